@@ -9,12 +9,16 @@
 
 #include "xenia/app/emulator_window.h"
 
+#include <algorithm>
+#include <cfloat>
+#include <cstdio>
 #include <filesystem>
 #include <functional>
 #include <memory>
 #include <mutex>
 #include <string>
 #include <utility>
+#include <vector>
 
 #include "third_party/fmt/include/fmt/chrono.h"
 #include "third_party/fmt/include/fmt/format.h"
@@ -25,7 +29,11 @@
 #include "xenia/base/clock.h"
 #include "xenia/base/cvar.h"
 #include "xenia/base/debugging.h"
+#include "xenia/base/fast_forward.h"
+#include "xenia/base/frame_timeline.h"
 #include "xenia/base/logging.h"
+#include "xenia/base/math.h"
+#include "xenia/base/metrics.h"
 #include "xenia/base/platform.h"
 #include "xenia/base/profiling.h"
 #include "xenia/base/system.h"
@@ -36,6 +44,8 @@
 #include "xenia/gpu/d3d12/d3d12_command_processor.h"
 #include "xenia/gpu/graphics_system.h"
 #include "xenia/hid/input_system.h"
+#include "xenia/kernel/kernel_flags.h"
+#include "xenia/kernel/util/kernel_call_stats.h"
 #include "xenia/kernel/xam/profile_manager.h"
 #include "xenia/kernel/xam/xam_module.h"
 #include "xenia/kernel/xam/xam_state.h"
@@ -214,6 +224,7 @@ std::unique_ptr<EmulatorWindow> EmulatorWindow::Create(
 }
 
 EmulatorWindow::~EmulatorWindow() {
+  shader_storage_progress_timer_.reset();
   // Notify the ImGui drawer that the immediate drawer is being destroyed.
   ShutdownGraphicsSystemPresenterPainting();
 }
@@ -572,6 +583,286 @@ void EmulatorWindow::DisplayConfigDialog::OnDraw(ImGuiIO& io) {
   }
 }
 
+void EmulatorWindow::KernelCallStatsDialog::OnDraw(ImGuiIO& io) {
+  ImGui::SetNextWindowPos(ImVec2(20, 20), ImGuiCond_FirstUseEver);
+  ImGui::SetNextWindowSize(ImVec2(640, 480), ImGuiCond_FirstUseEver);
+  bool dialog_open = true;
+  if (!ImGui::Begin("Kernel Call Statistics", &dialog_open,
+                    ImGuiWindowFlags_NoCollapse)) {
+    ImGui::End();
+    if (!dialog_open) {
+      emulator_window_.ToggleKernelCallStatsDialog();
+    }
+    return;
+  }
+
+  if (!cvars::kernel_call_stats) {
+    ImGui::TextUnformatted(
+        "Enable kernel_call_stats to count the kernel calls.");
+  } else {
+    if (ImGui::Button("Reset")) {
+      kernel::util::KernelCallStats::Reset();
+    }
+    auto records = kernel::util::KernelCallStats::GetRecords();
+    if (ImGui::BeginTable("Exports", 5,
+                          ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg |
+                              ImGuiTableFlags_ScrollY)) {
+      ImGui::TableSetupScrollFreeze(0, 1);
+      ImGui::TableSetupColumn("Export");
+      ImGui::TableSetupColumn("Ordinal");
+      ImGui::TableSetupColumn("Calls");
+      ImGui::TableSetupColumn("Host ms");
+      ImGui::TableSetupColumn("Host us/call");
+      ImGui::TableHeadersRow();
+      for (const auto& record : records) {
+        ImGui::TableNextRow();
+        ImGui::TableNextColumn();
+        ImGui::Text("%s!%s", record.module_name, record.export_entry->name);
+        ImGui::TableNextColumn();
+        ImGui::Text("%u", uint32_t(record.export_entry->ordinal));
+        ImGui::TableNextColumn();
+        ImGui::Text("%llu", (unsigned long long)record.call_count);
+        ImGui::TableNextColumn();
+        ImGui::Text("%.1f", record.host_time_us / 1000.0);
+        ImGui::TableNextColumn();
+        ImGui::Text("%.2f", record.host_time_us / double(record.call_count));
+      }
+      ImGui::EndTable();
+    }
+  }
+
+  ImGui::End();
+
+  if (!dialog_open) {
+    emulator_window_.ToggleKernelCallStatsDialog();
+    // `this` might have been destroyed by ToggleKernelCallStatsDialog.
+    return;
+  }
+}
+
+void EmulatorWindow::MetricsDialog::OnDraw(ImGuiIO& io) {
+  ImGui::SetNextWindowPos(ImVec2(20, 20), ImGuiCond_FirstUseEver);
+  ImGui::SetNextWindowSize(ImVec2(640, 480), ImGuiCond_FirstUseEver);
+  bool dialog_open = true;
+  if (!ImGui::Begin("Metrics", &dialog_open, ImGuiWindowFlags_NoCollapse)) {
+    ImGui::End();
+    if (!dialog_open) {
+      emulator_window_.ToggleMetricsDialog();
+    }
+    return;
+  }
+
+  if (ImGui::Button("Reset")) {
+    metrics::Reset();
+  }
+  auto values = metrics::Aggregate();
+  if (ImGui::BeginTable("Metrics", 6,
+                        ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg |
+                            ImGuiTableFlags_ScrollY)) {
+    ImGui::TableSetupScrollFreeze(0, 1);
+    ImGui::TableSetupColumn("Category");
+    ImGui::TableSetupColumn("Metric");
+    ImGui::TableSetupColumn("Count");
+    ImGui::TableSetupColumn("Mean");
+    ImGui::TableSetupColumn("p50");
+    ImGui::TableSetupColumn("p99");
+    ImGui::TableHeadersRow();
+    for (const metrics::MetricValue& value : values) {
+      ImGui::TableNextRow();
+      ImGui::TableNextColumn();
+      ImGui::TextUnformatted(value.metric->category());
+      ImGui::TableNextColumn();
+      ImGui::TextUnformatted(value.metric->description());
+      if (ImGui::IsItemHovered()) {
+        ImGui::SetTooltip("%s", value.metric->name());
+      }
+      ImGui::TableNextColumn();
+      ImGui::Text("%llu", (unsigned long long)value.count);
+      if (value.metric->type() == metrics::MetricType::kHistogram) {
+        ImGui::TableNextColumn();
+        ImGui::Text("%.2f", value.GetMean());
+        ImGui::TableNextColumn();
+        ImGui::Text("<= %llu",
+                    (unsigned long long)value.GetPercentileUpperBound(0.5));
+        ImGui::TableNextColumn();
+        ImGui::Text("<= %llu",
+                    (unsigned long long)value.GetPercentileUpperBound(0.99));
+      }
+    }
+    ImGui::EndTable();
+  }
+
+  ImGui::End();
+
+  if (!dialog_open) {
+    emulator_window_.ToggleMetricsDialog();
+    // `this` might have been destroyed by ToggleMetricsDialog.
+    return;
+  }
+}
+
+void EmulatorWindow::MemoryHeapsDialog::OnDraw(ImGuiIO& io) {
+  ImGui::SetNextWindowPos(ImVec2(20, 20), ImGuiCond_FirstUseEver);
+  ImGui::SetNextWindowSize(ImVec2(800, 480), ImGuiCond_FirstUseEver);
+  bool dialog_open = true;
+  if (!ImGui::Begin("Memory Heaps", &dialog_open,
+                    ImGuiWindowFlags_NoCollapse)) {
+    ImGui::End();
+    if (!dialog_open) {
+      emulator_window_.ToggleMemoryHeapsDialog();
+    }
+    return;
+  }
+
+  emulator_window_.emulator()->memory()->QueryHeapStats(heap_stats_);
+  if (ImGui::BeginTable("Heaps", 8,
+                        ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) {
+    ImGui::TableSetupColumn("Heap");
+    ImGui::TableSetupColumn("Page");
+    ImGui::TableSetupColumn("Reserved MB");
+    ImGui::TableSetupColumn("Committed MB");
+    ImGui::TableSetupColumn("Largest free MB");
+    ImGui::TableSetupColumn("Free runs");
+    ImGui::TableSetupColumn("Allocations");
+    ImGui::TableSetupColumn("Allocs/s");
+    ImGui::TableHeadersRow();
+    for (const HeapStats& stats : heap_stats_) {
+      ImGui::TableNextRow();
+      ImGui::TableNextColumn();
+      ImGui::Text("%08X-%08X", stats.heap_base,
+                  stats.heap_base + (stats.heap_size - 1));
+      ImGui::TableNextColumn();
+      ImGui::Text("%u KB", stats.page_size >> 10);
+      ImGui::TableNextColumn();
+      ImGui::Text("%.1f / %.1f",
+                  double(stats.reserved_page_count) * stats.page_size /
+                      (1024 * 1024),
+                  double(stats.heap_size) / (1024 * 1024));
+      ImGui::TableNextColumn();
+      ImGui::Text("%.1f", double(stats.committed_page_count) *
+                              stats.page_size / (1024 * 1024));
+      ImGui::TableNextColumn();
+      ImGui::Text("%.1f", double(stats.largest_free_page_run) *
+                              stats.page_size / (1024 * 1024));
+      ImGui::TableNextColumn();
+      ImGui::Text("%u", stats.free_run_count);
+      ImGui::TableNextColumn();
+      ImGui::Text("%llu (%llu live)",
+                  (unsigned long long)stats.allocation_count,
+                  (unsigned long long)(stats.allocation_count -
+                                       stats.release_count));
+      ImGui::TableNextColumn();
+      ImGui::Text("%.1f", stats.allocations_per_second);
+    }
+    ImGui::EndTable();
+  }
+
+  // Allocation sizes of each heap, in power of two buckets.
+  for (const HeapStats& stats : heap_stats_) {
+    char label[32];
+    std::snprintf(label, xe::countof(label), "%08X sizes", stats.heap_base);
+    if (!ImGui::TreeNode(label)) {
+      continue;
+    }
+    float histogram[HeapStats::kAllocationSizeBucketCount];
+    for (uint32_t i = 0; i < HeapStats::kAllocationSizeBucketCount; ++i) {
+      histogram[i] = float(stats.allocation_size_histogram[i]);
+    }
+    ImGui::PlotHistogram("##sizes", histogram,
+                         int(HeapStats::kAllocationSizeBucketCount), 0,
+                         "4 KB .. 2 GB+", 0.0f, FLT_MAX, ImVec2(0, 80));
+    ImGui::TreePop();
+  }
+
+  ImGui::End();
+
+  if (!dialog_open) {
+    emulator_window_.ToggleMemoryHeapsDialog();
+    // `this` might have been destroyed by ToggleMemoryHeapsDialog.
+    return;
+  }
+}
+
+void EmulatorWindow::FrameTimelineDialog::OnDraw(ImGuiIO& io) {
+  ImGui::SetNextWindowPos(ImVec2(20, 20), ImGuiCond_FirstUseEver);
+  ImGui::SetNextWindowSize(ImVec2(640, 480), ImGuiCond_FirstUseEver);
+  bool dialog_open = true;
+  if (!ImGui::Begin("Frame Timeline", &dialog_open,
+                    ImGuiWindowFlags_NoCollapse)) {
+    ImGui::End();
+    if (!dialog_open) {
+      emulator_window_.ToggleFrameTimelineDialog();
+    }
+    return;
+  }
+
+  if (!frame_timeline::IsEnabled()) {
+    ImGui::TextUnformatted(
+        "Enable frame_timeline to record the durations of the frames.");
+  } else {
+    if (ImGui::Button("Reset")) {
+      frame_timeline::Reset();
+    }
+    ImGui::SameLine();
+    if (ImGui::Button("Export CSV")) {
+      frame_timeline::ExportCsv(cvars::frame_timeline_export_path);
+    }
+    std::vector<frame_timeline::Frame> frames = frame_timeline::GetFrames();
+    uint64_t budget_ticks = frame_timeline::GetBudgetTicks(frames);
+    double ms_per_tick = 1000.0 / double(Clock::QueryHostTickFrequency());
+    std::vector<float> durations_ms;
+    durations_ms.reserve(frames.size());
+    float max_duration_ms = 0.0f;
+    for (const frame_timeline::Frame& frame : frames) {
+      float duration_ms = float(double(frame.duration_ticks) * ms_per_tick);
+      durations_ms.push_back(duration_ms);
+      max_duration_ms = std::max(max_duration_ms, duration_ms);
+    }
+    ImGui::PlotHistogram("##Durations", durations_ms.data(),
+                         int(durations_ms.size()), 0, "Frame durations, ms",
+                         0.0f, max_duration_ms, ImVec2(-1.0f, 120.0f));
+    if (!frames.empty()) {
+      ImGui::Text("Last frame %.2f ms, present latency %.2f ms, budget %.2f ms",
+                  durations_ms.back(),
+                  double(frames.back().present_latency_ticks) * ms_per_tick,
+                  double(budget_ticks) * ms_per_tick);
+    }
+    if (ImGui::BeginTable("Stutters", 3,
+                          ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg |
+                              ImGuiTableFlags_ScrollY)) {
+      ImGui::TableSetupScrollFreeze(0, 1);
+      ImGui::TableSetupColumn("Frame");
+      ImGui::TableSetupColumn("Duration, ms");
+      ImGui::TableSetupColumn("Dominant activity");
+      ImGui::TableHeadersRow();
+      // The most recent first.
+      for (size_t i = frames.size(); i--;) {
+        const frame_timeline::Frame& frame = frames[i];
+        if (frame.duration_ticks <= budget_ticks) {
+          continue;
+        }
+        ImGui::TableNextRow();
+        ImGui::TableNextColumn();
+        ImGui::Text("%llu", (unsigned long long)frame.number);
+        ImGui::TableNextColumn();
+        ImGui::Text("%.2f", durations_ms[i]);
+        ImGui::TableNextColumn();
+        ImGui::TextUnformatted(
+            frame_timeline::DescribeDominantActivity(frame).c_str());
+      }
+      ImGui::EndTable();
+    }
+  }
+
+  ImGui::End();
+
+  if (!dialog_open) {
+    emulator_window_.ToggleFrameTimelineDialog();
+    // `this` might have been destroyed by ToggleFrameTimelineDialog.
+    return;
+  }
+}
+
 bool EmulatorWindow::Initialize() {
   window_->AddListener(&window_listener_);
   window_->AddInputListener(&window_listener_, kZOrderEmulatorWindowInput);
@@ -637,6 +928,9 @@ bool EmulatorWindow::Initialize() {
     cpu_menu->AddChild(MenuItem::Create(
         MenuItem::Type::kString, "Time Scalar *= 2", "Numpad +",
         std::bind(&EmulatorWindow::CpuTimeScalarSetDouble, this)));
+    cpu_menu->AddChild(MenuItem::Create(
+        MenuItem::Type::kString, "Toggle &Fast-Forward", "Numpad /",
+        std::bind(&EmulatorWindow::CpuToggleFastForward, this)));
   }
   cpu_menu->AddChild(MenuItem::Create(MenuItem::Type::kSeparator));
   {
@@ -646,6 +940,18 @@ bool EmulatorWindow::Initialize() {
     cpu_menu->AddChild(MenuItem::Create(MenuItem::Type::kString,
                                         "&Pause/Resume Profiler", "`",
                                         []() { Profiler::TogglePause(); }));
+    cpu_menu->AddChild(MenuItem::Create(
+        MenuItem::Type::kString, "&Kernel Call Statistics", "",
+        std::bind(&EmulatorWindow::ToggleKernelCallStatsDialog, this)));
+    cpu_menu->AddChild(MenuItem::Create(
+        MenuItem::Type::kString, "&Metrics", "",
+        std::bind(&EmulatorWindow::ToggleMetricsDialog, this)));
+    cpu_menu->AddChild(MenuItem::Create(
+        MenuItem::Type::kString, "Memory &Heaps", "",
+        std::bind(&EmulatorWindow::ToggleMemoryHeapsDialog, this)));
+    cpu_menu->AddChild(MenuItem::Create(
+        MenuItem::Type::kString, "&Frame Timeline", "",
+        std::bind(&EmulatorWindow::ToggleFrameTimelineDialog, this)));
   }
   cpu_menu->AddChild(MenuItem::Create(MenuItem::Type::kSeparator));
   {
@@ -855,6 +1161,9 @@ void EmulatorWindow::OnKeyDown(ui::KeyEvent& e) {
     case ui::VirtualKey::kAdd: {
       CpuTimeScalarSetDouble();
     } break;
+    case ui::VirtualKey::kDivide: {
+      CpuToggleFastForward();
+    } break;
 
     case ui::VirtualKey::kF3: {
       Profiler::ToggleDisplay();
@@ -1356,6 +1665,11 @@ void EmulatorWindow::CpuTimeScalarSetDouble() {
   UpdateTitle();
 }
 
+void EmulatorWindow::CpuToggleFastForward() {
+  fast_forward::SetEnabled(!fast_forward::IsEnabled());
+  UpdateTitle();
+}
+
 void EmulatorWindow::CpuBreakIntoDebugger() {
   if (!cvars::debug) {
     xe::ui::ImGuiDialog::ShowMessageBox(imgui_drawer_.get(), "Xenia Debugger",
@@ -1407,6 +1721,42 @@ void EmulatorWindow::ToggleDisplayConfigDialog() {
   }
 }
 
+void EmulatorWindow::ToggleKernelCallStatsDialog() {
+  if (!kernel_call_stats_dialog_) {
+    kernel_call_stats_dialog_ = std::unique_ptr<KernelCallStatsDialog>(
+        new KernelCallStatsDialog(imgui_drawer_.get(), *this));
+  } else {
+    kernel_call_stats_dialog_.reset();
+  }
+}
+
+void EmulatorWindow::ToggleMetricsDialog() {
+  if (!metrics_dialog_) {
+    metrics_dialog_ = std::unique_ptr<MetricsDialog>(
+        new MetricsDialog(imgui_drawer_.get(), *this));
+  } else {
+    metrics_dialog_.reset();
+  }
+}
+
+void EmulatorWindow::ToggleMemoryHeapsDialog() {
+  if (!memory_heaps_dialog_) {
+    memory_heaps_dialog_ = std::unique_ptr<MemoryHeapsDialog>(
+        new MemoryHeapsDialog(imgui_drawer_.get(), *this));
+  } else {
+    memory_heaps_dialog_.reset();
+  }
+}
+
+void EmulatorWindow::ToggleFrameTimelineDialog() {
+  if (!frame_timeline_dialog_) {
+    frame_timeline_dialog_ = std::unique_ptr<FrameTimelineDialog>(
+        new FrameTimelineDialog(imgui_drawer_.get(), *this));
+  } else {
+    frame_timeline_dialog_.reset();
+  }
+}
+
 void EmulatorWindow::ToggleProfilesConfigDialog() {
   if (!profile_config_dialog_) {
     disable_hotkeys_ = true;
@@ -1493,12 +1843,33 @@ void EmulatorWindow::UpdateTitle() {
     }
   }
 
-  if (Clock::guest_time_scalar() != 1.0) {
+  if (fast_forward::IsEnabled()) {
+    sb.AppendFormat(u8" (fast-forward @{:.2f}x)", Clock::guest_time_scalar());
+  } else if (Clock::guest_time_scalar() != 1.0) {
     sb.AppendFormat(u8" (@{:.2f}x)", Clock::guest_time_scalar());
   }
 
-  if (initializing_shader_storage_) {
-    sb.Append(u8" (Preloading shaders\u2026)");
+  // Pipelines from the shader storage may still be created in the background
+  // after the initialization.
+  uint32_t shader_storage_done = 0, shader_storage_total = 0;
+  gpu::CommandProcessor* command_processor =
+      graphics_system ? graphics_system->command_processor() : nullptr;
+  if (command_processor) {
+    command_processor->GetShaderStorageProgress(shader_storage_done,
+                                                shader_storage_total);
+  }
+  if (initializing_shader_storage_ ||
+      shader_storage_done < shader_storage_total) {
+    sb.Append(initializing_shader_storage_ ? u8" (Preloading shaders\u2026"
+                                           : u8" (Creating pipelines\u2026");
+    if (shader_storage_total) {
+      sb.AppendFormat(u8" {}%",
+                      uint64_t(shader_storage_done) * 100 /
+                          shader_storage_total);
+    }
+    sb.Append(u8")");
+  } else {
+    shader_storage_progress_timer_.reset();
   }
 
   patcher::Patcher* patcher = emulator()->patcher();
@@ -1519,6 +1890,14 @@ void EmulatorWindow::SetInitializingShaderStorage(bool initializing) {
     return;
   }
   initializing_shader_storage_ = initializing;
+  if (initializing && !shader_storage_progress_timer_) {
+    // Refreshing the progress in the title until the loading is completed.
+    shader_storage_progress_timer_ =
+        xe::threading::HighResolutionTimer::CreateRepeating(
+            std::chrono::milliseconds(500), [this]() {
+              app_context_.CallInUIThread([this]() { UpdateTitle(); });
+            });
+  }
   UpdateTitle();
 }
 
@@ -12,9 +12,12 @@
 
 #include <memory>
 #include <string>
+#include <vector>
 
+#include "xenia/base/threading.h"
 #include "xenia/emulator.h"
 #include "xenia/gpu/command_processor.h"
+#include "xenia/memory.h"
 #include "xenia/ui/imgui_dialog.h"
 #include "xenia/ui/imgui_drawer.h"
 #include "xenia/ui/immediate_drawer.h"
@@ -186,6 +189,67 @@ class EmulatorWindow {
     EmulatorWindow& emulator_window_;
   };
 
+  class KernelCallStatsDialog final : public ui::ImGuiDialog {
+   public:
+    KernelCallStatsDialog(ui::ImGuiDrawer* imgui_drawer,
+                          EmulatorWindow& emulator_window)
+        : ui::ImGuiDialog(imgui_drawer), emulator_window_(emulator_window) {}
+
+    bool IsUpdatedContinuously() const override { return true; }
+
+   protected:
+    void OnDraw(ImGuiIO& io) override;
+
+   private:
+    EmulatorWindow& emulator_window_;
+  };
+
+  class MetricsDialog final : public ui::ImGuiDialog {
+   public:
+    MetricsDialog(ui::ImGuiDrawer* imgui_drawer,
+                  EmulatorWindow& emulator_window)
+        : ui::ImGuiDialog(imgui_drawer), emulator_window_(emulator_window) {}
+
+    bool IsUpdatedContinuously() const override { return true; }
+
+   protected:
+    void OnDraw(ImGuiIO& io) override;
+
+   private:
+    EmulatorWindow& emulator_window_;
+  };
+
+  class MemoryHeapsDialog final : public ui::ImGuiDialog {
+   public:
+    MemoryHeapsDialog(ui::ImGuiDrawer* imgui_drawer,
+                      EmulatorWindow& emulator_window)
+        : ui::ImGuiDialog(imgui_drawer), emulator_window_(emulator_window) {}
+
+    bool IsUpdatedContinuously() const override { return true; }
+
+   protected:
+    void OnDraw(ImGuiIO& io) override;
+
+   private:
+    EmulatorWindow& emulator_window_;
+    std::vector<HeapStats> heap_stats_;
+  };
+
+  class FrameTimelineDialog final : public ui::ImGuiDialog {
+   public:
+    FrameTimelineDialog(ui::ImGuiDrawer* imgui_drawer,
+                        EmulatorWindow& emulator_window)
+        : ui::ImGuiDialog(imgui_drawer), emulator_window_(emulator_window) {}
+
+    bool IsUpdatedContinuously() const override { return true; }
+
+   protected:
+    void OnDraw(ImGuiIO& io) override;
+
+   private:
+    EmulatorWindow& emulator_window_;
+  };
+
   explicit EmulatorWindow(Emulator* emulator,
                           ui::WindowedAppContext& app_context, uint32_t width,
                           uint32_t height);
@@ -222,11 +286,16 @@ class EmulatorWindow {
   void CpuTimeScalarReset();
   void CpuTimeScalarSetHalf();
   void CpuTimeScalarSetDouble();
+  void CpuToggleFastForward();
   void CpuBreakIntoDebugger();
   void CpuBreakIntoHostDebugger();
   void GpuTraceFrame();
   void GpuClearCaches();
   void ToggleDisplayConfigDialog();
+  void ToggleKernelCallStatsDialog();
+  void ToggleMetricsDialog();
+  void ToggleMemoryHeapsDialog();
+  void ToggleFrameTimelineDialog();
   void ToggleControllerVibration();
   void ShowCompatibility();
   void ShowFAQ();
@@ -264,8 +333,14 @@ class EmulatorWindow {
 
   std::string base_title_;
   bool initializing_shader_storage_ = false;
+  std::unique_ptr<xe::threading::HighResolutionTimer>
+      shader_storage_progress_timer_;
 
   std::unique_ptr<DisplayConfigDialog> display_config_dialog_;
+  std::unique_ptr<KernelCallStatsDialog> kernel_call_stats_dialog_;
+  std::unique_ptr<MetricsDialog> metrics_dialog_;
+  std::unique_ptr<MemoryHeapsDialog> memory_heaps_dialog_;
+  std::unique_ptr<FrameTimelineDialog> frame_timeline_dialog_;
 
   // Storing pointers and toggling dialog state is useful for broadcasting
   // messages back to guest.
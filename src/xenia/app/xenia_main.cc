@@ -21,6 +21,7 @@
 #include "xenia/base/cvar.h"
 #include "xenia/base/debugging.h"
 #include "xenia/base/logging.h"
+#include "xenia/base/mutex.h"
 #include "xenia/base/platform.h"
 #include "xenia/base/profiling.h"
 #include "xenia/base/threading.h"
@@ -89,6 +90,13 @@ DEFINE_path(
     "for the OS, will be used.",
     "Storage");
 
+#if XE_ENABLE_LOCK_INSTRUMENTATION == 1
+DEFINE_path(lock_instrumentation_json, "lock_statistics.json",
+            "File to write the lock wait and hold times to on exit, or empty "
+            "to not write them.",
+            "General");
+#endif  // XE_ENABLE_LOCK_INSTRUMENTATION
+
 DEFINE_bool(mount_scratch, false, "Enable scratch mount", "Storage");
 
 DEFINE_bool(mount_cache, true, "Enable cache mount", "Storage");
@@ -477,6 +485,11 @@ void EmulatorApp::OnDestroy() {
   }
 
   Profiler::Dump();
+#if XE_ENABLE_LOCK_INSTRUMENTATION == 1
+  if (!cvars::lock_instrumentation_json.empty()) {
+    xe::lock_instrumentation::DumpJson(cvars::lock_instrumentation_json);
+  }
+#endif  // XE_ENABLE_LOCK_INSTRUMENTATION
   // The profiler needs to shut down before the graphics context.
   Profiler::Shutdown();
 
@@ -9,10 +9,78 @@
 
 #include "xenia/apu/audio_driver.h"
 
+#include <algorithm>
+
+#include "xenia/base/assert.h"
+#include "xenia/base/cvar.h"
+#include "xenia/base/profiling.h"
+
+DEFINE_bool(apu_adaptive_queued_frames, false,
+            "Lower the number of audio frames the guest can queue, down to "
+            "apu_min_queued_frames, while no underruns happen, and raise it "
+            "again up to apu_max_queued_frames when the host runs out of "
+            "frames, reducing the audio delay in stable scenes. Only used by "
+            "the SDL audio driver.",
+            "APU");
+DEFINE_uint32(apu_min_queued_frames, 2,
+              "Minimum number of audio frames the guest can queue with "
+              "apu_adaptive_queued_frames.",
+              "APU");
+DEFINE_uint32(apu_adaptive_queued_frames_stable_frames, 375,
+              "Number of audio frames (of 5.33 ms each) consumed without an "
+              "underrun after which the number of frames the guest can queue "
+              "is reduced by one with apu_adaptive_queued_frames.",
+              "APU");
+
 namespace xe {
 namespace apu {
 
 AudioDriver::~AudioDriver() = default;
 
+void AudioDriver::SetupQueueDepthAdaptation(uint32_t queued_frames) {
+  queue_frames_withheld_ = 0;
+  queue_frames_without_underrun_ = 0;
+  if (!cvars::apu_adaptive_queued_frames) {
+    queue_depth_max_ = 0;
+    return;
+  }
+  queue_depth_max_ = queued_frames;
+  queue_depth_min_ = std::min(
+      std::max(cvars::apu_min_queued_frames, uint32_t(1)), queued_frames);
+  COUNT_profile_set("apu/queued_frame_limit", queue_depth_max_);
+}
+
+void AudioDriver::OnQueuedFrameConsumed(xe::threading::Semaphore* semaphore) {
+  if (queue_depth_max_ &&
+      ++queue_frames_without_underrun_ >=
+          cvars::apu_adaptive_queued_frames_stable_frames &&
+      queue_depth_max_ - queue_frames_withheld_ > queue_depth_min_) {
+    // Stable for long enough - not giving the slot of the frame back to the
+    // guest.
+    queue_frames_without_underrun_ = 0;
+    ++queue_frames_withheld_;
+    COUNT_profile_set("apu/queued_frame_limit",
+                      queue_depth_max_ - queue_frames_withheld_);
+    return;
+  }
+  auto ret = semaphore->Release(1, nullptr);
+  assert_true(ret);
+}
+
+void AudioDriver::OnQueueUnderrun(xe::threading::Semaphore* semaphore) {
+  if (!queue_depth_max_) {
+    return;
+  }
+  queue_frames_without_underrun_ = 0;
+  if (queue_frames_withheld_) {
+    // Let the guest queue one more frame.
+    --queue_frames_withheld_;
+    auto ret = semaphore->Release(1, nullptr);
+    assert_true(ret);
+    COUNT_profile_set("apu/queued_frame_limit",
+                      queue_depth_max_ - queue_frames_withheld_);
+  }
+}
+
 }  // namespace apu
 }  // namespace xe
@@ -10,6 +10,9 @@
 #ifndef XENIA_APU_AUDIO_DRIVER_H_
 #define XENIA_APU_AUDIO_DRIVER_H_
 
+#include <cstdint>
+
+#include "xenia/base/threading.h"
 #include "xenia/memory.h"
 #include "xenia/xbox.h"
 
@@ -34,6 +37,27 @@ class AudioDriver {
   virtual void Pause() = 0;
   virtual void Resume() = 0;
   virtual void SetVolume(float volume) = 0;
+
+  // Enables adapting the number of frames the guest can queue to the observed
+  // underruns if configured, for a driver whose semaphore initially allows
+  // queued_frames frames to be queued.
+  void SetupQueueDepthAdaptation(uint32_t queued_frames);
+
+ protected:
+  // To be called by the implementations with the semaphore they were created
+  // with instead of releasing it directly when the host has consumed a frame.
+  void OnQueuedFrameConsumed(xe::threading::Semaphore* semaphore);
+  // To be called when the host requested a frame, but none was queued.
+  void OnQueueUnderrun(xe::threading::Semaphore* semaphore);
+
+ private:
+  // 0 if the queue depth is not adapted.
+  uint32_t queue_depth_max_ = 0;
+  uint32_t queue_depth_min_ = 0;
+  // Semaphore slots held back from the guest to reduce the latency.
+  uint32_t queue_frames_withheld_ = 0;
+  // Frames consumed since the last underrun or queue depth reduction.
+  uint32_t queue_frames_without_underrun_ = 0;
 };
 
 }  // namespace apu
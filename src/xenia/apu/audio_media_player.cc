@@ -13,6 +13,8 @@
 #include "xenia/apu/xma_context.h"
 #include "xenia/base/logging.h"
 
+#include <algorithm>
+
 #include <XAudio2.h>
 
 extern "C" {
@@ -35,15 +37,77 @@ DEFINE_int32(xmp_default_volume, 70,
 namespace xe {
 namespace apu {
 
-int32_t InitializeAndOpenAvCodec(std::vector<uint8_t>* song_data,
+// Size of the buffer for reading the song file - the file is streamed from the
+// file system rather than loaded into memory entirely before the playback.
+constexpr int kSongFileStreamBufferSize = 64 * 1024;
+
+struct SongFileStream {
+  vfs::File* file;
+  uint64_t size;
+  uint64_t position;
+};
+
+int ReadSongFileStream(void* opaque, uint8_t* buf, int buf_size) {
+  auto stream = reinterpret_cast<SongFileStream*>(opaque);
+  if (stream->position >= stream->size) {
+    return AVERROR_EOF;
+  }
+  size_t bytes_to_read = size_t(
+      std::min(uint64_t(buf_size), stream->size - stream->position));
+  size_t bytes_read = 0;
+  X_STATUS result = stream->file->ReadSync(buf, bytes_to_read,
+                                           stream->position, &bytes_read);
+  if (XFAILED(result) || !bytes_read) {
+    return AVERROR_EOF;
+  }
+  stream->position += bytes_read;
+  return int(bytes_read);
+}
+
+int64_t SeekSongFileStream(void* opaque, int64_t offset, int whence) {
+  auto stream = reinterpret_cast<SongFileStream*>(opaque);
+  int64_t position;
+  switch (whence & ~AVSEEK_FORCE) {
+    case AVSEEK_SIZE:
+      return int64_t(stream->size);
+    case SEEK_SET:
+      position = offset;
+      break;
+    case SEEK_CUR:
+      position = int64_t(stream->position) + offset;
+      break;
+    case SEEK_END:
+      position = int64_t(stream->size) + offset;
+      break;
+    default:
+      return -1;
+  }
+  if (position < 0) {
+    return -1;
+  }
+  stream->position = uint64_t(position);
+  return position;
+}
+
+int32_t InitializeAndOpenAvCodec(SongFileStream* song_stream,
+                                 AVIOContext*& io_context,
                                  AVFormatContext*& format_context,
                                  AVCodecContext*& av_context) {
-  AVIOContext* io_ctx =
-      avio_alloc_context(song_data->data(), (int)song_data->size(), 0, nullptr,
-                         nullptr, nullptr, nullptr);
+  auto io_buffer =
+      reinterpret_cast<uint8_t*>(av_malloc(kSongFileStreamBufferSize));
+  if (!io_buffer) {
+    return AVERROR(ENOMEM);
+  }
+  io_context =
+      avio_alloc_context(io_buffer, kSongFileStreamBufferSize, 0, song_stream,
+                         ReadSongFileStream, nullptr, SeekSongFileStream);
+  if (!io_context) {
+    av_free(io_buffer);
+    return AVERROR(ENOMEM);
+  }
 
   format_context = avformat_alloc_context();
-  format_context->pb = io_ctx;
+  format_context->pb = io_context;
 
   int ret = avformat_open_input(&format_context, nullptr, nullptr, nullptr);
   if (ret < 0) {
@@ -71,6 +135,17 @@ int32_t InitializeAndOpenAvCodec(std::vector<uint8_t>* song_data,
   return ret;
 }
 
+void CloseAvCodec(AVIOContext*& io_context, AVFormatContext*& format_context,
+                  AVCodecContext*& av_context) {
+  avcodec_free_context(&av_context);
+  // Custom I/O is not closed by avformat_close_input.
+  avformat_close_input(&format_context);
+  if (io_context) {
+    av_freep(&io_context->buffer);
+    avio_context_free(&io_context);
+  }
+}
+
 void ConvertAudioFrame(AVFrame* frame, int channel_count,
                        std::vector<float>* framebuffer) {
   framebuffer->reserve(frame->nb_samples * channel_count);
@@ -222,22 +297,28 @@ X_STATUS AudioMediaPlayer::Play(uint32_t playlist_handle, uint32_t song_handle,
 }
 
 void AudioMediaPlayer::Play() {
-  std::vector<uint8_t>* song_buffer = new std::vector<uint8_t>();
-
-  if (!LoadSongToMemory(song_buffer)) {
+  vfs::File* song_file = OpenSongFile();
+  if (!song_file) {
     return;
   }
+  SongFileStream song_stream = {song_file, song_file->entry()->size(), 0};
 
+  AVIOContext* ioContext = nullptr;
   AVFormatContext* formatContext = nullptr;
   AVCodecContext* codecContext = nullptr;
-  InitializeAndOpenAvCodec(song_buffer, formatContext, codecContext);
+  if (InitializeAndOpenAvCodec(&song_stream, ioContext, formatContext,
+                               codecContext) < 0) {
+    XELOGE("Failed to open the song {} for decoding",
+           xe::to_utf8(active_song_->file_path));
+    CloseAvCodec(ioContext, formatContext, codecContext);
+    song_file->Destroy();
+    return;
+  }
 
   if (!SetupDriver(codecContext->sample_rate, codecContext->channels)) {
     XELOGE("Driver initialization failed!");
-    avcodec_free_context(&codecContext);
-    av_freep(&formatContext->pb->buffer);
-    avio_context_free(&formatContext->pb);
-    avformat_close_input(&formatContext);
+    CloseAvCodec(ioContext, formatContext, codecContext);
+    song_file->Destroy();
     return;
   }
 
@@ -265,10 +346,8 @@ void AudioMediaPlayer::Play() {
   }
 
   // Cleanup after work
-  avcodec_free_context(&codecContext);
-  av_freep(&formatContext->pb->buffer);
-  avio_context_free(&formatContext->pb);
-  avformat_close_input(&formatContext);
+  CloseAvCodec(ioContext, formatContext, codecContext);
+  song_file->Destroy();
 
   processing_end_fence_.Signal();
 
@@ -395,9 +474,9 @@ X_STATUS AudioMediaPlayer::Previous() {
   return X_STATUS_SUCCESS;
 }
 
-bool AudioMediaPlayer::LoadSongToMemory(std::vector<uint8_t>* buffer) {
+vfs::File* AudioMediaPlayer::OpenSongFile() {
   if (!active_song_) {
-    return false;
+    return nullptr;
   }
 
   // Find file based on provided path?
@@ -409,15 +488,10 @@ bool AudioMediaPlayer::LoadSongToMemory(std::vector<uint8_t>* buffer) {
       &vfs_file, &file_action);
 
   if (result) {
-    return false;
+    return nullptr;
   }
 
-  buffer->resize(vfs_file->entry()->size());
-  size_t bytes_read = 0;
-  result = vfs_file->ReadSync(buffer->data(), vfs_file->entry()->size(), 0,
-                              &bytes_read);
-
-  return !result;
+  return vfs_file;
 }
 
 void AudioMediaPlayer::AddPlaylist(uint32_t handle,
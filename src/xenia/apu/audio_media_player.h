@@ -12,6 +12,7 @@
 
 #include "xenia/apu/audio_system.h"
 #include "xenia/kernel/xam/apps/xmp_app.h"
+#include "xenia/vfs/file.h"
 
 namespace xe {
 namespace apu {
@@ -97,7 +98,9 @@ class AudioMediaPlayer {
 
   void Play();
   void WorkerThreadMain();
-  bool LoadSongToMemory(std::vector<uint8_t>* buffer);
+  // Returns the file of the active song, to be destroyed by the caller, or
+  // nullptr if failed to open.
+  vfs::File* OpenSongFile();
 
   XmpApp::State state_ = XmpApp::State::kIdle;
   XmpApp::PlaybackClient playback_client_ = XmpApp::PlaybackClient::kSystem;
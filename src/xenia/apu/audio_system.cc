@@ -14,6 +14,7 @@
 #include "xenia/apu/xma_decoder.h"
 #include "xenia/base/assert.h"
 #include "xenia/base/byte_stream.h"
+#include "xenia/base/fast_forward.h"
 #include "xenia/base/logging.h"
 #include "xenia/base/math.h"
 #include "xenia/base/profiling.h"
@@ -137,8 +138,9 @@ void AudioSystem::WorkerThreadMain() {
       if (client_callback) {
         SCOPE_profile_cpu_i("apu", "xe::apu::AudioSystem->client_callback");
         uint64_t args[] = {client_callback_arg};
-        processor_->Execute(worker_thread_->thread_state(), client_callback,
-                            args, xe::countof(args));
+        client_callbacks_[index].Call(worker_thread_->thread_state(),
+                                      client_callback, args,
+                                      xe::countof(args));
       }
 
       pumped = true;
@@ -197,11 +199,16 @@ X_STATUS AudioSystem::RegisterClient(uint32_t callback, uint32_t callback_arg,
     return result;
   }
   assert_not_null(driver);
+  driver->SetupQueueDepthAdaptation(queued_frames_);
 
   uint32_t ptr = memory()->SystemHeapAlloc(0x4);
   xe::store_and_swap<uint32_t>(memory()->TranslateVirtual(ptr), callback_arg);
 
-  clients_[index] = {driver, callback, callback_arg, ptr, true};
+  {
+    std::lock_guard<xe::xe_unlikely_mutex> driver_lock(
+        client_driver_mutexes_[index]);
+    clients_[index] = {driver, callback, callback_arg, ptr, true};
+  }
 
   if (out_index) {
     *out_index = index;
@@ -213,8 +220,20 @@ X_STATUS AudioSystem::RegisterClient(uint32_t callback, uint32_t callback_arg,
 void AudioSystem::SubmitFrame(size_t index, float* samples) {
   SCOPE_profile_cpu_f("apu");
 
-  auto global_lock = global_critical_region_.Acquire();
+  // Not entering the global critical region, which is contended by all guest
+  // threads - the driver can only be replaced by registration and
+  // unregistration of the client, which are very unlikely to happen at the
+  // same time as submission.
   assert_true(index < kMaximumClientCount);
+  if (xe::fast_forward::IsEnabled()) {
+    // Not waiting for the playback, which would throttle the title to the
+    // real time - dropping the frame as if it has been consumed instead.
+    auto ret = client_semaphores_[index]->Release(1, nullptr);
+    assert_true(ret);
+    return;
+  }
+  std::lock_guard<xe::xe_unlikely_mutex> driver_lock(
+      client_driver_mutexes_[index]);
   assert_true(clients_[index].driver != NULL);
   (clients_[index].driver)->SubmitFrame(samples);
 }
@@ -224,9 +243,13 @@ void AudioSystem::UnregisterClient(size_t index) {
 
   auto global_lock = global_critical_region_.Acquire();
   assert_true(index < kMaximumClientCount);
-  DestroyDriver(clients_[index].driver);
-  memory()->SystemHeapFree(clients_[index].wrapped_callback_arg);
-  clients_[index] = {0};
+  {
+    std::lock_guard<xe::xe_unlikely_mutex> driver_lock(
+        client_driver_mutexes_[index]);
+    DestroyDriver(clients_[index].driver);
+    memory()->SystemHeapFree(clients_[index].wrapped_callback_arg);
+    clients_[index] = {0};
+  }
 
   // Drain the semaphore of its count.
   auto client_semaphore = client_semaphores_[index].get();
@@ -305,6 +328,9 @@ bool AudioSystem::Restore(ByteStream* stream) {
     }
 
     assert_not_null(driver);
+    driver->SetupQueueDepthAdaptation(queued_frames_);
+    std::lock_guard<xe::xe_unlikely_mutex> driver_lock(
+        client_driver_mutexes_[id]);
     client.driver = driver;
   }
 
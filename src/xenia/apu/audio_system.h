@@ -89,6 +89,11 @@ class AudioSystem {
     uint32_t wrapped_callback_arg;
     bool in_use;
   } clients_[kMaximumClientCount];
+  // Called only on the worker thread.
+  cpu::GuestCallback client_callbacks_[kMaximumClientCount];
+  // Protects the driver of each client instead of the global critical region
+  // in frame submission.
+  xe::xe_unlikely_mutex client_driver_mutexes_[kMaximumClientCount];
 
   int FindFreeClient();
 
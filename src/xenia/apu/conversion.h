@@ -10,6 +10,7 @@
 #ifndef XENIA_APU_CONVERSION_H_
 #define XENIA_APU_CONVERSION_H_
 
+#include <cstddef>
 #include <cstdint>
 
 #include "xenia/base/byte_order.h"
@@ -21,51 +22,42 @@ namespace conversion {
 
 #if XE_ARCH_AMD64
 
-XE_NOINLINE
-static void _generic_sequential_6_BE_to_interleaved_6_LE(
-    float* XE_RESTRICT output, const float* XE_RESTRICT input,
-    unsigned ch_sample_count) {
-  for (unsigned sample = 0; sample < ch_sample_count; sample++) {
-    for (unsigned channel = 0; channel < 6; channel++) {
-      unsigned int value = *reinterpret_cast<const unsigned int*>(
-          &input[channel * ch_sample_count + sample]);
+inline void sequential_6_BE_to_interleaved_6_LE(float* output,
+                                                const float* input,
+                                                size_t ch_sample_count) {
+  assert_true(ch_sample_count % 4 == 0);
+  const __m128i byte_swap_shuffle =
+      _mm_set_epi8(12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3);
 
-      *reinterpret_cast<unsigned int*>(&output[sample * 6 + channel]) =
-          xe::byte_swap(value);
-    }
-  }
-}
-#if XE_COMPILER_CLANG_CL != 1
-// load_be_u32 unavailable on clang-cl
-XE_NOINLINE
-static void _movbe_sequential_6_BE_to_interleaved_6_LE(
-    float* XE_RESTRICT output, const float* XE_RESTRICT input,
-    unsigned ch_sample_count) {
-  for (unsigned sample = 0; sample < ch_sample_count; sample++) {
-    for (unsigned channel = 0; channel < 6; channel++) {
-      *reinterpret_cast<unsigned int*>(&output[sample * 6 + channel]) =
-          _load_be_u32(reinterpret_cast<const unsigned int*>(
-              &input[channel * ch_sample_count + sample]));
+  for (size_t sample = 0; sample < ch_sample_count; sample += 4) {
+    // load 4 samples from 6 channels each and byte swap
+    __m128 channels[6];
+    for (size_t channel = 0; channel < 6; ++channel) {
+      channels[channel] = _mm_castsi128_ps(_mm_shuffle_epi8(
+          _mm_castps_si128(
+              _mm_loadu_ps(&input[channel * ch_sample_count + sample])),
+          byte_swap_shuffle));
     }
+    // transpose the first 4 channels to get them for each sample
+    _MM_TRANSPOSE4_PS(channels[0], channels[1], channels[2], channels[3]);
+    // interleave the last 2 channels for pairs of samples
+    __m128 channels_45_01 = _mm_unpacklo_ps(channels[4], channels[5]);
+    __m128 channels_45_23 = _mm_unpackhi_ps(channels[4], channels[5]);
+    float* sample_output = &output[sample * 6];
+    _mm_storeu_ps(sample_output, channels[0]);
+    _mm_storel_pi(reinterpret_cast<__m64*>(sample_output + 4), channels_45_01);
+    _mm_storeu_ps(sample_output + 6, channels[1]);
+    _mm_storeh_pi(reinterpret_cast<__m64*>(sample_output + 10),
+                  channels_45_01);
+    _mm_storeu_ps(sample_output + 12, channels[2]);
+    _mm_storel_pi(reinterpret_cast<__m64*>(sample_output + 16),
+                  channels_45_23);
+    _mm_storeu_ps(sample_output + 18, channels[3]);
+    _mm_storeh_pi(reinterpret_cast<__m64*>(sample_output + 22),
+                  channels_45_23);
   }
 }
 
-inline static void sequential_6_BE_to_interleaved_6_LE(
-    float* output, const float* input, unsigned ch_sample_count) {
-  if (amd64::GetFeatureFlags() & amd64::kX64EmitMovbe) {
-    _movbe_sequential_6_BE_to_interleaved_6_LE(output, input, ch_sample_count);
-  } else {
-    _generic_sequential_6_BE_to_interleaved_6_LE(output, input,
-                                                 ch_sample_count);
-  }
-}
-#else
-inline static void sequential_6_BE_to_interleaved_6_LE(
-    float* output, const float* input, unsigned ch_sample_count) {
-  _generic_sequential_6_BE_to_interleaved_6_LE(output, input, ch_sample_count);
-}
-#endif
-
 inline void sequential_6_BE_to_interleaved_2_LE(float* output,
                                                 const float* input,
                                                 size_t ch_sample_count) {
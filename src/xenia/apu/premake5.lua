@@ -18,3 +18,43 @@ project("xenia-apu")
     project_root.."/third_party/FFmpeg/",
   })
   local_platform_files()
+
+group("src")
+project("xenia-apu-xma-replay")
+  uuid("5b0c7a8e-2f4d-4e61-9c3a-8d1e6f2b7a49")
+  kind("ConsoleApp")
+  language("C++")
+  links({
+    "xenia-apu",
+    "xenia-apu-nop",
+    "xenia-base",
+    "xenia-core",
+    "xenia-cpu",
+    "xenia-gpu",
+    "xenia-hid",
+    "xenia-hid-nop",
+    "xenia-kernel",
+    "xenia-ui",
+    "xenia-vfs",
+    "xenia-patcher",
+  })
+  links({
+    "aes_128",
+    "capstone",
+    "fmt",
+    "imgui",
+    "libavcodec",
+    "libavformat",
+    "libavutil",
+    "mspack",
+    "snappy",
+    "xxhash",
+    "zstd",
+  })
+  includedirs({
+    project_root.."/third_party/FFmpeg/",
+  })
+  files({
+    "xma_replay_main.cc",
+    "../base/console_app_main_"..platform_suffix..".cc",
+  })
@@ -9,16 +9,26 @@
 
 #include "xenia/apu/sdl/sdl_audio_driver.h"
 
+#include <algorithm>
 #include <array>
 #include <cstring>
 
 #include "xenia/apu/apu_flags.h"
 #include "xenia/apu/conversion.h"
 #include "xenia/base/assert.h"
+#include "xenia/base/cvar.h"
 #include "xenia/base/logging.h"
 #include "xenia/base/profiling.h"
 #include "xenia/helper/sdl/sdl_helper.h"
 
+DEFINE_bool(apu_time_stretch, false,
+            "Change the tempo of the audio output without changing its pitch "
+            "according to how many audio frames the game has queued, so the "
+            "audio keeps playing smoothly instead of crackling when the "
+            "emulation is running slower or faster than full speed. Adds some "
+            "latency. Only used by the SDL audio driver.",
+            "APU");
+
 namespace xe {
 namespace apu {
 namespace sdl {
@@ -101,6 +111,13 @@ bool SDLAudioDriver::Initialize() {
   }
   sdl_device_channels_ = obtained_spec.channels;
 
+  if (cvars::apu_time_stretch && need_format_conversion_) {
+    time_stretcher_ =
+        std::make_unique<TimeStretcher>(sdl_device_channels_, frame_frequency_);
+    time_stretch_frame_.resize(channel_samples_ * sdl_device_channels_);
+    time_stretch_tempo_ = 1.0f;
+  }
+
   SDL_PauseAudioDevice(sdl_device_id_, 0);
 
   return true;
@@ -108,21 +125,15 @@ bool SDLAudioDriver::Initialize() {
 
 void SDLAudioDriver::SubmitFrame(float* frame) {
   float* output_frame;
-  {
-    std::unique_lock<std::mutex> guard(frames_mutex_);
-    if (frames_unused_.empty()) {
-      output_frame = new float[frame_channels_ * channel_samples_];
-    } else {
-      output_frame = frames_unused_.top();
-      frames_unused_.pop();
-    }
+  if (!frames_unused_.TryPop(output_frame)) {
+    output_frame = new float[frame_channels_ * channel_samples_];
   }
 
   std::memcpy(output_frame, frame, frame_size_);
 
-  {
-    std::unique_lock<std::mutex> guard(frames_mutex_);
-    frames_queued_.push(output_frame);
+  if (!frames_queued_.TryPush(output_frame)) {
+    assert_always("More frames submitted than the guest semaphore allows");
+    delete[] output_frame;
   }
 }
 
@@ -139,15 +150,16 @@ void SDLAudioDriver::Shutdown() {
     SDL_QuitSubSystem(SDL_INIT_AUDIO);
     sdl_initialized_ = false;
   }
-  std::unique_lock<std::mutex> guard(frames_mutex_);
-  while (!frames_unused_.empty()) {
-    delete[] frames_unused_.top();
-    frames_unused_.pop();
-  };
-  while (!frames_queued_.empty()) {
-    delete[] frames_queued_.front();
-    frames_queued_.pop();
-  };
+  // The callback is not invoked anymore after closing the device, so the
+  // queues can be drained from this thread.
+  time_stretcher_.reset();
+  float* frame;
+  while (frames_unused_.TryPop(frame)) {
+    delete[] frame;
+  }
+  while (frames_queued_.TryPop(frame)) {
+    delete[] frame;
+  }
 }
 
 void SDLAudioDriver::SDLCallback(void* userdata, Uint8* stream, int len) {
@@ -160,30 +172,19 @@ void SDLAudioDriver::SDLCallback(void* userdata, Uint8* stream, int len) {
   assert_true(len == sizeof(float) * driver->channel_samples_ *
                          driver->sdl_device_channels_);
 
-  std::unique_lock<std::mutex> guard(driver->frames_mutex_);
-  if (driver->frames_queued_.empty()) {
+  if (driver->time_stretcher_) {
+    driver->TimeStretchCallback(reinterpret_cast<float*>(stream));
+    return;
+  }
+  float* buffer;
+  if (!driver->frames_queued_.TryPop(buffer)) {
     std::memset(stream, 0, len);
+    driver->OnQueueUnderrun(driver->semaphore_);
   } else {
-    auto buffer = driver->frames_queued_.front();
-    driver->frames_queued_.pop();
     if (cvars::mute) {
       std::memset(stream, 0, len);
     } else if (driver->need_format_conversion_) {
-      switch (driver->sdl_device_channels_) {
-        case 2:
-          conversion::sequential_6_BE_to_interleaved_2_LE(
-              reinterpret_cast<float*>(stream), buffer,
-              driver->channel_samples_);
-          break;
-        case 6:
-          conversion::sequential_6_BE_to_interleaved_6_LE(
-              reinterpret_cast<float*>(stream), buffer,
-              driver->channel_samples_);
-          break;
-        default:
-          assert_unhandled_case(driver->sdl_device_channels_);
-          break;
-      }
+      driver->ConvertFrame(reinterpret_cast<float*>(stream), buffer);
     } else {
       assert_true(driver->sdl_device_channels_ == driver->frame_channels_);
       if (driver->volume_ != 1.0f) {
@@ -195,12 +196,66 @@ void SDLAudioDriver::SDLCallback(void* userdata, Uint8* stream, int len) {
         std::memcpy(stream, buffer, len);
       }
     }
-    driver->frames_unused_.push(buffer);
+    driver->ReleaseFrame(buffer);
 
-    auto ret = driver->semaphore_->Release(1, nullptr);
-    assert_true(ret);
+    driver->OnQueuedFrameConsumed(driver->semaphore_);
   }
 };
+
+void SDLAudioDriver::ReleaseFrame(float* frame) {
+  if (!frames_unused_.TryPush(frame)) {
+    delete[] frame;
+  }
+}
+
+void SDLAudioDriver::ConvertFrame(float* output, const float* frame) const {
+  switch (sdl_device_channels_) {
+    case 2:
+      conversion::sequential_6_BE_to_interleaved_2_LE(output, frame,
+                                                      channel_samples_);
+      break;
+    case 6:
+      conversion::sequential_6_BE_to_interleaved_6_LE(output, frame,
+                                                      channel_samples_);
+      break;
+    default:
+      assert_unhandled_case(sdl_device_channels_);
+      break;
+  }
+}
+
+void SDLAudioDriver::TimeStretchCallback(float* output) {
+  // Keeping enough frames for the time stretcher to work with and to absorb
+  // jitter of the guest, but taking only up to twice that from the guest so
+  // it's still paced by the audio output.
+  size_t target_frame_count =
+      time_stretcher_->GetMinimumInputFrameCount() + channel_samples_ * 2;
+  float* buffer;
+  while (time_stretcher_->GetBufferedFrameCount() < target_frame_count * 2 &&
+         frames_queued_.TryPop(buffer)) {
+    ConvertFrame(time_stretch_frame_.data(), buffer);
+    time_stretcher_->Push(time_stretch_frame_.data(), channel_samples_);
+    ReleaseFrame(buffer);
+    OnQueuedFrameConsumed(semaphore_);
+  }
+  size_t buffered_frame_count = time_stretcher_->GetBufferedFrameCount();
+  if (buffered_frame_count < target_frame_count) {
+    OnQueueUnderrun(semaphore_);
+  }
+
+  // Play slower if the guest is not providing frames fast enough, and faster
+  // if it's providing too many, smoothly to avoid audible tempo jumps.
+  float tempo_target =
+      std::min(std::max(float(buffered_frame_count) / float(target_frame_count),
+                        0.5f),
+               2.0f);
+  time_stretch_tempo_ += (tempo_target - time_stretch_tempo_) * 0.1f;
+  time_stretcher_->Pull(output, channel_samples_, time_stretch_tempo_);
+  if (cvars::mute) {
+    std::memset(output, 0,
+                sizeof(float) * channel_samples_ * sdl_device_channels_);
+  }
+}
 }  // namespace sdl
 }  // namespace apu
 }  // namespace xe
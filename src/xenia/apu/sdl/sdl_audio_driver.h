@@ -10,12 +10,13 @@
 #ifndef XENIA_APU_SDL_SDL_AUDIO_DRIVER_H_
 #define XENIA_APU_SDL_SDL_AUDIO_DRIVER_H_
 
-#include <mutex>
-#include <queue>
-#include <stack>
+#include <memory>
+#include <vector>
 
 #include "SDL.h"
 #include "xenia/apu/audio_driver.h"
+#include "xenia/apu/time_stretcher.h"
+#include "xenia/base/concurrent_ring_buffer.h"
 #include "xenia/base/threading.h"
 
 namespace xe {
@@ -39,6 +40,15 @@ class SDLAudioDriver : public AudioDriver {
 
  protected:
   static void SDLCallback(void* userdata, Uint8* stream, int len);
+  // Converts a guest frame to the format of the device.
+  void ConvertFrame(float* output, const float* frame) const;
+  // Returns a consumed frame for reuse by SubmitFrame.
+  void ReleaseFrame(float* frame);
+  void TimeStretchCallback(float* output);
+
+  // Larger than AudioSystem::kMaximumQueuedFrames, which the guest is limited
+  // to via the semaphore, so the queues don't overflow.
+  static constexpr size_t kFrameQueueCapacity = 128;
 
   xe::threading::Semaphore* semaphore_ = nullptr;
 
@@ -53,9 +63,14 @@ class SDLAudioDriver : public AudioDriver {
   uint32_t channel_samples_;
   uint32_t frame_size_;
   bool need_format_conversion_;
-  std::queue<float*> frames_queued_ = {};
-  std::stack<float*> frames_unused_ = {};
-  std::mutex frames_mutex_ = {};
+  // Frames from SubmitFrame to the SDL callback.
+  SpscRingBuffer<float*, kFrameQueueCapacity> frames_queued_;
+  // Frames returned by the SDL callback for reuse by SubmitFrame.
+  SpscRingBuffer<float*, kFrameQueueCapacity> frames_unused_;
+
+  std::unique_ptr<TimeStretcher> time_stretcher_;
+  std::vector<float> time_stretch_frame_;
+  float time_stretch_tempo_ = 1.0f;
 };
 
 }  // namespace sdl
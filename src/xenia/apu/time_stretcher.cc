@@ -0,0 +1,149 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2026 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/apu/time_stretcher.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "xenia/base/assert.h"
+
+namespace xe {
+namespace apu {
+
+TimeStretcher::TimeStretcher(uint32_t channels, uint32_t sample_rate)
+    : channels_(channels) {
+  assert_not_zero(channels);
+  // Parameters commonly used for music and speech - 40 ms sequences with 8 ms
+  // of cross-fading between them, looking for the best match within 15 ms.
+  sequence_frames_ = std::max(size_t(sample_rate) * 40 / 1000, size_t(8));
+  overlap_frames_ = std::max(size_t(sample_rate) * 8 / 1000, size_t(2));
+  seek_frames_ = std::max(size_t(sample_rate) * 15 / 1000, size_t(1));
+  overlap_.resize(overlap_frames_ * channels_);
+}
+
+size_t TimeStretcher::GetBufferedFrameCount() const {
+  return input_.size() / channels_ + output_.size() / channels_ -
+         output_read_frames_;
+}
+
+void TimeStretcher::Push(const float* samples, size_t frame_count) {
+  input_.insert(input_.end(), samples, samples + frame_count * channels_);
+}
+
+size_t TimeStretcher::Pull(float* samples_out, size_t frame_count,
+                           float tempo) {
+  tempo = std::min(std::max(tempo, 0.25f), 4.0f);
+  size_t frames_produced = 0;
+  while (frames_produced < frame_count) {
+    size_t output_frames_available =
+        output_.size() / channels_ - output_read_frames_;
+    if (!output_frames_available) {
+      output_.clear();
+      output_read_frames_ = 0;
+      if (!ProcessSequence(tempo)) {
+        break;
+      }
+      continue;
+    }
+    size_t frames_to_copy =
+        std::min(output_frames_available, frame_count - frames_produced);
+    std::memcpy(samples_out + frames_produced * channels_,
+                output_.data() + output_read_frames_ * channels_,
+                sizeof(float) * frames_to_copy * channels_);
+    output_read_frames_ += frames_to_copy;
+    frames_produced += frames_to_copy;
+  }
+  if (frames_produced < frame_count) {
+    std::memset(samples_out + frames_produced * channels_, 0,
+                sizeof(float) * (frame_count - frames_produced) * channels_);
+  }
+  return frames_produced;
+}
+
+void TimeStretcher::Reset() {
+  input_.clear();
+  output_.clear();
+  output_read_frames_ = 0;
+  has_overlap_ = false;
+  input_skip_remainder_ = 0.0;
+}
+
+bool TimeStretcher::ProcessSequence(float tempo) {
+  if (input_.size() / channels_ < GetMinimumInputFrameCount()) {
+    return false;
+  }
+
+  size_t offset = 0;
+  size_t output_start = output_.size();
+  size_t sequence_output_frames = sequence_frames_ - overlap_frames_;
+  output_.resize(output_start + sequence_output_frames * channels_);
+  float* output = output_.data() + output_start;
+  if (has_overlap_) {
+    offset = SeekBestOverlapOffset();
+    // Cross-fade the end of the previous sequence with the beginning of the
+    // new one.
+    const float* input = input_.data() + offset * channels_;
+    float fade_step = 1.0f / float(overlap_frames_);
+    for (size_t i = 0; i < overlap_frames_; ++i) {
+      float fade_in = float(i) * fade_step;
+      float fade_out = 1.0f - fade_in;
+      for (uint32_t j = 0; j < channels_; ++j) {
+        size_t sample = i * channels_ + j;
+        output[sample] = overlap_[sample] * fade_out + input[sample] * fade_in;
+      }
+    }
+    std::memcpy(output + overlap_frames_ * channels_,
+                input + overlap_frames_ * channels_,
+                sizeof(float) * (sequence_output_frames - overlap_frames_) *
+                    channels_);
+  } else {
+    std::memcpy(output, input_.data(),
+                sizeof(float) * sequence_output_frames * channels_);
+  }
+  // Keep the end of the sequence for cross-fading with the next one.
+  std::memcpy(overlap_.data(),
+              input_.data() + (offset + sequence_output_frames) * channels_,
+              sizeof(float) * overlap_frames_ * channels_);
+  has_overlap_ = true;
+
+  // Advance in the input according to the tempo.
+  input_skip_remainder_ += double(sequence_output_frames) * double(tempo);
+  size_t input_skip_frames = size_t(input_skip_remainder_);
+  input_skip_remainder_ -= double(input_skip_frames);
+  input_skip_frames = std::min(input_skip_frames, input_.size() / channels_);
+  input_.erase(input_.begin(),
+               input_.begin() + input_skip_frames * channels_);
+  return true;
+}
+
+size_t TimeStretcher::SeekBestOverlapOffset() const {
+  size_t overlap_samples = overlap_frames_ * channels_;
+  size_t best_offset = 0;
+  float best_correlation = -1.0f;
+  for (size_t offset = 0; offset < seek_frames_; ++offset) {
+    const float* input = input_.data() + offset * channels_;
+    float correlation = 0.0f;
+    float input_energy = 0.0f;
+    for (size_t i = 0; i < overlap_samples; ++i) {
+      correlation += overlap_[i] * input[i];
+      input_energy += input[i] * input[i];
+    }
+    correlation /= std::sqrt(input_energy + 1e-9f);
+    if (correlation > best_correlation) {
+      best_correlation = correlation;
+      best_offset = offset;
+    }
+  }
+  return best_offset;
+}
+
+}  // namespace apu
+}  // namespace xe
@@ -0,0 +1,73 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2026 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#ifndef XENIA_APU_TIME_STRETCHER_H_
+#define XENIA_APU_TIME_STRETCHER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace xe {
+namespace apu {
+
+// Changes the tempo of interleaved floating-point audio without changing its
+// pitch using waveform similarity overlap-add (WSOLA), so the audio output can
+// keep playing smoothly when the emulation is running slower or faster than
+// the audio is consumed by the host.
+class TimeStretcher {
+ public:
+  TimeStretcher(uint32_t channels, uint32_t sample_rate);
+
+  uint32_t channels() const { return channels_; }
+
+  // Number of frames (samples for all channels) that have been pushed, but
+  // not yet returned by Pull.
+  size_t GetBufferedFrameCount() const;
+  // Number of input frames required to produce any output.
+  size_t GetMinimumInputFrameCount() const {
+    return seek_frames_ + sequence_frames_;
+  }
+
+  void Push(const float* samples, size_t frame_count);
+  // Produces frame_count frames, consuming approximately frame_count * tempo
+  // frames of the input. The frames that couldn't be produced because there
+  // wasn't enough input are filled with silence. Returns the number of frames
+  // actually produced.
+  size_t Pull(float* samples_out, size_t frame_count, float tempo);
+
+  void Reset();
+
+ private:
+  // Outputs sequence_frames_ - overlap_frames_ frames into output_, returns
+  // false if not enough input.
+  bool ProcessSequence(float tempo);
+  // Returns the offset in the input at which the beginning best matches the
+  // end of the previous sequence.
+  size_t SeekBestOverlapOffset() const;
+
+  uint32_t channels_;
+  size_t sequence_frames_;
+  size_t overlap_frames_;
+  size_t seek_frames_;
+
+  std::vector<float> input_;
+  std::vector<float> output_;
+  size_t output_read_frames_ = 0;
+  // End of the previous sequence to cross-fade with the next one.
+  std::vector<float> overlap_;
+  bool has_overlap_ = false;
+  // Fractional part of the number of input frames to skip.
+  double input_skip_remainder_ = 0.0;
+};
+
+}  // namespace apu
+}  // namespace xe
+
+#endif  // XENIA_APU_TIME_STRETCHER_H_
@@ -0,0 +1,226 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2026 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/apu/xma_capture.h"
+
+#include <cstring>
+
+#include "xenia/base/assert.h"
+#include "xenia/base/clock.h"
+#include "xenia/base/filesystem.h"
+#include "xenia/base/logging.h"
+
+namespace xe {
+namespace apu {
+
+namespace {
+
+void AppendData(std::vector<uint8_t>& record, const void* data, size_t size) {
+  if (!size) {
+    return;
+  }
+  size_t offset = record.size();
+  record.resize(offset + size);
+  std::memcpy(record.data() + offset, data, size);
+}
+
+uint32_t GetOutputBufferSize(const XMA_CONTEXT_DATA& data) {
+  return data.output_buffer_ptr
+             ? data.output_buffer_block_count * uint32_t(256)
+             : uint32_t(0);
+}
+
+}  // namespace
+
+void XmaCaptureWriter::BeginWork(const Memory& memory, uint32_t context_id,
+                                 uint32_t context_guest_ptr,
+                                 std::vector<uint8_t>& record_out) {
+  record_out.clear();
+  const uint8_t* context_ptr = memory.TranslateVirtual(context_guest_ptr);
+  XMA_CONTEXT_DATA data(context_ptr);
+
+  XmaCaptureRecordHeader record_header;
+  record_header.type = XmaCaptureRecordType::kWork;
+  record_header.context_id = context_id;
+  record_header.input_buffer_0_size =
+      data.input_buffer_0_ptr
+          ? data.input_buffer_0_packet_count * XmaContext::kBytesPerPacket
+          : 0;
+  record_header.input_buffer_1_size =
+      data.input_buffer_1_ptr
+          ? data.input_buffer_1_packet_count * XmaContext::kBytesPerPacket
+          : 0;
+  record_header.output_buffer_size = GetOutputBufferSize(data);
+
+  AppendData(record_out, &record_header, sizeof(record_header));
+  AppendData(record_out, context_ptr, sizeof(XMA_CONTEXT_DATA));
+  if (record_header.input_buffer_0_size) {
+    AppendData(record_out, memory.TranslatePhysical(data.input_buffer_0_ptr),
+               record_header.input_buffer_0_size);
+  }
+  if (record_header.input_buffer_1_size) {
+    AppendData(record_out, memory.TranslatePhysical(data.input_buffer_1_ptr),
+               record_header.input_buffer_1_size);
+  }
+  if (record_header.output_buffer_size) {
+    AppendData(record_out, memory.TranslatePhysical(data.output_buffer_ptr),
+               record_header.output_buffer_size);
+  }
+}
+
+void XmaCaptureWriter::EndWork(const Memory& memory,
+                               uint32_t context_guest_ptr,
+                               std::vector<uint8_t>& record,
+                               uint32_t title_id) {
+  assert_true(record.size() >= sizeof(XmaCaptureRecordHeader));
+  XmaCaptureRecordHeader record_header;
+  std::memcpy(&record_header, record.data(), sizeof(record_header));
+
+  const uint8_t* context_ptr = memory.TranslateVirtual(context_guest_ptr);
+  AppendData(record, context_ptr, sizeof(XMA_CONTEXT_DATA));
+  // Taking the output from where it was before the processing, to keep the
+  // size of the buffer in the record consistent even if the guest has
+  // modified the context meanwhile.
+  if (record_header.output_buffer_size) {
+    XMA_CONTEXT_DATA data_before(record.data() + sizeof(record_header));
+    AppendData(record,
+               memory.TranslatePhysical(data_before.output_buffer_ptr),
+               record_header.output_buffer_size);
+  }
+
+  std::lock_guard<std::mutex> lock(file_mutex_);
+  WriteRecord(record.data(), record.size(), title_id);
+}
+
+void XmaCaptureWriter::WriteClear(uint32_t context_id, uint32_t title_id) {
+  XmaCaptureRecordHeader record_header = {};
+  record_header.type = XmaCaptureRecordType::kClear;
+  record_header.context_id = context_id;
+  std::lock_guard<std::mutex> lock(file_mutex_);
+  WriteRecord(&record_header, sizeof(record_header), title_id);
+}
+
+void XmaCaptureWriter::WriteRecord(const void* record, size_t record_size,
+                                   uint32_t title_id) {
+  if (!file_) {
+    if (file_open_failed_) {
+      return;
+    }
+    std::filesystem::path path =
+        directory_ / fmt::format("{:08X}_{}.xmacapture", title_id,
+                                 Clock::QueryHostSystemTime());
+    std::error_code error_code;
+    std::filesystem::create_directories(directory_, error_code);
+    file_ = xe::filesystem::OpenFile(path, "wb");
+    if (!file_) {
+      file_open_failed_ = true;
+      XELOGE("XMA: Failed to create the capture file {}",
+             xe::path_to_utf8(path));
+      return;
+    }
+    XmaCaptureHeader header;
+    header.magic = XmaCaptureHeader::kMagic;
+    header.version = XmaCaptureHeader::kVersion;
+    header.title_id = title_id;
+    header.is_new_decoder = is_new_decoder_ ? 1 : 0;
+    fwrite(&header, sizeof(header), 1, file_);
+    XELOGI("XMA: Capturing the decoder work to {}", xe::path_to_utf8(path));
+  }
+  fwrite(record, record_size, 1, file_);
+  ++records_written_;
+}
+
+void XmaCaptureWriter::Close() {
+  std::lock_guard<std::mutex> lock(file_mutex_);
+  if (file_) {
+    fclose(file_);
+    file_ = nullptr;
+    XELOGI("XMA: Wrote {} decoder capture records", records_written_);
+  }
+}
+
+bool XmaCaptureReader::Open(const std::filesystem::path& path) {
+  Close();
+  file_ = xe::filesystem::OpenFile(path, "rb");
+  if (!file_) {
+    XELOGE("XMA: Failed to open the capture file {}",
+           xe::path_to_utf8(path));
+    return false;
+  }
+  if (!ReadData(&header_, sizeof(header_)) ||
+      header_.magic != XmaCaptureHeader::kMagic ||
+      header_.version != XmaCaptureHeader::kVersion) {
+    XELOGE("XMA: {} is not a supported capture file",
+           xe::path_to_utf8(path));
+    Close();
+    return false;
+  }
+  return true;
+}
+
+void XmaCaptureReader::Close() {
+  if (file_) {
+    fclose(file_);
+    file_ = nullptr;
+  }
+  header_ = {};
+  is_corrupted_ = false;
+}
+
+bool XmaCaptureReader::ReadRecord(XmaCaptureRecord& record_out) {
+  if (!file_ || is_corrupted_) {
+    return false;
+  }
+  XmaCaptureRecordHeader& record_header = record_out.header;
+  size_t header_read =
+      fread(&record_header, 1, sizeof(record_header), file_);
+  if (header_read != sizeof(record_header)) {
+    // A partially written header is left if the emulator has been terminated
+    // while capturing.
+    is_corrupted_ = header_read != 0;
+    return false;
+  }
+  switch (record_header.type) {
+    case XmaCaptureRecordType::kWork:
+      if (!ReadData(record_out.context_before,
+                    sizeof(record_out.context_before)) ||
+          !ReadBuffer(record_out.input_buffer_0,
+                      record_header.input_buffer_0_size) ||
+          !ReadBuffer(record_out.input_buffer_1,
+                      record_header.input_buffer_1_size) ||
+          !ReadBuffer(record_out.output_buffer_before,
+                      record_header.output_buffer_size) ||
+          !ReadData(record_out.context_after,
+                    sizeof(record_out.context_after)) ||
+          !ReadBuffer(record_out.output_buffer_after,
+                      record_header.output_buffer_size)) {
+        is_corrupted_ = true;
+        return false;
+      }
+      return true;
+    case XmaCaptureRecordType::kClear:
+      return true;
+    default:
+      is_corrupted_ = true;
+      return false;
+  }
+}
+
+bool XmaCaptureReader::ReadData(void* data, size_t size) {
+  return !size || fread(data, size, 1, file_) == 1;
+}
+
+bool XmaCaptureReader::ReadBuffer(std::vector<uint8_t>& buffer,
+                                  uint32_t size) {
+  buffer.resize(size);
+  return ReadData(buffer.data(), size);
+}
+
+}  // namespace apu
+}  // namespace xe
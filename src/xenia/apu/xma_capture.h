@@ -0,0 +1,136 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2026 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#ifndef XENIA_APU_XMA_CAPTURE_H_
+#define XENIA_APU_XMA_CAPTURE_H_
+
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <mutex>
+#include <vector>
+
+#include "xenia/apu/xma_context.h"
+#include "xenia/memory.h"
+
+namespace xe {
+namespace apu {
+
+// Captures of the work done by the XMA decoder, containing everything needed
+// to redo the decoding outside the emulator and to compare the result with
+// what the decoder produced while the title was running.
+//
+// A capture file is the header followed by records in the order the decoder
+// processed the contexts in. All the fields are in the host byte order, the
+// context data and the buffers are stored as they are in the guest memory.
+// Records of processing a context contain the context data and the input and
+// the output buffers before the processing, and the context data and the
+// output buffer after it.
+struct XmaCaptureHeader {
+  static constexpr uint32_t kMagic = 0x43414D58;  // 'XMAC'
+  static constexpr uint32_t kVersion = 1;
+
+  uint32_t magic;
+  uint32_t version;
+  uint32_t title_id;
+  // Whether captured with XmaContextNew rather than XmaContextOld.
+  uint32_t is_new_decoder;
+};
+static_assert_size(XmaCaptureHeader, 16);
+
+enum class XmaCaptureRecordType : uint32_t {
+  // XmaContext::Work that has processed the context.
+  kWork,
+  // XmaContext::Clear, without any data.
+  kClear,
+};
+
+struct XmaCaptureRecordHeader {
+  XmaCaptureRecordType type;
+  uint32_t context_id;
+  uint32_t input_buffer_0_size;
+  uint32_t input_buffer_1_size;
+  uint32_t output_buffer_size;
+};
+static_assert_size(XmaCaptureRecordHeader, 20);
+
+struct XmaCaptureRecord {
+  XmaCaptureRecordHeader header;
+  uint8_t context_before[sizeof(XMA_CONTEXT_DATA)];
+  std::vector<uint8_t> input_buffer_0;
+  std::vector<uint8_t> input_buffer_1;
+  std::vector<uint8_t> output_buffer_before;
+  uint8_t context_after[sizeof(XMA_CONTEXT_DATA)];
+  std::vector<uint8_t> output_buffer_after;
+};
+
+class XmaCaptureWriter {
+ public:
+  // The file is created in the directory when the first record is written, so
+  // the title ID is known by that time.
+  XmaCaptureWriter(const std::filesystem::path& directory,
+                   bool is_new_decoder)
+      : directory_(directory), is_new_decoder_(is_new_decoder) {}
+  ~XmaCaptureWriter() { Close(); }
+
+  // Serializes the state of the context before XmaContext::Work into the
+  // record, to be finished by EndWork if the context has been processed.
+  static void BeginWork(const Memory& memory, uint32_t context_id,
+                        uint32_t context_guest_ptr,
+                        std::vector<uint8_t>& record_out);
+  // Adds the state of the context after XmaContext::Work to the record from
+  // BeginWork and writes it. May be called from multiple threads.
+  void EndWork(const Memory& memory, uint32_t context_guest_ptr,
+               std::vector<uint8_t>& record, uint32_t title_id);
+  // May be called from multiple threads.
+  void WriteClear(uint32_t context_id, uint32_t title_id);
+
+  void Close();
+
+ private:
+  // The mutex must be locked.
+  void WriteRecord(const void* record, size_t record_size,
+                   uint32_t title_id);
+
+  std::filesystem::path directory_;
+  bool is_new_decoder_;
+
+  std::mutex file_mutex_;
+  FILE* file_ = nullptr;
+  bool file_open_failed_ = false;
+  uint64_t records_written_ = 0;
+};
+
+class XmaCaptureReader {
+ public:
+  ~XmaCaptureReader() { Close(); }
+
+  bool Open(const std::filesystem::path& path);
+  void Close();
+
+  const XmaCaptureHeader& header() const { return header_; }
+
+  // Returns false at the end of the file, or if the record is corrupted, in
+  // which case is_corrupted() returns true.
+  bool ReadRecord(XmaCaptureRecord& record_out);
+  bool is_corrupted() const { return is_corrupted_; }
+
+ private:
+  bool ReadData(void* data, size_t size);
+  bool ReadBuffer(std::vector<uint8_t>& buffer, uint32_t size);
+
+  FILE* file_ = nullptr;
+  XmaCaptureHeader header_ = {};
+  bool is_corrupted_ = false;
+};
+
+}  // namespace apu
+}  // namespace xe
+
+#endif  // XENIA_APU_XMA_CAPTURE_H_
@@ -176,7 +176,7 @@ class XmaContext {
   // static const uint32_t kOutputMaxSizeBytes = 31 * kOutputBytesPerBlock;
 
   explicit XmaContext();
-  ~XmaContext();
+  virtual ~XmaContext();
 
   virtual int Setup(uint32_t id, Memory* memory, uint32_t guest_ptr) {
     return 0;
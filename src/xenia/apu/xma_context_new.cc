@@ -11,6 +11,7 @@
 #include "xenia/apu/xma_helpers.h"
 
 #include <algorithm>
+#include <cstring>
 
 #include "xenia/base/logging.h"
 #include "xenia/base/platform.h"
@@ -33,7 +34,8 @@ extern "C" {
 namespace xe {
 namespace apu {
 
-XmaContextNew::XmaContextNew() = default;
+XmaContextNew::XmaContextNew(XmaDecodedFrameCache& decoded_frame_cache)
+    : decoded_frame_cache_(decoded_frame_cache) {}
 
 XmaContextNew::~XmaContextNew() {
   if (av_context_) {
@@ -393,7 +395,14 @@ void XmaContextNew::Decode(XMA_CONTEXT_DATA* data) {
                      (kBitsPerPacket - kBitsPerPacketHeader) * 2);
   stream.SetOffset(relative_offset - kBitsPerPacketHeader);
 
-  xma_frame_.fill(0);
+  // The bit copying preserves the bits outside the frame in the partially
+  // covered bytes, and FFmpeg requires zero padding after the packet, but
+  // anything further is never read - not clearing the whole 4 KB buffer for
+  // every frame.
+  std::memset(xma_frame_.data(), 0,
+              std::min(xma_frame_.size(),
+                       size_t(3 + (packet_info.current_frame_size_ >> 3) +
+                              AV_INPUT_BUFFER_PADDING_SIZE)));
 
   XELOGAPU(
       "XmaContext {}: Reading Frame {}/{} (size: {}) From Packet "
@@ -405,15 +414,10 @@ void XmaContextNew::Decode(XMA_CONTEXT_DATA* data) {
   const uint32_t padding_start = static_cast<uint8_t>(
       stream.Copy(xma_frame_.data() + 1, packet_info.current_frame_size_));
 
-  raw_frame_.fill(0);
-
-  PrepareDecoder(data->sample_rate, bool(data->is_stereo));
+  bool decoder_reopened =
+      PrepareDecoder(data->sample_rate, bool(data->is_stereo)) > 0;
   PreparePacket(packet_info.current_frame_size_, padding_start);
-  if (DecodePacket(av_context_, av_packet_, av_frame_)) {
-    // dump_raw(av_frame_, id());
-    ConvertFrame(reinterpret_cast<const uint8_t**>(&av_frame_->data),
-                 bool(data->is_stereo), raw_frame_.data());
-  }
+  DecodeFrameToRaw(bool(data->is_stereo), decoder_reopened);
 
   // TODO: Write function to regenerate decoder
   // TODO: Be aware of subframe_skips & loops subframes skips
@@ -674,6 +678,77 @@ void XmaContextNew::PreparePacket(const uint32_t frame_size,
   xma_frame_[0] = ((frame_padding & 7) << 5) | ((padding_end & 7) << 2);
 }
 
+void XmaContextNew::DecodeFrameToRaw(bool is_two_channel,
+                                     bool decoder_reopened) {
+  if (decoder_reopened) {
+    // Starting from the clean state.
+    has_previous_frame_ = false;
+    av_context_has_previous_frame_ = true;
+  }
+
+  size_t raw_frame_size = kBytesPerFrameChannel << uint32_t(is_two_channel);
+  bool use_cache = XmaDecodedFrameCache::IsEnabled();
+  XmaDecodedFrameCache::Key cache_key;
+  if (use_cache) {
+    cache_key.previous_frame_hash =
+        has_previous_frame_ ? previous_frame_hash_ : 0;
+    cache_key.frame_hash =
+        XmaDecodedFrameCache::HashFrame(av_packet_->data, av_packet_->size);
+    cache_key.frame_size_bytes = uint32_t(av_packet_->size);
+    cache_key.sample_rate = uint32_t(av_context_->sample_rate);
+    cache_key.is_two_channel = uint32_t(is_two_channel);
+  }
+
+  if (!use_cache || !decoded_frame_cache_.Find(cache_key, raw_frame_.data(),
+                                               raw_frame_size)) {
+    if (!av_context_has_previous_frame_ && has_previous_frame_) {
+      // The previous frame was taken from the cache, but its decoding affects
+      // the output of the current frame - decode it again, discarding the
+      // output.
+      const int current_size = av_packet_->size;
+      av_packet_->data = previous_xma_frame_.data();
+      av_packet_->size = previous_xma_frame_size_;
+      DecodePacket(av_context_, av_packet_, av_frame_);
+      av_packet_->data = xma_frame_.data();
+      av_packet_->size = current_size;
+    }
+    av_context_has_previous_frame_ = true;
+    // ConvertFrame overwrites all the samples that are consumed, so silence
+    // only needs to be written if there's nothing to convert.
+    if (DecodePacket(av_context_, av_packet_, av_frame_)) {
+      // dump_raw(av_frame_, id());
+      ConvertFrame(reinterpret_cast<const uint8_t**>(&av_frame_->data),
+                   is_two_channel, raw_frame_.data());
+      if (is_two_channel && !av_frame_->data[1]) {
+        // Only the first channel has been converted.
+        std::memset(raw_frame_.data() + kBytesPerFrameChannel, 0,
+                    kBytesPerFrameChannel);
+      }
+      if (use_cache) {
+        decoded_frame_cache_.Store(cache_key, raw_frame_.data(),
+                                   raw_frame_size);
+      }
+    } else {
+      raw_frame_.fill(0);
+    }
+  } else {
+    av_context_has_previous_frame_ = false;
+  }
+
+  if (use_cache) {
+    has_previous_frame_ = true;
+    previous_frame_hash_ = cache_key.frame_hash;
+    // Including the zero padding required by FFmpeg.
+    previous_xma_frame_size_ = av_packet_->size;
+    std::memcpy(previous_xma_frame_.data(), xma_frame_.data(),
+                std::min(previous_xma_frame_.size(),
+                         size_t(av_packet_->size) +
+                             AV_INPUT_BUFFER_PADDING_SIZE));
+  } else {
+    has_previous_frame_ = false;
+  }
+}
+
 bool XmaContextNew::DecodePacket(AVCodecContext* av_context,
                                  const AVPacket* av_packet, AVFrame* av_frame) {
   auto ret = avcodec_send_packet(av_context, av_packet);
@@ -16,6 +16,7 @@
 #include <queue>
 
 #include "xenia/apu/xma_context.h"
+#include "xenia/apu/xma_decoded_frame_cache.h"
 #include "xenia/base/bit_stream.h"
 #include "xenia/base/ring_buffer.h"
 #include "xenia/memory.h"
@@ -68,7 +69,7 @@ class XmaContextNew : public XmaContext {
   static const uint32_t kLastFrameMarker = 0x7FFF;
   static const uint32_t kMaxFrameSizeinBits = 0x4000 - kBitsPerPacketHeader;
 
-  explicit XmaContextNew();
+  explicit XmaContextNew(XmaDecodedFrameCache& decoded_frame_cache);
   ~XmaContextNew();
 
   int Setup(uint32_t id, Memory* memory, uint32_t guest_ptr);
@@ -116,6 +117,9 @@ class XmaContextNew : public XmaContext {
 
   bool DecodePacket(AVCodecContext* av_context, const AVPacket* av_packet,
                     AVFrame* av_frame);
+  // Decodes the frame in av_packet_ to raw_frame_, taking it from the decoded
+  // frame cache if possible.
+  void DecodeFrameToRaw(bool is_two_channel, bool decoder_reopened);
 
   // This method should be used ONLY when we're at the last packet of the stream
   // and we want to find offset in next buffer
@@ -126,6 +130,17 @@ class XmaContextNew : public XmaContext {
   std::array<uint8_t, 1 + 4096> xma_frame_;
   std::array<uint8_t, kBytesPerFrameChannel * 2> raw_frame_;
 
+  XmaDecodedFrameCache& decoded_frame_cache_;
+  // The last frame decoded by this context (whether by FFmpeg or taken from
+  // the cache), which the output of the next frame depends on.
+  bool has_previous_frame_ = false;
+  uint64_t previous_frame_hash_ = 0;
+  std::array<uint8_t, 1 + 4096> previous_xma_frame_;
+  int previous_xma_frame_size_ = 0;
+  // Whether FFmpeg has decoded the last frame itself, rather than the frame
+  // having been taken from the cache, so the state of FFmpeg is up to date.
+  bool av_context_has_previous_frame_ = true;
+
   int32_t remaining_subframe_blocks_in_output_buffer_ = 0;
   uint8_t current_frame_remaining_subframes_ = 0;
 };
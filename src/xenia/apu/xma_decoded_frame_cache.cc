@@ -0,0 +1,92 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2026 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/apu/xma_decoded_frame_cache.h"
+
+#include <cstring>
+
+#include "xenia/base/cvar.h"
+#include "xenia/base/metrics.h"
+
+DEFINE_uint32(apu_xma_decoded_frame_cache_mb, 0,
+              "Maximum size in megabytes of the cache of decoded XMA frames, "
+              "reused when the same audio is played again, such as looping "
+              "music and ambience, instead of decoding it again. 0 to disable "
+              "the cache. Only used by the new XMA decoder.",
+              "APU");
+
+namespace xe {
+namespace apu {
+
+namespace {
+metrics::Counter decoded_frame_cache_hits_(
+    "APU", "xma_decoded_frame_cache_hits", "XMA decoded frame cache hits");
+metrics::Counter decoded_frame_cache_misses_(
+    "APU", "xma_decoded_frame_cache_misses", "XMA decoded frame cache misses");
+metrics::Counter decoded_frame_cache_evictions_(
+    "APU", "xma_decoded_frame_cache_evictions",
+    "XMA decoded frames evicted from the cache");
+}  // namespace
+
+bool XmaDecodedFrameCache::IsEnabled() {
+  return cvars::apu_xma_decoded_frame_cache_mb != 0;
+}
+
+bool XmaDecodedFrameCache::Find(const Key& key, void* pcm_out,
+                                size_t pcm_size_bytes) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = entries_.find(key);
+  if (it == entries_.end() || it->second.pcm.size() != pcm_size_bytes) {
+    decoded_frame_cache_misses_.Increment();
+    return false;
+  }
+  decoded_frame_cache_hits_.Increment();
+  std::memcpy(pcm_out, it->second.pcm.data(), pcm_size_bytes);
+  lru_.splice(lru_.end(), lru_, it->second.lru_iterator);
+  return true;
+}
+
+void XmaDecodedFrameCache::Store(const Key& key, const void* pcm,
+                                 size_t pcm_size_bytes) {
+  size_t max_size_bytes = size_t(cvars::apu_xma_decoded_frame_cache_mb) << 20;
+  if (pcm_size_bytes > max_size_bytes) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto emplace_result = entries_.try_emplace(key);
+  Entry& entry = emplace_result.first->second;
+  if (emplace_result.second) {
+    entry.lru_iterator = lru_.insert(lru_.end(), key);
+  } else {
+    total_pcm_size_bytes_ -= entry.pcm.size();
+    lru_.splice(lru_.end(), lru_, entry.lru_iterator);
+  }
+  entry.pcm.assign(reinterpret_cast<const uint8_t*>(pcm),
+                   reinterpret_cast<const uint8_t*>(pcm) + pcm_size_bytes);
+  total_pcm_size_bytes_ += pcm_size_bytes;
+  // Evict the least recently used frames, never the one just stored as it's
+  // at the back.
+  while (total_pcm_size_bytes_ > max_size_bytes) {
+    auto evicted_it = entries_.find(lru_.front());
+    total_pcm_size_bytes_ -= evicted_it->second.pcm.size();
+    entries_.erase(evicted_it);
+    lru_.pop_front();
+    decoded_frame_cache_evictions_.Increment();
+  }
+}
+
+void XmaDecodedFrameCache::Clear() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  entries_.clear();
+  lru_.clear();
+  total_pcm_size_bytes_ = 0;
+}
+
+}  // namespace apu
+}  // namespace xe
@@ -0,0 +1,85 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2026 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#ifndef XENIA_APU_XMA_DECODED_FRAME_CACHE_H_
+#define XENIA_APU_XMA_DECODED_FRAME_CACHE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "xenia/base/xxhash.h"
+
+namespace xe {
+namespace apu {
+
+// Converted PCM of XMA frames that have already been decoded, shared between
+// all the contexts, so looping music and ambience don't need to go through
+// FFmpeg again on every iteration of the loop. The output of the decoder
+// depends not only on the frame, but also on the previous frame because of
+// the overlap of the transform windows, so both are a part of the key.
+class XmaDecodedFrameCache {
+ public:
+  struct Key {
+    uint64_t previous_frame_hash;
+    uint64_t frame_hash;
+    uint32_t frame_size_bytes;
+    uint32_t sample_rate : 31;
+    uint32_t is_two_channel : 1;
+
+    struct Hasher {
+      size_t operator()(const Key& key) const {
+        return size_t(key.previous_frame_hash ^ (key.frame_hash * 31) ^
+                      (uint64_t(key.frame_size_bytes) << 32) ^
+                      key.sample_rate);
+      }
+    };
+    bool operator==(const Key& other) const {
+      return previous_frame_hash == other.previous_frame_hash &&
+             frame_hash == other.frame_hash &&
+             frame_size_bytes == other.frame_size_bytes &&
+             sample_rate == other.sample_rate &&
+             is_two_channel == other.is_two_channel;
+    }
+  };
+
+  static uint64_t HashFrame(const void* frame, size_t size_bytes) {
+    return XXH3_64bits(frame, size_bytes);
+  }
+
+  // Whether frames should be looked up and stored at all, according to the
+  // configuration.
+  static bool IsEnabled();
+
+  // Copies the PCM cached for the key to pcm_out if it exists.
+  bool Find(const Key& key, void* pcm_out, size_t pcm_size_bytes);
+  void Store(const Key& key, const void* pcm, size_t pcm_size_bytes);
+  void Clear();
+
+ private:
+  struct Entry {
+    std::vector<uint8_t> pcm;
+    // Position in lru_.
+    std::list<Key>::iterator lru_iterator;
+  };
+
+  std::mutex mutex_;
+  std::unordered_map<Key, Entry, Key::Hasher> entries_;
+  // Least recently used keys are at the front.
+  std::list<Key> lru_;
+  size_t total_pcm_size_bytes_ = 0;
+};
+
+}  // namespace apu
+}  // namespace xe
+
+#endif  // XENIA_APU_XMA_DECODED_FRAME_CACHE_H_
@@ -9,11 +9,17 @@
 
 #include "xenia/apu/xma_decoder.h"
 
+#include <algorithm>
+#include <string>
+
+#include "xenia/apu/xma_capture.h"
 #include "xenia/apu/xma_context.h"
 #include "xenia/apu/xma_context_new.h"
 #include "xenia/apu/xma_context_old.h"
 
+#include "xenia/base/clock.h"
 #include "xenia/base/cvar.h"
+#include "xenia/base/frame_timeline.h"
 #include "xenia/base/logging.h"
 #include "xenia/base/math.h"
 #include "xenia/base/profiling.h"
@@ -62,6 +68,22 @@ DEFINE_bool(use_dedicated_xma_thread, true,
             "better results, but decrease performance a bit.",
             "APU");
 
+DEFINE_uint32(apu_xma_decoder_threads, 1,
+              "Number of threads decoding XMA contexts in parallel when "
+              "use_dedicated_xma_thread is enabled. Each context is still "
+              "decoded by only one thread at a time, so its output stays in "
+              "order. Values above 1 may help titles playing many XMA streams "
+              "simultaneously. Clamped to the number of logical processors.",
+              "APU");
+
+DEFINE_path(apu_xma_capture_path, "",
+            "Directory to write a capture of the XMA decoder work to, with "
+            "the context data and the input and the output buffers every time "
+            "a context is processed, for replaying with xenia-apu-xma-replay. "
+            "The files grow quickly, so this should only be used for "
+            "debugging and benchmarking the decoders.",
+            "APU");
+
 namespace xe {
 namespace apu {
 
@@ -117,9 +139,16 @@ void av_log_callback(void* avcl, int level, const char* fmt, va_list va) {
 }
 
 X_STATUS XmaDecoder::Setup(kernel::KernelState* kernel_state) {
+  kernel_state_ = kernel_state;
+
   // Setup ffmpeg logging callback
   av_log_set_callback(av_log_callback);
 
+  if (!cvars::apu_xma_capture_path.empty()) {
+    capture_writer_ = std::make_unique<XmaCaptureWriter>(
+        cvars::apu_xma_capture_path, cvars::use_new_decoder);
+  }
+
   // Let the processor know we want register access callbacks.
   memory_->AddVirtualMappedRange(
       0x7FEA0000, 0xFFFF0000, 0x0000FFFF, this,
@@ -140,7 +169,7 @@ X_STATUS XmaDecoder::Setup(kernel::KernelState* kernel_state) {
   // Setup XMA contexts.
   for (int i = 0; i < kContextCount; ++i) {
     if (cvars::use_new_decoder) {
-      contexts_[i] = new XmaContextNew();
+      contexts_[i] = new XmaContextNew(decoded_frame_cache_);
     } else {
       contexts_[i] = new XmaContextOld();
     }
@@ -170,6 +199,43 @@ X_STATUS XmaDecoder::Setup(kernel::KernelState* kernel_state) {
                                      // actually. never calls any guest code
   worker_thread_->set_name("XMA Decoder");
   worker_thread_->set_can_debugger_suspend(true);
+
+  // Additional threads taking contexts to decode from the same pass as the
+  // main worker thread.
+  uint32_t helper_thread_count = 0;
+  if (cvars::use_dedicated_xma_thread) {
+    helper_thread_count =
+        std::min(std::max(cvars::apu_xma_decoder_threads, uint32_t(1)),
+                 std::max(xe::threading::logical_processor_count(),
+                          uint32_t(1))) -
+        1;
+  }
+  if (helper_thread_count) {
+    helpers_running_ = true;
+    helper_pass_done_event_ =
+        xe::threading::Event::CreateAutoResetEvent(false);
+    assert_not_null(helper_pass_done_event_);
+    helper_work_events_.reserve(helper_thread_count);
+    helper_threads_.reserve(helper_thread_count);
+    for (uint32_t i = 0; i < helper_thread_count; ++i) {
+      helper_work_events_.push_back(
+          xe::threading::Event::CreateAutoResetEvent(false));
+      assert_not_null(helper_work_events_.back());
+      auto helper_thread =
+          kernel::object_ref<kernel::XHostThread>(new kernel::XHostThread(
+              kernel_state, 128 * 1024, 0,
+              [this, i]() {
+                HelperThreadMain(i);
+                return 0;
+              },
+              kernel_state->GetIdleProcess()));
+      helper_thread->set_name(fmt::format("XMA Decoder {}", i + 1));
+      helper_thread->set_can_debugger_suspend(true);
+      helper_thread->Create();
+      helper_threads_.push_back(std::move(helper_thread));
+    }
+  }
+
   worker_thread_->Create();
 
   return X_STATUS_SUCCESS;
@@ -179,14 +245,46 @@ void XmaDecoder::WorkerThreadMain() {
   uint32_t idle_loop_count = 0;
   while (worker_running_) {
     // Okay, let's loop through XMA contexts to find ones we need to decode!
+    // Only visiting the contexts kicked since the last pass, as the contexts
+    // are disabled when they're processed, and are enabled only by kicking.
+    uint32_t pass_context_count = 0;
+    for (uint32_t i = 0; i < kReadyContextBlockCount; ++i) {
+      uint64_t ready_context_bits =
+          ready_contexts_[i].exchange(0, std::memory_order_acquire);
+      uint32_t ready_context_bit;
+      while (xe::bit_scan_forward(ready_context_bits, &ready_context_bit)) {
+        ready_context_bits &= ~(uint64_t(1) << ready_context_bit);
+        pass_contexts_[pass_context_count++] = i * 64 + ready_context_bit;
+      }
+    }
+    pass_context_count_ = pass_context_count;
     bool did_work = false;
-    for (uint32_t n = 0; n < kContextCount; n++) {
-      did_work = contexts_[n]->Work() || did_work;
-
-      // TODO: Need thread safety to do this.
-      // Probably not too important though.
-      // registers_.current_context = n;
-      // registers_.next_context = (n + 1) % kContextCount;
+    if (helper_threads_.empty() || pass_context_count <= 1) {
+      for (uint32_t i = 0; i < pass_context_count; i++) {
+        did_work = WorkContext(*contexts_[pass_contexts_[i]]) || did_work;
+
+        // TODO: Need thread safety to do this.
+        // Probably not too important though.
+        // registers_.current_context = n;
+        // registers_.next_context = (n + 1) % kContextCount;
+      }
+    } else {
+      // Let the helper threads take contexts from the same pass too. This
+      // thread is waiting for all of them to finish before the next pass, so
+      // none of the contexts is decoded by multiple threads at once.
+      pass_next_context_.store(0, std::memory_order_relaxed);
+      pass_helper_did_work_.store(false, std::memory_order_relaxed);
+      pass_helpers_remaining_.store(uint32_t(helper_threads_.size()),
+                                    std::memory_order_release);
+      for (const std::unique_ptr<xe::threading::Event>& helper_work_event :
+           helper_work_events_) {
+        helper_work_event->Set();
+      }
+      did_work = WorkPassContexts();
+      xe::threading::Wait(helper_pass_done_event_.get(), false);
+      if (pass_helper_did_work_.load(std::memory_order_acquire)) {
+        did_work = true;
+      }
     }
 
     if (paused_) {
@@ -203,6 +301,76 @@ void XmaDecoder::WorkerThreadMain() {
   }
 }
 
+void XmaDecoder::HelperThreadMain(size_t helper_index) {
+  xe::threading::Event& work_event = *helper_work_events_[helper_index];
+  while (true) {
+    xe::threading::Wait(&work_event, false);
+    if (!helpers_running_) {
+      break;
+    }
+    if (WorkPassContexts()) {
+      pass_helper_did_work_.store(true, std::memory_order_release);
+    }
+    if (pass_helpers_remaining_.fetch_sub(1, std::memory_order_acq_rel) ==
+        1) {
+      helper_pass_done_event_->Set();
+    }
+  }
+}
+
+bool XmaDecoder::WorkPassContexts() {
+  bool did_work = false;
+  while (true) {
+    uint32_t pass_context_index =
+        pass_next_context_.fetch_add(1, std::memory_order_relaxed);
+    if (pass_context_index >= pass_context_count_) {
+      break;
+    }
+    did_work = WorkContext(*contexts_[pass_contexts_[pass_context_index]]) ||
+               did_work;
+  }
+  return did_work;
+}
+
+bool XmaDecoder::WorkContext(XmaContext& context) {
+  // Not including the capture in the decoding time.
+  bool capture = capture_writer_ && context.is_enabled();
+  std::vector<uint8_t> capture_record;
+  if (capture) {
+    XmaCaptureWriter::BeginWork(*memory(), context.id(), context.guest_ptr(),
+                                capture_record);
+  }
+  uint64_t work_start_ticks = Clock::QueryHostTickCount();
+  if (!context.Work()) {
+    return false;
+  }
+  uint64_t work_end_ticks = Clock::QueryHostTickCount();
+  frame_timeline::AddActivityTime(frame_timeline::Activity::kXmaDecode,
+                                  work_end_ticks - work_start_ticks);
+  if (capture) {
+    capture_writer_->EndWork(*memory(), context.guest_ptr(), capture_record,
+                             kernel_state_->title_id());
+  }
+  uint64_t work_microseconds =
+      (work_end_ticks - work_start_ticks) * 1000000 /
+      Clock::QueryHostTickFrequency();
+  uint32_t bucket = 0;
+  if (work_microseconds) {
+    bucket = std::min(uint32_t(xe::log2_floor(work_microseconds)) + 1,
+                      kDecodeLatencyHistogramBucketCount - 1);
+  }
+  decode_latency_histogram_[bucket].fetch_add(1, std::memory_order_relaxed);
+  return true;
+}
+
+void XmaDecoder::GetDecodeLatencyHistogram(
+    uint64_t buckets_out[kDecodeLatencyHistogramBucketCount]) const {
+  for (uint32_t i = 0; i < kDecodeLatencyHistogramBucketCount; ++i) {
+    buckets_out[i] =
+        decode_latency_histogram_[i].load(std::memory_order_relaxed);
+  }
+}
+
 void XmaDecoder::Shutdown() {
   worker_running_ = false;
 
@@ -220,12 +388,59 @@ void XmaDecoder::Shutdown() {
     worker_thread_.reset();
   }
 
+  // The main worker thread is not starting passes anymore, so the helper
+  // threads can be stopped.
+  if (!helper_threads_.empty()) {
+    helpers_running_ = false;
+    for (const std::unique_ptr<xe::threading::Event>& helper_work_event :
+         helper_work_events_) {
+      helper_work_event->Set();
+    }
+    for (const kernel::object_ref<kernel::XHostThread>& helper_thread :
+         helper_threads_) {
+      xe::threading::Wait(helper_thread->thread(), false);
+    }
+    helper_threads_.clear();
+  }
+  helper_work_events_.clear();
+  helper_pass_done_event_.reset();
+
+  {
+    uint64_t decode_latency_histogram[kDecodeLatencyHistogramBucketCount];
+    GetDecodeLatencyHistogram(decode_latency_histogram);
+    std::string decode_latency_histogram_string;
+    for (uint32_t i = 0; i < kDecodeLatencyHistogramBucketCount; ++i) {
+      if (!decode_latency_histogram[i]) {
+        continue;
+      }
+      if (!decode_latency_histogram_string.empty()) {
+        decode_latency_histogram_string += ", ";
+      }
+      if (i + 1 < kDecodeLatencyHistogramBucketCount) {
+        decode_latency_histogram_string += fmt::format(
+            "<{} us: {}", uint64_t(1) << i, decode_latency_histogram[i]);
+      } else {
+        decode_latency_histogram_string +=
+            fmt::format(">={} us: {}", uint64_t(1) << (i - 1),
+                        decode_latency_histogram[i]);
+      }
+    }
+    if (!decode_latency_histogram_string.empty()) {
+      XELOGAPU("XMA: Context decoding time histogram: {}",
+               decode_latency_histogram_string);
+    }
+  }
+
   if (context_data_first_ptr_) {
     memory()->SystemHeapFree(context_data_first_ptr_);
   }
 
   context_data_first_ptr_ = 0;
   context_data_last_ptr_ = 0;
+
+  decoded_frame_cache_.Clear();
+
+  capture_writer_.reset();
 }
 
 int XmaDecoder::GetContextId(uint32_t guest_ptr) {
@@ -328,8 +543,11 @@ void XmaDecoder::WriteRegister(uint32_t addr, uint32_t value) {
         uint32_t context_id = base_context_id + i;
         auto& context = *contexts_[context_id];
         context.Enable();
-        if (!cvars::use_dedicated_xma_thread) {
-          context.Work();
+        if (cvars::use_dedicated_xma_thread) {
+          ready_contexts_[context_id >> 6].fetch_or(
+              uint64_t(1) << (context_id & 63), std::memory_order_release);
+        } else {
+          WorkContext(context);
         }
       }
     }
@@ -359,6 +577,9 @@ void XmaDecoder::WriteRegister(uint32_t addr, uint32_t value) {
         uint32_t context_id = base_context_id + i;
         XmaContext& context = *contexts_[context_id];
         context.Clear();
+        if (capture_writer_) {
+          capture_writer_->WriteClear(context_id, kernel_state_->title_id());
+        }
       }
     }
   } else {
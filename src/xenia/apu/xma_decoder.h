@@ -11,10 +11,15 @@
 #define XENIA_APU_XMA_DECODER_H_
 
 #include <atomic>
+#include <cstdint>
+#include <memory>
 #include <mutex>
 #include <queue>
+#include <vector>
 
+#include "xenia/apu/xma_capture.h"
 #include "xenia/apu/xma_context.h"
+#include "xenia/apu/xma_decoded_frame_cache.h"
 #include "xenia/apu/xma_register_file.h"
 #include "xenia/base/bit_map.h"
 #include "xenia/kernel/xthread.h"
@@ -51,11 +56,25 @@ class XmaDecoder {
   void Pause();
   void Resume();
 
+  // Durations of the decoding done for a context each time it was processed.
+  // Bucket 0 counts the ones shorter than 1 microsecond, bucket i counts the
+  // ones shorter than 2^i microseconds, but not shorter than 2^(i-1), and the
+  // last bucket also includes all the longer ones.
+  static constexpr uint32_t kDecodeLatencyHistogramBucketCount = 16;
+  void GetDecodeLatencyHistogram(
+      uint64_t buckets_out[kDecodeLatencyHistogramBucketCount]) const;
+
  protected:
   int GetContextId(uint32_t guest_ptr);
 
  private:
   void WorkerThreadMain();
+  void HelperThreadMain(size_t helper_index);
+  // Decodes the contexts taken from pass_next_context_ until all of them in
+  // the current pass have been taken by this or other threads.
+  bool WorkPassContexts();
+  // Decodes the context if it's enabled, updating the statistics.
+  bool WorkContext(XmaContext& context);
 
   static uint32_t MMIOReadRegisterThunk(void* ppc_context, XmaDecoder* as,
                                         uint32_t addr) {
@@ -69,6 +88,7 @@ class XmaDecoder {
  protected:
   Memory* memory_ = nullptr;
   cpu::Processor* processor_ = nullptr;
+  kernel::KernelState* kernel_state_ = nullptr;
 
   std::atomic<bool> worker_running_ = {false};
   kernel::object_ref<kernel::XHostThread> worker_thread_;
@@ -80,12 +100,39 @@ class XmaDecoder {
 
   XmaRegisterFile register_file_;
 
+  // Shared by the contexts, must outlive them.
+  XmaDecodedFrameCache decoded_frame_cache_;
+
   static const uint32_t kContextCount = 320;
   XmaContext* contexts_[kContextCount];
+  // Bits of the contexts kicked since they were last taken by the worker
+  // thread, so only they need to be visited in a pass.
+  static constexpr uint32_t kReadyContextBlockCount = (kContextCount + 63) / 64;
+  std::atomic<uint64_t> ready_contexts_[kReadyContextBlockCount] = {};
   BitMap context_bitmap_;
 
   uint32_t context_data_first_ptr_ = 0;
   uint32_t context_data_last_ptr_ = 0;
+
+  // Threads decoding contexts in parallel with the worker thread, in passes
+  // started by the worker thread.
+  std::atomic<bool> helpers_running_ = {false};
+  std::vector<kernel::object_ref<kernel::XHostThread>> helper_threads_;
+  std::vector<std::unique_ptr<xe::threading::Event>> helper_work_events_;
+  std::unique_ptr<xe::threading::Event> helper_pass_done_event_;
+  // Indices of the contexts to process in the current pass, and the index in
+  // pass_contexts_ of the next one to take.
+  uint32_t pass_contexts_[kContextCount];
+  uint32_t pass_context_count_ = 0;
+  std::atomic<uint32_t> pass_next_context_ = {0};
+  std::atomic<uint32_t> pass_helpers_remaining_ = {0};
+  std::atomic<bool> pass_helper_did_work_ = {false};
+
+  std::atomic<uint64_t>
+      decode_latency_histogram_[kDecodeLatencyHistogramBucketCount] = {};
+
+  // Created if capturing the work of the decoder is enabled.
+  std::unique_ptr<XmaCaptureWriter> capture_writer_;
 };
 
 }  // namespace apu
@@ -0,0 +1,357 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2026 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "xenia/apu/xma_capture.h"
+#include "xenia/apu/xma_context.h"
+#include "xenia/apu/xma_context_new.h"
+#include "xenia/apu/xma_context_old.h"
+#include "xenia/apu/xma_decoded_frame_cache.h"
+#include "xenia/base/clock.h"
+#include "xenia/base/console_app_main.h"
+#include "xenia/base/cvar.h"
+#include "xenia/base/filesystem.h"
+#include "xenia/base/logging.h"
+#include "xenia/memory.h"
+
+DEFINE_transient_path(xma_capture, "",
+                      "XMA decoder capture file written with "
+                      "apu_xma_capture_path to replay.",
+                      "APU");
+DEFINE_uint32(xma_replay_max_reported_mismatches, 16,
+              "Maximum number of records with output different from the "
+              "captured one to log the details of.",
+              "APU");
+
+DECLARE_bool(use_new_decoder);
+
+namespace xe {
+namespace apu {
+
+class XmaReplayer {
+ public:
+  explicit XmaReplayer(Memory& memory) : memory_(memory) {}
+  ~XmaReplayer();
+
+  // Returns false in case of a fatal error.
+  bool Replay(const XmaCaptureRecord& record, uint64_t record_index);
+  void LogStatistics() const;
+
+ private:
+  struct Context {
+    std::unique_ptr<XmaContext> context;
+    uint32_t guest_ptr = 0;
+
+    uint64_t work_count = 0;
+    uint64_t work_ticks = 0;
+    uint64_t output_blocks = 0;
+    uint64_t frames = 0;
+    uint64_t context_mismatches = 0;
+    uint64_t output_mismatches = 0;
+  };
+
+  struct StagingBuffer {
+    uint32_t guest_ptr = 0;
+    uint32_t size = 0;
+    uint32_t physical_ptr = 0;
+  };
+
+  Context* GetContext(uint32_t context_id);
+  // Copies the data to a physical memory buffer, returning its physical
+  // address.
+  uint32_t Stage(StagingBuffer& buffer, const std::vector<uint8_t>& data);
+  // Replaces the addresses of the staging buffers in the context data with
+  // the original ones from the capture.
+  void RestoreAddresses(XMA_CONTEXT_DATA& data,
+                        const XMA_CONTEXT_DATA& captured_data) const;
+
+  Memory& memory_;
+  XmaDecodedFrameCache decoded_frame_cache_;
+  std::vector<std::unique_ptr<Context>> contexts_;
+
+  StagingBuffer input_buffer_0_;
+  StagingBuffer input_buffer_1_;
+  StagingBuffer output_buffer_;
+
+  uint64_t reported_mismatches_ = 0;
+};
+
+XmaReplayer::~XmaReplayer() {
+  for (StagingBuffer* buffer :
+       {&input_buffer_0_, &input_buffer_1_, &output_buffer_}) {
+    if (buffer->guest_ptr) {
+      memory_.SystemHeapFree(buffer->guest_ptr);
+    }
+  }
+  for (const std::unique_ptr<Context>& context : contexts_) {
+    if (context) {
+      context->context.reset();
+      memory_.SystemHeapFree(context->guest_ptr);
+    }
+  }
+}
+
+XmaReplayer::Context* XmaReplayer::GetContext(uint32_t context_id) {
+  if (context_id >= contexts_.size()) {
+    contexts_.resize(context_id + 1);
+  }
+  std::unique_ptr<Context>& context = contexts_[context_id];
+  if (context) {
+    return context.get();
+  }
+  auto new_context = std::make_unique<Context>();
+  new_context->guest_ptr = memory_.SystemHeapAlloc(
+      sizeof(XMA_CONTEXT_DATA), 256, kSystemHeapPhysical);
+  if (!new_context->guest_ptr) {
+    XELOGE("Failed to allocate the data of XMA context {}", context_id);
+    return nullptr;
+  }
+  std::memset(memory_.TranslateVirtual(new_context->guest_ptr), 0,
+              sizeof(XMA_CONTEXT_DATA));
+  if (cvars::use_new_decoder) {
+    new_context->context =
+        std::make_unique<XmaContextNew>(decoded_frame_cache_);
+  } else {
+    new_context->context = std::make_unique<XmaContextOld>();
+  }
+  if (new_context->context->Setup(context_id, &memory_,
+                                  new_context->guest_ptr)) {
+    XELOGE("Failed to set up XMA context {}", context_id);
+    new_context->context.reset();
+    memory_.SystemHeapFree(new_context->guest_ptr);
+    return nullptr;
+  }
+  new_context->context->set_is_allocated(true);
+  context = std::move(new_context);
+  return context.get();
+}
+
+uint32_t XmaReplayer::Stage(StagingBuffer& buffer,
+                            const std::vector<uint8_t>& data) {
+  if (data.empty()) {
+    return 0;
+  }
+  if (buffer.size < data.size()) {
+    if (buffer.guest_ptr) {
+      memory_.SystemHeapFree(buffer.guest_ptr);
+    }
+    buffer.size = uint32_t(data.size());
+    buffer.guest_ptr =
+        memory_.SystemHeapAlloc(buffer.size, 256, kSystemHeapPhysical);
+    if (!buffer.guest_ptr) {
+      buffer.size = 0;
+      buffer.physical_ptr = 0;
+      return 0;
+    }
+    buffer.physical_ptr = memory_.GetPhysicalAddress(buffer.guest_ptr);
+  }
+  std::memcpy(memory_.TranslateVirtual(buffer.guest_ptr), data.data(),
+              data.size());
+  return buffer.physical_ptr;
+}
+
+void XmaReplayer::RestoreAddresses(
+    XMA_CONTEXT_DATA& data, const XMA_CONTEXT_DATA& captured_data) const {
+  if (input_buffer_0_.physical_ptr &&
+      data.input_buffer_0_ptr == input_buffer_0_.physical_ptr) {
+    data.input_buffer_0_ptr = captured_data.input_buffer_0_ptr;
+  }
+  if (input_buffer_1_.physical_ptr &&
+      data.input_buffer_1_ptr == input_buffer_1_.physical_ptr) {
+    data.input_buffer_1_ptr = captured_data.input_buffer_1_ptr;
+  }
+  if (output_buffer_.physical_ptr &&
+      data.output_buffer_ptr == output_buffer_.physical_ptr) {
+    data.output_buffer_ptr = captured_data.output_buffer_ptr;
+  }
+}
+
+bool XmaReplayer::Replay(const XmaCaptureRecord& record,
+                         uint64_t record_index) {
+  Context* context = GetContext(record.header.context_id);
+  if (!context) {
+    return false;
+  }
+  uint8_t* context_ptr = memory_.TranslateVirtual(context->guest_ptr);
+
+  if (record.header.type == XmaCaptureRecordType::kClear) {
+    context->context->Clear();
+    return true;
+  }
+
+  // Redirecting the context to the staging buffers, which are at different
+  // addresses than in the emulator.
+  XMA_CONTEXT_DATA captured_data_before(record.context_before);
+  XMA_CONTEXT_DATA data = captured_data_before;
+  if (!record.input_buffer_0.empty()) {
+    data.input_buffer_0_ptr = Stage(input_buffer_0_, record.input_buffer_0);
+  }
+  if (!record.input_buffer_1.empty()) {
+    data.input_buffer_1_ptr = Stage(input_buffer_1_, record.input_buffer_1);
+  }
+  if (!record.output_buffer_before.empty()) {
+    data.output_buffer_ptr =
+        Stage(output_buffer_, record.output_buffer_before);
+  }
+  if ((!record.input_buffer_0.empty() && !data.input_buffer_0_ptr) ||
+      (!record.input_buffer_1.empty() && !data.input_buffer_1_ptr) ||
+      (!record.output_buffer_before.empty() && !data.output_buffer_ptr)) {
+    XELOGE("Failed to allocate the buffers of record {}", record_index);
+    return false;
+  }
+  data.Store(context_ptr);
+
+  context->context->Enable();
+  uint64_t work_start_ticks = Clock::QueryHostTickCount();
+  context->context->Work();
+  context->work_ticks += Clock::QueryHostTickCount() - work_start_ticks;
+  ++context->work_count;
+
+  XMA_CONTEXT_DATA data_after(context_ptr);
+  if (data.output_buffer_block_count) {
+    uint32_t output_blocks = (data_after.output_buffer_write_offset +
+                              data.output_buffer_block_count -
+                              data.output_buffer_write_offset) %
+                             data.output_buffer_block_count;
+    context->output_blocks += output_blocks;
+    context->frames += output_blocks * uint64_t(256) /
+                       (XmaContext::kBytesPerFrameChannel *
+                        (data.is_stereo ? uint64_t(2) : uint64_t(1)));
+  }
+
+  RestoreAddresses(data_after, captured_data_before);
+  uint8_t context_after[sizeof(XMA_CONTEXT_DATA)];
+  data_after.Store(context_after);
+  bool context_mismatch = std::memcmp(context_after, record.context_after,
+                                      sizeof(context_after)) != 0;
+  bool output_mismatch =
+      !record.output_buffer_after.empty() &&
+      std::memcmp(memory_.TranslateVirtual(output_buffer_.guest_ptr),
+                  record.output_buffer_after.data(),
+                  record.output_buffer_after.size()) != 0;
+  if (context_mismatch) {
+    ++context->context_mismatches;
+  }
+  if (output_mismatch) {
+    ++context->output_mismatches;
+  }
+  if ((context_mismatch || output_mismatch) &&
+      reported_mismatches_ < cvars::xma_replay_max_reported_mismatches) {
+    ++reported_mismatches_;
+    XMA_CONTEXT_DATA captured_data_after(record.context_after);
+    XELOGW(
+        "Record {} (context {}) differs from the capture:{}{} input read "
+        "offset {} (captured {}), output write offset {} (captured {})",
+        record_index, record.header.context_id,
+        context_mismatch ? " context data" : "",
+        output_mismatch ? " output buffer" : "",
+        data_after.input_buffer_read_offset,
+        captured_data_after.input_buffer_read_offset,
+        data_after.output_buffer_write_offset,
+        captured_data_after.output_buffer_write_offset);
+  }
+  return true;
+}
+
+void XmaReplayer::LogStatistics() const {
+  uint64_t tick_frequency = Clock::QueryHostTickFrequency();
+  uint64_t total_work_count = 0;
+  uint64_t total_work_ticks = 0;
+  uint64_t total_frames = 0;
+  uint64_t total_context_mismatches = 0;
+  uint64_t total_output_mismatches = 0;
+  for (size_t i = 0; i < contexts_.size(); ++i) {
+    const Context* context = contexts_[i].get();
+    if (!context || !context->work_count) {
+      continue;
+    }
+    XELOGI(
+        "Context {}: {} times processed, {} frames, {} us decoding ({:.2f} us "
+        "per processing), {} context data and {} output mismatches",
+        i, context->work_count, context->frames,
+        context->work_ticks * 1000000 / tick_frequency,
+        double(context->work_ticks) * 1000000.0 /
+            (double(tick_frequency) * double(context->work_count)),
+        context->context_mismatches, context->output_mismatches);
+    total_work_count += context->work_count;
+    total_work_ticks += context->work_ticks;
+    total_frames += context->frames;
+    total_context_mismatches += context->context_mismatches;
+    total_output_mismatches += context->output_mismatches;
+  }
+  double total_seconds = double(total_work_ticks) / double(tick_frequency);
+  XELOGI(
+      "Total: {} times processed, {} frames in {:.3f} s of decoding ({:.0f} "
+      "frames per second), {} context data and {} output mismatches",
+      total_work_count, total_frames, total_seconds,
+      total_seconds > 0.0 ? double(total_frames) / total_seconds : 0.0,
+      total_context_mismatches, total_output_mismatches);
+  if (!total_context_mismatches && !total_output_mismatches) {
+    XELOGI("The output is bit-exact with the capture");
+  }
+}
+
+int xma_replay_main(const std::vector<std::string>& args) {
+  if (cvars::xma_capture.empty()) {
+    XELOGE("Usage: {} [xma_capture]", xe::path_to_utf8(args[0]));
+    return 1;
+  }
+
+  XmaCaptureReader reader;
+  if (!reader.Open(cvars::xma_capture)) {
+    return 1;
+  }
+  bool is_capture_new_decoder = reader.header().is_new_decoder != 0;
+  XELOGI("Replaying the capture of title {:08X} made with the {} decoder "
+         "using the {} decoder",
+         reader.header().title_id, is_capture_new_decoder ? "new" : "old",
+         cvars::use_new_decoder ? "new" : "old");
+  if (is_capture_new_decoder != cvars::use_new_decoder) {
+    XELOGW(
+        "The decoders are different, the output is not expected to match the "
+        "capture");
+  }
+
+  auto memory = std::make_unique<Memory>();
+  if (!memory->Initialize()) {
+    XELOGE("Failed to initialize the memory");
+    return 1;
+  }
+
+  bool succeeded = true;
+  {
+    XmaReplayer replayer(*memory);
+    XmaCaptureRecord record;
+    uint64_t record_count = 0;
+    while (reader.ReadRecord(record)) {
+      if (!replayer.Replay(record, record_count)) {
+        succeeded = false;
+        break;
+      }
+      ++record_count;
+    }
+    if (reader.is_corrupted()) {
+      XELOGW("The capture is corrupted after record {}", record_count);
+    }
+    XELOGI("Replayed {} records", record_count);
+    replayer.LogStatistics();
+  }
+  memory.reset();
+  return succeeded ? 0 : 1;
+}
+
+}  // namespace apu
+}  // namespace xe
+
+XE_DEFINE_CONSOLE_APP("xenia-apu-xma-replay", xe::apu::xma_replay_main,
+                      "[xma_capture]", "xma_capture");
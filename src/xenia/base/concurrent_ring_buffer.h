@@ -0,0 +1,217 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2026 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#ifndef XENIA_BASE_CONCURRENT_RING_BUFFER_H_
+#define XENIA_BASE_CONCURRENT_RING_BUFFER_H_
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+namespace xe {
+
+// Bounded lock-free queues of fixed capacity for passing objects between host
+// threads, unlike RingBuffer, which is a view of a byte buffer (often in the
+// guest memory) and needs external synchronization. The elements are stored
+// in place and must be default-constructible and movable, popped slots are
+// reset to a default-constructed value so they don't keep resources alive.
+//
+// The indices modified by different threads are placed in separate cache
+// lines, so the producer and the consumer don't invalidate each other's cache
+// lines outside the actual handoff.
+
+constexpr size_t kConcurrentRingBufferCacheLineSize = 64;
+
+// Single producer, single consumer.
+template <typename T, size_t Capacity>
+class SpscRingBuffer {
+  static_assert(Capacity >= 2 && !(Capacity & (Capacity - 1)),
+                "The capacity must be a power of two");
+
+ public:
+  static constexpr size_t kCapacity = Capacity;
+
+  // Producer. Doesn't modify the value if the queue is full.
+  bool TryPush(T&& value) {
+    size_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail - producer_cached_head_ >= kCapacity) {
+      producer_cached_head_ = head_.load(std::memory_order_acquire);
+      if (tail - producer_cached_head_ >= kCapacity) {
+        return false;
+      }
+    }
+    slots_[tail & (kCapacity - 1)] = std::move(value);
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+  bool TryPush(const T& value) {
+    T value_copy(value);
+    return TryPush(std::move(value_copy));
+  }
+
+  // Producer. Moves up to count values from the array into the queue, making
+  // them visible to the consumer at once, and returns how many were pushed.
+  size_t TryPushBatch(T* values, size_t count) {
+    size_t tail = tail_.load(std::memory_order_relaxed);
+    size_t free_count = kCapacity - (tail - producer_cached_head_);
+    if (free_count < count) {
+      producer_cached_head_ = head_.load(std::memory_order_acquire);
+      free_count = kCapacity - (tail - producer_cached_head_);
+    }
+    count = std::min(count, free_count);
+    for (size_t i = 0; i < count; ++i) {
+      slots_[(tail + i) & (kCapacity - 1)] = std::move(values[i]);
+    }
+    if (count) {
+      tail_.store(tail + count, std::memory_order_release);
+    }
+    return count;
+  }
+
+  // Consumer.
+  bool TryPop(T& value_out) {
+    size_t head = head_.load(std::memory_order_relaxed);
+    if (head == consumer_cached_tail_) {
+      consumer_cached_tail_ = tail_.load(std::memory_order_acquire);
+      if (head == consumer_cached_tail_) {
+        return false;
+      }
+    }
+    T& slot = slots_[head & (kCapacity - 1)];
+    value_out = std::move(slot);
+    slot = T();
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Consumer. Moves up to max_count values into the array, releasing their
+  // slots to the producer at once, and returns how many were popped.
+  size_t TryPopBatch(T* values_out, size_t max_count) {
+    size_t head = head_.load(std::memory_order_relaxed);
+    size_t count = consumer_cached_tail_ - head;
+    if (count < max_count) {
+      consumer_cached_tail_ = tail_.load(std::memory_order_acquire);
+      count = consumer_cached_tail_ - head;
+    }
+    count = std::min(count, max_count);
+    for (size_t i = 0; i < count; ++i) {
+      T& slot = slots_[(head + i) & (kCapacity - 1)];
+      values_out[i] = std::move(slot);
+      slot = T();
+    }
+    if (count) {
+      head_.store(head + count, std::memory_order_release);
+    }
+    return count;
+  }
+
+  // Exact only when called from one of the sides while the other is idle.
+  bool empty() const {
+    return head_.load(std::memory_order_acquire) ==
+           tail_.load(std::memory_order_acquire);
+  }
+
+ private:
+  // Written by the consumer.
+  alignas(kConcurrentRingBufferCacheLineSize) std::atomic<size_t> head_{0};
+  size_t consumer_cached_tail_ = 0;
+  // Written by the producer.
+  alignas(kConcurrentRingBufferCacheLineSize) std::atomic<size_t> tail_{0};
+  size_t producer_cached_head_ = 0;
+
+  alignas(kConcurrentRingBufferCacheLineSize) T slots_[kCapacity];
+};
+
+// Multiple producers, single consumer. Each slot has a sequence number telling
+// whether it's free for the producer or filled for the consumer for the
+// current lap (Dmitry Vyukov's bounded queue), so producers only contend on
+// claiming the tail.
+template <typename T, size_t Capacity>
+class MpscRingBuffer {
+  static_assert(Capacity >= 2 && !(Capacity & (Capacity - 1)),
+                "The capacity must be a power of two");
+
+ public:
+  static constexpr size_t kCapacity = Capacity;
+
+  MpscRingBuffer() {
+    for (size_t i = 0; i < kCapacity; ++i) {
+      slots_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  // Any producer thread. Doesn't modify the value if the queue is full.
+  bool TryPush(T&& value) {
+    size_t tail = tail_.load(std::memory_order_relaxed);
+    Slot* slot;
+    while (true) {
+      slot = &slots_[tail & (kCapacity - 1)];
+      size_t sequence = slot->sequence.load(std::memory_order_acquire);
+      intptr_t difference = intptr_t(sequence) - intptr_t(tail);
+      if (!difference) {
+        if (tail_.compare_exchange_weak(tail, tail + 1,
+                                        std::memory_order_relaxed)) {
+          break;
+        }
+      } else if (difference < 0) {
+        // Not consumed yet since the previous lap.
+        return false;
+      } else {
+        tail = tail_.load(std::memory_order_relaxed);
+      }
+    }
+    slot->value = std::move(value);
+    slot->sequence.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+  bool TryPush(const T& value) {
+    T value_copy(value);
+    return TryPush(std::move(value_copy));
+  }
+
+  // Consumer. Values pushed by one producer are popped in the order they were
+  // pushed, but a producer that has claimed a slot and hasn't filled it yet
+  // stalls the consumer until it does.
+  bool TryPop(T& value_out) {
+    Slot& slot = slots_[head_ & (kCapacity - 1)];
+    if (slot.sequence.load(std::memory_order_acquire) != head_ + 1) {
+      return false;
+    }
+    value_out = std::move(slot.value);
+    slot.value = T();
+    slot.sequence.store(head_ + kCapacity, std::memory_order_release);
+    ++head_;
+    return true;
+  }
+
+  // Consumer.
+  bool empty() const {
+    return slots_[head_ & (kCapacity - 1)].sequence.load(
+               std::memory_order_acquire) != head_ + 1;
+  }
+
+ private:
+  struct Slot {
+    std::atomic<size_t> sequence;
+    T value;
+  };
+
+  // Written by the producers.
+  alignas(kConcurrentRingBufferCacheLineSize) std::atomic<size_t> tail_{0};
+  // Only accessed by the consumer.
+  alignas(kConcurrentRingBufferCacheLineSize) size_t head_ = 0;
+
+  alignas(kConcurrentRingBufferCacheLineSize) Slot slots_[kCapacity];
+};
+
+}  // namespace xe
+
+#endif  // XENIA_BASE_CONCURRENT_RING_BUFFER_H_
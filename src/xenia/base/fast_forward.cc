@@ -0,0 +1,85 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2026 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/base/fast_forward.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+
+#include "xenia/base/clock.h"
+#include "xenia/base/cvar.h"
+#include "xenia/base/logging.h"
+
+DEFINE_bool(fast_forward, false,
+            "Run the title as fast as the host allows, with the guest time "
+            "scaled, without vsync and the framerate limit, presenting only "
+            "some of the frames and without audio.",
+            "General");
+DEFINE_double(fast_forward_time_scalar, 4.0,
+              "Scalar of the guest time while fast-forwarding, or 0 to keep "
+              "the current one.",
+              "General");
+DEFINE_uint32(fast_forward_present_interval, 8,
+              "Present only every Nth guest frame while fast-forwarding.",
+              "General");
+
+namespace xe {
+namespace fast_forward {
+
+namespace {
+
+std::atomic<bool> enabled{false};
+std::atomic<uint32_t> frames_since_present{0};
+
+std::mutex mutex;
+double saved_time_scalar = 1.0;
+
+}  // namespace
+
+bool IsEnabled() { return enabled.load(std::memory_order_relaxed); }
+
+void SetEnabled(bool new_enabled) {
+  std::lock_guard<std::mutex> lock(mutex);
+  if (IsEnabled() == new_enabled) {
+    return;
+  }
+  if (new_enabled) {
+    saved_time_scalar = Clock::guest_time_scalar();
+    if (cvars::fast_forward_time_scalar > 0.0) {
+      Clock::set_guest_time_scalar(cvars::fast_forward_time_scalar);
+    }
+    frames_since_present.store(0, std::memory_order_relaxed);
+    XELOGI("Fast-forwarding at {:.2f}x guest time",
+           Clock::guest_time_scalar());
+  } else {
+    Clock::set_guest_time_scalar(saved_time_scalar);
+    XELOGI("Stopped fast-forwarding");
+  }
+  enabled.store(new_enabled, std::memory_order_relaxed);
+}
+
+bool ShouldPresentGuestFrame() {
+  if (!IsEnabled()) {
+    return true;
+  }
+  // Only the GPU thread swaps, but enabling may reset the counter.
+  uint32_t interval = std::max(cvars::fast_forward_present_interval, 1u);
+  uint32_t frames = frames_since_present.load(std::memory_order_relaxed) + 1;
+  if (frames < interval) {
+    frames_since_present.store(frames, std::memory_order_relaxed);
+    return false;
+  }
+  frames_since_present.store(0, std::memory_order_relaxed);
+  return true;
+}
+
+}  // namespace fast_forward
+}  // namespace xe
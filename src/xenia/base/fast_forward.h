@@ -0,0 +1,36 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2026 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#ifndef XENIA_BASE_FAST_FORWARD_H_
+#define XENIA_BASE_FAST_FORWARD_H_
+
+namespace xe {
+namespace fast_forward {
+
+// Running the title as fast as the host allows, initially enabled with the
+// fast_forward cvar and toggled from the emulator window. While enabled:
+// - Guest time runs fast_forward_time_scalar times faster, so the timers of
+//   the title keep up with its frames.
+// - Vertical blanks and GPU waits are not paced by vsync and framerate_limit.
+// - Only every fast_forward_present_interval-th guest frame is presented.
+// - Audio frames are discarded as soon as they're submitted instead of
+//   throttling the title to the playback speed.
+
+bool IsEnabled();
+// Saves the guest time scalar when enabling and restores it when disabling.
+void SetEnabled(bool enabled);
+
+// To be called on every guest frame swap, returns whether the frame needs to
+// be presented.
+bool ShouldPresentGuestFrame();
+
+}  // namespace fast_forward
+}  // namespace xe
+
+#endif  // XENIA_BASE_FAST_FORWARD_H_
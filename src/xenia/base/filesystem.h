@@ -63,6 +63,19 @@ int64_t Tell(FILE* file);
 // undefined.
 bool TruncateStdioFile(FILE* file, uint64_t length);
 
+// Advisory locks for coordinating with other processes using the same stdio
+// file, held through the file until they're unlocked or the file is closed.
+// Every index is a separate lock, and the locks don't restrict reading or
+// writing the file. Locking an index already locked through the file replaces
+// the lock. If wait is false and another process holds a conflicting lock,
+// returns false, leaving the index unlocked.
+bool LockStdioFile(FILE* file, uint32_t index, bool exclusive, bool wait);
+void UnlockStdioFile(FILE* file, uint32_t index);
+
+// Flushes a stdio file opened for appending and appends the data to its end in
+// a single write, so appends by different processes are never interleaved.
+bool AppendToStdioFile(FILE* file, const void* data, size_t size);
+
 struct FileAccess {
   // Implies kFileReadData.
   static const uint32_t kGenericRead = 0x80000000;
@@ -14,6 +14,7 @@
 
 #include <assert.h>
 #include <dirent.h>
+#include <errno.h>
 #include <fcntl.h>
 #include <ftw.h>
 #include <libgen.h>
@@ -106,6 +107,56 @@ bool TruncateStdioFile(FILE* file, uint64_t length) {
   return true;
 }
 
+// Open file description locks are not released when other descriptors of the
+// file are closed by the process, unlike the process-associated ones. The
+// locked bytes are beyond any data the files may contain.
+static bool SetStdioFileLock(FILE* file, uint32_t index, short type,
+                             bool wait) {
+  struct flock lock = {};
+  lock.l_type = type;
+  lock.l_whence = SEEK_SET;
+  lock.l_start = off_t(INT64_C(0x7FFFFFFF00000000) + index);
+  lock.l_len = 1;
+  int result;
+  do {
+    result = fcntl(fileno(file), wait ? F_OFD_SETLKW : F_OFD_SETLK, &lock);
+  } while (result && errno == EINTR);
+  return !result;
+}
+
+bool LockStdioFile(FILE* file, uint32_t index, bool exclusive, bool wait) {
+  if (!SetStdioFileLock(file, index, exclusive ? F_WRLCK : F_RDLCK, wait)) {
+    UnlockStdioFile(file, index);
+    return false;
+  }
+  return true;
+}
+
+void UnlockStdioFile(FILE* file, uint32_t index) {
+  SetStdioFileLock(file, index, F_UNLCK, false);
+}
+
+bool AppendToStdioFile(FILE* file, const void* data, size_t size) {
+  if (fflush(file)) {
+    return false;
+  }
+  // The stream is opened with O_APPEND, which makes positioning at the end and
+  // writing a single atomic step.
+  auto bytes = static_cast<const uint8_t*>(data);
+  while (size) {
+    ssize_t written = write(fileno(file), bytes, size);
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    bytes += written;
+    size -= size_t(written);
+  }
+  return true;
+}
+
 static int removeCallback(const char* fpath, const struct stat* sb,
                           int typeflag, struct FTW* ftwbuf) {
   int rv = remove(fpath);
@@ -10,6 +10,7 @@
 #include <io.h>
 #include <shlobj.h>
 
+#include <algorithm>
 #include <string>
 
 #undef CreateFile
@@ -103,6 +104,62 @@ bool TruncateStdioFile(FILE* file, uint64_t length) {
   return true;
 }
 
+// Locks on Windows prevent other processes from accessing the locked range, so
+// the locked bytes are beyond any data the files may contain.
+static OVERLAPPED GetStdioFileLockOverlapped(uint32_t index) {
+  uint64_t offset = UINT64_C(0x7FFFFFFF00000000) + index;
+  OVERLAPPED overlapped = {};
+  overlapped.Offset = DWORD(offset);
+  overlapped.OffsetHigh = DWORD(offset >> 32);
+  return overlapped;
+}
+
+bool LockStdioFile(FILE* file, uint32_t index, bool exclusive, bool wait) {
+  // Locks are not converted, and an exclusive lock would conflict with the
+  // shared lock being replaced.
+  UnlockStdioFile(file, index);
+  auto handle = reinterpret_cast<HANDLE>(_get_osfhandle(_fileno(file)));
+  DWORD flags = 0;
+  if (exclusive) {
+    flags |= LOCKFILE_EXCLUSIVE_LOCK;
+  }
+  if (!wait) {
+    flags |= LOCKFILE_FAIL_IMMEDIATELY;
+  }
+  OVERLAPPED overlapped = GetStdioFileLockOverlapped(index);
+  return LockFileEx(handle, flags, 0, 1, 0, &overlapped) != FALSE;
+}
+
+void UnlockStdioFile(FILE* file, uint32_t index) {
+  auto handle = reinterpret_cast<HANDLE>(_get_osfhandle(_fileno(file)));
+  OVERLAPPED overlapped = GetStdioFileLockOverlapped(index);
+  UnlockFileEx(handle, 0, 1, 0, &overlapped);
+}
+
+bool AppendToStdioFile(FILE* file, const void* data, size_t size) {
+  if (fflush(file)) {
+    return false;
+  }
+  // The CRT emulates appending by seeking to the end before writing, which is
+  // not atomic, while the offset of all ones writes to the end of the file
+  // like with FILE_APPEND_DATA.
+  auto handle = reinterpret_cast<HANDLE>(_get_osfhandle(_fileno(file)));
+  auto bytes = static_cast<const uint8_t*>(data);
+  while (size) {
+    OVERLAPPED overlapped = {};
+    overlapped.Offset = 0xFFFFFFFF;
+    overlapped.OffsetHigh = 0xFFFFFFFF;
+    DWORD written;
+    if (!WriteFile(handle, bytes, DWORD(std::min(size, size_t(UINT32_MAX))),
+                   &written, &overlapped)) {
+      return false;
+    }
+    bytes += written;
+    size -= written;
+  }
+  return true;
+}
+
 class Win32FileHandle : public FileHandle {
  public:
   Win32FileHandle(const std::filesystem::path& path, HANDLE handle)
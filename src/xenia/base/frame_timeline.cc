@@ -0,0 +1,213 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2026 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/base/frame_timeline.h"
+
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+
+#include "xenia/base/cvar.h"
+#include "xenia/base/filesystem.h"
+#include "xenia/base/logging.h"
+#include "xenia/base/math.h"
+#include "xenia/base/string.h"
+
+#include "third_party/fmt/include/fmt/format.h"
+
+DEFINE_bool(frame_timeline, false,
+            "Record the duration of the recent guest frames and the host time "
+            "spent in the emulation activities during them, for the Frame "
+            "Timeline dialog.",
+            "Display");
+DEFINE_double(frame_timeline_budget_ms, 0.0,
+              "Duration of frames over which the Frame Timeline dialog lists "
+              "them as stutters, or 0 for 1.5 times the median duration.",
+              "Display");
+DEFINE_path(frame_timeline_export_path, "frame_timeline.csv",
+            "File the Frame Timeline dialog exports the frames to.",
+            "Display");
+
+namespace xe {
+namespace frame_timeline {
+
+namespace {
+
+constexpr size_t kHistorySize = 1024;
+
+const char* const kActivityNames[] = {
+    "JIT compilation", "command processing", "pipeline creation",
+    "texture loading", "XMA decoding",
+};
+static_assert(xe::countof(kActivityNames) == size_t(Activity::kCount));
+const char* const kActivityCsvNames[] = {
+    "jit_compile", "command_processor", "pipeline_creation", "texture_load",
+    "xma_decode",
+};
+static_assert(xe::countof(kActivityCsvNames) == size_t(Activity::kCount));
+
+// Of the frame not swapped yet.
+std::array<std::atomic<uint64_t>, size_t(Activity::kCount)>
+    current_activity_ticks = {};
+
+std::mutex mutex;
+std::array<Frame, kHistorySize> history;
+uint64_t frame_count = 0;
+uint64_t last_swap_ticks = 0;
+
+double TicksToMs(uint64_t ticks) {
+  return double(ticks) * 1000.0 / double(Clock::QueryHostTickFrequency());
+}
+
+}  // namespace
+
+const char* GetActivityName(Activity activity) {
+  return kActivityNames[size_t(activity)];
+}
+
+bool IsEnabled() { return cvars::frame_timeline; }
+
+void AddActivityTime(Activity activity, uint64_t ticks) {
+  if (!IsEnabled()) {
+    return;
+  }
+  current_activity_ticks[size_t(activity)].fetch_add(
+      ticks, std::memory_order_relaxed);
+}
+
+void OnGuestSwap() {
+  if (!IsEnabled()) {
+    return;
+  }
+  uint64_t now_ticks = Clock::QueryHostTickCount();
+  std::lock_guard<std::mutex> lock(mutex);
+  if (!last_swap_ticks) {
+    // The time before the first swap is not a frame.
+    last_swap_ticks = now_ticks;
+    for (auto& ticks : current_activity_ticks) {
+      ticks.store(0, std::memory_order_relaxed);
+    }
+    return;
+  }
+  Frame& frame = history[frame_count % kHistorySize];
+  frame.number = frame_count++;
+  frame.swap_ticks = now_ticks;
+  frame.duration_ticks = now_ticks - last_swap_ticks;
+  frame.present_latency_ticks = 0;
+  for (size_t i = 0; i < size_t(Activity::kCount); ++i) {
+    frame.activity_ticks[i] =
+        current_activity_ticks[i].exchange(0, std::memory_order_relaxed);
+  }
+  last_swap_ticks = now_ticks;
+}
+
+void OnPresent() {
+  if (!IsEnabled()) {
+    return;
+  }
+  uint64_t now_ticks = Clock::QueryHostTickCount();
+  std::lock_guard<std::mutex> lock(mutex);
+  if (!frame_count) {
+    return;
+  }
+  Frame& frame = history[(frame_count - 1) % kHistorySize];
+  if (!frame.present_latency_ticks) {
+    frame.present_latency_ticks =
+        std::max(now_ticks - frame.swap_ticks, uint64_t(1));
+  }
+}
+
+std::vector<Frame> GetFrames() {
+  std::lock_guard<std::mutex> lock(mutex);
+  size_t count = size_t(std::min(frame_count, uint64_t(kHistorySize)));
+  std::vector<Frame> result;
+  result.reserve(count);
+  for (uint64_t i = frame_count - count; i < frame_count; ++i) {
+    result.push_back(history[i % kHistorySize]);
+  }
+  return result;
+}
+
+void Reset() {
+  std::lock_guard<std::mutex> lock(mutex);
+  frame_count = 0;
+  last_swap_ticks = 0;
+}
+
+uint64_t GetBudgetTicks(const std::vector<Frame>& frames) {
+  if (cvars::frame_timeline_budget_ms > 0.0) {
+    return uint64_t(cvars::frame_timeline_budget_ms *
+                    double(Clock::QueryHostTickFrequency()) / 1000.0);
+  }
+  if (frames.empty()) {
+    return UINT64_MAX;
+  }
+  std::vector<uint64_t> durations;
+  durations.reserve(frames.size());
+  for (const Frame& frame : frames) {
+    durations.push_back(frame.duration_ticks);
+  }
+  auto median = durations.begin() + durations.size() / 2;
+  std::nth_element(durations.begin(), median, durations.end());
+  return *median + *median / 2;
+}
+
+std::string DescribeDominantActivity(const Frame& frame) {
+  auto activity_ticks = frame.activity_ticks;
+  // Excluding the nested activities from the command processing.
+  uint64_t& command_processor_ticks =
+      activity_ticks[size_t(Activity::kCommandProcessor)];
+  for (Activity nested :
+       {Activity::kPipelineCreation, Activity::kTextureLoad}) {
+    command_processor_ticks -= std::min(command_processor_ticks,
+                                        activity_ticks[size_t(nested)]);
+  }
+  size_t dominant = size_t(
+      std::max_element(activity_ticks.begin(), activity_ticks.end()) -
+      activity_ticks.begin());
+  if (!activity_ticks[dominant]) {
+    return "no recorded activity";
+  }
+  return fmt::format("{:.1f} ms in {}", TicksToMs(activity_ticks[dominant]),
+                     kActivityNames[dominant]);
+}
+
+bool ExportCsv(const std::filesystem::path& path) {
+  FILE* file = filesystem::OpenFile(path, "w");
+  if (!file) {
+    XELOGE("Failed to open {} for exporting the frame timeline",
+           xe::path_to_utf8(path));
+    return false;
+  }
+  std::vector<Frame> frames = GetFrames();
+  uint64_t budget_ticks = GetBudgetTicks(frames);
+  std::fputs("frame,duration_ms,present_latency_ms", file);
+  for (const char* activity_name : kActivityCsvNames) {
+    std::fprintf(file, ",%s_ms", activity_name);
+  }
+  std::fputs(",stutter\n", file);
+  for (const Frame& frame : frames) {
+    std::fprintf(file, "%llu,%.3f,%.3f", (unsigned long long)frame.number,
+                 TicksToMs(frame.duration_ticks),
+                 TicksToMs(frame.present_latency_ticks));
+    for (uint64_t ticks : frame.activity_ticks) {
+      std::fprintf(file, ",%.3f", TicksToMs(ticks));
+    }
+    std::fprintf(file, ",%s\n",
+                 frame.duration_ticks > budget_ticks
+                     ? DescribeDominantActivity(frame).c_str()
+                     : "");
+  }
+  std::fclose(file);
+  XELOGI("Exported {} frames to {}", frames.size(), xe::path_to_utf8(path));
+  return true;
+}
+
+}  // namespace frame_timeline
+}  // namespace xe
@@ -0,0 +1,99 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2026 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#ifndef XENIA_BASE_FRAME_TIMELINE_H_
+#define XENIA_BASE_FRAME_TIMELINE_H_
+
+#include <array>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "xenia/base/clock.h"
+#include "xenia/base/cvar.h"
+
+DECLARE_path(frame_timeline_export_path);
+
+namespace xe {
+namespace frame_timeline {
+
+// History of the recent guest frames, enabled with the frame_timeline cvar,
+// for finding what causes stutters. A frame is the interval between two guest
+// frame swaps, and includes the host time spent in the activities below on
+// any thread during it, and the time from its swap to the first host
+// presentation after it. Shown in the Frame Timeline dialog and exportable as
+// CSV.
+
+enum class Activity : uint32_t {
+  kJitCompile,
+  // Including the texture loads and the pipeline creation on the GPU thread.
+  kCommandProcessor,
+  kPipelineCreation,
+  kTextureLoad,
+  kXmaDecode,
+
+  kCount,
+};
+
+const char* GetActivityName(Activity activity);
+
+struct Frame {
+  uint64_t number;
+  // Host ticks of the swap ending the frame.
+  uint64_t swap_ticks;
+  // Host ticks since the previous swap.
+  uint64_t duration_ticks;
+  // Host ticks from the swap to the presentation, 0 if not presented yet.
+  uint64_t present_latency_ticks;
+  std::array<uint64_t, size_t(Activity::kCount)> activity_ticks;
+};
+
+bool IsEnabled();
+
+void AddActivityTime(Activity activity, uint64_t ticks);
+
+class ScopedActivity {
+ public:
+  explicit ScopedActivity(Activity activity)
+      : activity_(activity),
+        start_ticks_(IsEnabled() ? Clock::QueryHostTickCount() : 0) {}
+  ~ScopedActivity() {
+    if (start_ticks_) {
+      AddActivityTime(activity_, Clock::QueryHostTickCount() - start_ticks_);
+    }
+  }
+  ScopedActivity(const ScopedActivity&) = delete;
+  ScopedActivity& operator=(const ScopedActivity&) = delete;
+
+ private:
+  Activity activity_;
+  uint64_t start_ticks_;
+};
+
+void OnGuestSwap();
+void OnPresent();
+
+// Oldest first.
+std::vector<Frame> GetFrames();
+void Reset();
+
+// The frame_timeline_budget_ms cvar, or if it's 0, 1.5 times the median
+// duration of the frames.
+uint64_t GetBudgetTicks(const std::vector<Frame>& frames);
+// Describes the activity the frame spent the most time in, such as "42.0 ms
+// in pipeline creation".
+std::string DescribeDominantActivity(const Frame& frame);
+
+bool ExportCsv(const std::filesystem::path& path);
+
+}  // namespace frame_timeline
+}  // namespace xe
+
+#endif  // XENIA_BASE_FRAME_TIMELINE_H_
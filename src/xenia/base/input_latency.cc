@@ -0,0 +1,175 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2026 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/base/input_latency.h"
+
+#include <array>
+#include <mutex>
+#include <vector>
+
+#include "xenia/base/clock.h"
+#include "xenia/base/cvar.h"
+#include "xenia/base/logging.h"
+#include "xenia/base/metrics.h"
+
+DEFINE_bool(input_latency_tracking, false,
+            "Measure the time from host input events to the presentation of "
+            "the frames rendered with them, reported in the HID metrics and "
+            "logged when the title ends.",
+            "HID");
+
+namespace xe {
+namespace input_latency {
+
+namespace {
+
+xe::metrics::Histogram input_to_guest_read_us_(
+    "HID", "input_to_guest_read_us",
+    "Microseconds from a host input event to the guest reading it");
+xe::metrics::Histogram input_to_guest_swap_us_(
+    "HID", "input_to_guest_swap_us",
+    "Microseconds from a host input event to the next guest frame swap");
+xe::metrics::Histogram input_to_present_us_(
+    "HID", "input_to_present_us",
+    "Microseconds from a host input event to the next guest frame "
+    "presentation");
+
+constexpr uint32_t kMaxUsers = 4;
+
+struct UserInput {
+  // Host input event not included in a produced state yet, 0 if none.
+  uint64_t event_ticks = 0;
+  // Host input event included in the state with the packet number, not read
+  // by the guest yet, 0 if none.
+  uint64_t produced_event_ticks = 0;
+  uint32_t produced_packet_number = 0;
+};
+
+std::mutex mutex;
+std::array<UserInput, kMaxUsers> user_inputs;
+// Events read by the guest, waiting for the next swap.
+std::vector<uint64_t> read_event_ticks;
+// Events swapped by the guest, waiting for the next presentation.
+std::vector<uint64_t> swapped_event_ticks;
+
+uint32_t title_id = 0;
+xe::metrics::MetricValue title_latencies = {};
+
+uint64_t GetMicrosecondsSince(uint64_t ticks, uint64_t now_ticks) {
+  return (now_ticks - ticks) * 1000000 / Clock::QueryHostTickFrequency();
+}
+
+void LogTitleLatencies() {
+  if (!title_latencies.count) {
+    return;
+  }
+  XELOGI(
+      "Input latency for title {:08X}: {} samples, mean {:.0f} us, "
+      "p50 <= {} us, p90 <= {} us, p99 <= {} us",
+      title_id, title_latencies.count, title_latencies.GetMean(),
+      title_latencies.GetPercentileUpperBound(0.5),
+      title_latencies.GetPercentileUpperBound(0.9),
+      title_latencies.GetPercentileUpperBound(0.99));
+}
+
+}  // namespace
+
+bool IsEnabled() { return cvars::input_latency_tracking; }
+
+void OnHostInput(uint32_t user_index) {
+  if (!IsEnabled() || user_index >= kMaxUsers) {
+    return;
+  }
+  uint64_t now_ticks = Clock::QueryHostTickCount();
+  std::lock_guard<std::mutex> lock(mutex);
+  UserInput& user_input = user_inputs[user_index];
+  if (!user_input.event_ticks) {
+    user_input.event_ticks = now_ticks;
+  }
+}
+
+void OnStateProduced(uint32_t user_index, uint32_t packet_number) {
+  if (!IsEnabled() || user_index >= kMaxUsers) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(mutex);
+  UserInput& user_input = user_inputs[user_index];
+  if (!user_input.event_ticks || user_input.produced_event_ticks) {
+    return;
+  }
+  user_input.produced_event_ticks = user_input.event_ticks;
+  user_input.produced_packet_number = packet_number;
+  user_input.event_ticks = 0;
+}
+
+void OnGuestRead(uint32_t user_index, uint32_t packet_number) {
+  if (!IsEnabled() || user_index >= kMaxUsers) {
+    return;
+  }
+  uint64_t now_ticks = Clock::QueryHostTickCount();
+  std::lock_guard<std::mutex> lock(mutex);
+  UserInput& user_input = user_inputs[user_index];
+  if (!user_input.produced_event_ticks ||
+      int32_t(packet_number - user_input.produced_packet_number) < 0) {
+    return;
+  }
+  input_to_guest_read_us_.Record(
+      GetMicrosecondsSince(user_input.produced_event_ticks, now_ticks));
+  read_event_ticks.push_back(user_input.produced_event_ticks);
+  user_input.produced_event_ticks = 0;
+}
+
+void OnGuestSwap() {
+  if (!IsEnabled()) {
+    return;
+  }
+  uint64_t now_ticks = Clock::QueryHostTickCount();
+  std::lock_guard<std::mutex> lock(mutex);
+  for (uint64_t event_ticks : read_event_ticks) {
+    input_to_guest_swap_us_.Record(
+        GetMicrosecondsSince(event_ticks, now_ticks));
+    swapped_event_ticks.push_back(event_ticks);
+  }
+  read_event_ticks.clear();
+}
+
+void OnPresent() {
+  if (!IsEnabled()) {
+    return;
+  }
+  uint64_t now_ticks = Clock::QueryHostTickCount();
+  std::lock_guard<std::mutex> lock(mutex);
+  for (uint64_t event_ticks : swapped_event_ticks) {
+    uint64_t latency = GetMicrosecondsSince(event_ticks, now_ticks);
+    input_to_present_us_.Record(latency);
+    ++title_latencies.count;
+    title_latencies.sum += latency;
+    ++title_latencies.buckets[xe::metrics::Histogram::GetBucket(latency)];
+  }
+  swapped_event_ticks.clear();
+}
+
+void BeginTitle(uint32_t new_title_id) {
+  std::lock_guard<std::mutex> lock(mutex);
+  LogTitleLatencies();
+  title_id = new_title_id;
+  title_latencies = {};
+  user_inputs = {};
+  read_event_ticks.clear();
+  swapped_event_ticks.clear();
+}
+
+void EndTitle() {
+  std::lock_guard<std::mutex> lock(mutex);
+  LogTitleLatencies();
+  title_latencies = {};
+}
+
+}  // namespace input_latency
+}  // namespace xe
@@ -0,0 +1,50 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2026 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#ifndef XENIA_BASE_INPUT_LATENCY_H_
+#define XENIA_BASE_INPUT_LATENCY_H_
+
+#include <cstdint>
+
+namespace xe {
+namespace input_latency {
+
+// Measurement of the time from a host input event to the presentation of the
+// first frame the guest could have rendered with it, enabled with the
+// input_latency_tracking cvar. An input event of a user is followed through
+// the stages:
+// - The first controller state produced by the input system after the event,
+//   identified by its packet number.
+// - The first guest read of that state or a newer one.
+// - The next guest frame swap.
+// - The next host presentation of the guest output.
+// The latency until each stage is recorded in the HID metrics, and the
+// latency until the presentation is logged for every title when it ends.
+//
+// Only one input event of a user is followed at a time, the events until it
+// reaches the guest are treated as a part of it.
+
+bool IsEnabled();
+
+void OnHostInput(uint32_t user_index);
+void OnStateProduced(uint32_t user_index, uint32_t packet_number);
+void OnGuestRead(uint32_t user_index, uint32_t packet_number);
+void OnGuestSwap();
+void OnPresent();
+
+// Starts collecting the latencies of the title, logging the ones of the
+// previous title if it hasn't ended.
+void BeginTitle(uint32_t title_id);
+// Logs the latencies collected since the title began.
+void EndTitle();
+
+}  // namespace input_latency
+}  // namespace xe
+
+#endif  // XENIA_BASE_INPUT_LATENCY_H_
@@ -0,0 +1,209 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2022 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/base/lock_instrumentation.h"
+
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "third_party/fmt/include/fmt/format.h"
+#include "xenia/base/filesystem.h"
+#include "xenia/base/logging.h"
+
+namespace xe {
+namespace lock_instrumentation {
+
+namespace {
+
+constexpr uint64_t kWindowNs = 1000000000;
+
+struct SiteKey {
+  const void* lock;
+  const char* file;
+  uint32_t line;
+
+  bool operator==(const SiteKey& other) const {
+    return lock == other.lock && file == other.file && line == other.line;
+  }
+};
+
+struct SiteKeyHash {
+  size_t operator()(const SiteKey& key) const {
+    return std::hash<const void*>()(key.lock) ^
+           (std::hash<const char*>()(key.file) << 1) ^ (size_t(key.line) << 7);
+  }
+};
+
+struct SiteRecord {
+  SiteStats current;
+  SiteStats last_second;
+  SiteStats total;
+};
+
+// Deliberately a std::mutex and not one of the instrumented types.
+std::mutex stats_mutex_;
+std::unordered_map<SiteKey, SiteRecord, SiteKeyHash> records_;
+uint64_t window_start_ns_ = 0;
+
+thread_local Site pending_site_;
+
+void ResetCounts(SiteStats& stats) {
+  stats.acquisitions = 0;
+  stats.contentions = 0;
+  stats.wait_ns = stats.max_wait_ns = 0;
+  stats.hold_ns = stats.max_hold_ns = 0;
+}
+
+void RollWindowInLock(uint64_t now_ns) {
+  if (now_ns - window_start_ns_ < kWindowNs) {
+    return;
+  }
+  bool skipped = now_ns - window_start_ns_ >= 2 * kWindowNs;
+  for (auto& it : records_) {
+    auto& record = it.second;
+    record.last_second = record.current;
+    if (skipped) {
+      // Nothing was recorded for the full second before this one.
+      ResetCounts(record.last_second);
+    }
+    ResetCounts(record.current);
+  }
+  window_start_ns_ = now_ns;
+}
+
+SiteRecord& GetRecordInLock(const void* lock, const char* lock_name,
+                            const Site& site) {
+  auto& record = records_[SiteKey{lock, site.file, site.line}];
+  if (!record.total.lock) {
+    for (SiteStats* stats :
+         {&record.current, &record.last_second, &record.total}) {
+      stats->lock = lock;
+      stats->lock_name = lock_name;
+      stats->site = site;
+    }
+  }
+  return record;
+}
+
+std::vector<SiteStats> CollectSorted(bool last_second) {
+  std::vector<SiteStats> result;
+  {
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    RollWindowInLock(QueryTimeNs());
+    result.reserve(records_.size());
+    for (auto& it : records_) {
+      auto& stats = last_second ? it.second.last_second : it.second.total;
+      if (stats.acquisitions) {
+        result.push_back(stats);
+      }
+    }
+  }
+  std::sort(result.begin(), result.end(),
+            [](const SiteStats& a, const SiteStats& b) {
+              return a.wait_ns > b.wait_ns;
+            });
+  return result;
+}
+
+std::string EscapeJson(const char* text) {
+  std::string result;
+  for (; text && *text; ++text) {
+    if (*text == '\\' || *text == '"') {
+      result += '\\';
+    }
+    result += *text;
+  }
+  return result;
+}
+
+}  // namespace
+
+uint64_t QueryTimeNs() {
+  return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                      std::chrono::steady_clock::now().time_since_epoch())
+                      .count());
+}
+
+void SetPendingSite(const char* file, uint32_t line) {
+  pending_site_.file = file;
+  pending_site_.line = line;
+}
+
+Site TakePendingSite() {
+  Site site = pending_site_;
+  pending_site_ = Site();
+  return site;
+}
+
+void RecordAcquire(const void* lock, const char* lock_name, const Site& site,
+                   bool contended, uint64_t wait_ns) {
+  std::lock_guard<std::mutex> stats_lock(stats_mutex_);
+  RollWindowInLock(QueryTimeNs());
+  auto& record = GetRecordInLock(lock, lock_name, site);
+  for (SiteStats* stats : {&record.current, &record.total}) {
+    ++stats->acquisitions;
+    if (contended) {
+      ++stats->contentions;
+    }
+    stats->wait_ns += wait_ns;
+    stats->max_wait_ns = std::max(stats->max_wait_ns, wait_ns);
+  }
+}
+
+void RecordRelease(const void* lock, const char* lock_name, const Site& site,
+                   uint64_t hold_ns) {
+  std::lock_guard<std::mutex> stats_lock(stats_mutex_);
+  RollWindowInLock(QueryTimeNs());
+  auto& record = GetRecordInLock(lock, lock_name, site);
+  for (SiteStats* stats : {&record.current, &record.total}) {
+    stats->hold_ns += hold_ns;
+    stats->max_hold_ns = std::max(stats->max_hold_ns, hold_ns);
+  }
+}
+
+std::vector<SiteStats> GetLastSecond() { return CollectSorted(true); }
+
+std::vector<SiteStats> GetTotals() { return CollectSorted(false); }
+
+bool DumpJson(const std::filesystem::path& path) {
+  FILE* file = xe::filesystem::OpenFile(path, "w");
+  if (!file) {
+    XELOGE("Unable to write lock statistics to {}", xe::path_to_utf8(path));
+    return false;
+  }
+  auto write_sites = [file](const std::vector<SiteStats>& sites) {
+    for (size_t i = 0; i < sites.size(); ++i) {
+      auto& stats = sites[i];
+      fmt::print(file,
+                 "    {{\"lock\": \"{}\", \"address\": \"{}\", "
+                 "\"file\": \"{}\", \"line\": {}, \"acquisitions\": {}, "
+                 "\"contentions\": {}, \"wait_ns\": {}, \"max_wait_ns\": {}, "
+                 "\"hold_ns\": {}, \"max_hold_ns\": {}}}{}\n",
+                 EscapeJson(stats.lock_name), fmt::ptr(stats.lock),
+                 EscapeJson(stats.site.file), stats.site.line,
+                 stats.acquisitions, stats.contentions, stats.wait_ns,
+                 stats.max_wait_ns, stats.hold_ns, stats.max_hold_ns,
+                 i + 1 < sites.size() ? "," : "");
+    }
+  };
+  fmt::print(file, "{{\n  \"last_second\": [\n");
+  write_sites(GetLastSecond());
+  fmt::print(file, "  ],\n  \"total\": [\n");
+  write_sites(GetTotals());
+  fmt::print(file, "  ]\n}}\n");
+  fclose(file);
+  XELOGI("Wrote lock statistics to {}", xe::path_to_utf8(path));
+  return true;
+}
+
+}  // namespace lock_instrumentation
+}  // namespace xe
@@ -0,0 +1,64 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2022 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#ifndef XENIA_BASE_LOCK_INSTRUMENTATION_H_
+#define XENIA_BASE_LOCK_INSTRUMENTATION_H_
+
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+namespace xe {
+namespace lock_instrumentation {
+
+// Wait and hold times of instrumented locks (XE_ENABLE_LOCK_INSTRUMENTATION in
+// mutex.h), per lock and acquisition site. Recording takes an internal lock,
+// so this is only meant for finding which lock is the bottleneck, not for
+// measuring absolute overhead.
+
+struct Site {
+  const char* file = nullptr;
+  uint32_t line = 0;
+};
+
+struct SiteStats {
+  const void* lock = nullptr;
+  const char* lock_name = nullptr;
+  Site site;
+  uint64_t acquisitions = 0;
+  uint64_t contentions = 0;
+  uint64_t wait_ns = 0;
+  uint64_t max_wait_ns = 0;
+  uint64_t hold_ns = 0;
+  uint64_t max_hold_ns = 0;
+};
+
+uint64_t QueryTimeNs();
+
+// Attributes the next acquisition of an instrumented lock on this thread to
+// the given site. Without one, acquisitions are only keyed by the lock.
+void SetPendingSite(const char* file, uint32_t line);
+Site TakePendingSite();
+
+void RecordAcquire(const void* lock, const char* lock_name, const Site& site,
+                   bool contended, uint64_t wait_ns);
+void RecordRelease(const void* lock, const char* lock_name, const Site& site,
+                   uint64_t hold_ns);
+
+// Totals of the last complete second, sorted by descending wait time.
+std::vector<SiteStats> GetLastSecond();
+// Totals since startup, sorted by descending wait time.
+std::vector<SiteStats> GetTotals();
+
+bool DumpJson(const std::filesystem::path& path);
+
+}  // namespace lock_instrumentation
+}  // namespace xe
+
+#endif  // XENIA_BASE_LOCK_INSTRUMENTATION_H_
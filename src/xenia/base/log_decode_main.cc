@@ -0,0 +1,216 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2026 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "third_party/fmt/include/fmt/format.h"
+#include "xenia/base/console_app_main.h"
+#include "xenia/base/cvar.h"
+#include "xenia/base/filesystem.h"
+#include "xenia/base/logging.h"
+#include "xenia/base/logging_deferred.h"
+
+DEFINE_transient_path(log_binary, "",
+                      "Binary log file written with log_binary_file to "
+                      "format.",
+                      "Logging");
+DEFINE_path(log_decode_output, "",
+            "Text file to write the formatted log to, or empty to write to "
+            "the standard output.",
+            "Logging");
+
+namespace xe {
+namespace logging {
+namespace deferred {
+
+class BinaryLogDecoder {
+ public:
+  BinaryLogDecoder(FILE* in, FILE* out) : in_(in), out_(out) {}
+
+  // Returns false if the file is not a binary log. Stops at the first
+  // truncated or malformed entry, which is reported via is_corrupted().
+  bool Decode();
+
+  bool is_corrupted() const { return is_corrupted_; }
+  uint64_t line_count() const { return line_count_; }
+
+ private:
+  template <typename T>
+  bool Read(T& value) {
+    return fread(&value, sizeof(value), 1, in_) == 1;
+  }
+  bool Read(std::vector<char>& data, uint32_t size) {
+    data.resize(size);
+    return !size || fread(data.data(), 1, size, in_) == size;
+  }
+
+  bool DecodeFormat();
+  bool DecodeDeferredLine();
+  bool DecodeTextLine();
+  void WriteLine(uint32_t thread_id, char prefix_char, const char* text,
+                 size_t text_length);
+
+  FILE* in_;
+  FILE* out_;
+  std::vector<std::string> formats_;
+  std::vector<char> args_;
+  std::vector<char> text_;
+  char formatted_[64 * 1024];
+  bool is_corrupted_ = false;
+  uint64_t line_count_ = 0;
+};
+
+bool BinaryLogDecoder::Decode() {
+  BinaryLogFileHeader header;
+  if (!Read(header) || header.magic != BinaryLogFileHeader::kMagic) {
+    XELOGE("The file is not a binary log");
+    return false;
+  }
+  if (header.version != BinaryLogFileHeader::kVersion) {
+    XELOGE("Unsupported binary log version {}, expected {}", header.version,
+           BinaryLogFileHeader::kVersion);
+    return false;
+  }
+  BinaryLogEntryType entry_type;
+  while (Read(entry_type)) {
+    bool decoded;
+    switch (entry_type) {
+      case BinaryLogEntryType::kFormat:
+        decoded = DecodeFormat();
+        break;
+      case BinaryLogEntryType::kDeferredLine:
+        decoded = DecodeDeferredLine();
+        break;
+      case BinaryLogEntryType::kTextLine:
+        decoded = DecodeTextLine();
+        break;
+      default:
+        decoded = false;
+        break;
+    }
+    if (!decoded) {
+      is_corrupted_ = true;
+      break;
+    }
+  }
+  return true;
+}
+
+bool BinaryLogDecoder::DecodeFormat() {
+  uint32_t format_id, format_length;
+  if (!Read(format_id) || !Read(format_length) ||
+      format_id != formats_.size() || !Read(text_, format_length)) {
+    return false;
+  }
+  formats_.emplace_back(text_.data(), text_.size());
+  return true;
+}
+
+bool BinaryLogDecoder::DecodeDeferredLine() {
+  uint32_t thread_id, format_id, arg_count, args_size;
+  char prefix_char;
+  if (!Read(thread_id) || !Read(prefix_char) || !Read(format_id) ||
+      !Read(arg_count) || !Read(args_size) || format_id >= formats_.size() ||
+      !Read(args_, args_size)) {
+    return false;
+  }
+  size_t formatted_length = FormatArgs(
+      formats_[format_id], arg_count,
+      reinterpret_cast<const uint8_t*>(args_.data()), args_.size(), formatted_,
+      sizeof(formatted_));
+  if (!formatted_length) {
+    static const char kMalformedText[] =
+        "(Failed to format a deferred log line)";
+    WriteLine(thread_id, prefix_char, kMalformedText,
+              sizeof(kMalformedText) - 1);
+    return true;
+  }
+  WriteLine(thread_id, prefix_char, formatted_, formatted_length);
+  return true;
+}
+
+bool BinaryLogDecoder::DecodeTextLine() {
+  uint32_t thread_id, text_length;
+  char prefix_char;
+  if (!Read(thread_id) || !Read(prefix_char) || !Read(text_length) ||
+      !Read(text_, text_length)) {
+    return false;
+  }
+  WriteLine(thread_id, prefix_char, text_.data(), text_.size());
+  return true;
+}
+
+void BinaryLogDecoder::WriteLine(uint32_t thread_id, char prefix_char,
+                                 const char* text, size_t text_length) {
+  // Same as the text log sinks.
+  if (prefix_char) {
+    fmt::print(out_, "{}> {:08X} ", prefix_char, thread_id);
+  }
+  if (text_length) {
+    fwrite(text, 1, text_length, out_);
+    if (text[text_length - 1] != '\n') {
+      fputc('\n', out_);
+    }
+  }
+  ++line_count_;
+}
+
+int log_decode_main(const std::vector<std::string>& args) {
+  if (cvars::log_binary.empty()) {
+    XELOGE("Usage: {} [log_binary]", xe::path_to_utf8(args[0]));
+    return 1;
+  }
+
+  FILE* in = xe::filesystem::OpenFile(cvars::log_binary, "rb");
+  if (!in) {
+    XELOGE("Failed to open the binary log {}",
+           xe::path_to_utf8(cvars::log_binary));
+    return 1;
+  }
+  FILE* out = stdout;
+  if (!cvars::log_decode_output.empty()) {
+    xe::filesystem::CreateParentFolder(cvars::log_decode_output);
+    out = xe::filesystem::OpenFile(cvars::log_decode_output, "wb");
+    if (!out) {
+      XELOGE("Failed to open the output file {}",
+             xe::path_to_utf8(cvars::log_decode_output));
+      fclose(in);
+      return 1;
+    }
+  }
+
+  auto decoder = std::make_unique<BinaryLogDecoder>(in, out);
+  bool succeeded = decoder->Decode();
+  if (succeeded) {
+    if (decoder->is_corrupted()) {
+      XELOGW("The binary log is truncated or corrupted after line {}",
+             decoder->line_count());
+    }
+    XELOGI("Decoded {} lines", decoder->line_count());
+  }
+
+  fclose(in);
+  if (out != stdout) {
+    fclose(out);
+  } else {
+    fflush(out);
+  }
+  return succeeded ? 0 : 1;
+}
+
+}  // namespace deferred
+}  // namespace logging
+}  // namespace xe
+
+XE_DEFINE_CONSOLE_APP("xenia-log-decode",
+                      xe::logging::deferred::log_decode_main, "[log_binary]",
+                      "log_binary");
@@ -14,6 +14,8 @@
 #include <cstdlib>
 #include <cstring>
 #include <mutex>
+#include <string>
+#include <unordered_map>
 #include <vector>
 
 #include "third_party/disruptorplus/include/disruptorplus/multi_threaded_claim_strategy.hpp"
@@ -27,6 +29,7 @@
 #include "xenia/base/debugging.h"
 #include "xenia/base/filesystem.h"
 #include "xenia/base/literals.h"
+#include "xenia/base/logging_deferred.h"
 #include "xenia/base/math.h"
 #include "xenia/base/memory.h"
 #include "xenia/base/platform.h"
@@ -55,6 +58,17 @@ DEFINE_bool(log_to_debugprint, false, "Dump the log to DebugPrint.", "Logging");
 #endif  // XE_PLATFORM_ANDROID
 DEFINE_bool(flush_log, true, "Flush log file after each log line batch.",
             "Logging");
+DEFINE_bool(log_deferred_formatting, false,
+            "Store the format string and the arguments of log lines with only "
+            "basic argument types, and format them on the log writer thread "
+            "rather than on the logging thread.",
+            "Logging");
+DEFINE_path(log_binary_file, "",
+            "Write the log in the binary form to the given file instead of "
+            "the text log file, with the formatting of the lines that allow "
+            "it deferred to xenia-log-decode (implies "
+            "log_deferred_formatting).",
+            "Logging");
 
 DEFINE_uint32(log_mask, 0,
               "Disables specific categorizes for more granular debug logging. "
@@ -67,6 +81,7 @@ DEFINE_int32(
     "Logging");
 
 namespace dp = disruptorplus;
+namespace deferred = xe::logging::deferred;
 using namespace xe::literals;
 
 namespace xe {
@@ -78,11 +93,15 @@ Logger* logger_ = nullptr;
 struct LogLine {
   size_t buffer_length;
   uint32_t thread_id;
-  uint16_t _pad_0;  // (2b) padding
+  // The buffer contains a logging::deferred record rather than the text.
+  bool is_deferred;
+  uint8_t _pad_0;  // (1b) padding
   bool terminate;
   char prefix_char;
 };
 
+bool defer_formatting_ = false;
+
 thread_local char thread_log_buffer_[64_KiB];
 
 FileLogSink::~FileLogSink() {
@@ -235,14 +254,25 @@ class Logger {
   }
 
   ~Logger() {
-    AppendLine(0, '\0', nullptr, 0, true);  // append a terminator
+    AppendLine(0, '\0', nullptr, 0, false, true);  // append a terminator
     xe::threading::Wait(write_thread_.get(), true);
+    if (binary_file_) {
+      fclose(binary_file_);
+    }
   }
 
   void AddLogSink(std::unique_ptr<LogSink>&& sink) {
     sinks_.push_back(std::move(sink));
   }
 
+  void SetBinaryFile(FILE* file) {
+    deferred::BinaryLogFileHeader header;
+    header.magic = deferred::BinaryLogFileHeader::kMagic;
+    header.version = deferred::BinaryLogFileHeader::kVersion;
+    fwrite(&header, sizeof(header), 1, file);
+    binary_file_ = file;
+  }
+
  private:
   static const size_t kBufferSize = 8_MiB;
   uint8_t buffer_[kBufferSize];
@@ -268,6 +298,14 @@ class Logger {
 
   std::vector<std::unique_ptr<LogSink>> sinks_;
 
+  // Only accessed by the writer thread after being set.
+  FILE* binary_file_ = nullptr;
+  std::unordered_map<std::string, uint32_t> binary_format_ids_;
+  // Deferred records gathered from the ring buffer and formatted by the writer
+  // thread.
+  std::vector<uint8_t> deferred_record_;
+  char deferred_line_[64_KiB];
+
   std::unique_ptr<xe::threading::Thread> write_thread_;
 
   void Write(const char* buf, size_t size) {
@@ -276,6 +314,60 @@ class Logger {
     }
   }
 
+  template <typename T>
+  void WriteBinary(const T& value) {
+    fwrite(&value, sizeof(value), 1, binary_file_);
+  }
+
+  void WriteBinaryDeferredLine(const LogLine& line) {
+    deferred::DeferredRecordHeader record_header;
+    if (deferred_record_.size() < sizeof(record_header)) {
+      return;
+    }
+    std::memcpy(&record_header, deferred_record_.data(),
+                sizeof(record_header));
+    size_t args_offset = sizeof(record_header) + record_header.format_length;
+    if (deferred_record_.size() < args_offset) {
+      return;
+    }
+    std::string format(
+        reinterpret_cast<const char*>(deferred_record_.data()) +
+            sizeof(record_header),
+        record_header.format_length);
+    auto format_it = binary_format_ids_.find(format);
+    if (format_it == binary_format_ids_.end()) {
+      uint32_t format_id = uint32_t(binary_format_ids_.size());
+      WriteBinary(deferred::BinaryLogEntryType::kFormat);
+      WriteBinary(format_id);
+      WriteBinary(record_header.format_length);
+      fwrite(format.data(), 1, format.size(), binary_file_);
+      format_it =
+          binary_format_ids_.emplace(std::move(format), format_id).first;
+    }
+    WriteBinary(deferred::BinaryLogEntryType::kDeferredLine);
+    WriteBinary(line.thread_id);
+    WriteBinary(line.prefix_char);
+    WriteBinary(format_it->second);
+    WriteBinary(record_header.arg_count);
+    WriteBinary(uint32_t(deferred_record_.size() - args_offset));
+    fwrite(deferred_record_.data() + args_offset, 1,
+           deferred_record_.size() - args_offset, binary_file_);
+  }
+
+  void WriteBinaryTextLine(const LogLine& line,
+                           const RingBuffer::ReadRange& line_range) {
+    WriteBinary(deferred::BinaryLogEntryType::kTextLine);
+    WriteBinary(line.thread_id);
+    WriteBinary(line.prefix_char);
+    WriteBinary(uint32_t(line.buffer_length));
+    if (line.buffer_length) {
+      fwrite(line_range.first, 1, line_range.first_length, binary_file_);
+      if (line_range.second_length) {
+        fwrite(line_range.second, 1, line_range.second_length, binary_file_);
+      }
+    }
+  }
+
   void WriteThread() {
     RingBuffer rb(buffer_, kBufferSize);
 
@@ -315,6 +407,48 @@ class Logger {
           read_count += needed_count;
           i += needed_count;
 
+          RingBuffer::ReadRange line_range = {};
+          if (line.buffer_length) {
+            // Get access to the line data - which may be split in the ring
+            // buffer.
+            line_range = rb.BeginRead(line.buffer_length);
+          }
+          const char* text_first =
+              reinterpret_cast<const char*>(line_range.first);
+          size_t text_first_length = line_range.first_length;
+          const char* text_second =
+              reinterpret_cast<const char*>(line_range.second);
+          size_t text_second_length = line_range.second_length;
+          if (line.is_deferred) {
+            deferred_record_.resize(line.buffer_length);
+            std::memcpy(deferred_record_.data(), line_range.first,
+                        line_range.first_length);
+            if (line_range.second_length) {
+              std::memcpy(deferred_record_.data() + line_range.first_length,
+                          line_range.second, line_range.second_length);
+            }
+            if (binary_file_) {
+              WriteBinaryDeferredLine(line);
+            }
+            // Only formatting if not writing just the binary file.
+            if (!sinks_.empty()) {
+              text_first = deferred_line_;
+              text_first_length = deferred::FormatRecord(
+                  deferred_record_.data(), deferred_record_.size(),
+                  deferred_line_, sizeof(deferred_line_));
+              if (!text_first_length) {
+                static const char kMalformedText[] =
+                    "(Failed to format a deferred log line)";
+                text_first = kMalformedText;
+                text_first_length = sizeof(kMalformedText) - 1;
+              }
+              text_second = nullptr;
+              text_second_length = 0;
+            }
+          } else if (binary_file_ && !line.terminate) {
+            WriteBinaryTextLine(line, line_range);
+          }
+
           if (line.prefix_char) {
             char prefix[] = {
                 line.prefix_char,
@@ -336,34 +470,31 @@ class Logger {
             Write(prefix, sizeof(prefix) - 1);
           }
 
-          if (line.buffer_length) {
-            // Get access to the line data - which may be split in the ring
-            // buffer - and write it out in parts.
-            auto line_range = rb.BeginRead(line.buffer_length);
-            Write(reinterpret_cast<const char*>(line_range.first),
-                  line_range.first_length);
-            if (line_range.second_length) {
-              Write(reinterpret_cast<const char*>(line_range.second),
-                    line_range.second_length);
+          if (text_first_length) {
+            // Write the line out in parts.
+            Write(text_first, text_first_length);
+            if (text_second_length) {
+              Write(text_second, text_second_length);
             }
 
             // Always ensure there is a newline.
-            char last_char =
-                line_range.second
-                    ? line_range.second[line_range.second_length - 1]
-                    : line_range.first[line_range.first_length - 1];
+            char last_char = text_second_length
+                                 ? text_second[text_second_length - 1]
+                                 : text_first[text_first_length - 1];
             if (last_char != '\n') {
               const char suffix[1] = {'\n'};
               Write(suffix, 1);
             }
-
-            rb.EndRead(std::move(line_range));
           } else {
             // Always ensure there is a newline.
             const char suffix[1] = {'\n'};
             Write(suffix, 1);
           }
 
+          if (line.buffer_length) {
+            rb.EndRead(std::move(line_range));
+          }
+
           if (line.terminate) {
             terminate = true;
             break;
@@ -388,6 +519,9 @@ class Logger {
           for (const auto& sink : sinks_) {
             sink->Flush();
           }
+          if (binary_file_) {
+            fflush(binary_file_);
+          }
         }
 
         idle_loops = 0;
@@ -405,7 +539,7 @@ class Logger {
  public:
   void AppendLine(uint32_t thread_id, const char prefix_char,
                   const char* buffer_data, size_t buffer_length,
-                  bool terminate = false) {
+                  bool is_deferred = false, bool terminate = false) {
     size_t count = BlockCount(sizeof(LogLine) + buffer_length);
 
     auto range = claim_strategy_.claim(count);
@@ -419,6 +553,7 @@ class Logger {
     line.buffer_length = buffer_length;
     line.thread_id = thread_id;
     line.prefix_char = prefix_char;
+    line.is_deferred = is_deferred;
     line.terminate = terminate;
 
     rb.Write(&line, sizeof(LogLine));
@@ -434,6 +569,18 @@ void InitializeLogging(const std::string_view app_name) {
   auto mem = memory::AlignedAlloc<Logger>(0x10);
   logger_ = new (mem) Logger(app_name);
 
+  // Set up before any line is appended, so the writer thread sees it.
+  bool is_binary_file_open = false;
+  if (!cvars::log_binary_file.empty()) {
+    xe::filesystem::CreateParentFolder(cvars::log_binary_file);
+    FILE* binary_file = xe::filesystem::OpenFile(cvars::log_binary_file, "wb");
+    if (binary_file) {
+      logger_->SetBinaryFile(binary_file);
+      is_binary_file_open = true;
+    }
+  }
+  defer_formatting_ = cvars::log_deferred_formatting || is_binary_file_open;
+
 #if XE_PLATFORM_ANDROID
   // TODO(Triang3l): Enable file logging, but not by default as logs may be
   // huge.
@@ -441,17 +588,19 @@ void InitializeLogging(const std::string_view app_name) {
     logger_->AddLogSink(std::make_unique<AndroidLogSink>(app_name));
   }
 #else
-  FILE* log_file = nullptr;
-  if (cvars::log_file.empty()) {
-    // Default to app name.
-    auto file_name = fmt::format("{}.log", app_name);
-    auto file_path = xe::filesystem::GetExecutableFolder() / file_name;
-    log_file = xe::filesystem::OpenFile(file_path, "wt");
-  } else {
-    xe::filesystem::CreateParentFolder(cvars::log_file);
-    log_file = xe::filesystem::OpenFile(cvars::log_file, "wt");
+  if (!is_binary_file_open) {
+    FILE* log_file = nullptr;
+    if (cvars::log_file.empty()) {
+      // Default to app name.
+      auto file_name = fmt::format("{}.log", app_name);
+      auto file_path = xe::filesystem::GetExecutableFolder() / file_name;
+      log_file = xe::filesystem::OpenFile(file_path, "wt");
+    } else {
+      xe::filesystem::CreateParentFolder(cvars::log_file);
+      log_file = xe::filesystem::OpenFile(cvars::log_file, "wt");
+    }
+    logger_->AddLogSink(std::make_unique<FileLogSink>(log_file, true));
   }
-  logger_->AddLogSink(std::make_unique<FileLogSink>(log_file, true));
 
   if (cvars::log_to_stdout) {
     logger_->AddLogSink(std::make_unique<FileLogSink>(stdout, false));
@@ -469,6 +618,7 @@ void ShutdownLogging() {
 
   logger->~Logger();
   memory::AlignedFree(logger);
+  defer_formatting_ = false;
 }
 
 static int g_saved_loglevel = static_cast<int>(LogLevel::Disabled);
@@ -497,6 +647,19 @@ void logging::internal::AppendLogLine(LogLevel log_level,
                       thread_log_buffer_, written);
 }
 
+bool logging::internal::IsFormattingDeferred() { return defer_formatting_; }
+
+XE_NOALIAS
+void logging::internal::AppendDeferredLogLine(LogLevel log_level,
+                                              const char prefix_char,
+                                              size_t written) {
+  if (!logger_ || !ShouldLog(log_level) || !written) {
+    return;
+  }
+  logger_->AppendLine(xe::threading::current_thread_id(), prefix_char,
+                      thread_log_buffer_, written, true);
+}
+
 void logging::AppendLogLine(LogLevel log_level, const char prefix_char,
                             const std::string_view str, uint32_t log_mask) {
   if (!internal::ShouldLog(log_level, log_mask) || !str.size()) {
@@ -15,6 +15,7 @@
 #include <string>
 
 #include "third_party/fmt/include/fmt/format.h"
+#include "xenia/base/logging_deferred.h"
 #include "xenia/base/string.h"
 
 namespace xe {
@@ -90,6 +91,12 @@ uint32_t GetLogLevel();
 std::pair<char*, size_t> GetThreadBuffer();
 XE_NOALIAS
 void AppendLogLine(LogLevel log_level, const char prefix_char, size_t written);
+// Whether lines should be stored as logging::deferred records when possible.
+bool IsFormattingDeferred();
+// Appends a logging::deferred record from the thread buffer.
+XE_NOALIAS
+void AppendDeferredLogLine(LogLevel log_level, const char prefix_char,
+                           size_t written);
 
 }  // namespace internal
 // technically, noalias is incorrect here, these functions do in fact alias
@@ -101,6 +108,17 @@ XE_NOALIAS XE_NOINLINE XE_COLD static void AppendLogLineFormat_Impl(
     LogLevel log_level, const char prefix_char, const char* format,
     const Args&... args) {
   auto target = internal::GetThreadBuffer();
+  if constexpr (deferred::kIsDeferrable<Args...>) {
+    if (internal::IsFormattingDeferred()) {
+      size_t record_size = deferred::EncodeRecord(target.first, target.second,
+                                                  format, args...);
+      // Formatted immediately if too long.
+      if (record_size) {
+        internal::AppendDeferredLogLine(log_level, prefix_char, record_size);
+        return;
+      }
+    }
+  }
   auto result = fmt::format_to_n(target.first, target.second, format, args...);
   internal::AppendLogLine(log_level, prefix_char, result.size);
 }
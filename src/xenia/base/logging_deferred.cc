@@ -0,0 +1,137 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2026 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/base/logging_deferred.h"
+
+#include <algorithm>
+
+#include "third_party/fmt/include/fmt/args.h"
+#include "third_party/fmt/include/fmt/format.h"
+
+namespace xe {
+namespace logging {
+namespace deferred {
+
+namespace {
+
+template <typename T>
+bool PushValue(fmt::dynamic_format_arg_store<fmt::format_context>& store,
+               const uint8_t*& args, const uint8_t* args_end) {
+  if (size_t(args_end - args) < sizeof(T)) {
+    return false;
+  }
+  T value;
+  std::memcpy(&value, args, sizeof(T));
+  args += sizeof(T);
+  store.push_back(value);
+  return true;
+}
+
+}  // namespace
+
+size_t FormatArgs(std::string_view format, uint32_t arg_count,
+                  const uint8_t* args, size_t args_size, char* out,
+                  size_t out_size) {
+  fmt::dynamic_format_arg_store<fmt::format_context> store;
+  store.reserve(arg_count, 0);
+  const uint8_t* args_end = args + args_size;
+  for (uint32_t i = 0; i < arg_count; ++i) {
+    if (args == args_end) {
+      return 0;
+    }
+    auto type = DeferredArgType(*(args++));
+    bool pushed;
+    switch (type) {
+      case DeferredArgType::kBool:
+        pushed = PushValue<bool>(store, args, args_end);
+        break;
+      case DeferredArgType::kChar:
+        pushed = PushValue<char>(store, args, args_end);
+        break;
+      case DeferredArgType::kInt32:
+        pushed = PushValue<int32_t>(store, args, args_end);
+        break;
+      case DeferredArgType::kUint32:
+        pushed = PushValue<uint32_t>(store, args, args_end);
+        break;
+      case DeferredArgType::kInt64:
+        pushed = PushValue<int64_t>(store, args, args_end);
+        break;
+      case DeferredArgType::kUint64:
+        pushed = PushValue<uint64_t>(store, args, args_end);
+        break;
+      case DeferredArgType::kFloat:
+        pushed = PushValue<float>(store, args, args_end);
+        break;
+      case DeferredArgType::kDouble:
+        pushed = PushValue<double>(store, args, args_end);
+        break;
+      case DeferredArgType::kPointer: {
+        uint64_t pointer;
+        pushed = size_t(args_end - args) >= sizeof(pointer);
+        if (pushed) {
+          std::memcpy(&pointer, args, sizeof(pointer));
+          args += sizeof(pointer);
+          store.push_back(reinterpret_cast<const void*>(uintptr_t(pointer)));
+        }
+      } break;
+      case DeferredArgType::kString: {
+        uint32_t length;
+        pushed = size_t(args_end - args) >= sizeof(length);
+        if (pushed) {
+          std::memcpy(&length, args, sizeof(length));
+          args += sizeof(length);
+          pushed = size_t(args_end - args) >= length;
+        }
+        if (pushed) {
+          // Not copied by the store, referencing the record.
+          store.push_back(
+              std::string_view(reinterpret_cast<const char*>(args), length));
+          args += length;
+        }
+      } break;
+      default:
+        pushed = false;
+        break;
+    }
+    if (!pushed) {
+      return 0;
+    }
+  }
+  try {
+    return std::min(
+        fmt::vformat_to_n(out, out_size, fmt::string_view(format), store)
+            .size,
+        out_size);
+  } catch (const fmt::format_error&) {
+    return 0;
+  }
+}
+
+size_t FormatRecord(const uint8_t* record, size_t record_size, char* out,
+                    size_t out_size) {
+  DeferredRecordHeader header;
+  if (record_size < sizeof(header)) {
+    return 0;
+  }
+  std::memcpy(&header, record, sizeof(header));
+  size_t args_offset = sizeof(header) + header.format_length;
+  if (record_size < args_offset) {
+    return 0;
+  }
+  return FormatArgs(
+      std::string_view(reinterpret_cast<const char*>(record + sizeof(header)),
+                       header.format_length),
+      header.arg_count, record + args_offset, record_size - args_offset, out,
+      out_size);
+}
+
+}  // namespace deferred
+}  // namespace logging
+}  // namespace xe
@@ -0,0 +1,217 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2026 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#ifndef XENIA_BASE_LOGGING_DEFERRED_H_
+#define XENIA_BASE_LOGGING_DEFERRED_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+namespace xe {
+namespace logging {
+namespace deferred {
+
+// Log lines with formatting deferred to the log writer thread or to an offline
+// decoder. A record contains the format string and the raw arguments, each
+// prefixed with its type:
+//   DeferredRecordHeader
+//   char format[format_length]
+//   {DeferredArgType type, payload}[arg_count]
+// Strings are stored as a uint32_t length followed by the characters, other
+// values as their host representation. Everything is unaligned.
+//
+// Only lines with arguments of the types below may be deferred, others are
+// formatted immediately, as custom formatters may depend on state that may
+// change before the line is written.
+
+enum class DeferredArgType : uint8_t {
+  kBool,
+  kChar,
+  kInt32,
+  kUint32,
+  kInt64,
+  kUint64,
+  kFloat,
+  kDouble,
+  kPointer,
+  kString,
+};
+
+struct DeferredRecordHeader {
+  uint32_t format_length;
+  uint32_t arg_count;
+};
+
+template <typename T, typename = void>
+struct DeferredArg {
+  static constexpr bool kIsSupported = false;
+};
+
+template <typename T>
+struct DeferredArgValue {
+  static constexpr bool kIsSupported = true;
+  static size_t GetSize(const T& value) { return sizeof(value); }
+  static void Write(uint8_t* out, const T& value) {
+    std::memcpy(out, &value, sizeof(value));
+  }
+};
+
+template <>
+struct DeferredArg<bool> : DeferredArgValue<bool> {
+  static constexpr DeferredArgType kType = DeferredArgType::kBool;
+};
+template <>
+struct DeferredArg<char> : DeferredArgValue<char> {
+  static constexpr DeferredArgType kType = DeferredArgType::kChar;
+};
+template <>
+struct DeferredArg<float> : DeferredArgValue<float> {
+  static constexpr DeferredArgType kType = DeferredArgType::kFloat;
+};
+template <>
+struct DeferredArg<double> : DeferredArgValue<double> {
+  static constexpr DeferredArgType kType = DeferredArgType::kDouble;
+};
+
+// Integers other than char, widened to 32 or 64 bits preserving the
+// signedness, so format specifications behave the same.
+template <typename T>
+struct DeferredArg<
+    T, std::enable_if_t<std::is_integral_v<T> && !std::is_same_v<T, bool> &&
+                        !std::is_same_v<T, char>>> {
+  static constexpr bool kIsSupported = true;
+  static constexpr bool kIs64Bit = sizeof(T) > sizeof(uint32_t);
+  using StoredType = std::conditional_t<
+      std::is_signed_v<T>, std::conditional_t<kIs64Bit, int64_t, int32_t>,
+      std::conditional_t<kIs64Bit, uint64_t, uint32_t>>;
+  static constexpr DeferredArgType kType =
+      std::is_signed_v<T>
+          ? (kIs64Bit ? DeferredArgType::kInt64 : DeferredArgType::kInt32)
+          : (kIs64Bit ? DeferredArgType::kUint64 : DeferredArgType::kUint32);
+  static size_t GetSize(T value) { return sizeof(StoredType); }
+  static void Write(uint8_t* out, T value) {
+    StoredType stored = StoredType(value);
+    std::memcpy(out, &stored, sizeof(stored));
+  }
+};
+
+template <typename T>
+struct DeferredArg<T*,
+                   std::enable_if_t<std::is_void_v<std::remove_cv_t<T>>>> {
+  static constexpr bool kIsSupported = true;
+  static constexpr DeferredArgType kType = DeferredArgType::kPointer;
+  static size_t GetSize(const void* value) { return sizeof(uint64_t); }
+  static void Write(uint8_t* out, const void* value) {
+    uint64_t stored = uint64_t(uintptr_t(value));
+    std::memcpy(out, &stored, sizeof(stored));
+  }
+};
+
+struct DeferredArgString {
+  static constexpr bool kIsSupported = true;
+  static constexpr DeferredArgType kType = DeferredArgType::kString;
+  static size_t GetSize(std::string_view value) {
+    return sizeof(uint32_t) + value.size();
+  }
+  static void Write(uint8_t* out, std::string_view value) {
+    uint32_t length = uint32_t(value.size());
+    std::memcpy(out, &length, sizeof(length));
+    std::memcpy(out + sizeof(length), value.data(), value.size());
+  }
+};
+template <>
+struct DeferredArg<std::string_view> : DeferredArgString {};
+template <>
+struct DeferredArg<std::string> : DeferredArgString {};
+template <>
+struct DeferredArg<const char*> : DeferredArgString {};
+template <>
+struct DeferredArg<char*> : DeferredArgString {};
+
+template <typename... Args>
+constexpr bool kIsDeferrable =
+    (DeferredArg<std::decay_t<Args>>::kIsSupported && ...);
+
+// Returns the size of the record, or 0 if it doesn't fit in the buffer.
+template <typename... Args>
+size_t EncodeRecord(char* out, size_t out_size, const char* format,
+                    const Args&... args) {
+  static_assert(kIsDeferrable<Args...>);
+  size_t format_length = std::strlen(format);
+  size_t record_size =
+      sizeof(DeferredRecordHeader) + format_length +
+      ((sizeof(DeferredArgType) +
+        DeferredArg<std::decay_t<Args>>::GetSize(args)) +
+       ... + 0);
+  if (record_size > out_size) {
+    return 0;
+  }
+  auto out_bytes = reinterpret_cast<uint8_t*>(out);
+  DeferredRecordHeader header;
+  header.format_length = uint32_t(format_length);
+  header.arg_count = uint32_t(sizeof...(Args));
+  std::memcpy(out_bytes, &header, sizeof(header));
+  out_bytes += sizeof(header);
+  std::memcpy(out_bytes, format, format_length);
+  out_bytes += format_length;
+  (
+      [&](const auto& arg) {
+        using Arg = DeferredArg<std::decay_t<decltype(arg)>>;
+        *(out_bytes++) = uint8_t(Arg::kType);
+        Arg::Write(out_bytes, arg);
+        out_bytes += Arg::GetSize(arg);
+      }(args),
+      ...);
+  return record_size;
+}
+
+// Formats the arguments of a deferred record (following the format string) to
+// the buffer, returns the number of characters written, which is 0 if the
+// arguments are malformed or don't match the format string.
+size_t FormatArgs(std::string_view format, uint32_t arg_count,
+                  const uint8_t* args, size_t args_size, char* out,
+                  size_t out_size);
+
+// Formats a whole record written by EncodeRecord.
+size_t FormatRecord(const uint8_t* record, size_t record_size, char* out,
+                    size_t out_size);
+
+// Binary log files written with the log_binary_file option, to be formatted
+// offline with xenia-log-decode. All the fields are in the host byte order.
+// The file header is followed by entries, each starting with the
+// BinaryLogEntryType.
+struct BinaryLogFileHeader {
+  static constexpr uint32_t kMagic = 0x474F4C58;  // 'XLOG'
+  static constexpr uint32_t kVersion = 1;
+
+  uint32_t magic;
+  uint32_t version;
+};
+
+enum class BinaryLogEntryType : uint8_t {
+  // Introduces a format string - uint32_t ID (sequential from 0), uint32_t
+  // length, characters - before the first line using it.
+  kFormat,
+  // uint32_t thread ID, char prefix, uint32_t format ID, uint32_t argument
+  // count, uint32_t size of the arguments, arguments as in the record.
+  kDeferredLine,
+  // uint32_t thread ID, char prefix, uint32_t length, characters, for lines
+  // formatted immediately.
+  kTextLine,
+};
+
+}  // namespace deferred
+}  // namespace logging
+}  // namespace xe
+
+#endif  // XENIA_BASE_LOGGING_DEFERRED_H_
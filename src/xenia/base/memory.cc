@@ -10,6 +10,7 @@
 #include "xenia/base/memory.h"
 #include "xenia/base/cvar.h"
 #include "xenia/base/logging.h"
+#include "xenia/base/math.h"
 #include "xenia/base/platform.h"
 
 #if XE_ARCH_ARM64
@@ -17,6 +18,7 @@
 #endif
 
 #include <algorithm>
+#include <cstring>
 
 DEFINE_bool(
     writable_executable_memory, true,
@@ -218,6 +220,52 @@ void vastcpy(uint8_t* XE_RESTRICT physaddr, uint8_t* XE_RESTRICT rdmapping,
   return vastcpy_dispatch((CacheLine*)physaddr, (CacheLine*)rdmapping,
                           written_length);
 }
+
+void fill_streaming(void* dest, uint8_t value, size_t size) {
+#if XE_ARCH_AMD64
+  auto dest_bytes = reinterpret_cast<uint8_t*>(dest);
+  size_t head_size =
+      std::min(size, size_t((0 - reinterpret_cast<uintptr_t>(dest)) & 31));
+  std::memset(dest_bytes, value, head_size);
+  dest_bytes += head_size;
+  size -= head_size;
+  __m256i fill = _mm256_set1_epi8(char(value));
+  for (; size >= 64; size -= 64, dest_bytes += 64) {
+    _mm256_stream_si256(reinterpret_cast<__m256i*>(dest_bytes), fill);
+    _mm256_stream_si256(reinterpret_cast<__m256i*>(dest_bytes + 32), fill);
+  }
+  swcache::WriteFence();
+  std::memset(dest_bytes, value, size);
+#else
+  std::memset(dest, value, size);
+#endif  // XE_ARCH_AMD64
+}
+
+void copy_streaming(void* XE_RESTRICT dest, const void* XE_RESTRICT src,
+                    size_t size) {
+#if XE_ARCH_AMD64
+  auto dest_bytes = reinterpret_cast<uint8_t*>(dest);
+  auto src_bytes = reinterpret_cast<const uint8_t*>(src);
+  size_t head_size =
+      std::min(size, size_t((0 - reinterpret_cast<uintptr_t>(dest)) & 31));
+  std::memcpy(dest_bytes, src_bytes, head_size);
+  dest_bytes += head_size;
+  src_bytes += head_size;
+  size -= head_size;
+  for (; size >= 64; size -= 64, dest_bytes += 64, src_bytes += 64) {
+    __m256i data0 =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src_bytes));
+    __m256i data1 =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src_bytes + 32));
+    _mm256_stream_si256(reinterpret_cast<__m256i*>(dest_bytes), data0);
+    _mm256_stream_si256(reinterpret_cast<__m256i*>(dest_bytes + 32), data1);
+  }
+  swcache::WriteFence();
+  std::memcpy(dest_bytes, src_bytes, size);
+#else
+  std::memcpy(dest, src, size);
+#endif  // XE_ARCH_AMD64
+}
 }  // namespace memory
 
 // TODO(benvanik): fancy AVX versions.
@@ -244,8 +292,8 @@ void copy_128_aligned(void* dest, const void* src, size_t count) {
 #else
 #define XE_WORKAROUND_CONSTANT_RETURN_IF(x)
 #endif
-void copy_and_swap_16_aligned(void* dest_ptr, const void* src_ptr,
-                              size_t count) {
+static void copy_and_swap_16_aligned_sse(void* dest_ptr, const void* src_ptr,
+                                         size_t count) {
   assert_zero(reinterpret_cast<uintptr_t>(dest_ptr) & 0xF);
   assert_zero(reinterpret_cast<uintptr_t>(src_ptr) & 0xF);
 
@@ -267,8 +315,8 @@ void copy_and_swap_16_aligned(void* dest_ptr, const void* src_ptr,
   }
 }
 
-void copy_and_swap_16_unaligned(void* dest_ptr, const void* src_ptr,
-                                size_t count) {
+static void copy_and_swap_16_unaligned_sse(void* dest_ptr, const void* src_ptr,
+                                           size_t count) {
   auto dest = reinterpret_cast<uint16_t*>(dest_ptr);
   auto src = reinterpret_cast<const uint16_t*>(src_ptr);
   __m128i shufmask =
@@ -287,8 +335,8 @@ void copy_and_swap_16_unaligned(void* dest_ptr, const void* src_ptr,
   }
 }
 
-void copy_and_swap_32_aligned(void* dest_ptr, const void* src_ptr,
-                              size_t count) {
+static void copy_and_swap_32_aligned_sse(void* dest_ptr, const void* src_ptr,
+                                         size_t count) {
   assert_zero(reinterpret_cast<uintptr_t>(dest_ptr) & 0xF);
   assert_zero(reinterpret_cast<uintptr_t>(src_ptr) & 0xF);
 
@@ -310,68 +358,19 @@ void copy_and_swap_32_aligned(void* dest_ptr, const void* src_ptr,
   }
 }
 
-void copy_and_swap_32_unaligned(void* dest_ptr, const void* src_ptr,
-                                size_t count) {
+static void copy_and_swap_32_unaligned_sse(void* dest_ptr, const void* src_ptr,
+                                           size_t count) {
   auto dest = reinterpret_cast<uint32_t*>(dest_ptr);
   auto src = reinterpret_cast<const uint32_t*>(src_ptr);
   size_t i;
-  // chrispy: this optimization mightt backfire if our unaligned load spans two
-  // cachelines... which it probably will
-  if (amd64::GetFeatureFlags() & amd64::kX64EmitAVX2) {
-    __m256i shufmask = _mm256_set_epi8(
-        0x0C, 0x0D, 0x0E, 0x0F, 0x08, 0x09, 0x0A, 0x0B, 0x04, 0x05, 0x06, 0x07,
-        0x00, 0x01, 0x02, 0x03, 0x0C, 0x0D, 0x0E, 0x0F, 0x08, 0x09, 0x0A, 0x0B,
-        0x04, 0x05, 0x06, 0x07, 0x00, 0x01, 0x02, 0x03);
-    // with vpshufb being a 0.5 through instruction, it makes the most sense to
-    // double up on our iters
-    for (i = 0; i + 16 <= count; i += 16) {
-      __m256i input1 =
-          _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&src[i]));
-      __m256i input2 =
-          _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&src[i + 8]));
-
-      __m256i output1 = _mm256_shuffle_epi8(input1, shufmask);
-      __m256i output2 = _mm256_shuffle_epi8(input2, shufmask);
-// chrispy: todo, benchmark this w/ and w/out these prefetches here on multiple
-// machines finding a good distance for prefetchw in particular is probably
-// important for when we're writing across 2 cachelines
-#if 0
-      if (i + 48 <= count) {
-        swcache::PrefetchNTA(&src[i + 32]);
-        if (amd64::GetFeatureFlags() & amd64::kX64EmitPrefetchW) {
-          swcache::PrefetchW(&dest[i + 32]);
-        }
-      }
-#endif
-      _mm256_storeu_si256(reinterpret_cast<__m256i*>(&dest[i]), output1);
-      _mm256_storeu_si256(reinterpret_cast<__m256i*>(&dest[i + 8]), output2);
-    }
-    if (i + 8 <= count) {
-      __m256i input =
-          _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&src[i]));
-      __m256i output = _mm256_shuffle_epi8(input, shufmask);
-      _mm256_storeu_si256(reinterpret_cast<__m256i*>(&dest[i]), output);
-      i += 8;
-    }
-    if (i + 4 <= count) {
-      __m128i input =
-          _mm_loadu_si128(reinterpret_cast<const __m128i*>(&src[i]));
-      __m128i output =
-          _mm_shuffle_epi8(input, _mm256_castsi256_si128(shufmask));
-      _mm_storeu_si128(reinterpret_cast<__m128i*>(&dest[i]), output);
-      i += 4;
-    }
-  } else {
-    __m128i shufmask =
-        _mm_set_epi8(0x0C, 0x0D, 0x0E, 0x0F, 0x08, 0x09, 0x0A, 0x0B, 0x04, 0x05,
-                     0x06, 0x07, 0x00, 0x01, 0x02, 0x03);
-
-    for (i = 0; i + 4 <= count; i += 4) {
-      __m128i input =
-          _mm_loadu_si128(reinterpret_cast<const __m128i*>(&src[i]));
-      __m128i output = _mm_shuffle_epi8(input, shufmask);
-      _mm_storeu_si128(reinterpret_cast<__m128i*>(&dest[i]), output);
-    }
+  __m128i shufmask =
+      _mm_set_epi8(0x0C, 0x0D, 0x0E, 0x0F, 0x08, 0x09, 0x0A, 0x0B, 0x04, 0x05,
+                   0x06, 0x07, 0x00, 0x01, 0x02, 0x03);
+
+  for (i = 0; i + 4 <= count; i += 4) {
+    __m128i input = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&src[i]));
+    __m128i output = _mm_shuffle_epi8(input, shufmask);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(&dest[i]), output);
   }
   XE_WORKAROUND_CONSTANT_RETURN_IF(count % 4 == 0);
   for (; i < count; ++i) {  // handle residual elements
@@ -379,8 +378,8 @@ void copy_and_swap_32_unaligned(void* dest_ptr, const void* src_ptr,
   }
 }
 
-void copy_and_swap_64_aligned(void* dest_ptr, const void* src_ptr,
-                              size_t count) {
+static void copy_and_swap_64_aligned_sse(void* dest_ptr, const void* src_ptr,
+                                         size_t count) {
   assert_zero(reinterpret_cast<uintptr_t>(dest_ptr) & 0xF);
   assert_zero(reinterpret_cast<uintptr_t>(src_ptr) & 0xF);
 
@@ -402,8 +401,8 @@ void copy_and_swap_64_aligned(void* dest_ptr, const void* src_ptr,
   }
 }
 
-void copy_and_swap_64_unaligned(void* dest_ptr, const void* src_ptr,
-                                size_t count) {
+static void copy_and_swap_64_unaligned_sse(void* dest_ptr, const void* src_ptr,
+                                           size_t count) {
   auto dest = reinterpret_cast<uint64_t*>(dest_ptr);
   auto src = reinterpret_cast<const uint64_t*>(src_ptr);
   __m128i shufmask =
@@ -422,8 +421,9 @@ void copy_and_swap_64_unaligned(void* dest_ptr, const void* src_ptr,
   }
 }
 
-void copy_and_swap_16_in_32_aligned(void* dest_ptr, const void* src_ptr,
-                                    size_t count) {
+static void copy_and_swap_16_in_32_aligned_sse(void* dest_ptr,
+                                               const void* src_ptr,
+                                               size_t count) {
   auto dest = reinterpret_cast<uint32_t*>(dest_ptr);
   auto src = reinterpret_cast<const uint32_t*>(src_ptr);
   size_t i;
@@ -439,8 +439,9 @@ void copy_and_swap_16_in_32_aligned(void* dest_ptr, const void* src_ptr,
   }
 }
 
-void copy_and_swap_16_in_32_unaligned(void* dest_ptr, const void* src_ptr,
-                                      size_t count) {
+static void copy_and_swap_16_in_32_unaligned_sse(void* dest_ptr,
+                                                 const void* src_ptr,
+                                                 size_t count) {
   auto dest = reinterpret_cast<uint32_t*>(dest_ptr);
   auto src = reinterpret_cast<const uint32_t*>(src_ptr);
   size_t i;
@@ -456,6 +457,287 @@ void copy_and_swap_16_in_32_unaligned(void* dest_ptr, const void* src_ptr,
   }
 }
 
+#if XE_COMPILER_HAS_GNU_EXTENSIONS
+#define XE_AVX2_FUNCTION __attribute__((target("avx2")))
+#define XE_AVX512_FUNCTION __attribute__((target("avx512f,avx512bw")))
+#else
+#define XE_AVX2_FUNCTION
+#define XE_AVX512_FUNCTION
+#endif
+
+// Byte orders of one 16-byte lane after swapping, for vpshufb.
+alignas(16) static const uint8_t kSwap16Shuffle[16] = {
+    1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14};
+alignas(16) static const uint8_t kSwap32Shuffle[16] = {
+    3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12};
+alignas(16) static const uint8_t kSwap64Shuffle[16] = {
+    7, 6, 5, 4, 3, 2, 1, 0, 15, 14, 13, 12, 11, 10, 9, 8};
+alignas(16) static const uint8_t kSwap16In32Shuffle[16] = {
+    2, 3, 0, 1, 6, 7, 4, 5, 10, 11, 8, 9, 14, 15, 12, 13};
+
+// Copies larger than this are mostly uploads that are not read again by the
+// CPU, and would only evict the rest of the cache, so they're written with
+// non-temporal stores.
+static constexpr size_t kCopyAndSwapStreamingThreshold = 1024 * 1024;
+
+// Swaps one element of the wide kernels outside their vectors. The element is
+// loaded whole before being stored, as the buffers may be the same for an
+// in-place swap.
+static void copy_and_swap_element(uint8_t* dest, const uint8_t* src,
+                                  size_t element_size,
+                                  const uint8_t* shuffle) {
+  uint8_t element[8];
+  std::memcpy(element, src, element_size);
+  for (size_t j = 0; j < element_size; ++j) {
+    dest[j] = element[shuffle[j]];
+  }
+}
+
+// The wide kernels don't need aligned loads to be fast, so they're used for
+// both the aligned and the unaligned functions, and work on bytes.
+XE_AVX2_FUNCTION
+static void copy_and_swap_avx2(uint8_t* dest, const uint8_t* src, size_t size,
+                               size_t element_size, const uint8_t* shuffle) {
+  __m256i shufmask = _mm256_broadcastsi128_si256(
+      _mm_load_si128(reinterpret_cast<const __m128i*>(shuffle)));
+  size_t i = 0;
+  // Non-temporal stores need an aligned destination, reachable by swapping
+  // whole elements first only if the elements are aligned.
+  bool streaming = size >= kCopyAndSwapStreamingThreshold &&
+                   !(reinterpret_cast<uintptr_t>(dest) & (element_size - 1));
+  if (streaming) {
+    size_t head_size = (0 - reinterpret_cast<uintptr_t>(dest)) & 31;
+    for (; i < head_size; i += element_size) {
+      copy_and_swap_element(dest + i, src + i, element_size, shuffle);
+    }
+    // vpshufb has a throughput of 2 per clock, so two vectors are swapped per
+    // iteration.
+    for (; i + 64 <= size; i += 64) {
+      __m256i input1 =
+          _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+      __m256i input2 =
+          _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i + 32));
+      _mm256_stream_si256(reinterpret_cast<__m256i*>(dest + i),
+                          _mm256_shuffle_epi8(input1, shufmask));
+      _mm256_stream_si256(reinterpret_cast<__m256i*>(dest + i + 32),
+                          _mm256_shuffle_epi8(input2, shufmask));
+    }
+    swcache::WriteFence();
+  } else {
+    for (; i + 64 <= size; i += 64) {
+      __m256i input1 =
+          _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+      __m256i input2 =
+          _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i + 32));
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(dest + i),
+                          _mm256_shuffle_epi8(input1, shufmask));
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(dest + i + 32),
+                          _mm256_shuffle_epi8(input2, shufmask));
+    }
+  }
+  if (i + 32 <= size) {
+    __m256i input =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dest + i),
+                        _mm256_shuffle_epi8(input, shufmask));
+    i += 32;
+  }
+  if (i + 16 <= size) {
+    __m128i input = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i),
+                     _mm_shuffle_epi8(input, _mm256_castsi256_si128(shufmask)));
+    i += 16;
+  }
+  for (; i < size; i += element_size) {  // handle residual elements
+    copy_and_swap_element(dest + i, src + i, element_size, shuffle);
+  }
+}
+
+// Masked loads and stores of bytes replace the residual loops, and masked
+// loads don't fault on the bytes outside the mask.
+XE_AVX512_FUNCTION
+static void copy_and_swap_avx512(uint8_t* dest, const uint8_t* src,
+                                 size_t size, size_t element_size,
+                                 const uint8_t* shuffle) {
+  __m512i shufmask = _mm512_broadcast_i32x4(
+      _mm_load_si128(reinterpret_cast<const __m128i*>(shuffle)));
+  size_t i = 0;
+  bool streaming = size >= kCopyAndSwapStreamingThreshold &&
+                   !(reinterpret_cast<uintptr_t>(dest) & (element_size - 1));
+  if (streaming) {
+    size_t head_size = (0 - reinterpret_cast<uintptr_t>(dest)) & 63;
+    if (head_size) {
+      __mmask64 mask = (UINT64_C(1) << head_size) - 1;
+      __m512i input = _mm512_maskz_loadu_epi8(mask, src);
+      _mm512_mask_storeu_epi8(dest, mask,
+                              _mm512_shuffle_epi8(input, shufmask));
+      i = head_size;
+    }
+    for (; i + 128 <= size; i += 128) {
+      __m512i input1 = _mm512_loadu_si512(src + i);
+      __m512i input2 = _mm512_loadu_si512(src + i + 64);
+      _mm512_stream_si512(reinterpret_cast<__m512i*>(dest + i),
+                          _mm512_shuffle_epi8(input1, shufmask));
+      _mm512_stream_si512(reinterpret_cast<__m512i*>(dest + i + 64),
+                          _mm512_shuffle_epi8(input2, shufmask));
+    }
+    swcache::WriteFence();
+  } else {
+    for (; i + 128 <= size; i += 128) {
+      __m512i input1 = _mm512_loadu_si512(src + i);
+      __m512i input2 = _mm512_loadu_si512(src + i + 64);
+      _mm512_storeu_si512(dest + i, _mm512_shuffle_epi8(input1, shufmask));
+      _mm512_storeu_si512(dest + i + 64,
+                          _mm512_shuffle_epi8(input2, shufmask));
+    }
+  }
+  if (i + 64 <= size) {
+    __m512i input = _mm512_loadu_si512(src + i);
+    _mm512_storeu_si512(dest + i, _mm512_shuffle_epi8(input, shufmask));
+    i += 64;
+  }
+  if (i < size) {
+    __mmask64 mask = (UINT64_C(1) << (size - i)) - 1;
+    __m512i input = _mm512_maskz_loadu_epi8(mask, src + i);
+    _mm512_mask_storeu_epi8(dest + i, mask,
+                            _mm512_shuffle_epi8(input, shufmask));
+  }
+}
+
+template <size_t element_size, const uint8_t* shuffle>
+XE_AVX2_FUNCTION static void copy_and_swap_avx2_kernel(void* dest,
+                                                       const void* src,
+                                                       size_t count) {
+  copy_and_swap_avx2(reinterpret_cast<uint8_t*>(dest),
+                     reinterpret_cast<const uint8_t*>(src),
+                     count * element_size, element_size, shuffle);
+}
+
+template <size_t element_size, const uint8_t* shuffle>
+XE_AVX512_FUNCTION static void copy_and_swap_avx512_kernel(void* dest,
+                                                           const void* src,
+                                                           size_t count) {
+  copy_and_swap_avx512(reinterpret_cast<uint8_t*>(dest),
+                       reinterpret_cast<const uint8_t*>(src),
+                       count * element_size, element_size, shuffle);
+}
+
+using CopyAndSwapKernel = void (*)(void* dest, const void* src, size_t count);
+
+struct CopyAndSwapDispatch {
+  CopyAndSwapKernel swap_16_aligned;
+  CopyAndSwapKernel swap_16_unaligned;
+  CopyAndSwapKernel swap_32_aligned;
+  CopyAndSwapKernel swap_32_unaligned;
+  CopyAndSwapKernel swap_64_aligned;
+  CopyAndSwapKernel swap_64_unaligned;
+  CopyAndSwapKernel swap_16_in_32_aligned;
+  CopyAndSwapKernel swap_16_in_32_unaligned;
+};
+
+static const CopyAndSwapDispatch copy_and_swap_dispatch_sse = {
+    copy_and_swap_16_aligned_sse,       copy_and_swap_16_unaligned_sse,
+    copy_and_swap_32_aligned_sse,       copy_and_swap_32_unaligned_sse,
+    copy_and_swap_64_aligned_sse,       copy_and_swap_64_unaligned_sse,
+    copy_and_swap_16_in_32_aligned_sse, copy_and_swap_16_in_32_unaligned_sse,
+};
+
+static const CopyAndSwapDispatch copy_and_swap_dispatch_avx2 = {
+    copy_and_swap_avx2_kernel<2, kSwap16Shuffle>,
+    copy_and_swap_avx2_kernel<2, kSwap16Shuffle>,
+    copy_and_swap_avx2_kernel<4, kSwap32Shuffle>,
+    copy_and_swap_avx2_kernel<4, kSwap32Shuffle>,
+    copy_and_swap_avx2_kernel<8, kSwap64Shuffle>,
+    copy_and_swap_avx2_kernel<8, kSwap64Shuffle>,
+    copy_and_swap_avx2_kernel<4, kSwap16In32Shuffle>,
+    copy_and_swap_avx2_kernel<4, kSwap16In32Shuffle>,
+};
+
+static const CopyAndSwapDispatch copy_and_swap_dispatch_avx512 = {
+    copy_and_swap_avx512_kernel<2, kSwap16Shuffle>,
+    copy_and_swap_avx512_kernel<2, kSwap16Shuffle>,
+    copy_and_swap_avx512_kernel<4, kSwap32Shuffle>,
+    copy_and_swap_avx512_kernel<4, kSwap32Shuffle>,
+    copy_and_swap_avx512_kernel<8, kSwap64Shuffle>,
+    copy_and_swap_avx512_kernel<8, kSwap64Shuffle>,
+    copy_and_swap_avx512_kernel<4, kSwap16In32Shuffle>,
+    copy_and_swap_avx512_kernel<4, kSwap16In32Shuffle>,
+};
+
+template <CopyAndSwapKernel CopyAndSwapDispatch::*kernel>
+XE_COLD static void first_copy_and_swap(void* dest, const void* src,
+                                        size_t count);
+
+static const CopyAndSwapDispatch copy_and_swap_dispatch_first = {
+    first_copy_and_swap<&CopyAndSwapDispatch::swap_16_aligned>,
+    first_copy_and_swap<&CopyAndSwapDispatch::swap_16_unaligned>,
+    first_copy_and_swap<&CopyAndSwapDispatch::swap_32_aligned>,
+    first_copy_and_swap<&CopyAndSwapDispatch::swap_32_unaligned>,
+    first_copy_and_swap<&CopyAndSwapDispatch::swap_64_aligned>,
+    first_copy_and_swap<&CopyAndSwapDispatch::swap_64_unaligned>,
+    first_copy_and_swap<&CopyAndSwapDispatch::swap_16_in_32_aligned>,
+    first_copy_and_swap<&CopyAndSwapDispatch::swap_16_in_32_unaligned>,
+};
+
+static const CopyAndSwapDispatch* copy_and_swap_dispatch =
+    &copy_and_swap_dispatch_first;
+
+template <CopyAndSwapKernel CopyAndSwapDispatch::*kernel>
+XE_COLD static void first_copy_and_swap(void* dest, const void* src,
+                                        size_t count) {
+  uint64_t feature_flags = amd64::GetFeatureFlags();
+  const CopyAndSwapDispatch* dispatch_to_use = nullptr;
+  if ((feature_flags & (amd64::kX64EmitAVX512F | amd64::kX64EmitAVX512BW)) ==
+      (amd64::kX64EmitAVX512F | amd64::kX64EmitAVX512BW)) {
+    XELOGI("Selecting AVX-512 copy_and_swap.");
+    dispatch_to_use = &copy_and_swap_dispatch_avx512;
+  } else if (feature_flags & amd64::kX64EmitAVX2) {
+    XELOGI("Selecting AVX2 copy_and_swap.");
+    dispatch_to_use = &copy_and_swap_dispatch_avx2;
+  } else {
+    XELOGI("Selecting SSSE3 copy_and_swap.");
+    dispatch_to_use = &copy_and_swap_dispatch_sse;
+  }
+
+  copy_and_swap_dispatch =
+      dispatch_to_use;  // all future calls will go through our selected path
+  return (copy_and_swap_dispatch->*kernel)(dest, src, count);
+}
+
+void copy_and_swap_16_aligned(void* dest, const void* src, size_t count) {
+  copy_and_swap_dispatch->swap_16_aligned(dest, src, count);
+}
+
+void copy_and_swap_16_unaligned(void* dest, const void* src, size_t count) {
+  copy_and_swap_dispatch->swap_16_unaligned(dest, src, count);
+}
+
+void copy_and_swap_32_aligned(void* dest, const void* src, size_t count) {
+  copy_and_swap_dispatch->swap_32_aligned(dest, src, count);
+}
+
+void copy_and_swap_32_unaligned(void* dest, const void* src, size_t count) {
+  copy_and_swap_dispatch->swap_32_unaligned(dest, src, count);
+}
+
+void copy_and_swap_64_aligned(void* dest, const void* src, size_t count) {
+  copy_and_swap_dispatch->swap_64_aligned(dest, src, count);
+}
+
+void copy_and_swap_64_unaligned(void* dest, const void* src, size_t count) {
+  copy_and_swap_dispatch->swap_64_unaligned(dest, src, count);
+}
+
+void copy_and_swap_16_in_32_aligned(void* dest, const void* src,
+                                    size_t count) {
+  copy_and_swap_dispatch->swap_16_in_32_aligned(dest, src, count);
+}
+
+void copy_and_swap_16_in_32_unaligned(void* dest, const void* src,
+                                      size_t count) {
+  copy_and_swap_dispatch->swap_16_in_32_unaligned(dest, src, count);
+}
+
 #elif XE_ARCH_ARM64
 
 // Although NEON offers vector rev instructions (like vrev32q_u8), they are
@@ -642,4 +924,47 @@ void copy_and_swap_16_in_32_unaligned(void* dst_ptr, const void* src_ptr,
 
 #endif
 
+size_t find_terminator_be16(const void* string, size_t max_count,
+                            char16_t stop) {
+  auto chars = reinterpret_cast<const uint16_t*>(string);
+  uint16_t stop_swapped = byte_swap(uint16_t(stop));
+#if XE_ARCH_AMD64
+  // Aligned loads don't cross pages, so only possible with aligned characters.
+  if (!(reinterpret_cast<uintptr_t>(string) & 1)) {
+    uintptr_t misalignment = reinterpret_cast<uintptr_t>(string) & 0xF;
+    auto block = reinterpret_cast<const __m128i*>(
+        reinterpret_cast<uintptr_t>(string) - misalignment);
+    __m128i zero = _mm_setzero_si128();
+    __m128i stop_vector = _mm_set1_epi16(int16_t(stop_swapped));
+    // Bytes of the block before the string.
+    uint32_t ignore_mask = (uint32_t(1) << misalignment) - 1;
+    // Characters of the string before the block, negative for the first.
+    ptrdiff_t block_index = -ptrdiff_t(misalignment / 2);
+    for (;;) {
+      __m128i input = _mm_load_si128(block++);
+      uint32_t mask = uint32_t(_mm_movemask_epi8(
+                          _mm_or_si128(_mm_cmpeq_epi16(input, zero),
+                                       _mm_cmpeq_epi16(input, stop_vector)))) &
+                      ~ignore_mask;
+      if (mask) {
+        return std::min(size_t(block_index + xe::tzcnt(mask) / 2), max_count);
+      }
+      ignore_mask = 0;
+      block_index += 8;
+      if (size_t(block_index) >= max_count) {
+        return max_count;
+      }
+    }
+  }
+#endif  // XE_ARCH_AMD64
+  size_t length = 0;
+  for (; length < max_count; ++length) {
+    uint16_t c = chars[length];
+    if (!c || c == stop_swapped) {
+      break;
+    }
+  }
+  return length;
+}
+
 }  // namespace xe
@@ -14,9 +14,11 @@
 #include <cstring>
 #include <filesystem>
 #include <functional>
+#include <memory>
 #include <string>
 #include <string_view>
 #include <type_traits>
+#include <utility>
 
 #include "xenia/base/byte_order.h"
 
@@ -156,6 +158,39 @@ void* MapFileView(FileMappingHandle handle, void* base_address, size_t length,
                   PageAccess access, size_t file_offset);
 bool UnmapFileView(FileMappingHandle handle, void* base_address, size_t length);
 
+// Asks the host to back a mapped range with large pages where it can, to
+// reduce TLB misses. Protection can still be changed per page afterwards, the
+// host splitting large pages as needed. Returns false if not supported.
+bool AdviseLargePages(void* base_address, size_t length);
+
+// Asks the host to allocate the physical pages of a mapped range, which must
+// not have been accessed yet, on the NUMA node, preferring other nodes when it
+// runs out of memory. Returns false if not supported - on Windows, the pages
+// are allocated on the node of the thread first accessing them.
+bool BindToNumaNode(void* base_address, size_t length, uint32_t node);
+
+// Host tracking of writes to memory without access violations, for polling
+// written pages in bulk rather than handling a fault for every one of them.
+// Only available with asynchronous userfaultfd write protection on Linux 6.7
+// and newer - GetWriteWatch on Windows only works for VirtualAlloc memory, not
+// for file mapping views.
+class WriteWatch {
+ public:
+  // Returns nullptr if not supported by the host.
+  static std::unique_ptr<WriteWatch> Create();
+
+  virtual ~WriteWatch() = default;
+
+  // Starts tracking writes to the page range from now on, forgetting earlier
+  // ones. Needs to be done again after the range is mapped again.
+  virtual bool Reset(void* base_address, size_t length) = 0;
+  // Calls the callback for every run of pages written in the range since it
+  // was reset, or not tracked at all. Doesn't reset the pages.
+  virtual bool GetWritten(
+      void* base_address, size_t length,
+      const std::function<void(void* address, size_t length)>& callback) = 0;
+};
+
 inline size_t hash_combine(size_t seed) { return seed; }
 
 template <typename T, typename... Ts>
@@ -169,6 +204,12 @@ XE_NOINLINE
 void vastcpy(uint8_t* XE_RESTRICT physaddr, uint8_t* XE_RESTRICT rdmapping,
              uint32_t written_length);
 
+// memset and memcpy with non-temporal stores, for ranges too large for the
+// cache that are not read again soon. The ranges may have any alignment.
+void fill_streaming(void* dest, uint8_t value, size_t size);
+void copy_streaming(void* XE_RESTRICT dest, const void* XE_RESTRICT src,
+                    size_t size);
+
 }  // namespace memory
 
 // TODO(benvanik): move into xe::memory::
@@ -189,6 +230,13 @@ void copy_and_swap_16_in_32_aligned(void* dest, const void* src, size_t count);
 void copy_and_swap_16_in_32_unaligned(void* dest, const void* src,
                                       size_t count);
 
+// Returns the number of big-endian UTF-16 characters of the string before the
+// terminator or the character stop (unless it's zero), at most max_count. May
+// read the bytes around the string within the 16-byte blocks containing it,
+// which never cross a page boundary.
+size_t find_terminator_be16(const void* string, size_t max_count,
+                            char16_t stop = 0);
+
 template <typename T>
 void copy_and_swap(T* dest, const T* src, size_t count) {
   bool is_aligned = reinterpret_cast<uintptr_t>(dest) % 32 == 0 &&
@@ -532,6 +580,11 @@ class FixedVMemVector {
     resize(0);  // todo:maybe zero out
   }
   void reserve(size_t size) { xenia_assert(size < sz); }
+  // Exchanges the allocations without copying the contents.
+  void swap(FixedVMemVector& other) {
+    std::swap(data_, other.data_);
+    std::swap(nbytes_, other.nbytes_);
+  }
 };
 // software prefetches/cache operations
 namespace swcache {
@@ -9,6 +9,7 @@
 
 #include "xenia/base/memory.h"
 
+#include <errno.h>
 #include <fcntl.h>
 #include <sys/mman.h>
 #include <unistd.h>
@@ -27,6 +28,13 @@
 #include "xenia/base/main_android.h"
 #endif
 
+#if XE_PLATFORM_LINUX
+#include <linux/fs.h>
+#include <linux/userfaultfd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+
 namespace xe {
 namespace memory {
 
@@ -193,5 +201,130 @@ bool UnmapFileView(FileMappingHandle handle, void* base_address,
   return munmap(base_address, length) == 0;
 }
 
+bool AdviseLargePages(void* base_address, size_t length) {
+#if XE_PLATFORM_LINUX && defined(MADV_HUGEPAGE)
+  // Transparent huge pages, effective when enabled as "madvise" or "always".
+  return madvise(base_address, length, MADV_HUGEPAGE) == 0;
+#else
+  return false;
+#endif
+}
+
+bool BindToNumaNode(void* base_address, size_t length, uint32_t node) {
+#if XE_PLATFORM_LINUX && defined(SYS_mbind)
+  if (node >= 64) {
+    return false;
+  }
+  // MPOL_PREFERRED from linux/mempolicy.h, calling directly rather than
+  // through libnuma.
+  constexpr int kMpolPreferred = 1;
+  unsigned long node_mask[64 / (sizeof(unsigned long) * 8)] = {};
+  node_mask[node / (sizeof(unsigned long) * 8)] =
+      1ul << (node % (sizeof(unsigned long) * 8));
+  // The kernel ignores the last bit of maxnode.
+  return syscall(SYS_mbind, base_address, length, kMpolPreferred, node_mask,
+                 sizeof(node_mask) * 8 + 1, 0) == 0;
+#else
+  return false;
+#endif
+}
+
+#if XE_PLATFORM_LINUX && defined(PAGEMAP_SCAN) && \
+    defined(UFFD_FEATURE_WP_ASYNC)
+// Pages registered for asynchronous write protection are unprotected by the
+// kernel itself on the first write, without notifying anyone, and the scan of
+// /proc/self/pagemap reports which ones have been.
+class UserfaultfdWriteWatch : public WriteWatch {
+ public:
+  UserfaultfdWriteWatch(int uffd, int pagemap)
+      : uffd_(uffd), pagemap_(pagemap) {}
+  ~UserfaultfdWriteWatch() override {
+    close(pagemap_);
+    close(uffd_);
+  }
+
+  bool Reset(void* base_address, size_t length) override {
+    uffdio_register uffd_register = {};
+    uffd_register.range.start = uint64_t(base_address);
+    uffd_register.range.len = length;
+    uffd_register.mode = UFFDIO_REGISTER_MODE_WP;
+    // Registering again is fine, while committing memory drops registration.
+    if (ioctl(uffd_, UFFDIO_REGISTER, &uffd_register)) {
+      return false;
+    }
+    uffdio_writeprotect write_protect = {};
+    write_protect.range = uffd_register.range;
+    write_protect.mode = UFFDIO_WRITEPROTECT_MODE_WP;
+    return ioctl(uffd_, UFFDIO_WRITEPROTECT, &write_protect) == 0;
+  }
+
+  bool GetWritten(void* base_address, size_t length,
+                  const std::function<void(void* address, size_t length)>&
+                      callback) override {
+    page_region regions[64];
+    uint64_t start = uint64_t(base_address);
+    uint64_t end = start + length;
+    while (start < end) {
+      pm_scan_arg scan = {};
+      scan.size = sizeof(scan);
+      // Fails if any part of the range is not registered.
+      scan.flags = PM_SCAN_CHECK_WPASYNC;
+      scan.start = start;
+      scan.end = end;
+      scan.vec = uint64_t(regions);
+      scan.vec_len = xe::countof(regions);
+      scan.category_mask = PAGE_IS_WRITTEN;
+      scan.return_mask = PAGE_IS_WRITTEN;
+      long region_count = ioctl(pagemap_, PAGEMAP_SCAN, &scan);
+      if (region_count < 0) {
+        if (errno != EPERM) {
+          return false;
+        }
+        // Mapped again since reset, so anything may have been written.
+        callback(reinterpret_cast<void*>(start), size_t(end - start));
+        return true;
+      }
+      for (long i = 0; i < region_count; ++i) {
+        callback(reinterpret_cast<void*>(regions[i].start),
+                 size_t(regions[i].end - regions[i].start));
+      }
+      if (scan.walk_end <= start) {
+        break;
+      }
+      // Stops before the end if out of regions.
+      start = scan.walk_end;
+    }
+    return true;
+  }
+
+ private:
+  int uffd_;
+  int pagemap_;
+};
+
+std::unique_ptr<WriteWatch> WriteWatch::Create() {
+  int uffd = int(
+      syscall(SYS_userfaultfd, O_CLOEXEC | O_NONBLOCK | UFFD_USER_MODE_ONLY));
+  if (uffd < 0) {
+    return nullptr;
+  }
+  uffdio_api api = {};
+  api.api = UFFD_API;
+  api.features = UFFD_FEATURE_WP_ASYNC | UFFD_FEATURE_WP_UNPOPULATED;
+  if (ioctl(uffd, UFFDIO_API, &api)) {
+    close(uffd);
+    return nullptr;
+  }
+  int pagemap = open("/proc/self/pagemap", O_RDONLY | O_CLOEXEC);
+  if (pagemap < 0) {
+    close(uffd);
+    return nullptr;
+  }
+  return std::make_unique<UserfaultfdWriteWatch>(uffd, pagemap);
+}
+#else
+std::unique_ptr<WriteWatch> WriteWatch::Create() { return nullptr; }
+#endif
+
 }  // namespace memory
 }  // namespace xe
@@ -283,5 +283,19 @@ bool UnmapFileView(FileMappingHandle handle, void* base_address,
   return UnmapViewOfFile(base_address) ? true : false;
 }
 
+bool AdviseLargePages(void* base_address, size_t length) {
+  // SEC_LARGE_PAGES sections must be committed as a whole when created, and
+  // large pages can't be protected individually, which memory watches need.
+  return false;
+}
+
+bool BindToNumaNode(void* base_address, size_t length, uint32_t node) {
+  // The node of a section can only be chosen when creating it, with
+  // CreateFileMappingNuma, for all of its views.
+  return false;
+}
+
+std::unique_ptr<WriteWatch> WriteWatch::Create() { return nullptr; }
+
 }  // namespace memory
 }  // namespace xe
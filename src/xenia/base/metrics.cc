@@ -0,0 +1,247 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2026 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/base/metrics.h"
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <mutex>
+
+#include "third_party/fmt/include/fmt/format.h"
+#include "xenia/base/assert.h"
+#include "xenia/base/cvar.h"
+#include "xenia/base/filesystem.h"
+#include "xenia/base/logging.h"
+#include "xenia/base/threading.h"
+
+DEFINE_path(metrics_export_path, "",
+            "File to periodically append the values of the metrics (cache "
+            "hit counts, queue depths, and so on) to, as CSV.",
+            "General");
+DEFINE_uint32(metrics_export_interval, 10,
+              "Seconds between the metric values written to "
+              "metrics_export_path.",
+              "General");
+
+namespace xe {
+namespace metrics {
+
+namespace {
+
+struct Registry {
+  std::mutex mutex;
+  std::vector<const Metric*> metrics;
+  uint32_t slot_count = 0;
+  std::vector<internal::ThreadSlots*> threads;
+  // Values of the threads that have exited.
+  std::vector<uint64_t> exited_values =
+      std::vector<uint64_t>(internal::kMaxSlots);
+  // Values at the last Reset.
+  std::vector<uint64_t> reset_values =
+      std::vector<uint64_t>(internal::kMaxSlots);
+};
+
+// Metrics are registered during static initialization, possibly before this
+// file's globals are constructed, and threads may exit after they're
+// destroyed, so never destroyed.
+Registry& GetRegistry() {
+  static Registry* registry = new Registry;
+  return *registry;
+}
+
+// Moves the values to the exited ones when the thread exits.
+class ThreadSlotsReleaser {
+ public:
+  explicit ThreadSlotsReleaser(internal::ThreadSlots* thread_slots)
+      : thread_slots_(thread_slots) {}
+  ~ThreadSlotsReleaser() {
+    Registry& registry = GetRegistry();
+    {
+      std::lock_guard<std::mutex> lock(registry.mutex);
+      for (uint32_t i = 0; i < registry.slot_count; ++i) {
+        registry.exited_values[i] +=
+            thread_slots_->values[i].load(std::memory_order_relaxed);
+      }
+      auto it = std::find(registry.threads.begin(), registry.threads.end(),
+                          thread_slots_);
+      if (it != registry.threads.end()) {
+        registry.threads.erase(it);
+      }
+    }
+    internal::GetThreadSlotsPointer() = nullptr;
+    delete thread_slots_;
+  }
+
+ private:
+  internal::ThreadSlots* thread_slots_;
+};
+
+// Sums of the values of all threads since the start.
+void GetTotalValues(const Registry& registry, std::vector<uint64_t>& values) {
+  values = registry.exited_values;
+  for (const internal::ThreadSlots* thread_slots : registry.threads) {
+    for (uint32_t i = 0; i < registry.slot_count; ++i) {
+      values[i] += thread_slots->values[i].load(std::memory_order_relaxed);
+    }
+  }
+}
+
+std::unique_ptr<threading::Thread> export_thread_;
+std::unique_ptr<threading::Event> export_thread_stop_;
+
+void WriteCsv(FILE* file, double time_s) {
+  for (const MetricValue& value : Aggregate()) {
+    const Metric& metric = *value.metric;
+    if (metric.type() == MetricType::kHistogram) {
+      fmt::print(file, "{:.1f},{},{},{},{:.2f},{},{},{}\n", time_s,
+                 metric.category(), metric.name(), value.count,
+                 value.GetMean(), value.GetPercentileUpperBound(0.5),
+                 value.GetPercentileUpperBound(0.9),
+                 value.GetPercentileUpperBound(0.99));
+    } else {
+      fmt::print(file, "{:.1f},{},{},{},,,,\n", time_s, metric.category(),
+                 metric.name(), value.count);
+    }
+  }
+  std::fflush(file);
+}
+
+}  // namespace
+
+Metric::Metric(MetricType type, const char* category, const char* name,
+               const char* description, uint32_t slot_count)
+    : type_(type),
+      category_(category),
+      name_(name),
+      description_(description) {
+  Registry& registry = GetRegistry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  if (registry.slot_count + slot_count > internal::kMaxSlots) {
+    assert_always("Too many metrics, increase kMaxSlots");
+    first_slot_ = internal::kMaxSlots;
+    return;
+  }
+  first_slot_ = registry.slot_count;
+  registry.slot_count += slot_count;
+  registry.metrics.push_back(this);
+}
+
+namespace internal {
+
+ThreadSlots* CreateThreadSlots() {
+  auto thread_slots = new ThreadSlots;
+  for (std::atomic<uint64_t>& value : thread_slots->values) {
+    value.store(0, std::memory_order_relaxed);
+  }
+  {
+    Registry& registry = GetRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    registry.threads.push_back(thread_slots);
+  }
+  GetThreadSlotsPointer() = thread_slots;
+  static thread_local ThreadSlotsReleaser releaser(thread_slots);
+  return thread_slots;
+}
+
+}  // namespace internal
+
+uint64_t MetricValue::GetPercentileUpperBound(double percentile) const {
+  if (!count) {
+    return 0;
+  }
+  uint64_t threshold =
+      std::max(uint64_t(1), uint64_t(double(count) * percentile + 0.5));
+  uint64_t cumulative = 0;
+  for (uint32_t i = 0; i < Histogram::kBucketCount; ++i) {
+    cumulative += buckets[i];
+    if (cumulative >= threshold) {
+      return Histogram::GetBucketUpperBound(i);
+    }
+  }
+  return Histogram::GetBucketUpperBound(Histogram::kBucketCount - 1);
+}
+
+std::vector<MetricValue> Aggregate() {
+  Registry& registry = GetRegistry();
+  std::vector<uint64_t> values;
+  std::vector<MetricValue> metric_values;
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  GetTotalValues(registry, values);
+  metric_values.reserve(registry.metrics.size());
+  for (const Metric* metric : registry.metrics) {
+    auto get_value = [&](uint32_t slot) {
+      uint32_t slot_index = metric->first_slot() + slot;
+      return values[slot_index] - registry.reset_values[slot_index];
+    };
+    MetricValue& metric_value = metric_values.emplace_back();
+    metric_value.metric = metric;
+    metric_value.count = get_value(0);
+    metric_value.buckets.fill(0);
+    if (metric->type() == MetricType::kHistogram) {
+      metric_value.sum = get_value(1);
+      for (uint32_t i = 0; i < Histogram::kBucketCount; ++i) {
+        metric_value.buckets[i] = get_value(2 + i);
+      }
+    } else {
+      metric_value.sum = 0;
+    }
+  }
+  return metric_values;
+}
+
+void Reset() {
+  Registry& registry = GetRegistry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  // The values are only modified by their threads, so the current ones are
+  // subtracted instead of being zeroed.
+  GetTotalValues(registry, registry.reset_values);
+}
+
+void StartExport() {
+  if (cvars::metrics_export_path.empty() || export_thread_) {
+    return;
+  }
+  FILE* file = filesystem::OpenFile(cvars::metrics_export_path, "a");
+  if (!file) {
+    XELOGE("Failed to open {} for the metrics",
+           xe::path_to_utf8(cvars::metrics_export_path));
+    return;
+  }
+  fmt::print(file, "time_s,category,name,count,mean,p50,p90,p99\n");
+  export_thread_stop_ = threading::Event::CreateManualResetEvent(false);
+  export_thread_ = threading::Thread::Create({}, [file]() {
+    auto start = std::chrono::steady_clock::now();
+    auto interval = std::chrono::seconds(
+        std::max(cvars::metrics_export_interval, uint32_t(1)));
+    bool stop = false;
+    while (!stop) {
+      stop = threading::Wait(export_thread_stop_.get(), false, interval) ==
+             threading::WaitResult::kSuccess;
+      std::chrono::duration<double> time =
+          std::chrono::steady_clock::now() - start;
+      WriteCsv(file, time.count());
+    }
+    std::fclose(file);
+  });
+  export_thread_->set_name("Metrics Export");
+}
+
+void StopExport() {
+  if (!export_thread_) {
+    return;
+  }
+  export_thread_stop_->Set();
+  threading::Wait(export_thread_.get(), false);
+  export_thread_.reset();
+  export_thread_stop_.reset();
+}
+
+}  // namespace metrics
+}  // namespace xe
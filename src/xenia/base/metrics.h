@@ -0,0 +1,174 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2026 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#ifndef XENIA_BASE_METRICS_H_
+#define XENIA_BASE_METRICS_H_
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "xenia/base/platform.h"
+
+namespace xe {
+namespace metrics {
+
+// Counters and histograms cheap enough to update on hot paths, such as cache
+// lookups, for statistics that are only looked at occasionally. Every thread
+// updates its own copy of the values, allocated on the first update from the
+// thread and not shared with other threads, so an update is a thread-local
+// load, add and store, without atomic read-modify-write operations or cache
+// line transfers. The copies of all threads are summed when the values are
+// requested, for the Metrics dialog or the metrics_export_path file.
+//
+// Metrics must have static storage duration, and are usually defined at the
+// namespace scope of the translation unit using them:
+//   xe::metrics::Counter texture_cache_hits_("GPU", "texture_cache_hits",
+//                                            "Texture cache hits");
+// The names and the descriptions must be string literals.
+
+enum class MetricType {
+  kCounter,
+  kHistogram,
+};
+
+class Metric {
+ public:
+  Metric(const Metric& metric) = delete;
+  Metric& operator=(const Metric& metric) = delete;
+
+  MetricType type() const { return type_; }
+  const char* category() const { return category_; }
+  const char* name() const { return name_; }
+  const char* description() const { return description_; }
+  uint32_t first_slot() const { return first_slot_; }
+
+ protected:
+  Metric(MetricType type, const char* category, const char* name,
+         const char* description, uint32_t slot_count);
+
+ private:
+  MetricType type_;
+  const char* category_;
+  const char* name_;
+  const char* description_;
+  uint32_t first_slot_;
+};
+
+namespace internal {
+
+// Total number of values of all the metrics. Metrics registered beyond this
+// share a slot range that is never reported.
+constexpr uint32_t kMaxSlots = 4096;
+constexpr uint32_t kOverflowSlots = 64;
+
+struct alignas(64) ThreadSlots {
+  // Only written by the owning thread, atomic for the aggregation.
+  std::atomic<uint64_t> values[kMaxSlots + kOverflowSlots];
+};
+
+inline ThreadSlots*& GetThreadSlotsPointer() {
+  static thread_local ThreadSlots* thread_slots = nullptr;
+  return thread_slots;
+}
+
+XE_NOINLINE ThreadSlots* CreateThreadSlots();
+
+inline std::atomic<uint64_t>* GetThreadValues(uint32_t first_slot) {
+  ThreadSlots* thread_slots = GetThreadSlotsPointer();
+  if (XE_UNLIKELY(!thread_slots)) {
+    thread_slots = CreateThreadSlots();
+  }
+  return &thread_slots->values[first_slot];
+}
+
+inline void AddToValue(std::atomic<uint64_t>& value, uint64_t amount) {
+  value.store(value.load(std::memory_order_relaxed) + amount,
+              std::memory_order_relaxed);
+}
+
+}  // namespace internal
+
+class Counter : public Metric {
+ public:
+  Counter(const char* category, const char* name, const char* description)
+      : Metric(MetricType::kCounter, category, name, description, 1) {}
+
+  void Increment(uint64_t amount = 1) const {
+    internal::AddToValue(*internal::GetThreadValues(first_slot()), amount);
+  }
+};
+
+// Distribution of values, such as queue depths, in power-of-two buckets:
+// bucket 0 is for 0, bucket i for [2^(i - 1), 2^i - 1], the last one for
+// everything larger.
+class Histogram : public Metric {
+ public:
+  static constexpr uint32_t kBucketCount = 33;
+  // Sample count, sum, buckets.
+  static constexpr uint32_t kSlotCount = 2 + kBucketCount;
+
+  Histogram(const char* category, const char* name, const char* description)
+      : Metric(MetricType::kHistogram, category, name, description,
+               kSlotCount) {}
+
+  static uint32_t GetBucket(uint64_t value) {
+    uint32_t bucket = 0;
+    while (value && bucket < kBucketCount - 1) {
+      value >>= 1;
+      ++bucket;
+    }
+    return bucket;
+  }
+  // The largest value in the bucket, UINT64_MAX for the last one.
+  static uint64_t GetBucketUpperBound(uint32_t bucket) {
+    if (bucket >= kBucketCount - 1) {
+      return UINT64_MAX;
+    }
+    return (uint64_t(1) << bucket) - 1;
+  }
+
+  void Record(uint64_t value) const {
+    std::atomic<uint64_t>* values = internal::GetThreadValues(first_slot());
+    internal::AddToValue(values[0], 1);
+    internal::AddToValue(values[1], value);
+    internal::AddToValue(values[2 + GetBucket(value)], 1);
+  }
+};
+
+struct MetricValue {
+  const Metric* metric;
+  // For counters, the value. For histograms, the number of samples.
+  uint64_t count;
+  // Histograms only.
+  uint64_t sum;
+  std::array<uint64_t, Histogram::kBucketCount> buckets;
+
+  double GetMean() const { return count ? double(sum) / double(count) : 0.0; }
+  // Upper bound of the bucket containing the percentile of the samples.
+  uint64_t GetPercentileUpperBound(double percentile) const;
+};
+
+// Values of all the metrics summed over all threads, including exited ones,
+// since the last Reset, in the order of registration. Updates made
+// concurrently with the aggregation may or may not be included.
+std::vector<MetricValue> Aggregate();
+void Reset();
+
+// Appends the values with the time since the start to metrics_export_path
+// every metrics_export_interval seconds.
+void StartExport();
+void StopExport();
+
+}  // namespace metrics
+}  // namespace xe
+
+#endif  // XENIA_BASE_METRICS_H_
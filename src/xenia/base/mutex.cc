@@ -8,11 +8,17 @@
  */
 
 #include "xenia/base/mutex.h"
+
+#include <atomic>
+
 #if XE_PLATFORM_WIN32 == 1
 #include "xenia/base/platform_win.h"
 #endif
 
 namespace xe {
+
+static std::atomic<uint64_t> global_mutex_contention_count = {0};
+
 #if XE_PLATFORM_WIN32 == 1 && XE_ENABLE_FAST_WIN32_MUTEX == 1
 // default spincount for entercriticalsection is insane on windows, 0x20007D0i64
 // (33556432 times!!) when a lock is highly contended performance degrades
@@ -40,6 +46,10 @@ xe_global_mutex ::~xe_global_mutex() {
 }
 
 void xe_global_mutex::lock() {
+  if (TryEnterCriticalSection(global_critical_section(this))) {
+    return;
+  }
+  global_mutex_contention_count.fetch_add(1, std::memory_order_relaxed);
   EnterCriticalSection(global_critical_section(this));
 }
 void xe_global_mutex::unlock() {
@@ -64,10 +74,26 @@ void xe_fast_mutex::unlock() { LeaveCriticalSection(fast_crit(this)); }
 bool xe_fast_mutex::try_lock() {
   return TryEnterCriticalSection(fast_crit(this));
 }
+#else
+void xe_global_mutex::lock() {
+  if (mutex_.try_lock()) {
+    return;
+  }
+  global_mutex_contention_count.fetch_add(1, std::memory_order_relaxed);
+  mutex_.lock();
+}
 #endif
 // chrispy: moved this out of body of function to eliminate the initialization
 // guards
+#if XE_ENABLE_LOCK_INSTRUMENTATION == 1
+static global_mutex_type global_mutex("global_critical_region");
+#else
 static global_mutex_type global_mutex;
+#endif
 global_mutex_type& global_critical_region::mutex() { return global_mutex; }
 
+uint64_t global_critical_region::contention_count() {
+  return global_mutex_contention_count.load(std::memory_order_relaxed);
+}
+
 }  // namespace xe
@@ -13,6 +13,13 @@
 #include "memory.h"
 #include "platform.h"
 #define XE_ENABLE_FAST_WIN32_MUTEX 1
+// Records the wait and hold times of the global critical region and xe_mutex
+// per acquisition site, see lock_instrumentation.h. Adds an internal lock to
+// every acquisition and release, diagnostic builds only.
+#define XE_ENABLE_LOCK_INSTRUMENTATION 0
+#if XE_ENABLE_LOCK_INSTRUMENTATION == 1
+#include "xenia/base/lock_instrumentation.h"
+#endif
 namespace xe {
 
 #if XE_PLATFORM_WIN32 == 1 && XE_ENABLE_FAST_WIN32_MUTEX == 1
@@ -36,7 +43,6 @@ class alignas(4096) xe_global_mutex {
   void unlock();
   bool try_lock();
 };
-using global_mutex_type = xe_global_mutex;
 
 class alignas(64) xe_fast_mutex {
   XE_MAYBE_UNUSED
@@ -79,12 +85,96 @@ class xe_unlikely_mutex {
   void unlock() { mut.exchange(0); }
   bool try_lock() { return _tryget(); }
 };
-using xe_mutex = xe_fast_mutex;
+using xe_plain_mutex = xe_fast_mutex;
 #else
-using global_mutex_type = std::recursive_mutex;
-using xe_mutex = std::mutex;
+// A std::recursive_mutex that counts contended acquisitions, like the win32
+// xe_global_mutex.
+class xe_global_mutex {
+ public:
+  void lock();
+  void unlock() { mutex_.unlock(); }
+  bool try_lock() { return mutex_.try_lock(); }
+
+ private:
+  std::recursive_mutex mutex_;
+};
+using xe_plain_mutex = std::mutex;
 using xe_unlikely_mutex = std::mutex;
 #endif
+
+#if XE_ENABLE_LOCK_INSTRUMENTATION == 1
+// Reports the wait and hold times of the wrapped mutex. Recursive acquisitions
+// are counted once, from the outermost lock to the matching unlock. The time
+// spent recording is excluded from the hold time.
+template <typename Mutex>
+class instrumented_mutex {
+ public:
+  explicit instrumented_mutex(const char* name = "xe_mutex") : name_(name) {}
+
+  void lock() {
+    auto site = lock_instrumentation::TakePendingSite();
+    if (mutex_.try_lock()) {
+      OnLocked(site, false, 0);
+      return;
+    }
+    uint64_t wait_start_ns = lock_instrumentation::QueryTimeNs();
+    mutex_.lock();
+    OnLocked(site, true, wait_start_ns);
+  }
+  void unlock() {
+    if (--depth_) {
+      mutex_.unlock();
+      return;
+    }
+    uint64_t hold_ns = lock_instrumentation::QueryTimeNs() - acquire_time_ns_;
+    // The members may be overwritten by the next owner once unlocked.
+    lock_instrumentation::Site site = site_;
+    mutex_.unlock();
+    lock_instrumentation::RecordRelease(this, name_, site, hold_ns);
+  }
+  bool try_lock() {
+    auto site = lock_instrumentation::TakePendingSite();
+    if (!mutex_.try_lock()) {
+      return false;
+    }
+    OnLocked(site, false, 0);
+    return true;
+  }
+
+ private:
+  void OnLocked(const lock_instrumentation::Site& site, bool contended,
+                uint64_t wait_start_ns) {
+    if (depth_++) {
+      return;
+    }
+    site_ = site;
+    uint64_t wait_ns =
+        contended ? lock_instrumentation::QueryTimeNs() - wait_start_ns : 0;
+    lock_instrumentation::RecordAcquire(this, name_, site, contended, wait_ns);
+    acquire_time_ns_ = lock_instrumentation::QueryTimeNs();
+  }
+
+  Mutex mutex_;
+  const char* name_;
+  // Only accessed by the owner.
+  uint32_t depth_ = 0;
+  uint64_t acquire_time_ns_ = 0;
+  lock_instrumentation::Site site_;
+};
+using global_mutex_type = instrumented_mutex<xe_global_mutex>;
+using xe_mutex = instrumented_mutex<xe_plain_mutex>;
+// Attributes global critical region acquisitions to the caller.
+#define XE_LOCK_SITE_PARAMS                 \
+  const char* site_file = __builtin_FILE(), \
+      uint32_t site_line = __builtin_LINE()
+#define XE_LOCK_SITE_SET() \
+  lock_instrumentation::SetPendingSite(site_file, site_line)
+#else
+using global_mutex_type = xe_global_mutex;
+using xe_mutex = xe_plain_mutex;
+#define XE_LOCK_SITE_PARAMS
+#define XE_LOCK_SITE_SET()
+#endif
 struct null_mutex {
  public:
   static void lock() {}
@@ -136,16 +226,21 @@ class global_critical_region {
   constexpr global_critical_region() {}
   static global_mutex_type& mutex();
 
+  // Number of acquisitions that had to wait for another thread since startup.
+  static uint64_t contention_count();
+
   // Acquires a lock on the global critical section.
   // Use this when keeping an instance is not possible. Otherwise, prefer
   // to keep an instance of global_critical_region near the members requiring
   // it to keep things readable.
-  static global_unique_lock_type AcquireDirect() {
+  static global_unique_lock_type AcquireDirect(XE_LOCK_SITE_PARAMS) {
+    XE_LOCK_SITE_SET();
     return global_unique_lock_type(mutex());
   }
 
   // Acquires a lock on the global critical section.
-  static inline global_unique_lock_type Acquire() {
+  static inline global_unique_lock_type Acquire(XE_LOCK_SITE_PARAMS) {
+    XE_LOCK_SITE_SET();
     return global_unique_lock_type(mutex());
   }
 
@@ -162,7 +257,8 @@ class global_critical_region {
 
   // Tries to acquire a lock on the glboal critical section.
   // Check owns_lock() to see if the lock was successfully acquired.
-  static inline global_unique_lock_type TryAcquire() {
+  static inline global_unique_lock_type TryAcquire(XE_LOCK_SITE_PARAMS) {
+    XE_LOCK_SITE_SET();
     return global_unique_lock_type(mutex(), std::try_to_lock);
   }
 };
@@ -63,6 +63,8 @@ void InitFeatureFlags() {
     TEST_EMIT_FEATURE(kX64EmitAVX512DQ, Xbyak::util::Cpu::tAVX512DQ);
     TEST_EMIT_FEATURE(kX64EmitAVX512VBMI, Xbyak::util::Cpu::tAVX512VBMI);
     TEST_EMIT_FEATURE(kX64EmitPrefetchW, Xbyak::util::Cpu::tPREFETCHW);
+    TEST_EMIT_FEATURE(kX64EmitAESNI, Xbyak::util::Cpu::tAESNI);
+    TEST_EMIT_FEATURE(kX64EmitSHA, Xbyak::util::Cpu::tSHA);
 #undef TEST_EMIT_FEATURE
     /*
     fix for xbyak bug/omission, amd cpus are never checked for lzcnt. fixed in
@@ -127,6 +129,10 @@ void InitFeatureFlags() {
     if ((data[1] & (1 << 9)) && (cvars::x64_extension_mask & kX64FastRepMovs)) {
       feature_flags_ |= kX64FastRepMovs;
     }
+    if ((data[2] & (1 << 5)) &&
+        (cvars::x64_extension_mask & kX64EmitWaitPkg)) {
+      feature_flags_ |= kX64EmitWaitPkg;
+    }
   }
   g_feature_flags = feature_flags_;
   g_did_initialize_feature_flags = true;
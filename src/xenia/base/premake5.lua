@@ -13,8 +13,23 @@ project("xenia-base")
   local_platform_files()
   removefiles({"console_app_main_*.cc"})
   removefiles({"main_init_*.cc"})
+  removefiles({"log_decode_main.cc"})
   files({
     "debug_visualizers.natvis",
   })
 
+group("src")
+project("xenia-log-decode")
+  uuid("3e9c51a2-7d84-4b0f-a6e1-c25f08d94b37")
+  kind("ConsoleApp")
+  language("C++")
+  links({
+    "fmt",
+    "xenia-base",
+  })
+  files({
+    "log_decode_main.cc",
+    "console_app_main_"..platform_suffix..".cc",
+  })
+
 include("testing")
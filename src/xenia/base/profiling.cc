@@ -9,6 +9,8 @@
 
 #include <algorithm>
 #include <string>
+#include <string_view>
+#include <vector>
 
 // NOTE: this must be included before microprofile as macro expansion needs
 // XELOGI.
@@ -36,6 +38,7 @@
 
 #include "xenia/base/assert.h"
 #include "xenia/base/cvar.h"
+#include "xenia/base/mutex.h"
 #include "xenia/base/profiling.h"
 #include "xenia/ui/ui_event.h"
 #include "xenia/ui/virtual_key.h"
@@ -274,6 +277,11 @@ void Profiler::SetUserIO(size_t z_order, ui::Window* window,
 }
 
 void Profiler::Flip() {
+  static uint64_t last_contention_count = 0;
+  uint64_t contention_count = global_critical_region::contention_count();
+  COUNT_profile_set("base/global_lock_contentions_per_frame",
+                    int64_t(contention_count - last_contention_count));
+  last_contention_count = contention_count;
   MicroProfileFlip();
   // This can be called from non-UI threads, so not trying to access the drawer
   // to trigger redraw here as it's owned and managed exclusively by the UI
@@ -281,6 +289,45 @@ void Profiler::Flip() {
 }
 
 #if XE_OPTION_PROFILING_UI
+#if XE_ENABLE_LOCK_INSTRUMENTATION == 1
+// The most waited for lock sites of the last second, in the top right corner.
+static void DrawLockStatistics(ui::MicroprofileDrawer& drawer,
+                               uint32_t coordinate_space_width) {
+  constexpr size_t kMaxSites = 8;
+  constexpr int kLineHeight = MICROPROFILE_TEXT_HEIGHT + 2;
+  auto sites = lock_instrumentation::GetLastSecond();
+  if (sites.empty()) {
+    return;
+  }
+  std::vector<std::string> lines;
+  lines.push_back("lock site                      wait ms  max ms  hold ms  "
+                  "acquired contended");
+  for (size_t i = 0; i < std::min(sites.size(), kMaxSites); ++i) {
+    auto& stats = sites[i];
+    std::string_view file = stats.site.file ? stats.site.file : "?";
+    size_t separator = file.find_last_of("/\\");
+    if (separator != std::string_view::npos) {
+      file.remove_prefix(separator + 1);
+    }
+    lines.push_back(fmt::format(
+        "{:<30.30} {:>7.2f} {:>7.2f} {:>8.2f} {:>9} {:>9}",
+        fmt::format("{}:{}", file, stats.site.line), stats.wait_ns / 1e6,
+        stats.max_wait_ns / 1e6, stats.hold_ns / 1e6, stats.acquisitions,
+        stats.contentions));
+  }
+  int width = int(lines[0].size()) * MICROPROFILE_TEXT_WIDTH;
+  int x = std::max(0, int(coordinate_space_width) - width - 8);
+  int y = 40;
+  drawer.DrawBox(x - 4, y - 4, x + width + 4,
+                 y + int(lines.size()) * kLineHeight + 2, 0xC0000000,
+                 ui::MicroprofileDrawer::BoxType::kFlat);
+  for (auto& line : lines) {
+    drawer.DrawTextString(x, y, 0xFFFFFFFF, line.c_str(), int(line.size()));
+    y += kLineHeight;
+  }
+}
+#endif  // XE_ENABLE_LOCK_INSTRUMENTATION
+
 void Profiler::ProfilerUIDrawer::Draw(ui::UIDrawContext& ui_draw_context) {
   if (!window_ || !presenter_ || !drawer_) {
     return;
@@ -295,6 +342,9 @@ void Profiler::ProfilerUIDrawer::Draw(ui::UIDrawContext& ui_draw_context) {
   drawer_->Begin(ui_draw_context, coordinate_space_width,
                  coordinate_space_height);
   MicroProfileDraw(coordinate_space_width, coordinate_space_height);
+#if XE_ENABLE_LOCK_INSTRUMENTATION == 1
+  DrawLockStatistics(*drawer_, coordinate_space_width);
+#endif  // XE_ENABLE_LOCK_INSTRUMENTATION
   drawer_->End();
   // Continuous repaint.
   if (is_visible()) {
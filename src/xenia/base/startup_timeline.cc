@@ -0,0 +1,171 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2026 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/base/startup_timeline.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "third_party/fmt/include/fmt/format.h"
+#include "xenia/base/clock.h"
+#include "xenia/base/cvar.h"
+#include "xenia/base/filesystem.h"
+#include "xenia/base/logging.h"
+#include "xenia/base/threading.h"
+
+DEFINE_path(startup_timeline, "",
+            "File to write the timeline of the emulator and title startup to, "
+            "in the Chrome trace JSON format, when the first frame is "
+            "presented.",
+            "General");
+
+namespace xe {
+namespace startup_timeline {
+
+namespace {
+
+struct Event {
+  const char* name;
+  uint64_t start_ticks;
+  // UINT64_MAX for instant events.
+  uint64_t end_ticks;
+  uint32_t thread_id;
+};
+
+std::atomic<bool> finished = {false};
+std::mutex events_mutex;
+std::vector<Event> events;
+
+void AddEvent(const char* name, uint64_t start_ticks, uint64_t end_ticks) {
+  std::lock_guard<std::mutex> lock(events_mutex);
+  if (finished.load(std::memory_order_relaxed)) {
+    return;
+  }
+  events.push_back(
+      {name, start_ticks, end_ticks, threading::current_thread_system_id()});
+}
+
+uint64_t TicksToMicroseconds(uint64_t ticks) {
+  return ticks * 1000000 / Clock::QueryHostTickFrequency();
+}
+
+void AppendJsonString(std::string& json, const char* string) {
+  json += '"';
+  for (const char* c = string; *c; ++c) {
+    switch (*c) {
+      case '"':
+      case '\\':
+        json += '\\';
+        json += *c;
+        break;
+      default:
+        if (uint8_t(*c) >= 0x20) {
+          json += *c;
+        }
+        break;
+    }
+  }
+  json += '"';
+}
+
+}  // namespace
+
+bool IsRecording() {
+  return !cvars::startup_timeline.empty() &&
+         !finished.load(std::memory_order_relaxed);
+}
+
+void AddSpan(const char* name, uint64_t start_ticks, uint64_t end_ticks) {
+  if (IsRecording()) {
+    AddEvent(name, start_ticks, end_ticks);
+  }
+}
+
+void AddInstantEvent(const char* name) {
+  if (IsRecording()) {
+    AddEvent(name, Clock::QueryHostTickCount(), UINT64_MAX);
+  }
+}
+
+void Finish(const char* name) {
+  if (!IsRecording()) {
+    return;
+  }
+  std::vector<Event> finished_events;
+  {
+    std::lock_guard<std::mutex> lock(events_mutex);
+    if (finished.load(std::memory_order_relaxed)) {
+      return;
+    }
+    events.push_back({name, Clock::QueryHostTickCount(), UINT64_MAX,
+                      threading::current_thread_system_id()});
+    finished.store(true, std::memory_order_relaxed);
+    finished_events = std::move(events);
+    events.clear();
+  }
+
+  // The timestamps are relative to the first event.
+  uint64_t origin_ticks = UINT64_MAX;
+  for (const Event& event : finished_events) {
+    origin_ticks = std::min(origin_ticks, event.start_ticks);
+  }
+
+  std::string json = "{\"traceEvents\":[\n";
+  for (size_t i = 0; i < finished_events.size(); ++i) {
+    const Event& event = finished_events[i];
+    json += "{\"name\":";
+    AppendJsonString(json, event.name);
+    uint64_t start_microseconds =
+        TicksToMicroseconds(event.start_ticks - origin_ticks);
+    if (event.end_ticks == UINT64_MAX) {
+      json += fmt::format(",\"ph\":\"i\",\"s\":\"g\",\"ts\":{}",
+                          start_microseconds);
+    } else {
+      json += fmt::format(
+          ",\"ph\":\"X\",\"ts\":{},\"dur\":{}", start_microseconds,
+          TicksToMicroseconds(event.end_ticks - event.start_ticks));
+    }
+    json += fmt::format(",\"pid\":1,\"tid\":{}}}", event.thread_id);
+    json += i + 1 < finished_events.size() ? ",\n" : "\n";
+  }
+  json += "]}\n";
+
+  FILE* file = xe::filesystem::OpenFile(cvars::startup_timeline, "wb");
+  if (!file) {
+    XELOGE("Failed to create the startup timeline file {}",
+           xe::path_to_utf8(cvars::startup_timeline));
+    return;
+  }
+  bool written = fwrite(json.data(), json.size(), 1, file) == 1;
+  fclose(file);
+  if (!written) {
+    XELOGE("Failed to write the startup timeline file {}",
+           xe::path_to_utf8(cvars::startup_timeline));
+    return;
+  }
+  XELOGI("Wrote the startup timeline with {} events to {}",
+         finished_events.size(), xe::path_to_utf8(cvars::startup_timeline));
+}
+
+ScopedSpan::ScopedSpan(const char* name)
+    : name_(name),
+      start_ticks_(IsRecording() ? Clock::QueryHostTickCount() : 0) {}
+
+ScopedSpan::~ScopedSpan() {
+  if (start_ticks_) {
+    AddSpan(name_, start_ticks_, Clock::QueryHostTickCount());
+  }
+}
+
+}  // namespace startup_timeline
+}  // namespace xe
@@ -0,0 +1,57 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2026 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#ifndef XENIA_BASE_STARTUP_TIMELINE_H_
+#define XENIA_BASE_STARTUP_TIMELINE_H_
+
+#include <cstdint>
+
+namespace xe {
+namespace startup_timeline {
+
+// Spans of the work done while a title is starting, with host timestamps,
+// written as a Chrome trace (chrome://tracing, Perfetto) to startup_timeline
+// when the first frame is presented. Recording stops after that, so the spans
+// have no overhead later. The names must be string literals.
+
+bool IsRecording();
+
+void AddSpan(const char* name, uint64_t start_ticks, uint64_t end_ticks);
+void AddInstantEvent(const char* name);
+
+// Adds the instant event, writes the timeline and stops recording. Only the
+// first call has any effect.
+void Finish(const char* name);
+
+class ScopedSpan {
+ public:
+  explicit ScopedSpan(const char* name);
+  ~ScopedSpan();
+
+  ScopedSpan(const ScopedSpan& span) = delete;
+  ScopedSpan& operator=(const ScopedSpan& span) = delete;
+
+ private:
+  const char* name_;
+  uint64_t start_ticks_;
+};
+
+}  // namespace startup_timeline
+}  // namespace xe
+
+#define XE_STARTUP_TIMELINE_SPAN_CONCAT_(a, b) a##b
+#define XE_STARTUP_TIMELINE_SPAN_NAME_(line) \
+  XE_STARTUP_TIMELINE_SPAN_CONCAT_(startup_timeline_span_, line)
+// Records the time until the end of the scope as a span of the startup
+// timeline.
+#define SCOPE_startup_timeline(name)                             \
+  xe::startup_timeline::ScopedSpan XE_STARTUP_TIMELINE_SPAN_NAME_( \
+      __LINE__)(name)
+
+#endif  // XENIA_BASE_STARTUP_TIMELINE_H_
@@ -0,0 +1,255 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2026 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+#include "xenia/base/concurrent_ring_buffer.h"
+
+#include "third_party/catch/include/catch.hpp"
+
+namespace xe {
+namespace base {
+namespace test {
+
+TEST_CASE("SpscRingBuffer push and pop", "[concurrent_ring_buffer]") {
+  auto ring = std::make_unique<SpscRingBuffer<uint32_t, 4>>();
+  uint32_t value = 0;
+  REQUIRE(ring->empty());
+  REQUIRE_FALSE(ring->TryPop(value));
+
+  for (uint32_t i = 0; i < 4; ++i) {
+    REQUIRE(ring->TryPush(i));
+  }
+  REQUIRE_FALSE(ring->TryPush(uint32_t(4)));
+
+  // Wrapping around.
+  for (uint32_t lap = 0; lap < 3; ++lap) {
+    for (uint32_t i = 0; i < 4; ++i) {
+      REQUIRE(ring->TryPop(value));
+      REQUIRE(value == lap * 4 + i);
+      REQUIRE(ring->TryPush((lap + 1) * 4 + i));
+    }
+  }
+  REQUIRE_FALSE(ring->empty());
+}
+
+TEST_CASE("SpscRingBuffer batches", "[concurrent_ring_buffer]") {
+  auto ring = std::make_unique<SpscRingBuffer<uint32_t, 8>>();
+  uint32_t values[12];
+  for (uint32_t i = 0; i < 12; ++i) {
+    values[i] = i;
+  }
+  REQUIRE(ring->TryPushBatch(values, 5) == 5);
+  // Only the free slots are filled.
+  REQUIRE(ring->TryPushBatch(values + 5, 7) == 3);
+
+  uint32_t popped[12] = {};
+  REQUIRE(ring->TryPopBatch(popped, 6) == 6);
+  REQUIRE(ring->TryPushBatch(values + 8, 4) == 4);
+  REQUIRE(ring->TryPopBatch(popped + 6, 12) == 6);
+  for (uint32_t i = 0; i < 12; ++i) {
+    REQUIRE(popped[i] == i);
+  }
+  REQUIRE(ring->TryPopBatch(popped, 12) == 0);
+}
+
+TEST_CASE("Concurrent ring buffers release popped values",
+          "[concurrent_ring_buffer]") {
+  auto value = std::make_shared<int>(1);
+  std::shared_ptr<int> popped;
+
+  auto spsc = std::make_unique<SpscRingBuffer<std::shared_ptr<int>, 2>>();
+  REQUIRE(spsc->TryPush(value));
+  REQUIRE(value.use_count() == 2);
+  REQUIRE(spsc->TryPop(popped));
+  popped.reset();
+  REQUIRE(value.use_count() == 1);
+
+  auto mpsc = std::make_unique<MpscRingBuffer<std::shared_ptr<int>, 2>>();
+  REQUIRE(mpsc->TryPush(value));
+  REQUIRE(mpsc->TryPop(popped));
+  popped.reset();
+  REQUIRE(value.use_count() == 1);
+
+  // A failed push must not take the value.
+  REQUIRE(mpsc->TryPush(value));
+  REQUIRE(mpsc->TryPush(value));
+  std::shared_ptr<int> value_to_move = value;
+  REQUIRE_FALSE(mpsc->TryPush(std::move(value_to_move)));
+  REQUIRE(value_to_move);
+}
+
+TEST_CASE("SpscRingBuffer across threads", "[concurrent_ring_buffer]") {
+  constexpr uint32_t kValueCount = 1000000;
+  auto ring = std::make_unique<SpscRingBuffer<uint32_t, 64>>();
+
+  std::thread producer([&ring]() {
+    uint32_t batch[16];
+    uint32_t next = 0;
+    while (next < kValueCount) {
+      uint32_t batch_size = std::min(uint32_t(16), kValueCount - next);
+      for (uint32_t i = 0; i < batch_size; ++i) {
+        batch[i] = next + i;
+      }
+      size_t pushed = ring->TryPushBatch(batch, batch_size);
+      next += uint32_t(pushed);
+      if (!pushed) {
+        std::this_thread::yield();
+      }
+    }
+  });
+
+  uint32_t expected = 0;
+  bool in_order = true;
+  while (expected < kValueCount) {
+    uint32_t value;
+    if (!ring->TryPop(value)) {
+      std::this_thread::yield();
+      continue;
+    }
+    in_order &= value == expected;
+    ++expected;
+  }
+  producer.join();
+  REQUIRE(in_order);
+  REQUIRE(ring->empty());
+}
+
+TEST_CASE("MpscRingBuffer across threads", "[concurrent_ring_buffer]") {
+  constexpr uint32_t kProducerCount = 4;
+  constexpr uint32_t kValuesPerProducer = 250000;
+  auto ring = std::make_unique<MpscRingBuffer<uint32_t, 64>>();
+
+  std::vector<std::thread> producers;
+  for (uint32_t producer_index = 0; producer_index < kProducerCount;
+       ++producer_index) {
+    producers.emplace_back([&ring, producer_index]() {
+      for (uint32_t i = 0; i < kValuesPerProducer; ++i) {
+        // The producer index in the upper bits.
+        while (!ring->TryPush((producer_index << 24) | i)) {
+          std::this_thread::yield();
+        }
+      }
+    });
+  }
+
+  // Values from each producer must arrive in order.
+  uint32_t next_expected[kProducerCount] = {};
+  uint32_t received = 0;
+  bool in_order = true;
+  while (received < kProducerCount * kValuesPerProducer) {
+    uint32_t value;
+    if (!ring->TryPop(value)) {
+      std::this_thread::yield();
+      continue;
+    }
+    uint32_t producer_index = value >> 24;
+    REQUIRE(producer_index < kProducerCount);
+    in_order &= (value & 0xFFFFFF) == next_expected[producer_index];
+    ++next_expected[producer_index];
+    ++received;
+  }
+  for (std::thread& producer : producers) {
+    producer.join();
+  }
+  REQUIRE(in_order);
+  REQUIRE(ring->empty());
+}
+
+namespace {
+
+constexpr uint32_t kBenchmarkValueCount = 10000000;
+
+// Returns millions of values per second.
+template <typename Push, typename Pop>
+double MeasureHandoff(uint32_t producer_count, Push push, Pop pop) {
+  auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> producers;
+  uint32_t values_per_producer = kBenchmarkValueCount / producer_count;
+  for (uint32_t i = 0; i < producer_count; ++i) {
+    producers.emplace_back([&push, values_per_producer]() {
+      for (uint32_t j = 0; j < values_per_producer; ++j) {
+        while (!push(j)) {
+          std::this_thread::yield();
+        }
+      }
+    });
+  }
+  uint32_t total = values_per_producer * producer_count;
+  for (uint32_t received = 0; received < total;) {
+    uint32_t value;
+    if (pop(value)) {
+      ++received;
+    } else {
+      std::this_thread::yield();
+    }
+  }
+  for (std::thread& producer : producers) {
+    producer.join();
+  }
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return double(total) / 1000000.0 / elapsed.count();
+}
+
+}  // namespace
+
+// Compares the ring buffers with a mutex-protected std::queue, as previously
+// used for the handoffs. Not run by default:
+//   xenia-base-tests "[benchmark]"
+TEST_CASE("Concurrent ring buffer throughput", "[.][benchmark]") {
+  std::mutex mutex;
+  std::queue<uint32_t> queue;
+  auto queue_push = [&](uint32_t value) {
+    std::lock_guard<std::mutex> lock(mutex);
+    queue.push(value);
+    return true;
+  };
+  auto queue_pop = [&](uint32_t& value) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (queue.empty()) {
+      return false;
+    }
+    value = queue.front();
+    queue.pop();
+    return true;
+  };
+
+  auto spsc = std::make_unique<SpscRingBuffer<uint32_t, 1024>>();
+  auto mpsc = std::make_unique<MpscRingBuffer<uint32_t, 1024>>();
+
+  WARN("SPSC: " << MeasureHandoff(
+                       1, [&](uint32_t value) { return spsc->TryPush(value); },
+                       [&](uint32_t& value) { return spsc->TryPop(value); })
+                << " M/s");
+  WARN("MPSC, 1 producer: "
+       << MeasureHandoff(
+              1, [&](uint32_t value) { return mpsc->TryPush(value); },
+              [&](uint32_t& value) { return mpsc->TryPop(value); })
+       << " M/s");
+  WARN("MPSC, 4 producers: "
+       << MeasureHandoff(
+              4, [&](uint32_t value) { return mpsc->TryPush(value); },
+              [&](uint32_t& value) { return mpsc->TryPop(value); })
+       << " M/s");
+  WARN("std::queue with a mutex, 1 producer: "
+       << MeasureHandoff(1, queue_push, queue_pop) << " M/s");
+  WARN("std::queue with a mutex, 4 producers: "
+       << MeasureHandoff(4, queue_push, queue_pop) << " M/s");
+}
+
+}  // namespace test
+}  // namespace base
+}  // namespace xe
@@ -14,7 +14,10 @@
 
 #include "xenia/base/clock.h"
 
+#include <algorithm>
 #include <array>
+#include <chrono>
+#include <vector>
 
 namespace xe {
 namespace base {
@@ -506,6 +509,190 @@ TEST_CASE("copy_and_swap_16_in_32_unaligned", "[copy_and_swap]") {
   }
 }
 
+TEST_CASE("copy_and_swap large unaligned copies", "[copy_and_swap]") {
+  // Larger than the threshold for non-temporal stores, with every alignment
+  // of the destination and an odd residual.
+  constexpr size_t count = (1024 * 1024 + 1040) / 4 + 3;
+  std::vector<uint32_t> src(count + 4);
+  for (size_t i = 0; i < src.size(); ++i) {
+    src[i] = static_cast<uint32_t>(i * 0x01010101 + 0x00020406);
+  }
+  std::vector<uint8_t> dst((count + 4) * 4);
+  for (size_t offset = 0; offset < 16; ++offset) {
+    std::fill(dst.begin(), dst.end(), uint8_t(0xCD));
+    copy_and_swap_32_unaligned(dst.data() + offset, src.data() + 1, count);
+    for (size_t i = 0; i < offset; ++i) {
+      REQUIRE(dst[i] == 0xCD);
+    }
+    for (size_t i = 0; i < count; ++i) {
+      uint32_t value;
+      std::memcpy(&value, dst.data() + offset + i * 4, sizeof(value));
+      REQUIRE(value == byte_swap(src[1 + i]));
+    }
+    for (size_t i = offset + count * 4; i < dst.size(); ++i) {
+      REQUIRE(dst[i] == 0xCD);
+    }
+  }
+
+  std::vector<uint32_t> rotated(count);
+  copy_and_swap_16_in_32_unaligned(rotated.data(), src.data(), count);
+  for (size_t i = 0; i < count; ++i) {
+    REQUIRE(rotated[i] == ((src[i] >> 16) | (src[i] << 16)));
+  }
+}
+
+TEST_CASE("copy_and_swap in place", "[copy_and_swap]") {
+  // Counts leaving residual elements after the vectors, small and above the
+  // threshold for non-temporal stores, where the destination is aligned by
+  // swapping whole elements first.
+  using Function = void (*)(void* dest, const void* src, size_t count);
+  static const uint8_t kSwap16[] = {1, 0};
+  static const uint8_t kSwap32[] = {3, 2, 1, 0};
+  static const uint8_t kSwap64[] = {7, 6, 5, 4, 3, 2, 1, 0};
+  static const uint8_t kSwap16In32[] = {2, 3, 0, 1};
+  const struct {
+    Function function;
+    size_t element_size;
+    const uint8_t* byte_order;
+  } functions[] = {
+      {copy_and_swap_16_unaligned, 2, kSwap16},
+      {copy_and_swap_32_unaligned, 4, kSwap32},
+      {copy_and_swap_64_unaligned, 8, kSwap64},
+      {copy_and_swap_16_in_32_unaligned, 4, kSwap16In32},
+  };
+  for (const auto& function : functions) {
+    size_t element_size = function.element_size;
+    for (size_t count : {size_t(37), 1024 * 1024 / element_size + 7}) {
+      std::vector<uint8_t> original((count + 1) * element_size);
+      for (size_t i = 0; i < original.size(); ++i) {
+        original[i] = static_cast<uint8_t>(i * 7 + (i >> 8));
+      }
+      std::vector<uint8_t> data(original);
+      // Misaligned by one element from the start of the allocation.
+      uint8_t* elements = data.data() + element_size;
+      function.function(elements, elements, count);
+      for (size_t i = 0; i < count * element_size; ++i) {
+        size_t element_start = i - i % element_size;
+        REQUIRE(elements[i] ==
+                original[element_size + element_start +
+                         function.byte_order[i % element_size]]);
+      }
+    }
+  }
+}
+
+// Reports the throughput of the copy_and_swap kernels selected for the host.
+// Not run by default:
+//   xenia-base-tests "[benchmark]"
+TEST_CASE("copy_and_swap throughput", "[.][benchmark]") {
+  constexpr size_t kMaxSize = 64 * 1024 * 1024;
+  std::vector<uint8_t> src(kMaxSize, uint8_t(0x5A));
+  std::vector<uint8_t> dst(kMaxSize);
+  using Function = void (*)(void* dest, const void* src, size_t count);
+  const struct {
+    const char* name;
+    Function function;
+    size_t element_size;
+  } functions[] = {
+      {"16", copy_and_swap_16_unaligned, 2},
+      {"32", copy_and_swap_32_unaligned, 4},
+      {"64", copy_and_swap_64_unaligned, 8},
+      {"16_in_32", copy_and_swap_16_in_32_unaligned, 4},
+  };
+  for (const auto& function : functions) {
+    for (size_t size = 64; size <= kMaxSize; size *= 4) {
+      // Around 1 GB per size.
+      size_t iterations = std::max(size_t(1), (size_t(1) << 30) / size);
+      auto start = std::chrono::steady_clock::now();
+      for (size_t i = 0; i < iterations; ++i) {
+        function.function(dst.data(), src.data(),
+                          size / function.element_size);
+      }
+      std::chrono::duration<double> elapsed =
+          std::chrono::steady_clock::now() - start;
+      WARN("copy_and_swap_" << function.name << ", " << size << " bytes: "
+                            << double(size) * iterations / elapsed.count() /
+                                   (1024.0 * 1024.0 * 1024.0)
+                            << " GiB/s");
+    }
+  }
+}
+
+TEST_CASE("find_terminator_be16", "[find_terminator_be16]") {
+  // Big-endian "Score: %d" and the terminator, at every alignment.
+  const char text[] = "Score: %d";
+  alignas(16) uint16_t buffer[64];
+  for (size_t offset = 0; offset < 16; ++offset) {
+    std::fill(std::begin(buffer), std::end(buffer), uint16_t(0x4141));
+    uint16_t* string = buffer + offset;
+    for (size_t i = 0; i < sizeof(text); ++i) {
+      string[i] = byte_swap(uint16_t(text[i]));
+    }
+    REQUIRE(find_terminator_be16(string, SIZE_MAX) == sizeof(text) - 1);
+    REQUIRE(find_terminator_be16(string, SIZE_MAX, u'%') == 7);
+    REQUIRE(find_terminator_be16(string, 3) == 3);
+    REQUIRE(find_terminator_be16(string, 0) == 0);
+    REQUIRE(find_terminator_be16(string + 10, SIZE_MAX) == 0);
+  }
+}
+
+// Compares find_terminator_be16 with the per-character loop previously used
+// for the guest strings. Not run by default:
+//   xenia-base-tests "[benchmark]"
+TEST_CASE("find_terminator_be16 throughput", "[.][benchmark]") {
+  for (size_t length : {8, 32, 128, 1024}) {
+    std::vector<uint16_t> string(length + 1, byte_swap(uint16_t('a')));
+    string[length] = 0;
+    constexpr size_t kIterations = 1000000;
+    size_t sum = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < kIterations; ++i) {
+      size_t result = 0;
+      for (const uint16_t* c = string.data(); *c; ++c) {
+        ++result;
+      }
+      sum += result;
+    }
+    std::chrono::duration<double> loop_elapsed =
+        std::chrono::steady_clock::now() - start;
+    start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < kIterations; ++i) {
+      sum += find_terminator_be16(string.data(), SIZE_MAX);
+    }
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    REQUIRE(sum == length * kIterations * 2);
+    WARN(length << " characters: loop " << loop_elapsed.count() * 1000.0
+                << " ms, find_terminator_be16 " << elapsed.count() * 1000.0
+                << " ms");
+  }
+}
+
+TEST_CASE("fill_streaming and copy_streaming", "[streaming]") {
+  std::vector<uint8_t> src(1024);
+  for (size_t i = 0; i < src.size(); ++i) {
+    src[i] = static_cast<uint8_t>(i * 13 + 1);
+  }
+  std::vector<uint8_t> dst(1100);
+  for (size_t offset = 0; offset < 40; ++offset) {
+    for (size_t size : {0, 1, 31, 64, 65, 1000}) {
+      std::fill(dst.begin(), dst.end(), uint8_t(0xEE));
+      memory::fill_streaming(dst.data() + offset, 0x5A, size);
+      for (size_t i = 0; i < dst.size(); ++i) {
+        bool in_range = i >= offset && i < offset + size;
+        REQUIRE(dst[i] == (in_range ? 0x5A : 0xEE));
+      }
+
+      std::fill(dst.begin(), dst.end(), uint8_t(0xEE));
+      memory::copy_streaming(dst.data() + offset, src.data() + 3, size);
+      for (size_t i = 0; i < dst.size(); ++i) {
+        bool in_range = i >= offset && i < offset + size;
+        REQUIRE(dst[i] == (in_range ? src[i - offset + 3] : 0xEE));
+      }
+    }
+  }
+}
+
 TEST_CASE("create_and_close_file_mapping", "Virtual Memory Mapping") {
   auto path = fmt::format("xenia_test_{}", Clock::QueryHostTickCount());
   auto memory = xe::memory::CreateFileMappingHandle(
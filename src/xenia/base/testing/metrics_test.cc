@@ -0,0 +1,88 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2026 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "xenia/base/metrics.h"
+
+#include "third_party/catch/include/catch.hpp"
+
+namespace xe {
+namespace metrics {
+namespace test {
+
+Counter test_counter_("Test", "test_counter", "Test counter");
+Histogram test_histogram_("Test", "test_histogram", "Test histogram");
+
+MetricValue GetValue(const Metric& metric) {
+  for (const MetricValue& value : Aggregate()) {
+    if (value.metric == &metric) {
+      return value;
+    }
+  }
+  FAIL("The metric is not registered");
+  return {};
+}
+
+TEST_CASE("Counters are summed over threads", "[metrics]") {
+  Reset();
+  REQUIRE(GetValue(test_counter_).count == 0);
+
+  test_counter_.Increment();
+  test_counter_.Increment(2);
+  REQUIRE(GetValue(test_counter_).count == 3);
+
+  // Including the values of the threads that have exited.
+  std::vector<std::thread> threads;
+  for (uint32_t i = 0; i < 4; ++i) {
+    threads.emplace_back([]() {
+      for (uint32_t j = 0; j < 1000; ++j) {
+        test_counter_.Increment();
+      }
+    });
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  REQUIRE(GetValue(test_counter_).count == 4003);
+
+  Reset();
+  REQUIRE(GetValue(test_counter_).count == 0);
+  test_counter_.Increment();
+  REQUIRE(GetValue(test_counter_).count == 1);
+}
+
+TEST_CASE("Histogram buckets", "[metrics]") {
+  REQUIRE(Histogram::GetBucket(0) == 0);
+  REQUIRE(Histogram::GetBucket(1) == 1);
+  REQUIRE(Histogram::GetBucket(2) == 2);
+  REQUIRE(Histogram::GetBucket(3) == 2);
+  REQUIRE(Histogram::GetBucket(4) == 3);
+  REQUIRE(Histogram::GetBucket(UINT64_MAX) == Histogram::kBucketCount - 1);
+  REQUIRE(Histogram::GetBucketUpperBound(0) == 0);
+  REQUIRE(Histogram::GetBucketUpperBound(2) == 3);
+
+  Reset();
+  for (uint64_t i = 0; i < 100; ++i) {
+    test_histogram_.Record(i < 90 ? 1 : 100);
+  }
+  MetricValue value = GetValue(test_histogram_);
+  REQUIRE(value.count == 100);
+  REQUIRE(value.sum == 90 + 10 * 100);
+  REQUIRE(value.buckets[1] == 90);
+  REQUIRE(value.buckets[Histogram::GetBucket(100)] == 10);
+  REQUIRE(value.GetPercentileUpperBound(0.5) == 1);
+  REQUIRE(value.GetPercentileUpperBound(0.99) == 127);
+}
+
+}  // namespace test
+}  // namespace metrics
+}  // namespace xe
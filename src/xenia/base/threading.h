@@ -29,6 +29,7 @@
 #include "xenia/base/literals.h"
 #include "xenia/base/platform.h"
 #include "xenia/base/threading_timer_queue.h"
+#include "xenia/base/type_pool.h"
 
 namespace xe {
 namespace threading {
@@ -90,10 +91,63 @@ class Fence {
 // Returns the total number of logical processors in the host system.
 uint32_t logical_processor_count();
 
+// Invokes the function for every index from 0 to count - 1 on the calling
+// thread and on temporary threads, one per additional logical processor at
+// most (or up to max_thread_count threads in total), and returns when all the
+// invocations are done.
+template <typename Function>
+void ParallelFor(size_t count, const Function& function,
+                 size_t max_thread_count = SIZE_MAX) {
+  std::atomic<size_t> next_index = {0};
+  auto worker = [&]() {
+    while (true) {
+      size_t index = next_index.fetch_add(1, std::memory_order_relaxed);
+      if (index >= count) {
+        break;
+      }
+      function(index);
+    }
+  };
+  size_t thread_count = std::min(
+      {size_t(std::max(logical_processor_count(), uint32_t(1))),
+       std::max(max_thread_count, size_t(1)), count});
+  std::vector<std::thread> threads;
+  if (thread_count > 1) {
+    threads.reserve(thread_count - 1);
+    for (size_t i = 1; i < thread_count; ++i) {
+      threads.emplace_back(worker);
+    }
+  }
+  worker();
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+}
+
 // Enables the current process to set thread affinity.
 // Must be called at startup before attempting to set thread affinity.
 void EnableAffinityConfiguration();
 
+// Returns the masks of the logical processors sharing each physical core of
+// the host (SMT siblings), in the order of their lowest logical processor.
+// Only the first 64 logical processors are considered. Empty if unknown.
+std::vector<uint64_t> QueryPhysicalCoreMasks();
+
+// Returns the masks of the logical processors sharing each last level cache of
+// the host (such as the L3 cache of a CCD), in the order of their lowest
+// logical processor. Only the first 64 logical processors are considered.
+// Empty if unknown.
+std::vector<uint64_t> QueryLastLevelCacheMasks();
+
+// Returns the masks of the logical processors of each NUMA node of the host,
+// indexed by the node number, with zero masks for nodes without processors in
+// the first 64. Empty if unknown.
+std::vector<uint64_t> QueryNumaNodeMasks();
+
+// Returns the logical processor the calling thread is running on, or UINT_MAX
+// if unknown.
+uint32_t current_logical_processor();
+
 // Gets a stable thread-specific ID, but may not be. Use for informative
 // purposes only.
 uint32_t current_thread_system_id();
@@ -121,6 +175,10 @@ void Sleep(std::chrono::duration<Rep, Period> duration) {
   Sleep(std::chrono::duration_cast<std::chrono::microseconds>(duration));
 }
 
+// Allows the host to delay the timed waits and sleeps of the current thread
+// by up to the given duration, to handle them together with other wakeups.
+void set_current_thread_timer_slack(std::chrono::microseconds slack);
+
 enum class SleepResult {
   kSuccess,
   kAlerted,
@@ -201,7 +259,9 @@ enum class WaitResult {
   kFailed,
 };
 
-class WaitHandle {
+// Allocated from pools as titles may create and destroy synchronization
+// objects very frequently, such as every frame.
+class WaitHandle : public ThreadCachedPoolAllocated {
  public:
   virtual ~WaitHandle() = default;
 
@@ -18,12 +18,15 @@
 #include <sched.h>
 #include <signal.h>
 #include <sys/eventfd.h>
+#include <sys/prctl.h>
 #include <sys/syscall.h>
 #include <sys/time.h>
 #include <sys/types.h>
 #include <unistd.h>
+#include <algorithm>
 #include <array>
 #include <cstddef>
+#include <cstdio>
 #include <ctime>
 #include <memory>
 
@@ -132,6 +135,103 @@ void install_signal_handler(SignalType type) {
 // TODO(dougvj)
 void EnableAffinityConfiguration() {}
 
+// Reads a sysfs list of logical processor ranges like "0,8" or "0-1".
+static bool ReadProcessorListFile(const char* path, uint64_t& mask_out) {
+  FILE* file = fopen(path, "r");
+  if (!file) {
+    return false;
+  }
+  uint64_t mask = 0;
+  unsigned int first, last;
+  int separator;
+  while (fscanf(file, "%u", &first) == 1) {
+    last = first;
+    separator = fgetc(file);
+    if (separator == '-') {
+      if (fscanf(file, "%u", &last) != 1) {
+        break;
+      }
+      separator = fgetc(file);
+    }
+    for (unsigned int j = first; j <= last && j < 64; ++j) {
+      mask |= uint64_t(1) << j;
+    }
+    if (separator != ',') {
+      break;
+    }
+  }
+  fclose(file);
+  mask_out = mask;
+  return true;
+}
+
+// Groups the logical processors by the list in the sysfs file of each of them,
+// with the path formatted from the processor index.
+static std::vector<uint64_t> QueryProcessorGroupMasks(const char* path_format) {
+  std::vector<uint64_t> groups;
+  uint32_t count = std::min(logical_processor_count(), uint32_t(64));
+  uint64_t assigned = 0;
+  for (uint32_t i = 0; i < count; ++i) {
+    if (assigned & (uint64_t(1) << i)) {
+      continue;
+    }
+    char path[128];
+    snprintf(path, sizeof(path), path_format, i);
+    uint64_t mask;
+    if (!ReadProcessorListFile(path, mask)) {
+      // Offline, or no topology information.
+      continue;
+    }
+    mask |= uint64_t(1) << i;
+    assigned |= mask;
+    groups.push_back(mask);
+  }
+  return groups;
+}
+
+std::vector<uint64_t> QueryPhysicalCoreMasks() {
+  return QueryProcessorGroupMasks(
+      "/sys/devices/system/cpu/cpu%u/topology/thread_siblings_list");
+}
+
+std::vector<uint64_t> QueryLastLevelCacheMasks() {
+  // index3 is the L3 cache on x86, fall back to the L2 cache if there's no L3.
+  std::vector<uint64_t> caches = QueryProcessorGroupMasks(
+      "/sys/devices/system/cpu/cpu%u/cache/index3/shared_cpu_list");
+  if (caches.empty()) {
+    caches = QueryProcessorGroupMasks(
+        "/sys/devices/system/cpu/cpu%u/cache/index2/shared_cpu_list");
+  }
+  return caches;
+}
+
+std::vector<uint64_t> QueryNumaNodeMasks() {
+  std::vector<uint64_t> nodes;
+  uint64_t node_mask;
+  if (!ReadProcessorListFile("/sys/devices/system/node/online", node_mask)) {
+    return nodes;
+  }
+  // The node list has the same format as the processor lists.
+  for (uint32_t node = 0; node < 64; ++node) {
+    if (!(node_mask & (uint64_t(1) << node))) {
+      continue;
+    }
+    char path[96];
+    snprintf(path, sizeof(path), "/sys/devices/system/node/node%u/cpulist",
+             node);
+    uint64_t mask = 0;
+    ReadProcessorListFile(path, mask);
+    nodes.resize(node + 1);
+    nodes[node] = mask;
+  }
+  return nodes;
+}
+
+uint32_t current_logical_processor() {
+  int cpu = sched_getcpu();
+  return cpu >= 0 ? uint32_t(cpu) : UINT_MAX;
+}
+
 // uint64_t ticks() { return mach_absolute_time(); }
 
 uint32_t current_thread_system_id() {
@@ -159,6 +259,14 @@ void Sleep(std::chrono::microseconds duration) {
   } while (ret == -1 && errno == EINTR);
 }
 
+void set_current_thread_timer_slack(std::chrono::microseconds slack) {
+#ifdef PR_SET_TIMERSLACK
+  // 0 would restore the default slack of the thread, not disable it.
+  prctl(PR_SET_TIMERSLACK,
+        std::max(static_cast<unsigned long>(slack.count()) * 1000, 1ul));
+#endif
+}
+
 // TODO(bwrsandman) Implement by allowing alert interrupts from IO operations
 thread_local bool alertable_state_ = false;
 SleepResult AlertableSleep(std::chrono::microseconds duration) {
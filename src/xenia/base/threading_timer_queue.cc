@@ -8,7 +8,8 @@
  */
 
 #include <algorithm>
-#include <forward_list>
+#include <array>
+#include <vector>
 
 #include "third_party/disruptorplus/include/disruptorplus/blocking_wait_strategy.hpp"
 #include "third_party/disruptorplus/include/disruptorplus/multi_threaded_claim_strategy.hpp"
@@ -17,9 +18,16 @@
 #include "third_party/disruptorplus/include/disruptorplus/spin_wait.hpp"
 #include "third_party/disruptorplus/include/disruptorplus/spin_wait_strategy.hpp"
 #include "xenia/base/assert.h"
+#include "xenia/base/cvar.h"
 #include "xenia/base/threading.h"
 #include "xenia/base/threading_timer_queue.h"
 
+DEFINE_uint32(timer_slack_us, 500,
+              "How long timer expirations and thread sleeps may be delayed, "
+              "in microseconds, so that ones close to each other are handled "
+              "in a single host wakeup. 0 for the most precise timing.",
+              "Kernel");
+
 namespace dp = disruptorplus;
 
 namespace xe {
@@ -51,6 +59,7 @@ class TimerQueue {
         wait_strategy_(),
         claim_strategy_(kWaitCount, wait_strategy_),
         consumed_(wait_strategy_),
+        origin_(clock::now()),
         shutdown_(false) {
     claim_strategy_.add_claim_barrier(consumed_);
     dispatch_thread_ = std::thread(&TimerQueue::TimerThreadMain, this);
@@ -71,43 +80,41 @@ class TimerQueue {
 
   void TimerThreadMain() {
     dp::sequence_t next_sequence = 0;
-    const auto comp = [](const std::shared_ptr<WaitItem>& left,
-                         const std::shared_ptr<WaitItem>& right) {
-      return left->due_ < right->due_;
-    };
+    std::vector<std::shared_ptr<WaitItem>> due_items;
 
     xe::threading::set_name("xe::threading::TimerQueue");
 
     while (!shutdown_.load(std::memory_order_relaxed)) {
       {
-        // Consume new wait items and add them to sorted wait queue
+        // Wake up for the earliest timer only after the slack, to also run
+        // the timers that become due in the meantime in the same wakeup.
+        clock::time_point wake_time = GetEarliestDue();
+        if (wake_time != clock::time_point::max()) {
+          wake_time += std::chrono::microseconds(cvars::timer_slack_us);
+        }
+        // Consume new wait items and add them to the wheel
         dp::sequence_t available = claim_strategy_.wait_until_published(
-            next_sequence, next_sequence - 1,
-            wait_queue_.empty() ? clock::time_point::max()
-                                : wait_queue_.front()->due_);
+            next_sequence, next_sequence - 1, wake_time);
 
         // Check for timeout
         if (available != next_sequence - 1) {
-          std::forward_list<std::shared_ptr<WaitItem>> wait_items;
           do {
-            wait_items.push_front(std::move(buffer_[next_sequence]));
+            Insert(std::move(buffer_[next_sequence]));
           } while (next_sequence++ != available);
 
           consumed_.publish(available);
-
-          wait_items.sort(comp);
-          wait_queue_.merge(wait_items, comp);
         }
       }
 
       {
-        // Check wait queue, invoke callbacks and reschedule
-        std::forward_list<std::shared_ptr<WaitItem>> wait_items;
-        while (!wait_queue_.empty() &&
-               wait_queue_.front()->due_ <= clock::now()) {
-          auto wait_item = std::move(wait_queue_.front());
-          wait_queue_.pop_front();
-
+        // Invoke callbacks of the due timers in order and reschedule
+        CollectDue(clock::now(), due_items);
+        std::stable_sort(due_items.begin(), due_items.end(),
+                         [](const std::shared_ptr<WaitItem>& left,
+                            const std::shared_ptr<WaitItem>& right) {
+                           return left->due_ < right->due_;
+                         });
+        for (auto& wait_item : due_items) {
           // Ensure that it isn't disarmed
           auto state = WaitItem::State::kIdle;
           if (wait_item->state_.compare_exchange_strong(
@@ -124,7 +131,7 @@ class TimerQueue {
               wait_item->due_ += wait_item->interval_;
               wait_item->state_.store(WaitItem::State::kIdle,
                                       std::memory_order_release);
-              wait_items.push_front(std::move(wait_item));
+              Insert(std::move(wait_item));
             } else {
               wait_item->state_.store(WaitItem::State::kDisarmed,
                                       std::memory_order_release);
@@ -134,8 +141,7 @@ class TimerQueue {
             assert_true(WaitItem::State::kDisarmed == state);
           }
         }
-        wait_items.sort(comp);
-        wait_queue_.merge(wait_items, comp);
+        due_items.clear();
       }
     }
   }
@@ -157,6 +163,156 @@ class TimerQueue {
   const std::thread& dispatch_thread() const { return dispatch_thread_; }
 
  private:
+  // Hierarchical timer wheel, only accessed by the dispatch thread. The first
+  // level has a slot for each of the next 256 ticks; each higher level has 64
+  // slots covering 64 times the span of the whole level below. When the
+  // current tick enters the span of a higher level slot, its timers are
+  // redistributed to the levels below, so inserting and expiring a timer
+  // doesn't depend on how many others there are.
+  static constexpr clock::duration kTick = std::chrono::microseconds(100);
+  static constexpr uint32_t kLevel0Bits = 8;
+  static constexpr uint32_t kLevelBits = 6;
+  static constexpr uint32_t kUpperLevelCount = 4;
+  using Slot = std::vector<std::shared_ptr<WaitItem>>;
+
+  // Rounded up, so that timers never run early.
+  uint64_t GetDueTick(clock::time_point due) const {
+    if (due <= origin_) {
+      return 0;
+    }
+    return uint64_t((due - origin_ + kTick - clock::duration(1)) / kTick);
+  }
+
+  static uint32_t GetUpperLevelShift(uint32_t level) {
+    return kLevel0Bits + kLevelBits * level;
+  }
+
+  void Insert(std::shared_ptr<WaitItem> wait_item) {
+    if (!timer_count_) {
+      // Nothing to expire in between, skip over the time the wheel was empty.
+      clock::time_point now = clock::now();
+      if (now > origin_) {
+        current_tick_ =
+            std::max(current_tick_, uint64_t((now - origin_) / kTick));
+      }
+    }
+    ++timer_count_;
+    Place(std::move(wait_item));
+  }
+
+  void Place(std::shared_ptr<WaitItem> wait_item) {
+    uint64_t due_tick = std::max(GetDueTick(wait_item->due_), current_tick_);
+    uint64_t delta = due_tick - current_tick_;
+    if (delta < (uint64_t(1) << kLevel0Bits)) {
+      level0_[due_tick & ((1 << kLevel0Bits) - 1)].push_back(
+          std::move(wait_item));
+      ++level0_count_;
+      return;
+    }
+    for (uint32_t level = 0; level < kUpperLevelCount; ++level) {
+      uint32_t shift = GetUpperLevelShift(level);
+      uint64_t level_span = uint64_t(1) << (shift + kLevelBits);
+      if (delta >= level_span) {
+        if (level + 1 < kUpperLevelCount) {
+          continue;
+        }
+        // Further than the wheel reaches, gets redistributed again later.
+        due_tick = current_tick_ + level_span - 1;
+      }
+      upper_levels_[level][(due_tick >> shift) & ((1 << kLevelBits) - 1)]
+          .push_back(std::move(wait_item));
+      return;
+    }
+  }
+
+  // Moves the timers due by now to due_items_out.
+  void CollectDue(clock::time_point now, Slot& due_items_out) {
+    if (now < origin_) {
+      return;
+    }
+    uint64_t now_tick = uint64_t((now - origin_) / kTick);
+    Slot cascaded;
+    while (timer_count_ && current_tick_ <= now_tick) {
+      uint32_t index = uint32_t(current_tick_) & ((1 << kLevel0Bits) - 1);
+      if (!index) {
+        for (uint32_t level = 0; level < kUpperLevelCount; ++level) {
+          uint32_t level_index =
+              uint32_t(current_tick_ >> GetUpperLevelShift(level)) &
+              ((1 << kLevelBits) - 1);
+          cascaded.swap(upper_levels_[level][level_index]);
+          for (auto& wait_item : cascaded) {
+            Place(std::move(wait_item));
+          }
+          cascaded.clear();
+          if (level_index) {
+            break;
+          }
+        }
+      }
+      if (!level0_count_) {
+        // Nothing until the next span of the first level.
+        current_tick_ =
+            std::min((current_tick_ | ((1 << kLevel0Bits) - 1)) + 1,
+                     now_tick + 1);
+        continue;
+      }
+      Slot& slot = level0_[index];
+      timer_count_ -= slot.size();
+      level0_count_ -= slot.size();
+      for (auto& wait_item : slot) {
+        due_items_out.push_back(std::move(wait_item));
+      }
+      slot.clear();
+      ++current_tick_;
+    }
+  }
+
+  static void GetSlotEarliestDue(const Slot& slot,
+                                 clock::time_point& earliest) {
+    for (const auto& wait_item : slot) {
+      earliest = std::min(earliest, wait_item->due_);
+    }
+  }
+
+  clock::time_point GetEarliestDue() const {
+    clock::time_point earliest = clock::time_point::max();
+    if (!timer_count_) {
+      return earliest;
+    }
+    // Within the first level the slots are in due order starting from the
+    // current tick.
+    for (uint32_t i = 0; i < (1 << kLevel0Bits); ++i) {
+      const Slot& slot =
+          level0_[(current_tick_ + i) & ((1 << kLevel0Bits) - 1)];
+      if (!slot.empty()) {
+        GetSlotEarliestDue(slot, earliest);
+        break;
+      }
+    }
+    // In the higher levels, the slot of the current span has usually been
+    // redistributed already, so anything in it is a whole wheel turn ahead,
+    // and the slots after it come first. Only at the start of the span it may
+    // still hold timers of the current span too.
+    for (uint32_t level = 0; level < kUpperLevelCount; ++level) {
+      uint32_t shift = GetUpperLevelShift(level);
+      uint32_t current_index = uint32_t(current_tick_ >> shift);
+      if (!(current_tick_ & ((uint64_t(1) << shift) - 1))) {
+        GetSlotEarliestDue(
+            upper_levels_[level][current_index & ((1 << kLevelBits) - 1)],
+            earliest);
+      }
+      for (uint32_t i = 1; i <= (1 << kLevelBits); ++i) {
+        const Slot& slot = upper_levels_[level][(current_index + i) &
+                                                ((1 << kLevelBits) - 1)];
+        if (!slot.empty()) {
+          GetSlotEarliestDue(slot, earliest);
+          break;
+        }
+      }
+    }
+    return earliest;
+  }
+
   // This ring buffer will be used to introduce timers queued by the public API
   static constexpr size_t kWaitCount = 512;
   dp::ring_buffer<std::shared_ptr<WaitItem>> buffer_;
@@ -165,9 +321,13 @@ class TimerQueue {
   dp::multi_threaded_claim_strategy<WaitStrat> claim_strategy_;
   dp::sequence_barrier<WaitStrat> consumed_;
 
-  // This is a _sorted_ (ascending due_) list of active timers managed by a
-  // dedicated thread
-  std::forward_list<std::shared_ptr<WaitItem>> wait_queue_;
+  clock::time_point origin_;
+  uint64_t current_tick_ = 0;
+  size_t timer_count_ = 0;
+  size_t level0_count_ = 0;
+  std::array<Slot, 1 << kLevel0Bits> level0_;
+  std::array<std::array<Slot, 1 << kLevelBits>, kUpperLevelCount>
+      upper_levels_;
   std::atomic_bool shutdown_;
   std::thread dispatch_thread_;
 };
@@ -11,6 +11,7 @@
 #include "xenia/base/assert.h"
 #include "xenia/base/chrono_steady_cast.h"
 #include "xenia/base/logging.h"
+#include "xenia/base/math.h"
 #include "xenia/base/platform_win.h"
 #include "xenia/base/threading.h"
 #include "xenia/base/threading_timer_queue.h"
@@ -74,6 +75,111 @@ void EnableAffinityConfiguration() {
   SetProcessAffinityMask(process_handle, system_affinity_mask);
 }
 
+std::vector<uint64_t> QueryPhysicalCoreMasks() {
+  std::vector<uint64_t> cores;
+  DWORD length = 0;
+  GetLogicalProcessorInformationEx(RelationProcessorCore, nullptr, &length);
+  if (GetLastError() != ERROR_INSUFFICIENT_BUFFER) {
+    return cores;
+  }
+  std::vector<uint8_t> buffer(length);
+  if (!GetLogicalProcessorInformationEx(
+          RelationProcessorCore,
+          reinterpret_cast<PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX>(
+              buffer.data()),
+          &length)) {
+    return cores;
+  }
+  for (DWORD offset = 0; offset < length;) {
+    auto info = reinterpret_cast<PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX>(
+        buffer.data() + offset);
+    // Only processor group 0 is addressable by affinity masks here.
+    for (WORD i = 0; i < info->Processor.GroupCount; ++i) {
+      const GROUP_AFFINITY& group_mask = info->Processor.GroupMask[i];
+      if (group_mask.Group == 0 && group_mask.Mask) {
+        cores.push_back(uint64_t(group_mask.Mask));
+      }
+    }
+    offset += info->Size;
+  }
+  std::sort(cores.begin(), cores.end(), [](uint64_t a, uint64_t b) {
+    return xe::tzcnt(a) < xe::tzcnt(b);
+  });
+  return cores;
+}
+
+// Returns the processor information entries of the relationship type.
+static std::vector<uint8_t> QueryLogicalProcessorInformation(
+    LOGICAL_PROCESSOR_RELATIONSHIP relationship) {
+  DWORD length = 0;
+  GetLogicalProcessorInformationEx(relationship, nullptr, &length);
+  if (GetLastError() != ERROR_INSUFFICIENT_BUFFER) {
+    return {};
+  }
+  std::vector<uint8_t> buffer(length);
+  if (!GetLogicalProcessorInformationEx(
+          relationship,
+          reinterpret_cast<PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX>(
+              buffer.data()),
+          &length)) {
+    return {};
+  }
+  buffer.resize(length);
+  return buffer;
+}
+
+std::vector<uint64_t> QueryLastLevelCacheMasks() {
+  std::vector<uint64_t> caches;
+  std::vector<uint8_t> buffer = QueryLogicalProcessorInformation(RelationCache);
+  BYTE last_level = 0;
+  for (size_t offset = 0; offset < buffer.size();) {
+    auto info = reinterpret_cast<PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX>(
+        buffer.data() + offset);
+    const CACHE_RELATIONSHIP& cache = info->Cache;
+    // Only processor group 0 is addressable by affinity masks here.
+    if ((cache.Type == CacheUnified || cache.Type == CacheData) &&
+        cache.GroupMask.Group == 0 && cache.GroupMask.Mask) {
+      if (cache.Level > last_level) {
+        last_level = cache.Level;
+        caches.clear();
+      }
+      if (cache.Level == last_level) {
+        caches.push_back(uint64_t(cache.GroupMask.Mask));
+      }
+    }
+    offset += info->Size;
+  }
+  std::sort(caches.begin(), caches.end(), [](uint64_t a, uint64_t b) {
+    return xe::tzcnt(a) < xe::tzcnt(b);
+  });
+  return caches;
+}
+
+std::vector<uint64_t> QueryNumaNodeMasks() {
+  std::vector<uint64_t> nodes;
+  std::vector<uint8_t> buffer =
+      QueryLogicalProcessorInformation(RelationNumaNode);
+  for (size_t offset = 0; offset < buffer.size();) {
+    auto info = reinterpret_cast<PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX>(
+        buffer.data() + offset);
+    const NUMA_NODE_RELATIONSHIP& node = info->NumaNode;
+    if (node.NodeNumber < 64) {
+      if (nodes.size() <= node.NodeNumber) {
+        nodes.resize(node.NodeNumber + 1);
+      }
+      if (node.GroupMask.Group == 0) {
+        nodes[node.NodeNumber] |= uint64_t(node.GroupMask.Mask);
+      }
+    }
+    offset += info->Size;
+  }
+  return nodes;
+}
+
+uint32_t current_logical_processor() {
+  return uint32_t(GetCurrentProcessorNumber());
+}
+
 uint32_t current_thread_system_id() {
   return static_cast<uint32_t>(GetCurrentThreadId());
 }
@@ -169,6 +275,11 @@ void Sleep(std::chrono::microseconds duration) {
   }
 }
 
+void set_current_thread_timer_slack(std::chrono::microseconds /*slack*/) {
+  // No-op - Windows has no per-thread timer slack, it coalesces the timed
+  // waits and sleeps of all threads by the global timer resolution instead.
+}
+
 SleepResult AlertableSleep(std::chrono::microseconds duration) {
   if (SleepEx(static_cast<DWORD>(duration.count() / 1000), TRUE) ==
       WAIT_IO_COMPLETION) {
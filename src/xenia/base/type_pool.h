@@ -10,7 +10,10 @@
 #ifndef XENIA_BASE_TYPE_POOL_H_
 #define XENIA_BASE_TYPE_POOL_H_
 
+#include <algorithm>
+#include <cstddef>
 #include <mutex>
+#include <new>
 #include <vector>
 
 namespace xe {
@@ -54,6 +57,130 @@ class TypePool {
   std::vector<T*> list_;
 };
 
+// Pool of fixed-size memory blocks for objects that are frequently created and
+// destroyed, possibly on different threads. Each thread keeps a small cache of
+// free blocks, so allocation and freeing usually don't take the lock, and
+// blocks are exchanged with the shared list in batches when the cache runs
+// empty or overflows. Blocks are never returned to the system.
+template <size_t BlockSize>
+class ThreadCachedBlockPool {
+  static_assert(BlockSize >= sizeof(void*) &&
+                BlockSize % alignof(std::max_align_t) == 0);
+
+ public:
+  static constexpr size_t kBlockSize = BlockSize;
+
+  static void* Allocate() {
+    ThreadCache& cache = thread_cache_;
+    if (!cache.count && !cache.is_destroyed) {
+      std::lock_guard<std::mutex> guard(shared().lock);
+      std::vector<void*>& blocks = shared().blocks;
+      size_t transfer_count = std::min(kTransferCount, blocks.size());
+      for (size_t i = 0; i < transfer_count; ++i) {
+        cache.blocks[cache.count++] = blocks.back();
+        blocks.pop_back();
+      }
+    }
+    if (cache.count) {
+      return cache.blocks[--cache.count];
+    }
+    return ::operator new(kBlockSize);
+  }
+
+  static void Free(void* block) {
+    ThreadCache& cache = thread_cache_;
+    if (cache.is_destroyed) {
+      // Freeing from a destructor of another thread-local object.
+      std::lock_guard<std::mutex> guard(shared().lock);
+      shared().blocks.push_back(block);
+      return;
+    }
+    if (cache.count >= kThreadCacheCapacity) {
+      cache.ReleaseToShared(kTransferCount);
+    }
+    cache.blocks[cache.count++] = block;
+  }
+
+ private:
+  // Exchanging half of the cache, so alternating allocation and freeing at the
+  // boundary doesn't take the lock every time.
+  static constexpr size_t kThreadCacheCapacity = 32;
+  static constexpr size_t kTransferCount = kThreadCacheCapacity / 2;
+
+  struct Shared {
+    std::mutex lock;
+    std::vector<void*> blocks;
+  };
+  static Shared& shared() {
+    // Never destroyed, as threads may still be freeing blocks while static
+    // objects are destroyed on exit.
+    static Shared* shared_ = new Shared;
+    return *shared_;
+  }
+
+  struct ThreadCache {
+    void* blocks[kThreadCacheCapacity];
+    size_t count = 0;
+    bool is_destroyed = false;
+
+    ~ThreadCache() {
+      ReleaseToShared(count);
+      is_destroyed = true;
+    }
+
+    void ReleaseToShared(size_t release_count) {
+      std::lock_guard<std::mutex> guard(shared().lock);
+      for (size_t i = 0; i < release_count; ++i) {
+        shared().blocks.push_back(blocks[--count]);
+      }
+    }
+  };
+  static inline thread_local ThreadCache thread_cache_;
+};
+
+// Allocation from ThreadCachedBlockPools of a few size classes, for objects of
+// polymorphic classes deriving from this, so the size of the actual type is
+// known when deleting them via a pointer to the base. Larger and over-aligned
+// objects are allocated from the global heap.
+class ThreadCachedPoolAllocated {
+ public:
+  static void* operator new(size_t size) {
+    if (size <= 128) {
+      return ThreadCachedBlockPool<128>::Allocate();
+    }
+    if (size <= 256) {
+      return ThreadCachedBlockPool<256>::Allocate();
+    }
+    if (size <= 512) {
+      return ThreadCachedBlockPool<512>::Allocate();
+    }
+    if (size <= 1024) {
+      return ThreadCachedBlockPool<1024>::Allocate();
+    }
+    return ::operator new(size);
+  }
+  static void operator delete(void* ptr, size_t size) {
+    if (size <= 128) {
+      ThreadCachedBlockPool<128>::Free(ptr);
+    } else if (size <= 256) {
+      ThreadCachedBlockPool<256>::Free(ptr);
+    } else if (size <= 512) {
+      ThreadCachedBlockPool<512>::Free(ptr);
+    } else if (size <= 1024) {
+      ThreadCachedBlockPool<1024>::Free(ptr);
+    } else {
+      ::operator delete(ptr);
+    }
+  }
+  static void* operator new(size_t size, std::align_val_t alignment) {
+    return ::operator new(size, alignment);
+  }
+  static void operator delete(void* ptr, size_t size,
+                              std::align_val_t alignment) {
+    ::operator delete(ptr, alignment);
+  }
+};
+
 }  // namespace xe
 
 #endif  // XENIA_BASE_TYPE_POOL_H_
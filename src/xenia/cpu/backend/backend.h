@@ -99,6 +99,10 @@ class Backend {
     return false;
   }
 
+  // Called by the command processor on every guest frame swap, lets the
+  // backend publish per-frame counters to the profiler.
+  virtual void OnGuestFrameSwap() {}
+
   virtual uint32_t CreateGuestTrampoline(GuestTrampolineProc proc,
                                          void* userdata1, void* userdata2,
                                          bool long_term = false) {
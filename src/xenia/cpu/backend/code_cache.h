@@ -12,7 +12,9 @@
 
 #include <cstddef>
 #include <cstdint>
+#include <functional>
 #include <string>
+#include <vector>
 
 #include "xenia/cpu/function.h"
 
@@ -35,6 +37,33 @@ class CodeCache {
 
   // Finds platform-specific function unwind info for the given host PC.
   virtual void* LookupUnwindInfo(uint64_t host_pc) = 0;
+
+  // Reclamation of dead code (jit_code_reclamation). Code is retired when it
+  // can't be entered anymore, and reclaimed for placing new code once no
+  // thread is executing it.
+
+  // Retires the code of the functions, which are about to be destroyed, and
+  // makes the calls to their addresses resolve the functions again.
+  virtual void RetireFunctionCode(
+      const std::vector<GuestFunction*>& functions) {}
+  // Makes the calls to the functions, whose guest code has been modified,
+  // resolve them again, so they're translated again on the next call. The
+  // current code is retired once it has been replaced.
+  virtual void InvalidateFunctionCode(
+      const std::vector<GuestFunction*>& functions) {}
+  // Size of the code retired, but not reclaimed yet.
+  virtual size_t retired_code_size() const { return 0; }
+  // Suspends the threads that may be executing generated code and appends the
+  // host PCs of all their frames. Returns false if a stack couldn't be walked
+  // completely.
+  using SuspendAndCaptureCallback =
+      std::function<bool(std::vector<uint64_t>& host_pcs)>;
+  // Reclaims the retired code not containing any of the host PCs captured by
+  // the callback. The callback is invoked with the lookups locked, so no
+  // thread is suspended in the middle of one, and the caller resumes the
+  // threads after this returns.
+  virtual void ReclaimRetiredCode(
+      const SuspendAndCaptureCallback& suspend_and_capture) {}
 };
 
 }  // namespace backend
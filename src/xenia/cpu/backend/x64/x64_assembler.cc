@@ -25,6 +25,8 @@
 #include "xenia/cpu/hir/label.h"
 #include "xenia/cpu/processor.h"
 
+DECLARE_bool(debug);
+
 namespace xe {
 namespace cpu {
 namespace backend {
@@ -91,16 +93,32 @@ bool X64Assembler::Assemble(GuestFunction* function, HIRBuilder* builder,
     string_buffer_.Reset();
   }
 
+  auto x64_function = static_cast<X64Function*>(function);
+  uint8_t* previous_machine_code =
+      x64_function->has_patchable_entry() ? x64_function->machine_code()
+                                          : nullptr;
+
   function->set_debug_info(std::move(debug_info));
-  static_cast<X64Function*>(function)->Setup(
-      reinterpret_cast<uint8_t*>(machine_code), code_size);
+  x64_function->Setup(reinterpret_cast<uint8_t*>(machine_code), code_size);
+  x64_function->set_patchable_entry(function->is_baseline() ||
+                                    cvars::invalidate_modified_code ||
+                                    cvars::debug);
+  x64_function->set_stack_size(emitter_->stack_size());
 
   // Install into indirection table.
   uint64_t host_address = reinterpret_cast<uint64_t>(machine_code);
   assert_true((host_address >> 32) == 0);
-  reinterpret_cast<X64CodeCache*>(backend_->code_cache())
-      ->AddIndirection(function->address(),
-                       static_cast<uint32_t>(host_address));
+  auto code_cache = reinterpret_cast<X64CodeCache*>(backend_->code_cache());
+  code_cache->AddIndirection(function->address(),
+                             static_cast<uint32_t>(host_address));
+
+  // Callers that were emitted with a direct call to the baseline code go
+  // through its entry, so redirect that too.
+  if (previous_machine_code) {
+    code_cache->RedirectCode(previous_machine_code, machine_code);
+    // The rest of the baseline code can be reused once no thread executes it.
+    code_cache->RetireCode(previous_machine_code);
+  }
 
   return true;
 }
@@ -16,6 +16,8 @@
 
 #include "xenia/base/exception_handler.h"
 #include "xenia/base/logging.h"
+#include "xenia/base/memory.h"
+#include "xenia/base/profiling.h"
 #include "xenia/cpu/backend/x64/x64_assembler.h"
 #include "xenia/cpu/backend/x64/x64_code_cache.h"
 #include "xenia/cpu/backend/x64/x64_emitter.h"
@@ -41,6 +43,18 @@ DEFINE_bool(enable_host_guest_stack_synchronization, true,
             "and checks for reentry at return sites. Has slight performance "
             "impact, but fixes crashes in games that use setjmp/longjmp.",
             "x64");
+DEFINE_bool(lazy_host_guest_stack_synchronization, false,
+            "With enable_host_guest_stack_synchronization, only records the "
+            "guest stack pointer in each host frame instead of maintaining "
+            "stackpoints on every call, and searches the host frames when a "
+            "longjmp reenters a function. Removes the bookkeeping from calls, "
+            "but loses the guest pseudo stack trace used in GPU error "
+            "reports.",
+            "x64");
+DEFINE_bool(x64_count_mxcsr_switches, false,
+            "Count the switches between the FPU and VMX MXCSR modes done by "
+            "guest code, and show the number per frame in the profiler.",
+            "x64");
 #if XE_X64_PROFILER_AVAILABLE == 1
 DECLARE_bool(instrument_call_times);
 #endif
@@ -65,11 +79,13 @@ class X64HelperEmitter : public X64Emitter {
   GuestToHostThunk EmitGuestToHostThunk();
   ResolveFunctionThunk EmitResolveFunctionThunk();
   void* EmitGuestAndHostSynchronizeStackHelper();
+  void* EmitGuestAndHostLazySynchronizeStackHelper();
   // 1 for loading byte, 2 for halfword and 4 for word.
   // these specialized versions save space in the caller
   void* EmitGuestAndHostSynchronizeStackSizeLoadThunk(
       void* sync_func, unsigned stack_element_size);
 
+  void EmitReserveBitLocation(const Xbyak::Reg64& base);
   void* EmitTryAcquireReservationHelper();
   void* EmitReservedStoreHelper(bool bit64 = false);
 
@@ -109,6 +125,21 @@ static constexpr uint32_t guest_trampoline_template_offset_arg1 = 2,
                           guest_trampoline_template_offset_arg2 = 0xC,
                           guest_trampoline_template_offset_rcx = 0x16,
                           guest_trampoline_template_offset_rax = 0x20;
+ReserveHelper::ReserveHelper() {
+  blocks = reinterpret_cast<uint64_t*>(xe::memory::AllocFixed(
+      nullptr, RESERVE_NUM_ENTRIES / 8,
+      xe::memory::AllocationType::kReserveCommit,
+      xe::memory::PageAccess::kReadWrite));
+  assert_not_null(blocks);
+}
+
+ReserveHelper::~ReserveHelper() {
+  if (blocks) {
+    xe::memory::DeallocFixed(blocks, RESERVE_NUM_ENTRIES / 8,
+                             xe::memory::DeallocationType::kRelease);
+  }
+}
+
 X64Backend::X64Backend() : Backend(), code_cache_(nullptr) {
   if (cs_open(CS_ARCH_X86, CS_MODE_64, &capstone_handle_) != CS_ERR_OK) {
     assert_always("Failed to initialize capstone");
@@ -151,6 +182,26 @@ X64Backend::~X64Backend() {
   }
 }
 
+uint32_t X64Backend::FindOrPlaceConstant(const vec128_t& value) {
+  std::lock_guard<std::mutex> lock(constant_pool_mutex_);
+  auto it = constant_pool_addresses_.find({value.low, value.high});
+  if (it != constant_pool_addresses_.end()) {
+    return it->second;
+  }
+  if (constant_pool_used_ + sizeof(vec128_t) > X64Emitter::kConstantPoolSize) {
+    return 0;
+  }
+  auto entry = reinterpret_cast<vec128_t*>(
+      emitter_data_ + X64Emitter::GetConstantPoolOffset() +
+      constant_pool_used_);
+  *entry = value;
+  constant_pool_used_ += sizeof(vec128_t);
+  auto address = uint32_t(reinterpret_cast<uintptr_t>(entry));
+  constant_pool_addresses_.emplace(std::make_pair(value.low, value.high),
+                                   address);
+  return address;
+}
+
 static void ForwardMMIOAccessForRecording(void* context, void* hostaddr) {
   reinterpret_cast<X64Backend*>(context)
       ->RecordMMIOExceptionForGuestInstruction(hostaddr);
@@ -159,6 +210,10 @@ static void ForwardMMIOAccessForRecording(void* context, void* hostaddr) {
 // todo: better way of passing to atexit. maybe do in destructor instead?
 // nope, destructor is never called
 static GuestProfilerData* backend_profiler_data = nullptr;
+static Processor* backend_profiler_processor = nullptr;
+// Number of functions taking the most time that are recorded as hot for
+// profile_guided_code_layout.
+static constexpr size_t kProfilerHotFunctionCount = 1024;
 
 static uint64_t nanosecond_lifetime_start = 0;
 static void WriteGuestProfilerData() {
@@ -204,6 +259,13 @@ static void WriteGuestProfilerData() {
 
     fclose(output_file);
     fclose(idapy_file);
+
+    size_t hot_count =
+        std::min(unsorted_profile.size(), kProfilerHotFunctionCount);
+    for (size_t i = unsorted_profile.size() - hot_count;
+         i < unsorted_profile.size(); ++i) {
+      backend_profiler_processor->MarkFunctionHot(unsorted_profile[i].first);
+    }
   }
 }
 
@@ -270,7 +332,9 @@ bool X64Backend::Initialize(Processor* processor) {
 
   if (cvars::enable_host_guest_stack_synchronization) {
     synchronize_guest_and_host_stack_helper_ =
-        thunk_emitter.EmitGuestAndHostSynchronizeStackHelper();
+        UsesStackpoints()
+            ? thunk_emitter.EmitGuestAndHostSynchronizeStackHelper()
+            : thunk_emitter.EmitGuestAndHostLazySynchronizeStackHelper();
 
     synchronize_guest_and_host_stack_helper_size8_ =
         thunk_emitter.EmitGuestAndHostSynchronizeStackSizeLoadThunk(
@@ -309,6 +373,7 @@ bool X64Backend::Initialize(Processor* processor) {
 #if XE_X64_PROFILER_AVAILABLE == 1
   if (cvars::instrument_call_times) {
     backend_profiler_data = &profiler_data_;
+    backend_profiler_processor = processor;
     xe::threading::Thread::CreationParameters slimparams;
 
     slimparams.create_suspended = false;
@@ -522,6 +587,12 @@ uint64_t X64Backend::CalculateNextHostInstruction(ThreadDebugInfo* thread_info,
 }
 
 void X64Backend::InstallBreakpoint(Breakpoint* breakpoint) {
+  if (breakpoint->has_condition()) {
+    // Evaluated in the code translated again with the condition, trapping only
+    // when it's true, instead of trapping on every execution.
+    processor()->InvalidateFunctionsWithAddress(breakpoint->guest_address());
+    return;
+  }
   breakpoint->ForEachHostAddress([breakpoint](uint64_t host_address) {
     auto ptr = reinterpret_cast<void*>(host_address);
     auto original_bytes = xe::load_and_swap<uint16_t>(ptr);
@@ -534,6 +605,10 @@ void X64Backend::InstallBreakpoint(Breakpoint* breakpoint) {
 void X64Backend::InstallBreakpoint(Breakpoint* breakpoint, Function* fn) {
   assert_true(breakpoint->address_type() == Breakpoint::AddressType::kGuest);
   assert_true(fn->is_guest());
+  if (breakpoint->has_condition()) {
+    // Already translated with the condition.
+    return;
+  }
   auto guest_function = reinterpret_cast<cpu::GuestFunction*>(fn);
   auto host_address =
       guest_function->MapGuestAddressToMachineCode(breakpoint->guest_address());
@@ -551,6 +626,12 @@ void X64Backend::InstallBreakpoint(Breakpoint* breakpoint, Function* fn) {
 }
 
 void X64Backend::UninstallBreakpoint(Breakpoint* breakpoint) {
+  if (breakpoint->has_condition()) {
+    // Remove the condition from the code. The code currently executed by the
+    // thread that has hit the breakpoint stays valid until it's reclaimed.
+    processor()->InvalidateFunctionsWithAddress(breakpoint->guest_address());
+    return;
+  }
   for (auto& pair : breakpoint->backend_data()) {
     auto ptr = reinterpret_cast<uint8_t*>(pair.first);
     auto instruction_bytes = xe::load_and_swap<uint16_t>(ptr);
@@ -580,7 +661,9 @@ void X64Backend::RecordMMIOExceptionForGuestInstruction(void* host_address) {
             xex_guest_module->GetInstructionAddressFlags(guestaddr);
 
         if (icf) {
-          icf->accessed_mmio = true;
+          InfoCacheFlags accessed_mmio = {};
+          accessed_mmio.accessed_mmio = 1;
+          icf->Set(accessed_mmio);
         }
       }
     }
@@ -735,7 +818,8 @@ GuestToHostThunk X64HelperEmitter::EmitGuestToHostThunk() {
 }
 
 // X64Emitter handles actually resolving functions.
-uint64_t ResolveFunction(void* raw_context, uint64_t target_address);
+uint64_t ResolveFunctionFromThunk(void* raw_context, uint64_t target_address,
+                                  uint64_t caller_host_rsp);
 
 ResolveFunctionThunk X64HelperEmitter::EmitResolveFunctionThunk() {
   // ebx = target PPC address
@@ -758,7 +842,8 @@ ResolveFunctionThunk X64HelperEmitter::EmitResolveFunctionThunk() {
 
   mov(rcx, rsi);  // context
   mov(rdx, rbx);
-  mov(rax, reinterpret_cast<uint64_t>(&ResolveFunction));
+  lea(r8, ptr[rsp + stack_size]);  // rsp of the caller, at its return address
+  mov(rax, reinterpret_cast<uint64_t>(&ResolveFunctionFromThunk));
   call(rax);
 
   EmitLoadVolatileRegs();
@@ -892,6 +977,52 @@ void* X64HelperEmitter::EmitGuestAndHostSynchronizeStackHelper() {
   return EmitCurrentForOffsets(code_offsets);
 }
 
+// Helper for X64Backend::FindHostFrameForReentry.
+static uint64_t FindHostFrameForReentryThunk(void* raw_context,
+                                             uint64_t host_rsp,
+                                             uint64_t host_pc) {
+  auto ctx = reinterpret_cast<ppc::PPCContext*>(raw_context);
+  auto backend = static_cast<X64Backend*>(ctx->processor->backend());
+  auto function = backend->code_cache()->LookupFunction(host_pc);
+  if (!function) {
+    return 0;
+  }
+  return backend->FindHostFrameForReentry(host_rsp, function,
+                                          static_cast<uint32_t>(ctx->r[1]));
+}
+
+// r8 = return address w/ adjustment, rsp + 0 = return address of the call that
+// brought us into the middle of the function
+void* X64HelperEmitter::EmitGuestAndHostLazySynchronizeStackHelper() {
+  _code_offsets code_offsets = {};
+  code_offsets.prolog = getSize();
+  // rsp is misaligned by 8 here, the push realigns it. The guest function
+  // doesn't keep anything in volatile registers across the call we're at the
+  // return site of, so only r8 needs to be kept.
+  push(r8);
+  sub(rsp, 32);
+  code_offsets.prolog_stack_alloc = getSize();
+  code_offsets.body = getSize();
+
+  mov(rcx, GetContextReg());
+  lea(rdx, ptr[rsp + 40]);
+  // r8 = host pc in the function to look for
+  mov(rax, reinterpret_cast<uint64_t>(&FindHostFrameForReentryThunk));
+  call(rax);
+
+  add(rsp, 32);
+  pop(r8);
+  Xbyak::Label not_found{};
+  test(rax, rax);
+  jz(not_found, T_NEAR);
+  mov(rsp, rax);
+  L(not_found);
+  code_offsets.epilog = getSize();
+  jmp(r8);
+  code_offsets.tail = getSize();
+  return EmitCurrentForOffsets(code_offsets);
+}
+
 void* X64HelperEmitter::EmitGuestAndHostSynchronizeStackSizeLoadThunk(
     void* sync_func, unsigned stack_element_size) {
   _code_offsets code_offsets = {};
@@ -1347,6 +1478,19 @@ void* X64HelperEmitter::EmitFrsqrteHelper() {
   return EmitCurrentForOffsets(code_offsets);
 }
 
+// ecx = guest address, base = reservation bitmap
+// out: rdx = bitmap line, ecx = bit index within the line (0-511)
+// With a memory operand the bit test instructions treat a register bit offset
+// as relative to the operand address, so no qword split is needed.
+void X64HelperEmitter::EmitReserveBitLocation(const Xbyak::Reg64& base) {
+  shr(ecx, RESERVE_BLOCK_SHIFT);
+  mov(edx, ecx);
+  and_(edx, (1 << RESERVE_LINE_SHIFT) - 1);
+  shl(edx, 6);  // 64 byte lines
+  lea(rdx, ptr[base + rdx]);
+  shr(ecx, RESERVE_LINE_SHIFT);
+}
+
 void* X64HelperEmitter::EmitTryAcquireReservationHelper() {
   _code_offsets code_offsets = {};
   code_offsets.prolog = getSize();
@@ -1355,15 +1499,11 @@ void* X64HelperEmitter::EmitTryAcquireReservationHelper() {
   Xbyak::Label acquire_new_reservation;
 
   btr(GetBackendFlagsPtr(), kX64BackendHasReserveBit);
-  mov(r8, GetBackendCtxPtr(offsetof(X64BackendContext, reserve_helper_)));
+  mov(r8, GetBackendCtxPtr(offsetof(X64BackendContext, reserve_blocks_)));
   jc(already_has_a_reservation);
 
-  shr(ecx, RESERVE_BLOCK_SHIFT);
+  EmitReserveBitLocation(r8);
   xor_(r9d, r9d);
-  mov(edx, ecx);
-  shr(edx, 6);  // divide by 64
-  lea(rdx, ptr[r8 + rdx * 8]);
-  and_(ecx, 64 - 1);
 
   lock();
   bts(qword[rdx], rcx);
@@ -1403,12 +1543,9 @@ void* X64HelperEmitter::EmitReservedStoreHelper(bool bit64) {
 
   jnc(done);
 
-  mov(rax, GetBackendCtxPtr(offsetof(X64BackendContext, reserve_helper_)));
+  mov(rax, GetBackendCtxPtr(offsetof(X64BackendContext, reserve_blocks_)));
 
-  shr(ecx, RESERVE_BLOCK_SHIFT);
-  mov(edx, ecx);
-  shr(edx, 6);  // divide by 64
-  lea(rdx, ptr[rax + rdx * 8]);
+  EmitReserveBitLocation(rax);
   // begin acquiring exclusive access to cacheline containing our bit
   prefetchw(ptr[rdx]);
 
@@ -1419,10 +1556,6 @@ void* X64HelperEmitter::EmitReservedStoreHelper(bool bit64) {
   mov(rax,
       GetBackendCtxPtr(offsetof(X64BackendContext, cached_reserve_value_)));
 
-  // we need modulo bitsize, it turns out bittests' modulus behavior for the
-  // bitoffset only applies for register operands, for memory ones we bug out
-  // todo: actually, the above note may not be true, double check it
-  and_(ecx, 64 - 1);
   cmp(GetBackendCtxPtr(offsetof(X64BackendContext, cached_reserve_bit)), ecx);
   jnz(reservation_isnt_for_our_addr);
 
@@ -1436,7 +1569,7 @@ void* X64HelperEmitter::EmitReservedStoreHelper(bool bit64) {
   }
   // the ZF flag is unaffected by BTR! we exploit this for the retval
 
-  // cancel our lock on the 65k block
+  // cancel our lock on the granule
   lock();
   btr(qword[rdx], rcx);
 
@@ -1450,10 +1583,17 @@ void* X64HelperEmitter::EmitReservedStoreHelper(bool bit64) {
   cmp(ax, 0x0101);
   ret();
 
-  // could be the same label, but otherwise we don't know where we came from
-  // when one gets triggered
+  // stwcx. to a different granule than the lwarx fails, but the reservation
+  // is still given up
   L(reservation_isnt_for_our_addr);
-  DebugBreak();
+  mov(rdx,
+      GetBackendCtxPtr(offsetof(X64BackendContext, cached_reserve_offset)));
+  mov(ecx, GetBackendCtxPtr(offsetof(X64BackendContext, cached_reserve_bit)));
+  lock();
+  btr(qword[rdx], rcx);
+  xor_(eax, eax);
+  cmp(ax, 0x0101);
+  ret();
 
   L(somehow_double_cleared);  // somehow, something else cleared our reserve??
   DebugBreak();
@@ -1574,7 +1714,7 @@ void X64Backend::InitializeBackendContext(void* ctx) {
 
   */
 
-  bctx->stackpoints = cvars::enable_host_guest_stack_synchronization
+  bctx->stackpoints = UsesStackpoints()
                           ? new X64BackendStackpoint[cvars::max_stackpoints]
                           : nullptr;
   bctx->current_stackpoint_depth = 0;
@@ -1583,11 +1723,26 @@ void X64Backend::InitializeBackendContext(void* ctx) {
   // https://media.discordapp.net/attachments/440280035056943104/1000765256643125308/unknown.png
   bctx->Ox1000 = 0x1000;
   bctx->guest_tick_count = Clock::GetGuestTickCountPointer();
-  bctx->reserve_helper_ = &reserve_helper_;
+  bctx->reserve_blocks_ = reserve_helper_.blocks;
+  bctx->mxcsr_switch_count = 0;
+  if (cvars::x64_count_mxcsr_switches) {
+    std::lock_guard<std::mutex> lock(mxcsr_stats_mutex_);
+    mxcsr_stats_contexts_.push_back(bctx);
+  }
 }
 void X64Backend::DeinitializeBackendContext(void* ctx) {
   X64BackendContext* bctx = BackendContextForGuestContext(ctx);
 
+  if (cvars::x64_count_mxcsr_switches) {
+    std::lock_guard<std::mutex> lock(mxcsr_stats_mutex_);
+    auto it = std::find(mxcsr_stats_contexts_.begin(),
+                        mxcsr_stats_contexts_.end(), bctx);
+    if (it != mxcsr_stats_contexts_.end()) {
+      mxcsr_switches_retired_ += bctx->mxcsr_switch_count;
+      mxcsr_stats_contexts_.erase(it);
+    }
+  }
+
   if (bctx->stackpoints) {
     delete[] bctx->stackpoints;
     bctx->stackpoints = nullptr;
@@ -1616,7 +1771,7 @@ void X64Backend::SetGuestRoundingMode(void* ctx, unsigned int mode) {
 }
 
 bool X64Backend::PopulatePseudoStacktrace(GuestPseudoStackTrace* st) {
-  if (!cvars::enable_host_guest_stack_synchronization) {
+  if (!UsesStackpoints()) {
     return false;
   }
 
@@ -1649,6 +1804,54 @@ bool X64Backend::PopulatePseudoStacktrace(GuestPseudoStackTrace* st) {
   return true;
 }
 
+void X64Backend::OnGuestFrameSwap() {
+  if (!cvars::x64_count_mxcsr_switches) {
+    return;
+  }
+  // The counters of other threads are read while they may be incremented,
+  // which is fine for statistics.
+  std::lock_guard<std::mutex> lock(mxcsr_stats_mutex_);
+  uint64_t total = mxcsr_switches_retired_;
+  for (auto bctx : mxcsr_stats_contexts_) {
+    total += *reinterpret_cast<volatile uint64_t*>(&bctx->mxcsr_switch_count);
+  }
+  COUNT_profile_set("cpu/x64/mxcsr_switches_per_frame",
+                    total - mxcsr_switches_last_frame_);
+  mxcsr_switches_last_frame_ = total;
+}
+
+uint64_t X64Backend::FindHostFrameForReentry(uint64_t host_rsp,
+                                             GuestFunction* function,
+                                             uint32_t guest_stack) {
+  // Functions don't use a frame pointer, but all frames of guest functions
+  // follow StackLayout, and their size is known from the function:
+  //   host_rsp + 0                    return address into the caller
+  //   host_rsp + 8                    caller rsp
+  //   caller rsp + caller stack_size  return address into its caller
+  // The walk ends at the first return address outside of guest code, which is
+  // the host to guest thunk (or a guest to host call that called back in).
+  // Deeper calls are entered with a guest stack pointer that's at most the one
+  // of the frame that called them, so looking for a frame above guest_stack
+  // finds the one that was longjmp'd to even when the function is recursive.
+  constexpr uint32_t kMaxFrames = 65536;
+  for (uint32_t i = 0; i < kMaxFrames; ++i) {
+    uint64_t return_address = *reinterpret_cast<uint64_t*>(host_rsp);
+    auto caller =
+        static_cast<X64Function*>(code_cache_->LookupFunction(return_address));
+    if (!caller) {
+      return 0;
+    }
+    uint64_t caller_rsp = host_rsp + 8;
+    uint32_t entry_guest_stack = *reinterpret_cast<uint32_t*>(
+        caller_rsp + StackLayout::GUEST_ENTRY_STACK_PTR);
+    if (caller == function && entry_guest_stack > guest_stack) {
+      return caller_rsp;
+    }
+    host_rsp = caller_rsp + caller->stack_size();
+  }
+  return 0;
+}
+
 #if XE_X64_PROFILER_AVAILABLE == 1
 uint64_t* X64Backend::GetProfilerRecordForFunction(uint32_t guest_address) {
   // who knows, we might want to compile different versions of a function one
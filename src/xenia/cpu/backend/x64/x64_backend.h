@@ -10,7 +10,11 @@
 #ifndef XENIA_CPU_BACKEND_X64_X64_BACKEND_H_
 #define XENIA_CPU_BACKEND_X64_X64_BACKEND_H_
 
+#include <map>
 #include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
 
 #include "xenia/base/bit_map.h"
 #include "xenia/base/cvar.h"
@@ -27,6 +31,8 @@
 DECLARE_int64(x64_extension_mask);
 DECLARE_int64(max_stackpoints);
 DECLARE_bool(enable_host_guest_stack_synchronization);
+DECLARE_bool(lazy_host_guest_stack_synchronization);
+DECLARE_bool(x64_count_mxcsr_switches);
 namespace xe {
 class Exception;
 }  // namespace xe
@@ -57,15 +63,26 @@ static constexpr uint32_t GUEST_TRAMPOLINE_MIN_LEN = 8;
 static constexpr uint32_t MAX_GUEST_TRAMPOLINES =
     (GUEST_TRAMPOLINE_END - GUEST_TRAMPOLINE_BASE) / GUEST_TRAMPOLINE_MIN_LEN;
 
-#define RESERVE_BLOCK_SHIFT 16
+// Reservations are tracked per 128 byte granule, the size of a Xenon cache
+// line, so unrelated atomics no longer share a reservation. Consecutive
+// granules are spread across host cache lines of the bitmap (the low granule
+// bits select the line, the high bits the bit within it) so that threads
+// spinning on neighbouring guest locks don't bounce the same bitmap line.
+#define RESERVE_BLOCK_SHIFT 7
+// Number of bitmap lines, log2. Each 64 byte line holds 512 granule bits.
+#define RESERVE_LINE_SHIFT 16
 
 #define RESERVE_NUM_ENTRIES \
   ((1024ULL * 1024ULL * 1024ULL * 4ULL) >> RESERVE_BLOCK_SHIFT)
+static_assert(RESERVE_NUM_ENTRIES == (512ULL << RESERVE_LINE_SHIFT),
+              "Reservation bitmap lines must cover the guest address space");
 // https://codalogic.com/blog/2022/12/06/Exploring-PowerPCs-read-modify-write-operations
 struct ReserveHelper {
-  uint64_t blocks[RESERVE_NUM_ENTRIES / 64];
+  // RESERVE_NUM_ENTRIES bits, allocated as zeroed pages on first touch.
+  uint64_t* blocks;
 
-  ReserveHelper() { memset(blocks, 0, sizeof(blocks)); }
+  ReserveHelper();
+  ~ReserveHelper();
 };
 
 struct X64BackendStackpoint {
@@ -94,7 +111,8 @@ struct X64BackendContext {
     uint64_t helper_scratch_u64s[8];
     uint32_t helper_scratch_u32s[16];
   };
-  ReserveHelper* reserve_helper_;
+  // ReserveHelper::blocks of the backend.
+  uint64_t* reserve_blocks_;
   uint64_t cached_reserve_value_;
   // guest_tick_count is used if inline_loadclock is used
   uint64_t* guest_tick_count;
@@ -111,6 +129,8 @@ struct X64BackendContext {
   unsigned int flags;
   unsigned int Ox1000;  // constant 0x1000 so we can shrink each tail emitted
                         // add of it by... 2 bytes lol
+  // number of vldmxcsr executed by this thread, if x64_count_mxcsr_switches
+  uint64_t mxcsr_switch_count;
 };
 constexpr unsigned int DEFAULT_VMX_MXCSR =
     0x8000 |                   // flush to zero
@@ -179,6 +199,20 @@ class X64Backend : public Backend {
   virtual void FreeGuestTrampoline(uint32_t trampoline_addr) override;
   virtual void SetGuestRoundingMode(void* ctx, unsigned int mode) override;
   virtual bool PopulatePseudoStacktrace(GuestPseudoStackTrace* st) override;
+  virtual void OnGuestFrameSwap() override;
+  // Whether a stackpoint is pushed and popped by every guest function, as
+  // opposed to the host frames being searched only when a longjmp reenters a
+  // function (lazy_host_guest_stack_synchronization).
+  static bool UsesStackpoints() {
+    return cvars::enable_host_guest_stack_synchronization &&
+           !cvars::lazy_host_guest_stack_synchronization;
+  }
+  // Walks the frames of guest functions up from host_rsp, which must point to
+  // a return address into generated code, and returns the host rsp of the
+  // innermost frame of function that was entered with a guest stack pointer
+  // above guest_stack. Returns 0 if there is none.
+  uint64_t FindHostFrameForReentry(uint64_t host_rsp, GuestFunction* function,
+                                   uint32_t guest_stack);
   void RecordMMIOExceptionForGuestInstruction(void* host_address);
 
   uint32_t LookupXMMConstantAddress32(unsigned index) {
@@ -187,6 +221,10 @@ class X64Backend : public Backend {
   void* LookupXMMConstantAddress(unsigned index) {
     return reinterpret_cast<void*>(emitter_data() + sizeof(vec128_t) * index);
   }
+  // Returns the 32-bit address of the 16 byte constant in the pool after the
+  // emitter constant data, placing it there the first time, so every value is
+  // stored once for all the generated code. 0 if the pool is full.
+  uint32_t FindOrPlaceConstant(const vec128_t& value);
 #if XE_X64_PROFILER_AVAILABLE == 1
   uint64_t* GetProfilerRecordForFunction(uint32_t guest_address);
 #endif
@@ -199,6 +237,12 @@ class X64Backend : public Backend {
   std::unique_ptr<X64CodeCache> code_cache_;
   uintptr_t emitter_data_ = 0;
 
+  // Append-only, entries are never changed once placed as the generated code
+  // may be reading them.
+  std::mutex constant_pool_mutex_;
+  std::map<std::pair<uint64_t, uint64_t>, uint32_t> constant_pool_addresses_;
+  size_t constant_pool_used_ = 0;
+
   HostToGuestThunk host_to_guest_thunk_;
   GuestToHostThunk guest_to_host_thunk_;
   ResolveFunctionThunk resolve_function_thunk_;
@@ -222,7 +266,15 @@ class X64Backend : public Backend {
   GuestProfilerData profiler_data_;
 #endif
 
-  alignas(64) ReserveHelper reserve_helper_;
+  ReserveHelper reserve_helper_;
+
+  // Contexts of the live threads, to sum up their mxcsr_switch_count.
+  std::mutex mxcsr_stats_mutex_;
+  std::vector<X64BackendContext*> mxcsr_stats_contexts_;
+  // Switches of the threads that have exited.
+  uint64_t mxcsr_switches_retired_ = 0;
+  uint64_t mxcsr_switches_last_frame_ = 0;
+
   // allocates 8-byte aligned addresses in a normally not executable guest
   // address
   // range that will be used to dispatch to host code
@@ -9,8 +9,11 @@
 
 #include "xenia/cpu/backend/x64/x64_code_cache.h"
 
+#include <algorithm>
+#include <climits>
 #include <cstdlib>
 #include <cstring>
+#include <unordered_set>
 
 #if ENABLE_VTUNE
 #include "third_party/vtune/include/jitprofiling.h"
@@ -19,14 +22,21 @@
 
 #include "third_party/fmt/include/fmt/format.h"
 #include "xenia/base/assert.h"
+#include "xenia/base/atomic.h"
 #include "xenia/base/clock.h"
+#include "xenia/base/cvar.h"
 #include "xenia/base/literals.h"
 #include "xenia/base/logging.h"
 #include "xenia/base/math.h"
 #include "xenia/base/memory.h"
+#include "xenia/base/metrics.h"
+#include "xenia/cpu/backend/x64/x64_function.h"
+#include "xenia/cpu/cpu_flags.h"
 #include "xenia/cpu/function.h"
 #include "xenia/cpu/module.h"
 
+DECLARE_int32(host_numa_node);
+
 namespace xe {
 namespace cpu {
 namespace backend {
@@ -34,6 +44,21 @@ namespace x64 {
 
 using namespace xe::literals;
 
+namespace {
+xe::metrics::Counter code_cache_placed_bytes_(
+    "CPU", "code_cache_placed_bytes",
+    "Bytes of generated code and unwind info placed in the code cache");
+xe::metrics::Counter code_cache_retired_bytes_(
+    "CPU", "code_cache_retired_bytes",
+    "Bytes of generated code retired after retranslation or unloading");
+xe::metrics::Counter code_cache_reclaimed_bytes_(
+    "CPU", "code_cache_reclaimed_bytes",
+    "Bytes of retired generated code reclaimed once no thread executed it");
+xe::metrics::Counter code_cache_reused_bytes_(
+    "CPU", "code_cache_reused_bytes",
+    "Bytes of generated code placed in reclaimed ranges");
+}  // namespace
+
 X64CodeCache::X64CodeCache() = default;
 
 X64CodeCache::~X64CodeCache() {
@@ -120,6 +145,18 @@ bool X64CodeCache::Initialize() {
     }
   }
 
+  // Keep the generated code and the indirection table close to the guest
+  // threads executing it.
+  if (cvars::host_numa_node >= 0) {
+    uint32_t node = uint32_t(cvars::host_numa_node);
+    if (indirection_table_base_) {
+      xe::memory::BindToNumaNode(indirection_table_base_,
+                                 kIndirectionTableSize, node);
+    }
+    xe::memory::BindToNumaNode(generated_code_write_base_, kGeneratedCodeSize,
+                               node);
+  }
+
   // Preallocate the function map to a large, reasonable size.
   generated_code_map_.reserve(kMaximumFunctionCount);
 
@@ -183,40 +220,49 @@ void X64CodeCache::PlaceGuestCode(uint32_t guest_address, void* machine_code,
   UnwindReservation unwind_reservation;
   {
     auto global_lock = global_critical_region_.Acquire();
+    std::lock_guard<std::recursive_mutex> map_lock(code_map_mutex_);
 
-    low_mark = generated_code_offset_;
+    // Reserve unwind info.
+    // We go on the high size of the unwind info as we don't know how big we
+    // need it, and a few extra bytes of padding isn't the worst thing. Its
+    // size doesn't depend on the address, so it's reserved before choosing
+    // where to place the code.
+    unwind_reservation = RequestUnwindReservation(nullptr);
 
     // Reserve code.
     // Always move the code to land on 16b alignment.
-    code_execute_address =
-        generated_code_execute_base_ + generated_code_offset_;
+    size_t code_size_aligned = xe::round_up(func_info.code_size.total, 16);
+    size_t block_size =
+        code_size_aligned + xe::round_up(unwind_reservation.data_size, 16);
+    low_mark = AllocateCodeRange(block_size);
+    high_mark = low_mark + block_size;
+    code_cache_placed_bytes_.Increment(block_size);
+
+    code_execute_address = generated_code_execute_base_ + low_mark;
     code_execute_address_out = code_execute_address;
-    uint8_t* code_write_address =
-        generated_code_write_base_ + generated_code_offset_;
+    uint8_t* code_write_address = generated_code_write_base_ + low_mark;
     code_write_address_out = code_write_address;
-    generated_code_offset_ += xe::round_up(func_info.code_size.total, 16);
 
-    auto tail_write_address =
-        generated_code_write_base_ + generated_code_offset_;
+    auto tail_write_address = code_write_address + code_size_aligned;
+    unwind_reservation.entry_address = tail_write_address;
 
-    // Reserve unwind info.
-    // We go on the high size of the unwind info as we don't know how big we
-    // need it, and a few extra bytes of padding isn't the worst thing.
-    unwind_reservation = RequestUnwindReservation(generated_code_write_base_ +
-                                                  generated_code_offset_);
-    generated_code_offset_ += xe::round_up(unwind_reservation.data_size, 16);
+    auto end_write_address = generated_code_write_base_ + high_mark;
 
-    auto end_write_address =
-        generated_code_write_base_ + generated_code_offset_;
-
-    high_mark = generated_code_offset_;
-
-    // Store in map. It is maintained in sorted order of host PC dependent on
-    // us also being append-only.
-    generated_code_map_.emplace_back(
-        (uint64_t(code_execute_address - generated_code_execute_base_) << 32) |
-            generated_code_offset_,
-        function_info);
+    // Store in map. It is maintained in sorted order of host PC, which only
+    // needs an insertion in the middle when reclaimed code is reused.
+    uint64_t map_key = (uint64_t(low_mark) << 32) | high_mark;
+    if (generated_code_map_.empty() ||
+        generated_code_map_.back().first < map_key) {
+      generated_code_map_.emplace_back(map_key, function_info);
+    } else {
+      generated_code_map_.emplace(
+          std::lower_bound(
+              generated_code_map_.begin(), generated_code_map_.end(),
+              map_key,
+              [](const std::pair<uint64_t, GuestFunction*>& entry,
+                 uint64_t key) { return entry.first < key; }),
+          map_key, function_info);
+    }
 
     // TODO(DrChat): The following code doesn't really need to be under the
     // global lock except for PlaceCode (but it depends on the previous code
@@ -335,7 +381,257 @@ uint32_t X64CodeCache::PlaceData(const void* data, size_t length) {
   return uint32_t(uintptr_t(data_address));
 }
 
+void X64CodeCache::RedirectCode(const void* old_execute_address,
+                                const void* new_execute_address) {
+  auto old_address = reinterpret_cast<uintptr_t>(old_execute_address);
+  auto new_address = reinterpret_cast<uintptr_t>(new_execute_address);
+  // Code is always placed at 16b alignment, so the 5 bytes being replaced can
+  // be written with a single aligned 8 byte store, and nothing can observe a
+  // half-written jump.
+  assert_zero(old_address & 7);
+  uint8_t* write_address =
+      generated_code_write_base_ +
+      (old_address - reinterpret_cast<uintptr_t>(generated_code_execute_base_));
+  int64_t displacement = int64_t(new_address) - int64_t(old_address + 5);
+  assert_true(displacement >= INT32_MIN && displacement <= INT32_MAX);
+  uint64_t entry;
+  std::memcpy(&entry, write_address, sizeof(entry));
+  entry = (entry & ~uint64_t(0xFFFFFFFFFF)) | 0xE9 |
+          (uint64_t(uint32_t(int32_t(displacement))) << 8);
+  xe::atomic_exchange(int64_t(entry),
+                      reinterpret_cast<volatile int64_t*>(write_address));
+}
+
+size_t X64CodeCache::AllocateCodeRange(size_t size) {
+  // Best fit, to keep the large ranges for large functions.
+  auto best_range = free_code_ranges_.end();
+  for (auto it = free_code_ranges_.begin(); it != free_code_ranges_.end();
+       ++it) {
+    if (it->second >= size && (best_range == free_code_ranges_.end() ||
+                               it->second < best_range->second)) {
+      best_range = it;
+    }
+  }
+  if (best_range == free_code_ranges_.end()) {
+    size_t offset = generated_code_offset_;
+    generated_code_offset_ += size;
+    return offset;
+  }
+  size_t offset = best_range->first;
+  size_t remaining_size = best_range->second - size;
+  free_code_ranges_.erase(best_range);
+  if (remaining_size) {
+    free_code_ranges_.emplace(offset + size, remaining_size);
+  }
+  free_code_size_ -= size;
+  code_cache_reused_bytes_.Increment(size);
+  return offset;
+}
+
+void X64CodeCache::RetireCode(const void* execute_address) {
+  if (!cvars::jit_code_reclamation) {
+    return;
+  }
+  auto global_lock = global_critical_region_.Acquire();
+  std::lock_guard<std::recursive_mutex> map_lock(code_map_mutex_);
+  uint64_t offset = uint64_t(reinterpret_cast<const uint8_t*>(execute_address) -
+                             generated_code_execute_base_);
+  auto it = std::lower_bound(
+      generated_code_map_.cbegin(), generated_code_map_.cend(), offset << 32,
+      [](const std::pair<uint64_t, GuestFunction*>& entry, uint64_t key) {
+        return entry.first < key;
+      });
+  if (it == generated_code_map_.cend() || (it->first >> 32) != offset) {
+    assert_always();
+    return;
+  }
+  RetireCodeRange(uint32_t(offset), uint32_t(it->first), 0);
+}
+
+void X64CodeCache::RetireFunctionCode(
+    const std::vector<GuestFunction*>& functions) {
+  if (!cvars::jit_code_reclamation || functions.empty()) {
+    return;
+  }
+  auto global_lock = global_critical_region_.Acquire();
+  std::lock_guard<std::recursive_mutex> map_lock(code_map_mutex_);
+  std::unordered_set<GuestFunction*> function_set(functions.cbegin(),
+                                                  functions.cend());
+  for (auto& entry : generated_code_map_) {
+    GuestFunction* function = entry.second;
+    if (!function || !function_set.count(function)) {
+      continue;
+    }
+    // Also clears the entries kept for the earlier retired code of the
+    // function, not to return a destroyed function from lookups.
+    entry.second = nullptr;
+    auto offset = uint32_t(entry.first >> 32);
+    if (generated_code_execute_base_ + offset == function->machine_code()) {
+      RetireCodeRange(offset, uint32_t(entry.first), function->address());
+    }
+  }
+  if (indirection_table_base_) {
+    for (GuestFunction* function : functions) {
+      if (function->machine_code()) {
+        AddIndirection(function->address(), indirection_default_value_);
+      }
+    }
+  }
+}
+
+void X64CodeCache::InvalidateFunctionCode(
+    const std::vector<GuestFunction*>& functions) {
+  auto global_lock = global_critical_region_.Acquire();
+  for (GuestFunction* function : functions) {
+    auto x64_function = static_cast<X64Function*>(function);
+    uint8_t* machine_code = x64_function->machine_code();
+    if (!machine_code) {
+      continue;
+    }
+    if (indirection_table_base_) {
+      AddIndirection(function->address(), indirection_default_value_);
+    }
+    if (!x64_function->has_patchable_entry()) {
+      continue;
+    }
+    // Direct calls and inline caches still enter the current code, redirect
+    // its entry to mov ebx, guest_address; jmp resolve_function_thunk. When
+    // the function is translated again, the entry is redirected to the new
+    // code, and the current code is retired.
+    uint8_t resolve_code[10];
+    uint32_t guest_address = function->address();
+    resolve_code[0] = 0xBB;
+    std::memcpy(resolve_code + 1, &guest_address, sizeof(uint32_t));
+    resolve_code[5] = 0xE9;
+    std::memset(resolve_code + 6, 0, sizeof(int32_t));
+    auto resolve_write_address = reinterpret_cast<uint8_t*>(
+        uintptr_t(PlaceData(resolve_code, sizeof(resolve_code))));
+    uint8_t* resolve_execute_address =
+        generated_code_execute_base_ +
+        (resolve_write_address - generated_code_write_base_);
+    int64_t displacement =
+        int64_t(indirection_default_value_) -
+        int64_t(reinterpret_cast<uintptr_t>(resolve_execute_address + 10));
+    assert_true(displacement >= INT32_MIN && displacement <= INT32_MAX);
+    auto displacement32 = int32_t(displacement);
+    std::memcpy(resolve_write_address + 6, &displacement32, sizeof(int32_t));
+    RedirectCode(machine_code, resolve_execute_address);
+  }
+}
+
+void X64CodeCache::RetireCodeRange(uint32_t offset, uint32_t end,
+                                   uint32_t resolve_guest_address) {
+  assert_true(end - offset > kRetiredCodeEntrySize);
+  retired_code_.push_back({offset, end, resolve_guest_address});
+  size_t size = end - offset - kRetiredCodeEntrySize;
+  retired_code_size_ += size;
+  code_cache_retired_bytes_.Increment(size);
+}
+
+void X64CodeCache::ReclaimRetiredCode(
+    const SuspendAndCaptureCallback& suspend_and_capture) {
+  auto global_lock = global_critical_region_.Acquire();
+  if (retired_code_.empty()) {
+    return;
+  }
+  std::lock_guard<std::recursive_mutex> map_lock(code_map_mutex_);
+  std::vector<uint64_t> host_pcs;
+  if (!suspend_and_capture(host_pcs)) {
+    XELOGW("Code cache: unable to walk the thread stacks, not reclaiming code");
+    return;
+  }
+  std::sort(host_pcs.begin(), host_pcs.end());
+  size_t reclaimed_size = 0;
+  size_t retired_count = 0;
+  for (const RetiredCode& retired_code : retired_code_) {
+    // A thread about to execute the entry is fine, the entry is kept.
+    auto entry = uint64_t(reinterpret_cast<uintptr_t>(
+        generated_code_execute_base_ + retired_code.offset));
+    auto pc_it = std::upper_bound(host_pcs.cbegin(), host_pcs.cend(), entry);
+    if (pc_it != host_pcs.cend() &&
+        *pc_it < entry + (retired_code.end - retired_code.offset)) {
+      retired_code_[retired_count++] = retired_code;
+      continue;
+    }
+    ReclaimCode(retired_code);
+    reclaimed_size +=
+        retired_code.end - retired_code.offset - kRetiredCodeEntrySize;
+  }
+  retired_code_.resize(retired_count);
+  retired_code_size_ -= reclaimed_size;
+  code_cache_reclaimed_bytes_.Increment(reclaimed_size);
+  XELOGI(
+      "Code cache: reclaimed {} KB, {} KB in use, {} KB free for reuse, {} KB "
+      "still executed",
+      reclaimed_size / 1024,
+      (generated_code_offset_ - free_code_size_) / 1024,
+      free_code_size_ / 1024, retired_code_size_ / 1024);
+}
+
+void X64CodeCache::ReclaimCode(const RetiredCode& retired_code) {
+  uint8_t* entry_write_address =
+      generated_code_write_base_ + retired_code.offset;
+  if (retired_code.resolve_guest_address) {
+    // mov ebx, guest_address; jmp resolve_function_thunk, like a call through
+    // the indirection table to a function that hasn't been resolved yet.
+    int64_t displacement =
+        int64_t(indirection_default_value_) -
+        int64_t(reinterpret_cast<uintptr_t>(generated_code_execute_base_ +
+                                            retired_code.offset + 10));
+    assert_true(displacement >= INT32_MIN && displacement <= INT32_MAX);
+    auto displacement32 = int32_t(displacement);
+    entry_write_address[0] = 0xBB;
+    std::memcpy(entry_write_address + 1, &retired_code.resolve_guest_address,
+                sizeof(uint32_t));
+    entry_write_address[5] = 0xE9;
+    std::memcpy(entry_write_address + 6, &displacement32, sizeof(int32_t));
+  }
+
+  // Keep only the entry in the map.
+  uint64_t map_key = (uint64_t(retired_code.offset) << 32) | retired_code.end;
+  auto map_it = std::lower_bound(
+      generated_code_map_.begin(), generated_code_map_.end(), map_key,
+      [](const std::pair<uint64_t, GuestFunction*>& entry, uint64_t key) {
+        return entry.first < key;
+      });
+  assert_true(map_it != generated_code_map_.end() &&
+              map_it->first == map_key);
+  map_it->first = (uint64_t(retired_code.offset) << 32) |
+                  (retired_code.offset + kRetiredCodeEntrySize);
+  RemoveUnwindEntry(generated_code_execute_base_ + retired_code.offset);
+
+  size_t free_offset = retired_code.offset + kRetiredCodeEntrySize;
+  std::memset(generated_code_write_base_ + free_offset, 0xCC,
+              retired_code.end - free_offset);
+  FreeCodeRange(free_offset, retired_code.end);
+}
+
+void X64CodeCache::FreeCodeRange(size_t offset, size_t end) {
+  auto next_it = free_code_ranges_.lower_bound(offset);
+  if (next_it != free_code_ranges_.end() && next_it->first == end) {
+    end += next_it->second;
+    free_code_size_ -= next_it->second;
+    next_it = free_code_ranges_.erase(next_it);
+  }
+  if (next_it != free_code_ranges_.begin()) {
+    auto previous_it = std::prev(next_it);
+    if (previous_it->first + previous_it->second == offset) {
+      offset = previous_it->first;
+      free_code_size_ -= previous_it->second;
+      free_code_ranges_.erase(previous_it);
+    }
+  }
+  if (end == generated_code_offset_) {
+    // Free space at the end is simply allocated again.
+    generated_code_offset_ = offset;
+    return;
+  }
+  free_code_ranges_.emplace(offset, end - offset);
+  free_code_size_ += end - offset;
+}
+
 GuestFunction* X64CodeCache::LookupFunction(uint64_t host_pc) {
+  std::lock_guard<std::recursive_mutex> map_lock(code_map_mutex_);
   uint32_t key = uint32_t(host_pc - kGeneratedCodeExecuteBase);
   void* fn_entry = std::bsearch(
       &key, generated_code_map_.data(), generated_code_map_.size() + 1,
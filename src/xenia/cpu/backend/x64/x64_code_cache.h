@@ -13,7 +13,9 @@
 #include <atomic>
 #include <cstddef>
 #include <cstdint>
+#include <map>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <utility>
 #include <vector>
@@ -58,6 +60,7 @@ class X64CodeCache : public CodeCache {
   // TODO(benvanik): padding/guards/etc
 
   bool has_indirection_table() { return indirection_table_base_ != nullptr; }
+  uint32_t indirection_default() const { return indirection_default_value_; }
   void set_indirection_default(uint32_t default_value);
   void AddIndirection(uint32_t guest_address, uint32_t host_address);
 
@@ -74,6 +77,22 @@ class X64CodeCache : public CodeCache {
                       void*& code_write_address_out);
   uint32_t PlaceData(const void* data, size_t length);
 
+  // Atomically replaces the 5 byte nop at the start of previously placed code
+  // with a jump to new code.
+  void RedirectCode(const void* old_execute_address,
+                    const void* new_execute_address);
+
+  // Retires the code placed at the address, which has been retranslated and
+  // redirected to the new code with RedirectCode.
+  void RetireCode(const void* execute_address);
+  void RetireFunctionCode(
+      const std::vector<GuestFunction*>& functions) override;
+  void InvalidateFunctionCode(
+      const std::vector<GuestFunction*>& functions) override;
+  size_t retired_code_size() const override { return retired_code_size_; }
+  void ReclaimRetiredCode(
+      const SuspendAndCaptureCallback& suspend_and_capture) override;
+
   GuestFunction* LookupFunction(uint64_t host_pc) override;
 
  protected:
@@ -97,6 +116,11 @@ class X64CodeCache : public CodeCache {
   // levels can exceed this
   static const size_t kMaximumFunctionCount = 1000000;
 
+  // The beginning of retired code kept for the callers with direct calls to
+  // it. For retranslated code it already jumps to the new code, for removed
+  // functions it's replaced with a jump to the function resolution thunk.
+  static const size_t kRetiredCodeEntrySize = 16;
+
   struct UnwindReservation {
     size_t data_size = 0;
     size_t table_slot = 0;
@@ -112,6 +136,9 @@ class X64CodeCache : public CodeCache {
                          const EmitFunctionInfo& func_info,
                          void* code_execute_address,
                          UnwindReservation unwind_reservation) {}
+  // Removes the unwind info of reclaimed code, leaving only the entry that is
+  // kept, which is a leaf.
+  virtual void RemoveUnwindEntry(void* code_execute_address) {}
 
   std::filesystem::path file_name_;
   xe::memory::FileMappingHandle mapping_ =
@@ -143,6 +170,33 @@ class X64CodeCache : public CodeCache {
   // This can be used to bsearch on host PC to find the guest function.
   // The key is [start address | end address].
   std::vector<std::pair<uint64_t, GuestFunction*>> generated_code_map_;
+  // Held by the lookups in generated_code_map_ and in the unwind info, which
+  // may be modified in the middle when reclaimed code is reused.
+  std::recursive_mutex code_map_mutex_;
+
+  struct RetiredCode {
+    // Offset of the entry of the code in generated code.
+    uint32_t offset;
+    // End of the code and its unwind info.
+    uint32_t end;
+    // Guest address the entry should resolve when called, or 0 if it already
+    // jumps to the new code.
+    uint32_t resolve_guest_address;
+  };
+  // Allocates space for code, reusing reclaimed ranges if possible, and
+  // returns its offset.
+  size_t AllocateCodeRange(size_t size);
+  void RetireCodeRange(uint32_t offset, uint32_t end,
+                       uint32_t resolve_guest_address);
+  void ReclaimCode(const RetiredCode& retired_code);
+  void FreeCodeRange(size_t offset, size_t end);
+
+  std::vector<RetiredCode> retired_code_;
+  size_t retired_code_size_ = 0;
+  // Reclaimed ranges, offset to size, not adjacent to each other or to the end
+  // of generated code.
+  std::map<size_t, size_t> free_code_ranges_;
+  size_t free_code_size_ = 0;
 };
 
 }  // namespace x64
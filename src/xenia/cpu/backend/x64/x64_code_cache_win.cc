@@ -9,6 +9,7 @@
 
 #include "xenia/cpu/backend/x64/x64_code_cache.h"
 
+#include <algorithm>
 #include <cstdlib>
 #include <cstring>
 
@@ -18,6 +19,7 @@
 #include "xenia/base/math.h"
 #include "xenia/base/memory.h"
 #include "xenia/base/platform_win.h"
+#include "xenia/cpu/cpu_flags.h"
 #include "xenia/cpu/function.h"
 
 // Function pointer definitions
@@ -109,6 +111,7 @@ class Win32X64CodeCache : public X64CodeCache {
   void PlaceCode(uint32_t guest_address, void* machine_code,
                  const EmitFunctionInfo& func_info, void* code_execute_address,
                  UnwindReservation unwind_reservation) override;
+  void RemoveUnwindEntry(void* code_execute_address) override;
 
   void InitializeUnwindEntry(uint8_t* unwind_entry_address,
                              size_t unwind_table_slot,
@@ -171,8 +174,11 @@ bool Win32X64CodeCache::Initialize() {
     grow_table_ = (FnRtlGrowFunctionTable)GetProcAddress(
         ntdll_handle, "RtlGrowFunctionTable");
   }
-  supports_growable_table_ =
-      add_growable_table_ && delete_growable_table_ && grow_table_;
+  // Reused reclaimed code is placed between the existing entries, which the
+  // growable table doesn't allow, so its entries are provided by the callback
+  // instead.
+  supports_growable_table_ = add_growable_table_ && delete_growable_table_ &&
+                             grow_table_ && !cvars::jit_code_reclamation;
 
   // Create table and register with the system. It's empty now, but we'll grow
   // it as functions are added.
@@ -232,9 +238,19 @@ void Win32X64CodeCache::PlaceCode(uint32_t guest_address, void* machine_code,
                                   void* code_execute_address,
                                   UnwindReservation unwind_reservation) {
   // Add unwind info.
-  InitializeUnwindEntry(unwind_reservation.entry_address,
-                        unwind_reservation.table_slot, code_execute_address,
-                        func_info);
+  size_t table_slot = unwind_reservation.table_slot;
+  if (!supports_growable_table_) {
+    // Keep the table sorted if the code is placed in reclaimed space.
+    auto code_offset = DWORD(reinterpret_cast<uint8_t*>(code_execute_address) -
+                             generated_code_execute_base_);
+    while (table_slot &&
+           unwind_table_[table_slot - 1].BeginAddress > code_offset) {
+      unwind_table_[table_slot] = unwind_table_[table_slot - 1];
+      --table_slot;
+    }
+  }
+  InitializeUnwindEntry(unwind_reservation.entry_address, table_slot,
+                        code_execute_address, func_info);
 
   if (supports_growable_table_) {
     // Notify that the unwind table has grown.
@@ -249,6 +265,24 @@ void Win32X64CodeCache::PlaceCode(uint32_t guest_address, void* machine_code,
                         func_info.code_size.total);
 }
 
+void Win32X64CodeCache::RemoveUnwindEntry(void* code_execute_address) {
+  // Only reclaimed with jit_code_reclamation, which doesn't use the growable
+  // table.
+  assert_false(supports_growable_table_);
+  auto code_offset = DWORD(reinterpret_cast<uint8_t*>(code_execute_address) -
+                           generated_code_execute_base_);
+  auto entries_end = unwind_table_.begin() + unwind_table_count_;
+  auto it = std::lower_bound(unwind_table_.begin(), entries_end, code_offset,
+                             [](const RUNTIME_FUNCTION& entry, DWORD offset) {
+                               return entry.BeginAddress < offset;
+                             });
+  if (it == entries_end || it->BeginAddress != code_offset) {
+    return;
+  }
+  std::move(it + 1, entries_end, it);
+  --unwind_table_count_;
+}
+
 void Win32X64CodeCache::InitializeUnwindEntry(
     uint8_t* unwind_entry_address, size_t unwind_table_slot,
     void* code_execute_address, const EmitFunctionInfo& func_info) {
@@ -324,6 +358,7 @@ void Win32X64CodeCache::InitializeUnwindEntry(
 }
 
 void* Win32X64CodeCache::LookupUnwindInfo(uint64_t host_pc) {
+  std::lock_guard<std::recursive_mutex> map_lock(code_map_mutex_);
   return std::bsearch(
       &host_pc, unwind_table_.data(), unwind_table_count_,
       sizeof(RUNTIME_FUNCTION),
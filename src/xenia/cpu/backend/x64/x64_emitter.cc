@@ -11,6 +11,7 @@
 
 #include <stddef.h>
 
+#include <algorithm>
 #include <climits>
 #include <cstring>
 
@@ -39,6 +40,8 @@
 #include "xenia/cpu/symbol.h"
 #include "xenia/cpu/thread_state.h"
 
+DECLARE_bool(debug);
+
 DEFINE_bool(debugprint_trap_log, false,
             "Log debugprint traps to the active debugger", "CPU");
 DEFINE_bool(ignore_undefined_externs, true,
@@ -53,11 +56,25 @@ DEFINE_bool(enable_incorrect_roundingmode_behavior, false,
             "code. The workaround may cause reduced CPU performance but is a "
             "more accurate emulation",
             "x64");
+DEFINE_bool(propagate_mxcsr_mode_across_blocks, true,
+            "Start blocks in the MXCSR mode all of their predecessors end in, "
+            "instead of checking the mode again at the beginning of every "
+            "block.",
+            "x64");
 DEFINE_uint32(align_all_basic_blocks, 0,
               "Aligns the start of all basic blocks to N bytes. Only specify a "
               "power of 2, 16 is the recommended value. Results in larger "
               "icache usage, but potentially faster loops",
               "x64");
+DEFINE_bool(direct_kernel_export_calls, true,
+            "Call the host handlers of kernel imports directly from the "
+            "caller instead of going through the import thunk. Breakpoints "
+            "on the import thunks will not be hit.",
+            "x64");
+DEFINE_bool(inline_cache_indirect_calls, true,
+            "Emit a two-entry inline cache at indirect call and branch sites "
+            "so repeated targets skip the indirection table lookup.",
+            "x64");
 #if XE_X64_PROFILER_AVAILABLE == 1
 DEFINE_bool(instrument_call_times, false,
             "Compute time taken for functions, for profiling guest code",
@@ -74,6 +91,8 @@ using namespace xe::literals;
 
 static const size_t kMaxCodeSize = 1_MiB;
 
+uint64_t OnBaselineFunctionHot(void* raw_context, uint64_t function_ptr);
+
 // static const size_t kStashOffsetHigh = 32 + 32;
 
 const uint32_t X64Emitter::gpr_reg_map_[X64Emitter::GPR_COUNT] = {
@@ -86,6 +105,8 @@ const uint32_t X64Emitter::xmm_reg_map_[X64Emitter::XMM_COUNT] = {
     4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15,
 };
 
+InlineCacheStats X64Emitter::inline_cache_stats_;
+
 X64Emitter::X64Emitter(X64Backend* backend, XbyakAllocator* allocator)
     : CodeGenerator(kMaxCodeSize, Xbyak::AutoGrow, allocator),
       processor_(backend->processor()),
@@ -119,6 +140,17 @@ bool X64Emitter::Emit(GuestFunction* function, HIRBuilder* builder,
   debug_info_ = debug_info;
   debug_info_flags_ = debug_info_flags;
   trace_data_ = &function->trace_data();
+  baseline_function_ = function->is_baseline() ? function : nullptr;
+  // Functions may be translated again due to code modification or
+  // conditional breakpoints.
+  patchable_entry_ = function->is_baseline() ||
+                     cvars::invalidate_modified_code || cvars::debug;
+  current_source_address_ = function->address();
+  execution_counter_ = cvars::jit_function_stats
+                           ? &function->jit_stats().execution_count
+                           : nullptr;
+  block_profile_function_ = cvars::guest_block_profile ? function : nullptr;
+  block_profile_block_ = nullptr;
   source_map_arena_.Reset();
 
   // Fill the generator with code.
@@ -235,6 +267,16 @@ bool X64Emitter::Emit(HIRBuilder* builder, EmitFunctionInfo& func_info) {
   func_info.stack_size = stack_size;
   stack_size_ = stack_size;
 
+  if (patchable_entry_) {
+    // A single 5 byte nop at the 16b aligned entry, which X64CodeCache can
+    // atomically replace with a jump to the optimized code.
+    db(0x0F);
+    db(0x1F);
+    db(0x44);
+    db(0x00);
+    db(0x00);
+  }
+
   PushStackpoint();
   sub(rsp, (uint32_t)stack_size);
 
@@ -250,6 +292,35 @@ bool X64Emitter::Emit(HIRBuilder* builder, EmitFunctionInfo& func_info) {
 
   mov(qword[rsp + StackLayout::GUEST_CALL_RET_ADDR], rax);  // 0
 
+  if (cvars::enable_host_guest_stack_synchronization &&
+      !X64Backend::UsesStackpoints()) {
+    // Instead of pushing a stackpoint, leave the guest stack pointer
+    // in the frame for X64Backend::FindHostFrameForReentry.
+    mov(eax, dword[GetContextReg() + offsetof(ppc::PPCContext, r[1])]);
+    mov(dword[rsp + StackLayout::GUEST_ENTRY_STACK_PTR], eax);
+  }
+
+  if (baseline_function_) {
+    // Count down the calls until the function is worth optimizing.
+    Xbyak::Label* hot_done = &NewCachedLabel();
+    Xbyak::Label& hot =
+        AddToTail([hot_done](X64Emitter& e, Xbyak::Label& our_tail_label) {
+          e.L(our_tail_label);
+          e.CallNative(OnBaselineFunctionHot,
+                       reinterpret_cast<uint64_t>(e.baseline_function_));
+          e.jmp(*hot_done, X64Emitter::T_NEAR);
+        });
+    mov(rax, reinterpret_cast<uint64_t>(baseline_function_->hot_counter()));
+    sub(dword[rax], 1);
+    jz(hot, T_NEAR);
+    L(*hot_done);
+  }
+
+  if (execution_counter_) {
+    mov(rax, reinterpret_cast<uint64_t>(execution_counter_));
+    inc(qword[rax]);
+  }
+
 #if XE_X64_PROFILER_AVAILABLE == 1
   if (cvars::instrument_call_times) {
     mov(rdx, 0x7ffe0014);  // load pointer to kusershared systemtime
@@ -293,10 +364,11 @@ bool X64Emitter::Emit(HIRBuilder* builder, EmitFunctionInfo& func_info) {
       qword[GetContextReg() + offsetof(ppc::PPCContext, virtual_membase)]);
   */
   // Body.
+  AnalyzeBlockMxcsrEdges(builder);
   auto block = builder->first_block();
   synchronize_stack_on_next_instruction_ = false;
   while (block) {
-    ForgetMxcsrMode();  // at start of block, mxcsr mode is undefined
+    BeginBlockMxcsrMode(block);
 
     // Mark block labels.
     auto label = block->label_head;
@@ -326,11 +398,21 @@ bool X64Emitter::Emit(HIRBuilder* builder, EmitFunctionInfo& func_info) {
         XELOGE("Unable to process HIR opcode {}", GetOpcodeName(instr->opcode));
         break;
       }
+      MergeMxcsrModeOnBranches(block, instr, new_tail);
       instr = new_tail;
     }
 
+    // Anything but an unconditional branch or return may fall through.
+    auto tail = block->instr_tail;
+    if (block->next &&
+        (!tail || (tail->opcode != &hir::OPCODE_BRANCH_info &&
+                   tail->opcode != &hir::OPCODE_RETURN_info))) {
+      MergeMxcsrModeInto(block, block->next);
+    }
+
     block = block->next;
   }
+  block_mxcsr_states_.clear();
 
   // Function epilog.
   L(epilog_label);
@@ -394,11 +476,20 @@ void X64Emitter::EmitProfilerEpilogue() {
 #endif
 }
 
+GuestFunction::BranchCounters* X64Emitter::GetBranchCounters(const Instr* i) {
+  if (!baseline_function_ || !(i->flags & hir::BRANCH_PROFILED) ||
+      !cvars::jit_trace_formation) {
+    return nullptr;
+  }
+  return baseline_function_->AllocBranchCounters(current_source_address_);
+}
+
 void X64Emitter::MarkSourceOffset(const Instr* i) {
   auto entry = source_map_arena_.Alloc<SourceMapEntry>();
   entry->guest_address = static_cast<uint32_t>(i->src1.offset);
   entry->hir_offset = uint32_t(i->block->ordinal << 16) | i->ordinal;
   entry->code_offset = static_cast<uint32_t>(getSize());
+  current_source_address_ = entry->guest_address;
 
   if (cvars::emit_source_annotations) {
     nop(2);
@@ -406,6 +497,15 @@ void X64Emitter::MarkSourceOffset(const Instr* i) {
     nop(2);
   }
 
+  if (block_profile_function_ && i->block != block_profile_block_) {
+    block_profile_block_ = i->block;
+    // Approximate, so not atomic.
+    mov(rax, reinterpret_cast<uint64_t>(
+                 block_profile_function_->AllocBlockCounter(
+                     entry->guest_address)));
+    inc(qword[rax]);
+  }
+
   if (debug_info_flags_ & DebugInfoFlags::kDebugInfoTraceFunctionCoverage) {
     uint32_t instruction_index =
         (entry->guest_address - trace_data_->start_address()) / 4;
@@ -482,8 +582,19 @@ void X64Emitter::UnimplementedInstr(const hir::Instr* i) {
   assert_always();
 }
 
+uint64_t OnBaselineFunctionHot(void* raw_context, uint64_t function_ptr) {
+  auto thread_state =
+      reinterpret_cast<ppc::PPCContext_s*>(raw_context)->thread_state;
+  thread_state->processor()->QueueHotFunction(
+      reinterpret_cast<GuestFunction*>(function_ptr));
+  return 0;
+}
+
 // This is used by the X64ThunkEmitter's ResolveFunctionThunk.
-uint64_t ResolveFunction(void* raw_context, uint64_t target_address) {
+// caller_host_rsp points to the return address into the calling guest
+// function, or is 0 if unknown.
+uint64_t ResolveFunctionFromThunk(void* raw_context, uint64_t target_address,
+                                  uint64_t caller_host_rsp) {
   auto guest_context = reinterpret_cast<ppc::PPCContext_s*>(raw_context);
 
   auto thread_state = guest_context->thread_state;
@@ -553,7 +664,21 @@ uint64_t ResolveFunction(void* raw_context, uint64_t target_address) {
               }
               // we found an existing X64Function, and a return site within that
               // function that has a host address w/ native code
-              if (candidate && host_address) {
+              if (candidate && host_address &&
+                  !X64Backend::UsesStackpoints()) {
+                // Only a longjmp if one of the frames we were called from is
+                // that of the function at the guest stack being restored. The
+                // synchronization at the return site finds the same frame
+                // again.
+                X64Backend* backend =
+                    static_cast<X64Backend*>(processor->backend());
+                if (caller_host_rsp &&
+                    backend->FindHostFrameForReentry(
+                        caller_host_rsp, candidate,
+                        static_cast<uint32_t>(guest_context->r[1]))) {
+                  return host_address;
+                }
+              } else if (candidate && host_address) {
                 X64Backend* backend =
                     static_cast<X64Backend*>(processor->backend());
                 // grab the backend context, next we have to check whether the
@@ -696,9 +821,25 @@ uint64_t ResolveFunction(void* raw_context, uint64_t target_address) {
   return addr;
 }
 
+uint64_t ResolveFunction(void* raw_context, uint64_t target_address) {
+  return ResolveFunctionFromThunk(raw_context, target_address, 0);
+}
+
 void X64Emitter::Call(const hir::Instr* instr, GuestFunction* function) {
   assert_not_null(function);
   ForgetMxcsrMode();
+  if (cvars::direct_kernel_export_calls &&
+      function->behavior() == Function::Behavior::kExtern) {
+    // Import thunks are just sc 2 + blr, so the handler can be called in
+    // place with the LR the caller has already set up. This also covers
+    // indirect calls constant propagation resolved to a thunk, such as
+    // through function pointer tables in read-only memory.
+    CallExtern(instr, function);
+    if (instr->flags & hir::CALL_TAIL) {
+      jmp(epilog_label(), T_NEAR);
+    }
+    return;
+  }
   auto fn = static_cast<X64Function*>(function);
   // Resolve address to the function to call and store in rax.
 
@@ -754,6 +895,75 @@ void X64Emitter::Call(const hir::Instr* instr, GuestFunction* function) {
   }
 }
 
+// Each inline cache is two qwords placed in the code cache, each holding the
+// guest target in the low dword and its host code address in the high dword so
+// that a pair is always read and written atomically. The first entry is the
+// most recent target; on a miss it is shifted into the second entry, which
+// gives polymorphic sites such as vtable calls with two receivers a hit on
+// both.
+// Entries aren't invalidated when the code they point to is retranslated,
+// invalidated or removed. The code cache redirects the entry of such code to
+// the new code or to a stub resolving the function again, and keeps that entry
+// when the rest of the code is retired and reclaimed (see
+// X64CodeCache::kRetiredCodeEntrySize), so a stale entry only costs a jump.
+// In: ebx = guest target. Out: rax = host target. Clobbers rcx and rdx.
+void X64Emitter::EmitIndirectCallInlineCache() {
+  static const uint64_t kEmptyEntry = 0x00000000FFFFFFFFull;
+  const uint64_t empty_cache[2] = {kEmptyEntry, kEmptyEntry};
+  uint32_t cache_address =
+      code_cache_->PlaceData(empty_cache, sizeof(empty_cache));
+  inline_cache_stats_.sites.fetch_add(1, std::memory_order_relaxed);
+
+  Xbyak::Label* done = &NewCachedLabel();
+  Xbyak::Label& check_secondary =
+      AddToTail([done](X64Emitter& e, Xbyak::Label& our_tail_label) {
+        e.L(our_tail_label);
+        Xbyak::Label miss;
+        e.mov(rax, qword[rdx + 8]);
+        e.cmp(eax, ebx);
+        e.jne(miss);
+        e.mov(rcx, reinterpret_cast<uint64_t>(
+                       &inline_cache_stats_.secondary_hits));
+        e.lock();
+        e.inc(qword[rcx]);
+        e.shr(rax, 32);
+        e.jmp(*done, X64Emitter::T_NEAR);
+
+        e.L(miss);
+        Xbyak::Label cacheable;
+        e.mov(eax, dword[ebx]);
+        // Unresolved targets point at the resolve thunk; caching that would
+        // send every later call through ResolveFunction.
+        e.cmp(eax, e.code_cache_->indirection_default());
+        e.jne(cacheable);
+        e.mov(rcx, reinterpret_cast<uint64_t>(
+                       &inline_cache_stats_.unresolved_misses));
+        e.lock();
+        e.inc(qword[rcx]);
+        e.jmp(*done, X64Emitter::T_NEAR);
+
+        e.L(cacheable);
+        e.mov(rcx, reinterpret_cast<uint64_t>(&inline_cache_stats_.misses));
+        e.lock();
+        e.inc(qword[rcx]);
+        e.mov(rcx, qword[rdx]);
+        e.mov(qword[rdx + 8], rcx);
+        e.shl(rax, 32);
+        e.mov(ecx, ebx);
+        e.or_(rcx, rax);
+        e.shr(rax, 32);
+        e.mov(qword[rdx], rcx);
+        e.jmp(*done, X64Emitter::T_NEAR);
+      });
+
+  mov(edx, cache_address);
+  mov(rax, qword[rdx]);
+  cmp(eax, ebx);
+  jne(check_secondary, T_NEAR);
+  shr(rax, 32);
+  L(*done);
+}
+
 void X64Emitter::CallIndirect(const hir::Instr* instr,
                               const Xbyak::Reg64& reg) {
   ForgetMxcsrMode();
@@ -766,7 +976,13 @@ void X64Emitter::CallIndirect(const hir::Instr* instr,
   // Load the pointer to the indirection table maintained in X64CodeCache.
   // The target dword will either contain the address of the generated code
   // or a thunk to ResolveAddress.
-  if (code_cache_->has_indirection_table()) {
+  if (code_cache_->has_indirection_table() &&
+      cvars::inline_cache_indirect_calls) {
+    if (reg.cvt32() != ebx) {
+      mov(ebx, reg.cvt32());
+    }
+    EmitIndirectCallInlineCache();
+  } else if (code_cache_->has_indirection_table()) {
     if (reg.cvt32() != ebx) {
       mov(ebx, reg.cvt32());
     }
@@ -1259,7 +1475,7 @@ uintptr_t X64Emitter::PlaceConstData() {
   void* mem = nullptr;
   while (!mem) {
     mem = memory::AllocFixed(
-        ptr, xe::round_up(kConstDataSize, memory::page_size()),
+        ptr, GetConstantPoolOffset() + kConstantPoolSize,
         memory::AllocationType::kReserveCommit, memory::PageAccess::kReadWrite);
 
     ptr += kConstDataIncrement;
@@ -1284,6 +1500,11 @@ uintptr_t X64Emitter::PlaceConstData() {
   return reinterpret_cast<uintptr_t>(mem);
 }
 
+size_t X64Emitter::GetConstantPoolOffset() {
+  // Not to make the pool read-only with the table.
+  return xe::round_up(kConstDataSize, memory::page_size());
+}
+
 void X64Emitter::FreeConstData(uintptr_t data) {
   memory::DeallocFixed(reinterpret_cast<void*>(data), 0,
                        memory::DeallocationType::kRelease);
@@ -1333,6 +1554,9 @@ void X64Emitter::LoadConstantXmm(Xbyak::Xmm dest, const vec128_t& v) {
           vpbroadcastb(dest, byte[bval]);
           return;
         }
+        if (LoadPooledConstantXmm(dest, v)) {
+          return;
+        }
         // didnt find existing mem with the value
         mov(byte[rsp + kStashOffset], firstbyte);
         vpbroadcastb(dest, byte[rsp + kStashOffset]);
@@ -1353,6 +1577,9 @@ void X64Emitter::LoadConstantXmm(Xbyak::Xmm dest, const vec128_t& v) {
           vpbroadcastw(dest, word[wval]);
           return;
         }
+        if (LoadPooledConstantXmm(dest, v)) {
+          return;
+        }
         // didnt find existing mem with the value
         mov(word[rsp + kStashOffset], firstword);
         vpbroadcastw(dest, word[rsp + kStashOffset]);
@@ -1373,6 +1600,9 @@ void X64Emitter::LoadConstantXmm(Xbyak::Xmm dest, const vec128_t& v) {
           vpbroadcastd(dest, dword[dwval]);
           return;
         }
+        if (LoadPooledConstantXmm(dest, v)) {
+          return;
+        }
         mov(dword[rsp + kStashOffset], firstdword);
         vpbroadcastd(dest, dword[rsp + kStashOffset]);
         return;
@@ -1386,6 +1616,9 @@ void X64Emitter::LoadConstantXmm(Xbyak::Xmm dest, const vec128_t& v) {
           vpbroadcastq(dest, qword[qwval]);
           return;
         }
+        if (LoadPooledConstantXmm(dest, v)) {
+          return;
+        }
         MovMem64(rsp + kStashOffset, v.low);
         vpbroadcastq(dest, qword[rsp + kStashOffset]);
         return;
@@ -1406,6 +1639,9 @@ void X64Emitter::LoadConstantXmm(Xbyak::Xmm dest, const vec128_t& v) {
       movq(dest, dest);
       return;
     }
+    if (LoadPooledConstantXmm(dest, v)) {
+      return;
+    }
     if (v.high == 0) {
       if ((v.low & 0xFFFFFFFF) == v.low) {
         mov(dword[rsp + kStashOffset], static_cast<unsigned>(v.low));
@@ -1417,14 +1653,21 @@ void X64Emitter::LoadConstantXmm(Xbyak::Xmm dest, const vec128_t& v) {
       return;
     }
 
-    // TODO(benvanik): see what other common values are.
-    // TODO(benvanik): build constant table - 99% are reused.
     MovMem64(rsp + kStashOffset, v.low);
     MovMem64(rsp + kStashOffset + 8, v.high);
     vmovdqa(dest, ptr[rsp + kStashOffset]);
   }
 }
 
+bool X64Emitter::LoadPooledConstantXmm(Xbyak::Xmm dest, const vec128_t& v) {
+  uint32_t address = backend_->FindOrPlaceConstant(v);
+  if (!address) {
+    return false;
+  }
+  vmovdqa(dest, ptr[reinterpret_cast<void*>(uintptr_t(address))]);
+  return true;
+}
+
 void X64Emitter::LoadConstantXmm(Xbyak::Xmm dest, float v) {
   union {
     float f;
@@ -1472,8 +1715,12 @@ void X64Emitter::LoadConstantXmm(Xbyak::Xmm dest, double v) {
         return;
       }
     }
-    // TODO(benvanik): see what other common values are.
-    // TODO(benvanik): build constant table - 99% are reused.
+    // Shorter than loading a 64-bit immediate to a GPR and moving it.
+    uint32_t address = backend_->FindOrPlaceConstant(vec128q(raw_bits, 0));
+    if (address) {
+      vmovsd(dest, qword[reinterpret_cast<void*>(uintptr_t(address))]);
+      return;
+    }
     mov(rax, x.i);
     vmovq(dest, rax);
   }
@@ -1654,6 +1901,7 @@ static void ChangeMxcsrModeDynamicHelper(X64Emitter& e) {
   Xbyak::Label& reload_bailout =
       e.AddToTail([&come_back](X64Emitter& e, Xbyak::Label& thislabel) {
         e.L(thislabel);
+        e.CountMxcsrSwitch();
         if (switching_to_fpu) {
           e.LoadFpuMxcsrDirect();
         } else {
@@ -1705,6 +1953,7 @@ bool X64Emitter::ChangeMxcsrMode(MXCSRMode new_mode, bool already_set) {
   } else {
     mxcsr_mode_ = new_mode;
     if (!already_set) {
+      CountMxcsrSwitch();
       if (new_mode == MXCSRMode::Fpu) {
         LoadFpuMxcsrDirect();
         btr(GetBackendFlagsPtr(), kX64BackendMXCSRModeBit);
@@ -1720,6 +1969,100 @@ bool X64Emitter::ChangeMxcsrMode(MXCSRMode new_mode, bool already_set) {
   }
   return false;
 }
+void X64Emitter::CountMxcsrSwitch() {
+  if (!cvars::x64_count_mxcsr_switches) {
+    return;
+  }
+  Xbyak::Address count =
+      GetBackendCtxPtr(offsetof(X64BackendContext, mxcsr_switch_count));
+  count.setBit(64);
+  inc(count);
+}
+
+void X64Emitter::AnalyzeBlockMxcsrEdges(HIRBuilder* builder) {
+  block_mxcsr_states_.clear();
+  if (!cvars::propagate_mxcsr_mode_across_blocks ||
+      cvars::enable_incorrect_roundingmode_behavior) {
+    return;
+  }
+  // Block ordinals are in placement order after FinalizationPass.
+  size_t block_count = 0;
+  for (auto block = builder->first_block(); block; block = block->next) {
+    block_count = std::max(block_count, size_t(block->ordinal) + 1);
+  }
+  block_mxcsr_states_.resize(block_count);
+  for (auto block = builder->first_block(); block; block = block->next) {
+    for (auto i = block->instr_head; i; i = i->next) {
+      uint32_t signature = i->opcode->signature;
+      const hir::Label* targets[] = {
+          GET_OPCODE_SIG_TYPE_SRC1(signature) == hir::OPCODE_SIG_TYPE_L
+              ? i->src1.label
+              : nullptr,
+          GET_OPCODE_SIG_TYPE_SRC2(signature) == hir::OPCODE_SIG_TYPE_L
+              ? i->src2.label
+              : nullptr,
+          GET_OPCODE_SIG_TYPE_SRC3(signature) == hir::OPCODE_SIG_TYPE_L
+              ? i->src3.label
+              : nullptr,
+      };
+      for (auto target : targets) {
+        if (target && target->block->ordinal <= block->ordinal) {
+          block_mxcsr_states_[target->block->ordinal].has_back_edge = true;
+        }
+      }
+    }
+  }
+}
+
+void X64Emitter::MergeMxcsrModeInto(const hir::Block* current,
+                                    const hir::Block* target) {
+  if (block_mxcsr_states_.empty() || target->ordinal <= current->ordinal) {
+    return;
+  }
+  auto& state = block_mxcsr_states_[target->ordinal];
+  if (!state.has_incoming) {
+    state.incoming = mxcsr_mode_;
+    state.has_incoming = true;
+  } else if (state.incoming != mxcsr_mode_) {
+    state.incoming = MXCSRMode::Unknown;
+  }
+}
+
+void X64Emitter::MergeMxcsrModeOnBranches(const hir::Block* current,
+                                          const Instr* first,
+                                          const Instr* end) {
+  if (block_mxcsr_states_.empty()) {
+    return;
+  }
+  // The mode after the sequence is the one at its jumps, compares fused into
+  // a branch switch the mode before jumping.
+  for (auto i = first; i && i != end; i = i->next) {
+    uint32_t signature = i->opcode->signature;
+    if (GET_OPCODE_SIG_TYPE_SRC1(signature) == hir::OPCODE_SIG_TYPE_L) {
+      MergeMxcsrModeInto(current, i->src1.label->block);
+    }
+    if (GET_OPCODE_SIG_TYPE_SRC2(signature) == hir::OPCODE_SIG_TYPE_L) {
+      MergeMxcsrModeInto(current, i->src2.label->block);
+    }
+    if (GET_OPCODE_SIG_TYPE_SRC3(signature) == hir::OPCODE_SIG_TYPE_L) {
+      MergeMxcsrModeInto(current, i->src3.label->block);
+    }
+  }
+}
+
+void X64Emitter::BeginBlockMxcsrMode(const hir::Block* block) {
+  ForgetMxcsrMode();  // at start of block, mxcsr mode is undefined
+  if (block_mxcsr_states_.empty()) {
+    return;
+  }
+  // Blocks without any emitted predecessor are only reached from the function
+  // entry, where the mode is unknown too.
+  auto& state = block_mxcsr_states_[block->ordinal];
+  if (state.has_incoming && !state.has_back_edge) {
+    mxcsr_mode_ = state.incoming;
+  }
+}
+
 void X64Emitter::LoadFpuMxcsrDirect() {
   vldmxcsr(GetBackendCtxPtr(offsetof(X64BackendContext, mxcsr_fpu)));
 }
@@ -1744,7 +2087,7 @@ void X64Emitter::HandleStackpointOverflowError(ppc::PPCContext* context) {
 }
 
 void X64Emitter::PushStackpoint() {
-  if (!cvars::enable_host_guest_stack_synchronization) {
+  if (!X64Backend::UsesStackpoints()) {
     return;
   }
   // push the current host and guest stack pointers
@@ -1788,7 +2131,7 @@ void X64Emitter::PushStackpoint() {
   jge(overflowed_stackpoints, T_NEAR);
 }
 void X64Emitter::PopStackpoint() {
-  if (!cvars::enable_host_guest_stack_synchronization) {
+  if (!X64Backend::UsesStackpoints()) {
     return;
   }
   // todo: maybe verify that rsp and r1 == the stackpoint?
@@ -10,6 +10,7 @@
 #ifndef XENIA_CPU_BACKEND_X64_X64_EMITTER_H_
 #define XENIA_CPU_BACKEND_X64_X64_EMITTER_H_
 
+#include <atomic>
 #include <vector>
 
 #include "xenia/base/arena.h"
@@ -199,6 +200,19 @@ class XbyakAllocator : public Xbyak::Allocator {
 
 class X64Emitter;
 using TailEmitCallback = std::function<void(X64Emitter& e, Xbyak::Label& lbl)>;
+// Counters for the inline caches emitted at indirect call sites. Hits on the
+// first entry are not counted to keep the fast path free of memory writes.
+struct InlineCacheStats {
+  // Number of call sites that were emitted with an inline cache.
+  std::atomic<uint64_t> sites = {0};
+  // Lookups that matched the second (older) entry of a site.
+  std::atomic<uint64_t> secondary_hits = {0};
+  // Lookups that matched no entry and went through the indirection table.
+  std::atomic<uint64_t> misses = {0};
+  // Misses that found an unresolved target and could not be cached.
+  std::atomic<uint64_t> unresolved_misses = {0};
+};
+
 struct TailEmitter {
   Xbyak::Label label;
   uint32_t alignment;
@@ -213,8 +227,14 @@ class X64Emitter : public Xbyak::CodeGenerator {
   Processor* processor() const { return processor_; }
   X64Backend* backend() const { return backend_; }
 
+  // Places the constant table, followed by kConstantPoolSize bytes for the
+  // constant pool of X64Backend at GetConstantPoolOffset().
   static uintptr_t PlaceConstData();
   static void FreeConstData(uintptr_t data);
+  static size_t GetConstantPoolOffset();
+  static constexpr size_t kConstantPoolSize = 1024 * 1024;
+
+  static InlineCacheStats& inline_cache_stats() { return inline_cache_stats_; }
 
   bool Emit(GuestFunction* function, hir::HIRBuilder* builder,
             uint32_t debug_info_flags, FunctionDebugInfo* debug_info,
@@ -254,6 +274,9 @@ class X64Emitter : public Xbyak::CodeGenerator {
   Xbyak::Label& epilog_label() { return *epilog_label_; }
 
   void MarkSourceOffset(const hir::Instr* i);
+  // Counters for a conditional branch that baseline code should count the
+  // direction of for jit_trace_formation, or null.
+  GuestFunction::BranchCounters* GetBranchCounters(const hir::Instr* i);
 
   void DebugBreak();
   void Trap(uint16_t trap_type = 0);
@@ -261,6 +284,7 @@ class X64Emitter : public Xbyak::CodeGenerator {
 
   void Call(const hir::Instr* instr, GuestFunction* function);
   void CallIndirect(const hir::Instr* instr, const Xbyak::Reg64& reg);
+  void EmitIndirectCallInlineCache();
   void CallExtern(const hir::Instr* instr, const Function* function);
   void CallNative(void* fn);
   void CallNative(uint64_t (*fn)(void* raw_context));
@@ -289,6 +313,9 @@ class X64Emitter : public Xbyak::CodeGenerator {
   void LoadConstantXmm(Xbyak::Xmm dest, float v);
   void LoadConstantXmm(Xbyak::Xmm dest, double v);
   void LoadConstantXmm(Xbyak::Xmm dest, const vec128_t& v);
+  // Loads a constant not in the constant table from the constant pool shared
+  // by all generated code, returns false if the pool is full.
+  bool LoadPooledConstantXmm(Xbyak::Xmm dest, const vec128_t& v);
   Xbyak::Address StashXmm(int index, const Xbyak::Xmm& r);
   Xbyak::Address StashConstantXmm(int index, float v);
   Xbyak::Address StashConstantXmm(int index, double v);
@@ -327,6 +354,8 @@ class X64Emitter : public Xbyak::CodeGenerator {
 
   void LoadFpuMxcsrDirect();  // unsafe, does not change mxcsr_mode_
   void LoadVmxMxcsrDirect();  // unsafe, does not change mxcsr_mode_
+  // Counts an MXCSR load for x64_count_mxcsr_switches. Clobbers flags.
+  void CountMxcsrSwitch();
 
   XexModule* GuestModule() { return guest_module_; }
 
@@ -412,12 +441,28 @@ class X64Emitter : public Xbyak::CodeGenerator {
   FunctionDebugInfo* debug_info_ = nullptr;
   uint32_t debug_info_flags_ = 0;
   FunctionTraceData* trace_data_ = nullptr;
+  // The function being emitted if it's baseline code that needs a call
+  // counter and a patchable entry, null otherwise.
+  GuestFunction* baseline_function_ = nullptr;
+  // Baseline code, or any code with --invalidate_modified_code, so calls to it
+  // can be redirected.
+  bool patchable_entry_ = false;
+  // GuestFunction::JitStats::execution_count with --jit_function_stats.
+  uint64_t* execution_counter_ = nullptr;
+  // Guest address of the last SOURCE_OFFSET.
+  uint32_t current_source_address_ = 0;
+  // The function being emitted with --guest_block_profile, null otherwise.
+  GuestFunction* block_profile_function_ = nullptr;
+  // Block of the last SOURCE_OFFSET, for counting the executions of every
+  // block once at its first guest instruction.
+  const hir::Block* block_profile_block_ = nullptr;
   Arena source_map_arena_;
 
   size_t stack_size_ = 0;
 
   static const uint32_t gpr_reg_map_[GPR_COUNT];
   static const uint32_t xmm_reg_map_[XMM_COUNT];
+  static InlineCacheStats inline_cache_stats_;
   /*
     set to true if the low 32 bits of membase == 0.
     only really advantageous if you are storing 32 bit 0 to a displaced address,
@@ -429,6 +474,23 @@ class X64Emitter : public Xbyak::CodeGenerator {
       label_cache_;  // for creating labels that need to be referenced much
                      // later by tail emitters
   MXCSRMode mxcsr_mode_ = MXCSRMode::Unknown;
+
+  // Per block, indexed by ordinal. A block starts in the mode all of its
+  // predecessors end in, as long as they are all placed before it.
+  struct BlockMxcsrState {
+    MXCSRMode incoming = MXCSRMode::Unknown;
+    bool has_incoming = false;
+    // Entered from itself or a later block, so the mode is unknown until
+    // checked.
+    bool has_back_edge = false;
+  };
+  void AnalyzeBlockMxcsrEdges(hir::HIRBuilder* builder);
+  void MergeMxcsrModeInto(const hir::Block* current, const hir::Block* target);
+  void MergeMxcsrModeOnBranches(const hir::Block* current,
+                                const hir::Instr* first,
+                                const hir::Instr* end);
+  void BeginBlockMxcsrMode(const hir::Block* block);
+  std::vector<BlockMxcsrState> block_mxcsr_states_;
 };
 
 }  // namespace x64
@@ -28,12 +28,25 @@ class X64Function : public GuestFunction {
 
   void Setup(uint8_t* machine_code, size_t machine_code_length);
 
+  // Whether the machine code begins with a 5 byte nop that can be replaced
+  // with a jump when the function is retranslated.
+  bool has_patchable_entry() const { return has_patchable_entry_; }
+  void set_patchable_entry(bool value) { has_patchable_entry_ = value; }
+
+  // Bytes the function allocates on the host stack, not counting the return
+  // address. Retranslations only differ in this when they spill locals to the
+  // stack, which needs more than 64k of them.
+  size_t stack_size() const { return stack_size_; }
+  void set_stack_size(size_t value) { stack_size_ = value; }
+
  protected:
   bool CallImpl(ThreadState* thread_state, uint32_t return_address) override;
 
  private:
   uint8_t* machine_code_ = nullptr;
   size_t machine_code_length_ = 0;
+  bool has_patchable_entry_ = false;
+  size_t stack_size_ = 0;
 };
 
 }  // namespace x64
@@ -11,6 +11,7 @@
 
 #include <algorithm>
 #include <cstring>
+#include <string>
 
 #include "xenia/cpu/backend/x64/x64_op.h"
 
@@ -20,12 +21,44 @@ namespace backend {
 namespace x64 {
 
 volatile int anchor_control = 0;
+
+// With jit_trace_formation, baseline code counts the direction of guest
+// conditional branches. Taken branches jump to a stub in the tail that counts
+// them before continuing to the real target, and the fallthrough is counted
+// right after the branch. Flags are dead at both points.
+template <typename T>
+static std::string GetBranchTarget(X64Emitter& e, const T& i) {
+  std::string target = i.src2.value->GetIdString();
+  auto counters = e.GetBranchCounters(i.instr);
+  if (!counters) {
+    return target;
+  }
+  std::string stub =
+      target + "_taken" +
+      std::to_string(reinterpret_cast<uintptr_t>(i.instr));
+  e.AddToTail([stub, target, counters](X64Emitter& e, Xbyak::Label&) {
+    e.L(stub);
+    e.mov(e.rax, reinterpret_cast<uint64_t>(&counters->taken));
+    e.inc(e.dword[e.rax]);
+    e.jmp(target, e.T_NEAR);
+  });
+  return stub;
+}
+template <typename T>
+static void CountBranchNotTaken(X64Emitter& e, const T& i) {
+  auto counters = e.GetBranchCounters(i.instr);
+  if (counters) {
+    e.mov(e.rax, reinterpret_cast<uint64_t>(&counters->not_taken));
+    e.inc(e.dword[e.rax]);
+  }
+}
+
 template <typename T>
 static void EmitFusedBranch(X64Emitter& e, const T& i) {
   bool valid = i.instr->prev && i.instr->prev->dest == i.src1.value;
   auto opcode = valid ? i.instr->prev->opcode->num : -1;
   if (valid) {
-    std::string name = i.src2.value->GetIdString();
+    std::string name = GetBranchTarget(e, i);
     switch (opcode) {
       case OPCODE_COMPARE_EQ:
         e.je(std::move(name), e.T_NEAR);
@@ -64,8 +97,9 @@ static void EmitFusedBranch(X64Emitter& e, const T& i) {
     }
   } else {
     e.test(i.src1, i.src1);
-    e.jnz(i.src2.value->GetIdString(), e.T_NEAR);
+    e.jnz(GetBranchTarget(e, i), e.T_NEAR);
   }
+  CountBranchNotTaken(e, i);
 }
 // ============================================================================
 // OPCODE_DEBUG_BREAK
@@ -182,6 +216,16 @@ struct TRAP_TRUE_I8
   static void Emit(X64Emitter& e, const EmitArgType& i) {
     Xbyak::Label& after = e.NewCachedLabel();
     unsigned flags = i.instr->flags;
+    if (flags == TRAP_TRUE_BREAKPOINT) {
+      // Not in the tail, so the host address of the ud2 maps back to the guest
+      // instruction with the breakpoint. The breakpoint handler resumes after
+      // the ud2.
+      e.test(i.src1, i.src1);
+      e.jz(after, X64Emitter::T_NEAR);
+      e.ud2();
+      e.L(after);
+      return;
+    }
     Xbyak::Label& dotrap =
         e.AddToTail([flags, &after](X64Emitter& e, Xbyak::Label& me) {
           e.L(me);
@@ -534,7 +578,8 @@ struct BRANCH_TRUE_F32
     Xmm input = GetInputRegOrConstant(e, i.src1, e.xmm0);
     e.vmovd(e.eax, input);
     e.test(e.eax, e.eax);
-    e.jnz(i.src2.value->GetIdString(), e.T_NEAR);
+    e.jnz(GetBranchTarget(e, i), e.T_NEAR);
+    CountBranchNotTaken(e, i);
   }
 };
 struct BRANCH_TRUE_F64
@@ -543,7 +588,8 @@ struct BRANCH_TRUE_F64
     Xmm input = GetInputRegOrConstant(e, i.src1, e.xmm0);
     e.vmovq(e.rax, input);
     e.test(e.rax, e.rax);
-    e.jnz(i.src2.value->GetIdString(), e.T_NEAR);
+    e.jnz(GetBranchTarget(e, i), e.T_NEAR);
+    CountBranchNotTaken(e, i);
   }
 };
 EMITTER_OPCODE_TABLE(OPCODE_BRANCH_TRUE, BRANCH_TRUE_I8, BRANCH_TRUE_I16,
@@ -557,7 +603,8 @@ struct BRANCH_FALSE_I8
     : Sequence<BRANCH_FALSE_I8, I<OPCODE_BRANCH_FALSE, VoidOp, I8Op, LabelOp>> {
   static void Emit(X64Emitter& e, const EmitArgType& i) {
     e.test(i.src1, i.src1);
-    e.jz(i.src2.value->GetIdString(), e.T_NEAR);
+    e.jz(GetBranchTarget(e, i), e.T_NEAR);
+    CountBranchNotTaken(e, i);
   }
 };
 struct BRANCH_FALSE_I16
@@ -565,7 +612,8 @@ struct BRANCH_FALSE_I16
                I<OPCODE_BRANCH_FALSE, VoidOp, I16Op, LabelOp>> {
   static void Emit(X64Emitter& e, const EmitArgType& i) {
     e.test(i.src1, i.src1);
-    e.jz(i.src2.value->GetIdString(), e.T_NEAR);
+    e.jz(GetBranchTarget(e, i), e.T_NEAR);
+    CountBranchNotTaken(e, i);
   }
 };
 struct BRANCH_FALSE_I32
@@ -573,7 +621,8 @@ struct BRANCH_FALSE_I32
                I<OPCODE_BRANCH_FALSE, VoidOp, I32Op, LabelOp>> {
   static void Emit(X64Emitter& e, const EmitArgType& i) {
     e.test(i.src1, i.src1);
-    e.jz(i.src2.value->GetIdString(), e.T_NEAR);
+    e.jz(GetBranchTarget(e, i), e.T_NEAR);
+    CountBranchNotTaken(e, i);
   }
 };
 struct BRANCH_FALSE_I64
@@ -581,7 +630,8 @@ struct BRANCH_FALSE_I64
                I<OPCODE_BRANCH_FALSE, VoidOp, I64Op, LabelOp>> {
   static void Emit(X64Emitter& e, const EmitArgType& i) {
     e.test(i.src1, i.src1);
-    e.jz(i.src2.value->GetIdString(), e.T_NEAR);
+    e.jz(GetBranchTarget(e, i), e.T_NEAR);
+    CountBranchNotTaken(e, i);
   }
 };
 struct BRANCH_FALSE_F32
@@ -591,7 +641,8 @@ struct BRANCH_FALSE_F32
     Xmm input = GetInputRegOrConstant(e, i.src1, e.xmm0);
     e.vmovd(e.eax, input);
     e.test(e.eax, e.eax);
-    e.jz(i.src2.value->GetIdString(), e.T_NEAR);
+    e.jz(GetBranchTarget(e, i), e.T_NEAR);
+    CountBranchNotTaken(e, i);
   }
 };
 struct BRANCH_FALSE_F64
@@ -601,7 +652,8 @@ struct BRANCH_FALSE_F64
     Xmm input = GetInputRegOrConstant(e, i.src1, e.xmm0);
     e.vmovq(e.rax, input);
     e.test(e.rax, e.rax);
-    e.jz(i.src2.value->GetIdString(), e.T_NEAR);
+    e.jz(GetBranchTarget(e, i), e.T_NEAR);
+    CountBranchNotTaken(e, i);
   }
 };
 EMITTER_OPCODE_TABLE(OPCODE_BRANCH_FALSE, BRANCH_FALSE_I8, BRANCH_FALSE_I16,
@@ -1904,14 +1904,14 @@ struct MEMSET_I64_I8_I64
         e.vmovdqa(e.ptr[addr], e.ymm0);
         break;
       case 128:
-        // probably should lea the address beforehand
-        e.vmovdqa(e.ptr[addr + 0 * 16], e.ymm0);
-
-        e.vmovdqa(e.ptr[addr + 2 * 16], e.ymm0);
-
-        e.vmovdqa(e.ptr[addr + 4 * 16], e.ymm0);
-
-        e.vmovdqa(e.ptr[addr + 6 * 16], e.ymm0);
+        // dcbz128, the address is 128-byte aligned, so this is within a
+        // page. Compute the address once for the four stores (rax is only
+        // used for the address).
+        e.lea(e.rax, e.ptr[addr]);
+        e.vmovdqa(e.ptr[e.rax + 0 * 32], e.ymm0);
+        e.vmovdqa(e.ptr[e.rax + 1 * 32], e.ymm0);
+        e.vmovdqa(e.ptr[e.rax + 2 * 32], e.ymm0);
+        e.vmovdqa(e.ptr[e.rax + 3 * 32], e.ymm0);
         break;
       default:
         assert_unhandled_case(i.src3.constant());
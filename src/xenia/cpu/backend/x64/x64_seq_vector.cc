@@ -880,6 +880,61 @@ static XmmConst GetShiftmaskForType(unsigned typ) {
     return XMMXOPDwordShiftMask;
   }
 }
+
+enum class VectorShiftKind { kLeft, kLogicalRight, kArithmeticRight };
+
+// AVX-512BW has per-element variable word shifts. 16-bit shifts map to them
+// directly, and 8-bit shifts can use them after widening to words in a ymm
+// register and narrowing back with vpmovwb. Returns false if unsupported so the
+// caller can fall back to its existing sequence.
+template <typename T>
+static bool TryEmitVariableShiftAVX512(X64Emitter& e, const T& i,
+                                       VectorShiftKind kind) {
+  if (!e.IsFeatureEnabled(kX64EmitAVX512Ortho | kX64EmitAVX512BW)) {
+    return false;
+  }
+  uint32_t type = i.instr->flags;
+  if (type != INT8_TYPE && type != INT16_TYPE) {
+    return false;
+  }
+  Xmm src1 = GetInputRegOrConstant(e, i.src1, e.xmm2);
+  Xmm src2 = GetInputRegOrConstant(e, i.src2, e.xmm3);
+  e.vpand(e.xmm1, src2, e.GetXmmConstPtr(GetShiftmaskForType(type)));
+  if (type == INT16_TYPE) {
+    switch (kind) {
+      case VectorShiftKind::kLeft:
+        e.vpsllvw(i.dest, src1, e.xmm1);
+        break;
+      case VectorShiftKind::kLogicalRight:
+        e.vpsrlvw(i.dest, src1, e.xmm1);
+        break;
+      case VectorShiftKind::kArithmeticRight:
+        e.vpsravw(i.dest, src1, e.xmm1);
+        break;
+    }
+    return true;
+  }
+  if (kind == VectorShiftKind::kArithmeticRight) {
+    e.vpmovsxbw(e.ymm0, src1);
+  } else {
+    e.vpmovzxbw(e.ymm0, src1);
+  }
+  e.vpmovzxbw(e.ymm1, e.xmm1);
+  switch (kind) {
+    case VectorShiftKind::kLeft:
+      e.vpsllvw(e.ymm0, e.ymm0, e.ymm1);
+      break;
+    case VectorShiftKind::kLogicalRight:
+      e.vpsrlvw(e.ymm0, e.ymm0, e.ymm1);
+      break;
+    case VectorShiftKind::kArithmeticRight:
+      e.vpsravw(e.ymm0, e.ymm0, e.ymm1);
+      break;
+  }
+  // Truncating narrow, which drops the bits shifted out of each byte.
+  e.vpmovwb(i.dest, e.ymm0);
+  return true;
+}
 struct VECTOR_SHL_V128
     : Sequence<VECTOR_SHL_V128, I<OPCODE_VECTOR_SHL, V128Op, V128Op, V128Op>> {
   static void Emit(X64Emitter& e, const EmitArgType& i) {
@@ -921,6 +976,11 @@ struct VECTOR_SHL_V128
   }
 
   static void EmitInt8(X64Emitter& e, const EmitArgType& i) {
+    // Uniform constant shifts are better served by gf2p8affineqb below.
+    if (!(i.src2.is_constant && e.IsFeatureEnabled(kX64EmitGFNI)) &&
+        TryEmitVariableShiftAVX512(e, i, VectorShiftKind::kLeft)) {
+      return;
+    }
     // TODO(benvanik): native version (with shift magic).
 
     if (e.IsFeatureEnabled(kX64EmitAVX2)) {
@@ -1063,6 +1123,10 @@ struct VECTOR_SHL_V128
       }
     }
 
+    if (TryEmitVariableShiftAVX512(e, i, VectorShiftKind::kLeft)) {
+      return;
+    }
+
     // Shift 8 words in src1 by amount specified in src2.
     Xbyak::Label emu, end;
 
@@ -1262,6 +1326,11 @@ struct VECTOR_SHR_V128
   }
 
   static void EmitInt8(X64Emitter& e, const EmitArgType& i) {
+    // Uniform constant shifts are better served by gf2p8affineqb below.
+    if (!(i.src2.is_constant && e.IsFeatureEnabled(kX64EmitGFNI)) &&
+        TryEmitVariableShiftAVX512(e, i, VectorShiftKind::kLogicalRight)) {
+      return;
+    }
     if (i.src2.is_constant && e.IsFeatureEnabled(kX64EmitGFNI)) {
       const auto& shamt = i.src2.constant();
       bool all_same = true;
@@ -1338,6 +1407,10 @@ struct VECTOR_SHR_V128
       }
     }
 
+    if (TryEmitVariableShiftAVX512(e, i, VectorShiftKind::kLogicalRight)) {
+      return;
+    }
+
     // Shift 8 words in src1 by amount specified in src2.
     Xbyak::Label emu, end;
 
@@ -1547,6 +1620,11 @@ struct VECTOR_SHA_V128
   }
 
   static void EmitInt8(X64Emitter& e, const EmitArgType& i) {
+    // Uniform constant shifts are better served by gf2p8affineqb below.
+    if (!(i.src2.is_constant && e.IsFeatureEnabled(kX64EmitGFNI)) &&
+        TryEmitVariableShiftAVX512(e, i, VectorShiftKind::kArithmeticRight)) {
+      return;
+    }
     unsigned stack_offset_src1 = StackLayout::GUEST_SCRATCH;
     unsigned stack_offset_src2 = StackLayout::GUEST_SCRATCH + 16;
     if (i.src2.is_constant) {
@@ -1637,6 +1715,10 @@ struct VECTOR_SHA_V128
       }
     }
 
+    if (TryEmitVariableShiftAVX512(e, i, VectorShiftKind::kArithmeticRight)) {
+      return;
+    }
+
     // Shift 8 words in src1 by amount specified in src2.
     Xbyak::Label emu, end;
 
@@ -115,13 +115,17 @@ class StackLayout {
    *  +------------------+
    *  | call ret addr    | rsp + 96
    *  +------------------+
+   *  | guest r1 @ entry | rsp + 104
+   *  +------------------+
+   *  | (unused)         | rsp + 112
+   *  +------------------+
    *    ... locals ...
    *  +------------------+
    *  | (return address) |
    *  +------------------+
    *
    */
-  static const size_t GUEST_STACK_SIZE = 104;
+  static const size_t GUEST_STACK_SIZE = 120;
   // was GUEST_CTX_HOME, can't remove because that'd throw stack alignment off.
   // instead, can be used as a temporary in sequences
   static const size_t GUEST_SCRATCH = 0;
@@ -131,6 +135,9 @@ class StackLayout {
   static const size_t GUEST_PROFILER_START = 80;
   static const size_t GUEST_RET_ADDR = 88;
   static const size_t GUEST_CALL_RET_ADDR = 96;
+  // only written with lazy_host_guest_stack_synchronization, lets the frame be
+  // matched against the guest stack when looking for a longjmp target
+  static const size_t GUEST_ENTRY_STACK_PTR = 104;
 };
 
 }  // namespace x64
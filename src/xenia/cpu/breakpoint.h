@@ -10,6 +10,7 @@
 #ifndef XENIA_CPU_BREAKPOINT_H_
 #define XENIA_CPU_BREAKPOINT_H_
 
+#include "xenia/cpu/breakpoint_condition.h"
 #include "xenia/cpu/processor.h"
 
 namespace xe {
@@ -56,6 +57,27 @@ class Breakpoint {
   // Whether the breakpoint is currently installed and active.
   bool is_installed() const { return installed_; }
 
+  // Guest breakpoints with a condition are evaluated in the translated code,
+  // which is translated again when they're installed and uninstalled.
+  bool has_condition() const {
+    return address_type_ == AddressType::kGuest && has_condition_;
+  }
+  const BreakpointCondition& condition() const { return condition_; }
+  // Assumes the caller holds the global lock.
+  void set_condition(const BreakpointCondition* condition) {
+    bool was_installed = installed_;
+    if (was_installed) {
+      Uninstall();
+    }
+    has_condition_ = condition != nullptr;
+    if (condition) {
+      condition_ = *condition;
+    }
+    if (was_installed) {
+      Install();
+    }
+  }
+
   std::string to_string() const;
 
   // Returns a guest function that contains the guest address, if any.
@@ -124,6 +146,9 @@ class Breakpoint {
   AddressType address_type_;
   uint64_t address_ = 0;
 
+  bool has_condition_ = false;
+  BreakpointCondition condition_;
+
   HitCallback hit_callback_;
 
   // Opaque backend data. Don't touch this.
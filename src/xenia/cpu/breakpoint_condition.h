@@ -0,0 +1,62 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2026 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#ifndef XENIA_CPU_BREAKPOINT_CONDITION_H_
+#define XENIA_CPU_BREAKPOINT_CONDITION_H_
+
+#include <cstdint>
+
+#include "xenia/base/math.h"
+#include "xenia/base/string.h"
+
+namespace xe {
+namespace cpu {
+
+// Comparison of a guest general-purpose register with a constant, evaluated by
+// the translated code at the breakpoint address, so it traps only when the
+// comparison is true.
+struct BreakpointCondition {
+  enum class Op {
+    kEQ,
+    kNE,
+    kSLT,
+    kSLE,
+    kSGT,
+    kSGE,
+    kULT,
+    kULE,
+    kUGT,
+    kUGE,
+  };
+
+  // Parses the names used by break_condition_op, returns false if unknown.
+  static bool ParseOp(const char* name, Op& op_out) {
+    static const char* const kOpNames[] = {
+        "eq", "ne", "slt", "sle", "sgt", "sge", "ult", "ule", "ugt", "uge",
+    };
+    for (size_t i = 0; i < xe::countof(kOpNames); ++i) {
+      if (!xe_strcasecmp(name, kOpNames[i])) {
+        op_out = Op(i);
+        return true;
+      }
+    }
+    return false;
+  }
+
+  uint32_t gpr = 0;
+  uint64_t value = 0;
+  Op op = Op::kEQ;
+  // Whether only the lower 32 bits of the register and the value are compared.
+  bool truncate = true;
+};
+
+}  // namespace cpu
+}  // namespace xe
+
+#endif  // XENIA_CPU_BREAKPOINT_CONDITION_H_
@@ -9,13 +9,23 @@
 
 #include "xenia/cpu/compiler/compiler.h"
 
+#include <cstring>
+#include <mutex>
+
+#include "xenia/base/clock.h"
 #include "xenia/base/profiling.h"
 #include "xenia/cpu/compiler/compiler_pass.h"
+#include "xenia/cpu/cpu_flags.h"
 
 namespace xe {
 namespace cpu {
 namespace compiler {
 
+namespace {
+std::mutex pass_stats_mutex_;
+std::vector<Compiler::PassStats> pass_stats_;
+}  // namespace
+
 Compiler::Compiler(Processor* processor) : processor_(processor) {}
 
 Compiler::~Compiler() { Reset(); }
@@ -28,19 +38,62 @@ void Compiler::AddPass(std::unique_ptr<CompilerPass> pass) {
 void Compiler::Reset() {}
 
 bool Compiler::Compile(xe::cpu::hir::HIRBuilder* builder) {
+  bool gather_stats = cvars::jit_function_stats;
   // TODO(benvanik): sophisticated stuff. Run passes in parallel, run until they
   //                 stop changing things, etc.
   for (size_t i = 0; i < passes_.size(); ++i) {
     auto& pass = passes_[i];
     scratch_arena_.Reset();
+    uint64_t start_ticks = gather_stats ? Clock::QueryHostTickCount() : 0;
     if (!pass->Run(builder)) {
+      function_pass_stats_.clear();
       return false;
     }
+    if (gather_stats) {
+      RecordPassRun(pass.get(), Clock::QueryHostTickCount() - start_ticks);
+    }
+  }
+
+  if (!function_pass_stats_.empty()) {
+    // One lock per function rather than per pass run.
+    std::lock_guard<std::mutex> lock(pass_stats_mutex_);
+    for (const PassStats& pass_stats : function_pass_stats_) {
+      AddPassStats(pass_stats_, pass_stats);
+    }
+    function_pass_stats_.clear();
   }
 
   return true;
 }
 
+std::vector<Compiler::PassStats> Compiler::GetPassStats() {
+  std::lock_guard<std::mutex> lock(pass_stats_mutex_);
+  return pass_stats_;
+}
+
+void Compiler::ResetPassStats() {
+  std::lock_guard<std::mutex> lock(pass_stats_mutex_);
+  pass_stats_.clear();
+}
+
+void Compiler::RecordPassRun(const CompilerPass* pass, uint64_t ticks) {
+  AddPassStats(function_pass_stats_, {pass->name(), 1, ticks});
+}
+
+void Compiler::AddPassStats(std::vector<PassStats>& stats,
+                            const PassStats& pass_stats) {
+  // Only a few passes, and the names are literals in their headers, but may
+  // be different copies in different modules.
+  for (PassStats& existing_stats : stats) {
+    if (!std::strcmp(existing_stats.name, pass_stats.name)) {
+      existing_stats.run_count += pass_stats.run_count;
+      existing_stats.ticks += pass_stats.ticks;
+      return;
+    }
+  }
+  stats.push_back(pass_stats);
+}
+
 }  // namespace compiler
 }  // namespace cpu
 }  // namespace xe
@@ -10,6 +10,7 @@
 #ifndef XENIA_CPU_COMPILER_COMPILER_H_
 #define XENIA_CPU_COMPILER_COMPILER_H_
 
+#include <cstdint>
 #include <memory>
 #include <vector>
 
@@ -42,11 +43,32 @@ class Compiler {
 
   bool Compile(hir::HIRBuilder* builder);
 
+  // Time spent in the passes with --jit_function_stats, summed over all the
+  // compilers. The time of a pass running other passes includes theirs.
+  struct PassStats {
+    const char* name;
+    uint64_t run_count;
+    // In Clock::QueryHostTickCount units.
+    uint64_t ticks;
+  };
+  // In the order the passes were first run.
+  static std::vector<PassStats> GetPassStats();
+  static void ResetPassStats();
+
+  // Records a run of a pass, including the ones run by other passes.
+  void RecordPassRun(const CompilerPass* pass, uint64_t ticks);
+
  private:
+  static void AddPassStats(std::vector<PassStats>& stats,
+                           const PassStats& pass_stats);
+
   Processor* processor_;
   Arena scratch_arena_;
 
   std::vector<std::unique_ptr<CompilerPass>> passes_;
+
+  // Of the function being compiled, added to the global stats at the end.
+  std::vector<PassStats> function_pass_stats_;
 };
 
 }  // namespace compiler
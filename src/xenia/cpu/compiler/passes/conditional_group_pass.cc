@@ -9,8 +9,10 @@
 
 #include "xenia/cpu/compiler/passes/conditional_group_pass.h"
 
+#include "xenia/base/clock.h"
 #include "xenia/base/profiling.h"
 #include "xenia/cpu/compiler/compiler.h"
+#include "xenia/cpu/cpu_flags.h"
 #include "xenia/cpu/ppc/ppc_context.h"
 #include "xenia/cpu/processor.h"
 
@@ -47,12 +49,14 @@ bool ConditionalGroupPass::Initialize(Compiler* compiler) {
 }
 
 bool ConditionalGroupPass::Run(HIRBuilder* builder) {
+  bool gather_stats = cvars::jit_function_stats;
   bool dirty;
   do {
     dirty = false;
     for (size_t i = 0; i < passes_.size(); ++i) {
       scratch_arena()->Reset();
       auto& pass = passes_[i];
+      uint64_t start_ticks = gather_stats ? Clock::QueryHostTickCount() : 0;
       auto subpass = dynamic_cast<ConditionalGroupSubpass*>(pass.get());
       if (!subpass) {
         if (!pass->Run(builder)) {
@@ -65,6 +69,10 @@ bool ConditionalGroupPass::Run(HIRBuilder* builder) {
         }
         dirty |= result;
       }
+      if (gather_stats) {
+        compiler_->RecordPassRun(pass.get(),
+                                 Clock::QueryHostTickCount() - start_ticks);
+      }
     }
   } while (dirty);
   return true;
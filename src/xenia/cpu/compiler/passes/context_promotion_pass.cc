@@ -26,6 +26,12 @@ DEFINE_bool(full_optimization_even_with_debug, false,
             "not intended for actual debugging of the code",
             "CPU");
 
+DEFINE_bool(extended_block_context_promotion, true,
+            "Carry promoted context values into blocks that can only be "
+            "entered by falling through a conditional branch, so they stay in "
+            "host registers instead of being reloaded from the context.",
+            "CPU");
+
 namespace xe {
 namespace cpu {
 namespace compiler {
@@ -72,10 +78,17 @@ bool ContextPromotionPass::Run(HIRBuilder* builder) {
   // instead as it may be faster (at least on the block-level).
 
   // Promote loads to values.
-  // Process each block independently, for now.
+  // Blocks are processed independently unless they can only be reached by
+  // falling through the previous one, in which case the values known at the
+  // end of that block are still valid. The decision is recorded in the block,
+  // as later passes may fold the branch ending the previous block, and the
+  // register allocator keeps such chains of blocks in registers as a unit.
   auto block = builder->first_block();
   while (block) {
-    PromoteBlock(block);
+    block->extends_previous_block =
+        cvars::extended_block_context_promotion &&
+        block->CanExtendPreviousBlock();
+    PromoteBlock(block, block->extends_previous_block);
     block = block->next;
   }
 
@@ -94,14 +107,20 @@ bool ContextPromotionPass::Run(HIRBuilder* builder) {
   return true;
 }
 
-void ContextPromotionPass::PromoteBlock(Block* block) {
+void ContextPromotionPass::PromoteBlock(Block* block, bool extend_previous) {
   auto& validity = context_validity_;
-  validity.reset();
+  if (!extend_previous) {
+    validity.reset();
+  }
 
   Instr* i = block->instr_head;
   while (i) {
     auto next = i->next;
-    if (i->opcode->flags & OPCODE_FLAG_VOLATILE) {
+    if (i->opcode == &OPCODE_BRANCH_TRUE_info ||
+        i->opcode == &OPCODE_BRANCH_FALSE_info) {
+      // Conditional branches end the block and don't touch the context, so
+      // the values stay valid for a fallthrough block that extends this one.
+    } else if (i->opcode->flags & OPCODE_FLAG_VOLATILE) {
       // Volatile instruction - requires all context values be flushed.
       validity.reset();
     } else if (i->opcode == &OPCODE_LOAD_CONTEXT_info) {
@@ -38,10 +38,11 @@ class ContextPromotionPass : public CompilerPass {
 
   bool Initialize(Compiler* compiler) override;
 
+  const char* name() const override { return "ContextPromotionPass"; }
   bool Run(hir::HIRBuilder* builder) override;
 
  private:
-  void PromoteBlock(hir::Block* block);
+  void PromoteBlock(hir::Block* block, bool extend_previous);
   void RemoveDeadStoresBlock(hir::Block* block);
 
  private:
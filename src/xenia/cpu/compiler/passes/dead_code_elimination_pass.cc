@@ -168,7 +168,6 @@ void DeadCodeEliminationPass::MakeNopRecursive(Instr* i) {
       }                                                  \
       HIRBuilder::GetCurrent()->DeallocateValue(value);  \
     }                                                    \
-    HIRBuilder::GetCurrent()->DeallocateUse(use);        \
   }
   MAKE_NOP_SRC(1);
   MAKE_NOP_SRC(2);
@@ -179,9 +178,10 @@ void DeadCodeEliminationPass::ReplaceAssignment(Instr* i) {
   auto src = i->src1.value;
   auto dest = i->dest;
 
-  auto use = dest->use_head;
-  while (use) {
-    auto use_instr = use->instr;
+  // The use list entries are reused for the uses of src as they're replaced,
+  // so take the first one until none is left.
+  while (dest->use_head) {
+    auto use_instr = dest->use_head->instr;
     if (use_instr->src1.value == dest) {
       use_instr->set_src1(src);
     }
@@ -191,7 +191,6 @@ void DeadCodeEliminationPass::ReplaceAssignment(Instr* i) {
     if (use_instr->src3.value == dest) {
       use_instr->set_src3(src);
     }
-    use = use->next;
   }
 
   i->UnlinkAndNOP();
@@ -0,0 +1,169 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2022 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/cpu/compiler/passes/dead_flag_elimination_pass.h"
+
+#include <cstddef>
+
+#include "xenia/base/cvar.h"
+#include "xenia/base/math.h"
+#include "xenia/base/profiling.h"
+#include "xenia/cpu/hir/hir_builder.h"
+#include "xenia/cpu/ppc/ppc_context.h"
+
+DECLARE_bool(debug);
+DECLARE_bool(store_all_context_values);
+DECLARE_bool(full_optimization_even_with_debug);
+
+namespace xe {
+namespace cpu {
+namespace compiler {
+namespace passes {
+
+// TODO(benvanik): remove when enums redefined.
+using namespace xe::cpu::hir;
+
+using xe::cpu::hir::Block;
+using xe::cpu::hir::HIRBuilder;
+using xe::cpu::hir::Instr;
+
+static_assert(offsetof(ppc::PPCContext, xer_ov) ==
+                      offsetof(ppc::PPCContext, xer_ca) + 1 &&
+                  offsetof(ppc::PPCContext, xer_so) ==
+                      offsetof(ppc::PPCContext, xer_ca) + 2,
+              "XER bits are expected to be contiguous");
+
+DeadFlagEliminationPass::DeadFlagEliminationPass() : CompilerPass() {}
+
+DeadFlagEliminationPass::~DeadFlagEliminationPass() = default;
+
+bool DeadFlagEliminationPass::Run(HIRBuilder* builder) {
+  // Dot-form instructions update CR0 and carrying ones XER[CA], but the flags
+  // are usually overwritten by the next such instruction before anything
+  // looks at them:
+  //   block0:
+  //     v3 = compare_slt v2, 0
+  //     store_context +cr0_lt, v3   <-- dead, block1 overwrites before reading
+  //     ...
+  //     branch_true v9, block1
+  //   block1:
+  //     v10 = compare_slt v8, 0
+  //     store_context +cr0_lt, v10
+  // Liveness of each flag byte is computed backwards over the whole function
+  // until it settles. Anything leaving the function (calls, returns) or
+  // volatile makes all flags live, as the other side may read them.
+  // Like the dead store removal in ContextPromotionPass, this loses the
+  // values the debugger would show.
+  if (!cvars::full_optimization_even_with_debug &&
+      (cvars::debug || cvars::store_all_context_values)) {
+    return true;
+  }
+
+  uint16_t block_count = 0;
+  for (auto block = builder->first_block(); block; block = block->next) {
+    block->ordinal = block_count++;
+  }
+  live_in_.assign(block_count, 0);
+
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (auto block = builder->last_block(); block; block = block->prev) {
+      FlagMask live = GetFallthroughLiveOut(block);
+      for (auto i = block->instr_tail; i; i = i->prev) {
+        live = Transfer(i, live, false);
+      }
+      if (live != live_in_[block->ordinal]) {
+        // Liveness only grows, so this terminates.
+        live_in_[block->ordinal] = live;
+        changed = true;
+      }
+    }
+  }
+
+  for (auto block = builder->first_block(); block; block = block->next) {
+    FlagMask live = GetFallthroughLiveOut(block);
+    Instr* i = block->instr_tail;
+    while (i) {
+      Instr* prev = i->prev;
+      live = Transfer(i, live, true);
+      i = prev;
+    }
+  }
+  return true;
+}
+
+DeadFlagEliminationPass::FlagMask DeadFlagEliminationPass::GetFlagMask(
+    size_t offset, size_t size) {
+  constexpr size_t kCRBegin = offsetof(ppc::PPCContext, cr0);
+  constexpr size_t kCREnd = kCRBegin + 8 * 4;
+  constexpr size_t kXERBegin = offsetof(ppc::PPCContext, xer_ca);
+  constexpr size_t kXEREnd = kXERBegin + 3;
+  FlagMask mask = 0;
+  for (size_t n = offset; n < offset + size; ++n) {
+    if (n >= kCRBegin && n < kCREnd) {
+      mask |= FlagMask(1) << (n - kCRBegin);
+    } else if (n >= kXERBegin && n < kXEREnd) {
+      mask |= FlagMask(1) << (32 + n - kXERBegin);
+    }
+  }
+  return mask;
+}
+
+DeadFlagEliminationPass::FlagMask DeadFlagEliminationPass::Transfer(
+    Instr* i, FlagMask live_after, bool remove_dead_stores) const {
+  if (i->opcode == &OPCODE_BRANCH_info) {
+    return live_in_[i->src1.label->block->ordinal];
+  }
+  if (i->opcode == &OPCODE_BRANCH_TRUE_info ||
+      i->opcode == &OPCODE_BRANCH_FALSE_info) {
+    return live_after | live_in_[i->src2.label->block->ordinal];
+  }
+  if ((i->opcode->flags & (OPCODE_FLAG_BRANCH | OPCODE_FLAG_VOLATILE)) ||
+      i->opcode == &OPCODE_CONTEXT_BARRIER_info) {
+    return kAllFlags;
+  }
+  if (i->opcode == &OPCODE_LOAD_CONTEXT_info) {
+    return live_after |
+           GetFlagMask(i->src1.offset, GetTypeSize(i->dest->type));
+  }
+  if (i->opcode == &OPCODE_STORE_CONTEXT_info) {
+    size_t size = GetTypeSize(i->src2.value->type);
+    FlagMask mask = GetFlagMask(i->src1.offset, size);
+    if (!mask) {
+      return live_after;
+    }
+    // Stores also touching something other than flags have to stay.
+    if (remove_dead_stores && !(live_after & mask) &&
+        xe::bit_count(mask) == size) {
+      i->UnlinkAndNOP();
+    }
+    return live_after & ~mask;
+  }
+  return live_after;
+}
+
+DeadFlagEliminationPass::FlagMask
+DeadFlagEliminationPass::GetFallthroughLiveOut(const Block* block) const {
+  auto tail = block->instr_tail;
+  if (tail && (tail->opcode == &OPCODE_BRANCH_info ||
+               tail->opcode == &OPCODE_RETURN_info)) {
+    // Never falls through, the branch itself provides the liveness.
+    return 0;
+  }
+  if (!block->next) {
+    return kAllFlags;
+  }
+  return live_in_[block->next->ordinal];
+}
+
+}  // namespace passes
+}  // namespace compiler
+}  // namespace cpu
+}  // namespace xe
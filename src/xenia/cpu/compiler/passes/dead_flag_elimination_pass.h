@@ -0,0 +1,58 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2022 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#ifndef XENIA_CPU_COMPILER_PASSES_DEAD_FLAG_ELIMINATION_PASS_H_
+#define XENIA_CPU_COMPILER_PASSES_DEAD_FLAG_ELIMINATION_PASS_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "xenia/cpu/compiler/compiler_pass.h"
+
+namespace xe {
+namespace cpu {
+namespace compiler {
+namespace passes {
+
+// Removes stores to the CR fields and XER CA/OV/SO that are overwritten on
+// every path before being read, like the CR0 update of a dot-form instruction
+// followed by another one. Unlike the block-local dead store removal in
+// ContextPromotionPass this follows branches across the function. The
+// computations feeding the removed stores are left for DeadCodeElimination.
+class DeadFlagEliminationPass : public CompilerPass {
+ public:
+  DeadFlagEliminationPass();
+  ~DeadFlagEliminationPass() override;
+
+  const char* name() const override { return "DeadFlagEliminationPass"; }
+  bool Run(hir::HIRBuilder* builder) override;
+
+ private:
+  // One bit per CR byte (cr0_lt is bit 0), then xer_ca, xer_ov and xer_so.
+  using FlagMask = uint64_t;
+  static constexpr FlagMask kAllFlags = (FlagMask(1) << 35) - 1;
+
+  static FlagMask GetFlagMask(size_t offset, size_t size);
+  // Flags live before the instruction given the ones live after it. If
+  // remove_dead_stores is set, stores only writing dead flags are removed.
+  FlagMask Transfer(hir::Instr* i, FlagMask live_after,
+                    bool remove_dead_stores) const;
+  // Flags live when running off the end of the block.
+  FlagMask GetFallthroughLiveOut(const hir::Block* block) const;
+
+  // By block ordinal.
+  std::vector<FlagMask> live_in_;
+};
+
+}  // namespace passes
+}  // namespace compiler
+}  // namespace cpu
+}  // namespace xe
+
+#endif  // XENIA_CPU_COMPILER_PASSES_DEAD_FLAG_ELIMINATION_PASS_H_
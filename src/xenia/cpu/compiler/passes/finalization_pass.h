@@ -22,6 +22,7 @@ class FinalizationPass : public CompilerPass {
   FinalizationPass();
   ~FinalizationPass() override;
 
+  const char* name() const override { return "FinalizationPass"; }
   bool Run(hir::HIRBuilder* builder) override;
 
  private:
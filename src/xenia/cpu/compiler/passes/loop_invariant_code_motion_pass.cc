@@ -0,0 +1,308 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2022 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/cpu/compiler/passes/loop_invariant_code_motion_pass.h"
+
+#include "xenia/base/profiling.h"
+#include "xenia/cpu/hir/hir_builder.h"
+#include "xenia/cpu/ppc/ppc_context.h"
+
+namespace xe {
+namespace cpu {
+namespace compiler {
+namespace passes {
+
+// TODO(benvanik): remove when enums redefined.
+using namespace xe::cpu::hir;
+
+using xe::cpu::hir::Block;
+using xe::cpu::hir::Edge;
+using xe::cpu::hir::HIRBuilder;
+using xe::cpu::hir::Instr;
+using xe::cpu::hir::Value;
+
+LoopInvariantCodeMotionPass::LoopInvariantCodeMotionPass() : CompilerPass() {}
+
+LoopInvariantCodeMotionPass::~LoopInvariantCodeMotionPass() = default;
+
+bool LoopInvariantCodeMotionPass::Run(HIRBuilder* builder) {
+  // Tight guest loops are usually a single block that branches back to its
+  // own label:
+  //   block0:
+  //     ...
+  //   loop:
+  //     v0 = load_context +r4    <-- never stored in the loop
+  //     v1 = add v0, 0x10
+  //     v2 = shl v1, 2           <-- recomputed every iteration
+  //     v3 = load_context +r3
+  //     v4 = add v3, v2
+  //     ...
+  //     branch_true v9, loop
+  // Invariant instructions are moved to the end of the block that falls into
+  // the loop. Values can't be held in registers across the loop label, so the
+  // results still used in the loop are passed through locals; this only pays
+  // off when more instructions are hoisted than locals are reloaded.
+  auto block = builder->first_block();
+  while (block) {
+    if (IsSimpleLoop(block)) {
+      HoistInvariants(builder, block);
+    }
+    block = block->next;
+  }
+  return true;
+}
+
+bool LoopInvariantCodeMotionPass::IsSimpleLoop(Block* block) {
+  // Must branch to itself and only be entered from the preceding block.
+  auto preheader = block->prev;
+  if (!preheader || !preheader->instr_tail || !block->label_head) {
+    return false;
+  }
+  bool has_back_edge = false;
+  auto edge = block->incoming_edge_head;
+  while (edge) {
+    if (edge->src == block) {
+      has_back_edge = true;
+    } else if (edge->src != preheader) {
+      return false;
+    }
+    edge = edge->incoming_next;
+  }
+  if (!has_back_edge) {
+    return false;
+  }
+
+  // The preheader has to reach the loop without anything in between that could
+  // change the context, such as a call.
+  auto tail = preheader->instr_tail;
+  if (tail->opcode == &OPCODE_BRANCH_info) {
+    return tail->src1.label->block == block;
+  }
+  if (tail->opcode == &OPCODE_BRANCH_TRUE_info ||
+      tail->opcode == &OPCODE_BRANCH_FALSE_info) {
+    return true;
+  }
+  return !(tail->opcode->flags & (OPCODE_FLAG_BRANCH | OPCODE_FLAG_VOLATILE));
+}
+
+bool LoopInvariantCodeMotionPass::IsHoistableOpcode(const Instr* i) {
+  // Pure operations that can't fault, so executing them speculatively in the
+  // preheader is safe even if the loop is skipped.
+  switch (i->GetOpcodeNum()) {
+    case OPCODE_ASSIGN:
+    case OPCODE_CAST:
+    case OPCODE_ZERO_EXTEND:
+    case OPCODE_SIGN_EXTEND:
+    case OPCODE_TRUNCATE:
+    case OPCODE_LOAD_VECTOR_SHL:
+    case OPCODE_LOAD_VECTOR_SHR:
+    case OPCODE_LOAD_CONTEXT:
+    case OPCODE_SELECT:
+    case OPCODE_COMPARE_EQ:
+    case OPCODE_COMPARE_NE:
+    case OPCODE_COMPARE_SLT:
+    case OPCODE_COMPARE_SLE:
+    case OPCODE_COMPARE_SGT:
+    case OPCODE_COMPARE_SGE:
+    case OPCODE_COMPARE_ULT:
+    case OPCODE_COMPARE_ULE:
+    case OPCODE_COMPARE_UGT:
+    case OPCODE_COMPARE_UGE:
+    case OPCODE_ADD:
+    case OPCODE_SUB:
+    case OPCODE_MUL:
+    case OPCODE_NEG:
+    case OPCODE_AND:
+    case OPCODE_AND_NOT:
+    case OPCODE_OR:
+    case OPCODE_XOR:
+    case OPCODE_NOT:
+    case OPCODE_SHL:
+    case OPCODE_SHR:
+    case OPCODE_SHA:
+    case OPCODE_ROTATE_LEFT:
+    case OPCODE_BYTE_SWAP:
+    case OPCODE_CNTLZ:
+    case OPCODE_INSERT:
+    case OPCODE_EXTRACT:
+    case OPCODE_SPLAT:
+    case OPCODE_PERMUTE:
+    case OPCODE_SWIZZLE:
+      break;
+    default:
+      return false;
+  }
+  // Integer only - float results depend on the rounding mode, which the
+  // preheader may not share with the loop.
+  if (i->dest->type == FLOAT32_TYPE || i->dest->type == FLOAT64_TYPE) {
+    return false;
+  }
+  // Don't split up paired instructions (like add + did_saturate).
+  if (i->next && i->next->opcode->flags & OPCODE_FLAG_PAIRED_PREV) {
+    return false;
+  }
+  return true;
+}
+
+void LoopInvariantCodeMotionPass::HoistInvariants(HIRBuilder* builder,
+                                                  Block* block) {
+  // Gather the context stores in the loop. Anything volatile besides the
+  // looping branch gives up, as it may touch the context or guest state in
+  // ways we can't see.
+  stored_context_.assign(sizeof(ppc::PPCContext), false);
+  for (auto i = block->instr_head; i; i = i->next) {
+    if (i->opcode->flags & OPCODE_FLAG_BRANCH) {
+      if (i->opcode != &OPCODE_BRANCH_info &&
+          i->opcode != &OPCODE_BRANCH_TRUE_info &&
+          i->opcode != &OPCODE_BRANCH_FALSE_info) {
+        return;
+      }
+    } else if (i->opcode->flags & OPCODE_FLAG_VOLATILE) {
+      return;
+    } else if (i->opcode == &OPCODE_STORE_CONTEXT_info) {
+      size_t offset = i->src1.offset;
+      size_t size = GetTypeSize(i->src2.value->type);
+      for (size_t n = offset; n < offset + size && n < stored_context_.size();
+           ++n) {
+        stored_context_[n] = true;
+      }
+    }
+  }
+
+  // Find invariant instructions in order. Sources must be constants or the
+  // results of instructions already found to be invariant.
+  invariant_values_.assign(builder->max_value_ordinal() + 1, false);
+  auto is_invariant_source = [this](Value* value) {
+    return value->IsConstant() || (value->ordinal < invariant_values_.size() &&
+                                   invariant_values_[value->ordinal]);
+  };
+  // A label-less block after the loop extends it (see
+  // Block::extends_previous_block) and may use the loop's values directly.
+  // Those uses are past the looping branch and can't be redirected to a local
+  // loaded in the loop, so such values stay where they are.
+  auto is_used_outside_loop = [block](Value* value) {
+    for (auto use = value->use_head; use; use = use->next) {
+      if (use->instr->block != block) {
+        return true;
+      }
+    }
+    return false;
+  };
+  std::vector<Instr*> invariants;
+  for (auto i = block->instr_head; i; i = i->next) {
+    if (!i->dest || !IsHoistableOpcode(i) || is_used_outside_loop(i->dest)) {
+      continue;
+    }
+    if (i->opcode == &OPCODE_LOAD_CONTEXT_info) {
+      size_t offset = i->src1.offset;
+      size_t size = GetTypeSize(i->dest->type);
+      bool stored = false;
+      for (size_t n = offset; n < offset + size && n < stored_context_.size();
+           ++n) {
+        stored |= stored_context_[n];
+      }
+      if (stored) {
+        continue;
+      }
+    } else {
+      uint32_t signature = i->opcode->signature;
+      if ((GET_OPCODE_SIG_TYPE_SRC1(signature) == OPCODE_SIG_TYPE_V &&
+           !is_invariant_source(i->src1.value)) ||
+          (GET_OPCODE_SIG_TYPE_SRC2(signature) == OPCODE_SIG_TYPE_V &&
+           !is_invariant_source(i->src2.value)) ||
+          (GET_OPCODE_SIG_TYPE_SRC3(signature) == OPCODE_SIG_TYPE_V &&
+           !is_invariant_source(i->src3.value))) {
+        continue;
+      }
+    }
+    invariant_values_[i->dest->ordinal] = true;
+    invariants.push_back(i);
+  }
+  if (invariants.empty()) {
+    return;
+  }
+
+  // Results that are still used by the rest of the loop need a local each.
+  std::vector<Value*> live_out;
+  for (auto i : invariants) {
+    auto use = i->dest->use_head;
+    while (use) {
+      auto use_instr = use->instr;
+      bool use_is_hoisted = use_instr->dest &&
+                            use_instr->dest->ordinal <
+                                invariant_values_.size() &&
+                            invariant_values_[use_instr->dest->ordinal];
+      if (use_instr->block == block && !use_is_hoisted) {
+        live_out.push_back(i->dest);
+        break;
+      }
+      use = use->next;
+    }
+  }
+  if (invariants.size() <= live_out.size()) {
+    // Reloading a local costs as much as what we would save.
+    return;
+  }
+
+  // Move everything before the branches that end the preheader, keeping the
+  // original order so dependencies stay intact.
+  auto insert_point = block->prev->instr_tail;
+  while (insert_point->prev &&
+         insert_point->prev->opcode->flags & OPCODE_FLAG_BRANCH) {
+    insert_point = insert_point->prev;
+  }
+  if (!(insert_point->opcode->flags & OPCODE_FLAG_BRANCH)) {
+    insert_point = nullptr;
+  }
+  auto move_to_preheader = [&](Instr* i) {
+    if (insert_point) {
+      i->MoveBefore(insert_point);
+    } else {
+      // The preheader falls through, so append to its end. There's no move
+      // after, so move before the tail and then swap the tail back in front.
+      auto preheader_tail = block->prev->instr_tail;
+      i->MoveBefore(preheader_tail);
+      preheader_tail->MoveBefore(i);
+    }
+  };
+  for (auto i : invariants) {
+    move_to_preheader(i);
+  }
+
+  // Route the live results through locals.
+  for (auto value : live_out) {
+    auto slot = builder->AllocLocal(value->type);
+    builder->StoreLocal(slot, value);
+    move_to_preheader(builder->last_instr());
+
+    auto local_value = builder->LoadLocal(slot);
+    builder->last_instr()->MoveBefore(block->instr_head);
+
+    for (auto i = block->instr_head->next; i; i = i->next) {
+      uint32_t signature = i->opcode->signature;
+      if (GET_OPCODE_SIG_TYPE_SRC1(signature) == OPCODE_SIG_TYPE_V &&
+          i->src1.value == value) {
+        i->set_src1(local_value);
+      }
+      if (GET_OPCODE_SIG_TYPE_SRC2(signature) == OPCODE_SIG_TYPE_V &&
+          i->src2.value == value) {
+        i->set_src2(local_value);
+      }
+      if (GET_OPCODE_SIG_TYPE_SRC3(signature) == OPCODE_SIG_TYPE_V &&
+          i->src3.value == value) {
+        i->set_src3(local_value);
+      }
+    }
+  }
+}
+
+}  // namespace passes
+}  // namespace compiler
+}  // namespace cpu
+}  // namespace xe
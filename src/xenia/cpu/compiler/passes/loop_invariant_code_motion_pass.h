@@ -0,0 +1,49 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2022 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#ifndef XENIA_CPU_COMPILER_PASSES_LOOP_INVARIANT_CODE_MOTION_PASS_H_
+#define XENIA_CPU_COMPILER_PASSES_LOOP_INVARIANT_CODE_MOTION_PASS_H_
+
+#include <vector>
+
+#include "xenia/cpu/compiler/compiler_pass.h"
+
+namespace xe {
+namespace cpu {
+namespace compiler {
+namespace passes {
+
+// Hoists invariant computations out of single-block loops into the block that
+// falls into the loop. Requires up to date edges from ControlFlowAnalysisPass.
+class LoopInvariantCodeMotionPass : public CompilerPass {
+ public:
+  LoopInvariantCodeMotionPass();
+  ~LoopInvariantCodeMotionPass() override;
+
+  const char* name() const override { return "LoopInvariantCodeMotionPass"; }
+  bool Run(hir::HIRBuilder* builder) override;
+
+ private:
+  bool IsSimpleLoop(hir::Block* block);
+  bool IsHoistableOpcode(const hir::Instr* i);
+  void HoistInvariants(hir::HIRBuilder* builder, hir::Block* block);
+
+  // Indexed by value ordinal, set if the value is invariant in the loop being
+  // processed.
+  std::vector<bool> invariant_values_;
+  // Indexed by context byte offset, set if the loop stores to it.
+  std::vector<bool> stored_context_;
+};
+
+}  // namespace passes
+}  // namespace compiler
+}  // namespace cpu
+}  // namespace xe
+
+#endif  // XENIA_CPU_COMPILER_PASSES_LOOP_INVARIANT_CODE_MOTION_PASS_H_
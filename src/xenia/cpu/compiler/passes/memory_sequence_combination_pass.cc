@@ -68,35 +68,70 @@ void MemorySequenceCombinationPass::CombineLoadSequence(Instr* i) {
     return;
   }
 
-  // Ensure all uses of the load result are BYTE_SWAP - if it's mixed we
-  // shouldn't transform as we'd have to introduce new swaps!
+  // Ensure all uses of the load result are BYTE_SWAP or stores of the value -
+  // if it's mixed with anything else we shouldn't transform as we'd have to
+  // introduce new swaps! Stores can absorb the swap themselves:
+  //   v1.i32 = load v0
+  //   v2.i32 = byte_swap v1.i32
+  //   store v3, v1.i32
+  // becomes:
+  //   v1.i32 = load v0, [swap]
+  //   v2.i32 = assign v1.i32
+  //   store v3, v1.i32, [swap]
+  bool any_swap = false;
   auto use = i->dest->use_head;
   while (use) {
-    if (use->instr->opcode != &OPCODE_BYTE_SWAP_info) {
+    if (use->instr->opcode == &OPCODE_BYTE_SWAP_info) {
+      any_swap = true;
+    } else if (!IsStoreOfValue(use->instr, i->dest)) {
       // Not a swap.
       return;
     }
-    // TODO(benvanik): allow uses by STORE (we can make that swap).
     use = use->next;
   }
+  if (!any_swap) {
+    // Only stores - flipping everything wouldn't remove anything.
+    return;
+  }
 
   // Merge byte swap into load.
   // Note that we may have already been a swapped operation - this inverts that.
   i->flags ^= LoadStoreFlags::LOAD_STORE_BYTE_SWAP;
 
   // Replace use of byte swap value with loaded value.
-  // It's byte_swap vN -> assign vN, so not much to do.
+  // It's byte_swap vN -> assign vN, so not much to do. Stores now get the
+  // swapped value and have to swap it back.
   use = i->dest->use_head;
   while (use) {
     auto next_use = use->next;
-    use->instr->opcode = &OPCODE_ASSIGN_info;
-    use->instr->flags = 0;
+    if (use->instr->opcode == &OPCODE_BYTE_SWAP_info) {
+      use->instr->opcode = &OPCODE_ASSIGN_info;
+      use->instr->flags = 0;
+    } else {
+      use->instr->flags ^= LoadStoreFlags::LOAD_STORE_BYTE_SWAP;
+    }
     use = next_use;
   }
 
   // TODO(benvanik): merge in extend/truncate.
 }
 
+bool MemorySequenceCombinationPass::IsStoreOfValue(const Instr* i,
+                                                   const Value* value) {
+  // Swapped stores are only implemented for the integer types.
+  if (value->type < INT16_TYPE || value->type > INT64_TYPE) {
+    return false;
+  }
+  // Only the stored value may be the load result, not the address.
+  if (i->opcode == &OPCODE_STORE_info) {
+    return i->src2.value == value && i->src1.value != value;
+  } else if (i->opcode == &OPCODE_STORE_OFFSET_info) {
+    return i->src3.value == value && i->src1.value != value &&
+           i->src2.value != value;
+  }
+  return false;
+}
+
 void MemorySequenceCombinationPass::CombineStoreSequence(Instr* i) {
   // Store with swap:
   //   v1.i32 = ...
@@ -22,12 +22,14 @@ class MemorySequenceCombinationPass : public CompilerPass {
   MemorySequenceCombinationPass();
   ~MemorySequenceCombinationPass() override;
 
+  const char* name() const override { return "MemorySequenceCombinationPass"; }
   bool Run(hir::HIRBuilder* builder) override;
 
  private:
   void CombineMemorySequences(hir::HIRBuilder* builder);
   void CombineLoadSequence(hir::Instr* i);
   void CombineStoreSequence(hir::Instr* i);
+  static bool IsStoreOfValue(const hir::Instr* i, const hir::Value* value);
 };
 
 }  // namespace passes
@@ -71,32 +71,40 @@ RegisterAllocationPass::~RegisterAllocationPass() {
 }
 
 bool RegisterAllocationPass::Run(HIRBuilder* builder) {
-  // Simple per-block allocator that operates on SSA form.
-  // Registers do not move across blocks, though this could be
-  // optimized with some intra-block analysis (dominators/etc).
+  // Simple allocator that operates on SSA form.
+  // Registers do not move across blocks, except into blocks that can only be
+  // entered by falling through the previous block (see
+  // Block::extends_previous_block) - such chains are allocated as if they were
+  // a single block, which lets context promotion keep guest registers live
+  // across not-taken conditional branches.
   // Really, it'd just be nice to have someone who knew what they
   // were doing lower SSA and do this right.
 
+  // Renumber all instructions up front. This is required so that we can sort
+  // the usage pointers below, including uses in later blocks of a chain.
   uint16_t block_ordinal = 0;
   uint32_t instr_ordinal = 0;
   auto block = builder->first_block();
   while (block) {
     // Sequential block ordinals.
     block->ordinal = block_ordinal++;
-
-    // Reset all state.
-    PrepareBlockState();
-
-    // Renumber all instructions in the block. This is required so that
-    // we can sort the usage pointers below.
     auto instr = block->instr_head;
     while (instr) {
       // Sequential global instruction ordinals.
       instr->ordinal = instr_ordinal++;
       instr = instr->next;
     }
+    block = block->next;
+  }
 
-    instr = block->instr_head;
+  block = builder->first_block();
+  while (block) {
+    // Reset all state, unless registers carry over from the previous block.
+    if (!block->extends_previous_block) {
+      PrepareBlockState();
+    }
+
+    auto instr = block->instr_head;
     while (instr) {
       const auto info = instr->opcode;
       uint32_t signature = info->signature;
@@ -247,8 +255,7 @@ void RegisterAllocationPass::AdvanceUses(Instr* instr) {
         // Remove the iterator.
         auto value = upcoming_use.value;
         upcoming_uses.erase(upcoming_uses.begin() + j);
-        assert_true(next_use->instr->block == instr->block);
-        assert_true(value->def->block == instr->block);
+        assert_true(next_use->instr->ordinal >= instr->ordinal);
         upcoming_uses.emplace_back(value, next_use);
         // i remains the same.
         continue;
@@ -350,8 +357,6 @@ bool RegisterAllocationPass::SpillOneRegister(HIRBuilder* builder, Block* block,
   auto furthest_usage =
       std::max_element(usage_set->upcoming_uses.begin(),
                        usage_set->upcoming_uses.end(), &RegisterUsage::Compare);
-  assert_true(furthest_usage->value->def->block == block);
-  assert_true(furthest_usage->use->instr->block == block);
   auto spill_value = furthest_usage->value;
   Value::Use* prev_use = furthest_usage->use->prev;
   Value::Use* next_use = furthest_usage->use;
@@ -440,6 +445,11 @@ bool RegisterAllocationPass::SpillOneRegister(HIRBuilder* builder, Block* block,
   while (walk_use) {
     auto next_walk_use = walk_use->next;
     auto instr = walk_use->instr;
+    // All the uses by the instruction are renamed at once, and their entries
+    // are moved to the use list of the new value.
+    while (next_walk_use && next_walk_use->instr == instr) {
+      next_walk_use = next_walk_use->next;
+    }
 
     uint32_t signature = instr->opcode->signature;
     if (GET_OPCODE_SIG_TYPE_SRC1(signature) == OPCODE_SIG_TYPE_V) {
@@ -0,0 +1,174 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2022 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/cpu/compiler/passes/trace_formation_pass.h"
+
+#include "xenia/base/profiling.h"
+#include "xenia/cpu/hir/hir_builder.h"
+
+namespace xe {
+namespace cpu {
+namespace compiler {
+namespace passes {
+
+// TODO(benvanik): remove when enums redefined.
+using namespace xe::cpu::hir;
+
+using xe::cpu::hir::Block;
+using xe::cpu::hir::HIRBuilder;
+using xe::cpu::hir::Instr;
+using xe::cpu::hir::Value;
+
+TraceFormationPass::TraceFormationPass() : CompilerPass() {}
+
+TraceFormationPass::~TraceFormationPass() = default;
+
+bool TraceFormationPass::Run(HIRBuilder* builder) {
+  // Two shapes are handled, both for forward branches:
+  //
+  // Taken is hot - the skipped block is cold:
+  //   B: branch_true v0, T        B: branch_false v0, C
+  //   C: ...                -->   T: ...
+  //   T: ...                      ...
+  //                               C: ...
+  //                                  branch T
+  //
+  // Taken is cold - the target block is cold:
+  //   B: branch_true v0, T        B: branch_true v0, T
+  //   C: ...                      C: ...
+  //      branch X           -->      branch X
+  //   T: ...                      ...
+  //   D: ...                      D: ...
+  //                               T: ...
+  //                                  branch D
+  first_moved_block_ = nullptr;
+  auto block = builder->first_block();
+  while (block && block != first_moved_block_) {
+    auto tail = block->instr_tail;
+    if (!tail || (tail->opcode != &OPCODE_BRANCH_TRUE_info &&
+                  tail->opcode != &OPCODE_BRANCH_FALSE_info)) {
+      block = block->next;
+      continue;
+    }
+    auto fallthrough = block->next;
+    auto target = tail->src2.label->block;
+    if (!fallthrough || fallthrough == target ||
+        fallthrough == first_moved_block_) {
+      block = block->next;
+      continue;
+    }
+
+    if (tail->flags & BRANCH_LIKELY) {
+      // Values may be carried into blocks that can only be entered by falling
+      // through (see Block::extends_previous_block), which would break apart.
+      if (fallthrough->next == target && UsesOnlyOwnValues(fallthrough)) {
+        // The inverted branch replaces the entry from the previous block.
+        MoveToEnd(builder, fallthrough, false);
+        if (!fallthrough->label_head) {
+          builder->MarkLabel(builder->NewLabel(), fallthrough);
+        }
+        tail->opcode = tail->opcode == &OPCODE_BRANCH_TRUE_info
+                           ? &OPCODE_BRANCH_FALSE_info
+                           : &OPCODE_BRANCH_TRUE_info;
+        tail->src2.label = fallthrough->label_head;
+        tail->flags = (tail->flags & ~BRANCH_LIKELY) | BRANCH_UNLIKELY;
+      }
+    } else if (tail->flags & BRANCH_UNLIKELY) {
+      // Only move forward targets, so loop heads stay where they are.
+      bool is_forward = false;
+      for (auto scan = fallthrough->next; scan && scan != first_moved_block_;
+           scan = scan->next) {
+        if (scan == target) {
+          is_forward = true;
+          break;
+        }
+      }
+      if (is_forward && target != builder->last_block() &&
+          UsesOnlyOwnValues(target)) {
+        MoveToEnd(builder, target, true);
+      }
+    }
+    block = block->next;
+  }
+  return true;
+}
+
+bool TraceFormationPass::FallsThrough(const Block* block) {
+  auto tail = block->instr_tail;
+  if (!tail) {
+    return true;
+  }
+  if (tail->opcode == &OPCODE_BRANCH_info ||
+      tail->opcode == &OPCODE_RETURN_info) {
+    return false;
+  }
+  if (tail->opcode == &OPCODE_CALL_info ||
+      tail->opcode == &OPCODE_CALL_INDIRECT_info) {
+    return !(tail->flags & CALL_TAIL);
+  }
+  return true;
+}
+
+bool TraceFormationPass::UsesOnlyOwnValues(const Block* block) {
+  auto uses_outside_value = [block](const Value* value) {
+    return value && !value->IsConstant() && value->def &&
+           value->def->block != block;
+  };
+  for (auto i = block->instr_head; i; i = i->next) {
+    uint32_t signature = i->opcode->signature;
+    if ((GET_OPCODE_SIG_TYPE_SRC1(signature) == OPCODE_SIG_TYPE_V &&
+         uses_outside_value(i->src1.value)) ||
+        (GET_OPCODE_SIG_TYPE_SRC2(signature) == OPCODE_SIG_TYPE_V &&
+         uses_outside_value(i->src2.value)) ||
+        (GET_OPCODE_SIG_TYPE_SRC3(signature) == OPCODE_SIG_TYPE_V &&
+         uses_outside_value(i->src3.value))) {
+      return false;
+    }
+  }
+  // Nor may the following block depend on this one.
+  return !block->next || !block->next->extends_previous_block;
+}
+
+void TraceFormationPass::AppendBranch(HIRBuilder* builder, Block* block,
+                                      Block* target) {
+  auto previous = builder->SetInsertionBlock(block);
+  if (target) {
+    builder->Branch(target);
+  } else {
+    builder->Return();
+  }
+  builder->SetInsertionBlock(previous);
+}
+
+void TraceFormationPass::MoveToEnd(HIRBuilder* builder, Block* block,
+                                   bool link_previous) {
+  if (!first_moved_block_) {
+    // The original last block may have fallen off the end of the function.
+    auto last_block = builder->last_block();
+    if (last_block != block && FallsThrough(last_block)) {
+      AppendBranch(builder, last_block, nullptr);
+    }
+    first_moved_block_ = block;
+  }
+  // Make the entry and exit of the block explicit.
+  if (link_previous && block->prev && FallsThrough(block->prev)) {
+    AppendBranch(builder, block->prev, block);
+  }
+  if (FallsThrough(block)) {
+    AppendBranch(builder, block, block->next);
+  }
+  builder->MoveBlockToEnd(block);
+  // Only blocks not using values from the previous one are moved.
+  block->extends_previous_block = false;
+}
+
+}  // namespace passes
+}  // namespace compiler
+}  // namespace cpu
+}  // namespace xe
@@ -0,0 +1,51 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2022 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#ifndef XENIA_CPU_COMPILER_PASSES_TRACE_FORMATION_PASS_H_
+#define XENIA_CPU_COMPILER_PASSES_TRACE_FORMATION_PASS_H_
+
+#include "xenia/cpu/compiler/compiler_pass.h"
+
+namespace xe {
+namespace cpu {
+namespace compiler {
+namespace passes {
+
+// Lays out blocks along the hot path using the BRANCH_LIKELY/BRANCH_UNLIKELY
+// hints on conditional branches, so that the common direction falls through
+// and cold blocks move to the end of the function. Must run before register
+// allocation. Edges are not updated.
+class TraceFormationPass : public CompilerPass {
+ public:
+  TraceFormationPass();
+  ~TraceFormationPass() override;
+
+  const char* name() const override { return "TraceFormationPass"; }
+  bool Run(hir::HIRBuilder* builder) override;
+
+ private:
+  static bool FallsThrough(const hir::Block* block);
+  static bool UsesOnlyOwnValues(const hir::Block* block);
+  void AppendBranch(hir::HIRBuilder* builder, hir::Block* block,
+                    hir::Block* target);
+  // Moves the block after the last one, adding branches for the fallthrough
+  // out of it and, if link_previous is set, into it.
+  void MoveToEnd(hir::HIRBuilder* builder, hir::Block* block,
+                 bool link_previous);
+
+  // First block moved to the end, where the original layout stops.
+  hir::Block* first_moved_block_ = nullptr;
+};
+
+}  // namespace passes
+}  // namespace compiler
+}  // namespace cpu
+}  // namespace xe
+
+#endif  // XENIA_CPU_COMPILER_PASSES_TRACE_FORMATION_PASS_H_
@@ -77,7 +77,13 @@ bool ValidationPass::ValidateInstruction(Block* block, Instr* instr) {
     assert_true(instr->dest->def == instr);
     auto use = instr->dest->use_head;
     while (use) {
-      assert_true(use->instr->block == block);
+      // Values may only be used in their own block or in following blocks
+      // that can only be entered by falling through into them.
+      auto use_block = use->instr->block;
+      while (use_block != block && use_block->extends_previous_block) {
+        use_block = use_block->prev;
+      }
+      assert_true(use_block == block);
       use = use->next;
     }
   }
@@ -22,6 +22,7 @@ class ValidationPass : public CompilerPass {
   ValidationPass();
   ~ValidationPass() override;
 
+  const char* name() const override { return "ValidationPass"; }
   bool Run(hir::HIRBuilder* builder) override;
 
  private:
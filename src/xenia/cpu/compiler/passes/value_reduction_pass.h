@@ -22,6 +22,7 @@ class ValueReductionPass : public CompilerPass {
   ValueReductionPass();
   ~ValueReductionPass() override;
 
+  const char* name() const override { return "ValueReductionPass"; }
   bool Run(hir::HIRBuilder* builder) override;
 
  private:
@@ -33,6 +33,67 @@ DEFINE_bool(trace_function_data, false,
 DEFINE_bool(validate_hir, false,
             "Perform validation checks on the HIR during compilation.", "CPU");
 
+DEFINE_bool(
+    jit_tiered_compilation, false,
+    "Translate functions with a minimal set of compiler passes on first call, "
+    "and retranslate them with all optimizations on a background thread once "
+    "they have been called jit_hot_function_threshold times.",
+    "CPU");
+DEFINE_uint32(jit_hot_function_threshold, 1000,
+              "Number of calls after which a function translated by "
+              "jit_tiered_compilation is retranslated with all optimizations.",
+              "CPU");
+
+DEFINE_bool(jit_trace_formation, false,
+            "With jit_tiered_compilation, count the direction of conditional "
+            "branches in baseline code and lay out the optimized translation "
+            "so that the hot path falls through and cold blocks move to the "
+            "end of the function.",
+            "CPU");
+
+DEFINE_bool(guest_block_profile, false,
+            "Count the executions of the guest basic blocks in the generated "
+            "code, and store their approximate frequencies in the instruction "
+            "infocache on exit, so the next runs of the title can precompile "
+            "and lay out what matters first (precompile_known_functions, "
+            "profile_guided_code_layout). Adds a counter increment to every "
+            "block.",
+            "CPU");
+
+DEFINE_bool(jit_code_reclamation, false,
+            "Reuse the generated code of functions that have been "
+            "retranslated or unloaded once no thread is executing it, so "
+            "long sessions loading many code modules don't run out of space "
+            "for generated code. Requires thread stack walking, which is only "
+            "available on Windows.",
+            "CPU");
+DEFINE_uint32(jit_code_reclamation_threshold, 4,
+              "Megabytes of dead generated code to accumulate before pausing "
+              "the threads to reclaim it with --jit_code_reclamation.",
+              "CPU");
+
+DEFINE_bool(invalidate_modified_code, false,
+            "Watch the writable guest memory containing translated code, and "
+            "retranslate the functions overlapping the memory written by the "
+            "title on their next call, for titles modifying their code with "
+            "writable_code_segments or loading code into data memory.",
+            "CPU");
+
+DEFINE_bool(jit_function_stats, false,
+            "Record per-function compile times, HIR instruction counts, code "
+            "sizes and execution counts, shown in the debugger and written to "
+            "--jit_function_stats_path on exit. Adds a counter increment to "
+            "every function entry.",
+            "CPU");
+DEFINE_path(jit_function_stats_path, "",
+            "CSV file the --jit_function_stats are written to on exit.",
+            "CPU");
+DEFINE_bool(jit_context_access_stats, false,
+            "Count the guest context fields accessed by the translated code, "
+            "as emitted rather than as executed, and log the most accessed "
+            "ones on exit, for laying out the context.",
+            "CPU");
+
 DEFINE_uint64(
     pvr, 0x710700,
     "Processor version and revision number.\nBits 0 to 15 are the version "
@@ -24,6 +24,21 @@ DECLARE_bool(trace_function_data);
 
 DECLARE_bool(validate_hir);
 
+DECLARE_bool(jit_tiered_compilation);
+DECLARE_uint32(jit_hot_function_threshold);
+DECLARE_bool(jit_trace_formation);
+
+DECLARE_bool(guest_block_profile);
+
+DECLARE_bool(jit_code_reclamation);
+DECLARE_uint32(jit_code_reclamation_threshold);
+
+DECLARE_bool(invalidate_modified_code);
+
+DECLARE_bool(jit_function_stats);
+DECLARE_path(jit_function_stats_path);
+DECLARE_bool(jit_context_access_stats);
+
 DECLARE_uint64(pvr);
 
 // Breakpoints:
@@ -15,7 +15,9 @@
 namespace xe {
 namespace cpu {
 
-EntryTable::EntryTable() = default;
+EntryTable::EntryTable()
+    : published_pages_(
+          new std::atomic<std::atomic<Entry*>*>[kPublishedPageCount]()) {}
 
 EntryTable::~EntryTable() {
   auto global_lock = global_critical_region_.Acquire();
@@ -23,9 +25,55 @@ EntryTable::~EntryTable() {
     Entry* entry = it;
     delete entry;
   }
+  for (uint32_t i = 0; i < kPublishedPageCount; ++i) {
+    delete[] published_pages_[i].load(std::memory_order_relaxed);
+  }
+}
+
+Entry* EntryTable::LookupPublished(uint32_t address) const {
+  if (address & 3) {
+    return nullptr;
+  }
+  uint32_t index = address >> 2;
+  auto page = published_pages_[index >> kPublishedPageShift].load(
+      std::memory_order_acquire);
+  if (!page) {
+    return nullptr;
+  }
+  return page[index & (kPublishedPageSize - 1)].load(
+      std::memory_order_acquire);
+}
+
+void EntryTable::SetPublished(uint32_t address, Entry* entry) {
+  if (address & 3) {
+    // Only reachable through the locked map.
+    return;
+  }
+  uint32_t index = address >> 2;
+  auto& page_slot = published_pages_[index >> kPublishedPageShift];
+  auto page = page_slot.load(std::memory_order_acquire);
+  if (!page) {
+    if (!entry) {
+      return;
+    }
+    auto new_page = new std::atomic<Entry*>[kPublishedPageSize]();
+    if (page_slot.compare_exchange_strong(page, new_page,
+                                          std::memory_order_acq_rel)) {
+      page = new_page;
+    } else {
+      // Another thread published into the same page first.
+      delete[] new_page;
+    }
+  }
+  page[index & (kPublishedPageSize - 1)].store(entry,
+                                               std::memory_order_release);
 }
 
 Entry* EntryTable::Get(uint32_t address) {
+  Entry* published = LookupPublished(address);
+  if (published) {
+    return published;
+  }
   auto global_lock = global_critical_region_.Acquire();
   uint32_t idx = map_.IndexForKey(address);
   if (idx == map_.size() || *map_.KeyAt(idx) != address) {
@@ -42,8 +90,11 @@ Entry* EntryTable::Get(uint32_t address) {
 }
 
 Entry::Status EntryTable::GetOrCreate(uint32_t address, Entry** out_entry) {
-  // TODO(benvanik): replace with a map with wait-free for find.
-  // https://github.com/facebook/folly/blob/master/folly/AtomicHashMap.h
+  Entry* published = LookupPublished(address);
+  if (published) {
+    *out_entry = published;
+    return Entry::STATUS_READY;
+  }
 
   auto global_lock = global_critical_region_.Acquire();
 
@@ -83,21 +134,30 @@ Entry::Status EntryTable::GetOrCreate(uint32_t address, Entry** out_entry) {
   return status;
 }
 
+void EntryTable::Publish(Entry* entry) {
+  entry->status = Entry::STATUS_READY;
+  SetPublished(entry->address, entry);
+}
+
 void EntryTable::Delete(uint32_t address) {
   auto global_lock = global_critical_region_.Acquire();
-  // doesnt this leak memory by not deleting the entry?
+  // The entry itself is never freed, as lock-free lookups may still be
+  // holding on to it.
   uint32_t idx = map_.IndexForKey(address);
   if (idx != map_.size() && *map_.KeyAt(idx) == address) {
     map_.EraseAt(idx);
+    SetPublished(address, nullptr);
   }
 }
 
-std::vector<Function*> EntryTable::FindWithAddress(uint32_t address) {
+std::vector<Function*> EntryTable::FindWithAddress(uint32_t address,
+                                                   uint32_t length) {
   auto global_lock = global_critical_region_.Acquire();
   std::vector<Function*> fns;
+  uint64_t end = uint64_t(address) + length;
   for (auto& it : map_.Values()) {
     Entry* entry = it;
-    if (address >= entry->address && address <= entry->end_address) {
+    if (entry->address < end && address <= entry->end_address) {
       if (entry->status == Entry::STATUS_READY) {
         fns.push_back(entry->function);
       }
@@ -10,6 +10,8 @@
 #ifndef XENIA_CPU_ENTRY_TABLE_H_
 #define XENIA_CPU_ENTRY_TABLE_H_
 
+#include <atomic>
+#include <memory>
 #include <unordered_map>
 #include <vector>
 
@@ -30,7 +32,7 @@ typedef struct Entry_t {
 
   uint32_t address;
   uint32_t end_address;
-  Status status;
+  std::atomic<Status> status;
   Function* function;
 } Entry;
 
@@ -41,11 +43,29 @@ class EntryTable {
 
   Entry* Get(uint32_t address);
   Entry::Status GetOrCreate(uint32_t address, Entry** out_entry);
+  // Marks an entry created by GetOrCreate as ready once its function and end
+  // address are set. Lookups of published entries don't take any lock, so
+  // threads calling into already compiled code don't wait on the ones still
+  // compiling.
+  void Publish(Entry* entry);
   void Delete(uint32_t address);
 
-  std::vector<Function*> FindWithAddress(uint32_t address);
+  // Ready functions overlapping the range.
+  std::vector<Function*> FindWithAddress(uint32_t address,
+                                         uint32_t length = 1);
 
  private:
+  // Ready entries by address / 4, in pages allocated when first published.
+  static constexpr uint32_t kPublishedPageShift = 16;
+  static constexpr uint32_t kPublishedPageSize = 1u << kPublishedPageShift;
+  static constexpr uint32_t kPublishedPageCount =
+      1u << (30 - kPublishedPageShift);
+
+  Entry* LookupPublished(uint32_t address) const;
+  void SetPublished(uint32_t address, Entry* entry);
+
+  std::unique_ptr<std::atomic<std::atomic<Entry*>*>[]> published_pages_;
+
   xe::global_critical_region global_critical_region_;
   // TODO(benvanik): replace with a better data structure.
   xe::split_map<uint32_t, Entry*> map_;
@@ -18,6 +18,9 @@
 
 namespace xe {
 namespace cpu {
+namespace ppc {
+class PPCHIRBuilder;
+}  // namespace ppc
 
 enum class ExportCategory : uint8_t {
   kNone = 0,
@@ -69,6 +72,10 @@ struct ExportTag {
 typedef void (*xe_kernel_export_shim_fn)(void*, void*);
 
 typedef void (*ExportTrampoline)(ppc::PPCContext* ppc_context);
+// Emits HIR in place of a direct call to the export, taking the arguments from
+// and leaving the result in the guest registers like the call would. Returns
+// false, without emitting anything, if the call has to be made instead.
+typedef bool (*ExportIntrinsic)(ppc::PPCHIRBuilder& f);
 #pragma pack(push, 1)
 class Export {
  public:
@@ -98,6 +105,8 @@ class Export {
       // Trampoline that is called from the guest-to-host thunk.
       // Expects only PPC context as first arg.
       ExportTrampoline trampoline;
+      // Optional inline implementation for the JIT.
+      ExportIntrinsic intrinsic;
     } function_data;
   };
   const char* const name;
@@ -11,6 +11,7 @@
 #define XENIA_CPU_FUNCTION_H_
 
 #include <memory>
+#include <unordered_map>
 #include <vector>
 
 #include "xenia/cpu/function_debug_info.h"
@@ -137,6 +138,56 @@ class GuestFunction : public Function {
   FunctionTraceData& trace_data() { return trace_data_; }
   std::vector<SourceMapEntry>& source_map() { return source_map_; }
 
+  // Tiered compilation state. Baseline code is translated with a minimal pass
+  // set and counts down hot_counter on every call; when it reaches zero the
+  // function is marked hot and retranslated with the full pass pipeline.
+  bool is_baseline() const { return is_baseline_; }
+  void set_baseline(bool value) { is_baseline_ = value; }
+  bool is_hot() const { return is_hot_; }
+  void set_hot(bool value) { is_hot_ = value; }
+  uint32_t* hot_counter() { return &hot_counter_; }
+
+  // Translation and execution statistics, only gathered with
+  // --jit_function_stats. Values describe the latest translation, except for
+  // the totals.
+  struct JitStats {
+    uint32_t translation_count = 0;
+    uint64_t total_compile_time_us = 0;
+    uint64_t compile_time_us = 0;
+    uint32_t hir_instr_count_before = 0;
+    uint32_t hir_instr_count_after = 0;
+    uint32_t machine_code_length = 0;
+    // Incremented by the generated code on entry, not atomically.
+    uint64_t execution_count = 0;
+  };
+  JitStats& jit_stats() { return jit_stats_; }
+
+  // Guest conditional branch directions counted by baseline code for
+  // jit_trace_formation, keyed by the address of the branch instruction.
+  // Entries are only added while the baseline code is emitted.
+  struct BranchCounters {
+    uint32_t taken = 0;
+    uint32_t not_taken = 0;
+  };
+  BranchCounters* AllocBranchCounters(uint32_t guest_address) {
+    return &branch_counters_[guest_address];
+  }
+  const BranchCounters* LookupBranchCounters(uint32_t guest_address) const {
+    auto it = branch_counters_.find(guest_address);
+    return it != branch_counters_.end() ? &it->second : nullptr;
+  }
+
+  // Executions of the guest basic blocks counted by the generated code with
+  // --guest_block_profile, keyed by the address of the first instruction of
+  // the block, kept across retranslations. Entries are only added while the
+  // code is emitted.
+  uint64_t* AllocBlockCounter(uint32_t guest_address) {
+    return &block_counters_[guest_address];
+  }
+  const std::unordered_map<uint32_t, uint64_t>& block_counters() const {
+    return block_counters_;
+  }
+
   ExternHandler extern_handler() const { return extern_handler_; }
   Export* export_data() const { return export_data_; }
   void SetupExtern(ExternHandler handler, Export* export_data = nullptr);
@@ -160,6 +211,12 @@ class GuestFunction : public Function {
   std::vector<SourceMapEntry> source_map_;
   ExternHandler extern_handler_ = nullptr;
   Export* export_data_ = nullptr;
+  bool is_baseline_ = false;
+  bool is_hot_ = false;
+  uint32_t hot_counter_ = 0;
+  JitStats jit_stats_;
+  std::unordered_map<uint32_t, BranchCounters> branch_counters_;
+  std::unordered_map<uint32_t, uint64_t> block_counters_;
 };
 
 }  // namespace cpu
@@ -0,0 +1,261 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2026 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/cpu/guest_memory_routines.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "xenia/base/byte_order.h"
+#include "xenia/base/math.h"
+#include "xenia/base/metrics.h"
+#include "xenia/base/mutex.h"
+#include "xenia/cpu/ppc/ppc_context.h"
+#include "xenia/cpu/processor.h"
+#include "xenia/memory.h"
+
+namespace xe {
+namespace cpu {
+
+namespace {
+
+xe::metrics::Counter guest_memory_routine_calls_(
+    "CPU", "guest_memory_routine_calls",
+    "Calls to guest memset and memcpy routines executed on the host");
+xe::metrics::Counter guest_memory_routine_bytes_(
+    "CPU", "guest_memory_routine_bytes",
+    "Bytes written by guest memset and memcpy routines executed on the host");
+
+// Register fields of an instruction word.
+constexpr uint8_t kFieldD = 1 << 0;  // RT / RS, bits 21:25.
+constexpr uint8_t kFieldA = 1 << 1;  // RA, bits 16:20.
+
+struct SignatureWord {
+  // The instruction with the temporary register fields zeroed.
+  uint32_t code;
+  // Fields containing the first and the second temporary register.
+  uint8_t temp_fields[2];
+};
+
+uint32_t GetFieldMask(uint8_t fields) {
+  uint32_t mask = 0;
+  if (fields & kFieldD) {
+    mask |= 0x1F << 21;
+  }
+  if (fields & kFieldA) {
+    mask |= 0x1F << 16;
+  }
+  return mask;
+}
+
+bool MatchSignature(const uint8_t* code, size_t word_count,
+                    const SignatureWord* signature, size_t signature_length) {
+  if (word_count < signature_length) {
+    return false;
+  }
+  // Unbound until the first word using them.
+  uint32_t temps[2] = {UINT32_MAX, UINT32_MAX};
+  for (size_t i = 0; i < signature_length; ++i) {
+    const SignatureWord& signature_word = signature[i];
+    uint32_t word = xe::load_and_swap<uint32_t>(code + i * sizeof(uint32_t));
+    uint32_t temp_mask = GetFieldMask(signature_word.temp_fields[0]) |
+                         GetFieldMask(signature_word.temp_fields[1]);
+    if ((word & ~temp_mask) != signature_word.code) {
+      return false;
+    }
+    for (uint32_t j = 0; j < 2; ++j) {
+      uint8_t fields = signature_word.temp_fields[j];
+      for (uint32_t shift : {21, 16}) {
+        if (!(fields & (shift == 21 ? kFieldD : kFieldA))) {
+          continue;
+        }
+        uint32_t reg = (word >> shift) & 0x1F;
+        if (temps[j] == UINT32_MAX) {
+          // Only the volatile registers not used for the arguments, as the
+          // handlers don't write the temporaries. r0 is not usable as a base.
+          if (reg < 6 || reg > 12 || reg == temps[j ^ 1]) {
+            return false;
+          }
+          temps[j] = reg;
+        } else if (reg != temps[j]) {
+          return false;
+        }
+      }
+    }
+  }
+  return true;
+}
+
+void TriggerWatches(Memory* memory, uint32_t address, uint64_t length,
+                    bool is_write) {
+  // Only physical memory is watched, check it before taking the global lock.
+  const BaseHeap* heap = memory->LookupHeap(address);
+  if (!heap || heap->heap_type() != HeapType::kGuestPhysical) {
+    return;
+  }
+  memory->TriggerPhysicalMemoryCallbacks(
+      global_critical_region::AcquireDirect(), address,
+      uint32_t(std::min(length, uint64_t(UINT32_MAX))), is_write, false);
+}
+
+bool WrapsAround(uint32_t address, uint64_t length) {
+  return address + length > (uint64_t(1) << 32);
+}
+
+// The handlers leave the registers like the byte loops below, with the
+// exception of their temporaries. Those are volatile registers other than the
+// arguments (see MatchSignature), which the callers can't expect to be
+// preserved across the call, so they're left as they were on entry.
+//
+// cr6 has the result of comparing the low 32 bits of the length to zero, and
+// beqlr returns right after that with nothing else modified. Otherwise the
+// loop counts the whole 64-bit length down in CTR. SO is not modeled by the
+// translated comparisons either, so it's not written.
+template <bool kSignedLengthComparison>
+bool CompareLength(ppc::PPCContext* ppc_context) {
+  auto length = uint32_t(ppc_context->r[5]);
+  bool lt = kSignedLengthComparison && int32_t(length) < 0;
+  ppc_context->cr6.cr6_all_equal = lt;
+  ppc_context->cr6.cr6_1 = length && !lt;
+  ppc_context->cr6.cr6_none_equal = !length;
+  return length != 0;
+}
+
+// void* memset(void* dest, int value, size_t length), storing bytes forward.
+template <bool kSignedLengthComparison>
+void GuestMemsetHandler(ppc::PPCContext* ppc_context,
+                        kernel::KernelState* kernel_state) {
+  if (!CompareLength<kSignedLengthComparison>(ppc_context)) {
+    return;
+  }
+  auto dest = uint32_t(ppc_context->r[3]);
+  auto value = uint8_t(ppc_context->r[4]);
+  uint64_t length = ppc_context->r[5];
+  ppc_context->ctr = 0;
+  guest_memory_routine_calls_.Increment();
+  guest_memory_routine_bytes_.Increment(length);
+  Memory* memory = ppc_context->processor->memory();
+  TriggerWatches(memory, dest, length, true);
+  if (WrapsAround(dest, length)) {
+    for (uint64_t i = 0; i < length; ++i) {
+      *memory->TranslateVirtual<uint8_t*>(uint32_t(dest + i)) = value;
+    }
+    return;
+  }
+  std::memset(memory->TranslateVirtual(dest), value, size_t(length));
+}
+
+// void* memcpy(void* dest, const void* src, size_t length), copying bytes
+// forward, so a destination overlapping the source after its start repeats
+// the source bytes before it. r4 is left past the end of the source.
+template <bool kSignedLengthComparison>
+void GuestMemcpyHandler(ppc::PPCContext* ppc_context,
+                        kernel::KernelState* kernel_state) {
+  if (!CompareLength<kSignedLengthComparison>(ppc_context)) {
+    return;
+  }
+  auto dest = uint32_t(ppc_context->r[3]);
+  auto src = uint32_t(ppc_context->r[4]);
+  uint64_t length = ppc_context->r[5];
+  ppc_context->r[4] += length;
+  ppc_context->ctr = 0;
+  guest_memory_routine_calls_.Increment();
+  guest_memory_routine_bytes_.Increment(length);
+  Memory* memory = ppc_context->processor->memory();
+  TriggerWatches(memory, src, length, false);
+  TriggerWatches(memory, dest, length, true);
+  if (WrapsAround(dest, length) || WrapsAround(src, length) ||
+      (dest > src && dest - src < length)) {
+    for (uint64_t i = 0; i < length; ++i) {
+      *memory->TranslateVirtual<uint8_t*>(uint32_t(dest + i)) =
+          *memory->TranslateVirtual<uint8_t*>(uint32_t(src + i));
+    }
+    return;
+  }
+  std::memmove(memory->TranslateVirtual(dest), memory->TranslateVirtual(src),
+               size_t(length));
+}
+
+// Byte loops keeping the destination in r3 for returning it:
+//   cmplwi cr6, r5, 0 (or cmpwi, which is the same for zero)
+//   mr t0, r3
+//   beqlr cr6
+//   mtctr r5
+// loop:
+//   (memcpy) lbz t1, 0(r4)
+//   (memcpy) addi r4, r4, 1
+//   stb r4 (memset) / t1 (memcpy), 0(t0)
+//   addi t0, t0, 1
+//   bdnz loop
+//   blr
+// The signatures exclude the comparison.
+constexpr uint32_t kCmplwiCr6R5Zero = 0x2B050000;
+constexpr uint32_t kCmpwiCr6R5Zero = 0x2F050000;
+const SignatureWord kMemsetByteLoopSignature[] = {
+    {0x7C601B78, {kFieldA, 0}},
+    {0x4D9A0020, {0, 0}},
+    {0x7CA903A6, {0, 0}},
+    {0x98800000, {kFieldA, 0}},
+    {0x38000001, {kFieldD | kFieldA, 0}},
+    {0x4200FFF8, {0, 0}},
+    {0x4E800020, {0, 0}},
+};
+const SignatureWord kMemcpyByteLoopSignature[] = {
+    {0x7C601B78, {kFieldA, 0}},
+    {0x4D9A0020, {0, 0}},
+    {0x7CA903A6, {0, 0}},
+    {0x88040000, {0, kFieldD}},
+    {0x38840001, {0, 0}},
+    {0x98000000, {kFieldA, kFieldD}},
+    {0x38000001, {kFieldD | kFieldA, 0}},
+    {0x4200FFF0, {0, 0}},
+    {0x4E800020, {0, 0}},
+};
+
+constexpr uint32_t kByteLoopSizes[] = {
+    uint32_t(sizeof(uint32_t) * (1 + xe::countof(kMemsetByteLoopSignature))),
+    uint32_t(sizeof(uint32_t) * (1 + xe::countof(kMemcpyByteLoopSignature))),
+};
+const GuestMemoryRoutine kMemsetByteLoops[] = {
+    {"memset", kByteLoopSizes[0], GuestMemsetHandler<false>},
+    {"memset", kByteLoopSizes[0], GuestMemsetHandler<true>},
+};
+const GuestMemoryRoutine kMemcpyByteLoops[] = {
+    {"memcpy", kByteLoopSizes[1], GuestMemcpyHandler<false>},
+    {"memcpy", kByteLoopSizes[1], GuestMemcpyHandler<true>},
+};
+
+}  // namespace
+
+const GuestMemoryRoutine* MatchGuestMemoryRoutine(const uint8_t* code,
+                                                  size_t word_count) {
+  if (!word_count) {
+    return nullptr;
+  }
+  uint32_t first_word = xe::load_and_swap<uint32_t>(code);
+  if (first_word != kCmplwiCr6R5Zero && first_word != kCmpwiCr6R5Zero) {
+    return nullptr;
+  }
+  // The handlers set cr6 like the comparison of the routine.
+  size_t comparison = first_word == kCmpwiCr6R5Zero ? 1 : 0;
+  code += sizeof(uint32_t);
+  --word_count;
+  if (MatchSignature(code, word_count, kMemsetByteLoopSignature,
+                     xe::countof(kMemsetByteLoopSignature))) {
+    return &kMemsetByteLoops[comparison];
+  }
+  if (MatchSignature(code, word_count, kMemcpyByteLoopSignature,
+                     xe::countof(kMemcpyByteLoopSignature))) {
+    return &kMemcpyByteLoops[comparison];
+  }
+  return nullptr;
+}
+
+}  // namespace cpu
+}  // namespace xe
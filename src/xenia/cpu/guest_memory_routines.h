@@ -0,0 +1,51 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2026 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#ifndef XENIA_CPU_GUEST_MEMORY_ROUTINES_H_
+#define XENIA_CPU_GUEST_MEMORY_ROUTINES_H_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "xenia/cpu/function.h"
+
+namespace xe {
+namespace cpu {
+
+// Recognition of the memset and memcpy routines titles link statically, so
+// they can be executed as single host calls instead of being translated
+// instruction by instruction.
+//
+// Routines are recognized by their code, with the temporary registers the
+// compiler is free to choose matched by wildcards, and replaced routines are
+// only entered through their first instruction, so the host handler must
+// reproduce what the matched code does, including the return value, the
+// behavior for overlapping ranges and the registers it leaves. The one
+// exception are the temporaries, which the ABI doesn't preserve across calls
+// (see the handlers). Other routines (such as the CRT ones using dcbz and
+// dcbt) are added to the signature table in the .cc.
+
+struct GuestMemoryRoutine {
+  const char* name;
+  // Size of the code of the routine, in bytes.
+  uint32_t code_size;
+  // Reads the arguments from and writes the result to the guest registers,
+  // and triggers the physical memory watches of the accessed ranges.
+  GuestFunction::ExternHandler handler;
+};
+
+// Returns the routine whose code starts at the big-endian instruction words,
+// or nullptr if none.
+const GuestMemoryRoutine* MatchGuestMemoryRoutine(const uint8_t* code,
+                                                  size_t word_count);
+
+}  // namespace cpu
+}  // namespace xe
+
+#endif  // XENIA_CPU_GUEST_MEMORY_ROUTINES_H_
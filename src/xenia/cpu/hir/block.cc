@@ -16,6 +16,17 @@ namespace xe {
 namespace cpu {
 namespace hir {
 
+bool Block::CanExtendPreviousBlock() const {
+  if (label_head || !prev || !prev->instr_tail) {
+    return false;
+  }
+  // Only plain conditional branches; calls and traps clobber registers and
+  // may modify the context.
+  auto opcode = prev->instr_tail->opcode;
+  return opcode == &OPCODE_BRANCH_TRUE_info ||
+         opcode == &OPCODE_BRANCH_FALSE_info;
+}
+
 void Block::AssertNoCycles() {
   Instr* hare = instr_head;
   Instr* tortoise = instr_head;
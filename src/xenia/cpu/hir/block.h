@@ -63,6 +63,17 @@ class Block {
 
   uint16_t ordinal;
 
+  // Set by context promotion if values from the previous block are used in
+  // this one, so the register allocator must keep them live across the
+  // boundary. Later passes may fold or remove the branch that made the chain
+  // possible, so they must check this rather than CanExtendPreviousBlock.
+  bool extends_previous_block;
+
+  // True if the block has no labels and the previous block ends in a
+  // conditional branch, meaning it can only be entered by falling through
+  // the previous block.
+  bool CanExtendPreviousBlock() const;
+
   void AssertNoCycles();
 };
 
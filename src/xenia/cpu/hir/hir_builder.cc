@@ -132,22 +132,12 @@ Value* HIRBuilder::AllocateValue() {
   }
   return arena()->Alloc<Value>();
 }
-Value::Use* HIRBuilder::AllocateUse() {
-  Value::Use* result = free_uses_.NewEntry();
-  if (result) {
-    return result;
-  }
-  return arena()->Alloc<Value::Use>();
-}
 void HIRBuilder::DeallocateInstruction(Instr* instr) {
   // free_instrs_.DeleteEntry(instr);
 }
 void HIRBuilder::DeallocateValue(Value* value) {
   // free_values_.DeleteEntry(value);
 }
-void HIRBuilder::DeallocateUse(Value::Use* use) {
-  // free_uses_.DeleteEntry(use);
-}
 void HIRBuilder::DumpValue(StringBuffer* str, Value* value) {
   if (value->IsConstant()) {
     switch (value->type) {
@@ -351,6 +341,12 @@ void HIRBuilder::AssertNoCycles() {
 
 Block* HIRBuilder::current_block() const { return current_block_; }
 
+Block* HIRBuilder::SetInsertionBlock(Block* block) {
+  Block* previous = current_block_;
+  current_block_ = block;
+  return previous;
+}
+
 Instr* HIRBuilder::last_instr() const {
   if (current_block_ && current_block_->instr_tail) {
     return current_block_->instr_tail;
@@ -429,6 +425,7 @@ void HIRBuilder::InsertLabel(Label* label, Instr* prev_instr) {
 
   Block* new_block = arena_->Alloc<Block>();
   new_block->ordinal = UINT16_MAX;
+  new_block->extends_previous_block = false;
   new_block->incoming_values = nullptr;
   new_block->arena = arena_;
   new_block->prev = prev_block;
@@ -576,6 +573,23 @@ void HIRBuilder::RemoveBlock(Block* block) {
   block->next = block->prev = nullptr;
 }
 
+void HIRBuilder::MoveBlockToEnd(Block* block) {
+  if (block == block_tail_) {
+    return;
+  }
+  if (block->prev) {
+    block->prev->next = block->next;
+  }
+  block->next->prev = block->prev;
+  if (block == block_head_) {
+    block_head_ = block->next;
+  }
+  block->prev = block_tail_;
+  block->next = nullptr;
+  block_tail_->next = block;
+  block_tail_ = block;
+}
+
 void HIRBuilder::MergeAdjacentBlocks(Block* left, Block* right) {
   assert_true(left->next == right && right->prev == left);
   assert_true(!right->incoming_edge_head ||
@@ -674,6 +688,7 @@ void HIRBuilder::MergeAdjacentBlocks(Block* left, Block* right) {
 Block* HIRBuilder::AppendBlock() {
   Block* block = arena_->Alloc<Block>();
   block->ordinal = UINT16_MAX;
+  block->extends_previous_block = false;
   block->incoming_values = nullptr;
   block->arena = arena_;
   block->next = NULL;
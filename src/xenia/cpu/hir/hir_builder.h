@@ -35,7 +35,6 @@ enum FunctionAttributes {
 class HIRBuilder {
   SimpleFreelist<Instr> free_instrs_;
   SimpleFreelist<Value> free_values_;
-  SimpleFreelist<Value::Use> free_uses_;
 
  public:
   HIRBuilder();
@@ -65,6 +64,11 @@ class HIRBuilder {
   Block* last_block() const { return block_tail_; }
   Block* current_block() const;
   Instr* last_instr() const;
+  // Makes instructions append to the end of an existing block, for passes
+  // that need to add to blocks after the function has been built. Returns the
+  // previous insertion block so it can be restored. Ending the block (such as
+  // with a branch) resets it.
+  Block* SetInsertionBlock(Block* block);
 
   Label* NewLabel();
   void MarkLabel(Label* label, Block* block = 0);
@@ -75,18 +79,17 @@ class HIRBuilder {
   void RemoveEdge(Block* src, Block* dest);
   void RemoveEdge(Edge* edge);
   void RemoveBlock(Block* block);
+  // Unlinks the block and appends it after the last block. Edges are kept.
+  void MoveBlockToEnd(Block* block);
   void MergeAdjacentBlocks(Block* left, Block* right);
 
   Instr* AllocateInstruction();
 
   Value* AllocateValue();
-  Value::Use* AllocateUse();
   void DeallocateInstruction(Instr* instr);
   void DeallocateValue(Value* value);
-  void DeallocateUse(Value::Use* use);
   void ResetPools() {
     free_instrs_.Reset();
-    free_uses_.Reset();
     free_values_.Reset();
   }
   // static allocations:
@@ -22,7 +22,7 @@ void Instr::set_srcN(Value* value, uint32_t idx) {
     srcs[idx].value->RemoveUse(srcs_use[idx]);
   }
   srcs[idx].value = value;
-  srcs_use[idx] = value ? value->AddUse(block->arena, this) : nullptr;
+  srcs_use[idx] = value ? value->AddUse(&uses[idx], this) : nullptr;
 }
 
 void Instr::MoveBefore(Instr* other) {
@@ -62,30 +62,16 @@ void Instr::Replace(const OpcodeInfo* new_opcode, uint16_t new_flags) {
   if (src1_use) {
     src1.value->RemoveUse(src1_use);
     src1.value = NULL;
-    // src1_use = NULL;
+    src1_use = nullptr;
   }
   if (src2_use) {
     src2.value->RemoveUse(src2_use);
     src2.value = NULL;
-    // src2_use = NULL;
+    src2_use = nullptr;
   }
   if (src3_use) {
     src3.value->RemoveUse(src3_use);
     src3.value = NULL;
-    // src3_use = NULL;
-  }
-
-  if (src1_use) {
-    HIRBuilder::GetCurrent()->DeallocateUse(src1_use);
-    src1_use = nullptr;
-  }
-  if (src2_use) {
-    HIRBuilder::GetCurrent()->DeallocateUse(src2_use);
-    src2_use = nullptr;
-  }
-
-  if (src3_use) {
-    HIRBuilder::GetCurrent()->DeallocateUse(src3_use);
     src3_use = nullptr;
   }
 }
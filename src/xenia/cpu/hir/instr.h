@@ -69,6 +69,8 @@ class Instr {
     };
     Value::Use* srcs_use[3];
   };
+  // Storage of the use list entries referenced by srcs_use.
+  Value::Use uses[3];
   void set_srcN(Value* value, uint32_t idx);
   void set_src1(Value* value) { set_srcN(value, 0); }
 
@@ -24,6 +24,16 @@ enum CallFlags {
 enum BranchFlags {
   BRANCH_LIKELY = (1 << 1),
   BRANCH_UNLIKELY = (1 << 2),
+  // A guest conditional branch whose direction baseline code counts for
+  // jit_trace_formation.
+  BRANCH_PROFILED = (1 << 3),
+};
+
+enum TrapCodes : uint16_t {
+  // Conditional debugger breakpoint, trapping in place with the instruction
+  // the debugger patches in for breakpoints. Only for TRAP_TRUE, as TRAP codes
+  // are arbitrary guest trap immediates.
+  TRAP_TRUE_BREAKPOINT = 0xFFFF,
 };
 
 enum RoundMode {
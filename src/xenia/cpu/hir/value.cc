@@ -21,8 +21,7 @@ namespace xe {
 namespace cpu {
 namespace hir {
 
-Value::Use* Value::AddUse(Arena* arena, Instr* instr) {
-  Use* use = HIRBuilder::GetCurrent()->AllocateUse();
+Value::Use* Value::AddUse(Use* use, Instr* instr) {
   use->instr = instr;
   use->prev = NULL;
   use->next = use_head;
@@ -42,8 +41,6 @@ void Value::RemoveUse(Use* use) {
   if (use->next) {
     use->next->prev = use->prev;
   }
-
-  // HIRBuilder::GetCurrent()->DeallocateUse(use);
 }
 
 uint32_t Value::AsUint32() {
@@ -104,9 +104,9 @@ struct ValueMask {
 
 class Value {
  public:
-  /*
-    todo : this should be intrusive and be part of Instr instead.
-  */
+  // Entries of the use list, stored in the using instruction (Instr::uses), so
+  // adding a use doesn't allocate and walking the uses of a value touches the
+  // instructions the passes look at next anyway.
   typedef struct Use_s {
     Instr* instr;
     Use_s* prev;
@@ -142,7 +142,7 @@ class Value {
     ConstantValue constant;
   };
 
-  Use* AddUse(Arena* arena, Instr* instr);
+  Use* AddUse(Use* use, Instr* instr);
   void RemoveUse(Use* use);
 
   void set_zero(TypeName new_type) {
@@ -10,6 +10,7 @@
 #include "xenia/cpu/ppc/ppc_context.h"
 
 #include <cinttypes>
+#include <cstddef>
 #include <cstdlib>
 
 #include "xenia/base/assert.h"
@@ -82,6 +83,58 @@ std::string PPCContext::GetRegisterName(PPCRegister reg) {
   }
 }
 
+std::string PPCContext::GetFieldName(size_t offset) {
+  constexpr size_t kCRBegin = offsetof(PPCContext, cr0);
+  if (offset >= kCRBegin && offset < kCRBegin + 8 * 4) {
+    static const char* const kCRBitNames[] = {"lt", "gt", "eq", "so"};
+    return "cr" + std::to_string((offset - kCRBegin) / 4) + "." +
+           kCRBitNames[(offset - kCRBegin) % 4];
+  }
+  struct ArrayField {
+    const char* name;
+    size_t offset;
+    size_t element_size;
+    size_t element_count;
+  };
+  static const ArrayField kArrayFields[] = {
+      {"r", offsetof(PPCContext, r), sizeof(uint64_t), 32},
+      {"f", offsetof(PPCContext, f), sizeof(double), 32},
+      {"v", offsetof(PPCContext, v), sizeof(vec128_t), 128},
+  };
+  for (const ArrayField& field : kArrayFields) {
+    if (offset >= field.offset &&
+        offset < field.offset + field.element_size * field.element_count) {
+      return field.name +
+             std::to_string((offset - field.offset) / field.element_size);
+    }
+  }
+  struct Field {
+    const char* name;
+    size_t offset;
+  };
+  static const Field kFields[] = {
+      {"fpscr", offsetof(PPCContext, fpscr)},
+      {"xer_ca", offsetof(PPCContext, xer_ca)},
+      {"xer_ov", offsetof(PPCContext, xer_ov)},
+      {"xer_so", offsetof(PPCContext, xer_so)},
+      {"vscr_sat", offsetof(PPCContext, vscr_sat)},
+      {"ctr", offsetof(PPCContext, ctr)},
+      {"lr", offsetof(PPCContext, lr)},
+      {"msr", offsetof(PPCContext, msr)},
+      {"vscr_vec", offsetof(PPCContext, vscr_vec)},
+      {"vrsave", offsetof(PPCContext, vrsave)},
+      {"thread_id", offsetof(PPCContext, thread_id)},
+      {"scratch", offsetof(PPCContext, scratch)},
+      {"reserved_val", offsetof(PPCContext, reserved_val)},
+  };
+  for (const Field& field : kFields) {
+    if (offset == field.offset) {
+      return field.name;
+    }
+  }
+  return "+" + string_util::to_hex_string(uint32_t(offset));
+}
+
 std::string PPCContext::GetStringFromValue(PPCRegister reg) const {
   switch (reg) {
     case PPCRegister::kLR:
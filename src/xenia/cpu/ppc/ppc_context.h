@@ -373,6 +373,17 @@ typedef struct alignas(64) PPCContext_s {
     } bits;
   } fpscr;  // Floating-point status and control register
 
+  // XER register:
+  // Split to make it easier to do individual updates.
+  // Set by the carrying instructions, so placed with the CR fields in the
+  // padding before r, to be reachable with 8-bit displacements from the
+  // context register like them (see --jit_context_access_stats).
+  uint8_t xer_ca;
+  uint8_t xer_ov;
+  uint8_t xer_so;
+  // todo: remove, saturation should be represented by a vector
+  uint8_t vscr_sat;
+
   // Most frequently used registers first.
 
   uint64_t r[32];  // 0x20 General purpose registers
@@ -384,18 +395,11 @@ typedef struct alignas(64) PPCContext_s {
   double f[32];     // 0x120 Floating-point registers
   vec128_t v[128];  // 0x220 VMX128 vector registers
   vec128_t vscr_vec;
-  // XER register:
-  // Split to make it easier to do individual updates.
-  uint8_t xer_ca;
-  uint8_t xer_ov;
-  uint8_t xer_so;
 
   // Condition registers:
   // These are split to make it easier to do DCE on unused stores.
   uint64_t cr() const;
   void set_cr(uint64_t value);
-  // todo: remove, saturation should be represented by a vector
-  uint8_t vscr_sat;
 
   uint32_t vrsave;
 
@@ -477,6 +481,8 @@ typedef struct alignas(64) PPCContext_s {
 #endif
   }
   static std::string GetRegisterName(PPCRegister reg);
+  // Name of the field at the offset, for reporting context accesses.
+  static std::string GetFieldName(size_t offset);
   std::string GetStringFromValue(PPCRegister reg) const;
   void SetValueFromString(PPCRegister reg, std::string value);
 
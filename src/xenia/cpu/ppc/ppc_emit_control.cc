@@ -33,6 +33,31 @@ using namespace xe::cpu::hir;
 using xe::cpu::hir::Label;
 using xe::cpu::hir::Value;
 
+// Baseline code counts the directions of the branch, and the optimized
+// translation of a hot function gets hints for TraceFormationPass.
+static uint32_t GetTraceBranchFlags(GuestFunction* function, uint32_t cia) {
+  if (!function->is_hot()) {
+    return BRANCH_PROFILED;
+  }
+  auto counters = function->LookupBranchCounters(cia);
+  if (!counters) {
+    return 0;
+  }
+  // Only lay out branches that are clearly biased.
+  uint32_t taken = counters->taken;
+  uint32_t not_taken = counters->not_taken;
+  if (taken + not_taken < 16) {
+    return 0;
+  }
+  if (taken / 4 > not_taken) {
+    return BRANCH_LIKELY;
+  }
+  if (not_taken / 4 > taken) {
+    return BRANCH_UNLIKELY;
+  }
+  return 0;
+}
+
 int InstrEmit_branch(PPCHIRBuilder& f, const char* src, uint64_t cia,
                      Value* nia, bool lk, Value* cond = NULL,
                      bool expect_true = true, bool nia_is_lr = false) {
@@ -70,6 +95,9 @@ int InstrEmit_branch(PPCHIRBuilder& f, const char* src, uint64_t cia,
     if (label) {
       // Branch to label.
       uint32_t branch_flags = 0;
+      if (cond && cvars::jit_trace_formation) {
+        branch_flags = GetTraceBranchFlags(f.function(), uint32_t(cia));
+      }
       if (cond) {
         if (expect_true) {
           f.BranchTrue(cond, label, branch_flags);
@@ -82,7 +110,15 @@ int InstrEmit_branch(PPCHIRBuilder& f, const char* src, uint64_t cia,
     } else {
       // Call function.
       auto function = f.LookupFunction(nia_value);
-      if (cond) {
+      if (!cond && lk &&
+          (f.TryEmitExportIntrinsic(function) ||
+           f.TryInlineSaveRestore(function, true) ||
+           f.TryInlineLeafFunction(function))) {
+        // LR has been set above, the body continues with the next
+        // instruction just like the blr would have.
+      } else if (!cond && !lk && f.TryInlineSaveRestore(function, false)) {
+        // The inlined body ends with the return of this function.
+      } else if (cond) {
         if (!expect_true) {
           cond = f.IsFalse(cond);
         }
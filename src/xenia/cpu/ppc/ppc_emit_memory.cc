@@ -22,6 +22,13 @@ DEFINE_bool(
     "instructions were written with the Xbox 360's cache in mind, and modern "
     "processors do their own automatic prefetching.",
     "CPU");
+DEFINE_bool(
+    translate_cache_touch, false,
+    "Translate ppc dcbt and dcbtst cache touch hints to host prefetcht0 and "
+    "prefetchw of the two 64-byte lines of the 128-byte guest cache line, even "
+    "if --disable_prefetch_and_cachecontrol is enabled, without the cache "
+    "flushes. May help titles touching the data ahead in memory-bound loops.",
+    "CPU");
 
 DEFINE_bool(no_reserved_ops, false,
             "For testing whether a game may have races with a broken reserved "
@@ -1140,7 +1147,8 @@ int InstrEmit_dcbst(PPCHIRBuilder& f, const InstrData& i) {
 }
 
 int InstrEmit_dcbt(PPCHIRBuilder& f, const InstrData& i) {
-  if (!cvars::disable_prefetch_and_cachecontrol) {
+  if (!cvars::disable_prefetch_and_cachecontrol ||
+      cvars::translate_cache_touch) {
     Value* ea = CalculateEA_0(f, i.X.RA, i.X.RB);
     f.CacheControl(ea, 128, CacheControlType::CACHE_CONTROL_TYPE_DATA_TOUCH);
   }
@@ -1148,7 +1156,8 @@ int InstrEmit_dcbt(PPCHIRBuilder& f, const InstrData& i) {
 }
 
 int InstrEmit_dcbtst(PPCHIRBuilder& f, const InstrData& i) {
-  if (!cvars::disable_prefetch_and_cachecontrol) {
+  if (!cvars::disable_prefetch_and_cachecontrol ||
+      cvars::translate_cache_touch) {
     Value* ea = CalculateEA_0(f, i.X.RA, i.X.RB);
     f.CacheControl(ea, 128,
                    CacheControlType::CACHE_CONTROL_TYPE_DATA_TOUCH_FOR_STORE);
@@ -1170,7 +1179,7 @@ int InstrEmit_dcbz(PPCHIRBuilder& f, const InstrData& i) {
 
 int InstrEmit_dcbz128(PPCHIRBuilder& f, const InstrData& i) {
   // EA <- (RA) + (RB)
-  // memset(EA & ~31, 0, 32)
+  // memset(EA & ~127, 0, 128)
   Value* ea = CalculateEA_0(f, i.X.RA, i.X.RB);
   // dcbz128 - 128 byte set
   int block_size = 128;
@@ -12,6 +12,7 @@
 #include "xenia/base/atomic.h"
 #include "xenia/base/logging.h"
 #include "xenia/base/mutex.h"
+#include "xenia/cpu/cpu_flags.h"
 #include "xenia/cpu/ppc/ppc_context.h"
 #include "xenia/cpu/ppc/ppc_emit.h"
 #include "xenia/cpu/ppc/ppc_opcode_info.h"
@@ -50,6 +51,10 @@ PPCFrontend::PPCFrontend(Processor* processor) : processor_(processor) {
 PPCFrontend::~PPCFrontend() {
   // Force cleanup now before we deinit.
   translator_pool_.Reset();
+
+  if (cvars::jit_context_access_stats) {
+    PPCTranslator::LogContextAccessStats();
+  }
 }
 
 Memory* PPCFrontend::memory() const { return processor_->memory(); }
@@ -28,11 +28,30 @@
 #include "xenia/cpu/ppc/ppc_opcode_info.h"
 #include "xenia/cpu/processor.h"
 #include "xenia/cpu/xex_module.h"
+
+DECLARE_bool(debug);
+
 DEFINE_bool(
     break_on_unimplemented_instructions, true,
     "Break to the host debugger (or crash if no debugger attached) if an "
     "unimplemented PowerPC instruction is encountered.",
     "CPU");
+DEFINE_uint32(
+    inline_leaf_function_max_instructions, 0,
+    "Inline calls to guest leaf functions of up to this many instructions "
+    "(including the final blr) into the caller, so the optimization passes "
+    "can work across the call boundary. 0 to disable.",
+    "CPU");
+DEFINE_bool(
+    inline_save_restore_helpers, true,
+    "Emit the instructions of the __savegprlr_*, __restgprlr_*, __savefpr_*, "
+    "__restfpr_*, __savevmx_* and __restvmx_* helpers found in the module in "
+    "place of the calls to them in function prologs and epilogs.",
+    "CPU");
+DEFINE_bool(inline_kernel_intrinsics, true,
+            "Emit the inline implementations some kernel exports have in "
+            "place of calls to them, skipping the call to the host.",
+            "CPU");
 
 namespace xe {
 namespace cpu {
@@ -117,6 +136,13 @@ bool PPCHIRBuilder::Emit(GuestFunction* function, uint32_t flags) {
   // Always mark entry with label.
   label_list_[0] = NewLabel();
 
+  breakpoint_conditions_.clear();
+  if (cvars::debug) {
+    frontend_->processor()->GetInstalledBreakpointConditions(
+        function_->address(), function_->end_address(),
+        breakpoint_conditions_);
+  }
+
   uint32_t start_address = function_->address();
   uint32_t end_address = function_->end_address();
   for (uint32_t address = start_address, offset = 0; address <= end_address;
@@ -200,6 +226,16 @@ bool PPCHIRBuilder::Emit(GuestFunction* function, uint32_t flags) {
 }
 
 void PPCHIRBuilder::MaybeBreakOnInstruction(uint32_t address) {
+  for (const auto& breakpoint_condition : breakpoint_conditions_) {
+    if (breakpoint_condition.first == address) {
+      Comment("Conditional breakpoint");
+      // Trapping with the same ud2 as unconditional breakpoints, in the code
+      // of the instruction for mapping back to the breakpoint address.
+      TrapTrue(EmitBreakpointCondition(breakpoint_condition.second),
+               TRAP_TRUE_BREAKPOINT);
+    }
+  }
+
   if (address != cvars::break_on_instruction) {
     return;
   }
@@ -211,38 +247,50 @@ void PPCHIRBuilder::MaybeBreakOnInstruction(uint32_t address) {
     return;
   }
 
-  auto left = LoadGPR(cvars::break_condition_gpr);
-  auto right = LoadConstantUint64(cvars::break_condition_value);
-  if (cvars::break_condition_truncate) {
+  BreakpointCondition condition;
+  condition.gpr = uint32_t(cvars::break_condition_gpr);
+  condition.value = cvars::break_condition_value;
+  condition.truncate = cvars::break_condition_truncate;
+  if (!BreakpointCondition::ParseOp(cvars::break_condition_op.c_str(),
+                                    condition.op)) {
+    assert_always();
+    return;
+  }
+  TrapTrue(EmitBreakpointCondition(condition));
+}
+
+Value* PPCHIRBuilder::EmitBreakpointCondition(
+    const BreakpointCondition& condition) {
+  auto left = LoadGPR(condition.gpr);
+  auto right = LoadConstantUint64(condition.value);
+  if (condition.truncate) {
     left = Truncate(left, INT32_TYPE);
     right = Truncate(right, INT32_TYPE);
   }
-
-  auto op = cvars::break_condition_op.c_str();
-  // TODO(rick): table?
-  if (xe_strcasecmp(op, "eq") == 0) {
-    TrapTrue(CompareEQ(left, right));
-  } else if (xe_strcasecmp(op, "ne") == 0) {
-    TrapTrue(CompareNE(left, right));
-  } else if (xe_strcasecmp(op, "slt") == 0) {
-    TrapTrue(CompareSLT(left, right));
-  } else if (xe_strcasecmp(op, "sle") == 0) {
-    TrapTrue(CompareSLE(left, right));
-  } else if (xe_strcasecmp(op, "sgt") == 0) {
-    TrapTrue(CompareSGT(left, right));
-  } else if (xe_strcasecmp(op, "sge") == 0) {
-    TrapTrue(CompareSGE(left, right));
-  } else if (xe_strcasecmp(op, "ult") == 0) {
-    TrapTrue(CompareULT(left, right));
-  } else if (xe_strcasecmp(op, "ule") == 0) {
-    TrapTrue(CompareULE(left, right));
-  } else if (xe_strcasecmp(op, "ugt") == 0) {
-    TrapTrue(CompareUGT(left, right));
-  } else if (xe_strcasecmp(op, "uge") == 0) {
-    TrapTrue(CompareUGE(left, right));
-  } else {
-    assert_always();
+  switch (condition.op) {
+    case BreakpointCondition::Op::kEQ:
+      return CompareEQ(left, right);
+    case BreakpointCondition::Op::kNE:
+      return CompareNE(left, right);
+    case BreakpointCondition::Op::kSLT:
+      return CompareSLT(left, right);
+    case BreakpointCondition::Op::kSLE:
+      return CompareSLE(left, right);
+    case BreakpointCondition::Op::kSGT:
+      return CompareSGT(left, right);
+    case BreakpointCondition::Op::kSGE:
+      return CompareSGE(left, right);
+    case BreakpointCondition::Op::kULT:
+      return CompareULT(left, right);
+    case BreakpointCondition::Op::kULE:
+      return CompareULE(left, right);
+    case BreakpointCondition::Op::kUGT:
+      return CompareUGT(left, right);
+    case BreakpointCondition::Op::kUGE:
+      return CompareUGE(left, right);
   }
+  assert_unhandled_case(condition.op);
+  return CompareEQ(left, right);
 }
 
 void PPCHIRBuilder::AnnotateLabel(uint32_t address, Label* label) {
@@ -294,6 +342,155 @@ Label* PPCHIRBuilder::LookupLabel(uint32_t address) {
   return label;
 }
 
+bool PPCHIRBuilder::TryInlineLeafFunction(Function* function) {
+  uint32_t max_instructions = cvars::inline_leaf_function_max_instructions;
+  if (!max_instructions || !function || !function->is_guest() ||
+      function->behavior() != Function::Behavior::kDefault ||
+      function->IsSaverest() || function == function_) {
+    return false;
+  }
+  // Coverage tracing indexes counters by the offset in the traced function.
+  if (cvars::trace_function_coverage) {
+    return false;
+  }
+
+  Memory* memory = frontend_->memory();
+  uint32_t address = function->address();
+  if (!function->module()->ContainsAddress(address)) {
+    return false;
+  }
+
+  // Only straight-line code with no control, sync or branch instructions
+  // (which also rules out mflr/mtlr and nested calls) can be inlined.
+  uint32_t count = 0;
+  while (true) {
+    if (count >= max_instructions ||
+        !function->module()->ContainsAddress(address + count * 4)) {
+      return false;
+    }
+    uint32_t code = xe::load_and_swap<uint32_t>(
+        memory->TranslateVirtual(address + count * 4));
+    ++count;
+    if (code == 0x4E800020) {
+      // blr
+      break;
+    }
+    auto opcode = LookupOpcode(code);
+    if (opcode == PPCOpcode::kInvalid) {
+      return false;
+    }
+    auto& opcode_info = GetOpcodeInfo(opcode);
+    if (!opcode_info.emit || opcode_info.type != PPCOpcodeType::kGeneral ||
+        opcode_info.group == PPCOpcodeGroup::kB ||
+        opcode_info.group == PPCOpcodeGroup::kC) {
+      return false;
+    }
+  }
+
+  if (with_debug_info_) {
+    CommentFormat("inlined {:08X} {}", address, function->name());
+  }
+  // The final blr would return to LR, which is where we are already going.
+  EmitInlinedInstructions(address, count - 1);
+  return true;
+}
+
+bool PPCHIRBuilder::TryInlineSaveRestore(Function* function, bool lk) {
+  if (!cvars::inline_save_restore_helpers || !function ||
+      !function->IsSaverest()) {
+    return false;
+  }
+  if (cvars::trace_function_coverage) {
+    return false;
+  }
+  // __restgprlr_* load LR from the stack and return to it, so they can only
+  // be inlined in place of a tail branch, which they're always used as.
+  bool writes_lr = function->IsRestore() &&
+                   function->SaverestType() == SaveRestoreType::GPR;
+  if (lk && writes_lr) {
+    return false;
+  }
+
+  // The helpers are straight-line code ending with blr, FindSaveRest has
+  // matched all of it.
+  Memory* memory = frontend_->memory();
+  uint32_t address = function->address();
+  uint32_t count = 0;
+  while (true) {
+    if (!function->module()->ContainsAddress(address + count * 4)) {
+      return false;
+    }
+    uint32_t code = xe::load_and_swap<uint32_t>(
+        memory->TranslateVirtual(address + count * 4));
+    ++count;
+    if (code == 0x4E800020) {
+      // blr
+      break;
+    }
+  }
+
+  if (with_debug_info_) {
+    CommentFormat("inlined {:08X} {}", address, function->name());
+  }
+  // With LR set to the return address by the call, the final blr would return
+  // to the next instruction. For a tail branch, it's the return of the caller.
+  EmitInlinedInstructions(address, lk ? count - 1 : count);
+  return true;
+}
+
+void PPCHIRBuilder::EmitInlinedInstructions(uint32_t address,
+                                            uint32_t count) {
+  Memory* memory = frontend_->memory();
+  // Inlined instructions get no SOURCE_OFFSET, as they're not part of this
+  // function's address range.
+  for (uint32_t n = 0; n < count; ++n) {
+    trace_info_.dest_count = 0;
+    uint32_t instr_address = address + n * 4;
+    uint32_t code =
+        xe::load_and_swap<uint32_t>(memory->TranslateVirtual(instr_address));
+    auto opcode = LookupOpcode(code);
+    if (with_debug_info_) {
+      comment_buffer_.Reset();
+      comment_buffer_.AppendFormat("{:08X} {:08X} ", instr_address, code);
+      DisasmPPC(instr_address, code, &comment_buffer_);
+      Comment(comment_buffer_);
+    }
+    MaybeBreakOnInstruction(instr_address);
+    InstrData i;
+    i.address = instr_address;
+    i.code = code;
+    i.opcode = opcode;
+    i.opcode_info = &GetOpcodeInfo(opcode);
+    if (!i.opcode_info->emit || i.opcode_info->emit(*this, i)) {
+      // Part of the body may already be emitted, so there's no going back to
+      // a call here.
+      XELOGE("Unimplemented instr {:08X} {:08X} in inlined function",
+             instr_address, code);
+      Comment("UNIMPLEMENTED!");
+      if (cvars::break_on_unimplemented_instructions) {
+        DebugBreak();
+      }
+    }
+  }
+  trace_info_.dest_count = 0;
+}
+
+bool PPCHIRBuilder::TryEmitExportIntrinsic(Function* function) {
+  if (!cvars::inline_kernel_intrinsics || !function || !function->is_guest() ||
+      function->behavior() != Function::Behavior::kExtern) {
+    return false;
+  }
+  Export* export_data = static_cast<GuestFunction*>(function)->export_data();
+  if (!export_data || export_data->get_type() != Export::Type::kFunction ||
+      !export_data->function_data.intrinsic) {
+    return false;
+  }
+  if (with_debug_info_) {
+    CommentFormat("intrinsic {}", export_data->name);
+  }
+  return export_data->function_data.intrinsic(*this);
+}
+
 // Value* PPCHIRBuilder::LoadXER() {
 //}
 //
@@ -597,7 +794,9 @@ void PPCHIRBuilder::SetReturnAddress(Value* value) {
       if (xexmod) {
         auto flags = xexmod->GetInstructionAddressFlags(value->AsUint32());
         if (flags) {
-          flags->is_return_site = true;
+          InfoCacheFlags return_site = {};
+          return_site.is_return_site = 1;
+          flags->Set(return_site);
         }
       }
     }
@@ -10,7 +10,11 @@
 #ifndef XENIA_CPU_PPC_PPC_HIR_BUILDER_H_
 #define XENIA_CPU_PPC_PPC_HIR_BUILDER_H_
 
+#include <utility>
+#include <vector>
+
 #include "xenia/base/string_buffer.h"
+#include "xenia/cpu/breakpoint_condition.h"
 #include "xenia/cpu/function.h"
 #include "xenia/cpu/hir/hir_builder.h"
 
@@ -43,6 +47,19 @@ class PPCHIRBuilder : public hir::HIRBuilder {
   GuestFunction* function() const { return function_; }
   Function* LookupFunction(uint32_t address);
   Label* LookupLabel(uint32_t address);
+  // Emits the body of the called function in place of the call if it's a
+  // small leaf (straight-line code ending with blr that doesn't touch LR or
+  // any other control registers). LR must already be set to the return
+  // address. Returns false if the function can't be inlined.
+  bool TryInlineLeafFunction(Function* function);
+  // Emits the body of the register save / restore helper found by
+  // FindSaveRest in place of the call (if lk) or the tail branch to it.
+  // Returns false if the function is not one or can't be inlined there.
+  bool TryInlineSaveRestore(Function* function, bool lk);
+  // Emits the intrinsic the kernel registered for the export in place of the
+  // call if the function is an import thunk of one. Returns false if the call
+  // has to be made.
+  bool TryEmitExportIntrinsic(Function* function);
 
   Value* LoadLR();
   void StoreLR(Value* value);
@@ -86,6 +103,11 @@ class PPCHIRBuilder : public hir::HIRBuilder {
 
  private:
   void MaybeBreakOnInstruction(uint32_t address);
+  // Returns whether the condition is true, as an INT8_TYPE value.
+  Value* EmitBreakpointCondition(const BreakpointCondition& condition);
+  // Emits the guest instructions at the address in place, without source
+  // offsets, for inlining.
+  void EmitInlinedInstructions(uint32_t address, uint32_t count);
   void AnnotateLabel(uint32_t address, Label* label);
 
   PPCFrontend* frontend_;
@@ -100,6 +122,8 @@ class PPCHIRBuilder : public hir::HIRBuilder {
   uint64_t instr_count_;
   Instr** instr_offset_list_;
   Label** label_list_;
+  // Installed conditional breakpoints within the function.
+  std::vector<std::pair<uint32_t, BreakpointCondition>> breakpoint_conditions_;
 
   // Reset each instruction.
   struct {
@@ -9,15 +9,22 @@
 
 #include "xenia/cpu/ppc/ppc_translator.h"
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+
 #include "xenia/base/assert.h"
 #include "xenia/base/byte_order.h"
+#include "xenia/base/clock.h"
 #include "xenia/base/cvar.h"
+#include "xenia/base/logging.h"
 #include "xenia/base/memory.h"
 #include "xenia/base/profiling.h"
 #include "xenia/base/reset_scope.h"
 #include "xenia/base/string.h"
 #include "xenia/cpu/compiler/compiler_passes.h"
 #include "xenia/cpu/cpu_flags.h"
+#include "xenia/cpu/ppc/ppc_context.h"
 #include "xenia/cpu/ppc/ppc_frontend.h"
 #include "xenia/cpu/ppc/ppc_hir_builder.h"
 #include "xenia/cpu/ppc/ppc_opcode_info.h"
@@ -33,6 +40,16 @@ DEFINE_bool(disable_context_promotion, false,
             "some sports games, but will reduce performance.",
             "CPU");
 
+DEFINE_bool(disable_dead_flag_elimination, false,
+            "Disables removal of CR and XER flag updates that are overwritten "
+            "before being read.",
+            "CPU");
+
+DEFINE_bool(disable_loop_invariant_code_motion, false,
+            "Disables hoisting of invariant instructions out of single-block "
+            "guest loops.",
+            "CPU");
+
 namespace xe {
 namespace cpu {
 namespace ppc {
@@ -92,9 +109,31 @@ PPCTranslator::PPCTranslator(PPCFrontend* frontend) : frontend_(frontend) {
   // compiler_->AddPass(std::make_unique<passes::DeadStoreEliminationPass>());
   // if (validate)
   // compiler_->AddPass(std::make_unique<passes::ValidationPass>());
+  if (!cvars::disable_dead_flag_elimination) {
+    // Leaves the flag computations for DCE to clean up.
+    compiler_->AddPass(std::make_unique<passes::DeadFlagEliminationPass>());
+    if (validate)
+      compiler_->AddPass(std::make_unique<passes::ValidationPass>());
+  }
   compiler_->AddPass(std::make_unique<passes::DeadCodeEliminationPass>());
   if (validate) compiler_->AddPass(std::make_unique<passes::ValidationPass>());
 
+  if (!cvars::disable_loop_invariant_code_motion) {
+    // Earlier passes may have folded branches, so refresh the edges first.
+    compiler_->AddPass(std::make_unique<passes::ControlFlowAnalysisPass>());
+    compiler_->AddPass(std::make_unique<passes::LoopInvariantCodeMotionPass>());
+    if (validate)
+      compiler_->AddPass(std::make_unique<passes::ValidationPass>());
+  }
+
+  if (cvars::jit_tiered_compilation && cvars::jit_trace_formation) {
+    // Uses the branch hints from the baseline code's branch counters, so only
+    // hot retranslations are affected.
+    compiler_->AddPass(std::make_unique<passes::TraceFormationPass>());
+    if (validate)
+      compiler_->AddPass(std::make_unique<passes::ValidationPass>());
+  }
+
   //// Removes all unneeded variables. Try not to add new ones after this.
   // compiler_->AddPass(new passes::ValueReductionPass());
   // if (validate) compiler_->AddPass(new passes::ValidationPass());
@@ -109,10 +148,87 @@ PPCTranslator::PPCTranslator(PPCFrontend* frontend) : frontend_(frontend) {
 
   // Must come last. The HIR is not really HIR after this.
   compiler_->AddPass(std::make_unique<passes::FinalizationPass>());
+
+  if (cvars::jit_tiered_compilation) {
+    // The backend requires constants to be folded and registers to be
+    // allocated, everything else is left for the hot retranslation.
+    baseline_compiler_.reset(new Compiler(frontend->processor()));
+    baseline_compiler_->AddPass(
+        std::make_unique<passes::ConstantPropagationPass>());
+    baseline_compiler_->AddPass(std::make_unique<passes::SimplificationPass>());
+    if (validate) {
+      baseline_compiler_->AddPass(std::make_unique<passes::ValidationPass>());
+    }
+    baseline_compiler_->AddPass(
+        std::make_unique<passes::RegisterAllocationPass>(
+            backend->machine_info()));
+    baseline_compiler_->AddPass(std::make_unique<passes::FinalizationPass>());
+  }
 }
 
 PPCTranslator::~PPCTranslator() = default;
 
+static uint32_t CountHIRInstructions(hir::HIRBuilder* builder) {
+  uint32_t count = 0;
+  for (auto block = builder->first_block(); block; block = block->next) {
+    for (auto instr = block->instr_head; instr; instr = instr->next) {
+      ++count;
+    }
+  }
+  return count;
+}
+
+// Accesses by the optimized HIR, by the context offset they start at.
+static std::array<std::atomic<uint64_t>, sizeof(PPCContext)>
+    context_access_counts_;
+
+static void CountContextAccesses(hir::HIRBuilder* builder) {
+  for (auto block = builder->first_block(); block; block = block->next) {
+    for (auto instr = block->instr_head; instr; instr = instr->next) {
+      if (instr->opcode != &hir::OPCODE_LOAD_CONTEXT_info &&
+          instr->opcode != &hir::OPCODE_STORE_CONTEXT_info) {
+        continue;
+      }
+      if (instr->src1.offset < context_access_counts_.size()) {
+        context_access_counts_[size_t(instr->src1.offset)].fetch_add(
+            1, std::memory_order_relaxed);
+      }
+    }
+  }
+}
+
+void PPCTranslator::LogContextAccessStats() {
+  std::array<uint64_t, sizeof(PPCContext)> counts;
+  std::array<uint32_t, sizeof(PPCContext)> offsets;
+  uint64_t total_count = 0;
+  uint64_t disp8_count = 0;
+  for (uint32_t offset = 0; offset < counts.size(); ++offset) {
+    uint64_t count = context_access_counts_[offset].load();
+    counts[offset] = count;
+    offsets[offset] = offset;
+    total_count += count;
+    // The context register points to the start of the context.
+    if (offset < 0x80) {
+      disp8_count += count;
+    }
+  }
+  if (!total_count) {
+    return;
+  }
+  std::stable_sort(
+      offsets.begin(), offsets.end(),
+      [&counts](uint32_t a, uint32_t b) { return counts[a] > counts[b]; });
+  XELOGI(
+      "Context accesses: {}, {:.1f}% with 8-bit displacements; most "
+      "accessed fields:",
+      total_count, double(disp8_count) * 100.0 / double(total_count));
+  for (size_t i = 0; i < 32 && counts[offsets[i]]; ++i) {
+    uint32_t offset = offsets[i];
+    XELOGI("  +{:03X} (cache line {}) {}: {}", offset, offset / 64,
+           PPCContext::GetFieldName(offset), counts[offset]);
+  }
+}
+
 class HirBuilderScope {
   PPCHIRBuilder* builder_;
 
@@ -169,6 +285,7 @@ bool PPCTranslator::Translate(GuestFunction* function,
   // Reset() all caching when we leave.
   xe::make_reset_scope(builder_);
   xe::make_reset_scope(compiler_);
+  xe::make_reset_scope(baseline_compiler_);
   xe::make_reset_scope(assembler_);
   xe::make_reset_scope(&string_buffer_);
 
@@ -188,6 +305,9 @@ bool PPCTranslator::Translate(GuestFunction* function,
   if (cvars::trace_function_data) {
     debug_info_flags |= DebugInfoFlags::kDebugInfoTraceFunctionData;
   }
+  bool gather_stats = cvars::jit_function_stats;
+  uint64_t start_ticks = gather_stats ? Clock::QueryHostTickCount() : 0;
+
   std::unique_ptr<FunctionDebugInfo> debug_info;
   if (debug_info_flags) {
     debug_info.reset(new FunctionDebugInfo());
@@ -243,9 +363,26 @@ bool PPCTranslator::Translate(GuestFunction* function,
   }
 
   // Compile/optimize/etc.
-  if (!compiler_->Compile(builder_.get())) {
+  // Save/restore helpers are special-cased by callers and must never be
+  // swapped out, so they always get the full pipeline.
+  bool baseline =
+      baseline_compiler_ && !function->is_hot() && !function->IsSaverest();
+  function->set_baseline(baseline);
+  if (baseline) {
+    *function->hot_counter() =
+        std::max(cvars::jit_hot_function_threshold, uint32_t(1));
+  }
+  uint32_t hir_instr_count_before =
+      gather_stats ? CountHIRInstructions(builder_.get()) : 0;
+  Compiler* compiler = baseline ? baseline_compiler_.get() : compiler_.get();
+  if (!compiler->Compile(builder_.get())) {
     return false;
   }
+  uint32_t hir_instr_count_after =
+      gather_stats ? CountHIRInstructions(builder_.get()) : 0;
+  if (cvars::jit_context_access_stats) {
+    CountContextAccesses(builder_.get());
+  }
 
   // Stash optimized HIR.
   if (debug_info_flags & DebugInfoFlags::kDebugInfoDisasmHir) {
@@ -262,6 +399,17 @@ bool PPCTranslator::Translate(GuestFunction* function,
     return false;
   }
 
+  if (gather_stats) {
+    auto& stats = function->jit_stats();
+    stats.compile_time_us = (Clock::QueryHostTickCount() - start_ticks) *
+                            1000000 / Clock::QueryHostTickFrequency();
+    stats.total_compile_time_us += stats.compile_time_us;
+    ++stats.translation_count;
+    stats.hir_instr_count_before = hir_instr_count_before;
+    stats.hir_instr_count_after = hir_instr_count_after;
+    stats.machine_code_length = uint32_t(function->machine_code_length());
+  }
+
   return true;
 }
 void PPCTranslator::Reset() { builder_->ResetPools(); }
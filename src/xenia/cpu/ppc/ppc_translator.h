@@ -34,6 +34,10 @@ class PPCTranslator {
   void DumpHIR(GuestFunction* function, PPCHIRBuilder* builder);
   void Reset();
 
+  // Logs the context fields accessed most by the code translated by all the
+  // translators with --jit_context_access_stats.
+  static void LogContextAccessStats();
+
  private:
   void DumpSource(GuestFunction* function, StringBuffer* string_buffer);
 
@@ -41,6 +45,9 @@ class PPCTranslator {
   std::unique_ptr<PPCScanner> scanner_;
   std::unique_ptr<PPCHIRBuilder> builder_;
   std::unique_ptr<compiler::Compiler> compiler_;
+  // Minimal pass set used for the first translation of a function when
+  // jit_tiered_compilation is enabled, null otherwise.
+  std::unique_ptr<compiler::Compiler> baseline_compiler_;
   std::unique_ptr<backend::Assembler> assembler_;
 
   StringBuffer string_buffer_;
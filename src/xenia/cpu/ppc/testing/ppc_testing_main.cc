@@ -8,6 +8,7 @@
  */
 
 #include "xenia/base/console_app_main.h"
+#include "xenia/base/clock.h"
 #include "xenia/base/cvar.h"
 #include "xenia/base/filesystem.h"
 #include "xenia/base/literals.h"
@@ -15,6 +16,7 @@
 #include "xenia/base/math.h"
 #include "xenia/base/platform.h"
 #include "xenia/base/string_buffer.h"
+#include "xenia/cpu/compiler/compiler.h"
 #include "xenia/cpu/cpu_flags.h"
 #include "xenia/cpu/ppc/ppc_context.h"
 #include "xenia/cpu/ppc/ppc_frontend.h"
@@ -34,6 +36,10 @@ DEFINE_path(test_path, "src/xenia/cpu/ppc/testing/",
 DEFINE_path(test_bin_path, "src/xenia/cpu/ppc/testing/bin/",
             "Directory with binary outputs of the test files.", "Other");
 DEFINE_transient_string(test_name, "", "Test suite name.", "General");
+DEFINE_transient_bool(count_hir_instructions, false,
+                      "Report the number of HIR instructions the tests "
+                      "compile to, to compare the effects of compiler passes.",
+                      "Other");
 
 namespace xe {
 namespace cpu {
@@ -260,6 +266,12 @@ class TestRunner {
       return false;
     }
 
+    if (fn->is_guest()) {
+      auto& stats = static_cast<GuestFunction*>(fn)->jit_stats();
+      hir_instr_count_before_ += stats.hir_instr_count_before;
+      hir_instr_count_after_ += stats.hir_instr_count_after;
+    }
+
     auto ctx = thread_state_->context();
     ctx->lr = 0xBCBCBCBC;
     fn->Call(thread_state_.get(), uint32_t(ctx->lr));
@@ -368,7 +380,12 @@ class TestRunner {
     return !any_failed;
   }
 
+  uint64_t hir_instr_count_before() const { return hir_instr_count_before_; }
+  uint64_t hir_instr_count_after() const { return hir_instr_count_after_; }
+
   size_t memory_size_;
+  uint64_t hir_instr_count_before_ = 0;
+  uint64_t hir_instr_count_after_ = 0;
   std::unique_ptr<Memory> memory_;
   std::unique_ptr<Processor> processor_;
   std::unique_ptr<ThreadState> thread_state_;
@@ -460,6 +477,10 @@ bool RunTests(const std::string_view test_name) {
   }
 
   XELOGI("{} tests loaded.", test_suites.size());
+  if (cvars::count_hir_instructions) {
+    // Instruction counts are only gathered along with the other stats.
+    cvars::jit_function_stats = true;
+  }
   TestRunner runner;
   for (auto& test_suite : test_suites) {
     XELOGI("{}.s:", test_suite.name());
@@ -477,6 +498,15 @@ bool RunTests(const std::string_view test_name) {
   XELOGI("Total tests: {}", failed_count + passed_count);
   XELOGI("Passed: {}", passed_count);
   XELOGI("Failed: {}", failed_count);
+  if (cvars::count_hir_instructions) {
+    XELOGI("HIR instructions: {} before optimization, {} after",
+           runner.hir_instr_count_before(), runner.hir_instr_count_after());
+    uint64_t tick_frequency = Clock::QueryHostTickFrequency();
+    for (const auto& pass_stats : compiler::Compiler::GetPassStats()) {
+      XELOGI("  {}: {} runs, {} us", pass_stats.name, pass_stats.run_count,
+             pass_stats.ticks * 1000000 / tick_frequency);
+    }
+  }
 
   return failed_count ? false : true;
 }
@@ -27,4 +27,45 @@ filter({"configurations:Release", "platforms:Windows"})
 buildoptions({
   "/Os",
   "/O1"
-})
\ No newline at end of file
+})
+
+group("src")
+project("xenia-cpu-xex-precompile")
+  uuid("8e3f5b21-6c4a-4d97-b0e2-3a9c7d51f864")
+  kind("ConsoleApp")
+  language("C++")
+  links({
+    "xenia-apu",
+    "xenia-base",
+    "xenia-core",
+    "xenia-cpu",
+    "xenia-gpu",
+    "xenia-gpu-null",
+    "xenia-hid",
+    "xenia-kernel",
+    "xenia-ui",
+    "xenia-vfs",
+    "xenia-patcher",
+  })
+  links({
+    "aes_128",
+    "capstone",
+    "fmt",
+    "imgui",
+    "libavcodec",
+    "libavformat",
+    "libavutil",
+    "mspack",
+    "snappy",
+    "xxhash",
+    "zstd",
+  })
+  files({
+    "xex_precompile_main.cc",
+    "../base/console_app_main_"..platform_suffix..".cc",
+  })
+  filter("architecture:x86_64")
+    links({
+      "xenia-cpu-backend-x64",
+    })
+  filter({})
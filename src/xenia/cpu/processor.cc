@@ -9,6 +9,8 @@
 
 #include "xenia/cpu/processor.h"
 
+#include <algorithm>
+
 #include "xenia/base/assert.h"
 #include "xenia/base/atomic.h"
 #include "xenia/base/byte_order.h"
@@ -16,12 +18,15 @@
 #include "xenia/base/cvar.h"
 #include "xenia/base/debugging.h"
 #include "xenia/base/exception_handler.h"
+#include "xenia/base/filesystem.h"
+#include "xenia/base/frame_timeline.h"
 #include "xenia/base/literals.h"
 #include "xenia/base/logging.h"
 #include "xenia/base/memory.h"
 #include "xenia/base/platform.h"
 #include "xenia/base/profiling.h"
 #include "xenia/base/threading.h"
+#include "xenia/cpu/backend/code_cache.h"
 #include "xenia/cpu/breakpoint.h"
 #include "xenia/cpu/cpu_flags.h"
 #include "xenia/cpu/export_resolver.h"
@@ -48,6 +53,17 @@ DEFINE_path(trace_function_data_path, "", "File to write trace data to.",
             "CPU");
 DEFINE_bool(break_on_start, false, "Break into the debugger on startup.",
             "CPU");
+DEFINE_bool(sample_guest_threads, false,
+            "Periodically sample the call stacks of guest threads and write a "
+            "flamegraph-compatible profile (<title id>.folded) and a list of "
+            "the hottest guest instructions on exit. Much cheaper than "
+            "--instrument_call_times. Windows only for now.",
+            "CPU");
+DEFINE_int32(sample_guest_threads_interval_ms, 1,
+             "Interval between guest thread samples, in milliseconds.", "CPU");
+DEFINE_path(sample_guest_threads_path, "profiles",
+            "Directory the --sample_guest_threads profiles are written to.",
+            "CPU");
 
 namespace xe {
 namespace kernel {
@@ -86,6 +102,30 @@ Processor::Processor(xe::Memory* memory, ExportResolver* export_resolver)
     : memory_(memory), export_resolver_(export_resolver) {}
 
 Processor::~Processor() {
+  WriteSamplingProfile();
+  if (cvars::jit_function_stats && !cvars::jit_function_stats_path.empty()) {
+    DumpFunctionStats(cvars::jit_function_stats_path);
+  }
+
+  // Stop retranslating before the functions go away with their modules.
+  if (hot_function_thread_) {
+    {
+      std::lock_guard<xe_mutex> lock(hot_function_lock_);
+      hot_function_thread_shutdown_ = true;
+    }
+    hot_function_cond_.notify_all();
+    xe::threading::Wait(hot_function_thread_.get(), false);
+    hot_function_thread_.reset();
+  }
+
+  // After retranslation has stopped adding block counters.
+  StoreBlockProfile();
+
+  if (cvars::invalidate_modified_code && backend_ &&
+      backend_->code_cache()) {
+    memory_->SetCodeWriteCallback(nullptr, nullptr);
+  }
+
   {
     auto global_lock = global_critical_region_.Acquire();
     modules_.clear();
@@ -145,6 +185,10 @@ bool Processor::Setup(std::unique_ptr<backend::Backend> backend) {
       XELOGW("Disabling --debug due to lack of stack walker");
       cvars::debug = false;
     }
+    if (cvars::jit_code_reclamation) {
+      XELOGW(
+          "Dead generated code won't be reclaimed due to lack of stack walker");
+    }
   }
 
   // Open the trace data path, if requested.
@@ -154,6 +198,23 @@ bool Processor::Setup(std::unique_ptr<backend::Backend> backend) {
         ChunkedMappedMemoryWriter::Open(functions_trace_path_, 32_MiB, true);
   }
 
+  if (cvars::invalidate_modified_code) {
+    if (code_cache) {
+      memory_->SetCodeWriteCallback(CodeWriteCallbackThunk, this);
+    } else {
+      XELOGW("Modified guest code can't be invalidated without a code cache");
+    }
+  }
+
+  if (cvars::jit_tiered_compilation) {
+    xe::threading::Thread::CreationParameters params;
+    params.initial_priority = xe::threading::ThreadPriority::kBelowNormal;
+    hot_function_thread_ = xe::threading::Thread::Create(
+        params, [this]() { HotFunctionThreadMain(); });
+    assert_not_null(hot_function_thread_);
+    hot_function_thread_->set_name("JIT Hot Functions");
+  }
+
   return true;
 }
 
@@ -167,6 +228,40 @@ void Processor::PreLaunch() {
     // Start running.
     execution_state_ = ExecutionState::kRunning;
   }
+
+  if (cvars::sample_guest_threads && !sampling_profiler_) {
+    sampling_profiler_ = std::make_unique<SamplingProfiler>(this);
+    if (!sampling_profiler_->Start(std::chrono::milliseconds(
+            cvars::sample_guest_threads_interval_ms))) {
+      sampling_profiler_.reset();
+    }
+  }
+}
+
+void Processor::WriteSamplingProfile() {
+  if (!sampling_profiler_) {
+    return;
+  }
+  sampling_profiler_->Stop();
+
+  // Name the profile after the title, falling back to the module name.
+  std::string base_name = "profile";
+  for (auto module : GetModules()) {
+    if (!module->is_executable()) {
+      continue;
+    }
+    auto xex_module = dynamic_cast<XexModule*>(module);
+    auto execution_info =
+        xex_module ? xex_module->opt_execution_info() : nullptr;
+    if (execution_info) {
+      base_name = fmt::format("{:08X}", uint32_t(execution_info->title_id));
+    } else {
+      base_name = module->name();
+    }
+    break;
+  }
+  sampling_profiler_->WriteReport(cvars::sample_guest_threads_path, base_name);
+  sampling_profiler_.reset();
 }
 
 bool Processor::AddModule(std::unique_ptr<Module> module) {
@@ -188,11 +283,24 @@ void Processor::RemoveModule(const std::string_view name) {
     const std::vector<uint32_t> addressed_functions =
         (*itr)->GetAddressedFunctions();
 
+    auto code_cache = backend_->code_cache();
+    if (code_cache) {
+      std::vector<GuestFunction*> guest_functions;
+      (*itr)->ForEachFunction([&guest_functions](Function* function) {
+        if (function->is_guest()) {
+          guest_functions.push_back(static_cast<GuestFunction*>(function));
+        }
+      });
+      code_cache->RetireFunctionCode(guest_functions);
+    }
+
     modules_.erase(itr);
 
     for (const uint32_t entry : addressed_functions) {
       RemoveFunctionByAddress(entry);
     }
+
+    ReclaimRetiredCode();
   }
 }
 
@@ -241,8 +349,9 @@ Function* Processor::QueryFunction(uint32_t address) {
   return entry->function;
 }
 
-std::vector<Function*> Processor::FindFunctionsWithAddress(uint32_t address) {
-  return entry_table_.FindWithAddress(address);
+std::vector<Function*> Processor::FindFunctionsWithAddress(uint32_t address,
+                                                           uint32_t length) {
+  return entry_table_.FindWithAddress(address, length);
 }
 
 void Processor::RemoveFunctionByAddress(uint32_t address) {
@@ -274,13 +383,16 @@ Function* Processor::ResolveFunction(uint32_t address) {
     if (xexmod) {
       auto addr_flags = xexmod->GetInstructionAddressFlags(address);
       if (addr_flags) {
-        addr_flags->was_resolved = 1;
+        InfoCacheFlags resolved = {};
+        resolved.was_resolved = 1;
+        addr_flags->Set(resolved);
       }
     }
 
     entry->function = function;
     entry->end_address = function->end_address();
-    status = entry->status = Entry::STATUS_READY;
+    entry_table_.Publish(entry);
+    status = Entry::STATUS_READY;
   }
   if (status == Entry::STATUS_READY) {
     // Ready to use.
@@ -332,6 +444,184 @@ Function* Processor::LookupFunction(Module* module, uint32_t address) {
   return function;
 }
 
+void Processor::QueueHotFunction(GuestFunction* function) {
+  if (!hot_function_thread_) {
+    return;
+  }
+  {
+    std::lock_guard<xe_mutex> lock(hot_function_lock_);
+    if (function->is_hot()) {
+      return;
+    }
+    function->set_hot(true);
+    hot_function_queue_.push_back(function);
+  }
+  hot_function_cond_.notify_one();
+  MarkFunctionHot(function->address());
+}
+
+void Processor::MarkFunctionHot(uint32_t address) {
+  auto xexmod = dynamic_cast<XexModule*>(LookupModule(address));
+  if (xexmod) {
+    auto addr_flags = xexmod->GetInstructionAddressFlags(address);
+    if (addr_flags) {
+      InfoCacheFlags hot = {};
+      hot.is_hot = 1;
+      addr_flags->Set(hot);
+    }
+  }
+}
+
+void Processor::HotFunctionThreadMain() {
+  while (true) {
+    GuestFunction* function;
+    {
+      std::unique_lock<xe_mutex> lock(hot_function_lock_);
+      while (hot_function_queue_.empty() && !hot_function_thread_shutdown_) {
+        hot_function_cond_.wait(lock);
+      }
+      if (hot_function_thread_shutdown_) {
+        return;
+      }
+      function = hot_function_queue_.front();
+      hot_function_queue_.pop_front();
+    }
+    // The backend swaps the new code in when it's placed, callers already
+    // running the baseline code will simply finish with it.
+    if (!frontend_->DefineFunction(function, debug_info_flags_)) {
+      XELOGW("Failed to retranslate hot function {:08X}, keeping baseline code",
+             function->address());
+    }
+    ReclaimRetiredCode();
+  }
+}
+
+void Processor::ReclaimRetiredCode() {
+  auto code_cache = backend_->code_cache();
+  if (!cvars::jit_code_reclamation || !code_cache || !stack_walker_ ||
+      code_cache->retired_code_size() <
+          size_t(cvars::jit_code_reclamation_threshold) * 1024 * 1024) {
+    return;
+  }
+  auto global_lock = global_critical_region_.Acquire();
+  if (execution_state_ != ExecutionState::kRunning) {
+    // When paused, the threads are owned by the debugger.
+    return;
+  }
+  // Holding the global lock keeps threads from being destroyed under us, and
+  // guarantees no suspended thread owns it.
+  std::vector<Thread*> suspended_threads;
+  code_cache->ReclaimRetiredCode([this, &suspended_threads](
+                                     std::vector<uint64_t>& host_pcs) {
+    uint64_t frame_host_pcs[256];
+    // The caller may be a guest thread too, such as one unloading a module.
+    size_t count = stack_walker_->CaptureStackTrace(
+        frame_host_pcs, 0, xe::countof(frame_host_pcs));
+    if (count >= xe::countof(frame_host_pcs)) {
+      return false;
+    }
+    host_pcs.insert(host_pcs.end(), frame_host_pcs, frame_host_pcs + count);
+    for (auto& it : thread_debug_infos_) {
+      auto thread_info = it.second.get();
+      auto thread = thread_info->thread;
+      if (!thread || thread_info->state == ThreadDebugInfo::State::kExited ||
+          thread_info->state == ThreadDebugInfo::State::kZombie ||
+          (Thread::IsInThread() &&
+           thread_info->thread_id == Thread::GetCurrentThreadId())) {
+        continue;
+      }
+      // Host threads are included too, as they may be running guest
+      // callbacks.
+      if (!thread->thread()->Suspend()) {
+        return false;
+      }
+      suspended_threads.push_back(thread);
+      count = stack_walker_->CaptureStackTrace(
+          thread->thread()->native_handle(), frame_host_pcs, 0,
+          xe::countof(frame_host_pcs), nullptr, nullptr);
+      if (!count || count >= xe::countof(frame_host_pcs)) {
+        // Frames past the walked ones may be in the retired code.
+        return false;
+      }
+      host_pcs.insert(host_pcs.end(), frame_host_pcs, frame_host_pcs + count);
+    }
+    return true;
+  });
+  for (Thread* thread : suspended_threads) {
+    thread->thread()->Resume();
+  }
+}
+
+std::vector<GuestFunction*> Processor::QueryTranslatedFunctions() {
+  std::vector<GuestFunction*> functions;
+  for (auto module : GetModules()) {
+    module->ForEachFunction([&functions](Function* function) {
+      if (function->is_guest() &&
+          function->status() == Symbol::Status::kDefined) {
+        functions.push_back(static_cast<GuestFunction*>(function));
+      }
+    });
+  }
+  return functions;
+}
+
+void Processor::StoreBlockProfile() {
+  if (!cvars::guest_block_profile) {
+    return;
+  }
+  uint32_t block_count = 0;
+  for (GuestFunction* function : QueryTranslatedFunctions()) {
+    auto xexmod = dynamic_cast<XexModule*>(function->module());
+    if (!xexmod) {
+      continue;
+    }
+    for (const auto& block_counter : function->block_counters()) {
+      if (!block_counter.second) {
+        continue;
+      }
+      auto addr_flags = xexmod->GetInstructionAddressFlags(block_counter.first);
+      if (!addr_flags) {
+        continue;
+      }
+      addr_flags->SetBlockFrequency(
+          InfoCacheFlags::GetBlockFrequency(block_counter.second));
+      ++block_count;
+    }
+  }
+  XELOGI("Stored the execution frequencies of {} guest blocks", block_count);
+}
+
+bool Processor::DumpFunctionStats(const std::filesystem::path& path) {
+  auto functions = QueryTranslatedFunctions();
+  std::sort(functions.begin(), functions.end(),
+            [](GuestFunction* a, GuestFunction* b) {
+              return a->address() < b->address();
+            });
+
+  xe::filesystem::CreateParentFolder(path);
+  FILE* file = xe::filesystem::OpenFile(path, "w");
+  if (!file) {
+    XELOGE("Unable to write function stats to {}", xe::path_to_utf8(path));
+    return false;
+  }
+  fmt::print(file,
+             "address,name,translations,compile_us,total_compile_us,"
+             "hir_before,hir_after,code_size,executions,baseline\n");
+  for (auto function : functions) {
+    auto& stats = function->jit_stats();
+    fmt::print(file, "{:08X},{},{},{},{},{},{},{},{},{}\n",
+               function->address(), function->name(), stats.translation_count,
+               stats.compile_time_us, stats.total_compile_time_us,
+               stats.hir_instr_count_before, stats.hir_instr_count_after,
+               stats.machine_code_length, stats.execution_count,
+               function->is_baseline() ? 1 : 0);
+  }
+  fclose(file);
+  XELOGI("Wrote stats for {} functions to {}", functions.size(),
+         xe::path_to_utf8(path));
+  return true;
+}
+
 bool Processor::DemandFunction(Function* function) {
   // Lock function for generation. If it's already being generated
   // by another thread this will block and return DECLARED.
@@ -340,6 +630,8 @@ bool Processor::DemandFunction(Function* function) {
   if (symbol_status == Symbol::Status::kNew) {
     // Symbol is undefined, so define now.
     assert_true(function->is_guest());
+    frame_timeline::ScopedActivity frame_timeline_activity(
+        frame_timeline::Activity::kJitCompile);
     if (!frontend_->DefineFunction(static_cast<GuestFunction*>(function),
                                    debug_info_flags_)) {
       function->set_status(Symbol::Status::kFailed);
@@ -349,6 +641,13 @@ bool Processor::DemandFunction(Function* function) {
     // Before we give the symbol back to the rest, let the debugger know.
     OnFunctionDefined(function);
 
+    if (cvars::invalidate_modified_code) {
+      // Read-only code is watched too, in case the title makes it writable.
+      memory_->WatchCodeWrites(
+          function->address(),
+          function->end_address() - function->address() + 4);
+    }
+
     function->set_status(Symbol::Status::kDefined);
     symbol_status = function->status();
   }
@@ -361,6 +660,44 @@ bool Processor::DemandFunction(Function* function) {
   return true;
 }
 
+size_t Processor::InvalidateFunctionsWithAddress(uint32_t address,
+                                                 uint32_t length) {
+  auto global_lock = global_critical_region_.Acquire();
+  std::vector<GuestFunction*> functions;
+  for (Function* function : FindFunctionsWithAddress(address, length)) {
+    // Functions still being translated will use the current state of the
+    // memory and the breakpoints anyway.
+    if (function->is_guest() &&
+        function->status() == Symbol::Status::kDefined) {
+      functions.push_back(static_cast<GuestFunction*>(function));
+    }
+  }
+  if (functions.empty()) {
+    return 0;
+  }
+  backend_->code_cache()->InvalidateFunctionCode(functions);
+  for (GuestFunction* function : functions) {
+    // Resolved and defined again on the next call.
+    RemoveFunctionByAddress(function->address());
+    function->set_status(Symbol::Status::kDeclared);
+  }
+  return functions.size();
+}
+
+void Processor::InvalidateModifiedCode(uint32_t address, uint32_t length) {
+  size_t function_count = InvalidateFunctionsWithAddress(address, length);
+  if (function_count) {
+    XELOGCPU("Guest code modified at {:08X}, invalidated {} functions",
+             address, function_count);
+  }
+}
+
+void Processor::CodeWriteCallbackThunk(void* context_ptr, uint32_t address,
+                                       uint32_t length) {
+  reinterpret_cast<Processor*>(context_ptr)
+      ->InvalidateModifiedCode(address, length);
+}
+
 bool Processor::Execute(ThreadState* thread_state, uint32_t address) {
   SCOPE_profile_cpu_f("cpu");
 
@@ -372,6 +709,11 @@ bool Processor::Execute(ThreadState* thread_state, uint32_t address) {
     return false;
   }
 
+  return ExecuteFunction(thread_state, function);
+}
+
+bool Processor::ExecuteFunction(ThreadState* thread_state,
+                                Function* function) {
   auto context = thread_state->context();
 
   // Pad out stack a bit, as some games seem to overwrite the caller by about
@@ -410,6 +752,25 @@ uint64_t Processor::Execute(ThreadState* thread_state, uint32_t address,
                             uint64_t args[], size_t arg_count) {
   SCOPE_profile_cpu_f("cpu");
 
+  SetExecuteArguments(thread_state, args, arg_count);
+  if (!Execute(thread_state, address)) {
+    return 0xDEADBABE;
+  }
+  return thread_state->context()->r[3];
+}
+
+uint64_t Processor::ExecuteResolved(ThreadState* thread_state,
+                                    Function* function, uint64_t args[],
+                                    size_t arg_count) {
+  SetExecuteArguments(thread_state, args, arg_count);
+  if (!ExecuteFunction(thread_state, function)) {
+    return 0xDEADBABE;
+  }
+  return thread_state->context()->r[3];
+}
+
+void Processor::SetExecuteArguments(ThreadState* thread_state, uint64_t args[],
+                                    size_t arg_count) {
   auto context = thread_state->context();
   for (size_t i = 0; i < std::min(arg_count, static_cast<size_t>(8)); ++i) {
     context->r[3 + i] = args[i];
@@ -425,11 +786,21 @@ uint64_t Processor::Execute(ThreadState* thread_state, uint32_t address,
                                    (uint32_t)args[i + 8]);
     }
   }
+}
 
-  if (!Execute(thread_state, address)) {
-    return 0xDEADBABE;
+uint64_t GuestCallback::Call(ThreadState* thread_state, uint32_t address,
+                             uint64_t args[], size_t arg_count) {
+  Processor* processor = thread_state->processor();
+  Function* function = function_.load(std::memory_order_acquire);
+  if (!function || function->address() != address) {
+    function = processor->ResolveFunction(address);
+    if (!function) {
+      XELOGCPU("GuestCallback({:08X}): failed to find function", address);
+      return 0xDEADBABE;
+    }
+    function_.store(function, std::memory_order_release);
   }
-  return context->r[3];
+  return processor->ExecuteResolved(thread_state, function, args, arg_count);
 }
 
 bool Processor::Save(ByteStream* stream) {
@@ -576,6 +947,21 @@ Breakpoint* Processor::FindBreakpoint(uint32_t address) {
   return nullptr;
 }
 
+void Processor::GetInstalledBreakpointConditions(
+    uint32_t address_first, uint32_t address_last,
+    std::vector<std::pair<uint32_t, BreakpointCondition>>& conditions_out) {
+  auto global_lock = global_critical_region_.Acquire();
+  for (auto breakpoint : breakpoints_) {
+    if (!breakpoint->is_installed() || !breakpoint->has_condition()) {
+      continue;
+    }
+    uint32_t guest_address = breakpoint->guest_address();
+    if (guest_address >= address_first && guest_address <= address_last) {
+      conditions_out.emplace_back(guest_address, breakpoint->condition());
+    }
+  }
+}
+
 void Processor::set_debug_listener(DebugListener* debug_listener) {
   if (debug_listener == debug_listener_) {
     return;
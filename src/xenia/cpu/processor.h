@@ -10,21 +10,28 @@
 #ifndef XENIA_CPU_PROCESSOR_H_
 #define XENIA_CPU_PROCESSOR_H_
 
+#include <atomic>
+#include <condition_variable>
+#include <deque>
 #include <map>
 #include <memory>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "xenia/base/cvar.h"
 #include "xenia/base/mapped_memory.h"
 #include "xenia/base/mutex.h"
+#include "xenia/base/threading.h"
 #include "xenia/cpu/backend/backend.h"
+#include "xenia/cpu/breakpoint_condition.h"
 #include "xenia/cpu/debug_listener.h"
 #include "xenia/cpu/entry_table.h"
 #include "xenia/cpu/export_resolver.h"
 #include "xenia/cpu/function.h"
 #include "xenia/cpu/module.h"
 #include "xenia/cpu/ppc/ppc_frontend.h"
+#include "xenia/cpu/sampling_profiler.h"
 #include "xenia/cpu/thread_debug_info.h"
 #include "xenia/cpu/thread_state.h"
 #include "xenia/memory.h"
@@ -111,18 +118,40 @@ class Processor {
                           void* arg1);
 
   Function* QueryFunction(uint32_t address);
-  std::vector<Function*> FindFunctionsWithAddress(uint32_t address);
+  std::vector<Function*> FindFunctionsWithAddress(uint32_t address,
+                                                  uint32_t length = 1);
   void RemoveFunctionByAddress(uint32_t address);
+  // Makes the defined guest functions overlapping the range be translated
+  // again on their next call, returning how many have been invalidated. Only
+  // effective for the calls not going through the indirection table if the
+  // functions have patchable entries.
+  size_t InvalidateFunctionsWithAddress(uint32_t address, uint32_t length = 1);
 
   Function* LookupFunction(uint32_t address);
   Module* LookupModule(uint32_t address);
   Function* LookupFunction(Module* module, uint32_t address);
   Function* ResolveFunction(uint32_t address);
 
+  // Queues a function translated with baseline code (jit_tiered_compilation)
+  // that has become hot for retranslation with the full pass pipeline.
+  void QueueHotFunction(GuestFunction* function);
+  // Records that the function at the given address is hot in its module's
+  // instruction infocache, for profile_guided_code_layout in later runs.
+  void MarkFunctionHot(uint32_t address);
+
+  // Returns all guest functions that have been translated so far.
+  std::vector<GuestFunction*> QueryTranslatedFunctions();
+  // Writes the --jit_function_stats of all translated functions as CSV.
+  bool DumpFunctionStats(const std::filesystem::path& path);
+
   bool Execute(ThreadState* thread_state, uint32_t address);
   bool ExecuteRaw(ThreadState* thread_state, uint32_t address);
   uint64_t Execute(ThreadState* thread_state, uint32_t address, uint64_t args[],
                    size_t arg_count);
+  // Executes a function already resolved with ResolveFunction, such as by a
+  // GuestCallback, without looking it up again.
+  uint64_t ExecuteResolved(ThreadState* thread_state, Function* function,
+                           uint64_t args[], size_t arg_count);
 
   bool Save(ByteStream* stream);
   bool Restore(ByteStream* stream);
@@ -149,6 +178,13 @@ class Processor {
   // Returns all currently registered breakpoints.
   std::vector<Breakpoint*> breakpoints() const;
 
+  // Appends the addresses and the conditions of the installed conditional
+  // breakpoints in the guest address range, for evaluating them in the
+  // translated code.
+  void GetInstalledBreakpointConditions(
+      uint32_t address_first, uint32_t address_last,
+      std::vector<std::pair<uint32_t, BreakpointCondition>>& conditions_out);
+
   // Shows the debug listener, focusing it if it already exists.
   void ShowDebugger();
 
@@ -212,6 +248,9 @@ class Processor {
   uint8_t* AllocateFunctionTraceData(size_t size);
 
  private:
+  // Samples thread_debug_infos_ under the global lock.
+  friend class SamplingProfiler;
+
   // Synchronously demands a debug listener.
   void DemandDebugListener();
 
@@ -236,6 +275,10 @@ class Processor {
 
   void OnFunctionDefined(Function* function);
 
+  void SetExecuteArguments(ThreadState* thread_state, uint64_t args[],
+                           size_t arg_count);
+  bool ExecuteFunction(ThreadState* thread_state, Function* function);
+
   static bool ExceptionCallbackThunk(Exception* ex, void* data);
   bool ExceptionCallback(Exception* ex);
   void OnStepCompleted(ThreadDebugInfo* thread_info);
@@ -248,6 +291,20 @@ class Processor {
                                          uint32_t current_pc);
 
   bool DemandFunction(Function* function);
+  // Makes the guest functions overlapping the range be translated again on
+  // their next call (--invalidate_modified_code).
+  void InvalidateModifiedCode(uint32_t address, uint32_t length);
+  static void CodeWriteCallbackThunk(void* context_ptr, uint32_t address,
+                                     uint32_t length);
+  void HotFunctionThreadMain();
+  // Reclaims the dead generated code (jit_code_reclamation) if enough of it
+  // has accumulated, pausing all threads to check that none is executing it.
+  void ReclaimRetiredCode();
+  // Stops the sampling profiler and writes its report, if it is running.
+  void WriteSamplingProfile();
+  // Stores the frequencies counted with --guest_block_profile in the
+  // instruction infocaches of the modules.
+  void StoreBlockProfile();
 
   Memory* memory_ = nullptr;
   std::unique_ptr<StackWalker> stack_walker_;
@@ -280,6 +337,29 @@ class Processor {
   std::vector<Breakpoint*> breakpoints_;
 
   Irql irql_;
+
+  xe_mutex hot_function_lock_;
+  std::condition_variable_any hot_function_cond_;
+  std::deque<GuestFunction*> hot_function_queue_;
+  bool hot_function_thread_shutdown_ = false;
+  std::unique_ptr<xe::threading::Thread> hot_function_thread_;
+
+  std::unique_ptr<SamplingProfiler> sampling_profiler_;
+};
+
+// A guest function the host calls back into frequently on threads bound to
+// their thread states, such as an audio client or an interrupt callback,
+// resolved on the first call rather than on every Execute.
+class GuestCallback {
+ public:
+  // Returns 0xDEADBABE if the function can't be resolved, like Execute.
+  uint64_t Call(ThreadState* thread_state, uint32_t address, uint64_t args[],
+                size_t arg_count);
+
+ private:
+  // Functions are never freed, so one resolved for a previous address is safe
+  // to compare to the current one.
+  std::atomic<Function*> function_{nullptr};
 };
 
 }  // namespace cpu
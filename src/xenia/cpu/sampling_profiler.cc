@@ -0,0 +1,229 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2022 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/cpu/sampling_profiler.h"
+
+#include <algorithm>
+#include <map>
+
+#include "third_party/fmt/include/fmt/format.h"
+#include "xenia/base/assert.h"
+#include "xenia/base/filesystem.h"
+#include "xenia/base/host_thread_context.h"
+#include "xenia/base/logging.h"
+#include "xenia/cpu/function.h"
+#include "xenia/cpu/processor.h"
+#include "xenia/cpu/stack_walker.h"
+#include "xenia/cpu/thread.h"
+#include "xenia/cpu/thread_debug_info.h"
+
+namespace xe {
+namespace cpu {
+
+SamplingProfiler::SamplingProfiler(Processor* processor)
+    : processor_(processor) {}
+
+SamplingProfiler::~SamplingProfiler() { Stop(); }
+
+bool SamplingProfiler::Start(std::chrono::milliseconds interval) {
+  assert_null(thread_);
+  if (!processor_->stack_walker()) {
+    XELOGW("Sampling profiler unavailable without a stack walker");
+    return false;
+  }
+  interval_ = std::max(interval, std::chrono::milliseconds(1));
+  shutdown_event_ = xe::threading::Event::CreateManualResetEvent(false);
+
+  xe::threading::Thread::CreationParameters params;
+  params.initial_priority = xe::threading::ThreadPriority::kHighest;
+  thread_ = xe::threading::Thread::Create(params, [this]() { ThreadMain(); });
+  if (!thread_) {
+    shutdown_event_.reset();
+    return false;
+  }
+  thread_->set_name("Guest Sampling Profiler");
+  XELOGI("Sampling guest threads every {}ms", interval_.count());
+  return true;
+}
+
+void SamplingProfiler::Stop() {
+  if (!thread_) {
+    return;
+  }
+  shutdown_event_->Set();
+  xe::threading::Wait(thread_.get(), false);
+  thread_.reset();
+  shutdown_event_.reset();
+}
+
+void SamplingProfiler::ThreadMain() {
+  while (xe::threading::Wait(shutdown_event_.get(), false, interval_) ==
+         xe::threading::WaitResult::kTimeout) {
+    SampleThreads();
+  }
+}
+
+void SamplingProfiler::SampleThreads() {
+  auto stack_walker = processor_->stack_walker();
+  uint64_t frame_host_pcs[kMaxFrames];
+  HostThreadContext host_context;
+
+  // Holding the global lock keeps threads from being destroyed under us, and
+  // guarantees no suspended thread owns it. Only the capture happens while
+  // the thread is suspended, symbols are resolved when writing the report.
+  auto global_lock = processor_->global_critical_region_.Acquire();
+  for (auto& it : processor_->thread_debug_infos_) {
+    auto thread_info = it.second.get();
+    auto thread = thread_info->thread;
+    if (!thread || thread_info->suspended ||
+        thread_info->state != ThreadDebugInfo::State::kAlive ||
+        !thread->can_debugger_suspend()) {
+      // Dead, paused in the debugger, or waiting - waits aren't interesting
+      // for finding hot code.
+      continue;
+    }
+    if (!thread->thread()->Suspend()) {
+      continue;
+    }
+    uint64_t hash = 0;
+    size_t count = stack_walker->CaptureStackTrace(
+        thread->thread()->native_handle(), frame_host_pcs, 0, kMaxFrames,
+        nullptr, &host_context, &hash);
+    thread->thread()->Resume();
+    if (!count) {
+      continue;
+    }
+
+    uint64_t key = hash ^ (uint64_t(thread_info->thread_id) << 32);
+    auto& stack = stacks_[key];
+    if (!stack.count) {
+      stack.thread_id = thread_info->thread_id;
+      stack.host_pcs.assign(frame_host_pcs, frame_host_pcs + count);
+    }
+    ++stack.count;
+    ++sample_count_;
+  }
+}
+
+bool SamplingProfiler::WriteReport(const std::filesystem::path& directory,
+                                   const std::string_view base_name) {
+  assert_null(thread_);
+  auto stack_walker = processor_->stack_walker();
+  if (!stack_walker || stacks_.empty()) {
+    return false;
+  }
+
+  std::map<uint32_t, std::string> thread_names;
+  {
+    auto global_lock = processor_->global_critical_region_.Acquire();
+    for (auto& it : processor_->thread_debug_infos_) {
+      auto thread = it.second->thread;
+      if (thread && !thread->thread_name().empty()) {
+        thread_names[it.first] = thread->thread_name();
+      }
+    }
+  }
+
+  auto frame_name = [](const StackFrame& frame) -> std::string {
+    if (frame.type == StackFrame::Type::kGuest) {
+      auto function = frame.guest_symbol.function;
+      if (!function) {
+        return "[unknown guest]";
+      }
+      if (!function->name().empty()) {
+        return function->name();
+      }
+      return fmt::format("sub_{:08X}", function->address());
+    }
+    if (frame.host_symbol.name[0]) {
+      return frame.host_symbol.name;
+    }
+    return fmt::format("0x{:X}", frame.host_pc);
+  };
+
+  // Folded stacks are merged by name, as different host stacks may resolve to
+  // the same symbols.
+  std::map<std::string, uint64_t> folded;
+  // Guest PC of the innermost guest frame -> samples.
+  std::unordered_map<uint32_t, uint64_t> hotspots;
+  std::unordered_map<uint32_t, Function*> hotspot_functions;
+  StackFrame frames[kMaxFrames];
+  for (auto& it : stacks_) {
+    auto& stack = it.second;
+    size_t count = stack.host_pcs.size();
+    stack_walker->ResolveStack(stack.host_pcs.data(), frames, count);
+
+    auto name_it = thread_names.find(stack.thread_id);
+    std::string line = name_it != thread_names.end()
+                           ? name_it->second
+                           : fmt::format("thread {:X}", stack.thread_id);
+    for (size_t i = count; i-- > 0;) {
+      line += ';';
+      line += frame_name(frames[i]);
+    }
+    folded[line] += stack.count;
+
+    for (size_t i = 0; i < count; ++i) {
+      if (frames[i].type == StackFrame::Type::kGuest && frames[i].guest_pc) {
+        hotspots[frames[i].guest_pc] += stack.count;
+        hotspot_functions[frames[i].guest_pc] =
+            frames[i].guest_symbol.function;
+        break;
+      }
+    }
+  }
+
+  auto folded_path = directory / fmt::format("{}.folded", base_name);
+  xe::filesystem::CreateParentFolder(folded_path);
+  FILE* file = xe::filesystem::OpenFile(folded_path, "w");
+  if (!file) {
+    XELOGE("Unable to write profile to {}", xe::path_to_utf8(folded_path));
+    return false;
+  }
+  for (auto& it : folded) {
+    fmt::print(file, "{} {}\n", it.first, it.second);
+  }
+  fclose(file);
+
+  std::vector<std::pair<uint32_t, uint64_t>> sorted_hotspots(hotspots.begin(),
+                                                             hotspots.end());
+  std::sort(sorted_hotspots.begin(), sorted_hotspots.end(),
+            [](auto& a, auto& b) { return a.second > b.second; });
+  auto hotspots_path = directory / fmt::format("{}_hotspots.txt", base_name);
+  file = xe::filesystem::OpenFile(hotspots_path, "w");
+  if (file) {
+    uint64_t total = sample_count_;
+    fmt::print(file, "{} samples\n", total);
+    fmt::print(file, "{:>10} {:>7}  {:8}  function\n", "samples", "%",
+               "address");
+    for (auto& it : sorted_hotspots) {
+      auto function = hotspot_functions[it.first];
+      std::string location;
+      if (function) {
+        location =
+            fmt::format("{}+0x{:X}",
+                        function->name().empty()
+                            ? fmt::format("sub_{:08X}", function->address())
+                            : function->name(),
+                        it.first - function->address());
+      }
+      fmt::print(file, "{:>10} {:>6.2f}%  {:08X}  {}\n", it.second,
+                 100.0 * double(it.second) / double(total), it.first,
+                 location);
+    }
+    fclose(file);
+  }
+
+  XELOGI("Wrote {} profiler samples to {}", uint64_t(sample_count_),
+         xe::path_to_utf8(folded_path));
+  return true;
+}
+
+}  // namespace cpu
+}  // namespace xe
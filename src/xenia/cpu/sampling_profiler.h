@@ -0,0 +1,80 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2022 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#ifndef XENIA_CPU_SAMPLING_PROFILER_H_
+#define XENIA_CPU_SAMPLING_PROFILER_H_
+
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "xenia/base/threading.h"
+
+namespace xe {
+namespace cpu {
+
+class Processor;
+
+// Periodically suspends guest threads and captures their host call stacks,
+// without instrumenting the generated code (unlike --instrument_call_times).
+// Stacks are only symbolized when the report is written, so the sampling
+// thread does little more than suspend, walk and resume.
+//
+// The report is written in the folded stack format understood by
+// flamegraph.pl / speedscope, along with a list of the hottest guest
+// instructions.
+class SamplingProfiler {
+ public:
+  explicit SamplingProfiler(Processor* processor);
+  ~SamplingProfiler();
+
+  bool is_running() const { return !!thread_; }
+
+  bool Start(std::chrono::milliseconds interval);
+  void Stop();
+
+  // Writes <base_name>.folded and <base_name>_hotspots.txt into the directory.
+  // Must be called while the sampled functions are still alive.
+  bool WriteReport(const std::filesystem::path& directory,
+                   const std::string_view base_name);
+
+  uint64_t sample_count() const { return sample_count_; }
+
+ private:
+  static constexpr size_t kMaxFrames = 64;
+
+  struct Stack {
+    uint32_t thread_id = 0;
+    std::vector<uint64_t> host_pcs;  // Innermost first.
+    uint64_t count = 0;
+  };
+
+  void ThreadMain();
+  void SampleThreads();
+
+  Processor* processor_ = nullptr;
+  std::chrono::milliseconds interval_;
+  std::unique_ptr<xe::threading::Event> shutdown_event_;
+  std::unique_ptr<xe::threading::Thread> thread_;
+
+  // Only touched by the sampling thread until it has been stopped.
+  // Keyed by stack hash ^ thread id.
+  std::unordered_map<uint64_t, Stack> stacks_;
+  std::atomic<uint64_t> sample_count_ = {0};
+};
+
+}  // namespace cpu
+}  // namespace xe
+
+#endif  // XENIA_CPU_SAMPLING_PROFILER_H_
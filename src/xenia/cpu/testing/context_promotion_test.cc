@@ -0,0 +1,49 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2026 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/cpu/testing/util.h"
+
+using namespace xe::cpu::hir;
+using namespace xe::cpu;
+using namespace xe::cpu::testing;
+using xe::cpu::ppc::PPCContext;
+
+// The branch only becomes constant after context promotion, so constant
+// propagation removes it from the end of a block whose values are still used
+// in the following block of the promoted chain.
+TEST_CASE("CONTEXT_PROMOTION_FOLDED_BRANCH_IN_CHAIN", "[instr]") {
+  TestFunction test([](HIRBuilder& b) {
+    auto skip = b.NewLabel();
+    StoreGPR(b, 5, LoadGPR(b, 4));
+    StoreGPR(b, 6, b.LoadZeroInt64());
+    b.BranchTrue(b.IsTrue(LoadGPR(b, 6)), skip);
+    // Label-less, only entered by falling through. The other values take
+    // registers from the allocator before the promoted r4 is read again.
+    auto a = b.Add(LoadGPR(b, 7), b.LoadConstantInt64(1));
+    auto c = b.Add(LoadGPR(b, 8), b.LoadConstantInt64(2));
+    StoreGPR(b, 7, a);
+    StoreGPR(b, 8, c);
+    StoreGPR(b, 3, b.Add(LoadGPR(b, 4), b.Add(a, c)));
+    b.MarkLabel(skip);
+    b.Return();
+  });
+  test.Run(
+      [](PPCContext* ctx) {
+        ctx->r[4] = 0x1000;
+        ctx->r[7] = 0x20;
+        ctx->r[8] = 0x300;
+      },
+      [](PPCContext* ctx) {
+        REQUIRE(ctx->r[3] == 0x1323);
+        REQUIRE(ctx->r[5] == 0x1000);
+        REQUIRE(ctx->r[6] == 0);
+        REQUIRE(ctx->r[7] == 0x21);
+        REQUIRE(ctx->r[8] == 0x302);
+      });
+}
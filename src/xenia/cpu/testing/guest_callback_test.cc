@@ -0,0 +1,86 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2026 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include <chrono>
+
+#include "xenia/base/logging.h"
+#include "xenia/cpu/processor.h"
+#include "xenia/cpu/testing/util.h"
+#include "xenia/cpu/thread_state.h"
+
+using namespace xe;
+using namespace xe::cpu;
+using namespace xe::cpu::hir;
+using namespace xe::cpu::testing;
+
+namespace {
+
+// r3 = r3 + r4
+void GenerateAdd(HIRBuilder& b) {
+  StoreGPR(b, 3, b.Add(LoadGPR(b, 3), LoadGPR(b, 4)));
+  b.Return();
+}
+
+}  // namespace
+
+TEST_CASE("GUEST_CALLBACK", "[guest_callback]") {
+  TestFunction test(GenerateAdd);
+  for (auto& processor : test.processors) {
+    auto thread_state = std::make_unique<ThreadState>(processor.get(), 0x100);
+    ThreadState::Bind(thread_state.get());
+    GuestCallback callback;
+    for (uint64_t i = 0; i < 3; ++i) {
+      uint64_t args[] = {i, 0x10};
+      REQUIRE(callback.Call(thread_state.get(), 0x80000000, args,
+                            xe::countof(args)) == i + 0x10);
+    }
+    uint64_t args[] = {0, 0};
+    REQUIRE(callback.Call(thread_state.get(), 0x80001000, args,
+                          xe::countof(args)) == 0xDEADBABE);
+    ThreadState::Bind(nullptr);
+  }
+}
+
+// Host to guest to host round trips of kernel callbacks, through Execute and
+// GuestCallback. Not run by default:
+//   xenia-cpu-tests "[benchmark]"
+TEST_CASE("GUEST_CALLBACK_ROUND_TRIP", "[.][benchmark]") {
+  TestFunction test(GenerateAdd);
+  constexpr uint32_t kIterations = 1000000;
+  for (auto& processor : test.processors) {
+    auto thread_state = std::make_unique<ThreadState>(processor.get(), 0x100);
+    ThreadState::Bind(thread_state.get());
+
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < kIterations; ++i) {
+      uint64_t args[] = {i, 1};
+      processor->Execute(thread_state.get(), 0x80000000, args,
+                         xe::countof(args));
+    }
+    auto execute_elapsed =
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start);
+
+    GuestCallback callback;
+    start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < kIterations; ++i) {
+      uint64_t args[] = {i, 1};
+      callback.Call(thread_state.get(), 0x80000000, args, xe::countof(args));
+    }
+    auto callback_elapsed =
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start);
+
+    REQUIRE(thread_state->context()->r[3] == kIterations);
+    XELOGI("{} round trips: Execute {} ns each, GuestCallback {} ns each",
+           kIterations, execute_elapsed.count() / kIterations,
+           callback_elapsed.count() / kIterations);
+    ThreadState::Bind(nullptr);
+  }
+}
@@ -0,0 +1,113 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2026 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include <cstring>
+#include <initializer_list>
+#include <vector>
+
+#include "xenia/base/byte_order.h"
+#include "xenia/cpu/guest_memory_routines.h"
+#include "xenia/cpu/ppc/ppc_context.h"
+
+#include "third_party/catch/include/catch.hpp"
+
+namespace xe {
+namespace test {
+
+namespace {
+
+std::vector<uint8_t> Assemble(std::initializer_list<uint32_t> words) {
+  std::vector<uint8_t> code(words.size() * sizeof(uint32_t));
+  uint8_t* code_ptr = code.data();
+  for (uint32_t word : words) {
+    xe::store_and_swap<uint32_t>(code_ptr, word);
+    code_ptr += sizeof(uint32_t);
+  }
+  return code;
+}
+
+const cpu::GuestMemoryRoutine* Match(const std::vector<uint8_t>& code) {
+  return cpu::MatchGuestMemoryRoutine(code.data(),
+                                      code.size() / sizeof(uint32_t));
+}
+
+}  // namespace
+
+TEST_CASE("Guest memset byte loops are recognized", "[guest_memory_routines]") {
+  // cmplwi cr6, r5, 0; mr r11, r3; beqlr cr6; mtctr r5
+  // stb r4, 0(r11); addi r11, r11, 1; bdnz -8; blr
+  auto memset_code =
+      Assemble({0x2B050000, 0x7C6B1B78, 0x4D9A0020, 0x7CA903A6, 0x988B0000,
+                0x396B0001, 0x4200FFF8, 0x4E800020});
+  const cpu::GuestMemoryRoutine* routine = Match(memset_code);
+  REQUIRE(routine);
+  REQUIRE(std::strcmp(routine->name, "memset") == 0);
+  REQUIRE(routine->code_size == memset_code.size());
+
+  // Truncated.
+  memset_code.resize(memset_code.size() - sizeof(uint32_t));
+  REQUIRE_FALSE(Match(memset_code));
+
+  // addi r10, r11, 1 - the temporary register must be the same.
+  REQUIRE_FALSE(Match(Assemble({0x2B050000, 0x7C6B1B78, 0x4D9A0020,
+                                0x7CA903A6, 0x988B0000, 0x394B0001,
+                                0x4200FFF8, 0x4E800020})));
+
+  // mr r4, r3 - the temporary register must not be an argument.
+  REQUIRE_FALSE(Match(Assemble({0x2B050000, 0x7C641B78, 0x4D9A0020,
+                                0x7CA903A6, 0x98840000, 0x38840001,
+                                0x4200FFF8, 0x4E800020})));
+}
+
+TEST_CASE("Guest memcpy byte loops are recognized", "[guest_memory_routines]") {
+  // cmpwi cr6, r5, 0; mr r11, r3; beqlr cr6; mtctr r5
+  // lbz r10, 0(r4); addi r4, r4, 1; stb r10, 0(r11); addi r11, r11, 1;
+  // bdnz -16; blr
+  auto memcpy_code = Assemble({0x2F050000, 0x7C6B1B78, 0x4D9A0020, 0x7CA903A6,
+                               0x89440000, 0x38840001, 0x994B0000, 0x396B0001,
+                               0x4200FFF0, 0x4E800020});
+  const cpu::GuestMemoryRoutine* routine = Match(memcpy_code);
+  REQUIRE(routine);
+  REQUIRE(std::strcmp(routine->name, "memcpy") == 0);
+  REQUIRE(routine->code_size == memcpy_code.size());
+
+  // lbz r11, 0(r4) - the loaded byte must not overwrite the destination.
+  REQUIRE_FALSE(Match(Assemble({0x2F050000, 0x7C6B1B78, 0x4D9A0020,
+                                0x7CA903A6, 0x89640000, 0x38840001,
+                                0x996B0000, 0x396B0001, 0x4200FFF0,
+                                0x4E800020})));
+}
+
+TEST_CASE("Guest memory routines with no length only set cr6",
+          "[guest_memory_routines]") {
+  // Returned from by beqlr before any memory access, so no processor needed.
+  for (uint32_t comparison : {0x2B050000u, 0x2F050000u}) {
+    const cpu::GuestMemoryRoutine* routine =
+        Match(Assemble({comparison, 0x7C6B1B78, 0x4D9A0020, 0x7CA903A6,
+                        0x89440000, 0x38840001, 0x994B0000, 0x396B0001,
+                        0x4200FFF0, 0x4E800020}));
+    REQUIRE(routine);
+    cpu::ppc::PPCContext ppc_context;
+    std::memset(&ppc_context, 0, sizeof(ppc_context));
+    ppc_context.r[3] = 0x82000000;
+    ppc_context.r[4] = 0x82001000;
+    // Only the low 32 bits are compared.
+    ppc_context.r[5] = uint64_t(1) << 32;
+    ppc_context.ctr = 7;
+    ppc_context.cr6.value = 0x01010001;
+    routine->handler(&ppc_context, nullptr);
+    REQUIRE(ppc_context.cr6.value == 0x01010000);
+    REQUIRE(ppc_context.ctr == 7);
+    REQUIRE(ppc_context.r[3] == 0x82000000);
+    REQUIRE(ppc_context.r[4] == 0x82001000);
+  }
+}
+
+}  // namespace test
+}  // namespace xe
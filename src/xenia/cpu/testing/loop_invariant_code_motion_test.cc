@@ -0,0 +1,52 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2026 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/cpu/testing/util.h"
+
+using namespace xe::cpu::hir;
+using namespace xe::cpu;
+using namespace xe::cpu::testing;
+using xe::cpu::ppc::PPCContext;
+
+// Context promotion hands the r4 loaded in the loop to the block after the
+// looping branch, so that value must not be hoisted across the loop label.
+TEST_CASE("LICM_USE_AFTER_LOOP_FALLTHROUGH", "[instr]") {
+  TestFunction test([](HIRBuilder& b) {
+    auto loop = b.NewLabel();
+    StoreGPR(b, 3, b.LoadZeroInt64());
+    StoreGPR(b, 8, b.LoadZeroInt64());
+    b.MarkLabel(loop);
+    auto v0 = LoadGPR(b, 4);
+    auto v1 = b.Add(v0, b.LoadConstantInt64(0x10));
+    auto v2 = b.Shl(v1, int8_t(2));
+    StoreGPR(b, 3, b.Add(LoadGPR(b, 3), v2));
+    // Independent of r4, so this can still be hoisted.
+    auto v3 = b.Xor(LoadGPR(b, 9), b.LoadConstantInt64(0xFF));
+    auto v4 = b.Add(v3, b.LoadConstantInt64(1));
+    StoreGPR(b, 8, b.Add(LoadGPR(b, 8), v4));
+    auto counter = b.Sub(LoadGPR(b, 5), b.LoadConstantInt64(1));
+    StoreGPR(b, 5, counter);
+    b.BranchTrue(b.IsTrue(counter), loop);
+    // Label-less, only entered by falling out of the loop.
+    StoreGPR(b, 6, b.Add(LoadGPR(b, 4), b.LoadConstantInt64(1)));
+    b.Return();
+  });
+  test.Run(
+      [](PPCContext* ctx) {
+        ctx->r[4] = 0x1000;
+        ctx->r[5] = 3;
+        ctx->r[9] = 0x7;
+      },
+      [](PPCContext* ctx) {
+        REQUIRE(ctx->r[3] == 0xC0C0);
+        REQUIRE(ctx->r[5] == 0);
+        REQUIRE(ctx->r[6] == 0x1001);
+        REQUIRE(ctx->r[8] == 0x2EB);
+      });
+}
@@ -0,0 +1,161 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2023 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include <chrono>
+#include <random>
+#include <vector>
+
+#include "xenia/memory.h"
+
+#include "third_party/catch/include/catch.hpp"
+
+namespace xe {
+namespace test {
+
+namespace {
+
+constexpr uint32_t kTestHeapAddress = 0x00000000;
+
+BaseHeap* GetTestHeap(Memory& memory) {
+  // The 4 KB page virtual heap.
+  return memory.LookupHeap(kTestHeapAddress + 0x10000);
+}
+
+uint32_t Allocate(BaseHeap* heap, uint32_t size, uint32_t alignment,
+                  bool top_down) {
+  uint32_t address = 0;
+  heap->Alloc(size, alignment, kMemoryAllocationReserve,
+              kMemoryProtectRead | kMemoryProtectWrite, top_down, &address);
+  return address;
+}
+
+}  // namespace
+
+TEST_CASE("Heap allocation finds free ranges", "[memory]") {
+  Memory memory;
+  REQUIRE(memory.Initialize());
+  BaseHeap* heap = GetTestHeap(memory);
+  uint32_t page_size = heap->page_size();
+
+  SECTION("Bottom-up allocations are placed after each other") {
+    uint32_t first = Allocate(heap, page_size, page_size, false);
+    uint32_t second = Allocate(heap, page_size, page_size, false);
+    REQUIRE(first);
+    REQUIRE(second == first + page_size);
+  }
+
+  SECTION("A released hole is reused if large enough") {
+    uint32_t first = Allocate(heap, 4 * page_size, page_size, false);
+    uint32_t second = Allocate(heap, page_size, page_size, false);
+    REQUIRE(heap->Release(first));
+    REQUIRE(Allocate(heap, 8 * page_size, page_size, false) > second);
+    REQUIRE(Allocate(heap, 4 * page_size, page_size, false) == first);
+  }
+
+  SECTION("Alignment is respected past reserved pages") {
+    uint32_t alignment = 64 * page_size;
+    uint32_t first = Allocate(heap, page_size, page_size, false);
+    uint32_t aligned = Allocate(heap, page_size, alignment, false);
+    REQUIRE(aligned % alignment == 0);
+    REQUIRE(aligned > first);
+  }
+
+  SECTION("Top-down allocations are placed before each other") {
+    uint32_t first = Allocate(heap, 3 * page_size, page_size, true);
+    uint32_t second = Allocate(heap, 3 * page_size, page_size, true);
+    REQUIRE(first);
+    REQUIRE(second + 3 * page_size <= first);
+    REQUIRE(heap->Release(second));
+    REQUIRE(Allocate(heap, 3 * page_size, page_size, true) == second);
+  }
+}
+
+TEST_CASE("Heap statistics track allocations", "[memory]") {
+  Memory memory;
+  REQUIRE(memory.Initialize());
+  BaseHeap* heap = GetTestHeap(memory);
+  uint32_t page_size = heap->page_size();
+
+  HeapStats initial_stats;
+  heap->QueryStats(initial_stats);
+
+  uint32_t address = 0;
+  REQUIRE(heap->Alloc(4 * page_size, page_size,
+                      kMemoryAllocationReserve | kMemoryAllocationCommit,
+                      kMemoryProtectRead | kMemoryProtectWrite, false,
+                      &address));
+  HeapStats stats;
+  heap->QueryStats(stats);
+  REQUIRE(stats.reserved_page_count == initial_stats.reserved_page_count + 4);
+  REQUIRE(stats.committed_page_count ==
+          initial_stats.committed_page_count + 4);
+  REQUIRE(stats.allocation_count == initial_stats.allocation_count + 1);
+  // 16 KB with 4 KB pages.
+  REQUIRE(stats.allocation_size_histogram[2] ==
+          initial_stats.allocation_size_histogram[2] + 1);
+  REQUIRE(stats.largest_free_page_run <= stats.total_page_count -
+                                             stats.reserved_page_count);
+
+  REQUIRE(heap->Decommit(address, 2 * page_size));
+  heap->QueryStats(stats);
+  REQUIRE(stats.committed_page_count ==
+          initial_stats.committed_page_count + 2);
+
+  REQUIRE(heap->Release(address));
+  heap->QueryStats(stats);
+  REQUIRE(stats.reserved_page_count == initial_stats.reserved_page_count);
+  REQUIRE(stats.committed_page_count == initial_stats.committed_page_count);
+  REQUIRE(stats.release_count == initial_stats.release_count + 1);
+  REQUIRE(stats.free_run_count == initial_stats.free_run_count);
+  REQUIRE(stats.largest_free_page_run == initial_stats.largest_free_page_run);
+}
+
+// Allocation and release churn similar to titles calling
+// NtAllocateVirtualMemory many times with a fragmented heap. Not run by
+// default:
+//   xenia-cpu-tests "[benchmark]"
+TEST_CASE("Heap allocation churn", "[.][benchmark]") {
+  Memory memory;
+  REQUIRE(memory.Initialize());
+  BaseHeap* heap = GetTestHeap(memory);
+  uint32_t page_size = heap->page_size();
+
+  std::mt19937 random(0x48454150);
+  std::uniform_int_distribution<uint32_t> random_pages(1, 64);
+  std::vector<uint32_t> live;
+  constexpr size_t kLiveCount = 4096;
+  constexpr size_t kIterations = 200000;
+
+  auto start = std::chrono::steady_clock::now();
+  size_t failed = 0;
+  for (size_t i = 0; i < kIterations; ++i) {
+    if (live.size() >= kLiveCount) {
+      size_t index = random() % live.size();
+      heap->Release(live[index]);
+      live[index] = live.back();
+      live.pop_back();
+    }
+    uint32_t address = Allocate(heap, random_pages(random) * page_size,
+                                page_size, (i & 1) != 0);
+    if (address) {
+      live.push_back(address);
+    } else {
+      ++failed;
+    }
+  }
+  std::chrono::duration<double, std::micro> elapsed =
+      std::chrono::steady_clock::now() - start;
+  WARN(kIterations << " allocations: " << elapsed.count() / kIterations
+                   << " us per allocation and release, " << failed
+                   << " failed");
+  REQUIRE(failed == 0);
+}
+
+}  // namespace test
+}  // namespace xe
@@ -0,0 +1,159 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2022 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include <chrono>
+#include <thread>
+
+#include "xenia/base/logging.h"
+#include "xenia/cpu/testing/util.h"
+#include "xenia/cpu/thread_state.h"
+
+using namespace xe;
+using namespace xe::cpu;
+using namespace xe::cpu::hir;
+using namespace xe::cpu::testing;
+using xe::cpu::ppc::PPCContext;
+
+// r4 = address, r3 = stwcx. result, r5 = value loaded
+TEST_CASE("RESERVED_LOAD_STORE_I32", "[instr]") {
+  TestFunction test([](HIRBuilder& b) {
+    auto address = b.Truncate(LoadGPR(b, 4), INT32_TYPE);
+    auto value = b.LoadWithReserve(address, INT32_TYPE);
+    StoreGPR(b, 5, b.ZeroExtend(value, INT64_TYPE));
+    auto success = b.StoreWithReserve(
+        address, b.Add(value, b.LoadConstantInt32(1)), INT32_TYPE);
+    StoreGPR(b, 3, b.ZeroExtend(success, INT64_TYPE));
+    b.Return();
+  });
+  uint32_t address = test.memory->SystemHeapAlloc(256);
+  auto host_address = test.memory->TranslateVirtual<uint32_t*>(address);
+  *host_address = 0x1234;
+  test.Run([address](PPCContext* ctx) { ctx->r[4] = address; },
+           [host_address](PPCContext* ctx) {
+             REQUIRE(ctx->r[3] == 1);
+             REQUIRE(ctx->r[5] == 0x1234);
+             REQUIRE(*host_address == 0x1235);
+           });
+  test.memory->SystemHeapFree(address);
+}
+
+TEST_CASE("RESERVED_STORE_WITHOUT_RESERVATION_I32", "[instr]") {
+  TestFunction test([](HIRBuilder& b) {
+    auto address = b.Truncate(LoadGPR(b, 4), INT32_TYPE);
+    auto success =
+        b.StoreWithReserve(address, b.LoadConstantInt32(1), INT32_TYPE);
+    StoreGPR(b, 3, b.ZeroExtend(success, INT64_TYPE));
+    b.Return();
+  });
+  uint32_t address = test.memory->SystemHeapAlloc(256);
+  auto host_address = test.memory->TranslateVirtual<uint32_t*>(address);
+  *host_address = 0;
+  test.Run([address](PPCContext* ctx) { ctx->r[4] = address; },
+           [host_address](PPCContext* ctx) {
+             REQUIRE(ctx->r[3] == 0);
+             REQUIRE(*host_address == 0);
+           });
+  test.memory->SystemHeapFree(address);
+}
+
+// A store to another granule fails, and must give up the reservation so the
+// next lwarx. can acquire it again.
+TEST_CASE("RESERVED_STORE_OTHER_GRANULE_I32", "[instr]") {
+  TestFunction test([](HIRBuilder& b) {
+    auto address = b.Truncate(LoadGPR(b, 4), INT32_TYPE);
+    auto other_address = b.Add(address, b.LoadConstantInt32(128));
+    b.LoadWithReserve(address, INT32_TYPE);
+    auto failure =
+        b.StoreWithReserve(other_address, b.LoadConstantInt32(1), INT32_TYPE);
+    StoreGPR(b, 3, b.ZeroExtend(failure, INT64_TYPE));
+    b.LoadWithReserve(address, INT32_TYPE);
+    auto success =
+        b.StoreWithReserve(address, b.LoadConstantInt32(2), INT32_TYPE);
+    StoreGPR(b, 5, b.ZeroExtend(success, INT64_TYPE));
+    b.Return();
+  });
+  uint32_t address = test.memory->SystemHeapAlloc(256, 128);
+  auto host_address = test.memory->TranslateVirtual<uint32_t*>(address);
+  host_address[0] = 0;
+  host_address[32] = 0;
+  test.Run([address](PPCContext* ctx) { ctx->r[4] = address; },
+           [host_address](PPCContext* ctx) {
+             REQUIRE(ctx->r[3] == 0);
+             REQUIRE(ctx->r[5] == 1);
+             REQUIRE(host_address[0] == 2);
+             REQUIRE(host_address[32] == 0);
+           });
+  test.memory->SystemHeapFree(address);
+}
+
+// Contended increments of counters from several host threads, each counter on
+// its own granule. Not run by default:
+//   xenia-cpu-tests "[benchmark]"
+TEST_CASE("RESERVED_INCREMENT_CONTENTION", "[.][benchmark]") {
+  // r4 = address, r5 = number of increments left
+  //   loop:
+  //     v = lwarx r4
+  //     r5 -= stwcx. r4, v + 1
+  //     bne r5, loop
+  TestFunction test([](HIRBuilder& b) {
+    auto loop = b.NewLabel();
+    b.MarkLabel(loop);
+    auto address = b.Truncate(LoadGPR(b, 4), INT32_TYPE);
+    auto value = b.LoadWithReserve(address, INT32_TYPE);
+    auto success = b.StoreWithReserve(
+        address, b.Add(value, b.LoadConstantInt32(1)), INT32_TYPE);
+    auto remaining =
+        b.Sub(LoadGPR(b, 5), b.ZeroExtend(success, INT64_TYPE));
+    StoreGPR(b, 5, remaining);
+    b.BranchTrue(b.CompareNE(remaining, b.LoadZeroInt64()), loop);
+    b.Return();
+  });
+
+  constexpr uint32_t kThreadCount = 8;
+  constexpr uint32_t kCounterCount = 4;
+  constexpr uint32_t kIterations = 100000;
+  uint32_t base_address =
+      test.memory->SystemHeapAlloc(kCounterCount * 128, 128);
+  auto host_base = test.memory->TranslateVirtual<uint32_t*>(base_address);
+  for (uint32_t i = 0; i < kCounterCount; ++i) {
+    host_base[i * 32] = 0;
+  }
+
+  for (auto& processor : test.processors) {
+    auto fn = processor->ResolveFunction(0x80000000);
+    REQUIRE(fn);
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (uint32_t t = 0; t < kThreadCount; ++t) {
+      threads.emplace_back([&, t]() {
+        auto thread_state =
+            std::make_unique<ThreadState>(processor.get(), 0x100 + t);
+        auto ctx = thread_state->context();
+        ctx->lr = 0xBCBCBCBC;
+        ctx->r[4] = base_address + (t % kCounterCount) * 128;
+        ctx->r[5] = kIterations;
+        fn->Call(thread_state.get(), uint32_t(ctx->lr));
+      });
+    }
+    for (auto& thread : threads) {
+      thread.join();
+    }
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start);
+
+    uint32_t total = 0;
+    for (uint32_t i = 0; i < kCounterCount; ++i) {
+      total += host_base[i * 32];
+    }
+    REQUIRE(total == kThreadCount * kIterations);
+    XELOGI("{} threads, {} reserved increments each: {}us", kThreadCount,
+           kIterations, elapsed.count());
+  }
+  test.memory->SystemHeapFree(base_address);
+}
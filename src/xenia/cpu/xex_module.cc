@@ -14,25 +14,30 @@
 #include "third_party/fmt/include/fmt/format.h"
 
 #include "xenia/base/byte_order.h"
+#include "xenia/base/clock.h"
 #include "xenia/base/cvar.h"
+#include "xenia/base/filesystem.h"
 #include "xenia/base/logging.h"
 #include "xenia/base/math.h"
 #include "xenia/base/memory.h"
+#include "xenia/base/startup_timeline.h"
+#include "xenia/base/threading.h"
+#include "xenia/base/xxhash.h"
 
 #include "xenia/cpu/cpu_flags.h"
 #include "xenia/cpu/export_resolver.h"
+#include "xenia/cpu/guest_memory_routines.h"
 #include "xenia/cpu/lzx.h"
 #include "xenia/cpu/processor.h"
 #include "xenia/emulator.h"
 #include "xenia/kernel/kernel_state.h"
+#include "xenia/kernel/util/crypto_utils.h"
 #include "xenia/kernel/xmodule.h"
 
-#include "third_party/crypto/TinySHA1.hpp"
-#include "third_party/crypto/rijndael-alg-fst.c"
-#include "third_party/crypto/rijndael-alg-fst.h"
 #include "third_party/pe/pe_image.h"
 #include "xenia/cpu/ppc/ppc_decode_data.h"
 #include "xenia/cpu/ppc/ppc_instr.h"
+#include "xenia/cpu/ppc/ppc_opcode_info.h"
 DEFINE_bool(disable_instruction_infocache, false,
             "Disables caching records of called instructions/mmio accesses.",
             "CPU");
@@ -48,6 +53,57 @@ DEFINE_bool(
     "finding/stress testing with the JIT",
     "CPU");
 
+DEFINE_bool(
+    precompile_known_functions, false,
+    "Translate all functions recorded in the instruction infocache as having "
+    "been called in previous runs when the module is loaded, instead of "
+    "translating them on first call. Reduces stutter at the cost of longer "
+    "load times. The infocache is keyed by the hash of the patched image, so "
+    "it never refers to stale code.",
+    "CPU");
+
+DEFINE_bool(
+    profile_guided_code_layout, false,
+    "Translate the functions recorded as hot in the instruction infocache "
+    "(by instrument_call_times, jit_tiered_compilation or guest_block_profile "
+    "in previous runs) first when the module is loaded, so they're placed "
+    "together in the code cache.",
+    "CPU");
+
+DEFINE_bool(
+    preanalyze_mmio_accesses, true,
+    "Scan the code of a module once when it's first loaded for 32 bit loads "
+    "and stores to constant addresses in the MMIO range, and record them in "
+    "the instruction infocache as if they had been caught by "
+    "record_mmio_access_exceptions. Lets "
+    "emit_mmio_aware_stores_for_recorded_exception_addresses avoid the access "
+    "violations the first run would otherwise take.",
+    "CPU");
+
+DEFINE_bool(
+    replace_guest_memory_routines, true,
+    "Recognize the memset and memcpy routines linked into the executable "
+    "among the functions found by the code preanalysis, and execute them as "
+    "host calls instead of translating their loops. The replaced routines are "
+    "logged when the module is loaded.",
+    "CPU");
+
+DEFINE_int32(
+    precompile_threads, 0,
+    "Number of background threads translating the functions selected by "
+    "enable_early_precompilation and precompile_known_functions. 0 to "
+    "translate them on the loading thread before the title starts, -1 to use "
+    "half of the logical CPU cores, a positive number to specify the number of "
+    "threads explicitly (up to the number of logical CPU cores).",
+    "CPU");
+
+DEFINE_bool(
+    cache_decompressed_xex_images, true,
+    "Store the decompressed images of compressed executables in the cache "
+    "directory, so they don't need to be decrypted and decompressed again when "
+    "the title is launched the next time.",
+    "CPU");
+
 DECLARE_bool(allow_plugins);
 
 static const uint8_t xe_xex2_retail_key[16] = {
@@ -60,20 +116,18 @@ static const uint8_t xe_xex2_devkit_key[16] = {
 void aes_decrypt_buffer(const uint8_t* session_key, const uint8_t* input_buffer,
                         const size_t input_size, uint8_t* output_buffer,
                         const size_t output_size) {
-  uint32_t rk[4 * (MAXNR + 1)];
-  uint8_t ivec[16] = {0};
-  int32_t Nr = rijndaelKeySetupDec(rk, session_key, 128);
-  const uint8_t* ct = input_buffer;
-  uint8_t* pt = output_buffer;
-  for (size_t n = 0; n < input_size; n += 16, ct += 16, pt += 16) {
-    // Decrypt 16 uint8_ts from input -> output.
-    rijndaelDecrypt(rk, Nr, ct, pt);
-    for (size_t i = 0; i < 16; i++) {
-      // XOR with previous.
-      pt[i] ^= ivec[i];
-      // Set previous.
-      ivec[i] = ct[i];
-    }
+  xe::kernel::util::Aes128CbcDecryptor decryptor(session_key);
+  // A partial last block is decrypted zero-padded rather than reading and
+  // writing past the buffers.
+  size_t whole_size = input_size & ~size_t(15);
+  decryptor.Decrypt(input_buffer, whole_size, output_buffer);
+  if (whole_size < input_size) {
+    uint8_t last_block[16] = {};
+    std::memcpy(last_block, input_buffer + whole_size,
+                input_size - whole_size);
+    decryptor.Decrypt(last_block, sizeof(last_block), last_block);
+    std::memcpy(output_buffer + whole_size, last_block,
+                input_size - whole_size);
   }
 }
 
@@ -85,7 +139,7 @@ using xe::kernel::KernelState;
 XexModule::XexModule(Processor* processor, KernelState* kernel_state)
     : Module(processor), processor_(processor), kernel_state_(kernel_state) {}
 
-XexModule::~XexModule() {}
+XexModule::~XexModule() { ShutdownPrecompileThreads(); }
 
 bool XexModule::GetOptHeader(const xex2_header* header, xex2_header_keys key,
                              void** out_ptr) {
@@ -436,15 +490,14 @@ int XexModule::ApplyPatch(XexModule* module) {
   }
 
   uint8_t digest[0x14];
-  sha1::SHA1 s;
+  kernel::util::Sha1 s;
   // Now loop through each block and apply the delta patches inside
   while (cur_block->block_size) {
     const auto* next_block = (const xex2_compressed_block_info*)p;
 
     // Compare block hash, if no match we probably used wrong decrypt key
-    s.reset();
-    s.processBytes(p, cur_block->block_size);
-    s.finalize(digest);
+    s.Update(p, cur_block->block_size);
+    s.Finalize(digest);
 
     if (memcmp(digest, cur_block->block_hash, 0x14) != 0) {
       result_code = 9;
@@ -648,9 +701,8 @@ int XexModule::ReadImageBasicCompressed(const void* xex_addr,
   std::memset(buffer, 0, total_size);  // Quickly zero the contents.
   uint8_t* d = buffer;
 
-  uint32_t rk[4 * (MAXNR + 1)];
-  uint8_t ivec[16] = {0};
-  int32_t Nr = rijndaelKeySetupDec(rk, session_key_, 128);
+  // The CBC chain continues across the blocks.
+  kernel::util::Aes128CbcDecryptor decryptor(session_key_);
 
   for (size_t n = 0; n < block_count; n++) {
     const uint32_t data_size = comp_info.blocks[n].data_size;
@@ -664,20 +716,11 @@ int XexModule::ReadImageBasicCompressed(const void* xex_addr,
         }
         memcpy(d, p, data_size);
         break;
-      case XEX_ENCRYPTION_NORMAL: {
-        const uint8_t* ct = p;
-        uint8_t* pt = d;
-        for (size_t m = 0; m < data_size; m += 16, ct += 16, pt += 16) {
-          // Decrypt 16 uint8_ts from input -> output.
-          rijndaelDecrypt(rk, Nr, ct, pt);
-          for (size_t i = 0; i < 16; i++) {
-            // XOR with previous.
-            pt[i] ^= ivec[i];
-            // Set previous.
-            ivec[i] = ct[i];
-          }
-        }
-      } break;
+      case XEX_ENCRYPTION_NORMAL:
+        // Whole blocks, as the chain continues from the last one.
+        decryptor.Decrypt(p, xe::round_up(data_size, uint32_t(16), false),
+                          d);
+        break;
       default:
         assert_always();
         return 1;
@@ -690,7 +733,104 @@ int XexModule::ReadImageBasicCompressed(const void* xex_addr,
   return 0;
 }
 
+namespace {
+struct DecompressedImageCacheHeader {
+  static constexpr uint32_t kMagic = 0x474D4958;  // 'XIMG'
+  static constexpr uint32_t kVersion = 1;
+
+  uint32_t magic;
+  uint32_t version;
+  uint32_t image_size;
+  uint32_t reserved;
+  uint64_t image_hash;
+};
+}  // namespace
+
+std::filesystem::path XexModule::GetDecompressedImageCachePath(
+    const void* xex_addr, size_t xex_length) const {
+  if (!cvars::cache_decompressed_xex_images) {
+    return {};
+  }
+  Emulator* emulator = kernel_state_->emulator();
+  if (!emulator || emulator->cache_root().empty()) {
+    return {};
+  }
+  uint64_t xex_hash =
+      XXH3_64bits_withSeed(xex_addr, xex_length, is_dev_kit_ ? 1 : 0);
+  return emulator->cache_root() / "modules" / "images" /
+         fmt::format("{:016X}.bin", xex_hash);
+}
+
+bool XexModule::ReadDecompressedImageCache(const std::filesystem::path& path,
+                                           uint8_t* image,
+                                           uint32_t image_size) const {
+  FILE* file = xe::filesystem::OpenFile(path, "rb");
+  if (!file) {
+    return false;
+  }
+  DecompressedImageCacheHeader header;
+  bool read = fread(&header, sizeof(header), 1, file) == 1 &&
+              header.magic == DecompressedImageCacheHeader::kMagic &&
+              header.version == DecompressedImageCacheHeader::kVersion &&
+              header.image_size == image_size &&
+              fread(image, image_size, 1, file) == 1;
+  fclose(file);
+  if (!read || XXH3_64bits(image, image_size) != header.image_hash) {
+    XELOGW("Ignoring the invalid decompressed XEX image cache file {}",
+           xe::path_to_utf8(path));
+    return false;
+  }
+  return true;
+}
+
+void XexModule::WriteDecompressedImageCache(const std::filesystem::path& path,
+                                            const uint8_t* image,
+                                            uint32_t image_size) const {
+  std::error_code error_code;
+  std::filesystem::create_directories(path.parent_path(), error_code);
+  FILE* file = xe::filesystem::OpenFile(path, "wb");
+  if (!file) {
+    XELOGW("Failed to create the decompressed XEX image cache file {}",
+           xe::path_to_utf8(path));
+    return;
+  }
+  DecompressedImageCacheHeader header = {};
+  header.magic = DecompressedImageCacheHeader::kMagic;
+  header.version = DecompressedImageCacheHeader::kVersion;
+  header.image_size = image_size;
+  header.image_hash = XXH3_64bits(image, image_size);
+  bool written = fwrite(&header, sizeof(header), 1, file) == 1 &&
+                 fwrite(image, image_size, 1, file) == 1;
+  fclose(file);
+  if (!written) {
+    XELOGW("Failed to write the decompressed XEX image cache file {}",
+           xe::path_to_utf8(path));
+    std::filesystem::remove(path, error_code);
+  }
+}
+
 int XexModule::ReadImageCompressed(const void* xex_addr, size_t xex_length) {
+  // Decryption and decompression are skipped entirely if the result is
+  // already cached.
+  std::filesystem::path cache_path =
+      GetDecompressedImageCachePath(xex_addr, xex_length);
+  if (!cache_path.empty() && std::filesystem::exists(cache_path)) {
+    uint32_t uncompressed_size = image_size();
+    if (memory()
+            ->LookupHeap(base_address_)
+            ->AllocFixed(
+                base_address_, uncompressed_size, 4096,
+                xe::kMemoryAllocationReserve | xe::kMemoryAllocationCommit,
+                xe::kMemoryProtectRead | xe::kMemoryProtectWrite)) {
+      uint8_t* buffer = memory()->TranslateVirtual(base_address_);
+      if (ReadDecompressedImageCache(cache_path, buffer, uncompressed_size)) {
+        return 0;
+      }
+      // Decompressing again into the same allocation.
+      memory()->LookupHeap(base_address_)->Release(base_address_);
+    }
+  }
+
   const uint32_t exe_length =
       static_cast<uint32_t>(xex_length - xex_header()->header_size);
   const uint8_t* exe_buffer =
@@ -707,7 +847,7 @@ int XexModule::ReadImageCompressed(const void* xex_addr, size_t xex_length) {
   uint8_t* compress_buffer = NULL;
   const uint8_t* p = NULL;
   uint8_t* d = NULL;
-  sha1::SHA1 s;
+  kernel::util::Sha1 s;
 
   // Decrypt (if needed).
   bool free_input = false;
@@ -748,9 +888,8 @@ int XexModule::ReadImageCompressed(const void* xex_addr, size_t xex_length) {
     const auto* next_block = (const xex2_compressed_block_info*)p;
 
     // Compare block hash, if no match we probably used wrong decrypt key
-    s.reset();
-    s.processBytes(p, cur_block->block_size);
-    s.finalize(block_calced_digest);
+    s.Update(p, cur_block->block_size);
+    s.Finalize(block_calced_digest);
     if (memcmp(block_calced_digest, cur_block->block_hash, 0x14) != 0) {
       result_code = 2;
       break;
@@ -796,6 +935,9 @@ int XexModule::ReadImageCompressed(const void* xex_addr, size_t xex_length) {
       result_code = lzx_decompress(
           compress_buffer, d - compress_buffer, buffer, uncompressed_size,
           compression_info->normal.window_size, nullptr, 0);
+      if (!result_code && !cache_path.empty()) {
+        WriteDecompressedImageCache(cache_path, buffer, uncompressed_size);
+      }
     } else {
       XELOGE("Unable to allocate XEX memory at {:08X}-{:08X}.", base_address_,
              uncompressed_size);
@@ -936,6 +1078,7 @@ void XexModule::ReadSecurityInfo() {
 
 bool XexModule::Load(const std::string_view name, const std::string_view path,
                      const void* xex_addr, size_t xex_length) {
+  SCOPE_startup_timeline("XexModule::Load");
   auto src_header = reinterpret_cast<const xex2_header*>(xex_addr);
 
   if (src_header->magic == kXEX1Signature) {
@@ -990,6 +1133,7 @@ bool XexModule::Load(const std::string_view name, const std::string_view path,
 }
 
 bool XexModule::LoadContinue() {
+  SCOPE_startup_timeline("XexModule::LoadContinue");
   // Second part of image load
   // Split from Load() so that we can patch the XEX before loading this data
   assert_false(finished_load_);
@@ -1126,15 +1270,13 @@ bool XexModule::LoadContinue() {
 }
 
 void XexModule::Precompile() {
-  sha1::SHA1 final_image_sha_;
-
-  final_image_sha_.reset();
+  kernel::util::Sha1 final_image_sha_;
 
   unsigned high_code = this->high_address_ - this->low_address_;
 
-  final_image_sha_.processBytes(memory()->TranslateVirtual(this->low_address_),
-                                high_code);
-  final_image_sha_.finalize(image_sha_bytes_);
+  final_image_sha_.Update(memory()->TranslateVirtual(this->low_address_),
+                          high_code);
+  final_image_sha_.Finalize(image_sha_bytes_);
 
   char fmtbuf[16];
 
@@ -1148,9 +1290,15 @@ void XexModule::Precompile() {
   if (!FindSaveRest()) {
     return;
   }
+  FindMemoryRoutines();
 
   info_cache_.Init(this);
-  PrecompileDiscoveredFunctions();
+  PreanalyzeMMIOAccesses();
+  PrecompileHotFunctions();
+  std::vector<uint32_t> precompile_addresses;
+  PrecompileKnownFunctions(precompile_addresses);
+  PrecompileDiscoveredFunctions(precompile_addresses);
+  PrecompileFunctions(std::move(precompile_addresses));
 }
 bool XexModule::Unload() {
   if (!loaded_) {
@@ -1158,6 +1306,8 @@ bool XexModule::Unload() {
   }
   loaded_ = false;
 
+  ShutdownPrecompileThreads();
+
   // If this isn't a patch, just deallocate the memory occupied by the exe
   if (!is_patch()) {
     assert_not_zero(base_address_);
@@ -1417,7 +1567,8 @@ InfoCacheFlags* XexModule::GetInstructionAddressFlags(uint32_t guest_addr) {
 
   return info_cache_.LookupFlags(guest_addr);
 }
-void XexModule::PrecompileDiscoveredFunctions() {
+void XexModule::PrecompileDiscoveredFunctions(
+    std::vector<uint32_t>& addresses_out) {
   if (!cvars::enable_early_precompilation) {
     return;
   }
@@ -1427,34 +1578,163 @@ void XexModule::PrecompileDiscoveredFunctions() {
     if (other < low_address_ || other >= high_address_) {
       continue;
     }
-    auto sym = processor_->LookupFunction(other);
-
-    if (!sym || sym->status() != Symbol::Status::kDefined) {
-      processor_->ResolveFunction(other);
+    addresses_out.push_back(other);
+  }
+}
+void XexModule::PrecompileHotFunctions() {
+  if (!cvars::profile_guided_code_layout) {
+    return;
+  }
+  uint32_t end = (high_address_ - low_address_) / 4;
+  auto flags = info_cache_.LookupFlags(0);
+  if (!flags) {
+    return;
+  }
+  // Functions whose entry has been executed as many times as a function
+  // becomes hot after in the runs profiled with guest_block_profile are hot
+  // too.
+  uint32_t hot_block_frequency = InfoCacheFlags::GetBlockFrequency(
+      std::max(cvars::jit_hot_function_threshold, uint32_t(1)));
+  // Nothing else is being translated yet, so translating the hot functions
+  // back to back here places them next to each other in the code cache
+  // instead of scattering them in first-call order.
+  uint32_t num_precompiled = 0;
+  for (uint32_t i = 0; i < end; i++) {
+    if (!flags[i].is_hot &&
+        !(flags[i].was_resolved &&
+          flags[i].block_frequency >= hot_block_frequency)) {
+      continue;
+    }
+    uint32_t addr = low_address_ + (i * 4);
+    auto function = processor_->LookupFunction(addr);
+    if (!function || function->status() == Symbol::Status::kDefined ||
+        !function->is_guest()) {
+      continue;
+    }
+    // Profiled hot code skips the baseline tier.
+    static_cast<GuestFunction*>(function)->set_hot(true);
+    if (processor_->ResolveFunction(addr)) {
+      ++num_precompiled;
     }
   }
+  if (num_precompiled) {
+    XELOGI("Placed {} profiled hot functions of {} together", num_precompiled,
+           name_);
+  }
 }
-void XexModule::PrecompileKnownFunctions() {
-  if (!cvars::enable_early_precompilation) {
+void XexModule::PrecompileKnownFunctions(std::vector<uint32_t>& addresses_out) {
+  if (!cvars::enable_early_precompilation &&
+      !cvars::precompile_known_functions) {
     return;
   }
-  uint32_t start = 0;
   uint32_t end = (high_address_ - low_address_) / 4;
   auto flags = info_cache_.LookupFlags(0);
   if (!flags) {
     return;
   }
-  // maybe should pre-acquire global crit?
   for (uint32_t i = 0; i < end; i++) {
     if (flags[i].was_resolved) {
-      uint32_t addr = low_address_ + (i * 4);
-      auto sym = processor_->LookupFunction(addr);
+      addresses_out.push_back(low_address_ + (i * 4));
+    }
+  }
+}
+void XexModule::PrecompileFunctions(std::vector<uint32_t> addresses) {
+  if (addresses.empty()) {
+    return;
+  }
+  // Known and discovered functions overlap a lot.
+  std::sort(addresses.begin(), addresses.end());
+  addresses.erase(std::unique(addresses.begin(), addresses.end()),
+                  addresses.end());
+  // Translate the functions executed the most in the runs profiled with
+  // guest_block_profile first, so they're ready before the cold ones if the
+  // title starts before everything has been precompiled.
+  InfoCacheFlags* flags = info_cache_.LookupFlags(0);
+  if (flags) {
+    std::stable_sort(addresses.begin(), addresses.end(),
+                     [this, flags](uint32_t a, uint32_t b) {
+                       return flags[(a - low_address_) / 4].block_frequency >
+                              flags[(b - low_address_) / 4].block_frequency;
+                     });
+  }
+
+  uint32_t thread_count = 0;
+  if (cvars::precompile_threads < 0) {
+    thread_count =
+        std::max(xe::threading::logical_processor_count() / 2, uint32_t(1));
+  } else {
+    thread_count = std::min(uint32_t(cvars::precompile_threads),
+                            xe::threading::logical_processor_count());
+  }
 
-      if (!sym || sym->status() != Symbol::Status::kDefined) {
-        processor_->ResolveFunction(addr);
-      }
+  if (!thread_count) {
+    uint64_t start_time = Clock::QueryHostUptimeMillis();
+    for (uint32_t address : addresses) {
+      PrecompileFunction(address);
+    }
+    XELOGI("Precompiled {} functions of {} in {} ms", addresses.size(), name_,
+           Clock::QueryHostUptimeMillis() - start_time);
+    return;
+  }
+
+  // Translated functions are published to the indirection table by the code
+  // cache as each one is placed, and anything the guest reaches before its
+  // worker does is still translated on demand - the entry table makes
+  // whichever thread gets there first do the work while the other waits.
+  ShutdownPrecompileThreads();
+  precompile_queue_ = std::move(addresses);
+  precompile_queue_next_ = 0;
+  precompile_threads_done_ = 0;
+  precompile_thread_count_ = thread_count;
+  precompile_start_time_ = Clock::QueryHostUptimeMillis();
+  precompile_shutdown_ = false;
+  for (uint32_t i = 0; i < thread_count; ++i) {
+    xe::threading::Thread::CreationParameters params;
+    params.initial_priority = xe::threading::ThreadPriority::kBelowNormal;
+    std::unique_ptr<xe::threading::Thread> thread =
+        xe::threading::Thread::Create(params, [this]() { PrecompileThread(); });
+    assert_not_null(thread);
+    thread->set_name("Precompile");
+    precompile_threads_.push_back(std::move(thread));
+  }
+}
+void XexModule::PrecompileFunction(uint32_t address) {
+  auto sym = processor_->LookupFunction(address);
+  if (!sym || sym->status() != Symbol::Status::kDefined) {
+    processor_->ResolveFunction(address);
+  }
+}
+void XexModule::PrecompileThread() {
+  while (!precompile_shutdown_.load(std::memory_order_relaxed)) {
+    size_t index =
+        precompile_queue_next_.fetch_add(1, std::memory_order_relaxed);
+    if (index >= precompile_queue_.size()) {
+      break;
     }
+    PrecompileFunction(precompile_queue_[index]);
+  }
+  if (precompile_threads_done_.fetch_add(1) + 1 == precompile_thread_count_ &&
+      !precompile_shutdown_) {
+    XELOGI("Precompiled {} functions of {} in the background in {} ms",
+           precompile_queue_.size(), name_,
+           Clock::QueryHostUptimeMillis() - precompile_start_time_);
+  }
+}
+void XexModule::WaitForPrecompilation() {
+  for (auto& thread : precompile_threads_) {
+    xe::threading::Wait(thread.get(), false);
+  }
+}
+void XexModule::ShutdownPrecompileThreads() {
+  if (precompile_threads_.empty()) {
+    return;
+  }
+  precompile_shutdown_ = true;
+  for (auto& thread : precompile_threads_) {
+    xe::threading::Wait(thread.get(), false);
   }
+  precompile_threads_.clear();
+  precompile_queue_.clear();
 }
 
 static uint32_t GetBLCalledFunction(XexModule* xexmod, uint32_t current_base,
@@ -1616,6 +1896,251 @@ std::vector<uint32_t> XexModule::PreanalyzeCode() {
   delete[] funcstart_candstack2;
   return result;
 }
+
+// Base of the physical address range the GPU and audio register apertures
+// (0x7FC80000 and 0x7FEA0000) are mapped into.
+static constexpr uint32_t kMMIOApertureBase = 0x7FC00000;
+static constexpr uint32_t kMMIOApertureEnd = 0x80000000;
+
+void XexModule::PreanalyzeMMIOAccesses() {
+  if (!cvars::preanalyze_mmio_accesses) {
+    return;
+  }
+  auto header = info_cache_.GetHeader();
+  if (!header || header->mmio_analysis_version ==
+                     XexInfoCache::CURRENT_MMIO_ANALYSIS_VERSION) {
+    return;
+  }
+  uint64_t start_time = Clock::QueryHostUptimeMillis();
+
+  uint32_t highest_exec_addr = 0;
+  for (auto&& sec : pe_sections_) {
+    if ((sec.flags & kXEPESectionContainsCode)) {
+      highest_exec_addr =
+          std::max<uint32_t>(highest_exec_addr, sec.address + sec.size);
+    }
+  }
+  highest_exec_addr = std::min(highest_exec_addr, high_address_);
+
+  // Register bases are almost always built with lis/addis + ori/addi right
+  // before the accesses, so a forward walk through each function that only
+  // knows about those is enough:
+  //   lis r11, 0x7FC8
+  //   stw r10, 0x1234(r11)
+  // Values are forgotten whenever the path can't be followed. A wrong guess
+  // only makes an access take the slower MMIO aware path, which still handles
+  // ordinary memory.
+  struct RegisterState {
+    uint32_t known = 0;  // bit per GPR
+    uint32_t values[32];
+
+    void Set(uint32_t reg, uint32_t value) {
+      known |= 1u << reg;
+      values[reg] = value;
+    }
+    void Forget(uint32_t reg) { known &= ~(1u << reg); }
+    bool Get(uint32_t reg, uint32_t& value_out) const {
+      if (!(known & (1u << reg))) {
+        return false;
+      }
+      value_out = values[reg];
+      return true;
+    }
+    // rA|0 - r0 reads as 0 when used as a base.
+    bool GetBase(uint32_t reg, uint32_t& value_out) const {
+      if (!reg) {
+        value_out = 0;
+        return true;
+      }
+      return Get(reg, value_out);
+    }
+  };
+
+  auto function_starts = PreanalyzeCode();
+  uint32_t num_sites = 0;
+  for (size_t f = 0; f < function_starts.size(); ++f) {
+    uint32_t start = function_starts[f];
+    uint32_t end = f + 1 < function_starts.size() ? function_starts[f + 1]
+                                                  : highest_exec_addr;
+    if (start < low_address_ || start >= highest_exec_addr) {
+      continue;
+    }
+    end = std::min(end, highest_exec_addr);
+
+    RegisterState state;
+    auto code = memory()->TranslateVirtual<const uint32_t*>(start);
+    for (uint32_t address = start; address < end; address += 4, ++code) {
+      ppc::PPCOpcodeBits bits{xe::byte_swap(*code)};
+      uint32_t rt = bits.D.RT;
+      uint32_t ra = bits.D.RA;
+      uint32_t simm = uint32_t(int32_t(int16_t(bits.D.DS)));
+
+      // Address of the 32 bit access, if this is one and it's known.
+      bool is_access = false;
+      bool has_address = false;
+      uint32_t access_address = 0;
+      uint32_t base = 0, index = 0;
+
+      auto opcode = ppc::LookupOpcode(bits.code);
+      switch (opcode) {
+        case ppc::PPCOpcode::addi:
+          if (state.GetBase(ra, base)) {
+            state.Set(rt, base + simm);
+          } else {
+            state.Forget(rt);
+          }
+          break;
+        case ppc::PPCOpcode::addis:
+          if (state.GetBase(ra, base)) {
+            state.Set(rt, base + (simm << 16));
+          } else {
+            state.Forget(rt);
+          }
+          break;
+        case ppc::PPCOpcode::ori:
+          // ori rA, rS, UIMM
+          if (state.Get(rt, base)) {
+            state.Set(ra, base | uint32_t(bits.D.DS));
+          } else {
+            state.Forget(ra);
+          }
+          break;
+        case ppc::PPCOpcode::oris:
+          if (state.Get(rt, base)) {
+            state.Set(ra, base | (uint32_t(bits.D.DS) << 16));
+          } else {
+            state.Forget(ra);
+          }
+          break;
+        case ppc::PPCOpcode::lwz:
+        case ppc::PPCOpcode::lwzu:
+        case ppc::PPCOpcode::stw:
+        case ppc::PPCOpcode::stwu:
+          is_access = true;
+          has_address = state.GetBase(ra, base);
+          access_address = base + simm;
+          if (opcode == ppc::PPCOpcode::lwz || opcode == ppc::PPCOpcode::lwzu) {
+            state.Forget(rt);
+          }
+          if (opcode == ppc::PPCOpcode::lwzu ||
+              opcode == ppc::PPCOpcode::stwu) {
+            if (has_address) {
+              state.Set(ra, access_address);
+            } else {
+              state.Forget(ra);
+            }
+          }
+          break;
+        case ppc::PPCOpcode::lwzx:
+        case ppc::PPCOpcode::lwzux:
+        case ppc::PPCOpcode::lwbrx:
+        case ppc::PPCOpcode::stwx:
+        case ppc::PPCOpcode::stwux:
+        case ppc::PPCOpcode::stwbrx:
+          is_access = true;
+          has_address = state.GetBase(ra, base) && state.Get(bits.X.RB, index);
+          access_address = base + index;
+          if (opcode == ppc::PPCOpcode::lwzx ||
+              opcode == ppc::PPCOpcode::lwzux ||
+              opcode == ppc::PPCOpcode::lwbrx) {
+            state.Forget(rt);
+          }
+          if (opcode == ppc::PPCOpcode::lwzux ||
+              opcode == ppc::PPCOpcode::stwux) {
+            if (has_address) {
+              state.Set(ra, access_address);
+            } else {
+              state.Forget(ra);
+            }
+          }
+          break;
+        case ppc::PPCOpcode::bx:
+        case ppc::PPCOpcode::bcx:
+        case ppc::PPCOpcode::bclrx:
+        case ppc::PPCOpcode::bcctrx:
+          if (bits.I.LK) {
+            // Calls clobber r0 and r3-r12, the rest is nonvolatile.
+            state.known &= ~0x1FF9u;
+          } else if (opcode == ppc::PPCOpcode::bx ||
+                     (bits.B.BO & 0x14) == 0x14) {
+            // Unconditional, whatever follows is reached from elsewhere.
+            state.known = 0;
+          }
+          break;
+        case ppc::PPCOpcode::lmw:
+          state.known &= (1u << rt) - 1;
+          break;
+        default:
+          // Every other GPR write goes to rD or to rA. Also forgets registers
+          // for instructions that use those fields for something else, which
+          // is always safe.
+          state.Forget(rt);
+          state.Forget(ra);
+          break;
+      }
+
+      if (is_access && has_address && access_address >= kMMIOApertureBase &&
+          access_address < kMMIOApertureEnd) {
+        auto flags = info_cache_.LookupFlags(address - low_address_);
+        if (flags && !flags->accessed_mmio) {
+          flags->accessed_mmio = 1;
+          ++num_sites;
+        }
+      }
+    }
+  }
+
+  header->mmio_analysis_version = XexInfoCache::CURRENT_MMIO_ANALYSIS_VERSION;
+  XELOGI("Found {} likely MMIO access sites in {} in {} ms", num_sites, name_,
+         Clock::QueryHostUptimeMillis() - start_time);
+}
+void XexModule::FindMemoryRoutines() {
+  if (!cvars::replace_guest_memory_routines) {
+    return;
+  }
+  uint32_t replaced_count = 0;
+  uint32_t replaced_bytes = 0;
+  for (uint32_t address : PreanalyzeCode()) {
+    if (address < low_address_ || address >= high_address_) {
+      continue;
+    }
+    const GuestMemoryRoutine* routine = MatchGuestMemoryRoutine(
+        memory()->TranslateVirtual(address), (high_address_ - address) / 4);
+    if (!routine) {
+      continue;
+    }
+    Function* function;
+    if (DeclareFunction(address, &function) != Symbol::Status::kNew) {
+      // Already declared, such as an import thunk or __savegprlr_*.
+      continue;
+    }
+    // Rewrite the beginning like an import thunk, the rest of the routine is
+    // left intact.
+    //     sc 2
+    //     blr
+    BaseHeap* heap = memory()->LookupHeap(address);
+    uint32_t old_protect;
+    heap->Protect(address, 8, kMemoryProtectRead | kMemoryProtectWrite,
+                  &old_protect);
+    uint8_t* p = memory()->TranslateVirtual(address);
+    xe::store_and_swap<uint32_t>(p + 0x0, 0x44000042);
+    xe::store_and_swap<uint32_t>(p + 0x4, 0x4E800020);
+    heap->Protect(address, 8, old_protect);
+    function->set_end_address(address + 4);
+    function->set_name(routine->name);
+    static_cast<GuestFunction*>(function)->SetupExtern(routine->handler);
+    function->set_status(Symbol::Status::kDeclared);
+    XELOGI("{}: Replaced {} at {:08X} ({} bytes)", name_, routine->name,
+           address, routine->code_size);
+    ++replaced_count;
+    replaced_bytes += routine->code_size;
+  }
+  if (replaced_count) {
+    XELOGI("{}: Replaced {} guest memory routines ({} bytes of code)", name_,
+           replaced_count, replaced_bytes);
+  }
+}
+
 bool XexModule::FindSaveRest() {
   // Special stack save/restore functions.
   // http://research.microsoft.com/en-us/um/redmond/projects/invisible/src/crt/md/ppc/xxx.s.htm
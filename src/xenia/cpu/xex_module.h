@@ -10,9 +10,15 @@
 #ifndef XENIA_CPU_XEX_MODULE_H_
 #define XENIA_CPU_XEX_MODULE_H_
 
+#include <atomic>
+#include <cstring>
+#include <filesystem>
+#include <memory>
 #include <string>
 #include <vector>
+#include "xenia/base/atomic.h"
 #include "xenia/base/mapped_memory.h"
+#include "xenia/base/threading.h"
 #include "xenia/cpu/module.h"
 #include "xenia/kernel/util/xex2_info.h"
 
@@ -37,19 +43,78 @@ struct InfoCacheFlags {
   uint32_t is_syscall_func : 1;
   uint32_t is_return_site : 1;  // address can be reached from another function
                                 // by returning
-  uint32_t reserved : 28;
+  uint32_t is_hot : 1;  // function start found to be hot by
+                        // instrument_call_times or jit_tiered_compilation
+  // GetBlockFrequency of the executions of the basic block starting here in
+  // the last run profiled with guest_block_profile, 0 if not executed.
+  uint32_t block_frequency : 4;
+  uint32_t reserved : 23;
+
+  // Sets the fields set in bits. Other fields of the same instruction may be
+  // updated by other threads at the same time, such as when functions are
+  // compiled in parallel, and a plain bitfield store rewrites the whole word.
+  void Set(InfoCacheFlags bits);
+  void SetBlockFrequency(uint32_t frequency);
+
+  // Floor of the base 4 logarithm of the execution count plus 1, saturated.
+  static constexpr uint32_t GetBlockFrequency(uint64_t execution_count) {
+    uint32_t frequency = 0;
+    while (execution_count && frequency < 15) {
+      ++frequency;
+      execution_count >>= 2;
+    }
+    return frequency;
+  }
 };
 static_assert(sizeof(InfoCacheFlags) == 4,
               "InfoCacheFlags size should be equal to sizeof ppc instruction.");
 
+inline void InfoCacheFlags::Set(InfoCacheFlags bits) {
+  uint32_t mask;
+  std::memcpy(&mask, &bits, sizeof(mask));
+  auto word = reinterpret_cast<volatile uint32_t*>(this);
+  uint32_t value;
+  do {
+    value = *word;
+    if ((value & mask) == mask) {
+      return;
+    }
+  } while (!xe::atomic_cas(value, value | mask, word));
+}
+
+inline void InfoCacheFlags::SetBlockFrequency(uint32_t frequency) {
+  InfoCacheFlags field = {};
+  field.block_frequency = 0xF;
+  InfoCacheFlags bits = {};
+  bits.block_frequency = frequency;
+  uint32_t mask, new_bits;
+  std::memcpy(&mask, &field, sizeof(mask));
+  std::memcpy(&new_bits, &bits, sizeof(new_bits));
+  auto word = reinterpret_cast<volatile uint32_t*>(this);
+  uint32_t value;
+  do {
+    value = *word;
+    if ((value & mask) == new_bits) {
+      return;
+    }
+  } while (!xe::atomic_cas(value, (value & ~mask) | new_bits, word));
+}
+
 struct XexInfoCache {
   // increment this to invalidate all user infocaches
   static constexpr uint32_t CURRENT_INFOCACHE_VERSION = 4;
 
+  // increment this to rerun the static MMIO access analysis on caches that
+  // have already been analyzed
+  static constexpr uint32_t CURRENT_MMIO_ANALYSIS_VERSION = 1;
+
   struct InfoCacheFlagsHeader {
     uint32_t version;
+    // CURRENT_MMIO_ANALYSIS_VERSION once accessed_mmio has been prepopulated
+    // for the image, 0 otherwise.
+    uint32_t mmio_analysis_version;
 
-    unsigned char reserved[252];
+    unsigned char reserved[248];
 
     InfoCacheFlags* LookupFlags(unsigned offset) {
       return &reinterpret_cast<InfoCacheFlags*>(&this[1])[offset];
@@ -233,14 +298,27 @@ class XexModule : public xe::cpu::Module {
   InfoCacheFlags* GetInstructionAddressFlags(uint32_t guest_addr);
 
   virtual void Precompile() override;
+  // Waits for the background threads started by Precompile to translate all
+  // the functions queued for them.
+  void WaitForPrecompilation();
 
  protected:
   std::unique_ptr<Function> CreateFunction(uint32_t address) override;
 
  private:
-  void PrecompileKnownFunctions();
-  void PrecompileDiscoveredFunctions();
+  void PrecompileHotFunctions();
+  void PrecompileKnownFunctions(std::vector<uint32_t>& addresses_out);
+  void PrecompileDiscoveredFunctions(std::vector<uint32_t>& addresses_out);
+  // Translates the given functions, either synchronously or on a pool of
+  // background threads depending on the precompile_threads cvar.
+  void PrecompileFunctions(std::vector<uint32_t> addresses);
+  void PrecompileFunction(uint32_t address);
+  void PrecompileThread();
+  void ShutdownPrecompileThreads();
   std::vector<uint32_t> PreanalyzeCode();
+  // Flags the 32 bit loads and stores whose address is a constant in the MMIO
+  // aperture as accessed_mmio, so they don't have to fault once first.
+  void PreanalyzeMMIOAccesses();
   friend struct XexInfoCache;
   void ReadSecurityInfo();
 
@@ -248,12 +326,25 @@ class XexModule : public xe::cpu::Module {
   int ReadImageUncompressed(const void* xex_addr, size_t xex_length);
   int ReadImageBasicCompressed(const void* xex_addr, size_t xex_length);
   int ReadImageCompressed(const void* xex_addr, size_t xex_length);
+  // The decompressed images of XEX files with normal compression are cached
+  // on disk, keyed by the hash of the whole XEX file and the key used to
+  // decrypt it. Returns an empty path if caching is disabled.
+  std::filesystem::path GetDecompressedImageCachePath(const void* xex_addr,
+                                                      size_t xex_length) const;
+  bool ReadDecompressedImageCache(const std::filesystem::path& path,
+                                  uint8_t* image, uint32_t image_size) const;
+  void WriteDecompressedImageCache(const std::filesystem::path& path,
+                                   const uint8_t* image,
+                                   uint32_t image_size) const;
 
   int ReadPEHeaders();
 
   bool SetupLibraryImports(const std::string_view name,
                            const xex2_import_library* library);
   bool FindSaveRest();
+  // Replaces the guest routines recognized by MatchGuestMemoryRoutine with
+  // host calls.
+  void FindMemoryRoutines();
 
   Processor* processor_ = nullptr;
   kernel::KernelState* kernel_state_ = nullptr;
@@ -285,6 +376,14 @@ class XexModule : public xe::cpu::Module {
   uint8_t image_sha_bytes_[20];
   std::string image_sha_str_;
   XexInfoCache info_cache_;
+
+  std::vector<uint32_t> precompile_queue_;
+  std::atomic<size_t> precompile_queue_next_ = {0};
+  std::atomic<size_t> precompile_threads_done_ = {0};
+  std::atomic<bool> precompile_shutdown_ = {false};
+  size_t precompile_thread_count_ = 0;
+  uint64_t precompile_start_time_ = 0;
+  std::vector<std::unique_ptr<xe::threading::Thread>> precompile_threads_;
 };
 
 }  // namespace cpu
@@ -0,0 +1,161 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2026 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "xenia/base/clock.h"
+#include "xenia/base/console_app_main.h"
+#include "xenia/base/cvar.h"
+#include "xenia/base/filesystem.h"
+#include "xenia/base/logging.h"
+#include "xenia/base/threading.h"
+#include "xenia/cpu/compiler/compiler.h"
+#include "xenia/cpu/cpu_flags.h"
+#include "xenia/cpu/xex_module.h"
+#include "xenia/emulator.h"
+#include "xenia/gpu/null/null_graphics_system.h"
+#include "xenia/kernel/kernel_state.h"
+#include "xenia/kernel/user_module.h"
+
+DEFINE_transient_path(target, "", "The .xex to translate.", "General");
+DEFINE_transient_path(
+    cache_root, "",
+    "Host cache root of the emulator to write the instruction info cache of "
+    "the module to.",
+    "Storage");
+DEFINE_int32(xex_precompile_threads, -1,
+             "Number of threads to translate the functions on, -1 to use all "
+             "the logical CPU cores, 0 to translate them on the main thread.",
+             "CPU");
+
+DECLARE_bool(disable_instruction_infocache);
+DECLARE_bool(enable_early_precompilation);
+DECLARE_int32(precompile_threads);
+
+namespace xe {
+namespace cpu {
+
+// Translates all the functions of a module found by the code analysis the
+// emulator does with enable_early_precompilation, as it would while loading
+// the module, and reports the translation throughput. The translated functions
+// are recorded in the instruction info cache of the module under the cache
+// root, so the emulator using the same cache root precompiles them when
+// loading the module with precompile_known_functions, without the analysis.
+//
+// With --jit_function_stats, also reports the time spent in each compiler pass
+// and the sizes of the HIR and of the emitted code, for tracking the
+// translation performance over a corpus of real functions, and
+// --jit_function_stats_path writes the stats of every function.
+int xex_precompile_main(const std::vector<std::string>& args) {
+  if (cvars::target.empty() || cvars::cache_root.empty()) {
+    XELOGE("Usage: {} [target.xex] [cache_root]", xe::path_to_utf8(args[0]));
+    return 1;
+  }
+  if (cvars::disable_instruction_infocache) {
+    XELOGW(
+        "disable_instruction_infocache is enabled, only measuring the "
+        "translation");
+  }
+  cvars::enable_early_precompilation = true;
+  if (cvars::xex_precompile_threads < 0) {
+    cvars::precompile_threads =
+        int32_t(xe::threading::logical_processor_count());
+  } else {
+    cvars::precompile_threads = cvars::xex_precompile_threads;
+  }
+
+  std::filesystem::path target = std::filesystem::absolute(cvars::target);
+  std::filesystem::path cache_root =
+      std::filesystem::absolute(cvars::cache_root);
+  auto emulator = std::make_unique<Emulator>("", "", "", cache_root);
+  X_STATUS result = emulator->Setup(
+      nullptr, nullptr, true, nullptr,
+      []() { return std::make_unique<gpu::null::NullGraphicsSystem>(); },
+      nullptr);
+  if (XFAILED(result)) {
+    XELOGE("Failed to setup the emulator: {:08X}", result);
+    return 1;
+  }
+  result = emulator->MountPath(target, "\\Device\\Harddisk0\\Partition1");
+  if (XFAILED(result)) {
+    return 1;
+  }
+
+  kernel::KernelState* kernel_state = emulator->kernel_state();
+  auto module = kernel_state->LoadUserModule(
+      "game:\\" + xe::path_to_utf8(target.filename()));
+  if (!module || !module->xex_module()) {
+    XELOGE("Failed to load {}", xe::path_to_utf8(target));
+    return 1;
+  }
+  result = kernel_state->ApplyTitleUpdate(module);
+  if (XFAILED(result)) {
+    XELOGE("Failed to apply the title update: {:08X}", result);
+    return 1;
+  }
+
+  // Precompile is done in FinishLoadingUserModule.
+  uint64_t start_time = Clock::QueryHostUptimeMillis();
+  result = kernel_state->FinishLoadingUserModule(module, false);
+  if (XFAILED(result)) {
+    XELOGE("Failed to finish loading {}: {:08X}", xe::path_to_utf8(target),
+           result);
+    return 1;
+  }
+  XexModule* xex_module = module->xex_module();
+  xex_module->WaitForPrecompilation();
+  uint64_t elapsed_ms = Clock::QueryHostUptimeMillis() - start_time;
+
+  uint32_t function_count = 0;
+  uint64_t hir_instr_count_before = 0;
+  uint64_t hir_instr_count_after = 0;
+  uint64_t machine_code_length = 0;
+  xex_module->ForEachFunction([&](Function* function) {
+    if (function->status() != Symbol::Status::kDefined) {
+      return;
+    }
+    ++function_count;
+    if (function->is_guest()) {
+      auto& stats = static_cast<GuestFunction*>(function)->jit_stats();
+      hir_instr_count_before += stats.hir_instr_count_before;
+      hir_instr_count_after += stats.hir_instr_count_after;
+      machine_code_length += stats.machine_code_length;
+    }
+  });
+  XELOGI(
+      "Translated {} functions of {:08X} on {} threads in {} ms ({:.0f} "
+      "functions per second)",
+      function_count, module->title_id(), cvars::precompile_threads,
+      elapsed_ms,
+      elapsed_ms ? double(function_count) * 1000.0 / double(elapsed_ms) : 0.0);
+  if (cvars::jit_function_stats) {
+    XELOGI(
+        "HIR instructions: {} before optimization, {} after; {} bytes of "
+        "machine code",
+        hir_instr_count_before, hir_instr_count_after, machine_code_length);
+    // Summed over the threads, so may exceed the elapsed time.
+    uint64_t tick_frequency = Clock::QueryHostTickFrequency();
+    for (const auto& pass_stats : compiler::Compiler::GetPassStats()) {
+      XELOGI("  {}: {} runs, {} ms", pass_stats.name, pass_stats.run_count,
+             pass_stats.ticks * 1000 / tick_frequency);
+    }
+  }
+
+  module.reset();
+  emulator.reset();
+  return 0;
+}
+
+}  // namespace cpu
+}  // namespace xe
+
+XE_DEFINE_CONSOLE_APP("xenia-cpu-xex-precompile", xe::cpu::xex_precompile_main,
+                      "[target.xex] [cache_root]", "target", "cache_root");
@@ -25,6 +25,7 @@
 #include "xenia/base/string_util.h"
 #include "xenia/base/threading.h"
 #include "xenia/cpu/breakpoint.h"
+#include "xenia/cpu/cpu_flags.h"
 #include "xenia/cpu/ppc/ppc_opcode_info.h"
 #include "xenia/cpu/stack_walker.h"
 #include "xenia/gpu/graphics_system.h"
@@ -217,6 +218,9 @@ void DebugWindow::DrawFrame(ImGuiIO& io) {
   ImGui::SameLine();
   ImGui::RadioButton("Memory", &state_.right_pane_tab,
                      ImState::kRightPaneMemory);
+  ImGui::SameLine();
+  ImGui::RadioButton("JIT Stats", &state_.right_pane_tab,
+                     ImState::kRightPaneJitStats);
   ImGui::EndGroup();
   ImGui::Separator();
   switch (state_.right_pane_tab) {
@@ -230,6 +234,11 @@ void DebugWindow::DrawFrame(ImGuiIO& io) {
       DrawMemoryPane();
       ImGui::EndChild();
       break;
+    case ImState::kRightPaneJitStats:
+      ImGui::BeginChild("##jit_stats_pane");
+      DrawJitStatsPane();
+      ImGui::EndChild();
+      break;
   }
   ImGui::EndChild();
   ImGui::InvisibleButton("##hsplitter0", ImVec2(-1, kSplitterWidth));
@@ -1124,12 +1133,193 @@ void DebugWindow::DrawThreadsPane() {
 }
 
 void DebugWindow::DrawMemoryPane() {
-  ImGui::Text("<memory>");
+  if (ImGui::Button("Refresh")) {
+    emulator_->memory()->QueryHeapStats(cache_.heap_stats);
+  }
+  ImGui::SameLine();
+  if (ImGui::Button("Dump Map")) {
+    emulator_->memory()->DumpMap();
+  }
+  ImGui::Separator();
+  ImGui::Columns(6, "##heap_stats_columns");
+  ImGui::Text("Heap");
+  ImGui::NextColumn();
+  ImGui::Text("Reserved");
+  ImGui::NextColumn();
+  ImGui::Text("Committed");
+  ImGui::NextColumn();
+  ImGui::Text("Largest free");
+  ImGui::NextColumn();
+  ImGui::Text("Free runs");
+  ImGui::NextColumn();
+  ImGui::Text("Allocs/s");
+  ImGui::NextColumn();
+  ImGui::Separator();
+  for (const HeapStats& stats : cache_.heap_stats) {
+    ImGui::Text("%08X (%u KB)", stats.heap_base, stats.page_size >> 10);
+    ImGui::NextColumn();
+    ImGui::Text("%u KB", stats.reserved_page_count * (stats.page_size >> 10));
+    ImGui::NextColumn();
+    ImGui::Text("%u KB", stats.committed_page_count * (stats.page_size >> 10));
+    ImGui::NextColumn();
+    ImGui::Text("%u KB",
+                stats.largest_free_page_run * (stats.page_size >> 10));
+    ImGui::NextColumn();
+    ImGui::Text("%u", stats.free_run_count);
+    ImGui::NextColumn();
+    ImGui::Text("%.1f", stats.allocations_per_second);
+    ImGui::NextColumn();
+  }
+  ImGui::Columns(1);
   // tools for searching:
   //   search bytes | text | pattern
   // https://github.com/ocornut/imgui/wiki/memory_editor_example
 }
 
+void DebugWindow::DrawJitStatsPane() {
+  using Column = decltype(state_.jit_stats)::Column;
+  auto& state = state_.jit_stats;
+
+  if (!cvars::jit_function_stats) {
+    ImGui::TextWrapped(
+        "Run with --jit_function_stats to record per-function translation "
+        "and execution statistics.");
+    return;
+  }
+
+  ImGui::BeginGroup();
+  if (ImGui::Button("Refresh")) {
+    cache_.translated_functions = processor_->QueryTranslatedFunctions();
+    SortJitStats();
+  }
+  ImGui::SameLine();
+  if (ImGui::Button("Dump CSV")) {
+    std::filesystem::path path = cvars::jit_function_stats_path;
+    if (path.empty()) {
+      path = "jit_function_stats.csv";
+    }
+    processor_->DumpFunctionStats(path);
+  }
+  ImGui::SameLine();
+  uint64_t total_compile_time_us = 0;
+  for (auto function : cache_.translated_functions) {
+    total_compile_time_us += function->jit_stats().total_compile_time_us;
+  }
+  ImGui::Text("%zu functions, %.3fs compiling",
+              cache_.translated_functions.size(),
+              total_compile_time_us / 1000000.0);
+  ImGui::EndGroup();
+  ImGui::Separator();
+
+  // Clicking a header sorts by it, clicking it again flips the order.
+  static const char* const kColumnNames[] = {
+      "Address", "Name",    "Trans", "Compile us", "Total us",
+      "HIR in",  "HIR out", "Bytes", "Calls",
+  };
+  static_assert(xe::countof(kColumnNames) == size_t(Column::kCount),
+                "Column names must match the columns");
+  ImGui::Columns(int(Column::kCount), "##jit_stats_columns");
+  for (int i = 0; i < int(Column::kCount); ++i) {
+    bool is_sort_column = state.sort_column == Column(i);
+    char label[32];
+    std::snprintf(label, xe::countof(label), "%s%s", kColumnNames[i],
+                  is_sort_column ? (state.sort_descending ? " v" : " ^") : "");
+    if (ImGui::Selectable(label, is_sort_column)) {
+      if (is_sort_column) {
+        state.sort_descending = !state.sort_descending;
+      } else {
+        state.sort_column = Column(i);
+        state.sort_descending = Column(i) != Column::kAddress &&
+                                Column(i) != Column::kName;
+      }
+      SortJitStats();
+    }
+    ImGui::NextColumn();
+  }
+  ImGui::Separator();
+  ImGui::Columns(1);
+
+  ImGui::BeginChild("##jit_stats_listing");
+  ImGui::Columns(int(Column::kCount), "##jit_stats_rows");
+  ImGuiListClipper clipper;
+  clipper.Begin(int(cache_.translated_functions.size()));
+  while (clipper.Step()) {
+    for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; ++i) {
+      auto function = cache_.translated_functions[i];
+      auto& stats = function->jit_stats();
+      char address_label[32];
+      std::snprintf(address_label, xe::countof(address_label), "%08X##%p",
+                    function->address(), function);
+      if (ImGui::Selectable(address_label, state_.function == function,
+                            ImGuiSelectableFlags_SpanAllColumns)) {
+        NavigateToFunction(function);
+      }
+      ImGui::NextColumn();
+      ImGui::Text("%s", function->name().c_str());
+      ImGui::NextColumn();
+      ImGui::Text("%u", stats.translation_count);
+      ImGui::NextColumn();
+      ImGui::Text("%" PRIu64, stats.compile_time_us);
+      ImGui::NextColumn();
+      ImGui::Text("%" PRIu64, stats.total_compile_time_us);
+      ImGui::NextColumn();
+      ImGui::Text("%u", stats.hir_instr_count_before);
+      ImGui::NextColumn();
+      ImGui::Text("%u", stats.hir_instr_count_after);
+      ImGui::NextColumn();
+      ImGui::Text("%u", stats.machine_code_length);
+      ImGui::NextColumn();
+      ImGui::Text("%" PRIu64, stats.execution_count);
+      ImGui::NextColumn();
+    }
+  }
+  clipper.End();
+  ImGui::Columns(1);
+  ImGui::EndChild();
+}
+
+void DebugWindow::SortJitStats() {
+  using Column = decltype(state_.jit_stats)::Column;
+  auto& state = state_.jit_stats;
+  auto key = [column = state.sort_column](cpu::GuestFunction* function) {
+    auto& stats = function->jit_stats();
+    switch (column) {
+      case Column::kTranslations:
+        return uint64_t(stats.translation_count);
+      case Column::kCompileTime:
+        return stats.compile_time_us;
+      case Column::kTotalCompileTime:
+        return stats.total_compile_time_us;
+      case Column::kHirBefore:
+        return uint64_t(stats.hir_instr_count_before);
+      case Column::kHirAfter:
+        return uint64_t(stats.hir_instr_count_after);
+      case Column::kCodeSize:
+        return uint64_t(stats.machine_code_length);
+      case Column::kExecutions:
+        return stats.execution_count;
+      default:
+        return uint64_t(function->address());
+    }
+  };
+  bool descending = state.sort_descending;
+  auto& functions = cache_.translated_functions;
+  if (state.sort_column == Column::kName) {
+    std::stable_sort(functions.begin(), functions.end(),
+                     [descending](cpu::GuestFunction* a,
+                                  cpu::GuestFunction* b) {
+                       return descending ? b->name() < a->name()
+                                         : a->name() < b->name();
+                     });
+  } else {
+    std::stable_sort(functions.begin(), functions.end(),
+                     [&key, descending](cpu::GuestFunction* a,
+                                        cpu::GuestFunction* b) {
+                       return descending ? key(b) < key(a) : key(a) < key(b);
+                     });
+  }
+}
+
 void DebugWindow::DrawBreakpointsPane() {
   auto& state = state_.breakpoints;
 
@@ -1492,6 +1682,13 @@ void DebugWindow::UpdateCache() {
 
   cache_.thread_debug_infos = processor_->QueryThreadDebugInfos();
 
+  emulator_->memory()->QueryHeapStats(cache_.heap_stats);
+
+  if (cvars::jit_function_stats) {
+    cache_.translated_functions = processor_->QueryTranslatedFunctions();
+    SortJitStats();
+  }
+
   SelectThreadStackFrame(state_.thread_info, state_.thread_stack_frame_index,
                          false);
 }
@@ -18,6 +18,7 @@
 #include "xenia/cpu/debug_listener.h"
 #include "xenia/cpu/processor.h"
 #include "xenia/emulator.h"
+#include "xenia/memory.h"
 #include "xenia/ui/imgui_dialog.h"
 #include "xenia/ui/imgui_drawer.h"
 #include "xenia/ui/immediate_drawer.h"
@@ -58,6 +59,8 @@ class DebugWindow : public cpu::DebugListener {
                          DebugWindow& debug_window)
         : xe::ui::ImGuiDialog(imgui_drawer), debug_window_(debug_window) {}
 
+    bool IsUpdatedContinuously() const override { return true; }
+
    protected:
     void OnDraw(ImGuiIO& io) override;
 
@@ -87,6 +90,8 @@ class DebugWindow : public cpu::DebugListener {
   void DrawThreadsPane();
   void DrawMemoryPane();
   void DrawBreakpointsPane();
+  void DrawJitStatsPane();
+  void SortJitStats();
   void DrawLogPane();
 
   void SelectThreadStackFrame(cpu::ThreadDebugInfo* thread_info,
@@ -124,6 +129,8 @@ class DebugWindow : public cpu::DebugListener {
     bool is_running = false;
     std::vector<kernel::object_ref<kernel::XModule>> modules;
     std::vector<cpu::ThreadDebugInfo*> thread_debug_infos;
+    std::vector<cpu::GuestFunction*> translated_functions;
+    std::vector<HeapStats> heap_stats;
   } cache_;
 
   enum class RegisterGroup {
@@ -139,6 +146,7 @@ class DebugWindow : public cpu::DebugListener {
   struct ImState {
     static const int kRightPaneThreads = 0;
     static const int kRightPaneMemory = 1;
+    static const int kRightPaneJitStats = 2;
     int right_pane_tab = kRightPaneThreads;
 
     cpu::ThreadDebugInfo* thread_info = nullptr;
@@ -162,6 +170,23 @@ class DebugWindow : public cpu::DebugListener {
           code_breakpoints_by_host_address;
     } breakpoints;
 
+    struct {
+      enum class Column {
+        kAddress,
+        kName,
+        kTranslations,
+        kCompileTime,
+        kTotalCompileTime,
+        kHirBefore,
+        kHirAfter,
+        kCodeSize,
+        kExecutions,
+        kCount,
+      };
+      Column sort_column = Column::kTotalCompileTime;
+      bool sort_descending = true;
+    } jit_stats;
+
     xe::kernel::XThread* isolated_log_thread = nullptr;
   } state_;
 };
@@ -10,7 +10,13 @@
 #include "xenia/emulator.h"
 
 #include <algorithm>
+#include <atomic>
 #include <cinttypes>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <thread>
 
 #include "config.h"
 #include "third_party/fmt/include/fmt/format.h"
@@ -18,6 +24,7 @@
 #include "third_party/zarchive/include/zarchive/zarchivecommon.h"
 #include "third_party/zarchive/include/zarchive/zarchivewriter.h"
 #include "third_party/zarchive/src/sha_256.h"
+#include "third_party/zstd/lib/zstd.h"
 #include "xenia/apu/audio_system.h"
 #include "xenia/base/assert.h"
 #include "xenia/base/byte_stream.h"
@@ -25,12 +32,18 @@
 #include "xenia/base/cvar.h"
 #include "xenia/base/debugging.h"
 #include "xenia/base/exception_handler.h"
+#include "xenia/base/fast_forward.h"
+#include "xenia/base/filesystem.h"
+#include "xenia/base/input_latency.h"
 #include "xenia/base/literals.h"
 #include "xenia/base/logging.h"
 #include "xenia/base/mapped_memory.h"
+#include "xenia/base/metrics.h"
 #include "xenia/base/platform.h"
+#include "xenia/base/startup_timeline.h"
 #include "xenia/base/string.h"
 #include "xenia/base/system.h"
+#include "xenia/base/threading.h"
 #include "xenia/cpu/backend/code_cache.h"
 #include "xenia/cpu/backend/null_backend.h"
 #include "xenia/cpu/cpu_flags.h"
@@ -92,9 +105,234 @@ DEFINE_int32(priority_class, 0,
              "values: 0 - Normal, 1 - Above normal, 2 - High",
              "General");
 
+DEFINE_int32(save_state_compression_level, 3,
+             "zstd compression level of the save states, from 1 to 22, or 0 to "
+             "write them uncompressed. Compressed save states are compressed "
+             "on multiple threads and written in the background after the "
+             "emulation is resumed.",
+             "General");
+
 namespace xe {
 using namespace xe::literals;
 
+namespace {
+
+// Compressed save states are made of independently compressed chunks of the
+// uncompressed save state, so they can be compressed and decompressed on
+// multiple threads.
+constexpr size_t kSaveStateChunkSize = 16_MiB;
+
+struct CompressedSaveStateHeader {
+  fourcc_t signature;
+  uint32_t chunk_count;
+  uint64_t size;
+  // Followed by the compressed size of each chunk as uint64_t, and then the
+  // compressed chunks.
+};
+
+bool WriteCompressedSaveState(const std::filesystem::path& path,
+                              const uint8_t* data, size_t size,
+                              int compression_level) {
+  size_t chunk_count =
+      (size + (kSaveStateChunkSize - 1)) / kSaveStateChunkSize;
+  std::vector<std::vector<uint8_t>> compressed_chunks(chunk_count);
+  std::atomic<bool> compressed = {true};
+  threading::ParallelFor(chunk_count, [&](size_t chunk) {
+    size_t chunk_offset = chunk * kSaveStateChunkSize;
+    size_t chunk_size = std::min(kSaveStateChunkSize, size - chunk_offset);
+    std::vector<uint8_t>& compressed_chunk = compressed_chunks[chunk];
+    compressed_chunk.resize(ZSTD_compressBound(chunk_size));
+    size_t compressed_size =
+        ZSTD_compress(compressed_chunk.data(), compressed_chunk.size(),
+                      data + chunk_offset, chunk_size, compression_level);
+    if (ZSTD_isError(compressed_size)) {
+      XELOGE("Failed to compress the save state: {}",
+             ZSTD_getErrorName(compressed_size));
+      compressed.store(false, std::memory_order_relaxed);
+      return;
+    }
+    compressed_chunk.resize(compressed_size);
+  });
+  if (!compressed) {
+    return false;
+  }
+
+  FILE* file = filesystem::OpenFile(path, "wb");
+  if (!file) {
+    XELOGE("Failed to create the save state file {}", xe::path_to_utf8(path));
+    return false;
+  }
+  CompressedSaveStateHeader header;
+  header.signature = kEmulatorCompressedSaveSignature;
+  header.chunk_count = uint32_t(chunk_count);
+  header.size = size;
+  bool written = fwrite(&header, sizeof(header), 1, file) == 1;
+  for (size_t i = 0; written && i < chunk_count; ++i) {
+    uint64_t compressed_size = compressed_chunks[i].size();
+    written = fwrite(&compressed_size, sizeof(compressed_size), 1, file) == 1;
+  }
+  for (size_t i = 0; written && i < chunk_count; ++i) {
+    written = fwrite(compressed_chunks[i].data(), compressed_chunks[i].size(),
+                     1, file) == 1;
+  }
+  fclose(file);
+  if (!written) {
+    XELOGE("Failed to write the save state file {}", xe::path_to_utf8(path));
+  }
+  return written;
+}
+
+bool ReadCompressedSaveState(const uint8_t* data, size_t size,
+                             std::vector<uint8_t>& decompressed_out) {
+  CompressedSaveStateHeader header;
+  if (size < sizeof(header)) {
+    return false;
+  }
+  std::memcpy(&header, data, sizeof(header));
+  size_t chunk_count = header.chunk_count;
+  if (header.signature != kEmulatorCompressedSaveSignature ||
+      chunk_count != (header.size + (kSaveStateChunkSize - 1)) /
+                         kSaveStateChunkSize ||
+      (size - sizeof(header)) / sizeof(uint64_t) < chunk_count) {
+    return false;
+  }
+  // Locating the chunks before decompressing them in parallel.
+  std::vector<size_t> compressed_chunk_offsets(chunk_count + 1);
+  size_t compressed_chunk_offset =
+      sizeof(header) + sizeof(uint64_t) * chunk_count;
+  for (size_t i = 0; i < chunk_count; ++i) {
+    uint64_t compressed_size;
+    std::memcpy(&compressed_size,
+                data + sizeof(header) + sizeof(uint64_t) * i,
+                sizeof(compressed_size));
+    if (compressed_size > size - compressed_chunk_offset) {
+      return false;
+    }
+    compressed_chunk_offsets[i] = compressed_chunk_offset;
+    compressed_chunk_offset += size_t(compressed_size);
+  }
+  compressed_chunk_offsets[chunk_count] = compressed_chunk_offset;
+
+  decompressed_out.resize(size_t(header.size));
+  std::atomic<bool> decompressed = {true};
+  threading::ParallelFor(chunk_count, [&](size_t chunk) {
+    size_t chunk_offset = chunk * kSaveStateChunkSize;
+    size_t chunk_size =
+        std::min(kSaveStateChunkSize, decompressed_out.size() - chunk_offset);
+    size_t decompressed_size = ZSTD_decompress(
+        decompressed_out.data() + chunk_offset, chunk_size,
+        data + compressed_chunk_offsets[chunk],
+        compressed_chunk_offsets[chunk + 1] - compressed_chunk_offsets[chunk]);
+    if (ZSTD_isError(decompressed_size) || decompressed_size != chunk_size) {
+      decompressed.store(false, std::memory_order_relaxed);
+    }
+  });
+  if (!decompressed) {
+    decompressed_out.clear();
+    return false;
+  }
+  return true;
+}
+
+// Reads the files to pack into a ZArchive on a separate thread, so reading
+// overlaps with the compression and writing done by ZArchiveWriter. The data
+// is provided in the order of the files, so the archive is the same as when
+// reading on the packing thread.
+class ZarchiveFileReader {
+ public:
+  struct Chunk {
+    size_t file_index;
+    std::vector<uint8_t> data;
+    // The last chunk of the file, possibly empty.
+    bool is_file_end;
+    bool is_error;
+  };
+
+  explicit ZarchiveFileReader(std::vector<std::filesystem::path> file_paths)
+      : file_paths_(std::move(file_paths)) {
+    thread_ = std::thread(&ZarchiveFileReader::ThreadMain, this);
+  }
+  ~ZarchiveFileReader() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      cancelled_ = true;
+    }
+    space_condition_.notify_all();
+    thread_.join();
+  }
+
+  // Blocks until the next chunk is available.
+  Chunk Pop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    chunk_condition_.wait(lock, [this]() { return !chunks_.empty(); });
+    Chunk chunk = std::move(chunks_.front());
+    chunks_.pop_front();
+    lock.unlock();
+    space_condition_.notify_one();
+    return chunk;
+  }
+
+ private:
+  static constexpr size_t kChunkSize = 1024 * 1024;
+  static constexpr size_t kMaxQueuedChunks = 32;
+
+  // Returns false if cancelled.
+  bool Push(Chunk chunk) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    space_condition_.wait(lock, [this]() {
+      return cancelled_ || chunks_.size() < kMaxQueuedChunks;
+    });
+    if (cancelled_) {
+      return false;
+    }
+    chunks_.push_back(std::move(chunk));
+    lock.unlock();
+    chunk_condition_.notify_one();
+    return true;
+  }
+
+  void ThreadMain() {
+    threading::set_name("ZArchive File Reader");
+    for (size_t i = 0; i < file_paths_.size(); ++i) {
+      FILE* file = xe::filesystem::OpenFile(file_paths_[i], "rb");
+      if (!file) {
+        Push({i, {}, true, true});
+        return;
+      }
+      while (true) {
+        Chunk chunk = {i, std::vector<uint8_t>(kChunkSize), false, false};
+        size_t bytes_read = fread(chunk.data.data(), 1, kChunkSize, file);
+        chunk.data.resize(bytes_read);
+        if (bytes_read < kChunkSize) {
+          chunk.is_file_end = true;
+          chunk.is_error = ferror(file) != 0;
+        }
+        bool is_file_end = chunk.is_file_end;
+        bool is_error = chunk.is_error;
+        if (!Push(std::move(chunk)) || is_error) {
+          fclose(file);
+          return;
+        }
+        if (is_file_end) {
+          break;
+        }
+      }
+      fclose(file);
+    }
+  }
+
+  std::vector<std::filesystem::path> file_paths_;
+  std::thread thread_;
+
+  std::mutex mutex_;
+  std::condition_variable chunk_condition_;
+  std::condition_variable space_condition_;
+  std::deque<Chunk> chunks_;
+  bool cancelled_ = false;
+};
+
+}  // namespace
+
 Emulator::GameConfigLoadCallback::GameConfigLoadCallback(Emulator& emulator)
     : emulator_(emulator) {
   emulator_.AddGameConfigLoadCallback(this);
@@ -164,6 +402,8 @@ Emulator::Emulator(const std::filesystem::path& command_line,
 }
 
 Emulator::~Emulator() {
+  FinishSaveToFile();
+
   // Note that we delete things in the reverse order they were initialized.
 
   // Give the systems time to shutdown before we delete them.
@@ -173,7 +413,11 @@ Emulator::~Emulator() {
   if (audio_system_) {
     audio_system_->Shutdown();
   }
+  if (input_system_) {
+    input_system_->Shutdown();
+  }
 
+  input_latency::EndTitle();
   input_system_.reset();
   graphics_system_.reset();
   audio_system_.reset();
@@ -186,6 +430,8 @@ Emulator::~Emulator() {
 
   export_resolver_.reset();
 
+  metrics::StopExport();
+
   ExceptionHandler::Uninstall(Emulator::ExceptionCallbackThunk, this);
 }
 
@@ -198,6 +444,7 @@ X_STATUS Emulator::Setup(
         graphics_system_factory,
     std::function<std::vector<std::unique_ptr<hid::InputDriver>>(ui::Window*)>
         input_driver_factory) {
+  SCOPE_startup_timeline("Emulator::Setup");
   X_STATUS result = X_STATUS_UNSUCCESSFUL;
 
   display_window_ = display_window;
@@ -210,56 +457,79 @@ X_STATUS Emulator::Setup(
   Clock::set_guest_system_time_base(Clock::QueryHostSystemTime());
   // This can be adjusted dynamically, as well.
   Clock::set_guest_time_scalar(cvars::time_scalar);
+  fast_forward::SetEnabled(cvars::fast_forward);
 
   // Before we can set thread affinity we must enable the process to use all
   // logical processors.
   xe::threading::EnableAffinityConfiguration();
 
-  // Create memory system first, as it is required for other systems.
-  memory_ = std::make_unique<Memory>();
-  if (!memory_->Initialize()) {
-    return false;
+  // Initialize the GPU.
+  graphics_system_ = graphics_system_factory();
+  if (!graphics_system_) {
+    return X_STATUS_NOT_IMPLEMENTED;
   }
 
-  // Shared export resolver used to attach and query for HLE exports.
-  export_resolver_ = std::make_unique<xe::cpu::ExportResolver>();
+  // Creating the host GPU device doesn't depend on anything else, and it may
+  // take a while, so do it in parallel with the CPU setup (reserving the guest
+  // address space, initializing the backend). The rest of the graphics system
+  // setup needs the processor and the kernel state.
+  std::thread graphics_provider_thread([this]() {
+    xe::threading::set_name("Graphics Provider Initialization");
+    SCOPE_startup_timeline("GraphicsSystem::InitializeProvider");
+    graphics_system_->InitializeProvider(display_window_ != nullptr);
+  });
+
+  auto setup_cpu_and_apu = [&]() -> X_STATUS {
+    // Create memory system first, as it is required for other systems.
+    memory_ = std::make_unique<Memory>();
+    if (!memory_->Initialize()) {
+      return X_STATUS_UNSUCCESSFUL;
+    }
+
+    // Shared export resolver used to attach and query for HLE exports.
+    export_resolver_ = std::make_unique<xe::cpu::ExportResolver>();
 
-  std::unique_ptr<xe::cpu::backend::Backend> backend;
+    std::unique_ptr<xe::cpu::backend::Backend> backend;
 #if XE_ARCH_AMD64
-  if (cvars::cpu == "x64") {
-    backend.reset(new xe::cpu::backend::x64::X64Backend());
-  }
+    if (cvars::cpu == "x64") {
+      backend.reset(new xe::cpu::backend::x64::X64Backend());
+    }
 #endif  // XE_ARCH
-  if (cvars::cpu == "any") {
-    if (!backend) {
+    if (cvars::cpu == "any") {
+      if (!backend) {
 #if XE_ARCH_AMD64
-      backend.reset(new xe::cpu::backend::x64::X64Backend());
+        backend.reset(new xe::cpu::backend::x64::X64Backend());
 #endif  // XE_ARCH
+      }
+    }
+    if (!backend && !require_cpu_backend) {
+      backend.reset(new xe::cpu::backend::NullBackend());
     }
-  }
-  if (!backend && !require_cpu_backend) {
-    backend.reset(new xe::cpu::backend::NullBackend());
-  }
 
-  // Initialize the CPU.
-  processor_ = std::make_unique<xe::cpu::Processor>(memory_.get(),
-                                                    export_resolver_.get());
-  if (!processor_->Setup(std::move(backend))) {
-    return X_STATUS_UNSUCCESSFUL;
-  }
+    // Initialize the CPU.
+    processor_ = std::make_unique<xe::cpu::Processor>(memory_.get(),
+                                                      export_resolver_.get());
+    if (!processor_->Setup(std::move(backend))) {
+      return X_STATUS_UNSUCCESSFUL;
+    }
 
-  // Initialize the APU.
-  if (audio_system_factory) {
-    audio_system_ = audio_system_factory(processor_.get());
-    if (!audio_system_) {
-      return X_STATUS_NOT_IMPLEMENTED;
+    // Initialize the APU.
+    if (audio_system_factory) {
+      audio_system_ = audio_system_factory(processor_.get());
+      if (!audio_system_) {
+        return X_STATUS_NOT_IMPLEMENTED;
+      }
     }
-  }
 
-  // Initialize the GPU.
-  graphics_system_ = graphics_system_factory();
-  if (!graphics_system_) {
-    return X_STATUS_NOT_IMPLEMENTED;
+    return X_STATUS_SUCCESS;
+  };
+  {
+    SCOPE_startup_timeline("CPU and APU setup");
+    result = setup_cpu_and_apu();
+  }
+  graphics_provider_thread.join();
+  if (XFAILED(result)) {
+    return result;
   }
 
   // Initialize the HID.
@@ -285,7 +555,7 @@ X_STATUS Emulator::Setup(
   // Bring up the virtual filesystem used by the kernel.
   file_system_ = std::make_unique<xe::vfs::VirtualFileSystem>();
 
-  patcher_ = std::make_unique<xe::patcher::Patcher>(storage_root_);
+  patcher_ = std::make_unique<xe::patcher::Patcher>(storage_root_, cache_root_);
 
   // Shared kernel state.
   kernel_state_ = std::make_unique<xe::kernel::KernelState>(this);
@@ -318,6 +588,8 @@ X_STATUS Emulator::Setup(
     audio_media_player_->Setup();
   }
 
+  metrics::StartExport();
+
   // Initialize emulator fallback exception handling last.
   ExceptionHandler::Install(Emulator::ExceptionCallbackThunk, this);
 
@@ -330,6 +602,7 @@ X_STATUS Emulator::TerminateTitle() {
   }
 
   kernel_state_->TerminateTitle();
+  input_latency::EndTitle();
   title_id_ = std::nullopt;
   title_name_ = "";
   title_version_ = "";
@@ -412,6 +685,7 @@ void Emulator::SetPersistentEmulatorFlags(uint64_t new_flags) {
 
 X_STATUS Emulator::MountPath(const std::filesystem::path& path,
                              const std::string_view mount_path) {
+  SCOPE_startup_timeline("Emulator::MountPath");
   auto device = CreateVfsDevice(path, mount_path);
   if (!device || !device->Initialize()) {
     XELOGE(
@@ -510,6 +784,7 @@ Emulator::FileSignatureType Emulator::GetFileSignature(
 }
 
 X_STATUS Emulator::LaunchPath(const std::filesystem::path& path) {
+  SCOPE_startup_timeline("Emulator::LaunchPath");
   X_STATUS mount_result = X_STATUS_SUCCESS;
 
   switch (GetFileSignature(path)) {
@@ -860,8 +1135,7 @@ X_STATUS Emulator::ExtractZarchivePackage(
 X_STATUS Emulator::CreateZarchivePackage(
     const std::filesystem::path& inputDirectory,
     const std::filesystem::path& outputFile) {
-  std::vector<uint8_t> buffer;
-  buffer.resize(64 * 1024);
+  uint64_t start_time = Clock::QueryHostTickCount();
 
   std::error_code ec;
   PackContext packContext;
@@ -890,6 +1164,15 @@ X_STATUS Emulator::CreateZarchivePackage(
     return X_STATUS_UNSUCCESSFUL;
   }
 
+  // Gathering the entries first to read the files ahead and to report the
+  // progress.
+  struct PackEntry {
+    std::filesystem::path path;
+    bool is_directory;
+  };
+  std::vector<PackEntry> entries;
+  std::vector<std::filesystem::path> file_paths;
+  uint64_t total_file_size = 0;
   for (auto const& dirEntry :
        std::filesystem::recursive_directory_iterator(inputDirectory)) {
     std::filesystem::path pathEntry =
@@ -901,44 +1184,62 @@ X_STATUS Emulator::CreateZarchivePackage(
     }
 
     if (dirEntry.is_directory()) {
-      if (!zWriter.MakeDir(pathEntry.generic_string().c_str(), false)) {
-        XELOGI("Failed to create directory {}\n", pathEntry.string());
-        return X_STATUS_UNSUCCESSFUL;
-      }
+      entries.push_back({pathEntry, true});
     } else if (dirEntry.is_regular_file()) {
       // Don't pack itself to prevent infinite packing.
       if (dirEntry == outputFile) {
         continue;
       }
+      entries.push_back({pathEntry, false});
+      file_paths.push_back(inputDirectory / pathEntry);
+      total_file_size += dirEntry.file_size(ec);
+    }
+  }
 
-      XELOGI("Adding file: {}\n", pathEntry.string());
+  ZarchiveFileReader file_reader(file_paths);
+  size_t file_index = 0;
+  uint64_t packed_file_size = 0;
+  uint64_t last_reported_percent = 0;
 
-      if (!zWriter.StartNewFile(pathEntry.generic_string().c_str())) {
-        XELOGI("Failed to create archive file {}\n", pathEntry.string());
+  for (const PackEntry& entry : entries) {
+    if (entry.is_directory) {
+      if (!zWriter.MakeDir(entry.path.generic_string().c_str(), false)) {
+        XELOGI("Failed to create directory {}\n", entry.path.string());
         return X_STATUS_UNSUCCESSFUL;
       }
+    } else {
+      XELOGI("Adding file: {}\n", entry.path.string());
 
-      std::filesystem::path file_to_pack_path = inputDirectory / pathEntry;
-      FILE* file = xe::filesystem::OpenFile(file_to_pack_path, "rb");
-
-      if (!file) {
-        XELOGI("Failed to open input file {}\n", pathEntry.string());
+      if (!zWriter.StartNewFile(entry.path.generic_string().c_str())) {
+        XELOGI("Failed to create archive file {}\n", entry.path.string());
         return X_STATUS_UNSUCCESSFUL;
       }
 
-      const uint64_t file_size = std::filesystem::file_size(file_to_pack_path);
-      uint64_t total_bytes_read = 0;
-
-      while (total_bytes_read < file_size) {
-        uint64_t bytes_read =
-            fread_s(buffer.data(), buffer.size(), 1, buffer.size(), file);
-
-        total_bytes_read += bytes_read;
-
-        zWriter.AppendData(buffer.data(), bytes_read);
+      while (true) {
+        ZarchiveFileReader::Chunk chunk = file_reader.Pop();
+        assert_true(chunk.file_index == file_index);
+        if (chunk.is_error) {
+          XELOGI("Failed to read input file {}\n", entry.path.string());
+          return X_STATUS_UNSUCCESSFUL;
+        }
+        if (!chunk.data.empty()) {
+          zWriter.AppendData(chunk.data.data(), chunk.data.size());
+          packed_file_size += chunk.data.size();
+        }
+        if (chunk.is_file_end) {
+          break;
+        }
+      }
+      ++file_index;
+
+      if (total_file_size) {
+        uint64_t percent = packed_file_size * 100 / total_file_size;
+        if (percent / 10 != last_reported_percent / 10) {
+          last_reported_percent = percent;
+          XELOGI("Packed {} of {} MiB ({}%)", packed_file_size >> 20,
+                 total_file_size >> 20, percent);
+        }
       }
-
-      fclose(file);
     }
 
     if (packContext.hasError) {
@@ -948,6 +1249,13 @@ X_STATUS Emulator::CreateZarchivePackage(
 
   zWriter.Finalize();
 
+  double seconds = double(Clock::QueryHostTickCount() - start_time) /
+                   double(Clock::QueryHostTickFrequency());
+  XELOGI("Packed {} files, {} MiB, in {:.1f} s ({:.1f} MiB/s)",
+         file_paths.size(), packed_file_size >> 20, seconds,
+         seconds > 0.0 ? double(packed_file_size) / (1024.0 * 1024.0) / seconds
+                       : 0.0);
+
   return X_STATUS_SUCCESS;
 }
 
@@ -1008,11 +1316,23 @@ void Emulator::Resume() {
 }
 
 bool Emulator::SaveToFile(const std::filesystem::path& path) {
+  FinishSaveToFile();
+
   Pause();
 
-  filesystem::CreateEmptyFile(path);
-  auto map = MappedMemory::Open(path, MappedMemory::Mode::kReadWrite, 0, 2_GiB);
+  // Compressed save states are first written uncompressed to a temporary file
+  // to keep the emulation paused only while the state is being copied.
+  int compression_level = std::min(cvars::save_state_compression_level,
+                                   ZSTD_maxCLevel());
+  std::filesystem::path uncompressed_path = path;
+  if (compression_level > 0) {
+    uncompressed_path += ".tmp";
+  }
+  filesystem::CreateEmptyFile(uncompressed_path);
+  auto map = MappedMemory::Open(uncompressed_path,
+                                MappedMemory::Mode::kReadWrite, 0, 2_GiB);
   if (!map) {
+    Resume();
     return false;
   }
 
@@ -1031,18 +1351,66 @@ bool Emulator::SaveToFile(const std::filesystem::path& path) {
   audio_system_->Save(&stream);
   kernel_state_->Save(&stream);
   memory_->Save(&stream);
-  map->Close(stream.offset());
+
+  if (compression_level <= 0) {
+    map->Close(stream.offset());
+    Resume();
+    return true;
+  }
 
   Resume();
+
+  size_t size = stream.offset();
+  save_thread_ = std::thread([map = std::move(map), size, path,
+                              uncompressed_path, compression_level]() {
+    uint64_t start_time = Clock::QueryHostTickCount();
+    bool written =
+        WriteCompressedSaveState(path, map->data(), size, compression_level);
+    map->Close();
+    std::error_code error_code;
+    std::filesystem::remove(uncompressed_path, error_code);
+    if (written) {
+      XELOGI("Wrote the compressed save state {} ({} bytes uncompressed) in {} "
+             "ms",
+             xe::path_to_utf8(path), size,
+             (Clock::QueryHostTickCount() - start_time) * 1000 /
+                 Clock::QueryHostTickFrequency());
+    }
+  });
   return true;
 }
 
+void Emulator::FinishSaveToFile() {
+  if (save_thread_.joinable()) {
+    save_thread_.join();
+  }
+}
+
 bool Emulator::RestoreFromFile(const std::filesystem::path& path) {
+  // The file may be still being written.
+  FinishSaveToFile();
+
   // Restore the emulator state from a file
   auto map = MappedMemory::Open(path, MappedMemory::Mode::kReadWrite);
   if (!map) {
     return false;
   }
+  std::vector<uint8_t> decompressed;
+  uint8_t* data = map->data();
+  size_t data_size = map->size();
+  fourcc_t signature = 0;
+  if (data_size >= sizeof(signature)) {
+    std::memcpy(&signature, data, sizeof(signature));
+  }
+  if (signature == kEmulatorCompressedSaveSignature) {
+    if (!ReadCompressedSaveState(data, data_size, decompressed)) {
+      XELOGE("Could not decompress the save state!");
+      return false;
+    }
+    map.reset();
+    data = decompressed.data();
+    data_size = decompressed.size();
+  }
 
   restoring_ = true;
 
@@ -1051,7 +1419,7 @@ bool Emulator::RestoreFromFile(const std::filesystem::path& path) {
   kernel_state_->TerminateTitle();
 
   auto lock = global_critical_region::AcquireDirect();
-  ByteStream stream(map->data(), map->size());
+  ByteStream stream(data, data_size);
   if (stream.Read<uint32_t>() != kEmulatorSaveSignature) {
     return false;
   }
@@ -1354,6 +1722,7 @@ static std::string format_version(xex2_version version) {
 
 X_STATUS Emulator::CompleteLaunch(const std::filesystem::path& path,
                                   const std::string_view module_path) {
+  SCOPE_startup_timeline("Emulator::CompleteLaunch");
   // Making changes to the UI (setting the icon) and executing game config
   // load callbacks which expect to be called from the UI thread.
   assert_true(display_window_->app_context().IsInUIThread());
@@ -1393,16 +1762,45 @@ X_STATUS Emulator::CompleteLaunch(const std::filesystem::path& path,
     return X_STATUS_NOT_FOUND;
   }
 
+  // The title ID is known from the headers at this point, so load the
+  // per-game configuration file (which may change how the module and the
+  // shaders are loaded) and make sure updates are handled by the callbacks.
+  if (module->title_id()) {
+    config::LoadGameConfig(fmt::format("{:08X}", module->title_id()));
+    assert_true(game_config_load_callback_loop_next_index_ == SIZE_MAX);
+    game_config_load_callback_loop_next_index_ = 0;
+    while (game_config_load_callback_loop_next_index_ <
+           game_config_load_callbacks_.size()) {
+      game_config_load_callbacks_[game_config_load_callback_loop_next_index_++]
+          ->PostGameConfigLoad();
+    }
+    game_config_load_callback_loop_next_index_ = SIZE_MAX;
+  }
+
+  // Initializing the shader storage in a blocking way so the user doesn't
+  // miss the initial seconds - for instance, sound from an intro video may
+  // start playing before the video can be seen if doing this in parallel with
+  // the main thread. It only depends on the title ID though, so loading it on
+  // the GPU thread while the title update is applied and the module is
+  // prepared, and waiting for it only before launching the module.
+  on_shader_storage_initialization(true);
+  graphics_system_->BeginInitializeShaderStorage(cache_root_,
+                                                 module->title_id());
+
   X_RESULT result = kernel_state_->ApplyTitleUpdate(module);
   if (XFAILED(result)) {
     XELOGE("Failed to apply title update! Cannot run module {}",
            xe::path_to_utf8(path));
+    graphics_system_->WaitForShaderStorageInitialization();
+    on_shader_storage_initialization(false);
     return result;
   }
 
   result = kernel_state_->FinishLoadingUserModule(module);
   if (XFAILED(result)) {
     XELOGE("Failed to initialize user module {}", xe::path_to_utf8(path));
+    graphics_system_->WaitForShaderStorageInitialization();
+    on_shader_storage_initialization(false);
     return result;
   }
   // Grab the current title ID.
@@ -1429,20 +1827,6 @@ X_STATUS Emulator::CompleteLaunch(const std::filesystem::path& path,
 
   // Try and load the resource database (xex only).
   if (module->title_id()) {
-    auto title_id = fmt::format("{:08X}", module->title_id());
-
-    // Load the per-game configuration file and make sure updates are handled
-    // by the callbacks.
-    config::LoadGameConfig(title_id);
-    assert_true(game_config_load_callback_loop_next_index_ == SIZE_MAX);
-    game_config_load_callback_loop_next_index_ = 0;
-    while (game_config_load_callback_loop_next_index_ <
-           game_config_load_callbacks_.size()) {
-      game_config_load_callbacks_[game_config_load_callback_loop_next_index_++]
-          ->PostGameConfigLoad();
-    }
-    game_config_load_callback_loop_next_index_ = SIZE_MAX;
-
     const kernel::util::XdbfGameData db = kernel_state_->module_xdbf(module);
 
     game_info_database_ = std::make_unique<kernel::util::GameInfoDatabase>(&db);
@@ -1509,13 +1893,10 @@ X_STATUS Emulator::CompleteLaunch(const std::filesystem::path& path,
     }
   }
 
-  // Initializing the shader storage in a blocking way so the user doesn't
-  // miss the initial seconds - for instance, sound from an intro video may
-  // start playing before the video can be seen if doing this in parallel with
-  // the main thread.
-  on_shader_storage_initialization(true);
-  graphics_system_->InitializeShaderStorage(cache_root_, title_id_.value(),
-                                            true);
+  {
+    SCOPE_startup_timeline("Waiting for the shader storage");
+    graphics_system_->WaitForShaderStorageInitialization();
+  }
   on_shader_storage_initialization(false);
 
   auto main_thread = kernel_state_->LaunchModule(module);
@@ -1523,6 +1904,7 @@ X_STATUS Emulator::CompleteLaunch(const std::filesystem::path& path,
     return X_STATUS_UNSUCCESSFUL;
   }
   main_thread_ = main_thread;
+  input_latency::BeginTitle(title_id_.value());
   on_launch(title_id_.value(), title_name_);
 
   // Plugins must be loaded after calling LaunchModule() and
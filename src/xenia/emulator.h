@@ -15,6 +15,7 @@
 #include <functional>
 #include <optional>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include "xenia/apu/audio_media_player.h"
@@ -55,6 +56,7 @@ class Window;
 namespace xe {
 
 constexpr fourcc_t kEmulatorSaveSignature = make_fourcc("XSAV");
+constexpr fourcc_t kEmulatorCompressedSaveSignature = make_fourcc("XSVZ");
 static const std::string kDefaultGameSymbolicLink = "GAME:";
 static const std::string kDefaultPartitionSymbolicLink = "D:";
 
@@ -262,6 +264,8 @@ class Emulator {
   void Pause();
   void Resume();
   bool is_paused() const { return paused_; }
+  // If the save state is compressed, it's written to the file in the
+  // background after the emulation is resumed.
   bool SaveToFile(const std::filesystem::path& path);
   bool RestoreFromFile(const std::filesystem::path& path);
 
@@ -292,6 +296,9 @@ class Emulator {
   X_STATUS CompleteLaunch(const std::filesystem::path& path,
                           const std::string_view module_path);
 
+  // Waits for the background writing of the last save state to be completed.
+  void FinishSaveToFile();
+
   std::filesystem::path command_line_;
   std::filesystem::path storage_root_;
   std::filesystem::path content_root_;
@@ -335,6 +342,9 @@ class Emulator {
   bool paused_;
   bool restoring_;
   threading::Fence restore_fence_;  // Fired on restore finish.
+
+  // Compressing and writing the last save state.
+  std::thread save_thread_;
 };
 
 }  // namespace xe
@@ -9,13 +9,19 @@
 
 #include "xenia/gpu/command_processor.h"
 
+#include <algorithm>
 #include <cinttypes>
 
 #include "third_party/fmt/include/fmt/format.h"
 #include "xenia/base/byte_stream.h"
+#include "xenia/base/clock.h"
 #include "xenia/base/cvar.h"
+#include "xenia/base/fast_forward.h"
+#include "xenia/base/frame_timeline.h"
+#include "xenia/base/input_latency.h"
 #include "xenia/base/logging.h"
 #include "xenia/base/profiling.h"
+#include "xenia/base/startup_timeline.h"
 #include "xenia/gpu/gpu_flags.h"
 #include "xenia/gpu/graphics_system.h"
 #include "xenia/gpu/packet_disassembler.h"
@@ -45,6 +51,14 @@ DEFINE_bool(
     "of the guest thread that wrote the new read position.",
     "GPU");
 
+DEFINE_bool(
+    log_frame_latency, false,
+    "Periodically log the host time from the beginning of the GPU emulation of "
+    "a frame to the completion of its host GPU work, which is an estimate of "
+    "the part of the input-to-photon latency caused by queued frames (see "
+    "max_queued_frames).",
+    "GPU");
+
 DEFINE_bool(clear_memory_page_state, false,
             "Refresh state of memory pages to enable gpu written data. (Use "
             "for 'Team Ninja' Games to fix missing character models)",
@@ -188,6 +202,7 @@ void CommandProcessor::RestoreRegisters(uint32_t first_register,
   } else {
     std::memcpy(register_file_->values + first_register, register_values,
                 sizeof(uint32_t) * register_count);
+    register_file_->MarkRangeWritten(first_register, register_count);
   }
 }
 
@@ -205,11 +220,22 @@ void CommandProcessor::RestoreGammaRamp(
 }
 
 void CommandProcessor::CallInThread(std::function<void()> fn) {
-  if (pending_fns_.empty() &&
-      kernel::XThread::IsInThread(worker_thread_.get())) {
+  // Only the worker thread may check whether the queue is empty.
+  bool is_in_worker_thread = kernel::XThread::IsInThread(worker_thread_.get());
+  if (is_in_worker_thread && pending_fns_.empty()) {
     fn();
-  } else {
-    pending_fns_.push(std::move(fn));
+    return;
+  }
+  while (!pending_fns_.TryPush(std::move(fn))) {
+    if (is_in_worker_thread) {
+      // Make room by executing the functions queued earlier.
+      std::function<void()> pending_fn;
+      if (pending_fns_.TryPop(pending_fn)) {
+        pending_fn();
+      }
+    } else {
+      xe::threading::MaybeYield();
+    }
   }
 }
 
@@ -233,10 +259,10 @@ void CommandProcessor::WorkerThreadMain() {
   }
 
   while (worker_running_) {
-    while (!pending_fns_.empty()) {
-      auto fn = std::move(pending_fns_.front());
-      pending_fns_.pop();
-      fn();
+    std::function<void()> pending_fn;
+    while (pending_fns_.TryPop(pending_fn)) {
+      pending_fn();
+      pending_fn = nullptr;
     }
 
     uint32_t write_ptr_index = write_ptr_index_.load();
@@ -268,8 +294,16 @@ void CommandProcessor::WorkerThreadMain() {
     }
     assert_true(read_ptr_index_ != write_ptr_index);
 
+    // With host write tracking, catch up with what the CPU has written to the
+    // watched memory before the commands that may use it.
+    memory_->PollPhysicalMemoryWrites();
+
     // Execute. Note that we handle wraparound transparently.
-    read_ptr_index_ = ExecutePrimaryBuffer(read_ptr_index_, write_ptr_index);
+    {
+      frame_timeline::ScopedActivity frame_timeline_activity(
+          frame_timeline::Activity::kCommandProcessor);
+      read_ptr_index_ = ExecutePrimaryBuffer(read_ptr_index_, write_ptr_index);
+    }
 
     // TODO(benvanik): use reader->Read_update_freq_ and only issue after moving
     //     that many indices.
@@ -593,30 +627,31 @@ void CommandProcessor::HandleSpecialRegisterWrite(uint32_t index,
   }
 }
 void CommandProcessor::WriteRegister(uint32_t index, uint32_t value) {
-  // chrispy: rearrange check order, place set after checks
-
   if (XE_LIKELY(index < RegisterFile::kRegisterCount)) {
+    uint32_t old_value = register_file_->values[index];
     register_file_->values[index] = value;
-
-    // quick pre-test
-    // todo: figure out just how unlikely this is. if very (it ought to be,
-    // theres a ton of registers other than these) make this predicate
-    // branchless and mark with unlikely, then make HandleSpecialRegisterWrite
-    // noinline yep, its very unlikely. these ORS here are meant to be bitwise
-    // ors, so that we do not do branching evaluation of the conditions (we will
-    // almost always take all of the branches)
-
-    unsigned expr = (index - XE_GPU_REG_SCRATCH_REG0 < 8) |
-                    (index == XE_GPU_REG_COHER_STATUS_HOST) |
-                    ((index - XE_GPU_REG_DC_LUT_RW_INDEX) <=
-                     (XE_GPU_REG_DC_LUT_30_COLOR - XE_GPU_REG_DC_LUT_RW_INDEX));
-    // chrispy: reordered for msvc branch probability (assumes if is taken and
-    // else is not)
-    if (XE_LIKELY(expr == 0)) {
-      XE_MSVC_REORDER_BARRIER();
-
-    } else {
-      HandleSpecialRegisterWrite(index, value);
+    register_file_->MarkWritten(index);
+
+    // Dispatched by the write class table rather than by comparing the index
+    // with every range needing handling, nothing else needs to be done for
+    // the vast majority of the registers.
+    RegisterFile::WriteClass write_class = RegisterFile::GetWriteClass(index);
+    switch (write_class) {
+      case RegisterFile::WriteClass::kRegular:
+        break;
+      case RegisterFile::WriteClass::kSpecial:
+        HandleSpecialRegisterWrite(index, value);
+        break;
+      case RegisterFile::WriteClass::kFetchConstant:
+        if (value != old_value) {
+          OnFetchConstantsChanged(
+              UINT32_C(1)
+              << ((index - XE_GPU_REG_SHADER_CONSTANT_FETCH_00_0) / 6));
+        }
+        break;
+      default:
+        OnShaderConstantsWritten(write_class, index, 1);
+        break;
     }
   } else {
     XELOGW("CommandProcessor::WriteRegister index out of bounds: {}", index);
@@ -626,19 +661,66 @@ void CommandProcessor::WriteRegister(uint32_t index, uint32_t value) {
 void CommandProcessor::WriteRegistersFromMem(uint32_t start_index,
                                              uint32_t* base,
                                              uint32_t num_registers) {
-  for (uint32_t i = 0; i < num_registers; ++i) {
-    uint32_t data = xe::load_and_swap<uint32_t>(base + i);
-    this->WriteRegister(start_index + i, data);
+  uint32_t end_index = start_index + num_registers;
+  if (XE_UNLIKELY(end_index > RegisterFile::kRegisterCount)) {
+    XELOGW(
+        "CommandProcessor::WriteRegistersFromMem range out of bounds: {}, {} "
+        "registers",
+        start_index, num_registers);
+    if (start_index >= RegisterFile::kRegisterCount) {
+      return;
+    }
+    end_index = uint32_t(RegisterFile::kRegisterCount);
+  }
+  uint32_t index = start_index;
+  while (index < end_index) {
+    uint32_t run_length =
+        RegisterFile::GetWriteClassRunLength(index, end_index - index);
+    RegisterFile::WriteClass write_class = RegisterFile::GetWriteClass(index);
+    if (XE_UNLIKELY(write_class == RegisterFile::WriteClass::kSpecial)) {
+      for (uint32_t i = 0; i < run_length; ++i) {
+        WriteRegister(index + i, xe::load_and_swap<uint32_t>(base + i));
+      }
+    } else if (write_class == RegisterFile::WriteClass::kFetchConstant) {
+      uint32_t fetch_constants_changed =
+          register_file_->StoreFetchConstants(index, base, run_length);
+      if (fetch_constants_changed) {
+        OnFetchConstantsChanged(fetch_constants_changed);
+      }
+    } else {
+      copy_and_swap_32_unaligned(&register_file_->values[index], base,
+                                 run_length);
+      if (write_class == RegisterFile::WriteClass::kRegular) {
+        register_file_->MarkRangeWritten(index, run_length);
+      } else {
+        // All the constants of a class are in the same state groups.
+        register_file_->MarkStateGroupsWritten(
+            RegisterFile::GetStateGroups(index));
+        OnShaderConstantsWritten(write_class, index, run_length);
+      }
+    }
+    index += run_length;
+    base += run_length;
   }
 }
 
 void CommandProcessor::WriteRegisterRangeFromRing(xe::RingBuffer* ring,
                                                   uint32_t base,
                                                   uint32_t num_registers) {
-  for (uint32_t i = 0; i < num_registers; ++i) {
-    uint32_t data = ring->ReadAndSwap<uint32_t>();
-    WriteRegister(base + i, data);
+  RingBuffer::ReadRange range =
+      ring->BeginRead(num_registers * sizeof(uint32_t));
+  uint32_t num_registers_first =
+      uint32_t(range.first_length / sizeof(uint32_t));
+  WriteRegistersFromMem(
+      base, reinterpret_cast<uint32_t*>(const_cast<uint8_t*>(range.first)),
+      num_registers_first);
+  if (range.second) {
+    WriteRegistersFromMem(
+        base + num_registers_first,
+        reinterpret_cast<uint32_t*>(const_cast<uint8_t*>(range.second)),
+        num_registers - num_registers_first);
   }
+  ring->EndRead(range);
 }
 
 void CommandProcessor::WriteALURangeFromRing(xe::RingBuffer* ring,
@@ -750,8 +832,72 @@ void CommandProcessor::MakeCoherent() {
 
 void CommandProcessor::PrepareForWait() { trace_writer_.Flush(); }
 
+void CommandProcessor::OnHostFrameOpened(uint64_t frame) {
+  if (!cvars::log_frame_latency) {
+    return;
+  }
+  frame_latency_open_ticks_[frame % kFrameLatencyHistorySize] =
+      Clock::QueryHostTickCount();
+  if (!frame_latency_first_frame_) {
+    frame_latency_first_frame_ = frame;
+    frame_latency_last_completed_frame_ = frame - 1;
+  }
+}
+
+void CommandProcessor::OnHostFramesCompleted(uint64_t frame_completed) {
+  if (!cvars::log_frame_latency || !frame_latency_first_frame_ ||
+      frame_completed <= frame_latency_last_completed_frame_) {
+    return;
+  }
+  uint64_t now = Clock::QueryHostTickCount();
+  // The opening times of older frames have already been overwritten.
+  uint64_t frame_first = frame_latency_last_completed_frame_ + 1;
+  if (frame_completed >= kFrameLatencyHistorySize) {
+    frame_first = std::max(
+        frame_first, frame_completed + 1 - kFrameLatencyHistorySize);
+  }
+  for (uint64_t frame = frame_first; frame <= frame_completed; ++frame) {
+    uint64_t latency =
+        now - frame_latency_open_ticks_[frame % kFrameLatencyHistorySize];
+    frame_latency_sum_ticks_ += latency;
+    frame_latency_max_ticks_ = std::max(frame_latency_max_ticks_, latency);
+    ++frame_latency_count_;
+  }
+  frame_latency_last_completed_frame_ = frame_completed;
+  if (frame_latency_count_ >= kFrameLatencyLogInterval) {
+    double ticks_per_ms = double(Clock::QueryHostTickFrequency()) / 1000.0;
+    XELOGI(
+        "Frame latency (until the host GPU completion is noticed): {:.2f} ms "
+        "average, {:.2f} ms maximum over {} frames",
+        double(frame_latency_sum_ticks_) /
+            (ticks_per_ms * double(frame_latency_count_)),
+        double(frame_latency_max_ticks_) / ticks_per_ms, frame_latency_count_);
+    frame_latency_sum_ticks_ = 0;
+    frame_latency_max_ticks_ = 0;
+    frame_latency_count_ = 0;
+  }
+}
+
 void CommandProcessor::ReturnFromWait() {}
 
+void CommandProcessor::ReportStateGroupRebuilds() {
+  COUNT_profile_set(
+      "gpu/state_groups/viewport_rebuilds_per_frame",
+      state_group_rebuilds_[RegisterFile::kStateGroupIndexViewport]);
+  COUNT_profile_set("gpu/state_groups/blend_rebuilds_per_frame",
+                    state_group_rebuilds_[RegisterFile::kStateGroupIndexBlend]);
+  COUNT_profile_set(
+      "gpu/state_groups/depth_stencil_rebuilds_per_frame",
+      state_group_rebuilds_[RegisterFile::kStateGroupIndexDepthStencil]);
+  COUNT_profile_set(
+      "gpu/state_groups/shader_constants_rebuilds_per_frame",
+      state_group_rebuilds_[RegisterFile::kStateGroupIndexShaderConstants]);
+  COUNT_profile_set(
+      "gpu/state_groups/fetch_constants_rebuilds_per_frame",
+      state_group_rebuilds_[RegisterFile::kStateGroupIndexFetchConstants]);
+  std::memset(state_group_rebuilds_, 0, sizeof(state_group_rebuilds_));
+}
+
 void CommandProcessor::InitializeTrace() {
   // Write the initial register values, to be loaded directly into the
   // RegisterFile since all registers, including those that may have side
@@ -10,16 +10,20 @@
 #ifndef XENIA_GPU_COMMAND_PROCESSOR_H_
 #define XENIA_GPU_COMMAND_PROCESSOR_H_
 
+#include <algorithm>
+#include <array>
 #include <atomic>
 #include <cstring>
 #include <functional>
 #include <memory>
 #include <mutex>
-#include <queue>
 #include <string>
 #include <vector>
 
+#include "xenia/base/concurrent_ring_buffer.h"
+#include "xenia/base/math.h"
 #include "xenia/base/ring_buffer.h"
+#include "xenia/gpu/draw_extent_estimator.h"
 #include "xenia/gpu/register_file.h"
 #include "xenia/gpu/trace_writer.h"
 #include "xenia/gpu/xenos.h"
@@ -116,6 +120,24 @@ class CommandProcessor {
   // awaited.
   virtual void InitializeShaderStorage(const std::filesystem::path& cache_root,
                                        uint32_t title_id, bool blocking);
+  // Progress of loading the shader storage, in shader translations and
+  // pipelines, which may continue in the background after the initialization,
+  // for displaying in the UI. May be called from any thread.
+  void GetShaderStorageProgress(uint32_t& done_out, uint32_t& total_out) const {
+    total_out = shader_storage_progress_total_.load(std::memory_order_relaxed);
+    done_out = std::min(
+        shader_storage_progress_done_.load(std::memory_order_relaxed),
+        total_out);
+  }
+  // For the implementations, may also be called on their threads.
+  void ResetShaderStorageProgress(uint32_t total) {
+    shader_storage_progress_done_.store(0, std::memory_order_relaxed);
+    shader_storage_progress_total_.store(total, std::memory_order_relaxed);
+  }
+  void AddShaderStorageProgress(int32_t done) {
+    shader_storage_progress_done_.fetch_add(uint32_t(done),
+                                            std::memory_order_relaxed);
+  }
 
   virtual void RequestFrameTrace(const std::filesystem::path& root_path);
   virtual void BeginTracing(const std::filesystem::path& root_path);
@@ -131,6 +153,21 @@ class CommandProcessor {
       const reg::DC_LUT_PWL_DATA* new_gamma_ramp_pwl_rgb,
       uint32_t new_gamma_ramp_rw_component);
   virtual void RestoreEdramSnapshot(const void* snapshot) = 0;
+  // Reads the EDRAM contents back in the format of RestoreEdramSnapshot, for
+  // trace playback checkpoints. Must be called from the command processor
+  // thread. Returns false if not supported.
+  virtual bool SaveEdramSnapshot(void* snapshot) { return false; }
+  // Submits the pending host GPU work and awaits its completion, for timing the
+  // host GPU work in trace replay. Must be called from the command processor
+  // thread. Returns whether the await was successful.
+  virtual bool AwaitHostGpuCompletion() { return true; }
+  // Cumulative statistics of the CPU vertex shader execution for draw extent
+  // estimation, for the trace benchmark. Must be called from the command
+  // processor thread.
+  virtual DrawExtentEstimator::Statistics GetDrawExtentEstimatorStatistics()
+      const {
+    return DrawExtentEstimator::Statistics();
+  }
 
   void InitializeRingBuffer(uint32_t ptr, uint32_t size_log2);
   void EnableReadPointerWriteBack(uint32_t ptr, uint32_t block_size_log2);
@@ -218,6 +255,14 @@ class CommandProcessor {
   const reg::DC_LUT_PWL_DATA* gamma_ramp_pwl_rgb() const {
     return gamma_ramp_pwl_rgb_[0];
   }
+  // Called by the register writes of the base class for a range of float or
+  // bool / loop constant registers after storing their values.
+  virtual void OnShaderConstantsWritten(RegisterFile::WriteClass write_class,
+                                        uint32_t first_index,
+                                        uint32_t count) {}
+  // Called by the register writes of the base class with the mask of the
+  // texture fetch constants whose values have been changed by the writes.
+  virtual void OnFetchConstantsChanged(uint32_t fetch_constant_mask) {}
   virtual void OnGammaRamp256EntryTableValueWritten() {}
   virtual void OnGammaRampPWLValueWritten() {}
 
@@ -227,6 +272,12 @@ class CommandProcessor {
 
   virtual void OnPrimaryBufferEnd() {}
 
+  // For log_frame_latency, to be called by the implementations when the GPU
+  // emulation thread starts a frame, and when it notices that the host GPU has
+  // completed frames up to and including frame_completed.
+  void OnHostFrameOpened(uint64_t frame);
+  void OnHostFramesCompleted(uint64_t frame_completed);
+
 #include "pm4_command_processor_declare.h"
 
   virtual Shader* LoadShader(xenos::ShaderType shader_type,
@@ -242,6 +293,14 @@ class CommandProcessor {
     return false;
   }
   virtual bool IssueCopy() { return false; }
+  // Called for EVENT_WRITE_ZPD if host occlusion queries are enabled. Returns
+  // true if the implementation will write the sample counts for the end of the
+  // query to the xe_gpu_depth_sample_counts at the address itself, or false if
+  // the fake sample count should be written.
+  virtual bool IssueOcclusionQuery(uint32_t sample_count_address,
+                                   bool is_end) {
+    return false;
+  }
 
   // "Actual" is for the command processor thread, to be read by the
   // implementations.
@@ -251,6 +310,22 @@ class CommandProcessor {
 
   virtual void InitializeTrace();
 
+  // Takes the register state groups written since the derived host state was
+  // last built, counting them as rebuilt for the profiler.
+  uint32_t TakeDirtyStateGroups(uint32_t groups) {
+    uint32_t dirty = register_file_->TakeDirtyStateGroups(groups);
+    uint32_t group_index;
+    for (uint32_t remaining = dirty;
+         xe::bit_scan_forward(remaining, &group_index);
+         remaining = xe::clear_lowest_bit(remaining)) {
+      ++state_group_rebuilds_[group_index];
+    }
+    return dirty;
+  }
+  // Reports how many times each state group was rebuilt during the frame that
+  // has just ended.
+  void ReportStateGroupRebuilds();
+
   Memory* memory_ = nullptr;
   kernel::KernelState* kernel_state_ = nullptr;
   GraphicsSystem* graphics_system_ = nullptr;
@@ -269,7 +344,13 @@ class CommandProcessor {
   std::atomic<bool> worker_running_;
   kernel::object_ref<kernel::XHostThread> worker_thread_;
 
-  std::queue<std::function<void()>> pending_fns_;
+  std::atomic<uint32_t> shader_storage_progress_done_{0};
+  std::atomic<uint32_t> shader_storage_progress_total_{0};
+
+  // Functions queued by CallInThread from any thread, executed by the worker.
+  // The capacity is large enough for what may be queued while the command
+  // processor is paused, the callers wait for free space otherwise.
+  MpscRingBuffer<std::function<void()>, 1024> pending_fns_;
 
   // MicroEngine binary from PM4_ME_INIT
   std::vector<uint32_t> me_bin_;
@@ -299,11 +380,22 @@ class CommandProcessor {
   SwapPostEffect swap_post_effect_desired_ = SwapPostEffect::kNone;
   SwapPostEffect swap_post_effect_actual_ = SwapPostEffect::kNone;
 
+  uint32_t state_group_rebuilds_[RegisterFile::kStateGroupCount] = {};
+
  private:
   reg::DC_LUT_30_COLOR gamma_ramp_256_entry_table_[256] = {};
   reg::DC_LUT_PWL_DATA gamma_ramp_pwl_rgb_[128][3] = {};
   uint32_t gamma_ramp_rw_component_ = 0;
 
+  static constexpr uint32_t kFrameLatencyLogInterval = 600;
+  static constexpr uint32_t kFrameLatencyHistorySize = 8;
+  std::array<uint64_t, kFrameLatencyHistorySize> frame_latency_open_ticks_{};
+  uint64_t frame_latency_first_frame_ = 0;
+  uint64_t frame_latency_last_completed_frame_ = 0;
+  uint64_t frame_latency_sum_ticks_ = 0;
+  uint64_t frame_latency_max_ticks_ = 0;
+  uint32_t frame_latency_count_ = 0;
+
   XE_NOINLINE XE_COLD void LogKickoffInitator(uint32_t value);
 };
 
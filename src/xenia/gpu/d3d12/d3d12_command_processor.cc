@@ -15,9 +15,14 @@
 #include "xenia/base/assert.h"
 #include "xenia/base/byte_order.h"
 #include "xenia/base/cvar.h"
+#include "xenia/base/fast_forward.h"
+#include "xenia/base/frame_timeline.h"
+#include "xenia/base/input_latency.h"
 #include "xenia/base/logging.h"
 #include "xenia/base/math.h"
 #include "xenia/base/profiling.h"
+#include "xenia/base/startup_timeline.h"
+#include "xenia/base/xxhash.h"
 #include "xenia/gpu/d3d12/d3d12_graphics_system.h"
 #include "xenia/gpu/d3d12/d3d12_shader.h"
 #include "xenia/gpu/draw_util.h"
@@ -45,11 +50,43 @@ DEFINE_bool(d3d12_readback_resolve, false,
             "causes mid-frame synchronization, so it has a huge performance "
             "impact.",
             "D3D12");
+DEFINE_bool(d3d12_readback_async, false,
+            "With d3d12_readback_memexport or d3d12_readback_resolve, don't "
+            "wait for the GPU to copy the data, and write it to the guest "
+            "memory when the copy is completed, or at the end of the frame at "
+            "latest, reducing the synchronization overhead. Data written by "
+            "the GPU may be visible to the CPU later than expected.",
+            "D3D12");
+DEFINE_bool(d3d12_readback_memexport_lazy, false,
+            "With d3d12_readback_memexport, copy the exported data to readback "
+            "buffers asynchronously, and write it to the guest memory only "
+            "when the guest CPU accesses the exported memory, rather than when "
+            "the copy is completed or at the end of the frame. Exported data "
+            "that is only used by the GPU is never written to the guest "
+            "memory, but the first CPU access to the exported memory may need "
+            "to await the GPU.",
+            "D3D12");
 DEFINE_bool(d3d12_submit_on_primary_buffer_end, true,
             "Submit the command list when a PM4 primary buffer ends if it's "
             "possible to submit immediately to try to reduce frame latency.",
             "D3D12");
 
+DEFINE_bool(d3d12_submission_thread, false,
+            "Convert the recorded commands to Direct3D 12 command lists and "
+            "submit them on a separate thread, so the command processor thread "
+            "can continue processing the next PM4 packets meanwhile.",
+            "D3D12");
+DEFINE_int32(d3d12_command_list_recording_threads, 0,
+             "Number of additional threads converting the parts of large "
+             "submissions to separate Direct3D 12 command lists in parallel, "
+             "or 0 to convert each submission on one thread.",
+             "D3D12");
+DEFINE_int32(d3d12_command_list_recording_min_draws, 1024,
+             "Minimum number of draws and dispatches in each part of a "
+             "submission converted in parallel with "
+             "d3d12_command_list_recording_threads.",
+             "D3D12");
+
 DECLARE_bool(clear_memory_page_state);
 
 namespace xe {
@@ -88,8 +125,10 @@ void D3D12CommandProcessor::ClearCaches() {
 
 void D3D12CommandProcessor::InitializeShaderStorage(
     const std::filesystem::path& cache_root, uint32_t title_id, bool blocking) {
+  SCOPE_startup_timeline("D3D12CommandProcessor::InitializeShaderStorage");
   CommandProcessor::InitializeShaderStorage(cache_root, title_id, blocking);
   pipeline_cache_->InitializeShaderStorage(cache_root, title_id, blocking);
+  texture_cache_->InitializeTextureStorage(cache_root, title_id);
 }
 
 void D3D12CommandProcessor::RequestFrameTrace(
@@ -116,12 +155,53 @@ void D3D12CommandProcessor::RestoreEdramSnapshot(const void* snapshot) {
   render_target_cache_->RestoreEdramSnapshot(snapshot);
 }
 
+bool D3D12CommandProcessor::SaveEdramSnapshot(void* snapshot) {
+  if (!BeginSubmission(false)) {
+    return false;
+  }
+  if (!render_target_cache_->InitializeTraceSubmitDownloads()) {
+    return false;
+  }
+  if (!AwaitAllQueueOperationsCompletion()) {
+    return false;
+  }
+  return render_target_cache_->CompleteEdramSnapshotDownload(snapshot);
+}
+
 bool D3D12CommandProcessor::PushTransitionBarrier(
     ID3D12Resource* resource, D3D12_RESOURCE_STATES old_state,
     D3D12_RESOURCE_STATES new_state, UINT subresource) {
   if (old_state == new_state) {
     return false;
   }
+  // The resource can't have been used in the intermediate state if the
+  // barriers haven't been submitted yet, so if the most recent pending barrier
+  // for the resource is a transition of the same subresources, merge them, or
+  // drop both if the resource is transitioned back to the original state.
+  for (auto it = barriers_.rbegin(); it != barriers_.rend(); ++it) {
+    if (!BarrierReferencesResource(*it, resource)) {
+      continue;
+    }
+    if (it->Type == D3D12_RESOURCE_BARRIER_TYPE_TRANSITION &&
+        it->Transition.Subresource == subresource &&
+        it->Transition.StateAfter == old_state) {
+      ++barriers_merged_;
+      if (it->Transition.StateBefore == new_state) {
+        if (new_state & D3D12_RESOURCE_STATE_UNORDERED_ACCESS) {
+          // Still need to order the unordered accesses before and after.
+          it->Type = D3D12_RESOURCE_BARRIER_TYPE_UAV;
+          it->Flags = D3D12_RESOURCE_BARRIER_FLAG_NONE;
+          it->UAV.pResource = resource;
+        } else {
+          barriers_.erase(std::next(it).base());
+        }
+      } else {
+        it->Transition.StateAfter = new_state;
+      }
+      return true;
+    }
+    break;
+  }
   D3D12_RESOURCE_BARRIER barrier;
   barrier.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
   barrier.Flags = D3D12_RESOURCE_BARRIER_FLAG_NONE;
@@ -144,6 +224,16 @@ void D3D12CommandProcessor::PushAliasingBarrier(ID3D12Resource* old_resource,
 }
 
 void D3D12CommandProcessor::PushUAVBarrier(ID3D12Resource* resource) {
+  // A UAV barrier for the same resource (or for all resources) already in the
+  // batch covers all the accesses before it.
+  for (const D3D12_RESOURCE_BARRIER& pending_barrier : barriers_) {
+    if (pending_barrier.Type == D3D12_RESOURCE_BARRIER_TYPE_UAV &&
+        (!pending_barrier.UAV.pResource ||
+         pending_barrier.UAV.pResource == resource)) {
+      ++barriers_merged_;
+      return;
+    }
+  }
   D3D12_RESOURCE_BARRIER barrier;
   barrier.Type = D3D12_RESOURCE_BARRIER_TYPE_UAV;
   barrier.Flags = D3D12_RESOURCE_BARRIER_FLAG_NONE;
@@ -156,9 +246,39 @@ void D3D12CommandProcessor::SubmitBarriers() {
   if (barrier_count != 0) {
     deferred_command_list_.D3DResourceBarrier(barrier_count, barriers_.data());
     barriers_.clear();
+    barriers_submitted_ += barrier_count;
+    ++barrier_batches_submitted_;
   }
 }
 
+bool D3D12CommandProcessor::BarrierReferencesResource(
+    const D3D12_RESOURCE_BARRIER& barrier, ID3D12Resource* resource) {
+  switch (barrier.Type) {
+    case D3D12_RESOURCE_BARRIER_TYPE_TRANSITION:
+      return barrier.Transition.pResource == resource;
+    case D3D12_RESOURCE_BARRIER_TYPE_ALIASING:
+      // Null means any placed or reserved resource.
+      return !barrier.Aliasing.pResourceBefore ||
+             !barrier.Aliasing.pResourceAfter ||
+             barrier.Aliasing.pResourceBefore == resource ||
+             barrier.Aliasing.pResourceAfter == resource;
+    case D3D12_RESOURCE_BARRIER_TYPE_UAV:
+      return !barrier.UAV.pResource || barrier.UAV.pResource == resource;
+    default:
+      return true;
+  }
+}
+
+void D3D12CommandProcessor::ReportBarrierCounts() {
+  COUNT_profile_set("gpu/d3d12/barriers_per_frame", barriers_submitted_);
+  COUNT_profile_set("gpu/d3d12/barrier_batches_per_frame",
+                    barrier_batches_submitted_);
+  COUNT_profile_set("gpu/d3d12/barriers_merged_per_frame", barriers_merged_);
+  barriers_submitted_ = 0;
+  barrier_batches_submitted_ = 0;
+  barriers_merged_ = 0;
+}
+
 ID3D12RootSignature* D3D12CommandProcessor::GetRootSignature(
     const DxbcShader* vertex_shader, const DxbcShader* pixel_shader,
     bool tessellated) {
@@ -874,6 +994,64 @@ bool D3D12CommandProcessor::SetupContext() {
   // Optional - added in Creators Update (SDK 10.0.15063.0).
   command_list_->QueryInterface(IID_PPV_ARGS(&command_list_1_));
 
+  if (cvars::d3d12_submission_thread) {
+    for (QueuedSubmission& queued_submission : submission_queue_) {
+      queued_submission.deferred_command_list =
+          std::make_unique<DeferredCommandList>(*this);
+    }
+    submission_queue_written_event_ =
+        xe::threading::Event::CreateAutoResetEvent(false);
+    submission_queue_read_event_ =
+        xe::threading::Event::CreateAutoResetEvent(false);
+    submission_thread_running_ = true;
+    submission_thread_ =
+        xe::threading::Thread::Create({}, [this]() { SubmissionThread(); });
+    if (!submission_thread_) {
+      XELOGE("Failed to create the submission thread");
+      return false;
+    }
+    submission_thread_->set_name("D3D12 Submission");
+  }
+
+  size_t command_list_recorder_count =
+      std::min(size_t(std::max(cvars::d3d12_command_list_recording_threads, 0)),
+               kMaxCommandListRecorders);
+  if (command_list_recorder_count) {
+    command_list_recorders_.resize(command_list_recorder_count);
+    for (CommandListRecorder& recorder : command_list_recorders_) {
+      ID3D12CommandAllocator* recorder_command_allocator;
+      if (FAILED(device->CreateCommandAllocator(
+              D3D12_COMMAND_LIST_TYPE_DIRECT,
+              IID_PPV_ARGS(&recorder_command_allocator)))) {
+        XELOGE("Failed to create a command allocator for parallel recording");
+        return false;
+      }
+      recorder.command_allocators.emplace_back(0, recorder_command_allocator);
+      if (FAILED(device->CreateCommandList(
+              0, D3D12_COMMAND_LIST_TYPE_DIRECT, recorder_command_allocator,
+              nullptr, IID_PPV_ARGS(&recorder.command_list)))) {
+        XELOGE(
+            "Failed to create a graphics command list for parallel "
+            "recording");
+        return false;
+      }
+      recorder.command_list->Close();
+      recorder.command_list->QueryInterface(
+          IID_PPV_ARGS(&recorder.command_list_1));
+    }
+    command_list_recording_shutdown_ = false;
+    for (size_t i = 0; i < command_list_recorder_count; ++i) {
+      command_list_recorders_[i].thread = xe::threading::Thread::Create(
+          {}, [this, i]() { CommandListRecordingThread(i); });
+      if (!command_list_recorders_[i].thread) {
+        XELOGE("Failed to create a command list recording thread");
+        return false;
+      }
+      command_list_recorders_[i].thread->set_name(
+          "D3D12 Command List Recording");
+    }
+  }
+
   bindless_resources_used_ =
       cvars::d3d12_bindless &&
       provider.GetResourceBindingTier() >= D3D12_RESOURCE_BINDING_TIER_2;
@@ -1628,6 +1806,10 @@ bool D3D12CommandProcessor::SetupContext() {
   pix_capture_requested_.store(false, std::memory_order_relaxed);
   pix_capturing_ = false;
 
+  if (cvars::profile_gpu_timestamps) {
+    InitializeGpuTimestamps();
+  }
+
   // Just not to expose uninitialized memory.
   std::memset(&system_constants_, 0, sizeof(system_constants_));
 
@@ -1637,6 +1819,58 @@ bool D3D12CommandProcessor::SetupContext() {
 void D3D12CommandProcessor::ShutdownContext() {
   AwaitAllQueueOperationsCompletion();
 
+  CompleteAsyncReadbacks(true);
+  CompleteLazyAsyncReadbacks(0);
+  CompleteOcclusionQueries(true);
+  ShutdownOcclusionQueries();
+  ShutdownGpuTimestamps();
+  for (AsyncReadbackBuffer& buffer : async_readback_buffers_free_) {
+    buffer.buffer->Release();
+  }
+  async_readback_buffers_free_.clear();
+  if (async_readback_invalidation_callback_handle_) {
+    memory_->UnregisterPhysicalMemoryInvalidationCallback(
+        async_readback_invalidation_callback_handle_);
+    async_readback_invalidation_callback_handle_ = nullptr;
+  }
+  if (async_readback_data_provider_handle_) {
+    memory_->UnregisterPhysicalMemoryDataProvider(
+        async_readback_data_provider_handle_);
+    async_readback_data_provider_handle_ = nullptr;
+  }
+
+  if (submission_thread_) {
+    AwaitQueuedSubmissions();
+    submission_thread_running_ = false;
+    submission_queue_written_event_->Set();
+    xe::threading::Wait(submission_thread_.get(), false);
+    submission_thread_.reset();
+  }
+  submission_queue_read_event_.reset();
+  submission_queue_written_event_.reset();
+  for (QueuedSubmission& queued_submission : submission_queue_) {
+    queued_submission.deferred_command_list.reset();
+  }
+
+  {
+    std::lock_guard<xe_mutex> lock(command_list_recording_lock_);
+    command_list_recording_shutdown_ = true;
+  }
+  command_list_recording_request_cond_.notify_all();
+  for (CommandListRecorder& recorder : command_list_recorders_) {
+    if (recorder.thread) {
+      xe::threading::Wait(recorder.thread.get(), false);
+    }
+    for (const std::pair<uint64_t, ID3D12CommandAllocator*>&
+             recorder_command_allocator : recorder.command_allocators) {
+      recorder_command_allocator.second->Release();
+    }
+    ui::d3d12::util::ReleaseAndNull(recorder.command_list_1);
+    ui::d3d12::util::ReleaseAndNull(recorder.command_list);
+  }
+  command_list_recorders_.clear();
+  command_list_parts_.clear();
+
   ui::d3d12::util::ReleaseAndNull(readback_buffer_);
   readback_buffer_size_ = 0;
 
@@ -1768,7 +2002,9 @@ void D3D12CommandProcessor::WriteRegisterForceinline(uint32_t index,
   __m128i is_above_lower = _mm_cmpgt_epi16(to_rangecheck, lower_bounds);
   __m128i is_below_upper = _mm_cmplt_epi16(to_rangecheck, upper_bounds);
   __m128i is_within_range = _mm_and_si128(is_above_lower, is_below_upper);
+  uint32_t old_value = register_file_->values[index];
   register_file_->values[index] = value;
+  register_file_->MarkWritten(index);
 
   uint32_t movmask = static_cast<uint32_t>(_mm_movemask_epi8(is_within_range));
 
@@ -1797,10 +2033,13 @@ void D3D12CommandProcessor::WriteRegisterForceinline(uint32_t index,
     } else if (movmask & (1 << 5)) {
       cbuffer_binding_bool_loop_.up_to_date = false;
     } else if (movmask & (1 << 1)) {
-      cbuffer_binding_fetch_.up_to_date = false;
+      // Titles often rewrite the same fetch constants on every draw.
+      if (value != old_value) {
+        cbuffer_binding_fetch_.up_to_date = false;
 
-      texture_cache_->TextureFetchConstantWritten(
-          (index - XE_GPU_REG_SHADER_CONSTANT_FETCH_00_0) / 6);
+        texture_cache_->TextureFetchConstantWritten(
+            (index - XE_GPU_REG_SHADER_CONSTANT_FETCH_00_0) / 6);
+      }
     } else {
       HandleSpecialRegisterWrite(index, value);
     }
@@ -2011,6 +2250,8 @@ void D3D12CommandProcessor::WriteShaderConstantsFromMem(
     cbuffer_binding_float_vertex_.up_to_date = cbuffer_vertex_uptodate;
   }
 
+  register_file_->MarkStateGroupsWritten(
+      RegisterFile::kStateGroupShaderConstants);
   // maybe use non-temporal copy if possible...
   copy_and_swap_32_unaligned(&register_file_->values[start_index], base,
                              num_registers);
@@ -2020,6 +2261,8 @@ void D3D12CommandProcessor::WriteBoolLoopFromMem(uint32_t start_index,
                                                  uint32_t* base,
                                                  uint32_t num_registers) {
   cbuffer_binding_bool_loop_.up_to_date = false;
+  register_file_->MarkStateGroupsWritten(
+      RegisterFile::kStateGroupShaderConstants);
   copy_and_swap_32_unaligned(&register_file_->values[start_index], base,
                              num_registers);
 }
@@ -2027,18 +2270,12 @@ XE_FORCEINLINE
 void D3D12CommandProcessor::WriteFetchFromMem(uint32_t start_index,
                                               uint32_t* base,
                                               uint32_t num_registers) {
-  cbuffer_binding_fetch_.up_to_date = false;
-
-  uint32_t first_fetch =
-      ((start_index - XE_GPU_REG_SHADER_CONSTANT_FETCH_00_0) / 6);
-  uint32_t last_fetch =  // i think last_fetch should be inclusive if its modulo
-                         // is nz...
-      (((start_index + num_registers) - XE_GPU_REG_SHADER_CONSTANT_FETCH_00_0) /
-       6);
-  texture_cache_->TextureFetchConstantsWritten(first_fetch, last_fetch);
-
-  copy_and_swap_32_unaligned(&register_file_->values[start_index], base,
-                             num_registers);
+  uint32_t fetch_constants_changed =
+      register_file_->StoreFetchConstants(start_index, base, num_registers);
+  if (fetch_constants_changed) {
+    cbuffer_binding_fetch_.up_to_date = false;
+    texture_cache_->TextureFetchConstantsChanged(fetch_constants_changed);
+  }
 }
 
 void D3D12CommandProcessor::WritePossiblySpecialRegistersFromMem(
@@ -2075,8 +2312,9 @@ D3D12CommandProcessor::WriteRegisterRangeFromMem_WithKnownBound(
   auto get_end_before_qty = [&end, current_index](uint32_t regnum) {
     return std::min<uint32_t>(regnum, end) - current_index;
   };
-#define REGULAR_WRITE_CALLBACK(s, e, i, b, n) \
-  copy_and_swap_32_unaligned(&register_file_->values[i], b, n)
+#define REGULAR_WRITE_CALLBACK(s, e, i, b, n)                    \
+  copy_and_swap_32_unaligned(&register_file_->values[i], b, n); \
+  register_file_->MarkRangeWritten(i, n)
 #define WRITE_FETCH_CONSTANTS_CALLBACK(str, er, ind, b, n) \
   WriteFetchFromMem(ind, b, n)
 #define SPECIAL_REG_RANGE_CALLBACK(str, edr, ind, bs, n) \
@@ -2194,6 +2432,15 @@ void D3D12CommandProcessor::IssueSwap(uint32_t frontbuffer_ptr,
     return;
   }
 
+  // Make the data read back asynchronously during the frame visible to the
+  // guest before it proceeds to the next frame.
+  CompleteAsyncReadbacks(true);
+
+  // Skipping the intermediate frames while fast-forwarding.
+  if (!fast_forward::ShouldPresentGuestFrame()) {
+    return;
+  }
+
   // Obtain the actual front buffer size to pass to RefreshGuestOutput,
   // resolution-scaled if it's a resolve destination, or not otherwise.
   D3D12_SHADER_RESOURCE_VIEW_DESC swap_texture_srv_desc;
@@ -2530,6 +2777,14 @@ void D3D12CommandProcessor::IssueSwap(uint32_t frontbuffer_ptr,
   EndSubmission(true);
 }
 
+void D3D12CommandProcessor::PrepareForWait() {
+  CommandProcessor::PrepareForWait();
+  // The guest may be polling the results of the ended occlusion queries while
+  // there are no commands to process, deliver them instead of leaving them
+  // pending until the next submission.
+  CompleteOcclusionQueries(true);
+}
+
 void D3D12CommandProcessor::OnPrimaryBufferEnd() {
   if (cvars::d3d12_submit_on_primary_buffer_end && submission_open_ &&
       CanEndSubmissionImmediately()) {
@@ -2690,6 +2945,10 @@ bool D3D12CommandProcessor::IssueDraw(xenos::PrimitiveType primitive_type,
           &root_signature)) {
     return false;
   }
+  if (!pipeline_handle) {
+    // The shaders are still being translated asynchronously.
+    return true;
+  }
 
   // Update the textures - this may bind pipelines.
   uint32_t used_texture_mask =
@@ -2708,11 +2967,22 @@ bool D3D12CommandProcessor::IssueDraw(xenos::PrimitiveType primitive_type,
     current_external_pipeline_ = nullptr;
   }
 
+  // Only the state derived from the registers written since the last draw
+  // needs to be read from the registers again.
+  uint32_t dirty_state_groups =
+      TakeDirtyStateGroups(RegisterFile::kStateGroupsAll);
+
   // Get dynamic rasterizer state.
   uint32_t draw_resolution_scale_x = texture_cache_->draw_resolution_scale_x();
   uint32_t draw_resolution_scale_y = texture_cache_->draw_resolution_scale_y();
   draw_util::ViewportInfo viewport_info;
   draw_util::GetViewportInfoArgs gviargs{};
+  bool viewport_registers_written =
+      (dirty_state_groups & RegisterFile::kStateGroupViewport) != 0;
+  if (!viewport_registers_written) {
+    // Still need to check the inputs not coming from the registers.
+    gviargs = previous_viewport_info_args_;
+  }
 
   gviargs.Setup(
       draw_resolution_scale_x, draw_resolution_scale_y,
@@ -2723,7 +2993,9 @@ bool D3D12CommandProcessor::IssueDraw(xenos::PrimitiveType primitive_type,
       host_render_targets_used &&
           render_target_cache_->depth_float24_convert_in_pixel_shader(),
       host_render_targets_used, pixel_shader && pixel_shader->writes_depth());
-  gviargs.SetupRegisterValues(regs);
+  if (viewport_registers_written) {
+    gviargs.SetupRegisterValues(regs);
+  }
 
   if (gviargs == previous_viewport_info_args_) {
     viewport_info = previous_viewport_info_;
@@ -2732,23 +3004,28 @@ bool D3D12CommandProcessor::IssueDraw(xenos::PrimitiveType primitive_type,
     previous_viewport_info_args_ = gviargs;
     previous_viewport_info_ = viewport_info;
   }
-  // todo: use SIMD for getscissor + scaling here, should reduce code size more
-  draw_util::Scissor scissor;
-  draw_util::GetScissor(regs, scissor);
+  if (viewport_registers_written) {
+    // todo: use SIMD for getscissor + scaling here, should reduce code size
+    // more
+    draw_util::Scissor& scissor = previous_scissor_;
+    draw_util::GetScissor(regs, scissor);
 #if XE_ARCH_AMD64 == 1
-  __m128i* scisp = (__m128i*)&scissor;
-  *scisp = _mm_mullo_epi32(
-      *scisp, _mm_setr_epi32(draw_resolution_scale_x, draw_resolution_scale_y,
-                             draw_resolution_scale_x, draw_resolution_scale_y));
+    __m128i* scisp = (__m128i*)&scissor;
+    *scisp = _mm_mullo_epi32(
+        *scisp,
+        _mm_setr_epi32(draw_resolution_scale_x, draw_resolution_scale_y,
+                       draw_resolution_scale_x, draw_resolution_scale_y));
 #else
-  scissor.offset[0] *= draw_resolution_scale_x;
-  scissor.offset[1] *= draw_resolution_scale_y;
-  scissor.extent[0] *= draw_resolution_scale_x;
-  scissor.extent[1] *= draw_resolution_scale_y;
+    scissor.offset[0] *= draw_resolution_scale_x;
+    scissor.offset[1] *= draw_resolution_scale_y;
+    scissor.extent[0] *= draw_resolution_scale_x;
+    scissor.extent[1] *= draw_resolution_scale_y;
 #endif
+  }
   // Update viewport, scissor, blend factor and stencil reference.
-  UpdateFixedFunctionState(viewport_info, scissor, primitive_polygonal,
-                           normalized_depth_control);
+  UpdateFixedFunctionState(viewport_info, previous_scissor_,
+                           primitive_polygonal, normalized_depth_control,
+                           dirty_state_groups);
 
   // Update system constants before uploading them.
   // TODO(Triang3l): With ROV, pass the disabled render target mask for safety.
@@ -2916,6 +3193,11 @@ bool D3D12CommandProcessor::IssueDraw(xenos::PrimitiveType primitive_type,
   SetPrimitiveTopology(primitive_topology);
   // Must not call anything that may change the primitive topology from now on!
 
+  if (occlusion_query_active_) {
+    BeginOcclusionQuerySegment();
+  }
+  SwitchGpuTimestampCategory(GpuTimestampProfiler::Category::kDraws);
+
   // Draw.
   if (primitive_processing_result.index_buffer_type ==
       PrimitiveProcessor::ProcessedIndexBufferType::kNone) {
@@ -2984,15 +3266,25 @@ bool D3D12CommandProcessor::IssueDraw(xenos::PrimitiveType primitive_type,
         assert_unhandled_case(primitive_processing_result.index_buffer_type);
         return false;
     }
-    deferred_command_list_.D3DIASetIndexBuffer(&index_buffer_view);
     if (memexport_used) {
       shared_memory_->UseForWriting();
     } else {
       shared_memory_->UseForReading();
     }
     SubmitBarriers();
-    deferred_command_list_.D3DDrawIndexedInstanced(
-        primitive_processing_result.host_draw_vertex_count, 1, 0, 0, 0);
+    // If nothing has been recorded since the previous draw, and it has an
+    // index buffer directly preceding the current one, merge the two draws.
+    // Memory export makes draws dependent on each other, and uses a scratch
+    // buffer for the indices.
+    if (!cvars::merge_consecutive_draws || memexport_used ||
+        !primitive_processing_result.IsMergeableWithAdjacentIndices() ||
+        !deferred_command_list_.TryExtendLastD3DDrawIndexedInstanced(
+            index_buffer_view,
+            primitive_processing_result.host_draw_vertex_count)) {
+      deferred_command_list_.D3DIASetIndexBuffer(&index_buffer_view);
+      deferred_command_list_.D3DDrawIndexedInstanced(
+          primitive_processing_result.host_draw_vertex_count, 1, 0, 0, 0);
+    }
     if (scratch_index_buffer != nullptr) {
       ReleaseScratchGPUBuffer(scratch_index_buffer,
                               D3D12_RESOURCE_STATE_INDEX_BUFFER);
@@ -3018,7 +3310,23 @@ bool D3D12CommandProcessor::IssueDraw(xenos::PrimitiveType primitive_type,
            memexport_ranges_) {
         memexport_total_size += memexport_range.size_bytes;
       }
-      if (memexport_total_size != 0) {
+      bool memexport_read_back_async = false;
+      if (memexport_total_size != 0 &&
+          (cvars::d3d12_readback_async ||
+           cvars::d3d12_readback_memexport_lazy)) {
+        std::vector<std::pair<uint32_t, uint32_t>> memexport_readback_ranges;
+        memexport_readback_ranges.reserve(memexport_ranges_.size());
+        for (const draw_util::MemExportRange& memexport_range :
+             memexport_ranges_) {
+          memexport_readback_ranges.emplace_back(
+              memexport_range.base_address_dwords << 2,
+              memexport_range.size_bytes);
+        }
+        memexport_read_back_async = RequestAsyncReadback(
+            memexport_readback_ranges.data(), memexport_readback_ranges.size(),
+            cvars::d3d12_readback_memexport_lazy);
+      }
+      if (memexport_total_size != 0 && !memexport_read_back_async) {
         ID3D12Resource* readback_buffer =
             RequestReadbackBuffer(memexport_total_size);
         if (readback_buffer != nullptr) {
@@ -3084,6 +3392,43 @@ void D3D12CommandProcessor::InitializeTrace() {
   }
 }
 
+bool D3D12CommandProcessor::IssueOcclusionQuery(uint32_t sample_count_address,
+                                                bool is_end) {
+  // With rasterizer-ordered views, depth and stencil testing is done in the
+  // pixel shader, and the host query would count all covered samples.
+  if (render_target_cache_->GetPath() !=
+      RenderTargetCache::Path::kHostRenderTargets) {
+    return false;
+  }
+  if (is_end) {
+    if (!occlusion_query_active_) {
+      // Began when host queries were not available.
+      return false;
+    }
+    EndOcclusionQuerySegment();
+    occlusion_query_active_ = false;
+    occlusion_queries_.back().sample_count_address = sample_count_address;
+    return true;
+  }
+  if (!occlusion_query_heap_ && !InitializeOcclusionQueries()) {
+    return false;
+  }
+  if (occlusion_query_active_) {
+    // Not ended by the guest - abandon the previous query.
+    EndOcclusionQuerySegment();
+    occlusion_query_active_ = false;
+  }
+  OcclusionQuery& query = occlusion_queries_.emplace_back();
+  query.sample_count_address = UINT32_MAX;
+  query.slot_first = occlusion_query_slot_next_;
+  query.slot_count = 0;
+  query.segments_dropped = false;
+  query.submission = 0;
+  occlusion_query_active_ = true;
+  // The segments are begun lazily before draws.
+  return true;
+}
+
 bool D3D12CommandProcessor::IssueCopy() {
 #if XE_UI_D3D12_FINE_GRAINED_DRAW_SCOPES
   SCOPE_profile_cpu_f("gpu");
@@ -3091,6 +3436,7 @@ bool D3D12CommandProcessor::IssueCopy() {
   if (!BeginSubmission(true)) {
     return false;
   }
+  SwitchGpuTimestampCategory(GpuTimestampProfiler::Category::kResolves);
   if (!cvars::d3d12_readback_resolve) {
     uint32_t written_address, written_length;
     return render_target_cache_->Resolve(*memory_, *shared_memory_,
@@ -3107,6 +3453,13 @@ bool D3D12CommandProcessor::IssueCopy_ReadbackResolvePath() {
   if (render_target_cache_->Resolve(*memory_, *shared_memory_, *texture_cache_,
                                     written_address, written_length)) {
     if (!texture_cache_->IsDrawResolutionScaled() && written_length) {
+      if (cvars::d3d12_readback_async) {
+        std::pair<uint32_t, uint32_t> written_range(written_address,
+                                                    written_length);
+        if (RequestAsyncReadback(&written_range, 1)) {
+          return true;
+        }
+      }
       // Read the resolved data on the CPU.
       ID3D12Resource* readback_buffer = RequestReadbackBuffer(written_length);
       if (readback_buffer != nullptr) {
@@ -3232,6 +3585,8 @@ void D3D12CommandProcessor::CheckSubmissionFence(uint64_t await_submission) {
   primitive_processor_->CompletedSubmissionUpdated();
 
   texture_cache_->CompletedSubmissionUpdated(submission_completed_);
+
+  CompleteGpuTimestamps();
 }
 
 bool D3D12CommandProcessor::BeginSubmission(bool is_guest_command) {
@@ -3260,11 +3615,21 @@ bool D3D12CommandProcessor::BeginSubmission(bool is_guest_command) {
 
   // Check the fence - needed for all kinds of submissions (to reclaim transient
   // resources early) and specifically for frames (not to queue too many), and
-  // await the availability of the current frame.
-  CheckSubmissionFence(
-      is_opening_frame
-          ? closed_frame_submissions_[frame_current_ % kQueueFrames]
-          : 0);
+  // await the availability of the current frame, or, with max_queued_frames,
+  // of a more recent one for lower latency.
+  uint64_t await_submission = 0;
+  if (is_opening_frame) {
+    uint32_t queued_frames =
+        std::clamp(cvars::max_queued_frames, uint32_t(1), kQueueFrames);
+    if (frame_current_ >= queued_frames) {
+      await_submission =
+          closed_frame_submissions_[(frame_current_ - queued_frames) %
+                                    kQueueFrames];
+    }
+  }
+  CheckSubmissionFence(await_submission);
+  CompleteAsyncReadbacks(false);
+  CompleteOcclusionQueries(false);
   // TODO(Triang3l): If failed to await (completed submission < awaited frame
   // submission), do something like dropping the draw command that wanted to
   // open the frame.
@@ -3282,9 +3647,19 @@ bool D3D12CommandProcessor::BeginSubmission(bool is_guest_command) {
       }
       frame_completed_ = frame;
     }
+    OnHostFramesCompleted(frame_completed_);
+    OnHostFrameOpened(frame_current_);
   }
 
   if (!submission_open_) {
+    // The timestamps of the submission that used the same block of timestamp
+    // queries must be read back before they're overwritten.
+    if (gpu_timestamp_query_heap_ &&
+        submission_current_ > GpuTimestampProfiler::kSubmissionBlockCount) {
+      CheckSubmissionFence(submission_current_ -
+                           GpuTimestampProfiler::kSubmissionBlockCount);
+    }
+
     submission_open_ = true;
 
     // Start a new deferred command list - will submit it to the real one in the
@@ -3292,6 +3667,12 @@ bool D3D12CommandProcessor::BeginSubmission(bool is_guest_command) {
     // fulfilled).
     deferred_command_list_.Reset();
 
+    if (gpu_timestamp_query_heap_) {
+      deferred_command_list_.D3DEndQuery(
+          gpu_timestamp_query_heap_, D3D12_QUERY_TYPE_TIMESTAMP,
+          gpu_timestamp_profiler_.BeginSubmission(submission_current_));
+    }
+
     // Reset cached state of the command list.
     ff_viewport_update_needed_ = true;
     ff_scissor_update_needed_ = true;
@@ -3307,6 +3688,10 @@ bool D3D12CommandProcessor::BeginSubmission(bool is_guest_command) {
     } else {
       view_bindful_heap_current_ = nullptr;
       sampler_bindful_heap_current_ = nullptr;
+      // Textures not used in the new submission yet may be destroyed.
+      bindful_texture_tables_.clear();
+      bindful_texture_tables_heap_index_ =
+          ui::d3d12::D3D12DescriptorHeapPool::kHeapIndexInvalid;
     }
     primitive_topology_ = D3D_PRIMITIVE_TOPOLOGY_UNDEFINED;
 
@@ -3328,6 +3713,8 @@ bool D3D12CommandProcessor::BeginSubmission(bool is_guest_command) {
     cbuffer_binding_system_.up_to_date = false;
     cbuffer_binding_float_vertex_.up_to_date = false;
     cbuffer_binding_float_pixel_.up_to_date = false;
+    float_constant_upload_vertex_.valid = false;
+    float_constant_upload_pixel_.valid = false;
     cbuffer_binding_bool_loop_.up_to_date = false;
     cbuffer_binding_fetch_.up_to_date = false;
     current_shared_memory_binding_is_uav_.reset();
@@ -3365,6 +3752,8 @@ bool D3D12CommandProcessor::BeginSubmission(bool is_guest_command) {
 
     primitive_processor_->BeginFrame();
 
+    render_target_cache_->BeginFrame();
+
     texture_cache_->BeginFrame();
   }
 
@@ -3392,12 +3781,30 @@ bool D3D12CommandProcessor::EndSubmission(bool is_swap) {
     command_allocator_writable_last_ = command_allocator_writable_first_;
   }
 
+  // Submit the textures loaded on the asynchronous loading queue before the
+  // direct queue submission awaiting them.
+  bool await_async_texture_loads = false;
+  if (submission_open_ &&
+      !texture_cache_->SubmitAsyncLoads(await_async_texture_loads)) {
+    // Try to submit later.
+    return false;
+  }
+
   bool is_closing_frame = is_swap && frame_open_;
 
   if (is_closing_frame) {
     texture_cache_->EndFrame();
 
+    shared_memory_->EndFrame();
+
     primitive_processor_->EndFrame();
+
+    ReportStateGroupRebuilds();
+    ReportBarrierCounts();
+
+    if (gpu_timestamp_query_heap_) {
+      gpu_timestamp_profiler_.EndFrame();
+    }
   }
 
   if (submission_open_) {
@@ -3405,25 +3812,41 @@ bool D3D12CommandProcessor::EndSubmission(bool is_swap) {
 
     pipeline_cache_->EndSubmission();
 
+    // D3D12 queries can't span multiple command lists - the active occlusion
+    // query will be continued in the next submission.
+    EndOcclusionQuerySegment();
+
     // Submit barriers now because resources with the queued barriers may be
     // destroyed between frames.
     SubmitBarriers();
 
-    ID3D12CommandQueue* direct_queue = provider.GetDirectQueue();
+    if (gpu_timestamp_query_heap_) {
+      uint32_t timestamp_index = gpu_timestamp_profiler_.EndSubmission();
+      if (timestamp_index != UINT32_MAX) {
+        deferred_command_list_.D3DEndQuery(gpu_timestamp_query_heap_,
+                                           D3D12_QUERY_TYPE_TIMESTAMP,
+                                           timestamp_index);
+        uint32_t timestamp_first =
+            GpuTimestampProfiler::GetSubmissionFirstTimestamp(
+                submission_current_);
+        deferred_command_list_.D3DResolveQueryData(
+            gpu_timestamp_query_heap_, D3D12_QUERY_TYPE_TIMESTAMP,
+            timestamp_first,
+            gpu_timestamp_profiler_.GetLastSubmissionTimestampCount(),
+            gpu_timestamp_readback_buffer_, sizeof(uint64_t) * timestamp_first);
+      }
+    }
 
     // Submit the deferred command list.
-    // Only one deferred command list must be executed in the same
-    // ExecuteCommandLists - the boundaries of ExecuteCommandLists are a full
-    // UAV and aliasing barrier, and subsystems of the emulator assume it
-    // happens between Xenia submissions.
     ID3D12CommandAllocator* command_allocator =
         command_allocator_writable_first_->command_allocator;
-    command_allocator->Reset();
-    command_list_->Reset(command_allocator, nullptr);
-    deferred_command_list_.Execute(command_list_, command_list_1_);
-    command_list_->Close();
-    ID3D12CommandList* execute_command_lists[] = {command_list_};
-    direct_queue->ExecuteCommandLists(1, execute_command_lists);
+    if (submission_thread_) {
+      QueueSubmission(command_allocator, submission_current_,
+                      await_async_texture_loads);
+    } else {
+      ExecuteSubmission(deferred_command_list_, command_allocator,
+                        submission_current_, await_async_texture_loads);
+    }
     command_allocator_writable_first_->last_usage_submission =
         submission_current_;
     if (command_allocator_submitted_last_) {
@@ -3439,7 +3862,7 @@ bool D3D12CommandProcessor::EndSubmission(bool is_swap) {
       command_allocator_writable_last_ = nullptr;
     }
 
-    direct_queue->Signal(submission_fence_, submission_current_++);
+    ++submission_current_;
 
     submission_open_ = false;
 
@@ -3448,6 +3871,12 @@ bool D3D12CommandProcessor::EndSubmission(bool is_swap) {
     queue_operations_done_since_submission_signal_ = false;
   }
 
+  if (is_swap) {
+    // The presenter will put the commands that use the guest output on the
+    // queue after this, and the capture must include the whole frame.
+    AwaitQueuedSubmissions();
+  }
+
   if (is_closing_frame) {
     if (cvars::clear_memory_page_state) {
       shared_memory_->SetSystemPageBlocksValidWithGpuDataWritten();
@@ -3524,10 +3953,188 @@ void D3D12CommandProcessor::ClearCommandAllocatorCache() {
   command_allocator_writable_last_ = nullptr;
 }
 
+void D3D12CommandProcessor::ExecuteSubmission(
+    DeferredCommandList& deferred_command_list,
+    ID3D12CommandAllocator* command_allocator, uint64_t submission,
+    bool await_async_texture_loads) {
+  SCOPE_profile_cpu_f("gpu");
+  // Only one deferred command list must be executed in the same
+  // ExecuteCommandLists - the boundaries of ExecuteCommandLists are a full UAV
+  // and aliasing barrier, and subsystems of the emulator assume it happens
+  // between Xenia submissions.
+  if (!command_list_recorders_.empty()) {
+    deferred_command_list.Split(
+        uint32_t(command_list_recorders_.size() + 1),
+        uint32_t(std::max(cvars::d3d12_command_list_recording_min_draws, 1)),
+        command_list_parts_);
+  } else {
+    command_list_parts_.clear();
+  }
+  size_t part_count = command_list_parts_.size();
+  if (part_count > 1) {
+    // The other parts are recorded by the recording threads meanwhile.
+    {
+      std::lock_guard<xe_mutex> lock(command_list_recording_lock_);
+      command_list_recording_source_ = &deferred_command_list;
+      command_list_recording_submission_ = submission;
+      command_list_recording_part_count_ = part_count;
+      command_list_recording_pending_ = part_count - 1;
+      ++command_list_recording_generation_;
+    }
+    command_list_recording_request_cond_.notify_all();
+  }
+  command_allocator->Reset();
+  command_list_->Reset(command_allocator, nullptr);
+  if (part_count > 1) {
+    deferred_command_list.Execute(command_list_, command_list_1_,
+                                  command_list_parts_[0]);
+  } else {
+    deferred_command_list.Execute(command_list_, command_list_1_);
+  }
+  command_list_->Close();
+  ID3D12CommandList* execute_command_lists[1 + kMaxCommandListRecorders];
+  UINT execute_command_list_count = 0;
+  execute_command_lists[execute_command_list_count++] = command_list_;
+  if (part_count > 1) {
+    {
+      std::unique_lock<xe_mutex> lock(command_list_recording_lock_);
+      command_list_recording_done_cond_.wait(
+          lock, [this]() { return !command_list_recording_pending_; });
+    }
+    for (size_t i = 1; i < part_count; ++i) {
+      execute_command_lists[execute_command_list_count++] =
+          command_list_recorders_[i - 1].command_list;
+    }
+  }
+  ID3D12CommandQueue* direct_queue = GetD3D12Provider().GetDirectQueue();
+  if (await_async_texture_loads) {
+    // The asynchronous loading fence is signaled with the submission number.
+    direct_queue->Wait(texture_cache_->GetAsyncLoadFence(), submission);
+  }
+  direct_queue->ExecuteCommandLists(execute_command_list_count,
+                                    execute_command_lists);
+  direct_queue->Signal(submission_fence_, submission);
+}
+
+void D3D12CommandProcessor::CommandListRecordingThread(size_t recorder_index) {
+  CommandListRecorder& recorder = command_list_recorders_[recorder_index];
+  // The first part is recorded by the thread executing the submission.
+  size_t part_index = recorder_index + 1;
+  ID3D12Device* device = GetD3D12Provider().GetDevice();
+  uint64_t generation_done = 0;
+  while (true) {
+    const DeferredCommandList* source;
+    uint64_t submission;
+    {
+      std::unique_lock<xe_mutex> lock(command_list_recording_lock_);
+      command_list_recording_request_cond_.wait(lock, [&]() {
+        return command_list_recording_shutdown_ ||
+               command_list_recording_generation_ != generation_done;
+      });
+      if (command_list_recording_shutdown_) {
+        return;
+      }
+      generation_done = command_list_recording_generation_;
+      // Not enough draws for this thread to record a part this time.
+      if (part_index >= command_list_recording_part_count_) {
+        continue;
+      }
+      source = command_list_recording_source_;
+      submission = command_list_recording_submission_;
+    }
+
+    // Reuse the oldest allocator if the GPU is done with it, or create a new
+    // one, or wait for the oldest if failed.
+    ID3D12CommandAllocator* command_allocator = nullptr;
+    std::pair<uint64_t, ID3D12CommandAllocator*>& oldest_command_allocator =
+        recorder.command_allocators.front();
+    if (oldest_command_allocator.first >
+            submission_fence_->GetCompletedValue() &&
+        FAILED(device->CreateCommandAllocator(
+            D3D12_COMMAND_LIST_TYPE_DIRECT,
+            IID_PPV_ARGS(&command_allocator)))) {
+      command_allocator = nullptr;
+      submission_fence_->SetEventOnCompletion(oldest_command_allocator.first,
+                                              nullptr);
+    }
+    if (!command_allocator) {
+      command_allocator = oldest_command_allocator.second;
+      recorder.command_allocators.pop_front();
+    }
+    recorder.command_allocators.emplace_back(submission, command_allocator);
+    command_allocator->Reset();
+    recorder.command_list->Reset(command_allocator, nullptr);
+    source->Execute(recorder.command_list, recorder.command_list_1,
+                    command_list_parts_[part_index]);
+    recorder.command_list->Close();
+
+    {
+      std::lock_guard<xe_mutex> lock(command_list_recording_lock_);
+      if (!--command_list_recording_pending_) {
+        command_list_recording_done_cond_.notify_all();
+      }
+    }
+  }
+}
+
+void D3D12CommandProcessor::QueueSubmission(
+    ID3D12CommandAllocator* command_allocator, uint64_t submission,
+    bool await_async_texture_loads) {
+  SCOPE_profile_cpu_f("gpu");
+  uint64_t written = submission_queue_written_.load(std::memory_order_relaxed);
+  while (written - submission_queue_read_.load(std::memory_order_acquire) >=
+         kSubmissionQueueSize) {
+    xe::threading::Wait(submission_queue_read_event_.get(), false);
+  }
+  QueuedSubmission& queued_submission =
+      submission_queue_[written % kSubmissionQueueSize];
+  // The list in the slot has been reset by the submission thread, and will be
+  // recorded into for the next submission.
+  queued_submission.deferred_command_list->Swap(deferred_command_list_);
+  queued_submission.command_allocator = command_allocator;
+  queued_submission.submission = submission;
+  queued_submission.await_async_texture_loads = await_async_texture_loads;
+  submission_queue_written_.store(written + 1, std::memory_order_release);
+  submission_queue_written_event_->Set();
+}
+
+void D3D12CommandProcessor::AwaitQueuedSubmissions() {
+  if (!submission_thread_) {
+    return;
+  }
+  uint64_t written = submission_queue_written_.load(std::memory_order_relaxed);
+  while (submission_queue_read_.load(std::memory_order_acquire) != written) {
+    xe::threading::Wait(submission_queue_read_event_.get(), false);
+  }
+}
+
+void D3D12CommandProcessor::SubmissionThread() {
+  uint64_t read = submission_queue_read_.load(std::memory_order_relaxed);
+  while (true) {
+    if (submission_queue_written_.load(std::memory_order_acquire) == read) {
+      if (!submission_thread_running_) {
+        break;
+      }
+      xe::threading::Wait(submission_queue_written_event_.get(), false);
+      continue;
+    }
+    QueuedSubmission& queued_submission =
+        submission_queue_[read % kSubmissionQueueSize];
+    ExecuteSubmission(*queued_submission.deferred_command_list,
+                      queued_submission.command_allocator,
+                      queued_submission.submission,
+                      queued_submission.await_async_texture_loads);
+    queued_submission.deferred_command_list->Reset();
+    submission_queue_read_.store(++read, std::memory_order_release);
+    submission_queue_read_event_->Set();
+  }
+}
+
 void D3D12CommandProcessor::UpdateFixedFunctionState(
     const draw_util::ViewportInfo& viewport_info,
     const draw_util::Scissor& scissor, bool primitive_polygonal,
-    reg::RB_DEPTHCONTROL normalized_depth_control) {
+    reg::RB_DEPTHCONTROL normalized_depth_control,
+    uint32_t dirty_state_groups) {
 #if XE_UI_D3D12_FINE_GRAINED_DRAW_SCOPES
   SCOPE_profile_cpu_f("gpu");
 #endif  // XE_UI_D3D12_FINE_GRAINED_DRAW_SCOPES
@@ -3555,37 +4162,46 @@ void D3D12CommandProcessor::UpdateFixedFunctionState(
     const RegisterFile& regs = *register_file_;
 
     // Blend factor.
-    float blend_factor[] = {
-        regs.Get<float>(XE_GPU_REG_RB_BLEND_RED),
-        regs.Get<float>(XE_GPU_REG_RB_BLEND_GREEN),
-        regs.Get<float>(XE_GPU_REG_RB_BLEND_BLUE),
-        regs.Get<float>(XE_GPU_REG_RB_BLEND_ALPHA),
-    };
-    // std::memcmp instead of != so in case of NaN, every draw won't be
-    // invalidating it.
-    ff_blend_factor_update_needed_ |=
-        std::memcmp(ff_blend_factor_, blend_factor, sizeof(float) * 4) != 0;
+    if (dirty_state_groups & RegisterFile::kStateGroupBlend) {
+      float blend_factor[] = {
+          regs.Get<float>(XE_GPU_REG_RB_BLEND_RED),
+          regs.Get<float>(XE_GPU_REG_RB_BLEND_GREEN),
+          regs.Get<float>(XE_GPU_REG_RB_BLEND_BLUE),
+          regs.Get<float>(XE_GPU_REG_RB_BLEND_ALPHA),
+      };
+      // std::memcmp instead of != so in case of NaN, every draw won't be
+      // invalidating it.
+      if (std::memcmp(ff_blend_factor_, blend_factor, sizeof(float) * 4)) {
+        std::memcpy(ff_blend_factor_, blend_factor, sizeof(float) * 4);
+        ff_blend_factor_update_needed_ = true;
+      }
+    }
     if (ff_blend_factor_update_needed_) {
-      std::memcpy(ff_blend_factor_, blend_factor, sizeof(float) * 4);
       deferred_command_list_.D3DOMSetBlendFactor(ff_blend_factor_);
       ff_blend_factor_update_needed_ = false;
     }
 
     // Stencil reference value. Per-face reference not supported by Direct3D 12,
-    // choose the back face one only if drawing only back faces.
-    Register stencil_ref_mask_reg;
-    auto pa_su_sc_mode_cntl = regs.Get<reg::PA_SU_SC_MODE_CNTL>();
-    if (primitive_polygonal && normalized_depth_control.backface_enable &&
-        pa_su_sc_mode_cntl.cull_front && !pa_su_sc_mode_cntl.cull_back) {
-      stencil_ref_mask_reg = XE_GPU_REG_RB_STENCILREFMASK_BF;
-    } else {
-      stencil_ref_mask_reg = XE_GPU_REG_RB_STENCILREFMASK;
+    // choose the back face one only if drawing only back faces. The face also
+    // depends on the primitive type, which is not a part of the register state
+    // groups.
+    if ((dirty_state_groups & RegisterFile::kStateGroupDepthStencil) ||
+        ff_stencil_ref_primitive_polygonal_ != primitive_polygonal) {
+      ff_stencil_ref_primitive_polygonal_ = primitive_polygonal;
+      Register stencil_ref_mask_reg;
+      auto pa_su_sc_mode_cntl = regs.Get<reg::PA_SU_SC_MODE_CNTL>();
+      if (primitive_polygonal && normalized_depth_control.backface_enable &&
+          pa_su_sc_mode_cntl.cull_front && !pa_su_sc_mode_cntl.cull_back) {
+        stencil_ref_mask_reg = XE_GPU_REG_RB_STENCILREFMASK_BF;
+      } else {
+        stencil_ref_mask_reg = XE_GPU_REG_RB_STENCILREFMASK;
+      }
+      uint32_t stencil_ref =
+          regs.Get<reg::RB_STENCILREFMASK>(stencil_ref_mask_reg).stencilref;
+      ff_stencil_ref_update_needed_ |= ff_stencil_ref_ != stencil_ref;
+      ff_stencil_ref_ = stencil_ref;
     }
-    uint32_t stencil_ref =
-        regs.Get<reg::RB_STENCILREFMASK>(stencil_ref_mask_reg).stencilref;
-    ff_stencil_ref_update_needed_ |= ff_stencil_ref_ != stencil_ref;
     if (ff_stencil_ref_update_needed_) {
-      ff_stencil_ref_ = stencil_ref;
       deferred_command_list_.D3DOMSetStencilRef(ff_stencil_ref_);
       ff_stencil_ref_update_needed_ = false;
     }
@@ -4216,6 +4832,53 @@ void D3D12CommandProcessor::UpdateSystemConstantValues(
   }
 }
 
+bool D3D12CommandProcessor::UploadFloatConstants(
+    const uint64_t* float_bitmap, uint32_t first_register, uint32_t count,
+    FloatConstantUpload& upload, D3D12_GPU_VIRTUAL_ADDRESS& address_out) {
+  const RegisterFile& regs = *register_file_;
+  alignas(16) float values[256 * 4];
+  float* values_current = values;
+  for (uint32_t i = 0; i < 4; ++i) {
+    uint64_t float_constant_map_entry = float_bitmap[i];
+    uint32_t float_constant_index;
+    while (xe::bit_scan_forward(float_constant_map_entry,
+                                &float_constant_index)) {
+      float_constant_map_entry = xe::clear_lowest_bit(float_constant_map_entry);
+      std::memcpy(
+          values_current,
+          &regs[first_register + (i << 8) + (float_constant_index << 2)],
+          4 * sizeof(float));
+      values_current += 4;
+    }
+  }
+  size_t values_size = sizeof(float) * 4 * count;
+  // std::memcmp instead of != so in case of NaN, the upload can still be
+  // reused.
+  if (upload.valid && upload.count == count &&
+      !std::memcmp(upload.values, values, values_size)) {
+    address_out = upload.address;
+    return true;
+  }
+  // Even if the shader doesn't need any float constants, a valid binding must
+  // still be provided, so if the first draw in the frame with the current
+  // root signature doesn't have float constants at all, still allocate an
+  // empty buffer.
+  uint8_t* float_constants = constant_buffer_pool_->Request(
+      frame_current_, std::max(values_size, sizeof(float) * 4),
+      D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT, nullptr, nullptr,
+      &address_out);
+  if (float_constants == nullptr) {
+    upload.valid = false;
+    return false;
+  }
+  std::memcpy(float_constants, values, values_size);
+  std::memcpy(upload.values, values, values_size);
+  upload.address = address_out;
+  upload.count = count;
+  upload.valid = true;
+  return true;
+}
+
 bool D3D12CommandProcessor::UpdateBindings(const D3D12Shader* vertex_shader,
                                            const D3D12Shader* pixel_shader,
                                            ID3D12RootSignature* root_signature,
@@ -4323,65 +4986,25 @@ bool D3D12CommandProcessor::UpdateBindings(const D3D12Shader* vertex_shader,
         ~(1u << root_parameter_system_constants);
   }
   if (!cbuffer_binding_float_vertex_.up_to_date) {
-    // Even if the shader doesn't need any float constants, a valid binding must
-    // still be provided, so if the first draw in the frame with the current
-    // root signature doesn't have float constants at all, still allocate an
-    // empty buffer.
-    uint8_t* float_constants = constant_buffer_pool_->Request(
-        frame_current_,
-        sizeof(float) * 4 * std::max(float_constant_count_vertex, uint32_t(1)),
-        D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT, nullptr, nullptr,
-        &cbuffer_binding_float_vertex_.address);
-    if (float_constants == nullptr) {
+    if (!UploadFloatConstants(float_constant_map_vertex.float_bitmap,
+                              XE_GPU_REG_SHADER_CONSTANT_000_X,
+                              float_constant_count_vertex,
+                              float_constant_upload_vertex_,
+                              cbuffer_binding_float_vertex_.address)) {
       return false;
     }
-    for (uint32_t i = 0; i < 4; ++i) {
-      uint64_t float_constant_map_entry =
-          float_constant_map_vertex.float_bitmap[i];
-      uint32_t float_constant_index;
-      while (xe::bit_scan_forward(float_constant_map_entry,
-                                  &float_constant_index)) {
-        float_constant_map_entry =
-            xe::clear_lowest_bit(float_constant_map_entry);
-        std::memcpy(float_constants,
-                    &regs[XE_GPU_REG_SHADER_CONSTANT_000_X + (i << 8) +
-                          (float_constant_index << 2)],
-                    4 * sizeof(float));
-        float_constants += 4 * sizeof(float);
-      }
-    }
     cbuffer_binding_float_vertex_.up_to_date = true;
     current_graphics_root_up_to_date_ &=
         ~(1u << root_parameter_float_constants_vertex);
   }
   if (!cbuffer_binding_float_pixel_.up_to_date) {
-    uint8_t* float_constants = constant_buffer_pool_->Request(
-        frame_current_,
-        sizeof(float) * 4 * std::max(float_constant_count_pixel, uint32_t(1)),
-        D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT, nullptr, nullptr,
-        &cbuffer_binding_float_pixel_.address);
-    if (float_constants == nullptr) {
+    if (!UploadFloatConstants(current_float_constant_map_pixel_,
+                              XE_GPU_REG_SHADER_CONSTANT_256_X,
+                              float_constant_count_pixel,
+                              float_constant_upload_pixel_,
+                              cbuffer_binding_float_pixel_.address)) {
       return false;
     }
-    if (pixel_shader != nullptr) {
-      const Shader::ConstantRegisterMap& float_constant_map_pixel =
-          pixel_shader->constant_register_map();
-      for (uint32_t i = 0; i < 4; ++i) {
-        uint64_t float_constant_map_entry =
-            float_constant_map_pixel.float_bitmap[i];
-        uint32_t float_constant_index;
-        while (xe::bit_scan_forward(float_constant_map_entry,
-                                    &float_constant_index)) {
-          float_constant_map_entry =
-              xe::clear_lowest_bit(float_constant_map_entry);
-          std::memcpy(float_constants,
-                      &regs[XE_GPU_REG_SHADER_CONSTANT_256_X + (i << 8) +
-                            (float_constant_index << 2)],
-                      4 * sizeof(float));
-          float_constants += 4 * sizeof(float);
-        }
-      }
-    }
     cbuffer_binding_float_pixel_.up_to_date = true;
     current_graphics_root_up_to_date_ &=
         ~(1u << root_parameter_float_constants_pixel);
@@ -4917,6 +5540,50 @@ bool D3D12CommandProcessor::UpdateBindings_BindfulPath(
   bool edram_rov_used = render_target_cache_->GetPath() ==
                         RenderTargetCache::Path::kPixelShaderInterlock;
 
+  // Reuse the tables with the same contents if they have already been written
+  // to the current heap pages. If a new page is needed for the remaining
+  // descriptors, everything will be written to it anyway.
+  if (write_textures_vertex &&
+      FindBindfulTextureTable(texture_layout_uid_vertex, textures_vertex.data(),
+                              texture_count_vertex,
+                              current_texture_srv_keys_vertex_,
+                              gpu_handle_textures_vertex_)) {
+    write_textures_vertex = false;
+    current_texture_layout_uid_vertex_ = texture_layout_uid_vertex;
+    bindful_textures_written_vertex_ = true;
+    current_graphics_root_up_to_date_ &=
+        ~(1u << current_graphics_root_bindful_extras_.textures_vertex);
+  }
+  if (write_textures_pixel &&
+      FindBindfulTextureTable(texture_layout_uid_pixel, textures_pixel->data(),
+                              texture_count_pixel,
+                              current_texture_srv_keys_pixel_,
+                              gpu_handle_textures_pixel_)) {
+    write_textures_pixel = false;
+    current_texture_layout_uid_pixel_ = texture_layout_uid_pixel;
+    bindful_textures_written_pixel_ = true;
+    current_graphics_root_up_to_date_ &=
+        ~(1u << current_graphics_root_bindful_extras_.textures_pixel);
+  }
+  if (write_samplers_vertex &&
+      FindBindfulSamplerTable(current_samplers_vertex_.data(),
+                              sampler_count_vertex,
+                              gpu_handle_samplers_vertex_)) {
+    write_samplers_vertex = false;
+    bindful_samplers_written_vertex_ = true;
+    current_graphics_root_up_to_date_ &=
+        ~(1u << current_graphics_root_bindful_extras_.samplers_vertex);
+  }
+  if (write_samplers_pixel &&
+      FindBindfulSamplerTable(current_samplers_pixel_.data(),
+                              sampler_count_pixel,
+                              gpu_handle_samplers_pixel_)) {
+    write_samplers_pixel = false;
+    bindful_samplers_written_pixel_ = true;
+    current_graphics_root_up_to_date_ &=
+        ~(1u << current_graphics_root_bindful_extras_.samplers_pixel);
+  }
+
   // Allocate the descriptors.
   size_t view_count_partial_update = 0;
   if (write_textures_vertex) {
@@ -5030,6 +5697,9 @@ bool D3D12CommandProcessor::UpdateBindings_BindfulPath(
     texture_cache_->WriteActiveTextureSRVKeys(
         current_texture_srv_keys_vertex_.data(), textures_vertex.data(),
         texture_count_vertex);
+    AddBindfulTextureTable(view_heap_index, texture_layout_uid_vertex,
+                           current_texture_srv_keys_vertex_.data(),
+                           texture_count_vertex, gpu_handle_textures_vertex_);
     bindful_textures_written_vertex_ = true;
     current_graphics_root_up_to_date_ &=
         ~(1u << current_graphics_root_bindful_extras_.textures_vertex);
@@ -5050,6 +5720,9 @@ bool D3D12CommandProcessor::UpdateBindings_BindfulPath(
     texture_cache_->WriteActiveTextureSRVKeys(
         current_texture_srv_keys_pixel_.data(), textures_pixel->data(),
         texture_count_pixel);
+    AddBindfulTextureTable(view_heap_index, texture_layout_uid_pixel,
+                           current_texture_srv_keys_pixel_.data(),
+                           texture_count_pixel, gpu_handle_textures_pixel_);
     bindful_textures_written_pixel_ = true;
     current_graphics_root_up_to_date_ &=
         ~(1u << current_graphics_root_bindful_extras_.textures_pixel);
@@ -5065,6 +5738,8 @@ bool D3D12CommandProcessor::UpdateBindings_BindfulPath(
       sampler_gpu_handle.ptr += descriptor_size_sampler;
     }
     // Current samplers have already been updated.
+    AddBindfulSamplerTable(sampler_heap_index, current_samplers_vertex_.data(),
+                           sampler_count_vertex, gpu_handle_samplers_vertex_);
     bindful_samplers_written_vertex_ = true;
     current_graphics_root_up_to_date_ &=
         ~(1u << current_graphics_root_bindful_extras_.samplers_vertex);
@@ -5080,6 +5755,8 @@ bool D3D12CommandProcessor::UpdateBindings_BindfulPath(
       sampler_gpu_handle.ptr += descriptor_size_sampler;
     }
     // Current samplers have already been updated.
+    AddBindfulSamplerTable(sampler_heap_index, current_samplers_pixel_.data(),
+                           sampler_count_pixel, gpu_handle_samplers_pixel_);
     bindful_samplers_written_pixel_ = true;
     current_graphics_root_up_to_date_ &=
         ~(1u << current_graphics_root_bindful_extras_.samplers_pixel);
@@ -5095,6 +5772,121 @@ bool D3D12CommandProcessor::UpdateBindings_BindfulPath(
   return {};
 }
 
+static uint64_t HashBindfulTextureTable(
+    size_t layout_uid, const D3D12TextureCache::TextureSRVKey* srv_keys,
+    size_t binding_count) {
+  XXH3_state_t hash_state;
+  XXH3_64bits_reset(&hash_state);
+  XXH3_64bits_update(&hash_state, &layout_uid, sizeof(layout_uid));
+  for (size_t i = 0; i < binding_count; ++i) {
+    // Not hashing the whole TextureSRVKey because of its padding.
+    const D3D12TextureCache::TextureSRVKey& srv_key = srv_keys[i];
+    XXH3_64bits_update(&hash_state, &srv_key.key, sizeof(srv_key.key));
+    uint32_t swizzle_and_signs =
+        srv_key.host_swizzle ^ (uint32_t(srv_key.swizzled_signs) << 24);
+    XXH3_64bits_update(&hash_state, &swizzle_and_signs,
+                       sizeof(swizzle_and_signs));
+  }
+  return XXH3_64bits_digest(&hash_state);
+}
+
+bool D3D12CommandProcessor::FindBindfulTextureTable(
+    size_t layout_uid, const D3D12Shader::TextureBinding* bindings,
+    size_t binding_count,
+    std::vector<D3D12TextureCache::TextureSRVKey>& srv_keys_out,
+    D3D12_GPU_DESCRIPTOR_HANDLE& gpu_handle_out) {
+  if (draw_view_bindful_heap_index_ ==
+          ui::d3d12::D3D12DescriptorHeapPool::kHeapIndexInvalid ||
+      bindful_texture_tables_heap_index_ != draw_view_bindful_heap_index_) {
+    return false;
+  }
+  srv_keys_out.resize(std::max(srv_keys_out.size(), binding_count));
+  texture_cache_->WriteActiveTextureSRVKeys(srv_keys_out.data(), bindings,
+                                            binding_count);
+  auto bucket = bindful_texture_tables_.equal_range(
+      HashBindfulTextureTable(layout_uid, srv_keys_out.data(), binding_count));
+  for (auto it = bucket.first; it != bucket.second; ++it) {
+    const BindfulTextureTable& table = it->second;
+    if (table.layout_uid != layout_uid ||
+        table.srv_keys.size() != binding_count) {
+      continue;
+    }
+    size_t i = 0;
+    for (; i < binding_count; ++i) {
+      const D3D12TextureCache::TextureSRVKey& table_srv_key =
+          table.srv_keys[i];
+      const D3D12TextureCache::TextureSRVKey& srv_key = srv_keys_out[i];
+      if (table_srv_key.key != srv_key.key ||
+          table_srv_key.host_swizzle != srv_key.host_swizzle ||
+          table_srv_key.swizzled_signs != srv_key.swizzled_signs) {
+        break;
+      }
+    }
+    if (i >= binding_count) {
+      gpu_handle_out = table.gpu_handle;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool D3D12CommandProcessor::FindBindfulSamplerTable(
+    const D3D12TextureCache::SamplerParameters* parameters,
+    size_t sampler_count, D3D12_GPU_DESCRIPTOR_HANDLE& gpu_handle_out) {
+  if (draw_sampler_bindful_heap_index_ ==
+          ui::d3d12::D3D12DescriptorHeapPool::kHeapIndexInvalid ||
+      bindful_sampler_tables_heap_index_ != draw_sampler_bindful_heap_index_) {
+    return false;
+  }
+  auto bucket = bindful_sampler_tables_.equal_range(XXH3_64bits(
+      parameters, sizeof(*parameters) * sampler_count));
+  for (auto it = bucket.first; it != bucket.second; ++it) {
+    const BindfulSamplerTable& table = it->second;
+    if (table.parameters.size() == sampler_count &&
+        std::equal(table.parameters.cbegin(), table.parameters.cend(),
+                   parameters)) {
+      gpu_handle_out = table.gpu_handle;
+      return true;
+    }
+  }
+  return false;
+}
+
+void D3D12CommandProcessor::AddBindfulTextureTable(
+    uint64_t heap_index, size_t layout_uid,
+    const D3D12TextureCache::TextureSRVKey* srv_keys, size_t binding_count,
+    D3D12_GPU_DESCRIPTOR_HANDLE gpu_handle) {
+  if (bindful_texture_tables_heap_index_ != heap_index) {
+    bindful_texture_tables_.clear();
+    bindful_texture_tables_heap_index_ = heap_index;
+  }
+  BindfulTextureTable& table =
+      bindful_texture_tables_
+          .emplace(HashBindfulTextureTable(layout_uid, srv_keys, binding_count),
+                   BindfulTextureTable())
+          ->second;
+  table.layout_uid = layout_uid;
+  table.srv_keys.assign(srv_keys, srv_keys + binding_count);
+  table.gpu_handle = gpu_handle;
+}
+
+void D3D12CommandProcessor::AddBindfulSamplerTable(
+    uint64_t heap_index,
+    const D3D12TextureCache::SamplerParameters* parameters,
+    size_t sampler_count, D3D12_GPU_DESCRIPTOR_HANDLE gpu_handle) {
+  if (bindful_sampler_tables_heap_index_ != heap_index) {
+    bindful_sampler_tables_.clear();
+    bindful_sampler_tables_heap_index_ = heap_index;
+  }
+  BindfulSamplerTable& table =
+      bindful_sampler_tables_
+          .emplace(XXH3_64bits(parameters, sizeof(*parameters) * sampler_count),
+                   BindfulSamplerTable())
+          ->second;
+  table.parameters.assign(parameters, parameters + sampler_count);
+  table.gpu_handle = gpu_handle;
+}
+
 ID3D12Resource* D3D12CommandProcessor::RequestReadbackBuffer(uint32_t size) {
   if (size == 0) {
     return nullptr;
@@ -5123,6 +5915,545 @@ ID3D12Resource* D3D12CommandProcessor::RequestReadbackBuffer(uint32_t size) {
   return readback_buffer_;
 }
 
+bool D3D12CommandProcessor::RequestAsyncReadback(
+    const std::pair<uint32_t, uint32_t>* ranges, size_t range_count,
+    bool lazy) {
+  uint32_t total_size = 0;
+  for (size_t i = 0; i < range_count; ++i) {
+    total_size += ranges[i].second;
+  }
+  if (!total_size) {
+    return true;
+  }
+
+  // Limit the number of buffers in flight.
+  if (lazy) {
+    CompleteAsyncReadbacks(false);
+    if (async_readbacks_lazy_.size() >= kMaxAsyncReadbacks) {
+      CompleteLazyAsyncReadbacks(kMaxAsyncReadbacks - 1);
+    }
+  } else if (async_readbacks_.size() >= kMaxAsyncReadbacks) {
+    CheckSubmissionFence(async_readbacks_.front().submission);
+    CompleteAsyncReadbacks(false);
+  }
+
+  AsyncReadbackBuffer buffer;
+  auto free_buffer_it = std::find_if(
+      async_readback_buffers_free_.begin(), async_readback_buffers_free_.end(),
+      [total_size](const AsyncReadbackBuffer& free_buffer) {
+        return free_buffer.size >= total_size;
+      });
+  if (free_buffer_it != async_readback_buffers_free_.end()) {
+    buffer = *free_buffer_it;
+    *free_buffer_it = async_readback_buffers_free_.back();
+    async_readback_buffers_free_.pop_back();
+  } else {
+    buffer.size = xe::align(total_size, kAsyncReadbackBufferSizeIncrement);
+    const ui::d3d12::D3D12Provider& provider = GetD3D12Provider();
+    ID3D12Device* device = provider.GetDevice();
+    D3D12_RESOURCE_DESC buffer_desc;
+    ui::d3d12::util::FillBufferResourceDesc(buffer_desc, buffer.size,
+                                            D3D12_RESOURCE_FLAG_NONE);
+    if (FAILED(device->CreateCommittedResource(
+            &ui::d3d12::util::kHeapPropertiesReadback,
+            provider.GetHeapFlagCreateNotZeroed(), &buffer_desc,
+            D3D12_RESOURCE_STATE_COPY_DEST, nullptr,
+            IID_PPV_ARGS(&buffer.buffer)))) {
+      XELOGE("Failed to create a {} MB asynchronous readback buffer",
+             buffer.size >> 20);
+      return false;
+    }
+    // Readback buffers may stay mapped while the GPU is writing to them.
+    void* mapping;
+    if (FAILED(buffer.buffer->Map(0, nullptr, &mapping))) {
+      XELOGE("Failed to map a {} MB asynchronous readback buffer",
+             buffer.size >> 20);
+      buffer.buffer->Release();
+      return false;
+    }
+    buffer.mapping = reinterpret_cast<const uint8_t*>(mapping);
+  }
+
+  if (!async_readback_invalidation_callback_handle_) {
+    async_readback_invalidation_callback_handle_ =
+        memory_->RegisterPhysicalMemoryInvalidationCallback(
+            AsyncReadbackInvalidationCallbackThunk, this);
+  }
+  if (lazy && !async_readback_data_provider_handle_) {
+    async_readback_data_provider_handle_ =
+        memory_->RegisterPhysicalMemoryDataProvider(
+            AsyncReadbackDataProviderThunk, this);
+  }
+
+  shared_memory_->UseAsCopySource();
+  SubmitBarriers();
+  ID3D12Resource* shared_memory_buffer = shared_memory_->GetBuffer();
+  std::vector<AsyncReadbackRange> readback_ranges;
+  readback_ranges.reserve(range_count + kAsyncReadbackMaxExtraRanges);
+  uint32_t buffer_offset = 0;
+  for (size_t i = 0; i < range_count; ++i) {
+    uint32_t range_length = ranges[i].second;
+    if (!range_length) {
+      continue;
+    }
+    deferred_command_list_.D3DCopyBufferRegion(buffer.buffer, buffer_offset,
+                                               shared_memory_buffer,
+                                               ranges[i].first, range_length);
+    AsyncReadbackRange& readback_range = readback_ranges.emplace_back();
+    readback_range.physical_address = ranges[i].first;
+    readback_range.length = range_length;
+    readback_range.buffer_offset = buffer_offset;
+    buffer_offset += range_length;
+  }
+  {
+    auto global_lock = global_critical_region_.Acquire();
+    AsyncReadback& readback =
+        (lazy ? async_readbacks_lazy_ : async_readbacks_).emplace_back();
+    readback.buffer = buffer;
+    readback.submission = submission_current_;
+    readback.ranges = std::move(readback_ranges);
+  }
+  // Let guest CPU writes to the ranges, which logically happen after the GPU
+  // writes, take precedence over the data being read back. For lazy readbacks,
+  // also provide the data when the guest CPU accesses the ranges.
+  for (size_t i = 0; i < range_count; ++i) {
+    if (ranges[i].second) {
+      memory_->EnablePhysicalMemoryAccessCallbacks(
+          ranges[i].first, ranges[i].second, true, lazy,
+          async_readback_invalidation_callback_handle_);
+    }
+  }
+
+  // Start the copying right away so it's likely completed by the time the
+  // data is needed.
+  EndSubmission(false);
+  return true;
+}
+
+void D3D12CommandProcessor::CompleteAsyncReadbacks(bool await_all) {
+  while (!async_readbacks_.empty()) {
+    // The front may be completed in CheckSubmissionFence, don't hold
+    // references across it.
+    uint64_t readback_submission = async_readbacks_.front().submission;
+    if (readback_submission > submission_completed_) {
+      if (!await_all) {
+        break;
+      }
+      CheckSubmissionFence(readback_submission);
+      if (async_readbacks_.empty() ||
+          async_readbacks_.front().submission != readback_submission) {
+        continue;
+      }
+    }
+    AsyncReadbackBuffer buffer;
+    {
+      auto global_lock = global_critical_region_.Acquire();
+      AsyncReadback& readback = async_readbacks_.front();
+      if (readback_submission <= submission_completed_) {
+        WriteAsyncReadbackRanges(readback);
+      } else {
+        XELOGE(
+            "Failed to await the completion of an asynchronous readback in "
+            "submission {}",
+            readback_submission);
+      }
+      buffer = readback.buffer;
+      async_readbacks_.pop_front();
+    }
+    async_readback_buffers_free_.push_back(buffer);
+  }
+
+  // Reclaim the buffers of lazy readbacks with all the data already provided
+  // or overwritten by the guest CPU.
+  if (!async_readbacks_lazy_.empty()) {
+    auto global_lock = global_critical_region_.Acquire();
+    for (auto it = async_readbacks_lazy_.begin();
+         it != async_readbacks_lazy_.end();) {
+      if (it->ranges.empty() && it->submission <= submission_completed_) {
+        async_readback_buffers_free_.push_back(it->buffer);
+        it = async_readbacks_lazy_.erase(it);
+      } else {
+        ++it;
+      }
+    }
+  }
+}
+
+void D3D12CommandProcessor::CompleteLazyAsyncReadbacks(size_t max_remaining) {
+  while (async_readbacks_lazy_.size() > max_remaining) {
+    uint64_t readback_submission = async_readbacks_lazy_.front().submission;
+    if (readback_submission > submission_completed_) {
+      CheckSubmissionFence(readback_submission);
+    }
+    AsyncReadbackBuffer buffer;
+    {
+      auto global_lock = global_critical_region_.Acquire();
+      AsyncReadback& readback = async_readbacks_lazy_.front();
+      if (readback_submission <= submission_completed_) {
+        // The pages stay protected for the data provider, but it will ignore
+        // them as the readback won't be pending anymore.
+        WriteAsyncReadbackRanges(readback);
+      } else {
+        XELOGE(
+            "Failed to await the completion of an asynchronous readback in "
+            "submission {}",
+            readback_submission);
+      }
+      buffer = readback.buffer;
+      async_readbacks_lazy_.pop_front();
+    }
+    async_readback_buffers_free_.push_back(buffer);
+  }
+}
+
+void D3D12CommandProcessor::WriteAsyncReadbackRanges(
+    const AsyncReadback& readback) {
+  // Called in the global critical region.
+  // The writes may trigger the invalidation callbacks for the pages still
+  // pending in this readback.
+  async_readbacks_completing_ = true;
+  for (const AsyncReadbackRange& range : readback.ranges) {
+    uint8_t* range_guest = memory_->TranslatePhysical(range.physical_address);
+    const uint8_t* range_host = readback.buffer.mapping + range.buffer_offset;
+    // vastcpy copies whole cache lines.
+    if (!((range.physical_address | range.buffer_offset | range.length) &
+          (XE_HOST_CACHE_LINE_SIZE - 1))) {
+      memory::vastcpy(range_guest, const_cast<uint8_t*>(range_host),
+                      range.length);
+    } else {
+      std::memcpy(range_guest, range_host, range.length);
+    }
+  }
+  async_readbacks_completing_ = false;
+}
+
+std::pair<uint32_t, uint32_t>
+D3D12CommandProcessor::AsyncReadbackInvalidationCallbackThunk(
+    void* context_ptr, uint32_t physical_address_start, uint32_t length,
+    bool exact_range) {
+  return reinterpret_cast<D3D12CommandProcessor*>(context_ptr)
+      ->AsyncReadbackInvalidationCallback(physical_address_start, length,
+                                          exact_range);
+}
+
+std::pair<uint32_t, uint32_t>
+D3D12CommandProcessor::AsyncReadbackInvalidationCallback(
+    uint32_t physical_address_start, uint32_t length, bool exact_range) {
+  // Called in the global critical region.
+  if (async_readbacks_completing_ || !length) {
+    return std::make_pair(uint32_t(0), UINT32_MAX);
+  }
+  uint32_t physical_address_end = physical_address_start + length;
+  for (std::deque<AsyncReadback>* readbacks :
+       {&async_readbacks_, &async_readbacks_lazy_}) {
+    for (AsyncReadback& readback : *readbacks) {
+      std::vector<AsyncReadbackRange>& ranges = readback.ranges;
+      for (size_t i = 0; i < ranges.size();) {
+        AsyncReadbackRange& range = ranges[i];
+        uint32_t range_end = range.physical_address + range.length;
+        if (range.physical_address >= physical_address_end ||
+            range_end <= physical_address_start) {
+          ++i;
+          continue;
+        }
+        bool keep_head = range.physical_address < physical_address_start;
+        bool keep_tail = range_end > physical_address_end;
+        // Allocating is not allowed here - if there's no space for splitting
+        // the range, drop the tail instead.
+        if (keep_head && keep_tail && ranges.size() < ranges.capacity()) {
+          AsyncReadbackRange tail;
+          tail.physical_address = physical_address_end;
+          tail.length = range_end - physical_address_end;
+          tail.buffer_offset =
+              range.buffer_offset +
+              (physical_address_end - range.physical_address);
+          range.length = physical_address_start - range.physical_address;
+          ranges.push_back(tail);
+          ++i;
+        } else if (keep_head) {
+          range.length = physical_address_start - range.physical_address;
+          ++i;
+        } else if (keep_tail) {
+          range.buffer_offset += physical_address_end - range.physical_address;
+          range.length = range_end - physical_address_end;
+          range.physical_address = physical_address_end;
+          ++i;
+        } else {
+          range = ranges.back();
+          ranges.pop_back();
+        }
+      }
+    }
+  }
+  return std::make_pair(uint32_t(0), UINT32_MAX);
+}
+
+void D3D12CommandProcessor::AsyncReadbackDataProviderThunk(
+    void* context_ptr, uint32_t physical_address_start, uint32_t length) {
+  reinterpret_cast<D3D12CommandProcessor*>(context_ptr)
+      ->AsyncReadbackDataProvider(physical_address_start, length);
+}
+
+void D3D12CommandProcessor::AsyncReadbackDataProvider(
+    uint32_t physical_address_start, uint32_t length) {
+  // Called in the global critical region, from any thread accessing the guest
+  // memory, thus not touching the submission state owned by the command
+  // processor thread - only awaiting the fence, which is signaled by the queue
+  // without anything else needing the global critical region, as lazy
+  // readbacks are submitted immediately when requested.
+  if (!length) {
+    return;
+  }
+  uint32_t physical_address_end = physical_address_start + length;
+  for (AsyncReadback& readback : async_readbacks_lazy_) {
+    std::vector<AsyncReadbackRange>& ranges = readback.ranges;
+    bool readback_awaited = false;
+    for (size_t i = 0; i < ranges.size();) {
+      const AsyncReadbackRange& range = ranges[i];
+      if (range.physical_address >= physical_address_end ||
+          range.physical_address + range.length <= physical_address_start) {
+        ++i;
+        continue;
+      }
+      if (!readback_awaited) {
+        if (submission_fence_->GetCompletedValue() < readback.submission &&
+            (FAILED(submission_fence_->SetEventOnCompletion(
+                 readback.submission, nullptr)) ||
+             submission_fence_->GetCompletedValue() < readback.submission)) {
+          XELOGE(
+              "Failed to await the completion of a lazy asynchronous readback "
+              "in submission {}",
+              readback.submission);
+          break;
+        }
+        readback_awaited = true;
+      }
+      // Providing whole ranges rather than only the accessed pages so the
+      // ranges don't need to be split, which would require allocation. Those
+      // extra pages will just be ignored when accessed.
+      uint8_t* range_guest = memory_->TranslatePhysical(range.physical_address);
+      const uint8_t* range_host = readback.buffer.mapping + range.buffer_offset;
+      std::memcpy(range_guest, range_host, range.length);
+      ranges[i] = ranges.back();
+      ranges.pop_back();
+    }
+  }
+}
+
+bool D3D12CommandProcessor::InitializeOcclusionQueries() {
+  if (occlusion_queries_initialization_failed_) {
+    return false;
+  }
+  const ui::d3d12::D3D12Provider& provider = GetD3D12Provider();
+  ID3D12Device* device = provider.GetDevice();
+  D3D12_QUERY_HEAP_DESC query_heap_desc;
+  query_heap_desc.Type = D3D12_QUERY_HEAP_TYPE_OCCLUSION;
+  query_heap_desc.Count = kOcclusionQuerySlotCount;
+  query_heap_desc.NodeMask = 0;
+  if (FAILED(device->CreateQueryHeap(&query_heap_desc,
+                                     IID_PPV_ARGS(&occlusion_query_heap_)))) {
+    XELOGE("Failed to create the occlusion query heap");
+    occlusion_queries_initialization_failed_ = true;
+    ShutdownOcclusionQueries();
+    return false;
+  }
+  D3D12_RESOURCE_DESC buffer_desc;
+  ui::d3d12::util::FillBufferResourceDesc(
+      buffer_desc, sizeof(uint64_t) * kOcclusionQuerySlotCount,
+      D3D12_RESOURCE_FLAG_NONE);
+  if (FAILED(device->CreateCommittedResource(
+          &ui::d3d12::util::kHeapPropertiesReadback,
+          provider.GetHeapFlagCreateNotZeroed(), &buffer_desc,
+          D3D12_RESOURCE_STATE_COPY_DEST, nullptr,
+          IID_PPV_ARGS(&occlusion_query_readback_buffer_)))) {
+    XELOGE("Failed to create the occlusion query readback buffer");
+    occlusion_queries_initialization_failed_ = true;
+    ShutdownOcclusionQueries();
+    return false;
+  }
+  // Readback buffers may stay mapped while the GPU is writing to them.
+  void* mapping;
+  if (FAILED(occlusion_query_readback_buffer_->Map(0, nullptr, &mapping))) {
+    XELOGE("Failed to map the occlusion query readback buffer");
+    occlusion_queries_initialization_failed_ = true;
+    ShutdownOcclusionQueries();
+    return false;
+  }
+  occlusion_query_readback_mapping_ =
+      reinterpret_cast<const uint64_t*>(mapping);
+  return true;
+}
+
+void D3D12CommandProcessor::ShutdownOcclusionQueries() {
+  occlusion_queries_.clear();
+  occlusion_query_active_ = false;
+  occlusion_query_segment_open_ = false;
+  occlusion_query_slot_next_ = 0;
+  occlusion_query_slots_used_ = 0;
+  occlusion_query_readback_mapping_ = nullptr;
+  ui::d3d12::util::ReleaseAndNull(occlusion_query_readback_buffer_);
+  ui::d3d12::util::ReleaseAndNull(occlusion_query_heap_);
+}
+
+void D3D12CommandProcessor::BeginOcclusionQuerySegment() {
+  assert_true(occlusion_query_active_);
+  assert_true(submission_open_);
+  if (occlusion_query_segment_open_) {
+    return;
+  }
+  OcclusionQuery& query = occlusion_queries_.back();
+  if (occlusion_query_slots_used_ >= kOcclusionQuerySlotCount) {
+    // Can't await the oldest queries here as that would end the submission in
+    // the middle of a draw.
+    query.segments_dropped = true;
+    return;
+  }
+  deferred_command_list_.D3DBeginQuery(occlusion_query_heap_,
+                                       D3D12_QUERY_TYPE_OCCLUSION,
+                                       occlusion_query_slot_next_);
+  occlusion_query_slot_next_ =
+      (occlusion_query_slot_next_ + 1) % kOcclusionQuerySlotCount;
+  ++occlusion_query_slots_used_;
+  ++query.slot_count;
+  occlusion_query_segment_open_ = true;
+}
+
+void D3D12CommandProcessor::EndOcclusionQuerySegment() {
+  if (!occlusion_query_segment_open_) {
+    return;
+  }
+  assert_true(submission_open_);
+  uint32_t slot = (occlusion_query_slot_next_ + kOcclusionQuerySlotCount - 1) %
+                  kOcclusionQuerySlotCount;
+  deferred_command_list_.D3DEndQuery(occlusion_query_heap_,
+                                     D3D12_QUERY_TYPE_OCCLUSION, slot);
+  deferred_command_list_.D3DResolveQueryData(
+      occlusion_query_heap_, D3D12_QUERY_TYPE_OCCLUSION, slot, 1,
+      occlusion_query_readback_buffer_, sizeof(uint64_t) * slot);
+  occlusion_queries_.back().submission = submission_current_;
+  occlusion_query_segment_open_ = false;
+}
+
+void D3D12CommandProcessor::CompleteOcclusionQueries(bool await_all) {
+  while (occlusion_queries_.size() > size_t(occlusion_query_active_)) {
+    uint64_t query_submission = occlusion_queries_.front().submission;
+    if (query_submission > submission_completed_) {
+      if (!await_all) {
+        break;
+      }
+      // May end the submission, but doesn't add or remove queries.
+      CheckSubmissionFence(query_submission);
+    }
+    const OcclusionQuery& query = occlusion_queries_.front();
+    bool completed = query_submission <= submission_completed_;
+    if (!completed) {
+      XELOGE(
+          "Failed to await the completion of an occlusion query in submission "
+          "{}",
+          query_submission);
+    }
+    if (query.sample_count_address != UINT32_MAX) {
+      uint64_t sample_count = 0;
+      if (completed) {
+        for (uint32_t i = 0; i < query.slot_count; ++i) {
+          sample_count += occlusion_query_readback_mapping_
+              [(query.slot_first + i) % kOcclusionQuerySlotCount];
+        }
+        // Count the samples at the guest resolution.
+        sample_count /= texture_cache_->draw_resolution_scale_x() *
+                        texture_cache_->draw_resolution_scale_y();
+      }
+      if (!completed || query.segments_dropped) {
+        // Some samples were not counted - don't let the guest cull the object
+        // because of that.
+        sample_count = std::max(
+            sample_count,
+            uint64_t(std::max(cvars::query_occlusion_fake_sample_count, 1)));
+      }
+      uint32_t sample_count_32 =
+          uint32_t(std::min(sample_count, uint64_t(UINT32_MAX)));
+      auto& sample_counts =
+          *memory_->TranslatePhysical<xe_gpu_depth_sample_counts*>(
+              query.sample_count_address);
+      sample_counts.Total_A = sample_count_32;
+      sample_counts.Total_B = 0;
+      sample_counts.StencilFail_A = 0;
+      sample_counts.StencilFail_B = 0;
+      // The guest polls the pairs of the ZPass and the ZFail counts for the
+      // completion of the query, replace each pair (in which both counts
+      // contain the marker) with a single store so the guest doesn't see a
+      // partially written result.
+      std::atomic_thread_fence(std::memory_order_release);
+      uint64_t z_fail = 0;
+      std::memcpy(&sample_counts.ZFail_A, &z_fail, sizeof(z_fail));
+      uint64_t z_pass = sample_count_32;
+      std::memcpy(&sample_counts.ZPass_A, &z_pass, sizeof(z_pass));
+    }
+    occlusion_query_slots_used_ -= query.slot_count;
+    occlusion_queries_.pop_front();
+  }
+}
+
+bool D3D12CommandProcessor::InitializeGpuTimestamps() {
+  const ui::d3d12::D3D12Provider& provider = GetD3D12Provider();
+  ID3D12Device* device = provider.GetDevice();
+  UINT64 timestamp_frequency;
+  if (FAILED(provider.GetDirectQueue()->GetTimestampFrequency(
+          &timestamp_frequency)) ||
+      !timestamp_frequency) {
+    XELOGW("Failed to get the GPU timestamp frequency, not profiling");
+    return false;
+  }
+  gpu_timestamp_profiler_.SetTicksPerSecond(double(timestamp_frequency));
+  D3D12_QUERY_HEAP_DESC query_heap_desc;
+  query_heap_desc.Type = D3D12_QUERY_HEAP_TYPE_TIMESTAMP;
+  query_heap_desc.Count = GpuTimestampProfiler::kTimestampCount;
+  query_heap_desc.NodeMask = 0;
+  if (FAILED(device->CreateQueryHeap(
+          &query_heap_desc, IID_PPV_ARGS(&gpu_timestamp_query_heap_)))) {
+    XELOGW("Failed to create the GPU timestamp query heap, not profiling");
+    ShutdownGpuTimestamps();
+    return false;
+  }
+  D3D12_RESOURCE_DESC buffer_desc;
+  ui::d3d12::util::FillBufferResourceDesc(
+      buffer_desc, sizeof(uint64_t) * GpuTimestampProfiler::kTimestampCount,
+      D3D12_RESOURCE_FLAG_NONE);
+  void* mapping;
+  if (FAILED(device->CreateCommittedResource(
+          &ui::d3d12::util::kHeapPropertiesReadback,
+          provider.GetHeapFlagCreateNotZeroed(), &buffer_desc,
+          D3D12_RESOURCE_STATE_COPY_DEST, nullptr,
+          IID_PPV_ARGS(&gpu_timestamp_readback_buffer_))) ||
+      FAILED(gpu_timestamp_readback_buffer_->Map(0, nullptr, &mapping))) {
+    XELOGW("Failed to create the GPU timestamp readback buffer, not profiling");
+    ShutdownGpuTimestamps();
+    return false;
+  }
+  gpu_timestamp_readback_mapping_ = reinterpret_cast<const uint64_t*>(mapping);
+  return true;
+}
+
+void D3D12CommandProcessor::ShutdownGpuTimestamps() {
+  gpu_timestamp_readback_mapping_ = nullptr;
+  ui::d3d12::util::ReleaseAndNull(gpu_timestamp_readback_buffer_);
+  ui::d3d12::util::ReleaseAndNull(gpu_timestamp_query_heap_);
+}
+
+void D3D12CommandProcessor::CompleteGpuTimestamps() {
+  if (!gpu_timestamp_query_heap_) {
+    return;
+  }
+  // UINT64_MAX if there are no pending submissions.
+  for (uint64_t submission = gpu_timestamp_profiler_.GetNextPendingSubmission();
+       submission <= submission_completed_;
+       submission = gpu_timestamp_profiler_.GetNextPendingSubmission()) {
+    gpu_timestamp_profiler_.AccumulateSubmission(
+        gpu_timestamp_readback_mapping_ +
+        GpuTimestampProfiler::GetSubmissionFirstTimestamp(submission));
+  }
+}
+
 void D3D12CommandProcessor::WriteGammaRampSRV(
     bool is_pwl, D3D12_CPU_DESCRIPTOR_HANDLE handle) const {
   ID3D12Device* device = GetD3D12Provider().GetDevice();
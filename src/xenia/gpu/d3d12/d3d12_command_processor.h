@@ -11,9 +11,12 @@
 #define XENIA_GPU_D3D12_D3D12_COMMAND_PROCESSOR_H_
 
 #include <algorithm>
+#include <array>
 #include <atomic>
+#include <condition_variable>
 #include <deque>
 #include <memory>
+#include <mutex>
 #include <optional>
 #include <string>
 #include <unordered_map>
@@ -21,6 +24,8 @@
 #include <vector>
 
 #include "xenia/base/assert.h"
+#include "xenia/base/mutex.h"
+#include "xenia/base/threading.h"
 #include "xenia/gpu/command_processor.h"
 #include "xenia/gpu/d3d12/d3d12_graphics_system.h"
 #include "xenia/gpu/d3d12/d3d12_primitive_processor.h"
@@ -32,6 +37,7 @@
 #include "xenia/gpu/draw_util.h"
 #include "xenia/gpu/dxbc_shader.h"
 #include "xenia/gpu/dxbc_shader_translator.h"
+#include "xenia/gpu/gpu_timestamp_profiler.h"
 #include "xenia/gpu/registers.h"
 #include "xenia/gpu/xenos.h"
 #include "xenia/kernel/kernel_state.h"
@@ -75,6 +81,14 @@ class D3D12CommandProcessor final : public CommandProcessor {
   void TracePlaybackWroteMemory(uint32_t base_ptr, uint32_t length) override;
 
   void RestoreEdramSnapshot(const void* snapshot) override;
+  bool SaveEdramSnapshot(void* snapshot) override;
+  bool AwaitHostGpuCompletion() override {
+    return AwaitAllQueueOperationsCompletion();
+  }
+  DrawExtentEstimator::Statistics GetDrawExtentEstimatorStatistics()
+      const override {
+    return render_target_cache_->draw_extent_estimator().statistics();
+  }
 
   ui::d3d12::D3D12Provider& GetD3D12Provider() const {
     return *static_cast<ui::d3d12::D3D12Provider*>(
@@ -91,17 +105,35 @@ class D3D12CommandProcessor final : public CommandProcessor {
   uint64_t GetCurrentSubmission() const { return submission_current_; }
   uint64_t GetCompletedSubmission() const { return submission_completed_; }
 
+  // If GPU timestamp profiling is enabled, writes a timestamp if the category
+  // of the work in the currently open submission is changed.
+  void SwitchGpuTimestampCategory(GpuTimestampProfiler::Category category) {
+    if (!gpu_timestamp_query_heap_) {
+      return;
+    }
+    uint32_t index = gpu_timestamp_profiler_.SwitchCategory(category);
+    if (index != UINT32_MAX) {
+      deferred_command_list_.D3DEndQuery(gpu_timestamp_query_heap_,
+                                         D3D12_QUERY_TYPE_TIMESTAMP, index);
+    }
+  }
+
   // Must be called when a subsystem does something like UpdateTileMappings so
   // it can be awaited in CheckSubmissionFence(submission_current_) if it was
   // done after the latest ExecuteCommandLists + Signal.
   void NotifyQueueOperationsDoneDirectly() {
     queue_operations_done_since_submission_signal_ = true;
   }
+  // Must be called before a subsystem does something like UpdateTileMappings
+  // so it's not placed on the queue before the submissions that have already
+  // been ended, but are still waiting for the submission thread.
+  void AwaitQueuedSubmissions();
 
   uint64_t GetCurrentFrame() const { return frame_current_; }
   uint64_t GetCompletedFrame() const { return frame_completed_; }
 
   // Returns true if the barrier has been inserted (the new state is different).
+  // Transitions of the same subresources in one batch are merged.
   bool PushTransitionBarrier(
       ID3D12Resource* resource, D3D12_RESOURCE_STATES old_state,
       D3D12_RESOURCE_STATES new_state,
@@ -324,6 +356,9 @@ class D3D12CommandProcessor final : public CommandProcessor {
   bool IssueCopy() override;
   XE_NOINLINE
   bool IssueCopy_ReadbackResolvePath();
+  bool IssueOcclusionQuery(uint32_t sample_count_address,
+                           bool is_end) override;
+  void PrepareForWait() override;
   void InitializeTrace() override;
 
  private:
@@ -429,6 +464,10 @@ class D3D12CommandProcessor final : public CommandProcessor {
   // clearing and stopping capturing. Returns whether the submission was done
   // successfully, if it has failed, leaves it open.
   bool EndSubmission(bool is_swap);
+  static bool BarrierReferencesResource(const D3D12_RESOURCE_BARRIER& barrier,
+                                        ID3D12Resource* resource);
+  // Reports the barrier statistics of the frame that has just ended.
+  void ReportBarrierCounts();
   // Checks if ending a submission right now would not cause potentially more
   // delay than it would reduce by making the GPU start working earlier - such
   // as when there are unfinished graphics pipeline creation requests that would
@@ -440,6 +479,19 @@ class D3D12CommandProcessor final : public CommandProcessor {
   }
   // Need to await submission completion before calling.
   void ClearCommandAllocatorCache();
+  // Converts the deferred command list to the native one, executes it and
+  // signals the submission fence. If await_async_texture_loads is true, the
+  // direct queue waits for the asynchronous texture loading of the submission
+  // first.
+  void ExecuteSubmission(DeferredCommandList& deferred_command_list,
+                         ID3D12CommandAllocator* command_allocator,
+                         uint64_t submission, bool await_async_texture_loads);
+  // Hands the commands recorded in deferred_command_list_ over to the
+  // submission thread.
+  void QueueSubmission(ID3D12CommandAllocator* command_allocator,
+                       uint64_t submission, bool await_async_texture_loads);
+  void SubmissionThread();
+  void CommandListRecordingThread(size_t recorder_index);
 
   // Request descriptors and automatically rebind the descriptor heap on the
   // draw command list. Refer to D3D12DescriptorHeapPool::Request for partial /
@@ -458,7 +510,8 @@ class D3D12CommandProcessor final : public CommandProcessor {
   void UpdateFixedFunctionState(const draw_util::ViewportInfo& viewport_info,
                                 const draw_util::Scissor& scissor,
                                 bool primitive_polygonal,
-                                reg::RB_DEPTHCONTROL normalized_depth_control);
+                                reg::RB_DEPTHCONTROL normalized_depth_control,
+                                uint32_t dirty_state_groups);
 
   template <bool primitive_polygonal, bool edram_rov_used>
   XE_NOINLINE void UpdateSystemConstantValues_Impl(
@@ -479,6 +532,13 @@ class D3D12CommandProcessor final : public CommandProcessor {
                       const D3D12Shader* pixel_shader,
                       ID3D12RootSignature* root_signature,
                       bool shared_memory_is_uav);
+  struct FloatConstantUpload;
+  // Packs the float constants used by a shader stage, and uploads them unless
+  // the previous upload for the stage in the frame has the same contents.
+  bool UploadFloatConstants(const uint64_t* float_bitmap,
+                            uint32_t first_register, uint32_t count,
+                            FloatConstantUpload& upload,
+                            D3D12_GPU_VIRTUAL_ADDRESS& address_out);
   XE_COLD
   XE_NOINLINE
   void UpdateBindings_UpdateRootBindful();
@@ -491,6 +551,25 @@ class D3D12CommandProcessor final : public CommandProcessor {
       const std::vector<xe::gpu::DxbcShader::TextureBinding>* textures_pixel,
       const size_t sampler_count_vertex, const size_t sampler_count_pixel,
       bool& retflag);
+  // Looks up a texture or a sampler descriptor table with the same contents as
+  // the specified bindings written earlier to the current bindful descriptor
+  // heap page. For textures, also writes the SRV keys of the current bindings.
+  bool FindBindfulTextureTable(
+      size_t layout_uid, const D3D12Shader::TextureBinding* bindings,
+      size_t binding_count,
+      std::vector<D3D12TextureCache::TextureSRVKey>& srv_keys_out,
+      D3D12_GPU_DESCRIPTOR_HANDLE& gpu_handle_out);
+  bool FindBindfulSamplerTable(
+      const D3D12TextureCache::SamplerParameters* parameters,
+      size_t sampler_count, D3D12_GPU_DESCRIPTOR_HANDLE& gpu_handle_out);
+  void AddBindfulTextureTable(
+      uint64_t heap_index, size_t layout_uid,
+      const D3D12TextureCache::TextureSRVKey* srv_keys, size_t binding_count,
+      D3D12_GPU_DESCRIPTOR_HANDLE gpu_handle);
+  void AddBindfulSamplerTable(
+      uint64_t heap_index,
+      const D3D12TextureCache::SamplerParameters* parameters,
+      size_t sampler_count, D3D12_GPU_DESCRIPTOR_HANDLE gpu_handle);
 
   // Returns a buffer for reading GPU data back to the CPU. Assuming
   // synchronizing immediately after use. Always in COPY_DEST state.
@@ -539,6 +618,54 @@ class D3D12CommandProcessor final : public CommandProcessor {
   ID3D12GraphicsCommandList1* command_list_1_ = nullptr;
   DeferredCommandList deferred_command_list_;
 
+  // With d3d12_submission_thread, command_list_ is recorded and executed on the
+  // submission thread rather than here, while the command processor thread
+  // continues processing the next PM4 packets. The queue is bounded, single
+  // producer and single consumer, and the deferred command lists in it are
+  // allocated once and reused.
+  static constexpr uint32_t kSubmissionQueueSize = 4;
+  struct QueuedSubmission {
+    std::unique_ptr<DeferredCommandList> deferred_command_list;
+    ID3D12CommandAllocator* command_allocator = nullptr;
+    uint64_t submission = 0;
+    bool await_async_texture_loads = false;
+  };
+  std::array<QueuedSubmission, kSubmissionQueueSize> submission_queue_;
+  // Numbers of submissions queued by the command processor thread and executed
+  // by the submission thread.
+  std::atomic<uint64_t> submission_queue_written_{0};
+  std::atomic<uint64_t> submission_queue_read_{0};
+  std::unique_ptr<xe::threading::Event> submission_queue_written_event_;
+  std::unique_ptr<xe::threading::Event> submission_queue_read_event_;
+  std::atomic<bool> submission_thread_running_{false};
+  std::unique_ptr<xe::threading::Thread> submission_thread_;
+
+  // With d3d12_command_list_recording_threads, large deferred command lists
+  // are split into parts recorded into separate native command lists in
+  // parallel, executed in order within one ExecuteCommandLists. The first part
+  // is recorded into command_list_ by the thread executing the submission.
+  static constexpr size_t kMaxCommandListRecorders = 15;
+  struct CommandListRecorder {
+    ID3D12GraphicsCommandList* command_list = nullptr;
+    ID3D12GraphicsCommandList1* command_list_1 = nullptr;
+    // With the submission they were last used in, oldest first.
+    std::deque<std::pair<uint64_t, ID3D12CommandAllocator*>>
+        command_allocators;
+    std::unique_ptr<xe::threading::Thread> thread;
+  };
+  std::vector<CommandListRecorder> command_list_recorders_;
+  std::vector<DeferredCommandList::ExecutionPart> command_list_parts_;
+  xe_mutex command_list_recording_lock_;
+  std::condition_variable_any command_list_recording_request_cond_;
+  std::condition_variable_any command_list_recording_done_cond_;
+  // Protected with command_list_recording_lock_.
+  const DeferredCommandList* command_list_recording_source_ = nullptr;
+  uint64_t command_list_recording_submission_ = 0;
+  uint64_t command_list_recording_generation_ = 0;
+  size_t command_list_recording_part_count_ = 0;
+  size_t command_list_recording_pending_ = 0;
+  bool command_list_recording_shutdown_ = false;
+
   // Should bindless textures and samplers be used - many times faster
   // UpdateBindings than bindful (that becomes a significant bottleneck with
   // bindful - mainly because of CopyDescriptorsSimple, which takes the majority
@@ -682,6 +809,10 @@ class D3D12CommandProcessor final : public CommandProcessor {
 
   // Unsubmitted barrier batch.
   std::vector<D3D12_RESOURCE_BARRIER> barriers_;
+  // Statistics for the current frame, for the profiler.
+  uint32_t barriers_submitted_ = 0;
+  uint32_t barrier_batches_submitted_ = 0;
+  uint32_t barriers_merged_ = 0;
 
   // <Submission where requested, resource>, sorted by the submission number.
   std::deque<std::pair<uint64_t, ID3D12Resource*>> resources_for_deletion_;
@@ -696,11 +827,126 @@ class D3D12CommandProcessor final : public CommandProcessor {
   ID3D12Resource* readback_buffer_ = nullptr;
   uint32_t readback_buffer_size_ = 0;
 
+  // Asynchronous readback (d3d12_readback_async) - copying from the shared
+  // memory to persistently mapped readback buffers, with the results written
+  // to the guest memory once the submission they were copied in is completed,
+  // or, for lazy readbacks (d3d12_readback_memexport_lazy), once the guest
+  // accesses the memory.
+  static constexpr uint32_t kAsyncReadbackBufferSizeIncrement = 1024 * 1024;
+  static constexpr size_t kMaxAsyncReadbacks = 16;
+  // Extra ranges a readback may be split into by guest CPU writes.
+  static constexpr size_t kAsyncReadbackMaxExtraRanges = 16;
+  struct AsyncReadbackBuffer {
+    ID3D12Resource* buffer;
+    const uint8_t* mapping;
+    uint32_t size;
+  };
+  struct AsyncReadbackRange {
+    uint32_t physical_address;
+    uint32_t length;
+    uint32_t buffer_offset;
+  };
+  struct AsyncReadback {
+    AsyncReadbackBuffer buffer;
+    uint64_t submission;
+    // Capacity reserved in advance since the ranges may be modified in the
+    // physical memory invalidation callback, which must not allocate.
+    std::vector<AsyncReadbackRange> ranges;
+  };
+  // Records copying of the (physical address, length) ranges of the shared
+  // memory to a readback buffer and starts executing the copy. Returns false
+  // if failed to allocate the buffer, so synchronous readback may be used.
+  // With lazy, the data is written to the guest memory only when the guest
+  // accesses it (or when there are too many pending lazy readbacks), via a
+  // physical memory data provider.
+  bool RequestAsyncReadback(const std::pair<uint32_t, uint32_t>* ranges,
+                            size_t range_count, bool lazy = false);
+  // Writes the data of completed readbacks to the guest memory, and, if
+  // await_all is true, awaits the completion of all pending readbacks first.
+  // Only reclaims the buffers of lazy readbacks with all the data already
+  // provided.
+  void CompleteAsyncReadbacks(bool await_all);
+  // Writes the data of the oldest lazy readbacks to the guest memory, awaiting
+  // their completion, until at most max_remaining are left.
+  void CompleteLazyAsyncReadbacks(size_t max_remaining);
+  // Writes the data of the ranges of a completed readback to the guest memory.
+  void WriteAsyncReadbackRanges(const AsyncReadback& readback);
+  static std::pair<uint32_t, uint32_t> AsyncReadbackInvalidationCallbackThunk(
+      void* context_ptr, uint32_t physical_address_start, uint32_t length,
+      bool exact_range);
+  std::pair<uint32_t, uint32_t> AsyncReadbackInvalidationCallback(
+      uint32_t physical_address_start, uint32_t length, bool exact_range);
+  static void AsyncReadbackDataProviderThunk(void* context_ptr,
+                                             uint32_t physical_address_start,
+                                             uint32_t length);
+  void AsyncReadbackDataProvider(uint32_t physical_address_start,
+                                 uint32_t length);
+  static constexpr xe::global_critical_region global_critical_region_{};
+  // Protected by global_critical_region_, as the ranges may be modified by the
+  // invalidation callback and by the data provider.
+  std::deque<AsyncReadback> async_readbacks_;
+  std::deque<AsyncReadback> async_readbacks_lazy_;
+  bool async_readbacks_completing_ = false;
+  std::vector<AsyncReadbackBuffer> async_readback_buffers_free_;
+  void* async_readback_invalidation_callback_handle_ = nullptr;
+  void* async_readback_data_provider_handle_ = nullptr;
+
+  // Host occlusion queries (query_occlusion_host) for the guest
+  // EVENT_WRITE_ZPD. A guest query may span multiple submissions, and since
+  // D3D12 queries can't cross command lists, it's made of segments - host
+  // queries in consecutive slots (in a ring) whose results are summed. The
+  // slots are resolved into a persistently mapped readback buffer, and the
+  // sample counts are written to the guest memory when the submission of the
+  // last segment is completed.
+  static constexpr uint32_t kOcclusionQuerySlotCount = 16384;
+  struct OcclusionQuery {
+    // UINT32_MAX if the query has not been ended yet or has been abandoned.
+    uint32_t sample_count_address;
+    uint32_t slot_first;
+    uint32_t slot_count;
+    // Whether segments couldn't be begun because all the slots were in use.
+    bool segments_dropped;
+    // The submission of the last segment.
+    uint64_t submission;
+  };
+  bool InitializeOcclusionQueries();
+  void ShutdownOcclusionQueries();
+  // Begins a segment of the active query in the current submission, before a
+  // draw.
+  void BeginOcclusionQuerySegment();
+  void EndOcclusionQuerySegment();
+  // Writes the sample counts of the ended queries whose submissions have been
+  // completed to the guest memory, and, if await_all is true, awaits the
+  // completion of all ended queries first.
+  void CompleteOcclusionQueries(bool await_all);
+  bool occlusion_queries_initialization_failed_ = false;
+  ID3D12QueryHeap* occlusion_query_heap_ = nullptr;
+  ID3D12Resource* occlusion_query_readback_buffer_ = nullptr;
+  const uint64_t* occlusion_query_readback_mapping_ = nullptr;
+  // The back is the active query if occlusion_query_active_ is true.
+  std::deque<OcclusionQuery> occlusion_queries_;
+  bool occlusion_query_active_ = false;
+  bool occlusion_query_segment_open_ = false;
+  uint32_t occlusion_query_slot_next_ = 0;
+  uint32_t occlusion_query_slots_used_ = 0;
+
+  bool InitializeGpuTimestamps();
+  void ShutdownGpuTimestamps();
+  // Accumulates the timestamps of the completed submissions.
+  void CompleteGpuTimestamps();
+  GpuTimestampProfiler gpu_timestamp_profiler_;
+  // Null if GPU timestamp profiling is disabled.
+  ID3D12QueryHeap* gpu_timestamp_query_heap_ = nullptr;
+  ID3D12Resource* gpu_timestamp_readback_buffer_ = nullptr;
+  const uint64_t* gpu_timestamp_readback_mapping_ = nullptr;
+
   // The current fixed-function drawing state.
   D3D12_VIEWPORT ff_viewport_;
   D3D12_RECT ff_scissor_;
   float ff_blend_factor_[4];
   uint32_t ff_stencil_ref_;
+  // The last primitive type the stencil reference face was chosen for.
+  bool ff_stencil_ref_primitive_polygonal_ = false;
   bool ff_viewport_update_needed_;
   bool ff_scissor_update_needed_;
   bool ff_blend_factor_update_needed_;
@@ -743,6 +989,20 @@ class D3D12CommandProcessor final : public CommandProcessor {
   ConstantBufferBinding cbuffer_binding_descriptor_indices_vertex_;
   ConstantBufferBinding cbuffer_binding_descriptor_indices_pixel_;
 
+  // The float constants last uploaded for each stage in the current frame.
+  // Titles often set all the constants before every draw even if the values
+  // are the same, and the buffer only contains the constants used by the
+  // shader, packed, so it can be reused regardless of which constants they
+  // were as long as the packed contents are the same.
+  struct FloatConstantUpload {
+    D3D12_GPU_VIRTUAL_ADDRESS address;
+    uint32_t count;
+    bool valid = false;
+    float values[256 * 4];
+  };
+  FloatConstantUpload float_constant_upload_vertex_;
+  FloatConstantUpload float_constant_upload_pixel_;
+
   // Whether the latest shared memory and EDRAM buffer binding contains the
   // shared memory UAV rather than the SRV.
   // Separate descriptor tables for the SRV and the UAV, even though only one is
@@ -781,6 +1041,32 @@ class D3D12CommandProcessor final : public CommandProcessor {
   std::vector<uint32_t> current_sampler_bindless_indices_vertex_;
   std::vector<uint32_t> current_sampler_bindless_indices_pixel_;
 
+  // Content-addressed caches of the bindful texture and sampler descriptor
+  // tables written to the current view and sampler heap pages, keyed by the
+  // hash of the bindings, so draws switching back to bindings used earlier
+  // (titles often alternate between a few materials) can reuse the tables
+  // instead of writing new descriptors. Cleared when the heap page changes.
+  // The texture tables reference the resources of the textures, which may be
+  // destroyed once the submissions using them are completed, so they are also
+  // cleared at the beginning of every submission.
+  struct BindfulTextureTable {
+    size_t layout_uid;
+    std::vector<D3D12TextureCache::TextureSRVKey> srv_keys;
+    D3D12_GPU_DESCRIPTOR_HANDLE gpu_handle;
+  };
+  struct BindfulSamplerTable {
+    std::vector<D3D12TextureCache::SamplerParameters> parameters;
+    D3D12_GPU_DESCRIPTOR_HANDLE gpu_handle;
+  };
+  std::unordered_multimap<uint64_t, BindfulTextureTable>
+      bindful_texture_tables_;
+  uint64_t bindful_texture_tables_heap_index_ =
+      ui::d3d12::D3D12DescriptorHeapPool::kHeapIndexInvalid;
+  std::unordered_multimap<uint64_t, BindfulSamplerTable>
+      bindful_sampler_tables_;
+  uint64_t bindful_sampler_tables_heap_index_ =
+      ui::d3d12::D3D12DescriptorHeapPool::kHeapIndexInvalid;
+
   // Latest bindful descriptor handles used for handling Xenos draw calls.
   D3D12_GPU_DESCRIPTOR_HANDLE gpu_handle_shared_memory_srv_and_edram_;
   D3D12_GPU_DESCRIPTOR_HANDLE gpu_handle_shared_memory_uav_and_edram_;
@@ -794,6 +1080,8 @@ class D3D12CommandProcessor final : public CommandProcessor {
 
   draw_util::GetViewportInfoArgs previous_viewport_info_args_;
   draw_util::ViewportInfo previous_viewport_info_;
+  // With the resolution scale applied.
+  draw_util::Scissor previous_scissor_;
 
   std::atomic<bool> pix_capture_requested_ = false;
   bool pix_capturing_;
@@ -1552,9 +1552,15 @@ bool D3D12RenderTargetCache::Resolve(const Memory& memory,
               resolve_info.GetClearShaderGroupCount(draw_resolution_scale_x(),
                                                     draw_resolution_scale_y());
           assert_true(clear_group_count.first && clear_group_count.second);
+          // Skipping clears of tiles not modified since the same clear.
+          draw_util::ResolveClearShaderConstants depth_clear_constants;
+          bool depth_cleared = false;
           if (clear_depth) {
-            draw_util::ResolveClearShaderConstants depth_clear_constants;
             resolve_info.GetDepthClearShaderConstants(depth_clear_constants);
+            depth_cleared = PrepareInterlockResolveClear(resolve_info,
+                                                         depth_clear_constants);
+          }
+          if (depth_cleared) {
             command_list.D3DSetComputeRoot32BitConstants(
                 0, sizeof(depth_clear_constants) / sizeof(uint32_t),
                 &depth_clear_constants, 0);
@@ -1564,10 +1570,13 @@ bool D3D12RenderTargetCache::Resolve(const Memory& memory,
             command_list.D3DDispatch(clear_group_count.first,
                                      clear_group_count.second, 1);
           }
+          draw_util::ResolveClearShaderConstants color_clear_constants;
           if (clear_color) {
-            draw_util::ResolveClearShaderConstants color_clear_constants;
             resolve_info.GetColorClearShaderConstants(color_clear_constants);
-            if (clear_depth) {
+          }
+          if (clear_color && PrepareInterlockResolveClear(
+                                 resolve_info, color_clear_constants)) {
+            if (depth_cleared) {
               // Non-RT-specific constants have already been set.
               command_list.D3DSetComputeRoot32BitConstants(
                   0,
@@ -1641,13 +1650,22 @@ bool D3D12RenderTargetCache::InitializeTraceSubmitDownloads() {
 }
 
 void D3D12RenderTargetCache::InitializeTraceCompleteDownloads() {
+  CompleteEdramSnapshotDownload(nullptr);
+}
+
+bool D3D12RenderTargetCache::CompleteEdramSnapshotDownload(void* snapshot) {
   if (!edram_snapshot_download_buffer_) {
-    return;
+    return false;
   }
   void* download_mapping;
-  if (SUCCEEDED(edram_snapshot_download_buffer_->Map(0, nullptr,
-                                                     &download_mapping))) {
-    trace_writer_.WriteEdramSnapshot(download_mapping);
+  bool mapped = SUCCEEDED(
+      edram_snapshot_download_buffer_->Map(0, nullptr, &download_mapping));
+  if (mapped) {
+    if (snapshot) {
+      std::memcpy(snapshot, download_mapping, xenos::kEdramSizeBytes);
+    } else {
+      trace_writer_.WriteEdramSnapshot(download_mapping);
+    }
     D3D12_RANGE download_write_range = {};
     edram_snapshot_download_buffer_->Unmap(0, &download_write_range);
   } else {
@@ -1657,6 +1675,7 @@ void D3D12RenderTargetCache::InitializeTraceCompleteDownloads() {
   }
   edram_snapshot_download_buffer_->Release();
   edram_snapshot_download_buffer_ = nullptr;
+  return mapped;
 }
 
 void D3D12RenderTargetCache::RestoreEdramSnapshot(const void* snapshot) {
@@ -1762,6 +1781,7 @@ void D3D12RenderTargetCache::RestoreEdramSnapshot(const void* snapshot) {
       command_list.D3DCopyBufferRegion(edram_buffer_, 0, upload_buffer,
                                        UINT64(upload_buffer_offset),
                                        xenos::kEdramSizeBytes);
+      InvalidateKnownResolveClears(0, xenos::kEdramTileCount);
     } break;
 
     default:
@@ -4464,6 +4484,21 @@ void D3D12RenderTargetCache::PerformTransfersAndResolveClears(
 
   bool resolve_clear_needed =
       render_target_resolve_clear_values && resolve_clear_rectangle;
+  // This is called for every draw, only switch the profiling category if
+  // there are actual transfers to do (resolve clears are a part of resolves).
+  bool any_transfers_needed = false;
+  if (render_target_transfers) {
+    for (uint32_t i = 0; i < render_target_count; ++i) {
+      if (render_targets[i] && !render_target_transfers[i].empty()) {
+        any_transfers_needed = true;
+        break;
+      }
+    }
+  }
+  if (any_transfers_needed) {
+    command_processor_.SwitchGpuTimestampCategory(
+        GpuTimestampProfiler::Category::kEdramTransfers);
+  }
   D3D12_RECT clear_rect;
   if (resolve_clear_needed) {
     // Assuming the rectangle is already clamped by the setup function from the
@@ -5330,6 +5365,17 @@ void D3D12RenderTargetCache::PerformTransfersAndResolveClears(
     // Perform the clear.
     if (resolve_clear_needed) {
       uint64_t clear_value = render_target_resolve_clear_values[i];
+      // Clearing the whole resource without rectangles if possible, for fast
+      // clears to be more likely to be used by the driver.
+      D3D12_RESOURCE_DESC dest_resource_desc =
+          dest_d3d12_rt.resource()->GetDesc();
+      UINT clear_rect_count =
+          (clear_rect.left <= 0 && clear_rect.top <= 0 &&
+           UINT64(clear_rect.right) >= dest_resource_desc.Width &&
+           UINT(clear_rect.bottom) >= dest_resource_desc.Height)
+              ? 0
+              : 1;
+      const D3D12_RECT* clear_rects = clear_rect_count ? &clear_rect : nullptr;
       if (dest_rt_key.is_depth) {
         uint32_t depth_guest_clear_value =
             (uint32_t(clear_value) >> 8) & 0xFFFFFF;
@@ -5353,7 +5399,8 @@ void D3D12RenderTargetCache::PerformTransfersAndResolveClears(
         command_list.D3DClearDepthStencilView(
             dest_d3d12_rt.descriptor_draw().GetHandle(),
             D3D12_CLEAR_FLAG_DEPTH | D3D12_CLEAR_FLAG_STENCIL,
-            depth_host_clear_value, UINT(clear_value) & 0xFF, 1, &clear_rect);
+            depth_host_clear_value, UINT(clear_value) & 0xFF, clear_rect_count,
+            clear_rects);
       } else {
         float color_clear_value[4] = {};
         bool clear_via_drawing = false;
@@ -5462,7 +5509,7 @@ void D3D12RenderTargetCache::PerformTransfersAndResolveClears(
               dest_d3d12_rt.descriptor_load_separate().IsValid()
                   ? dest_d3d12_rt.descriptor_load_separate().GetHandle()
                   : dest_d3d12_rt.descriptor_draw().GetHandle(),
-              color_clear_value, 1, &clear_rect);
+              color_clear_value, clear_rect_count, clear_rects);
         }
       }
     }
@@ -91,6 +91,9 @@ class D3D12RenderTargetCache final : public RenderTargetCache {
   // Returns true if any downloads were submitted to the command processor.
   bool InitializeTraceSubmitDownloads();
   void InitializeTraceCompleteDownloads();
+  // Completes the EDRAM download submitted by InitializeTraceSubmitDownloads,
+  // copying it to the snapshot instead of writing it to the trace.
+  bool CompleteEdramSnapshotDownload(void* snapshot);
   void RestoreEdramSnapshot(const void* snapshot);
 
   // For host render targets.
@@ -17,6 +17,7 @@
 #include "xenia/base/cvar.h"
 #include "xenia/base/logging.h"
 #include "xenia/base/math.h"
+#include "xenia/base/profiling.h"
 #include "xenia/gpu/d3d12/d3d12_command_processor.h"
 #include "xenia/ui/d3d12/d3d12_util.h"
 
@@ -26,6 +27,16 @@ DEFINE_bool(d3d12_tiled_shared_memory, true,
             "but allows graphics debuggers that don't support tiled resources "
             "to work.",
             "D3D12");
+DEFINE_bool(
+    d3d12_host_visible_shared_memory, false,
+    "On cache-coherent UMA devices, place the shared memory buffer in memory "
+    "directly writable by the CPU, and copy guest memory into it without "
+    "intermediate upload buffers and copy commands. This disables tiled "
+    "resources for shared memory. Unlike uploads via copy commands, the "
+    "writes are not ordered with GPU work that has already been recorded, so "
+    "if a game overwrites data still being read by the GPU in frames in "
+    "flight, rendering of those frames may become corrupted.",
+    "D3D12");
 
 namespace xe {
 namespace gpu {
@@ -50,41 +61,77 @@ bool D3D12SharedMemory::Initialize() {
   ui::d3d12::util::FillBufferResourceDesc(
       buffer_desc, kBufferSize, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
   buffer_state_ = D3D12_RESOURCE_STATE_COPY_DEST;
-  if (cvars::d3d12_tiled_shared_memory &&
-      provider.GetTiledResourcesTier() !=
-          D3D12_TILED_RESOURCES_TIER_NOT_SUPPORTED &&
-      !provider.GetGraphicsAnalysis()) {
-    if (FAILED(device->CreateReservedResource(
-            &buffer_desc, buffer_state_, nullptr, IID_PPV_ARGS(&buffer_)))) {
-      XELOGE("Shared memory: Failed to create the {} MB tiled buffer",
-             kBufferSize >> 20);
-      Shutdown();
-      return false;
+  if (cvars::d3d12_host_visible_shared_memory &&
+      provider.IsCacheCoherentUMA()) {
+    // On UMA, L0 is the only memory pool, and write-back CPU pages are cached
+    // coherently with the GPU.
+    D3D12_HEAP_PROPERTIES host_visible_heap_properties = {};
+    host_visible_heap_properties.Type = D3D12_HEAP_TYPE_CUSTOM;
+    host_visible_heap_properties.CPUPageProperty =
+        D3D12_CPU_PAGE_PROPERTY_WRITE_BACK;
+    host_visible_heap_properties.MemoryPoolPreference = D3D12_MEMORY_POOL_L0;
+    if (SUCCEEDED(device->CreateCommittedResource(
+            &host_visible_heap_properties,
+            provider.GetHeapFlagCreateNotZeroed(), &buffer_desc,
+            buffer_state_, nullptr, IID_PPV_ARGS(&buffer_)))) {
+      D3D12_RANGE buffer_read_range = {};
+      void* buffer_mapping;
+      if (SUCCEEDED(buffer_->Map(0, &buffer_read_range, &buffer_mapping))) {
+        buffer_mapping_ = reinterpret_cast<uint8_t*>(buffer_mapping);
+        XELOGGPU(
+            "Using a {} MB CPU-writable buffer for shared memory emulation",
+            kBufferSize >> 20);
+      } else {
+        XELOGE(
+            "Shared memory: Failed to map the {} MB CPU-writable buffer, "
+            "falling back to uploading via copy commands",
+            kBufferSize >> 20);
+        ui::d3d12::util::ReleaseAndNull(buffer_);
+      }
+    } else {
+      XELOGE(
+          "Shared memory: Failed to create the {} MB CPU-writable buffer, "
+          "falling back to uploading via copy commands",
+          kBufferSize >> 20);
     }
-    static_assert(D3D12_TILED_RESOURCE_TILE_SIZE_IN_BYTES == (1 << 16));
-    InitializeSparseHostGpuMemory(
-        std::max(kHostGpuMemoryOptimalSparseAllocationLog2, uint32_t(16)));
-  } else {
-    XELOGGPU(
-        "Direct3D 12 tiled resources are not used for shared memory "
-        "emulation - video memory usage may increase significantly "
-        "because a full {} MB buffer will be created",
-        kBufferSize >> 20);
-    if (provider.GetGraphicsAnalysis()) {
-      // As of October 8th, 2018, PIX doesn't support tiled buffers.
-      // FIXME(Triang3l): Re-enable tiled resources with PIX once fixed.
+  }
+  if (!buffer_) {
+    if (cvars::d3d12_tiled_shared_memory &&
+        provider.GetTiledResourcesTier() !=
+            D3D12_TILED_RESOURCES_TIER_NOT_SUPPORTED &&
+        !provider.GetGraphicsAnalysis()) {
+      if (FAILED(device->CreateReservedResource(
+              &buffer_desc, buffer_state_, nullptr, IID_PPV_ARGS(&buffer_)))) {
+        XELOGE("Shared memory: Failed to create the {} MB tiled buffer",
+               kBufferSize >> 20);
+        Shutdown();
+        return false;
+      }
+      static_assert(D3D12_TILED_RESOURCE_TILE_SIZE_IN_BYTES == (1 << 16));
+      InitializeSparseHostGpuMemory(
+          std::max(kHostGpuMemoryOptimalSparseAllocationLog2, uint32_t(16)));
+    } else {
       XELOGGPU(
-          "This is caused by PIX being attached, which doesn't support tiled "
-          "resources yet.");
-    }
-    if (FAILED(device->CreateCommittedResource(
-            &ui::d3d12::util::kHeapPropertiesDefault,
-            provider.GetHeapFlagCreateNotZeroed(), &buffer_desc, buffer_state_,
-            nullptr, IID_PPV_ARGS(&buffer_)))) {
-      XELOGE("Shared memory: Failed to create the {} MB buffer",
-             kBufferSize >> 20);
-      Shutdown();
-      return false;
+          "Direct3D 12 tiled resources are not used for shared memory "
+          "emulation - video memory usage may increase significantly "
+          "because a full {} MB buffer will be created",
+          kBufferSize >> 20);
+      if (provider.GetGraphicsAnalysis()) {
+        // As of October 8th, 2018, PIX doesn't support tiled buffers.
+        // FIXME(Triang3l): Re-enable tiled resources with PIX once fixed.
+        XELOGGPU(
+            "This is caused by PIX being attached, which doesn't support tiled "
+            "resources yet.");
+      }
+      if (FAILED(device->CreateCommittedResource(
+              &ui::d3d12::util::kHeapPropertiesDefault,
+              provider.GetHeapFlagCreateNotZeroed(), &buffer_desc,
+              buffer_state_, nullptr, IID_PPV_ARGS(&buffer_)))) {
+        XELOGE("Shared memory: Failed to create the {} MB buffer",
+               kBufferSize >> 20);
+        Shutdown();
+        return false;
+      }
     }
   }
   buffer_gpu_address_ = buffer_->GetGPUVirtualAddress();
@@ -168,6 +215,11 @@ void D3D12SharedMemory::Shutdown(bool from_destructor) {
   ui::d3d12::util::ReleaseAndNull(buffer_descriptor_heap_);
 
   // First free the buffer to detach it from the heaps.
+  if (buffer_mapping_) {
+    D3D12_RANGE buffer_written_range = {};
+    buffer_->Unmap(0, &buffer_written_range);
+    buffer_mapping_ = nullptr;
+  }
   ui::d3d12::util::ReleaseAndNull(buffer_);
 
   for (ID3D12Heap* heap : buffer_tiled_heaps_) {
@@ -197,6 +249,12 @@ void D3D12SharedMemory::BeginSubmission() {
   buffer_uav_writes_commit_needed_ = false;
 }
 
+void D3D12SharedMemory::EndFrame() {
+  COUNT_profile_set("gpu/shared_memory/upload_copies_per_frame",
+                    upload_copies_in_frame_);
+  upload_copies_in_frame_ = 0;
+}
+
 void D3D12SharedMemory::CommitUAVWritesAndTransitionBuffer(
     D3D12_RESOURCE_STATES new_state) {
   if (buffer_state_ == new_state) {
@@ -397,6 +455,7 @@ bool D3D12SharedMemory::AllocateSparseHostGpuMemoryRange(
   region_size.UseBox = FALSE;
   D3D12_TILE_RANGE_FLAGS range_flags = D3D12_TILE_RANGE_FLAG_NONE;
   UINT heap_range_start_offset = 0;
+  command_processor_.AwaitQueuedSubmissions();
   direct_queue->UpdateTileMappings(
       buffer_, 1, &region_start_coordinates, &region_size, heap, 1,
       &range_flags, &heap_range_start_offset, &region_size.NumTiles,
@@ -411,6 +470,22 @@ bool D3D12SharedMemory::UploadRanges(
   if (!num_upload_page_ranges) {
     return true;
   }
+  if (buffer_mapping_) {
+    // CPU writes are visible to command lists submitted after them, and the
+    // current command list is only submitted later, so no copy commands or
+    // barriers are needed.
+    for (uint32_t i = 0; i < num_upload_page_ranges; ++i) {
+      auto& upload_range = upload_page_ranges[i];
+      uint32_t upload_range_start = upload_range.first << page_size_log2();
+      uint32_t upload_range_length = upload_range.second << page_size_log2();
+      trace_writer_.WriteMemoryRead(upload_range_start, upload_range_length);
+      MakeRangeValid(upload_range_start, upload_range_length, false, false);
+      std::memcpy(buffer_mapping_ + upload_range_start,
+                  memory().TranslatePhysical(upload_range_start),
+                  upload_range_length);
+    }
+    return true;
+  }
   CommitUAVWritesAndTransitionBuffer(D3D12_RESOURCE_STATE_COPY_DEST);
   command_processor_.SubmitBarriers();
   auto& command_list = command_processor_.GetDeferredCommandList();
@@ -449,9 +524,17 @@ bool D3D12SharedMemory::UploadRanges(
             memory().TranslatePhysical(upload_range_start << page_size_log2()),
             upload_buffer_size);
       }
-      command_list.D3DCopyBufferRegion(
-          buffer_, upload_range_start << page_size_log2(), upload_buffer,
-          UINT64(upload_buffer_offset), UINT64(upload_buffer_size));
+      // Consecutive uploads, including ones from different requests if nothing
+      // has been recorded between them, are usually adjacent both in the
+      // upload buffer and in the shared memory.
+      if (!command_list.TryExtendLastD3DCopyBufferRegion(
+              buffer_, upload_range_start << page_size_log2(), upload_buffer,
+              UINT64(upload_buffer_offset), UINT64(upload_buffer_size))) {
+        command_list.D3DCopyBufferRegion(
+            buffer_, upload_range_start << page_size_log2(), upload_buffer,
+            UINT64(upload_buffer_offset), UINT64(upload_buffer_size));
+        ++upload_copies_in_frame_;
+      }
       uint32_t upload_buffer_pages =
           uint32_t(upload_buffer_size >> page_size_log2());
       upload_range_start += upload_buffer_pages;
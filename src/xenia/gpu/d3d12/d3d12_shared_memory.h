@@ -44,6 +44,8 @@ class D3D12SharedMemory : public SharedMemory {
 
   void CompletedSubmissionUpdated();
   void BeginSubmission();
+  // Reports the upload statistics of the frame.
+  void EndFrame();
 
   // RequestRange may transition the buffer to copy destination - call it before
   // UseForReading or UseForWriting.
@@ -102,6 +104,9 @@ class D3D12SharedMemory : public SharedMemory {
   ID3D12Resource* buffer_ = nullptr;
   D3D12_GPU_VIRTUAL_ADDRESS buffer_gpu_address_ = 0;
   std::vector<ID3D12Heap*> buffer_tiled_heaps_;
+  // Persistently mapped if the buffer is in CPU-writable memory, in which case
+  // guest memory is copied to it directly rather than via upload buffers.
+  uint8_t* buffer_mapping_ = nullptr;
   D3D12_RESOURCE_STATES buffer_state_ = D3D12_RESOURCE_STATE_COPY_DEST;
   bool buffer_uav_writes_commit_needed_ = false;
   void CommitUAVWritesAndTransitionBuffer(D3D12_RESOURCE_STATES new_state);
@@ -124,6 +129,9 @@ class D3D12SharedMemory : public SharedMemory {
   D3D12_CPU_DESCRIPTOR_HANDLE buffer_descriptor_heap_start_;
 
   std::unique_ptr<ui::d3d12::D3D12UploadBufferPool> upload_buffer_pool_;
+  // Copy commands recorded for uploads in the current frame, not including
+  // the ones merged into the previous copy command.
+  uint32_t upload_copies_in_frame_ = 0;
 
   // Created temporarily, only for downloading.
   ID3D12Resource* trace_download_buffer_ = nullptr;
@@ -17,9 +17,11 @@
 #include <utility>
 
 #include "xenia/base/assert.h"
+#include "xenia/base/cvar.h"
 #include "xenia/base/logging.h"
 #include "xenia/base/math.h"
 #include "xenia/base/profiling.h"
+#include "xenia/base/xxhash.h"
 #include "xenia/gpu/d3d12/d3d12_command_processor.h"
 #include "xenia/gpu/d3d12/d3d12_shared_memory.h"
 #include "xenia/gpu/texture_info.h"
@@ -28,6 +30,21 @@
 #include "xenia/ui/d3d12/d3d12_upload_buffer_pool.h"
 #include "xenia/ui/d3d12/d3d12_util.h"
 
+DEFINE_bool(
+    d3d12_async_texture_loading, false,
+    "Load textures that haven't been used by the GPU yet, such as streamed "
+    "ones, on a separate compute queue, so the loading overlaps the rendering "
+    "work submitted before. Textures containing data written by the GPU are "
+    "still loaded on the direct queue.",
+    "D3D12");
+DEFINE_uint32(
+    d3d12_texture_heap_size_mb, 64,
+    "Size of the heaps textures up to a quarter of it are placed in on "
+    "Direct3D 12, in megabytes, instead of creating a committed resource, "
+    "aligned to at least 64 KB, for each texture. 0 to create all textures as "
+    "committed resources.",
+    "D3D12");
+
 namespace xe {
 namespace gpu {
 namespace d3d12 {
@@ -127,6 +144,15 @@ bool D3D12TextureCache::Initialize() {
       command_processor_.GetD3D12Provider();
   ID3D12Device* device = provider.GetDevice();
 
+  if (cvars::d3d12_texture_heap_size_mb) {
+    // Tier 1 heaps can contain only one category of resources, the textures
+    // are not render targets or depth / stencil.
+    placed_resource_pool_ =
+        std::make_unique<ui::d3d12::D3D12PlacedResourcePool>(
+            provider, D3D12_HEAP_FLAG_ALLOW_ONLY_NON_RT_DS_TEXTURES,
+            uint64_t(cvars::d3d12_texture_heap_size_mb) << 20);
+  }
+
   if (IsDrawResolutionScaled()) {
     // Buffers not used yet - no need aliasing barriers to change ownership of
     // gigabytes between even and odd buffers.
@@ -418,6 +444,13 @@ bool D3D12TextureCache::Initialize() {
       provider.OffsetViewDescriptor(null_srv_descriptor_heap_start_,
                                     uint32_t(NullSRVDescriptorIndex::kCube)));
 
+  if (cvars::d3d12_async_texture_loading && !InitializeAsyncLoading()) {
+    XELOGW(
+        "D3D12TextureCache: Failed to initialize asynchronous texture "
+        "loading, loading all textures on the direct queue");
+    async_load_descriptor_heap_pool_.reset();
+  }
+
   return true;
 }
 
@@ -428,6 +461,55 @@ void D3D12TextureCache::ClearCache() {
   srv_descriptor_cache_free_.clear();
   srv_descriptor_cache_allocated_ = 0;
   srv_descriptor_cache_.clear();
+
+  if (async_load_upload_buffer_pool_) {
+    async_load_upload_buffer_pool_->ClearCache();
+  }
+  if (async_load_descriptor_heap_pool_) {
+    async_load_descriptor_heap_pool_->ClearCache();
+  }
+  async_load_scratch_buffers_.clear();
+
+  if (texture_storage_upload_buffer_pool_) {
+    texture_storage_upload_buffer_pool_->ClearCache();
+  }
+}
+
+void D3D12TextureCache::CompletedSubmissionUpdated(
+    uint64_t completed_submission_index) {
+  TextureCache::CompletedSubmissionUpdated(completed_submission_index);
+
+  if (async_load_upload_buffer_pool_) {
+    async_load_upload_buffer_pool_->Reclaim(completed_submission_index);
+  }
+  if (async_load_descriptor_heap_pool_) {
+    async_load_descriptor_heap_pool_->Reclaim(completed_submission_index);
+  }
+
+  if (texture_storage_upload_buffer_pool_) {
+    texture_storage_upload_buffer_pool_->Reclaim(completed_submission_index);
+  }
+  while (!texture_storage_readbacks_.empty()) {
+    TextureStorageReadback& readback = texture_storage_readbacks_.front();
+    if (readback.submission > completed_submission_index) {
+      break;
+    }
+    D3D12_RANGE readback_range;
+    readback_range.Begin = 0;
+    readback_range.End = readback.size;
+    void* readback_mapping;
+    if (SUCCEEDED(
+            readback.buffer->Map(0, &readback_range, &readback_mapping))) {
+      const uint8_t* readback_data =
+          static_cast<const uint8_t*>(readback_mapping);
+      StoreHostData(readback.key,
+                    std::vector<uint8_t>(readback_data,
+                                         readback_data + readback.size));
+      D3D12_RANGE readback_write_range = {};
+      readback.buffer->Unmap(0, &readback_write_range);
+    }
+    texture_storage_readbacks_.pop_front();
+  }
 }
 
 void D3D12TextureCache::BeginSubmission(uint64_t new_submission_index) {
@@ -451,6 +533,15 @@ void D3D12TextureCache::BeginSubmission(uint64_t new_submission_index) {
 void D3D12TextureCache::BeginFrame() {
   TextureCache::BeginFrame();
 
+  if (placed_resource_pool_) {
+    const ui::d3d12::D3D12PlacedResourcePool::Statistics&
+        placed_resource_statistics = placed_resource_pool_->statistics();
+    COUNT_profile_set("gpu/texture_cache/placed_heaps_kb",
+                      placed_resource_statistics.heap_bytes >> 10);
+    COUNT_profile_set("gpu/texture_cache/placed_textures_kb",
+                      placed_resource_statistics.resource_bytes >> 10);
+  }
+
   std::memset(unsupported_format_features_used_, 0,
               sizeof(unsupported_format_features_used_));
 }
@@ -523,6 +614,66 @@ void D3D12TextureCache::RequestTextures(uint32_t used_texture_mask) {
     }
   }
 }
+
+bool D3D12TextureCache::SubmitAsyncLoads(bool& submitted_out) {
+  submitted_out = false;
+  if (!async_loads_recorded_) {
+    if (async_load_deferred_command_list_) {
+      // Drop the commands from loads that have failed.
+      async_load_deferred_command_list_->Reset();
+      async_load_descriptor_heap_index_ =
+          ui::d3d12::D3D12DescriptorHeapPool::kHeapIndexInvalid;
+    }
+    return true;
+  }
+
+  uint64_t submission_current = command_processor_.GetCurrentSubmission();
+  uint64_t submission_completed = command_processor_.GetCompletedSubmission();
+  AsyncLoadCommandAllocator* command_allocator = nullptr;
+  for (AsyncLoadCommandAllocator& command_allocator_existing :
+       async_load_command_allocators_) {
+    if (command_allocator_existing.last_usage_submission <=
+        submission_completed) {
+      command_allocator = &command_allocator_existing;
+      break;
+    }
+  }
+  if (!command_allocator) {
+    Microsoft::WRL::ComPtr<ID3D12CommandAllocator> new_command_allocator;
+    if (FAILED(command_processor_.GetD3D12Provider()
+                   .GetDevice()
+                   ->CreateCommandAllocator(
+                       D3D12_COMMAND_LIST_TYPE_COMPUTE,
+                       IID_PPV_ARGS(&new_command_allocator)))) {
+      XELOGE(
+          "D3D12TextureCache: Failed to create an asynchronous texture loading "
+          "command allocator");
+      // Try to submit later, the loads must not be dropped.
+      return false;
+    }
+    command_allocator = &async_load_command_allocators_.emplace_back();
+    command_allocator->command_allocator = std::move(new_command_allocator);
+  }
+
+  command_allocator->command_allocator->Reset();
+  async_load_command_list_->Reset(command_allocator->command_allocator.Get(),
+                                  nullptr);
+  async_load_deferred_command_list_->Execute(async_load_command_list_.Get(),
+                                             nullptr);
+  async_load_command_list_->Close();
+  ID3D12CommandList* execute_command_lists[] = {async_load_command_list_.Get()};
+  async_load_queue_->ExecuteCommandLists(1, execute_command_lists);
+  async_load_queue_->Signal(async_load_fence_.Get(), submission_current);
+  command_allocator->last_usage_submission = submission_current;
+
+  async_load_deferred_command_list_->Reset();
+  async_loads_recorded_ = false;
+  async_load_descriptor_heap_index_ =
+      ui::d3d12::D3D12DescriptorHeapPool::kHeapIndexInvalid;
+  submitted_out = true;
+  return true;
+}
+
 // chrispy: optimize this further
 bool D3D12TextureCache::AreActiveTextureSRVKeysUpToDate(
     const TextureSRVKey* keys,
@@ -976,6 +1127,7 @@ bool D3D12TextureCache::EnsureScaledResolveMemoryCommitted(
     std::array<size_t, 2> buffer_indices =
         GetPossibleScaledResolveBufferIndices(uint64_t(i)
                                               << kScaledResolveHeapSizeLog2);
+    command_processor_.AwaitQueuedSubmissions();
     for (size_t j = 0; j < 2; ++j) {
       size_t buffer_index = buffer_indices[j];
       if (j && buffer_index == buffer_indices[0]) {
@@ -1195,15 +1347,22 @@ ID3D12Resource* D3D12TextureCache::RequestSwapTexture(
 
 D3D12TextureCache::D3D12Texture::D3D12Texture(
     D3D12TextureCache& texture_cache, const TextureKey& key,
-    ID3D12Resource* resource, D3D12_RESOURCE_STATES resource_state)
+    ID3D12Resource* resource, D3D12_RESOURCE_STATES resource_state,
+    const ui::d3d12::D3D12PlacedResourcePool::Allocation& placed_allocation,
+    uint64_t placed_slot_size)
     : Texture(texture_cache, key),
       resource_(resource),
+      placed_allocation_(placed_allocation),
       resource_state_(resource_state) {
-  ID3D12Device* device =
-      texture_cache.command_processor_.GetD3D12Provider().GetDevice();
-  D3D12_RESOURCE_DESC resource_desc = resource_->GetDesc();
-  SetHostMemoryUsage(
-      device->GetResourceAllocationInfo(0, 1, &resource_desc).SizeInBytes);
+  if (placed_allocation_.IsValid()) {
+    SetHostMemoryUsage(placed_slot_size);
+  } else {
+    ID3D12Device* device =
+        texture_cache.command_processor_.GetD3D12Provider().GetDevice();
+    D3D12_RESOURCE_DESC resource_desc = resource_->GetDesc();
+    SetHostMemoryUsage(
+        device->GetResourceAllocationInfo(0, 1, &resource_desc).SizeInBytes);
+  }
 }
 
 D3D12TextureCache::D3D12Texture::~D3D12Texture() {
@@ -1211,6 +1370,11 @@ D3D12TextureCache::D3D12Texture::~D3D12Texture() {
   for (const auto& descriptor_pair : srv_descriptors_) {
     d3d12_texture_cache.ReleaseTextureDescriptor(descriptor_pair.second);
   }
+  if (placed_allocation_.IsValid()) {
+    // Release the resource before its memory can be reused.
+    resource_.Reset();
+    d3d12_texture_cache.placed_resource_pool_->Free(placed_allocation_);
+  }
 }
 
 bool D3D12TextureCache::IsDecompressionNeeded(xenos::TextureFormat format,
@@ -1336,24 +1500,49 @@ std::unique_ptr<TextureCache::Texture> D3D12TextureCache::CreateTexture(
   // Assuming untiling will be the next operation.
   D3D12_RESOURCE_STATES resource_state = D3D12_RESOURCE_STATE_COPY_DEST;
   Microsoft::WRL::ComPtr<ID3D12Resource> resource;
-  if (FAILED(device->CreateCommittedResource(
-          &ui::d3d12::util::kHeapPropertiesDefault,
-          provider.GetHeapFlagCreateNotZeroed(), &desc, resource_state, nullptr,
-          IID_PPV_ARGS(&resource)))) {
-    return nullptr;
+  // Textures too large for the heaps, or not placed because of a heap
+  // creation failure, are created as committed resources.
+  ui::d3d12::D3D12PlacedResourcePool::Allocation placed_allocation;
+  uint64_t placed_slot_size = 0;
+  if (!placed_resource_pool_ ||
+      !placed_resource_pool_->CreateResource(desc, resource_state, nullptr,
+                                             resource, placed_allocation,
+                                             &placed_slot_size)) {
+    if (FAILED(device->CreateCommittedResource(
+            &ui::d3d12::util::kHeapPropertiesDefault,
+            provider.GetHeapFlagCreateNotZeroed(), &desc, resource_state,
+            nullptr, IID_PPV_ARGS(&resource)))) {
+      return nullptr;
+    }
   }
   return std::unique_ptr<Texture>(
-      new D3D12Texture(*this, key, resource.Get(), resource_state));
+      new D3D12Texture(*this, key, resource.Get(), resource_state,
+                       placed_allocation, placed_slot_size));
 }
 
 bool D3D12TextureCache::LoadTextureDataFromResidentMemoryImpl(Texture& texture,
                                                               bool load_base,
                                                               bool load_mips) {
+  return LoadTextureDataImpl(texture, load_base, load_mips, nullptr, 0);
+}
+
+bool D3D12TextureCache::LoadTextureDataImpl(Texture& texture, bool load_base,
+                                            bool load_mips,
+                                            const uint8_t* host_data,
+                                            uint32_t host_data_size) {
   D3D12Texture& d3d12_texture = static_cast<D3D12Texture&>(texture);
   TextureKey texture_key = d3d12_texture.key();
 
-  DeferredCommandList& command_list =
-      command_processor_.GetDeferredCommandList();
+  // The converted data to store is read back from the direct queue.
+  uint64_t texture_storage_key;
+  bool store_host_data =
+      !host_data && IsHostDataStoreRequested(texture_storage_key);
+
+  // Textures not used on the direct queue yet, with the data only from the
+  // CPU, can be loaded on the asynchronous loading queue from a copy of the
+  // guest memory.
+  bool async = !host_data && !store_host_data &&
+               IsAsyncLoadPossible(d3d12_texture, load_base, load_mips);
   ID3D12Device* device = command_processor_.GetD3D12Provider().GetDevice();
 
   // Get the pipeline.
@@ -1385,7 +1574,8 @@ bool D3D12TextureCache::LoadTextureDataFromResidentMemoryImpl(Texture& texture,
   uint32_t block_width = guest_format_info->block_width;
   uint32_t block_height = guest_format_info->block_height;
   uint32_t bytes_per_block = guest_format_info->bytes_per_block();
-  uint32_t level_first = load_base ? 0 : 1;
+  uint32_t level_first = load_base ? 0 : texture.mips_first_level();
+  assert_true(!load_base || !load_mips || texture.mips_first_level() == 1);
   uint32_t level_last = load_mips ? texture_key.mip_max_level : 0;
   assert_true(level_first <= level_last);
   uint32_t level_packed = guest_layout.packed_level;
@@ -1490,209 +1680,362 @@ bool D3D12TextureCache::LoadTextureDataFromResidentMemoryImpl(Texture& texture,
         level_host_slice_size;
     copy_buffer_size += level_host_slice_size * array_size;
   }
-  D3D12_RESOURCE_STATES copy_buffer_state =
-      D3D12_RESOURCE_STATE_UNORDERED_ACCESS;
-  ID3D12Resource* copy_buffer = command_processor_.RequestScratchGPUBuffer(
-      uint32_t(copy_buffer_size), copy_buffer_state);
-  if (copy_buffer == nullptr) {
+  if (copy_buffer_size > kTextureStorageUploadBufferPageSize) {
+    store_host_data = false;
+    if (host_data) {
+      return false;
+    }
+  }
+  if (host_data && host_data_size != copy_buffer_size) {
+    // Stored with a different layout.
     return false;
   }
-
-  // Begin loading.
-  // May use different buffers for scaled base and mips, and also addressability
-  // of more than 128 * 2^20 (2^D3D12_REQ_BUFFER_RESOURCE_TEXEL_COUNT_2_TO_EXP)
-  // texels is not mandatory - need two separate UAV descriptors for base and
-  // mips.
-  // Destination.
-  uint32_t descriptor_count = 1;
-  if (texture_resolution_scaled) {
-    // Source - base and mips, one or both.
-    descriptor_count += (level_first == 0 && level_last != 0) ? 2 : 1;
-  } else {
-    // Source - shared memory.
-    if (!bindless_resources_used_) {
-      ++descriptor_count;
+  D3D12_RESOURCE_STATES copy_buffer_state =
+      D3D12_RESOURCE_STATE_UNORDERED_ACCESS;
+  ID3D12Resource* copy_buffer = nullptr;
+  // Non-zero only for the upload buffer with the stored host data.
+  size_t copy_buffer_offset = 0;
+  if (host_data) {
+    if (!texture_storage_upload_buffer_pool_) {
+      texture_storage_upload_buffer_pool_ =
+          std::make_unique<ui::d3d12::D3D12UploadBufferPool>(
+              command_processor_.GetD3D12Provider(),
+              kTextureStorageUploadBufferPageSize);
+    }
+    uint8_t* host_data_mapping = texture_storage_upload_buffer_pool_->Request(
+        command_processor_.GetCurrentSubmission(), size_t(copy_buffer_size),
+        D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT, &copy_buffer,
+        &copy_buffer_offset, nullptr);
+    if (!host_data_mapping) {
+      return false;
+    }
+    std::memcpy(host_data_mapping, host_data, host_data_size);
+  } else if (async) {
+    copy_buffer = RequestAsyncLoadScratchBuffer(uint32_t(copy_buffer_size));
+    if (!copy_buffer) {
+      // Let the direct queue load it instead.
+      async = false;
     }
   }
-  ui::d3d12::util::DescriptorCpuGpuHandlePair descriptors_allocated[3];
-  if (!command_processor_.RequestOneUseSingleViewDescriptors(
-          descriptor_count, descriptors_allocated)) {
-    command_processor_.ReleaseScratchGPUBuffer(copy_buffer, copy_buffer_state);
-    return false;
+  if (!host_data && !async) {
+    copy_buffer = command_processor_.RequestScratchGPUBuffer(
+        uint32_t(copy_buffer_size), copy_buffer_state);
+    if (copy_buffer == nullptr) {
+      return false;
+    }
   }
-  uint32_t descriptor_write_index = 0;
-  command_processor_.SetExternalPipeline(pipeline);
-  command_list.D3DSetComputeRootSignature(load_root_signature_.Get());
-  // Set up the destination descriptor.
-  assert_true(descriptor_write_index < descriptor_count);
-  ui::d3d12::util::DescriptorCpuGpuHandlePair descriptor_dest =
-      descriptors_allocated[descriptor_write_index++];
-  ui::d3d12::util::CreateBufferTypedUAV(
-      device, descriptor_dest.first, copy_buffer,
-      ui::d3d12::util::GetUintPow2DXGIFormat(load_shader_info.dest_bpe_log2),
-      uint32_t(copy_buffer_size) >> load_shader_info.dest_bpe_log2);
-  command_list.D3DSetComputeRootDescriptorTable(2, descriptor_dest.second);
-  // Set up the unscaled source descriptor (scaled needs two descriptors that
-  // depend on the buffer being current, so they will be set later - for mips,
-  // after loading the base is done).
-  if (!texture_resolution_scaled) {
-    D3D12SharedMemory& d3d12_shared_memory =
-        static_cast<D3D12SharedMemory&>(shared_memory());
-    d3d12_shared_memory.UseForReading();
-    ui::d3d12::util::DescriptorCpuGpuHandlePair descriptor_unscaled_source;
-    if (bindless_resources_used_) {
-      descriptor_unscaled_source =
-          command_processor_.GetSharedMemoryUintPow2BindlessSRVHandlePair(
-              load_shader_info.source_bpe_log2);
-    } else {
-      assert_true(descriptor_write_index < descriptor_count);
-      descriptor_unscaled_source =
-          descriptors_allocated[descriptor_write_index++];
-      d3d12_shared_memory.WriteUintPow2SRVDescriptor(
-          descriptor_unscaled_source.first, load_shader_info.source_bpe_log2);
+  auto release_copy_buffer = [&]() {
+    // The asynchronous loading scratch buffers are reclaimed by the
+    // submission, and the upload buffers are owned by the pool.
+    if (!host_data && !async) {
+      command_processor_.ReleaseScratchGPUBuffer(copy_buffer,
+                                                 copy_buffer_state);
     }
-    command_list.D3DSetComputeRootDescriptorTable(
-        1, descriptor_unscaled_source.second);
-  }
-
-  // Submit the copy buffer population commands.
-
-  auto& cbuffer_pool = command_processor_.GetConstantBufferPool();
-  LoadConstants load_constants;
-  // 3 bits for each.
-  assert_true(texture_resolution_scale_x <= 7);
-  assert_true(texture_resolution_scale_y <= 7);
-  load_constants.is_tiled_3d_endian_scale =
-      uint32_t(texture_key.tiled) | (uint32_t(is_3d) << 1) |
-      (uint32_t(texture_key.endianness) << 2) |
-      (texture_resolution_scale_x << 4) | (texture_resolution_scale_y << 7);
-
-  // The loop is slices within levels because the base and the levels may need
-  // different portions of the scaled resolve virtual address space to be
-  // available through buffers, and to create a descriptor, the buffer start
-  // address is required - which may be different for base and mips.
-  bool scaled_mips_source_set_up = false;
-  uint32_t guest_x_blocks_per_group_log2 =
-      load_shader_info.GetGuestXBlocksPerGroupLog2();
-  for (uint32_t loop_level = loop_level_first; loop_level <= loop_level_last;
-       ++loop_level) {
-    bool is_base = loop_level == 0;
-    uint32_t level = (level_packed == 0) ? 0 : loop_level;
+  };
 
-    uint32_t guest_address =
-        (is_base ? texture_key.base_page : texture_key.mip_page) << 12;
-
-    // Set up the base or mips source, also making it accessible if loading from
-    // scaled resolve memory.
-    if (texture_resolution_scaled && (is_base || !scaled_mips_source_set_up)) {
-      uint32_t guest_size_unscaled = is_base ? d3d12_texture.GetGuestBaseSize()
-                                             : d3d12_texture.GetGuestMipsSize();
-      if (!MakeScaledResolveRangeCurrent(guest_address, guest_size_unscaled,
-                                         load_shader_info.source_bpe_log2)) {
-        command_processor_.ReleaseScratchGPUBuffer(copy_buffer,
-                                                   copy_buffer_state);
+  DeferredCommandList& command_list =
+      async ? *async_load_deferred_command_list_
+            : command_processor_.GetDeferredCommandList();
+  if (!async) {
+    command_processor_.SwitchGpuTimestampCategory(
+        GpuTimestampProfiler::Category::kTextureLoads);
+  }
+
+  // The stored host data is already in the layout of the copy buffer.
+  if (!host_data) {
+    // Begin loading.
+    // May use different buffers for scaled base and mips, and also
+    // addressability of more than 128 * 2^20
+    // (2^D3D12_REQ_BUFFER_RESOURCE_TEXEL_COUNT_2_TO_EXP) texels is not
+    // mandatory - need two separate UAV descriptors for base and mips.
+    // Destination.
+    uint32_t descriptor_count = 1;
+    if (texture_resolution_scaled) {
+      // Source - base and mips, one or both.
+      descriptor_count += (level_first == 0 && level_last != 0) ? 2 : 1;
+    } else {
+      // Source - shared memory.
+      if (!bindless_resources_used_) {
+        ++descriptor_count;
+      }
+    }
+    ui::d3d12::util::DescriptorCpuGpuHandlePair descriptors_allocated[3];
+    if (async) {
+      // Source - the copy of the guest memory, not the shared memory.
+      if (bindless_resources_used_) {
+        ++descriptor_count;
+      }
+      uint32_t descriptor_index;
+      uint64_t descriptor_heap_index =
+          async_load_descriptor_heap_pool_->Request(
+              command_processor_.GetCurrentSubmission(),
+              async_load_descriptor_heap_index_, descriptor_count,
+              descriptor_count, descriptor_index);
+      if (descriptor_heap_index ==
+          ui::d3d12::D3D12DescriptorHeapPool::kHeapIndexInvalid) {
+        return false;
+      }
+      if (async_load_descriptor_heap_index_ != descriptor_heap_index) {
+        async_load_descriptor_heap_index_ = descriptor_heap_index;
+        async_load_deferred_command_list_->SetDescriptorHeaps(
+            async_load_descriptor_heap_pool_->GetLastRequestHeap(), nullptr);
+      }
+      const ui::d3d12::D3D12Provider& provider =
+          command_processor_.GetD3D12Provider();
+      for (uint32_t i = 0; i < descriptor_count; ++i) {
+        descriptors_allocated[i] = std::make_pair(
+            provider.OffsetViewDescriptor(
+                async_load_descriptor_heap_pool_->GetLastRequestHeapCPUStart(),
+                descriptor_index + i),
+            provider.OffsetViewDescriptor(
+                async_load_descriptor_heap_pool_->GetLastRequestHeapGPUStart(),
+                descriptor_index + i));
+      }
+    } else if (!command_processor_.RequestOneUseSingleViewDescriptors(
+                   descriptor_count, descriptors_allocated)) {
+      release_copy_buffer();
+      return false;
+    }
+    uint32_t descriptor_write_index = 0;
+    if (async) {
+      // The scratch buffers decay to the common state after every submission.
+      D3D12_RESOURCE_BARRIER copy_buffer_barrier;
+      copy_buffer_barrier.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
+      copy_buffer_barrier.Flags = D3D12_RESOURCE_BARRIER_FLAG_NONE;
+      copy_buffer_barrier.Transition.pResource = copy_buffer;
+      copy_buffer_barrier.Transition.Subresource =
+          D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
+      copy_buffer_barrier.Transition.StateBefore = D3D12_RESOURCE_STATE_COMMON;
+      copy_buffer_barrier.Transition.StateAfter = copy_buffer_state;
+      command_list.D3DResourceBarrier(1, &copy_buffer_barrier);
+      command_list.D3DSetPipelineState(pipeline);
+    } else {
+      command_processor_.SetExternalPipeline(pipeline);
+    }
+    command_list.D3DSetComputeRootSignature(load_root_signature_.Get());
+    // Set up the destination descriptor.
+    assert_true(descriptor_write_index < descriptor_count);
+    ui::d3d12::util::DescriptorCpuGpuHandlePair descriptor_dest =
+        descriptors_allocated[descriptor_write_index++];
+    ui::d3d12::util::CreateBufferTypedUAV(
+        device, descriptor_dest.first, copy_buffer,
+        ui::d3d12::util::GetUintPow2DXGIFormat(load_shader_info.dest_bpe_log2),
+        uint32_t(copy_buffer_size) >> load_shader_info.dest_bpe_log2);
+    command_list.D3DSetComputeRootDescriptorTable(2, descriptor_dest.second);
+    // Set up the unscaled source descriptor (scaled needs two descriptors that
+    // depend on the buffer being current, so they will be set later - for mips,
+    // after loading the base is done).
+    // For asynchronous loading, offsets of the base and the mips in the copy of
+    // the guest memory.
+    uint32_t async_source_base_offset = 0, async_source_mips_offset = 0;
+    if (async) {
+      // Copy the guest data to the upload buffer.
+      uint32_t async_source_base_size =
+          load_base ? d3d12_texture.GetGuestBaseSize() : 0;
+      uint32_t async_source_mips_size =
+          load_mips ? d3d12_texture.GetGuestMipsSize() : 0;
+      // Aligned to the largest element size for the typed SRV.
+      async_source_mips_offset =
+          xe::align(async_source_base_size, UINT32_C(16));
+      uint32_t async_source_size =
+          async_source_mips_offset + async_source_mips_size;
+      ID3D12Resource* async_source_buffer;
+      size_t async_source_buffer_offset;
+      uint8_t* async_source_mapping = async_load_upload_buffer_pool_->Request(
+          command_processor_.GetCurrentSubmission(), async_source_size,
+          UINT32_C(16), &async_source_buffer, &async_source_buffer_offset,
+          nullptr);
+      if (!async_source_mapping) {
         return false;
       }
-      TransitionCurrentScaledResolveRange(
-          D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+      const SharedMemory& memory = shared_memory();
+      if (async_source_base_size) {
+        std::memcpy(async_source_mapping,
+                    memory.TranslatePhysical(texture_key.base_page << 12),
+                    async_source_base_size);
+      }
+      if (async_source_mips_size) {
+        std::memcpy(async_source_mapping + async_source_mips_offset,
+                    memory.TranslatePhysical(texture_key.mip_page << 12),
+                    async_source_mips_size);
+      }
       assert_true(descriptor_write_index < descriptor_count);
-      ui::d3d12::util::DescriptorCpuGpuHandlePair descriptor_scaled_source =
+      ui::d3d12::util::DescriptorCpuGpuHandlePair descriptor_async_source =
           descriptors_allocated[descriptor_write_index++];
-      CreateCurrentScaledResolveRangeUintPow2SRV(
-          descriptor_scaled_source.first, load_shader_info.source_bpe_log2);
+      uint32_t source_bpe_log2 = load_shader_info.source_bpe_log2;
+      ui::d3d12::util::CreateBufferTypedSRV(
+          device, descriptor_async_source.first, async_source_buffer,
+          ui::d3d12::util::GetUintPow2DXGIFormat(source_bpe_log2),
+          xe::align(async_source_size, UINT32_C(1) << source_bpe_log2) >>
+              source_bpe_log2,
+          uint32_t(async_source_buffer_offset) >> source_bpe_log2);
       command_list.D3DSetComputeRootDescriptorTable(
-          1, descriptor_scaled_source.second);
-      if (!is_base) {
-        scaled_mips_source_set_up = true;
+          1, descriptor_async_source.second);
+    } else if (!texture_resolution_scaled) {
+      D3D12SharedMemory& d3d12_shared_memory =
+          static_cast<D3D12SharedMemory&>(shared_memory());
+      d3d12_shared_memory.UseForReading();
+      ui::d3d12::util::DescriptorCpuGpuHandlePair descriptor_unscaled_source;
+      if (bindless_resources_used_) {
+        descriptor_unscaled_source =
+            command_processor_.GetSharedMemoryUintPow2BindlessSRVHandlePair(
+                load_shader_info.source_bpe_log2);
+      } else {
+        assert_true(descriptor_write_index < descriptor_count);
+        descriptor_unscaled_source =
+            descriptors_allocated[descriptor_write_index++];
+        d3d12_shared_memory.WriteUintPow2SRVDescriptor(
+            descriptor_unscaled_source.first, load_shader_info.source_bpe_log2);
       }
+      command_list.D3DSetComputeRootDescriptorTable(
+          1, descriptor_unscaled_source.second);
     }
 
-    if (texture_resolution_scaled) {
-      // Offset already applied in the buffer because more than 512 MB can't be
-      // directly addresses as R32 on some hardware (above
-      // 2^D3D12_REQ_BUFFER_RESOURCE_TEXEL_COUNT_2_TO_EXP).
-      load_constants.guest_offset = 0;
-    } else {
-      load_constants.guest_offset = guest_address;
-    }
-    if (!is_base) {
-      load_constants.guest_offset +=
-          guest_layout.mip_offsets_bytes[level] *
+    // Submit the copy buffer population commands.
+
+    auto& cbuffer_pool = command_processor_.GetConstantBufferPool();
+    LoadConstants load_constants;
+    // 3 bits for each.
+    assert_true(texture_resolution_scale_x <= 7);
+    assert_true(texture_resolution_scale_y <= 7);
+    load_constants.is_tiled_3d_endian_scale =
+        uint32_t(texture_key.tiled) | (uint32_t(is_3d) << 1) |
+        (uint32_t(texture_key.endianness) << 2) |
+        (texture_resolution_scale_x << 4) | (texture_resolution_scale_y << 7);
+
+    // The loop is slices within levels because the base and the levels may need
+    // different portions of the scaled resolve virtual address space to be
+    // available through buffers, and to create a descriptor, the buffer start
+    // address is required - which may be different for base and mips.
+    bool scaled_mips_source_set_up = false;
+    uint32_t guest_x_blocks_per_group_log2 =
+        load_shader_info.GetGuestXBlocksPerGroupLog2();
+    for (uint32_t loop_level = loop_level_first; loop_level <= loop_level_last;
+         ++loop_level) {
+      bool is_base = loop_level == 0;
+      uint32_t level = (level_packed == 0) ? 0 : loop_level;
+
+      uint32_t guest_address =
+          (is_base ? texture_key.base_page : texture_key.mip_page) << 12;
+
+      // Set up the base or mips source, also making it accessible if loading
+      // from scaled resolve memory.
+      if (texture_resolution_scaled &&
+          (is_base || !scaled_mips_source_set_up)) {
+        uint32_t guest_size_unscaled = is_base
+                                           ? d3d12_texture.GetGuestBaseSize()
+                                           : d3d12_texture.GetGuestMipsSize();
+        if (!MakeScaledResolveRangeCurrent(guest_address, guest_size_unscaled,
+                                           load_shader_info.source_bpe_log2)) {
+          release_copy_buffer();
+          return false;
+        }
+        TransitionCurrentScaledResolveRange(
+            D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE);
+        assert_true(descriptor_write_index < descriptor_count);
+        ui::d3d12::util::DescriptorCpuGpuHandlePair descriptor_scaled_source =
+            descriptors_allocated[descriptor_write_index++];
+        CreateCurrentScaledResolveRangeUintPow2SRV(
+            descriptor_scaled_source.first, load_shader_info.source_bpe_log2);
+        command_list.D3DSetComputeRootDescriptorTable(
+            1, descriptor_scaled_source.second);
+        if (!is_base) {
+          scaled_mips_source_set_up = true;
+        }
+      }
+
+      if (async) {
+        load_constants.guest_offset =
+            is_base ? async_source_base_offset : async_source_mips_offset;
+      } else if (texture_resolution_scaled) {
+        // Offset already applied in the buffer because more than 512 MB can't
+        // be directly addresses as R32 on some hardware (above
+        // 2^D3D12_REQ_BUFFER_RESOURCE_TEXEL_COUNT_2_TO_EXP).
+        load_constants.guest_offset = 0;
+      } else {
+        load_constants.guest_offset = guest_address;
+      }
+      if (!is_base) {
+        load_constants.guest_offset +=
+            guest_layout.mip_offsets_bytes[level] *
+            (texture_resolution_scale_x * texture_resolution_scale_y);
+      }
+      const texture_util::TextureGuestLayout::Level& level_guest_layout =
+          is_base ? guest_layout.base : guest_layout.mips[level];
+      uint32_t level_guest_pitch = level_guest_layout.row_pitch_bytes;
+      if (texture_key.tiled) {
+        // Shaders expect pitch in blocks for tiled textures.
+        level_guest_pitch /= bytes_per_block;
+        assert_zero(level_guest_pitch & (xenos::kTextureTileWidthHeight - 1));
+      }
+      load_constants.guest_pitch_aligned = level_guest_pitch;
+      load_constants.guest_z_stride_block_rows_aligned =
+          level_guest_layout.z_slice_stride_block_rows;
+      assert_true(dimension != xenos::DataDimension::k3D ||
+                  !(load_constants.guest_z_stride_block_rows_aligned &
+                    (xenos::kTextureTileWidthHeight - 1)));
+
+      uint32_t level_width, level_height, level_depth;
+      if (level == level_packed) {
+        // This is the packed mip tail, containing not only the specified level,
+        // but also other levels at different offsets - load the entire needed
+        // extents.
+        level_width = level_guest_layout.x_extent_blocks * block_width;
+        level_height = level_guest_layout.y_extent_blocks * block_height;
+        level_depth = level_guest_layout.z_extent;
+      } else {
+        level_width = std::max(width >> level, uint32_t(1));
+        level_height = std::max(height >> level, uint32_t(1));
+        level_depth = std::max(depth >> level, uint32_t(1));
+      }
+      load_constants.size_blocks[0] = (level_width + (block_width - 1)) /
+                                      block_width * texture_resolution_scale_x;
+      load_constants.size_blocks[1] = (level_height + (block_height - 1)) /
+                                      block_height * texture_resolution_scale_y;
+      load_constants.size_blocks[2] = level_depth;
+      load_constants.height_texels = level_height;
+
+      uint32_t group_count_x =
+          (load_constants.size_blocks[0] +
+           ((UINT32_C(1) << guest_x_blocks_per_group_log2) - 1)) >>
+          guest_x_blocks_per_group_log2;
+      uint32_t group_count_y =
+          (load_constants.size_blocks[1] +
+           ((UINT32_C(1) << kLoadGuestYBlocksPerGroupLog2) - 1)) >>
+          kLoadGuestYBlocksPerGroupLog2;
+
+      const D3D12_PLACED_SUBRESOURCE_FOOTPRINT& level_host_slice_layout =
+          is_base ? host_slice_layout_base : host_slice_layouts_mips[level];
+      uint32_t host_slice_size = uint32_t(
+          is_base ? host_slice_size_base : host_slice_sizes_mips[level]);
+      load_constants.host_offset = uint32_t(level_host_slice_layout.Offset);
+      load_constants.host_pitch = level_host_slice_layout.Footprint.RowPitch;
+
+      uint32_t level_array_slice_stride_bytes_scaled =
+          level_guest_layout.array_slice_stride_bytes *
           (texture_resolution_scale_x * texture_resolution_scale_y);
-    }
-    const texture_util::TextureGuestLayout::Level& level_guest_layout =
-        is_base ? guest_layout.base : guest_layout.mips[level];
-    uint32_t level_guest_pitch = level_guest_layout.row_pitch_bytes;
-    if (texture_key.tiled) {
-      // Shaders expect pitch in blocks for tiled textures.
-      level_guest_pitch /= bytes_per_block;
-      assert_zero(level_guest_pitch & (xenos::kTextureTileWidthHeight - 1));
-    }
-    load_constants.guest_pitch_aligned = level_guest_pitch;
-    load_constants.guest_z_stride_block_rows_aligned =
-        level_guest_layout.z_slice_stride_block_rows;
-    assert_true(dimension != xenos::DataDimension::k3D ||
-                !(load_constants.guest_z_stride_block_rows_aligned &
-                  (xenos::kTextureTileWidthHeight - 1)));
-
-    uint32_t level_width, level_height, level_depth;
-    if (level == level_packed) {
-      // This is the packed mip tail, containing not only the specified level,
-      // but also other levels at different offsets - load the entire needed
-      // extents.
-      level_width = level_guest_layout.x_extent_blocks * block_width;
-      level_height = level_guest_layout.y_extent_blocks * block_height;
-      level_depth = level_guest_layout.z_extent;
-    } else {
-      level_width = std::max(width >> level, uint32_t(1));
-      level_height = std::max(height >> level, uint32_t(1));
-      level_depth = std::max(depth >> level, uint32_t(1));
-    }
-    load_constants.size_blocks[0] = (level_width + (block_width - 1)) /
-                                    block_width * texture_resolution_scale_x;
-    load_constants.size_blocks[1] = (level_height + (block_height - 1)) /
-                                    block_height * texture_resolution_scale_y;
-    load_constants.size_blocks[2] = level_depth;
-    load_constants.height_texels = level_height;
-
-    uint32_t group_count_x =
-        (load_constants.size_blocks[0] +
-         ((UINT32_C(1) << guest_x_blocks_per_group_log2) - 1)) >>
-        guest_x_blocks_per_group_log2;
-    uint32_t group_count_y =
-        (load_constants.size_blocks[1] +
-         ((UINT32_C(1) << kLoadGuestYBlocksPerGroupLog2) - 1)) >>
-        kLoadGuestYBlocksPerGroupLog2;
-
-    const D3D12_PLACED_SUBRESOURCE_FOOTPRINT& level_host_slice_layout =
-        is_base ? host_slice_layout_base : host_slice_layouts_mips[level];
-    uint32_t host_slice_size =
-        uint32_t(is_base ? host_slice_size_base : host_slice_sizes_mips[level]);
-    load_constants.host_offset = uint32_t(level_host_slice_layout.Offset);
-    load_constants.host_pitch = level_host_slice_layout.Footprint.RowPitch;
-
-    uint32_t level_array_slice_stride_bytes_scaled =
-        level_guest_layout.array_slice_stride_bytes *
-        (texture_resolution_scale_x * texture_resolution_scale_y);
-    for (uint32_t slice = 0; slice < array_size; ++slice) {
-      D3D12_GPU_VIRTUAL_ADDRESS cbuffer_gpu_address;
-      uint8_t* cbuffer_mapping = cbuffer_pool.Request(
-          command_processor_.GetCurrentFrame(), sizeof(load_constants),
-          D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT, nullptr, nullptr,
-          &cbuffer_gpu_address);
-      if (cbuffer_mapping == nullptr) {
-        command_processor_.ReleaseScratchGPUBuffer(copy_buffer,
-                                                   copy_buffer_state);
-        return false;
+      for (uint32_t slice = 0; slice < array_size; ++slice) {
+        D3D12_GPU_VIRTUAL_ADDRESS cbuffer_gpu_address;
+        uint8_t* cbuffer_mapping = cbuffer_pool.Request(
+            command_processor_.GetCurrentFrame(), sizeof(load_constants),
+            D3D12_CONSTANT_BUFFER_DATA_PLACEMENT_ALIGNMENT, nullptr, nullptr,
+            &cbuffer_gpu_address);
+        if (cbuffer_mapping == nullptr) {
+          release_copy_buffer();
+          return false;
+        }
+        std::memcpy(cbuffer_mapping, &load_constants, sizeof(load_constants));
+        command_list.D3DSetComputeRootConstantBufferView(0,
+                                                         cbuffer_gpu_address);
+        assert_true(copy_buffer_state == D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
+        if (!async) {
+          command_processor_.SubmitBarriers();
+        }
+        command_list.D3DDispatch(group_count_x, group_count_y,
+                                 load_constants.size_blocks[2]);
+        load_constants.guest_offset += level_array_slice_stride_bytes_scaled;
+        load_constants.host_offset += host_slice_size;
       }
-      std::memcpy(cbuffer_mapping, &load_constants, sizeof(load_constants));
-      command_list.D3DSetComputeRootConstantBufferView(0, cbuffer_gpu_address);
-      assert_true(copy_buffer_state == D3D12_RESOURCE_STATE_UNORDERED_ACCESS);
-      command_processor_.SubmitBarriers();
-      command_list.D3DDispatch(group_count_x, group_count_y,
-                               load_constants.size_blocks[2]);
-      load_constants.guest_offset += level_array_slice_stride_bytes_scaled;
-      load_constants.host_offset += host_slice_size;
     }
   }
 
@@ -1701,14 +2044,30 @@ bool D3D12TextureCache::LoadTextureDataFromResidentMemoryImpl(Texture& texture,
 
   // Submit copying from the copy buffer to the host texture.
   ID3D12Resource* texture_resource = d3d12_texture.resource();
-  command_processor_.PushTransitionBarrier(
-      texture_resource,
-      d3d12_texture.SetResourceState(D3D12_RESOURCE_STATE_COPY_DEST),
-      D3D12_RESOURCE_STATE_COPY_DEST);
-  command_processor_.PushTransitionBarrier(copy_buffer, copy_buffer_state,
-                                           D3D12_RESOURCE_STATE_COPY_SOURCE);
+  D3D12_RESOURCE_BARRIER async_barrier;
+  async_barrier.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
+  async_barrier.Flags = D3D12_RESOURCE_BARRIER_FLAG_NONE;
+  async_barrier.Transition.Subresource =
+      D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
+  if (async) {
+    // The texture is already in the copy destination state.
+    async_barrier.Transition.pResource = copy_buffer;
+    async_barrier.Transition.StateBefore = copy_buffer_state;
+    async_barrier.Transition.StateAfter = D3D12_RESOURCE_STATE_COPY_SOURCE;
+    command_list.D3DResourceBarrier(1, &async_barrier);
+  } else {
+    command_processor_.PushTransitionBarrier(
+        texture_resource,
+        d3d12_texture.SetResourceState(D3D12_RESOURCE_STATE_COPY_DEST),
+        D3D12_RESOURCE_STATE_COPY_DEST);
+    // Upload buffers are always in the generic read state.
+    if (!host_data) {
+      command_processor_.PushTransitionBarrier(
+          copy_buffer, copy_buffer_state, D3D12_RESOURCE_STATE_COPY_SOURCE);
+    }
+    command_processor_.SubmitBarriers();
+  }
   copy_buffer_state = D3D12_RESOURCE_STATE_COPY_SOURCE;
-  command_processor_.SubmitBarriers();
   uint32_t texture_level_count = texture_key.mip_max_level + 1;
   D3D12_TEXTURE_COPY_LOCATION location_source, location_dest;
   location_source.pResource = copy_buffer;
@@ -1719,6 +2078,7 @@ bool D3D12TextureCache::LoadTextureDataFromResidentMemoryImpl(Texture& texture,
     uint32_t guest_level = std::min(level, level_packed);
     location_source.PlacedFootprint =
         level ? host_slice_layouts_mips[guest_level] : host_slice_layout_base;
+    location_source.PlacedFootprint.Offset += copy_buffer_offset;
     location_dest.SubresourceIndex = level;
     UINT64 host_slice_size =
         level ? host_slice_sizes_mips[guest_level] : host_slice_size_base;
@@ -1758,11 +2118,241 @@ bool D3D12TextureCache::LoadTextureDataFromResidentMemoryImpl(Texture& texture,
     }
   }
 
-  command_processor_.ReleaseScratchGPUBuffer(copy_buffer, copy_buffer_state);
+  if (async) {
+    // Leave the texture in the state that can be transitioned from on the
+    // direct queue to any other, and make the direct queue wait for the
+    // loading in the current submission.
+    async_barrier.Transition.pResource = texture_resource;
+    async_barrier.Transition.StateBefore = D3D12_RESOURCE_STATE_COPY_DEST;
+    async_barrier.Transition.StateAfter = D3D12_RESOURCE_STATE_COMMON;
+    command_list.D3DResourceBarrier(1, &async_barrier);
+    d3d12_texture.SetResourceState(D3D12_RESOURCE_STATE_COMMON);
+    async_loads_recorded_ = true;
+  }
+  if (store_host_data) {
+    const ui::d3d12::D3D12Provider& provider =
+        command_processor_.GetD3D12Provider();
+    D3D12_RESOURCE_DESC readback_buffer_desc;
+    ui::d3d12::util::FillBufferResourceDesc(
+        readback_buffer_desc, copy_buffer_size, D3D12_RESOURCE_FLAG_NONE);
+    Microsoft::WRL::ComPtr<ID3D12Resource> readback_buffer;
+    if (SUCCEEDED(provider.GetDevice()->CreateCommittedResource(
+            &ui::d3d12::util::kHeapPropertiesReadback,
+            provider.GetHeapFlagCreateNotZeroed(), &readback_buffer_desc,
+            D3D12_RESOURCE_STATE_COPY_DEST, nullptr,
+            IID_PPV_ARGS(&readback_buffer)))) {
+      command_list.D3DCopyBufferRegion(readback_buffer.Get(), 0, copy_buffer,
+                                       0, copy_buffer_size);
+      TextureStorageReadback& readback =
+          texture_storage_readbacks_.emplace_back();
+      readback.submission = command_processor_.GetCurrentSubmission();
+      readback.key = texture_storage_key;
+      readback.buffer = std::move(readback_buffer);
+      readback.size = uint32_t(copy_buffer_size);
+    }
+  }
+  release_copy_buffer();
+  d3d12_texture.SetDataLoaded();
+
+  return true;
+}
+
+bool D3D12TextureCache::LoadTextureDataFromHostDataImpl(Texture& texture,
+                                                        const uint8_t* data,
+                                                        uint32_t size) {
+  // The stored data is of the whole texture.
+  return LoadTextureDataImpl(texture, true, texture.GetGuestMipsSize() != 0,
+                             data, size);
+}
 
+bool D3D12TextureCache::GetTextureStorageHostConfig(const char*& name_out,
+                                                    uint64_t& hash_out) const {
+  // Anything that affects the host formats and the layout of the data written
+  // by the load shaders.
+  struct {
+    uint32_t version;
+    uint32_t unaligned_block_textures_supported;
+  } host_config;
+  std::memset(&host_config, 0, sizeof(host_config));
+  host_config.version = 1;
+  host_config.unaligned_block_textures_supported =
+      uint32_t(command_processor_.GetD3D12Provider()
+                   .AreUnalignedBlockTexturesSupported());
+  name_out = "d3d12";
+  hash_out = XXH3_64bits(&host_config, sizeof(host_config));
   return true;
 }
 
+bool D3D12TextureCache::CopyTextureDataImpl(Texture& texture,
+                                            Texture& source) {
+  D3D12Texture& d3d12_texture = static_cast<D3D12Texture&>(texture);
+  D3D12Texture& d3d12_source = static_cast<D3D12Texture&>(source);
+
+  // Both textures will be used by the command list.
+  d3d12_texture.MarkAsUsed();
+  d3d12_source.MarkAsUsed();
+
+  // The keys only differ in the addresses, so the resources have the same
+  // descriptions, and all the subresources can be copied at once.
+  ID3D12Resource* texture_resource = d3d12_texture.resource();
+  ID3D12Resource* source_resource = d3d12_source.resource();
+  command_processor_.PushTransitionBarrier(
+      texture_resource,
+      d3d12_texture.SetResourceState(D3D12_RESOURCE_STATE_COPY_DEST),
+      D3D12_RESOURCE_STATE_COPY_DEST);
+  command_processor_.PushTransitionBarrier(
+      source_resource,
+      d3d12_source.SetResourceState(D3D12_RESOURCE_STATE_COPY_SOURCE),
+      D3D12_RESOURCE_STATE_COPY_SOURCE);
+  command_processor_.SubmitBarriers();
+  command_processor_.GetDeferredCommandList().D3DCopyResource(
+      texture_resource, source_resource);
+  d3d12_texture.SetDataLoaded();
+
+  return true;
+}
+
+bool D3D12TextureCache::QueryHostMemoryBudget(uint64_t& budget_out,
+                                              uint64_t& usage_out) const {
+  return command_processor_.GetD3D12Provider().QueryLocalVideoMemoryInfo(
+      budget_out, usage_out);
+}
+
+bool D3D12TextureCache::InitializeAsyncLoading() {
+  const ui::d3d12::D3D12Provider& provider =
+      command_processor_.GetD3D12Provider();
+  ID3D12Device* device = provider.GetDevice();
+
+  D3D12_COMMAND_QUEUE_DESC queue_desc;
+  queue_desc.Type = D3D12_COMMAND_LIST_TYPE_COMPUTE;
+  queue_desc.Priority = D3D12_COMMAND_QUEUE_PRIORITY_NORMAL;
+  queue_desc.Flags = D3D12_COMMAND_QUEUE_FLAG_NONE;
+  queue_desc.NodeMask = 0;
+  if (FAILED(device->CreateCommandQueue(&queue_desc,
+                                        IID_PPV_ARGS(&async_load_queue_)))) {
+    return false;
+  }
+  if (FAILED(device->CreateFence(0, D3D12_FENCE_FLAG_NONE,
+                                 IID_PPV_ARGS(&async_load_fence_)))) {
+    return false;
+  }
+  AsyncLoadCommandAllocator& command_allocator =
+      async_load_command_allocators_.emplace_back();
+  command_allocator.last_usage_submission = 0;
+  if (FAILED(device->CreateCommandAllocator(
+          D3D12_COMMAND_LIST_TYPE_COMPUTE,
+          IID_PPV_ARGS(&command_allocator.command_allocator)))) {
+    return false;
+  }
+  if (FAILED(device->CreateCommandList(
+          0, D3D12_COMMAND_LIST_TYPE_COMPUTE,
+          command_allocator.command_allocator.Get(), nullptr,
+          IID_PPV_ARGS(&async_load_command_list_)))) {
+    return false;
+  }
+  // Initially in open state, wait until the first submission.
+  async_load_command_list_->Close();
+
+  async_load_deferred_command_list_ =
+      std::make_unique<DeferredCommandList>(command_processor_, 64 * 1024);
+  async_load_upload_buffer_pool_ =
+      std::make_unique<ui::d3d12::D3D12UploadBufferPool>(
+          provider, kAsyncLoadUploadBufferPageSize);
+  // Created last, its existence means asynchronous loading is available.
+  async_load_descriptor_heap_pool_ =
+      std::make_unique<ui::d3d12::D3D12DescriptorHeapPool>(
+          device, D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV,
+          kAsyncLoadDescriptorHeapSize);
+  return true;
+}
+
+bool D3D12TextureCache::IsAsyncLoadPossible(const D3D12Texture& texture,
+                                            bool load_base, bool load_mips) {
+  if (!async_load_descriptor_heap_pool_) {
+    return false;
+  }
+  const TextureKey& texture_key = texture.key();
+  if (texture_key.scaled_resolve) {
+    return false;
+  }
+  // The texture must not be accessed by commands on the direct queue that may
+  // be executed before or at the same time as the loading on the other queue,
+  // and the state must be usable on the compute queue.
+  if (texture.IsDataLoaded() ||
+      texture.resource_state() != D3D12_RESOURCE_STATE_COPY_DEST) {
+    return false;
+  }
+  uint32_t base_size = load_base ? texture.GetGuestBaseSize() : 0;
+  uint32_t mips_size = load_mips ? texture.GetGuestMipsSize() : 0;
+  if (xe::align(base_size, UINT32_C(16)) + xe::align(mips_size, UINT32_C(16)) >
+      kAsyncLoadUploadBufferPageSize) {
+    return false;
+  }
+  // The data written by the GPU may not be in the guest memory.
+  SharedMemory& shared_memory = TextureCache::shared_memory();
+  if ((base_size && shared_memory.IsRangeWrittenByGpu(
+                        texture_key.base_page << 12, base_size)) ||
+      (mips_size && shared_memory.IsRangeWrittenByGpu(
+                        texture_key.mip_page << 12, mips_size))) {
+    return false;
+  }
+  return true;
+}
+
+ID3D12Resource* D3D12TextureCache::RequestAsyncLoadScratchBuffer(
+    uint32_t size) {
+  uint64_t submission_current = command_processor_.GetCurrentSubmission();
+  uint64_t submission_completed = command_processor_.GetCompletedSubmission();
+  AsyncLoadScratchBuffer* smallest_fitting = nullptr;
+  for (AsyncLoadScratchBuffer& scratch_buffer : async_load_scratch_buffers_) {
+    if (scratch_buffer.last_usage_submission > submission_completed ||
+        scratch_buffer.size < size) {
+      continue;
+    }
+    if (!smallest_fitting || scratch_buffer.size < smallest_fitting->size) {
+      smallest_fitting = &scratch_buffer;
+    }
+  }
+  if (!smallest_fitting) {
+    // Replace a free buffer that is too small, or create a new one.
+    for (AsyncLoadScratchBuffer& scratch_buffer : async_load_scratch_buffers_) {
+      if (scratch_buffer.last_usage_submission <= submission_completed) {
+        smallest_fitting = &scratch_buffer;
+        break;
+      }
+    }
+    if (!smallest_fitting &&
+        async_load_scratch_buffers_.size() >= kMaxAsyncLoadScratchBuffers) {
+      return nullptr;
+    }
+    uint32_t new_size = std::max(xe::next_pow2(size), UINT32_C(1) << 20);
+    D3D12_RESOURCE_DESC buffer_desc;
+    ui::d3d12::util::FillBufferResourceDesc(
+        buffer_desc, new_size, D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS);
+    const ui::d3d12::D3D12Provider& provider =
+        command_processor_.GetD3D12Provider();
+    Microsoft::WRL::ComPtr<ID3D12Resource> buffer;
+    if (FAILED(provider.GetDevice()->CreateCommittedResource(
+            &ui::d3d12::util::kHeapPropertiesDefault,
+            provider.GetHeapFlagCreateNotZeroed(), &buffer_desc,
+            D3D12_RESOURCE_STATE_COMMON, nullptr, IID_PPV_ARGS(&buffer)))) {
+      XELOGE(
+          "D3D12TextureCache: Failed to create a {} MB asynchronous texture "
+          "loading scratch buffer",
+          new_size >> 20);
+      return nullptr;
+    }
+    if (!smallest_fitting) {
+      smallest_fitting = &async_load_scratch_buffers_.emplace_back();
+    }
+    smallest_fitting->buffer = std::move(buffer);
+    smallest_fitting->size = new_size;
+  }
+  smallest_fitting->last_usage_submission = submission_current;
+  // Buffers decay to the common state after ExecuteCommandLists.
+  return smallest_fitting->buffer.Get();
+}
+
 void D3D12TextureCache::UpdateTextureBindingsImpl(
     uint32_t fetch_constant_mask) {
   uint32_t bindings_remaining = fetch_constant_mask;
@@ -11,6 +11,7 @@
 #define XENIA_GPU_D3D12_D3D12_TEXTURE_CACHE_H_
 
 #include <array>
+#include <deque>
 #include <functional>
 #include <memory>
 #include <unordered_map>
@@ -20,12 +21,16 @@
 #include "xenia/base/assert.h"
 #include "xenia/gpu/d3d12/d3d12_shader.h"
 #include "xenia/gpu/d3d12/d3d12_shared_memory.h"
+#include "xenia/gpu/d3d12/deferred_command_list.h"
 #include "xenia/gpu/register_file.h"
 #include "xenia/gpu/texture_cache.h"
 #include "xenia/gpu/texture_util.h"
 #include "xenia/gpu/xenos.h"
 #include "xenia/ui/d3d12/d3d12_api.h"
+#include "xenia/ui/d3d12/d3d12_descriptor_heap_pool.h"
+#include "xenia/ui/d3d12/d3d12_placed_resource_pool.h"
 #include "xenia/ui/d3d12/d3d12_provider.h"
+#include "xenia/ui/d3d12/d3d12_upload_buffer_pool.h"
 
 namespace xe {
 namespace gpu {
@@ -89,6 +94,7 @@ class D3D12TextureCache final : public TextureCache {
 
   void ClearCache() override;
 
+  void CompletedSubmissionUpdated(uint64_t completed_submission_index) override;
   void BeginSubmission(uint64_t new_submission_index) override;
   void BeginFrame() override;
   void EndFrame();
@@ -99,6 +105,15 @@ class D3D12TextureCache final : public TextureCache {
   // binding the actual drawing pipeline.
   void RequestTextures(uint32_t used_texture_mask) override;
 
+  // Executes the texture loads recorded for the current submission on the
+  // asynchronous loading queue, signaling the fence from GetAsyncLoadFence with
+  // the current submission index. If submitted_out is true, the direct queue
+  // must wait for that value before executing the current submission. Returns
+  // false if failed to submit, then it must be retried before ending the
+  // submission.
+  bool SubmitAsyncLoads(bool& submitted_out);
+  ID3D12Fence* GetAsyncLoadFence() const { return async_load_fence_.Get(); }
+
   // Returns whether texture SRV keys stored externally are still valid for the
   // current bindings and host shader binding layout. Both keys and
   // host_shader_bindings must have host_shader_binding_count elements
@@ -541,6 +556,15 @@ class D3D12TextureCache final : public TextureCache {
   // This binds pipelines, allocates descriptors, and copies!
   bool LoadTextureDataFromResidentMemoryImpl(Texture& texture, bool load_base,
                                              bool load_mips) override;
+  bool CopyTextureDataImpl(Texture& texture, Texture& source) override;
+
+  bool GetTextureStorageHostConfig(const char*& name_out,
+                                   uint64_t& hash_out) const override;
+  bool LoadTextureDataFromHostDataImpl(Texture& texture, const uint8_t* data,
+                                       uint32_t size) override;
+
+  bool QueryHostMemoryBudget(uint64_t& budget_out,
+                             uint64_t& usage_out) const override;
 
   void UpdateTextureBindingsImpl(uint32_t fetch_constant_mask) override;
 
@@ -548,6 +572,12 @@ class D3D12TextureCache final : public TextureCache {
   static constexpr uint32_t kLoadGuestXThreadsPerGroupLog2 = 2;
   static constexpr uint32_t kLoadGuestYBlocksPerGroupLog2 = 5;
 
+  // Loads the texture data either by converting the guest data, or, if
+  // host_data is not null, by uploading the stored host data in the layout of
+  // the buffer the conversion writes to.
+  bool LoadTextureDataImpl(Texture& texture, bool load_base, bool load_mips,
+                           const uint8_t* host_data, uint32_t host_data_size);
+
   class D3D12Texture final : public Texture {
    public:
     union SRVDescriptorKey {
@@ -572,19 +602,30 @@ class D3D12TextureCache final : public TextureCache {
       }
     };
 
-    explicit D3D12Texture(D3D12TextureCache& texture_cache,
-                          const TextureKey& key, ID3D12Resource* resource,
-                          D3D12_RESOURCE_STATES resource_state);
+    // If the resource is placed in a heap of the placed resource pool,
+    // placed_allocation is valid and owned by the texture, and
+    // placed_slot_size is its size.
+    explicit D3D12Texture(
+        D3D12TextureCache& texture_cache, const TextureKey& key,
+        ID3D12Resource* resource, D3D12_RESOURCE_STATES resource_state,
+        const ui::d3d12::D3D12PlacedResourcePool::Allocation&
+            placed_allocation = {},
+        uint64_t placed_slot_size = 0);
     ~D3D12Texture();
 
     ID3D12Resource* resource() const { return resource_.Get(); }
 
+    D3D12_RESOURCE_STATES resource_state() const { return resource_state_; }
     D3D12_RESOURCE_STATES SetResourceState(D3D12_RESOURCE_STATES new_state) {
       D3D12_RESOURCE_STATES old_state = resource_state_;
       resource_state_ = new_state;
       return old_state;
     }
 
+    // Whether anything has been written to the resource since its creation.
+    bool IsDataLoaded() const { return data_loaded_; }
+    void SetDataLoaded() { data_loaded_ = true; }
+
     uint32_t GetSRVDescriptorIndex(SRVDescriptorKey descriptor_key) const {
       auto it = srv_descriptors_.find(descriptor_key);
       return it != srv_descriptors_.cend() ? it->second : UINT32_MAX;
@@ -597,7 +638,9 @@ class D3D12TextureCache final : public TextureCache {
 
    private:
     Microsoft::WRL::ComPtr<ID3D12Resource> resource_;
+    ui::d3d12::D3D12PlacedResourcePool::Allocation placed_allocation_;
     D3D12_RESOURCE_STATES resource_state_;
+    bool data_loaded_ = false;
 
     // For bindful - indices in the non-shader-visible descriptor cache for
     // copying to the shader-visible heap (much faster than recreating, which,
@@ -791,9 +834,20 @@ class D3D12TextureCache final : public TextureCache {
 
   xenos::ClampMode NormalizeClampMode(xenos::ClampMode clamp_mode) const;
 
+  bool InitializeAsyncLoading();
+  // Whether the texture can be loaded on the asynchronous loading queue.
+  bool IsAsyncLoadPossible(const D3D12Texture& texture, bool load_base,
+                           bool load_mips);
+  // Returns a buffer in the common state, or nullptr if none available.
+  ID3D12Resource* RequestAsyncLoadScratchBuffer(uint32_t size);
+
   D3D12CommandProcessor& command_processor_;
   bool bindless_resources_used_;
 
+  // Heaps for placing small textures, null if textures are created as
+  // committed resources.
+  std::unique_ptr<ui::d3d12::D3D12PlacedResourcePool> placed_resource_pool_;
+
   Microsoft::WRL::ComPtr<ID3D12RootSignature> load_root_signature_;
   std::array<Microsoft::WRL::ComPtr<ID3D12PipelineState>, kLoadShaderCount>
       load_pipelines_;
@@ -801,6 +855,56 @@ class D3D12TextureCache final : public TextureCache {
   std::array<Microsoft::WRL::ComPtr<ID3D12PipelineState>, kLoadShaderCount>
       load_pipelines_scaled_;
 
+  // Loading of textures that have not been used by the GPU yet (such as
+  // streamed ones) on a compute queue, overlapping the rendering work on the
+  // direct queue submitted before. The guest data is copied on the CPU from
+  // the guest memory into an upload buffer instead of being read from the
+  // shared memory, which is owned by the direct queue. The resources are
+  // reclaimed by the completion of the direct queue submission awaiting the
+  // loads.
+  static constexpr size_t kAsyncLoadUploadBufferPageSize = 16 * 1024 * 1024;
+  static constexpr uint32_t kAsyncLoadDescriptorHeapSize = 1024;
+  static constexpr size_t kMaxAsyncLoadScratchBuffers = 32;
+  Microsoft::WRL::ComPtr<ID3D12CommandQueue> async_load_queue_;
+  Microsoft::WRL::ComPtr<ID3D12Fence> async_load_fence_;
+  Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList> async_load_command_list_;
+  struct AsyncLoadCommandAllocator {
+    Microsoft::WRL::ComPtr<ID3D12CommandAllocator> command_allocator;
+    uint64_t last_usage_submission;
+  };
+  std::vector<AsyncLoadCommandAllocator> async_load_command_allocators_;
+  std::unique_ptr<DeferredCommandList> async_load_deferred_command_list_;
+  bool async_loads_recorded_ = false;
+  std::unique_ptr<ui::d3d12::D3D12UploadBufferPool>
+      async_load_upload_buffer_pool_;
+  std::unique_ptr<ui::d3d12::D3D12DescriptorHeapPool>
+      async_load_descriptor_heap_pool_;
+  // The descriptor heap set in async_load_deferred_command_list_.
+  uint64_t async_load_descriptor_heap_index_ =
+      ui::d3d12::D3D12DescriptorHeapPool::kHeapIndexInvalid;
+  struct AsyncLoadScratchBuffer {
+    Microsoft::WRL::ComPtr<ID3D12Resource> buffer;
+    uint32_t size;
+    uint64_t last_usage_submission;
+  };
+  std::vector<AsyncLoadScratchBuffer> async_load_scratch_buffers_;
+
+  // Persistent texture storage. The converted data is copied to readback
+  // buffers, and is stored when the submission is completed. The stored data
+  // is uploaded through the upload buffer pool, so records larger than a page
+  // are not stored.
+  static constexpr size_t kTextureStorageUploadBufferPageSize =
+      16 * 1024 * 1024;
+  std::unique_ptr<ui::d3d12::D3D12UploadBufferPool>
+      texture_storage_upload_buffer_pool_;
+  struct TextureStorageReadback {
+    uint64_t submission;
+    uint64_t key;
+    Microsoft::WRL::ComPtr<ID3D12Resource> buffer;
+    uint32_t size;
+  };
+  std::deque<TextureStorageReadback> texture_storage_readbacks_;
+
   std::vector<SRVDescriptorCachePage> srv_descriptor_cache_;
   uint32_t srv_descriptor_cache_allocated_;
   // Indices of cached descriptors used by deleted textures, for reuse.
@@ -0,0 +1,36 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2026 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/base/console_app_main.h"
+#include "xenia/gpu/d3d12/d3d12_graphics_system.h"
+#include "xenia/gpu/trace_benchmark.h"
+
+namespace xe {
+namespace gpu {
+namespace d3d12 {
+
+class D3D12TraceBenchmark : public TraceBenchmark {
+ public:
+  std::unique_ptr<gpu::GraphicsSystem> CreateGraphicsSystem() override {
+    return std::unique_ptr<gpu::GraphicsSystem>(new D3D12GraphicsSystem());
+  }
+};
+
+int trace_benchmark_main(const std::vector<std::string>& args) {
+  D3D12TraceBenchmark trace_benchmark;
+  return trace_benchmark.Main(args);
+}
+
+}  // namespace d3d12
+}  // namespace gpu
+}  // namespace xe
+
+XE_DEFINE_CONSOLE_APP("xenia-gpu-d3d12-trace-benchmark",
+                      xe::gpu::d3d12::trace_benchmark_main, "some.trace",
+                      "trace_benchmark_path");
@@ -24,244 +24,493 @@ DeferredCommandList::DeferredCommandList(
   command_stream_.reserve(initial_size / sizeof(uintmax_t));
 }
 
-void DeferredCommandList::Reset() { command_stream_.clear(); }
+void DeferredCommandList::Reset() {
+  command_stream_.clear();
+  last_command_offset_ = SIZE_MAX;
+  last_index_buffer_command_offset_ = SIZE_MAX;
+}
 
 void DeferredCommandList::Execute(ID3D12GraphicsCommandList* command_list,
                                   ID3D12GraphicsCommandList1* command_list_1) {
 #if XE_UI_D3D12_FINE_GRAINED_DRAW_SCOPES
   SCOPE_profile_cpu_f("gpu");
 #endif  // XE_UI_D3D12_FINE_GRAINED_DRAW_SCOPES
-  const uintmax_t* stream = (const uintmax_t*)command_stream_.data();
-  size_t stream_remaining = command_stream_.size() / sizeof(uintmax_t);
-  ID3D12PipelineState* current_pipeline_state = nullptr;
-  while (stream_remaining != 0) {
+  ExecuteRange(command_list, command_list_1, 0,
+               command_stream_.size() / sizeof(uintmax_t), nullptr, 0);
+}
+
+void DeferredCommandList::Split(uint32_t max_part_count,
+                                uint32_t min_draws_per_part,
+                                std::vector<ExecutionPart>& parts_out) const {
+  parts_out.clear();
+  const uintmax_t* stream =
+      reinterpret_cast<const uintmax_t*>(command_stream_.data());
+  size_t stream_size = command_stream_.size() / sizeof(uintmax_t);
+
+  uint32_t draw_count = 0;
+  for (size_t offset = 0; offset < stream_size;) {
+    const CommandHeader& header =
+        *reinterpret_cast<const CommandHeader*>(stream + offset);
+    if (IsDrawCommand(header.command)) {
+      ++draw_count;
+    }
+    offset += kCommandHeaderSizeElements + header.arguments_size_elements;
+  }
+  uint32_t part_count =
+      std::min(max_part_count, draw_count / std::max(min_draws_per_part, 1u));
+  if (part_count <= 1) {
+    parts_out.emplace_back();
+    parts_out.back().end = stream_size;
+    return;
+  }
+  uint32_t draws_per_part = (draw_count + part_count - 1) / part_count;
+
+  // Offsets of the commands that have set the state that is still current, to
+  // set it again in the beginning of each part. Order matters for the root
+  // arguments, which must be set after the root signature and the descriptor
+  // heaps.
+  constexpr size_t kNone = SIZE_MAX;
+  size_t descriptor_heaps = kNone;
+  size_t root_signatures[2] = {kNone, kNone};
+  std::vector<size_t> root_arguments[2];
+  size_t pipeline_state = kNone;
+  size_t fixed_function_state[size_t(Command::kCount)];
+  std::fill(std::begin(fixed_function_state), std::end(fixed_function_state),
+            kNone);
+  std::vector<size_t> vertex_buffers;
+
+  parts_out.emplace_back();
+  uint32_t part_draw_count = 0;
+  // Queries must begin and end in the same native command list.
+  uint32_t open_query_count = 0;
+  for (size_t offset = 0; offset < stream_size;) {
     const CommandHeader& header =
-        *reinterpret_cast<const CommandHeader*>(stream);
-    stream += kCommandHeaderSizeElements;
-    stream_remaining -= kCommandHeaderSizeElements;
+        *reinterpret_cast<const CommandHeader*>(stream + offset);
+    const uintmax_t* arguments = stream + offset + kCommandHeaderSizeElements;
+    size_t next_offset =
+        offset + kCommandHeaderSizeElements + header.arguments_size_elements;
     switch (header.command) {
-      case Command::kD3DClearDepthStencilView: {
-        auto& args =
-            *reinterpret_cast<const ClearDepthStencilViewHeader*>(stream);
-        command_list->ClearDepthStencilView(
-            args.depth_stencil_view, args.clear_flags, args.depth, args.stencil,
-            args.num_rects,
-            args.num_rects ? reinterpret_cast<const D3D12_RECT*>(&args + 1)
-                           : nullptr);
-      } break;
-      case Command::kD3DClearRenderTargetView: {
-        auto& args =
-            *reinterpret_cast<const ClearRenderTargetViewHeader*>(stream);
-        command_list->ClearRenderTargetView(
-            args.render_target_view, args.color_rgba, args.num_rects,
-            args.num_rects ? reinterpret_cast<const D3D12_RECT*>(&args + 1)
-                           : nullptr);
-      } break;
-      case Command::kD3DClearUnorderedAccessViewUint: {
-        auto& args =
-            *reinterpret_cast<const ClearUnorderedAccessViewHeader*>(stream);
-        command_list->ClearUnorderedAccessViewUint(
-            args.view_gpu_handle_in_current_heap, args.view_cpu_handle,
-            args.resource, args.values_uint, args.num_rects,
-            args.num_rects ? reinterpret_cast<const D3D12_RECT*>(&args + 1)
-                           : nullptr);
-      } break;
-      case Command::kD3DCopyBufferRegion: {
-        auto& args =
-            *reinterpret_cast<const D3DCopyBufferRegionArguments*>(stream);
-        command_list->CopyBufferRegion(args.dst_buffer, args.dst_offset,
-                                       args.src_buffer, args.src_offset,
-                                       args.num_bytes);
-      } break;
-      case Command::kD3DCopyResource: {
-        auto& args = *reinterpret_cast<const D3DCopyResourceArguments*>(stream);
-        command_list->CopyResource(args.dst_resource, args.src_resource);
-      } break;
-      case Command::kCopyTexture: {
-        auto& args = *reinterpret_cast<const CopyTextureArguments*>(stream);
-        command_list->CopyTextureRegion(&args.dst, 0, 0, 0, &args.src, nullptr);
-      } break;
-      case Command::kD3DCopyTextureRegion: {
-        auto& args =
-            *reinterpret_cast<const D3DCopyTextureRegionArguments*>(stream);
-        command_list->CopyTextureRegion(
-            &args.dst, args.dst_x, args.dst_y, args.dst_z, &args.src,
-            args.has_src_box ? &args.src_box : nullptr);
-      } break;
-      case Command::kD3DDispatch: {
-        if (current_pipeline_state != nullptr) {
-          auto& args = *reinterpret_cast<const D3DDispatchArguments*>(stream);
-          command_list->Dispatch(args.thread_group_count_x,
-                                 args.thread_group_count_y,
-                                 args.thread_group_count_z);
-        }
-      } break;
-      case Command::kD3DDrawIndexedInstanced: {
-        if (current_pipeline_state != nullptr) {
-          auto& args =
-              *reinterpret_cast<const D3DDrawIndexedInstancedArguments*>(
-                  stream);
-          command_list->DrawIndexedInstanced(
-              args.index_count_per_instance, args.instance_count,
-              args.start_index_location, args.base_vertex_location,
-              args.start_instance_location);
+      case Command::kSetDescriptorHeaps:
+        descriptor_heaps = offset;
+        break;
+      case Command::kD3DBeginQuery:
+        ++open_query_count;
+        break;
+      case Command::kD3DEndQuery:
+        // Timestamps are written with EndQuery alone.
+        if (reinterpret_cast<const D3DQueryArguments*>(arguments)->type !=
+            D3D12_QUERY_TYPE_TIMESTAMP) {
+          assert_not_zero(open_query_count);
+          --open_query_count;
         }
+        break;
+      case Command::kD3DSetGraphicsRootSignature:
+      case Command::kD3DSetComputeRootSignature: {
+        size_t type = header.command == Command::kD3DSetComputeRootSignature;
+        root_signatures[type] = offset;
+        root_arguments[type].clear();
       } break;
-      case Command::kD3DDrawInstanced: {
-        if (current_pipeline_state != nullptr) {
-          auto& args =
-              *reinterpret_cast<const D3DDrawInstancedArguments*>(stream);
-          command_list->DrawInstanced(
-              args.vertex_count_per_instance, args.instance_count,
-              args.start_vertex_location, args.start_instance_location);
+      case Command::kD3DSetGraphicsRoot32BitConstants:
+      case Command::kD3DSetGraphicsRootConstantBufferView:
+      case Command::kD3DSetGraphicsRootDescriptorTable:
+      case Command::kD3DSetComputeRoot32BitConstants:
+      case Command::kD3DSetComputeRootConstantBufferView:
+      case Command::kD3DSetComputeRootDescriptorTable: {
+        std::vector<size_t>& type_root_arguments =
+            root_arguments[IsComputeRootArgumentCommand(header.command)];
+        auto overwritten = std::find_if(
+            type_root_arguments.begin(), type_root_arguments.end(),
+            [this, offset](size_t old_offset) {
+              return IsRootArgumentOverwritten(old_offset, offset);
+            });
+        if (overwritten != type_root_arguments.end()) {
+          type_root_arguments.erase(overwritten);
         }
+        type_root_arguments.push_back(offset);
       } break;
-      case Command::kD3DIASetIndexBuffer: {
-        auto view = reinterpret_cast<const D3D12_INDEX_BUFFER_VIEW*>(stream);
-        command_list->IASetIndexBuffer(
-            view->Format != DXGI_FORMAT_UNKNOWN ? view : nullptr);
-      } break;
-      case Command::kD3DIASetPrimitiveTopology: {
-        command_list->IASetPrimitiveTopology(
-            *reinterpret_cast<const D3D12_PRIMITIVE_TOPOLOGY*>(stream));
-      } break;
+      case Command::kD3DSetPipelineState:
+      case Command::kSetPipelineStateHandle:
+        pipeline_state = offset;
+        break;
+      case Command::kD3DIASetIndexBuffer:
+      case Command::kD3DIASetPrimitiveTopology:
+      case Command::kD3DOMSetBlendFactor:
+      case Command::kD3DOMSetRenderTargets:
+      case Command::kD3DOMSetStencilRef:
+      case Command::kRSSetScissorRect:
+      case Command::kRSSetViewport:
+      case Command::kD3DSetSamplePositions:
+        fixed_function_state[size_t(header.command)] = offset;
+        break;
       case Command::kD3DIASetVertexBuffers: {
-        static_assert(alignof(D3D12_VERTEX_BUFFER_VIEW) <= alignof(uintmax_t));
         auto& args =
-            *reinterpret_cast<const D3DIASetVertexBuffersHeader*>(stream);
-        command_list->IASetVertexBuffers(
-            args.start_slot, args.num_views,
-            reinterpret_cast<const D3D12_VERTEX_BUFFER_VIEW*>(
-                reinterpret_cast<const uint8_t*>(stream) +
-                xe::align(sizeof(D3DIASetVertexBuffersHeader),
-                          alignof(D3D12_VERTEX_BUFFER_VIEW))));
-      } break;
-      case Command::kD3DOMSetBlendFactor: {
-        command_list->OMSetBlendFactor(reinterpret_cast<const FLOAT*>(stream));
-      } break;
-      case Command::kD3DOMSetRenderTargets: {
-        auto& args =
-            *reinterpret_cast<const D3DOMSetRenderTargetsArguments*>(stream);
-        command_list->OMSetRenderTargets(
-            args.num_render_target_descriptors, args.render_target_descriptors,
-            args.rts_single_handle_to_descriptor_range ? TRUE : FALSE,
-            args.depth_stencil ? &args.depth_stencil_descriptor : nullptr);
-      } break;
-      case Command::kD3DOMSetStencilRef: {
-        command_list->OMSetStencilRef(*reinterpret_cast<const UINT*>(stream));
-      } break;
-      case Command::kD3DResourceBarrier: {
-        static_assert(alignof(D3D12_RESOURCE_BARRIER) <= alignof(uintmax_t));
-        command_list->ResourceBarrier(
-            *reinterpret_cast<const UINT*>(stream),
-            reinterpret_cast<const D3D12_RESOURCE_BARRIER*>(
-                reinterpret_cast<const uint8_t*>(stream) +
-                xe::align(sizeof(UINT), alignof(D3D12_RESOURCE_BARRIER))));
-      } break;
-      case Command::kRSSetScissorRect: {
-        command_list->RSSetScissorRects(
-            1, reinterpret_cast<const D3D12_RECT*>(stream));
-      } break;
-      case Command::kRSSetViewport: {
-        command_list->RSSetViewports(
-            1, reinterpret_cast<const D3D12_VIEWPORT*>(stream));
-      } break;
-      case Command::kD3DSetComputeRoot32BitConstants: {
-        auto args =
-            reinterpret_cast<const SetRoot32BitConstantsHeader*>(stream);
-        command_list->SetComputeRoot32BitConstants(
-            args->root_parameter_index, args->num_32bit_values_to_set, args + 1,
-            args->dest_offset_in_32bit_values);
-      } break;
-      case Command::kD3DSetGraphicsRoot32BitConstants: {
-        auto args =
-            reinterpret_cast<const SetRoot32BitConstantsHeader*>(stream);
-        command_list->SetGraphicsRoot32BitConstants(
-            args->root_parameter_index, args->num_32bit_values_to_set, args + 1,
-            args->dest_offset_in_32bit_values);
-      } break;
-      case Command::kD3DSetComputeRootConstantBufferView: {
-        auto& args =
-            *reinterpret_cast<const SetRootConstantBufferViewArguments*>(
-                stream);
-        command_list->SetComputeRootConstantBufferView(
-            args.root_parameter_index, args.buffer_location);
-      } break;
-      case Command::kD3DSetGraphicsRootConstantBufferView: {
-        auto& args =
-            *reinterpret_cast<const SetRootConstantBufferViewArguments*>(
-                stream);
-        command_list->SetGraphicsRootConstantBufferView(
-            args.root_parameter_index, args.buffer_location);
-      } break;
-      case Command::kD3DSetComputeRootDescriptorTable: {
-        auto& args =
-            *reinterpret_cast<const SetRootDescriptorTableArguments*>(stream);
-        command_list->SetComputeRootDescriptorTable(args.root_parameter_index,
-                                                    args.base_descriptor);
-      } break;
-      case Command::kD3DSetGraphicsRootDescriptorTable: {
-        auto& args =
-            *reinterpret_cast<const SetRootDescriptorTableArguments*>(stream);
-        command_list->SetGraphicsRootDescriptorTable(args.root_parameter_index,
-                                                     args.base_descriptor);
-      } break;
-      case Command::kD3DSetComputeRootSignature: {
-        command_list->SetComputeRootSignature(
-            *reinterpret_cast<ID3D12RootSignature* const*>(stream));
-      } break;
-      case Command::kD3DSetGraphicsRootSignature: {
-        command_list->SetGraphicsRootSignature(
-            *reinterpret_cast<ID3D12RootSignature* const*>(stream));
-      } break;
-      case Command::kSetDescriptorHeaps: {
-        auto& args =
-            *reinterpret_cast<const SetDescriptorHeapsArguments*>(stream);
-        UINT num_descriptor_heaps = 0;
-        ID3D12DescriptorHeap* descriptor_heaps[2];
-        if (args.cbv_srv_uav_descriptor_heap != nullptr) {
-          descriptor_heaps[num_descriptor_heaps++] =
-              args.cbv_srv_uav_descriptor_heap;
-        }
-        if (args.sampler_descriptor_heap != nullptr) {
-          descriptor_heaps[num_descriptor_heaps++] =
-              args.sampler_descriptor_heap;
-        }
-        command_list->SetDescriptorHeaps(num_descriptor_heaps,
-                                         descriptor_heaps);
-      } break;
-      case Command::kD3DSetPipelineState: {
-        current_pipeline_state =
-            *reinterpret_cast<ID3D12PipelineState* const*>(stream);
-        if (current_pipeline_state) {
-          command_list->SetPipelineState(current_pipeline_state);
-        }
-      } break;
-      case Command::kSetPipelineStateHandle: {
-        current_pipeline_state = command_processor_.GetD3D12PipelineByHandle(
-            *reinterpret_cast<void* const*>(stream));
-        if (current_pipeline_state) {
-          command_list->SetPipelineState(current_pipeline_state);
-        }
-      } break;
-      case Command::kD3DSetSamplePositions: {
-        if (command_list_1 != nullptr) {
-          auto& args =
-              *reinterpret_cast<const D3DSetSamplePositionsArguments*>(stream);
-          command_list_1->SetSamplePositions(
-              args.num_samples_per_pixel, args.num_pixels,
-              (args.num_samples_per_pixel && args.num_pixels)
-                  ? const_cast<D3D12_SAMPLE_POSITION*>(args.sample_positions)
-                  : nullptr);
+            *reinterpret_cast<const D3DIASetVertexBuffersHeader*>(arguments);
+        auto overwritten = std::find_if(
+            vertex_buffers.begin(), vertex_buffers.end(),
+            [stream, &args](size_t old_offset) {
+              auto& old_args =
+                  *reinterpret_cast<const D3DIASetVertexBuffersHeader*>(
+                      stream + old_offset + kCommandHeaderSizeElements);
+              return old_args.start_slot >= args.start_slot &&
+                     old_args.start_slot + old_args.num_views <=
+                         args.start_slot + args.num_views;
+            });
+        if (overwritten != vertex_buffers.end()) {
+          vertex_buffers.erase(overwritten);
         }
+        vertex_buffers.push_back(offset);
       } break;
       default:
-        assert_unhandled_case(header.command);
         break;
     }
-    stream += header.arguments_size_elements;
-    stream_remaining -= header.arguments_size_elements;
+    offset = next_offset;
+    if (!IsDrawCommand(header.command) || ++part_draw_count < draws_per_part ||
+        offset >= stream_size || parts_out.size() >= part_count ||
+        open_query_count) {
+      continue;
+    }
+    parts_out.back().end = offset;
+    parts_out.emplace_back();
+    ExecutionPart& part = parts_out.back();
+    part.begin = offset;
+    part_draw_count = 0;
+    std::vector<size_t>& state_commands = part.state_commands;
+    if (descriptor_heaps != kNone) {
+      state_commands.push_back(descriptor_heaps);
+    }
+    for (size_t type = 0; type < 2; ++type) {
+      if (root_signatures[type] != kNone) {
+        state_commands.push_back(root_signatures[type]);
+        state_commands.insert(state_commands.end(),
+                              root_arguments[type].cbegin(),
+                              root_arguments[type].cend());
+      }
+    }
+    if (pipeline_state != kNone) {
+      state_commands.push_back(pipeline_state);
+    }
+    for (size_t command_offset : fixed_function_state) {
+      if (command_offset != kNone) {
+        state_commands.push_back(command_offset);
+      }
+    }
+    state_commands.insert(state_commands.end(), vertex_buffers.cbegin(),
+                          vertex_buffers.cend());
+  }
+  parts_out.back().end = stream_size;
+}
+
+void DeferredCommandList::Execute(ID3D12GraphicsCommandList* command_list,
+                                  ID3D12GraphicsCommandList1* command_list_1,
+                                  const ExecutionPart& part) const {
+#if XE_UI_D3D12_FINE_GRAINED_DRAW_SCOPES
+  SCOPE_profile_cpu_f("gpu");
+#endif  // XE_UI_D3D12_FINE_GRAINED_DRAW_SCOPES
+  ExecuteRange(command_list, command_list_1, part.begin, part.end,
+               part.state_commands.data(), part.state_commands.size());
+}
+
+bool DeferredCommandList::IsRootArgumentOverwritten(size_t old_offset,
+                                                    size_t new_offset) const {
+  const uintmax_t* stream =
+      reinterpret_cast<const uintmax_t*>(command_stream_.data());
+  const CommandHeader& old_header =
+      *reinterpret_cast<const CommandHeader*>(stream + old_offset);
+  const CommandHeader& new_header =
+      *reinterpret_cast<const CommandHeader*>(stream + new_offset);
+  // All root argument structures start with the root parameter index.
+  const UINT* old_arguments = reinterpret_cast<const UINT*>(
+      stream + old_offset + kCommandHeaderSizeElements);
+  const UINT* new_arguments = reinterpret_cast<const UINT*>(
+      stream + new_offset + kCommandHeaderSizeElements);
+  if (old_arguments[0] != new_arguments[0]) {
+    return false;
+  }
+  bool old_constants =
+      old_header.command == Command::kD3DSetGraphicsRoot32BitConstants ||
+      old_header.command == Command::kD3DSetComputeRoot32BitConstants;
+  bool new_constants =
+      new_header.command == Command::kD3DSetGraphicsRoot32BitConstants ||
+      new_header.command == Command::kD3DSetComputeRoot32BitConstants;
+  if (!old_constants || !new_constants) {
+    // The type of a root parameter is fixed by the root signature.
+    return true;
+  }
+  // Constants may be set partially, only overwritten by the same range.
+  auto& old_constants_header =
+      *reinterpret_cast<const SetRoot32BitConstantsHeader*>(old_arguments);
+  auto& new_constants_header =
+      *reinterpret_cast<const SetRoot32BitConstantsHeader*>(new_arguments);
+  return old_constants_header.dest_offset_in_32bit_values >=
+             new_constants_header.dest_offset_in_32bit_values &&
+         old_constants_header.dest_offset_in_32bit_values +
+                 old_constants_header.num_32bit_values_to_set <=
+             new_constants_header.dest_offset_in_32bit_values +
+                 new_constants_header.num_32bit_values_to_set;
+}
+
+void DeferredCommandList::ExecuteRange(
+    ID3D12GraphicsCommandList* command_list,
+    ID3D12GraphicsCommandList1* command_list_1, size_t begin, size_t end,
+    const size_t* state_commands, size_t state_command_count) const {
+  const uintmax_t* stream_base =
+      reinterpret_cast<const uintmax_t*>(command_stream_.data());
+  ID3D12PipelineState* current_pipeline_state = nullptr;
+  for (size_t i = 0; i < state_command_count; ++i) {
+    ExecuteCommand(command_list, command_list_1,
+                   stream_base + state_commands[i], current_pipeline_state);
+  }
+  const uintmax_t* stream = stream_base + begin;
+  const uintmax_t* stream_end = stream_base + end;
+  while (stream < stream_end) {
+    stream = ExecuteCommand(command_list, command_list_1, stream,
+                            current_pipeline_state);
+  }
+}
+
+const uintmax_t* DeferredCommandList::ExecuteCommand(
+    ID3D12GraphicsCommandList* command_list,
+    ID3D12GraphicsCommandList1* command_list_1, const uintmax_t* stream,
+    ID3D12PipelineState*& current_pipeline_state) const {
+  const CommandHeader& header = *reinterpret_cast<const CommandHeader*>(stream);
+  stream += kCommandHeaderSizeElements;
+  switch (header.command) {
+    case Command::kD3DBeginQuery: {
+      auto& args = *reinterpret_cast<const D3DQueryArguments*>(stream);
+      command_list->BeginQuery(args.query_heap, args.type, args.index);
+    } break;
+    case Command::kD3DClearDepthStencilView: {
+      auto& args =
+          *reinterpret_cast<const ClearDepthStencilViewHeader*>(stream);
+      command_list->ClearDepthStencilView(
+          args.depth_stencil_view, args.clear_flags, args.depth, args.stencil,
+          args.num_rects,
+          args.num_rects ? reinterpret_cast<const D3D12_RECT*>(&args + 1)
+                         : nullptr);
+    } break;
+    case Command::kD3DClearRenderTargetView: {
+      auto& args =
+          *reinterpret_cast<const ClearRenderTargetViewHeader*>(stream);
+      command_list->ClearRenderTargetView(
+          args.render_target_view, args.color_rgba, args.num_rects,
+          args.num_rects ? reinterpret_cast<const D3D12_RECT*>(&args + 1)
+                         : nullptr);
+    } break;
+    case Command::kD3DClearUnorderedAccessViewUint: {
+      auto& args =
+          *reinterpret_cast<const ClearUnorderedAccessViewHeader*>(stream);
+      command_list->ClearUnorderedAccessViewUint(
+          args.view_gpu_handle_in_current_heap, args.view_cpu_handle,
+          args.resource, args.values_uint, args.num_rects,
+          args.num_rects ? reinterpret_cast<const D3D12_RECT*>(&args + 1)
+                         : nullptr);
+    } break;
+    case Command::kD3DCopyBufferRegion: {
+      auto& args =
+          *reinterpret_cast<const D3DCopyBufferRegionArguments*>(stream);
+      command_list->CopyBufferRegion(args.dst_buffer, args.dst_offset,
+                                     args.src_buffer, args.src_offset,
+                                     args.num_bytes);
+    } break;
+    case Command::kD3DCopyResource: {
+      auto& args = *reinterpret_cast<const D3DCopyResourceArguments*>(stream);
+      command_list->CopyResource(args.dst_resource, args.src_resource);
+    } break;
+    case Command::kCopyTexture: {
+      auto& args = *reinterpret_cast<const CopyTextureArguments*>(stream);
+      command_list->CopyTextureRegion(&args.dst, 0, 0, 0, &args.src, nullptr);
+    } break;
+    case Command::kD3DCopyTextureRegion: {
+      auto& args =
+          *reinterpret_cast<const D3DCopyTextureRegionArguments*>(stream);
+      command_list->CopyTextureRegion(
+          &args.dst, args.dst_x, args.dst_y, args.dst_z, &args.src,
+          args.has_src_box ? &args.src_box : nullptr);
+    } break;
+    case Command::kD3DDispatch: {
+      if (current_pipeline_state != nullptr) {
+        auto& args = *reinterpret_cast<const D3DDispatchArguments*>(stream);
+        command_list->Dispatch(args.thread_group_count_x,
+                               args.thread_group_count_y,
+                               args.thread_group_count_z);
+      }
+    } break;
+    case Command::kD3DDrawIndexedInstanced: {
+      if (current_pipeline_state != nullptr) {
+        auto& args =
+            *reinterpret_cast<const D3DDrawIndexedInstancedArguments*>(
+                stream);
+        command_list->DrawIndexedInstanced(
+            args.index_count_per_instance, args.instance_count,
+            args.start_index_location, args.base_vertex_location,
+            args.start_instance_location);
+      }
+    } break;
+    case Command::kD3DDrawInstanced: {
+      if (current_pipeline_state != nullptr) {
+        auto& args =
+            *reinterpret_cast<const D3DDrawInstancedArguments*>(stream);
+        command_list->DrawInstanced(
+            args.vertex_count_per_instance, args.instance_count,
+            args.start_vertex_location, args.start_instance_location);
+      }
+    } break;
+    case Command::kD3DEndQuery: {
+      auto& args = *reinterpret_cast<const D3DQueryArguments*>(stream);
+      command_list->EndQuery(args.query_heap, args.type, args.index);
+    } break;
+    case Command::kD3DIASetIndexBuffer: {
+      auto view = reinterpret_cast<const D3D12_INDEX_BUFFER_VIEW*>(stream);
+      command_list->IASetIndexBuffer(
+          view->Format != DXGI_FORMAT_UNKNOWN ? view : nullptr);
+    } break;
+    case Command::kD3DIASetPrimitiveTopology: {
+      command_list->IASetPrimitiveTopology(
+          *reinterpret_cast<const D3D12_PRIMITIVE_TOPOLOGY*>(stream));
+    } break;
+    case Command::kD3DIASetVertexBuffers: {
+      static_assert(alignof(D3D12_VERTEX_BUFFER_VIEW) <= alignof(uintmax_t));
+      auto& args =
+          *reinterpret_cast<const D3DIASetVertexBuffersHeader*>(stream);
+      command_list->IASetVertexBuffers(
+          args.start_slot, args.num_views,
+          reinterpret_cast<const D3D12_VERTEX_BUFFER_VIEW*>(
+              reinterpret_cast<const uint8_t*>(stream) +
+              xe::align(sizeof(D3DIASetVertexBuffersHeader),
+                        alignof(D3D12_VERTEX_BUFFER_VIEW))));
+    } break;
+    case Command::kD3DOMSetBlendFactor: {
+      command_list->OMSetBlendFactor(reinterpret_cast<const FLOAT*>(stream));
+    } break;
+    case Command::kD3DOMSetRenderTargets: {
+      auto& args =
+          *reinterpret_cast<const D3DOMSetRenderTargetsArguments*>(stream);
+      command_list->OMSetRenderTargets(
+          args.num_render_target_descriptors, args.render_target_descriptors,
+          args.rts_single_handle_to_descriptor_range ? TRUE : FALSE,
+          args.depth_stencil ? &args.depth_stencil_descriptor : nullptr);
+    } break;
+    case Command::kD3DOMSetStencilRef: {
+      command_list->OMSetStencilRef(*reinterpret_cast<const UINT*>(stream));
+    } break;
+    case Command::kD3DResourceBarrier: {
+      static_assert(alignof(D3D12_RESOURCE_BARRIER) <= alignof(uintmax_t));
+      command_list->ResourceBarrier(
+          *reinterpret_cast<const UINT*>(stream),
+          reinterpret_cast<const D3D12_RESOURCE_BARRIER*>(
+              reinterpret_cast<const uint8_t*>(stream) +
+              xe::align(sizeof(UINT), alignof(D3D12_RESOURCE_BARRIER))));
+    } break;
+    case Command::kD3DResolveQueryData: {
+      auto& args =
+          *reinterpret_cast<const D3DResolveQueryDataArguments*>(stream);
+      command_list->ResolveQueryData(args.query_heap, args.type,
+                                     args.start_index, args.num_queries,
+                                     args.destination_buffer,
+                                     args.aligned_destination_buffer_offset);
+    } break;
+    case Command::kRSSetScissorRect: {
+      command_list->RSSetScissorRects(
+          1, reinterpret_cast<const D3D12_RECT*>(stream));
+    } break;
+    case Command::kRSSetViewport: {
+      command_list->RSSetViewports(
+          1, reinterpret_cast<const D3D12_VIEWPORT*>(stream));
+    } break;
+    case Command::kD3DSetComputeRoot32BitConstants: {
+      auto args =
+          reinterpret_cast<const SetRoot32BitConstantsHeader*>(stream);
+      command_list->SetComputeRoot32BitConstants(
+          args->root_parameter_index, args->num_32bit_values_to_set, args + 1,
+          args->dest_offset_in_32bit_values);
+    } break;
+    case Command::kD3DSetGraphicsRoot32BitConstants: {
+      auto args =
+          reinterpret_cast<const SetRoot32BitConstantsHeader*>(stream);
+      command_list->SetGraphicsRoot32BitConstants(
+          args->root_parameter_index, args->num_32bit_values_to_set, args + 1,
+          args->dest_offset_in_32bit_values);
+    } break;
+    case Command::kD3DSetComputeRootConstantBufferView: {
+      auto& args =
+          *reinterpret_cast<const SetRootConstantBufferViewArguments*>(
+              stream);
+      command_list->SetComputeRootConstantBufferView(
+          args.root_parameter_index, args.buffer_location);
+    } break;
+    case Command::kD3DSetGraphicsRootConstantBufferView: {
+      auto& args =
+          *reinterpret_cast<const SetRootConstantBufferViewArguments*>(
+              stream);
+      command_list->SetGraphicsRootConstantBufferView(
+          args.root_parameter_index, args.buffer_location);
+    } break;
+    case Command::kD3DSetComputeRootDescriptorTable: {
+      auto& args =
+          *reinterpret_cast<const SetRootDescriptorTableArguments*>(stream);
+      command_list->SetComputeRootDescriptorTable(args.root_parameter_index,
+                                                  args.base_descriptor);
+    } break;
+    case Command::kD3DSetGraphicsRootDescriptorTable: {
+      auto& args =
+          *reinterpret_cast<const SetRootDescriptorTableArguments*>(stream);
+      command_list->SetGraphicsRootDescriptorTable(args.root_parameter_index,
+                                                   args.base_descriptor);
+    } break;
+    case Command::kD3DSetComputeRootSignature: {
+      command_list->SetComputeRootSignature(
+          *reinterpret_cast<ID3D12RootSignature* const*>(stream));
+    } break;
+    case Command::kD3DSetGraphicsRootSignature: {
+      command_list->SetGraphicsRootSignature(
+          *reinterpret_cast<ID3D12RootSignature* const*>(stream));
+    } break;
+    case Command::kSetDescriptorHeaps: {
+      auto& args =
+          *reinterpret_cast<const SetDescriptorHeapsArguments*>(stream);
+      UINT num_descriptor_heaps = 0;
+      ID3D12DescriptorHeap* descriptor_heaps[2];
+      if (args.cbv_srv_uav_descriptor_heap != nullptr) {
+        descriptor_heaps[num_descriptor_heaps++] =
+            args.cbv_srv_uav_descriptor_heap;
+      }
+      if (args.sampler_descriptor_heap != nullptr) {
+        descriptor_heaps[num_descriptor_heaps++] =
+            args.sampler_descriptor_heap;
+      }
+      command_list->SetDescriptorHeaps(num_descriptor_heaps,
+                                       descriptor_heaps);
+    } break;
+    case Command::kD3DSetPipelineState: {
+      current_pipeline_state =
+          *reinterpret_cast<ID3D12PipelineState* const*>(stream);
+      if (current_pipeline_state) {
+        command_list->SetPipelineState(current_pipeline_state);
+      }
+    } break;
+    case Command::kSetPipelineStateHandle: {
+      current_pipeline_state = command_processor_.GetD3D12PipelineByHandle(
+          *reinterpret_cast<void* const*>(stream));
+      if (current_pipeline_state) {
+        command_list->SetPipelineState(current_pipeline_state);
+      }
+    } break;
+    case Command::kD3DSetSamplePositions: {
+      if (command_list_1 != nullptr) {
+        auto& args =
+            *reinterpret_cast<const D3DSetSamplePositionsArguments*>(stream);
+        command_list_1->SetSamplePositions(
+            args.num_samples_per_pixel, args.num_pixels,
+            (args.num_samples_per_pixel && args.num_pixels)
+                ? const_cast<D3D12_SAMPLE_POSITION*>(args.sample_positions)
+                : nullptr);
+      }
+    } break;
+    default:
+      assert_unhandled_case(header.command);
+      break;
   }
+  return stream + header.arguments_size_elements;
 }
 
 void* DeferredCommandList::WriteCommand(Command command,
@@ -279,6 +528,7 @@ void* DeferredCommandList::WriteCommand(Command command,
   header.command = command;
   header.arguments_size_elements =
       uint32_t(arguments_size_elements) / sizeof(uintmax_t);
+  last_command_offset_ = offset;
   return command_stream_.data() + (offset + kCommandHeaderSizeBytes);
 }
 
@@ -13,6 +13,7 @@
 #include <algorithm>
 #include <cstdint>
 #include <cstring>
+#include <utility>
 #include <vector>
 
 #include "xenia/base/assert.h"
@@ -41,6 +42,41 @@ class DeferredCommandList {
   void Reset();
   void Execute(ID3D12GraphicsCommandList* command_list,
                ID3D12GraphicsCommandList1* command_list_1);
+  // A range of the commands that can be recorded into a separate native command
+  // list, in parallel with the other parts, after setting the state that was
+  // current in the beginning of the range again. Offsets are in uintmax_t
+  // elements.
+  struct ExecutionPart {
+    size_t begin = 0;
+    size_t end = 0;
+    std::vector<size_t> state_commands;
+  };
+  // Splits the commands into up to max_part_count parts with about the same
+  // number of draws and dispatches, at least min_draws_per_part each. Returns a
+  // single part for the whole list if it's too small to split.
+  void Split(uint32_t max_part_count, uint32_t min_draws_per_part,
+             std::vector<ExecutionPart>& parts_out) const;
+  void Execute(ID3D12GraphicsCommandList* command_list,
+               ID3D12GraphicsCommandList1* command_list_1,
+               const ExecutionPart& part) const;
+  // Exchanges the recorded commands with another list of the same command
+  // processor, for handing them over to another thread without copying.
+  void Swap(DeferredCommandList& other) {
+    assert_true(&command_processor_ == &other.command_processor_);
+    command_stream_.swap(other.command_stream_);
+    std::swap(last_command_offset_, other.last_command_offset_);
+    std::swap(last_index_buffer_command_offset_,
+              other.last_index_buffer_command_offset_);
+  }
+
+  void D3DBeginQuery(ID3D12QueryHeap* query_heap, D3D12_QUERY_TYPE type,
+                     UINT index) {
+    auto& args = *reinterpret_cast<D3DQueryArguments*>(
+        WriteCommand(Command::kD3DBeginQuery, sizeof(D3DQueryArguments)));
+    args.query_heap = query_heap;
+    args.type = type;
+    args.index = index;
+  }
 
   D3D12_RECT* ClearDepthStencilViewAllocatedRects(
       D3D12_CPU_DESCRIPTOR_HANDLE depth_stencil_view,
@@ -113,6 +149,33 @@ class DeferredCommandList {
     args.num_bytes = num_bytes;
   }
 
+  // If the last recorded command is a buffer region copy between the same
+  // buffers, with the source and the destination ranges directly preceding the
+  // specified ones, extends it to include the specified region and returns
+  // true. Otherwise, returns false, and D3DCopyBufferRegion needs to be called.
+  bool TryExtendLastD3DCopyBufferRegion(ID3D12Resource* dst_buffer,
+                                        UINT64 dst_offset,
+                                        ID3D12Resource* src_buffer,
+                                        UINT64 src_offset, UINT64 num_bytes) {
+    if (last_command_offset_ == SIZE_MAX) {
+      return false;
+    }
+    uint8_t* last_command = command_stream_.data() + last_command_offset_;
+    if (reinterpret_cast<const CommandHeader*>(last_command)->command !=
+        Command::kD3DCopyBufferRegion) {
+      return false;
+    }
+    auto& args = *reinterpret_cast<D3DCopyBufferRegionArguments*>(
+        last_command + kCommandHeaderSizeElements * sizeof(uintmax_t));
+    if (args.dst_buffer != dst_buffer || args.src_buffer != src_buffer ||
+        args.dst_offset + args.num_bytes != dst_offset ||
+        args.src_offset + args.num_bytes != src_offset) {
+      return false;
+    }
+    args.num_bytes += num_bytes;
+    return true;
+  }
+
   void D3DCopyResource(ID3D12Resource* dst_resource,
                        ID3D12Resource* src_resource) {
     auto& args = *reinterpret_cast<D3DCopyResourceArguments*>(WriteCommand(
@@ -173,6 +236,49 @@ class DeferredCommandList {
     args.start_instance_location = start_instance_location;
   }
 
+  // If the last recorded command is a non-instanced indexed draw from the
+  // beginning of the currently bound index buffer, and the specified index
+  // buffer directly follows the bound one in memory and has the same format,
+  // extends the draw and the index buffer binding to also draw index_count
+  // indices from the specified index buffer and returns true. Otherwise,
+  // returns false, and the index buffer needs to be bound and the draw needs
+  // to be recorded. The caller must ensure that the host primitive type is a
+  // list one, and that nothing else differentiates the two draws.
+  bool TryExtendLastD3DDrawIndexedInstanced(
+      const D3D12_INDEX_BUFFER_VIEW& index_buffer_view, UINT index_count) {
+    if (last_command_offset_ == SIZE_MAX ||
+        last_index_buffer_command_offset_ == SIZE_MAX) {
+      return false;
+    }
+    uint8_t* last_command = command_stream_.data() + last_command_offset_;
+    if (reinterpret_cast<const CommandHeader*>(last_command)->command !=
+        Command::kD3DDrawIndexedInstanced) {
+      return false;
+    }
+    auto& draw_args = *reinterpret_cast<D3DDrawIndexedInstancedArguments*>(
+        last_command + kCommandHeaderSizeElements * sizeof(uintmax_t));
+    if (draw_args.instance_count != 1 || draw_args.start_index_location ||
+        draw_args.base_vertex_location || draw_args.start_instance_location) {
+      return false;
+    }
+    auto& index_buffer_args = *reinterpret_cast<D3D12_INDEX_BUFFER_VIEW*>(
+        command_stream_.data() + last_index_buffer_command_offset_ +
+        kCommandHeaderSizeElements * sizeof(uintmax_t));
+    UINT index_size =
+        index_buffer_view.Format == DXGI_FORMAT_R16_UINT ? sizeof(uint16_t)
+                                                         : sizeof(uint32_t);
+    if (index_buffer_args.Format != index_buffer_view.Format ||
+        index_buffer_args.SizeInBytes !=
+            draw_args.index_count_per_instance * index_size ||
+        index_buffer_args.BufferLocation + index_buffer_args.SizeInBytes !=
+            index_buffer_view.BufferLocation) {
+      return false;
+    }
+    index_buffer_args.SizeInBytes += index_count * index_size;
+    draw_args.index_count_per_instance += index_count;
+    return true;
+  }
+
   void D3DDrawInstanced(UINT vertex_count_per_instance, UINT instance_count,
                         UINT start_vertex_location,
                         UINT start_instance_location) {
@@ -184,9 +290,19 @@ class DeferredCommandList {
     args.start_instance_location = start_instance_location;
   }
 
+  void D3DEndQuery(ID3D12QueryHeap* query_heap, D3D12_QUERY_TYPE type,
+                   UINT index) {
+    auto& args = *reinterpret_cast<D3DQueryArguments*>(
+        WriteCommand(Command::kD3DEndQuery, sizeof(D3DQueryArguments)));
+    args.query_heap = query_heap;
+    args.type = type;
+    args.index = index;
+  }
+
   void D3DIASetIndexBuffer(const D3D12_INDEX_BUFFER_VIEW* view) {
     auto& args = *reinterpret_cast<D3D12_INDEX_BUFFER_VIEW*>(WriteCommand(
         Command::kD3DIASetIndexBuffer, sizeof(D3D12_INDEX_BUFFER_VIEW)));
+    last_index_buffer_command_offset_ = last_command_offset_;
     if (view != nullptr) {
       args.BufferLocation = view->BufferLocation;
       args.SizeInBytes = view->SizeInBytes;
@@ -279,6 +395,21 @@ class DeferredCommandList {
                 num_barriers * sizeof(D3D12_RESOURCE_BARRIER));
   }
 
+  void D3DResolveQueryData(ID3D12QueryHeap* query_heap, D3D12_QUERY_TYPE type,
+                           UINT start_index, UINT num_queries,
+                           ID3D12Resource* destination_buffer,
+                           UINT64 aligned_destination_buffer_offset) {
+    auto& args = *reinterpret_cast<D3DResolveQueryDataArguments*>(
+        WriteCommand(Command::kD3DResolveQueryData,
+                     sizeof(D3DResolveQueryDataArguments)));
+    args.query_heap = query_heap;
+    args.type = type;
+    args.start_index = start_index;
+    args.num_queries = num_queries;
+    args.destination_buffer = destination_buffer;
+    args.aligned_destination_buffer_offset = aligned_destination_buffer_offset;
+  }
+
   void RSSetScissorRect(const D3D12_RECT& rect) {
     auto& arg = *reinterpret_cast<D3D12_RECT*>(
         WriteCommand(Command::kRSSetScissorRect, sizeof(D3D12_RECT)));
@@ -407,6 +538,7 @@ class DeferredCommandList {
 
  private:
   enum class Command {
+    kD3DBeginQuery,
     kD3DClearDepthStencilView,
     kD3DClearRenderTargetView,
     kD3DClearUnorderedAccessViewUint,
@@ -417,6 +549,7 @@ class DeferredCommandList {
     kD3DDispatch,
     kD3DDrawIndexedInstanced,
     kD3DDrawInstanced,
+    kD3DEndQuery,
     kD3DIASetIndexBuffer,
     kD3DIASetPrimitiveTopology,
     kD3DIASetVertexBuffers,
@@ -424,6 +557,7 @@ class DeferredCommandList {
     kD3DOMSetRenderTargets,
     kD3DOMSetStencilRef,
     kD3DResourceBarrier,
+    kD3DResolveQueryData,
     kRSSetScissorRect,
     kRSSetViewport,
     kD3DSetComputeRoot32BitConstants,
@@ -438,8 +572,21 @@ class DeferredCommandList {
     kD3DSetPipelineState,
     kSetPipelineStateHandle,
     kD3DSetSamplePositions,
+
+    kCount,
   };
 
+  static constexpr bool IsDrawCommand(Command command) {
+    return command == Command::kD3DDrawIndexedInstanced ||
+           command == Command::kD3DDrawInstanced ||
+           command == Command::kD3DDispatch;
+  }
+  static constexpr bool IsComputeRootArgumentCommand(Command command) {
+    return command == Command::kD3DSetComputeRoot32BitConstants ||
+           command == Command::kD3DSetComputeRootConstantBufferView ||
+           command == Command::kD3DSetComputeRootDescriptorTable;
+  }
+
   struct CommandHeader {
     Command command;
     uint32_t arguments_size_elements;
@@ -447,6 +594,12 @@ class DeferredCommandList {
   static constexpr size_t kCommandHeaderSizeElements =
       (sizeof(CommandHeader) + sizeof(uintmax_t) - 1) / sizeof(uintmax_t);
 
+  struct D3DQueryArguments {
+    ID3D12QueryHeap* query_heap;
+    D3D12_QUERY_TYPE type;
+    UINT index;
+  };
+
   struct ClearDepthStencilViewHeader {
     D3D12_CPU_DESCRIPTOR_HANDLE depth_stencil_view;
     D3D12_CLEAR_FLAGS clear_flags;
@@ -535,6 +688,15 @@ class DeferredCommandList {
     D3D12_CPU_DESCRIPTOR_HANDLE depth_stencil_descriptor;
   };
 
+  struct D3DResolveQueryDataArguments {
+    ID3D12QueryHeap* query_heap;
+    D3D12_QUERY_TYPE type;
+    UINT start_index;
+    UINT num_queries;
+    ID3D12Resource* destination_buffer;
+    UINT64 aligned_destination_buffer_offset;
+  };
+
   struct SetRoot32BitConstantsHeader {
     UINT root_parameter_index;
     UINT num_32bit_values_to_set;
@@ -564,11 +726,32 @@ class DeferredCommandList {
 
   void* WriteCommand(Command command, size_t arguments_size_bytes);
 
+  // Whether the root argument command at new_offset replaces all the values set
+  // by the one at old_offset.
+  bool IsRootArgumentOverwritten(size_t old_offset, size_t new_offset) const;
+  // Sets the state from the commands at the state_commands offsets, then
+  // executes the commands in [begin, end).
+  void ExecuteRange(ID3D12GraphicsCommandList* command_list,
+                    ID3D12GraphicsCommandList1* command_list_1, size_t begin,
+                    size_t end, const size_t* state_commands,
+                    size_t state_command_count) const;
+  // Returns the pointer to the next command.
+  const uintmax_t* ExecuteCommand(
+      ID3D12GraphicsCommandList* command_list,
+      ID3D12GraphicsCommandList1* command_list_1, const uintmax_t* stream,
+      ID3D12PipelineState*& current_pipeline_state) const;
+
   const D3D12CommandProcessor& command_processor_;
 
   // uintmax_t to ensure uint64_t and pointer alignment of all structures.
   // std::vector<uintmax_t> command_stream_;
   FixedVMemVector<MAX_SIZEOF_COMMANDLIST> command_stream_;
+  // Offset of the header of the most recently written command in
+  // command_stream_, or SIZE_MAX if empty.
+  size_t last_command_offset_ = SIZE_MAX;
+  // Offset of the header of the most recently written index buffer binding
+  // command in command_stream_, or SIZE_MAX if none.
+  size_t last_index_buffer_command_offset_ = SIZE_MAX;
 };
 
 }  // namespace d3d12
@@ -27,6 +27,7 @@
 #include "xenia/base/clock.h"
 #include "xenia/base/cvar.h"
 #include "xenia/base/filesystem.h"
+#include "xenia/base/frame_timeline.h"
 #include "xenia/base/logging.h"
 #include "xenia/base/math.h"
 #include "xenia/base/profiling.h"
@@ -40,6 +41,7 @@
 #include "xenia/gpu/dxbc_shader_translator.h"
 #include "xenia/gpu/gpu_flags.h"
 #include "xenia/gpu/registers.h"
+#include "xenia/gpu/shader_storage_merge.h"
 #include "xenia/gpu/xenos.h"
 #include "xenia/ui/d3d12/d3d12_util.h"
 
@@ -92,19 +94,10 @@ PipelineCache::PipelineCache(D3D12CommandProcessor& command_processor,
       register_file_(register_file),
       render_target_cache_(render_target_cache),
       bindless_resources_used_(bindless_resources_used) {
-  const ui::d3d12::D3D12Provider& provider =
-      command_processor_.GetD3D12Provider();
-
   bool edram_rov_used = render_target_cache.GetPath() ==
                         RenderTargetCache::Path::kPixelShaderInterlock;
 
-  shader_translator_ = std::make_unique<DxbcShaderTranslator>(
-      provider.GetAdapterVendorID(), bindless_resources_used_, edram_rov_used,
-      render_target_cache_.gamma_render_target_as_srgb(),
-      render_target_cache_.msaa_2x_supported(),
-      render_target_cache_.draw_resolution_scale_x(),
-      render_target_cache_.draw_resolution_scale_y(),
-      provider.GetGraphicsAnalysis() != nullptr);
+  shader_translator_ = CreateShaderTranslator();
 
   if (edram_rov_used) {
     depth_only_pixel_shader_ =
@@ -191,8 +184,17 @@ void PipelineCache::Shutdown() {
       xe::threading::Wait(creation_threads_[i].get(), false);
     }
     creation_threads_.clear();
+    XELOGGPU(
+        "Up to {} shader translations and {} pipelines were queued for the "
+        "creation threads",
+        translation_queue_max_depth_, creation_queue_max_depth_);
   }
   creation_completion_event_.reset();
+  translation_queue_.clear();
+  translations_completed_.clear();
+  translations_pending_.clear();
+  translation_queue_max_depth_ = 0;
+  creation_queue_max_depth_ = 0;
 
   // Shut down the persistent shader / pipeline storage.
   ShutdownShaderStorage();
@@ -200,7 +202,11 @@ void PipelineCache::Shutdown() {
   // Destroy all pipelines.
   current_pipeline_ = nullptr;
   for (auto it : pipelines_) {
-    it.second->state->Release();
+    ID3D12PipelineState* state =
+        it.second->state.load(std::memory_order_relaxed);
+    if (state) {
+      state->Release();
+    }
     delete it.second;
   }
   pipelines_.clear();
@@ -229,6 +235,10 @@ void PipelineCache::InitializeShaderStorage(
     const std::filesystem::path& cache_root, uint32_t title_id, bool blocking) {
   ShutdownShaderStorage();
 
+  // The storage translates shaders on its own threads, which must not race
+  // with the asynchronous translation of the same shaders.
+  AwaitPendingTranslations();
+
   auto shader_storage_root = cache_root / "shaders";
   // For files that can be moved between different hosts.
   // Host PSO blobs - if ever added - should be stored in shaders/local/ (they
@@ -246,6 +256,8 @@ void PipelineCache::InitializeShaderStorage(
       return;
     }
   }
+  // Add what has been collected elsewhere before opening the local files.
+  MergeSharedShaderStorage(shader_storage_shareable_root, title_id);
 
   bool edram_rov_used = render_target_cache_.GetPath() ==
                         RenderTargetCache::Path::kPixelShaderInterlock;
@@ -259,16 +271,6 @@ void PipelineCache::InitializeShaderStorage(
       shader_storage_shareable_root /
       fmt::format("{:08X}.{}.d3d12.xpso", title_id,
                   edram_rov_used ? "rov" : "rtv");
-  pipeline_storage_file_ =
-      xe::filesystem::OpenFile(pipeline_storage_file_path, "a+b");
-  if (!pipeline_storage_file_) {
-    XELOGE(
-        "Failed to open the Direct3D 12 pipeline description storage file for "
-        "writing, persistent shader storage will be disabled: {}",
-        xe::path_to_utf8(pipeline_storage_file_path));
-    return;
-  }
-  pipeline_storage_file_flush_needed_ = false;
   // 'XEPS'.
   const uint32_t pipeline_storage_magic = 0x53504558;
   // 'DXRO' or 'DXRT'.
@@ -282,22 +284,30 @@ void PipelineCache::InitializeShaderStorage(
     uint32_t magic_api;
     uint32_t version_swapped;
   } pipeline_storage_file_header;
-  if (fread(&pipeline_storage_file_header, sizeof(pipeline_storage_file_header),
-            1, pipeline_storage_file_) &&
-      pipeline_storage_file_header.magic == pipeline_storage_magic &&
-      pipeline_storage_file_header.magic_api == pipeline_storage_magic_api &&
-      pipeline_storage_file_header.version_swapped ==
-          pipeline_storage_version_swapped) {
-    xe::filesystem::Seek(pipeline_storage_file_, 0, SEEK_END);
-    int64_t pipeline_storage_told_end =
-        xe::filesystem::Tell(pipeline_storage_file_);
+  pipeline_storage_file_header.magic = pipeline_storage_magic;
+  pipeline_storage_file_header.magic_api = pipeline_storage_magic_api;
+  pipeline_storage_file_header.version_swapped =
+      pipeline_storage_version_swapped;
+  pipeline_storage_file_ = OpenShaderStorageFile(
+      pipeline_storage_file_path, &pipeline_storage_file_header,
+      sizeof(pipeline_storage_file_header));
+  if (!pipeline_storage_file_) {
+    XELOGE(
+        "Failed to open the Direct3D 12 pipeline description storage file for "
+        "writing, persistent shader storage will be disabled: {}",
+        xe::path_to_utf8(pipeline_storage_file_path));
+    return;
+  }
+  pipeline_storage_file_flush_needed_ = false;
+  xe::filesystem::Seek(pipeline_storage_file_, 0, SEEK_END);
+  int64_t pipeline_storage_told_end =
+      xe::filesystem::Tell(pipeline_storage_file_);
+  if (pipeline_storage_told_end >
+      int64_t(sizeof(pipeline_storage_file_header))) {
     size_t pipeline_storage_told_count =
-        size_t(pipeline_storage_told_end >=
-                       int64_t(sizeof(pipeline_storage_file_header))
-                   ? (uint64_t(pipeline_storage_told_end) -
-                      sizeof(pipeline_storage_file_header)) /
-                         sizeof(PipelineStoredDescription)
-                   : 0);
+        size_t((uint64_t(pipeline_storage_told_end) -
+                sizeof(pipeline_storage_file_header)) /
+               sizeof(PipelineStoredDescription));
     if (pipeline_storage_told_count &&
         xe::filesystem::Seek(pipeline_storage_file_,
                              int64_t(sizeof(pipeline_storage_file_header)),
@@ -347,8 +357,17 @@ void PipelineCache::InitializeShaderStorage(
       xe::Clock::QueryHostTickCount();
   auto shader_storage_file_path =
       shader_storage_shareable_root / fmt::format("{:08X}.xsh", title_id);
-  shader_storage_file_ =
-      xe::filesystem::OpenFile(shader_storage_file_path, "a+b");
+  struct {
+    uint32_t magic;
+    uint32_t version_swapped;
+  } shader_storage_file_header;
+  // 'XESH'.
+  shader_storage_file_header.magic = 0x48534558;
+  shader_storage_file_header.version_swapped =
+      xe::byte_swap(ShaderStoredHeader::kVersion);
+  shader_storage_file_ = OpenShaderStorageFile(
+      shader_storage_file_path, &shader_storage_file_header,
+      sizeof(shader_storage_file_header));
   if (!shader_storage_file_) {
     XELOGE(
         "Failed to open the guest shader storage file for writing, persistent "
@@ -360,236 +379,242 @@ void PipelineCache::InitializeShaderStorage(
   }
   ++shader_storage_index_;
   shader_storage_file_flush_needed_ = false;
-  struct {
-    uint32_t magic;
-    uint32_t version_swapped;
-  } shader_storage_file_header;
-  // 'XESH'.
-  const uint32_t shader_storage_magic = 0x48534558;
-  if (fread(&shader_storage_file_header, sizeof(shader_storage_file_header), 1,
-            shader_storage_file_) &&
-      shader_storage_file_header.magic == shader_storage_magic &&
-      xe::byte_swap(shader_storage_file_header.version_swapped) ==
-          ShaderStoredHeader::kVersion) {
-    uint64_t shader_storage_valid_bytes = sizeof(shader_storage_file_header);
-    // Load and translate shaders written by previous Xenia executions until the
-    // end of the file or until a corrupted one is detected.
-    ShaderStoredHeader shader_header;
-    std::vector<uint32_t> ucode_dwords;
-    ucode_dwords.reserve(0xFFFF);
-    size_t shaders_translated = 0;
-
-    // Threads overlapping file reading.
-    std::mutex shaders_translation_thread_mutex;
-    std::condition_variable shaders_translation_thread_cond;
-    std::deque<D3D12Shader*> shaders_to_translate;
-    size_t shader_translation_threads_busy = 0;
-    bool shader_translation_threads_shutdown = false;
-    std::mutex shaders_failed_to_translate_mutex;
-    std::vector<D3D12Shader::D3D12Translation*> shaders_failed_to_translate;
-    auto shader_translation_thread_function = [&]() {
-      const ui::d3d12::D3D12Provider& provider =
-          command_processor_.GetD3D12Provider();
-      StringBuffer ucode_disasm_buffer;
-      DxbcShaderTranslator translator(
-          provider.GetAdapterVendorID(), bindless_resources_used_,
-          edram_rov_used, render_target_cache_.gamma_render_target_as_srgb(),
-          render_target_cache_.msaa_2x_supported(),
-          render_target_cache_.draw_resolution_scale_x(),
-          render_target_cache_.draw_resolution_scale_y(),
-          provider.GetGraphicsAnalysis() != nullptr);
-      // If needed and possible, create objects needed for DXIL conversion and
-      // disassembly on this thread.
-      IDxbcConverter* dxbc_converter = nullptr;
-      IDxcUtils* dxc_utils = nullptr;
-      IDxcCompiler* dxc_compiler = nullptr;
-      if (cvars::d3d12_dxbc_disasm_dxilconv && dxbc_converter_ && dxc_utils_ &&
-          dxc_compiler_) {
-        provider.DxbcConverterCreateInstance(CLSID_DxbcConverter,
-                                             IID_PPV_ARGS(&dxbc_converter));
-        provider.DxcCreateInstance(CLSID_DxcUtils, IID_PPV_ARGS(&dxc_utils));
-        provider.DxcCreateInstance(CLSID_DxcCompiler,
-                                   IID_PPV_ARGS(&dxc_compiler));
-      }
+  uint64_t shader_storage_valid_bytes = sizeof(shader_storage_file_header);
+  // Load and translate shaders written by previous Xenia executions until the
+  // end of the file or until a corrupted one is detected.
+  ShaderStoredHeader shader_header;
+  std::vector<uint32_t> ucode_dwords;
+  ucode_dwords.reserve(0xFFFF);
+  size_t shaders_translated = 0;
+
+  command_processor_.ResetShaderStorageProgress(
+      uint32_t(shader_translations_needed.size() +
+               pipeline_stored_descriptions.size()));
+
+  // Threads overlapping file reading and pipeline creation.
+  std::mutex shaders_translation_thread_mutex;
+  std::condition_variable shaders_translation_thread_cond;
+  std::deque<D3D12Shader*> shaders_to_translate;
+  size_t shader_translation_threads_busy = 0;
+  bool shader_translation_threads_shutdown = false;
+  // Hashes of the shaders from the storage with all the needed modifications
+  // translated, so the pipelines using them can be created while the other
+  // shaders are still being translated. Protected with
+  // shaders_translation_thread_mutex, notify_all
+  // shader_translation_completion_cond when inserting.
+  std::unordered_set<uint64_t> shaders_translation_completed;
+  std::condition_variable shader_translation_completion_cond;
+  size_t shader_translations_done = 0;
+  std::mutex shaders_failed_to_translate_mutex;
+  std::vector<D3D12Shader::D3D12Translation*> shaders_failed_to_translate;
+  auto shader_translation_thread_function = [&]() {
+    const ui::d3d12::D3D12Provider& provider =
+        command_processor_.GetD3D12Provider();
+    StringBuffer ucode_disasm_buffer;
+    std::unique_ptr<DxbcShaderTranslator> translator =
+        CreateShaderTranslator();
+    // If needed and possible, create objects needed for DXIL conversion and
+    // disassembly on this thread.
+    IDxbcConverter* dxbc_converter = nullptr;
+    IDxcUtils* dxc_utils = nullptr;
+    IDxcCompiler* dxc_compiler = nullptr;
+    if (cvars::d3d12_dxbc_disasm_dxilconv && dxbc_converter_ && dxc_utils_ &&
+        dxc_compiler_) {
+      provider.DxbcConverterCreateInstance(CLSID_DxbcConverter,
+                                           IID_PPV_ARGS(&dxbc_converter));
+      provider.DxcCreateInstance(CLSID_DxcUtils, IID_PPV_ARGS(&dxc_utils));
+      provider.DxcCreateInstance(CLSID_DxcCompiler,
+                                 IID_PPV_ARGS(&dxc_compiler));
+    }
+    for (;;) {
+      D3D12Shader* shader_to_translate;
       for (;;) {
-        D3D12Shader* shader_to_translate;
-        for (;;) {
-          std::unique_lock<std::mutex> lock(shaders_translation_thread_mutex);
-          if (shaders_to_translate.empty()) {
-            if (shader_translation_threads_shutdown) {
-              return;
-            }
-            shaders_translation_thread_cond.wait(lock);
-            continue;
+        std::unique_lock<std::mutex> lock(shaders_translation_thread_mutex);
+        if (shaders_to_translate.empty()) {
+          if (shader_translation_threads_shutdown) {
+            return;
           }
-          shader_to_translate = shaders_to_translate.front();
-          shaders_to_translate.pop_front();
-          ++shader_translation_threads_busy;
-          break;
-        }
-        if (!shader_to_translate->is_ucode_analyzed()) {
-          shader_to_translate->AnalyzeUcode(ucode_disasm_buffer);
-        }
-        // Translate each needed modification on this thread after performing
-        // modification-independent analysis of the whole shader.
-        uint64_t ucode_data_hash = shader_to_translate->ucode_data_hash();
-        for (auto modification_it = shader_translations_needed.lower_bound(
-                 std::make_pair(ucode_data_hash, uint64_t(0)));
-             modification_it != shader_translations_needed.end() &&
-             modification_it->first == ucode_data_hash;
-             ++modification_it) {
-          D3D12Shader::D3D12Translation* translation =
-              static_cast<D3D12Shader::D3D12Translation*>(
-                  shader_to_translate->GetOrCreateTranslation(
-                      modification_it->second));
-          // Only try (and delete in case of failure) if it's a new translation.
-          // If it's a shader previously encountered in the game, translation of
-          // which has failed, and the shader storage is loaded later, keep it
-          // this way not to try to translate it again.
-          if (!translation->is_translated() &&
-              !TranslateAnalyzedShader(translator, *translation, dxbc_converter,
-                                       dxc_utils, dxc_compiler)) {
-            std::lock_guard<std::mutex> lock(shaders_failed_to_translate_mutex);
-            shaders_failed_to_translate.push_back(translation);
-          }
-        }
-        {
-          std::lock_guard<std::mutex> lock(shaders_translation_thread_mutex);
-          --shader_translation_threads_busy;
+          shaders_translation_thread_cond.wait(lock);
+          continue;
         }
-      }
-      if (dxc_compiler) {
-        dxc_compiler->Release();
-      }
-      if (dxc_utils) {
-        dxc_utils->Release();
-      }
-      if (dxbc_converter) {
-        dxbc_converter->Release();
-      }
-    };
-    std::vector<std::unique_ptr<xe::threading::Thread>>
-        shader_translation_threads;
-
-    while (true) {
-      if (!fread(&shader_header, sizeof(shader_header), 1,
-                 shader_storage_file_)) {
-        break;
-      }
-      size_t ucode_byte_count =
-          shader_header.ucode_dword_count * sizeof(uint32_t);
-      ucode_dwords.resize(shader_header.ucode_dword_count);
-      if (shader_header.ucode_dword_count &&
-          !fread(ucode_dwords.data(), ucode_byte_count, 1,
-                 shader_storage_file_)) {
+        shader_to_translate = shaders_to_translate.front();
+        shaders_to_translate.pop_front();
+        ++shader_translation_threads_busy;
         break;
       }
-      uint64_t ucode_data_hash =
-          XXH3_64bits(ucode_dwords.data(), ucode_byte_count);
-      if (shader_header.ucode_data_hash != ucode_data_hash) {
-        // Validation failed.
-        break;
-      }
-      shader_storage_valid_bytes += sizeof(shader_header) + ucode_byte_count;
-      D3D12Shader* shader =
-          LoadShader(shader_header.type, ucode_dwords.data(),
-                     shader_header.ucode_dword_count, ucode_data_hash);
-      if (shader->ucode_storage_index() == shader_storage_index_) {
-        // Appeared twice in this file for some reason - skip, otherwise race
-        // condition will be caused by translating twice in parallel.
-        continue;
+      if (!shader_to_translate->is_ucode_analyzed()) {
+        shader_to_translate->AnalyzeUcode(ucode_disasm_buffer);
+      }
+      // Translate each needed modification on this thread after performing
+      // modification-independent analysis of the whole shader.
+      uint64_t ucode_data_hash = shader_to_translate->ucode_data_hash();
+      size_t shader_translation_count = 0;
+      for (auto modification_it = shader_translations_needed.lower_bound(
+               std::make_pair(ucode_data_hash, uint64_t(0)));
+           modification_it != shader_translations_needed.end() &&
+           modification_it->first == ucode_data_hash;
+           ++modification_it) {
+        D3D12Shader::D3D12Translation* translation =
+            static_cast<D3D12Shader::D3D12Translation*>(
+                shader_to_translate->GetOrCreateTranslation(
+                    modification_it->second));
+        // Only try (and delete in case of failure) if it's a new translation.
+        // If it's a shader previously encountered in the game, translation of
+        // which has failed, and the shader storage is loaded later, keep it
+        // this way not to try to translate it again.
+        if (!translation->is_translated() &&
+            !TranslateAnalyzedShader(*translator, *translation,
+                                     dxbc_converter, dxc_utils,
+                                     dxc_compiler)) {
+          std::lock_guard<std::mutex> lock(shaders_failed_to_translate_mutex);
+          shaders_failed_to_translate.push_back(translation);
+        }
+        command_processor_.AddShaderStorageProgress(1);
+        ++shader_translation_count;
       }
-      // Loaded from the current storage - don't write again.
-      shader->set_ucode_storage_index(shader_storage_index_);
-      // Create new threads if the currently existing threads can't keep up
-      // with file reading, but not more than the number of logical processors
-      // minus one.
-      size_t shader_translation_threads_needed;
-      {
-        std::lock_guard<std::mutex> lock(shaders_translation_thread_mutex);
-        shader_translation_threads_needed =
-            std::min(shader_translation_threads_busy +
-                         shaders_to_translate.size() + size_t(1),
-                     logical_processor_count - size_t(1));
-      }
-      while (shader_translation_threads.size() <
-             shader_translation_threads_needed) {
-        auto thread = xe::threading::Thread::Create(
-            {}, shader_translation_thread_function);
-        assert_not_null(thread);
-        thread->set_name("Shader Translation");
-        shader_translation_threads.push_back(std::move(thread));
-      }
-      // Request ucode information gathering and translation of all the needed
-      // shaders.
       {
         std::lock_guard<std::mutex> lock(shaders_translation_thread_mutex);
-        shaders_to_translate.push_back(shader);
+        --shader_translation_threads_busy;
+        shaders_translation_completed.insert(ucode_data_hash);
+        shader_translations_done += shader_translation_count;
       }
-      shaders_translation_thread_cond.notify_one();
-      ++shaders_translated;
+      shader_translation_completion_cond.notify_all();
     }
-    if (!shader_translation_threads.empty()) {
-      {
-        std::lock_guard<std::mutex> lock(shaders_translation_thread_mutex);
-        shader_translation_threads_shutdown = true;
-      }
-      shaders_translation_thread_cond.notify_all();
-      for (auto& shader_translation_thread : shader_translation_threads) {
-        xe::threading::Wait(shader_translation_thread.get(), false);
-      }
-      shader_translation_threads.clear();
-      for (D3D12Shader::D3D12Translation* translation :
-           shaders_failed_to_translate) {
-        D3D12Shader* shader = static_cast<D3D12Shader*>(&translation->shader());
-        shader->DestroyTranslation(translation->modification());
-        if (shader->translations().empty()) {
-          shaders_.erase(shader->ucode_data_hash());
-          delete shader;
-        }
-      }
+    if (dxc_compiler) {
+      dxc_compiler->Release();
     }
-    XELOGGPU("Translated {} shaders from the storage in {} milliseconds",
-             shaders_translated,
-             (xe::Clock::QueryHostTickCount() -
-              shader_storage_initialization_start) *
-                 1000 / xe::Clock::QueryHostTickFrequency());
-    xe::filesystem::TruncateStdioFile(shader_storage_file_,
-                                      shader_storage_valid_bytes);
-  } else {
-    xe::filesystem::TruncateStdioFile(shader_storage_file_, 0);
-    shader_storage_file_header.magic = shader_storage_magic;
-    shader_storage_file_header.version_swapped =
-        xe::byte_swap(ShaderStoredHeader::kVersion);
-    fwrite(&shader_storage_file_header, sizeof(shader_storage_file_header), 1,
-           shader_storage_file_);
+    if (dxc_utils) {
+      dxc_utils->Release();
+    }
+    if (dxbc_converter) {
+      dxbc_converter->Release();
+    }
+  };
+  std::vector<std::unique_ptr<xe::threading::Thread>>
+      shader_translation_threads;
+
+  while (true) {
+    if (!fread(&shader_header, sizeof(shader_header), 1,
+               shader_storage_file_)) {
+      break;
+    }
+    size_t ucode_byte_count =
+        shader_header.ucode_dword_count * sizeof(uint32_t);
+    ucode_dwords.resize(shader_header.ucode_dword_count);
+    if (shader_header.ucode_dword_count &&
+        !fread(ucode_dwords.data(), ucode_byte_count, 1,
+               shader_storage_file_)) {
+      break;
+    }
+    uint64_t ucode_data_hash =
+        XXH3_64bits(ucode_dwords.data(), ucode_byte_count);
+    if (shader_header.ucode_data_hash != ucode_data_hash) {
+      // Validation failed.
+      break;
+    }
+    shader_storage_valid_bytes += sizeof(shader_header) + ucode_byte_count;
+    D3D12Shader* shader =
+        LoadShader(shader_header.type, ucode_dwords.data(),
+                   shader_header.ucode_dword_count, ucode_data_hash);
+    if (shader->ucode_storage_index() == shader_storage_index_) {
+      // Appeared twice in this file for some reason - skip, otherwise race
+      // condition will be caused by translating twice in parallel.
+      continue;
+    }
+    // Loaded from the current storage - don't write again.
+    shader->set_ucode_storage_index(shader_storage_index_);
+    // Create new threads if the currently existing threads can't keep up
+    // with file reading, but not more than the number of logical processors
+    // minus one.
+    size_t shader_translation_threads_needed;
+    {
+      std::lock_guard<std::mutex> lock(shaders_translation_thread_mutex);
+      shader_translation_threads_needed = std::min(
+          shader_translation_threads_busy + shaders_to_translate.size() +
+              size_t(1),
+          std::max(logical_processor_count - size_t(1), size_t(1)));
+    }
+    while (shader_translation_threads.size() <
+           shader_translation_threads_needed) {
+      auto thread = xe::threading::Thread::Create(
+          {}, shader_translation_thread_function);
+      assert_not_null(thread);
+      thread->set_name("Shader Translation");
+      shader_translation_threads.push_back(std::move(thread));
+    }
+    // Request ucode information gathering and translation of all the needed
+    // shaders.
+    {
+      std::lock_guard<std::mutex> lock(shaders_translation_thread_mutex);
+      shaders_to_translate.push_back(shader);
+    }
+    shaders_translation_thread_cond.notify_one();
+    ++shaders_translated;
+  }
+  // Drop the shaders after the first corrupted one.
+  if (uint64_t(xe::filesystem::Tell(shader_storage_file_)) !=
+          shader_storage_valid_bytes &&
+      !TruncateShaderStorageFile(shader_storage_file_,
+                                 shader_storage_valid_bytes)) {
+    XELOGW(
+        "The guest shader storage file is corrupted and used by another "
+        "instance, not adding new shaders to it: {}",
+        xe::path_to_utf8(shader_storage_file_path));
+    fclose(shader_storage_file_);
+    shader_storage_file_ = nullptr;
   }
 
-  // Create the pipelines.
+  // Create the pipelines, while the shaders not used by the pipelines created
+  // first are still being translated.
+  uint64_t pipeline_creation_start_ = xe::Clock::QueryHostTickCount();
+  // With asynchronous pipeline creation, the title may start while the
+  // pipelines are still being created on the persistent creation threads -
+  // the draws using them are dropped until they're ready, and the pipelines
+  // needed by the draws are moved to the front of the queue.
+  bool create_pipelines_in_background =
+      cvars::async_pipeline_creation && !creation_threads_.empty();
+  size_t creation_thread_original_count = creation_threads_.size();
+  size_t pipelines_created = 0;
   if (!pipeline_stored_descriptions.empty()) {
-    uint64_t pipeline_creation_start_ = xe::Clock::QueryHostTickCount();
-
     // Launch additional creation threads to use all cores to create
     // pipelines faster. Will also be using the main thread, so minus 1.
-    size_t creation_thread_original_count = creation_threads_.size();
-    size_t creation_thread_needed_count = std::max(
-        std::min(pipeline_stored_descriptions.size(), logical_processor_count) -
-            size_t(1),
-        creation_thread_original_count);
-    while (creation_threads_.size() < creation_thread_original_count) {
-      size_t creation_thread_index = creation_threads_.size();
-      std::unique_ptr<xe::threading::Thread> creation_thread =
-          xe::threading::Thread::Create({}, [this, creation_thread_index]() {
-            CreationThread(creation_thread_index);
-          });
-      assert_not_null(creation_thread);
-      creation_thread->set_name("D3D12 Pipelines");
-      creation_threads_.push_back(std::move(creation_thread));
-    }
+    if (!create_pipelines_in_background) {
+      size_t creation_thread_needed_count =
+          std::max(std::min(pipeline_stored_descriptions.size(),
+                            logical_processor_count) -
+                       size_t(1),
+                   creation_thread_original_count);
+      while (creation_threads_.size() < creation_thread_needed_count) {
+        size_t creation_thread_index = creation_threads_.size();
+        std::unique_ptr<xe::threading::Thread> creation_thread =
+            xe::threading::Thread::Create({}, [this, creation_thread_index]() {
+              CreationThread(creation_thread_index);
+            });
+        assert_not_null(creation_thread);
+        creation_thread->set_name("D3D12 Pipelines");
+        creation_threads_.push_back(std::move(creation_thread));
+      }
+    }
+
+    // Waits until the translations of the shader from the storage needed by
+    // the pipelines are finished.
+    auto await_shader_translation = [&](const D3D12Shader* shader) {
+      if (shader->ucode_storage_index() != shader_storage_index_) {
+        // Not from the storage, not being translated on the storage threads.
+        return;
+      }
+      uint64_t ucode_data_hash = shader->ucode_data_hash();
+      std::unique_lock<std::mutex> lock(shaders_translation_thread_mutex);
+      shader_translation_completion_cond.wait(lock, [&]() {
+        return shaders_translation_completed.find(ucode_data_hash) !=
+               shaders_translation_completed.end();
+      });
+    };
 
-    size_t pipelines_created = 0;
     for (const PipelineStoredDescription& pipeline_stored_description :
          pipeline_stored_descriptions) {
+      // Counted as done unless actually submitted for creation.
+      command_processor_.AddShaderStorageProgress(1);
       const PipelineDescription& pipeline_description =
           pipeline_stored_description.description;
       // TODO(Triang3l): On Vulkan, skip pipelines requiring unsupported device
@@ -617,6 +642,7 @@ void PipelineCache::InitializeShaderStorage(
         continue;
       }
       D3D12Shader* vertex_shader = vertex_shader_it->second;
+      await_shader_translation(vertex_shader);
       pipeline_runtime_description.vertex_shader =
           static_cast<D3D12Shader::D3D12Translation*>(
               vertex_shader->GetTranslation(
@@ -634,6 +660,7 @@ void PipelineCache::InitializeShaderStorage(
           continue;
         }
         pixel_shader = pixel_shader_it->second;
+        await_shader_translation(pixel_shader);
         pipeline_runtime_description.pixel_shader =
             static_cast<D3D12Shader::D3D12Translation*>(
                 pixel_shader->GetTranslation(
@@ -679,7 +706,10 @@ void PipelineCache::InitializeShaderStorage(
                          new_pipeline);
       COUNT_profile_set("gpu/pipeline_cache/pipelines", pipelines_.size());
       if (!creation_threads_.empty()) {
-        // Submit the pipeline for creation to any available thread.
+        // Submit the pipeline for creation to any available thread, counting
+        // the progress when it's created.
+        new_pipeline->from_storage = true;
+        command_processor_.AddShaderStorageProgress(-1);
         {
           std::lock_guard<xe_mutex> lock(creation_request_lock_);
           creation_queue_.push_back(new_pipeline);
@@ -690,64 +720,99 @@ void PipelineCache::InitializeShaderStorage(
       }
       ++pipelines_created;
     }
+  }
 
-    if (!creation_threads_.empty()) {
-      CreateQueuedPipelinesOnProcessorThread();
-      if (creation_threads_.size() > creation_thread_original_count) {
-        {
-          std::lock_guard<xe_mutex> lock(creation_request_lock_);
-          creation_threads_shutdown_from_ = creation_thread_original_count;
-          // Assuming the queue is empty because of
-          // CreateQueuedPipelinesOnProcessorThread.
-        }
-        creation_request_cond_.notify_all();
-        while (creation_threads_.size() > creation_thread_original_count) {
-          xe::threading::Wait(creation_threads_.back().get(), false);
-          creation_threads_.pop_back();
-        }
-        bool await_creation_completion_event;
-        {
-          // Cleanup so additional threads can be created later again.
-          std::lock_guard<xe_mutex> lock(creation_request_lock_);
-          creation_threads_shutdown_from_ = SIZE_MAX;
-          // If the invocation is blocking, all the shader storage
-          // initialization is expected to be done before proceeding, to avoid
-          // latency in the command processor after the invocation.
-          await_creation_completion_event =
-              blocking && creation_threads_busy_ != 0;
-          if (await_creation_completion_event) {
-            creation_completion_event_->Reset();
-            creation_completion_set_event_ = true;
-          }
-        }
+  // All the pipelines using the shaders have been submitted, wait for the
+  // translation of the rest, and drop the translations that have failed.
+  if (!shader_translation_threads.empty()) {
+    {
+      std::lock_guard<std::mutex> lock(shaders_translation_thread_mutex);
+      shader_translation_threads_shutdown = true;
+    }
+    shaders_translation_thread_cond.notify_all();
+    for (auto& shader_translation_thread : shader_translation_threads) {
+      xe::threading::Wait(shader_translation_thread.get(), false);
+    }
+    shader_translation_threads.clear();
+    for (D3D12Shader::D3D12Translation* translation :
+         shaders_failed_to_translate) {
+      D3D12Shader* shader = static_cast<D3D12Shader*>(&translation->shader());
+      shader->DestroyTranslation(translation->modification());
+      if (shader->translations().empty()) {
+        shaders_.erase(shader->ucode_data_hash());
+        delete shader;
+      }
+    }
+  }
+  XELOGGPU("Translated {} shaders from the storage in {} milliseconds",
+           shaders_translated,
+           (xe::Clock::QueryHostTickCount() -
+            shader_storage_initialization_start) *
+               1000 / xe::Clock::QueryHostTickFrequency());
+  // Translations of the shaders missing from the storage.
+  command_processor_.AddShaderStorageProgress(
+      int32_t(shader_translations_needed.size() - shader_translations_done));
+
+  if (pipelines_created && !create_pipelines_in_background) {
+    CreateQueuedPipelinesOnProcessorThread();
+    if (creation_threads_.size() > creation_thread_original_count) {
+      {
+        std::lock_guard<xe_mutex> lock(creation_request_lock_);
+        creation_threads_shutdown_from_ = creation_thread_original_count;
+        // Assuming the queue is empty because of
+        // CreateQueuedPipelinesOnProcessorThread.
+      }
+      creation_request_cond_.notify_all();
+      while (creation_threads_.size() > creation_thread_original_count) {
+        xe::threading::Wait(creation_threads_.back().get(), false);
+        creation_threads_.pop_back();
+      }
+      bool await_creation_completion_event;
+      {
+        // Cleanup so additional threads can be created later again.
+        std::lock_guard<xe_mutex> lock(creation_request_lock_);
+        creation_threads_shutdown_from_ = SIZE_MAX;
+        // If the invocation is blocking, all the shader storage
+        // initialization is expected to be done before proceeding, to avoid
+        // latency in the command processor after the invocation.
+        await_creation_completion_event =
+            blocking && creation_threads_busy_ != 0;
         if (await_creation_completion_event) {
-          creation_request_cond_.notify_one();
-          xe::threading::Wait(creation_completion_event_.get(), false);
+          creation_completion_event_->Reset();
+          creation_completion_set_event_ = true;
         }
       }
+      if (await_creation_completion_event) {
+        creation_request_cond_.notify_one();
+        xe::threading::Wait(creation_completion_event_.get(), false);
+      }
     }
+  }
 
+  if (pipelines_created) {
     XELOGGPU(
-        "Created {} graphics pipelines (not including reading the "
-        "descriptions) from the storage in {} milliseconds",
+        "{} {} graphics pipelines (not including reading the descriptions) "
+        "from the storage in {} milliseconds",
+        create_pipelines_in_background ? "Queued" : "Created",
         pipelines_created,
         (xe::Clock::QueryHostTickCount() - pipeline_creation_start_) * 1000 /
             xe::Clock::QueryHostTickFrequency());
-    // If any pipeline descriptions were corrupted (or the whole file has excess
-    // bytes in the end), truncate to the last valid pipeline description.
-    xe::filesystem::TruncateStdioFile(
-        pipeline_storage_file_,
-        uint64_t(sizeof(pipeline_storage_file_header) +
-                 sizeof(PipelineStoredDescription) *
-                     pipeline_stored_descriptions.size()));
-  } else {
-    xe::filesystem::TruncateStdioFile(pipeline_storage_file_, 0);
-    pipeline_storage_file_header.magic = pipeline_storage_magic;
-    pipeline_storage_file_header.magic_api = pipeline_storage_magic_api;
-    pipeline_storage_file_header.version_swapped =
-        pipeline_storage_version_swapped;
-    fwrite(&pipeline_storage_file_header, sizeof(pipeline_storage_file_header),
-           1, pipeline_storage_file_);
+  }
+
+  // If any pipeline descriptions were corrupted (or the whole file has excess
+  // bytes in the end), drop everything after the last valid one.
+  uint64_t pipeline_storage_valid_bytes =
+      sizeof(pipeline_storage_file_header) +
+      sizeof(PipelineStoredDescription) * pipeline_stored_descriptions.size();
+  if (uint64_t(pipeline_storage_told_end) != pipeline_storage_valid_bytes &&
+      !TruncateShaderStorageFile(pipeline_storage_file_,
+                                 pipeline_storage_valid_bytes)) {
+    XELOGW(
+        "The Direct3D 12 pipeline description storage file is corrupted and "
+        "used by another instance, not adding new pipelines to it: {}",
+        xe::path_to_utf8(pipeline_storage_file_path));
+    fclose(pipeline_storage_file_);
+    pipeline_storage_file_ = nullptr;
   }
 
   shader_storage_cache_root_ = cache_root;
@@ -808,7 +873,10 @@ void PipelineCache::EndSubmission() {
     shader_storage_file_flush_needed_ = false;
     pipeline_storage_file_flush_needed_ = false;
   }
-  if (!creation_threads_.empty()) {
+  // With asynchronous creation, the draws with pipelines not created by the
+  // time the submission is executed are dropped, and the pipelines will be
+  // used in the later submissions once they're ready.
+  if (!creation_threads_.empty() && !cvars::async_pipeline_creation) {
     CreateQueuedPipelinesOnProcessorThread();
     // Await creation of all queued pipelines.
     bool await_creation_completion_event;
@@ -831,7 +899,7 @@ void PipelineCache::EndSubmission() {
 }
 
 bool PipelineCache::IsCreatingPipelines() {
-  if (creation_threads_.empty()) {
+  if (creation_threads_.empty() || cvars::async_pipeline_creation) {
     return false;
   }
   std::lock_guard<xe_mutex> lock(creation_request_lock_);
@@ -895,6 +963,13 @@ PipelineCache::GetCurrentVertexShaderModification(
                regs.Get<reg::VGT_DRAW_INITIATOR>().prim_type ==
                    xenos::PrimitiveType::kPointList);
 
+  xenos::Endian vertex_fetch_endian;
+  if (draw_util::GetVertexFetchUniformEndian(shader, regs,
+                                             vertex_fetch_endian)) {
+    modification.vertex.vertex_fetch_endian_uniform = 1;
+    modification.vertex.vertex_fetch_endian = vertex_fetch_endian;
+  }
+
   return modification;
 }
 
@@ -981,59 +1056,22 @@ bool PipelineCache::ConfigurePipeline(
               register_file_.Get<reg::SQ_PROGRAM_CNTL>().vs_export_mode !=
                   xenos::VertexShaderExportMode::kPosition2VectorsEdgeKill);
   assert_false(register_file_.Get<reg::SQ_PROGRAM_CNTL>().gen_index_vtx);
-  if (!vertex_shader->is_translated()) {
-    if (!vertex_shader->shader().is_ucode_analyzed()) {
-      vertex_shader->shader().AnalyzeUcode(ucode_disasm_buffer_);
-    }
-    if (!TranslateAnalyzedShader(*shader_translator_, *vertex_shader,
-                                 dxbc_converter_, dxc_utils_, dxc_compiler_)) {
-      XELOGE("Failed to translate the vertex shader!");
-      return false;
-    }
-    if (shader_storage_file_ && vertex_shader->shader().ucode_storage_index() !=
-                                    shader_storage_index_) {
-      vertex_shader->shader().set_ucode_storage_index(shader_storage_index_);
-      assert_not_null(storage_write_thread_);
-      shader_storage_file_flush_needed_ = true;
-      {
-        std::lock_guard<std::mutex> lock(storage_write_request_lock_);
-        storage_write_shader_queue_.push_back(&vertex_shader->shader());
-      }
-      storage_write_request_cond_.notify_all();
-    }
+  if (!translations_pending_.empty()) {
+    CollectTranslatedShaders();
   }
-  if (!vertex_shader->is_valid()) {
-    // Translation attempted previously, but not valid.
+  bool vertex_shader_pending, pixel_shader_pending = false;
+  if (!EnsureShaderTranslated(*vertex_shader, vertex_shader_pending)) {
     return false;
   }
-  if (pixel_shader != nullptr) {
-    if (!pixel_shader->is_translated()) {
-      if (!pixel_shader->shader().is_ucode_analyzed()) {
-        pixel_shader->shader().AnalyzeUcode(ucode_disasm_buffer_);
-      }
-      if (!TranslateAnalyzedShader(*shader_translator_, *pixel_shader,
-                                   dxbc_converter_, dxc_utils_,
-                                   dxc_compiler_)) {
-        XELOGE("Failed to translate the pixel shader!");
-        return false;
-      }
-      if (shader_storage_file_ &&
-          pixel_shader->shader().ucode_storage_index() !=
-              shader_storage_index_) {
-        pixel_shader->shader().set_ucode_storage_index(shader_storage_index_);
-        assert_not_null(storage_write_thread_);
-        shader_storage_file_flush_needed_ = true;
-        {
-          std::lock_guard<std::mutex> lock(storage_write_request_lock_);
-          storage_write_shader_queue_.push_back(&pixel_shader->shader());
-        }
-        storage_write_request_cond_.notify_all();
-      }
-    }
-    if (!pixel_shader->is_valid()) {
-      // Translation attempted previously, but not valid.
-      return false;
-    }
+  if (pixel_shader != nullptr &&
+      !EnsureShaderTranslated(*pixel_shader, pixel_shader_pending)) {
+    return false;
+  }
+  if (vertex_shader_pending || pixel_shader_pending) {
+    // Being translated asynchronously, the draw must be skipped.
+    *pipeline_handle_out = nullptr;
+    *root_signature_out = nullptr;
+    return true;
   }
 
   PipelineRuntimeDescription runtime_description;
@@ -1059,6 +1097,24 @@ bool PipelineCache::ConfigurePipeline(
   for (auto it = found_range.first; it != found_range.second; ++it) {
     Pipeline* found_pipeline = it->second;
     if (found_pipeline->description.description == description) {
+      if (!found_pipeline->creation_prioritized &&
+          !creation_threads_.empty() &&
+          !found_pipeline->state.load(std::memory_order_acquire)) {
+        // Likely still in the creation queue after the pipelines from the
+        // storage, needed now.
+        found_pipeline->creation_prioritized = true;
+        bool creation_requeued = false;
+        {
+          std::lock_guard<xe_mutex> lock(creation_request_lock_);
+          if (!found_pipeline->creation_claimed) {
+            creation_queue_.push_front(found_pipeline);
+            creation_requeued = true;
+          }
+        }
+        if (creation_requeued) {
+          creation_request_cond_.notify_one();
+        }
+      }
       current_pipeline_ = found_pipeline;
       *pipeline_handle_out = found_pipeline;
       *root_signature_out = found_pipeline->description.root_signature;
@@ -1075,12 +1131,20 @@ bool PipelineCache::ConfigurePipeline(
 
   if (!creation_threads_.empty()) {
     // Submit the pipeline for creation to any available thread.
+    size_t creation_queue_depth;
     {
       std::lock_guard<xe_mutex> lock(creation_request_lock_);
       creation_queue_.push_back(new_pipeline);
+      creation_queue_depth = creation_queue_.size();
     }
     creation_request_cond_.notify_one();
+    creation_queue_max_depth_ =
+        std::max(creation_queue_max_depth_, creation_queue_depth);
+    COUNT_profile_set("gpu/pipeline_cache/creation_queue",
+                      creation_queue_depth);
   } else {
+    frame_timeline::ScopedActivity frame_timeline_activity(
+        frame_timeline::Activity::kPipelineCreation);
     new_pipeline->state = CreateD3D12Pipeline(runtime_description);
   }
 
@@ -1105,6 +1169,107 @@ bool PipelineCache::ConfigurePipeline(
   return true;
 }
 
+std::unique_ptr<DxbcShaderTranslator> PipelineCache::CreateShaderTranslator()
+    const {
+  const ui::d3d12::D3D12Provider& provider =
+      command_processor_.GetD3D12Provider();
+  return std::make_unique<DxbcShaderTranslator>(
+      provider.GetAdapterVendorID(), bindless_resources_used_,
+      render_target_cache_.GetPath() ==
+          RenderTargetCache::Path::kPixelShaderInterlock,
+      render_target_cache_.gamma_render_target_as_srgb(),
+      render_target_cache_.msaa_2x_supported(),
+      render_target_cache_.draw_resolution_scale_x(),
+      render_target_cache_.draw_resolution_scale_y(),
+      provider.GetGraphicsAnalysis() != nullptr);
+}
+
+bool PipelineCache::EnsureShaderTranslated(
+    D3D12Shader::D3D12Translation& translation, bool& pending_out) {
+  pending_out = false;
+  // Not touching the translation while a creation thread may be writing it.
+  if (!translations_pending_.empty() &&
+      translations_pending_.find(&translation) != translations_pending_.end()) {
+    pending_out = true;
+    return true;
+  }
+  if (!translation.is_translated()) {
+    Shader& shader = translation.shader();
+    if (!shader.is_ucode_analyzed()) {
+      shader.AnalyzeUcode(ucode_disasm_buffer_);
+    }
+    if (cvars::async_pipeline_creation && !creation_threads_.empty()) {
+      translations_pending_.insert(&translation);
+      size_t translation_queue_depth;
+      {
+        std::lock_guard<xe_mutex> lock(creation_request_lock_);
+        translation_queue_.push_back(&translation);
+        translation_queue_depth = translation_queue_.size();
+      }
+      creation_request_cond_.notify_one();
+      translation_queue_max_depth_ =
+          std::max(translation_queue_max_depth_, translation_queue_depth);
+      COUNT_profile_set("gpu/pipeline_cache/translation_queue",
+                        translation_queue_depth);
+      pending_out = true;
+      return true;
+    }
+    if (!TranslateAnalyzedShader(*shader_translator_, translation,
+                                 dxbc_converter_, dxc_utils_, dxc_compiler_)) {
+      XELOGE("Failed to translate the {} shader!",
+             shader.type() == xenos::ShaderType::kVertex ? "vertex" : "pixel");
+      return false;
+    }
+    StoreShader(shader);
+  }
+  // False if the translation was attempted previously, but not valid.
+  return translation.is_valid();
+}
+
+void PipelineCache::CollectTranslatedShaders() {
+  std::vector<D3D12Shader::D3D12Translation*> translations_completed;
+  {
+    std::lock_guard<xe_mutex> lock(creation_request_lock_);
+    translations_completed.swap(translations_completed_);
+  }
+  for (D3D12Shader::D3D12Translation* translation : translations_completed) {
+    translations_pending_.erase(translation);
+    if (translation->is_valid()) {
+      StoreShader(translation->shader());
+    }
+  }
+}
+
+void PipelineCache::AwaitPendingTranslations() {
+  if (translations_pending_.empty()) {
+    return;
+  }
+  {
+    std::unique_lock<xe_mutex> lock(creation_request_lock_);
+    translation_completion_awaited_ = true;
+    while (translations_completed_.size() < translations_pending_.size()) {
+      creation_request_cond_.wait(lock);
+    }
+    translation_completion_awaited_ = false;
+  }
+  CollectTranslatedShaders();
+}
+
+void PipelineCache::StoreShader(Shader& shader) {
+  if (!shader_storage_file_ ||
+      shader.ucode_storage_index() == shader_storage_index_) {
+    return;
+  }
+  assert_not_null(storage_write_thread_);
+  shader.set_ucode_storage_index(shader_storage_index_);
+  shader_storage_file_flush_needed_ = true;
+  {
+    std::lock_guard<std::mutex> lock(storage_write_request_lock_);
+    storage_write_shader_queue_.push_back(&shader);
+  }
+  storage_write_request_cond_.notify_all();
+}
+
 bool PipelineCache::TranslateAnalyzedShader(
     DxbcShaderTranslator& translator,
     D3D12Shader::D3D12Translation& translation, IDxbcConverter* dxbc_converter,
@@ -3233,8 +3398,12 @@ void PipelineCache::StorageWriteThread() {
   // Don't leak anything in unused bits.
   std::memset(&shader_header, 0, sizeof(shader_header));
 
-  std::vector<uint32_t> ucode_guest_endian;
-  ucode_guest_endian.reserve(0xFFFF);
+  // The header followed by the ucode.
+  static_assert(sizeof(shader_header) % sizeof(uint32_t) == 0);
+  constexpr size_t kShaderHeaderDwordCount =
+      sizeof(shader_header) / sizeof(uint32_t);
+  std::vector<uint32_t> shader_record;
+  shader_record.reserve(kShaderHeaderDwordCount + 0xFFFF);
 
   bool flush_shaders = false;
   bool flush_pipelines = false;
@@ -3286,38 +3455,46 @@ void PipelineCache::StorageWriteThread() {
       shader_header.ucode_data_hash = shader->ucode_data_hash();
       shader_header.ucode_dword_count = shader->ucode_dword_count();
       shader_header.type = shader->type();
+      shader_record.resize(kShaderHeaderDwordCount +
+                           shader_header.ucode_dword_count);
+      std::memcpy(shader_record.data(), &shader_header, sizeof(shader_header));
+      // Need to swap because the hash is calculated for the shader with guest
+      // endianness.
+      xe::copy_and_swap(shader_record.data() + kShaderHeaderDwordCount,
+                        shader->ucode_dwords(),
+                        shader_header.ucode_dword_count);
+      // Whole records are appended at once, as other instances may be
+      // appending to the same file.
       assert_not_null(shader_storage_file_);
-      fwrite(&shader_header, sizeof(shader_header), 1, shader_storage_file_);
-      if (shader_header.ucode_dword_count) {
-        ucode_guest_endian.resize(shader_header.ucode_dword_count);
-        // Need to swap because the hash is calculated for the shader with guest
-        // endianness.
-        xe::copy_and_swap(ucode_guest_endian.data(), shader->ucode_dwords(),
-                          shader_header.ucode_dword_count);
-        fwrite(ucode_guest_endian.data(),
-               shader_header.ucode_dword_count * sizeof(uint32_t), 1,
-               shader_storage_file_);
-      }
+      xe::filesystem::AppendToStdioFile(
+          shader_storage_file_, shader_record.data(),
+          sizeof(uint32_t) * shader_record.size());
     }
 
     if (write_pipeline) {
       assert_not_null(pipeline_storage_file_);
-      fwrite(&pipeline_description, sizeof(pipeline_description), 1,
-             pipeline_storage_file_);
+      xe::filesystem::AppendToStdioFile(pipeline_storage_file_,
+                                        &pipeline_description,
+                                        sizeof(pipeline_description));
     }
   }
 }
 
 void PipelineCache::CreationThread(size_t thread_index) {
+  // Created when the first shader is translated on this thread. DXIL
+  // disassembly is not done here, it's only for debugging.
+  std::unique_ptr<DxbcShaderTranslator> translator;
+
   while (true) {
     Pipeline* pipeline_to_create = nullptr;
+    D3D12Shader::D3D12Translation* translation_to_do = nullptr;
 
     // Check if need to shut down or set the completion event and dequeue the
-    // pipeline if there is any.
+    // shader or the pipeline if there is any.
     {
       std::unique_lock<xe_mutex> lock(creation_request_lock_);
       if (thread_index >= creation_threads_shutdown_from_ ||
-          creation_queue_.empty()) {
+          (translation_queue_.empty() && creation_queue_.empty())) {
         if (creation_completion_set_event_ && creation_threads_busy_ == 0) {
           // Last pipeline in the queue created - signal the event if requested.
           creation_completion_set_event_ = false;
@@ -3329,18 +3506,50 @@ void PipelineCache::CreationThread(size_t thread_index) {
         creation_request_cond_.wait(lock);
         continue;
       }
-      // Take the pipeline from the queue and increment the busy thread count
-      // until the pipeline is created - other threads must be able to dequeue
-      // requests, but can't set the completion event until the pipelines are
-      // fully created (rather than just started creating).
-      pipeline_to_create = creation_queue_.front();
-      creation_queue_.pop_front();
-      ++creation_threads_busy_;
+      if (!translation_queue_.empty()) {
+        translation_to_do = translation_queue_.front();
+        translation_queue_.pop_front();
+      } else {
+        // Take the pipeline from the queue and increment the busy thread count
+        // until the pipeline is created - other threads must be able to
+        // dequeue requests, but can't set the completion event until the
+        // pipelines are fully created (rather than just started creating).
+        pipeline_to_create = creation_queue_.front();
+        creation_queue_.pop_front();
+        if (pipeline_to_create->creation_claimed) {
+          // Moved to the front of the queue, and already taken from there.
+          continue;
+        }
+        pipeline_to_create->creation_claimed = true;
+        ++creation_threads_busy_;
+      }
+    }
+
+    if (translation_to_do) {
+      if (!translator) {
+        translator = CreateShaderTranslator();
+      }
+      // If failed, the translation is left invalid and will be ignored.
+      TranslateAnalyzedShader(*translator, *translation_to_do);
+      bool notify_completion;
+      {
+        std::lock_guard<xe_mutex> lock(creation_request_lock_);
+        translations_completed_.push_back(translation_to_do);
+        notify_completion = translation_completion_awaited_;
+      }
+      if (notify_completion) {
+        creation_request_cond_.notify_all();
+      }
+      continue;
     }
 
     // Create the D3D12 pipeline state object.
-    pipeline_to_create->state =
-        CreateD3D12Pipeline(pipeline_to_create->description);
+    pipeline_to_create->state.store(
+        CreateD3D12Pipeline(pipeline_to_create->description),
+        std::memory_order_release);
+    if (pipeline_to_create->from_storage) {
+      command_processor_.AddShaderStorageProgress(1);
+    }
 
     // Pipeline created - the thread is not busy anymore, safe to set the
     // completion event if needed (at the next iteration, or in some other
@@ -3363,9 +3572,17 @@ void PipelineCache::CreateQueuedPipelinesOnProcessorThread() {
       }
       pipeline_to_create = creation_queue_.front();
       creation_queue_.pop_front();
+      if (pipeline_to_create->creation_claimed) {
+        continue;
+      }
+      pipeline_to_create->creation_claimed = true;
+    }
+    pipeline_to_create->state.store(
+        CreateD3D12Pipeline(pipeline_to_create->description),
+        std::memory_order_release);
+    if (pipeline_to_create->from_storage) {
+      command_processor_.AddShaderStorageProgress(1);
     }
-    pipeline_to_create->state =
-        CreateD3D12Pipeline(pipeline_to_create->description);
   }
 }
 
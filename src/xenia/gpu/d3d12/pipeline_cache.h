@@ -10,6 +10,7 @@
 #ifndef XENIA_GPU_D3D12_PIPELINE_CACHE_H_
 #define XENIA_GPU_D3D12_PIPELINE_CACHE_H_
 
+#include <atomic>
 #include <condition_variable>
 #include <cstdio>
 #include <deque>
@@ -19,6 +20,7 @@
 #include <string>
 #include <thread>
 #include <unordered_map>
+#include <unordered_set>
 #include <utility>
 #include <vector>
 
@@ -99,9 +101,11 @@ class PipelineCache {
       void** pipeline_handle_out, ID3D12RootSignature** root_signature_out);
 
   // Returns a pipeline with deferred creation by its handle. May return nullptr
-  // if failed to create the pipeline.
+  // if failed to create the pipeline, or, with asynchronous pipeline creation,
+  // if it hasn't been created yet.
   ID3D12PipelineState* GetD3D12PipelineByHandle(void* handle) const {
-    return reinterpret_cast<const Pipeline*>(handle)->state;
+    return reinterpret_cast<const Pipeline*>(handle)->state.load(
+        std::memory_order_acquire);
   }
 
  private:
@@ -274,6 +278,10 @@ class PipelineCache {
                           const uint32_t* host_address, uint32_t dword_count,
                           uint64_t data_hash);
 
+  // Creates a translator for the current configuration, for use on one
+  // thread.
+  std::unique_ptr<DxbcShaderTranslator> CreateShaderTranslator() const;
+
   // Can be called from multiple threads.
   bool TranslateAnalyzedShader(DxbcShaderTranslator& translator,
                                D3D12Shader::D3D12Translation& translation,
@@ -281,6 +289,21 @@ class PipelineCache {
                                IDxcUtils* dxc_utils = nullptr,
                                IDxcCompiler* dxc_compiler = nullptr);
 
+  // Translates the shader on the processor thread if needed, or, with
+  // asynchronous pipeline creation, queues it for translation on the creation
+  // threads, setting pending_out - the translation must not be accessed then
+  // until it's collected. Returns false if the translation is not valid.
+  bool EnsureShaderTranslated(D3D12Shader::D3D12Translation& translation,
+                              bool& pending_out);
+  // Makes the translations done by the creation threads usable.
+  void CollectTranslatedShaders();
+  // Waits for all queued translations to be done and collects them.
+  void AwaitPendingTranslations();
+
+  // Queues the ucode for writing to the currently open storage if it hasn't
+  // been written to it yet.
+  void StoreShader(Shader& shader);
+
   // If draw_util::IsRasterizationPotentiallyDone is false, the pixel shader
   // MUST be made nullptr BEFORE calling this! The shaders must be translated
   // and valid.
@@ -358,9 +381,20 @@ class PipelineCache {
   std::vector<uint8_t> depth_only_pixel_shader_;
 
   struct Pipeline {
-    // nullptr if creation has failed.
-    ID3D12PipelineState* state;
+    // nullptr if creation has failed, or hasn't been finished yet. Written by
+    // the creation threads while it may be read on the processor thread with
+    // asynchronous pipeline creation.
+    std::atomic<ID3D12PipelineState*> state;
     PipelineRuntimeDescription description;
+    // Whether a thread has taken the pipeline from the creation queue, which
+    // may contain it twice if it was moved to the front. Protected with
+    // creation_request_lock_.
+    bool creation_claimed = false;
+    // Whether the pipeline was moved to the front of the creation queue, only
+    // accessed on the processor thread.
+    bool creation_prioritized = false;
+    // Whether the creation is counted in the shader storage loading progress.
+    bool from_storage = false;
   };
   // All previously generated pipelines identified by hash and the description.
   std::unordered_multimap<uint64_t, Pipeline*,
@@ -408,6 +442,23 @@ class PipelineCache {
   // Protected with creation_request_lock_, notify_one creation_request_cond_
   // when set.
   std::deque<Pipeline*> creation_queue_;
+  // Shaders to translate with asynchronous pipeline creation, taken before the
+  // pipelines since draws are waiting for them. Protected with
+  // creation_request_lock_, notify_one creation_request_cond_ when set.
+  std::deque<D3D12Shader::D3D12Translation*> translation_queue_;
+  // Translations done by the creation threads, not collected yet. Protected
+  // with creation_request_lock_.
+  std::vector<D3D12Shader::D3D12Translation*> translations_completed_;
+  // Whether the processor thread is waiting for the translations - if set,
+  // notify_all creation_request_cond_ when a translation is completed.
+  // Protected with creation_request_lock_.
+  bool translation_completion_awaited_ = false;
+  // Translations queued and not collected yet, only accessed on the processor
+  // thread.
+  std::unordered_set<D3D12Shader::D3D12Translation*> translations_pending_;
+  // The deepest the queues have been, for tuning the creation thread count.
+  size_t translation_queue_max_depth_ = 0;
+  size_t creation_queue_max_depth_ = 0;
   // Number of threads that are currently creating a pipeline - incremented when
   // a pipeline is dequeued (the completion event can't be triggered before this
   // is zero). Protected with creation_request_lock_.
@@ -51,6 +51,7 @@ project("xenia-gpu-d3d12-trace-viewer")
     "mspack",
     "snappy",
     "xxhash",
+    "zstd",
   })
   files({
     "d3d12_trace_viewer_main.cc",
@@ -103,6 +104,7 @@ project("xenia-gpu-d3d12-trace-dump")
     "mspack",
     "snappy",
     "xxhash",
+    "zstd",
   })
   files({
     "d3d12_trace_dump_main.cc",
@@ -122,3 +124,56 @@ project("xenia-gpu-d3d12-trace-dump")
     links({
       "xenia-cpu-backend-x64",
     })
+
+group("src")
+project("xenia-gpu-d3d12-trace-benchmark")
+  uuid("641ffcce-eb88-4ec4-a0a1-c9052b69906d")
+  kind("ConsoleApp")
+  language("C++")
+  links({
+    "xenia-apu",
+    "xenia-apu-nop",
+    "xenia-base",
+    "xenia-core",
+    "xenia-cpu",
+    "xenia-gpu",
+    "xenia-gpu-d3d12",
+    "xenia-hid",
+    "xenia-hid-nop",
+    "xenia-kernel",
+    "xenia-ui",
+    "xenia-ui-d3d12",
+    "xenia-vfs",
+    "xenia-patcher",
+  })
+  links({
+    "aes_128",
+    "capstone",
+    "dxbc",
+    "fmt",
+    "imgui",
+    "libavcodec",
+    "libavutil",
+    "mspack",
+    "snappy",
+    "xxhash",
+    "zstd",
+  })
+  files({
+    "d3d12_trace_benchmark_main.cc",
+    "../../base/console_app_main_"..platform_suffix..".cc",
+  })
+  -- Only create the .user file if it doesn't already exist.
+  local user_file = project_root.."/build/xenia-gpu-d3d12-trace-benchmark.vcxproj.user"
+  if not os.isfile(user_file) then
+    debugdir(project_root)
+    debugargs({
+      "2>&1",
+      "1>scratch/stdout-trace-benchmark.txt",
+    })
+  end
+
+  filter("architecture:x86_64")
+    links({
+      "xenia-cpu-backend-x64",
+    })
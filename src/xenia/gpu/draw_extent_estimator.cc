@@ -14,6 +14,7 @@
 #include <cstdint>
 
 #include "xenia/base/assert.h"
+#include "xenia/base/clock.h"
 #include "xenia/base/cvar.h"
 #include "xenia/base/memory.h"
 #include "xenia/base/profiling.h"
@@ -53,22 +54,23 @@ namespace xe {
 namespace gpu {
 
 void DrawExtentEstimator::PositionYExportSink::Export(
-    ucode::ExportRegister export_register, const float* value,
-    uint32_t value_mask) {
+    uint32_t invocation, ucode::ExportRegister export_register,
+    const float* value, uint32_t value_mask) {
+  assert_true(invocation < ShaderInterpreter::kMaxInvocations);
   if (export_register == ucode::ExportRegister::kVSPosition) {
     if (value_mask & 0b0010) {
-      position_y_ = value[1];
+      position_y_[invocation] = value[1];
     }
     if (value_mask & 0b1000) {
-      position_w_ = value[3];
+      position_w_[invocation] = value[3];
     }
   } else if (export_register ==
              ucode::ExportRegister::kVSPointSizeEdgeFlagKillVertex) {
     if (value_mask & 0b0001) {
-      point_size_ = value[0];
+      point_size_[invocation] = value[0];
     }
     if (value_mask & 0b0100) {
-      vertex_kill_ = xe::memory::Reinterpret<uint32_t>(value[2]);
+      vertex_kill_[invocation] = xe::memory::Reinterpret<uint32_t>(value[2]);
     }
   }
 }
@@ -169,9 +171,83 @@ uint32_t DrawExtentEstimator::EstimateVertexMaxY(const Shader& vertex_shader) {
   float max_y = -FLT_MAX;
 
   shader_interpreter_.SetShader(vertex_shader);
+  auto skippable_instructions_it =
+      vertex_shader_skippable_instructions_.find(
+          vertex_shader.ucode_data_hash());
+  if (skippable_instructions_it ==
+      vertex_shader_skippable_instructions_.end()) {
+    skippable_instructions_it =
+        vertex_shader_skippable_instructions_
+            .emplace(vertex_shader.ucode_data_hash(), std::vector<uint64_t>())
+            .first;
+    ShaderInterpreter::GetInstructionsSkippableForExports(
+        vertex_shader,
+        (UINT64_C(1) << uint32_t(ucode::ExportRegister::kVSPosition)) |
+            (UINT64_C(1) << uint32_t(
+                 ucode::ExportRegister::kVSPointSizeEdgeFlagKillVertex)),
+        skippable_instructions_it->second);
+  }
+  shader_interpreter_.SetSkippedInstructions(
+      skippable_instructions_it->second.data(),
+      uint32_t(skippable_instructions_it->second.size() * 64));
 
   PositionYExportSink position_y_export_sink;
   shader_interpreter_.SetExportSink(&position_y_export_sink);
+  uint64_t interpretation_start_ticks = Clock::QueryHostTickCount();
+  uint32_t batch_vertex_count = 0;
+  auto execute_batch = [&]() {
+    if (!batch_vertex_count) {
+      return;
+    }
+    position_y_export_sink.Reset();
+    shader_interpreter_.Execute(batch_vertex_count);
+    statistics_.vertex_count += batch_vertex_count;
+    for (uint32_t j = 0; j < batch_vertex_count; ++j) {
+      if (position_y_export_sink.vertex_kill(j).has_value() &&
+          (position_y_export_sink.vertex_kill(j).value() &
+           ~(UINT32_C(1) << 31))) {
+        continue;
+      }
+      if (!position_y_export_sink.position_y(j).has_value()) {
+        continue;
+      }
+      float vertex_y = position_y_export_sink.position_y(j).value();
+      if (!pa_cl_vte_cntl.vtx_xy_fmt) {
+        if (!position_y_export_sink.position_w(j).has_value()) {
+          continue;
+        }
+        vertex_y /= position_y_export_sink.position_w(j).value();
+      }
+
+      vertex_y = vertex_y * viewport_y_scale + viewport_y_offset;
+
+      if (vgt_draw_initiator.prim_type == xenos::PrimitiveType::kPointList) {
+        float point_radius_y;
+        if (position_y_export_sink.point_size(j).has_value()) {
+          // Vertex-specified diameter. Clamped effectively as a signed integer
+          // in the hardware, -NaN, -Infinity ... -0 to the minimum, +Infinity,
+          // +NaN to the maximum.
+          point_radius_y =
+              0.5f *
+              xe::memory::Reinterpret<float>(std::min(
+                  point_vertex_max_diameter_float,
+                  std::max(point_vertex_min_diameter_float,
+                           xe::memory::Reinterpret<int32_t>(
+                               position_y_export_sink.point_size(j).value()))));
+        } else {
+          // Constant radius.
+          point_radius_y = point_constant_radius_y;
+        }
+        vertex_y += point_radius_y;
+      }
+
+      // std::max is `a < b ? b : a`, thus in case of NaN, the first argument
+      // is always returned - max_y, which is initialized to a normalized
+      // value.
+      max_y = std::max(max_y, vertex_y);
+    }
+    batch_vertex_count = 0;
+  };
   for (uint32_t i = 0; i < vgt_draw_initiator.num_indices; ++i) {
     uint32_t vertex_index;
     if (vgt_draw_initiator.source_select == xenos::SourceSelect::kDMA) {
@@ -198,52 +274,15 @@ uint32_t DrawExtentEstimator::EstimateVertexMaxY(const Shader& vertex_shader) {
         std::min(max_index,
                  std::max(min_index, (vertex_index + index_offset) & 0xFFFFFF));
 
-    position_y_export_sink.Reset();
-
-    shader_interpreter_.temp_registers()[0] = float(vertex_index);
-    shader_interpreter_.Execute();
-
-    if (position_y_export_sink.vertex_kill().has_value() &&
-        (position_y_export_sink.vertex_kill().value() & ~(UINT32_C(1) << 31))) {
-      continue;
-    }
-    if (!position_y_export_sink.position_y().has_value()) {
-      continue;
-    }
-    float vertex_y = position_y_export_sink.position_y().value();
-    if (!pa_cl_vte_cntl.vtx_xy_fmt) {
-      if (!position_y_export_sink.position_w().has_value()) {
-        continue;
-      }
-      vertex_y /= position_y_export_sink.position_w().value();
-    }
-
-    vertex_y = vertex_y * viewport_y_scale + viewport_y_offset;
-
-    if (vgt_draw_initiator.prim_type == xenos::PrimitiveType::kPointList) {
-      float point_radius_y;
-      if (position_y_export_sink.point_size().has_value()) {
-        // Vertex-specified diameter. Clamped effectively as a signed integer in
-        // the hardware, -NaN, -Infinity ... -0 to the minimum, +Infinity, +NaN
-        // to the maximum.
-        point_radius_y =
-            0.5f *
-            xe::memory::Reinterpret<float>(std::min(
-                point_vertex_max_diameter_float,
-                std::max(point_vertex_min_diameter_float,
-                         xe::memory::Reinterpret<int32_t>(
-                             position_y_export_sink.point_size().value()))));
-      } else {
-        // Constant radius.
-        point_radius_y = point_constant_radius_y;
-      }
-      vertex_y += point_radius_y;
+    shader_interpreter_.temp_registers(batch_vertex_count)[0] =
+        float(vertex_index);
+    if (++batch_vertex_count >= ShaderInterpreter::kMaxInvocations) {
+      execute_batch();
     }
-
-    // std::max is `a < b ? b : a`, thus in case of NaN, the first argument is
-    // always returned - max_y, which is initialized to a normalized value.
-    max_y = std::max(max_y, vertex_y);
   }
+  execute_batch();
+  statistics_.host_ticks +=
+      Clock::QueryHostTickCount() - interpretation_start_ticks;
   shader_interpreter_.SetExportSink(nullptr);
 
   int32_t max_y_24p8 = ui::FloatToD3D11Fixed16p8(max_y);
@@ -12,6 +12,8 @@
 
 #include <cstdint>
 #include <optional>
+#include <unordered_map>
+#include <vector>
 
 #include "xenia/gpu/register_file.h"
 #include "xenia/gpu/shader.h"
@@ -33,34 +35,53 @@ class DrawExtentEstimator {
     shader_interpreter_.SetTraceWriter(trace_writer);
   }
 
+  struct Statistics {
+    // Vertices the vertex shader has been executed for on the CPU.
+    uint64_t vertex_count = 0;
+    // Time spent executing the vertex shader, in host ticks.
+    uint64_t host_ticks = 0;
+  };
+
   // The shader must have its ucode analyzed.
   uint32_t EstimateVertexMaxY(const Shader& vertex_shader);
   uint32_t EstimateMaxY(bool try_to_estimate_vertex_max_y,
                         const Shader& vertex_shader);
 
+  const Statistics& statistics() const { return statistics_; }
+
  private:
   class PositionYExportSink : public ShaderInterpreter::ExportSink {
    public:
-    void Export(ucode::ExportRegister export_register, const float* value,
-                uint32_t value_mask) override;
+    void Export(uint32_t invocation, ucode::ExportRegister export_register,
+                const float* value, uint32_t value_mask) override;
 
     void Reset() {
-      position_y_.reset();
-      position_w_.reset();
-      point_size_.reset();
-      vertex_kill_.reset();
+      for (uint32_t i = 0; i < ShaderInterpreter::kMaxInvocations; ++i) {
+        position_y_[i].reset();
+        position_w_[i].reset();
+        point_size_[i].reset();
+        vertex_kill_[i].reset();
+      }
     }
 
-    const std::optional<float>& position_y() const { return position_y_; }
-    const std::optional<float>& position_w() const { return position_w_; }
-    const std::optional<float>& point_size() const { return point_size_; }
-    const std::optional<uint32_t>& vertex_kill() const { return vertex_kill_; }
+    const std::optional<float>& position_y(uint32_t invocation) const {
+      return position_y_[invocation];
+    }
+    const std::optional<float>& position_w(uint32_t invocation) const {
+      return position_w_[invocation];
+    }
+    const std::optional<float>& point_size(uint32_t invocation) const {
+      return point_size_[invocation];
+    }
+    const std::optional<uint32_t>& vertex_kill(uint32_t invocation) const {
+      return vertex_kill_[invocation];
+    }
 
    private:
-    std::optional<float> position_y_;
-    std::optional<float> position_w_;
-    std::optional<float> point_size_;
-    std::optional<uint32_t> vertex_kill_;
+    std::optional<float> position_y_[ShaderInterpreter::kMaxInvocations];
+    std::optional<float> position_w_[ShaderInterpreter::kMaxInvocations];
+    std::optional<float> point_size_[ShaderInterpreter::kMaxInvocations];
+    std::optional<uint32_t> vertex_kill_[ShaderInterpreter::kMaxInvocations];
   };
 
   const RegisterFile& register_file_;
@@ -68,6 +89,14 @@ class DrawExtentEstimator {
   TraceWriter* trace_writer_;
 
   ShaderInterpreter shader_interpreter_;
+
+  Statistics statistics_;
+
+  // Instructions not involved in calculating the position, the point size and
+  // the vertex kill flag, for skipping them in the interpreter, by vertex
+  // shader ucode hash.
+  std::unordered_map<uint64_t, std::vector<uint64_t>>
+      vertex_shader_skippable_instructions_;
 };
 
 }  // namespace gpu
@@ -159,6 +159,25 @@ bool IsPixelShaderNeededWithRasterization(const Shader& shader,
   return false;
 }
 
+bool GetVertexFetchUniformEndian(const Shader& shader, const RegisterFile& regs,
+                                 xenos::Endian& endian_out) {
+  const std::vector<Shader::VertexBinding>& vertex_bindings =
+      shader.vertex_bindings();
+  if (vertex_bindings.empty()) {
+    return false;
+  }
+  xenos::Endian endian =
+      regs.GetVertexFetch(vertex_bindings.front().fetch_constant).endian;
+  for (size_t i = 1; i < vertex_bindings.size(); ++i) {
+    if (regs.GetVertexFetch(vertex_bindings[i].fetch_constant).endian !=
+        endian) {
+      return false;
+    }
+  }
+  endian_out = endian;
+  return true;
+}
+
 static float ViewportRecip2_0(float f) {
   float f1 = ArchReciprocalRefined(f);
   return f1 + f1;
@@ -262,6 +262,13 @@ inline bool DoesCoverageDependOnAlpha(reg::RB_COLORCONTROL rb_colorcontrol) {
 bool IsPixelShaderNeededWithRasterization(const Shader& shader,
                                           const RegisterFile& regs);
 
+// Returns whether all the vertex fetch constants used by the shader have the
+// same endianness, so the translated shader can swap the fetched words
+// statically instead of selecting the swap based on the fetch constant at
+// runtime. Almost all titles use 8-in-32 for all vertex buffers.
+bool GetVertexFetchUniformEndian(const Shader& shader, const RegisterFile& regs,
+                                 xenos::Endian& endian_out);
+
 struct ViewportInfo {
   // Offset from render target UV = 0 to +UV.
   // For simplicity of cropping to the maximum size on the host; to match the
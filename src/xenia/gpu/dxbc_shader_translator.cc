@@ -987,6 +987,11 @@ void DxbcShaderTranslator::StartTranslation() {
 
   // Start the main loop (for jumping to labels by setting pc and continuing).
   a_.OpLoop();
+  // With structured control flow, the loop is only needed for breaking from
+  // exece, and the program counter is not used.
+  if (is_control_flow_structured()) {
+    return;
+  }
   // Switch and the first label (pc == 0).
   if (UseSwitchForControlFlow()) {
     a_.OpSwitch(dxbc::Src::R(system_temp_ps_pc_p0_a0_, dxbc::Src::kYYYY));
@@ -1121,11 +1126,13 @@ void DxbcShaderTranslator::CompleteShaderCode() {
     // closing upper-level flow control blocks.
     CloseExecConditionals();
     // Close the last label and the switch.
-    if (UseSwitchForControlFlow()) {
-      a_.OpBreak();
-      a_.OpEndSwitch();
-    } else {
-      a_.OpEndIf();
+    if (!is_control_flow_structured()) {
+      if (UseSwitchForControlFlow()) {
+        a_.OpBreak();
+        a_.OpEndSwitch();
+      } else {
+        a_.OpEndIf();
+      }
     }
     // End the main loop.
     a_.OpBreak();
@@ -1838,7 +1845,7 @@ void DxbcShaderTranslator::ProcessExecInstructionEnd(
   if (instr.is_end) {
     // Break out of the main loop.
     CloseInstructionPredication();
-    if (UseSwitchForControlFlow()) {
+    if (UseSwitchForControlFlow() && !is_control_flow_structured()) {
       // Write an invalid value to pc.
       a_.OpMov(dxbc::Dest::R(system_temp_ps_pc_p0_a0_, 0b0010),
                dxbc::Src::LU(UINT32_MAX));
@@ -1880,9 +1887,14 @@ void DxbcShaderTranslator::ProcessLoopStartInstruction(
              dxbc::Src::LU(UINT8_MAX));
 
     // Skip the loop without pushing if the count is zero from the beginning.
-    a_.OpIf(false, dxbc::Src::R(loop_count_temp, dxbc::Src::kXXXX));
-    JumpToLabel(instr.loop_skip_address);
-    a_.OpEndIf();
+    if (is_control_flow_structured()) {
+      // Closed after the host loop in ProcessLoopEndInstruction.
+      a_.OpIf(true, dxbc::Src::R(loop_count_temp, dxbc::Src::kXXXX));
+    } else {
+      a_.OpIf(false, dxbc::Src::R(loop_count_temp, dxbc::Src::kXXXX));
+      JumpToLabel(instr.loop_skip_address);
+      a_.OpEndIf();
+    }
 
     // Push the count to the loop count stack - move XYZ to YZW and set X to the
     // new loop count.
@@ -1903,6 +1915,10 @@ void DxbcShaderTranslator::ProcessLoopStartInstruction(
     a_.OpUBFE(dxbc::Dest::R(system_temp_aL_, 0b0001), dxbc::Src::LU(8),
               dxbc::Src::LU(8), loop_constant_src);
   }
+
+  if (is_control_flow_structured()) {
+    a_.OpLoop();
+  }
 }
 
 void DxbcShaderTranslator::ProcessLoopEndInstruction(
@@ -1959,8 +1975,15 @@ void DxbcShaderTranslator::ProcessLoopEndInstruction(
              dxbc::Src::R(system_temp_aL_, 0b111001));
     a_.OpMov(dxbc::Dest::R(system_temp_aL_, 0b1000), dxbc::Src::LI(0));
     // Now going to fall through to the next exec (no need to jump).
+    if (is_control_flow_structured()) {
+      a_.OpBreak();
+    }
+  }
+  if (is_control_flow_structured()) {
+    a_.OpEndIf();
+  } else {
+    a_.OpElse();
   }
-  a_.OpElse();
   {
     // Continue case.
     uint32_t aL_add_temp = PushSystemTemp();
@@ -1981,8 +2004,14 @@ void DxbcShaderTranslator::ProcessLoopEndInstruction(
               dxbc::Src::R(aL_add_temp, dxbc::Src::kXXXX));
     // Release aL_add_temp.
     PopSystemTemp();
-    // Jump back to the beginning of the loop body.
-    JumpToLabel(instr.loop_body_address);
+    if (is_control_flow_structured()) {
+      // Go back to the beginning of the loop body, and close the check of
+      // whether the loop needs to be skipped.
+      a_.OpEndLoop();
+    } else {
+      // Jump back to the beginning of the loop body.
+      JumpToLabel(instr.loop_body_address);
+    }
   }
   a_.OpEndIf();
 }
@@ -2015,6 +2044,51 @@ void DxbcShaderTranslator::ProcessJumpInstruction(
   JumpToLabel(instr.target_address);
 }
 
+void DxbcShaderTranslator::ProcessStructuredIfBegin(
+    const ParsedJumpInstruction& instr, bool has_else) {
+  // The block contains other execs, not mergeable with the previous ones.
+  CloseExecConditionals();
+
+  if (emit_source_map_) {
+    instruction_disassembly_buffer_.Reset();
+    instr.Disassemble(&instruction_disassembly_buffer_);
+    EmitInstructionDisassembly();
+  }
+
+  // Enter the block if the jump is not taken. Unconditional jumps are only
+  // structured as else blocks, not as conditional blocks.
+  if (instr.type == ParsedJumpInstruction::Type::kConditional) {
+    uint32_t bool_constant_test_temp = PushSystemTemp();
+    if (cbuffer_index_bool_loop_constants_ == kBindingIndexUnallocated) {
+      cbuffer_index_bool_loop_constants_ = cbuffer_count_++;
+    }
+    a_.OpAnd(dxbc::Dest::R(bool_constant_test_temp, 0b0001),
+             dxbc::Src::CB(cbuffer_index_bool_loop_constants_,
+                           uint32_t(CbufferRegister::kBoolLoopConstants),
+                           instr.bool_constant_index >> 7)
+                 .Select((instr.bool_constant_index >> 5) & 3),
+             dxbc::Src::LU(uint32_t(1) << (instr.bool_constant_index & 31)));
+    a_.OpIf(!instr.condition,
+            dxbc::Src::R(bool_constant_test_temp, dxbc::Src::kXXXX));
+    // Release bool_constant_test_temp.
+    PopSystemTemp();
+  } else {
+    assert_true(instr.type == ParsedJumpInstruction::Type::kPredicated);
+    a_.OpIf(!instr.condition,
+            dxbc::Src::R(system_temp_ps_pc_p0_a0_, dxbc::Src::kZZZZ));
+  }
+}
+
+void DxbcShaderTranslator::ProcessStructuredElse() {
+  CloseExecConditionals();
+  a_.OpElse();
+}
+
+void DxbcShaderTranslator::ProcessStructuredIfEnd() {
+  CloseExecConditionals();
+  a_.OpEndIf();
+}
+
 void DxbcShaderTranslator::ProcessAllocInstruction(
     const ParsedAllocInstruction& instr, uint8_t export_eM) {
   bool start_memexport = instr.type == AllocType::kMemory &&
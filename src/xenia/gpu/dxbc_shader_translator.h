@@ -114,7 +114,7 @@ class DxbcShaderTranslator : public ShaderTranslator {
     // If anything in this is structure is changed in a way not compatible with
     // the previous layout, invalidate the pipeline storages by increasing this
     // version number (0xYYYYMMDD)!
-    static constexpr uint32_t kVersion = 0x20220720;
+    static constexpr uint32_t kVersion = 0x20261014;
 
     enum class DepthStencilMode : uint32_t {
       kNoModifiers,
@@ -161,6 +161,10 @@ class DxbcShaderTranslator : public ShaderTranslator {
       // Pipeline stage and input configuration.
       Shader::HostVertexShaderType host_vertex_shader_type
           : Shader::kHostVertexShaderTypeBitCount;
+      // Whether all vertex fetch constants used by the shader have the
+      // endianness vertex_fetch_endian, so the words can be swapped statically.
+      uint32_t vertex_fetch_endian_uniform : 1;
+      xenos::Endian vertex_fetch_endian : 2;
     } vertex;
     struct PixelShaderModification {
       // uint32_t 0.
@@ -590,6 +594,10 @@ class DxbcShaderTranslator : public ShaderTranslator {
   void ProcessLoopEndInstruction(
       const ParsedLoopEndInstruction& instr) override;
   void ProcessJumpInstruction(const ParsedJumpInstruction& instr) override;
+  void ProcessStructuredIfBegin(const ParsedJumpInstruction& instr,
+                                bool has_else) override;
+  void ProcessStructuredElse() override;
+  void ProcessStructuredIfEnd() override;
   void ProcessAllocInstruction(const ParsedAllocInstruction& instr,
                                uint8_t export_eM) override;
 
@@ -236,7 +236,41 @@ void DxbcShaderTranslator::ProcessVertexFetchInstruction(
 
   // - Endian swap the words.
 
-  {
+  Modification shader_modification = GetDxbcShaderModification();
+  if (is_vertex_shader() &&
+      shader_modification.vertex.vertex_fetch_endian_uniform) {
+    // Same endianness in all fetch constants used by the shader, known at
+    // translation time.
+    xenos::Endian endian = shader_modification.vertex.vertex_fetch_endian;
+    if (endian != xenos::Endian::kNone) {
+      uint32_t swap_temp = PushSystemTemp();
+      dxbc::Dest swap_temp_dest(dxbc::Dest::R(swap_temp, needed_words));
+      dxbc::Src swap_temp_src(dxbc::Src::R(swap_temp));
+      dxbc::Dest swap_result_dest(
+          dxbc::Dest::R(system_temp_result_, needed_words));
+      if (endian == xenos::Endian::k8in16 || endian == xenos::Endian::k8in32) {
+        // Temp = X0Z0.
+        a_.OpAnd(swap_temp_dest, result_src, dxbc::Src::LU(0x00FF00FF));
+        // Result = YZW0.
+        a_.OpUShR(swap_result_dest, result_src, dxbc::Src::LU(8));
+        // Result = Y0W0.
+        a_.OpAnd(swap_result_dest, result_src, dxbc::Src::LU(0x00FF00FF));
+        // Result = YXWZ.
+        a_.OpUMAd(swap_result_dest, swap_temp_src, dxbc::Src::LU(256),
+                  result_src);
+      }
+      if (endian == xenos::Endian::k8in32 ||
+          endian == xenos::Endian::k16in32) {
+        // Temp = ZW00.
+        a_.OpUShR(swap_temp_dest, result_src, dxbc::Src::LU(16));
+        // Result = ZWXY.
+        a_.OpBFI(swap_result_dest, dxbc::Src::LU(16), dxbc::Src::LU(16),
+                 result_src, swap_temp_src);
+      }
+      // Release swap_temp.
+      PopSystemTemp();
+    }
+  } else {
     uint32_t swap_temp = PushSystemTemp();
 
     // Extract the endianness from the fetch constant.
@@ -12,6 +12,14 @@
 DEFINE_path(trace_gpu_prefix, "scratch/gpu/",
             "Prefix path for GPU trace files.", "GPU");
 DEFINE_bool(trace_gpu_stream, false, "Trace all GPU packets.", "GPU");
+DEFINE_string(
+    trace_gpu_compression, "snappy",
+    "Compression of the data in GPU trace files.\n"
+    "Use: [none, snappy, zstd]\n"
+    " zstd:\n"
+    "  Smaller files, with memory contents uploaded repeatedly encoded as the "
+    "difference from their earlier contents.",
+    "GPU");
 
 DEFINE_path(
     dump_shaders, "",
@@ -26,6 +34,15 @@ DEFINE_uint64(framerate_limit, 0,
               "GPU");
 UPDATE_from_uint64(framerate_limit, 2024, 8, 31, 20, 60);
 
+DEFINE_uint32(
+    max_queued_frames, 3,
+    "Maximum number of frames (1 to 3) the host GPU may be behind the GPU "
+    "emulation thread. Lower values make the emulation wait for the host GPU "
+    "to complete older frames before starting new ones, reducing the "
+    "input-to-photon latency at the cost of less overlap between the CPU and "
+    "the host GPU work.",
+    "GPU");
+
 DEFINE_bool(
     gpu_allow_invalid_fetch_constants, true,
     "Allow texture and vertex fetch constants with invalid type - generally "
@@ -62,3 +79,34 @@ DEFINE_int32(query_occlusion_fake_sample_count, 100,
              "everything is reported as occluded.",
              "GPU");
 UPDATE_from_int32(query_occlusion_fake_sample_count, 2024, 9, 23, 9, 1000);
+DEFINE_bool(
+    query_occlusion_host, false,
+    "Count the samples for EVENT_WRITE_ZPD using host GPU occlusion queries, "
+    "writing the results to the guest memory asynchronously once the host GPU "
+    "has completed the drawing, so titles can actually cull hidden geometry. "
+    "Only supported on Direct3D 12 with host render targets, "
+    "query_occlusion_fake_sample_count is used in other cases.",
+    "GPU");
+
+DEFINE_bool(
+    profile_gpu_timestamps, false,
+    "Measure the host GPU time spent on draws, resolves, EDRAM transfers and "
+    "texture loading using timestamp queries, and periodically report the "
+    "average time per frame for each kind of work to the log and the profiler.",
+    "GPU");
+
+DEFINE_bool(
+    async_pipeline_creation, false,
+    "Don't wait for new graphics pipelines to be created on the pipeline "
+    "creation threads. Draws using pipelines that are not ready yet are "
+    "skipped until they are, avoiding stuttering when new shaders are "
+    "encountered at the cost of some objects possibly missing for a few "
+    "frames.",
+    "GPU");
+
+DEFINE_bool(
+    merge_consecutive_draws, true,
+    "Merge consecutive guest draws with identical state whose indices are "
+    "directly adjacent in memory into single host draws, reducing the host "
+    "graphics API call overhead in titles issuing long runs of small draws.",
+    "GPU");
@@ -13,6 +13,7 @@
 
 DECLARE_path(trace_gpu_prefix);
 DECLARE_bool(trace_gpu_stream);
+DECLARE_string(trace_gpu_compression);
 
 DECLARE_path(dump_shaders);
 
@@ -20,6 +21,8 @@ DECLARE_bool(vsync);
 
 DECLARE_uint64(framerate_limit);
 
+DECLARE_uint32(max_queued_frames);
+
 DECLARE_bool(gpu_allow_invalid_fetch_constants);
 
 DECLARE_bool(non_seamless_cube_map);
@@ -27,7 +30,14 @@ DECLARE_bool(non_seamless_cube_map);
 DECLARE_bool(half_pixel_offset);
 
 DECLARE_int32(query_occlusion_fake_sample_count);
+DECLARE_bool(query_occlusion_host);
+
+DECLARE_bool(profile_gpu_timestamps);
 
 DECLARE_bool(disassemble_pm4);
 
+DECLARE_bool(async_pipeline_creation);
+
+DECLARE_bool(merge_consecutive_draws);
+
 #endif  // XENIA_GPU_GPU_FLAGS_H_
@@ -0,0 +1,116 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2026 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/gpu/gpu_timestamp_profiler.h"
+
+#include "xenia/base/assert.h"
+#include "xenia/base/logging.h"
+#include "xenia/base/profiling.h"
+
+namespace xe {
+namespace gpu {
+
+uint32_t GpuTimestampProfiler::BeginSubmission(uint64_t submission) {
+  assert_false(submission_open_);
+  submission_open_ = true;
+  submission_current_ = submission;
+  SubmissionBlock& block = blocks_[submission % kSubmissionBlockCount];
+  block.timestamp_count = 1;
+  block.categories[0] = Category::kOther;
+  return GetSubmissionFirstTimestamp(submission);
+}
+
+uint32_t GpuTimestampProfiler::SwitchCategory(Category category) {
+  if (!submission_open_) {
+    return UINT32_MAX;
+  }
+  SubmissionBlock& block = blocks_[submission_current_ % kSubmissionBlockCount];
+  // The last timestamp is reserved for the end of the submission. If out of
+  // timestamps, the rest of the work is attributed to the current category.
+  if (block.categories[block.timestamp_count - 1] == category ||
+      block.timestamp_count >= kTimestampsPerSubmission - 1) {
+    return UINT32_MAX;
+  }
+  block.categories[block.timestamp_count] = category;
+  return GetSubmissionFirstTimestamp(submission_current_) +
+         block.timestamp_count++;
+}
+
+uint32_t GpuTimestampProfiler::EndSubmission() {
+  if (!submission_open_) {
+    return UINT32_MAX;
+  }
+  submission_open_ = false;
+  SubmissionBlock& block = blocks_[submission_current_ % kSubmissionBlockCount];
+  block.categories[block.timestamp_count] = Category::kOther;
+  last_submission_timestamp_count_ = block.timestamp_count + 1;
+  pending_submissions_.push_back(submission_current_);
+  return GetSubmissionFirstTimestamp(submission_current_) +
+         block.timestamp_count++;
+}
+
+uint32_t GpuTimestampProfiler::GetNextPendingSubmissionTimestampCount() const {
+  if (pending_submissions_.empty()) {
+    return 0;
+  }
+  return blocks_[pending_submissions_.front() % kSubmissionBlockCount]
+      .timestamp_count;
+}
+
+void GpuTimestampProfiler::AccumulateSubmission(const uint64_t* timestamps) {
+  assert_false(pending_submissions_.empty());
+  const SubmissionBlock& block =
+      blocks_[pending_submissions_.front() % kSubmissionBlockCount];
+  for (uint32_t i = 0; i + 1 < block.timestamp_count; ++i) {
+    // Timestamps are not guaranteed to be monotonic on all implementations.
+    if (timestamps[i + 1] > timestamps[i]) {
+      category_ticks_[size_t(block.categories[i])] +=
+          timestamps[i + 1] - timestamps[i];
+    }
+  }
+  pending_submissions_.pop_front();
+}
+
+void GpuTimestampProfiler::EndFrame() {
+  if (++frame_count_ < kReportIntervalFrames) {
+    return;
+  }
+  double ms_per_frame_per_tick =
+      1000.0 / (ticks_per_second_ * double(frame_count_));
+  std::array<double, size_t(Category::kCount)> category_ms;
+  for (size_t i = 0; i < size_t(Category::kCount); ++i) {
+    category_ms[i] = double(category_ticks_[i]) * ms_per_frame_per_tick;
+  }
+  COUNT_profile_set("gpu/timestamps/other_us_per_frame",
+                    int64_t(category_ms[size_t(Category::kOther)] * 1000.0));
+  COUNT_profile_set("gpu/timestamps/draws_us_per_frame",
+                    int64_t(category_ms[size_t(Category::kDraws)] * 1000.0));
+  COUNT_profile_set("gpu/timestamps/resolves_us_per_frame",
+                    int64_t(category_ms[size_t(Category::kResolves)] * 1000.0));
+  COUNT_profile_set(
+      "gpu/timestamps/edram_transfers_us_per_frame",
+      int64_t(category_ms[size_t(Category::kEdramTransfers)] * 1000.0));
+  COUNT_profile_set(
+      "gpu/timestamps/texture_loads_us_per_frame",
+      int64_t(category_ms[size_t(Category::kTextureLoads)] * 1000.0));
+  XELOGI(
+      "Host GPU time per frame over {} frames: draws {:.3f} ms, resolves "
+      "{:.3f} ms, EDRAM transfers {:.3f} ms, texture loads {:.3f} ms, other "
+      "{:.3f} ms",
+      frame_count_, category_ms[size_t(Category::kDraws)],
+      category_ms[size_t(Category::kResolves)],
+      category_ms[size_t(Category::kEdramTransfers)],
+      category_ms[size_t(Category::kTextureLoads)],
+      category_ms[size_t(Category::kOther)]);
+  category_ticks_.fill(0);
+  frame_count_ = 0;
+}
+
+}  // namespace gpu
+}  // namespace xe
@@ -0,0 +1,109 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2026 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#ifndef XENIA_GPU_GPU_TIMESTAMP_PROFILER_H_
+#define XENIA_GPU_GPU_TIMESTAMP_PROFILER_H_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+
+namespace xe {
+namespace gpu {
+
+// Host API-independent part of measuring the host GPU time spent on different
+// kinds of work (profile_gpu_timestamps). Instead of a pair of timestamps
+// around every draw, a timestamp is written whenever the kind of the work
+// being recorded changes, and the interval until the next timestamp is
+// attributed to the category of the work after the first one. Each submission
+// uses its own block of timestamp queries (in a ring of blocks), so the host
+// API implementations can reset and read back entire blocks.
+class GpuTimestampProfiler {
+ public:
+  enum class Category : uint32_t {
+    // Anything not covered by the other categories, such as uploads and
+    // barriers in the beginning of a submission.
+    kOther,
+    kDraws,
+    kResolves,
+    kEdramTransfers,
+    kTextureLoads,
+
+    kCount,
+  };
+
+  static constexpr uint32_t kSubmissionBlockCount = 32;
+  static constexpr uint32_t kTimestampsPerSubmission = 256;
+  static constexpr uint32_t kTimestampCount =
+      kSubmissionBlockCount * kTimestampsPerSubmission;
+
+  static constexpr uint32_t GetSubmissionFirstTimestamp(uint64_t submission) {
+    return uint32_t(submission % kSubmissionBlockCount) *
+           kTimestampsPerSubmission;
+  }
+
+  void SetTicksPerSecond(double ticks_per_second) {
+    ticks_per_second_ = ticks_per_second;
+  }
+
+  // The submission that previously used the block of the new one must be
+  // completed. Returns the index of the timestamp to write in the beginning of
+  // the submission.
+  uint32_t BeginSubmission(uint64_t submission);
+  // Returns the index of the timestamp to write before recording work of the
+  // category, or UINT32_MAX if there's no need to write one.
+  uint32_t SwitchCategory(Category category);
+  // Returns the index of the timestamp to write in the end of the submission,
+  // or UINT32_MAX if not recording a submission. The number of the timestamps
+  // written in the submission can be obtained after this call to read them
+  // back.
+  uint32_t EndSubmission();
+  uint32_t GetLastSubmissionTimestampCount() const {
+    return last_submission_timestamp_count_;
+  }
+  // Returns the submission whose timestamps will be accumulated by the next
+  // AccumulateSubmission call, or UINT64_MAX if there are none pending.
+  uint64_t GetNextPendingSubmission() const {
+    return pending_submissions_.empty() ? UINT64_MAX
+                                        : pending_submissions_.front();
+  }
+  uint32_t GetNextPendingSubmissionTimestampCount() const;
+  // Accumulates the timestamps of the completed submission returned by
+  // GetNextPendingSubmission, starting from its first timestamp.
+  void AccumulateSubmission(const uint64_t* timestamps);
+  // Counts a frame for averaging, and periodically reports the average time
+  // per frame for each category.
+  void EndFrame();
+
+ private:
+  static constexpr uint32_t kReportIntervalFrames = 300;
+
+  struct SubmissionBlock {
+    uint32_t timestamp_count = 0;
+    // The category of the work after each timestamp.
+    std::array<Category, kTimestampsPerSubmission> categories;
+  };
+  std::array<SubmissionBlock, kSubmissionBlockCount> blocks_;
+
+  double ticks_per_second_ = 1.0;
+
+  bool submission_open_ = false;
+  uint64_t submission_current_ = 0;
+  uint32_t last_submission_timestamp_count_ = 0;
+  std::deque<uint64_t> pending_submissions_;
+
+  std::array<uint64_t, size_t(Category::kCount)> category_ticks_{};
+  uint32_t frame_count_ = 0;
+};
+
+}  // namespace gpu
+}  // namespace xe
+
+#endif  // XENIA_GPU_GPU_TIMESTAMP_PROFILER_H_
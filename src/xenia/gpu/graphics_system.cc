@@ -19,6 +19,7 @@
 
 #include "xenia/base/byte_stream.h"
 #include "xenia/base/clock.h"
+#include "xenia/base/fast_forward.h"
 #include "xenia/base/logging.h"
 #include "xenia/base/math.h"
 #include "xenia/base/profiling.h"
@@ -91,6 +92,14 @@ GraphicsSystem::GraphicsSystem() : frame_limiter_worker_running_(false) {
 
 GraphicsSystem::~GraphicsSystem() = default;
 
+void GraphicsSystem::InitializeProvider(bool is_surface_required) {
+  if (provider_initialized_) {
+    return;
+  }
+  provider_initialized_ = true;
+  provider_ = CreateProvider(is_surface_required);
+}
+
 X_STATUS GraphicsSystem::Setup(cpu::Processor* processor,
                                kernel::KernelState* kernel_state,
                                ui::WindowedAppContext* app_context,
@@ -118,6 +127,7 @@ X_STATUS GraphicsSystem::Setup(cpu::Processor* processor,
         custom_res_x, custom_res_y));
   }
 
+  InitializeProvider(is_surface_required);
   if (provider_) {
     // Safe if either the UI thread call or the presenter creation fails.
     if (app_context_) {
@@ -179,7 +189,11 @@ X_STATUS GraphicsSystem::Setup(cpu::Processor* processor,
               register_file()->values[XE_GPU_REG_D1MODE_V_COUNTER] +=
                   GetInternalDisplayResolution().second;
 
-              if (cvars::vsync) {
+              // Unlimited while fast-forwarding.
+              const bool fast_forward = xe::fast_forward::IsEnabled();
+              const bool vsync = cvars::vsync && !fast_forward;
+
+              if (vsync) {
                 const uint64_t current_time = Clock::QueryGuestTickCount();
                 const uint64_t tick_freq = Clock::guest_tick_frequency();
                 const uint64_t time_delta = current_time - last_frame_time;
@@ -193,7 +207,7 @@ X_STATUS GraphicsSystem::Setup(cpu::Processor* processor,
                   // vblank after MarkVblank, no idea how long the guest code
                   // normally takes
                   MarkVblank();
-                  if (cvars::vsync) {
+                  if (vsync) {
                     const uint64_t estimated_nanoseconds =
                         static_cast<uint64_t>(
                             (vsync_duration_d * 1000000.0) *
@@ -204,9 +218,9 @@ X_STATUS GraphicsSystem::Setup(cpu::Processor* processor,
                 }
               }
 
-              if (!cvars::vsync) {
+              if (!vsync) {
                 MarkVblank();
-                if (normalized_framerate_limit > 0) {
+                if (normalized_framerate_limit > 0 && !fast_forward) {
                   // framerate_limit is over 0, vsync disabled
                   //  - No VSYNC + limited frames defined by user
                   uint64_t framerate_limited_sleep_time =
@@ -394,6 +408,32 @@ void GraphicsSystem::InitializeShaderStorage(
   }
 }
 
+void GraphicsSystem::BeginInitializeShaderStorage(
+    const std::filesystem::path& cache_root, uint32_t title_id) {
+  assert_false(shader_storage_initialization_pending_);
+  if (!cvars::store_shaders) {
+    return;
+  }
+  if (command_processor_->is_paused()) {
+    // The command processor thread won't execute the call while paused.
+    command_processor_->InitializeShaderStorage(cache_root, title_id, true);
+    return;
+  }
+  shader_storage_initialization_pending_ = true;
+  command_processor_->CallInThread([this, cache_root, title_id]() {
+    command_processor_->InitializeShaderStorage(cache_root, title_id, true);
+    shader_storage_initialization_fence_.Signal();
+  });
+}
+
+void GraphicsSystem::WaitForShaderStorageInitialization() {
+  if (!shader_storage_initialization_pending_) {
+    return;
+  }
+  shader_storage_initialization_fence_.Wait();
+  shader_storage_initialization_pending_ = false;
+}
+
 void GraphicsSystem::RequestFrameTrace() {
   command_processor_->RequestFrameTrace(cvars::trace_gpu_prefix);
 }
@@ -18,6 +18,7 @@
 #include <string>
 #include <thread>
 
+#include "xenia/base/threading.h"
 #include "xenia/cpu/processor.h"
 #include "xenia/gpu/register_file.h"
 #include "xenia/kernel/xthread.h"
@@ -55,6 +56,11 @@ class GraphicsSystem {
   ui::GraphicsProvider* provider() const { return provider_.get(); }
   ui::Presenter* presenter() const { return presenter_.get(); }
 
+  // Creates the host graphics provider, which doesn't depend on the other
+  // subsystems, so this may be called on any thread before Setup, in parallel
+  // with the setup of the CPU. Done by Setup if not called before it.
+  void InitializeProvider(bool is_surface_required);
+
   virtual X_STATUS Setup(cpu::Processor* processor,
                          kernel::KernelState* kernel_state,
                          ui::WindowedAppContext* app_context,
@@ -81,6 +87,13 @@ class GraphicsSystem {
 
   void InitializeShaderStorage(const std::filesystem::path& cache_root,
                                uint32_t title_id, bool blocking);
+  // Queues blocking shader storage initialization on the command processor
+  // thread without waiting for it, so the rest of the title loading can be
+  // done meanwhile. WaitForShaderStorageInitialization must be called before
+  // the title is launched.
+  void BeginInitializeShaderStorage(const std::filesystem::path& cache_root,
+                                    uint32_t title_id);
+  void WaitForShaderStorageInitialization();
 
   void RequestFrameTrace();
   void BeginTracing();
@@ -106,6 +119,9 @@ class GraphicsSystem {
  protected:
   GraphicsSystem();
 
+  // May return nullptr if the graphics system doesn't need a host GPU.
+  virtual std::unique_ptr<ui::GraphicsProvider> CreateProvider(
+      bool is_surface_required) = 0;
   virtual std::unique_ptr<CommandProcessor> CreateCommandProcessor() = 0;
 
   static uint32_t ReadRegisterThunk(void* ppc_context, GraphicsSystem* gs,
@@ -122,6 +138,7 @@ class GraphicsSystem {
   kernel::KernelState* kernel_state_ = nullptr;
   ui::WindowedAppContext* app_context_ = nullptr;
   std::unique_ptr<ui::GraphicsProvider> provider_;
+  bool provider_initialized_ = false;
 
   uint32_t interrupt_callback_ = 0;
   uint32_t interrupt_callback_data_ = 0;
@@ -140,6 +157,9 @@ class GraphicsSystem {
  private:
   std::unique_ptr<ui::Presenter> presenter_;
 
+  xe::threading::Fence shader_storage_initialization_fence_;
+  bool shader_storage_initialization_pending_ = false;
+
   std::atomic_flag host_gpu_loss_reported_;
 };
 
@@ -0,0 +1,406 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2026 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/gpu/memexport_interpreter.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <initializer_list>
+#include <utility>
+
+#include "xenia/base/assert.h"
+#include "xenia/base/math.h"
+#include "xenia/base/memory.h"
+#include "xenia/base/profiling.h"
+#include "xenia/gpu/registers.h"
+#include "xenia/gpu/xenos.h"
+
+namespace xe {
+namespace gpu {
+
+namespace {
+// Converts the components to integers and packs them with the specified bit
+// widths (without holes), according to the Direct3D format conversion rules,
+// the same way as the shader translators do.
+uint32_t PackFixedComponents(const float* components, const uint32_t* widths,
+                             uint32_t component_count, bool is_signed,
+                             bool is_norm) {
+  uint32_t packed = 0;
+  uint32_t offset = 0;
+  for (uint32_t i = 0; i < component_count; ++i) {
+    uint32_t width = widths[i];
+    float value = components[i];
+    // Flush NaNs.
+    if (std::isnan(value)) {
+      value = 0.0f;
+    }
+    uint32_t integer;
+    if (is_signed) {
+      if (is_norm) {
+        value = std::min(std::max(value, -1.0f), 1.0f) *
+                float((UINT32_C(1) << (width - 1)) - 1);
+      }
+      value += value < 0.0f ? -0.5f : 0.5f;
+      integer = uint32_t(
+          int32_t(std::min(std::max(value, -2147483648.0f), 2147483520.0f)));
+    } else {
+      if (is_norm) {
+        value = std::min(std::max(value, 0.0f), 1.0f) *
+                float((UINT32_C(1) << width) - 1);
+      }
+      value += 0.5f;
+      integer = uint32_t(std::min(std::max(value, 0.0f), 4294967040.0f));
+    }
+    packed |= (integer & ((UINT32_C(1) << width) - 1)) << offset;
+    offset += width;
+  }
+  return packed;
+}
+}  // namespace
+
+void MemExportInterpreter::MemExportSink::AllocExport(ucode::AllocType type,
+                                                      uint32_t size) {
+  // Any alloc terminates the current memory export.
+  Flush();
+}
+
+void MemExportInterpreter::MemExportSink::Export(
+    uint32_t invocation, ucode::ExportRegister export_register,
+    const float* value, uint32_t value_mask) {
+  assert_true(invocation < ShaderInterpreter::kMaxInvocations);
+  Invocation& invocation_state = invocations_[invocation];
+  if (export_register == ucode::ExportRegister::kExportAddress) {
+    for (uint32_t i = 0; i < 4; ++i) {
+      if (value_mask & (UINT32_C(1) << i)) {
+        invocation_state.address[i] =
+            xe::memory::Reinterpret<uint32_t>(value[i]);
+      }
+    }
+    return;
+  }
+  uint32_t eM_index = uint32_t(export_register) -
+                      uint32_t(ucode::ExportRegister::kExportData0);
+  if (eM_index >= ucode::kMaxMemExportElementCount) {
+    return;
+  }
+  for (uint32_t i = 0; i < 4; ++i) {
+    if (value_mask & (UINT32_C(1) << i)) {
+      invocation_state.data[eM_index][i] = value[i];
+    }
+  }
+  invocation_state.data_written |= uint8_t(1) << eM_index;
+}
+
+void MemExportInterpreter::MemExportSink::Reset() {
+  std::memset(invocations_, 0, sizeof(invocations_));
+}
+
+void MemExportInterpreter::MemExportSink::Flush() {
+  for (Invocation& invocation : invocations_) {
+    ExportInvocation(invocation);
+  }
+}
+
+uint32_t MemExportInterpreter::MemExportSink::PackElement(
+    const float* element, uint32_t format_info, uint32_t* packed_out) {
+  xenos::xe_gpu_memexport_stream_t stream;
+  stream.dword_2 = format_info;
+
+  float swapped[4];
+  if (stream.red_blue_swap) {
+    swapped[0] = element[2];
+    swapped[1] = element[1];
+    swapped[2] = element[0];
+  } else {
+    swapped[0] = element[0];
+    swapped[1] = element[1];
+    swapped[2] = element[2];
+  }
+  swapped[3] = element[3];
+
+  bool is_signed = (uint32_t(stream.num_format) & 0b001) != 0;
+  bool is_norm = (uint32_t(stream.num_format) & 0b010) == 0;
+  auto pack_fixed = [&](std::initializer_list<uint32_t> widths) {
+    return PackFixedComponents(swapped, widths.begin(), uint32_t(widths.size()),
+                               is_signed, is_norm);
+  };
+
+  auto pack_half = [&](uint32_t component) -> uint32_t {
+    return xe::float_to_xenos_half(swapped[component], true, true);
+  };
+
+  std::memset(packed_out, 0, sizeof(uint32_t) * 4);
+  switch (stream.format) {
+    // TODO(Triang3l): Investigate how input should be treated for k_8_A, k_8_B.
+    case xenos::ColorFormat::k_8:
+    case xenos::ColorFormat::k_8_A:
+    case xenos::ColorFormat::k_8_B:
+      packed_out[0] = pack_fixed({8});
+      return 0;
+    case xenos::ColorFormat::k_1_5_5_5:
+      packed_out[0] = pack_fixed({5, 5, 5, 1});
+      return 1;
+    case xenos::ColorFormat::k_5_6_5:
+      packed_out[0] = pack_fixed({5, 6, 5});
+      return 1;
+    case xenos::ColorFormat::k_6_5_5:
+      packed_out[0] = pack_fixed({5, 5, 6});
+      return 1;
+    // TODO(Triang3l): Investigate how input should be treated for k_8_8_8_8_A.
+    case xenos::ColorFormat::k_8_8_8_8:
+    case xenos::ColorFormat::k_8_8_8_8_A:
+    case xenos::ColorFormat::k_8_8_8_8_AS_16_16_16_16:
+      packed_out[0] = pack_fixed({8, 8, 8, 8});
+      return 2;
+    case xenos::ColorFormat::k_2_10_10_10:
+    case xenos::ColorFormat::k_2_10_10_10_AS_16_16_16_16:
+      packed_out[0] = pack_fixed({10, 10, 10, 2});
+      return 2;
+    case xenos::ColorFormat::k_8_8:
+      packed_out[0] = pack_fixed({8, 8});
+      return 1;
+    case xenos::ColorFormat::k_4_4_4_4:
+      packed_out[0] = pack_fixed({4, 4, 4, 4});
+      return 1;
+    case xenos::ColorFormat::k_10_11_11:
+    case xenos::ColorFormat::k_10_11_11_AS_16_16_16_16:
+      packed_out[0] = pack_fixed({11, 11, 10});
+      return 2;
+    case xenos::ColorFormat::k_11_11_10:
+    case xenos::ColorFormat::k_11_11_10_AS_16_16_16_16:
+      packed_out[0] = pack_fixed({10, 11, 11});
+      return 2;
+    case xenos::ColorFormat::k_16:
+      packed_out[0] = pack_fixed({16});
+      return 1;
+    case xenos::ColorFormat::k_16_16:
+      packed_out[0] = pack_fixed({16, 16});
+      return 2;
+    case xenos::ColorFormat::k_16_16_16_16: {
+      static const uint32_t kWidths16_16[] = {16, 16};
+      packed_out[0] = PackFixedComponents(swapped, kWidths16_16, 2, is_signed,
+                                          is_norm);
+      packed_out[1] = PackFixedComponents(swapped + 2, kWidths16_16, 2,
+                                          is_signed, is_norm);
+      return 3;
+    }
+    // TODO(Triang3l): Investigate whether the extended range float16 is written
+    // by memory exports as well.
+    case xenos::ColorFormat::k_16_FLOAT:
+      packed_out[0] = pack_half(0);
+      return 1;
+    case xenos::ColorFormat::k_16_16_FLOAT:
+      packed_out[0] = pack_half(0) | (pack_half(1) << 16);
+      return 2;
+    case xenos::ColorFormat::k_16_16_16_16_FLOAT:
+      packed_out[0] = pack_half(0) | (pack_half(1) << 16);
+      packed_out[1] = pack_half(2) | (pack_half(3) << 16);
+      return 3;
+    case xenos::ColorFormat::k_32_FLOAT:
+      std::memcpy(packed_out, swapped, sizeof(float));
+      return 2;
+    case xenos::ColorFormat::k_32_32_FLOAT:
+      std::memcpy(packed_out, swapped, sizeof(float) * 2);
+      return 3;
+    case xenos::ColorFormat::k_32_32_32_32_FLOAT:
+      std::memcpy(packed_out, swapped, sizeof(float) * 4);
+      return 4;
+    default:
+      return UINT32_MAX;
+  }
+}
+
+void MemExportInterpreter::MemExportSink::ExportInvocation(
+    Invocation& invocation) {
+  uint8_t data_written = invocation.data_written;
+  if (!data_written) {
+    return;
+  }
+  invocation.data_written = 0;
+
+  // Check if the address with the correct sign and exponent was written, and
+  // that the index doesn't overflow the mantissa bits.
+  const uint32_t* eA = invocation.address;
+  if ((eA[0] >> 30) != 0x1 || (eA[1] >> 23) != 0x96 ||
+      (eA[2] >> 23) != 0x96 || (eA[3] >> 23) != 0x96) {
+    return;
+  }
+
+  // Exclude the eM# outside the bounds of the stream.
+  uint32_t eM0_index = eA[1] & ((UINT32_C(1) << 23) - 1);
+  uint32_t index_count = eA[3] & ((UINT32_C(1) << 23) - 1);
+  if (eM0_index >= index_count) {
+    return;
+  }
+  data_written &= uint8_t(
+      (UINT32_C(1) << std::min(index_count - eM0_index,
+                               ucode::kMaxMemExportElementCount)) -
+      1);
+
+  xenos::xe_gpu_memexport_stream_t stream;
+  stream.dword_2 = eA[2];
+  // Change 8-in-64 and 8-in-128 to 8-in-32, and then swap within 32 bits.
+  xenos::Endian endian_32;
+  switch (stream.endianness) {
+    case xenos::Endian128::k8in64:
+    case xenos::Endian128::k8in128:
+      endian_32 = xenos::Endian::k8in32;
+      break;
+    default:
+      endian_32 = xenos::Endian(stream.endianness);
+      break;
+  }
+
+  // Left-shift the stream base address by 2 to both convert it from dwords to
+  // bytes and drop the upper bits.
+  uint32_t base_address_bytes = eA[0] << 2;
+  uint32_t eM_index;
+  while (xe::bit_scan_forward(data_written, &eM_index)) {
+    data_written &= ~(uint8_t(1) << eM_index);
+    uint32_t packed[4];
+    uint32_t element_bytes_log2 =
+        PackElement(invocation.data[eM_index], eA[2], packed);
+    if (element_bytes_log2 == UINT32_MAX) {
+      // Unsupported format, skipped like by the shader translators.
+      return;
+    }
+    if (stream.endianness == xenos::Endian128::k8in64) {
+      std::swap(packed[0], packed[1]);
+      std::swap(packed[2], packed[3]);
+    } else if (stream.endianness == xenos::Endian128::k8in128) {
+      std::swap(packed[0], packed[3]);
+      std::swap(packed[1], packed[2]);
+    }
+    for (uint32_t i = 0; i < 4; ++i) {
+      packed[i] = xenos::GpuSwap(packed[i], endian_32);
+    }
+    uint32_t element_address =
+        base_address_bytes + ((eM0_index + eM_index) << element_bytes_log2);
+    std::memcpy(memory_.TranslatePhysical(element_address), packed,
+                size_t(1) << element_bytes_log2);
+  }
+}
+
+bool MemExportInterpreter::ExecuteVertexShader(const Shader& vertex_shader) {
+  SCOPE_profile_cpu_f("gpu");
+
+  assert_true(vertex_shader.type() == xenos::ShaderType::kVertex);
+  assert_true(vertex_shader.is_ucode_analyzed());
+  if (!vertex_shader.memexport_eM_written()) {
+    return true;
+  }
+  if (!ShaderInterpreter::CanInterpretShader(vertex_shader)) {
+    return false;
+  }
+
+  const RegisterFile& regs = register_file_;
+
+  auto vgt_draw_initiator = regs.Get<reg::VGT_DRAW_INITIATOR>();
+  if (!vgt_draw_initiator.num_indices) {
+    return true;
+  }
+  if (vgt_draw_initiator.source_select != xenos::SourceSelect::kDMA &&
+      vgt_draw_initiator.source_select != xenos::SourceSelect::kAutoIndex) {
+    // TODO(Triang3l): Support immediate indices.
+    return false;
+  }
+
+  // Not reproducing tessellation.
+  if (xenos::IsMajorModeExplicit(vgt_draw_initiator.major_mode,
+                                 vgt_draw_initiator.prim_type) &&
+      regs.Get<reg::VGT_OUTPUT_PATH_CNTL>().path_select ==
+          xenos::VGTOutputPath::kTessellationEnable) {
+    return false;
+  }
+
+  auto vgt_dma_size = regs.Get<reg::VGT_DMA_SIZE>();
+  union {
+    const void* index_buffer;
+    const uint16_t* index_buffer_16;
+    const uint32_t* index_buffer_32;
+  };
+  xenos::Endian index_endian = vgt_dma_size.swap_mode;
+  if (vgt_draw_initiator.source_select == xenos::SourceSelect::kDMA) {
+    uint32_t index_buffer_base = regs[XE_GPU_REG_VGT_DMA_BASE];
+    if (vgt_draw_initiator.index_size == xenos::IndexFormat::kInt16) {
+      // Handle the index endianness to same way as the PrimitiveProcessor.
+      if (index_endian == xenos::Endian::k8in32) {
+        index_endian = xenos::Endian::k8in16;
+      } else if (index_endian == xenos::Endian::k16in32) {
+        index_endian = xenos::Endian::kNone;
+      }
+      index_buffer_base &= ~uint32_t(sizeof(uint16_t) - 1);
+    } else {
+      assert_true(vgt_draw_initiator.index_size == xenos::IndexFormat::kInt32);
+      index_buffer_base &= ~uint32_t(sizeof(uint32_t) - 1);
+    }
+    index_buffer = memory_.TranslatePhysical(index_buffer_base);
+  }
+  auto pa_su_sc_mode_cntl = regs.Get<reg::PA_SU_SC_MODE_CNTL>();
+  uint32_t reset_index =
+      regs.Get<reg::VGT_MULTI_PRIM_IB_RESET_INDX>().reset_indx;
+  uint32_t index_offset = regs.Get<reg::VGT_INDX_OFFSET>().indx_offset;
+  uint32_t min_index = regs.Get<reg::VGT_MIN_VTX_INDX>().min_indx;
+  uint32_t max_index = regs.Get<reg::VGT_MAX_VTX_INDX>().max_indx;
+
+  shader_interpreter_.SetShader(vertex_shader);
+  MemExportSink memexport_sink(memory_);
+  shader_interpreter_.SetExportSink(&memexport_sink);
+  uint32_t batch_vertex_count = 0;
+  auto execute_batch = [&]() {
+    if (!batch_vertex_count) {
+      return;
+    }
+    memexport_sink.Reset();
+    shader_interpreter_.Execute(batch_vertex_count);
+    // Perform the last memory export not terminated by an alloc.
+    memexport_sink.Flush();
+    batch_vertex_count = 0;
+  };
+  for (uint32_t i = 0; i < vgt_draw_initiator.num_indices; ++i) {
+    uint32_t vertex_index;
+    if (vgt_draw_initiator.source_select == xenos::SourceSelect::kDMA) {
+      if (i < vgt_dma_size.num_words) {
+        if (vgt_draw_initiator.index_size == xenos::IndexFormat::kInt16) {
+          vertex_index = index_buffer_16[i];
+        } else {
+          vertex_index = index_buffer_32[i];
+        }
+        // The Xenos only uses 24 bits of the index (reset_indx is 24-bit).
+        vertex_index = xenos::GpuSwap(vertex_index, index_endian) & 0xFFFFFF;
+      } else {
+        vertex_index = 0;
+      }
+      if (pa_su_sc_mode_cntl.multi_prim_ib_ena && vertex_index == reset_index) {
+        continue;
+      }
+    } else {
+      assert_true(vgt_draw_initiator.source_select ==
+                  xenos::SourceSelect::kAutoIndex);
+      vertex_index = i;
+    }
+    vertex_index =
+        std::min(max_index,
+                 std::max(min_index, (vertex_index + index_offset) & 0xFFFFFF));
+
+    shader_interpreter_.temp_registers(batch_vertex_count)[0] =
+        float(vertex_index);
+    if (++batch_vertex_count >= ShaderInterpreter::kMaxInvocations) {
+      execute_batch();
+    }
+  }
+  execute_batch();
+  shader_interpreter_.SetExportSink(nullptr);
+
+  return true;
+}
+
+}  // namespace gpu
+}  // namespace xe
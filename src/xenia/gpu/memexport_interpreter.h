@@ -0,0 +1,84 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2026 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#ifndef XENIA_GPU_MEMEXPORT_INTERPRETER_H_
+#define XENIA_GPU_MEMEXPORT_INTERPRETER_H_
+
+#include <cstdint>
+
+#include "xenia/gpu/register_file.h"
+#include "xenia/gpu/shader.h"
+#include "xenia/gpu/shader_interpreter.h"
+#include "xenia/gpu/ucode.h"
+#include "xenia/memory.h"
+
+namespace xe {
+namespace gpu {
+
+// Performs the memory exports done by vertex shaders on the CPU using the
+// ShaderInterpreter, for keeping the guest-visible memory correct without
+// executing the guest shaders on a host GPU.
+class MemExportInterpreter {
+ public:
+  MemExportInterpreter(const RegisterFile& register_file, Memory& memory)
+      : register_file_(register_file),
+        memory_(memory),
+        shader_interpreter_(register_file, memory) {}
+
+  // Executes the vertex shader for all vertices of the current draw, writing
+  // the memory exports it does to the guest memory. The shader must have its
+  // ucode analyzed. Returns false if the shader or the draw configuration can't
+  // be interpreted.
+  bool ExecuteVertexShader(const Shader& vertex_shader);
+
+ private:
+  class MemExportSink : public ShaderInterpreter::ExportSink {
+   public:
+    explicit MemExportSink(Memory& memory) : memory_(memory) {}
+
+    void AllocExport(ucode::AllocType type, uint32_t size) override;
+    void Export(uint32_t invocation, ucode::ExportRegister export_register,
+                const float* value, uint32_t value_mask) override;
+
+    void Reset();
+    // Performs the memory exports from the eM# written by the invocations
+    // since the last flush.
+    void Flush();
+
+   private:
+    struct Invocation {
+      // eA.
+      uint32_t address[4];
+      // eM#.
+      float data[ucode::kMaxMemExportElementCount][4];
+      // Bits for the eM# written since the last flush.
+      uint8_t data_written;
+    };
+
+    // Packs an eM# element according to the format from the Z of eA, returns
+    // the log2 of the size of the element in bytes, or UINT32_MAX if the format
+    // is not supported.
+    static uint32_t PackElement(const float* element, uint32_t format_info,
+                                uint32_t* packed_out);
+    void ExportInvocation(Invocation& invocation);
+
+    Memory& memory_;
+    Invocation invocations_[ShaderInterpreter::kMaxInvocations];
+  };
+
+  const RegisterFile& register_file_;
+  Memory& memory_;
+
+  ShaderInterpreter shader_interpreter_;
+};
+
+}  // namespace gpu
+}  // namespace xe
+
+#endif  // XENIA_GPU_MEMEXPORT_INTERPRETER_H_
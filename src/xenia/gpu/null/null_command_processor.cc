@@ -9,6 +9,18 @@
 
 #include "xenia/gpu/null/null_command_processor.h"
 
+#include "xenia/base/cvar.h"
+#include "xenia/base/logging.h"
+#include "xenia/base/xxhash.h"
+#include "xenia/gpu/registers.h"
+
+DEFINE_bool(
+    null_gpu_memexport, true,
+    "Perform the memory exports done by vertex shaders on the CPU with the "
+    "null GPU backend, for keeping the guest-visible results of GPU "
+    "computations that games may read on the CPU correct without rendering.",
+    "GPU");
+
 namespace xe {
 namespace gpu {
 namespace null {
@@ -24,10 +36,19 @@ void NullCommandProcessor::TracePlaybackWroteMemory(uint32_t base_ptr,
 void NullCommandProcessor::RestoreEdramSnapshot(const void* snapshot) {}
 
 bool NullCommandProcessor::SetupContext() {
-  return CommandProcessor::SetupContext();
+  if (!CommandProcessor::SetupContext()) {
+    return false;
+  }
+  if (cvars::null_gpu_memexport) {
+    memexport_interpreter_ =
+        std::make_unique<MemExportInterpreter>(*register_file_, *memory_);
+  }
+  return true;
 }
 
 void NullCommandProcessor::ShutdownContext() {
+  memexport_interpreter_.reset();
+  shaders_.clear();
   return CommandProcessor::ShutdownContext();
 }
 
@@ -39,13 +60,48 @@ Shader* NullCommandProcessor::LoadShader(xenos::ShaderType shader_type,
                                          uint32_t guest_address,
                                          const uint32_t* host_address,
                                          uint32_t dword_count) {
-  return nullptr;
+  if (!memexport_interpreter_) {
+    return nullptr;
+  }
+  uint64_t data_hash =
+      XXH3_64bits(host_address, dword_count * sizeof(uint32_t));
+  auto it = shaders_.find(data_hash);
+  if (it != shaders_.end()) {
+    return it->second.get();
+  }
+  auto shader = std::make_unique<Shader>(shader_type, data_hash, host_address,
+                                         dword_count);
+  // Only the memory export information is needed, and nothing is translated,
+  // so analyze right away.
+  shader->AnalyzeUcode(ucode_disasm_buffer_);
+  return shaders_.emplace(data_hash, std::move(shader)).first->second.get();
 }
 
 bool NullCommandProcessor::IssueDraw(xenos::PrimitiveType prim_type,
                                      uint32_t index_count,
                                      IndexBufferInfo* index_buffer_info,
                                      bool major_mode_explicit) {
+  if (!memexport_interpreter_) {
+    return true;
+  }
+  const RegisterFile& regs = *register_file_;
+  if (regs.Get<reg::RB_MODECONTROL>().edram_mode ==
+      xenos::ModeControl::kCopy) {
+    return IssueCopy();
+  }
+  // Nothing is rendered, only the guest-visible effects of the vertex shader
+  // need to be reproduced.
+  // TODO(Triang3l): Pixel shader memory exports, which require rasterization.
+  Shader* vertex_shader = active_vertex_shader();
+  if (!vertex_shader || !vertex_shader->memexport_eM_written()) {
+    return true;
+  }
+  if (!memexport_interpreter_->ExecuteVertexShader(*vertex_shader)) {
+    XELOGW(
+        "Null GPU: Unable to perform the memory exports of vertex shader "
+        "{:016X} on the CPU",
+        vertex_shader->ucode_data_hash());
+  }
   return true;
 }
 
@@ -10,8 +10,15 @@
 #ifndef XENIA_GPU_NULL_NULL_COMMAND_PROCESSOR_H_
 #define XENIA_GPU_NULL_NULL_COMMAND_PROCESSOR_H_
 
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+
+#include "xenia/base/string_buffer.h"
 #include "xenia/gpu/command_processor.h"
+#include "xenia/gpu/memexport_interpreter.h"
 #include "xenia/gpu/null/null_graphics_system.h"
+#include "xenia/gpu/shader.h"
 #include "xenia/gpu/xenos.h"
 #include "xenia/kernel/kernel_state.h"
 
@@ -46,6 +53,12 @@ class NullCommandProcessor : public CommandProcessor {
   bool IssueCopy() override;
 
   void InitializeTrace() override;
+
+  // Only loaded if vertex shader memory exports are performed.
+  std::unordered_map<uint64_t, std::unique_ptr<Shader>> shaders_;
+  StringBuffer ucode_disasm_buffer_;
+
+  std::unique_ptr<MemExportInterpreter> memexport_interpreter_;
 };
 
 }  // namespace null
@@ -9,10 +9,18 @@
 
 #include "xenia/gpu/null/null_graphics_system.h"
 
+#include "xenia/base/cvar.h"
 #include "xenia/gpu/null//null_command_processor.h"
 #include "xenia/ui/vulkan/vulkan_provider.h"
 #include "xenia/xbox.h"
 
+DEFINE_bool(
+    null_gpu_headless, false,
+    "Don't create a host graphics provider with the null GPU backend, for "
+    "running without a host GPU (such as on servers for automated testing). "
+    "Nothing will be presented, including the emulator user interface.",
+    "GPU");
+
 namespace xe {
 namespace gpu {
 namespace null {
@@ -21,15 +29,14 @@ NullGraphicsSystem::NullGraphicsSystem() {}
 
 NullGraphicsSystem::~NullGraphicsSystem() {}
 
-X_STATUS NullGraphicsSystem::Setup(cpu::Processor* processor,
-                                   kernel::KernelState* kernel_state,
-                                   ui::WindowedAppContext* app_context,
-                                   bool is_surface_required) {
+std::unique_ptr<ui::GraphicsProvider> NullGraphicsSystem::CreateProvider(
+    bool is_surface_required) {
   // This is a null graphics system, but we still setup vulkan because UI needs
   // it through us :|
-  provider_ = xe::ui::vulkan::VulkanProvider::Create(is_surface_required);
-  return GraphicsSystem::Setup(processor, kernel_state, app_context,
-                               is_surface_required);
+  if (cvars::null_gpu_headless) {
+    return nullptr;
+  }
+  return xe::ui::vulkan::VulkanProvider::Create(is_surface_required);
 }
 
 std::unique_ptr<CommandProcessor> NullGraphicsSystem::CreateCommandProcessor() {
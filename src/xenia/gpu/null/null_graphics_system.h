@@ -28,11 +28,9 @@ class NullGraphicsSystem : public GraphicsSystem {
 
   std::string name() const override { return "null"; }
 
-  X_STATUS Setup(cpu::Processor* processor, kernel::KernelState* kernel_state,
-                 ui::WindowedAppContext* app_context,
-                 bool is_surface_required) override;
-
  private:
+  std::unique_ptr<ui::GraphicsProvider> CreateProvider(
+      bool is_surface_required) override;
   std::unique_ptr<CommandProcessor> CreateCommandProcessor() override;
 };
 
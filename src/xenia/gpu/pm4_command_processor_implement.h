@@ -645,6 +645,7 @@ bool COMMAND_PROCESSOR::ExecutePacketType3_XE_SWAP(uint32_t packet,
                                                    uint32_t count) XE_RESTRICT {
   SCOPE_profile_cpu_f("gpu");
 
+  kernel_state_->processor()->backend()->OnGuestFrameSwap();
   Profiler::Flip();
 
   // Xenia-specific VdSwap hook.
@@ -662,6 +663,10 @@ bool COMMAND_PROCESSOR::ExecutePacketType3_XE_SWAP(uint32_t packet,
 
   COMMAND_PROCESSOR::IssueSwap(frontbuffer_ptr, frontbuffer_width,
                                frontbuffer_height);
+  xe::input_latency::OnGuestSwap();
+  xe::frame_timeline::OnGuestSwap();
+  // The startup is considered complete when the first frame is presented.
+  xe::startup_timeline::Finish("First frame");
 
   ++counter_;
   return true;
@@ -735,7 +740,7 @@ bool COMMAND_PROCESSOR::ExecutePacketType3_WAIT_REG_MEM(
       // Wait.
       if (wait >= 0x100) {
         PrepareForWait();
-        if (!cvars::vsync) {
+        if (!cvars::vsync || xe::fast_forward::IsEnabled()) {
           // User wants it fast and dangerous.
           // do nothing
         } else {
@@ -752,6 +757,12 @@ bool COMMAND_PROCESSOR::ExecutePacketType3_WAIT_REG_MEM(
     }
   } while (!matched);
 
+  if (is_memory) {
+    // Likely waiting for the CPU to finish writing data used by the next
+    // commands.
+    memory_->PollPhysicalMemoryWrites();
+  }
+
   return true;
 }
 XE_NOINLINE
@@ -964,21 +975,35 @@ bool COMMAND_PROCESSOR::ExecutePacketType3_EVENT_WRITE_ZPD(
 
   // Occlusion queries:
   // This command is send on query begin and end.
+  uint32_t sample_count_address =
+      register_file_->values[XE_GPU_REG_RB_SAMPLE_COUNT_ADDR];
+  auto* pSampleCounts =
+      memory_->TranslatePhysical<xe_gpu_depth_sample_counts*>(
+          sample_count_address);
+  // 0xFFFFFEED is written to this two locations by D3D only on D3DISSUE_END
+  // and used to detect a finished query.
+  bool is_end_via_z_pass = pSampleCounts->ZPass_A == kQueryFinished &&
+                           pSampleCounts->ZPass_B == kQueryFinished;
+  // Older versions of D3D also checks for ZFail (4D5307D5).
+  bool is_end_via_z_fail = pSampleCounts->ZFail_A == kQueryFinished &&
+                           pSampleCounts->ZFail_B == kQueryFinished;
+  bool is_end = is_end_via_z_pass || is_end_via_z_fail;
+
+  if (cvars::query_occlusion_host &&
+      COMMAND_PROCESSOR::IssueOcclusionQuery(sample_count_address, is_end)) {
+    // The end counts are written once the host query has been completed, and
+    // until then the markers are kept so the guest sees the query as pending.
+    if (!is_end) {
+      std::memset(pSampleCounts, 0, sizeof(xe_gpu_depth_sample_counts));
+    }
+    return true;
+  }
+
   // As a workaround report some fixed amount of passed samples.
   auto fake_sample_count = cvars::query_occlusion_fake_sample_count;
   if (fake_sample_count >= 0) {
-    auto* pSampleCounts =
-        memory_->TranslatePhysical<xe_gpu_depth_sample_counts*>(
-            register_file_->values[XE_GPU_REG_RB_SAMPLE_COUNT_ADDR]);
-    // 0xFFFFFEED is written to this two locations by D3D only on D3DISSUE_END
-    // and used to detect a finished query.
-    bool is_end_via_z_pass = pSampleCounts->ZPass_A == kQueryFinished &&
-                             pSampleCounts->ZPass_B == kQueryFinished;
-    // Older versions of D3D also checks for ZFail (4D5307D5).
-    bool is_end_via_z_fail = pSampleCounts->ZFail_A == kQueryFinished &&
-                             pSampleCounts->ZFail_B == kQueryFinished;
     std::memset(pSampleCounts, 0, sizeof(xe_gpu_depth_sample_counts));
-    if (is_end_via_z_pass || is_end_via_z_fail) {
+    if (is_end) {
       pSampleCounts->ZPass_A = fake_sample_count;
       pSampleCounts->Total_A = fake_sample_count;
     }
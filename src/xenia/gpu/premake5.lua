@@ -14,6 +14,7 @@ project("xenia-gpu")
     "xenia-base",
     "xenia-ui",
     "xxhash",
+    "zstd",
   })
   includedirs({
     project_root.."/third_party/Vulkan-Headers/include",
@@ -34,6 +35,7 @@ project("xenia-gpu-shader-compiler")
     "xenia-gpu",
     "xenia-ui",
     "xenia-ui-vulkan",
+    "zstd",
   })
   includedirs({
     project_root.."/third_party/Vulkan-Headers/include",
@@ -53,3 +55,19 @@ project("xenia-gpu-shader-compiler")
         "1>scratch/stdout-shader-compiler.txt",
       })
     end
+
+group("src")
+project("xenia-gpu-shader-storage-merge")
+  uuid("d50f5e0d-a146-4f28-863d-fa2fca3558a3")
+  kind("ConsoleApp")
+  language("C++")
+  links({
+    "fmt",
+    "xenia-base",
+    "xenia-gpu",
+    "xxhash",
+  })
+  files({
+    "shader_storage_merge_main.cc",
+    "../base/console_app_main_"..platform_suffix..".cc",
+  })
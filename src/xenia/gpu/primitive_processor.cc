@@ -68,6 +68,23 @@ DEFINE_int32(
     "while a very low value may result in excessive locking and lookups.\n"
     "Negative values disable caching.",
     "GPU");
+DEFINE_int32(
+    primitive_processor_gpu_conversion_min_indices, -1,
+    "Smallest number of guest indices of a single triangle fan, line loop or "
+    "quad list to convert to the host primitive type on the GPU using compute "
+    "shaders reading the indices directly from the shared memory, rather than "
+    "on the CPU, if supported by the GPU backend.\n"
+    "Negative values disable conversion on the GPU.",
+    "GPU");
+DEFINE_bool(
+    primitive_processor_persistent_cache, false,
+    "Keep the processed indices in the cache across frames, until the guest "
+    "index buffer is modified, instead of clearing the cache at the end of "
+    "every frame.\n"
+    "In later frames, the indices are copied to a host index buffer for the "
+    "frame instead of being processed again, at the cost of keeping a copy of "
+    "the processed indices in the CPU memory.",
+    "GPU");
 
 namespace xe {
 namespace gpu {
@@ -247,6 +264,7 @@ void PrimitiveProcessor::ShutdownCommon() {
     {
       auto global_lock = global_critical_region_.Acquire();
       cache_map_.clear();
+      cache_host_indices_bytes_ = 0;
       cache_bucket_free_first_entry_ = SIZE_MAX;
       std::memset(cache_buckets_non_empty_l1_, 0,
                   sizeof(cache_buckets_non_empty_l1_));
@@ -261,16 +279,39 @@ void PrimitiveProcessor::ShutdownCommon() {
 }
 
 void PrimitiveProcessor::ClearPerFrameCache() {
+  COUNT_profile_set("gpu/primitive_processor/cache_hits_per_frame",
+                    cache_hits_in_frame_);
+  COUNT_profile_set(
+      "gpu/primitive_processor/cache_rematerializations_per_frame",
+      cache_rematerializations_in_frame_);
+  COUNT_profile_set("gpu/primitive_processor/cache_misses_per_frame",
+                    cache_misses_in_frame_);
+  cache_hits_in_frame_ = 0;
+  cache_rematerializations_in_frame_ = 0;
+  cache_misses_in_frame_ = 0;
+  // Host index buffers of the cached results are not valid in the next frame
+  // anymore.
+  ++cache_frame_;
   if (!memory_invalidation_callback_handle_) {
     // Only do clearing if cache has ever been used.
     return;
   }
   auto global_lock = global_critical_region_.Acquire();
+  if (cvars::primitive_processor_persistent_cache &&
+      cache_host_indices_bytes_ <= kCacheMaxHostIndicesBytes) {
+    // Keep the entries, the host indices will be copied to the host index
+    // buffers for the new frame when reused.
+    return;
+  }
   for (const std::pair<CacheKey, size_t>& cache_map_entry : cache_map_) {
-    cache_entry_pool_[cache_map_entry.second].free_next =
-        cache_bucket_free_first_entry_;
+    CacheEntry& entry = cache_entry_pool_[cache_map_entry.second];
+    entry.free_next = cache_bucket_free_first_entry_;
     cache_bucket_free_first_entry_ = cache_map_entry.second;
+    // Release the memory, especially if dropping the cache because it has
+    // become too large.
+    std::vector<uint8_t>().swap(entry.host_indices);
   }
+  cache_host_indices_bytes_ = 0;
   cache_map_.clear();
   std::memset(cache_buckets_non_empty_l1_, 0,
               sizeof(cache_buckets_non_empty_l1_));
@@ -683,9 +724,11 @@ bool PrimitiveProcessor::Process(ProcessingResult& result_out) {
       trace_writer_.WriteMemoryRead(guest_index_base,
                                     guest_index_buffer_needed_bytes);
       CacheTransaction cache_transaction(
-          *this, CacheKey(guest_index_base, guest_draw_vertex_count,
-                          guest_index_format, guest_index_endian,
-                          guest_primitive_reset_enabled, guest_primitive_type));
+          *this,
+          CacheKey(guest_index_base, guest_draw_vertex_count,
+                   guest_index_format, guest_index_endian,
+                   guest_primitive_reset_enabled, guest_primitive_type),
+          guest_primitive_reset_index_guest_endian);
       if (cache_transaction.GetFoundResult()) {
         cacheable = *cache_transaction.GetFoundResult();
       } else {
@@ -709,7 +752,42 @@ bool PrimitiveProcessor::Process(ProcessingResult& result_out) {
             return false;
         }
         single_primitive_ranges_.clear();
-        if (guest_index_format == xenos::IndexFormat::kInt16) {
+        bool converted_on_gpu = false;
+        if (cvars::primitive_processor_gpu_conversion_min_indices >= 0 &&
+            guest_draw_vertex_count >=
+                uint32_t(
+                    cvars::primitive_processor_gpu_conversion_min_indices) &&
+            (guest_index_format == xenos::IndexFormat::kInt16 ||
+             full_32bit_vertex_indices_used_)) {
+          // Only checking whether the reset index is used on the CPU, which
+          // doesn't need writing the indices, and converting directly from the
+          // shared memory if the index buffer contains a single primitive.
+          bool is_reset_used =
+              guest_primitive_reset_enabled &&
+              (guest_index_format == xenos::IndexFormat::kInt16
+                   ? IsResetUsed(
+                         reinterpret_cast<const uint16_t*>(guest_indices_ptr),
+                         guest_draw_vertex_count,
+                         guest_primitive_reset_index_guest_endian)
+                   : IsResetUsed(
+                         reinterpret_cast<const uint32_t*>(guest_indices_ptr),
+                         guest_draw_vertex_count,
+                         guest_primitive_reset_index_guest_endian,
+                         guest_index_mask_guest_endian));
+          if (!is_reset_used) {
+            cacheable.host_draw_vertex_count =
+                host_index_count_getter(guest_draw_vertex_count);
+            converted_on_gpu =
+                cacheable.host_draw_vertex_count &&
+                ConvertSinglePrimitiveOnGpu(
+                    guest_primitive_type, guest_index_format, guest_index_base,
+                    guest_draw_vertex_count, cacheable.host_draw_vertex_count,
+                    cacheable.host_index_buffer_handle);
+          }
+        }
+        if (converted_on_gpu) {
+          // Written in the guest byte order, with the original index format.
+        } else if (guest_index_format == xenos::IndexFormat::kInt16) {
           // 16-bit indices - just convert the primitive (or multiple
           // primitives) to the host topology.
           // TODO(Triang3l): 16-bit > 32-bit primitive type conversion for
@@ -735,7 +813,7 @@ bool PrimitiveProcessor::Process(ProcessingResult& result_out) {
                 0, guest_draw_vertex_count, cacheable.host_draw_vertex_count);
           }
           auto host_indices = reinterpret_cast<uint16_t*>(
-              RequestHostConvertedIndexBufferForCurrentFrame(
+              cache_transaction.RequestHostConvertedIndexBuffer(
                   xenos::IndexFormat::kInt16, cacheable.host_draw_vertex_count,
                   false, guest_index_base, cacheable.host_index_buffer_handle));
           if (!host_indices) {
@@ -769,7 +847,7 @@ bool PrimitiveProcessor::Process(ProcessingResult& result_out) {
                 0, guest_draw_vertex_count, cacheable.host_draw_vertex_count);
           }
           auto host_indices = reinterpret_cast<uint32_t*>(
-              RequestHostConvertedIndexBufferForCurrentFrame(
+              cache_transaction.RequestHostConvertedIndexBuffer(
                   xenos::IndexFormat::kInt32, cacheable.host_draw_vertex_count,
                   false, guest_index_base, cacheable.host_index_buffer_handle));
           if (!host_indices) {
@@ -848,9 +926,11 @@ bool PrimitiveProcessor::Process(ProcessingResult& result_out) {
             // Not specifying the primitive type in the cache key because not
             // replacing it, only the reset index in a type-independent way.
             CacheTransaction cache_transaction(
-                *this, CacheKey(guest_index_base, guest_draw_vertex_count,
-                                guest_index_format, guest_index_endian,
-                                guest_primitive_reset_enabled));
+                *this,
+                CacheKey(guest_index_base, guest_draw_vertex_count,
+                         guest_index_format, guest_index_endian,
+                         guest_primitive_reset_enabled),
+                guest_primitive_reset_index_guest_endian);
             if (cache_transaction.GetFoundResult()) {
               cacheable = *cache_transaction.GetFoundResult();
             } else {
@@ -868,7 +948,7 @@ bool PrimitiveProcessor::Process(ProcessingResult& result_out) {
                                                   ? xenos::IndexFormat::kInt32
                                                   : xenos::IndexFormat::kInt16;
                 void* host_indices_ptr =
-                    RequestHostConvertedIndexBufferForCurrentFrame(
+                    cache_transaction.RequestHostConvertedIndexBuffer(
                         cacheable.host_index_format, guest_draw_vertex_count,
                         true, guest_index_base,
                         cacheable.host_index_buffer_handle);
@@ -906,9 +986,11 @@ bool PrimitiveProcessor::Process(ProcessingResult& result_out) {
           // Not specifying the primitive type in the cache key because not
           // replacing it, only the reset index in a type-independent way.
           CacheTransaction cache_transaction(
-              *this, CacheKey(guest_index_base, guest_draw_vertex_count,
-                              guest_index_format, guest_index_endian,
-                              guest_primitive_reset_enabled));
+              *this,
+              CacheKey(guest_index_base, guest_draw_vertex_count,
+                       guest_index_format, guest_index_endian,
+                       guest_primitive_reset_enabled),
+              guest_primitive_reset_index_guest_endian);
           if (cache_transaction.GetFoundResult()) {
             cacheable = *cache_transaction.GetFoundResult();
           } else {
@@ -920,7 +1002,7 @@ bool PrimitiveProcessor::Process(ProcessingResult& result_out) {
               cacheable.index_buffer_type =
                   ProcessedIndexBufferType::kHostConverted;
               auto host_indices = reinterpret_cast<uint32_t*>(
-                  RequestHostConvertedIndexBufferForCurrentFrame(
+                  cache_transaction.RequestHostConvertedIndexBuffer(
                       xenos::IndexFormat::kInt32, guest_draw_vertex_count, true,
                       guest_index_base, cacheable.host_index_buffer_handle));
               if (!host_indices) {
@@ -1412,8 +1494,11 @@ uint32_t PrimitiveProcessor::GetMultiPrimitiveHostIndexCountAndRanges(
 }
 
 PrimitiveProcessor::CacheTransaction::CacheTransaction(
-    PrimitiveProcessor& processor, CacheKey key)
-    : processor_(processor), key_(key) {
+    PrimitiveProcessor& processor, CacheKey key,
+    uint32_t reset_index_guest_endian)
+    : processor_(processor),
+      key_(key),
+      reset_index_guest_endian_(reset_index_guest_endian) {
   assert_zero(processor_.cache_currently_processing_size_bytes_);
   if (cvars::primitive_processor_cache_min_indices < 0 ||
       key_.count < uint32_t(cvars::primitive_processor_cache_min_indices)) {
@@ -1427,20 +1512,50 @@ PrimitiveProcessor::CacheTransaction::CacheTransaction(
       (key_.format == xenos::IndexFormat::kInt16 ? sizeof(uint16_t)
                                                  : sizeof(uint32_t)) *
       key_.count;
+  bool rematerialize = false;
   {
     auto global_lock = processor_.global_critical_region_.Acquire();
     auto cache_map_it = processor_.cache_map_.find(key_);
     if (cache_map_it != processor_.cache_map_.end()) {
-      result_ = processor_.cache_entry_pool_[cache_map_it->second].result;
-      result_type_ = ResultType::kExisting;
-    } else {
+      const CacheEntry& entry =
+          processor_.cache_entry_pool_[cache_map_it->second];
+      // If the reset index is different, process the indices again, and
+      // replace the entry in the destructor.
+      if (!key_.is_reset_enabled ||
+          entry.reset_index_guest_endian == reset_index_guest_endian_) {
+        result_ = entry.result;
+        if (result_.index_buffer_type !=
+                ProcessedIndexBufferType::kHostConverted ||
+            entry.frame == processor_.cache_frame_) {
+          result_type_ = ResultType::kExisting;
+        } else {
+          rematerialize = true;
+        }
+      }
+    }
+    if (result_type_ != ResultType::kExisting && !rematerialize) {
       // Inhibit writing the new result if the range happens to be modified
       // during the processing outside the lock.
       processor_.cache_currently_processing_base_ = key_.base;
       processor_.cache_currently_processing_size_bytes_ = size_bytes;
     }
   }
-  if (result_type_ != ResultType::kExisting) {
+  if (rematerialize) {
+    if (processor_.RematerializeCacheEntry(key_, result_)) {
+      result_type_ = ResultType::kExisting;
+      ++processor_.cache_rematerializations_in_frame_;
+      return;
+    }
+    // Invalidated while the lock was released, or failed to copy - process the
+    // indices again.
+    auto global_lock = processor_.global_critical_region_.Acquire();
+    processor_.cache_currently_processing_base_ = key_.base;
+    processor_.cache_currently_processing_size_bytes_ = size_bytes;
+  }
+  if (result_type_ == ResultType::kExisting) {
+    ++processor_.cache_hits_in_frame_;
+  } else {
+    ++processor_.cache_misses_in_frame_;
     // Enable the invalidation callback before reading the indices.
     // Also, only enable invalidation callbacks if anything needed processing at
     // all - don't waste time in the access violation handler doing nothing if
@@ -1451,7 +1566,8 @@ PrimitiveProcessor::CacheTransaction::CacheTransaction(
               MemoryInvalidationCallbackThunk, &processor_);
     }
     processor_.memory_.EnablePhysicalMemoryAccessCallbacks(
-        key_.base, size_bytes, true, false);
+        key_.base, size_bytes, true, false,
+        processor_.memory_invalidation_callback_handle_);
   }
 }
 
@@ -1465,8 +1581,19 @@ PrimitiveProcessor::CacheTransaction::~CacheTransaction() {
   processor_.cache_currently_processing_base_ = 0;
   processor_.cache_currently_processing_size_bytes_ = 0;
 
-  if (result_type_ == ResultType::kNewSet) {
-    size_t new_entry_index;
+  if (result_type_ != ResultType::kNewSet) {
+    return;
+  }
+
+  size_t new_entry_index;
+  auto cache_map_it = processor_.cache_map_.find(key_);
+  if (cache_map_it != processor_.cache_map_.end()) {
+    // Replacing an entry processed with a different reset index, already
+    // linked to the buckets of the range.
+    new_entry_index = cache_map_it->second;
+    processor_.cache_host_indices_bytes_ -=
+        processor_.cache_entry_pool_[new_entry_index].host_indices.size();
+  } else {
     if (processor_.cache_bucket_free_first_entry_ != SIZE_MAX) {
       new_entry_index = processor_.cache_bucket_free_first_entry_;
       processor_.cache_bucket_free_first_entry_ =
@@ -1509,11 +1636,90 @@ PrimitiveProcessor::CacheTransaction::~CacheTransaction() {
       bucket_first_entry_ref = new_entry_index;
     }
 
-    new_entry.key = key_;
-    new_entry.result = result_;
-
     processor_.cache_map_.emplace(key_, new_entry_index);
   }
+
+  CacheEntry& new_entry = processor_.cache_entry_pool_[new_entry_index];
+  new_entry.key = key_;
+  new_entry.result = result_;
+  new_entry.reset_index_guest_endian = reset_index_guest_endian_;
+  new_entry.frame = processor_.cache_frame_;
+  if (host_index_buffer_) {
+    new_entry.host_indices.swap(processor_.cache_host_indices_scratch_);
+  } else {
+    new_entry.host_indices.clear();
+  }
+  processor_.cache_host_indices_bytes_ += new_entry.host_indices.size();
+}
+
+void* PrimitiveProcessor::CacheTransaction::RequestHostConvertedIndexBuffer(
+    xenos::IndexFormat format, uint32_t index_count, bool coalign_for_simd,
+    uint32_t coalignment_original_address, size_t& backend_handle_out) {
+  void* host_index_buffer =
+      processor_.RequestHostConvertedIndexBufferForCurrentFrame(
+          format, index_count, coalign_for_simd, coalignment_original_address,
+          backend_handle_out);
+  if (!host_index_buffer || !key_.count ||
+      !cvars::primitive_processor_persistent_cache) {
+    return host_index_buffer;
+  }
+  host_index_buffer_ = host_index_buffer;
+  processor_.cache_host_indices_scratch_.resize(
+      (format == xenos::IndexFormat::kInt16 ? sizeof(uint16_t)
+                                            : sizeof(uint32_t)) *
+      index_count);
+  return processor_.cache_host_indices_scratch_.data();
+}
+
+void PrimitiveProcessor::CacheTransaction::SetNewResult(
+    const CachedResult& new_result) {
+  // Replacement of an existing entry is not allowed.
+  assert_true(result_type_ != ResultType::kExisting);
+  result_ = new_result;
+  result_type_ = ResultType::kNewSet;
+  if (host_index_buffer_) {
+    if (result_.index_buffer_type == ProcessedIndexBufferType::kHostConverted) {
+      std::memcpy(host_index_buffer_,
+                  processor_.cache_host_indices_scratch_.data(),
+                  processor_.cache_host_indices_scratch_.size());
+    } else {
+      host_index_buffer_ = nullptr;
+    }
+  }
+}
+
+bool PrimitiveProcessor::RematerializeCacheEntry(CacheKey key,
+                                                 CachedResult& result_out) {
+  assert_true(result_out.index_buffer_type ==
+              ProcessedIndexBufferType::kHostConverted);
+  size_t host_index_buffer_handle;
+  void* host_index_buffer = RequestHostConvertedIndexBufferForCurrentFrame(
+      result_out.host_index_format, result_out.host_draw_vertex_count, false,
+      key.base, host_index_buffer_handle);
+  if (!host_index_buffer) {
+    return false;
+  }
+  size_t host_indices_size =
+      (result_out.host_index_format == xenos::IndexFormat::kInt16
+           ? sizeof(uint16_t)
+           : sizeof(uint32_t)) *
+      result_out.host_draw_vertex_count;
+  auto global_lock = global_critical_region_.Acquire();
+  auto cache_map_it = cache_map_.find(key);
+  if (cache_map_it == cache_map_.end()) {
+    return false;
+  }
+  CacheEntry& entry = cache_entry_pool_[cache_map_it->second];
+  // The host indices may have not been stored if persistent caching was
+  // enabled during the frame.
+  if (entry.host_indices.size() != host_indices_size) {
+    return false;
+  }
+  std::memcpy(host_index_buffer, entry.host_indices.data(), host_indices_size);
+  entry.result.host_index_buffer_handle = host_index_buffer_handle;
+  entry.frame = cache_frame_;
+  result_out = entry.result;
+  return true;
 }
 
 std::pair<uint32_t, uint32_t> PrimitiveProcessor::MemoryInvalidationCallback(
@@ -1610,7 +1816,7 @@ std::pair<uint32_t, uint32_t> PrimitiveProcessor::MemoryInvalidationCallback(
           // the specified range.
           if (entry_key.base < physical_address_end) {
             uint32_t entry_end = entry_key.base + entry_key.GetSizeBytes();
-            if (entry_end > physical_address_end) {
+            if (entry_end > physical_address_start) {
               // Invalidate the entry.
               any_invalidated = true;
               // Remove the entry from the cache map.
@@ -1658,7 +1864,9 @@ std::pair<uint32_t, uint32_t> PrimitiveProcessor::MemoryInvalidationCallback(
                       entry_bucket_index)] = entry_link_prev;
                 }
               }
-              // Make the entry free for reuse.
+              // Make the entry free for reuse, keeping the allocation of the
+              // host indices.
+              cache_host_indices_bytes_ -= entry.host_indices.size();
               entry.free_next = cache_bucket_free_first_entry_;
               cache_bucket_free_first_entry_ = entry_index;
             }
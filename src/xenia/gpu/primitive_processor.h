@@ -20,6 +20,7 @@
 #include <mutex>
 #include <unordered_map>
 #include <utility>
+#include <vector>
 
 #include "xenia/base/assert.h"
 #include "xenia/base/cvar.h"
@@ -152,6 +153,25 @@ class PrimitiveProcessor {
     bool IsTessellated() const {
       return Shader::IsHostVertexShaderTypeDomain(host_vertex_shader_type);
     }
+    // Whether this indexed draw can be merged with a preceding one with the
+    // same state whose indices directly precede the indices of this one in
+    // memory - with list primitive types, all primitives are independent.
+    bool IsMergeableWithAdjacentIndices() const {
+      if (index_buffer_type == ProcessedIndexBufferType::kNone ||
+          IsTessellated()) {
+        return false;
+      }
+      switch (host_primitive_type) {
+        case xenos::PrimitiveType::kPointList:
+        case xenos::PrimitiveType::kLineList:
+        case xenos::PrimitiveType::kTriangleList:
+        case xenos::PrimitiveType::kRectangleList:
+        case xenos::PrimitiveType::kQuadList:
+          return true;
+        default:
+          return false;
+      }
+    }
   };
 
   virtual ~PrimitiveProcessor();
@@ -272,7 +292,9 @@ class PrimitiveProcessor {
 
   // Call at boundaries of lifespans of converted data (between frames,
   // preferably in the end of a frame so between the swap and the next draw,
-  // access violation handlers need to do less work).
+  // access violation handlers need to do less work). With
+  // primitive_processor_persistent_cache, keeps the entries unless the cache
+  // has become too large.
   void ClearPerFrameCache();
 
   static constexpr size_t GetBuiltinIndexBufferOffsetBytes(size_t handle) {
@@ -316,6 +338,22 @@ class PrimitiveProcessor {
       xenos::IndexFormat format, uint32_t index_count, bool coalign_for_simd,
       uint32_t coalignment_original_address, size_t& backend_handle_out) = 0;
 
+  // Optionally converts the indices of a single guest primitive (without
+  // primitive reset used) of a type not supported by the host directly from
+  // the shared memory on the GPU, writing them to a host index buffer for the
+  // current frame. Only requested for formats not needing pre-swapping or
+  // masking (16-bit, or 32-bit with full 32-bit vertex indices used), and the
+  // indices must be written in the guest byte order. Returns false if not
+  // supported or failed, in which case the conversion will be done on the CPU.
+  virtual bool ConvertSinglePrimitiveOnGpu(
+      xenos::PrimitiveType guest_primitive_type, xenos::IndexFormat format,
+      uint32_t guest_index_base, uint32_t guest_index_count,
+      uint32_t host_index_count, size_t& backend_handle_out) {
+    return false;
+  }
+
+  SharedMemory& shared_memory() const { return shared_memory_; }
+
  private:
 #if XE_GPU_PRIMITIVE_PROCESSOR_SIMD_SIZE
 #if XE_ARCH_AMD64
@@ -709,7 +747,8 @@ class PrimitiveProcessor {
 
   std::deque<SinglePrimitiveRange> single_primitive_ranges_;
 
-  // Caching for reuse of converted indices within a frame.
+  // Caching for reuse of converted indices within a frame, and, with
+  // primitive_processor_persistent_cache, across frames.
 
   // 256 KB as the largest possible guest index buffer - 0xFFFF 32-bit indices -
   // is slightly smaller than 256 KB, thus cache entries need store links within
@@ -792,6 +831,16 @@ class PrimitiveProcessor {
     size_t buckets_next[2];
     CacheKey key;
     CachedResult result;
+    // The reset index is not a part of the key, but the result depends on it
+    // if reset is enabled.
+    uint32_t reset_index_guest_endian;
+    // cache_frame_ when result.host_index_buffer_handle was obtained - the
+    // host index buffer is only valid within that frame.
+    uint64_t frame;
+    // For persistent caching, the host indices of a kHostConverted result, to
+    // be copied to a buffer for the current frame in later frames. The
+    // allocation is kept when the entry is freed to be reused later.
+    std::vector<uint8_t> host_indices;
     static uint32_t GetBucketCount(CacheKey key) {
       uint32_t count =
           ((key.base + (key.GetSizeBytes() - 1)) >> kCacheBucketSizeBytesLog2) -
@@ -817,6 +866,9 @@ class PrimitiveProcessor {
   //       stored as it will already be invalid at the time of the completion of
   //       the transaction.
   //     - Enabling an access callback for the range.
+  //   - If found, but the host indices were converted in an earlier frame
+  //     (with primitive_processor_persistent_cache), copying the stored host
+  //     indices into a host index buffer for the current frame.
   // - Setting the new result after processing (if not found in the cache
   //   previously).
   // - Transaction completion:
@@ -827,16 +879,21 @@ class PrimitiveProcessor {
   // possibility replace existing entries.
   class CacheTransaction final {
    public:
-    CacheTransaction(PrimitiveProcessor& processor, CacheKey key);
+    CacheTransaction(PrimitiveProcessor& processor, CacheKey key,
+                     uint32_t reset_index_guest_endian);
     const CachedResult* GetFoundResult() const {
       return result_type_ == ResultType::kExisting ? &result_ : nullptr;
     }
-    void SetNewResult(const CachedResult& new_result) {
-      // Replacement of an existing entry is not allowed.
-      assert_true(result_type_ != ResultType::kExisting);
-      result_ = new_result;
-      result_type_ = ResultType::kNewSet;
-    }
+    // Same as RequestHostConvertedIndexBufferForCurrentFrame, but if the host
+    // indices need to be kept for reuse in later frames, returns a CPU-side
+    // buffer (also to avoid reading back from write-combined memory) that will
+    // be copied to the host index buffer in SetNewResult.
+    void* RequestHostConvertedIndexBuffer(xenos::IndexFormat format,
+                                          uint32_t index_count,
+                                          bool coalign_for_simd,
+                                          uint32_t coalignment_original_address,
+                                          size_t& backend_handle_out);
+    void SetNewResult(const CachedResult& new_result);
     ~CacheTransaction();
 
    private:
@@ -846,7 +903,11 @@ class PrimitiveProcessor {
     // special logic, and count == 0 is also used as a special indicator for
     // vertex count below the cache usage threshold.
     CacheKey key_;
+    uint32_t reset_index_guest_endian_;
     CachedResult result_;
+    // If not null, the converted indices are in cache_host_indices_scratch_,
+    // and need to be copied to this host index buffer.
+    void* host_index_buffer_ = nullptr;
     enum class ResultType {
       kNewUnset,
       kNewSet,
@@ -855,6 +916,16 @@ class PrimitiveProcessor {
     ResultType result_type_ = ResultType::kNewUnset;
   };
 
+  // Upper limit of the total size of the host indices kept for reuse in later
+  // frames, the whole cache is dropped at the end of the frame if exceeded.
+  static constexpr size_t kCacheMaxHostIndicesBytes = size_t(64) << 20;
+
+  // Tries to copy the host indices stored in the entry for the key, if it
+  // still exists, to a new host index buffer for the current frame. Must be
+  // called outside the global critical region as the backend may need to
+  // allocate memory. result_out must initially contain the cached result.
+  bool RematerializeCacheEntry(CacheKey key, CachedResult& result_out);
+
   std::deque<CacheEntry> cache_entry_pool_;
 
   void* memory_invalidation_callback_handle_ = nullptr;
@@ -871,6 +942,22 @@ class PrimitiveProcessor {
   // 0 if not in a cache transaction that hasn't found an existing entry
   // currently.
   uint32_t cache_currently_processing_size_bytes_ = 0;
+  // Incremented by ClearPerFrameCache, for persistent caching.
+  // Modified by the processor.
+  uint64_t cache_frame_ = 0;
+  // Where the indices are converted in a transaction before being copied to
+  // the host index buffer if they need to be kept for reuse in later frames.
+  // Swapped with CacheEntry::host_indices when storing the entry.
+  // Modified by the processor.
+  std::vector<uint8_t> cache_host_indices_scratch_;
+  // Total size of CacheEntry::host_indices of the entries in the cache.
+  // Modified by both the processor and the invalidation callback.
+  size_t cache_host_indices_bytes_ = 0;
+  // Statistics for the current frame.
+  // Modified by the processor.
+  uint32_t cache_hits_in_frame_ = 0;
+  uint32_t cache_rematerializations_in_frame_ = 0;
+  uint32_t cache_misses_in_frame_ = 0;
   // Modified by both the processor and the invalidation callback.
   size_t cache_bucket_free_first_entry_ = SIZE_MAX;
   // Modified by both the processor and the invalidation callback.
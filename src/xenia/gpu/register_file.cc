@@ -8,15 +8,144 @@
  */
 
 #include "xenia/gpu/register_file.h"
+#include <algorithm>
 #include <array>
 #include <cstring>
 
+#include "xenia/base/byte_order.h"
 #include "xenia/base/math.h"
 
 namespace xe {
 namespace gpu {
 
 RegisterFile::RegisterFile() { std::memset(values, 0, sizeof(values)); }
+
+static constexpr std::array<uint8_t, RegisterFile::kRegisterCount>
+BuildRegisterStateGroups() {
+  std::array<uint8_t, RegisterFile::kRegisterCount> groups{};
+  // Viewport (draw_util::GetViewportInfoArgs) and scissor (GetScissor).
+  for (uint32_t index :
+       {XE_GPU_REG_RB_SURFACE_INFO, XE_GPU_REG_RB_DEPTH_INFO,
+        XE_GPU_REG_PA_SC_SCREEN_SCISSOR_TL, XE_GPU_REG_PA_SC_SCREEN_SCISSOR_BR,
+        XE_GPU_REG_PA_SC_WINDOW_OFFSET, XE_GPU_REG_PA_SC_WINDOW_SCISSOR_TL,
+        XE_GPU_REG_PA_SC_WINDOW_SCISSOR_BR, XE_GPU_REG_PA_CL_VPORT_XSCALE,
+        XE_GPU_REG_PA_CL_VPORT_XOFFSET, XE_GPU_REG_PA_CL_VPORT_YSCALE,
+        XE_GPU_REG_PA_CL_VPORT_YOFFSET, XE_GPU_REG_PA_CL_VPORT_ZSCALE,
+        XE_GPU_REG_PA_CL_VPORT_ZOFFSET, XE_GPU_REG_PA_CL_CLIP_CNTL,
+        XE_GPU_REG_PA_SU_SC_MODE_CNTL, XE_GPU_REG_PA_CL_VTE_CNTL,
+        XE_GPU_REG_PA_SU_VTX_CNTL}) {
+    groups[index] |= RegisterFile::kStateGroupViewport;
+  }
+  for (uint32_t index = XE_GPU_REG_RB_BLEND_RED;
+       index <= XE_GPU_REG_RB_BLEND_ALPHA; ++index) {
+    groups[index] |= RegisterFile::kStateGroupBlend;
+  }
+  // Including the registers the normalized depth control, the face selection
+  // and the polygon offset are derived from.
+  for (uint32_t index :
+       {XE_GPU_REG_RB_DEPTH_INFO, XE_GPU_REG_RB_STENCILREFMASK_BF,
+        XE_GPU_REG_RB_STENCILREFMASK, XE_GPU_REG_RB_DEPTHCONTROL,
+        XE_GPU_REG_PA_SU_SC_MODE_CNTL, XE_GPU_REG_RB_MODECONTROL,
+        XE_GPU_REG_PA_SU_POLY_OFFSET_FRONT_SCALE,
+        XE_GPU_REG_PA_SU_POLY_OFFSET_FRONT_OFFSET,
+        XE_GPU_REG_PA_SU_POLY_OFFSET_BACK_SCALE,
+        XE_GPU_REG_PA_SU_POLY_OFFSET_BACK_OFFSET}) {
+    groups[index] |= RegisterFile::kStateGroupDepthStencil;
+  }
+  for (uint32_t index = XE_GPU_REG_SHADER_CONSTANT_000_X;
+       index <= XE_GPU_REG_SHADER_CONSTANT_511_W; ++index) {
+    groups[index] |= RegisterFile::kStateGroupShaderConstants;
+  }
+  for (uint32_t index = XE_GPU_REG_SHADER_CONSTANT_BOOL_000_031;
+       index <= XE_GPU_REG_SHADER_CONSTANT_LOOP_31; ++index) {
+    groups[index] |= RegisterFile::kStateGroupShaderConstants;
+  }
+  for (uint32_t index = XE_GPU_REG_SHADER_CONSTANT_FETCH_00_0;
+       index <= XE_GPU_REG_SHADER_CONSTANT_FETCH_31_5; ++index) {
+    groups[index] |= RegisterFile::kStateGroupFetchConstants;
+  }
+  return groups;
+}
+const std::array<uint8_t, RegisterFile::kRegisterCount>
+    RegisterFile::register_state_groups_ = BuildRegisterStateGroups();
+
+static constexpr std::array<uint8_t, RegisterFile::kRegisterCount>
+BuildRegisterWriteClasses() {
+  std::array<uint8_t, RegisterFile::kRegisterCount> classes{};
+  auto set_class = [&classes](uint32_t first_index, uint32_t last_index,
+                              RegisterFile::WriteClass write_class) {
+    for (uint32_t index = first_index; index <= last_index; ++index) {
+      classes[index] = uint8_t(write_class);
+    }
+  };
+  // Must match the registers HandleSpecialRegisterWrite handles.
+  set_class(XE_GPU_REG_SCRATCH_REG0, XE_GPU_REG_SCRATCH_REG7,
+            RegisterFile::WriteClass::kSpecial);
+  set_class(XE_GPU_REG_COHER_STATUS_HOST, XE_GPU_REG_COHER_STATUS_HOST,
+            RegisterFile::WriteClass::kSpecial);
+  set_class(XE_GPU_REG_DC_LUT_RW_INDEX, XE_GPU_REG_DC_LUT_30_COLOR,
+            RegisterFile::WriteClass::kSpecial);
+  set_class(XE_GPU_REG_SHADER_CONSTANT_000_X, XE_GPU_REG_SHADER_CONSTANT_511_W,
+            RegisterFile::WriteClass::kFloatConstant);
+  set_class(XE_GPU_REG_SHADER_CONSTANT_FETCH_00_0,
+            XE_GPU_REG_SHADER_CONSTANT_FETCH_31_5,
+            RegisterFile::WriteClass::kFetchConstant);
+  set_class(XE_GPU_REG_SHADER_CONSTANT_BOOL_000_031,
+            XE_GPU_REG_SHADER_CONSTANT_LOOP_31,
+            RegisterFile::WriteClass::kBoolLoopConstant);
+  return classes;
+}
+static constexpr std::array<uint8_t, RegisterFile::kRegisterCount>
+    kRegisterWriteClasses = BuildRegisterWriteClasses();
+const std::array<uint8_t, RegisterFile::kRegisterCount>
+    RegisterFile::register_write_classes_ = kRegisterWriteClasses;
+
+static constexpr std::array<uint16_t, RegisterFile::kRegisterCount>
+BuildRegisterWriteClassRunEnds() {
+  std::array<uint16_t, RegisterFile::kRegisterCount> run_ends{};
+  uint32_t run_end = RegisterFile::kRegisterCount;
+  for (uint32_t index = RegisterFile::kRegisterCount; index-- > 0;) {
+    if (index + 1 < RegisterFile::kRegisterCount &&
+        kRegisterWriteClasses[index + 1] != kRegisterWriteClasses[index]) {
+      run_end = index + 1;
+    }
+    run_ends[index] = uint16_t(run_end);
+  }
+  return run_ends;
+}
+const std::array<uint16_t, RegisterFile::kRegisterCount>
+    RegisterFile::register_write_class_run_ends_ =
+        BuildRegisterWriteClassRunEnds();
+
+void RegisterFile::MarkRangeWritten(uint32_t first_index, uint32_t count) {
+  uint32_t end_index =
+      std::min(first_index + count, uint32_t(kRegisterCount));
+  uint32_t groups = 0;
+  for (uint32_t index = first_index; index < end_index; ++index) {
+    groups |= register_state_groups_[index];
+  }
+  dirty_state_groups_ |= groups;
+}
+uint32_t RegisterFile::StoreFetchConstants(uint32_t first_index,
+                                           const uint32_t* base,
+                                           uint32_t count) {
+  assert_true(first_index >= XE_GPU_REG_SHADER_CONSTANT_FETCH_00_0 &&
+              first_index + count <= XE_GPU_REG_SHADER_CONSTANT_FETCH_31_5 + 1);
+  uint32_t changed = 0;
+  for (uint32_t i = 0; i < count; ++i) {
+    uint32_t index = first_index + i;
+    uint32_t value = xe::load_and_swap<uint32_t>(base + i);
+    if (values[index] != value) {
+      values[index] = value;
+      changed |= UINT32_C(1)
+                 << ((index - XE_GPU_REG_SHADER_CONSTANT_FETCH_00_0) / 6);
+    }
+  }
+  if (changed) {
+    dirty_state_groups_ |= kStateGroupFetchConstants;
+  }
+  return changed;
+}
 constexpr unsigned int GetHighestRegisterNumber() {
   uint32_t highest = 0;
 #define XE_GPU_REGISTER(index, type, name) \
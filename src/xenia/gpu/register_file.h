@@ -10,6 +10,8 @@
 #ifndef XENIA_GPU_REGISTER_FILE_H_
 #define XENIA_GPU_REGISTER_FILE_H_
 
+#include <algorithm>
+#include <array>
 #include <cstdint>
 #include <cstdlib>
 #include <cstring>
@@ -33,6 +35,47 @@ struct RegisterInfo {
 
 class RegisterFile {
  public:
+  // Groups of registers by the host state derived from them, so the backends
+  // can rebuild only the state whose registers have been written since it was
+  // last built, instead of reading and comparing all of it on every draw. A
+  // register may be an input of multiple groups.
+  enum StateGroupIndex : uint32_t {
+    // Viewport and scissor.
+    kStateGroupIndexViewport,
+    // Blend constants.
+    kStateGroupIndexBlend,
+    // Stencil reference and masks, polygon offset.
+    kStateGroupIndexDepthStencil,
+    kStateGroupIndexShaderConstants,
+    kStateGroupIndexFetchConstants,
+
+    kStateGroupCount,
+  };
+  enum StateGroup : uint32_t {
+    kStateGroupViewport = 1 << kStateGroupIndexViewport,
+    kStateGroupBlend = 1 << kStateGroupIndexBlend,
+    kStateGroupDepthStencil = 1 << kStateGroupIndexDepthStencil,
+    kStateGroupShaderConstants = 1 << kStateGroupIndexShaderConstants,
+    kStateGroupFetchConstants = 1 << kStateGroupIndexFetchConstants,
+  };
+  static constexpr uint32_t kStateGroupsAll = (1 << kStateGroupCount) - 1;
+
+  // How the command processor handles writes to a register beyond storing the
+  // value and marking its state groups as written. Registers of each class
+  // other than kSpecial form contiguous ranges, so a range of written
+  // registers can be handled in runs of registers of the same class instead
+  // of register by register.
+  enum class WriteClass : uint8_t {
+    kRegular,
+    // Handled by CommandProcessor::HandleSpecialRegisterWrite, one register
+    // at a time and in the order of the writes - scratch registers,
+    // COHER_STATUS_HOST, the gamma ramp.
+    kSpecial,
+    kFloatConstant,
+    kFetchConstant,
+    kBoolLoopConstant,
+  };
+
   RegisterFile();
 
   static const RegisterInfo* GetRegisterInfo(uint32_t index);
@@ -40,6 +83,51 @@ class RegisterFile {
   static constexpr size_t kRegisterCount = 0x5003;
   uint32_t values[kRegisterCount];
 
+  // StateGroup bits of the host state depending on the register.
+  static uint32_t GetStateGroups(uint32_t index) {
+    return index < kRegisterCount ? register_state_groups_[index] : 0;
+  }
+
+  static WriteClass GetWriteClass(uint32_t index) {
+    return index < kRegisterCount ? WriteClass(register_write_classes_[index])
+                                  : WriteClass::kRegular;
+  }
+  // Returns the number of registers, starting from first_index (which must be
+  // a valid index) and up to count, of the same write class as the first.
+  static uint32_t GetWriteClassRunLength(uint32_t first_index,
+                                         uint32_t count) {
+    return std::min(
+        uint32_t(register_write_class_run_ends_[first_index]) - first_index,
+        count);
+  }
+
+  // Must be called when values are modified directly rather than through the
+  // register writes of the command processor.
+  void MarkWritten(uint32_t index) {
+    dirty_state_groups_ |= GetStateGroups(index);
+  }
+  void MarkRangeWritten(uint32_t first_index, uint32_t count);
+  void MarkStateGroupsWritten(uint32_t groups) {
+    dirty_state_groups_ |= groups;
+  }
+
+  // Returns which of the groups have had their registers written since the
+  // last time they were taken, and marks them as up to date.
+  uint32_t TakeDirtyStateGroups(uint32_t groups) {
+    uint32_t dirty = dirty_state_groups_ & groups;
+    dirty_state_groups_ &= ~groups;
+    return dirty;
+  }
+
+  // Stores the big-endian values of the fetch constant registers starting
+  // from first_index, returning the mask of the texture fetch constants (of 6
+  // registers each) whose values have changed, so titles rewriting the same
+  // fetch constants on every draw don't cause the texture bindings to be
+  // updated. The state groups are marked as written only if anything has
+  // changed.
+  uint32_t StoreFetchConstants(uint32_t first_index, const uint32_t* base,
+                               uint32_t count);
+
   const uint32_t& operator[](uint32_t reg) const { return values[reg]; }
   uint32_t& operator[](uint32_t reg) { return values[reg]; }
 
@@ -86,6 +174,17 @@ class RegisterFile {
         sizeof(stream));
     return stream;
   }
+
+ private:
+  static const std::array<uint8_t, kRegisterCount> register_state_groups_;
+  static const std::array<uint8_t, kRegisterCount> register_write_classes_;
+  // Index after the last register of the run of registers of the same write
+  // class the register is in.
+  static const std::array<uint16_t, kRegisterCount>
+      register_write_class_run_ends_;
+
+  // The state derived from the initial values hasn't been built yet.
+  uint32_t dirty_state_groups_ = kStateGroupsAll;
 };
 
 }  // namespace gpu
@@ -21,6 +21,7 @@
 #include "xenia/base/cvar.h"
 #include "xenia/base/logging.h"
 #include "xenia/base/math.h"
+#include "xenia/base/profiling.h"
 #include "xenia/gpu/draw_util.h"
 #include "xenia/gpu/register_file.h"
 #include "xenia/gpu/registers.h"
@@ -203,6 +204,15 @@ DEFINE_bool(
     "If this is enabled, excessive barriers may be eliminated when switching "
     "between different render targets in separate EDRAM locations.",
     "GPU");
+DEFINE_bool(
+    skip_redundant_resolve_clears, false,
+    "Skip resolve clears of EDRAM tiles that have already been cleared with "
+    "the same parameters and, according to the estimated extents of the "
+    "draws, haven't been drawn to since then, saving bandwidth (and, with host "
+    "render targets, ownership transfers) at high resolution scales.\n"
+    "May cause stale data to be left in the EDRAM if the extent of a draw is "
+    "underestimated.",
+    "GPU");
 
 namespace xe {
 namespace gpu {
@@ -513,6 +523,7 @@ void RenderTargetCache::InitializeCommon() {
 }
 
 void RenderTargetCache::DestroyAllRenderTargets(bool shutting_down) {
+  known_resolve_clears_.clear();
   ownership_ranges_.clear();
   if (!shutting_down) {
     ownership_ranges_.emplace(
@@ -569,7 +580,15 @@ void RenderTargetCache::ClearCache() {
   }
 }
 
-void RenderTargetCache::BeginFrame() { ResetAccumulatedRenderTargets(); }
+void RenderTargetCache::BeginFrame() {
+  COUNT_profile_set("gpu/render_target_cache/transfers_per_frame",
+                    transfers_in_frame_);
+  COUNT_profile_set("gpu/render_target_cache/transfer_pixels_per_frame",
+                    transfer_pixels_in_frame_);
+  transfers_in_frame_ = 0;
+  transfer_pixels_in_frame_ = 0;
+  ResetAccumulatedRenderTargets();
+}
 
 bool RenderTargetCache::Update(bool is_rasterization_done,
                                reg::RB_DEPTHCONTROL normalized_depth_control,
@@ -889,6 +908,8 @@ bool RenderTargetCache::Update(bool is_rasterization_done,
                     interlock_barrier_only
                         ? nullptr
                         : &last_update_transfers_[rt_bit_index]);
+    InvalidateKnownResolveClears(rt_base_index.first,
+                                 rt_base_index.first + rt_lengths_tiles[i]);
   }
 
   if (interlock_barrier_only) {
@@ -1166,6 +1187,40 @@ bool RenderTargetCache::PrepareHostRenderTargetsResolveClear(
     std::vector<Transfer>& color_transfers_out) {
   assert_true(GetPath() == Path::kHostRenderTargets);
 
+  // Skip the clear if it has already been done with nothing drawn since then.
+  // Depth and color clears in one resolve are trimmed not to overlap each
+  // other, so only dropping them both, not one of them.
+  draw_util::ResolveClearShaderConstants depth_clear_constants;
+  uint32_t depth_clear_known_start_tiles = 0, depth_clear_known_end_tiles = 0;
+  bool depth_clear_known = true;
+  if (resolve_info.IsClearingDepth()) {
+    resolve_info.GetDepthClearShaderConstants(depth_clear_constants);
+    depth_clear_known =
+        GetResolveClearTileRange(resolve_info, depth_clear_constants,
+                                 depth_clear_known_start_tiles,
+                                 depth_clear_known_end_tiles) &&
+        IsResolveClearKnown(depth_clear_known_start_tiles,
+                            depth_clear_known_end_tiles,
+                            depth_clear_constants);
+  }
+  draw_util::ResolveClearShaderConstants color_clear_constants;
+  uint32_t color_clear_known_start_tiles = 0, color_clear_known_end_tiles = 0;
+  bool color_clear_known = true;
+  if (resolve_info.IsClearingColor()) {
+    resolve_info.GetColorClearShaderConstants(color_clear_constants);
+    color_clear_known =
+        GetResolveClearTileRange(resolve_info, color_clear_constants,
+                                 color_clear_known_start_tiles,
+                                 color_clear_known_end_tiles) &&
+        IsResolveClearKnown(color_clear_known_start_tiles,
+                            color_clear_known_end_tiles,
+                            color_clear_constants);
+  }
+  if (depth_clear_known && color_clear_known &&
+      (resolve_info.IsClearingDepth() || resolve_info.IsClearingColor())) {
+    return false;
+  }
+
   uint32_t pitch_tiles_at_32bpp;
   uint32_t base_offset_tiles_at_32bpp;
   xenos::MsaaSamples msaa_samples;
@@ -1361,6 +1416,8 @@ bool RenderTargetCache::PrepareHostRenderTargetsResolveClear(
     ChangeOwnership(
         depth_render_target_key, depth_clear_start_tiles_base_relative,
         depth_clear_length_tiles, &depth_transfers_out, &clear_rectangle);
+    AddKnownResolveClear(depth_clear_known_start_tiles,
+                         depth_clear_known_end_tiles, depth_clear_constants);
   }
   color_render_target_out = color_render_target;
   color_transfers_out.clear();
@@ -1368,6 +1425,8 @@ bool RenderTargetCache::PrepareHostRenderTargetsResolveClear(
     ChangeOwnership(
         color_render_target_key, color_clear_start_tiles_base_relative,
         color_clear_length_tiles, &color_transfers_out, &clear_rectangle);
+    AddKnownResolveClear(color_clear_known_start_tiles,
+                         color_clear_known_end_tiles, color_clear_constants);
   }
   return true;
 }
@@ -1408,6 +1467,7 @@ RenderTargetCache::PrepareFullEdram1280xRenderTargetForSnapshotRestoration(
   }
   // Change ownership, but don't transfer the contents - they will be replaced
   // anyway.
+  known_resolve_clears_.clear();
   ownership_ranges_.clear();
   ownership_ranges_.emplace(
       std::piecewise_construct, std::forward_as_tuple(uint32_t(0)),
@@ -1436,6 +1496,101 @@ void RenderTargetCache::PixelShaderInterlockFullEdramBarrierPlaced() {
   ownership_ranges_.emplace(0, empty_range);
 }
 
+bool RenderTargetCache::PrepareInterlockResolveClear(
+    const draw_util::ResolveInfo& resolve_info,
+    const draw_util::ResolveClearShaderConstants& clear_constants) {
+  assert_true(GetPath() == Path::kPixelShaderInterlock);
+  uint32_t start_tiles, end_tiles;
+  if (!GetResolveClearTileRange(resolve_info, clear_constants, start_tiles,
+                                end_tiles)) {
+    return false;
+  }
+  if (IsResolveClearKnown(start_tiles, end_tiles, clear_constants)) {
+    return false;
+  }
+  AddKnownResolveClear(start_tiles, end_tiles, clear_constants);
+  return true;
+}
+
+bool RenderTargetCache::GetResolveClearTileRange(
+    const draw_util::ResolveInfo& resolve_info,
+    const draw_util::ResolveClearShaderConstants& clear_constants,
+    uint32_t& start_tiles_out, uint32_t& end_tiles_out) {
+  uint32_t row_length_used_tiles, rows;
+  draw_util::GetResolveEdramTileSpan(
+      clear_constants.rt_specific.edram_info, clear_constants.coordinate_info,
+      resolve_info.height_div_8, start_tiles_out, row_length_used_tiles, rows);
+  if (!row_length_used_tiles || !rows) {
+    end_tiles_out = start_tiles_out;
+    return false;
+  }
+  end_tiles_out =
+      start_tiles_out +
+      (rows - 1) * clear_constants.rt_specific.edram_info.pitch_tiles +
+      row_length_used_tiles;
+  return true;
+}
+
+bool RenderTargetCache::IsResolveClearKnown(
+    uint32_t start_tiles, uint32_t end_tiles,
+    const draw_util::ResolveClearShaderConstants& clear_constants) const {
+  if (!cvars::skip_redundant_resolve_clears) {
+    return false;
+  }
+  for (const KnownResolveClear& clear : known_resolve_clears_) {
+    if (clear.start_tiles == start_tiles && clear.end_tiles == end_tiles &&
+        !std::memcmp(&clear.constants, &clear_constants,
+                     sizeof(clear_constants))) {
+      // Nothing has been written to the tiles since the same clear.
+      return true;
+    }
+  }
+  return false;
+}
+
+void RenderTargetCache::AddKnownResolveClear(
+    uint32_t start_tiles, uint32_t end_tiles,
+    const draw_util::ResolveClearShaderConstants& clear_constants) {
+  InvalidateKnownResolveClears(start_tiles, end_tiles);
+  if (!cvars::skip_redundant_resolve_clears) {
+    return;
+  }
+  if (known_resolve_clears_.size() >= kMaxKnownResolveClears) {
+    known_resolve_clears_.erase(known_resolve_clears_.begin());
+  }
+  KnownResolveClear& new_clear = known_resolve_clears_.emplace_back();
+  new_clear.start_tiles = start_tiles;
+  new_clear.end_tiles = end_tiles;
+  new_clear.constants = clear_constants;
+}
+
+void RenderTargetCache::InvalidateKnownResolveClears(uint32_t start_tiles,
+                                                         uint32_t end_tiles) {
+  if (known_resolve_clears_.empty() || start_tiles >= end_tiles) {
+    return;
+  }
+  // Both ranges may exceed the EDRAM size because of addressing wrapping.
+  auto ranges_overlap = [](uint32_t a_start, uint32_t a_end, uint32_t b_start,
+                           uint32_t b_end) {
+    return a_start < b_end && b_start < a_end;
+  };
+  for (auto it = known_resolve_clears_.begin();
+       it != known_resolve_clears_.end();) {
+    if (ranges_overlap(start_tiles, end_tiles, it->start_tiles,
+                       it->end_tiles) ||
+        ranges_overlap(start_tiles + xenos::kEdramTileCount,
+                       end_tiles + xenos::kEdramTileCount, it->start_tiles,
+                       it->end_tiles) ||
+        ranges_overlap(start_tiles, end_tiles,
+                       it->start_tiles + xenos::kEdramTileCount,
+                       it->end_tiles + xenos::kEdramTileCount)) {
+      it = known_resolve_clears_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+}
+
 RenderTargetCache::RenderTarget* RenderTargetCache::GetOrCreateRenderTarget(
     RenderTargetKey key) {
   assert_true(GetPath() == Path::kHostRenderTargets);
@@ -1612,6 +1767,12 @@ void RenderTargetCache::ChangeOwnership(
               // Same render target, don't provide a separate host depth source.
               transfer_host_depth_source = RenderTargetKey();
             }
+            // Not excluding the resolve clear cutout, only an estimate.
+            transfer_pixels_in_frame_ +=
+                uint64_t(transfer_end_tiles - it->first) *
+                    (xenos::kEdramTileWidthSamples *
+                     xenos::kEdramTileHeightSamples) >>
+                (uint32_t(dest_is_64bpp) + uint32_t(dest.msaa_samples));
             if (!transfers_append_out->empty() &&
                 transfers_append_out->back().end_tiles == it->first &&
                 transfers_append_out->back().source->key() == transfer_source &&
@@ -1637,6 +1798,7 @@ void RenderTargetCache::ChangeOwnership(
                   assert_false(transfer_host_depth_source_rt_it !=
                                    render_targets_.end() &&
                                !transfer_host_depth_source_rt_it->second);
+                  ++transfers_in_frame_;
                   transfers_append_out->emplace_back(
                       it->first, transfer_end_tiles,
                       transfer_source_rt_it->second,
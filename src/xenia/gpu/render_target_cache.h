@@ -237,6 +237,9 @@ class RenderTargetCache {
   }
 
   const RegisterFile& register_file() const { return register_file_; }
+  const DrawExtentEstimator& draw_extent_estimator() const {
+    return draw_extent_estimator_;
+  }
 
   // Call last in implementation-specific initialization (when things like path
   // are initialized by the implementation).
@@ -587,7 +590,7 @@ class RenderTargetCache {
   // Sets up the needed render targets and transfers to perform a clear in a
   // resolve operation via a host render target clear. resolve_info is expected
   // to be obtained via draw_util::GetResolveInfo. Returns whether any clears
-  // need to be done (false in both empty and error cases).
+  // need to be done (false in empty, redundant and error cases).
   // TODO(Triang3l): Try to defer clears until the first draw in the next pass
   // (if it uses one or both render targets being cleared) for tile-based GPUs.
   bool PrepareHostRenderTargetsResolveClear(
@@ -616,6 +619,20 @@ class RenderTargetCache {
   // EDRAM memory are committed with a memory barrier.
   void PixelShaderInterlockFullEdramBarrierPlaced();
 
+  // Returns whether the resolve clear with the specified constants (for depth
+  // or for color) needs to be performed, and if it does, records it as the
+  // latest clear of its tiles. The clear is skipped if it's redundant - if the
+  // same clear has already been done, and no draws have touched the tiles
+  // since then.
+  bool PrepareInterlockResolveClear(
+      const draw_util::ResolveInfo& resolve_info,
+      const draw_util::ResolveClearShaderConstants& clear_constants);
+  // To be called by the implementation when the EDRAM contents in the range
+  // are modified not by draws or resolve clears (such as when restoring an
+  // EDRAM snapshot). The end may exceed the EDRAM size due to addressing
+  // wrapping.
+  void InvalidateKnownResolveClears(uint32_t start_tiles, uint32_t end_tiles);
+
  private:
   const RegisterFile& register_file_;
   uint32_t draw_resolution_scale_x_;
@@ -769,6 +786,32 @@ class RenderTargetCache {
   // consecutive in the array.
   std::vector<Transfer>
       last_update_transfers_[1 + xenos::kMaxColorRenderTargets];
+
+  // Ownership transfer statistics for the current frame, reported to the
+  // profiler in BeginFrame.
+  uint32_t transfers_in_frame_ = 0;
+  uint64_t transfer_pixels_in_frame_ = 0;
+
+  // Resolve clears not followed by draws to their tiles, for skipping redundant
+  // clears (skip_redundant_resolve_clears).
+  // Returns false if the clear covers no tiles.
+  static bool GetResolveClearTileRange(
+      const draw_util::ResolveInfo& resolve_info,
+      const draw_util::ResolveClearShaderConstants& clear_constants,
+      uint32_t& start_tiles_out, uint32_t& end_tiles_out);
+  bool IsResolveClearKnown(
+      uint32_t start_tiles, uint32_t end_tiles,
+      const draw_util::ResolveClearShaderConstants& clear_constants) const;
+  void AddKnownResolveClear(
+      uint32_t start_tiles, uint32_t end_tiles,
+      const draw_util::ResolveClearShaderConstants& clear_constants);
+  struct KnownResolveClear {
+    uint32_t start_tiles;
+    uint32_t end_tiles;
+    draw_util::ResolveClearShaderConstants constants;
+  };
+  static constexpr size_t kMaxKnownResolveClears = 8;
+  std::vector<KnownResolveClear> known_resolve_clears_;
 };
 
 }  // namespace gpu
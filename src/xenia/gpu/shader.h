@@ -802,6 +802,11 @@ class Shader {
     const std::vector<uint8_t>& translated_binary() const {
       return translated_binary_;
     }
+    // For replacing the translated binary with the result of post-processing
+    // done by the implementation, such as optimization.
+    void set_translated_binary(std::vector<uint8_t> translated_binary) {
+      translated_binary_ = std::move(translated_binary);
+    }
 
     // Gets the translated shader binary as a string.
     // This is only valid if it is actually text.
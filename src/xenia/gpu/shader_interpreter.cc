@@ -12,13 +12,270 @@
 #include <cfloat>
 #include <cmath>
 #include <cstring>
+#include <iterator>
+
+#include "xenia/base/assert.h"
 
 namespace xe {
 namespace gpu {
 
-void ShaderInterpreter::Execute() {
+void ShaderInterpreter::GetInstructionsSkippableForExports(
+    const Shader& shader, uint64_t needed_exports,
+    std::vector<uint64_t>& skippable_out) {
+  assert_true(shader.is_ucode_analyzed());
+  const uint32_t* ucode = shader.ucode_dwords();
+  uint32_t instruction_count = uint32_t(shader.ucode_dword_count() / 3);
+  skippable_out.clear();
+  skippable_out.resize((instruction_count + 63) >> 6, ~UINT64_C(0));
+
+  // Gather the instructions that may be executed.
+  struct InstructionUsage {
+    uint32_t index;
+    bool is_fetch;
+    // For ALU instructions, whether the vector and the scalar operations must
+    // be executed. For fetch instructions, the first one is used.
+    bool vector_needed;
+    bool scalar_needed;
+  };
+  std::vector<InstructionUsage> instructions;
+  for (uint32_t cf_index = 0; cf_index < 2 * shader.cf_pair_index_bound();
+       ++cf_index) {
+    ucode::ControlFlowInstruction cf_instr =
+        GetControlFlowInstruction(ucode, cf_index);
+    if (!ucode::IsControlFlowOpcodeExec(cf_instr.opcode())) {
+      continue;
+    }
+    const ucode::ControlFlowExecInstruction& cf_exec =
+        *reinterpret_cast<const ucode::ControlFlowExecInstruction*>(&cf_instr);
+    for (uint32_t exec_index = 0; exec_index < cf_exec.count();
+         ++exec_index) {
+      uint32_t instruction_index = cf_exec.address() + exec_index;
+      if (instruction_index >= instruction_count) {
+        break;
+      }
+      InstructionUsage& instruction = instructions.emplace_back();
+      instruction.index = instruction_index;
+      instruction.is_fetch =
+          ((cf_exec.sequence() >> (exec_index << 1)) & 0b01) != 0;
+      instruction.vector_needed = false;
+      instruction.scalar_needed = false;
+    }
+  }
+
+  // Conservatively, without considering the order of the instructions (which is
+  // also hard to do because of loops and jumps), propagate the need for the
+  // results from the needed exports to the instructions writing the registers
+  // they read, until nothing changes.
+  uint64_t needed_temps[xenos::kMaxShaderTempRegisters / 64] = {};
+  bool any_temp_needed = false;
+  auto mark_temp_needed = [&](uint32_t temp, bool is_relative) {
+    if (is_relative) {
+      std::fill(std::begin(needed_temps), std::end(needed_temps),
+                ~UINT64_C(0));
+    } else {
+      temp &= xenos::kMaxShaderTempRegisters - 1;
+      needed_temps[temp >> 6] |= UINT64_C(1) << (temp & 63);
+    }
+    any_temp_needed = true;
+  };
+  auto is_temp_needed = [&](uint32_t temp, bool is_relative) -> bool {
+    if (is_relative) {
+      return any_temp_needed;
+    }
+    temp &= xenos::kMaxShaderTempRegisters - 1;
+    return (needed_temps[temp >> 6] & (UINT64_C(1) << (temp & 63))) != 0;
+  };
+  // Full vertex fetches provide the fetch constant and the address for the
+  // subsequent mini fetches.
+  bool full_vertex_fetches_needed = false;
+  bool previous_scalar_needed = false;
+  bool any_changed;
+  do {
+    any_changed = false;
+    for (InstructionUsage& instruction : instructions) {
+      const uint32_t* instruction_ucode = &ucode[3 * instruction.index];
+      if (instruction.is_fetch) {
+        if (instruction.vector_needed) {
+          continue;
+        }
+        const ucode::FetchInstruction& fetch_instr =
+            *reinterpret_cast<const ucode::FetchInstruction*>(
+                instruction_ucode);
+        bool is_vertex_fetch =
+            fetch_instr.opcode() == ucode::FetchOpcode::kVertexFetch;
+        bool is_full_vertex_fetch =
+            is_vertex_fetch && !fetch_instr.vertex_fetch().is_mini_fetch();
+        if (!is_temp_needed(fetch_instr.dest(),
+                            fetch_instr.is_dest_relative()) &&
+            !(is_full_vertex_fetch && full_vertex_fetches_needed)) {
+          continue;
+        }
+        instruction.vector_needed = true;
+        any_changed = true;
+        if (is_full_vertex_fetch) {
+          mark_temp_needed(fetch_instr.src(), fetch_instr.is_src_relative());
+        } else if (is_vertex_fetch) {
+          full_vertex_fetches_needed = true;
+        }
+        continue;
+      }
+
+      const ucode::AluInstruction& alu_instr =
+          *reinterpret_cast<const ucode::AluInstruction*>(instruction_ucode);
+
+      if (!instruction.vector_needed) {
+        const ucode::AluVectorOpcodeInfo& vector_opcode_info =
+            ucode::GetAluVectorOpcodeInfo(alu_instr.vector_opcode());
+        uint32_t vector_result_write_mask =
+            alu_instr.GetVectorOpResultWriteMask();
+        // Exports are done even with only constant components written, and
+        // the vector operation is executed only if it writes anything or
+        // changes the state.
+        if (vector_opcode_info.changed_state ||
+            (alu_instr.is_export()
+                 ? ((needed_exports >> alu_instr.vector_dest()) & 1) != 0
+                 : (vector_result_write_mask &&
+                    is_temp_needed(alu_instr.vector_dest(),
+                                   alu_instr.is_vector_dest_relative())))) {
+          instruction.vector_needed = true;
+          any_changed = true;
+          for (uint32_t i = 0; i < 3; ++i) {
+            if ((!vector_result_write_mask &&
+                 !vector_opcode_info.changed_state) ||
+                !vector_opcode_info.operand_components_used[i] ||
+                !alu_instr.src_is_temp(1 + i)) {
+              continue;
+            }
+            uint32_t vector_src_register = alu_instr.src_reg(1 + i);
+            mark_temp_needed(
+                ucode::AluInstruction::src_temp_reg(vector_src_register),
+                ucode::AluInstruction::is_src_temp_relative(
+                    vector_src_register));
+          }
+        }
+      }
+
+      if (!instruction.scalar_needed) {
+        ucode::AluScalarOpcode scalar_opcode = alu_instr.scalar_opcode();
+        const ucode::AluScalarOpcodeInfo& scalar_opcode_info =
+            ucode::GetAluScalarOpcodeInfo(scalar_opcode);
+        uint32_t scalar_result_write_mask =
+            alu_instr.GetScalarOpResultWriteMask();
+        // In exports, both operations write to the vector destination.
+        if (scalar_opcode_info.changed_state ||
+            (previous_scalar_needed &&
+             scalar_opcode != ucode::AluScalarOpcode::kRetainPrev) ||
+            (scalar_result_write_mask &&
+             (alu_instr.is_export()
+                  ? ((needed_exports >> alu_instr.vector_dest()) & 1) != 0
+                  : is_temp_needed(alu_instr.scalar_dest(),
+                                   alu_instr.is_scalar_dest_relative())))) {
+          instruction.scalar_needed = true;
+          any_changed = true;
+          switch (scalar_opcode_info.operand_count) {
+            case 1:
+              if (alu_instr.src_is_temp(3)) {
+                uint32_t scalar_src_register = alu_instr.src_reg(3);
+                mark_temp_needed(
+                    ucode::AluInstruction::src_temp_reg(scalar_src_register),
+                    ucode::AluInstruction::is_src_temp_relative(
+                        scalar_src_register));
+              }
+              break;
+            case 2:
+              mark_temp_needed(alu_instr.scalar_const_reg_op_src_temp_reg(),
+                               false);
+              break;
+          }
+          switch (scalar_opcode) {
+            case ucode::AluScalarOpcode::kAddsPrev:
+            case ucode::AluScalarOpcode::kMulsPrev:
+            case ucode::AluScalarOpcode::kMulsPrev2:
+            case ucode::AluScalarOpcode::kSubsPrev:
+            case ucode::AluScalarOpcode::kRetainPrev:
+              previous_scalar_needed = true;
+              break;
+            default:
+              break;
+          }
+        }
+      }
+    }
+  } while (any_changed);
+
+  for (const InstructionUsage& instruction : instructions) {
+    if (instruction.vector_needed || instruction.scalar_needed) {
+      skippable_out[instruction.index >> 6] &=
+          ~(UINT64_C(1) << (instruction.index & 63));
+    }
+  }
+}
+
+bool ShaderInterpreter::HasPredicatedControlFlow(const Shader& shader) {
+  assert_true(shader.is_ucode_analyzed());
+  const uint32_t* ucode = shader.ucode_dwords();
+  for (uint32_t cf_index = 0; cf_index < 2 * shader.cf_pair_index_bound();
+       ++cf_index) {
+    ucode::ControlFlowInstruction cf_instr =
+        GetControlFlowInstruction(ucode, cf_index);
+    switch (cf_instr.opcode()) {
+      case ucode::ControlFlowOpcode::kCondExecPredEnd:
+        // Whether the shader is ended depends on the predicate.
+        return true;
+      case ucode::ControlFlowOpcode::kLoopEnd:
+        if (reinterpret_cast<const ucode::ControlFlowLoopEndInstruction*>(
+                &cf_instr)
+                ->is_predicated_break()) {
+          return true;
+        }
+        break;
+      case ucode::ControlFlowOpcode::kCondCall: {
+        const ucode::ControlFlowCondCallInstruction& cf_cond_call =
+            *reinterpret_cast<const ucode::ControlFlowCondCallInstruction*>(
+                &cf_instr);
+        if (!cf_cond_call.is_unconditional() && cf_cond_call.is_predicated()) {
+          return true;
+        }
+      } break;
+      case ucode::ControlFlowOpcode::kCondJmp: {
+        const ucode::ControlFlowCondJmpInstruction& cf_cond_jmp =
+            *reinterpret_cast<const ucode::ControlFlowCondJmpInstruction*>(
+                &cf_instr);
+        if (!cf_cond_jmp.is_unconditional() && cf_cond_jmp.is_predicated()) {
+          return true;
+        }
+      } break;
+      default:
+        break;
+    }
+  }
+  return false;
+}
+
+void ShaderInterpreter::Execute(uint32_t invocation_count) {
+  assert_true(invocation_count <= kMaxInvocations);
+  invocation_count = std::min(invocation_count, kMaxInvocations);
+  if (has_predicated_control_flow_) {
+    for (uint32_t i = 0; i < invocation_count; ++i) {
+      ExecuteInvocations(i, 1);
+    }
+  } else if (invocation_count) {
+    ExecuteInvocations(0, invocation_count);
+  }
+}
+
+void ShaderInterpreter::ExecuteInvocations(uint32_t first_invocation,
+                                           uint32_t invocation_count) {
+  uint32_t invocation_end = first_invocation + invocation_count;
+
   // For more consistency between invocations in case of a malformed shader.
   state_.Reset();
+  for (uint32_t i = first_invocation; i < invocation_end; ++i) {
+    invocation_states_[i].Reset();
+  }
+  // For the control flow, which is uniform, so the predicate of any
+  // invocation can be checked.
+  const bool& predicate = invocation_states_[first_invocation].predicate;
 
   const uint32_t* bool_constants =
       &register_file_[XE_GPU_REG_SHADER_CONSTANT_BOOL_000_031];
@@ -28,15 +285,8 @@ void ShaderInterpreter::Execute() {
   for (uint32_t cf_index = 0; !exec_ended; cf_index = cf_index_next) {
     cf_index_next = cf_index + 1;
 
-    const uint32_t* cf_pair = &ucode_[3 * (cf_index >> 1)];
-    ucode::ControlFlowInstruction cf_instr;
-    if (cf_index & 1) {
-      cf_instr.dword_0 = (cf_pair[1] >> 16) | (cf_pair[2] << 16);
-      cf_instr.dword_1 = cf_pair[2] >> 16;
-    } else {
-      cf_instr.dword_0 = cf_pair[0];
-      cf_instr.dword_1 = cf_pair[1] & 0xFFFF;
-    }
+    ucode::ControlFlowInstruction cf_instr =
+        GetControlFlowInstruction(ucode_, cf_index);
 
     ucode::ControlFlowOpcode cf_opcode = cf_instr.opcode();
     switch (cf_opcode) {
@@ -55,6 +305,8 @@ void ShaderInterpreter::Execute() {
             *reinterpret_cast<const ucode::ControlFlowExecInstruction*>(
                 &cf_instr);
 
+        uint32_t exec_invocations = ((UINT32_C(1) << invocation_count) - 1)
+                                    << first_invocation;
         switch (cf_opcode) {
           case ucode::ControlFlowOpcode::kCondExec:
           case ucode::ControlFlowOpcode::kCondExecEnd:
@@ -75,7 +327,13 @@ void ShaderInterpreter::Execute() {
             const ucode::ControlFlowCondExecPredInstruction cf_cond_exec_pred =
                 *reinterpret_cast<
                     const ucode::ControlFlowCondExecPredInstruction*>(&cf_exec);
-            if (cf_cond_exec_pred.condition() != state_.predicate) {
+            for (uint32_t i = first_invocation; i < invocation_end; ++i) {
+              if (cf_cond_exec_pred.condition() !=
+                  invocation_states_[i].predicate) {
+                exec_invocations &= ~(UINT32_C(1) << i);
+              }
+            }
+            if (!exec_invocations) {
               continue;
             }
           } break;
@@ -85,34 +343,48 @@ void ShaderInterpreter::Execute() {
 
         for (uint32_t exec_index = 0; exec_index < cf_exec.count();
              ++exec_index) {
+          uint32_t exec_instruction_index = cf_exec.address() + exec_index;
+          if (IsInstructionSkipped(exec_instruction_index)) {
+            continue;
+          }
           const uint32_t* exec_instruction =
-              &ucode_[3 * (cf_exec.address() + exec_index)];
+              &ucode_[3 * exec_instruction_index];
           if ((cf_exec.sequence() >> (exec_index << 1)) & 0b01) {
             const ucode::FetchInstruction& fetch_instr =
                 *reinterpret_cast<const ucode::FetchInstruction*>(
                     exec_instruction);
-            if (fetch_instr.is_predicated() &&
-                fetch_instr.predicate_condition() != state_.predicate) {
-              continue;
-            }
-            if (fetch_instr.opcode() == ucode::FetchOpcode::kVertexFetch) {
-              ExecuteVertexFetchInstruction(fetch_instr.vertex_fetch());
-            } else {
-              // Not supporting texture fetching (very complex).
-              float zero_result[4] = {};
-              StoreFetchResult(fetch_instr.dest(),
-                               fetch_instr.is_dest_relative(),
-                               fetch_instr.dest_swizzle(), zero_result);
+            for (invocation_ = first_invocation; invocation_ < invocation_end;
+                 ++invocation_) {
+              if (!(exec_invocations & (UINT32_C(1) << invocation_)) ||
+                  (fetch_instr.is_predicated() &&
+                   fetch_instr.predicate_condition() !=
+                       invocation_states_[invocation_].predicate)) {
+                continue;
+              }
+              if (fetch_instr.opcode() == ucode::FetchOpcode::kVertexFetch) {
+                ExecuteVertexFetchInstruction(fetch_instr.vertex_fetch());
+              } else {
+                // Not supporting texture fetching (very complex).
+                float zero_result[4] = {};
+                StoreFetchResult(fetch_instr.dest(),
+                                 fetch_instr.is_dest_relative(),
+                                 fetch_instr.dest_swizzle(), zero_result);
+              }
             }
           } else {
             const ucode::AluInstruction& alu_instr =
                 *reinterpret_cast<const ucode::AluInstruction*>(
                     exec_instruction);
-            if (alu_instr.is_predicated() &&
-                alu_instr.predicate_condition() != state_.predicate) {
-              continue;
+            for (invocation_ = first_invocation; invocation_ < invocation_end;
+                 ++invocation_) {
+              if (!(exec_invocations & (UINT32_C(1) << invocation_)) ||
+                  (alu_instr.is_predicated() &&
+                   alu_instr.predicate_condition() !=
+                       invocation_states_[invocation_].predicate)) {
+                continue;
+              }
+              ExecuteAluInstruction(alu_instr);
             }
-            ExecuteAluInstruction(alu_instr);
           }
         }
 
@@ -169,7 +441,7 @@ void ShaderInterpreter::Execute() {
             ++state_.loop_iterators[state_.loop_stack_depth - 1];
         if (loop_iterator < loop_constant.count &&
             (!cf_loop_end.is_predicated_break() ||
-             cf_loop_end.condition() != state_.predicate)) {
+             cf_loop_end.condition() != predicate)) {
           cf_index_next = cf_loop_end.address();
           continue;
         }
@@ -186,7 +458,7 @@ void ShaderInterpreter::Execute() {
                 &cf_instr);
         if (!cf_cond_call.is_unconditional()) {
           if (cf_cond_call.is_predicated()) {
-            if (cf_cond_call.condition() != state_.predicate) {
+            if (cf_cond_call.condition() != predicate) {
               continue;
             }
           } else {
@@ -217,7 +489,7 @@ void ShaderInterpreter::Execute() {
                 &cf_instr);
         if (!cf_cond_jmp.is_unconditional()) {
           if (cf_cond_jmp.is_predicated()) {
-            if (cf_cond_jmp.condition() != state_.predicate) {
+            if (cf_cond_jmp.condition() != predicate) {
               continue;
             }
           } else {
@@ -252,9 +524,10 @@ void ShaderInterpreter::Execute() {
 
 const std::array<float, 4> ShaderInterpreter::GetFloatConstant(
     uint32_t address, bool is_relative, bool relative_address_is_a0) const {
+  const InvocationState& state = invocation_states_[invocation_];
   int32_t index = int32_t(address);
   if (is_relative) {
-    index += relative_address_is_a0 ? state_.address_register
+    index += relative_address_is_a0 ? state.address_register
                                     : state_.GetLoopAddress();
   }
   if (index < 0) {
@@ -278,6 +551,8 @@ const std::array<float, 4> ShaderInterpreter::GetFloatConstant(
 }
 
 void ShaderInterpreter::ExecuteAluInstruction(ucode::AluInstruction instr) {
+  InvocationState& state = invocation_states_[invocation_];
+
   // Vector operation.
   float vector_result[4] = {};
   ucode::AluVectorOpcode vector_opcode = instr.vector_opcode();
@@ -512,7 +787,7 @@ void ShaderInterpreter::ExecuteAluInstruction(ucode::AluInstruction instr) {
         replicate_vector_result_x = true;
       } break;
       case ucode::AluVectorOpcode::kSetpEqPush: {
-        state_.predicate =
+        state.predicate =
             vector_operands[0][3] == 0.0f && vector_operands[1][3] == 0.0f;
         vector_result[0] =
             (vector_operands[0][0] == 0.0f && vector_operands[1][0] == 0.0f)
@@ -521,7 +796,7 @@ void ShaderInterpreter::ExecuteAluInstruction(ucode::AluInstruction instr) {
         replicate_vector_result_x = true;
       } break;
       case ucode::AluVectorOpcode::kSetpNePush: {
-        state_.predicate =
+        state.predicate =
             vector_operands[0][3] == 0.0f && vector_operands[1][3] != 0.0f;
         vector_result[0] =
             (vector_operands[0][0] == 0.0f && vector_operands[1][0] != 0.0f)
@@ -530,8 +805,8 @@ void ShaderInterpreter::ExecuteAluInstruction(ucode::AluInstruction instr) {
         replicate_vector_result_x = true;
       } break;
       case ucode::AluVectorOpcode::kSetpGtPush: {
-        state_.predicate = vector_operands[0][3] == 0.0f &&
-                           std::isgreater(vector_operands[1][3], 0.0f);
+        state.predicate = vector_operands[0][3] == 0.0f &&
+                          std::isgreater(vector_operands[1][3], 0.0f);
         vector_result[0] = (vector_operands[0][0] == 0.0f &&
                             std::isgreater(vector_operands[1][0], 0.0f))
                                ? 0.0f
@@ -539,8 +814,8 @@ void ShaderInterpreter::ExecuteAluInstruction(ucode::AluInstruction instr) {
         replicate_vector_result_x = true;
       } break;
       case ucode::AluVectorOpcode::kSetpGePush: {
-        state_.predicate = vector_operands[0][3] == 0.0f &&
-                           std::isgreaterequal(vector_operands[1][3], 0.0f);
+        state.predicate = vector_operands[0][3] == 0.0f &&
+                          std::isgreaterequal(vector_operands[1][3], 0.0f);
         vector_result[0] = (vector_operands[0][0] == 0.0f &&
                             std::isgreaterequal(vector_operands[1][0], 0.0f))
                                ? 0.0f
@@ -591,7 +866,7 @@ void ShaderInterpreter::ExecuteAluInstruction(ucode::AluInstruction instr) {
         vector_result[3] = vector_operands[1][3];
       } break;
       case ucode::AluVectorOpcode::kMaxA: {
-        state_.address_register = int32_t(std::floor(
+        state.address_register = int32_t(std::floor(
             xe::clamp_float(vector_operands[0][3], -256.0f, 255.0f) + 0.5f));
         for (uint32_t i = 0; i < 4; ++i) {
           vector_result[i] =
@@ -680,136 +955,136 @@ void ShaderInterpreter::ExecuteAluInstruction(ucode::AluInstruction instr) {
     case ucode::AluScalarOpcode::kAdds:
     case ucode::AluScalarOpcode::kAddsc0:
     case ucode::AluScalarOpcode::kAddsc1: {
-      state_.previous_scalar = scalar_operands[0] + scalar_operands[1];
+      state.previous_scalar = scalar_operands[0] + scalar_operands[1];
     } break;
     case ucode::AluScalarOpcode::kAddsPrev: {
-      state_.previous_scalar = scalar_operands[0] + state_.previous_scalar;
+      state.previous_scalar = scalar_operands[0] + state.previous_scalar;
     } break;
     case ucode::AluScalarOpcode::kMuls:
     case ucode::AluScalarOpcode::kMulsc0:
     case ucode::AluScalarOpcode::kMulsc1: {
       // Direct3D 9 behavior (0 or denormal * anything = +0).
-      state_.previous_scalar = (scalar_operands[0] && scalar_operands[1])
-                                   ? scalar_operands[0] * scalar_operands[1]
-                                   : 0.0f;
+      state.previous_scalar = (scalar_operands[0] && scalar_operands[1])
+                                  ? scalar_operands[0] * scalar_operands[1]
+                                  : 0.0f;
     } break;
     case ucode::AluScalarOpcode::kMulsPrev: {
       // Direct3D 9 behavior (0 or denormal * anything = +0).
-      state_.previous_scalar = (scalar_operands[0] && state_.previous_scalar)
-                                   ? scalar_operands[0] * state_.previous_scalar
-                                   : 0.0f;
+      state.previous_scalar = (scalar_operands[0] && state.previous_scalar)
+                                  ? scalar_operands[0] * state.previous_scalar
+                                  : 0.0f;
     } break;
     case ucode::AluScalarOpcode::kMulsPrev2: {
-      if (state_.previous_scalar == -FLT_MAX ||
-          !std::isfinite(state_.previous_scalar) ||
+      if (state.previous_scalar == -FLT_MAX ||
+          !std::isfinite(state.previous_scalar) ||
           !std::isfinite(scalar_operands[1]) ||
           std::islessequal(scalar_operands[1], 0.0f)) {
-        state_.previous_scalar = -FLT_MAX;
+        state.previous_scalar = -FLT_MAX;
       } else {
         // Direct3D 9 behavior (0 or denormal * anything = +0).
-        state_.previous_scalar =
-            (scalar_operands[0] && state_.previous_scalar)
-                ? scalar_operands[0] * state_.previous_scalar
+        state.previous_scalar =
+            (scalar_operands[0] && state.previous_scalar)
+                ? scalar_operands[0] * state.previous_scalar
                 : 0.0f;
       }
     } break;
     case ucode::AluScalarOpcode::kMaxs: {
-      state_.previous_scalar =
+      state.previous_scalar =
           std::isgreaterequal(scalar_operands[0], scalar_operands[1])
               ? scalar_operands[0]
               : scalar_operands[1];
     } break;
     case ucode::AluScalarOpcode::kMins: {
-      state_.previous_scalar =
+      state.previous_scalar =
           std::isless(scalar_operands[0], scalar_operands[1])
               ? scalar_operands[0]
               : scalar_operands[1];
     } break;
     case ucode::AluScalarOpcode::kSeqs: {
-      state_.previous_scalar = float(scalar_operands[0] == 0.0f);
+      state.previous_scalar = float(scalar_operands[0] == 0.0f);
     } break;
     case ucode::AluScalarOpcode::kSgts: {
-      state_.previous_scalar = float(std::isgreater(scalar_operands[0], 0.0f));
+      state.previous_scalar = float(std::isgreater(scalar_operands[0], 0.0f));
     } break;
     case ucode::AluScalarOpcode::kSges: {
-      state_.previous_scalar =
+      state.previous_scalar =
           float(std::isgreaterequal(scalar_operands[0], 0.0f));
     } break;
     case ucode::AluScalarOpcode::kSnes: {
-      state_.previous_scalar = float(scalar_operands[0] != 0.0f);
+      state.previous_scalar = float(scalar_operands[0] != 0.0f);
     } break;
     case ucode::AluScalarOpcode::kFrcs: {
-      state_.previous_scalar =
+      state.previous_scalar =
           scalar_operands[0] - std::floor(scalar_operands[0]);
     } break;
     case ucode::AluScalarOpcode::kTruncs: {
-      state_.previous_scalar = std::trunc(scalar_operands[0]);
+      state.previous_scalar = std::trunc(scalar_operands[0]);
     } break;
     case ucode::AluScalarOpcode::kFloors: {
-      state_.previous_scalar = std::floor(scalar_operands[0]);
+      state.previous_scalar = std::floor(scalar_operands[0]);
     } break;
     case ucode::AluScalarOpcode::kExp: {
-      state_.previous_scalar = std::exp2(scalar_operands[0]);
+      state.previous_scalar = std::exp2(scalar_operands[0]);
     } break;
     case ucode::AluScalarOpcode::kLogc: {
-      state_.previous_scalar = std::log2(scalar_operands[0]);
-      if (state_.previous_scalar == -INFINITY) {
-        state_.previous_scalar = -FLT_MAX;
+      state.previous_scalar = std::log2(scalar_operands[0]);
+      if (state.previous_scalar == -INFINITY) {
+        state.previous_scalar = -FLT_MAX;
       }
     } break;
     case ucode::AluScalarOpcode::kLog: {
-      state_.previous_scalar = std::log2(scalar_operands[0]);
+      state.previous_scalar = std::log2(scalar_operands[0]);
     } break;
     case ucode::AluScalarOpcode::kRcpc: {
-      state_.previous_scalar = 1.0f / scalar_operands[0];
-      if (state_.previous_scalar == -INFINITY) {
-        state_.previous_scalar = -FLT_MAX;
-      } else if (state_.previous_scalar == INFINITY) {
-        state_.previous_scalar = FLT_MAX;
+      state.previous_scalar = 1.0f / scalar_operands[0];
+      if (state.previous_scalar == -INFINITY) {
+        state.previous_scalar = -FLT_MAX;
+      } else if (state.previous_scalar == INFINITY) {
+        state.previous_scalar = FLT_MAX;
       }
     } break;
     case ucode::AluScalarOpcode::kRcpf: {
-      state_.previous_scalar = 1.0f / scalar_operands[0];
-      if (state_.previous_scalar == -INFINITY) {
-        state_.previous_scalar = -0.0f;
-      } else if (state_.previous_scalar == INFINITY) {
-        state_.previous_scalar = 0.0f;
+      state.previous_scalar = 1.0f / scalar_operands[0];
+      if (state.previous_scalar == -INFINITY) {
+        state.previous_scalar = -0.0f;
+      } else if (state.previous_scalar == INFINITY) {
+        state.previous_scalar = 0.0f;
       }
     } break;
     case ucode::AluScalarOpcode::kRcp: {
-      state_.previous_scalar = 1.0f / scalar_operands[0];
+      state.previous_scalar = 1.0f / scalar_operands[0];
     } break;
     case ucode::AluScalarOpcode::kRsqc: {
-      state_.previous_scalar = 1.0f / std::sqrt(scalar_operands[0]);
-      if (state_.previous_scalar == -INFINITY) {
-        state_.previous_scalar = -FLT_MAX;
-      } else if (state_.previous_scalar == INFINITY) {
-        state_.previous_scalar = FLT_MAX;
+      state.previous_scalar = 1.0f / std::sqrt(scalar_operands[0]);
+      if (state.previous_scalar == -INFINITY) {
+        state.previous_scalar = -FLT_MAX;
+      } else if (state.previous_scalar == INFINITY) {
+        state.previous_scalar = FLT_MAX;
       }
     } break;
     case ucode::AluScalarOpcode::kRsqf: {
-      state_.previous_scalar = 1.0f / std::sqrt(scalar_operands[0]);
-      if (state_.previous_scalar == -INFINITY) {
-        state_.previous_scalar = -0.0f;
-      } else if (state_.previous_scalar == INFINITY) {
-        state_.previous_scalar = 0.0f;
+      state.previous_scalar = 1.0f / std::sqrt(scalar_operands[0]);
+      if (state.previous_scalar == -INFINITY) {
+        state.previous_scalar = -0.0f;
+      } else if (state.previous_scalar == INFINITY) {
+        state.previous_scalar = 0.0f;
       }
     } break;
     case ucode::AluScalarOpcode::kRsq: {
-      state_.previous_scalar = 1.0f / std::sqrt(scalar_operands[0]);
+      state.previous_scalar = 1.0f / std::sqrt(scalar_operands[0]);
     } break;
     case ucode::AluScalarOpcode::kMaxAs: {
-      state_.address_register = int32_t(std::floor(
+      state.address_register = int32_t(std::floor(
           xe::clamp_float(scalar_operands[0], -256.0f, 255.0f) + 0.5f));
-      state_.previous_scalar =
+      state.previous_scalar =
           std::isgreaterequal(scalar_operands[0], scalar_operands[1])
               ? scalar_operands[0]
               : scalar_operands[1];
     } break;
     case ucode::AluScalarOpcode::kMaxAsf: {
-      state_.address_register = int32_t(
+      state.address_register = int32_t(
           std::floor(xe::clamp_float(scalar_operands[0], -256.0f, 255.0f)));
-      state_.previous_scalar =
+      state.previous_scalar =
           std::isgreaterequal(scalar_operands[0], scalar_operands[1])
               ? scalar_operands[0]
               : scalar_operands[1];
@@ -817,73 +1092,73 @@ void ShaderInterpreter::ExecuteAluInstruction(ucode::AluInstruction instr) {
     case ucode::AluScalarOpcode::kSubs:
     case ucode::AluScalarOpcode::kSubsc0:
     case ucode::AluScalarOpcode::kSubsc1: {
-      state_.previous_scalar = scalar_operands[0] - scalar_operands[1];
+      state.previous_scalar = scalar_operands[0] - scalar_operands[1];
     } break;
     case ucode::AluScalarOpcode::kSubsPrev: {
-      state_.previous_scalar = scalar_operands[0] - state_.previous_scalar;
+      state.previous_scalar = scalar_operands[0] - state.previous_scalar;
     } break;
     case ucode::AluScalarOpcode::kSetpEq: {
-      state_.predicate = scalar_operands[0] == 0.0f;
-      state_.previous_scalar = float(!state_.predicate);
+      state.predicate = scalar_operands[0] == 0.0f;
+      state.previous_scalar = float(!state.predicate);
     } break;
     case ucode::AluScalarOpcode::kSetpNe: {
-      state_.predicate = scalar_operands[0] != 0.0f;
-      state_.previous_scalar = float(!state_.predicate);
+      state.predicate = scalar_operands[0] != 0.0f;
+      state.previous_scalar = float(!state.predicate);
     } break;
     case ucode::AluScalarOpcode::kSetpGt: {
-      state_.predicate = std::isgreater(scalar_operands[0], 0.0f);
-      state_.previous_scalar = float(!state_.predicate);
+      state.predicate = std::isgreater(scalar_operands[0], 0.0f);
+      state.previous_scalar = float(!state.predicate);
     } break;
     case ucode::AluScalarOpcode::kSetpGe: {
-      state_.predicate = std::isgreaterequal(scalar_operands[0], 0.0f);
-      state_.previous_scalar = float(!state_.predicate);
+      state.predicate = std::isgreaterequal(scalar_operands[0], 0.0f);
+      state.previous_scalar = float(!state.predicate);
     } break;
     case ucode::AluScalarOpcode::kSetpInv: {
-      state_.predicate = scalar_operands[0] == 1.0f;
-      state_.previous_scalar =
-          state_.predicate
+      state.predicate = scalar_operands[0] == 1.0f;
+      state.previous_scalar =
+          state.predicate
               ? 0.0f
               : (scalar_operands[0] == 0.0f ? 1.0f : scalar_operands[0]);
     } break;
     case ucode::AluScalarOpcode::kSetpPop: {
       float new_counter = scalar_operands[0] - 1.0f;
-      state_.predicate = std::islessequal(new_counter, 0.0f);
-      state_.previous_scalar = state_.predicate ? 0.0f : new_counter;
+      state.predicate = std::islessequal(new_counter, 0.0f);
+      state.previous_scalar = state.predicate ? 0.0f : new_counter;
     } break;
     case ucode::AluScalarOpcode::kSetpClr: {
-      state_.predicate = false;
-      state_.previous_scalar = FLT_MAX;
+      state.predicate = false;
+      state.previous_scalar = FLT_MAX;
     } break;
     case ucode::AluScalarOpcode::kSetpRstr: {
-      state_.predicate = scalar_operands[0] == 0.0f;
-      state_.previous_scalar = state_.predicate ? 0.0f : scalar_operands[0];
+      state.predicate = scalar_operands[0] == 0.0f;
+      state.previous_scalar = state.predicate ? 0.0f : scalar_operands[0];
     } break;
     // Not implementing pixel kill currently, the interpreter is currently used
     // only for vertex shaders.
     case ucode::AluScalarOpcode::kKillsEq: {
-      state_.previous_scalar = float(scalar_operands[0] == 0.0f);
+      state.previous_scalar = float(scalar_operands[0] == 0.0f);
     } break;
     case ucode::AluScalarOpcode::kKillsGt: {
-      state_.previous_scalar = float(std::isgreater(scalar_operands[0], 0.0f));
+      state.previous_scalar = float(std::isgreater(scalar_operands[0], 0.0f));
     } break;
     case ucode::AluScalarOpcode::kKillsGe: {
-      state_.previous_scalar =
+      state.previous_scalar =
           float(std::isgreaterequal(scalar_operands[0], 0.0f));
     } break;
     case ucode::AluScalarOpcode::kKillsNe: {
-      state_.previous_scalar = float(scalar_operands[0] != 0.0f);
+      state.previous_scalar = float(scalar_operands[0] != 0.0f);
     } break;
     case ucode::AluScalarOpcode::kKillsOne: {
-      state_.previous_scalar = float(scalar_operands[0] == 1.0f);
+      state.previous_scalar = float(scalar_operands[0] == 1.0f);
     } break;
     case ucode::AluScalarOpcode::kSqrt: {
-      state_.previous_scalar = std::sqrt(scalar_operands[0]);
+      state.previous_scalar = std::sqrt(scalar_operands[0]);
     } break;
     case ucode::AluScalarOpcode::kSin: {
-      state_.previous_scalar = std::sin(scalar_operands[0]);
+      state.previous_scalar = std::sin(scalar_operands[0]);
     } break;
     case ucode::AluScalarOpcode::kCos: {
-      state_.previous_scalar = std::cos(scalar_operands[0]);
+      state.previous_scalar = std::cos(scalar_operands[0]);
     } break;
     case ucode::AluScalarOpcode::kRetainPrev: {
     } break;
@@ -898,8 +1173,8 @@ void ShaderInterpreter::ExecuteAluInstruction(ucode::AluInstruction instr) {
     }
   }
   float scalar_result = instr.scalar_clamp()
-                            ? xe::saturate(state_.previous_scalar)
-                            : state_.previous_scalar;
+                            ? xe::saturate(state.previous_scalar)
+                            : state.previous_scalar;
 
   uint32_t scalar_result_write_mask = instr.GetScalarOpResultWriteMask();
   if (instr.is_export()) {
@@ -924,7 +1199,7 @@ void ShaderInterpreter::ExecuteAluInstruction(ucode::AluInstruction instr) {
         export_value[i] = export_component;
       }
       export_sink_->Export(
-          ucode::ExportRegister(instr.vector_dest()), export_value,
+          invocation_, ucode::ExportRegister(instr.vector_dest()), export_value,
           vector_result_write_mask | scalar_result_write_mask |
               instr.GetConstant0WriteMask() | export_constant_1_mask);
     }
@@ -986,16 +1261,18 @@ void ShaderInterpreter::StoreFetchResult(uint32_t dest, bool is_dest_relative,
 
 void ShaderInterpreter::ExecuteVertexFetchInstruction(
     ucode::VertexFetchInstruction instr) {
+  InvocationState& state = invocation_states_[invocation_];
+
   // FIXME(Triang3l): Bit scan loops over components cause a link-time
   // optimization internal error in Visual Studio 2019, mainly in the format
   // unpacking. Using loops with up to 4 iterations here instead.
 
   if (!instr.is_mini_fetch()) {
-    state_.vfetch_full_last = instr;
+    state.vfetch_full_last = instr;
   }
 
   xenos::xe_gpu_vertex_fetch_t fetch_constant = register_file_.GetVertexFetch(
-      state_.vfetch_full_last.fetch_constant_index());
+      state.vfetch_full_last.fetch_constant_index());
 
   if (!instr.is_mini_fetch()) {
     // Get the part of the address that depends on vfetch_full data.
@@ -1003,7 +1280,7 @@ void ShaderInterpreter::ExecuteVertexFetchInstruction(
         GetTempRegister(instr.src(),
                         instr.is_src_relative())[instr.src_swizzle()] +
         (instr.is_index_rounded() ? 0.5f : 0.0f)));
-    state_.vfetch_address_dwords =
+    state.vfetch_address_dwords =
         instr.stride() * vertex_index + fetch_constant.address;
   }
 
@@ -1025,7 +1302,7 @@ void ShaderInterpreter::ExecuteVertexFetchInstruction(
         reinterpret_cast<const uint32_t*>(memory_.physical_membase());
     uint32_t buffer_end_dwords = fetch_constant.address + fetch_constant.size;
     uint32_t dword_0_address_dwords =
-        uint32_t(int32_t(state_.vfetch_address_dwords) + instr.offset());
+        uint32_t(int32_t(state.vfetch_address_dwords) + instr.offset());
     for (uint32_t i = 0; i < 4; ++i) {
       if (!(needed_dwords & (UINT32_C(1) << i))) {
         continue;
@@ -14,6 +14,7 @@
 #include <array>
 #include <cstddef>
 #include <cstdint>
+#include <vector>
 
 #include "xenia/gpu/register_file.h"
 #include "xenia/gpu/shader.h"
@@ -25,6 +26,11 @@ namespace gpu {
 
 class ShaderInterpreter {
  public:
+  // Invocations executed by one Execute call go through the control flow in
+  // lockstep if it's uniform for all of them, with every instruction executed
+  // for all the invocations before proceeding to the next one.
+  static constexpr uint32_t kMaxInvocations = 8;
+
   ShaderInterpreter(const RegisterFile& register_file, const Memory& memory)
       : register_file_(register_file), memory_(memory) {}
 
@@ -32,7 +38,8 @@ class ShaderInterpreter {
    public:
     virtual ~ExportSink() = default;
     virtual void AllocExport(ucode::AllocType type, uint32_t size) {}
-    virtual void Export(ucode::ExportRegister export_register,
+    virtual void Export(uint32_t invocation,
+                        ucode::ExportRegister export_register,
                         const float* value, uint32_t value_mask) {}
   };
 
@@ -45,8 +52,14 @@ class ShaderInterpreter {
     export_sink_ = new_export_sink;
   }
 
-  const float* temp_registers() const { return &temp_registers_[0][0]; }
-  float* temp_registers() { return &temp_registers_[0][0]; }
+  const float* temp_registers(uint32_t invocation = 0) const {
+    assert_true(invocation < kMaxInvocations);
+    return &temp_registers_[invocation][0][0];
+  }
+  float* temp_registers(uint32_t invocation = 0) {
+    assert_true(invocation < kMaxInvocations);
+    return &temp_registers_[invocation][0][0];
+  }
 
   static bool CanInterpretShader(const Shader& shader) {
     assert_true(shader.is_ucode_analyzed());
@@ -58,29 +71,49 @@ class ShaderInterpreter {
     }
     return true;
   }
+  // Without the analyzed shader, conservatively assumes that the control flow
+  // may depend on the predicate, so each invocation is executed separately.
   void SetShader(xenos::ShaderType shader_type, const uint32_t* ucode) {
     shader_type_ = shader_type;
     ucode_ = ucode;
+    has_predicated_control_flow_ = true;
+    SetSkippedInstructions(nullptr, 0);
   }
   void SetShader(const Shader& shader) {
     assert_true(CanInterpretShader(shader));
     SetShader(shader.type(), shader.ucode_dwords());
+    has_predicated_control_flow_ = HasPredicatedControlFlow(shader);
   }
 
-  void Execute();
+  // Finds the ALU and fetch instructions that can't affect the control flow and
+  // the values written to the exports in needed_exports (a mask of
+  // 1 << ucode::ExportRegister), so they can be skipped if only those exports
+  // are of interest. The result is a bit set indexed by the location of the
+  // instruction in the ucode, in units of 3 dwords, for
+  // SetSkippedInstructions.
+  static void GetInstructionsSkippableForExports(
+      const Shader& shader, uint64_t needed_exports,
+      std::vector<uint64_t>& skippable_out);
+  // The bit set must stay valid while it's used for execution. Reset by
+  // SetShader.
+  void SetSkippedInstructions(const uint64_t* skipped_instructions,
+                              uint32_t skipped_instructions_bound) {
+    skipped_instructions_ = skipped_instructions;
+    skipped_instructions_bound_ = skipped_instructions_bound;
+  }
+
+  // Executes the shader for invocation_count (up to kMaxInvocations)
+  // invocations, with the inputs in their temp_registers.
+  void Execute(uint32_t invocation_count = 1);
 
  private:
+  // Control flow state, shared by the invocations executed in lockstep.
   struct State {
-    ucode::VertexFetchInstruction vfetch_full_last;
-    uint32_t vfetch_address_dwords;
-    float previous_scalar;
     uint32_t call_stack_depth;
     uint32_t call_return_addresses[4];
     uint32_t loop_stack_depth;
     xenos::LoopConstant loop_constants[4];
     uint32_t loop_iterators[4];
-    int32_t address_register;
-    bool predicate;
 
     void Reset() { std::memset(this, 0, sizeof(*this)); }
 
@@ -102,6 +135,39 @@ class ShaderInterpreter {
     }
   };
 
+  struct InvocationState {
+    ucode::VertexFetchInstruction vfetch_full_last;
+    uint32_t vfetch_address_dwords;
+    float previous_scalar;
+    int32_t address_register;
+    bool predicate;
+
+    void Reset() { std::memset(this, 0, sizeof(*this)); }
+  };
+
+  static ucode::ControlFlowInstruction GetControlFlowInstruction(
+      const uint32_t* ucode, uint32_t cf_index) {
+    const uint32_t* cf_pair = &ucode[3 * (cf_index >> 1)];
+    ucode::ControlFlowInstruction cf_instr;
+    if (cf_index & 1) {
+      cf_instr.dword_0 = (cf_pair[1] >> 16) | (cf_pair[2] << 16);
+      cf_instr.dword_1 = cf_pair[2] >> 16;
+    } else {
+      cf_instr.dword_0 = cf_pair[0];
+      cf_instr.dword_1 = cf_pair[1] & 0xFFFF;
+    }
+    return cf_instr;
+  }
+
+  // Whether the control flow may diverge between invocations.
+  static bool HasPredicatedControlFlow(const Shader& shader);
+
+  bool IsInstructionSkipped(uint32_t instruction_index) const {
+    return instruction_index < skipped_instructions_bound_ &&
+           (skipped_instructions_[instruction_index >> 6] &
+            (UINT64_C(1) << (instruction_index & 63)));
+  }
+
   static float FlushDenormal(float value) {
     uint32_t bits = *reinterpret_cast<const uint32_t*>(&value);
     bits &= (bits & UINT32_C(0x7F800000)) ? ~UINT32_C(0) : (UINT32_C(1) << 31);
@@ -113,14 +179,19 @@ class ShaderInterpreter {
            ((UINT32_C(1) << xenos::kMaxShaderTempRegistersLog2) - 1);
   }
   const float* GetTempRegister(uint32_t address, bool is_relative) const {
-    return temp_registers_[GetTempRegisterIndex(address, is_relative)];
+    return temp_registers_[invocation_]
+                          [GetTempRegisterIndex(address, is_relative)];
   }
   float* GetTempRegister(uint32_t address, bool is_relative) {
-    return temp_registers_[GetTempRegisterIndex(address, is_relative)];
+    return temp_registers_[invocation_]
+                          [GetTempRegisterIndex(address, is_relative)];
   }
   const std::array<float, 4> GetFloatConstant(
       uint32_t address, bool is_relative, bool relative_address_is_a0) const;
 
+  // The control flow must be uniform for the invocations.
+  void ExecuteInvocations(uint32_t first_invocation, uint32_t invocation_count);
+  // For the current invocation_.
   void ExecuteAluInstruction(ucode::AluInstruction instr);
   void StoreFetchResult(uint32_t dest, bool is_dest_relative, uint32_t swizzle,
                         const float* value);
@@ -135,11 +206,17 @@ class ShaderInterpreter {
 
   xenos::ShaderType shader_type_ = xenos::ShaderType::kVertex;
   const uint32_t* ucode_ = nullptr;
+  bool has_predicated_control_flow_ = true;
+  const uint64_t* skipped_instructions_ = nullptr;
+  uint32_t skipped_instructions_bound_ = 0;
 
   // For both inputs and locals.
-  float temp_registers_[xenos::kMaxShaderTempRegisters][4];
+  float temp_registers_[kMaxInvocations][xenos::kMaxShaderTempRegisters][4];
 
   State state_;
+  InvocationState invocation_states_[kMaxInvocations];
+  // The invocation the instructions are currently executed for.
+  uint32_t invocation_ = 0;
 };
 
 }  // namespace gpu
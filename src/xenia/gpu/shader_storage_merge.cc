@@ -0,0 +1,400 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2023 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/gpu/shader_storage_merge.h"
+
+#include <cstring>
+#include <string>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "third_party/fmt/include/fmt/format.h"
+#include "xenia/base/cvar.h"
+#include "xenia/base/filesystem.h"
+#include "xenia/base/logging.h"
+#include "xenia/base/string.h"
+#include "xenia/base/utf8.h"
+#include "xenia/base/xxhash.h"
+
+DEFINE_path(
+    shader_storage_shared_root, "",
+    "Directory with read-only shareable shader storage files (.xsh and .xpso) "
+    "collected from other machines, such as ones merged with "
+    "xenia-gpu-shader-storage-merge. The shaders and pipelines of the title "
+    "from it are added to the local storage and created before the title "
+    "starts.",
+    "GPU");
+
+namespace xe {
+namespace gpu {
+
+namespace {
+
+// 'XESH'.
+constexpr uint32_t kShaderStorageMagic = 0x48534558;
+// 'XEPS'.
+constexpr uint32_t kPipelineStorageMagic = 0x53504558;
+
+// Magic and version.
+constexpr size_t kShaderStorageHeaderSize = sizeof(uint32_t) * 2;
+// Ucode hash, and the dword count and the shader type in a bit field.
+constexpr size_t kShaderRecordHeaderSize = sizeof(uint64_t) + sizeof(uint32_t);
+// Magic, API magic and version.
+constexpr size_t kPipelineStorageHeaderSize = sizeof(uint32_t) * 3;
+// Bounds for finding the size of the backend-specific pipeline records.
+constexpr size_t kPipelineRecordMinSize = sizeof(uint64_t) * 2;
+constexpr size_t kPipelineRecordMaxSize = 4096;
+
+// Held exclusively while opening, truncating or rewriting a file, so the
+// instances can check whether a file is used by others.
+constexpr uint32_t kStorageGuardLock = 0;
+// Held shared while the file is open.
+constexpr uint32_t kStorageUsageLock = 1;
+
+struct StorageRecord {
+  uint64_t hash;
+  size_t offset;
+  size_t size;
+};
+
+struct StorageContents {
+  std::vector<uint8_t> data;
+  size_t header_size = 0;
+  // Size of the header and all the records before the first corrupted one.
+  size_t valid_size = 0;
+  std::vector<StorageRecord> records;
+};
+
+bool ReadWholeFile(const std::filesystem::path& path,
+                   std::vector<uint8_t>& data_out) {
+  data_out.clear();
+  FILE* file = xe::filesystem::OpenFile(path, "rb");
+  if (!file) {
+    return false;
+  }
+  bool read = false;
+  if (xe::filesystem::Seek(file, 0, SEEK_END)) {
+    int64_t size = xe::filesystem::Tell(file);
+    if (size >= 0 && xe::filesystem::Seek(file, 0, SEEK_SET)) {
+      data_out.resize(size_t(size));
+      read = data_out.empty() ||
+             fread(data_out.data(), data_out.size(), 1, file) == 1;
+    }
+  }
+  fclose(file);
+  if (!read) {
+    data_out.clear();
+  }
+  return read;
+}
+
+uint32_t LoadUint32(const std::vector<uint8_t>& data, size_t offset) {
+  uint32_t value;
+  std::memcpy(&value, data.data() + offset, sizeof(value));
+  return value;
+}
+
+uint64_t LoadUint64(const std::vector<uint8_t>& data, size_t offset) {
+  uint64_t value;
+  std::memcpy(&value, data.data() + offset, sizeof(value));
+  return value;
+}
+
+bool ParseShaderStorage(StorageContents& contents) {
+  const std::vector<uint8_t>& data = contents.data;
+  if (data.size() < kShaderStorageHeaderSize ||
+      LoadUint32(data, 0) != kShaderStorageMagic) {
+    return false;
+  }
+  contents.header_size = kShaderStorageHeaderSize;
+  size_t offset = kShaderStorageHeaderSize;
+  while (data.size() - offset >= kShaderRecordHeaderSize) {
+    uint64_t ucode_hash = LoadUint64(data, offset);
+    size_t ucode_size = size_t(LoadUint32(data, offset + sizeof(uint64_t)) &
+                               ((uint32_t(1) << 31) - 1)) *
+                        sizeof(uint32_t);
+    if (data.size() - offset - kShaderRecordHeaderSize < ucode_size ||
+        XXH3_64bits(data.data() + offset + kShaderRecordHeaderSize,
+                    ucode_size) != ucode_hash) {
+      break;
+    }
+    contents.records.push_back(
+        {ucode_hash, offset, kShaderRecordHeaderSize + ucode_size});
+    offset += kShaderRecordHeaderSize + ucode_size;
+  }
+  contents.valid_size = offset;
+  return true;
+}
+
+bool IsPipelineRecordValid(const std::vector<uint8_t>& data, size_t offset,
+                           size_t record_size) {
+  return data.size() - offset >= record_size &&
+         XXH3_64bits(data.data() + offset + sizeof(uint64_t),
+                     record_size - sizeof(uint64_t)) ==
+             LoadUint64(data, offset);
+}
+
+// Returns 0 if the first record is corrupted or there are no records.
+size_t FindPipelineRecordSize(const std::vector<uint8_t>& data) {
+  for (size_t record_size = kPipelineRecordMinSize;
+       record_size <= kPipelineRecordMaxSize; record_size += sizeof(uint32_t)) {
+    if (data.size() - kPipelineStorageHeaderSize < record_size) {
+      break;
+    }
+    if (IsPipelineRecordValid(data, kPipelineStorageHeaderSize, record_size)) {
+      return record_size;
+    }
+  }
+  return 0;
+}
+
+bool ParsePipelineStorage(StorageContents& contents, size_t record_size) {
+  const std::vector<uint8_t>& data = contents.data;
+  if (data.size() < kPipelineStorageHeaderSize ||
+      LoadUint32(data, 0) != kPipelineStorageMagic) {
+    return false;
+  }
+  contents.header_size = kPipelineStorageHeaderSize;
+  size_t offset = kPipelineStorageHeaderSize;
+  if (record_size) {
+    while (IsPipelineRecordValid(data, offset, record_size)) {
+      contents.records.push_back(
+          {LoadUint64(data, offset), offset, record_size});
+      offset += record_size;
+    }
+  }
+  contents.valid_size = offset;
+  return true;
+}
+
+// Returns false only if failed to write the target file.
+bool MergeShaderStorageFile(const std::filesystem::path& source_path,
+                            const std::filesystem::path& target_path,
+                            bool is_pipeline_storage, size_t& records_added) {
+  StorageContents source;
+  if (!ReadWholeFile(source_path, source.data)) {
+    XELOGW("Shader storage merge: failed to read {}",
+           xe::path_to_utf8(source_path));
+    return true;
+  }
+  StorageContents target;
+  bool target_exists = ReadWholeFile(target_path, target.data);
+
+  bool source_valid, target_valid;
+  if (is_pipeline_storage) {
+    size_t record_size = FindPipelineRecordSize(source.data);
+    size_t target_record_size =
+        target_exists ? FindPipelineRecordSize(target.data) : 0;
+    if (record_size && target_record_size &&
+        record_size != target_record_size) {
+      XELOGW(
+          "Shader storage merge: {} has pipeline records of a different size "
+          "than {}, skipping",
+          xe::path_to_utf8(source_path), xe::path_to_utf8(target_path));
+      return true;
+    }
+    if (!record_size) {
+      record_size = target_record_size;
+    }
+    source_valid = ParsePipelineStorage(source, record_size);
+    target_valid = target_exists && ParsePipelineStorage(target, record_size);
+  } else {
+    source_valid = ParseShaderStorage(source);
+    target_valid = target_exists && ParseShaderStorage(target);
+  }
+  if (!source_valid || source.records.empty()) {
+    return true;
+  }
+  if (target_valid && !target.records.empty() &&
+      std::memcmp(source.data.data(), target.data.data(),
+                  source.header_size)) {
+    XELOGW(
+        "Shader storage merge: {} was written by a different version than {}, "
+        "skipping",
+        xe::path_to_utf8(source_path), xe::path_to_utf8(target_path));
+    return true;
+  }
+
+  // The valid part of the target, or the header of the source if the target
+  // is empty, followed by the new records.
+  std::vector<uint8_t> merged;
+  std::unordered_set<uint64_t> hashes;
+  if (target_valid && !target.records.empty()) {
+    merged.assign(target.data.cbegin(),
+                  target.data.cbegin() + target.valid_size);
+    for (const StorageRecord& record : target.records) {
+      hashes.insert(record.hash);
+    }
+  } else {
+    merged.assign(source.data.cbegin(),
+                  source.data.cbegin() + source.header_size);
+  }
+  size_t file_records_added = 0;
+  for (const StorageRecord& record : source.records) {
+    if (!hashes.insert(record.hash).second) {
+      continue;
+    }
+    merged.insert(merged.cend(), source.data.cbegin() + record.offset,
+                  source.data.cbegin() + record.offset + record.size);
+    ++file_records_added;
+  }
+  if (!file_records_added && target_valid &&
+      target.valid_size == target.data.size()) {
+    return true;
+  }
+
+  bool target_appendable =
+      target_valid && target.valid_size == target.data.size() &&
+      !std::memcmp(merged.data(), target.data.data(), target.valid_size);
+
+  FILE* target_file = xe::filesystem::OpenFile(target_path, "a+b");
+  if (!target_file) {
+    XELOGE("Shader storage merge: failed to open {} for writing",
+           xe::path_to_utf8(target_path));
+    return false;
+  }
+  xe::filesystem::LockStdioFile(target_file, kStorageGuardLock, true, true);
+  bool written;
+  if (xe::filesystem::LockStdioFile(target_file, kStorageUsageLock, true,
+                                    false)) {
+    written = xe::filesystem::TruncateStdioFile(target_file, 0) &&
+              xe::filesystem::AppendToStdioFile(target_file, merged.data(),
+                                                merged.size());
+  } else if (target_appendable) {
+    // The instances using the file may be appending the same records, the
+    // duplicates are skipped when loading.
+    written = xe::filesystem::AppendToStdioFile(
+        target_file, merged.data() + target.valid_size,
+        merged.size() - target.valid_size);
+  } else {
+    XELOGW(
+        "Shader storage merge: {} needs to be rewritten, but it's used by "
+        "another instance, skipping",
+        xe::path_to_utf8(target_path));
+    fclose(target_file);
+    return true;
+  }
+  fclose(target_file);
+  if (!written) {
+    XELOGE("Shader storage merge: failed to write {}",
+           xe::path_to_utf8(target_path));
+    return false;
+  }
+  XELOGI("Shader storage merge: added {} records from {} to {}",
+         file_records_added, xe::path_to_utf8(source_path),
+         xe::path_to_utf8(target_path));
+  records_added += file_records_added;
+  return true;
+}
+
+}  // namespace
+
+bool MergeShaderStorage(const std::filesystem::path& source_directory,
+                        const std::filesystem::path& target_directory,
+                        uint32_t title_id, size_t* records_added_out) {
+  if (records_added_out) {
+    *records_added_out = 0;
+  }
+  if (!std::filesystem::exists(target_directory) &&
+      !std::filesystem::create_directories(target_directory)) {
+    XELOGE("Shader storage merge: failed to create {}",
+           xe::path_to_utf8(target_directory));
+    return false;
+  }
+  std::string title_prefix =
+      title_id ? fmt::format("{:08X}.", title_id) : std::string();
+  size_t records_added = 0;
+  bool succeeded = true;
+  for (const xe::filesystem::FileInfo& file_info :
+       xe::filesystem::ListFiles(source_directory)) {
+    if (file_info.type != xe::filesystem::FileInfo::Type::kFile) {
+      continue;
+    }
+    std::string name = xe::path_to_utf8(file_info.name);
+    if (!title_prefix.empty() && !utf8::starts_with(name, title_prefix)) {
+      continue;
+    }
+    bool is_pipeline_storage;
+    if (utf8::ends_with_case(name, ".xsh")) {
+      is_pipeline_storage = false;
+    } else if (utf8::ends_with_case(name, ".xpso")) {
+      is_pipeline_storage = true;
+    } else {
+      continue;
+    }
+    if (!MergeShaderStorageFile(source_directory / file_info.name,
+                                target_directory / file_info.name,
+                                is_pipeline_storage, records_added)) {
+      succeeded = false;
+    }
+  }
+  if (records_added_out) {
+    *records_added_out = records_added;
+  }
+  return succeeded;
+}
+
+FILE* OpenShaderStorageFile(const std::filesystem::path& path,
+                            const void* header, size_t header_size) {
+  FILE* file = xe::filesystem::OpenFile(path, "a+b");
+  if (!file) {
+    return nullptr;
+  }
+  xe::filesystem::LockStdioFile(file, kStorageGuardLock, true, true);
+  std::vector<uint8_t> file_header(header_size);
+  bool opened = fread(file_header.data(), header_size, 1, file) == 1 &&
+                !std::memcmp(file_header.data(), header, header_size);
+  if (!opened) {
+    if (xe::filesystem::LockStdioFile(file, kStorageUsageLock, true, false)) {
+      opened = xe::filesystem::TruncateStdioFile(file, 0) &&
+               xe::filesystem::AppendToStdioFile(file, header, header_size);
+    } else {
+      XELOGW(
+          "{} was written by a different version, but it's used by another "
+          "instance, not using it",
+          xe::path_to_utf8(path));
+    }
+  }
+  opened = opened &&
+           xe::filesystem::LockStdioFile(file, kStorageUsageLock, false,
+                                         true) &&
+           xe::filesystem::Seek(file, int64_t(header_size), SEEK_SET);
+  xe::filesystem::UnlockStdioFile(file, kStorageGuardLock);
+  if (!opened) {
+    fclose(file);
+    return nullptr;
+  }
+  return file;
+}
+
+bool TruncateShaderStorageFile(FILE* file, uint64_t valid_size) {
+  xe::filesystem::LockStdioFile(file, kStorageGuardLock, true, true);
+  bool truncated =
+      xe::filesystem::LockStdioFile(file, kStorageUsageLock, true, false) &&
+      xe::filesystem::TruncateStdioFile(file, valid_size);
+  xe::filesystem::LockStdioFile(file, kStorageUsageLock, false, true);
+  xe::filesystem::UnlockStdioFile(file, kStorageGuardLock);
+  return truncated;
+}
+
+void MergeSharedShaderStorage(
+    const std::filesystem::path& shareable_storage_directory,
+    uint32_t title_id) {
+  if (cvars::shader_storage_shared_root.empty()) {
+    return;
+  }
+  size_t records_added;
+  MergeShaderStorage(cvars::shader_storage_shared_root,
+                     shareable_storage_directory, title_id, &records_added);
+  XELOGGPU("Added {} records from the shared shader storage", records_added);
+}
+
+}  // namespace gpu
+}  // namespace xe
@@ -0,0 +1,69 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2023 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#ifndef XENIA_GPU_SHADER_STORAGE_MERGE_H_
+#define XENIA_GPU_SHADER_STORAGE_MERGE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+
+namespace xe {
+namespace gpu {
+
+// Merging of the shareable persistent shader storage files - the guest shader
+// ucode (.xsh) and the pipeline descriptions (.xpso) - collected on different
+// machines.
+//
+// The records are deduplicated by their hashes, and corrupted ones are
+// dropped. Only files with exactly the same header (magic, API and version)
+// are merged, a file written by a different version is left as is. The record
+// format of the pipeline descriptions is backend-specific, so their size is
+// determined from the hashes of the records in the files.
+//
+// The files may be used by multiple emulator instances with the same cache
+// root at once. An instance holds a shared lock of the files while they're
+// open, and appends whole records with xe::filesystem::AppendToStdioFile
+// without any other synchronization. The files are only truncated or
+// rewritten while no instance has them open.
+
+// Appends the records from the storage files in source_directory that are
+// missing from the files with the same names in target_directory, creating the
+// target files if needed. If title_id is not 0, only the files of that title
+// are merged. Returns false if the target directory couldn't be written.
+bool MergeShaderStorage(const std::filesystem::path& source_directory,
+                        const std::filesystem::path& target_directory,
+                        uint32_t title_id, size_t* records_added_out = nullptr);
+
+// Opens a storage file for reading and appending, creating or resetting it
+// with the header if it doesn't begin with it, positioned after the header.
+// Returns nullptr if the file couldn't be opened, or if it has a different
+// header, but is used by another instance.
+FILE* OpenShaderStorageFile(const std::filesystem::path& path,
+                            const void* header, size_t header_size);
+
+// Truncates a storage file opened with OpenShaderStorageFile to the given
+// size, dropping the corrupted records after it. Returns false if the file is
+// used by another instance, in which case the corrupted records are kept, and
+// nothing must be appended to the file, as the records would be after them.
+bool TruncateShaderStorageFile(FILE* file, uint64_t valid_size);
+
+// If a shared read-only storage directory is configured, merges the files of
+// the title from it into the local shareable storage directory before the
+// backend loads the storage from it. Must be called while the local files are
+// not open.
+void MergeSharedShaderStorage(
+    const std::filesystem::path& shareable_storage_directory,
+    uint32_t title_id);
+
+}  // namespace gpu
+}  // namespace xe
+
+#endif  // XENIA_GPU_SHADER_STORAGE_MERGE_H_
@@ -0,0 +1,63 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2023 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include <string>
+#include <vector>
+
+#include "xenia/base/console_app_main.h"
+#include "xenia/base/cvar.h"
+#include "xenia/base/filesystem.h"
+#include "xenia/base/logging.h"
+#include "xenia/base/string.h"
+#include "xenia/base/string_util.h"
+#include "xenia/gpu/shader_storage_merge.h"
+
+DEFINE_transient_path(merge_source, "",
+                      "Directory with the shareable shader storage files to "
+                      "merge from.",
+                      "GPU");
+DEFINE_transient_path(merge_target, "",
+                      "Directory with the shareable shader storage files to "
+                      "merge into.",
+                      "GPU");
+DEFINE_transient_string(merge_title_id, "",
+                        "Hexadecimal title ID to merge the files of, or empty "
+                        "to merge the files of all titles.",
+                        "GPU");
+
+namespace xe {
+namespace gpu {
+
+int shader_storage_merge_main(const std::vector<std::string>& args) {
+  if (cvars::merge_source.empty() || cvars::merge_target.empty()) {
+    XELOGE("Usage: {} [merge_source] [merge_target]",
+           xe::path_to_utf8(args[0]));
+    return 1;
+  }
+  uint32_t title_id = 0;
+  if (!cvars::merge_title_id.empty()) {
+    title_id = xe::string_util::from_string<uint32_t>(cvars::merge_title_id,
+                                                      true);
+  }
+  size_t records_added;
+  if (!MergeShaderStorage(cvars::merge_source, cvars::merge_target, title_id,
+                          &records_added)) {
+    return 1;
+  }
+  XELOGI("Added {} records", records_added);
+  return 0;
+}
+
+}  // namespace gpu
+}  // namespace xe
+
+XE_DEFINE_CONSOLE_APP("xenia-gpu-shader-storage-merge",
+                      xe::gpu::shader_storage_merge_main,
+                      "[merge_source] [merge_target]", "merge_source",
+                      "merge_target");
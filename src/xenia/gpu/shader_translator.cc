@@ -14,6 +14,16 @@
 #include "xenia/base/logging.h"
 #include "xenia/gpu/gpu_flags.h"
 
+DEFINE_bool(
+    structured_control_flow, false,
+    "Translate jumps and loops in guest shaders to structured host if/else "
+    "and loop blocks when possible, instead of emulating the guest program "
+    "counter with a loop containing a switch (or an if sequence), which may "
+    "let the host shader compiler optimize the code better. Shaders with "
+    "control flow not expressible as nested blocks, or with calls, still use "
+    "the program counter emulation.",
+    "GPU");
+
 namespace xe {
 namespace gpu {
 
@@ -640,11 +650,8 @@ bool ShaderTranslator::TranslateAnalyzedShader(
     register_count_ = std::max(register_count_, GetModificationRegisterCount());
   }
 
-  StartTranslation();
-
   const uint32_t* ucode_dwords = shader.ucode_data().data();
 
-  // TODO(Triang3l): Remove when the old SPIR-V shader translator is deleted.
   uint32_t cf_pair_index_bound = shader.cf_pair_index_bound();
   std::vector<ControlFlowInstruction> cf_instructions;
   for (uint32_t i = 0; i < cf_pair_index_bound; ++i) {
@@ -653,6 +660,14 @@ bool ShaderTranslator::TranslateAnalyzedShader(
     cf_instructions.push_back(cf_ab[0]);
     cf_instructions.push_back(cf_ab[1]);
   }
+
+  // Needed by the implementation in the beginning of the translation already
+  // to decide whether to emulate the program counter.
+  AnalyzeStructuredControlFlow(cf_instructions);
+
+  StartTranslation();
+
+  // TODO(Triang3l): Remove when the old SPIR-V shader translator is deleted.
   PreProcessControlFlowInstructions(cf_instructions);
 
   // Translate all instructions.
@@ -663,7 +678,16 @@ bool ShaderTranslator::TranslateAnalyzedShader(
     for (uint32_t j = 0; j < 2; ++j) {
       uint32_t cf_index = i * 2 + j;
       cf_index_ = cf_index;
-      if (label_addresses.find(cf_index) != label_addresses.end()) {
+      if (cf_structured_) {
+        const StructuredControlFlowPoint& cf_structured_point =
+            cf_structured_points_[cf_index];
+        if (cf_structured_point.else_begins) {
+          ProcessStructuredElse();
+        }
+        for (uint32_t k = 0; k < cf_structured_point.if_end_count; ++k) {
+          ProcessStructuredIfEnd();
+        }
+      } else if (label_addresses.find(cf_index) != label_addresses.end()) {
         ProcessLabel(cf_index);
       }
       ProcessControlFlowInstructionBegin(cf_index);
@@ -691,6 +715,171 @@ bool ShaderTranslator::TranslateAnalyzedShader(
   return translation.is_valid_;
 }
 
+void ShaderTranslator::AnalyzeStructuredControlFlow(
+    const std::vector<ControlFlowInstruction>& cf_instructions) {
+  cf_structured_ = false;
+  cf_structured_points_.clear();
+  // Without labels, there's no need to emulate the program counter anyway.
+  if (!cvars::structured_control_flow ||
+      current_shader().label_addresses().empty()) {
+    return;
+  }
+
+  uint32_t cf_count = uint32_t(cf_instructions.size());
+
+  // Count the references to each label - the beginning of an else block must
+  // be reachable only by skipping the conditional block preceding it.
+  std::vector<uint32_t> label_reference_counts(cf_count, 0);
+  for (uint32_t i = 0; i < cf_count; ++i) {
+    const ControlFlowInstruction& cf = cf_instructions[i];
+    uint32_t target;
+    switch (cf.opcode()) {
+      case ControlFlowOpcode::kCondJmp:
+        target = cf.cond_jmp.address();
+        break;
+      case ControlFlowOpcode::kLoopStart:
+        target = cf.loop_start.address();
+        break;
+      case ControlFlowOpcode::kLoopEnd:
+        target = cf.loop_end.address();
+        break;
+      case ControlFlowOpcode::kCondCall:
+      case ControlFlowOpcode::kReturn:
+        // The call stack can't be expressed as nested blocks.
+        return;
+      default:
+        continue;
+    }
+    if (target >= cf_count) {
+      return;
+    }
+    ++label_reference_counts[target];
+  }
+
+  std::vector<StructuredControlFlowPoint> points(cf_count);
+  struct Block {
+    bool is_loop;
+    // For conditional blocks, the address of the jump that has opened it, for
+    // loops, the address of the loop start.
+    uint32_t begin;
+    // UINT32_MAX if there's no else block or it has already started.
+    uint32_t else_begin;
+    // For conditional blocks, the address of the label closing it, for loops,
+    // the address of the skip label after the loop end.
+    uint32_t end;
+  };
+  std::vector<Block> blocks;
+  for (uint32_t i = 0; i < cf_count; ++i) {
+    if (label_reference_counts[i]) {
+      StructuredControlFlowPoint& point = points[i];
+      while (!blocks.empty()) {
+        Block& block = blocks.back();
+        if (block.is_loop) {
+          break;
+        }
+        if (block.else_begin == i) {
+          point.else_begins = true;
+          block.else_begin = UINT32_MAX;
+          continue;
+        }
+        if (block.end != i) {
+          break;
+        }
+        ++point.if_end_count;
+        blocks.pop_back();
+      }
+      // Not properly nested if any non-innermost block ends here.
+      for (const Block& block : blocks) {
+        if (block.else_begin == i || block.end == i) {
+          return;
+        }
+      }
+    }
+
+    const ControlFlowInstruction& cf = cf_instructions[i];
+    ControlFlowOpcode opcode = cf.opcode();
+    if (DoesControlFlowOpcodeEndShader(opcode)) {
+      // Breaking out of the whole program from a host loop is not possible.
+      for (const Block& block : blocks) {
+        if (block.is_loop) {
+          return;
+        }
+      }
+      continue;
+    }
+    switch (opcode) {
+      case ControlFlowOpcode::kCondJmp: {
+        ParsedJumpInstruction instr;
+        ParseControlFlowCondJmp(cf.cond_jmp, i, instr);
+        if (instr.target_address <= i) {
+          return;
+        }
+        if (instr.type != ParsedJumpInstruction::Type::kUnconditional) {
+          blocks.push_back({false, i, UINT32_MAX, instr.target_address});
+          points[i].jump_type = StructuredJumpType::kIf;
+          break;
+        }
+        // An unconditional jump is only structured as the end of the "then"
+        // part of an if/else, immediately before the label where the
+        // innermost conditional block ends, which must not be reachable from
+        // anywhere else.
+        uint32_t next = i + 1;
+        while (next < cf_count &&
+               (cf_instructions[next].opcode() == ControlFlowOpcode::kNop ||
+                cf_instructions[next].opcode() ==
+                    ControlFlowOpcode::kMarkVsFetchDone)) {
+          ++next;
+        }
+        if (blocks.empty() || next >= cf_count ||
+            instr.target_address <= next) {
+          return;
+        }
+        Block& block = blocks.back();
+        if (block.is_loop || block.end != next ||
+            points[block.begin].jump_type != StructuredJumpType::kIf ||
+            label_reference_counts[next] != 1) {
+          return;
+        }
+        block.else_begin = next;
+        block.end = instr.target_address;
+        points[block.begin].jump_type = StructuredJumpType::kIfElse;
+        points[i].jump_type = StructuredJumpType::kElse;
+      } break;
+      case ControlFlowOpcode::kLoopStart: {
+        ParsedLoopStartInstruction instr;
+        ParseControlFlowLoopStart(cf.loop_start, i, instr);
+        if (instr.loop_skip_address <= i + 1) {
+          return;
+        }
+        blocks.push_back({true, i, UINT32_MAX, instr.loop_skip_address});
+      } break;
+      case ControlFlowOpcode::kLoopEnd: {
+        ParsedLoopEndInstruction instr;
+        ParseControlFlowLoopEnd(cf.loop_end, i, instr);
+        // The loop must begin right after its start and be skipped to right
+        // after its end.
+        if (blocks.empty()) {
+          return;
+        }
+        const Block& block = blocks.back();
+        if (!block.is_loop || instr.loop_body_address != block.begin + 1 ||
+            block.end != i + 1) {
+          return;
+        }
+        blocks.pop_back();
+      } break;
+      default:
+        break;
+    }
+  }
+  if (!blocks.empty()) {
+    return;
+  }
+
+  cf_structured_ = true;
+  cf_structured_points_ = std::move(points);
+}
+
 void ShaderTranslator::EmitTranslationError(const char* message,
                                             bool is_fatal) {
   Shader::Error error;
@@ -750,7 +939,24 @@ void ShaderTranslator::TranslateControlFlowInstruction(
     case ControlFlowOpcode::kCondJmp: {
       ParsedJumpInstruction instr;
       ParseControlFlowCondJmp(cf.cond_jmp, cf_index_, instr);
-      ProcessJumpInstruction(instr);
+      if (cf_structured_) {
+        switch (cf_structured_points_[cf_index_].jump_type) {
+          case StructuredJumpType::kIf:
+            ProcessStructuredIfBegin(instr, false);
+            break;
+          case StructuredJumpType::kIfElse:
+            ProcessStructuredIfBegin(instr, true);
+            break;
+          default:
+            // The end of the "then" part of an if/else - the branch to the end
+            // of the else block is implicit.
+            assert_true(cf_structured_points_[cf_index_].jump_type ==
+                        StructuredJumpType::kElse);
+            break;
+        }
+      } else {
+        ProcessJumpInstruction(instr);
+      }
     } break;
     case ControlFlowOpcode::kAlloc: {
       ParsedAllocInstruction instr;
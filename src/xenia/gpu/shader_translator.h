@@ -11,6 +11,8 @@
 #define XENIA_GPU_SHADER_TRANSLATOR_H_
 
 #include <memory>
+#include <vector>
+
 #include "xenia/gpu/shader.h"
 
 namespace xe {
@@ -62,6 +64,17 @@ class ShaderTranslator {
   // Temporary register count, accessible via static and dynamic addressing.
   uint32_t register_count() const { return register_count_; }
 
+  // Whether the jumps and the loops in the current shader have been recovered
+  // as properly nested host if/else and loop blocks (and the structured
+  // control flow is enabled). In this case, ProcessLabel and
+  // ProcessJumpInstruction are not called - instead, jumps are translated via
+  // the ProcessStructuredIf* functions, and ProcessLoopStartInstruction and
+  // ProcessLoopEndInstruction must open and close host loops rather than
+  // jumping to the labels. Calls and returns are never structured, and ending
+  // execs are never inside loops, so they can just break out of the whole
+  // program.
+  bool is_control_flow_structured() const { return cf_structured_; }
+
   // Emits a translation error that will be passed back in the result.
   virtual void EmitTranslationError(const char* message, bool is_fatal = true);
 
@@ -118,6 +131,17 @@ class ShaderTranslator {
   virtual void ProcessReturnInstruction(const ParsedReturnInstruction& instr) {}
   // Handles translation for jump instructions.
   virtual void ProcessJumpInstruction(const ParsedJumpInstruction& instr) {}
+  // With structured control flow, handles a forward jump by opening a
+  // conditional block executed if the jump is not taken, with the else block
+  // (opened via ProcessStructuredElse) containing the instructions from the
+  // jump target if has_else is true.
+  virtual void ProcessStructuredIfBegin(const ParsedJumpInstruction& instr,
+                                        bool has_else) {}
+  // With structured control flow, handles the label where the else block of
+  // the innermost conditional block starts.
+  virtual void ProcessStructuredElse() {}
+  // With structured control flow, closes the innermost conditional block.
+  virtual void ProcessStructuredIfEnd() {}
   // Handles translation for alloc instructions. Memory exports for eM#
   // indicated by export_eM must be performed, regardless of the alloc type.
   virtual void ProcessAllocInstruction(const ParsedAllocInstruction& instr,
@@ -139,6 +163,35 @@ class ShaderTranslator {
       uint8_t memexport_eM_potentially_written_before) {}
 
  private:
+  enum class StructuredJumpType : uint8_t {
+    kNone,
+    // Opening a conditional block closed at the target.
+    kIf,
+    // Opening a conditional block with an else block starting at the target.
+    kIfElse,
+    // Unconditional jump at the end of a conditional block to the end of its
+    // else block - the branch is implicit.
+    kElse,
+  };
+
+  struct StructuredControlFlowPoint {
+    StructuredJumpType jump_type = StructuredJumpType::kNone;
+    // Whether the else block of the innermost conditional block starts at the
+    // label at this address.
+    bool else_begins = false;
+    // Number of conditional blocks closed at the label at this address.
+    uint32_t if_end_count = 0;
+  };
+
+  // Tries to recover structured control flow from the control flow
+  // instructions, initializing cf_structured_ and cf_structured_points_.
+  // Falls back to labels (with the control flow emulated by the implementation
+  // via the program counter) if anything is not expressible as properly nested
+  // blocks - backward jumps other than loops, jumps into or out of loops,
+  // overlapping conditional blocks, calls.
+  void AnalyzeStructuredControlFlow(
+      const std::vector<ucode::ControlFlowInstruction>& cf_instructions);
+
   void TranslateControlFlowInstruction(const ucode::ControlFlowInstruction& cf);
   void TranslateExecInstructions(const ParsedExecInstruction& instr);
 
@@ -154,6 +207,10 @@ class ShaderTranslator {
   // Current control flow dword index.
   uint32_t cf_index_ = 0;
 
+  bool cf_structured_ = false;
+  // Indexed by the control flow instruction address, if cf_structured_.
+  std::vector<StructuredControlFlowPoint> cf_structured_points_;
+
   // Kept for supporting vfetch_mini.
   ucode::VertexFetchInstruction previous_vfetch_full_;
 };
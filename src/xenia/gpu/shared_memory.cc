@@ -10,12 +10,34 @@
 #include "xenia/gpu/shared_memory.h"
 
 #include <algorithm>
+#include <cstring>
 
 #include "xenia/base/assert.h"
 #include "xenia/base/bit_range.h"
+#include "xenia/base/cvar.h"
 #include "xenia/base/logging.h"
 #include "xenia/base/profiling.h"
 
+DEFINE_uint32(
+    shared_memory_upload_merge_gap_pages, 0,
+    "Maximum number of already up-to-date pages between two ranges of pages "
+    "requested for uploading from the guest memory to the shared memory to "
+    "upload them as a single range, reducing the number of copy commands at "
+    "the cost of copying some data again. Pages written by the GPU are never "
+    "uploaded again.",
+    "GPU");
+DEFINE_uint32(
+    shared_memory_sparse_dense_block_log2, 0,
+    "Log2 of the size of blocks of the shared memory in which all the sparse "
+    "allocations (of the granularity preferred by the host GPU API) are made "
+    "at once when the GPU starts accessing another part of a block that "
+    "already has some memory allocated for it, reducing the number of tile "
+    "heaps or memory allocations for regions densely used by the GPU at the "
+    "cost of some video memory (for instance, 24 for 16 MB). Sparse "
+    "allocations are made individually if this is 0 or not larger than the "
+    "host allocation granularity.",
+    "GPU");
+
 namespace xe {
 namespace gpu {
 
@@ -48,6 +70,15 @@ void SharedMemory::InitializeCommon() {
          8 * num_system_page_flags_entries);
   memset(system_page_flags_valid_and_gpu_written_, 0,
          8 * num_system_page_flags_entries);
+  assert_true(((num_system_page_flags_ + 63) >> 6) <= kSystemPageFlagsL2Count);
+  std::memset(system_page_flags_valid_any_l2_, 0,
+              sizeof(system_page_flags_valid_any_l2_));
+  std::memset(system_page_flags_valid_all_l2_, 0,
+              sizeof(system_page_flags_valid_all_l2_));
+  std::memset(system_page_flags_gpu_written_any_l2_, 0,
+              sizeof(system_page_flags_gpu_written_any_l2_));
+  std::memset(system_page_flags_gpu_resolved_any_l2_, 0,
+              sizeof(system_page_flags_gpu_resolved_any_l2_));
   memory_invalidation_callback_handle_ =
       memory_.RegisterPhysicalMemoryInvalidationCallback(
           MemoryInvalidationCallbackThunk, this);
@@ -88,6 +119,7 @@ void SharedMemory::ShutdownCommon() {
     memory_invalidation_callback_handle_ = nullptr;
   }
 
+  LogHostGpuMemorySparseStatistics();
   if (host_gpu_memory_sparse_used_bytes_) {
     host_gpu_memory_sparse_used_bytes_ = 0;
     COUNT_profile_set("gpu/shared_memory/host_gpu_memory_sparse_used_mb", 0);
@@ -97,6 +129,7 @@ void SharedMemory::ShutdownCommon() {
     COUNT_profile_set("gpu/shared_memory/host_gpu_memory_sparse_allocations",
                       0);
   }
+  host_gpu_memory_sparse_dense_block_bytes_ = 0;
   host_gpu_memory_sparse_allocated_.clear();
   host_gpu_memory_sparse_allocated_.shrink_to_fit();
   host_gpu_memory_sparse_granularity_log2_ = UINT32_MAX;
@@ -125,6 +158,7 @@ void SharedMemory::ClearCache() {
     delete[] pool;
   }
   watch_range_pools_.clear();
+  LogHostGpuMemorySparseStatistics();
   SetSystemPageBlocksValidWithGpuDataWritten();
 }
 
@@ -133,6 +167,7 @@ void SharedMemory::SetSystemPageBlocksValidWithGpuDataWritten() {
 
   for (unsigned i = 0; i < num_system_page_flags_; ++i) {
     system_page_flags_valid_[i] = system_page_flags_valid_and_gpu_written_[i];
+    UpdateSystemPageFlagsL2(i);
   }
 }
 
@@ -301,6 +336,87 @@ void SharedMemory::RangeWrittenByGpu(uint32_t start, uint32_t length,
   MakeRangeValid(start, length, true, is_resolve);
 }
 
+bool SharedMemory::IsRangeWrittenByGpu(uint32_t start, uint32_t length) {
+  if (length == 0 || start >= kBufferSize) {
+    return false;
+  }
+  length = std::min(length, kBufferSize - start);
+  auto global_lock = global_critical_region_.Acquire();
+  return ArePagesWrittenByGpu(start >> page_size_log2_,
+                              (start + length - 1) >> page_size_log2_);
+}
+
+// Returns the first block in [block_first, block_last] with its second level
+// bit set in the words returned by get_l2_word, or UINT32_MAX if none.
+template <typename GetL2Word>
+static uint32_t FindSystemPageFlagsL2Block(uint32_t block_first,
+                                           uint32_t block_last,
+                                           const GetL2Word& get_l2_word) {
+  if (block_first > block_last) {
+    return UINT32_MAX;
+  }
+  uint32_t l2_first = block_first >> 6;
+  uint32_t l2_last = block_last >> 6;
+  for (uint32_t i = l2_first; i <= l2_last; ++i) {
+    uint64_t l2_word = get_l2_word(i);
+    if (i == l2_first) {
+      l2_word &= ~((uint64_t(1) << (block_first & 63)) - 1);
+    }
+    if (i == l2_last && (block_last & 63) != 63) {
+      l2_word &= (uint64_t(1) << ((block_last & 63) + 1)) - 1;
+    }
+    uint32_t l2_bit;
+    if (xe::bit_scan_forward(l2_word, &l2_bit)) {
+      return (i << 6) + l2_bit;
+    }
+  }
+  return UINT32_MAX;
+}
+
+void SharedMemory::UpdateSystemPageFlagsL2(uint32_t block_index) {
+  uint32_t l2_index = block_index >> 6;
+  uint64_t l2_bit = uint64_t(1) << (block_index & 63);
+  uint64_t block_valid = system_page_flags_valid_[block_index];
+  auto update_bit = [l2_index, l2_bit](uint64_t* l2, bool set) {
+    if (set) {
+      l2[l2_index] |= l2_bit;
+    } else {
+      l2[l2_index] &= ~l2_bit;
+    }
+  };
+  update_bit(system_page_flags_valid_any_l2_, block_valid != 0);
+  update_bit(system_page_flags_valid_all_l2_, block_valid == UINT64_MAX);
+  update_bit(system_page_flags_gpu_written_any_l2_,
+             system_page_flags_valid_and_gpu_written_[block_index] != 0);
+  update_bit(system_page_flags_gpu_resolved_any_l2_,
+             system_page_flags_valid_and_gpu_resolved_[block_index] != 0);
+}
+
+bool SharedMemory::ArePagesWrittenByGpu(uint32_t page_first,
+                                        uint32_t page_last) const {
+  uint32_t block_first = page_first >> 6;
+  uint32_t block_last = page_last >> 6;
+  auto get_l2_word = [this](uint32_t l2_index) {
+    return system_page_flags_gpu_written_any_l2_[l2_index];
+  };
+  for (uint32_t i = FindSystemPageFlagsL2Block(block_first, block_last,
+                                               get_l2_word);
+       i != UINT32_MAX;
+       i = FindSystemPageFlagsL2Block(i + 1, block_last, get_l2_word)) {
+    uint64_t block_gpu_written = system_page_flags_valid_and_gpu_written_[i];
+    if (i == block_first) {
+      block_gpu_written &= ~((uint64_t(1) << (page_first & 63)) - 1);
+    }
+    if (i == block_last && (page_last & 63) != 63) {
+      block_gpu_written &= (uint64_t(1) << ((page_last & 63) + 1)) - 1;
+    }
+    if (block_gpu_written) {
+      return true;
+    }
+  }
+  return false;
+}
+
 bool SharedMemory::AllocateSparseHostGpuMemoryRange(
     uint32_t offset_allocations, uint32_t length_allocations) {
   assert_always(
@@ -346,6 +462,7 @@ void SharedMemory::MakeRangeValid(uint32_t start, uint32_t length,
       } else {
         system_page_flags_valid_and_gpu_resolved_[i] &= ~valid_bits;
       }
+      UpdateSystemPageFlagsL2(i);
     }
   }
 
@@ -353,7 +470,7 @@ void SharedMemory::MakeRangeValid(uint32_t start, uint32_t length,
     memory().EnablePhysicalMemoryAccessCallbacks(
         valid_page_first << page_size_log2_,
         (valid_page_last - valid_page_first + 1) << page_size_log2_, true,
-        false);
+        false, memory_invalidation_callback_handle_);
   }
 }
 
@@ -419,10 +536,30 @@ bool SharedMemory::RequestRange(uint32_t start, uint32_t length,
     TryFindUploadRange(block_first, block_last, page_first, page_last,
                        any_data_resolved, range_start, current_upload_range,
                        uploads);
-  }
-  if (range_start != UINT32_MAX) {
-    uploads[current_upload_range++] =
-        (std::make_pair(range_start, page_last + 1 - range_start));
+    if (range_start != UINT32_MAX) {
+      uploads[current_upload_range++] =
+          (std::make_pair(range_start, page_last + 1 - range_start));
+    }
+    uint32_t merge_gap_pages = cvars::shared_memory_upload_merge_gap_pages;
+    if (merge_gap_pages && current_upload_range > 1) {
+      // Merge the ranges separated by short runs of valid pages that contain
+      // the same data as the guest memory.
+      unsigned int merged_upload_range_count = 1;
+      for (unsigned int i = 1; i < current_upload_range; ++i) {
+        std::pair<uint32_t, uint32_t>& merged_range =
+            uploads[merged_upload_range_count - 1];
+        uint32_t gap_first = merged_range.first + merged_range.second;
+        uint32_t gap_length = uploads[i].first - gap_first;
+        if (gap_length <= merge_gap_pages &&
+            (!gap_length ||
+             !ArePagesWrittenByGpu(gap_first, gap_first + gap_length - 1))) {
+          merged_range.second += gap_length + uploads[i].second;
+        } else {
+          uploads[merged_upload_range_count++] = uploads[i];
+        }
+      }
+      current_upload_range = merged_upload_range_count;
+    }
   }
   if (any_data_resolved_out) {
     *any_data_resolved_out = any_data_resolved;
@@ -451,7 +588,22 @@ void SharedMemory::TryFindUploadRange(const uint32_t& block_first,
                                       uint32_t& range_start,
                                       unsigned int& current_upload_range,
                                       std::pair<uint32_t, uint32_t>* uploads) {
-  for (uint32_t i = block_first; i <= block_last; ++i) {
+  // Only the blocks that may open or close an upload range, or contain
+  // resolved data while none has been found yet, need to be checked - not the
+  // fully valid ones if no range is open, or the fully invalid ones if it is.
+  auto get_l2_word = [&](uint32_t l2_index) {
+    uint64_t l2_word = range_start == UINT32_MAX
+                           ? ~system_page_flags_valid_all_l2_[l2_index]
+                           : system_page_flags_valid_any_l2_[l2_index];
+    if (!any_data_resolved) {
+      l2_word |= system_page_flags_gpu_resolved_any_l2_[l2_index];
+    }
+    return l2_word;
+  };
+  for (uint32_t i = FindSystemPageFlagsL2Block(block_first, block_last,
+                                               get_l2_word);
+       i != UINT32_MAX;
+       i = FindSystemPageFlagsL2Block(i + 1, block_last, get_l2_word)) {
     // const SystemPageFlagsBlock& block = system_page_flags_[i];
     uint64_t block_valid = system_page_flags_valid_[i];
     uint64_t block_resolved = 0;
@@ -585,7 +737,14 @@ std::pair<uint32_t, uint32_t> SharedMemory::MemoryInvalidationCallback(
     }
   }
 
-  for (uint32_t i = block_first; i <= block_last; ++i) {
+  // Blocks without valid pages have nothing to invalidate.
+  auto get_l2_word = [this](uint32_t l2_index) {
+    return system_page_flags_valid_any_l2_[l2_index];
+  };
+  for (uint32_t i = FindSystemPageFlagsL2Block(block_first, block_last,
+                                               get_l2_word);
+       i != UINT32_MAX;
+       i = FindSystemPageFlagsL2Block(i + 1, block_last, get_l2_word)) {
     uint64_t invalidate_bits = UINT64_MAX;
     if (i == block_first) {
       invalidate_bits &= ~((uint64_t(1) << (page_first & 63)) - 1);
@@ -596,6 +755,7 @@ std::pair<uint32_t, uint32_t> SharedMemory::MemoryInvalidationCallback(
     system_page_flags_valid_[i] &= ~invalidate_bits;
     system_page_flags_valid_and_gpu_resolved_[i] &= ~invalidate_bits;
     system_page_flags_valid_and_gpu_written_[i] &= ~invalidate_bits;
+    UpdateSystemPageFlagsL2(i);
   }
 
   FireWatches(page_first, page_last, false);
@@ -621,6 +781,7 @@ void SharedMemory::PrepareForTraceDownload() {
     uint64_t previously_valid_block = system_page_flags_valid_[i];
     uint64_t gpu_written_block = system_page_flags_valid_and_gpu_written_[i];
     system_page_flags_valid_[i] = gpu_written_block;
+    UpdateSystemPageFlagsL2(i);
 
     // Fire watches on the invalidated pages.
     uint64_t fire_watches_block = previously_valid_block & ~gpu_written_block;
@@ -715,6 +876,34 @@ bool SharedMemory::EnsureHostGpuMemoryAllocated(uint32_t start,
                                   host_gpu_memory_sparse_granularity_log2_;
       uint32_t allocation_last = page_last << page_size_log2_ >>
                                  host_gpu_memory_sparse_granularity_log2_;
+      uint32_t requested_allocation_first = allocation_first;
+      uint32_t requested_allocation_last = allocation_last;
+      if (cvars::shared_memory_sparse_dense_block_log2 >
+          host_gpu_memory_sparse_granularity_log2_) {
+        // If the blocks containing the range already have something allocated
+        // in them, the GPU is likely to access more of them, so allocate the
+        // rest of the blocks entirely to avoid creating many small allocations.
+        uint32_t block_allocations_log2 =
+            std::min(cvars::shared_memory_sparse_dense_block_log2,
+                     kBufferSizeLog2) -
+            host_gpu_memory_sparse_granularity_log2_;
+        uint32_t block_allocation_first = allocation_first >>
+                                          block_allocations_log2
+                                          << block_allocations_log2;
+        uint32_t block_allocation_count =
+            (((allocation_last >> block_allocations_log2) + 1)
+             << block_allocations_log2) -
+            block_allocation_first;
+        std::pair<size_t, size_t> block_unallocated_range =
+            xe::bit_range::NextUnsetRange(
+                host_gpu_memory_sparse_allocated_.data(),
+                block_allocation_first, block_allocation_count);
+        if (block_unallocated_range.first != block_allocation_first ||
+            block_unallocated_range.second != block_allocation_count) {
+          allocation_first = block_allocation_first;
+          allocation_last = block_allocation_first + block_allocation_count - 1;
+        }
+      }
       while (true) {
         std::pair<size_t, size_t> allocation_range =
             xe::bit_range::NextUnsetRange(
@@ -738,6 +927,20 @@ bool SharedMemory::EnsureHostGpuMemoryAllocated(uint32_t start,
         host_gpu_memory_sparse_used_bytes_ +=
             uint32_t(allocation_range.second)
             << host_gpu_memory_sparse_granularity_log2_;
+        // Statistics of how much is allocated ahead of time by the dense block
+        // mode.
+        size_t requested_overlap_first = std::max(
+            size_t(requested_allocation_first), allocation_range.first);
+        size_t requested_overlap_end =
+            std::min(size_t(requested_allocation_last) + 1,
+                     allocation_range.first + allocation_range.second);
+        size_t requested_allocation_count =
+            requested_overlap_end > requested_overlap_first
+                ? requested_overlap_end - requested_overlap_first
+                : 0;
+        host_gpu_memory_sparse_dense_block_bytes_ +=
+            uint32_t(allocation_range.second - requested_allocation_count)
+            << host_gpu_memory_sparse_granularity_log2_;
         COUNT_profile_set(
             "gpu/shared_memory/host_gpu_memory_sparse_used_mb",
             (host_gpu_memory_sparse_used_bytes_ + ((1 << 20) - 1)) >> 20);
@@ -753,5 +956,33 @@ bool SharedMemory::EnsureHostGpuMemoryAllocated(uint32_t start,
   return true;
 }
 
+void SharedMemory::LogHostGpuMemorySparseStatistics() {
+  if (host_gpu_memory_sparse_granularity_log2_ == UINT32_MAX ||
+      !host_gpu_memory_sparse_used_bytes_ || !system_page_flags_valid_) {
+    return;
+  }
+  // Pages currently containing up-to-date data, for comparison with the
+  // allocated amount to see how sparsely the allocated memory is actually
+  // used.
+  uint32_t valid_page_count = 0;
+  uint32_t gpu_written_page_count = 0;
+  uint32_t page_flags_block_count = (kBufferSize >> page_size_log2_) / 64;
+  for (uint32_t i = 0; i < page_flags_block_count; ++i) {
+    valid_page_count += xe::bit_count(system_page_flags_valid_[i]);
+    gpu_written_page_count +=
+        xe::bit_count(system_page_flags_valid_and_gpu_written_[i]);
+  }
+  XELOGGPU(
+      "Shared memory: {} MB of {} MB allocated sparsely in {} allocations of "
+      "{} KB granularity, {} MB of it ahead of time in dense blocks, {} "
+      "MB valid, {} MB written by the GPU",
+      (host_gpu_memory_sparse_used_bytes_ + ((1 << 20) - 1)) >> 20,
+      kBufferSize >> 20, host_gpu_memory_sparse_allocations_,
+      (uint32_t(1) << host_gpu_memory_sparse_granularity_log2_) >> 10,
+      (host_gpu_memory_sparse_dense_block_bytes_ + ((1 << 20) - 1)) >> 20,
+      (valid_page_count << page_size_log2_) >> 20,
+      (gpu_written_page_count << page_size_log2_) >> 20);
+}
+
 }  // namespace gpu
 }  // namespace xe
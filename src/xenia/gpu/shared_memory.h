@@ -28,6 +28,12 @@ class SharedMemory {
   virtual void ClearCache();
   virtual void SetSystemPageBlocksValidWithGpuDataWritten();
 
+  // Guest data in the physical memory, for reading the CPU-written contents
+  // before they are requested for the GPU.
+  const uint8_t* TranslatePhysical(uint32_t physical_address) const {
+    return memory_.TranslatePhysical<const uint8_t*>(physical_address);
+  }
+
   typedef void (*GlobalWatchCallback)(
       const global_unique_lock_type& global_lock, void* context,
       uint32_t address_first, uint32_t address_last, bool invalidated_by_gpu);
@@ -102,6 +108,10 @@ class SharedMemory {
   // regions in those pages.
   void RangeWrittenByGpu(uint32_t start, uint32_t length, bool is_resolve);
 
+  // Whether any page in the range contains data written on the GPU (by
+  // resolves or memexport), that may be not in the guest memory.
+  bool IsRangeWrittenByGpu(uint32_t start, uint32_t length);
+
  protected:
   SharedMemory(Memory& memory);
   // Call in implementation-specific initialization.
@@ -174,10 +184,20 @@ class SharedMemory {
   uint32_t page_size_log2_;
 
   bool EnsureHostGpuMemoryAllocated(uint32_t start, uint32_t length);
+  // Writes the residency of the sparse host GPU memory to the log, called
+  // before the cache is cleared (such as when the title is switched) and on
+  // shutdown.
+  void LogHostGpuMemorySparseStatistics();
+
+  // Must be called with the global critical region locked.
+  bool ArePagesWrittenByGpu(uint32_t page_first, uint32_t page_last) const;
   uint32_t host_gpu_memory_sparse_granularity_log2_ = UINT32_MAX;
   std::vector<uint64_t> host_gpu_memory_sparse_allocated_;
   uint32_t host_gpu_memory_sparse_allocations_ = 0;
   uint32_t host_gpu_memory_sparse_used_bytes_ = 0;
+  // Part of host_gpu_memory_sparse_used_bytes_ allocated before being needed
+  // because of the dense block mode.
+  uint32_t host_gpu_memory_sparse_dense_block_bytes_ = 0;
 
   void* memory_invalidation_callback_handle_ = nullptr;
   void* memory_data_provider_handle_ = nullptr;
@@ -218,6 +238,25 @@ class SharedMemory {
            *system_page_flags_valid_and_gpu_written_ = nullptr,
            *system_page_flags_valid_and_gpu_resolved_ = nullptr;
   unsigned num_system_page_flags_ = 0;
+
+  // Second level of the page flags, with a bit for each block of 64 pages, so
+  // blocks without the pages being looked for can be skipped when scanning
+  // large ranges. >> 12 for 4 KB pages (the smallest host page size), >> 6 for
+  // the uint64_t blocks, >> 6 for the uint64_t second level bits.
+  static constexpr uint32_t kSystemPageFlagsL2Count =
+      kBufferSize >> (12 + 6 + 6);
+  // Whether any page in the block is valid.
+  uint64_t system_page_flags_valid_any_l2_[kSystemPageFlagsL2Count] = {};
+  // Whether all pages in the block are valid.
+  uint64_t system_page_flags_valid_all_l2_[kSystemPageFlagsL2Count] = {};
+  // Whether any page in the block is valid and written by the GPU.
+  uint64_t system_page_flags_gpu_written_any_l2_[kSystemPageFlagsL2Count] =
+      {};
+  // Whether any page in the block is valid and resolved by the GPU.
+  uint64_t system_page_flags_gpu_resolved_any_l2_[kSystemPageFlagsL2Count] =
+      {};
+  // Updates the second level bits of a block after modifying its flags.
+  void UpdateSystemPageFlagsL2(uint32_t block_index);
   static std::pair<uint32_t, uint32_t> MemoryInvalidationCallbackThunk(
       void* context_ptr, uint32_t physical_address_start, uint32_t length,
       bool exact_range);
@@ -136,6 +136,8 @@ void SpirvShaderTranslator::Reset() {
 
   main_switch_op_.reset();
   main_switch_next_pc_phi_operands_.clear();
+  cf_structured_ifs_.clear();
+  cf_structured_loops_.clear();
 
   cf_exec_conditional_merge_ = nullptr;
   cf_instruction_predicate_merge_ = nullptr;
@@ -570,9 +572,9 @@ void SpirvShaderTranslator::StartTranslation() {
   main_loop_merge_ = new spv::Block(builder_->getUniqueId(), *function_main_);
   builder_->createBranch(main_loop_header_);
 
-  // If no jumps, don't create a switch, but still create a loop so exece can
-  // break.
-  bool has_main_switch = !current_shader().label_addresses().empty();
+  // If no jumps, or they're translated to structured control flow, don't
+  // create a switch, but still create a loop so exece can break.
+  bool has_main_switch = HasMainSwitch();
 
   // Main loop header - based on whether it's the first iteration (entered from
   // the function or from the continuation), choose the program counter.
@@ -627,7 +629,7 @@ std::vector<uint8_t> SpirvShaderTranslator::CompleteTranslation() {
   if (!is_depth_only_fragment_shader_) {
     // Close flow control within the last switch case.
     CloseExecConditionals();
-    bool has_main_switch = !current_shader().label_addresses().empty();
+    bool has_main_switch = HasMainSwitch();
     // After the final exec (if it happened to be not exece, which would already
     // have a break branch), break from the switch if it exists, or from the
     // loop it doesn't.
@@ -849,9 +851,8 @@ void SpirvShaderTranslator::ProcessExecInstructionEnd(
     // Break out of the main switch (if exists) and the main loop.
     CloseInstructionPredication();
     if (!builder_->getBuildPoint()->isTerminated()) {
-      builder_->createBranch(current_shader().label_addresses().empty()
-                                 ? main_loop_merge_
-                                 : main_switch_merge_);
+      builder_->createBranch(HasMainSwitch() ? main_switch_merge_
+                                             : main_loop_merge_);
     }
   }
   UpdateExecConditionals(instr.type, instr.bool_constant_index,
@@ -886,13 +887,30 @@ void SpirvShaderTranslator::ProcessLoopStartInstruction(
 
   spv::Id const_int_8 = builder_->makeIntConstant(8);
 
+  spv::Id loop_count_new =
+      builder_->createTriOp(spv::OpBitFieldUExtract, type_uint_, loop_constant,
+                            const_int_0_, const_int_8);
+  spv::Id loop_count_zero = builder_->createBinOp(
+      spv::OpIEqual, type_bool_, loop_count_new, const_uint_0_);
+
+  // With structured control flow, skip the loop without pushing if the count is
+  // 0, with the merge after the host loop.
+  spv::Block* structured_skip_merge_block = nullptr;
+  if (is_control_flow_structured()) {
+    structured_skip_merge_block =
+        new spv::Block(builder_->getUniqueId(), *function_main_);
+    spv::Block& enter_block = builder_->makeNewBlock();
+    builder_->createSelectionMerge(structured_skip_merge_block,
+                                   spv::SelectionControlMaskNone);
+    builder_->createConditionalBranch(
+        loop_count_zero, structured_skip_merge_block, &enter_block);
+    builder_->setBuildPoint(&enter_block);
+  }
+
   // Push the count to the loop count stack - move XYZ to YZW and set X to the
   // new iteration count (swizzling the way glslang does it for similar GLSL).
   spv::Id loop_count_stack_old =
       builder_->createLoad(var_main_loop_count_, spv::NoPrecision);
-  spv::Id loop_count_new =
-      builder_->createTriOp(spv::OpBitFieldUExtract, type_uint_, loop_constant,
-                            const_int_0_, const_int_8);
   id_vector_temp_.clear();
   id_vector_temp_.push_back(loop_count_new);
   for (unsigned int i = 0; i < 3; ++i) {
@@ -927,11 +945,31 @@ void SpirvShaderTranslator::ProcessLoopStartInstruction(
       builder_->createCompositeConstruct(type_int4_, id_vector_temp_),
       var_main_loop_address_);
 
+  if (is_control_flow_structured()) {
+    // Open the host loop, closed in ProcessLoopEndInstruction.
+    StructuredLoop structured_loop;
+    structured_loop.header_block = &builder_->makeNewBlock();
+    structured_loop.continue_block =
+        new spv::Block(builder_->getUniqueId(), *function_main_);
+    structured_loop.merge_block =
+        new spv::Block(builder_->getUniqueId(), *function_main_);
+    structured_loop.skip_merge_block = structured_skip_merge_block;
+    builder_->createBranch(structured_loop.header_block);
+    builder_->setBuildPoint(structured_loop.header_block);
+    uint_vector_temp_.clear();
+    builder_->createLoopMerge(
+        structured_loop.merge_block, structured_loop.continue_block,
+        spv::LoopControlMaskNone, uint_vector_temp_);
+    spv::Block& loop_body_block = builder_->makeNewBlock();
+    builder_->createBranch(&loop_body_block);
+    builder_->setBuildPoint(&loop_body_block);
+    cf_structured_loops_.push_back(structured_loop);
+    return;
+  }
+
   // Break (jump to the skip label) if the loop counter is 0 (since the
   // condition is checked in the end).
   spv::Block& head_block = *builder_->getBuildPoint();
-  spv::Id loop_count_zero = builder_->createBinOp(
-      spv::OpIEqual, type_bool_, loop_count_new, const_uint_0_);
   spv::Block& skip_block = builder_->makeNewBlock();
   spv::Block& body_block = builder_->makeNewBlock();
   builder_->createSelectionMerge(&body_block, spv::SelectionControlMaskNone);
@@ -964,7 +1002,21 @@ void SpirvShaderTranslator::ProcessLoopEndInstruction(
   // Loop control is outside execs - actually close the last exec.
   CloseExecConditionals();
 
-  EnsureBuildPointAvailable();
+  // With structured control flow, the loop counter is checked in the continue
+  // construct of the host loop.
+  StructuredLoop structured_loop = {};
+  if (is_control_flow_structured()) {
+    assert_false(cf_structured_loops_.empty());
+    structured_loop = cf_structured_loops_.back();
+    cf_structured_loops_.pop_back();
+    if (!builder_->getBuildPoint()->isTerminated()) {
+      builder_->createBranch(structured_loop.continue_block);
+    }
+    function_main_->addBlock(structured_loop.continue_block);
+    builder_->setBuildPoint(structured_loop.continue_block);
+  } else {
+    EnsureBuildPointAvailable();
+  }
 
   // Subtract 1 from the loop counter (will store later).
   spv::Id loop_count_stack_old =
@@ -993,33 +1045,41 @@ void SpirvShaderTranslator::ProcessLoopEndInstruction(
         builder_->createLoad(var_main_predicate_, spv::NoPrecision));
   }
 
+  bool structured = is_control_flow_structured();
   spv::Block& body_block = *builder_->getBuildPoint();
-  spv::Block& continue_block = builder_->makeNewBlock();
-  spv::Block& break_block = builder_->makeNewBlock();
-  builder_->createSelectionMerge(&break_block, spv::SelectionControlMaskNone);
-  {
+  spv::Block* continue_block;
+  spv::Block* break_block;
+  if (structured) {
+    // Already in the continue construct, where the loop count and aL are
+    // updated unconditionally - if breaking, they're popped anyway.
+    continue_block = &body_block;
+    break_block = structured_loop.merge_block;
+  } else {
+    continue_block = &builder_->makeNewBlock();
+    break_block = &builder_->makeNewBlock();
+    builder_->createSelectionMerge(break_block, spv::SelectionControlMaskNone);
     std::unique_ptr<spv::Instruction> branch_conditional_op =
         std::make_unique<spv::Instruction>(spv::OpBranchConditional);
     branch_conditional_op->addIdOperand(condition);
     // More likely to continue than to break.
     if (break_is_true) {
-      branch_conditional_op->addIdOperand(break_block.getId());
-      branch_conditional_op->addIdOperand(continue_block.getId());
+      branch_conditional_op->addIdOperand(break_block->getId());
+      branch_conditional_op->addIdOperand(continue_block->getId());
       branch_conditional_op->addImmediateOperand(1);
       branch_conditional_op->addImmediateOperand(2);
     } else {
-      branch_conditional_op->addIdOperand(continue_block.getId());
-      branch_conditional_op->addIdOperand(break_block.getId());
+      branch_conditional_op->addIdOperand(continue_block->getId());
+      branch_conditional_op->addIdOperand(break_block->getId());
       branch_conditional_op->addImmediateOperand(2);
       branch_conditional_op->addImmediateOperand(1);
     }
     body_block.addInstruction(std::move(branch_conditional_op));
+    continue_block->addPredecessor(&body_block);
+    break_block->addPredecessor(&body_block);
   }
-  continue_block.addPredecessor(&body_block);
-  break_block.addPredecessor(&body_block);
 
   // Continue case.
-  builder_->setBuildPoint(&continue_block);
+  builder_->setBuildPoint(continue_block);
   // Store the loop count with 1 subtracted.
   builder_->createStore(builder_->createCompositeInsert(
                             loop_count, loop_count_stack_old, type_uint4_, 0),
@@ -1053,15 +1113,27 @@ void SpirvShaderTranslator::ProcessLoopEndInstruction(
                   builder_->makeIntConstant(16), builder_->makeIntConstant(8))),
           address_relative_stack_old, type_int4_, 0),
       var_main_loop_address_);
-  // Jump back to the beginning of the loop body.
-  main_switch_next_pc_phi_operands_.push_back(
-      builder_->makeIntConstant(int(instr.loop_body_address)));
-  main_switch_next_pc_phi_operands_.push_back(
-      builder_->getBuildPoint()->getId());
-  builder_->createBranch(main_loop_continue_);
+  if (structured) {
+    // Back edge to the host loop header, or exit from the loop.
+    if (break_is_true) {
+      builder_->createConditionalBranch(condition, break_block,
+                                        structured_loop.header_block);
+    } else {
+      builder_->createConditionalBranch(condition, structured_loop.header_block,
+                                        break_block);
+    }
+    function_main_->addBlock(break_block);
+  } else {
+    // Jump back to the beginning of the loop body.
+    main_switch_next_pc_phi_operands_.push_back(
+        builder_->makeIntConstant(int(instr.loop_body_address)));
+    main_switch_next_pc_phi_operands_.push_back(
+        builder_->getBuildPoint()->getId());
+    builder_->createBranch(main_loop_continue_);
+  }
 
   // Break case.
-  builder_->setBuildPoint(&break_block);
+  builder_->setBuildPoint(break_block);
   // Pop the current loop off the loop counter and the relative address stacks -
   // move YZW to XYZ and set W to 0.
   id_vector_temp_.clear();
@@ -1082,6 +1154,12 @@ void SpirvShaderTranslator::ProcessLoopEndInstruction(
   builder_->createStore(
       builder_->createCompositeConstruct(type_int4_, id_vector_temp_),
       var_main_loop_address_);
+  if (structured) {
+    // Leave the conditional skipping the loop if the count was 0.
+    builder_->createBranch(structured_loop.skip_merge_block);
+    function_main_->addBlock(structured_loop.skip_merge_block);
+    builder_->setBuildPoint(structured_loop.skip_merge_block);
+  }
   // Now going to fall through to the next control flow instruction.
 }
 
@@ -1115,6 +1193,88 @@ void SpirvShaderTranslator::ProcessJumpInstruction(
   builder_->createBranch(main_loop_continue_);
 }
 
+void SpirvShaderTranslator::ProcessStructuredIfBegin(
+    const ParsedJumpInstruction& instr, bool has_else) {
+  // The block contains other execs, not mergeable with the previous ones.
+  CloseExecConditionals();
+
+  EnsureBuildPointAvailable();
+  // Whether the jump is taken is checked against instr.condition.
+  // Unconditional jumps are only structured as else blocks, not as conditional
+  // blocks.
+  spv::Id condition_id;
+  if (instr.type == ParsedJumpInstruction::Type::kConditional) {
+    id_vector_temp_.clear();
+    // Bool constants (member 0).
+    id_vector_temp_.push_back(const_int_0_);
+    // 128-bit vector.
+    id_vector_temp_.push_back(
+        builder_->makeIntConstant(int(instr.bool_constant_index >> 7)));
+    // 32-bit scalar of a 128-bit vector.
+    id_vector_temp_.push_back(
+        builder_->makeIntConstant(int((instr.bool_constant_index >> 5) & 3)));
+    spv::Id bool_constant_scalar =
+        builder_->createLoad(builder_->createAccessChain(
+                                 spv::StorageClassUniform,
+                                 uniform_bool_loop_constants_, id_vector_temp_),
+                             spv::NoPrecision);
+    condition_id = builder_->createBinOp(
+        spv::OpINotEqual, type_bool_,
+        builder_->createBinOp(
+            spv::OpBitwiseAnd, type_uint_, bool_constant_scalar,
+            builder_->makeUintConstant(uint32_t(1)
+                                       << (instr.bool_constant_index & 31))),
+        const_uint_0_);
+  } else {
+    assert_true(instr.type == ParsedJumpInstruction::Type::kPredicated);
+    condition_id = builder_->createLoad(var_main_predicate_, spv::NoPrecision);
+  }
+
+  spv::Function& function = builder_->getBuildPoint()->getParent();
+  StructuredIf structured_if;
+  structured_if.else_block =
+      has_else ? new spv::Block(builder_->getUniqueId(), function) : nullptr;
+  structured_if.merge_block = new spv::Block(builder_->getUniqueId(), function);
+  spv::Block* taken_block =
+      has_else ? structured_if.else_block : structured_if.merge_block;
+  spv::Block& not_taken_block = builder_->makeNewBlock();
+  builder_->createSelectionMerge(structured_if.merge_block,
+                                 spv::SelectionControlDontFlattenMask);
+  builder_->createConditionalBranch(
+      condition_id, instr.condition ? taken_block : &not_taken_block,
+      instr.condition ? &not_taken_block : taken_block);
+  builder_->setBuildPoint(&not_taken_block);
+  cf_structured_ifs_.push_back(structured_if);
+}
+
+void SpirvShaderTranslator::ProcessStructuredElse() {
+  CloseExecConditionals();
+  assert_false(cf_structured_ifs_.empty());
+  StructuredIf& structured_if = cf_structured_ifs_.back();
+  assert_not_null(structured_if.else_block);
+  spv::Block& then_block = *builder_->getBuildPoint();
+  if (!then_block.isTerminated()) {
+    builder_->createBranch(structured_if.merge_block);
+  }
+  then_block.getParent().addBlock(structured_if.else_block);
+  builder_->setBuildPoint(structured_if.else_block);
+  structured_if.else_block = nullptr;
+}
+
+void SpirvShaderTranslator::ProcessStructuredIfEnd() {
+  CloseExecConditionals();
+  assert_false(cf_structured_ifs_.empty());
+  const StructuredIf& structured_if = cf_structured_ifs_.back();
+  assert_null(structured_if.else_block);
+  spv::Block& inner_block = *builder_->getBuildPoint();
+  if (!inner_block.isTerminated()) {
+    builder_->createBranch(structured_if.merge_block);
+  }
+  inner_block.getParent().addBlock(structured_if.merge_block);
+  builder_->setBuildPoint(structured_if.merge_block);
+  cf_structured_ifs_.pop_back();
+}
+
 void SpirvShaderTranslator::ProcessAllocInstruction(
     const ParsedAllocInstruction& instr, uint8_t export_eM) {
   bool start_memexport = instr.type == ucode::AllocType::kMemory &&
@@ -2857,6 +3017,44 @@ void SpirvShaderTranslator::StoreResult(const InstructionResult& result,
 }
 
 spv::Id SpirvShaderTranslator::EndianSwap32Uint(spv::Id value, spv::Id endian) {
+  // 8-in-16 or one half of 8-in-32 (doing 8-in-16 swap).
+  spv::Id is_8in16 = builder_->createBinOp(
+      spv::OpIEqual, type_bool_, endian,
+      builder_->makeUintConstant(
+          static_cast<unsigned int>(xenos::Endian::k8in16)));
+  spv::Id is_8in32 = builder_->createBinOp(
+      spv::OpIEqual, type_bool_, endian,
+      builder_->makeUintConstant(
+          static_cast<unsigned int>(xenos::Endian::k8in32)));
+  spv::Id is_8in16_or_8in32 =
+      builder_->createBinOp(spv::OpLogicalOr, type_bool_, is_8in16, is_8in32);
+  SpirvBuilder::IfBuilder if_8in16(is_8in16_or_8in32,
+                                   spv::SelectionControlMaskNone, *builder_);
+  spv::Id swapped_8in16 = EndianSwap32Uint(value, xenos::Endian::k8in16);
+  if_8in16.makeEndIf();
+  value = if_8in16.createMergePhi(swapped_8in16, value);
+
+  // 16-in-32 or another half of 8-in-32 (doing 16-in-32 swap).
+  spv::Id is_16in32 = builder_->createBinOp(
+      spv::OpIEqual, type_bool_, endian,
+      builder_->makeUintConstant(
+          static_cast<unsigned int>(xenos::Endian::k16in32)));
+  spv::Id is_8in32_or_16in32 =
+      builder_->createBinOp(spv::OpLogicalOr, type_bool_, is_8in32, is_16in32);
+  SpirvBuilder::IfBuilder if_16in32(is_8in32_or_16in32,
+                                    spv::SelectionControlMaskNone, *builder_);
+  spv::Id swapped_16in32 = EndianSwap32Uint(value, xenos::Endian::k16in32);
+  if_16in32.makeEndIf();
+  value = if_16in32.createMergePhi(swapped_16in32, value);
+
+  return value;
+}
+
+spv::Id SpirvShaderTranslator::EndianSwap32Uint(spv::Id value,
+                                                xenos::Endian endian) {
+  if (endian == xenos::Endian::kNone) {
+    return value;
+  }
   spv::Id type = builder_->getTypeId(value);
   spv::Id const_uint_8_scalar = builder_->makeUintConstant(8);
   spv::Id const_uint_00ff00ff_scalar = builder_->makeUintConstant(0x00FF00FF);
@@ -2884,22 +3082,9 @@ spv::Id SpirvShaderTranslator::EndianSwap32Uint(spv::Id value, spv::Id endian) {
     const_uint_16_typed = const_uint_16_scalar;
   }
 
-  // 8-in-16 or one half of 8-in-32 (doing 8-in-16 swap).
-  spv::Id is_8in16 = builder_->createBinOp(
-      spv::OpIEqual, type_bool_, endian,
-      builder_->makeUintConstant(
-          static_cast<unsigned int>(xenos::Endian::k8in16)));
-  spv::Id is_8in32 = builder_->createBinOp(
-      spv::OpIEqual, type_bool_, endian,
-      builder_->makeUintConstant(
-          static_cast<unsigned int>(xenos::Endian::k8in32)));
-  spv::Id is_8in16_or_8in32 =
-      builder_->createBinOp(spv::OpLogicalOr, type_bool_, is_8in16, is_8in32);
-  SpirvBuilder::IfBuilder if_8in16(is_8in16_or_8in32,
-                                   spv::SelectionControlMaskNone, *builder_);
-  spv::Id swapped_8in16;
-  {
-    swapped_8in16 = builder_->createBinOp(
+  // 8-in-16 or one half of 8-in-32.
+  if (endian == xenos::Endian::k8in16 || endian == xenos::Endian::k8in32) {
+    value = builder_->createBinOp(
         spv::OpBitwiseOr, type,
         builder_->createBinOp(
             spv::OpBitwiseAnd, type,
@@ -2912,28 +3097,15 @@ spv::Id SpirvShaderTranslator::EndianSwap32Uint(spv::Id value, spv::Id endian) {
                                   const_uint_00ff00ff_typed),
             const_uint_8_typed));
   }
-  if_8in16.makeEndIf();
-  value = if_8in16.createMergePhi(swapped_8in16, value);
 
-  // 16-in-32 or another half of 8-in-32 (doing 16-in-32 swap).
-  spv::Id is_16in32 = builder_->createBinOp(
-      spv::OpIEqual, type_bool_, endian,
-      builder_->makeUintConstant(
-          static_cast<unsigned int>(xenos::Endian::k16in32)));
-  spv::Id is_8in32_or_16in32 =
-      builder_->createBinOp(spv::OpLogicalOr, type_bool_, is_8in32, is_16in32);
-  SpirvBuilder::IfBuilder if_16in32(is_8in32_or_16in32,
-                                    spv::SelectionControlMaskNone, *builder_);
-  spv::Id swapped_16in32;
-  {
-    swapped_16in32 = builder_->createQuadOp(
+  // 16-in-32 or another half of 8-in-32.
+  if (endian == xenos::Endian::k8in32 || endian == xenos::Endian::k16in32) {
+    value = builder_->createQuadOp(
         spv::OpBitFieldInsert, type,
         builder_->createBinOp(spv::OpShiftRightLogical, type, value,
                               const_uint_16_typed),
         value, builder_->makeIntConstant(16), builder_->makeIntConstant(16));
   }
-  if_16in32.makeEndIf();
-  value = if_16in32.createMergePhi(swapped_16in32, value);
 
   return value;
 }
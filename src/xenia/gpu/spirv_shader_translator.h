@@ -34,7 +34,7 @@ class SpirvShaderTranslator : public ShaderTranslator {
     // TODO(Triang3l): Change to 0xYYYYMMDD once it's out of the rapid
     // prototyping stage (easier to do small granular updates with an
     // incremental counter).
-    static constexpr uint32_t kVersion = 6;
+    static constexpr uint32_t kVersion = 7;
 
     enum class DepthStencilMode : uint32_t {
       kNoModifiers,
@@ -60,6 +60,10 @@ class SpirvShaderTranslator : public ShaderTranslator {
       // Pipeline stage and input configuration.
       Shader::HostVertexShaderType host_vertex_shader_type
           : Shader::kHostVertexShaderTypeBitCount;
+      // Whether all vertex fetch constants used by the shader have the
+      // endianness vertex_fetch_endian, so the words can be swapped statically.
+      uint32_t vertex_fetch_endian_uniform : 1;
+      xenos::Endian vertex_fetch_endian : 2;
     } vertex;
     struct PixelShaderModification {
       // uint32_t 0.
@@ -435,6 +439,10 @@ class SpirvShaderTranslator : public ShaderTranslator {
   void ProcessLoopEndInstruction(
       const ParsedLoopEndInstruction& instr) override;
   void ProcessJumpInstruction(const ParsedJumpInstruction& instr) override;
+  void ProcessStructuredIfBegin(const ParsedJumpInstruction& instr,
+                                bool has_else) override;
+  void ProcessStructuredElse() override;
+  void ProcessStructuredIfEnd() override;
   void ProcessAllocInstruction(const ParsedAllocInstruction& instr,
                                uint8_t export_eM) override;
 
@@ -512,6 +520,12 @@ class SpirvShaderTranslator : public ShaderTranslator {
   // created.
   void EnsureBuildPointAvailable();
 
+  // Whether the program counter is emulated via a switch in the main loop.
+  bool HasMainSwitch() const {
+    return !is_control_flow_structured() &&
+           !current_shader().label_addresses().empty();
+  }
+
   void StartVertexOrTessEvalShaderBeforeMain();
   void StartVertexOrTessEvalShaderInMain();
   void CompleteVertexOrTessEvalShaderInMain();
@@ -604,6 +618,9 @@ class SpirvShaderTranslator : public ShaderTranslator {
 
   // Perform endian swap of a uint scalar or vector.
   spv::Id EndianSwap32Uint(spv::Id value, spv::Id endian);
+  // Perform endian swap of a uint scalar or vector with the endianness known at
+  // translation time.
+  spv::Id EndianSwap32Uint(spv::Id value, xenos::Endian endian);
   // Perform endian swap of a uint4 vector.
   spv::Id EndianSwap128Uint4(spv::Id value, spv::Id endian);
 
@@ -974,6 +991,22 @@ class SpirvShaderTranslator : public ShaderTranslator {
   spv::Block* main_switch_merge_;
   std::vector<spv::Id> main_switch_next_pc_phi_operands_;
 
+  // With structured control flow, the blocks not added to the function yet.
+  struct StructuredIf {
+    // Null if there's no else block or it has already been entered.
+    spv::Block* else_block;
+    spv::Block* merge_block;
+  };
+  std::vector<StructuredIf> cf_structured_ifs_;
+  struct StructuredLoop {
+    spv::Block* header_block;
+    spv::Block* continue_block;
+    spv::Block* merge_block;
+    // Merge of the conditional skipping the loop if the count is 0.
+    spv::Block* skip_merge_block;
+  };
+  std::vector<StructuredLoop> cf_structured_loops_;
+
   // If the exec bool constant / predicate conditional is open, block after it
   // (not added to the function yet).
   spv::Block* cf_exec_conditional_merge_;
@@ -9,10 +9,13 @@
 
 #include "xenia/gpu/texture_cache.h"
 
+#include "third_party/fmt/include/fmt/format.h"
 #include "xenia/base/clock.h"
 #include "xenia/base/cvar.h"
+#include "xenia/base/frame_timeline.h"
 #include "xenia/base/logging.h"
 #include "xenia/base/profiling.h"
+#include "xenia/base/xxhash.h"
 #include "xenia/gpu/gpu_flags.h"
 
 DEFINE_int32(
@@ -34,6 +37,50 @@ DEFINE_int32(
     "opaquely to the game.\n"
     "See draw_resolution_scale_x for more information.",
     "GPU");
+DEFINE_bool(
+    log_texture_load_stats, false,
+    "Log the number of loads, the amount of guest data and the time spent "
+    "loading textures from the shared memory for each guest format when the "
+    "texture cache is destroyed, for measuring the texture loading throughput, "
+    "for instance, by replaying a trace with the trace dump tool. The time is "
+    "measured on the command processor thread, so it includes the setup of "
+    "the loading on the GPU, but not its execution on the GPU.",
+    "GPU");
+DEFINE_bool(
+    texture_cache_content_deduplication, false,
+    "Copy the host data of textures with the same guest data and format at "
+    "different addresses from the already loaded texture rather than loading "
+    "it again from the guest memory. Requires hashing the guest data on the "
+    "CPU on every load of textures written by the CPU. Textures containing "
+    "data from resolves are not deduplicated, but ones written with memexport "
+    "(which is not in the guest memory) may cause incorrect reuse.",
+    "GPU");
+DEFINE_bool(
+    store_textures, false,
+    "Store the host data of the textures converted from the guest data in the "
+    "cache root, per title and host configuration, and upload it without "
+    "converting the textures again in the next runs of the title. Requires "
+    "store_shaders, and hashing the guest data like "
+    "texture_cache_content_deduplication, with the same limitations.",
+    "GPU");
+DEFINE_bool(
+    texture_cache_lazy_mips, false,
+    "Load only the mip levels of textures that are within the mip clamp range "
+    "of the texture fetch constants they are bound with, loading the more "
+    "detailed levels only when the textures are bound with a wider clamp "
+    "range later. Reduces the amount of guest data uploaded and converted for "
+    "textures with a minimum mip level above 1, such as streamed textures "
+    "before their most detailed levels are ready.",
+    "GPU");
+DEFINE_bool(
+    texture_cache_load_resolved_textures, false,
+    "Reload the textures sampled in the current or the previous submission "
+    "whose outdated data is fully covered by a resolve right after the "
+    "resolve, while the resolved data is likely still in the host GPU caches, "
+    "rather than when they're bound for the next draw. Helps render-to-texture "
+    "targets resolved once and sampled many times, but may cause redundant "
+    "loads if the same range is resolved again before being sampled.",
+    "GPU");
 DEFINE_uint32(
     texture_cache_memory_limit_soft, 384,
     "Maximum host texture memory usage (in megabytes) above which old textures "
@@ -49,6 +96,15 @@ DEFINE_uint32(
     "Maximum host texture memory usage (in megabytes) above which textures "
     "will be destroyed as soon as possible.",
     "GPU");
+DEFINE_uint32(
+    texture_cache_memory_budget_percent, 0,
+    "If not 0, percentage of the video memory budget reported by the OS, "
+    "excluding the memory used outside the texture cache, to use as the hard "
+    "host texture memory limit instead of texture_cache_memory_limit_hard. The "
+    "soft limit is then scaled by the ratio of texture_cache_memory_limit_soft "
+    "to texture_cache_memory_limit_hard. Used only if the host graphics API "
+    "provides the budget.",
+    "GPU");
 DEFINE_uint32(
     texture_cache_memory_limit_render_to_texture, 24,
     "Part of the host texture memory budget (in megabytes) that will be scaled "
@@ -166,6 +222,8 @@ TextureCache::TextureCache(const RegisterFile& register_file,
 }
 
 TextureCache::~TextureCache() {
+  LogLoadStats();
+
   DestroyAllTextures(true);
 
   if (scaled_resolve_global_watch_handle_) {
@@ -189,37 +247,73 @@ bool TextureCache::GetConfigDrawResolutionScale(uint32_t& x_out,
 
 void TextureCache::ClearCache() { DestroyAllTextures(); }
 
+void TextureCache::InitializeTextureStorage(
+    const std::filesystem::path& cache_root, uint32_t title_id) {
+  ShutdownTextureStorage();
+  const char* host_config_name;
+  uint64_t host_config_hash;
+  if (!cvars::store_textures ||
+      !GetTextureStorageHostConfig(host_config_name, host_config_hash)) {
+    return;
+  }
+  texture_storage_.Open(
+      cache_root / "textures" /
+          fmt::format("{:08X}.{}.xtex", title_id, host_config_name),
+      host_config_hash);
+}
+
+void TextureCache::ShutdownTextureStorage() { texture_storage_.Close(); }
+
 void TextureCache::CompletedSubmissionUpdated(
     uint64_t completed_submission_index) {
   // If memory usage is too high, destroy unused textures.
   uint64_t current_time = xe::Clock::QueryHostUptimeMillis();
-  // texture_cache_memory_limit_render_to_texture is assumed to be included in
-  // texture_cache_memory_limit_soft and texture_cache_memory_limit_hard, at 1x,
-  // so subtracting 1 from the scale.
-  uint32_t limit_scaled_resolve_add_mb =
-      cvars::texture_cache_memory_limit_render_to_texture *
-      (draw_resolution_scale_x() * draw_resolution_scale_y() - 1);
-  uint32_t limit_soft_mb =
-      cvars::texture_cache_memory_limit_soft + limit_scaled_resolve_add_mb;
-  uint32_t limit_hard_mb =
-      cvars::texture_cache_memory_limit_hard + limit_scaled_resolve_add_mb;
-  uint32_t limit_soft_lifetime =
-      cvars::texture_cache_memory_limit_soft_lifetime * 1000;
+  uint32_t limit_soft_mb, limit_hard_mb;
+  if (budget_limit_hard_mb_) {
+    limit_hard_mb = budget_limit_hard_mb_;
+    limit_soft_mb = uint32_t(
+        uint64_t(limit_hard_mb) * cvars::texture_cache_memory_limit_soft /
+        std::max(cvars::texture_cache_memory_limit_hard, UINT32_C(1)));
+  } else {
+    // texture_cache_memory_limit_render_to_texture is assumed to be included
+    // in texture_cache_memory_limit_soft and texture_cache_memory_limit_hard,
+    // at 1x, so subtracting 1 from the scale.
+    uint32_t limit_scaled_resolve_add_mb =
+        cvars::texture_cache_memory_limit_render_to_texture *
+        (draw_resolution_scale_x() * draw_resolution_scale_y() - 1);
+    limit_soft_mb =
+        cvars::texture_cache_memory_limit_soft + limit_scaled_resolve_add_mb;
+    limit_hard_mb =
+        cvars::texture_cache_memory_limit_hard + limit_scaled_resolve_add_mb;
+  }
+  uint64_t limit_soft_lifetime =
+      uint64_t(cvars::texture_cache_memory_limit_soft_lifetime) * 1000;
   bool destroyed_any = false;
-  while (texture_used_first_ != nullptr) {
+  Texture* texture_next = texture_used_first_;
+  while (texture_next != nullptr) {
     uint64_t total_host_memory_usage_mb =
         (textures_total_host_memory_usage_ + ((UINT32_C(1) << 20) - 1)) >> 20;
     bool limit_hard_exceeded = total_host_memory_usage_mb > limit_hard_mb;
     if (total_host_memory_usage_mb <= limit_soft_mb && !limit_hard_exceeded) {
       break;
     }
-    Texture* texture = texture_used_first_;
+    Texture* texture = texture_next;
     if (texture->last_usage_submission_index() > completed_submission_index) {
       break;
     }
-    if (!limit_hard_exceeded &&
-        (texture->last_usage_time() + limit_soft_lifetime) > current_time) {
-      break;
+    texture_next = texture->used_next();
+    if (!limit_hard_exceeded) {
+      // Above the soft limit, skip the textures that are more valuable to keep
+      // than the more recently used ones after them, until reaching ones too
+      // new to be evicted regardless of their value.
+      if (texture->last_usage_time() + limit_soft_lifetime / 2 > current_time) {
+        break;
+      }
+      if (texture->last_usage_time() +
+              GetSoftLimitLifetime(*texture, limit_soft_lifetime) >
+          current_time) {
+        continue;
+      }
     }
     if (!destroyed_any) {
       destroyed_any = true;
@@ -235,6 +329,11 @@ void TextureCache::CompletedSubmissionUpdated(
     assert_true(found_texture_it != textures_.end());
     if (found_texture_it != textures_.end()) {
       assert_true(found_texture_it->second.get() == texture);
+      frame_evicted_bytes_ += texture->GetHostMemoryUsage();
+      if (evicted_texture_keys_.size() >= kMaxEvictedTextureKeys) {
+        evicted_texture_keys_.clear();
+      }
+      evicted_texture_keys_.insert(texture->key());
       textures_.erase(found_texture_it);
       // `texture` is invalid now.
     }
@@ -255,6 +354,50 @@ void TextureCache::BeginFrame() {
   // sure bindings are reset so a new attempt will surely be made if the texture
   // is requested again.
   ResetTextureBindings();
+
+  COUNT_profile_set("gpu/texture_cache/evicted_kb_per_frame",
+                    frame_evicted_bytes_ >> 10);
+  COUNT_profile_set("gpu/texture_cache/reloaded_kb_per_frame",
+                    frame_reloaded_bytes_ >> 10);
+  frame_evicted_bytes_ = 0;
+  frame_reloaded_bytes_ = 0;
+
+  budget_limit_hard_mb_ = 0;
+  uint64_t budget, usage;
+  if (cvars::texture_cache_memory_budget_percent &&
+      QueryHostMemoryBudget(budget, usage)) {
+    // The memory used by the process outside the texture cache is not
+    // available for textures.
+    uint64_t usage_other =
+        usage - std::min(usage, textures_total_host_memory_usage_);
+    uint64_t budget_textures =
+        (budget - std::min(budget, usage_other)) *
+        std::min(cvars::texture_cache_memory_budget_percent, UINT32_C(100)) /
+        100;
+    // Not 0 to not fall back to the fixed limits.
+    budget_limit_hard_mb_ = uint32_t(std::max(budget_textures >> 20,
+                                              uint64_t(1)));
+  }
+}
+
+uint64_t TextureCache::GetSoftLimitLifetime(const Texture& texture,
+                                            uint64_t base_lifetime) {
+  // Keep the textures that are expensive to load again, because of untiling
+  // or decompression on the host, longer, and evict the large ones, that free
+  // more memory, sooner.
+  const TextureKey& key = texture.key();
+  uint64_t load_cost = 1;
+  if (key.tiled) {
+    ++load_cost;
+  }
+  if (FormatInfo::Get(key.format)->type == FormatType::kCompressed) {
+    ++load_cost;
+  }
+  uint64_t lifetime = base_lifetime * load_cost;
+  if (texture.GetHostMemoryUsage() >= (UINT64_C(4) << 20)) {
+    lifetime /= 2;
+  }
+  return lifetime;
 }
 
 void TextureCache::MarkRangeAsResolved(uint32_t start_unscaled,
@@ -287,6 +430,56 @@ void TextureCache::MarkRangeAsResolved(uint32_t start_unscaled,
   // Invalidate textures. Toggling individual textures between scaled and
   // unscaled also relies on invalidation through shared memory.
   shared_memory().RangeWrittenByGpu(start_unscaled, length_unscaled, true);
+
+  if (cvars::texture_cache_load_resolved_textures) {
+    LoadResolvedTextures(start_unscaled, length_unscaled);
+  }
+}
+
+void TextureCache::LoadResolvedTextures(uint32_t start_unscaled,
+                                        uint32_t length_unscaled) {
+  uint32_t end_unscaled = start_unscaled + length_unscaled;
+  auto range_contains = [&](uint32_t start, uint32_t length) {
+    return start >= start_unscaled && start + length <= end_unscaled;
+  };
+  // Gather first, as loading relinks the textures in the usage list.
+  resolved_textures_to_load_.clear();
+  {
+    auto global_lock = global_critical_region_.Acquire();
+    // The usage list is sorted by the submission of the last usage, so
+    // walking from the most recently used textures stops at the first one not
+    // used in the previous submission.
+    for (Texture* texture = texture_used_last_;
+         texture && texture->last_usage_submission_index() + 1 >=
+                        current_submission_index_;
+         texture = texture->used_previous()) {
+      bool base_outdated = texture->base_outdated(global_lock);
+      bool mips_outdated = texture->mips_outdated(global_lock);
+      if (!base_outdated && !mips_outdated) {
+        continue;
+      }
+      // Textures only partially covered are likely to be resolved further, in
+      // more parts, and are loaded when they're bound instead.
+      const TextureKey& key = texture->key();
+      if (base_outdated &&
+          !range_contains(key.base_page << 12, texture->GetGuestBaseSize())) {
+        continue;
+      }
+      if (mips_outdated) {
+        uint32_t mips_load_offset = texture->GetGuestMipsLoadOffset();
+        if (!range_contains((key.mip_page << 12) + mips_load_offset,
+                            texture->GetGuestMipsSize() - mips_load_offset)) {
+          continue;
+        }
+      }
+      resolved_textures_to_load_.push_back(texture);
+    }
+  }
+  for (Texture* texture : resolved_textures_to_load_) {
+    // On failure, another attempt is made when the texture is bound.
+    LoadTextureData(*texture);
+  }
+  resolved_textures_to_load_.clear();
 }
 
 uint32_t TextureCache::GuestToHostSwizzle(uint32_t guest_swizzle,
@@ -319,8 +512,13 @@ void TextureCache::RequestTextures(uint32_t used_texture_mask) {
   }
 
   // Update the texture keys and the textures.
-  uint32_t bindings_changed = 0;
   uint32_t textures_remaining = used_texture_mask & ~texture_bindings_in_sync_;
+  if (!textures_remaining) {
+    // The fetch constants of all the used bindings are the same as when they
+    // were last updated.
+    return;
+  }
+  uint32_t bindings_changed = 0;
   uint32_t index = 0;
 
   Texture* textures_to_load[64];  // max bits = 32, can be unsigned + signed
@@ -333,7 +531,9 @@ void TextureCache::RequestTextures(uint32_t used_texture_mask) {
     xenos::xe_gpu_texture_fetch_t fetch = regs.GetTextureFetch(index);
     TextureKey old_key = binding.key;
     uint8_t old_swizzled_signs = binding.swizzled_signs;
-    BindingInfoFromFetchConstant(fetch, binding.key, &binding.swizzled_signs);
+    uint32_t mip_min_level;
+    BindingInfoFromFetchConstant(fetch, binding.key, &binding.swizzled_signs,
+                                 &mip_min_level);
     texture_bindings_in_sync_ |= index_bit;
     if (!binding.key.is_valid) {
       if (old_key.is_valid) {
@@ -398,6 +598,20 @@ void TextureCache::RequestTextures(uint32_t used_texture_mask) {
       }
       binding.texture_signed = nullptr;
     }
+    if (cvars::texture_cache_lazy_mips && binding.key.mip_max_level) {
+      // The mip clamp range is not a part of the key, so the same texture may
+      // be needed with more levels than loaded previously.
+      auto global_lock = global_critical_region_.Acquire();
+      if (binding.texture != nullptr &&
+          binding.texture->RequestMipsFromLevel(global_lock, mip_min_level)) {
+        load_unsigned_data = true;
+      }
+      if (binding.texture_signed != nullptr &&
+          binding.texture_signed->RequestMipsFromLevel(global_lock,
+                                                       mip_min_level)) {
+        load_signed_data = true;
+      }
+    }
     if (load_unsigned_data && binding.texture != nullptr) {
       textures_to_load[num_textures_to_load++] = binding.texture;
     }
@@ -467,6 +681,10 @@ TextureCache::Texture::Texture(TextureCache& texture_cache,
       guest_layout_(key.GetGuestLayout()),
       base_resolved_(key.scaled_resolve),
       mips_resolved_(key.scaled_resolve),
+      mips_first_level_(
+          cvars::texture_cache_lazy_mips
+              ? std::max(uint32_t(key.mip_max_level), uint32_t(1))
+              : uint32_t(1)),
       last_usage_submission_index_(texture_cache.current_submission_index_),
       last_usage_time_(texture_cache.current_submission_time_),
       used_previous_(texture_cache.texture_used_last_),
@@ -502,6 +720,15 @@ TextureCache::Texture::~Texture() {
     texture_cache_.texture_used_last_ = used_previous_;
   }
 
+  if (content_hash_valid_) {
+    auto content_hash_it =
+        texture_cache_.content_hash_textures_.find(content_hash_);
+    if (content_hash_it != texture_cache_.content_hash_textures_.end() &&
+        content_hash_it->second == this) {
+      texture_cache_.content_hash_textures_.erase(content_hash_it);
+    }
+  }
+
   texture_cache_.UpdateTexturesTotalHostMemoryUsage(0, host_memory_usage_);
 }
 
@@ -524,6 +751,24 @@ void TextureCache::Texture::MakeUpToDateAndWatch(
   }
 }
 
+bool TextureCache::Texture::RequestMipsFromLevel(
+    const global_unique_lock_type& global_lock, uint32_t level) {
+  level = std::max(level, uint32_t(1));
+  if (level >= mips_first_level_ || !GetGuestMipsSize()) {
+    return false;
+  }
+  mips_first_level_ = level;
+  if (!mips_outdated_) {
+    // The more detailed levels have not been loaded, reload the mips.
+    if (mips_watch_handle_) {
+      texture_cache().shared_memory().UnwatchMemoryRange(mips_watch_handle_);
+      mips_watch_handle_ = nullptr;
+    }
+    mips_outdated_ = true;
+  }
+  return true;
+}
+
 void TextureCache::Texture::MarkAsUsed() {
   assert_true(last_usage_submission_index_ <=
               texture_cache_.current_submission_index_);
@@ -636,6 +881,11 @@ TextureCache::Texture* TextureCache::FindOrCreateTexture(TextureKey key) {
         textures_.emplace(key, std::move(new_texture)).first->second.get();
   }
   COUNT_profile_set("gpu/texture_cache/textures", textures_.size());
+  auto evicted_texture_key_it = evicted_texture_keys_.find(key);
+  if (evicted_texture_key_it != evicted_texture_keys_.end()) {
+    evicted_texture_keys_.erase(evicted_texture_key_it);
+    frame_reloaded_bytes_ += texture->GetHostMemoryUsage();
+  }
   texture->LogAction("Created");
   return texture;
 }
@@ -710,9 +960,12 @@ void TextureCache::LoadTexturesData(Texture** textures, uint32_t n_textures) {
     }
     bool mips_resolved = texture.GetMipsResolved();
     if (index_mips_outdated & (1ULL << i)) {
+      // Only the levels that will be loaded.
+      uint32_t mips_load_offset = texture.GetGuestMipsLoadOffset();
       if (!shared_memory().RequestRange(
-              texture_key.mip_page << 12,
-              xe::align(texture.GetGuestMipsSize(), UINT32_C(16)),
+              (texture_key.mip_page << 12) + mips_load_offset,
+              xe::align(texture.GetGuestMipsSize() - mips_load_offset,
+                        UINT32_C(16)),
               texture_key.scaled_resolve ? nullptr : &mips_resolved)) {
         continue;
       }
@@ -733,9 +986,10 @@ void TextureCache::LoadTexturesData(Texture** textures, uint32_t n_textures) {
     }
 
     // Actually load the texture data.
-    if (!LoadTextureDataFromResidentMemoryImpl(
+    if (!LoadTextureDataFromResidentMemory(
             texture, (index_base_outdated & (1ULL << i)) != 0,
-            (index_mips_outdated & (1ULL << i)) != 0)) {
+            (index_mips_outdated & (1ULL << i)) != 0,
+            base_resolved || mips_resolved)) {
       continue;
     }
 
@@ -778,6 +1032,8 @@ bool TextureCache::LoadTextureData(Texture& texture) {
   if (!base_outdated && !mips_outdated) {
     return true;
   }
+  frame_timeline::ScopedActivity frame_timeline_activity(
+      frame_timeline::Activity::kTextureLoad);
 
   TextureKey texture_key = texture.key();
 
@@ -806,9 +1062,12 @@ bool TextureCache::LoadTextureData(Texture& texture) {
   }
   bool mips_resolved = texture.GetMipsResolved();
   if (mips_outdated) {
+    // Only the levels that will be loaded.
+    uint32_t mips_load_offset = texture.GetGuestMipsLoadOffset();
     if (!shared_memory().RequestRange(
-            texture_key.mip_page << 12,
-            xe::align(texture.GetGuestMipsSize(), UINT32_C(16)),
+            (texture_key.mip_page << 12) + mips_load_offset,
+            xe::align(texture.GetGuestMipsSize() - mips_load_offset,
+                      UINT32_C(16)),
             texture_key.scaled_resolve ? nullptr : &mips_resolved)) {
       return false;
     }
@@ -829,8 +1088,9 @@ bool TextureCache::LoadTextureData(Texture& texture) {
   }
 
   // Actually load the texture data.
-  if (!LoadTextureDataFromResidentMemoryImpl(texture, base_outdated,
-                                             mips_outdated)) {
+  if (!LoadTextureDataFromResidentMemory(texture, base_outdated,
+                                         mips_outdated,
+                                         base_resolved || mips_resolved)) {
     return false;
   }
 
@@ -853,15 +1113,176 @@ bool TextureCache::LoadTextureData(Texture& texture) {
   return true;
 }
 
+bool TextureCache::LoadTextureDataFromResidentMemory(Texture& texture,
+                                                     bool load_base,
+                                                     bool load_mips,
+                                                     bool resolved) {
+  // The data is changing, so the previous hash is not valid anymore.
+  uint64_t content_hash;
+  if (texture.GetContentHash(content_hash)) {
+    auto content_hash_it = content_hash_textures_.find(content_hash);
+    if (content_hash_it != content_hash_textures_.end() &&
+        content_hash_it->second == &texture) {
+      content_hash_textures_.erase(content_hash_it);
+    }
+    texture.ResetContentHash();
+  }
+  bool content_hashed = GetLoadContentHash(texture, load_base, load_mips,
+                                           resolved, content_hash);
+  bool deduplicate =
+      content_hashed && cvars::texture_cache_content_deduplication;
+
+  uint32_t load_guest_bytes = (load_base ? texture.GetGuestBaseSize() : 0) +
+                              (load_mips ? texture.GetGuestMipsSize() : 0);
+
+  if (deduplicate) {
+    auto content_hash_it = content_hash_textures_.find(content_hash);
+    if (content_hash_it != content_hash_textures_.end()) {
+      Texture& source = *content_hash_it->second;
+      bool source_up_to_date;
+      {
+        auto global_lock = global_critical_region_.Acquire();
+        source_up_to_date = !source.base_outdated(global_lock) &&
+                            !source.mips_outdated(global_lock);
+      }
+      if (source_up_to_date && CopyTextureDataImpl(texture, source)) {
+        texture.SetContentHash(content_hash);
+        deduplicated_bytes_ += load_guest_bytes;
+        COUNT_profile_set("gpu/texture_cache/deduplicated_mb",
+                          deduplicated_bytes_ >> 20);
+        return true;
+      }
+    }
+  }
+
+  bool store_host_data = false;
+  if (content_hashed && texture_storage_.is_open()) {
+    const uint8_t* host_data;
+    uint32_t host_data_size;
+    switch (texture_storage_.Find(content_hash, host_data, host_data_size)) {
+      case TextureDiskCache::FindResult::kFound:
+        if (LoadTextureDataFromHostDataImpl(texture, host_data,
+                                            host_data_size)) {
+          if (deduplicate) {
+            texture.SetContentHash(content_hash);
+            content_hash_textures_[content_hash] = &texture;
+          }
+          texture_storage_loaded_bytes_ += load_guest_bytes;
+          COUNT_profile_set("gpu/texture_cache/storage_loaded_mb",
+                            texture_storage_loaded_bytes_ >> 20);
+          return true;
+        }
+        break;
+      case TextureDiskCache::FindResult::kNotFound:
+        store_host_data = true;
+        break;
+      default:
+        break;
+    }
+  }
+
+  uint64_t ticks_start =
+      cvars::log_texture_load_stats ? Clock::QueryHostTickCount() : 0;
+  if (load_base && load_mips && texture.mips_first_level() > 1) {
+    // The implementations load a contiguous range of levels.
+    if (!LoadTextureDataFromResidentMemoryImpl(texture, true, false) ||
+        !LoadTextureDataFromResidentMemoryImpl(texture, false, true)) {
+      return false;
+    }
+  } else {
+    texture_storage_store_key_ = content_hash;
+    texture_storage_store_requested_ = store_host_data;
+    bool loaded =
+        LoadTextureDataFromResidentMemoryImpl(texture, load_base, load_mips);
+    texture_storage_store_requested_ = false;
+    if (!loaded) {
+      return false;
+    }
+  }
+  if (cvars::log_texture_load_stats) {
+    LoadStats& stats = load_stats_[uint32_t(texture.key().format)];
+    ++stats.load_count;
+    stats.guest_bytes += load_guest_bytes;
+    stats.host_ticks += Clock::QueryHostTickCount() - ticks_start;
+  }
+
+  if (deduplicate) {
+    // Replaces the texture that has become outdated if there was one.
+    texture.SetContentHash(content_hash);
+    content_hash_textures_[content_hash] = &texture;
+  }
+  return true;
+}
+
+bool TextureCache::GetLoadContentHash(const Texture& texture, bool load_base,
+                                      bool load_mips, bool resolved,
+                                      uint64_t& hash_out) const {
+  if ((!cvars::texture_cache_content_deduplication &&
+       !texture_storage_.is_open()) ||
+      resolved) {
+    return false;
+  }
+  // Only the whole texture can be copied.
+  uint32_t base_size = texture.GetGuestBaseSize();
+  uint32_t mips_size = texture.GetGuestMipsSize();
+  if ((base_size && !load_base) || (mips_size && !load_mips) ||
+      (mips_size && texture.mips_first_level() > 1)) {
+    return false;
+  }
+  // The addresses don't matter, but whether the base and the mips are present
+  // affects the layout.
+  TextureKey content_key = texture.key();
+  content_key.base_page = content_key.base_page ? 1 : 0;
+  content_key.mip_page = content_key.mip_page ? 1 : 0;
+  const SharedMemory& memory = shared_memory();
+  XXH3_state_t hash_state;
+  XXH3_64bits_reset(&hash_state);
+  XXH3_64bits_update(&hash_state, &content_key, sizeof(content_key));
+  if (base_size) {
+    XXH3_64bits_update(
+        &hash_state, memory.TranslatePhysical(texture.key().base_page << 12),
+        base_size);
+  }
+  if (mips_size) {
+    XXH3_64bits_update(
+        &hash_state, memory.TranslatePhysical(texture.key().mip_page << 12),
+        mips_size);
+  }
+  hash_out = XXH3_64bits_digest(&hash_state);
+  return true;
+}
+
+void TextureCache::LogLoadStats() const {
+  if (!cvars::log_texture_load_stats) {
+    return;
+  }
+  double tick_frequency = double(Clock::QueryHostTickFrequency());
+  XELOGI("Texture loading by guest format:");
+  for (uint32_t i = 0; i < uint32_t(load_stats_.size()); ++i) {
+    const LoadStats& stats = load_stats_[i];
+    if (!stats.load_count) {
+      continue;
+    }
+    double megabytes = double(stats.guest_bytes) / (1024.0 * 1024.0);
+    double seconds = double(stats.host_ticks) / tick_frequency;
+    XELOGI("  {}: {} loads, {:.2f} MB, {:.3f} ms, {:.1f} MB/s",
+           FormatInfo::GetName(i), stats.load_count, megabytes,
+           seconds * 1000.0, seconds > 0.0 ? megabytes / seconds : 0.0);
+  }
+}
+
 void TextureCache::BindingInfoFromFetchConstant(
     const xenos::xe_gpu_texture_fetch_t& fetch, TextureKey& key_out,
-    uint8_t* swizzled_signs_out) {
+    uint8_t* swizzled_signs_out, uint32_t* mip_min_level_out) {
   // Reset the key and the signedness.
   key_out.MakeInvalid();
   if (swizzled_signs_out != nullptr) {
     *swizzled_signs_out =
         uint8_t(xenos::TextureSign::kUnsigned) * uint8_t(0b01010101);
   }
+  if (mip_min_level_out != nullptr) {
+    *mip_min_level_out = 0;
+  }
 
   switch (fetch.type) {
     case xenos::FetchConstantType::kTexture:
@@ -888,10 +1309,10 @@ void TextureCache::BindingInfoFromFetchConstant(
   }
 
   uint32_t width_minus_1, height_minus_1, depth_or_array_size_minus_1;
-  uint32_t base_page, mip_page, mip_max_level;
+  uint32_t base_page, mip_page, mip_min_level, mip_max_level;
   texture_util::GetSubresourcesFromFetchConstant(
       fetch, &width_minus_1, &height_minus_1, &depth_or_array_size_minus_1,
-      &base_page, &mip_page, nullptr, &mip_max_level);
+      &base_page, &mip_page, &mip_min_level, &mip_max_level);
   if (base_page == 0 && mip_page == 0) {
     // No texture data at all.
     return;
@@ -947,6 +1368,9 @@ void TextureCache::BindingInfoFromFetchConstant(
   if (swizzled_signs_out != nullptr) {
     *swizzled_signs_out = texture_util::SwizzleSigns(fetch);
   }
+  if (mip_min_level_out != nullptr) {
+    *mip_min_level_out = mip_min_level;
+  }
 }
 
 void TextureCache::ResetTextureBindings(bool from_destructor) {
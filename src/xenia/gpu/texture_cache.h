@@ -10,12 +10,16 @@
 #ifndef XENIA_GPU_TEXTURE_CACHE_H_
 #define XENIA_GPU_TEXTURE_CACHE_H_
 
+#include <algorithm>
 #include <array>
 #include <atomic>
 #include <cstdint>
 #include <cstring>
+#include <filesystem>
 #include <memory>
 #include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
 #include "xenia/base/assert.h"
 #include "xenia/base/hash.h"
@@ -23,6 +27,7 @@
 #include "xenia/base/mutex.h"
 #include "xenia/gpu/register_file.h"
 #include "xenia/gpu/shared_memory.h"
+#include "xenia/gpu/texture_disk_cache.h"
 #include "xenia/gpu/texture_util.h"
 #include "xenia/gpu/xenos.h"
 
@@ -85,6 +90,12 @@ class TextureCache {
 
   virtual void ClearCache();
 
+  // Opens the persistent storage of the converted host data of the title's
+  // textures if enabled with store_textures and supported by the backend.
+  void InitializeTextureStorage(const std::filesystem::path& cache_root,
+                                uint32_t title_id);
+  void ShutdownTextureStorage();
+
   virtual void CompletedSubmissionUpdated(uint64_t completed_submission_index);
   virtual void BeginSubmission(uint64_t new_submission_index);
   virtual void BeginFrame();
@@ -115,6 +126,11 @@ class TextureCache {
     texture_bindings_in_sync_ &= ~res;
   }
 
+  // Mask of the texture fetch constants whose values have actually changed.
+  void TextureFetchConstantsChanged(uint32_t fetch_constant_mask) {
+    texture_bindings_in_sync_ &= ~fetch_constant_mask;
+  }
+
   virtual void RequestTextures(uint32_t used_texture_mask);
 
   // "ActiveTexture" means as of the latest RequestTextures call.
@@ -238,12 +254,30 @@ class TextureCache {
       return guest_layout().mips_total_extent_bytes;
     }
 
+    // The first mip level (at least 1) loaded when the mips are loaded. Levels
+    // below it are not accessible with the mip clamp ranges of the fetch
+    // constants the texture has been bound with, and are not loaded.
+    uint32_t mips_first_level() const { return mips_first_level_; }
+    // Offset of the guest data of mips_first_level from the mip address.
+    uint32_t GetGuestMipsLoadOffset() const {
+      return guest_layout().mip_offsets_bytes[std::min(
+          mips_first_level_, guest_layout().packed_level)];
+    }
+    // Makes the levels starting from the specified one loaded on the next
+    // load, returning whether the mips need to be loaded for this.
+    bool RequestMipsFromLevel(const global_unique_lock_type& global_lock,
+                              uint32_t level);
+
     uint64_t GetHostMemoryUsage() const { return host_memory_usage_; }
 
     uint64_t last_usage_submission_index() const {
       return last_usage_submission_index_;
     }
     uint64_t last_usage_time() const { return last_usage_time_; }
+    // The next more recently used texture.
+    Texture* used_next() const { return used_next_; }
+    // The next less recently used texture.
+    Texture* used_previous() const { return used_previous_; }
 
     bool GetBaseResolved() const { return base_resolved_; }
     void SetBaseResolved(bool base_resolved) {
@@ -267,6 +301,19 @@ class TextureCache {
 
     void WatchCallback(const global_unique_lock_type& global_lock, bool is_mip);
 
+    // Hash of the guest data and of the parameters of the host representation
+    // from the last load, if the texture was fully loaded from data written by
+    // the CPU and can be a source for content deduplication.
+    bool GetContentHash(uint64_t& hash_out) const {
+      hash_out = content_hash_;
+      return content_hash_valid_;
+    }
+    void SetContentHash(uint64_t hash) {
+      content_hash_ = hash;
+      content_hash_valid_ = true;
+    }
+    void ResetContentHash() { content_hash_valid_ = false; }
+
     // For LRU caching - updates the last usage frame and moves the texture to
     // the end of the usage queue. Must be called any time the texture is
     // referenced by any GPU work in the implementation to make sure it's not
@@ -305,6 +352,11 @@ class TextureCache {
     bool base_resolved_;
     bool mips_resolved_;
 
+    uint32_t mips_first_level_;
+
+    uint64_t content_hash_ = 0;
+    bool content_hash_valid_ = false;
+
     // These are to be accessed within the global critical region to synchronize
     // with shared memory.
     // Whether the recent base level data needs reloading from the memory.
@@ -573,17 +625,61 @@ class TextureCache {
   // Writes the texture data (for base, mips or both - but not neither) from the
   // shared memory or the scaled resolve memory. The shared memory management is
   // done outside this function, the implementation just needs to load the data
-  // into the texture object.
+  // into the texture object. The mips are loaded starting from
+  // mips_first_level of the texture, which is 1 if loading both the base and
+  // the mips.
   virtual bool LoadTextureDataFromResidentMemoryImpl(Texture& texture,
                                                      bool load_base,
                                                      bool load_mips) = 0;
+  // Copies the host data of another texture with the same key other than the
+  // addresses and with the same guest data instead of loading it. The source is
+  // up to date. May return false if not supported, then the texture is loaded
+  // normally.
+  virtual bool CopyTextureDataImpl(Texture& texture, Texture& source) {
+    return false;
+  }
+
+  // Identifies the layout and the formats of the host data of the textures for
+  // the persistent texture storage, which is not used if this returns false.
+  // The hash must change if the host data may be different for the same key.
+  virtual bool GetTextureStorageHostConfig(const char*& name_out,
+                                           uint64_t& hash_out) const {
+    return false;
+  }
+  // Uploads the whole host data of the texture, previously passed to
+  // StoreHostData by LoadTextureDataFromResidentMemoryImpl for a texture with
+  // the same key and guest data, instead of loading it from the guest data. May
+  // return false if the data can't be used, then the texture is loaded
+  // normally.
+  virtual bool LoadTextureDataFromHostDataImpl(Texture& texture,
+                                               const uint8_t* data,
+                                               uint32_t size) {
+    return false;
+  }
+  // Whether the current LoadTextureDataFromResidentMemoryImpl call should
+  // write the whole host data of the texture to the persistent texture storage
+  // with StoreHostData when it's available, with the key returned in key_out.
+  bool IsHostDataStoreRequested(uint64_t& key_out) const {
+    key_out = texture_storage_store_key_;
+    return texture_storage_store_requested_;
+  }
+  void StoreHostData(uint64_t key, std::vector<uint8_t>&& data) {
+    texture_storage_.Store(key, std::move(data));
+  }
+
+  // Returns the current video memory budget for the process and the total
+  // usage by it, or false if not available.
+  virtual bool QueryHostMemoryBudget(uint64_t& budget_out,
+                                     uint64_t& usage_out) const {
+    return false;
+  }
 
   // Converts a texture fetch constant to a texture key, normalizing and
   // validating the values, or creating an invalid key, and also gets the
-  // post-guest-swizzle signedness.
+  // post-guest-swizzle signedness and the lowest mip level that may be sampled.
   static void BindingInfoFromFetchConstant(
       const xenos::xe_gpu_texture_fetch_t& fetch, TextureKey& key_out,
-      uint8_t* swizzled_signs_out);
+      uint8_t* swizzled_signs_out, uint32_t* mip_min_level_out = nullptr);
 
   // Makes all texture bindings invalid. Also requesting textures after calling
   // this will cause another attempt to create a texture or to untile it if
@@ -600,6 +696,36 @@ class TextureCache {
   virtual void UpdateTextureBindingsImpl(uint32_t fetch_constant_mask) {}
 
  private:
+  // Per guest format statistics of texture loading, for measuring the
+  // throughput of the loading from the shared memory.
+  struct LoadStats {
+    uint64_t load_count = 0;
+    uint64_t guest_bytes = 0;
+    uint64_t host_ticks = 0;
+  };
+
+  // Calls LoadTextureDataFromResidentMemoryImpl, or copies the data from a
+  // texture with the same contents if deduplication is enabled, or uploads it
+  // from the persistent texture storage, collecting the statistics if needed.
+  // resolved is whether any of the data being loaded may have been written by
+  // the GPU, and thus is not in the guest memory.
+  bool LoadTextureDataFromResidentMemory(Texture& texture, bool load_base,
+                                         bool load_mips, bool resolved);
+  // Returns false if the load can't be deduplicated or stored.
+  bool GetLoadContentHash(const Texture& texture, bool load_base,
+                          bool load_mips, bool resolved,
+                          uint64_t& hash_out) const;
+  void LogLoadStats() const;
+  // Loads the recently used textures whose outdated data is fully within the
+  // range that has just been resolved.
+  void LoadResolvedTextures(uint32_t start_unscaled, uint32_t length_unscaled);
+
+  // Time since the last usage after which a texture may be destroyed when the
+  // soft memory limit is exceeded, from the base lifetime weighted by the cost
+  // of loading the texture again and by its size.
+  static uint64_t GetSoftLimitLifetime(const Texture& texture,
+                                       uint64_t base_lifetime);
+
   void UpdateTexturesTotalHostMemoryUsage(uint64_t add, uint64_t subtract);
 
   // Shared memory callback for texture data invalidation.
@@ -648,8 +774,34 @@ class TextureCache {
 
   uint64_t textures_total_host_memory_usage_ = 0;
 
+  // Textures that can be deduplication sources by their content hashes. May
+  // contain textures that have become outdated since the load.
+  std::unordered_map<uint64_t, Texture*> content_hash_textures_;
+  // Guest data of the textures copied from ones with the same contents rather
+  // than loaded.
+  uint64_t deduplicated_bytes_ = 0;
+
+  // Persistent storage of the host data, keyed by the content hashes.
+  TextureDiskCache texture_storage_;
+  uint64_t texture_storage_store_key_ = 0;
+  bool texture_storage_store_requested_ = false;
+  // Guest data of the textures uploaded from the persistent storage.
+  uint64_t texture_storage_loaded_bytes_ = 0;
+
+  // Hard memory limit derived from the host video memory budget at the
+  // beginning of the frame, or 0 to use the fixed limits.
+  uint32_t budget_limit_hard_mb_ = 0;
+  // Keys of the recently evicted textures, for detecting textures created
+  // again after being evicted.
+  static constexpr size_t kMaxEvictedTextureKeys = 4096;
+  std::unordered_set<TextureKey, TextureKey::Hasher> evicted_texture_keys_;
+  uint64_t frame_evicted_bytes_ = 0;
+  uint64_t frame_reloaded_bytes_ = 0;
+
   Texture* texture_used_first_ = nullptr;
   Texture* texture_used_last_ = nullptr;
+  // Reused between LoadResolvedTextures calls to avoid allocations.
+  std::vector<Texture*> resolved_textures_to_load_;
 
   // Whether a texture has become outdated (a memory watch has been triggered),
   // so need to recheck if textures aren't outdated, disregarding whether fetch
@@ -661,6 +813,9 @@ class TextureCache {
   // Bit vector with bits reset on fetch constant writes to avoid parsing fetch
   // constants again and again.
   uint32_t texture_bindings_in_sync_ = 0;
+
+  // Indexed by xenos::TextureFormat.
+  std::array<LoadStats, 64> load_stats_;
 };
 
 }  // namespace gpu
@@ -0,0 +1,260 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2026 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/gpu/texture_disk_cache.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "xenia/base/assert.h"
+#include "xenia/base/byte_order.h"
+#include "xenia/base/clock.h"
+#include "xenia/base/cvar.h"
+#include "xenia/base/filesystem.h"
+#include "xenia/base/logging.h"
+#include "xenia/base/string.h"
+#include "xenia/base/xxhash.h"
+#include "xenia/gpu/shader_storage_merge.h"
+
+DEFINE_uint32(texture_disk_cache_memory_limit_mb, 512,
+              "Maximum amount of converted texture data loaded from the "
+              "persistent texture storage into memory, in megabytes.",
+              "GPU");
+
+namespace xe {
+namespace gpu {
+
+bool TextureDiskCache::Open(const std::filesystem::path& path,
+                            uint64_t host_config_hash) {
+  Close();
+
+  if (!xe::filesystem::CreateParentFolder(path)) {
+    XELOGE("Failed to create the directory for the texture storage file: {}",
+           xe::path_to_utf8(path));
+    return false;
+  }
+
+  struct {
+    uint32_t magic;
+    uint32_t version_swapped;
+    uint64_t host_config_hash;
+  } file_header;
+  // 'XETX'.
+  file_header.magic = 0x58544558;
+  file_header.version_swapped = xe::byte_swap(uint32_t(1));
+  file_header.host_config_hash = host_config_hash;
+  file_ = OpenShaderStorageFile(path, &file_header, sizeof(file_header));
+  if (!file_) {
+    XELOGE(
+        "Failed to open the texture storage file, persistent texture storage "
+        "will be disabled: {}",
+        xe::path_to_utf8(path));
+    return false;
+  }
+  path_ = path;
+
+  worker_thread_shutdown_ = false;
+  worker_thread_ =
+      xe::threading::Thread::Create({}, [this]() { WorkerThread(); });
+  if (!worker_thread_) {
+    fclose(file_);
+    file_ = nullptr;
+    return false;
+  }
+  worker_thread_->set_name("Texture storage");
+  return true;
+}
+
+void TextureDiskCache::Close() {
+  if (worker_thread_) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      worker_thread_shutdown_ = true;
+    }
+    write_request_cond_.notify_all();
+    xe::threading::Wait(worker_thread_.get(), false);
+    worker_thread_.reset();
+  }
+  write_queue_.clear();
+  records_.clear();
+  records_memory_usage_ = 0;
+  if (file_) {
+    fclose(file_);
+    file_ = nullptr;
+  }
+  path_.clear();
+}
+
+TextureDiskCache::FindResult TextureDiskCache::Find(uint64_t key,
+                                                    const uint8_t*& data_out,
+                                                    uint32_t& size_out) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = records_.find(key);
+  if (it == records_.end()) {
+    return FindResult::kNotFound;
+  }
+  if (!it->second.data) {
+    return FindResult::kUnavailable;
+  }
+  data_out = it->second.data.get();
+  size_out = it->second.size;
+  return FindResult::kFound;
+}
+
+void TextureDiskCache::Store(uint64_t key, std::vector<uint8_t>&& data) {
+  if (!is_open() || data.empty() || data.size() > kMaxRecordSize) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!records_.emplace(key, Record{nullptr, uint32_t(data.size()), false})
+             .second) {
+      return;
+    }
+    write_queue_.emplace_back(key, std::move(data));
+  }
+  write_request_cond_.notify_one();
+}
+
+void TextureDiskCache::ReadRecords() {
+  uint64_t read_start = xe::Clock::QueryHostTickCount();
+  uint64_t memory_limit =
+      uint64_t(cvars::texture_disk_cache_memory_limit_mb) << 20;
+
+  uint64_t valid_bytes = uint64_t(xe::filesystem::Tell(file_));
+  size_t record_count = 0, loaded_record_count = 0;
+
+  // The file is read in large batches, with the records parsed from the
+  // buffer, so the file doesn't have to be accessed for each record.
+  constexpr size_t kReadBatchSize = 8 * 1024 * 1024;
+  std::vector<uint8_t> buffer(kReadBatchSize);
+  size_t buffer_position = 0, buffer_end = 0;
+  bool end_of_file = false;
+  // Makes at least the specified number of bytes available from
+  // buffer_position, returns false if the file ends before them.
+  auto ensure_buffered = [&](size_t size) {
+    while (buffer_end - buffer_position < size) {
+      if (end_of_file) {
+        return false;
+      }
+      // Move the remaining bytes to the beginning to make space for the batch.
+      std::memmove(buffer.data(), buffer.data() + buffer_position,
+                   buffer_end - buffer_position);
+      buffer_end -= buffer_position;
+      buffer_position = 0;
+      if (buffer.size() - buffer_end < kReadBatchSize) {
+        buffer.resize(buffer_end + kReadBatchSize);
+      }
+      size_t bytes_requested = buffer.size() - buffer_end;
+      size_t bytes_read =
+          fread(buffer.data() + buffer_end, 1, bytes_requested, file_);
+      buffer_end += bytes_read;
+      end_of_file = bytes_read < bytes_requested;
+    }
+    return true;
+  };
+
+  while (ensure_buffered(sizeof(RecordHeader))) {
+    RecordHeader header;
+    std::memcpy(&header, buffer.data() + buffer_position, sizeof(header));
+    if (!header.data_size || header.data_size > kMaxRecordSize ||
+        header.reserved ||
+        !ensure_buffered(sizeof(RecordHeader) + header.data_size)) {
+      break;
+    }
+    const uint8_t* data = buffer.data() + buffer_position + sizeof(header);
+    if (XXH3_64bits(data, header.data_size) != header.data_hash) {
+      break;
+    }
+    buffer_position += sizeof(header) + header.data_size;
+    valid_bytes += sizeof(header) + header.data_size;
+    ++record_count;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (worker_thread_shutdown_) {
+      return;
+    }
+    Record& record = records_[header.key];
+    record.in_file = true;
+    if (!record.data && record.size != 0 && record.size != header.data_size) {
+      // Converted differently in this session, keep it as not loaded.
+      continue;
+    }
+    record.size = header.data_size;
+    if (!record.data &&
+        records_memory_usage_ + header.data_size <= memory_limit) {
+      record.data = std::make_unique<uint8_t[]>(header.data_size);
+      std::memcpy(record.data.get(), data, header.data_size);
+      records_memory_usage_ += header.data_size;
+      ++loaded_record_count;
+    }
+  }
+
+  XELOGGPU(
+      "Read {} converted textures from the storage, {} of them ({} MB) loaded, "
+      "in {} milliseconds",
+      record_count, loaded_record_count, records_memory_usage_ >> 20,
+      (xe::Clock::QueryHostTickCount() - read_start) * 1000 /
+          xe::Clock::QueryHostTickFrequency());
+
+  // Drop the records after the first corrupted one.
+  if (!xe::filesystem::Seek(file_, 0, SEEK_END) ||
+      (uint64_t(xe::filesystem::Tell(file_)) != valid_bytes &&
+       !TruncateShaderStorageFile(file_, valid_bytes))) {
+    XELOGW(
+        "The texture storage file is corrupted and used by another instance, "
+        "not adding new textures to it: {}",
+        xe::path_to_utf8(path_));
+    fclose(file_);
+    file_ = nullptr;
+  }
+}
+
+void TextureDiskCache::WorkerThread() {
+  ReadRecords();
+
+  std::vector<uint8_t> record_data;
+  while (true) {
+    uint64_t key;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      if (worker_thread_shutdown_) {
+        return;
+      }
+      if (write_queue_.empty()) {
+        write_request_cond_.wait(lock);
+        continue;
+      }
+      key = write_queue_.front().first;
+      record_data = std::move(write_queue_.front().second);
+      write_queue_.pop_front();
+      Record& record = records_[key];
+      if (record.in_file || !file_) {
+        continue;
+      }
+      record.in_file = true;
+    }
+    RecordHeader header;
+    header.key = key;
+    header.data_hash = XXH3_64bits(record_data.data(), record_data.size());
+    header.data_size = uint32_t(record_data.size());
+    header.reserved = 0;
+    // Whole records are appended at once, as other instances may be appending
+    // to the same file.
+    record_data.insert(record_data.begin(),
+                       reinterpret_cast<const uint8_t*>(&header),
+                       reinterpret_cast<const uint8_t*>(&header) +
+                           sizeof(header));
+    xe::filesystem::AppendToStdioFile(file_, record_data.data(),
+                                      record_data.size());
+  }
+}
+
+}  // namespace gpu
+}  // namespace xe
@@ -0,0 +1,100 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2026 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#ifndef XENIA_GPU_TEXTURE_DISK_CACHE_H_
+#define XENIA_GPU_TEXTURE_DISK_CACHE_H_
+
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "xenia/base/threading.h"
+
+namespace xe {
+namespace gpu {
+
+// Persistent per-title storage of host texture data converted from the guest
+// data, keyed by the content hash of the guest data and the texture key, so
+// textures already converted in the previous runs of the title can be uploaded
+// without converting them again.
+//
+// The records are appended to the file, and are read back after opening on a
+// background thread, sequentially with large buffered reads, into memory up to
+// texture_disk_cache_memory_limit_mb. Textures requested before their records
+// have been read are converted as usual.
+class TextureDiskCache {
+ public:
+  enum class FindResult {
+    // Not in the file, should be stored after converting.
+    kNotFound,
+    // In the file, or already stored, but the data is not in memory.
+    kUnavailable,
+    kFound,
+  };
+
+  TextureDiskCache() = default;
+  TextureDiskCache(const TextureDiskCache&) = delete;
+  TextureDiskCache& operator=(const TextureDiskCache&) = delete;
+  ~TextureDiskCache() { Close(); }
+
+  // The host configuration hash must change whenever the layout or the format
+  // of the host data may be different, the file is reset if it doesn't match.
+  bool Open(const std::filesystem::path& path, uint64_t host_config_hash);
+  void Close();
+  bool is_open() const { return worker_thread_ != nullptr; }
+
+  // The data stays valid until the cache is closed.
+  FindResult Find(uint64_t key, const uint8_t*& data_out, uint32_t& size_out);
+  // Queues the writing of the data for a key that was not found.
+  void Store(uint64_t key, std::vector<uint8_t>&& data);
+
+  static constexpr uint32_t kMaxRecordSize = 64 * 1024 * 1024;
+
+ private:
+  struct RecordHeader {
+    uint64_t key;
+    uint64_t data_hash;
+    uint32_t data_size;
+    uint32_t reserved;
+  };
+
+  struct Record {
+    // Null if not in memory.
+    std::unique_ptr<uint8_t[]> data;
+    uint32_t size;
+    // Read from the file, or written to it.
+    bool in_file;
+  };
+
+  void WorkerThread();
+  void ReadRecords();
+
+  FILE* file_ = nullptr;
+  std::filesystem::path path_;
+  std::unique_ptr<xe::threading::Thread> worker_thread_;
+
+  std::mutex mutex_;
+  std::condition_variable write_request_cond_;
+  std::unordered_map<uint64_t, Record> records_;
+  uint64_t records_memory_usage_ = 0;
+  std::deque<std::pair<uint64_t, std::vector<uint8_t>>> write_queue_;
+  bool worker_thread_shutdown_ = false;
+};
+
+}  // namespace gpu
+}  // namespace xe
+
+#endif  // XENIA_GPU_TEXTURE_DISK_CACHE_H_
@@ -0,0 +1,298 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2026 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/gpu/trace_benchmark.h"
+
+#include <algorithm>
+#include <cstdio>
+
+#include "third_party/fmt/include/fmt/format.h"
+#include "xenia/base/clock.h"
+#include "xenia/base/cvar.h"
+#include "xenia/base/filesystem.h"
+#include "xenia/base/logging.h"
+#include "xenia/base/string.h"
+#include "xenia/base/threading.h"
+#include "xenia/gpu/command_processor.h"
+#include "xenia/gpu/graphics_system.h"
+#include "xenia/gpu/trace_protocol.h"
+
+DEFINE_path(trace_benchmark_path, "",
+            "Trace file to benchmark, or a directory to benchmark all the "
+            "trace files in.",
+            "GPU");
+DEFINE_uint32(trace_benchmark_runs, 3,
+              "Number of times to replay each trace in the benchmark. The "
+              "first run includes the shader and pipeline compilation.",
+              "GPU");
+DEFINE_path(trace_benchmark_output, "",
+            "Path to write the benchmark results as JSON to, or empty to write "
+            "them to the standard output.",
+            "GPU");
+
+namespace xe {
+namespace gpu {
+
+TraceBenchmark::TraceBenchmark() = default;
+
+TraceBenchmark::~TraceBenchmark() = default;
+
+int TraceBenchmark::Main(const std::vector<std::string>& args) {
+  // Either a single trace or a directory with a set of traces.
+  std::vector<std::filesystem::path> trace_paths;
+  if (!cvars::trace_benchmark_path.empty()) {
+    std::filesystem::path path =
+        std::filesystem::absolute(cvars::trace_benchmark_path);
+    std::error_code error_code;
+    if (std::filesystem::is_directory(path, error_code)) {
+      for (const std::filesystem::directory_entry& entry :
+           std::filesystem::directory_iterator(path, error_code)) {
+        if (entry.is_regular_file(error_code) &&
+            entry.path().extension() == std::string(".") + kTraceExtension) {
+          trace_paths.push_back(entry.path());
+        }
+      }
+      // Keep the order of the results stable between runs.
+      std::sort(trace_paths.begin(), trace_paths.end());
+    } else {
+      trace_paths.push_back(std::move(path));
+    }
+  }
+  if (trace_paths.empty()) {
+    XELOGE("No trace files specified");
+    return 5;
+  }
+
+  if (!Setup()) {
+    XELOGE("Unable to setup trace benchmark tool");
+    return 4;
+  }
+
+  std::vector<TraceResult> results;
+  results.reserve(trace_paths.size());
+  int exit_code = 0;
+  for (const std::filesystem::path& trace_path : trace_paths) {
+    XELOGI("Benchmarking trace file {}...", xe::path_to_utf8(trace_path));
+    TraceResult& result = results.emplace_back();
+    if (!RunTrace(trace_path, result)) {
+      results.pop_back();
+      exit_code = 1;
+    }
+  }
+
+  std::string json = ResultsToJson(results);
+  if (cvars::trace_benchmark_output.empty()) {
+    std::fputs(json.c_str(), stdout);
+  } else {
+    xe::filesystem::CreateParentFolder(cvars::trace_benchmark_output);
+    FILE* file = filesystem::OpenFile(cvars::trace_benchmark_output, "wb");
+    if (file) {
+      std::fwrite(json.data(), 1, json.size(), file);
+      std::fclose(file);
+    } else {
+      XELOGE("Failed to open the benchmark output file {}",
+             xe::path_to_utf8(cvars::trace_benchmark_output));
+      exit_code = 1;
+    }
+  }
+
+  player_.reset();
+  emulator_.reset();
+  return exit_code;
+}
+
+bool TraceBenchmark::Setup() {
+  emulator_ = std::make_unique<Emulator>("", "", "", "");
+  X_STATUS result = emulator_->Setup(
+      nullptr, nullptr, false, nullptr,
+      [this]() { return CreateGraphicsSystem(); }, nullptr);
+  if (XFAILED(result)) {
+    XELOGE("Failed to setup emulator: {:08X}", result);
+    return false;
+  }
+  graphics_system_ = emulator_->graphics_system();
+  player_ = std::make_unique<TracePlayer>(graphics_system_);
+  return true;
+}
+
+bool TraceBenchmark::RunTrace(const std::filesystem::path& path,
+                              TraceResult& result_out) {
+  if (!player_->Open(xe::path_to_utf8(path))) {
+    XELOGE("Could not load trace file {}", xe::path_to_utf8(path));
+    return false;
+  }
+  result_out.path = path;
+  result_out.frame_count = player_->frame_count();
+  result_out.runs.clear();
+  result_out.run_cpu_vertex_shader_timings.clear();
+
+  double ticks_per_ms = double(Clock::QueryHostTickFrequency()) / 1000.0;
+  uint32_t run_count = std::max(cvars::trace_benchmark_runs, uint32_t(1));
+  for (uint32_t run = 0; run < run_count; ++run) {
+    std::vector<FrameTiming>& frame_timings = result_out.runs.emplace_back();
+    frame_timings.reserve(result_out.frame_count);
+    DrawExtentEstimator::Statistics run_start_statistics =
+        GetDrawExtentEstimatorStatistics();
+    for (int frame = 0; frame < result_out.frame_count; ++frame) {
+      uint64_t start_ticks = Clock::QueryHostTickCount();
+      player_->PlayFrame(frame);
+      player_->WaitOnPlayback();
+      uint64_t replay_ticks = Clock::QueryHostTickCount();
+      if (!AwaitHostGpuCompletion()) {
+        XELOGE("Failed to await the host GPU work of frame {} of {}", frame,
+               xe::path_to_utf8(path));
+        player_->Close();
+        return false;
+      }
+      uint64_t host_gpu_completion_ticks = Clock::QueryHostTickCount();
+      FrameTiming& frame_timing = frame_timings.emplace_back();
+      frame_timing.replay_ms =
+          double(replay_ticks - start_ticks) / ticks_per_ms;
+      frame_timing.host_gpu_completion_ms =
+          double(host_gpu_completion_ticks - start_ticks) / ticks_per_ms;
+    }
+    DrawExtentEstimator::Statistics run_end_statistics =
+        GetDrawExtentEstimatorStatistics();
+    VertexShaderTiming& vertex_shader_timing =
+        result_out.run_cpu_vertex_shader_timings.emplace_back();
+    vertex_shader_timing.vertex_count =
+        run_end_statistics.vertex_count - run_start_statistics.vertex_count;
+    vertex_shader_timing.ms =
+        double(run_end_statistics.host_ticks -
+               run_start_statistics.host_ticks) /
+        ticks_per_ms;
+  }
+
+  player_->Close();
+  return true;
+}
+
+bool TraceBenchmark::AwaitHostGpuCompletion() {
+  std::unique_ptr<xe::threading::Event> completion_event =
+      xe::threading::Event::CreateAutoResetEvent(false);
+  bool awaited = false;
+  CommandProcessor* command_processor = graphics_system_->command_processor();
+  command_processor->CallInThread([&]() {
+    awaited = command_processor->AwaitHostGpuCompletion();
+    completion_event->Set();
+  });
+  xe::threading::Wait(completion_event.get(), false);
+  return awaited;
+}
+
+DrawExtentEstimator::Statistics
+TraceBenchmark::GetDrawExtentEstimatorStatistics() {
+  std::unique_ptr<xe::threading::Event> completion_event =
+      xe::threading::Event::CreateAutoResetEvent(false);
+  DrawExtentEstimator::Statistics statistics;
+  CommandProcessor* command_processor = graphics_system_->command_processor();
+  command_processor->CallInThread([&]() {
+    statistics = command_processor->GetDrawExtentEstimatorStatistics();
+    completion_event->Set();
+  });
+  xe::threading::Wait(completion_event.get(), false);
+  return statistics;
+}
+
+namespace {
+std::string EscapeJsonString(const std::string_view string) {
+  std::string escaped;
+  escaped.reserve(string.size());
+  for (char c : string) {
+    switch (c) {
+      case '"':
+        escaped += "\\\"";
+        break;
+      case '\\':
+        escaped += "\\\\";
+        break;
+      default:
+        if (uint8_t(c) < 0x20) {
+          escaped += fmt::format("\\u{:04x}", uint32_t(uint8_t(c)));
+        } else {
+          escaped += c;
+        }
+        break;
+    }
+  }
+  return escaped;
+}
+}  // namespace
+
+std::string TraceBenchmark::ResultsToJson(
+    const std::vector<TraceResult>& results) const {
+  std::string json;
+  json += "{\n";
+  json += fmt::format("  \"backend\": \"{}\",\n",
+                      EscapeJsonString(graphics_system_->name()));
+  json += "  \"traces\": [";
+  for (size_t i = 0; i < results.size(); ++i) {
+    const TraceResult& result = results[i];
+    json += i ? ",\n" : "\n";
+    json += "    {\n";
+    json += fmt::format("      \"path\": \"{}\",\n",
+                        EscapeJsonString(xe::path_to_utf8(result.path)));
+    json += fmt::format("      \"frame_count\": {},\n", result.frame_count);
+    json += "      \"runs\": [";
+    for (size_t j = 0; j < result.runs.size(); ++j) {
+      const std::vector<FrameTiming>& frame_timings = result.runs[j];
+      double replay_total_ms = 0.0, replay_max_ms = 0.0;
+      double completion_total_ms = 0.0, completion_max_ms = 0.0;
+      std::string replay_ms_list, completion_ms_list;
+      for (size_t k = 0; k < frame_timings.size(); ++k) {
+        const FrameTiming& frame_timing = frame_timings[k];
+        replay_total_ms += frame_timing.replay_ms;
+        replay_max_ms = std::max(replay_max_ms, frame_timing.replay_ms);
+        completion_total_ms += frame_timing.host_gpu_completion_ms;
+        completion_max_ms =
+            std::max(completion_max_ms, frame_timing.host_gpu_completion_ms);
+        if (k) {
+          replay_ms_list += ", ";
+          completion_ms_list += ", ";
+        }
+        replay_ms_list += fmt::format("{:.4f}", frame_timing.replay_ms);
+        completion_ms_list +=
+            fmt::format("{:.4f}", frame_timing.host_gpu_completion_ms);
+      }
+      double frame_divisor =
+          double(std::max(frame_timings.size(), size_t(1)));
+      json += j ? ",\n" : "\n";
+      json += "        {\n";
+      json += fmt::format(
+          "          \"replay_ms\": {{\"total\": {:.4f}, \"average\": {:.4f}, "
+          "\"max\": {:.4f}, \"frames\": [{}]}},\n",
+          replay_total_ms, replay_total_ms / frame_divisor, replay_max_ms,
+          replay_ms_list);
+      json += fmt::format(
+          "          \"host_gpu_completion_ms\": {{\"total\": {:.4f}, "
+          "\"average\": {:.4f}, \"max\": {:.4f}, \"frames\": [{}]}},\n",
+          completion_total_ms, completion_total_ms / frame_divisor,
+          completion_max_ms, completion_ms_list);
+      const VertexShaderTiming& vertex_shader_timing =
+          result.run_cpu_vertex_shader_timings[j];
+      json += fmt::format(
+          "          \"cpu_vertex_shader\": {{\"vertices\": {}, "
+          "\"ms\": {:.4f}, \"vertices_per_second\": {:.1f}}}\n",
+          vertex_shader_timing.vertex_count, vertex_shader_timing.ms,
+          vertex_shader_timing.ms > 0.0
+              ? double(vertex_shader_timing.vertex_count) * 1000.0 /
+                    vertex_shader_timing.ms
+              : 0.0);
+      json += "        }";
+    }
+    json += "\n      ]\n";
+    json += "    }";
+  }
+  json += "\n  ]\n";
+  json += "}\n";
+  return json;
+}
+
+}  //  namespace gpu
+}  //  namespace xe
@@ -0,0 +1,74 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2026 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#ifndef XENIA_GPU_TRACE_BENCHMARK_H_
+#define XENIA_GPU_TRACE_BENCHMARK_H_
+
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "xenia/emulator.h"
+#include "xenia/gpu/draw_extent_estimator.h"
+#include "xenia/gpu/trace_player.h"
+
+namespace xe {
+namespace gpu {
+
+// Replays the traces a number of times without presenting, measuring the time
+// spent on each frame, for tracking the performance of the GPU backends.
+class TraceBenchmark {
+ public:
+  virtual ~TraceBenchmark();
+
+  int Main(const std::vector<std::string>& args);
+
+ protected:
+  TraceBenchmark();
+
+  virtual std::unique_ptr<gpu::GraphicsSystem> CreateGraphicsSystem() = 0;
+
+  std::unique_ptr<Emulator> emulator_;
+  GraphicsSystem* graphics_system_ = nullptr;
+  std::unique_ptr<TracePlayer> player_;
+
+ private:
+  struct FrameTiming {
+    // From the beginning of the replay of the frame to the moment the command
+    // processor has processed all of its commands.
+    double replay_ms;
+    // From the beginning of the replay to the completion of the host GPU work.
+    double host_gpu_completion_ms;
+  };
+  struct VertexShaderTiming {
+    // Vertices the vertex shader was executed for on the CPU for draw extent
+    // estimation during the run.
+    uint64_t vertex_count = 0;
+    double ms = 0.0;
+  };
+  struct TraceResult {
+    std::filesystem::path path;
+    int frame_count = 0;
+    // Per run.
+    std::vector<std::vector<FrameTiming>> runs;
+    std::vector<VertexShaderTiming> run_cpu_vertex_shader_timings;
+  };
+
+  bool Setup();
+  bool RunTrace(const std::filesystem::path& path, TraceResult& result_out);
+  bool AwaitHostGpuCompletion();
+  DrawExtentEstimator::Statistics GetDrawExtentEstimatorStatistics();
+  std::string ResultsToJson(const std::vector<TraceResult>& results) const;
+};
+
+}  // namespace gpu
+}  // namespace xe
+
+#endif  // XENIA_GPU_TRACE_BENCHMARK_H_
@@ -9,14 +9,25 @@
 
 #include "xenia/gpu/trace_player.h"
 
+#include <algorithm>
+#include <cstring>
 #include <memory>
 
+#include "xenia/base/cvar.h"
 #include "xenia/gpu/command_processor.h"
 #include "xenia/gpu/graphics_system.h"
+#include "xenia/gpu/register_file.h"
 #include "xenia/gpu/registers.h"
 #include "xenia/gpu/xenos.h"
 #include "xenia/memory.h"
 
+DEFINE_uint32(trace_checkpoint_interval, 100,
+              "Number of commands between the GPU state checkpoints recorded "
+              "while replaying a frame of a trace, for seeking backwards "
+              "without replaying the whole frame. Each checkpoint may take "
+              "more than 10 MB. 0 to disable.",
+              "GPU");
+
 namespace xe {
 namespace gpu {
 
@@ -75,12 +86,33 @@ void TracePlayer::SeekCommand(int target_command) {
               command.end_ptr - previous_command.end_ptr,
               TracePlaybackMode::kBreakOnSwap, false);
   } else {
-    // Full playback from frame start.
-    PlayTrace(frame->start_ptr, command.end_ptr - frame->start_ptr,
-              TracePlaybackMode::kBreakOnSwap, true);
+    // Playback from the nearest checkpoint, or full playback from frame start.
+    playing_trace_ = true;
+    graphics_system_->command_processor()->CallInThread(
+        [this, frame, target_command]() {
+          const uint8_t* start_ptr =
+              RestoreCheckpointOnThread(frame, target_command);
+          bool clear_caches = !start_ptr;
+          if (!start_ptr) {
+            start_ptr = frame->start_ptr;
+          }
+          const auto& command = frame->commands[target_command];
+          PlayTraceOnThread(frame, start_ptr, command.end_ptr - start_ptr,
+                            TracePlaybackMode::kBreakOnSwap, clear_caches);
+        });
   }
 }
 
+void TracePlayer::PlayFrame(int target_frame) {
+  current_frame_index_ = target_frame;
+  auto frame = current_frame();
+  current_command_index_ = int(frame->commands.size()) - 1;
+
+  assert_true(frame->start_ptr <= frame->end_ptr);
+  PlayTrace(frame->start_ptr, frame->end_ptr - frame->start_ptr,
+            TracePlaybackMode::kUntilEnd, false);
+}
+
 void TracePlayer::WaitOnPlayback() {
   xe::threading::Wait(playback_event_.get(), true);
 }
@@ -89,12 +121,15 @@ void TracePlayer::PlayTrace(const uint8_t* trace_data, size_t trace_size,
                             TracePlaybackMode playback_mode,
                             bool clear_caches) {
   playing_trace_ = true;
+  const Frame* frame = current_frame();
   graphics_system_->command_processor()->CallInThread([=]() {
-    PlayTraceOnThread(trace_data, trace_size, playback_mode, clear_caches);
+    PlayTraceOnThread(frame, trace_data, trace_size, playback_mode,
+                      clear_caches);
   });
 }
 
-void TracePlayer::PlayTraceOnThread(const uint8_t* trace_data,
+void TracePlayer::PlayTraceOnThread(const Frame* frame,
+                                    const uint8_t* trace_data,
                                     size_t trace_size,
                                     TracePlaybackMode playback_mode,
                                     bool clear_caches) {
@@ -105,6 +140,8 @@ void TracePlayer::PlayTraceOnThread(const uint8_t* trace_data,
     command_processor->ClearCaches();
   }
 
+  BeginCheckpointTrackingOnThread(frame, trace_data);
+
   playback_percent_ = 0;
   auto trace_end = trace_data + trace_size;
 
@@ -162,6 +199,7 @@ void TracePlayer::PlayTraceOnThread(const uint8_t* trace_data,
                                            pending_packet->count);
           pending_packet = nullptr;
         }
+        OnCommandEndOnThread(trace_ptr);
         if (pending_break) {
           playing_trace_ = false;
           return;
@@ -177,6 +215,10 @@ void TracePlayer::PlayTraceOnThread(const uint8_t* trace_data,
         trace_ptr += cmd->encoded_length;
         command_processor->TracePlaybackWroteMemory(cmd->base_ptr,
                                                     cmd->decoded_length);
+        if (tracked_trace_ptr_) {
+          tracked_memory_writes_.emplace_back(cmd->base_ptr,
+                                              cmd->decoded_length);
+        }
         break;
       }
       case TraceCommandType::kMemoryWrite: {
@@ -242,10 +284,150 @@ void TracePlayer::PlayTraceOnThread(const uint8_t* trace_data,
     }
   }
 
+  if (tracked_trace_ptr_) {
+    tracked_trace_ptr_ = trace_ptr;
+  }
+
   playing_trace_ = false;
 
   playback_event_->Set();
 }
 
+void TracePlayer::BeginCheckpointTrackingOnThread(const Frame* frame,
+                                                  const uint8_t* trace_data) {
+  if (checkpoint_frame_ != frame) {
+    checkpoint_frame_ = frame;
+    checkpoints_.clear();
+    tracked_trace_ptr_ = nullptr;
+  }
+  if (!cvars::trace_checkpoint_interval || !frame) {
+    tracked_trace_ptr_ = nullptr;
+    return;
+  }
+  if (trace_data == frame->start_ptr) {
+    tracked_trace_ptr_ = trace_data;
+    tracked_checkpoint_count_ = 0;
+    tracked_memory_writes_.clear();
+  } else if (trace_data != tracked_trace_ptr_) {
+    // Not continuing the tracked playback, the memory written before is
+    // unknown.
+    tracked_trace_ptr_ = nullptr;
+  }
+}
+
+void TracePlayer::OnCommandEndOnThread(const uint8_t* trace_ptr) {
+  if (!tracked_trace_ptr_) {
+    return;
+  }
+  tracked_trace_ptr_ = trace_ptr;
+  size_t command_index = (tracked_checkpoint_count_ + 1) *
+                             size_t(cvars::trace_checkpoint_interval) -
+                         1;
+  if (command_index >= checkpoint_frame_->commands.size() ||
+      checkpoint_frame_->commands[command_index].end_ptr != trace_ptr) {
+    return;
+  }
+  if (tracked_checkpoint_count_ >= checkpoints_.size()) {
+    RecordCheckpointOnThread(int(command_index));
+  }
+  ++tracked_checkpoint_count_;
+  tracked_memory_writes_.clear();
+}
+
+void TracePlayer::RecordCheckpointOnThread(int command_index) {
+  auto memory = graphics_system_->memory();
+  auto command_processor = graphics_system_->command_processor();
+
+  Checkpoint& checkpoint = checkpoints_.emplace_back();
+  checkpoint.command_index = command_index;
+
+  const RegisterFile& register_file = *graphics_system_->register_file();
+  checkpoint.registers.assign(
+      register_file.values,
+      register_file.values + RegisterFile::kRegisterCount);
+
+  // Merge the overlapping writes not to store the same memory multiple times.
+  std::sort(tracked_memory_writes_.begin(), tracked_memory_writes_.end());
+  for (const auto& write : tracked_memory_writes_) {
+    if (!checkpoint.memory_ranges.empty()) {
+      auto& last_range = checkpoint.memory_ranges.back();
+      uint64_t last_range_end = uint64_t(last_range.first) + last_range.second;
+      if (write.first <= last_range_end) {
+        last_range.second = uint32_t(
+            std::max(last_range_end, uint64_t(write.first) + write.second) -
+            last_range.first);
+        continue;
+      }
+    }
+    checkpoint.memory_ranges.push_back(write);
+  }
+  size_t memory_size = 0;
+  for (const auto& range : checkpoint.memory_ranges) {
+    memory_size += range.second;
+  }
+  checkpoint.memory_data.resize(memory_size);
+  uint8_t* memory_data = checkpoint.memory_data.data();
+  for (const auto& range : checkpoint.memory_ranges) {
+    std::memcpy(memory_data, memory->TranslatePhysical(range.first),
+                range.second);
+    memory_data += range.second;
+  }
+
+  checkpoint.edram.reset(new uint8_t[xenos::kEdramSizeBytes]);
+  if (!command_processor->SaveEdramSnapshot(checkpoint.edram.get())) {
+    checkpoint.edram.reset();
+  }
+}
+
+const uint8_t* TracePlayer::RestoreCheckpointOnThread(const Frame* frame,
+                                                      int target_command) {
+  if (checkpoint_frame_ != frame) {
+    return nullptr;
+  }
+  size_t checkpoint_count = 0;
+  while (checkpoint_count < checkpoints_.size() &&
+         checkpoints_[checkpoint_count].command_index <= target_command) {
+    ++checkpoint_count;
+  }
+  if (!checkpoint_count) {
+    return nullptr;
+  }
+
+  auto memory = graphics_system_->memory();
+  auto command_processor = graphics_system_->command_processor();
+
+  command_processor->ClearCaches();
+
+  // The memory written by the trace up to the checkpoint, in the order it was
+  // recorded, so the latest contents are written last.
+  for (size_t i = 0; i < checkpoint_count; ++i) {
+    const Checkpoint& checkpoint = checkpoints_[i];
+    const uint8_t* memory_data = checkpoint.memory_data.data();
+    for (const auto& range : checkpoint.memory_ranges) {
+      std::memcpy(memory->TranslatePhysical(range.first), memory_data,
+                  range.second);
+      memory_data += range.second;
+      command_processor->TracePlaybackWroteMemory(range.first, range.second);
+    }
+  }
+
+  const Checkpoint& checkpoint = checkpoints_[checkpoint_count - 1];
+  command_processor->RestoreRegisters(
+      0, checkpoint.registers.data(), uint32_t(checkpoint.registers.size()),
+      false);
+  if (checkpoint.edram) {
+    command_processor->RestoreEdramSnapshot(checkpoint.edram.get());
+  }
+
+  const uint8_t* checkpoint_ptr =
+      frame->commands[checkpoint.command_index].end_ptr;
+  if (cvars::trace_checkpoint_interval) {
+    tracked_trace_ptr_ = checkpoint_ptr;
+    tracked_checkpoint_count_ = checkpoint_count;
+    tracked_memory_writes_.clear();
+  }
+  return checkpoint_ptr;
+}
+
 }  // namespace gpu
 }  // namespace xe
@@ -11,7 +11,11 @@
 #define XENIA_GPU_TRACE_PLAYER_H_
 
 #include <atomic>
+#include <cstdint>
+#include <memory>
 #include <string>
+#include <utility>
+#include <vector>
 
 #include "xenia/base/threading.h"
 #include "xenia/gpu/trace_protocol.h"
@@ -43,14 +47,44 @@ class TracePlayer : public TraceReader {
 
   void SeekFrame(int target_frame);
   void SeekCommand(int target_command);
+  // Plays all the commands of the frame even if it's the current one, for
+  // benchmarking, use WaitOnPlayback to await the completion.
+  void PlayFrame(int target_frame);
 
   void WaitOnPlayback();
 
  private:
+  // GPU state after a command of the frame, for seeking backwards without
+  // replaying the whole frame. Recorded every trace_checkpoint_interval
+  // commands while the frame is played from its start.
+  struct Checkpoint {
+    int command_index;
+    std::vector<uint32_t> registers;
+    // Guest physical memory ranges written by the trace since the previous
+    // checkpoint, with their contents at this one, so the checkpoints up to
+    // this one together contain all the memory written by the trace in the
+    // frame so far.
+    std::vector<std::pair<uint32_t, uint32_t>> memory_ranges;
+    std::vector<uint8_t> memory_data;
+    // Null if the command processor can't read the EDRAM back, in which case
+    // the EDRAM snapshots in the trace are not restored either.
+    std::unique_ptr<uint8_t[]> edram;
+  };
+
   void PlayTrace(const uint8_t* trace_data, size_t trace_size,
                  TracePlaybackMode playback_mode, bool clear_caches);
-  void PlayTraceOnThread(const uint8_t* trace_data, size_t trace_size,
-                         TracePlaybackMode playback_mode, bool clear_caches);
+  void PlayTraceOnThread(const Frame* frame, const uint8_t* trace_data,
+                         size_t trace_size, TracePlaybackMode playback_mode,
+                         bool clear_caches);
+
+  void BeginCheckpointTrackingOnThread(const Frame* frame,
+                                       const uint8_t* trace_data);
+  void OnCommandEndOnThread(const uint8_t* trace_ptr);
+  void RecordCheckpointOnThread(int command_index);
+  // Restores the latest checkpoint not after the command, returning the trace
+  // pointer to continue the playback from, or nullptr if there's none.
+  const uint8_t* RestoreCheckpointOnThread(const Frame* frame,
+                                           int target_command);
 
   GraphicsSystem* graphics_system_;
   int current_frame_index_;
@@ -58,6 +92,16 @@ class TracePlayer : public TraceReader {
   bool playing_trace_ = false;
   std::atomic<uint32_t> playback_percent_ = {0};
   std::unique_ptr<xe::threading::Event> playback_event_;
+
+  // Checkpoints, only accessed on the command processor thread.
+  const Frame* checkpoint_frame_ = nullptr;
+  std::vector<Checkpoint> checkpoints_;
+  // The end of the playback since the frame start or a checkpoint, while
+  // memory writes are tracked for recording checkpoints, or nullptr.
+  const uint8_t* tracked_trace_ptr_ = nullptr;
+  // Checkpoints reached by the tracked playback.
+  size_t tracked_checkpoint_count_ = 0;
+  std::vector<std::pair<uint32_t, uint32_t>> tracked_memory_writes_;
 };
 
 }  // namespace gpu
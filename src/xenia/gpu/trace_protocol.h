@@ -23,7 +23,10 @@ static const char kTraceExtension[] = "xtr";
 // Other changes besides the file format may require bumps, such as
 // anything that changes what is recorded into the files (new GPU
 // command processor commands, etc).
-constexpr uint32_t kTraceFormatVersion = 1;
+constexpr uint32_t kTraceFormatVersion = 2;
+// Version 2 only added new memory encoding formats, so older traces can still
+// be read.
+constexpr uint32_t kTraceFormatVersionMinReadable = 1;
 
 // Trace file header identifying information about the trace.
 // This must be positioned at the start of the file and must only occur once.
@@ -95,6 +98,21 @@ enum class MemoryEncodingFormat {
   kNone,
   // Data is compressed with third_party/snappy.
   kSnappy,
+  // Data is compressed with third_party/zstd.
+  kZstd,
+  // Data is a MemoryDeltaReference followed by a third_party/zstd frame
+  // compressed with the decoded data of the referenced memory command as the
+  // raw content prefix (dictionary), for efficient storage of ranges
+  // uploaded repeatedly with only parts of the contents changed. Only used
+  // for memory commands, referencing an earlier memory command for the same
+  // range that is not encoded as a delta itself, so traces can still be
+  // played starting from any command.
+  kZstdDelta,
+};
+
+struct MemoryDeltaReference {
+  // Offset of the referenced MemoryCommand from the beginning of the file.
+  uint64_t command_offset;
 };
 
 // Represents the GPU reading or writing data from or to memory.
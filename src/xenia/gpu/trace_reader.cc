@@ -10,8 +10,10 @@
 #include "xenia/gpu/trace_reader.h"
 
 #include <cinttypes>
+#include <cstring>
 
 #include "third_party/snappy/snappy.h"
+#include "third_party/zstd/lib/zstd.h"
 #include "xenia/base/filesystem.h"
 #include "xenia/base/logging.h"
 #include "xenia/base/mapped_memory.h"
@@ -24,6 +26,12 @@
 namespace xe {
 namespace gpu {
 
+TraceReader::~TraceReader() {
+  if (zstd_dctx_) {
+    ZSTD_freeDCtx(zstd_dctx_);
+  }
+}
+
 bool TraceReader::Open(const std::string_view path) {
   Close();
 
@@ -46,7 +54,8 @@ bool TraceReader::Open(const std::string_view path) {
 
   // Verify version.
   auto header = reinterpret_cast<const TraceHeader*>(trace_data_);
-  if (header->version != kTraceFormatVersion) {
+  if (header->version < kTraceFormatVersionMinReadable ||
+      header->version > kTraceFormatVersion) {
     XELOGE("Trace format version mismatch, code has {}, file has {}",
            kTraceFormatVersion, header->version);
     if (header->version < kTraceFormatVersion) {
@@ -71,6 +80,8 @@ void TraceReader::Close() {
   mmap_.reset();
   trace_data_ = nullptr;
   trace_size_ = 0;
+  delta_reference_offset_ = UINT64_MAX;
+  delta_reference_data_.clear();
 }
 
 void TraceReader::ParseTrace() {
@@ -248,6 +259,71 @@ bool TraceReader::DecompressMemory(MemoryEncodingFormat encoding_format,
     case MemoryEncodingFormat::kSnappy:
       return snappy::RawUncompress(reinterpret_cast<const char*>(src), src_size,
                                    reinterpret_cast<char*>(dest));
+    case MemoryEncodingFormat::kZstd:
+    case MemoryEncodingFormat::kZstdDelta: {
+      if (!zstd_dctx_) {
+        zstd_dctx_ = ZSTD_createDCtx();
+        if (!zstd_dctx_) {
+          XELOGE("Failed to create a zstd decompression context");
+          return false;
+        }
+      }
+      if (encoding_format == MemoryEncodingFormat::kZstdDelta) {
+        MemoryDeltaReference delta_reference;
+        if (src_size < sizeof(delta_reference)) {
+          return false;
+        }
+        std::memcpy(&delta_reference, src, sizeof(delta_reference));
+        src = reinterpret_cast<const uint8_t*>(src) + sizeof(delta_reference);
+        src_size -= sizeof(delta_reference);
+        if (delta_reference_offset_ != delta_reference.command_offset) {
+          if (delta_reference.command_offset >= trace_size_ ||
+              trace_size_ - delta_reference.command_offset <
+                  sizeof(MemoryCommand)) {
+            XELOGE("Invalid trace memory delta reference offset {}",
+                   delta_reference.command_offset);
+            return false;
+          }
+          auto reference_cmd = reinterpret_cast<const MemoryCommand*>(
+              trace_data_ + delta_reference.command_offset);
+          if ((reference_cmd->type != TraceCommandType::kMemoryRead &&
+               reference_cmd->type != TraceCommandType::kMemoryWrite) ||
+              reference_cmd->encoding_format ==
+                  MemoryEncodingFormat::kZstdDelta ||
+              reference_cmd->decoded_length != dest_size ||
+              trace_size_ - delta_reference.command_offset -
+                      sizeof(MemoryCommand) <
+                  reference_cmd->encoded_length) {
+            XELOGE("Invalid trace memory delta reference at offset {}",
+                   delta_reference.command_offset);
+            return false;
+          }
+          delta_reference_data_.resize(reference_cmd->decoded_length);
+          // Invalidate in case of a failure.
+          delta_reference_offset_ = UINT64_MAX;
+          if (!DecompressMemory(reference_cmd->encoding_format,
+                                reference_cmd + 1,
+                                reference_cmd->encoded_length,
+                                delta_reference_data_.data(),
+                                delta_reference_data_.size())) {
+            return false;
+          }
+          delta_reference_offset_ = delta_reference.command_offset;
+        }
+        // The prefix is only used for the next decompression.
+        ZSTD_DCtx_refPrefix(zstd_dctx_, delta_reference_data_.data(),
+                            delta_reference_data_.size());
+      }
+      size_t decoded_size =
+          ZSTD_decompressDCtx(zstd_dctx_, dest, dest_size, src, src_size);
+      if (ZSTD_isError(decoded_size)) {
+        XELOGE("Failed to decompress trace data with zstd: {}",
+               ZSTD_getErrorName(decoded_size));
+        ZSTD_DCtx_reset(zstd_dctx_, ZSTD_reset_session_only);
+        return false;
+      }
+      return decoded_size == dest_size;
+    }
     default:
       assert_unhandled_case(encoding_format);
       return false;
@@ -10,6 +10,7 @@
 #ifndef XENIA_GPU_TRACE_READER_H_
 #define XENIA_GPU_TRACE_READER_H_
 
+#include <cstdint>
 #include <string_view>
 #include <vector>
 
@@ -17,6 +18,8 @@
 #include "xenia/gpu/trace_protocol.h"
 #include "xenia/memory.h"
 
+struct ZSTD_DCtx_s;
+
 namespace xe {
 namespace gpu {
 
@@ -90,7 +93,7 @@ class TraceReader {
   };
 
   TraceReader() = default;
-  virtual ~TraceReader() = default;
+  virtual ~TraceReader();
 
   const TraceHeader* header() const {
     return reinterpret_cast<const TraceHeader*>(trace_data_);
@@ -112,6 +115,12 @@ class TraceReader {
   const uint8_t* trace_data_ = nullptr;
   size_t trace_size_ = 0;
   std::vector<Frame> frames_;
+
+  ZSTD_DCtx_s* zstd_dctx_ = nullptr;
+  // The decoded data of the last memory command referenced by a delta-encoded
+  // one, often the same for a long sequence of commands.
+  uint64_t delta_reference_offset_ = UINT64_MAX;
+  std::vector<uint8_t> delta_reference_data_;
 };
 
 }  // namespace gpu
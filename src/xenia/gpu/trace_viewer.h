@@ -83,6 +83,8 @@ class TraceViewer : public xe::ui::WindowedApp {
                                TraceViewer& trace_viewer)
         : xe::ui::ImGuiDialog(imgui_drawer), trace_viewer_(trace_viewer) {}
 
+    bool IsUpdatedContinuously() const override { return true; }
+
    protected:
     void OnDraw(ImGuiIO& io) override;
 
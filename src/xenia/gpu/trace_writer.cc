@@ -12,14 +12,15 @@
 #include <cstring>
 #include <memory>
 
-#include "third_party/snappy/snappy-sinksource.h"
 #include "third_party/snappy/snappy.h"
+#include "third_party/zstd/lib/zstd.h"
 
 #include "build/version.h"
 #include "xenia/base/assert.h"
 #include "xenia/base/filesystem.h"
 #include "xenia/base/logging.h"
 #include "xenia/base/string.h"
+#include "xenia/gpu/gpu_flags.h"
 #include "xenia/gpu/registers.h"
 #include "xenia/gpu/xenos.h"
 
@@ -29,7 +30,12 @@ namespace gpu {
 TraceWriter::TraceWriter(uint8_t* membase)
     : membase_(membase), file_(nullptr) {}
 
-TraceWriter::~TraceWriter() = default;
+TraceWriter::~TraceWriter() {
+  Close();
+  if (zstd_cctx_) {
+    ZSTD_freeCCtx(zstd_cctx_);
+  }
+}
 
 bool TraceWriter::Open(const std::filesystem::path& path, uint32_t title_id) {
   Close();
@@ -53,7 +59,21 @@ bool TraceWriter::Open(const std::filesystem::path& path, uint32_t title_id) {
   header.title_id = title_id;
   fwrite(&header, sizeof(header), 1, file_);
 
+  if (cvars::trace_gpu_compression == "none") {
+    compression_format_ = MemoryEncodingFormat::kNone;
+  } else if (cvars::trace_gpu_compression == "zstd") {
+    compression_format_ = MemoryEncodingFormat::kZstd;
+  } else {
+    if (cvars::trace_gpu_compression != "snappy") {
+      XELOGW("Unknown trace_gpu_compression {}, using snappy",
+             cvars::trace_gpu_compression);
+    }
+    compression_format_ = MemoryEncodingFormat::kSnappy;
+  }
+
   cached_memory_reads_.clear();
+  delta_references_.clear();
+  delta_references_total_size_ = 0;
   return true;
 }
 
@@ -66,6 +86,8 @@ void TraceWriter::Flush() {
 void TraceWriter::Close() {
   if (file_) {
     cached_memory_reads_.clear();
+    delta_references_.clear();
+    delta_references_total_size_ = 0;
 
     fflush(file_);
     fclose(file_);
@@ -182,82 +204,118 @@ void TraceWriter::WriteMemoryWrite(uint32_t base_ptr, size_t length,
                      host_ptr);
 }
 
-class SnappySink : public snappy::Sink {
- public:
-  SnappySink(FILE* file) : file_(file) {}
-
-  void Append(const char* bytes, size_t n) override {
-    fwrite(bytes, 1, n, file_);
-  }
-
- private:
-  FILE* file_ = nullptr;
-};
-
 void TraceWriter::WriteMemoryCommand(TraceCommandType type, uint32_t base_ptr,
                                      size_t length, const void* host_ptr) {
   MemoryCommand cmd = {};
   cmd.type = type;
   cmd.base_ptr = base_ptr;
-  cmd.encoding_format = MemoryEncodingFormat::kNone;
-  cmd.encoded_length = cmd.decoded_length = static_cast<uint32_t>(length);
+  cmd.decoded_length = static_cast<uint32_t>(length);
 
   if (!host_ptr) {
     host_ptr = membase_ + cmd.base_ptr;
   }
 
-  bool compress = compress_output_ && length > compression_threshold_;
-  if (compress) {
-    // Write the header now so we reserve space in the buffer.
-    long header_position = std::ftell(file_);
-    cmd.encoding_format = MemoryEncodingFormat::kSnappy;
-    fwrite(&cmd, 1, sizeof(cmd), file_);
-
-    // Stream the content right to the buffer.
-    snappy::ByteArraySource snappy_source(
-        reinterpret_cast<const char*>(host_ptr), cmd.decoded_length);
-    SnappySink snappy_sink(file_);
-    cmd.encoded_length =
-        static_cast<uint32_t>(snappy::Compress(&snappy_source, &snappy_sink));
+  cmd.encoding_format = MemoryEncodingFormat::kNone;
+  if (length > compression_threshold_) {
+    // With zstd, encode the data as the difference from the earliest
+    // non-delta-encoded contents of the same range, or make this command the
+    // reference for later ones.
+    DeltaReference* delta_reference = nullptr;
+    uint64_t delta_reference_key = 0;
+    if (compression_format_ == MemoryEncodingFormat::kZstd) {
+      delta_reference_key = uint64_t(base_ptr) << 32 | uint64_t(length);
+      auto delta_reference_it = delta_references_.find(delta_reference_key);
+      if (delta_reference_it != delta_references_.end()) {
+        delta_reference = &delta_reference_it->second;
+      }
+    }
+    cmd.encoding_format = EncodeData(host_ptr, length, delta_reference);
+    if (compression_format_ == MemoryEncodingFormat::kZstd &&
+        !delta_reference &&
+        delta_references_total_size_ + length <=
+            kDeltaReferencesMaxTotalSize) {
+      DeltaReference& new_delta_reference =
+          delta_references_[delta_reference_key];
+      new_delta_reference.command_offset =
+          uint64_t(xe::filesystem::Tell(file_));
+      new_delta_reference.data.reset(new uint8_t[length]);
+      std::memcpy(new_delta_reference.data.get(), host_ptr, length);
+      delta_references_total_size_ += length;
+    }
+  }
 
-    // Seek back and overwrite the header with our final size.
-    std::fseek(file_, header_position, SEEK_SET);
+  if (cmd.encoding_format != MemoryEncodingFormat::kNone) {
+    cmd.encoded_length = uint32_t(encoded_data_.size());
     fwrite(&cmd, 1, sizeof(cmd), file_);
-    std::fseek(file_, header_position + sizeof(cmd) + cmd.encoded_length,
-               SEEK_SET);
+    fwrite(encoded_data_.data(), 1, encoded_data_.size(), file_);
   } else {
     // Uncompressed - write buffer directly to the file.
-    cmd.encoding_format = MemoryEncodingFormat::kNone;
+    cmd.encoded_length = cmd.decoded_length;
     fwrite(&cmd, 1, sizeof(cmd), file_);
     fwrite(host_ptr, 1, cmd.decoded_length, file_);
   }
 }
 
+MemoryEncodingFormat TraceWriter::EncodeData(
+    const void* data, size_t length, const DeltaReference* delta_reference) {
+  switch (compression_format_) {
+    case MemoryEncodingFormat::kSnappy: {
+      encoded_data_.resize(snappy::MaxCompressedLength(length));
+      size_t encoded_length;
+      snappy::RawCompress(reinterpret_cast<const char*>(data), length,
+                          reinterpret_cast<char*>(encoded_data_.data()),
+                          &encoded_length);
+      encoded_data_.resize(encoded_length);
+      return MemoryEncodingFormat::kSnappy;
+    }
+    case MemoryEncodingFormat::kZstd: {
+      if (!zstd_cctx_) {
+        zstd_cctx_ = ZSTD_createCCtx();
+        if (!zstd_cctx_) {
+          XELOGE("Failed to create a zstd compression context for the trace");
+          return MemoryEncodingFormat::kNone;
+        }
+        ZSTD_CCtx_setParameter(zstd_cctx_, ZSTD_c_compressionLevel,
+                               kZstdCompressionLevel);
+      }
+      size_t header_size = delta_reference ? sizeof(MemoryDeltaReference) : 0;
+      encoded_data_.resize(header_size + ZSTD_compressBound(length));
+      if (delta_reference) {
+        MemoryDeltaReference delta_reference_header;
+        delta_reference_header.command_offset = delta_reference->command_offset;
+        std::memcpy(encoded_data_.data(), &delta_reference_header,
+                    sizeof(delta_reference_header));
+        // The prefix is only used for the next compression.
+        ZSTD_CCtx_refPrefix(zstd_cctx_, delta_reference->data.get(), length);
+      }
+      size_t encoded_length =
+          ZSTD_compress2(zstd_cctx_, encoded_data_.data() + header_size,
+                         encoded_data_.size() - header_size, data, length);
+      if (ZSTD_isError(encoded_length)) {
+        XELOGE("Failed to compress trace data with zstd: {}",
+               ZSTD_getErrorName(encoded_length));
+        ZSTD_CCtx_reset(zstd_cctx_, ZSTD_reset_session_only);
+        return MemoryEncodingFormat::kNone;
+      }
+      encoded_data_.resize(header_size + encoded_length);
+      return delta_reference ? MemoryEncodingFormat::kZstdDelta
+                             : MemoryEncodingFormat::kZstd;
+    }
+    default:
+      return MemoryEncodingFormat::kNone;
+  }
+}
+
 void TraceWriter::WriteEdramSnapshot(const void* snapshot) {
   EdramSnapshotCommand cmd = {};
   cmd.type = TraceCommandType::kEdramSnapshot;
-
-  if (compress_output_) {
-    // Write the header now so we reserve space in the buffer.
-    long header_position = std::ftell(file_);
-    cmd.encoding_format = MemoryEncodingFormat::kSnappy;
-    fwrite(&cmd, 1, sizeof(cmd), file_);
-
-    // Stream the content right to the buffer.
-    snappy::ByteArraySource snappy_source(
-        reinterpret_cast<const char*>(snapshot), xenos::kEdramSizeBytes);
-    SnappySink snappy_sink(file_);
-    cmd.encoded_length =
-        static_cast<uint32_t>(snappy::Compress(&snappy_source, &snappy_sink));
-
-    // Seek back and overwrite the header with our final size.
-    std::fseek(file_, header_position, SEEK_SET);
+  cmd.encoding_format = EncodeData(snapshot, xenos::kEdramSizeBytes);
+  if (cmd.encoding_format != MemoryEncodingFormat::kNone) {
+    cmd.encoded_length = uint32_t(encoded_data_.size());
     fwrite(&cmd, 1, sizeof(cmd), file_);
-    std::fseek(file_, header_position + sizeof(cmd) + cmd.encoded_length,
-               SEEK_SET);
+    fwrite(encoded_data_.data(), 1, encoded_data_.size(), file_);
   } else {
     // Uncompressed - write buffer directly to the file.
-    cmd.encoding_format = MemoryEncodingFormat::kNone;
     cmd.encoded_length = xenos::kEdramSizeBytes;
     fwrite(&cmd, 1, sizeof(cmd), file_);
     fwrite(snapshot, 1, xenos::kEdramSizeBytes, file_);
@@ -286,27 +344,13 @@ void TraceWriter::WriteRegisters(uint32_t first_register,
   cmd.execute_callbacks = execute_callbacks_on_play;
 
   uint32_t uncompressed_length = uint32_t(sizeof(uint32_t) * register_count);
-  if (compress_output_) {
-    // Write the header now so we reserve space in the buffer.
-    long header_position = std::ftell(file_);
-    cmd.encoding_format = MemoryEncodingFormat::kSnappy;
+  cmd.encoding_format = EncodeData(register_values, uncompressed_length);
+  if (cmd.encoding_format != MemoryEncodingFormat::kNone) {
+    cmd.encoded_length = uint32_t(encoded_data_.size());
     fwrite(&cmd, 1, sizeof(cmd), file_);
-
-    // Stream the content right to the buffer.
-    snappy::ByteArraySource snappy_source(
-        reinterpret_cast<const char*>(register_values), uncompressed_length);
-    SnappySink snappy_sink(file_);
-    cmd.encoded_length =
-        static_cast<uint32_t>(snappy::Compress(&snappy_source, &snappy_sink));
-
-    // Seek back and overwrite the header with our final size.
-    std::fseek(file_, header_position, SEEK_SET);
-    fwrite(&cmd, 1, sizeof(cmd), file_);
-    std::fseek(file_, header_position + sizeof(cmd) + cmd.encoded_length,
-               SEEK_SET);
+    fwrite(encoded_data_.data(), 1, encoded_data_.size(), file_);
   } else {
     // Uncompressed - write the values directly to the file.
-    cmd.encoding_format = MemoryEncodingFormat::kNone;
     cmd.encoded_length = uncompressed_length;
     fwrite(&cmd, 1, sizeof(cmd), file_);
     fwrite(register_values, 1, uncompressed_length, file_);
@@ -327,34 +371,20 @@ void TraceWriter::WriteGammaRamp(
       sizeof(reg::DC_LUT_PWL_DATA) * 3 * 128;
   constexpr uint32_t kUncompressedLength =
       k256EntryTableUncompressedLength + kPWLUncompressedLength;
-  if (compress_output_) {
-    // Write the header now so we reserve space in the buffer.
-    long header_position = std::ftell(file_);
-    cmd.encoding_format = MemoryEncodingFormat::kSnappy;
-    fwrite(&cmd, 1, sizeof(cmd), file_);
-
-    // Stream the content right to the buffer.
-    {
-      std::unique_ptr<char[]> gamma_ramps(new char[kUncompressedLength]);
-      std::memcpy(gamma_ramps.get(), gamma_ramp_256_entry_table,
-                  k256EntryTableUncompressedLength);
-      std::memcpy(gamma_ramps.get() + k256EntryTableUncompressedLength,
-                  gamma_ramp_pwl_rgb, kPWLUncompressedLength);
-      snappy::ByteArraySource snappy_source(gamma_ramps.get(),
-                                            kUncompressedLength);
-      SnappySink snappy_sink(file_);
-      cmd.encoded_length =
-          static_cast<uint32_t>(snappy::Compress(&snappy_source, &snappy_sink));
-    }
-
-    // Seek back and overwrite the header with our final size.
-    std::fseek(file_, header_position, SEEK_SET);
+  {
+    std::unique_ptr<char[]> gamma_ramps(new char[kUncompressedLength]);
+    std::memcpy(gamma_ramps.get(), gamma_ramp_256_entry_table,
+                k256EntryTableUncompressedLength);
+    std::memcpy(gamma_ramps.get() + k256EntryTableUncompressedLength,
+                gamma_ramp_pwl_rgb, kPWLUncompressedLength);
+    cmd.encoding_format = EncodeData(gamma_ramps.get(), kUncompressedLength);
+  }
+  if (cmd.encoding_format != MemoryEncodingFormat::kNone) {
+    cmd.encoded_length = uint32_t(encoded_data_.size());
     fwrite(&cmd, 1, sizeof(cmd), file_);
-    std::fseek(file_, header_position + sizeof(cmd) + cmd.encoded_length,
-               SEEK_SET);
+    fwrite(encoded_data_.data(), 1, encoded_data_.size(), file_);
   } else {
     // Uncompressed - write the values directly to the file.
-    cmd.encoding_format = MemoryEncodingFormat::kNone;
     cmd.encoded_length = kUncompressedLength;
     fwrite(&cmd, 1, sizeof(cmd), file_);
     fwrite(gamma_ramp_256_entry_table, 1, k256EntryTableUncompressedLength,
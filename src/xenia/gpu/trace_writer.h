@@ -11,8 +11,11 @@
 #define XENIA_GPU_TRACE_WRITER_H_
 
 #include <filesystem>
+#include <memory>
 #include <set>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
 #include "xenia/gpu/registers.h"
 #include "xenia/gpu/trace_protocol.h"
@@ -27,6 +30,8 @@
 #define XE_ENABLE_TRACE_WRITER_INSTRUMENTATION 1
 #endif
 
+struct ZSTD_CCtx_s;
+
 namespace xe {
 namespace gpu {
 
@@ -63,15 +68,41 @@ class TraceWriter {
                       uint32_t gamma_ramp_rw_component);
 
  private:
+  // The earliest memory command not encoded as a delta for a range, kept for
+  // delta encoding of later memory commands for the same range.
+  struct DeltaReference {
+    uint64_t command_offset;
+    std::unique_ptr<uint8_t[]> data;
+  };
+
   void WriteMemoryCommand(TraceCommandType type, uint32_t base_ptr,
                           size_t length, const void* host_ptr = nullptr);
+  // Compresses the data in compression_format_ (or as a delta against the
+  // reference if it's not null, with zstd) to encoded_data_ if possible.
+  // Returns the encoding format that has been used - if kNone, the data must
+  // be written as is.
+  MemoryEncodingFormat EncodeData(
+      const void* data, size_t length,
+      const DeltaReference* delta_reference = nullptr);
 
   std::set<uint64_t> cached_memory_reads_;
   uint8_t* membase_;
   FILE* file_;
 
-  bool compress_output_ = true;
+  // Set from the trace_gpu_compression configuration variable when opening.
+  MemoryEncodingFormat compression_format_ = MemoryEncodingFormat::kSnappy;
   size_t compression_threshold_ = 1024;  // Min. number of bytes to compress.
+  static constexpr int kZstdCompressionLevel = 3;
+  std::vector<uint8_t> encoded_data_;
+  ZSTD_CCtx_s* zstd_cctx_ = nullptr;
+
+  // Keyed by the base address in the upper 32 bits and the length in the lower
+  // 32 bits.
+  std::unordered_map<uint64_t, DeltaReference> delta_references_;
+  // Limit of the memory usage by the references, no new ones are added after
+  // it is reached.
+  static constexpr size_t kDeltaReferencesMaxTotalSize = size_t(256) << 20;
+  size_t delta_references_total_size_ = 0;
 
 #else
   // this could be annoying to maintain if new methods are added or the
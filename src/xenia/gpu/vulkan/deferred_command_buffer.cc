@@ -28,7 +28,11 @@ DeferredCommandBuffer::DeferredCommandBuffer(
   command_stream_.reserve(initial_size / sizeof(uintmax_t));
 }
 
-void DeferredCommandBuffer::Reset() { command_stream_.clear(); }
+void DeferredCommandBuffer::Reset() {
+  command_stream_.clear();
+  last_command_offset_ = SIZE_MAX;
+  last_index_buffer_command_offset_ = SIZE_MAX;
+}
 
 void DeferredCommandBuffer::Execute(VkCommandBuffer command_buffer) {
 #if XE_UI_VULKAN_FINE_GRAINED_DRAW_SCOPES
@@ -235,6 +239,12 @@ void DeferredCommandBuffer::Execute(VkCommandBuffer command_buffer) {
                                    sizeof(ArgsVkPushConstants));
       } break;
 
+      case Command::kVkResetQueryPool: {
+        auto& args = *reinterpret_cast<const ArgsVkResetQueryPool*>(stream);
+        dfn.vkCmdResetQueryPool(command_buffer, args.query_pool,
+                                args.first_query, args.query_count);
+      } break;
+
       case Command::kVkSetBlendConstants: {
         auto& args = *reinterpret_cast<const ArgsVkSetBlendConstants*>(stream);
         dfn.vkCmdSetBlendConstants(command_buffer, args.blend_constants);
@@ -286,6 +296,12 @@ void DeferredCommandBuffer::Execute(VkCommandBuffer command_buffer) {
                 xe::align(sizeof(ArgsVkSetViewport), alignof(VkViewport))));
       } break;
 
+      case Command::kVkWriteTimestamp: {
+        auto& args = *reinterpret_cast<const ArgsVkWriteTimestamp*>(stream);
+        dfn.vkCmdWriteTimestamp(command_buffer, args.pipeline_stage,
+                                args.query_pool, args.query);
+      } break;
+
       default:
         assert_unhandled_case(header.command);
         break;
@@ -359,6 +375,7 @@ void* DeferredCommandBuffer::WriteCommand(Command command,
       *reinterpret_cast<CommandHeader*>(command_stream_.data() + offset);
   header.command = command;
   header.arguments_size_elements = uint32_t(arguments_size_elements);
+  last_command_offset_ = offset;
   return command_stream_.data() + (offset + kCommandHeaderSizeElements);
 }
 
@@ -95,6 +95,7 @@ class DeferredCommandBuffer {
                             VkIndexType index_type) {
     auto& args = *reinterpret_cast<ArgsVkBindIndexBuffer*>(WriteCommand(
         Command::kVkBindIndexBuffer, sizeof(ArgsVkBindIndexBuffer)));
+    last_index_buffer_command_offset_ = last_command_offset_;
     args.buffer = buffer;
     args.offset = offset;
     args.index_type = index_type;
@@ -262,6 +263,50 @@ class DeferredCommandBuffer {
     args.first_instance = first_instance;
   }
 
+  // If the last recorded command is a non-instanced indexed draw from the
+  // beginning of the currently bound index buffer, and the specified index
+  // buffer binding directly follows the indices drawn by it and has the same
+  // index type, extends the draw to also draw index_count indices from the
+  // specified binding and returns true. Otherwise, returns false, and the
+  // index buffer needs to be bound and the draw needs to be recorded. The
+  // caller must ensure that the host primitive type is a list one, and that
+  // nothing else differentiates the two draws.
+  bool TryExtendLastCmdVkDrawIndexed(VkBuffer index_buffer,
+                                     VkDeviceSize index_buffer_offset,
+                                     VkIndexType index_type,
+                                     uint32_t index_count) {
+    if (last_command_offset_ == SIZE_MAX ||
+        last_index_buffer_command_offset_ == SIZE_MAX) {
+      return false;
+    }
+    uintmax_t* last_command = command_stream_.data() + last_command_offset_;
+    if (reinterpret_cast<const CommandHeader*>(last_command)->command !=
+        Command::kVkDrawIndexed) {
+      return false;
+    }
+    auto& draw_args = *reinterpret_cast<ArgsVkDrawIndexed*>(
+        last_command + kCommandHeaderSizeElements);
+    if (draw_args.instance_count != 1 || draw_args.first_index ||
+        draw_args.vertex_offset || draw_args.first_instance) {
+      return false;
+    }
+    const auto& index_buffer_args =
+        *reinterpret_cast<const ArgsVkBindIndexBuffer*>(
+            command_stream_.data() + last_index_buffer_command_offset_ +
+            kCommandHeaderSizeElements);
+    VkDeviceSize index_size =
+        index_type == VK_INDEX_TYPE_UINT16 ? sizeof(uint16_t)
+                                           : sizeof(uint32_t);
+    if (index_buffer_args.buffer != index_buffer ||
+        index_buffer_args.index_type != index_type ||
+        index_buffer_args.offset + draw_args.index_count * index_size !=
+            index_buffer_offset) {
+      return false;
+    }
+    draw_args.index_count += index_count;
+    return true;
+  }
+
   void CmdVkEndRenderPass() { WriteCommand(Command::kVkEndRenderPass, 0); }
 
   // pNext of all barriers must be null.
@@ -288,6 +333,15 @@ class DeferredCommandBuffer {
     std::memcpy(args_ptr + sizeof(ArgsVkPushConstants), values, size);
   }
 
+  void CmdVkResetQueryPool(VkQueryPool query_pool, uint32_t first_query,
+                           uint32_t query_count) {
+    auto& args = *reinterpret_cast<ArgsVkResetQueryPool*>(
+        WriteCommand(Command::kVkResetQueryPool, sizeof(ArgsVkResetQueryPool)));
+    args.query_pool = query_pool;
+    args.first_query = first_query;
+    args.query_count = query_count;
+  }
+
   void CmdVkSetBlendConstants(const float* blend_constants) {
     auto& args = *reinterpret_cast<ArgsVkSetBlendConstants*>(WriteCommand(
         Command::kVkSetBlendConstants, sizeof(ArgsVkSetBlendConstants)));
@@ -357,6 +411,15 @@ class DeferredCommandBuffer {
                 sizeof(VkViewport) * viewport_count);
   }
 
+  void CmdVkWriteTimestamp(VkPipelineStageFlagBits pipeline_stage,
+                           VkQueryPool query_pool, uint32_t query) {
+    auto& args = *reinterpret_cast<ArgsVkWriteTimestamp*>(
+        WriteCommand(Command::kVkWriteTimestamp, sizeof(ArgsVkWriteTimestamp)));
+    args.pipeline_stage = pipeline_stage;
+    args.query_pool = query_pool;
+    args.query = query;
+  }
+
  private:
   enum class Command {
     kVkBeginRenderPass,
@@ -374,6 +437,7 @@ class DeferredCommandBuffer {
     kVkEndRenderPass,
     kVkPipelineBarrier,
     kVkPushConstants,
+    kVkResetQueryPool,
     kVkSetBlendConstants,
     kVkSetDepthBias,
     kVkSetScissor,
@@ -381,6 +445,7 @@ class DeferredCommandBuffer {
     kVkSetStencilReference,
     kVkSetStencilWriteMask,
     kVkSetViewport,
+    kVkWriteTimestamp,
   };
 
   struct CommandHeader {
@@ -506,6 +571,12 @@ class DeferredCommandBuffer {
     // Followed by `size` bytes of values.
   };
 
+  struct ArgsVkResetQueryPool {
+    VkQueryPool query_pool;
+    uint32_t first_query;
+    uint32_t query_count;
+  };
+
   struct ArgsVkSetBlendConstants {
     float blend_constants[4];
   };
@@ -535,12 +606,24 @@ class DeferredCommandBuffer {
     static_assert(alignof(VkViewport) <= alignof(uintmax_t));
   };
 
+  struct ArgsVkWriteTimestamp {
+    VkPipelineStageFlagBits pipeline_stage;
+    VkQueryPool query_pool;
+    uint32_t query;
+  };
+
   void* WriteCommand(Command command, size_t arguments_size_bytes);
 
   const VulkanCommandProcessor& command_processor_;
 
   // uintmax_t to ensure uint64_t and pointer alignment of all structures.
   std::vector<uintmax_t> command_stream_;
+  // Offset of the header of the most recently written command in
+  // command_stream_, or SIZE_MAX if empty.
+  size_t last_command_offset_ = SIZE_MAX;
+  // Offset of the header of the most recently written index buffer binding
+  // command in command_stream_, or SIZE_MAX if none.
+  size_t last_index_buffer_command_offset_ = SIZE_MAX;
 };
 
 }  // namespace vulkan
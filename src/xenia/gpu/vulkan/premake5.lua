@@ -55,6 +55,7 @@ project("xenia-gpu-vulkan-trace-viewer")
     "mspack",
     "snappy",
     "xxhash",
+    "zstd",
   })
   includedirs({
     project_root.."/third_party/Vulkan-Headers/include",
@@ -119,6 +120,7 @@ project("xenia-gpu-vulkan-trace-dump")
     "mspack",
     "snappy",
     "xxhash",
+    "zstd",
   })
   includedirs({
     project_root.."/third_party/Vulkan-Headers/include",
@@ -150,3 +152,68 @@ project("xenia-gpu-vulkan-trace-dump")
         "1>scratch/stdout-trace-dump.txt",
       })
     end
+
+group("src")
+project("xenia-gpu-vulkan-trace-benchmark")
+  uuid("240d4ac3-555a-4de4-afb5-30ec3754a98d")
+  kind("ConsoleApp")
+  language("C++")
+  links({
+    "xenia-apu",
+    "xenia-apu-nop",
+    "xenia-base",
+    "xenia-core",
+    "xenia-cpu",
+    "xenia-gpu",
+    "xenia-gpu-vulkan",
+    "xenia-hid",
+    "xenia-hid-nop",
+    "xenia-kernel",
+    "xenia-ui",
+    "xenia-ui-vulkan",
+    "xenia-vfs",
+    "xenia-patcher",
+  })
+  links({
+    "aes_128",
+    "capstone",
+    "fmt",
+    "glslang-spirv",
+    "imgui",
+    "libavcodec",
+    "libavutil",
+    "mspack",
+    "snappy",
+    "xxhash",
+    "zstd",
+  })
+  includedirs({
+    project_root.."/third_party/Vulkan-Headers/include",
+  })
+  files({
+    "vulkan_trace_benchmark_main.cc",
+    "../../base/console_app_main_"..platform_suffix..".cc",
+  })
+
+  filter("architecture:x86_64")
+    links({
+      "xenia-cpu-backend-x64",
+    })
+
+  filter("platforms:Linux")
+    links({
+      "X11",
+      "xcb",
+      "X11-xcb",
+    })
+
+  filter("platforms:Windows")
+    -- Only create the .user file if it doesn't already exist.
+    local user_file = project_root.."/build/xenia-gpu-vulkan-trace-benchmark.vcxproj.user"
+    if not os.isfile(user_file) then
+      debugdir(project_root)
+      debugargs({
+        "2>&1",
+        "1>scratch/stdout-trace-benchmark.txt",
+      })
+    end
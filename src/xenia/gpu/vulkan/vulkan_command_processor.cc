@@ -19,9 +19,14 @@
 
 #include "xenia/base/assert.h"
 #include "xenia/base/byte_order.h"
+#include "xenia/base/fast_forward.h"
+#include "xenia/base/frame_timeline.h"
+#include "xenia/base/input_latency.h"
 #include "xenia/base/logging.h"
 #include "xenia/base/math.h"
 #include "xenia/base/profiling.h"
+#include "xenia/base/startup_timeline.h"
+#include "xenia/base/xxhash.h"
 #include "xenia/gpu/draw_util.h"
 #include "xenia/gpu/gpu_flags.h"
 #include "xenia/gpu/packet_disassembler.h"
@@ -100,6 +105,13 @@ void VulkanCommandProcessor::ClearCaches() {
   cache_clear_requested_ = true;
 }
 
+void VulkanCommandProcessor::InitializeShaderStorage(
+    const std::filesystem::path& cache_root, uint32_t title_id, bool blocking) {
+  SCOPE_startup_timeline("VulkanCommandProcessor::InitializeShaderStorage");
+  CommandProcessor::InitializeShaderStorage(cache_root, title_id, blocking);
+  pipeline_cache_->InitializeShaderStorage(cache_root, title_id, blocking);
+}
+
 void VulkanCommandProcessor::TracePlaybackWroteMemory(uint32_t base_ptr,
                                                       uint32_t length) {
   shared_memory_->MemoryInvalidationCallback(base_ptr, length, true);
@@ -1033,6 +1045,10 @@ bool VulkanCommandProcessor::SetupContext() {
     return false;
   }
 
+  if (cvars::profile_gpu_timestamps) {
+    InitializeGpuTimestamps();
+  }
+
   // Just not to expose uninitialized memory.
   std::memset(&system_constants_, 0, sizeof(system_constants_));
 
@@ -1048,6 +1064,9 @@ void VulkanCommandProcessor::ShutdownContext() {
 
   DestroyScratchBuffer();
 
+  ui::vulkan::util::DestroyAndNullHandle(dfn.vkDestroyQueryPool, device,
+                                         gpu_timestamp_query_pool_);
+
   for (SwapFramebuffer& swap_framebuffer : swap_framebuffers_) {
     ui::vulkan::util::DestroyAndNullHandle(dfn.vkDestroyFramebuffer, device,
                                            swap_framebuffer.framebuffer);
@@ -1192,49 +1211,69 @@ void VulkanCommandProcessor::ShutdownContext() {
   CommandProcessor::ShutdownContext();
 }
 
-void VulkanCommandProcessor::WriteRegister(uint32_t index, uint32_t value) {
-  CommandProcessor::WriteRegister(index, value);
-
-  if (index >= XE_GPU_REG_SHADER_CONSTANT_000_X &&
-      index <= XE_GPU_REG_SHADER_CONSTANT_511_W) {
-    if (frame_open_) {
-      uint32_t float_constant_index =
-          (index - XE_GPU_REG_SHADER_CONSTANT_000_X) >> 2;
-      if (float_constant_index >= 256) {
-        float_constant_index -= 256;
-        if (current_float_constant_map_pixel_[float_constant_index >> 6] &
-            (1ull << (float_constant_index & 63))) {
-          current_constant_buffers_up_to_date_ &= ~(
-              UINT32_C(1) << SpirvShaderTranslator::kConstantBufferFloatPixel);
-        }
-      } else {
-        if (current_float_constant_map_vertex_[float_constant_index >> 6] &
-            (1ull << (float_constant_index & 63))) {
-          current_constant_buffers_up_to_date_ &= ~(
-              UINT32_C(1) << SpirvShaderTranslator::kConstantBufferFloatVertex);
-        }
-      }
+// Whether any of the float constants in [first, end) are used by the current
+// shader according to its float constant map.
+static bool AreFloatConstantsUsed(const uint64_t* float_constant_map,
+                                  uint32_t first, uint32_t end) {
+  uint32_t last = end - 1;
+  for (uint32_t word = first >> 6; word <= last >> 6; ++word) {
+    uint64_t word_mask = ~uint64_t(0);
+    if (word == first >> 6) {
+      word_mask &= ~uint64_t(0) << (first & 63);
     }
-  } else if (index >= XE_GPU_REG_SHADER_CONSTANT_BOOL_000_031 &&
-             index <= XE_GPU_REG_SHADER_CONSTANT_LOOP_31) {
-    current_constant_buffers_up_to_date_ &=
-        ~(UINT32_C(1) << SpirvShaderTranslator::kConstantBufferBoolLoop);
-  } else if (index >= XE_GPU_REG_SHADER_CONSTANT_FETCH_00_0 &&
-             index <= XE_GPU_REG_SHADER_CONSTANT_FETCH_31_5) {
-    current_constant_buffers_up_to_date_ &=
-        ~(UINT32_C(1) << SpirvShaderTranslator::kConstantBufferFetch);
-    if (texture_cache_) {
-      texture_cache_->TextureFetchConstantWritten(
-          (index - XE_GPU_REG_SHADER_CONSTANT_FETCH_00_0) / 6);
+    if (word == last >> 6) {
+      word_mask &= ~uint64_t(0) >> (63 - (last & 63));
     }
+    if (float_constant_map[word] & word_mask) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void VulkanCommandProcessor::OnShaderConstantsWritten(
+    RegisterFile::WriteClass write_class, uint32_t first_index,
+    uint32_t count) {
+  switch (write_class) {
+    case RegisterFile::WriteClass::kFloatConstant: {
+      if (!frame_open_) {
+        break;
+      }
+      uint32_t first_constant =
+          (first_index - XE_GPU_REG_SHADER_CONSTANT_000_X) >> 2;
+      uint32_t end_constant =
+          ((first_index + count - 1 - XE_GPU_REG_SHADER_CONSTANT_000_X) >> 2) +
+          1;
+      if (first_constant < 256 &&
+          AreFloatConstantsUsed(current_float_constant_map_vertex_,
+                                first_constant,
+                                std::min(end_constant, uint32_t(256)))) {
+        current_constant_buffers_up_to_date_ &= ~(
+            UINT32_C(1) << SpirvShaderTranslator::kConstantBufferFloatVertex);
+      }
+      if (end_constant > 256 &&
+          AreFloatConstantsUsed(current_float_constant_map_pixel_,
+                                std::max(first_constant, uint32_t(256)) - 256,
+                                end_constant - 256)) {
+        current_constant_buffers_up_to_date_ &= ~(
+            UINT32_C(1) << SpirvShaderTranslator::kConstantBufferFloatPixel);
+      }
+    } break;
+    case RegisterFile::WriteClass::kBoolLoopConstant:
+      current_constant_buffers_up_to_date_ &=
+          ~(UINT32_C(1) << SpirvShaderTranslator::kConstantBufferBoolLoop);
+      break;
+    default:
+      break;
   }
 }
-void VulkanCommandProcessor::WriteRegistersFromMem(uint32_t start_index,
-                                                   uint32_t* base,
-                                                   uint32_t num_registers) {
-  for (uint32_t i = 0; i < num_registers; ++i) {
-    uint32_t data = xe::load_and_swap<uint32_t>(base + i);
-    VulkanCommandProcessor::WriteRegister(start_index + i, data);
+
+void VulkanCommandProcessor::OnFetchConstantsChanged(
+    uint32_t fetch_constant_mask) {
+  current_constant_buffers_up_to_date_ &=
+      ~(UINT32_C(1) << SpirvShaderTranslator::kConstantBufferFetch);
+  if (texture_cache_) {
+    texture_cache_->TextureFetchConstantsChanged(fetch_constant_mask);
   }
 }
 void VulkanCommandProcessor::SparseBindBuffer(
@@ -1276,6 +1315,11 @@ void VulkanCommandProcessor::IssueSwap(uint32_t frontbuffer_ptr,
     return;
   }
 
+  // Skipping the intermediate frames while fast-forwarding.
+  if (!fast_forward::ShouldPresentGuestFrame()) {
+    return;
+  }
+
   // Obtaining the actual front buffer size to pass to RefreshGuestOutput,
   // resolution-scaled if it's a resolve destination, or not otherwise.
   uint32_t frontbuffer_width_scaled, frontbuffer_height_scaled;
@@ -2293,10 +2337,16 @@ bool VulkanCommandProcessor::IssueDraw(xenos::PrimitiveType prim_type,
                            pixel_shader->GetOrCreateTranslation(
                                pixel_shader_modification.value))
                      : nullptr;
+    bool shaders_pending;
     if (!pipeline_cache_->EnsureShadersTranslated(vertex_shader_translation,
-                                                  pixel_shader_translation)) {
+                                                  pixel_shader_translation,
+                                                  shaders_pending)) {
       return false;
     }
+    if (shaders_pending) {
+      // Being translated asynchronously, skip the draw.
+      return true;
+    }
 
     // Obtain the samplers. Note that the bindings don't depend on the shader
     // modification, so if on the second iteration of this loop it becomes
@@ -2395,6 +2445,10 @@ bool VulkanCommandProcessor::IssueDraw(xenos::PrimitiveType prim_type,
           pipeline_layout_provider)) {
     return false;
   }
+  if (pipeline == VK_NULL_HANDLE) {
+    // Still being created asynchronously, or failed to be created previously.
+    return true;
+  }
 
   // Update the textures before most other work in the submission because
   // samplers depend on this (and in case of sampler overflow in a submission,
@@ -2449,6 +2503,11 @@ bool VulkanCommandProcessor::IssueDraw(xenos::PrimitiveType prim_type,
   bool host_render_targets_used = render_target_cache_->GetPath() ==
                                   RenderTargetCache::Path::kHostRenderTargets;
 
+  // Only the state derived from the registers written since the last draw
+  // needs to be read from the registers again.
+  uint32_t dirty_state_groups =
+      TakeDirtyStateGroups(RegisterFile::kStateGroupsAll);
+
   // Get dynamic rasterizer state.
   draw_util::ViewportInfo viewport_info;
 
@@ -2469,18 +2528,32 @@ bool VulkanCommandProcessor::IssueDraw(xenos::PrimitiveType prim_type,
   // interlocks case completely - apply the viewport and the scissor offset
   // directly to pixel address and to things like ps_param_gen.
   draw_util::GetViewportInfoArgs gviargs{};
+  bool viewport_registers_written =
+      (dirty_state_groups & RegisterFile::kStateGroupViewport) != 0;
+  if (!viewport_registers_written) {
+    // Still need to check the inputs not coming from the registers.
+    gviargs = previous_viewport_info_args_;
+  }
   gviargs.Setup(1, 1, divisors::MagicDiv{1}, divisors::MagicDiv{1}, false,
                 device_info.maxViewportDimensions[0],
                 device_info.maxViewportDimensions[1], true,
                 normalized_depth_control, false, host_render_targets_used,
                 pixel_shader && pixel_shader->writes_depth());
-  gviargs.SetupRegisterValues(regs);
+  if (viewport_registers_written) {
+    gviargs.SetupRegisterValues(regs);
+  }
 
-  draw_util::GetHostViewportInfo(&gviargs, viewport_info);
+  if (gviargs == previous_viewport_info_args_) {
+    viewport_info = previous_viewport_info_;
+  } else {
+    draw_util::GetHostViewportInfo(&gviargs, viewport_info);
+    previous_viewport_info_args_ = gviargs;
+    previous_viewport_info_ = viewport_info;
+  }
 
   // Update dynamic graphics pipeline state.
   UpdateDynamicState(viewport_info, primitive_polygonal,
-                     normalized_depth_control);
+                     normalized_depth_control, dirty_state_groups);
 
   auto vgt_draw_initiator = regs.Get<reg::VGT_DRAW_INITIATOR>();
 
@@ -2592,6 +2665,7 @@ bool VulkanCommandProcessor::IssueDraw(xenos::PrimitiveType prim_type,
   SubmitBarriersAndEnterRenderTargetCacheRenderPass(
       render_target_cache_->last_update_render_pass(),
       render_target_cache_->last_update_framebuffer());
+  SwitchGpuTimestampCategory(GpuTimestampProfiler::Category::kDraws);
 
   // Draw.
   if (primitive_processing_result.index_buffer_type ==
@@ -2619,14 +2693,23 @@ bool VulkanCommandProcessor::IssueDraw(xenos::PrimitiveType prim_type,
         assert_unhandled_case(primitive_processing_result.index_buffer_type);
         return false;
     }
-    deferred_command_buffer_.CmdVkBindIndexBuffer(
-        index_buffer.first, index_buffer.second,
-        primitive_processing_result.host_index_format ==
-                xenos::IndexFormat::kInt16
-            ? VK_INDEX_TYPE_UINT16
-            : VK_INDEX_TYPE_UINT32);
-    deferred_command_buffer_.CmdVkDrawIndexed(
-        primitive_processing_result.host_draw_vertex_count, 1, 0, 0, 0);
+    VkIndexType index_type = primitive_processing_result.host_index_format ==
+                                     xenos::IndexFormat::kInt16
+                                 ? VK_INDEX_TYPE_UINT16
+                                 : VK_INDEX_TYPE_UINT32;
+    // If nothing has been recorded since the previous draw, and its indices
+    // directly precede the current ones, merge the two draws. Memory export
+    // makes draws dependent on each other.
+    if (!cvars::merge_consecutive_draws || !memexport_ranges_.empty() ||
+        !primitive_processing_result.IsMergeableWithAdjacentIndices() ||
+        !deferred_command_buffer_.TryExtendLastCmdVkDrawIndexed(
+            index_buffer.first, index_buffer.second, index_type,
+            primitive_processing_result.host_draw_vertex_count)) {
+      deferred_command_buffer_.CmdVkBindIndexBuffer(
+          index_buffer.first, index_buffer.second, index_type);
+      deferred_command_buffer_.CmdVkDrawIndexed(
+          primitive_processing_result.host_draw_vertex_count, 1, 0, 0, 0);
+    }
   }
 
   // Invalidate textures in memexported memory and watch for changes.
@@ -2647,6 +2730,7 @@ bool VulkanCommandProcessor::IssueCopy() {
     return false;
   }
 
+  SwitchGpuTimestampCategory(GpuTimestampProfiler::Category::kResolves);
   uint32_t written_address, written_length;
   if (!render_target_cache_->Resolve(*memory_, *shared_memory_, *texture_cache_,
                                      written_address, written_length)) {
@@ -2779,6 +2863,8 @@ void VulkanCommandProcessor::CheckSubmissionFenceAndDeviceLoss(
 
   texture_cache_->CompletedSubmissionUpdated(submission_completed_);
 
+  CompleteGpuTimestamps();
+
   // Destroy objects scheduled for destruction.
   while (!destroy_framebuffers_.empty()) {
     const auto& destroy_pair = destroy_framebuffers_.front();
@@ -2822,12 +2908,19 @@ bool VulkanCommandProcessor::BeginSubmission(bool is_guest_command) {
 
   // Check the fence - needed for all kinds of submissions (to reclaim transient
   // resources early) and specifically for frames (not to queue too many), and
-  // await the availability of the current frame. Also check whether the device
-  // is still available, and whether the await was successful.
-  uint64_t await_submission =
-      is_opening_frame
-          ? closed_frame_submissions_[frame_current_ % kMaxFramesInFlight]
-          : 0;
+  // await the availability of the current frame, or, with max_queued_frames,
+  // of a more recent one for lower latency. Also check whether the device is
+  // still available, and whether the await was successful.
+  uint64_t await_submission = 0;
+  if (is_opening_frame) {
+    uint32_t queued_frames =
+        std::clamp(cvars::max_queued_frames, uint32_t(1), kMaxFramesInFlight);
+    if (frame_current_ >= queued_frames) {
+      await_submission =
+          closed_frame_submissions_[(frame_current_ - queued_frames) %
+                                    kMaxFramesInFlight];
+    }
+  }
   CheckSubmissionFenceAndDeviceLoss(await_submission);
   if (device_lost_ || submission_completed_ < await_submission) {
     return false;
@@ -2847,9 +2940,22 @@ bool VulkanCommandProcessor::BeginSubmission(bool is_guest_command) {
       }
       frame_completed_ = frame;
     }
+    OnHostFramesCompleted(frame_completed_);
+    OnHostFrameOpened(frame_current_);
   }
 
   if (!submission_open_) {
+    // The timestamps of the submission that used the same block of timestamp
+    // queries must be read back before they're reset.
+    if (gpu_timestamp_query_pool_ != VK_NULL_HANDLE &&
+        GetCurrentSubmission() > GpuTimestampProfiler::kSubmissionBlockCount) {
+      CheckSubmissionFenceAndDeviceLoss(
+          GetCurrentSubmission() - GpuTimestampProfiler::kSubmissionBlockCount);
+      if (device_lost_) {
+        return false;
+      }
+    }
+
     submission_open_ = true;
 
     // Start a new deferred command buffer - will submit it to the real one in
@@ -2857,6 +2963,17 @@ bool VulkanCommandProcessor::BeginSubmission(bool is_guest_command) {
     // are fulfilled).
     deferred_command_buffer_.Reset();
 
+    if (gpu_timestamp_query_pool_ != VK_NULL_HANDLE) {
+      deferred_command_buffer_.CmdVkResetQueryPool(
+          gpu_timestamp_query_pool_,
+          GpuTimestampProfiler::GetSubmissionFirstTimestamp(
+              GetCurrentSubmission()),
+          GpuTimestampProfiler::kTimestampsPerSubmission);
+      deferred_command_buffer_.CmdVkWriteTimestamp(
+          VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, gpu_timestamp_query_pool_,
+          gpu_timestamp_profiler_.BeginSubmission(GetCurrentSubmission()));
+    }
+
     // Reset cached state of the command buffer.
     dynamic_viewport_update_needed_ = true;
     dynamic_scissor_update_needed_ = true;
@@ -2875,6 +2992,7 @@ bool VulkanCommandProcessor::BeginSubmission(bool is_guest_command) {
     current_external_compute_pipeline_ = VK_NULL_HANDLE;
     current_guest_graphics_pipeline_layout_ = nullptr;
     current_graphics_descriptor_sets_bound_up_to_date_ = 0;
+    texture_descriptor_set_cache_.clear();
 
     primitive_processor_->BeginSubmission();
 
@@ -2948,6 +3066,8 @@ bool VulkanCommandProcessor::BeginSubmission(bool is_guest_command) {
 
     primitive_processor_->BeginFrame();
 
+    render_target_cache_->BeginFrame();
+
     texture_cache_->BeginFrame();
   }
 
@@ -3024,6 +3144,12 @@ bool VulkanCommandProcessor::EndSubmission(bool is_swap) {
 
   if (is_closing_frame) {
     primitive_processor_->EndFrame();
+
+    ReportStateGroupRebuilds();
+
+    if (gpu_timestamp_query_pool_ != VK_NULL_HANDLE) {
+      gpu_timestamp_profiler_.EndFrame();
+    }
   }
 
   if (submission_open_) {
@@ -3033,6 +3159,8 @@ bool VulkanCommandProcessor::EndSubmission(bool is_swap) {
 
     render_target_cache_->EndSubmission();
 
+    pipeline_cache_->EndSubmission();
+
     primitive_processor_->EndSubmission();
 
     shared_memory_->EndSubmission();
@@ -3093,6 +3221,15 @@ bool VulkanCommandProcessor::EndSubmission(bool is_swap) {
 
     SubmitBarriers(true);
 
+    if (gpu_timestamp_query_pool_ != VK_NULL_HANDLE) {
+      uint32_t timestamp_index = gpu_timestamp_profiler_.EndSubmission();
+      if (timestamp_index != UINT32_MAX) {
+        deferred_command_buffer_.CmdVkWriteTimestamp(
+            VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, gpu_timestamp_query_pool_,
+            timestamp_index);
+      }
+    }
+
     assert_false(command_buffers_writable_.empty());
     CommandBuffer command_buffer = command_buffers_writable_.back();
     if (dfn.vkResetCommandPool(device, command_buffer.pool, 0) != VK_SUCCESS) {
@@ -3219,6 +3356,7 @@ bool VulkanCommandProcessor::EndSubmission(bool is_swap) {
 }
 
 void VulkanCommandProcessor::ClearTransientDescriptorPools() {
+  texture_descriptor_set_cache_.clear();
   texture_transient_descriptor_sets_free_.clear();
   texture_transient_descriptor_sets_used_.clear();
   transient_descriptor_allocator_textures_.Reset();
@@ -3275,7 +3413,8 @@ void VulkanCommandProcessor::DestroyScratchBuffer() {
 
 void VulkanCommandProcessor::UpdateDynamicState(
     const draw_util::ViewportInfo& viewport_info, bool primitive_polygonal,
-    reg::RB_DEPTHCONTROL normalized_depth_control) {
+    reg::RB_DEPTHCONTROL normalized_depth_control,
+    uint32_t dirty_state_groups) {
 #if XE_UI_VULKAN_FINE_GRAINED_DRAW_SCOPES
   SCOPE_profile_cpu_f("gpu");
 #endif  // XE_UI_VULKAN_FINE_GRAINED_DRAW_SCOPES
@@ -3309,8 +3448,10 @@ void VulkanCommandProcessor::UpdateDynamicState(
   SetViewport(viewport);
 
   // Scissor.
-  draw_util::Scissor scissor;
-  draw_util::GetScissor(regs, scissor);
+  draw_util::Scissor& scissor = previous_scissor_;
+  if (dirty_state_groups & RegisterFile::kStateGroupViewport) {
+    draw_util::GetScissor(regs, scissor);
+  }
   VkRect2D scissor_rect;
   scissor_rect.offset.x = int32_t(scissor.offset[0]);
   scissor_rect.offset.y = int32_t(scissor.offset[1]);
@@ -3320,35 +3461,44 @@ void VulkanCommandProcessor::UpdateDynamicState(
 
   if (render_target_cache_->GetPath() ==
       RenderTargetCache::Path::kHostRenderTargets) {
+    // The face-dependent state also depends on the primitive type, which is
+    // not a part of the register state groups.
+    bool depth_stencil_state_stale =
+        (dirty_state_groups & RegisterFile::kStateGroupDepthStencil) ||
+        dynamic_depth_stencil_primitive_polygonal_ != primitive_polygonal;
+    dynamic_depth_stencil_primitive_polygonal_ = primitive_polygonal;
+
     // Depth bias.
-    float depth_bias_constant_factor, depth_bias_slope_factor;
-    draw_util::GetPreferredFacePolygonOffset(regs, primitive_polygonal,
-                                             depth_bias_slope_factor,
-                                             depth_bias_constant_factor);
-    depth_bias_constant_factor *=
-        regs.Get<reg::RB_DEPTH_INFO>().depth_format ==
-                xenos::DepthRenderTargetFormat::kD24S8
-            ? draw_util::kD3D10PolygonOffsetFactorUnorm24
-            : draw_util::kD3D10PolygonOffsetFactorFloat24;
-    // With non-square resolution scaling, make sure the worst-case impact is
-    // reverted (slope only along the scaled axis), thus max. More bias is
-    // better than less bias, because less bias means Z fighting with the
-    // background is more likely.
-    depth_bias_slope_factor *=
-        xenos::kPolygonOffsetScaleSubpixelUnit *
-        float(std::max(render_target_cache_->draw_resolution_scale_x(),
-                       render_target_cache_->draw_resolution_scale_y()));
-    // std::memcmp instead of != so in case of NaN, every draw won't be
-    // invalidating it.
-    dynamic_depth_bias_update_needed_ |=
-        std::memcmp(&dynamic_depth_bias_constant_factor_,
-                    &depth_bias_constant_factor, sizeof(float)) != 0;
-    dynamic_depth_bias_update_needed_ |=
-        std::memcmp(&dynamic_depth_bias_slope_factor_, &depth_bias_slope_factor,
-                    sizeof(float)) != 0;
+    if (depth_stencil_state_stale) {
+      float depth_bias_constant_factor, depth_bias_slope_factor;
+      draw_util::GetPreferredFacePolygonOffset(regs, primitive_polygonal,
+                                               depth_bias_slope_factor,
+                                               depth_bias_constant_factor);
+      depth_bias_constant_factor *=
+          regs.Get<reg::RB_DEPTH_INFO>().depth_format ==
+                  xenos::DepthRenderTargetFormat::kD24S8
+              ? draw_util::kD3D10PolygonOffsetFactorUnorm24
+              : draw_util::kD3D10PolygonOffsetFactorFloat24;
+      // With non-square resolution scaling, make sure the worst-case impact is
+      // reverted (slope only along the scaled axis), thus max. More bias is
+      // better than less bias, because less bias means Z fighting with the
+      // background is more likely.
+      depth_bias_slope_factor *=
+          xenos::kPolygonOffsetScaleSubpixelUnit *
+          float(std::max(render_target_cache_->draw_resolution_scale_x(),
+                         render_target_cache_->draw_resolution_scale_y()));
+      // std::memcmp instead of != so in case of NaN, every draw won't be
+      // invalidating it.
+      if (std::memcmp(&dynamic_depth_bias_constant_factor_,
+                      &depth_bias_constant_factor, sizeof(float)) ||
+          std::memcmp(&dynamic_depth_bias_slope_factor_,
+                      &depth_bias_slope_factor, sizeof(float))) {
+        dynamic_depth_bias_constant_factor_ = depth_bias_constant_factor;
+        dynamic_depth_bias_slope_factor_ = depth_bias_slope_factor;
+        dynamic_depth_bias_update_needed_ = true;
+      }
+    }
     if (dynamic_depth_bias_update_needed_) {
-      dynamic_depth_bias_constant_factor_ = depth_bias_constant_factor;
-      dynamic_depth_bias_slope_factor_ = depth_bias_slope_factor;
       deferred_command_buffer_.CmdVkSetDepthBias(
           dynamic_depth_bias_constant_factor_, 0.0f,
           dynamic_depth_bias_slope_factor_);
@@ -3356,17 +3506,21 @@ void VulkanCommandProcessor::UpdateDynamicState(
     }
 
     // Blend constants.
-    float blend_constants[] = {
-        regs.Get<float>(XE_GPU_REG_RB_BLEND_RED),
-        regs.Get<float>(XE_GPU_REG_RB_BLEND_GREEN),
-        regs.Get<float>(XE_GPU_REG_RB_BLEND_BLUE),
-        regs.Get<float>(XE_GPU_REG_RB_BLEND_ALPHA),
-    };
-    dynamic_blend_constants_update_needed_ |=
-        std::memcmp(dynamic_blend_constants_, blend_constants,
-                    sizeof(float) * 4) != 0;
+    if (dirty_state_groups & RegisterFile::kStateGroupBlend) {
+      float blend_constants[] = {
+          regs.Get<float>(XE_GPU_REG_RB_BLEND_RED),
+          regs.Get<float>(XE_GPU_REG_RB_BLEND_GREEN),
+          regs.Get<float>(XE_GPU_REG_RB_BLEND_BLUE),
+          regs.Get<float>(XE_GPU_REG_RB_BLEND_ALPHA),
+      };
+      if (std::memcmp(dynamic_blend_constants_, blend_constants,
+                      sizeof(float) * 4)) {
+        std::memcpy(dynamic_blend_constants_, blend_constants,
+                    sizeof(float) * 4);
+        dynamic_blend_constants_update_needed_ = true;
+      }
+    }
     if (dynamic_blend_constants_update_needed_) {
-      std::memcpy(dynamic_blend_constants_, blend_constants, sizeof(float) * 4);
       deferred_command_buffer_.CmdVkSetBlendConstants(dynamic_blend_constants_);
       dynamic_blend_constants_update_needed_ = false;
     }
@@ -3379,7 +3533,7 @@ void VulkanCommandProcessor::UpdateDynamicState(
     // actually has effect on drawing, and because the masks and the references
     // are always dynamic in Xenia guest pipelines, they must be set in the
     // command buffer before any draw.
-    if (normalized_depth_control.stencil_enable) {
+    if (depth_stencil_state_stale && normalized_depth_control.stencil_enable) {
       Register stencil_ref_mask_front_reg, stencil_ref_mask_back_reg;
       if (primitive_polygonal && normalized_depth_control.backface_enable) {
         if (GetVulkanProvider().device_info().separateStencilMaskRef) {
@@ -4171,13 +4325,18 @@ bool VulkanCommandProcessor::UpdateBindings(const VulkanShader* vertex_shader,
     sampler_count_pixel = 0;
     texture_count_pixel = 0;
   }
-  // TODO(Triang3l): Reuse texture and sampler bindings if not changed.
+  // Texture descriptor sets with the same contents are looked up in the cache
+  // of the sets written in the current submission below.
   current_graphics_descriptor_set_values_up_to_date_ &=
       ~((UINT32_C(1) << SpirvShaderTranslator::kDescriptorSetTexturesVertex) |
         (UINT32_C(1) << SpirvShaderTranslator::kDescriptorSetTexturesPixel));
 
   // Make sure new descriptor sets are bound to the command buffer.
 
+  // If the same texture descriptor set is reused, it doesn't need to be bound
+  // again.
+  uint32_t descriptor_sets_bound_before_update =
+      current_graphics_descriptor_sets_bound_up_to_date_;
   current_graphics_descriptor_sets_bound_up_to_date_ &=
       current_graphics_descriptor_set_values_up_to_date_;
 
@@ -4300,6 +4459,37 @@ bool VulkanCommandProcessor::UpdateBindings(const VulkanShader* vertex_shader,
         [SpirvShaderTranslator::kDescriptorSetConstants] =
             constants_descriptor_set;
   }
+  // Reuse the texture descriptor sets with the same contents.
+  for (uint32_t i = 0; i < 2; ++i) {
+    bool is_vertex = !i;
+    bool& write_textures =
+        is_vertex ? write_vertex_textures : write_pixel_textures;
+    if (!write_textures) {
+      continue;
+    }
+    VkDescriptorSet cached_descriptor_set = FindCachedTextureDescriptorSet(
+        is_vertex, is_vertex ? texture_count_vertex : texture_count_pixel,
+        is_vertex ? sampler_count_vertex : sampler_count_pixel,
+        descriptor_write_image_info_.data() +
+            (is_vertex ? vertex_texture_image_info_offset
+                       : pixel_texture_image_info_offset));
+    if (cached_descriptor_set == VK_NULL_HANDLE) {
+      continue;
+    }
+    uint32_t descriptor_set_index =
+        is_vertex ? SpirvShaderTranslator::kDescriptorSetTexturesVertex
+                  : SpirvShaderTranslator::kDescriptorSetTexturesPixel;
+    uint32_t descriptor_set_bit = UINT32_C(1) << descriptor_set_index;
+    if (current_graphics_descriptor_sets_[descriptor_set_index] ==
+        cached_descriptor_set) {
+      current_graphics_descriptor_sets_bound_up_to_date_ |=
+          descriptor_sets_bound_before_update & descriptor_set_bit;
+    }
+    current_graphics_descriptor_sets_[descriptor_set_index] =
+        cached_descriptor_set;
+    write_descriptor_set_bits |= descriptor_set_bit;
+    write_textures = false;
+  }
   // Vertex shader textures and samplers.
   if (write_vertex_textures) {
     VkWriteDescriptorSet* write_textures =
@@ -4320,6 +4510,10 @@ bool VulkanCommandProcessor::UpdateBindings(const VulkanShader* vertex_shader,
     current_graphics_descriptor_sets_
         [SpirvShaderTranslator::kDescriptorSetTexturesVertex] =
             write_textures[0].dstSet;
+    AddCachedTextureDescriptorSet(
+        true, texture_count_vertex, sampler_count_vertex,
+        descriptor_write_image_info_.data() + vertex_texture_image_info_offset,
+        write_textures[0].dstSet);
   }
   // Pixel shader textures and samplers.
   if (write_pixel_textures) {
@@ -4341,6 +4535,10 @@ bool VulkanCommandProcessor::UpdateBindings(const VulkanShader* vertex_shader,
     current_graphics_descriptor_sets_
         [SpirvShaderTranslator::kDescriptorSetTexturesPixel] =
             write_textures[0].dstSet;
+    AddCachedTextureDescriptorSet(
+        false, texture_count_pixel, sampler_count_pixel,
+        descriptor_write_image_info_.data() + pixel_texture_image_info_offset,
+        write_textures[0].dstSet);
   }
   // Write.
   if (write_descriptor_set_count) {
@@ -4523,6 +4721,107 @@ uint32_t VulkanCommandProcessor::WriteTransientTextureBindings(
   return descriptor_set_write_count;
 }
 
+VkDescriptorSet VulkanCommandProcessor::FindCachedTextureDescriptorSet(
+    bool is_vertex, uint32_t texture_count, uint32_t sampler_count,
+    const VkDescriptorImageInfo* image_info) const {
+  TextureDescriptorSetLayoutKey layout;
+  layout.texture_count = texture_count;
+  layout.sampler_count = sampler_count;
+  layout.is_vertex = uint32_t(is_vertex);
+  size_t image_info_count = size_t(texture_count) + sampler_count;
+  auto bucket = texture_descriptor_set_cache_.equal_range(XXH3_64bits_withSeed(
+      image_info, sizeof(VkDescriptorImageInfo) * image_info_count,
+      layout.key));
+  for (auto it = bucket.first; it != bucket.second; ++it) {
+    const CachedTextureDescriptorSet& cached_set = it->second;
+    if (cached_set.layout == layout &&
+        !std::memcmp(cached_set.image_info.data(), image_info,
+                     sizeof(VkDescriptorImageInfo) * image_info_count)) {
+      return cached_set.set;
+    }
+  }
+  return VK_NULL_HANDLE;
+}
+
+void VulkanCommandProcessor::AddCachedTextureDescriptorSet(
+    bool is_vertex, uint32_t texture_count, uint32_t sampler_count,
+    const VkDescriptorImageInfo* image_info, VkDescriptorSet descriptor_set) {
+  TextureDescriptorSetLayoutKey layout;
+  layout.texture_count = texture_count;
+  layout.sampler_count = sampler_count;
+  layout.is_vertex = uint32_t(is_vertex);
+  size_t image_info_count = size_t(texture_count) + sampler_count;
+  CachedTextureDescriptorSet& cached_set =
+      texture_descriptor_set_cache_
+          .emplace(XXH3_64bits_withSeed(
+                       image_info,
+                       sizeof(VkDescriptorImageInfo) * image_info_count,
+                       layout.key),
+                   CachedTextureDescriptorSet())
+          ->second;
+  cached_set.layout = layout;
+  cached_set.image_info.assign(image_info, image_info + image_info_count);
+  cached_set.set = descriptor_set;
+}
+
+bool VulkanCommandProcessor::InitializeGpuTimestamps() {
+  const ui::vulkan::VulkanProvider& provider = GetVulkanProvider();
+  const ui::vulkan::VulkanProvider::DeviceInfo& device_info =
+      provider.device_info();
+  if (!device_info.timestampComputeAndGraphics ||
+      device_info.timestampPeriod <= 0.0f) {
+    XELOGW("GPU timestamps are not supported by the device, not profiling");
+    return false;
+  }
+  const ui::vulkan::VulkanProvider::DeviceFunctions& dfn = provider.dfn();
+  VkDevice device = provider.device();
+  VkQueryPoolCreateInfo query_pool_create_info;
+  query_pool_create_info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+  query_pool_create_info.pNext = nullptr;
+  query_pool_create_info.flags = 0;
+  query_pool_create_info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+  query_pool_create_info.queryCount = GpuTimestampProfiler::kTimestampCount;
+  query_pool_create_info.pipelineStatistics = 0;
+  if (dfn.vkCreateQueryPool(device, &query_pool_create_info, nullptr,
+                            &gpu_timestamp_query_pool_) != VK_SUCCESS) {
+    XELOGW("Failed to create the GPU timestamp query pool, not profiling");
+    gpu_timestamp_query_pool_ = VK_NULL_HANDLE;
+    return false;
+  }
+  // timestampPeriod is the number of nanoseconds per tick.
+  gpu_timestamp_profiler_.SetTicksPerSecond(
+      1000000000.0 / double(device_info.timestampPeriod));
+  return true;
+}
+
+void VulkanCommandProcessor::CompleteGpuTimestamps() {
+  if (gpu_timestamp_query_pool_ == VK_NULL_HANDLE) {
+    return;
+  }
+  const ui::vulkan::VulkanProvider& provider = GetVulkanProvider();
+  const ui::vulkan::VulkanProvider::DeviceFunctions& dfn = provider.dfn();
+  VkDevice device = provider.device();
+  // UINT64_MAX if there are no pending submissions.
+  for (uint64_t submission = gpu_timestamp_profiler_.GetNextPendingSubmission();
+       submission <= submission_completed_;
+       submission = gpu_timestamp_profiler_.GetNextPendingSubmission()) {
+    uint32_t timestamp_count =
+        gpu_timestamp_profiler_.GetNextPendingSubmissionTimestampCount();
+    if (dfn.vkGetQueryPoolResults(
+            device, gpu_timestamp_query_pool_,
+            GpuTimestampProfiler::GetSubmissionFirstTimestamp(submission),
+            timestamp_count, sizeof(uint64_t) * timestamp_count,
+            gpu_timestamp_results_temp_.data(), sizeof(uint64_t),
+            VK_QUERY_RESULT_64_BIT) != VK_SUCCESS) {
+      // Still need to drop the submission from the pending ones.
+      std::fill_n(gpu_timestamp_results_temp_.begin(), timestamp_count,
+                  uint64_t(0));
+    }
+    gpu_timestamp_profiler_.AccumulateSubmission(
+        gpu_timestamp_results_temp_.data());
+  }
+}
+
 #define COMMAND_PROCESSOR VulkanCommandProcessor
 #include "../pm4_command_processor_implement.h"
 }  // namespace vulkan
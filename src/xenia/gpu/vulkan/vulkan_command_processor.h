@@ -25,6 +25,7 @@
 #include "xenia/base/hash.h"
 #include "xenia/gpu/command_processor.h"
 #include "xenia/gpu/draw_util.h"
+#include "xenia/gpu/gpu_timestamp_profiler.h"
 #include "xenia/gpu/registers.h"
 #include "xenia/gpu/spirv_shader_translator.h"
 #include "xenia/gpu/vulkan/deferred_command_buffer.h"
@@ -143,9 +144,19 @@ class VulkanCommandProcessor final : public CommandProcessor {
 
   void ClearCaches() override;
 
+  void InitializeShaderStorage(const std::filesystem::path& cache_root,
+                               uint32_t title_id, bool blocking) override;
+
   void TracePlaybackWroteMemory(uint32_t base_ptr, uint32_t length) override;
 
   void RestoreEdramSnapshot(const void* snapshot) override;
+  bool AwaitHostGpuCompletion() override {
+    return AwaitAllQueueOperationsCompletion();
+  }
+  DrawExtentEstimator::Statistics GetDrawExtentEstimatorStatistics()
+      const override {
+    return render_target_cache_->draw_extent_estimator().statistics();
+  }
 
   ui::vulkan::VulkanProvider& GetVulkanProvider() const {
     return *static_cast<ui::vulkan::VulkanProvider*>(
@@ -166,6 +177,20 @@ class VulkanCommandProcessor final : public CommandProcessor {
   }
   uint64_t GetCompletedSubmission() const { return submission_completed_; }
 
+  // If GPU timestamp profiling is enabled, writes a timestamp if the category
+  // of the work in the currently open submission is changed.
+  void SwitchGpuTimestampCategory(GpuTimestampProfiler::Category category) {
+    if (gpu_timestamp_query_pool_ == VK_NULL_HANDLE) {
+      return;
+    }
+    uint32_t index = gpu_timestamp_profiler_.SwitchCategory(category);
+    if (index != UINT32_MAX) {
+      deferred_command_buffer_.CmdVkWriteTimestamp(
+          VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, gpu_timestamp_query_pool_,
+          index);
+    }
+  }
+
   // Sparse binds are:
   // - In a single submission, all submitted in one vkQueueBindSparse.
   // - Sent to the queue without waiting for a semaphore.
@@ -267,11 +292,9 @@ class VulkanCommandProcessor final : public CommandProcessor {
  protected:
   bool SetupContext() override;
   void ShutdownContext() override;
-  XE_FORCEINLINE
-  void WriteRegister(uint32_t index, uint32_t value) override;
-  XE_FORCEINLINE
-  virtual void WriteRegistersFromMem(uint32_t start_index, uint32_t* base,
-                                     uint32_t num_registers) override;
+  void OnShaderConstantsWritten(RegisterFile::WriteClass write_class,
+                                uint32_t first_index, uint32_t count) override;
+  void OnFetchConstantsChanged(uint32_t fetch_constant_mask) override;
 
   void OnGammaRamp256EntryTableValueWritten() override;
   void OnGammaRampPWLValueWritten() override;
@@ -435,6 +458,10 @@ class VulkanCommandProcessor final : public CommandProcessor {
     return !submission_open_ && submissions_in_flight_fences_.empty();
   }
 
+  bool InitializeGpuTimestamps();
+  // Accumulates the timestamps of the completed submissions.
+  void CompleteGpuTimestamps();
+
   void ClearTransientDescriptorPools();
 
   void SplitPendingBarrier();
@@ -443,7 +470,8 @@ class VulkanCommandProcessor final : public CommandProcessor {
 
   void UpdateDynamicState(const draw_util::ViewportInfo& viewport_info,
                           bool primitive_polygonal,
-                          reg::RB_DEPTHCONTROL normalized_depth_control);
+                          reg::RB_DEPTHCONTROL normalized_depth_control,
+                          uint32_t dirty_state_groups);
   void UpdateSystemConstantValues(
       bool primitive_polygonal,
       const PrimitiveProcessor::ProcessingResult& primitive_processing_result,
@@ -466,9 +494,26 @@ class VulkanCommandProcessor final : public CommandProcessor {
       const VkDescriptorImageInfo* texture_image_info,
       const VkDescriptorImageInfo* sampler_image_info,
       VkWriteDescriptorSet* descriptor_set_writes_out);
+  // Returns a texture descriptor set with the same layout and contents written
+  // earlier in the current submission, or VK_NULL_HANDLE if there's none. The
+  // image info of the textures must be followed by the image info of the
+  // samplers.
+  VkDescriptorSet FindCachedTextureDescriptorSet(
+      bool is_vertex, uint32_t texture_count, uint32_t sampler_count,
+      const VkDescriptorImageInfo* image_info) const;
+  void AddCachedTextureDescriptorSet(bool is_vertex, uint32_t texture_count,
+                                     uint32_t sampler_count,
+                                     const VkDescriptorImageInfo* image_info,
+                                     VkDescriptorSet descriptor_set);
 
   bool device_lost_ = false;
 
+  GpuTimestampProfiler gpu_timestamp_profiler_;
+  // VK_NULL_HANDLE if GPU timestamp profiling is disabled.
+  VkQueryPool gpu_timestamp_query_pool_ = VK_NULL_HANDLE;
+  std::array<uint64_t, GpuTimestampProfiler::kTimestampsPerSubmission>
+      gpu_timestamp_results_temp_;
+
   bool cache_clear_requested_ = false;
 
   // Host shader types that guest shaders can be translated into - they can
@@ -569,6 +614,19 @@ class VulkanCommandProcessor final : public CommandProcessor {
                      std::vector<VkDescriptorSet>,
                      TextureDescriptorSetLayoutKey::Hasher>
       texture_transient_descriptor_sets_free_;
+  // Texture descriptor sets written in the current submission, keyed by the
+  // hash of their layout and contents, for reusing them in draws switching back
+  // to the same textures and samplers (titles often alternate between a few
+  // materials) instead of writing new ones. Cleared at the beginning of every
+  // submission as image views and samplers may be destroyed once the
+  // submissions using them are completed.
+  struct CachedTextureDescriptorSet {
+    TextureDescriptorSetLayoutKey layout;
+    std::vector<VkDescriptorImageInfo> image_info;
+    VkDescriptorSet set;
+  };
+  std::unordered_multimap<uint64_t, CachedTextureDescriptorSet>
+      texture_descriptor_set_cache_;
 
   std::unique_ptr<VulkanSharedMemory> shared_memory_;
 
@@ -678,6 +736,9 @@ class VulkanCommandProcessor final : public CommandProcessor {
   uint32_t dynamic_stencil_write_mask_back_ = UINT8_MAX;
   uint32_t dynamic_stencil_reference_front_ = 0;
   uint32_t dynamic_stencil_reference_back_ = 0;
+  // The last primitive type the depth bias and the stencil state faces were
+  // chosen for.
+  bool dynamic_depth_stencil_primitive_polygonal_ = false;
   bool dynamic_viewport_update_needed_;
   bool dynamic_scissor_update_needed_;
   bool dynamic_depth_bias_update_needed_;
@@ -689,6 +750,12 @@ class VulkanCommandProcessor final : public CommandProcessor {
   bool dynamic_stencil_reference_front_update_needed_;
   bool dynamic_stencil_reference_back_update_needed_;
 
+  // The last guest viewport and scissor, rebuilt only when their registers or
+  // other inputs change.
+  draw_util::GetViewportInfoArgs previous_viewport_info_args_{};
+  draw_util::ViewportInfo previous_viewport_info_;
+  draw_util::Scissor previous_scissor_;
+
   // Currently used samplers.
   std::vector<std::pair<VulkanTextureCache::SamplerParameters, VkSampler>>
       current_samplers_vertex_;
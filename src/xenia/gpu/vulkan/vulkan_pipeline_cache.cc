@@ -11,22 +11,33 @@
 
 #include <algorithm>
 #include <array>
+#include <atomic>
 #include <cstdint>
 #include <cstring>
 #include <memory>
+#include <set>
+#include <string>
 #include <utility>
 #include <vector>
 
 #include "third_party/fmt/include/fmt/format.h"
 #include "xenia/base/assert.h"
+#include "xenia/base/byte_order.h"
+#include "xenia/base/clock.h"
+#include "xenia/base/cvar.h"
+#include "xenia/base/filesystem.h"
+#include "xenia/base/frame_timeline.h"
 #include "xenia/base/logging.h"
 #include "xenia/base/math.h"
 #include "xenia/base/profiling.h"
+#include "xenia/base/string.h"
+#include "xenia/base/string_buffer.h"
 #include "xenia/base/xxhash.h"
 #include "xenia/gpu/draw_util.h"
 #include "xenia/gpu/gpu_flags.h"
 #include "xenia/gpu/register_file.h"
 #include "xenia/gpu/registers.h"
+#include "xenia/gpu/shader_storage_merge.h"
 #include "xenia/gpu/spirv_builder.h"
 #include "xenia/gpu/spirv_shader_translator.h"
 #include "xenia/gpu/vulkan/vulkan_command_processor.h"
@@ -34,6 +45,21 @@
 #include "xenia/gpu/xenos.h"
 #include "xenia/ui/vulkan/vulkan_util.h"
 
+DEFINE_bool(
+    vulkan_spirv_optimize, false,
+    "Run the SPIRV-Tools performance optimization passes on the translated "
+    "shaders before passing them to the driver (requires the SPIRV-Tools "
+    "library from the Vulkan SDK, with the VULKAN_SDK environment variable "
+    "set). The optimized SPIR-V is cached in the local shader storage.",
+    "Vulkan");
+DEFINE_bool(
+    vulkan_graphics_pipeline_library, true,
+    "Create the shader and the fixed-function parts of the graphics pipelines "
+    "once and link them quickly if VK_EXT_graphics_pipeline_library is "
+    "supported, replacing the quickly linked pipelines with optimized ones "
+    "created in the background.",
+    "Vulkan");
+
 namespace xe {
 namespace gpu {
 namespace vulkan {
@@ -58,11 +84,22 @@ bool VulkanPipelineCache::Initialize() {
       render_target_cache_.GetPath() ==
       RenderTargetCache::Path::kPixelShaderInterlock;
 
-  shader_translator_ = std::make_unique<SpirvShaderTranslator>(
-      SpirvShaderTranslator::Features(provider.device_info()),
-      render_target_cache_.msaa_2x_attachments_supported(),
-      render_target_cache_.msaa_2x_no_attachments_supported(),
-      edram_fragment_shader_interlock);
+  shader_translator_ = CreateShaderTranslator();
+
+  spirv_optimizer_available_ = false;
+  if (cvars::vulkan_spirv_optimize) {
+    if (spirv_tools_context_.Initialize(
+            SpirvShaderTranslator::Features(provider.device_info())
+                .spirv_version) &&
+        spirv_tools_context_.IsOptimizerAvailable()) {
+      spirv_optimizer_available_ = true;
+    } else {
+      XELOGW(
+          "VulkanPipelineCache: The SPIR-V optimizer is not available, "
+          "translated shaders will be passed to the driver unoptimized");
+      spirv_tools_context_.Shutdown();
+    }
+  }
 
   if (edram_fragment_shader_interlock) {
     std::vector<uint8_t> depth_only_fragment_shader_code =
@@ -81,10 +118,73 @@ bool VulkanPipelineCache::Initialize() {
     }
   }
 
+  const ui::vulkan::VulkanProvider::DeviceInfo& device_info =
+      provider.device_info();
+  use_graphics_pipeline_library_ =
+      cvars::vulkan_graphics_pipeline_library &&
+      device_info.graphicsPipelineLibrary &&
+      device_info.graphicsPipelineLibraryFastLinking;
+  if (use_graphics_pipeline_library_) {
+    XELOGGPU(
+        "VulkanPipelineCache: Using the graphics pipeline library for pipeline "
+        "creation");
+  }
+
+  async_pipeline_creation_ = cvars::async_pipeline_creation;
+  if (async_pipeline_creation_ || use_graphics_pipeline_library_) {
+    uint32_t logical_processor_count =
+        xe::threading::logical_processor_count();
+    if (!logical_processor_count) {
+      // Pick some reasonable amount if couldn't determine the number of cores.
+      logical_processor_count = 6;
+    }
+    size_t creation_thread_count =
+        std::max(logical_processor_count * 3 / 4, uint32_t(1));
+    creation_threads_shutdown_ = false;
+    for (size_t i = 0; i < creation_thread_count; ++i) {
+      std::unique_ptr<xe::threading::Thread> creation_thread =
+          xe::threading::Thread::Create({}, [this]() { CreationThread(); });
+      assert_not_null(creation_thread);
+      creation_thread->set_name("Vulkan Pipelines");
+      creation_threads_.push_back(std::move(creation_thread));
+    }
+  }
+
   return true;
 }
 
 void VulkanPipelineCache::Shutdown() {
+  ShutdownShaderStorage();
+
+  // Stop asynchronous pipeline creation, dropping the pipelines not created
+  // yet.
+  if (!creation_threads_.empty()) {
+    {
+      std::lock_guard<std::mutex> lock(creation_request_lock_);
+      creation_threads_shutdown_ = true;
+      creation_queue_.clear();
+      optimization_queue_.clear();
+    }
+    creation_request_cond_.notify_all();
+    for (auto& creation_thread : creation_threads_) {
+      xe::threading::Wait(creation_thread.get(), false);
+    }
+    creation_threads_.clear();
+    XELOGGPU(
+        "Up to {} shader translations and {} pipelines were queued for the "
+        "creation threads",
+        translation_queue_max_depth_, creation_queue_max_depth_);
+  }
+  creation_completed_.clear();
+  creation_pending_count_ = 0;
+  // A fast-linked pipeline may have been created after the queue was cleared.
+  optimization_queue_.clear();
+  translation_queue_.clear();
+  translations_completed_.clear();
+  translations_pending_.clear();
+  translation_queue_max_depth_ = 0;
+  creation_queue_max_depth_ = 0;
+
   const ui::vulkan::VulkanProvider& provider =
       command_processor_.GetVulkanProvider();
   const ui::vulkan::VulkanProvider::DeviceFunctions& dfn = provider.dfn();
@@ -92,12 +192,27 @@ void VulkanPipelineCache::Shutdown() {
 
   // Destroy all pipelines.
   last_pipeline_ = nullptr;
+  for (const PipelineOptimized& optimized : optimization_completed_) {
+    dfn.vkDestroyPipeline(device, optimized.optimized_pipeline, nullptr);
+  }
+  optimization_completed_.clear();
+  optimization_completed_count_.store(0, std::memory_order_relaxed);
+  for (const auto& pipeline_replaced : pipelines_replaced_) {
+    dfn.vkDestroyPipeline(device, pipeline_replaced.second, nullptr);
+  }
+  pipelines_replaced_.clear();
   for (const auto& pipeline_pair : pipelines_) {
     if (pipeline_pair.second.pipeline != VK_NULL_HANDLE) {
       dfn.vkDestroyPipeline(device, pipeline_pair.second.pipeline, nullptr);
     }
   }
   pipelines_.clear();
+  for (const auto& pipeline_library_pair : pipeline_libraries_) {
+    dfn.vkDestroyPipeline(device, pipeline_library_pair.second, nullptr);
+  }
+  pipeline_libraries_.clear();
+  use_graphics_pipeline_library_ = false;
+  async_pipeline_creation_ = false;
 
   // Destroy all internal shaders.
   ui::vulkan::util::DestroyAndNullHandle(dfn.vkDestroyShaderModule, device,
@@ -119,14 +234,566 @@ void VulkanPipelineCache::Shutdown() {
 
   // Shut down shader translation.
   shader_translator_.reset();
+  spirv_optimizer_available_ = false;
+  spirv_tools_context_.Shutdown();
+}
+
+void VulkanPipelineCache::InitializeShaderStorage(
+    const std::filesystem::path& cache_root, uint32_t title_id,
+    [[maybe_unused]] bool blocking) {
+  ShutdownShaderStorage();
+
+  // The storage translates shaders on its own threads, which must not race
+  // with the asynchronous translation of the same shaders.
+  AwaitPendingTranslations();
+
+  auto shader_storage_root = cache_root / "shaders";
+  // For files that can be moved between different hosts.
+  auto shader_storage_shareable_root = shader_storage_root / "shareable";
+  if (!std::filesystem::exists(shader_storage_shareable_root)) {
+    if (!std::filesystem::create_directories(shader_storage_shareable_root)) {
+      XELOGE(
+          "Failed to create the shareable shader storage directory, persistent "
+          "shader storage will be disabled: {}",
+          xe::path_to_utf8(shader_storage_shareable_root));
+      return;
+    }
+  }
+  // Add what has been collected elsewhere before opening the local files.
+  MergeSharedShaderStorage(shader_storage_shareable_root, title_id);
+
+  const ui::vulkan::VulkanProvider& provider =
+      command_processor_.GetVulkanProvider();
+
+  bool edram_fragment_shader_interlock =
+      render_target_cache_.GetPath() ==
+      RenderTargetCache::Path::kPixelShaderInterlock;
+
+  // Initialize the pipeline storage stream - read pipeline descriptions and
+  // collect used shader modifications to translate.
+  std::vector<PipelineStoredDescription> pipeline_stored_descriptions;
+  // <Shader hash, modification bits>.
+  std::set<std::pair<uint64_t, uint64_t>> shader_translations_needed;
+  auto pipeline_storage_file_path =
+      shader_storage_shareable_root /
+      fmt::format("{:08X}.{}.vulkan.xpso", title_id,
+                  edram_fragment_shader_interlock ? "fsi" : "rtv");
+  // 'XEPS'.
+  const uint32_t pipeline_storage_magic = 0x53504558;
+  // 'VKFS' or 'VKRT'.
+  const uint32_t pipeline_storage_magic_api =
+      edram_fragment_shader_interlock ? 0x53464B56 : 0x54524B56;
+  const uint32_t pipeline_storage_version_swapped =
+      xe::byte_swap(std::max(PipelineDescription::kVersion,
+                             SpirvShaderTranslator::Modification::kVersion));
+  struct {
+    uint32_t magic;
+    uint32_t magic_api;
+    uint32_t version_swapped;
+  } pipeline_storage_file_header;
+  pipeline_storage_file_header.magic = pipeline_storage_magic;
+  pipeline_storage_file_header.magic_api = pipeline_storage_magic_api;
+  pipeline_storage_file_header.version_swapped =
+      pipeline_storage_version_swapped;
+  pipeline_storage_file_ = OpenShaderStorageFile(
+      pipeline_storage_file_path, &pipeline_storage_file_header,
+      sizeof(pipeline_storage_file_header));
+  if (!pipeline_storage_file_) {
+    XELOGE(
+        "Failed to open the Vulkan pipeline description storage file for "
+        "writing, persistent shader storage will be disabled: {}",
+        xe::path_to_utf8(pipeline_storage_file_path));
+    return;
+  }
+  pipeline_storage_file_flush_needed_ = false;
+  // Count of the descriptions, including the ones not usable on this device,
+  // that have passed the validation and must be kept in the file.
+  size_t pipeline_storage_valid_count = 0;
+  xe::filesystem::Seek(pipeline_storage_file_, 0, SEEK_END);
+  int64_t pipeline_storage_told_end =
+      xe::filesystem::Tell(pipeline_storage_file_);
+  if (pipeline_storage_told_end >
+      int64_t(sizeof(pipeline_storage_file_header))) {
+    size_t pipeline_storage_told_count =
+        size_t((uint64_t(pipeline_storage_told_end) -
+                sizeof(pipeline_storage_file_header)) /
+               sizeof(PipelineStoredDescription));
+    if (pipeline_storage_told_count &&
+        xe::filesystem::Seek(pipeline_storage_file_,
+                             int64_t(sizeof(pipeline_storage_file_header)),
+                             SEEK_SET)) {
+      pipeline_stored_descriptions.resize(pipeline_storage_told_count);
+      pipeline_stored_descriptions.resize(
+          fread(pipeline_stored_descriptions.data(),
+                sizeof(PipelineStoredDescription), pipeline_storage_told_count,
+                pipeline_storage_file_));
+      size_t pipeline_storage_read_count = pipeline_stored_descriptions.size();
+      size_t pipeline_storage_usable_count = 0;
+      for (size_t i = 0; i < pipeline_storage_read_count; ++i) {
+        const PipelineStoredDescription& pipeline_stored_description =
+            pipeline_stored_descriptions[i];
+        // Validate file integrity, stop and truncate the stream if data is
+        // corrupted.
+        if (XXH3_64bits(&pipeline_stored_description.description,
+                        sizeof(pipeline_stored_description.description)) !=
+            pipeline_stored_description.description_hash) {
+          break;
+        }
+        ++pipeline_storage_valid_count;
+        // Skip pipelines requiring unsupported device features, but keep them
+        // in the file, so it stays shareable across devices.
+        if (!ArePipelineRequirementsMet(
+                pipeline_stored_description.description)) {
+          continue;
+        }
+        // Mark the shader modifications as needed for translation.
+        shader_translations_needed.emplace(
+            pipeline_stored_description.description.vertex_shader_hash,
+            pipeline_stored_description.description.vertex_shader_modification);
+        if (pipeline_stored_description.description.pixel_shader_hash) {
+          shader_translations_needed.emplace(
+              pipeline_stored_description.description.pixel_shader_hash,
+              pipeline_stored_description.description
+                  .pixel_shader_modification);
+        }
+        if (pipeline_storage_usable_count != i) {
+          std::memcpy(
+              &pipeline_stored_descriptions[pipeline_storage_usable_count],
+              &pipeline_stored_description,
+              sizeof(pipeline_stored_description));
+        }
+        ++pipeline_storage_usable_count;
+      }
+      pipeline_stored_descriptions.resize(pipeline_storage_usable_count);
+    }
+  }
+
+  // The optimized SPIR-V depends on the version of SPIRV-Tools, thus stored in
+  // shaders/local/. Loaded before translating the shaders from the storage so
+  // they don't need to be optimized again.
+  if (spirv_optimizer_available_) {
+    LoadSpirvOptimizedStorage(
+        shader_storage_root / "local" /
+        fmt::format("{:08X}.{}.vulkan.spvopt", title_id,
+                    edram_fragment_shader_interlock ? "fsi" : "rtv"));
+  }
+
+  size_t logical_processor_count = xe::threading::logical_processor_count();
+  if (!logical_processor_count) {
+    // Pick some reasonable amount if couldn't determine the number of cores.
+    logical_processor_count = 6;
+  }
+
+  // Initialize the Xenos shader storage stream, shared with the other
+  // backends.
+  uint64_t shader_storage_initialization_start =
+      xe::Clock::QueryHostTickCount();
+  auto shader_storage_file_path =
+      shader_storage_shareable_root / fmt::format("{:08X}.xsh", title_id);
+  struct {
+    uint32_t magic;
+    uint32_t version_swapped;
+  } shader_storage_file_header;
+  // 'XESH'.
+  shader_storage_file_header.magic = 0x48534558;
+  shader_storage_file_header.version_swapped =
+      xe::byte_swap(ShaderStoredHeader::kVersion);
+  shader_storage_file_ = OpenShaderStorageFile(
+      shader_storage_file_path, &shader_storage_file_header,
+      sizeof(shader_storage_file_header));
+  if (!shader_storage_file_) {
+    XELOGE(
+        "Failed to open the guest shader storage file for writing, persistent "
+        "shader storage will be disabled: {}",
+        xe::path_to_utf8(shader_storage_file_path));
+    fclose(pipeline_storage_file_);
+    pipeline_storage_file_ = nullptr;
+    return;
+  }
+  ++shader_storage_index_;
+  shader_storage_file_flush_needed_ = false;
+  {
+    uint64_t shader_storage_valid_bytes = sizeof(shader_storage_file_header);
+    // Load and translate shaders written by previous Xenia executions until the
+    // end of the file or until a corrupted one is detected.
+    ShaderStoredHeader shader_header;
+    std::vector<uint32_t> ucode_dwords;
+    ucode_dwords.reserve(0xFFFF);
+    size_t shaders_translated = 0;
+
+    // Threads overlapping file reading.
+    std::mutex shaders_translation_thread_mutex;
+    std::condition_variable shaders_translation_thread_cond;
+    std::deque<VulkanShader*> shaders_to_translate;
+    size_t shader_translation_threads_busy = 0;
+    bool shader_translation_threads_shutdown = false;
+    std::mutex shaders_failed_to_translate_mutex;
+    std::vector<VulkanShader::VulkanTranslation*> shaders_failed_to_translate;
+    auto shader_translation_thread_function = [&]() {
+      StringBuffer ucode_disasm_buffer;
+      std::unique_ptr<SpirvShaderTranslator> translator =
+          CreateShaderTranslator();
+      for (;;) {
+        VulkanShader* shader_to_translate;
+        for (;;) {
+          std::unique_lock<std::mutex> lock(shaders_translation_thread_mutex);
+          if (shaders_to_translate.empty()) {
+            if (shader_translation_threads_shutdown) {
+              return;
+            }
+            shaders_translation_thread_cond.wait(lock);
+            continue;
+          }
+          shader_to_translate = shaders_to_translate.front();
+          shaders_to_translate.pop_front();
+          ++shader_translation_threads_busy;
+          break;
+        }
+        if (!shader_to_translate->is_ucode_analyzed()) {
+          shader_to_translate->AnalyzeUcode(ucode_disasm_buffer);
+        }
+        // Translate each needed modification on this thread after performing
+        // modification-independent analysis of the whole shader.
+        uint64_t ucode_data_hash = shader_to_translate->ucode_data_hash();
+        for (auto modification_it = shader_translations_needed.lower_bound(
+                 std::make_pair(ucode_data_hash, uint64_t(0)));
+             modification_it != shader_translations_needed.end() &&
+             modification_it->first == ucode_data_hash;
+             ++modification_it) {
+          VulkanShader::VulkanTranslation* translation =
+              static_cast<VulkanShader::VulkanTranslation*>(
+                  shader_to_translate->GetOrCreateTranslation(
+                      modification_it->second));
+          // Only try (and delete in case of failure) if it's a new translation.
+          // If it's a shader previously encountered in the game, translation of
+          // which has failed, and the shader storage is loaded later, keep it
+          // this way not to try to translate it again.
+          if (!translation->is_translated() &&
+              !TranslateAnalyzedShader(*translator, *translation)) {
+            std::lock_guard<std::mutex> lock(shaders_failed_to_translate_mutex);
+            shaders_failed_to_translate.push_back(translation);
+          }
+        }
+        {
+          std::lock_guard<std::mutex> lock(shaders_translation_thread_mutex);
+          --shader_translation_threads_busy;
+        }
+      }
+    };
+    std::vector<std::unique_ptr<xe::threading::Thread>>
+        shader_translation_threads;
+
+    while (true) {
+      if (!fread(&shader_header, sizeof(shader_header), 1,
+                 shader_storage_file_)) {
+        break;
+      }
+      size_t ucode_byte_count =
+          shader_header.ucode_dword_count * sizeof(uint32_t);
+      ucode_dwords.resize(shader_header.ucode_dword_count);
+      if (shader_header.ucode_dword_count &&
+          !fread(ucode_dwords.data(), ucode_byte_count, 1,
+                 shader_storage_file_)) {
+        break;
+      }
+      uint64_t ucode_data_hash =
+          XXH3_64bits(ucode_dwords.data(), ucode_byte_count);
+      if (shader_header.ucode_data_hash != ucode_data_hash) {
+        // Validation failed.
+        break;
+      }
+      shader_storage_valid_bytes += sizeof(shader_header) + ucode_byte_count;
+      VulkanShader* shader =
+          LoadShader(shader_header.type, ucode_dwords.data(),
+                     shader_header.ucode_dword_count, ucode_data_hash);
+      if (shader->ucode_storage_index() == shader_storage_index_) {
+        // Appeared twice in this file for some reason - skip, otherwise race
+        // condition will be caused by translating twice in parallel.
+        continue;
+      }
+      // Loaded from the current storage - don't write again.
+      shader->set_ucode_storage_index(shader_storage_index_);
+      // Create new threads if the currently existing threads can't keep up
+      // with file reading, but not more than the number of logical processors
+      // minus one.
+      size_t shader_translation_threads_needed;
+      {
+        std::lock_guard<std::mutex> lock(shaders_translation_thread_mutex);
+        shader_translation_threads_needed = std::max(
+            std::min(shader_translation_threads_busy +
+                         shaders_to_translate.size() + size_t(1),
+                     logical_processor_count - size_t(1)),
+            size_t(1));
+      }
+      while (shader_translation_threads.size() <
+             shader_translation_threads_needed) {
+        auto thread = xe::threading::Thread::Create(
+            {}, shader_translation_thread_function);
+        assert_not_null(thread);
+        thread->set_name("Shader Translation");
+        shader_translation_threads.push_back(std::move(thread));
+      }
+      // Request ucode information gathering and translation of all the needed
+      // shaders.
+      {
+        std::lock_guard<std::mutex> lock(shaders_translation_thread_mutex);
+        shaders_to_translate.push_back(shader);
+      }
+      shaders_translation_thread_cond.notify_one();
+      ++shaders_translated;
+    }
+    if (!shader_translation_threads.empty()) {
+      {
+        std::lock_guard<std::mutex> lock(shaders_translation_thread_mutex);
+        shader_translation_threads_shutdown = true;
+      }
+      shaders_translation_thread_cond.notify_all();
+      for (auto& shader_translation_thread : shader_translation_threads) {
+        xe::threading::Wait(shader_translation_thread.get(), false);
+      }
+      shader_translation_threads.clear();
+      for (VulkanShader::VulkanTranslation* translation :
+           shaders_failed_to_translate) {
+        VulkanShader* shader = static_cast<VulkanShader*>(&translation->shader());
+        shader->DestroyTranslation(translation->modification());
+        if (shader->translations().empty()) {
+          shaders_.erase(shader->ucode_data_hash());
+          delete shader;
+        }
+      }
+    }
+    XELOGGPU("Translated {} shaders from the storage in {} milliseconds",
+             shaders_translated,
+             (xe::Clock::QueryHostTickCount() -
+              shader_storage_initialization_start) *
+                 1000 / xe::Clock::QueryHostTickFrequency());
+    // Drop the shaders after the first corrupted one.
+    if (uint64_t(xe::filesystem::Tell(shader_storage_file_)) !=
+            shader_storage_valid_bytes &&
+        !TruncateShaderStorageFile(shader_storage_file_,
+                                   shader_storage_valid_bytes)) {
+      XELOGW(
+          "The guest shader storage file is corrupted and used by another "
+          "instance, not adding new shaders to it: {}",
+          xe::path_to_utf8(shader_storage_file_path));
+      fclose(shader_storage_file_);
+      shader_storage_file_ = nullptr;
+    }
+  }
+
+  // The driver's own cache of the compiled pipelines, only usable on the same
+  // device with the same driver, thus stored in shaders/local/.
+  const ui::vulkan::VulkanProvider::DeviceInfo& device_info =
+      provider.device_info();
+  std::string pipeline_cache_uuid;
+  for (uint8_t uuid_byte : device_info.pipelineCacheUUID) {
+    pipeline_cache_uuid += fmt::format("{:02x}", uuid_byte);
+  }
+  LoadVkPipelineCache(
+      shader_storage_root / "local" /
+      fmt::format("{:08X}.{}.vulkan.{:04X}{:04X}.{}.bin", title_id,
+                  edram_fragment_shader_interlock ? "fsi" : "rtv",
+                  device_info.vendorID, device_info.deviceID,
+                  pipeline_cache_uuid));
+
+  // Create the pipelines.
+  if (pipeline_storage_valid_count) {
+    uint64_t pipeline_creation_start = xe::Clock::QueryHostTickCount();
+
+    // Look up everything needed for creation on this thread, as the shader,
+    // render pass and layout caches are not thread-safe.
+    std::vector<PipelineCreationArguments> pipelines_to_create;
+    pipelines_to_create.reserve(pipeline_stored_descriptions.size());
+    for (const PipelineStoredDescription& pipeline_stored_description :
+         pipeline_stored_descriptions) {
+      const PipelineDescription& pipeline_description =
+          pipeline_stored_description.description;
+      // Skip already known pipelines.
+      if (pipelines_.find(pipeline_description) != pipelines_.end()) {
+        continue;
+      }
+      auto vertex_shader_it =
+          shaders_.find(pipeline_description.vertex_shader_hash);
+      if (vertex_shader_it == shaders_.end()) {
+        continue;
+      }
+      auto vertex_shader = static_cast<VulkanShader::VulkanTranslation*>(
+          vertex_shader_it->second->GetTranslation(
+              pipeline_description.vertex_shader_modification));
+      if (!vertex_shader || !vertex_shader->is_translated() ||
+          !vertex_shader->is_valid()) {
+        continue;
+      }
+      VulkanShader::VulkanTranslation* pixel_shader = nullptr;
+      if (pipeline_description.pixel_shader_hash) {
+        auto pixel_shader_it =
+            shaders_.find(pipeline_description.pixel_shader_hash);
+        if (pixel_shader_it == shaders_.end()) {
+          continue;
+        }
+        pixel_shader = static_cast<VulkanShader::VulkanTranslation*>(
+            pixel_shader_it->second->GetTranslation(
+                pipeline_description.pixel_shader_modification));
+        if (!pixel_shader || !pixel_shader->is_translated() ||
+            !pixel_shader->is_valid()) {
+          continue;
+        }
+      }
+      PipelineCreationArguments creation_arguments;
+      if (!PreparePipelineCreation(pipeline_description, vertex_shader,
+                                   pixel_shader, creation_arguments)) {
+        continue;
+      }
+      pipelines_to_create.push_back(creation_arguments);
+    }
+
+    // Create the pipelines using all cores, including this thread. Pipeline
+    // creation is not deferred in this implementation, so everything is loaded
+    // by the time this returns regardless of whether it's blocking.
+    std::atomic<size_t> pipeline_creation_next_index{0};
+    std::atomic<size_t> pipelines_created{0};
+    auto pipeline_creation_thread_function = [&]() {
+      for (;;) {
+        size_t index = pipeline_creation_next_index.fetch_add(
+            1, std::memory_order_relaxed);
+        if (index >= pipelines_to_create.size()) {
+          return;
+        }
+        if (EnsurePipelineCreated(pipelines_to_create[index])) {
+          pipelines_created.fetch_add(1, std::memory_order_relaxed);
+        }
+      }
+    };
+    std::vector<std::unique_ptr<xe::threading::Thread>>
+        pipeline_creation_threads;
+    size_t pipeline_creation_thread_count =
+        std::min(pipelines_to_create.size(), logical_processor_count);
+    while (pipeline_creation_threads.size() + 1 <
+           pipeline_creation_thread_count) {
+      auto thread = xe::threading::Thread::Create(
+          {}, pipeline_creation_thread_function);
+      assert_not_null(thread);
+      thread->set_name("Vulkan Pipelines");
+      pipeline_creation_threads.push_back(std::move(thread));
+    }
+    pipeline_creation_thread_function();
+    for (auto& pipeline_creation_thread : pipeline_creation_threads) {
+      xe::threading::Wait(pipeline_creation_thread.get(), false);
+    }
+    pipeline_creation_threads.clear();
+
+    XELOGGPU(
+        "Created {} graphics pipelines (not including reading the "
+        "descriptions) from the storage in {} milliseconds",
+        pipelines_created.load(std::memory_order_relaxed),
+        (xe::Clock::QueryHostTickCount() - pipeline_creation_start) * 1000 /
+            xe::Clock::QueryHostTickFrequency());
+  }
+
+  // If any pipeline descriptions were corrupted (or the whole file has excess
+  // bytes in the end), drop everything after the last valid one.
+  uint64_t pipeline_storage_valid_bytes =
+      sizeof(pipeline_storage_file_header) +
+      sizeof(PipelineStoredDescription) * pipeline_storage_valid_count;
+  if (uint64_t(pipeline_storage_told_end) != pipeline_storage_valid_bytes &&
+      !TruncateShaderStorageFile(pipeline_storage_file_,
+                                 pipeline_storage_valid_bytes)) {
+    XELOGW(
+        "The Vulkan pipeline description storage file is corrupted and "
+        "used by another instance, not adding new pipelines to it: {}",
+        xe::path_to_utf8(pipeline_storage_file_path));
+    fclose(pipeline_storage_file_);
+    pipeline_storage_file_ = nullptr;
+  }
+
+  shader_storage_cache_root_ = cache_root;
+  shader_storage_title_id_ = title_id;
+
+  // Start the storage writing thread.
+  storage_write_flush_shaders_ = false;
+  storage_write_flush_pipelines_ = false;
+  storage_write_thread_shutdown_ = false;
+  storage_write_thread_ =
+      xe::threading::Thread::Create({}, [this]() { StorageWriteThread(); });
+  assert_not_null(storage_write_thread_);
+  storage_write_thread_->set_name("Vulkan Storage writer");
+}
+
+void VulkanPipelineCache::ShutdownShaderStorage() {
+  if (storage_write_thread_) {
+    {
+      std::lock_guard<std::mutex> lock(storage_write_request_lock_);
+      storage_write_thread_shutdown_ = true;
+    }
+    storage_write_request_cond_.notify_all();
+    xe::threading::Wait(storage_write_thread_.get(), false);
+    storage_write_thread_.reset();
+  }
+  storage_write_shader_queue_.clear();
+  storage_write_pipeline_queue_.clear();
+
+  if (pipeline_storage_file_) {
+    fclose(pipeline_storage_file_);
+    pipeline_storage_file_ = nullptr;
+    pipeline_storage_file_flush_needed_ = false;
+  }
+
+  if (shader_storage_file_) {
+    fclose(shader_storage_file_);
+    shader_storage_file_ = nullptr;
+    shader_storage_file_flush_needed_ = false;
+  }
+
+  SaveVkPipelineCache();
+
+  ShutdownSpirvOptimizedStorage();
+
+  shader_storage_cache_root_.clear();
+  shader_storage_title_id_ = 0;
+}
+
+void VulkanPipelineCache::EndSubmission() {
+  if (!pipelines_replaced_.empty()) {
+    const ui::vulkan::VulkanProvider& provider =
+        command_processor_.GetVulkanProvider();
+    uint64_t submission_completed = command_processor_.GetCompletedSubmission();
+    while (!pipelines_replaced_.empty() &&
+           pipelines_replaced_.front().first <= submission_completed) {
+      provider.dfn().vkDestroyPipeline(
+          provider.device(), pipelines_replaced_.front().second, nullptr);
+      pipelines_replaced_.pop_front();
+    }
+  }
+
+  if (shader_storage_file_flush_needed_ ||
+      pipeline_storage_file_flush_needed_) {
+    {
+      std::lock_guard<std::mutex> lock(storage_write_request_lock_);
+      if (shader_storage_file_flush_needed_) {
+        storage_write_flush_shaders_ = true;
+      }
+      if (pipeline_storage_file_flush_needed_) {
+        storage_write_flush_pipelines_ = true;
+      }
+    }
+    storage_write_request_cond_.notify_one();
+    shader_storage_file_flush_needed_ = false;
+    pipeline_storage_file_flush_needed_ = false;
+  }
 }
 
 VulkanShader* VulkanPipelineCache::LoadShader(xenos::ShaderType shader_type,
                                               const uint32_t* host_address,
                                               uint32_t dword_count) {
   // Hash the input memory and lookup the shader.
-  uint64_t data_hash =
-      XXH3_64bits(host_address, dword_count * sizeof(uint32_t));
+  return LoadShader(shader_type, host_address, dword_count,
+                    XXH3_64bits(host_address, dword_count * sizeof(uint32_t)));
+}
+
+VulkanShader* VulkanPipelineCache::LoadShader(xenos::ShaderType shader_type,
+                                              const uint32_t* host_address,
+                                              uint32_t dword_count,
+                                              uint64_t data_hash) {
   auto it = shaders_.find(data_hash);
   if (it != shaders_.end()) {
     // Shader has been previously loaded.
@@ -170,6 +837,13 @@ VulkanPipelineCache::GetCurrentVertexShaderModification(
                      xenos::PrimitiveType::kPointList);
   }
 
+  xenos::Endian vertex_fetch_endian;
+  if (draw_util::GetVertexFetchUniformEndian(shader, regs,
+                                             vertex_fetch_endian)) {
+    modification.vertex.vertex_fetch_endian_uniform = 1;
+    modification.vertex.vertex_fetch_endian = vertex_fetch_endian;
+  }
+
   return modification;
 }
 
@@ -225,40 +899,113 @@ VulkanPipelineCache::GetCurrentPixelShaderModification(
 
 bool VulkanPipelineCache::EnsureShadersTranslated(
     VulkanShader::VulkanTranslation* vertex_shader,
-    VulkanShader::VulkanTranslation* pixel_shader) {
+    VulkanShader::VulkanTranslation* pixel_shader, bool& pending_out) {
   // Edge flags are not supported yet (because polygon primitives are not).
   assert_true(register_file_.Get<reg::SQ_PROGRAM_CNTL>().vs_export_mode !=
                   xenos::VertexShaderExportMode::kPosition2VectorsEdge &&
               register_file_.Get<reg::SQ_PROGRAM_CNTL>().vs_export_mode !=
                   xenos::VertexShaderExportMode::kPosition2VectorsEdgeKill);
   assert_false(register_file_.Get<reg::SQ_PROGRAM_CNTL>().gen_index_vtx);
-  if (!vertex_shader->is_translated()) {
-    vertex_shader->shader().AnalyzeUcode(ucode_disasm_buffer_);
-    if (!TranslateAnalyzedShader(*shader_translator_, *vertex_shader)) {
-      XELOGE("Failed to translate the vertex shader!");
-      return false;
-    }
+  if (!translations_pending_.empty()) {
+    CollectTranslatedShaders();
   }
-  if (!vertex_shader->is_valid()) {
-    // Translation attempted previously, but not valid.
+  bool vertex_shader_pending, pixel_shader_pending = false;
+  if (!EnsureShaderTranslated(*vertex_shader, vertex_shader_pending)) {
     return false;
   }
-  if (pixel_shader != nullptr) {
-    if (!pixel_shader->is_translated()) {
-      pixel_shader->shader().AnalyzeUcode(ucode_disasm_buffer_);
-      if (!TranslateAnalyzedShader(*shader_translator_, *pixel_shader)) {
-        XELOGE("Failed to translate the pixel shader!");
-        return false;
+  if (pixel_shader != nullptr &&
+      !EnsureShaderTranslated(*pixel_shader, pixel_shader_pending)) {
+    return false;
+  }
+  pending_out = vertex_shader_pending || pixel_shader_pending;
+  return true;
+}
+
+bool VulkanPipelineCache::EnsureShaderTranslated(
+    VulkanShader::VulkanTranslation& translation, bool& pending_out) {
+  pending_out = false;
+  // Not touching the translation while a creation thread may be writing it.
+  if (!translations_pending_.empty() &&
+      translations_pending_.find(&translation) != translations_pending_.end()) {
+    pending_out = true;
+    return true;
+  }
+  if (!translation.is_translated()) {
+    Shader& shader = translation.shader();
+    if (!shader.is_ucode_analyzed()) {
+      shader.AnalyzeUcode(ucode_disasm_buffer_);
+    }
+    if (async_pipeline_creation_) {
+      translations_pending_.insert(&translation);
+      size_t translation_queue_depth;
+      {
+        std::lock_guard<std::mutex> lock(creation_request_lock_);
+        translation_queue_.push_back(&translation);
+        translation_queue_depth = translation_queue_.size();
       }
+      creation_request_cond_.notify_one();
+      translation_queue_max_depth_ =
+          std::max(translation_queue_max_depth_, translation_queue_depth);
+      COUNT_profile_set("gpu/pipeline_cache/translation_queue",
+                        translation_queue_depth);
+      pending_out = true;
+      return true;
     }
-    if (!pixel_shader->is_valid()) {
-      // Translation attempted previously, but not valid.
+    if (!TranslateAnalyzedShader(*shader_translator_, translation)) {
+      XELOGE("Failed to translate the {} shader!",
+             shader.type() == xenos::ShaderType::kVertex ? "vertex" : "pixel");
       return false;
     }
   }
+  if (!translation.is_valid()) {
+    // Translation attempted previously, but not valid.
+    return false;
+  }
+  StoreShader(translation.shader());
   return true;
 }
 
+void VulkanPipelineCache::CollectTranslatedShaders() {
+  std::vector<VulkanShader::VulkanTranslation*> translations_completed;
+  {
+    std::lock_guard<std::mutex> lock(creation_request_lock_);
+    translations_completed.swap(translations_completed_);
+  }
+  for (VulkanShader::VulkanTranslation* translation : translations_completed) {
+    translations_pending_.erase(translation);
+  }
+}
+
+void VulkanPipelineCache::AwaitPendingTranslations() {
+  if (translations_pending_.empty()) {
+    return;
+  }
+  {
+    std::unique_lock<std::mutex> lock(creation_request_lock_);
+    translation_completion_awaited_ = true;
+    while (translations_completed_.size() < translations_pending_.size()) {
+      creation_request_cond_.wait(lock);
+    }
+    translation_completion_awaited_ = false;
+  }
+  CollectTranslatedShaders();
+}
+
+void VulkanPipelineCache::StoreShader(Shader& shader) {
+  if (!shader_storage_file_ ||
+      shader.ucode_storage_index() == shader_storage_index_) {
+    return;
+  }
+  assert_not_null(storage_write_thread_);
+  shader.set_ucode_storage_index(shader_storage_index_);
+  shader_storage_file_flush_needed_ = true;
+  {
+    std::lock_guard<std::mutex> lock(storage_write_request_lock_);
+    storage_write_shader_queue_.push_back(&shader);
+  }
+  storage_write_request_cond_.notify_all();
+}
+
 bool VulkanPipelineCache::ConfigurePipeline(
     VulkanShader::VulkanTranslation* vertex_shader,
     VulkanShader::VulkanTranslation* pixel_shader,
@@ -273,9 +1020,15 @@ bool VulkanPipelineCache::ConfigurePipeline(
 #endif  // XE_UI_VULKAN_FINE_GRAINED_DRAW_SCOPES
 
   // Ensure shaders are translated - needed now for GetCurrentStateDescription.
-  if (!EnsureShadersTranslated(vertex_shader, pixel_shader)) {
+  bool shaders_pending;
+  if (!EnsureShadersTranslated(vertex_shader, pixel_shader, shaders_pending)) {
     return false;
   }
+  if (shaders_pending) {
+    pipeline_out = VK_NULL_HANDLE;
+    pipeline_layout_out = nullptr;
+    return true;
+  }
 
   PipelineDescription description;
   if (!GetCurrentStateDescription(
@@ -284,20 +1037,87 @@ bool VulkanPipelineCache::ConfigurePipeline(
           description)) {
     return false;
   }
+  if (creation_pending_count_ ||
+      optimization_completed_count_.load(std::memory_order_relaxed)) {
+    CollectCreatedPipelines();
+  }
+  // With asynchronous creation, VK_NULL_HANDLE is returned for pipelines that
+  // are not ready yet, and the draw should be skipped.
   if (last_pipeline_ && last_pipeline_->first == description) {
-    pipeline_out = last_pipeline_->second.pipeline;
+    pipeline_out = last_pipeline_->second.creation_pending
+                       ? VK_NULL_HANDLE
+                       : last_pipeline_->second.pipeline;
     pipeline_layout_out = last_pipeline_->second.pipeline_layout;
     return true;
   }
   auto it = pipelines_.find(description);
   if (it != pipelines_.end()) {
     last_pipeline_ = &*it;
-    pipeline_out = it->second.pipeline;
+    pipeline_out = it->second.creation_pending ? VK_NULL_HANDLE
+                                               : it->second.pipeline;
     pipeline_layout_out = it->second.pipeline_layout;
     return true;
   }
 
   // Create the pipeline if not the latest and not already existing.
+  PipelineCreationArguments creation_arguments;
+  if (!PreparePipelineCreation(description, vertex_shader, pixel_shader,
+                               creation_arguments)) {
+    return false;
+  }
+  if (pipeline_storage_file_) {
+    assert_not_null(storage_write_thread_);
+    pipeline_storage_file_flush_needed_ = true;
+    {
+      std::lock_guard<std::mutex> lock(storage_write_request_lock_);
+      storage_write_pipeline_queue_.emplace_back();
+      PipelineStoredDescription& stored_description =
+          storage_write_pipeline_queue_.back();
+      stored_description.description_hash = description.GetHash();
+      std::memcpy(&stored_description.description, &description,
+                  sizeof(description));
+    }
+    storage_write_request_cond_.notify_all();
+  }
+  if (async_pipeline_creation_) {
+    creation_arguments.pipeline->second.creation_pending = true;
+    ++creation_pending_count_;
+    size_t creation_queue_depth;
+    {
+      std::lock_guard<std::mutex> lock(creation_request_lock_);
+      creation_queue_.push_back(creation_arguments);
+      creation_queue_depth = creation_queue_.size();
+    }
+    creation_request_cond_.notify_one();
+    creation_queue_max_depth_ =
+        std::max(creation_queue_max_depth_, creation_queue_depth);
+    COUNT_profile_set("gpu/pipeline_cache/creation_queue",
+                      creation_queue_depth);
+    last_pipeline_ = creation_arguments.pipeline;
+    pipeline_out = VK_NULL_HANDLE;
+    pipeline_layout_out = creation_arguments.pipeline->second.pipeline_layout;
+    return true;
+  }
+  {
+    frame_timeline::ScopedActivity frame_timeline_activity(
+        frame_timeline::Activity::kPipelineCreation);
+    if (use_graphics_pipeline_library_
+            ? !EnsurePipelineFastLinked(creation_arguments)
+            : !EnsurePipelineCreated(creation_arguments)) {
+      return false;
+    }
+  }
+  last_pipeline_ = creation_arguments.pipeline;
+  pipeline_out = creation_arguments.pipeline->second.pipeline;
+  pipeline_layout_out = creation_arguments.pipeline->second.pipeline_layout;
+  return true;
+}
+
+bool VulkanPipelineCache::PreparePipelineCreation(
+    const PipelineDescription& description,
+    const VulkanShader::VulkanTranslation* vertex_shader,
+    const VulkanShader::VulkanTranslation* pixel_shader,
+    PipelineCreationArguments& creation_arguments_out) {
   const PipelineLayoutProvider* pipeline_layout =
       command_processor_.GetPipelineLayout(
           pixel_shader
@@ -337,26 +1157,31 @@ bool VulkanPipelineCache::ConfigurePipeline(
               RenderTargetCache::Path::kPixelShaderInterlock
           ? render_target_cache_.GetFragmentShaderInterlockRenderPass()
           : render_target_cache_.GetHostRenderTargetsRenderPass(
-                render_pass_key);
+                description.render_pass_key);
   if (render_pass == VK_NULL_HANDLE) {
     return false;
   }
-  PipelineCreationArguments creation_arguments;
   auto& pipeline =
       *pipelines_.emplace(description, Pipeline(pipeline_layout)).first;
-  creation_arguments.pipeline = &pipeline;
-  creation_arguments.vertex_shader = vertex_shader;
-  creation_arguments.pixel_shader = pixel_shader;
-  creation_arguments.geometry_shader = geometry_shader;
-  creation_arguments.render_pass = render_pass;
-  if (!EnsurePipelineCreated(creation_arguments)) {
-    return false;
-  }
-  pipeline_out = pipeline.second.pipeline;
-  pipeline_layout_out = pipeline_layout;
+  creation_arguments_out.pipeline = &pipeline;
+  creation_arguments_out.vertex_shader = vertex_shader;
+  creation_arguments_out.pixel_shader = pixel_shader;
+  creation_arguments_out.geometry_shader = geometry_shader;
+  creation_arguments_out.render_pass = render_pass;
   return true;
 }
 
+std::unique_ptr<SpirvShaderTranslator>
+VulkanPipelineCache::CreateShaderTranslator() const {
+  return std::make_unique<SpirvShaderTranslator>(
+      SpirvShaderTranslator::Features(
+          command_processor_.GetVulkanProvider().device_info()),
+      render_target_cache_.msaa_2x_attachments_supported(),
+      render_target_cache_.msaa_2x_no_attachments_supported(),
+      render_target_cache_.GetPath() ==
+          RenderTargetCache::Path::kPixelShaderInterlock);
+}
+
 bool VulkanPipelineCache::TranslateAnalyzedShader(
     SpirvShaderTranslator& translator,
     VulkanShader::VulkanTranslation& translation) {
@@ -369,6 +1194,9 @@ bool VulkanPipelineCache::TranslateAnalyzedShader(
            shader.ucode_data_hash());
     return false;
   }
+  if (spirv_optimizer_available_) {
+    OptimizeTranslatedShader(translation);
+  }
   if (translation.GetOrCreateShaderModule() == VK_NULL_HANDLE) {
     return false;
   }
@@ -378,6 +1206,9 @@ bool VulkanPipelineCache::TranslateAnalyzedShader(
 
   // Set up the texture binding layout.
   if (shader.EnterBindingLayoutUserUIDSetup()) {
+    // Translations of different shaders may be done in parallel when loading
+    // the shader storage.
+    std::lock_guard<std::mutex> layouts_lock(layouts_mutex_);
     // Obtain the unique IDs of the binding layout if there are any texture
     // bindings, for invalidation in the command processor.
     size_t texture_binding_layout_uid = kLayoutUIDEmpty;
@@ -1864,12 +2695,9 @@ VkShaderModule VulkanPipelineCache::GetGeometryShader(GeometryShaderKey key) {
   return shader_module;
 }
 
-bool VulkanPipelineCache::EnsurePipelineCreated(
-    const PipelineCreationArguments& creation_arguments) {
-  if (creation_arguments.pipeline->second.pipeline != VK_NULL_HANDLE) {
-    return true;
-  }
-
+bool VulkanPipelineCache::GetPipelineCreateInfo(
+    const PipelineCreationArguments& creation_arguments,
+    PipelineCreateInfo& info_out) const {
   // This function preferably should validate the description to prevent
   // unsupported behavior that may be dangerous/crashing because pipelines can
   // be created from the disk storage.
@@ -1901,7 +2729,8 @@ bool VulkanPipelineCache::EnsurePipelineCreated(
       render_target_cache_.GetPath() ==
       RenderTargetCache::Path::kPixelShaderInterlock;
 
-  std::array<VkPipelineShaderStageCreateInfo, 3> shader_stages;
+  std::array<VkPipelineShaderStageCreateInfo, 3>& shader_stages =
+      info_out.shader_stages;
   uint32_t shader_stage_count = 0;
 
   // Vertex or tessellation evaluation shader.
@@ -1962,11 +2791,14 @@ bool VulkanPipelineCache::EnsurePipelineCreated(
     --shader_stage_count;
   }
 
-  VkPipelineVertexInputStateCreateInfo vertex_input_state = {};
+  VkPipelineVertexInputStateCreateInfo& vertex_input_state =
+      info_out.vertex_input_state;
+  vertex_input_state = {};
   vertex_input_state.sType =
       VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
 
-  VkPipelineInputAssemblyStateCreateInfo input_assembly_state;
+  VkPipelineInputAssemblyStateCreateInfo& input_assembly_state =
+      info_out.input_assembly_state;
   input_assembly_state.sType =
       VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
   input_assembly_state.pNext = nullptr;
@@ -2024,7 +2856,7 @@ bool VulkanPipelineCache::EnsurePipelineCreated(
   input_assembly_state.primitiveRestartEnable =
       description.primitive_restart ? VK_TRUE : VK_FALSE;
 
-  VkPipelineViewportStateCreateInfo viewport_state;
+  VkPipelineViewportStateCreateInfo& viewport_state = info_out.viewport_state;
   viewport_state.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
   viewport_state.pNext = nullptr;
   viewport_state.flags = 0;
@@ -2033,7 +2865,9 @@ bool VulkanPipelineCache::EnsurePipelineCreated(
   viewport_state.scissorCount = 1;
   viewport_state.pScissors = nullptr;
 
-  VkPipelineRasterizationStateCreateInfo rasterization_state = {};
+  VkPipelineRasterizationStateCreateInfo& rasterization_state =
+      info_out.rasterization_state;
+  rasterization_state = {};
   rasterization_state.sType =
       VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
   rasterization_state.depthClampEnable =
@@ -2075,8 +2909,11 @@ bool VulkanPipelineCache::EnsurePipelineCreated(
   // TODO(Triang3l): Wide lines.
   rasterization_state.lineWidth = 1.0f;
 
-  VkSampleMask sample_mask = UINT32_MAX;
-  VkPipelineMultisampleStateCreateInfo multisample_state = {};
+  VkSampleMask& sample_mask = info_out.sample_mask;
+  sample_mask = UINT32_MAX;
+  VkPipelineMultisampleStateCreateInfo& multisample_state =
+      info_out.multisample_state;
+  multisample_state = {};
   multisample_state.sType =
       VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
   if (description.render_pass_key.msaa_samples == xenos::MsaaSamples::k2X &&
@@ -2096,7 +2933,9 @@ bool VulkanPipelineCache::EnsurePipelineCreated(
         uint32_t(1) << uint32_t(description.render_pass_key.msaa_samples));
   }
 
-  VkPipelineDepthStencilStateCreateInfo depth_stencil_state = {};
+  VkPipelineDepthStencilStateCreateInfo& depth_stencil_state =
+      info_out.depth_stencil_state;
+  depth_stencil_state = {};
   depth_stencil_state.sType =
       VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
   depth_stencil_state.pNext = nullptr;
@@ -2139,11 +2978,15 @@ bool VulkanPipelineCache::EnsurePipelineCreated(
     }
   }
 
-  VkPipelineColorBlendStateCreateInfo color_blend_state = {};
+  VkPipelineColorBlendStateCreateInfo& color_blend_state =
+      info_out.color_blend_state;
+  color_blend_state = {};
   color_blend_state.sType =
       VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
-  VkPipelineColorBlendAttachmentState
-      color_blend_attachments[xenos::kMaxColorRenderTargets] = {};
+  VkPipelineColorBlendAttachmentState* color_blend_attachments =
+      info_out.color_blend_attachments;
+  std::memset(color_blend_attachments, 0,
+              sizeof(info_out.color_blend_attachments));
   if (!edram_fragment_shader_interlock) {
     uint32_t color_rts_used =
         description.render_pass_key.depth_and_color_used >> 1;
@@ -2228,8 +3071,8 @@ bool VulkanPipelineCache::EnsurePipelineCreated(
     }
   }
 
-  std::array<VkDynamicState, 7> dynamic_states;
-  VkPipelineDynamicStateCreateInfo dynamic_state;
+  std::array<VkDynamicState, 7>& dynamic_states = info_out.dynamic_states;
+  VkPipelineDynamicStateCreateInfo& dynamic_state = info_out.dynamic_state;
   dynamic_state.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
   dynamic_state.pNext = nullptr;
   dynamic_state.flags = 0;
@@ -2254,7 +3097,7 @@ bool VulkanPipelineCache::EnsurePipelineCreated(
         VK_DYNAMIC_STATE_STENCIL_REFERENCE;
   }
 
-  VkGraphicsPipelineCreateInfo pipeline_create_info;
+  VkGraphicsPipelineCreateInfo& pipeline_create_info = info_out.create_info;
   pipeline_create_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
   pipeline_create_info.pNext = nullptr;
   pipeline_create_info.flags = 0;
@@ -2275,12 +3118,27 @@ bool VulkanPipelineCache::EnsurePipelineCreated(
   pipeline_create_info.subpass = 0;
   pipeline_create_info.basePipelineHandle = VK_NULL_HANDLE;
   pipeline_create_info.basePipelineIndex = -1;
+  return true;
+}
+
+bool VulkanPipelineCache::EnsurePipelineCreated(
+    const PipelineCreationArguments& creation_arguments) {
+  if (creation_arguments.pipeline->second.pipeline != VK_NULL_HANDLE) {
+    return true;
+  }
+
+  PipelineCreateInfo info;
+  if (!GetPipelineCreateInfo(creation_arguments, info)) {
+    return false;
+  }
 
+  const ui::vulkan::VulkanProvider& provider =
+      command_processor_.GetVulkanProvider();
   const ui::vulkan::VulkanProvider::DeviceFunctions& dfn = provider.dfn();
   VkDevice device = provider.device();
   VkPipeline pipeline;
-  if (dfn.vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1,
-                                    &pipeline_create_info, nullptr,
+  if (dfn.vkCreateGraphicsPipelines(device, vk_pipeline_cache_, 1,
+                                    &info.create_info, nullptr,
                                     &pipeline) != VK_SUCCESS) {
     // TODO(Triang3l): Move these error messages outside.
     /* if (creation_arguments.pixel_shader) {
@@ -2298,6 +3156,658 @@ bool VulkanPipelineCache::EnsurePipelineCreated(
   return true;
 }
 
+VulkanPipelineCache::PipelineDescription
+VulkanPipelineCache::GetPipelineLibraryDescription(
+    const PipelineDescription& description, PipelineLibraryPart part) {
+  PipelineDescription part_description;
+  switch (part) {
+    case PipelineLibraryPart::kVertexInputInterface:
+      part_description.primitive_topology = description.primitive_topology;
+      part_description.primitive_restart = description.primitive_restart;
+      break;
+    case PipelineLibraryPart::kPreRasterizationShaders:
+      part_description.vertex_shader_hash = description.vertex_shader_hash;
+      part_description.vertex_shader_modification =
+          description.vertex_shader_modification;
+      part_description.geometry_shader = description.geometry_shader;
+      // The geometry shader also depends on the pixel shader modification.
+      if (description.geometry_shader != PipelineGeometryShader::kNone) {
+        part_description.pixel_shader_modification =
+            description.pixel_shader_modification;
+      }
+      // Also whether depth bias is enabled depends on the render pass.
+      part_description.render_pass_key = description.render_pass_key;
+      part_description.depth_clamp_enable = description.depth_clamp_enable;
+      part_description.polygon_mode = description.polygon_mode;
+      part_description.cull_front = description.cull_front;
+      part_description.cull_back = description.cull_back;
+      part_description.front_face_clockwise = description.front_face_clockwise;
+      break;
+    case PipelineLibraryPart::kFragmentShader:
+      part_description.pixel_shader_hash = description.pixel_shader_hash;
+      part_description.pixel_shader_modification =
+          description.pixel_shader_modification;
+      part_description.render_pass_key = description.render_pass_key;
+      part_description.depth_write_enable = description.depth_write_enable;
+      part_description.depth_compare_op = description.depth_compare_op;
+      part_description.stencil_test_enable = description.stencil_test_enable;
+      part_description.stencil_front_fail_op =
+          description.stencil_front_fail_op;
+      part_description.stencil_front_pass_op =
+          description.stencil_front_pass_op;
+      part_description.stencil_front_depth_fail_op =
+          description.stencil_front_depth_fail_op;
+      part_description.stencil_front_compare_op =
+          description.stencil_front_compare_op;
+      part_description.stencil_back_fail_op = description.stencil_back_fail_op;
+      part_description.stencil_back_pass_op = description.stencil_back_pass_op;
+      part_description.stencil_back_depth_fail_op =
+          description.stencil_back_depth_fail_op;
+      part_description.stencil_back_compare_op =
+          description.stencil_back_compare_op;
+      break;
+    case PipelineLibraryPart::kFragmentOutputInterface:
+      part_description.render_pass_key = description.render_pass_key;
+      std::memcpy(part_description.render_targets, description.render_targets,
+                  sizeof(description.render_targets));
+      break;
+    default:
+      assert_unhandled_case(part);
+      break;
+  }
+  return part_description;
+}
+
+VkPipeline VulkanPipelineCache::GetPipelineLibrary(
+    const PipelineCreationArguments& creation_arguments,
+    const PipelineCreateInfo& info, PipelineLibraryPart part) {
+  PipelineLibraryKey key;
+  key.description =
+      GetPipelineLibraryDescription(creation_arguments.pipeline->first, part);
+  key.pipeline_layout = creation_arguments.pipeline->second.pipeline_layout;
+  key.part = part;
+  {
+    std::lock_guard<std::mutex> lock(pipeline_libraries_mutex_);
+    auto it = pipeline_libraries_.find(key);
+    if (it != pipeline_libraries_.end()) {
+      return it->second;
+    }
+  }
+
+  VkGraphicsPipelineLibraryCreateInfoEXT library_create_info;
+  library_create_info.sType =
+      VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_LIBRARY_CREATE_INFO_EXT;
+  library_create_info.pNext = nullptr;
+  library_create_info.flags = VkGraphicsPipelineLibraryFlagsEXT(1)
+                              << uint32_t(part);
+
+  // Taking only the state of the part from the whole pipeline create info.
+  const VkGraphicsPipelineCreateInfo& pipeline_create_info = info.create_info;
+  VkGraphicsPipelineCreateInfo create_info = {};
+  create_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+  create_info.pNext = &library_create_info;
+  // Allowing the optimized pipelines to be linked from the libraries.
+  create_info.flags =
+      VK_PIPELINE_CREATE_LIBRARY_BIT_KHR |
+      VK_PIPELINE_CREATE_RETAIN_LINK_TIME_OPTIMIZATION_INFO_BIT_EXT;
+  VkShaderStageFlags part_shader_stages = 0;
+  switch (part) {
+    case PipelineLibraryPart::kVertexInputInterface:
+      create_info.pVertexInputState = pipeline_create_info.pVertexInputState;
+      create_info.pInputAssemblyState =
+          pipeline_create_info.pInputAssemblyState;
+      break;
+    case PipelineLibraryPart::kPreRasterizationShaders:
+      part_shader_stages =
+          VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_GEOMETRY_BIT;
+      create_info.pTessellationState = pipeline_create_info.pTessellationState;
+      create_info.pViewportState = pipeline_create_info.pViewportState;
+      create_info.pRasterizationState =
+          pipeline_create_info.pRasterizationState;
+      break;
+    case PipelineLibraryPart::kFragmentShader:
+      part_shader_stages = VK_SHADER_STAGE_FRAGMENT_BIT;
+      create_info.pMultisampleState = pipeline_create_info.pMultisampleState;
+      create_info.pDepthStencilState = pipeline_create_info.pDepthStencilState;
+      break;
+    case PipelineLibraryPart::kFragmentOutputInterface:
+      create_info.pMultisampleState = pipeline_create_info.pMultisampleState;
+      create_info.pColorBlendState = pipeline_create_info.pColorBlendState;
+      break;
+    default:
+      assert_unhandled_case(part);
+      return VK_NULL_HANDLE;
+  }
+  std::array<VkPipelineShaderStageCreateInfo, 3> shader_stages;
+  for (uint32_t i = 0; i < pipeline_create_info.stageCount; ++i) {
+    if (pipeline_create_info.pStages[i].stage & part_shader_stages) {
+      shader_stages[create_info.stageCount++] = pipeline_create_info.pStages[i];
+    }
+  }
+  create_info.pStages = shader_stages.data();
+  // The dynamic state not related to the part is ignored.
+  create_info.pDynamicState = pipeline_create_info.pDynamicState;
+  if (part != PipelineLibraryPart::kVertexInputInterface) {
+    create_info.layout = pipeline_create_info.layout;
+    create_info.renderPass = pipeline_create_info.renderPass;
+    create_info.subpass = pipeline_create_info.subpass;
+  }
+  create_info.basePipelineHandle = VK_NULL_HANDLE;
+  create_info.basePipelineIndex = -1;
+
+  const ui::vulkan::VulkanProvider& provider =
+      command_processor_.GetVulkanProvider();
+  const ui::vulkan::VulkanProvider::DeviceFunctions& dfn = provider.dfn();
+  VkDevice device = provider.device();
+  VkPipeline library;
+  if (dfn.vkCreateGraphicsPipelines(device, vk_pipeline_cache_, 1,
+                                    &create_info, nullptr,
+                                    &library) != VK_SUCCESS) {
+    return VK_NULL_HANDLE;
+  }
+  std::lock_guard<std::mutex> lock(pipeline_libraries_mutex_);
+  auto library_it = pipeline_libraries_.emplace(key, library);
+  if (!library_it.second) {
+    // Created on another creation thread in the meantime.
+    dfn.vkDestroyPipeline(device, library, nullptr);
+  }
+  return library_it.first->second;
+}
+
+VkPipeline VulkanPipelineCache::LinkPipelineLibraries(
+    const PipelineLibraries& libraries, VkPipelineLayout pipeline_layout,
+    bool optimize) const {
+  VkPipelineLibraryCreateInfoKHR library_info;
+  library_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LIBRARY_CREATE_INFO_KHR;
+  library_info.pNext = nullptr;
+  library_info.libraryCount = uint32_t(libraries.size());
+  library_info.pLibraries = libraries.data();
+
+  VkGraphicsPipelineCreateInfo create_info = {};
+  create_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+  create_info.pNext = &library_info;
+  create_info.flags =
+      optimize ? VK_PIPELINE_CREATE_LINK_TIME_OPTIMIZATION_BIT_EXT : 0;
+  create_info.layout = pipeline_layout;
+  create_info.basePipelineHandle = VK_NULL_HANDLE;
+  create_info.basePipelineIndex = -1;
+
+  const ui::vulkan::VulkanProvider& provider =
+      command_processor_.GetVulkanProvider();
+  VkPipeline pipeline;
+  if (provider.dfn().vkCreateGraphicsPipelines(
+          provider.device(), vk_pipeline_cache_, 1, &create_info, nullptr,
+          &pipeline) != VK_SUCCESS) {
+    return VK_NULL_HANDLE;
+  }
+  return pipeline;
+}
+
+bool VulkanPipelineCache::EnsurePipelineFastLinked(
+    const PipelineCreationArguments& creation_arguments) {
+  if (creation_arguments.pipeline->second.pipeline != VK_NULL_HANDLE) {
+    return true;
+  }
+
+  PipelineCreateInfo info;
+  if (!GetPipelineCreateInfo(creation_arguments, info)) {
+    return false;
+  }
+
+  PipelineOptimizationRequest optimization_request;
+  optimization_request.pipeline = creation_arguments.pipeline;
+  for (size_t i = 0; i < size_t(PipelineLibraryPart::kCount); ++i) {
+    VkPipeline library =
+        GetPipelineLibrary(creation_arguments, info, PipelineLibraryPart(i));
+    if (library == VK_NULL_HANDLE) {
+      return false;
+    }
+    optimization_request.libraries[i] = library;
+  }
+  VkPipeline pipeline = LinkPipelineLibraries(optimization_request.libraries,
+                                              info.create_info.layout, false);
+  if (pipeline == VK_NULL_HANDLE) {
+    return false;
+  }
+  creation_arguments.pipeline->second.pipeline = pipeline;
+
+  {
+    std::lock_guard<std::mutex> lock(creation_request_lock_);
+    optimization_queue_.push_back(optimization_request);
+  }
+  creation_request_cond_.notify_one();
+  return true;
+}
+
+void VulkanPipelineCache::LoadVkPipelineCache(
+    const std::filesystem::path& path) {
+  assert_true(vk_pipeline_cache_ == VK_NULL_HANDLE);
+
+  const ui::vulkan::VulkanProvider& provider =
+      command_processor_.GetVulkanProvider();
+  const ui::vulkan::VulkanProvider::DeviceFunctions& dfn = provider.dfn();
+  VkDevice device = provider.device();
+  const ui::vulkan::VulkanProvider::DeviceInfo& device_info =
+      provider.device_info();
+
+  // A stale or foreign blob is only dropped, the pipelines will be compiled
+  // from scratch and the blob will be overwritten on shutdown.
+  std::vector<uint8_t> initial_data;
+  FILE* file = xe::filesystem::OpenFile(path, "rb");
+  if (file) {
+    xe::filesystem::Seek(file, 0, SEEK_END);
+    int64_t file_size = xe::filesystem::Tell(file);
+    VkPipelineCacheHeaderVersionOne header;
+    if (file_size >= int64_t(sizeof(header)) &&
+        xe::filesystem::Seek(file, 0, SEEK_SET)) {
+      initial_data.resize(size_t(file_size));
+      if (!fread(initial_data.data(), initial_data.size(), 1, file)) {
+        initial_data.clear();
+      }
+    }
+    fclose(file);
+    if (!initial_data.empty()) {
+      std::memcpy(&header, initial_data.data(), sizeof(header));
+      if (header.headerSize < sizeof(header) ||
+          header.headerSize > initial_data.size() ||
+          header.headerVersion != VK_PIPELINE_CACHE_HEADER_VERSION_ONE ||
+          header.vendorID != device_info.vendorID ||
+          header.deviceID != device_info.deviceID ||
+          std::memcmp(header.pipelineCacheUUID, device_info.pipelineCacheUUID,
+                      VK_UUID_SIZE)) {
+        XELOGGPU("Ignoring the incompatible Vulkan pipeline cache {}",
+                 xe::path_to_utf8(path));
+        initial_data.clear();
+      }
+    }
+  }
+
+  VkPipelineCacheCreateInfo pipeline_cache_create_info;
+  pipeline_cache_create_info.sType =
+      VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+  pipeline_cache_create_info.pNext = nullptr;
+  pipeline_cache_create_info.flags = 0;
+  pipeline_cache_create_info.initialDataSize = initial_data.size();
+  pipeline_cache_create_info.pInitialData =
+      initial_data.empty() ? nullptr : initial_data.data();
+  if (dfn.vkCreatePipelineCache(device, &pipeline_cache_create_info, nullptr,
+                                &vk_pipeline_cache_) != VK_SUCCESS) {
+    // Try without the initial data in case it was rejected by the driver.
+    vk_pipeline_cache_ = VK_NULL_HANDLE;
+    pipeline_cache_create_info.initialDataSize = 0;
+    pipeline_cache_create_info.pInitialData = nullptr;
+    if (initial_data.empty() ||
+        dfn.vkCreatePipelineCache(device, &pipeline_cache_create_info, nullptr,
+                                  &vk_pipeline_cache_) != VK_SUCCESS) {
+      XELOGE("Failed to create the Vulkan pipeline cache");
+      vk_pipeline_cache_ = VK_NULL_HANDLE;
+      return;
+    }
+  }
+  vk_pipeline_cache_path_ = path;
+  XELOGGPU("Loaded {} bytes of the Vulkan pipeline cache",
+           initial_data.size());
+}
+
+void VulkanPipelineCache::SaveVkPipelineCache() {
+  if (vk_pipeline_cache_ == VK_NULL_HANDLE) {
+    return;
+  }
+
+  const ui::vulkan::VulkanProvider& provider =
+      command_processor_.GetVulkanProvider();
+  const ui::vulkan::VulkanProvider::DeviceFunctions& dfn = provider.dfn();
+  VkDevice device = provider.device();
+
+  std::vector<uint8_t> data;
+  size_t data_size = 0;
+  if (dfn.vkGetPipelineCacheData(device, vk_pipeline_cache_, &data_size,
+                                 nullptr) == VK_SUCCESS &&
+      data_size) {
+    data.resize(data_size);
+    if (dfn.vkGetPipelineCacheData(device, vk_pipeline_cache_, &data_size,
+                                   data.data()) != VK_SUCCESS) {
+      data.clear();
+    } else {
+      data.resize(data_size);
+    }
+  }
+  if (!data.empty()) {
+    std::filesystem::path directory = vk_pipeline_cache_path_.parent_path();
+    std::error_code error_code;
+    std::filesystem::create_directories(directory, error_code);
+    FILE* file = xe::filesystem::OpenFile(vk_pipeline_cache_path_, "wb");
+    if (file) {
+      fwrite(data.data(), data.size(), 1, file);
+      fclose(file);
+    } else {
+      XELOGE("Failed to open the Vulkan pipeline cache file for writing: {}",
+             xe::path_to_utf8(vk_pipeline_cache_path_));
+    }
+  }
+
+  ui::vulkan::util::DestroyAndNullHandle(dfn.vkDestroyPipelineCache, device,
+                                         vk_pipeline_cache_);
+  vk_pipeline_cache_path_.clear();
+}
+
+void VulkanPipelineCache::OptimizeTranslatedShader(
+    VulkanShader::VulkanTranslation& translation) {
+  const std::vector<uint8_t>& unoptimized = translation.translated_binary();
+  if (unoptimized.empty() || (unoptimized.size() & (sizeof(uint32_t) - 1))) {
+    return;
+  }
+  const uint32_t* unoptimized_words =
+      reinterpret_cast<const uint32_t*>(unoptimized.data());
+  size_t unoptimized_word_count = unoptimized.size() / sizeof(uint32_t);
+  uint64_t unoptimized_hash =
+      XXH3_64bits(unoptimized.data(), unoptimized.size());
+
+  std::vector<uint32_t> optimized;
+  {
+    std::lock_guard<std::mutex> lock(spirv_optimized_mutex_);
+    auto it = spirv_optimized_.find(unoptimized_hash);
+    if (it != spirv_optimized_.end() &&
+        it->second.unoptimized_word_count == unoptimized_word_count) {
+      optimized = it->second.optimized;
+    }
+  }
+
+  if (optimized.empty()) {
+    // Optimizing outside the lock, as this is the slow part, and it's done on
+    // multiple threads. If two threads optimize the same shader, the result is
+    // the same, and only one will be stored.
+    if (!spirv_tools_context_.Optimize(unoptimized_words,
+                                       unoptimized_word_count, optimized)) {
+      XELOGW(
+          "Failed to optimize the SPIR-V of shader {:016X}, using the "
+          "unoptimized translation",
+          translation.shader().ucode_data_hash());
+      return;
+    }
+    std::lock_guard<std::mutex> lock(spirv_optimized_mutex_);
+    auto emplaced = spirv_optimized_.emplace(
+        unoptimized_hash,
+        SpirvOptimized{uint32_t(unoptimized_word_count), optimized});
+    if (emplaced.second && spirv_optimized_storage_file_) {
+      SpirvOptimizedStoredHeader stored_header;
+      stored_header.unoptimized_hash = unoptimized_hash;
+      stored_header.unoptimized_word_count = uint32_t(unoptimized_word_count);
+      stored_header.optimized_word_count = uint32_t(optimized.size());
+      stored_header.optimized_hash =
+          XXH3_64bits(optimized.data(), sizeof(uint32_t) * optimized.size());
+      fwrite(&stored_header, sizeof(stored_header), 1,
+             spirv_optimized_storage_file_);
+      fwrite(optimized.data(), sizeof(uint32_t) * optimized.size(), 1,
+             spirv_optimized_storage_file_);
+      fflush(spirv_optimized_storage_file_);
+    }
+  }
+
+  std::vector<uint8_t> optimized_binary(sizeof(uint32_t) * optimized.size());
+  std::memcpy(optimized_binary.data(), optimized.data(),
+              optimized_binary.size());
+  translation.set_translated_binary(std::move(optimized_binary));
+}
+
+void VulkanPipelineCache::LoadSpirvOptimizedStorage(
+    const std::filesystem::path& path) {
+  ShutdownSpirvOptimizedStorage();
+
+  std::error_code error_code;
+  std::filesystem::create_directories(path.parent_path(), error_code);
+  spirv_optimized_storage_file_ = xe::filesystem::OpenFile(path, "a+b");
+  if (!spirv_optimized_storage_file_) {
+    XELOGE(
+        "Failed to open the optimized SPIR-V storage file for writing, "
+        "optimized shaders will not be stored: {}",
+        xe::path_to_utf8(path));
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(spirv_optimized_mutex_);
+  struct {
+    uint32_t magic;
+    uint32_t version;
+  } file_header;
+  // 'XESO'.
+  const uint32_t spirv_optimized_storage_magic = 0x4F534558;
+  if (fread(&file_header, sizeof(file_header), 1,
+            spirv_optimized_storage_file_) &&
+      file_header.magic == spirv_optimized_storage_magic &&
+      file_header.version == SpirvOptimizedStoredHeader::kVersion) {
+    uint64_t valid_bytes = sizeof(file_header);
+    SpirvOptimizedStoredHeader stored_header;
+    std::vector<uint32_t> optimized;
+    // Load until the end of the file or until a corrupted entry is detected.
+    while (fread(&stored_header, sizeof(stored_header), 1,
+                 spirv_optimized_storage_file_)) {
+      if (!stored_header.unoptimized_word_count ||
+          !stored_header.optimized_word_count) {
+        break;
+      }
+      optimized.resize(stored_header.optimized_word_count);
+      if (!fread(optimized.data(), sizeof(uint32_t) * optimized.size(), 1,
+                 spirv_optimized_storage_file_) ||
+          XXH3_64bits(optimized.data(), sizeof(uint32_t) * optimized.size()) !=
+              stored_header.optimized_hash) {
+        break;
+      }
+      spirv_optimized_.emplace(
+          stored_header.unoptimized_hash,
+          SpirvOptimized{stored_header.unoptimized_word_count, optimized});
+      valid_bytes +=
+          sizeof(stored_header) + sizeof(uint32_t) * optimized.size();
+    }
+    // Drop the corrupted tail so new entries are appended after valid data.
+    xe::filesystem::TruncateStdioFile(spirv_optimized_storage_file_,
+                                      valid_bytes);
+    XELOGGPU("Loaded {} optimized SPIR-V shaders", spirv_optimized_.size());
+  } else {
+    xe::filesystem::TruncateStdioFile(spirv_optimized_storage_file_, 0);
+    file_header.magic = spirv_optimized_storage_magic;
+    file_header.version = SpirvOptimizedStoredHeader::kVersion;
+    fwrite(&file_header, sizeof(file_header), 1,
+           spirv_optimized_storage_file_);
+  }
+}
+
+void VulkanPipelineCache::ShutdownSpirvOptimizedStorage() {
+  std::lock_guard<std::mutex> lock(spirv_optimized_mutex_);
+  if (spirv_optimized_storage_file_) {
+    fclose(spirv_optimized_storage_file_);
+    spirv_optimized_storage_file_ = nullptr;
+  }
+  spirv_optimized_.clear();
+}
+
+void VulkanPipelineCache::StorageWriteThread() {
+  ShaderStoredHeader shader_header;
+  // Don't leak anything in unused bits.
+  std::memset(&shader_header, 0, sizeof(shader_header));
+
+  // The header followed by the ucode.
+  static_assert(sizeof(shader_header) % sizeof(uint32_t) == 0);
+  constexpr size_t kShaderHeaderDwordCount =
+      sizeof(shader_header) / sizeof(uint32_t);
+  std::vector<uint32_t> shader_record;
+  shader_record.reserve(kShaderHeaderDwordCount + 0xFFFF);
+
+  bool flush_shaders = false;
+  bool flush_pipelines = false;
+
+  while (true) {
+    if (flush_shaders) {
+      flush_shaders = false;
+      assert_not_null(shader_storage_file_);
+      fflush(shader_storage_file_);
+    }
+    if (flush_pipelines) {
+      flush_pipelines = false;
+      assert_not_null(pipeline_storage_file_);
+      fflush(pipeline_storage_file_);
+    }
+
+    const Shader* shader = nullptr;
+    PipelineStoredDescription pipeline_description;
+    bool write_pipeline = false;
+    {
+      std::unique_lock<std::mutex> lock(storage_write_request_lock_);
+      if (storage_write_thread_shutdown_) {
+        return;
+      }
+      if (!storage_write_shader_queue_.empty()) {
+        shader = storage_write_shader_queue_.front();
+        storage_write_shader_queue_.pop_front();
+      } else if (storage_write_flush_shaders_) {
+        storage_write_flush_shaders_ = false;
+        flush_shaders = true;
+      }
+      if (!storage_write_pipeline_queue_.empty()) {
+        std::memcpy(&pipeline_description,
+                    &storage_write_pipeline_queue_.front(),
+                    sizeof(pipeline_description));
+        storage_write_pipeline_queue_.pop_front();
+        write_pipeline = true;
+      } else if (storage_write_flush_pipelines_) {
+        storage_write_flush_pipelines_ = false;
+        flush_pipelines = true;
+      }
+      if (!shader && !write_pipeline) {
+        storage_write_request_cond_.wait(lock);
+        continue;
+      }
+    }
+
+    if (shader) {
+      shader_header.ucode_data_hash = shader->ucode_data_hash();
+      shader_header.ucode_dword_count = shader->ucode_dword_count();
+      shader_header.type = shader->type();
+      shader_record.resize(kShaderHeaderDwordCount +
+                           shader_header.ucode_dword_count);
+      std::memcpy(shader_record.data(), &shader_header, sizeof(shader_header));
+      // Need to swap because the hash is calculated for the shader with guest
+      // endianness.
+      xe::copy_and_swap(shader_record.data() + kShaderHeaderDwordCount,
+                        shader->ucode_dwords(),
+                        shader_header.ucode_dword_count);
+      // Whole records are appended at once, as other instances may be
+      // appending to the same file.
+      assert_not_null(shader_storage_file_);
+      xe::filesystem::AppendToStdioFile(
+          shader_storage_file_, shader_record.data(),
+          sizeof(uint32_t) * shader_record.size());
+    }
+
+    if (write_pipeline) {
+      assert_not_null(pipeline_storage_file_);
+      xe::filesystem::AppendToStdioFile(pipeline_storage_file_,
+                                        &pipeline_description,
+                                        sizeof(pipeline_description));
+    }
+  }
+}
+
+void VulkanPipelineCache::CreationThread() {
+  // Created when the first shader is translated on this thread.
+  std::unique_ptr<SpirvShaderTranslator> translator;
+
+  while (true) {
+    PipelineCreationArguments creation_arguments;
+    creation_arguments.pipeline = nullptr;
+    VulkanShader::VulkanTranslation* translation_to_do = nullptr;
+    PipelineOptimizationRequest optimization_request;
+    optimization_request.pipeline = nullptr;
+    {
+      std::unique_lock<std::mutex> lock(creation_request_lock_);
+      if (creation_threads_shutdown_) {
+        return;
+      }
+      if (!translation_queue_.empty()) {
+        translation_to_do = translation_queue_.front();
+        translation_queue_.pop_front();
+      } else if (!creation_queue_.empty()) {
+        creation_arguments = creation_queue_.front();
+        creation_queue_.pop_front();
+      } else if (!optimization_queue_.empty()) {
+        optimization_request = optimization_queue_.front();
+        optimization_queue_.pop_front();
+      } else {
+        creation_request_cond_.wait(lock);
+        continue;
+      }
+    }
+    if (translation_to_do) {
+      if (!translator) {
+        translator = CreateShaderTranslator();
+      }
+      // If failed, the translation is left invalid and will be ignored.
+      TranslateAnalyzedShader(*translator, *translation_to_do);
+      bool notify_completion;
+      {
+        std::lock_guard<std::mutex> lock(creation_request_lock_);
+        translations_completed_.push_back(translation_to_do);
+        notify_completion = translation_completion_awaited_;
+      }
+      if (notify_completion) {
+        creation_request_cond_.notify_all();
+      }
+      continue;
+    }
+    if (optimization_request.pipeline) {
+      // If failed, the fast-linked pipeline stays in use.
+      VkPipeline optimized_pipeline = LinkPipelineLibraries(
+          optimization_request.libraries,
+          optimization_request.pipeline->second.pipeline_layout
+              ->GetPipelineLayout(),
+          true);
+      if (optimized_pipeline != VK_NULL_HANDLE) {
+        std::lock_guard<std::mutex> lock(creation_request_lock_);
+        optimization_completed_.push_back(
+            {optimization_request.pipeline, optimized_pipeline});
+        optimization_completed_count_.store(optimization_completed_.size(),
+                                            std::memory_order_relaxed);
+      }
+      continue;
+    }
+    // If failed, the pipeline stays VK_NULL_HANDLE, and draws with it will be
+    // skipped.
+    if (use_graphics_pipeline_library_) {
+      EnsurePipelineFastLinked(creation_arguments);
+    } else {
+      EnsurePipelineCreated(creation_arguments);
+    }
+    {
+      std::lock_guard<std::mutex> lock(creation_request_lock_);
+      creation_completed_.push_back(creation_arguments.pipeline);
+    }
+  }
+}
+
+void VulkanPipelineCache::CollectCreatedPipelines() {
+  std::lock_guard<std::mutex> lock(creation_request_lock_);
+  for (std::pair<const PipelineDescription, Pipeline>* pipeline :
+       creation_completed_) {
+    pipeline->second.creation_pending = false;
+  }
+  assert_true(creation_pending_count_ >= creation_completed_.size());
+  creation_pending_count_ -= creation_completed_.size();
+  creation_completed_.clear();
+  // The creation threads don't access the fast-linked pipelines after queueing
+  // their optimization.
+  for (const PipelineOptimized& optimized : optimization_completed_) {
+    Pipeline& pipeline = optimized.pipeline->second;
+    if (pipeline.pipeline != VK_NULL_HANDLE) {
+      // May still be used by the submissions not completed yet.
+      pipelines_replaced_.emplace_back(
+          command_processor_.GetCurrentSubmission(), pipeline.pipeline);
+    }
+    pipeline.pipeline = optimized.optimized_pipeline;
+  }
+  optimization_completed_.clear();
+  optimization_completed_count_.store(0, std::memory_order_relaxed);
+}
+
 }  // namespace vulkan
 }  // namespace gpu
 }  // namespace xe
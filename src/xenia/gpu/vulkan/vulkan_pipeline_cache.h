@@ -10,15 +10,25 @@
 #ifndef XENIA_GPU_VULKAN_VULKAN_PIPELINE_STATE_CACHE_H_
 #define XENIA_GPU_VULKAN_VULKAN_PIPELINE_STATE_CACHE_H_
 
+#include <array>
+#include <atomic>
+#include <condition_variable>
 #include <cstddef>
+#include <cstdio>
 #include <cstring>
+#include <deque>
+#include <filesystem>
 #include <functional>
 #include <memory>
+#include <mutex>
 #include <unordered_map>
+#include <unordered_set>
 #include <utility>
+#include <vector>
 
 #include "xenia/base/hash.h"
 #include "xenia/base/platform.h"
+#include "xenia/base/threading.h"
 #include "xenia/base/xxhash.h"
 #include "xenia/gpu/primitive_processor.h"
 #include "xenia/gpu/register_file.h"
@@ -27,6 +37,7 @@
 #include "xenia/gpu/vulkan/vulkan_render_target_cache.h"
 #include "xenia/gpu/vulkan/vulkan_shader.h"
 #include "xenia/gpu/xenos.h"
+#include "xenia/ui/vulkan/spirv_tools_context.h"
 #include "xenia/ui/vulkan/vulkan_provider.h"
 
 namespace xe {
@@ -59,6 +70,12 @@ class VulkanPipelineCache {
   bool Initialize();
   void Shutdown();
 
+  void InitializeShaderStorage(const std::filesystem::path& cache_root,
+                               uint32_t title_id, bool blocking);
+  void ShutdownShaderStorage();
+
+  void EndSubmission();
+
   VulkanShader* LoadShader(xenos::ShaderType shader_type,
                            const uint32_t* host_address, uint32_t dword_count);
   // Analyze shader microcode on the translator thread.
@@ -76,8 +93,12 @@ class VulkanPipelineCache {
       const Shader& shader, uint32_t interpolator_mask,
       uint32_t param_gen_pos) const;
 
+  // With asynchronous pipeline creation, the shaders may be queued for
+  // translation on the creation threads, in which case pending_out is set, and
+  // the draw must be skipped.
   bool EnsureShadersTranslated(VulkanShader::VulkanTranslation* vertex_shader,
-                               VulkanShader::VulkanTranslation* pixel_shader);
+                               VulkanShader::VulkanTranslation* pixel_shader,
+                               bool& pending_out);
   // TODO(Triang3l): Return a deferred creation handle.
   bool ConfigurePipeline(
       VulkanShader::VulkanTranslation* vertex_shader,
@@ -90,6 +111,17 @@ class VulkanPipelineCache {
       const PipelineLayoutProvider*& pipeline_layout_out);
 
  private:
+  // Same as in the Direct3D 12 pipeline cache, the guest shader storage files
+  // are shared between the backends.
+  XEPACKEDSTRUCT(ShaderStoredHeader, {
+    uint64_t ucode_data_hash;
+
+    uint32_t ucode_dword_count : 31;
+    xenos::ShaderType type : 1;
+
+    static constexpr uint32_t kVersion = 0x20201219;
+  });
+
   enum class PipelineGeometryShader : uint32_t {
     kNone,
     kPointList,
@@ -179,6 +211,8 @@ class VulkanPipelineCache {
     // Filled only for the attachments present in the render pass object.
     PipelineRenderTarget render_targets[xenos::kMaxColorRenderTargets];
 
+    static constexpr uint32_t kVersion = 0x20231014;
+
     // Including all the padding, for a stable hash.
     PipelineDescription() { Reset(); }
     PipelineDescription(const PipelineDescription& description) {
@@ -200,11 +234,21 @@ class VulkanPipelineCache {
     };
   });
 
+  XEPACKEDSTRUCT(PipelineStoredDescription, {
+    uint64_t description_hash;
+    PipelineDescription description;
+  });
+
   struct Pipeline {
+    // Must not be accessed on the command processor thread while
+    // creation_pending is true, it's written by a creation thread then.
     VkPipeline pipeline = VK_NULL_HANDLE;
     // The layouts are owned by the VulkanCommandProcessor, and must not be
     // destroyed by it while the pipeline cache is active.
     const PipelineLayoutProvider* pipeline_layout;
+    // Queued for asynchronous creation, and the result hasn't been collected on
+    // the command processor thread yet.
+    bool creation_pending = false;
     Pipeline(const PipelineLayoutProvider* pipeline_layout_provider)
         : pipeline_layout(pipeline_layout_provider) {}
   };
@@ -219,6 +263,83 @@ class VulkanPipelineCache {
     VkRenderPass render_pass;
   };
 
+  // Create info of a whole pipeline with all the structures it points to.
+  struct PipelineCreateInfo {
+    std::array<VkPipelineShaderStageCreateInfo, 3> shader_stages;
+    VkPipelineVertexInputStateCreateInfo vertex_input_state;
+    VkPipelineInputAssemblyStateCreateInfo input_assembly_state;
+    VkPipelineViewportStateCreateInfo viewport_state;
+    VkPipelineRasterizationStateCreateInfo rasterization_state;
+    VkSampleMask sample_mask;
+    VkPipelineMultisampleStateCreateInfo multisample_state;
+    VkPipelineDepthStencilStateCreateInfo depth_stencil_state;
+    VkPipelineColorBlendAttachmentState
+        color_blend_attachments[xenos::kMaxColorRenderTargets];
+    VkPipelineColorBlendStateCreateInfo color_blend_state;
+    std::array<VkDynamicState, 7> dynamic_states;
+    VkPipelineDynamicStateCreateInfo dynamic_state;
+    VkGraphicsPipelineCreateInfo create_info;
+
+    PipelineCreateInfo() = default;
+    // Contains pointers to itself.
+    PipelineCreateInfo(const PipelineCreateInfo& info) = delete;
+    PipelineCreateInfo& operator=(const PipelineCreateInfo& info) = delete;
+  };
+
+  // Parts of pipelines created once with VK_EXT_graphics_pipeline_library and
+  // shared by all pipelines using the same state of the part, in the order of
+  // the VkGraphicsPipelineLibraryFlagBitsEXT bits.
+  enum class PipelineLibraryPart : uint32_t {
+    kVertexInputInterface,
+    kPreRasterizationShaders,
+    kFragmentShader,
+    kFragmentOutputInterface,
+
+    kCount,
+  };
+  using PipelineLibraries =
+      std::array<VkPipeline, size_t(PipelineLibraryPart::kCount)>;
+
+  struct PipelineLibraryKey {
+    // With only the fields the part depends on, the rest are zero.
+    PipelineDescription description;
+    // The layouts depend on the bindings of both shaders, and linking requires
+    // the libraries to be created with compatible layouts.
+    const PipelineLayoutProvider* pipeline_layout;
+    PipelineLibraryPart part;
+
+    // Including all the padding, for a stable hash.
+    PipelineLibraryKey() {
+      std::memset(static_cast<void*>(this), 0, sizeof(*this));
+    }
+    PipelineLibraryKey(const PipelineLibraryKey& key) {
+      std::memcpy(static_cast<void*>(this), &key, sizeof(*this));
+    }
+    PipelineLibraryKey& operator=(const PipelineLibraryKey& key) {
+      std::memcpy(static_cast<void*>(this), &key, sizeof(*this));
+      return *this;
+    }
+    bool operator==(const PipelineLibraryKey& key) const {
+      return std::memcmp(this, &key, sizeof(*this)) == 0;
+    }
+    struct Hasher {
+      size_t operator()(const PipelineLibraryKey& key) const {
+        return size_t(XXH3_64bits(&key, sizeof(key)));
+      }
+    };
+  };
+
+  // Linking of a fast-linked pipeline again with link-time optimization on
+  // the creation threads.
+  struct PipelineOptimizationRequest {
+    std::pair<const PipelineDescription, Pipeline>* pipeline;
+    PipelineLibraries libraries;
+  };
+  struct PipelineOptimized {
+    std::pair<const PipelineDescription, Pipeline>* pipeline;
+    VkPipeline optimized_pipeline;
+  };
+
   union GeometryShaderKey {
     uint32_t key;
     struct {
@@ -246,9 +367,36 @@ class VulkanPipelineCache {
     }
   };
 
+  VulkanShader* LoadShader(xenos::ShaderType shader_type,
+                           const uint32_t* host_address, uint32_t dword_count,
+                           uint64_t data_hash);
+
+  // Creates a translator for the current configuration, for use on one
+  // thread.
+  std::unique_ptr<SpirvShaderTranslator> CreateShaderTranslator() const;
+
   // Can be called from multiple threads.
   bool TranslateAnalyzedShader(SpirvShaderTranslator& translator,
                                VulkanShader::VulkanTranslation& translation);
+  // Replaces the translated SPIR-V with the optimized one if the optimizer is
+  // enabled, taking it from the optimized SPIR-V storage if it has already been
+  // optimized previously. Can be called from multiple threads.
+  void OptimizeTranslatedShader(VulkanShader::VulkanTranslation& translation);
+
+  // Translates the shader on the processor thread if needed, or queues it for
+  // translation on the creation threads, setting pending_out - the translation
+  // must not be accessed then until it's collected. Returns false if the
+  // translation is not valid.
+  bool EnsureShaderTranslated(VulkanShader::VulkanTranslation& translation,
+                              bool& pending_out);
+  // Makes the translations done by the creation threads usable.
+  void CollectTranslatedShaders();
+  // Waits for all queued translations to be done and collects them.
+  void AwaitPendingTranslations();
+
+  // Queues the ucode for writing to the currently open storage if it hasn't
+  // been written to it yet.
+  void StoreShader(Shader& shader);
 
   void WritePipelineRenderTargetDescription(
       reg::RB_BLENDCONTROL blend_control, uint32_t write_mask,
@@ -275,9 +423,55 @@ class VulkanPipelineCache {
   // Can be called from creation threads - all needed data must be fully set up
   // at the point of the call: shaders must be translated, pipeline layout and
   // render pass objects must be available.
+  bool GetPipelineCreateInfo(
+      const PipelineCreationArguments& creation_arguments,
+      PipelineCreateInfo& info_out) const;
+  // Same requirements as for GetPipelineCreateInfo.
   bool EnsurePipelineCreated(
       const PipelineCreationArguments& creation_arguments);
 
+  // The fields of the description the part of the pipeline depends on.
+  static PipelineDescription GetPipelineLibraryDescription(
+      const PipelineDescription& description, PipelineLibraryPart part);
+  // Returns the existing library for the state of the part in the create info
+  // or creates it, can be called from creation threads.
+  VkPipeline GetPipelineLibrary(
+      const PipelineCreationArguments& creation_arguments,
+      const PipelineCreateInfo& info, PipelineLibraryPart part);
+  VkPipeline LinkPipelineLibraries(const PipelineLibraries& libraries,
+                                   VkPipelineLayout pipeline_layout,
+                                   bool optimize) const;
+  // With the graphics pipeline library, creates the pipeline by fast linking
+  // the libraries, and queues its optimization on the creation threads. Same
+  // requirements as for GetPipelineCreateInfo.
+  bool EnsurePipelineFastLinked(
+      const PipelineCreationArguments& creation_arguments);
+  // Looks up the objects needed for creating the pipeline for the description
+  // and adds the pipeline, not created yet, to pipelines_.
+  bool PreparePipelineCreation(
+      const PipelineDescription& description,
+      const VulkanShader::VulkanTranslation* vertex_shader,
+      const VulkanShader::VulkanTranslation* pixel_shader,
+      PipelineCreationArguments& creation_arguments_out);
+
+  // Host pipeline cache blob, only valid for the device and the driver it was
+  // created with.
+  void LoadVkPipelineCache(const std::filesystem::path& path);
+  void SaveVkPipelineCache();
+
+  // Optimized SPIR-V storage, depending on the version of SPIRV-Tools, so
+  // stored locally.
+  void LoadSpirvOptimizedStorage(const std::filesystem::path& path);
+  void ShutdownSpirvOptimizedStorage();
+
+  void StorageWriteThread();
+
+  // Asynchronous pipeline creation.
+  void CreationThread();
+  // Marks the pipelines the creation threads have finished as usable, and
+  // replaces the fast-linked pipelines with the optimized ones.
+  void CollectCreatedPipelines();
+
   VulkanCommandProcessor& command_processor_;
   const RegisterFile& register_file_;
   VulkanRenderTargetCache& render_target_cache_;
@@ -321,9 +515,109 @@ class VulkanPipelineCache {
   std::unordered_map<PipelineDescription, Pipeline, PipelineDescription::Hasher>
       pipelines_;
 
+  // VK_EXT_graphics_pipeline_library with fast linking is supported and
+  // enabled (vulkan_graphics_pipeline_library).
+  bool use_graphics_pipeline_library_ = false;
+  // Libraries are created and looked up on the creation threads too.
+  std::mutex pipeline_libraries_mutex_;
+  std::unordered_map<PipelineLibraryKey, VkPipeline,
+                     PipelineLibraryKey::Hasher>
+      pipeline_libraries_;
+  // Fast-linked pipelines replaced with the optimized ones, to be destroyed
+  // when the submission index is completed.
+  std::deque<std::pair<uint64_t, VkPipeline>> pipelines_replaced_;
+
   // Previously used pipeline, to avoid lookups if the state wasn't changed.
   const std::pair<const PipelineDescription, Pipeline>* last_pipeline_ =
       nullptr;
+
+  // Currently open shader storage path.
+  std::filesystem::path shader_storage_cache_root_;
+  uint32_t shader_storage_title_id_ = 0;
+
+  // Shader storage output stream, for preload in the next emulator runs.
+  FILE* shader_storage_file_ = nullptr;
+  // For only writing shaders to the currently open storage once, incremented
+  // when switching the storage.
+  uint32_t shader_storage_index_ = 0;
+  bool shader_storage_file_flush_needed_ = false;
+
+  // Pipeline storage output stream, for preload in the next emulator runs.
+  FILE* pipeline_storage_file_ = nullptr;
+  bool pipeline_storage_file_flush_needed_ = false;
+
+  // Used for creating all pipelines while the shader storage is open, and
+  // saved when it's closed.
+  VkPipelineCache vk_pipeline_cache_ = VK_NULL_HANDLE;
+  std::filesystem::path vk_pipeline_cache_path_;
+
+  // SPIR-V optimization (vulkan_spirv_optimize).
+  ui::vulkan::SpirvToolsContext spirv_tools_context_;
+  bool spirv_optimizer_available_ = false;
+  struct SpirvOptimizedStoredHeader {
+    uint64_t unoptimized_hash;
+    uint32_t unoptimized_word_count;
+    uint32_t optimized_word_count;
+    uint64_t optimized_hash;
+
+    static constexpr uint32_t kVersion = 0x1;
+  };
+  struct SpirvOptimized {
+    uint32_t unoptimized_word_count;
+    std::vector<uint32_t> optimized;
+  };
+  // Protected by spirv_optimized_mutex_, as shaders are translated on multiple
+  // threads.
+  std::mutex spirv_optimized_mutex_;
+  // Keyed by the hash of the unoptimized SPIR-V.
+  std::unordered_map<uint64_t, SpirvOptimized> spirv_optimized_;
+  FILE* spirv_optimized_storage_file_ = nullptr;
+
+  // Thread for asynchronous writing to the storage streams.
+  std::mutex storage_write_request_lock_;
+  std::condition_variable storage_write_request_cond_;
+  // Storage thread input is protected with storage_write_request_lock_, and the
+  // thread is notified about its change via storage_write_request_cond_.
+  std::deque<const Shader*> storage_write_shader_queue_;
+  std::deque<PipelineStoredDescription> storage_write_pipeline_queue_;
+  bool storage_write_flush_shaders_ = false;
+  bool storage_write_flush_pipelines_ = false;
+  bool storage_write_thread_shutdown_ = false;
+  std::unique_ptr<xe::threading::Thread> storage_write_thread_;
+
+  // Threads for asynchronous pipeline creation and pipeline optimization, only
+  // used if either is enabled.
+  bool async_pipeline_creation_ = false;
+  std::mutex creation_request_lock_;
+  std::condition_variable creation_request_cond_;
+  // Protected with creation_request_lock_.
+  std::deque<PipelineCreationArguments> creation_queue_;
+  std::vector<std::pair<const PipelineDescription, Pipeline>*>
+      creation_completed_;
+  // Taken only when there are no pipelines to create, as the fast-linked
+  // pipelines are already usable.
+  std::deque<PipelineOptimizationRequest> optimization_queue_;
+  std::vector<PipelineOptimized> optimization_completed_;
+  // Size of optimization_completed_, to check for the completed optimizations
+  // without locking.
+  std::atomic<size_t> optimization_completed_count_{0};
+  // Taken before the pipelines since draws are waiting for them.
+  std::deque<VulkanShader::VulkanTranslation*> translation_queue_;
+  std::vector<VulkanShader::VulkanTranslation*> translations_completed_;
+  // Whether the processor thread is waiting for the translations - if set,
+  // notify_all creation_request_cond_ when a translation is completed.
+  bool translation_completion_awaited_ = false;
+  bool creation_threads_shutdown_ = false;
+  // Pipelines with creation_pending, accessed only by the command processor
+  // thread.
+  size_t creation_pending_count_ = 0;
+  // Translations queued and not collected yet, accessed only by the command
+  // processor thread.
+  std::unordered_set<VulkanShader::VulkanTranslation*> translations_pending_;
+  // The deepest the queues have been, for tuning the creation thread count.
+  size_t translation_queue_max_depth_ = 0;
+  size_t creation_queue_max_depth_ = 0;
+  std::vector<std::unique_ptr<xe::threading::Thread>> creation_threads_;
 };
 
 }  // namespace vulkan
@@ -12,14 +12,22 @@
 #include <algorithm>
 #include <cstdint>
 #include <memory>
+#include <vector>
 
 #include "xenia/base/assert.h"
+#include "xenia/base/cvar.h"
 #include "xenia/base/logging.h"
+#include "xenia/base/math.h"
+#include "xenia/gpu/spirv_builder.h"
+#include "xenia/gpu/spirv_shader_translator.h"
 #include "xenia/gpu/vulkan/deferred_command_buffer.h"
 #include "xenia/gpu/vulkan/vulkan_command_processor.h"
+#include "xenia/gpu/vulkan/vulkan_shared_memory.h"
 #include "xenia/ui/vulkan/vulkan_provider.h"
 #include "xenia/ui/vulkan/vulkan_util.h"
 
+DECLARE_int32(primitive_processor_gpu_conversion_min_indices);
+
 namespace xe {
 namespace gpu {
 namespace vulkan {
@@ -36,12 +44,71 @@ bool VulkanPrimitiveProcessor::Initialize() {
     Shutdown();
     return false;
   }
+  const ui::vulkan::VulkanProvider& provider =
+      command_processor_.GetVulkanProvider();
+  // Storage buffer usage for writing the indices converted on the GPU.
   frame_index_buffer_pool_ =
       std::make_unique<ui::vulkan::VulkanUploadBufferPool>(
-          command_processor_.GetVulkanProvider(),
-          VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+          provider,
+          VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
           std::max(size_t(kMinRequiredConvertedIndexBufferSize),
                    ui::GraphicsUploadBufferPool::kDefaultPageSize));
+
+  if (cvars::primitive_processor_gpu_conversion_min_indices >= 0) {
+    // Failure to create the pipelines is not fatal, the conversion will be
+    // done on the CPU.
+    const ui::vulkan::VulkanProvider::DeviceFunctions& dfn = provider.dfn();
+    VkDevice device = provider.device();
+    VkDescriptorSetLayout descriptor_set_layout_storage_buffer =
+        command_processor_.GetSingleTransientDescriptorLayout(
+            VulkanCommandProcessor::SingleTransientDescriptorLayout ::
+                kStorageBufferCompute);
+    VkDescriptorSetLayout
+        gpu_conversion_descriptor_set_layouts[kGpuConversionDescriptorSetCount];
+    gpu_conversion_descriptor_set_layouts[kGpuConversionDescriptorSetSource] =
+        descriptor_set_layout_storage_buffer;
+    gpu_conversion_descriptor_set_layouts[kGpuConversionDescriptorSetDest] =
+        descriptor_set_layout_storage_buffer;
+    VkPushConstantRange gpu_conversion_push_constant_range;
+    gpu_conversion_push_constant_range.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    gpu_conversion_push_constant_range.offset = 0;
+    gpu_conversion_push_constant_range.size =
+        sizeof(uint32_t) * kGpuConversionPushConstantCount;
+    VkPipelineLayoutCreateInfo gpu_conversion_pipeline_layout_create_info;
+    gpu_conversion_pipeline_layout_create_info.sType =
+        VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    gpu_conversion_pipeline_layout_create_info.pNext = nullptr;
+    gpu_conversion_pipeline_layout_create_info.flags = 0;
+    gpu_conversion_pipeline_layout_create_info.setLayoutCount =
+        uint32_t(xe::countof(gpu_conversion_descriptor_set_layouts));
+    gpu_conversion_pipeline_layout_create_info.pSetLayouts =
+        gpu_conversion_descriptor_set_layouts;
+    gpu_conversion_pipeline_layout_create_info.pushConstantRangeCount = 1;
+    gpu_conversion_pipeline_layout_create_info.pPushConstantRanges =
+        &gpu_conversion_push_constant_range;
+    if (dfn.vkCreatePipelineLayout(
+            device, &gpu_conversion_pipeline_layout_create_info, nullptr,
+            &gpu_conversion_pipeline_layout_) == VK_SUCCESS) {
+      static const xenos::PrimitiveType
+          kGpuConversionPrimitiveTypes[kGpuConversionPrimitiveTypeCount] = {
+              xenos::PrimitiveType::kTriangleFan,
+              xenos::PrimitiveType::kLineLoop,
+              xenos::PrimitiveType::kQuadList,
+          };
+      for (size_t i = 0; i < kGpuConversionPrimitiveTypeCount; ++i) {
+        gpu_conversion_pipelines_[i][0] = CreateGpuConversionPipeline(
+            kGpuConversionPrimitiveTypes[i], xenos::IndexFormat::kInt16);
+        gpu_conversion_pipelines_[i][1] = CreateGpuConversionPipeline(
+            kGpuConversionPrimitiveTypes[i], xenos::IndexFormat::kInt32);
+      }
+    } else {
+      XELOGE(
+          "Vulkan primitive processor: Failed to create the GPU index "
+          "conversion pipeline layout");
+      gpu_conversion_pipeline_layout_ = VK_NULL_HANDLE;
+    }
+  }
+
   return true;
 }
 
@@ -51,6 +118,15 @@ void VulkanPrimitiveProcessor::Shutdown(bool from_destructor) {
   const ui::vulkan::VulkanProvider::DeviceFunctions& dfn = provider.dfn();
   VkDevice device = provider.device();
 
+  for (size_t i = 0; i < kGpuConversionPrimitiveTypeCount; ++i) {
+    for (size_t j = 0; j < 2; ++j) {
+      ui::vulkan::util::DestroyAndNullHandle(dfn.vkDestroyPipeline, device,
+                                             gpu_conversion_pipelines_[i][j]);
+    }
+  }
+  ui::vulkan::util::DestroyAndNullHandle(dfn.vkDestroyPipelineLayout, device,
+                                         gpu_conversion_pipeline_layout_);
+
   frame_index_buffers_.clear();
   frame_index_buffer_pool_.reset();
   ui::vulkan::util::DestroyAndNullHandle(dfn.vkDestroyBuffer, device,
@@ -219,6 +295,433 @@ void* VulkanPrimitiveProcessor::RequestHostConvertedIndexBufferForCurrentFrame(
   return mapping;
 }
 
+bool VulkanPrimitiveProcessor::ConvertSinglePrimitiveOnGpu(
+    xenos::PrimitiveType guest_primitive_type, xenos::IndexFormat format,
+    uint32_t guest_index_base, uint32_t guest_index_count,
+    uint32_t host_index_count, size_t& backend_handle_out) {
+  size_t primitive_type_index;
+  switch (guest_primitive_type) {
+    case xenos::PrimitiveType::kTriangleFan:
+      primitive_type_index = 0;
+      break;
+    case xenos::PrimitiveType::kLineLoop:
+      primitive_type_index = 1;
+      break;
+    case xenos::PrimitiveType::kQuadList:
+      primitive_type_index = 2;
+      break;
+    default:
+      return false;
+  }
+  bool format_is_32bit = format == xenos::IndexFormat::kInt32;
+  VkPipeline pipeline =
+      gpu_conversion_pipelines_[primitive_type_index][size_t(format_is_32bit)];
+  if (pipeline == VK_NULL_HANDLE) {
+    return false;
+  }
+
+  uint32_t index_size_log2 = format_is_32bit ? 2 : 1;
+  uint32_t guest_index_buffer_size = guest_index_count << index_size_log2;
+  if (!shared_memory().RequestRange(guest_index_base,
+                                    guest_index_buffer_size)) {
+    return false;
+  }
+
+  const ui::vulkan::VulkanProvider& provider =
+      command_processor_.GetVulkanProvider();
+  const ui::vulkan::VulkanProvider::DeviceFunctions& dfn = provider.dfn();
+  VkDevice device = provider.device();
+  VkDeviceSize storage_buffer_offset_alignment =
+      std::max(provider.device_info().minStorageBufferOffsetAlignment,
+               VkDeviceSize(sizeof(uint32_t)));
+
+  // Each invocation writes a whole 32-bit word, which may contain two 16-bit
+  // indices.
+  uint32_t dest_word_count =
+      format_is_32bit ? host_index_count : (host_index_count + 1) >> 1;
+  VkDeviceSize dest_size = VkDeviceSize(sizeof(uint32_t)) * dest_word_count;
+  VkBuffer dest_buffer;
+  VkDeviceSize dest_offset;
+  if (!frame_index_buffer_pool_->Request(
+          command_processor_.GetCurrentFrame(), size_t(dest_size),
+          size_t(storage_buffer_offset_alignment), dest_buffer, dest_offset)) {
+    return false;
+  }
+
+  VkDescriptorSet descriptor_sets[kGpuConversionDescriptorSetCount];
+  for (size_t i = 0; i < kGpuConversionDescriptorSetCount; ++i) {
+    descriptor_sets[i] = command_processor_.AllocateSingleTransientDescriptor(
+        VulkanCommandProcessor::SingleTransientDescriptorLayout ::
+            kStorageBufferCompute);
+    if (descriptor_sets[i] == VK_NULL_HANDLE) {
+      return false;
+    }
+  }
+  VulkanSharedMemory& vulkan_shared_memory =
+      static_cast<VulkanSharedMemory&>(shared_memory());
+  VkDescriptorBufferInfo
+      write_descriptor_set_buffer_infos[kGpuConversionDescriptorSetCount];
+  VkDescriptorBufferInfo& write_descriptor_set_source_buffer_info =
+      write_descriptor_set_buffer_infos[kGpuConversionDescriptorSetSource];
+  write_descriptor_set_source_buffer_info.buffer =
+      vulkan_shared_memory.buffer();
+  write_descriptor_set_source_buffer_info.offset =
+      VkDeviceSize(guest_index_base) -
+      VkDeviceSize(guest_index_base) % storage_buffer_offset_alignment;
+  write_descriptor_set_source_buffer_info.range =
+      xe::align(VkDeviceSize(guest_index_base + guest_index_buffer_size),
+                VkDeviceSize(sizeof(uint32_t))) -
+      write_descriptor_set_source_buffer_info.offset;
+  VkDescriptorBufferInfo& write_descriptor_set_dest_buffer_info =
+      write_descriptor_set_buffer_infos[kGpuConversionDescriptorSetDest];
+  write_descriptor_set_dest_buffer_info.buffer = dest_buffer;
+  write_descriptor_set_dest_buffer_info.offset = dest_offset;
+  write_descriptor_set_dest_buffer_info.range = dest_size;
+  VkWriteDescriptorSet write_descriptor_sets[kGpuConversionDescriptorSetCount];
+  for (size_t i = 0; i < kGpuConversionDescriptorSetCount; ++i) {
+    VkWriteDescriptorSet& write_descriptor_set = write_descriptor_sets[i];
+    write_descriptor_set.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write_descriptor_set.pNext = nullptr;
+    write_descriptor_set.dstSet = descriptor_sets[i];
+    write_descriptor_set.dstBinding = 0;
+    write_descriptor_set.dstArrayElement = 0;
+    write_descriptor_set.descriptorCount = 1;
+    write_descriptor_set.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    write_descriptor_set.pImageInfo = nullptr;
+    write_descriptor_set.pBufferInfo = &write_descriptor_set_buffer_infos[i];
+    write_descriptor_set.pTexelBufferView = nullptr;
+  }
+  dfn.vkUpdateDescriptorSets(device,
+                             uint32_t(xe::countof(write_descriptor_sets)),
+                             write_descriptor_sets, 0, nullptr);
+
+  vulkan_shared_memory.Use(VulkanSharedMemory::Usage::kRead);
+
+  DeferredCommandBuffer& command_buffer =
+      command_processor_.deferred_command_buffer();
+  command_processor_.BindExternalComputePipeline(pipeline);
+  command_buffer.CmdVkBindDescriptorSets(
+      VK_PIPELINE_BIND_POINT_COMPUTE, gpu_conversion_pipeline_layout_, 0,
+      uint32_t(xe::countof(descriptor_sets)), descriptor_sets, 0, nullptr);
+  uint32_t push_constants[kGpuConversionPushConstantCount];
+  push_constants[kGpuConversionPushConstantSourceOffset] = uint32_t(
+      guest_index_base - write_descriptor_set_source_buffer_info.offset);
+  push_constants[kGpuConversionPushConstantHostIndexCount] = host_index_count;
+  command_buffer.CmdVkPushConstants(
+      gpu_conversion_pipeline_layout_, VK_SHADER_STAGE_COMPUTE_BIT, 0,
+      sizeof(push_constants), push_constants);
+  command_processor_.SubmitBarriers(true);
+  command_buffer.CmdVkDispatch(
+      (dest_word_count + (kGpuConversionGroupSize - 1)) /
+          kGpuConversionGroupSize,
+      1, 1);
+  command_processor_.PushBufferMemoryBarrier(
+      dest_buffer, dest_offset, dest_size, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+      VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+      VK_ACCESS_INDEX_READ_BIT);
+
+  backend_handle_out = frame_index_buffers_.size();
+  frame_index_buffers_.emplace_back(dest_buffer, dest_offset);
+  return true;
+}
+
+VkPipeline VulkanPrimitiveProcessor::CreateGpuConversionPipeline(
+    xenos::PrimitiveType guest_primitive_type, xenos::IndexFormat format) {
+  bool format_is_32bit = format == xenos::IndexFormat::kInt32;
+
+  std::vector<spv::Id> id_vector_temp;
+
+  SpirvBuilder builder(spv::Spv_1_0,
+                       (SpirvShaderTranslator::kSpirvMagicToolId << 16) | 1,
+                       nullptr);
+  builder.addCapability(spv::CapabilityShader);
+  builder.setMemoryModel(spv::AddressingModelLogical, spv::MemoryModelGLSL450);
+  builder.setSource(spv::SourceLanguageUnknown, 0);
+
+  spv::Id type_void = builder.makeVoidType();
+  spv::Id type_bool = builder.makeBoolType();
+  spv::Id type_int = builder.makeIntType(32);
+  spv::Id type_uint = builder.makeUintType(32);
+  spv::Id type_uint3 = builder.makeVectorType(type_uint, 3);
+
+  // Bindings.
+  // Shared memory.
+  id_vector_temp.clear();
+  id_vector_temp.push_back(builder.makeRuntimeArray(type_uint));
+  // Storage buffers have std430 packing, no padding to 4-component vectors.
+  builder.addDecoration(id_vector_temp.back(), spv::DecorationArrayStride,
+                        sizeof(uint32_t));
+  spv::Id type_source =
+      builder.makeStructType(id_vector_temp, "XeSharedMemory");
+  builder.addMemberName(type_source, 0, "shared_memory");
+  builder.addMemberDecoration(type_source, 0, spv::DecorationNonWritable);
+  builder.addMemberDecoration(type_source, 0, spv::DecorationOffset, 0);
+  // Block since SPIR-V 1.3, but since SPIR-V 1.0 is generated, it's
+  // BufferBlock.
+  builder.addDecoration(type_source, spv::DecorationBufferBlock);
+  // StorageBuffer since SPIR-V 1.3, but since SPIR-V 1.0 is generated, it's
+  // Uniform.
+  spv::Id source_buffer =
+      builder.createVariable(spv::NoPrecision, spv::StorageClassUniform,
+                             type_source, "xe_shared_memory");
+  builder.addDecoration(source_buffer, spv::DecorationDescriptorSet,
+                        kGpuConversionDescriptorSetSource);
+  builder.addDecoration(source_buffer, spv::DecorationBinding, 0);
+  // Host index buffer.
+  id_vector_temp.clear();
+  id_vector_temp.push_back(builder.makeRuntimeArray(type_uint));
+  builder.addDecoration(id_vector_temp.back(), spv::DecorationArrayStride,
+                        sizeof(uint32_t));
+  spv::Id type_dest = builder.makeStructType(id_vector_temp, "XeIndexBuffer");
+  builder.addMemberName(type_dest, 0, "indices");
+  builder.addMemberDecoration(type_dest, 0, spv::DecorationNonReadable);
+  builder.addMemberDecoration(type_dest, 0, spv::DecorationOffset, 0);
+  builder.addDecoration(type_dest, spv::DecorationBufferBlock);
+  spv::Id dest_buffer = builder.createVariable(
+      spv::NoPrecision, spv::StorageClassUniform, type_dest, "xe_indices");
+  builder.addDecoration(dest_buffer, spv::DecorationDescriptorSet,
+                        kGpuConversionDescriptorSetDest);
+  builder.addDecoration(dest_buffer, spv::DecorationBinding, 0);
+  // Push constants.
+  id_vector_temp.clear();
+  id_vector_temp.reserve(kGpuConversionPushConstantCount);
+  for (uint32_t i = 0; i < kGpuConversionPushConstantCount; ++i) {
+    id_vector_temp.push_back(type_uint);
+  }
+  spv::Id type_push_constants = builder.makeStructType(
+      id_vector_temp, "XeIndexConversionPushConstants");
+  builder.addMemberName(type_push_constants,
+                        kGpuConversionPushConstantSourceOffset,
+                        "source_offset");
+  builder.addMemberDecoration(
+      type_push_constants, kGpuConversionPushConstantSourceOffset,
+      spv::DecorationOffset,
+      int(sizeof(uint32_t) * kGpuConversionPushConstantSourceOffset));
+  builder.addMemberName(type_push_constants,
+                        kGpuConversionPushConstantHostIndexCount,
+                        "host_index_count");
+  builder.addMemberDecoration(
+      type_push_constants, kGpuConversionPushConstantHostIndexCount,
+      spv::DecorationOffset,
+      int(sizeof(uint32_t) * kGpuConversionPushConstantHostIndexCount));
+  builder.addDecoration(type_push_constants, spv::DecorationBlock);
+  spv::Id push_constants = builder.createVariable(
+      spv::NoPrecision, spv::StorageClassPushConstant, type_push_constants,
+      "xe_index_conversion_push_constants");
+
+  // gl_GlobalInvocationID input.
+  spv::Id input_global_invocation_id =
+      builder.createVariable(spv::NoPrecision, spv::StorageClassInput,
+                             type_uint3, "gl_GlobalInvocationID");
+  builder.addDecoration(input_global_invocation_id, spv::DecorationBuiltIn,
+                        spv::BuiltInGlobalInvocationId);
+
+  // Begin the main function.
+  std::vector<spv::Id> main_param_types;
+  std::vector<std::vector<spv::Decoration>> main_precisions;
+  spv::Block* main_entry;
+  spv::Function* main_function =
+      builder.makeFunctionEntry(spv::NoPrecision, type_void, "main",
+                                main_param_types, main_precisions, &main_entry);
+
+  spv::Id const_int_0 = builder.makeIntConstant(0);
+  spv::Id const_uint_0 = builder.makeUintConstant(0);
+  spv::Id const_uint_1 = builder.makeUintConstant(1);
+  spv::Id const_uint_2 = builder.makeUintConstant(2);
+
+  id_vector_temp.clear();
+  id_vector_temp.push_back(
+      builder.makeIntConstant(int(kGpuConversionPushConstantSourceOffset)));
+  spv::Id source_offset = builder.createLoad(
+      builder.createAccessChain(spv::StorageClassPushConstant, push_constants,
+                                id_vector_temp),
+      spv::NoPrecision);
+  id_vector_temp.clear();
+  id_vector_temp.push_back(
+      builder.makeIntConstant(int(kGpuConversionPushConstantHostIndexCount)));
+  spv::Id host_index_count = builder.createLoad(
+      builder.createAccessChain(spv::StorageClassPushConstant, push_constants,
+                                id_vector_temp),
+      spv::NoPrecision);
+
+  // The word of the host index buffer written by this invocation.
+  spv::Id dest_word_index = builder.createCompositeExtract(
+      builder.createLoad(input_global_invocation_id, spv::NoPrecision),
+      type_uint, 0);
+  spv::Id dest_word_count =
+      format_is_32bit
+          ? host_index_count
+          : builder.createBinOp(
+                spv::OpShiftRightLogical, type_uint,
+                builder.createBinOp(spv::OpIAdd, type_uint, host_index_count,
+                                    const_uint_1),
+                const_uint_1);
+  SpirvBuilder::IfBuilder dest_in_bounds_if(
+      builder.createBinOp(spv::OpULessThan, type_bool, dest_word_index,
+                          dest_word_count),
+      spv::SelectionControlDontFlattenMask, builder);
+
+  // Host index to guest index mapping, matching TriangleFanToList,
+  // LineLoopToStrip and QuadListToTriangleList.
+  auto get_guest_index = [&](spv::Id host_index) -> spv::Id {
+    switch (guest_primitive_type) {
+      case xenos::PrimitiveType::kTriangleFan: {
+        // (v[t + 1], v[t + 2], v[0]) for triangle t.
+        spv::Id const_uint_3 = builder.makeUintConstant(3);
+        spv::Id triangle_index = builder.createBinOp(
+            spv::OpUDiv, type_uint, host_index, const_uint_3);
+        spv::Id triangle_vertex_index = builder.createBinOp(
+            spv::OpISub, type_uint, host_index,
+            builder.createBinOp(spv::OpIMul, type_uint, triangle_index,
+                                const_uint_3));
+        return builder.createTriOp(
+            spv::OpSelect, type_uint,
+            builder.createBinOp(spv::OpIEqual, type_bool,
+                                triangle_vertex_index, const_uint_2),
+            const_uint_0,
+            builder.createBinOp(
+                spv::OpIAdd, type_uint,
+                builder.createBinOp(spv::OpIAdd, type_uint, triangle_index,
+                                    const_uint_1),
+                triangle_vertex_index));
+      }
+      case xenos::PrimitiveType::kLineLoop:
+        // The guest indices, and v[0] in the end.
+        return builder.createTriOp(
+            spv::OpSelect, type_uint,
+            builder.createBinOp(spv::OpIEqual, type_bool, host_index,
+                                builder.createBinOp(spv::OpISub, type_uint,
+                                                    host_index_count,
+                                                    const_uint_1)),
+            const_uint_0, host_index);
+      case xenos::PrimitiveType::kQuadList: {
+        // (v0, v1, v2), (v0, v2, v3) for each quad.
+        spv::Id const_uint_3 = builder.makeUintConstant(3);
+        spv::Id const_uint_6 = builder.makeUintConstant(6);
+        spv::Id quad_index = builder.createBinOp(spv::OpUDiv, type_uint,
+                                                 host_index, const_uint_6);
+        spv::Id quad_host_vertex_index = builder.createBinOp(
+            spv::OpISub, type_uint, host_index,
+            builder.createBinOp(spv::OpIMul, type_uint, quad_index,
+                                const_uint_6));
+        spv::Id quad_guest_vertex_index = builder.createTriOp(
+            spv::OpSelect, type_uint,
+            builder.createBinOp(spv::OpULessThan, type_bool,
+                                quad_host_vertex_index, const_uint_3),
+            quad_host_vertex_index,
+            builder.createTriOp(
+                spv::OpSelect, type_uint,
+                builder.createBinOp(spv::OpIEqual, type_bool,
+                                    quad_host_vertex_index, const_uint_3),
+                const_uint_0,
+                builder.createBinOp(spv::OpISub, type_uint,
+                                    quad_host_vertex_index, const_uint_2)));
+        return builder.createBinOp(
+            spv::OpIAdd, type_uint,
+            builder.createBinOp(spv::OpShiftLeftLogical, type_uint, quad_index,
+                                const_uint_2),
+            quad_guest_vertex_index);
+      }
+      default:
+        assert_unhandled_case(guest_primitive_type);
+        return const_uint_0;
+    }
+  };
+  auto load_source_word = [&](spv::Id word_index) -> spv::Id {
+    id_vector_temp.clear();
+    // The only SSBO structure member.
+    id_vector_temp.push_back(const_int_0);
+    id_vector_temp.push_back(
+        builder.createUnaryOp(spv::OpBitcast, type_int, word_index));
+    return builder.createLoad(
+        builder.createAccessChain(spv::StorageClassUniform, source_buffer,
+                                  id_vector_temp),
+        spv::NoPrecision);
+  };
+  // Loads the guest index in the guest byte order.
+  auto load_guest_index = [&](spv::Id host_index) -> spv::Id {
+    spv::Id guest_index_address = builder.createBinOp(
+        spv::OpIAdd, type_uint, source_offset,
+        builder.createBinOp(spv::OpShiftLeftLogical, type_uint,
+                            get_guest_index(host_index),
+                            builder.makeUintConstant(format_is_32bit ? 2 : 1)));
+    spv::Id source_word = load_source_word(builder.createBinOp(
+        spv::OpShiftRightLogical, type_uint, guest_index_address,
+        const_uint_2));
+    if (format_is_32bit) {
+      return source_word;
+    }
+    return builder.createTriOp(
+        spv::OpBitFieldUExtract, type_uint, source_word,
+        builder.createBinOp(
+            spv::OpShiftLeftLogical, type_uint,
+            builder.createBinOp(spv::OpBitwiseAnd, type_uint,
+                                guest_index_address, const_uint_2),
+            builder.makeUintConstant(3)),
+        builder.makeUintConstant(16));
+  };
+
+  spv::Id dest_word;
+  if (format_is_32bit) {
+    dest_word = load_guest_index(dest_word_index);
+  } else {
+    spv::Id host_index_0 = builder.createBinOp(
+        spv::OpShiftLeftLogical, type_uint, dest_word_index, const_uint_1);
+    spv::Id host_index_1 =
+        builder.createBinOp(spv::OpIAdd, type_uint, host_index_0, const_uint_1);
+    // If the host index count is odd, duplicating the last index in the unused
+    // half of the word not to read out of bounds.
+    host_index_1 = builder.createTriOp(
+        spv::OpSelect, type_uint,
+        builder.createBinOp(spv::OpULessThan, type_bool, host_index_1,
+                            host_index_count),
+        host_index_1, host_index_0);
+    dest_word = builder.createBinOp(
+        spv::OpBitwiseOr, type_uint, load_guest_index(host_index_0),
+        builder.createBinOp(spv::OpShiftLeftLogical, type_uint,
+                            load_guest_index(host_index_1),
+                            builder.makeUintConstant(16)));
+  }
+  id_vector_temp.clear();
+  // The only SSBO structure member.
+  id_vector_temp.push_back(const_int_0);
+  id_vector_temp.push_back(
+      builder.createUnaryOp(spv::OpBitcast, type_int, dest_word_index));
+  // StorageBuffer since SPIR-V 1.3, but since SPIR-V 1.0 is generated, it's
+  // Uniform.
+  builder.createStore(dest_word,
+                      builder.createAccessChain(spv::StorageClassUniform,
+                                                dest_buffer, id_vector_temp));
+
+  dest_in_bounds_if.makeEndIf();
+
+  // End the main function and make it the entry point.
+  builder.leaveFunction();
+  builder.addExecutionMode(main_function, spv::ExecutionModeLocalSize,
+                           kGpuConversionGroupSize, 1, 1);
+  spv::Instruction* entry_point = builder.addEntryPoint(
+      spv::ExecutionModelGLCompute, main_function, "main");
+  // Bindings only need to be added to the entry point's interface starting with
+  // SPIR-V 1.4 - emitting 1.0 here, so only inputs / outputs.
+  entry_point->addIdOperand(input_global_invocation_id);
+
+  // Serialize the shader code.
+  std::vector<unsigned int> shader_code;
+  builder.dump(shader_code);
+
+  VkPipeline pipeline = ui::vulkan::util::CreateComputePipeline(
+      command_processor_.GetVulkanProvider(), gpu_conversion_pipeline_layout_,
+      reinterpret_cast<const uint32_t*>(shader_code.data()),
+      sizeof(uint32_t) * shader_code.size());
+  if (pipeline == VK_NULL_HANDLE) {
+    XELOGE(
+        "Vulkan primitive processor: Failed to create the GPU index conversion "
+        "pipeline for primitive type {} with {}-bit indices",
+        uint32_t(guest_primitive_type), format_is_32bit ? 32 : 16);
+  }
+  return pipeline;
+}
+
 }  // namespace vulkan
 }  // namespace gpu
 }  // namespace xe
@@ -10,6 +10,7 @@
 #ifndef XENIA_GPU_VULKAN_VULKAN_PRIMITIVE_PROCESSOR_H_
 #define XENIA_GPU_VULKAN_VULKAN_PRIMITIVE_PROCESSOR_H_
 
+#include <deque>
 #include <memory>
 #include <utility>
 
@@ -64,7 +65,37 @@ class VulkanPrimitiveProcessor final : public PrimitiveProcessor {
       uint32_t coalignment_original_address,
       size_t& backend_handle_out) override;
 
+  bool ConvertSinglePrimitiveOnGpu(xenos::PrimitiveType guest_primitive_type,
+                                   xenos::IndexFormat format,
+                                   uint32_t guest_index_base,
+                                   uint32_t guest_index_count,
+                                   uint32_t host_index_count,
+                                   size_t& backend_handle_out) override;
+
  private:
+  enum GpuConversionDescriptorSet : uint32_t {
+    kGpuConversionDescriptorSetSource,
+    kGpuConversionDescriptorSetDest,
+
+    kGpuConversionDescriptorSetCount,
+  };
+
+  enum GpuConversionPushConstant : uint32_t {
+    // Byte offset of the guest indices relatively to the source binding.
+    kGpuConversionPushConstantSourceOffset,
+    kGpuConversionPushConstantHostIndexCount,
+
+    kGpuConversionPushConstantCount,
+  };
+
+  static constexpr uint32_t kGpuConversionGroupSize = 64;
+
+  // Triangle fans, line loops, quad lists.
+  static constexpr size_t kGpuConversionPrimitiveTypeCount = 3;
+
+  VkPipeline CreateGpuConversionPipeline(
+      xenos::PrimitiveType guest_primitive_type, xenos::IndexFormat format);
+
   VulkanCommandProcessor& command_processor_;
 
   VkDeviceSize builtin_index_buffer_size_ = 0;
@@ -82,6 +113,11 @@ class VulkanPrimitiveProcessor final : public PrimitiveProcessor {
   std::unique_ptr<ui::vulkan::VulkanUploadBufferPool> frame_index_buffer_pool_;
   // Indexed by the backend handles.
   std::deque<std::pair<VkBuffer, VkDeviceSize>> frame_index_buffers_;
+
+  VkPipelineLayout gpu_conversion_pipeline_layout_ = VK_NULL_HANDLE;
+  // Indexed by the primitive type and by whether the indices are 32-bit.
+  VkPipeline gpu_conversion_pipelines_[kGpuConversionPrimitiveTypeCount][2] =
+      {};
 };
 
 }  // namespace vulkan
@@ -24,6 +24,7 @@
 #include "xenia/base/cvar.h"
 #include "xenia/base/logging.h"
 #include "xenia/base/math.h"
+#include "xenia/base/profiling.h"
 #include "xenia/gpu/draw_util.h"
 #include "xenia/gpu/registers.h"
 #include "xenia/gpu/spirv_builder.h"
@@ -32,6 +33,7 @@
 #include "xenia/gpu/vulkan/deferred_command_buffer.h"
 #include "xenia/gpu/vulkan/vulkan_command_processor.h"
 #include "xenia/gpu/xenos.h"
+#include "xenia/ui/vulkan/vulkan_mem_alloc.h"
 #include "xenia/ui/vulkan/vulkan_util.h"
 
 DEFINE_string(
@@ -54,6 +56,12 @@ DEFINE_string(
     "  Choose what is considered the most optimal for the system (currently "
     "always FB because the FSI path is much slower now).",
     "GPU");
+DEFINE_uint32(
+    vulkan_render_target_memory_block_size_mb, 128,
+    "Size of the device memory blocks render targets are suballocated from on "
+    "Vulkan, in megabytes. Render targets larger than half of a block are "
+    "allocated separately. 0 to allocate all render targets separately.",
+    "Vulkan");
 
 namespace xe {
 namespace gpu {
@@ -254,6 +262,16 @@ bool VulkanRenderTargetCache::Initialize(uint32_t shared_memory_binding_count) {
     }
   }
 
+  // Vulkan Memory Allocator for the render target images.
+  vma_allocator_ = ui::vulkan::CreateVmaAllocator(provider, true);
+  if (vma_allocator_ == VK_NULL_HANDLE) {
+    Shutdown();
+    return false;
+  }
+  image_pools_ = std::make_unique<ui::vulkan::VmaImagePools>(
+      provider, vma_allocator_,
+      VkDeviceSize(cvars::vulkan_render_target_memory_block_size_mb) << 20);
+
   // Format support.
   constexpr VkFormatFeatureFlags kUsedDepthFormatFeatures =
       VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT |
@@ -883,6 +901,14 @@ void VulkanRenderTargetCache::Shutdown(bool from_destructor) {
   // so ShutdownCommon is called by the RenderTargetCache destructor, when it's
   // already too late.
   DestroyAllRenderTargets(true);
+  if (image_pools_) {
+    image_pools_->LogStatistics("VulkanRenderTargetCache");
+    image_pools_.reset();
+  }
+  if (vma_allocator_ != VK_NULL_HANDLE) {
+    vmaDestroyAllocator(vma_allocator_);
+    vma_allocator_ = VK_NULL_HANDLE;
+  }
 
   ui::vulkan::util::DestroyAndNullHandle(dfn.vkDestroyPipeline, device,
                                          resolve_fsi_clear_64bpp_pipeline_);
@@ -1008,6 +1034,19 @@ void VulkanRenderTargetCache::ClearCache() {
   RenderTargetCache::ClearCache();
 }
 
+void VulkanRenderTargetCache::BeginFrame() {
+  RenderTargetCache::BeginFrame();
+
+  ui::vulkan::VmaImagePools::Statistics image_pool_statistics =
+      image_pools_->GetStatistics();
+  COUNT_profile_set("gpu/vulkan/render_target_pool_blocks_kb",
+                    image_pool_statistics.block_bytes >> 10);
+  COUNT_profile_set("gpu/vulkan/render_target_pool_used_kb",
+                    image_pool_statistics.pooled_allocation_bytes >> 10);
+  COUNT_profile_set("gpu/vulkan/render_target_separate_kb",
+                    image_pool_statistics.separate_allocation_bytes >> 10);
+}
+
 void VulkanRenderTargetCache::CompletedSubmissionUpdated() {
   if (transfer_vertex_buffer_pool_) {
     transfer_vertex_buffer_pool_->Reclaim(
@@ -1214,11 +1253,17 @@ bool VulkanRenderTargetCache::Resolve(const Memory& memory,
             resolve_info.GetClearShaderGroupCount(draw_resolution_scale_x(),
                                                   draw_resolution_scale_y());
         assert_true(clear_group_count.first && clear_group_count.second);
+        // Skipping clears of tiles not modified since the same clear.
+        draw_util::ResolveClearShaderConstants depth_clear_constants;
+        bool depth_cleared = false;
         if (clear_depth) {
+          resolve_info.GetDepthClearShaderConstants(depth_clear_constants);
+          depth_cleared =
+              PrepareInterlockResolveClear(resolve_info, depth_clear_constants);
+        }
+        if (depth_cleared) {
           command_processor_.BindExternalComputePipeline(
               resolve_fsi_clear_32bpp_pipeline_);
-          draw_util::ResolveClearShaderConstants depth_clear_constants;
-          resolve_info.GetDepthClearShaderConstants(depth_clear_constants);
           command_buffer.CmdVkPushConstants(
               resolve_fsi_clear_pipeline_layout_, VK_SHADER_STAGE_COMPUTE_BIT,
               0, sizeof(depth_clear_constants), &depth_clear_constants);
@@ -1226,14 +1271,17 @@ bool VulkanRenderTargetCache::Resolve(const Memory& memory,
           command_buffer.CmdVkDispatch(clear_group_count.first,
                                        clear_group_count.second, 1);
         }
+        draw_util::ResolveClearShaderConstants color_clear_constants;
         if (clear_color) {
+          resolve_info.GetColorClearShaderConstants(color_clear_constants);
+        }
+        if (clear_color &&
+            PrepareInterlockResolveClear(resolve_info, color_clear_constants)) {
           command_processor_.BindExternalComputePipeline(
               resolve_info.color_edram_info.format_is_64bpp
                   ? resolve_fsi_clear_64bpp_pipeline_
                   : resolve_fsi_clear_32bpp_pipeline_);
-          draw_util::ResolveClearShaderConstants color_clear_constants;
-          resolve_info.GetColorClearShaderConstants(color_clear_constants);
-          if (clear_depth) {
+          if (depth_cleared) {
             // Non-RT-specific constants have already been set.
             command_buffer.CmdVkPushConstants(
                 resolve_fsi_clear_pipeline_layout_, VK_SHADER_STAGE_COMPUTE_BIT,
@@ -1666,8 +1714,7 @@ VulkanRenderTargetCache::VulkanRenderTarget::~VulkanRenderTarget() {
     dfn.vkDestroyImageView(device, view_depth_stencil_, nullptr);
   }
   dfn.vkDestroyImageView(device, view_depth_color_, nullptr);
-  dfn.vkDestroyImage(device, image_, nullptr);
-  dfn.vkFreeMemory(device, memory_, nullptr);
+  render_target_cache_.image_pools_->DestroyImage(image_, allocation_);
 }
 
 uint32_t VulkanRenderTargetCache::GetMaxRenderTargetWidth() const {
@@ -1743,10 +1790,8 @@ RenderTargetCache::RenderTarget* VulkanRenderTargetCache::CreateRenderTarget(
     return nullptr;
   }
   VkImage image;
-  VkDeviceMemory memory;
-  if (!ui::vulkan::util::CreateDedicatedAllocationImage(
-          provider, image_create_info,
-          ui::vulkan::util::MemoryPurpose::kDeviceLocal, image, memory)) {
+  VmaAllocation allocation;
+  if (!image_pools_->CreateImage(image_create_info, image, allocation)) {
     XELOGE(
         "VulkanRenderTarget: Failed to create a {}x{} {}xMSAA {} render target "
         "image",
@@ -1780,8 +1825,7 @@ RenderTargetCache::RenderTarget* VulkanRenderTargetCache::CreateRenderTarget(
         key.is_depth ? "depth" : "color", image_create_info.extent.width,
         image_create_info.extent.height,
         uint32_t(1) << uint32_t(key.msaa_samples), key.GetFormatName());
-    dfn.vkDestroyImage(device, image, nullptr);
-    dfn.vkFreeMemory(device, memory, nullptr);
+    image_pools_->DestroyImage(image, allocation);
     return nullptr;
   }
   VkImageView view_depth_stencil = VK_NULL_HANDLE;
@@ -1800,8 +1844,7 @@ RenderTargetCache::RenderTarget* VulkanRenderTargetCache::CreateRenderTarget(
           uint32_t(1) << uint32_t(key.msaa_samples),
           xenos::GetDepthRenderTargetFormatName(key.GetDepthFormat()));
       dfn.vkDestroyImageView(device, view_depth_color, nullptr);
-      dfn.vkDestroyImage(device, image, nullptr);
-      dfn.vkFreeMemory(device, memory, nullptr);
+      image_pools_->DestroyImage(image, allocation);
       return nullptr;
     }
     view_create_info.subresourceRange.aspectMask = VK_IMAGE_ASPECT_STENCIL_BIT;
@@ -1815,8 +1858,7 @@ RenderTargetCache::RenderTarget* VulkanRenderTargetCache::CreateRenderTarget(
           xenos::GetDepthRenderTargetFormatName(key.GetDepthFormat()));
       dfn.vkDestroyImageView(device, view_depth_stencil, nullptr);
       dfn.vkDestroyImageView(device, view_depth_color, nullptr);
-      dfn.vkDestroyImage(device, image, nullptr);
-      dfn.vkFreeMemory(device, memory, nullptr);
+      image_pools_->DestroyImage(image, allocation);
       return nullptr;
     }
   } else {
@@ -1831,8 +1873,7 @@ RenderTargetCache::RenderTarget* VulkanRenderTargetCache::CreateRenderTarget(
             uint32_t(1) << uint32_t(key.msaa_samples),
             xenos::GetColorRenderTargetFormatName(key.GetColorFormat()));
         dfn.vkDestroyImageView(device, view_depth_color, nullptr);
-        dfn.vkDestroyImage(device, image, nullptr);
-        dfn.vkFreeMemory(device, memory, nullptr);
+        image_pools_->DestroyImage(image, allocation);
         return nullptr;
       }
     }
@@ -1849,8 +1890,7 @@ RenderTargetCache::RenderTarget* VulkanRenderTargetCache::CreateRenderTarget(
           dfn.vkDestroyImageView(device, view_srgb, nullptr);
         }
         dfn.vkDestroyImageView(device, view_depth_color, nullptr);
-        dfn.vkDestroyImage(device, image, nullptr);
-        dfn.vkFreeMemory(device, memory, nullptr);
+        image_pools_->DestroyImage(image, allocation);
         return nullptr;
       }
     }
@@ -1872,8 +1912,7 @@ RenderTargetCache::RenderTarget* VulkanRenderTargetCache::CreateRenderTarget(
       dfn.vkDestroyImageView(device, view_srgb, nullptr);
     }
     dfn.vkDestroyImageView(device, view_depth_color, nullptr);
-    dfn.vkDestroyImage(device, image, nullptr);
-    dfn.vkFreeMemory(device, memory, nullptr);
+    image_pools_->DestroyImage(image, allocation);
     return nullptr;
   }
   VkDescriptorSet descriptor_set_transfer_source =
@@ -1917,7 +1956,7 @@ RenderTargetCache::RenderTarget* VulkanRenderTargetCache::CreateRenderTarget(
   dfn.vkUpdateDescriptorSets(device, key.is_depth ? 2 : 1, descriptor_set_write,
                              0, nullptr);
 
-  return new VulkanRenderTarget(key, *this, image, memory, view_depth_color,
+  return new VulkanRenderTarget(key, *this, image, allocation, view_depth_color,
                                 view_depth_stencil, view_stencil, view_srgb,
                                 view_color_transfer_separate,
                                 descriptor_set_index_transfer_source);
@@ -4501,6 +4540,21 @@ void VulkanRenderTargetCache::PerformTransfersAndResolveClears(
 
   bool resolve_clear_needed =
       render_target_resolve_clear_values && resolve_clear_rectangle;
+  // This is called for every draw, only switch the profiling category if
+  // there are actual transfers to do (resolve clears are a part of resolves).
+  bool any_transfers_needed = false;
+  if (render_target_transfers) {
+    for (uint32_t i = 0; i < render_target_count; ++i) {
+      if (render_targets[i] && !render_target_transfers[i].empty()) {
+        any_transfers_needed = true;
+        break;
+      }
+    }
+  }
+  if (any_transfers_needed) {
+    command_processor_.SwitchGpuTimestampCategory(
+        GpuTimestampProfiler::Category::kEdramTransfers);
+  }
   VkClearRect resolve_clear_rect;
   if (resolve_clear_needed) {
     // Assuming the rectangle is already clamped by the setup function from the
@@ -24,6 +24,7 @@
 #include "xenia/gpu/vulkan/vulkan_texture_cache.h"
 #include "xenia/gpu/xenos.h"
 #include "xenia/ui/vulkan/single_layout_descriptor_set_pool.h"
+#include "xenia/ui/vulkan/vulkan_mem_alloc.h"
 #include "xenia/ui/vulkan/vulkan_provider.h"
 #include "xenia/ui/vulkan/vulkan_upload_buffer_pool.h"
 
@@ -109,6 +110,7 @@ class VulkanRenderTargetCache final : public RenderTargetCache {
   void Shutdown(bool from_destructor = false);
   void ClearCache() override;
 
+  void BeginFrame() override;
   void CompletedSubmissionUpdated();
   void EndSubmission();
 
@@ -280,6 +282,11 @@ class VulkanRenderTargetCache final : public RenderTargetCache {
   std::unique_ptr<ui::vulkan::SingleLayoutDescriptorSetPool>
       descriptor_set_pool_sampled_image_x2_;
 
+  // Render targets are suballocated like textures, but with their own pools as
+  // they are usually much larger and longer-lived.
+  VmaAllocator vma_allocator_ = VK_NULL_HANDLE;
+  std::unique_ptr<ui::vulkan::VmaImagePools> image_pools_;
+
   VkDeviceMemory edram_buffer_memory_ = VK_NULL_HANDLE;
   VkBuffer edram_buffer_ = VK_NULL_HANDLE;
   EdramBufferUsage edram_buffer_usage_;
@@ -331,7 +338,7 @@ class VulkanRenderTargetCache final : public RenderTargetCache {
     // Takes ownership of the Vulkan objects passed to the constructor.
     VulkanRenderTarget(RenderTargetKey key,
                        VulkanRenderTargetCache& render_target_cache,
-                       VkImage image, VkDeviceMemory memory,
+                       VkImage image, VmaAllocation allocation,
                        VkImageView view_depth_color,
                        VkImageView view_depth_stencil, VkImageView view_stencil,
                        VkImageView view_srgb,
@@ -340,7 +347,7 @@ class VulkanRenderTargetCache final : public RenderTargetCache {
         : RenderTarget(key),
           render_target_cache_(render_target_cache),
           image_(image),
-          memory_(memory),
+          allocation_(allocation),
           view_depth_color_(view_depth_color),
           view_depth_stencil_(view_depth_stencil),
           view_stencil_(view_stencil),
@@ -411,7 +418,7 @@ class VulkanRenderTargetCache final : public RenderTargetCache {
     VulkanRenderTargetCache& render_target_cache_;
 
     VkImage image_;
-    VkDeviceMemory memory_;
+    VmaAllocation allocation_;
 
     // TODO(Triang3l): Per-format drawing views for mutable formats with EDRAM
     // aliasing without transfers.
@@ -28,6 +28,17 @@ DEFINE_bool(vulkan_sparse_shared_memory, true,
             "allows graphics debuggers that don't support sparse binding to "
             "work.",
             "Vulkan");
+DEFINE_bool(
+    vulkan_host_visible_shared_memory, false,
+    "If the device has host-visible and host-coherent device-local memory "
+    "large enough for the whole shared memory buffer (on UMA devices, or with "
+    "resizable BAR), place the buffer there, and copy guest memory into it "
+    "without intermediate upload buffers and copy commands. This disables "
+    "sparse binding for shared memory. Unlike uploads via copy commands, the "
+    "writes are not ordered with GPU work that has already been recorded, so "
+    "if a game overwrites data still being read by the GPU in frames in "
+    "flight, rendering of those frames may become corrupted.",
+    "Vulkan");
 
 namespace xe {
 namespace gpu {
@@ -70,7 +81,14 @@ bool VulkanSharedMemory::Initialize() {
   buffer_create_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
   buffer_create_info.queueFamilyIndexCount = 0;
   buffer_create_info.pQueueFamilyIndices = nullptr;
-  if (cvars::vulkan_sparse_shared_memory && device_info.sparseResidencyBuffer) {
+  const uint32_t memory_types_host_visible_device_local =
+      cvars::vulkan_host_visible_shared_memory
+          ? device_info.memory_types_device_local &
+                device_info.memory_types_host_visible &
+                device_info.memory_types_host_coherent
+          : 0;
+  if (cvars::vulkan_sparse_shared_memory && device_info.sparseResidencyBuffer &&
+      !memory_types_host_visible_device_local) {
     if (dfn.vkCreateBuffer(device, &buffer_create_info, nullptr, &buffer_) ==
         VK_SUCCESS) {
       VkMemoryRequirements buffer_memory_requirements;
@@ -113,11 +131,13 @@ bool VulkanSharedMemory::Initialize() {
 
   // Create a non-sparse buffer if there were issues with the sparse buffer.
   if (buffer_ == VK_NULL_HANDLE) {
-    XELOGGPU(
-        "Vulkan sparse binding is not used for shared memory emulation - video "
-        "memory usage may increase significantly because a full {} MB buffer "
-        "will be created",
-        kBufferSize >> 20);
+    if (!memory_types_host_visible_device_local) {
+      XELOGGPU(
+          "Vulkan sparse binding is not used for shared memory emulation - "
+          "video memory usage may increase significantly because a full {} MB "
+          "buffer will be created",
+          kBufferSize >> 20);
+    }
     buffer_create_info.flags &= ~sparse_flags;
     if (dfn.vkCreateBuffer(device, &buffer_create_info, nullptr, &buffer_) !=
         VK_SUCCESS) {
@@ -129,15 +149,6 @@ bool VulkanSharedMemory::Initialize() {
     VkMemoryRequirements buffer_memory_requirements;
     dfn.vkGetBufferMemoryRequirements(device, buffer_,
                                       &buffer_memory_requirements);
-    if (!xe::bit_scan_forward(buffer_memory_requirements.memoryTypeBits &
-                                  device_info.memory_types_device_local,
-                              &buffer_memory_type_)) {
-      XELOGE(
-          "Shared memory: Failed to get a device-local Vulkan memory type for "
-          "the buffer");
-      Shutdown();
-      return false;
-    }
     VkMemoryAllocateInfo buffer_memory_allocate_info;
     VkMemoryAllocateInfo* buffer_memory_allocate_info_last =
         &buffer_memory_allocate_info;
@@ -145,7 +156,6 @@ bool VulkanSharedMemory::Initialize() {
     buffer_memory_allocate_info.pNext = nullptr;
     buffer_memory_allocate_info.allocationSize =
         buffer_memory_requirements.size;
-    buffer_memory_allocate_info.memoryTypeIndex = buffer_memory_type_;
     VkMemoryDedicatedAllocateInfo buffer_memory_dedicated_allocate_info;
     if (provider.device_info().ext_1_1_VK_KHR_dedicated_allocation) {
       buffer_memory_allocate_info_last->pNext =
@@ -159,15 +169,47 @@ bool VulkanSharedMemory::Initialize() {
       buffer_memory_dedicated_allocate_info.image = VK_NULL_HANDLE;
       buffer_memory_dedicated_allocate_info.buffer = buffer_;
     }
-    VkDeviceMemory buffer_memory;
-    if (dfn.vkAllocateMemory(device, &buffer_memory_allocate_info, nullptr,
-                             &buffer_memory) != VK_SUCCESS) {
-      XELOGE(
-          "Shared memory: Failed to allocate {} MB of memory for the Vulkan "
-          "buffer",
-          kBufferSize >> 20);
-      Shutdown();
-      return false;
+    VkDeviceMemory buffer_memory = VK_NULL_HANDLE;
+    // Try the host-visible memory first, but without resizable BAR, it's
+    // likely too small for the whole buffer, in which case fall back to the
+    // usual device-local memory.
+    bool buffer_memory_host_visible = false;
+    if (xe::bit_scan_forward(buffer_memory_requirements.memoryTypeBits &
+                                 memory_types_host_visible_device_local,
+                             &buffer_memory_type_)) {
+      buffer_memory_allocate_info.memoryTypeIndex = buffer_memory_type_;
+      if (dfn.vkAllocateMemory(device, &buffer_memory_allocate_info, nullptr,
+                               &buffer_memory) == VK_SUCCESS) {
+        buffer_memory_host_visible = true;
+      } else {
+        XELOGGPU(
+            "Shared memory: Failed to allocate {} MB of host-visible "
+            "device-local memory for the Vulkan buffer, falling back to "
+            "uploading via copy commands",
+            kBufferSize >> 20);
+        buffer_memory = VK_NULL_HANDLE;
+      }
+    }
+    if (buffer_memory == VK_NULL_HANDLE) {
+      if (!xe::bit_scan_forward(buffer_memory_requirements.memoryTypeBits &
+                                    device_info.memory_types_device_local,
+                                &buffer_memory_type_)) {
+        XELOGE(
+            "Shared memory: Failed to get a device-local Vulkan memory type "
+            "for the buffer");
+        Shutdown();
+        return false;
+      }
+      buffer_memory_allocate_info.memoryTypeIndex = buffer_memory_type_;
+      if (dfn.vkAllocateMemory(device, &buffer_memory_allocate_info, nullptr,
+                               &buffer_memory) != VK_SUCCESS) {
+        XELOGE(
+            "Shared memory: Failed to allocate {} MB of memory for the Vulkan "
+            "buffer",
+            kBufferSize >> 20);
+        Shutdown();
+        return false;
+      }
     }
     buffer_memory_.push_back(buffer_memory);
     if (dfn.vkBindBufferMemory(device, buffer_, buffer_memory, 0) !=
@@ -176,6 +218,21 @@ bool VulkanSharedMemory::Initialize() {
       Shutdown();
       return false;
     }
+    if (buffer_memory_host_visible) {
+      void* buffer_mapping;
+      if (dfn.vkMapMemory(device, buffer_memory, 0, VK_WHOLE_SIZE, 0,
+                          &buffer_mapping) == VK_SUCCESS) {
+        buffer_mapping_ = reinterpret_cast<uint8_t*>(buffer_mapping);
+        XELOGGPU(
+            "Using a {} MB host-visible buffer for shared memory emulation",
+            kBufferSize >> 20);
+      } else {
+        // Still usable as a regular buffer with copy command uploads.
+        XELOGE(
+            "Shared memory: Failed to map the host-visible Vulkan buffer, "
+            "falling back to uploading via copy commands");
+      }
+    }
   }
 
   // The first usage will likely be uploading.
@@ -201,6 +258,8 @@ void VulkanSharedMemory::Shutdown(bool from_destructor) {
   VkDevice device = provider.device();
 
   ui::vulkan::util::DestroyAndNullHandle(dfn.vkDestroyBuffer, device, buffer_);
+  // Freeing the memory unmaps it implicitly.
+  buffer_mapping_ = nullptr;
   for (VkDeviceMemory memory : buffer_memory_) {
     dfn.vkFreeMemory(device, memory, nullptr);
   }
@@ -381,6 +440,24 @@ bool VulkanSharedMemory::UploadRanges(
     return true;
   }
 
+  if (buffer_mapping_) {
+    // The memory is host-coherent, and host writes are made visible to the
+    // device by the submission of the command buffer, which is done later, so
+    // no copy commands or barriers are needed.
+    for (uint32_t i = 0; i < num_upload_ranges; ++i) {
+      uint32_t upload_range_start = upload_page_ranges[i].first
+                                    << page_size_log2();
+      uint32_t upload_range_length = upload_page_ranges[i].second
+                                     << page_size_log2();
+      trace_writer_.WriteMemoryRead(upload_range_start, upload_range_length);
+      MakeRangeValid(upload_range_start, upload_range_length, false, false);
+      std::memcpy(buffer_mapping_ + upload_range_start,
+                  memory().TranslatePhysical(upload_range_start),
+                  upload_range_length);
+    }
+    return true;
+  }
+
   auto& range_front = upload_page_ranges[0];
   auto& range_back = upload_page_ranges[num_upload_ranges - 1];
 
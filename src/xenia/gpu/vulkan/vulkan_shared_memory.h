@@ -77,6 +77,9 @@ class VulkanSharedMemory : public SharedMemory {
   uint32_t buffer_memory_type_;
   // Single for non-sparse, every allocation so far for sparse.
   std::vector<VkDeviceMemory> buffer_memory_;
+  // Persistently mapped if the buffer is in host-visible memory, in which case
+  // guest memory is copied to it directly rather than via upload buffers.
+  uint8_t* buffer_mapping_ = nullptr;
 
   Usage last_usage_;
   std::pair<uint32_t, uint32_t> last_written_range_;
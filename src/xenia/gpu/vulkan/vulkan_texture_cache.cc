@@ -14,6 +14,7 @@
 #include <utility>
 
 #include "xenia/base/assert.h"
+#include "xenia/base/cvar.h"
 #include "xenia/base/logging.h"
 #include "xenia/base/math.h"
 #include "xenia/base/profiling.h"
@@ -25,6 +26,13 @@
 #include "xenia/ui/vulkan/vulkan_mem_alloc.h"
 #include "xenia/ui/vulkan/vulkan_util.h"
 
+DEFINE_uint32(
+    vulkan_texture_memory_block_size_mb, 64,
+    "Size of the device memory blocks textures are suballocated from on "
+    "Vulkan, in megabytes. Textures larger than half of a block are allocated "
+    "separately. 0 to allocate all textures separately.",
+    "Vulkan");
+
 namespace xe {
 namespace gpu {
 namespace vulkan {
@@ -475,11 +483,28 @@ VulkanTextureCache::~VulkanTextureCache() {
   // textures before destroying VMA.
   DestroyAllTextures(true);
 
+  if (image_pools_) {
+    image_pools_->LogStatistics("VulkanTextureCache");
+    image_pools_.reset();
+  }
   if (vma_allocator_ != VK_NULL_HANDLE) {
     vmaDestroyAllocator(vma_allocator_);
   }
 }
 
+void VulkanTextureCache::BeginFrame() {
+  TextureCache::BeginFrame();
+
+  ui::vulkan::VmaImagePools::Statistics image_pool_statistics =
+      image_pools_->GetStatistics();
+  COUNT_profile_set("gpu/vulkan/texture_pool_blocks_kb",
+                    image_pool_statistics.block_bytes >> 10);
+  COUNT_profile_set("gpu/vulkan/texture_pool_used_kb",
+                    image_pool_statistics.pooled_allocation_bytes >> 10);
+  COUNT_profile_set("gpu/vulkan/texture_separate_kb",
+                    image_pool_statistics.separate_allocation_bytes >> 10);
+}
+
 void VulkanTextureCache::BeginSubmission(uint64_t new_submission_index) {
   TextureCache::BeginSubmission(new_submission_index);
 
@@ -1060,13 +1085,9 @@ std::unique_ptr<TextureCache::Texture> VulkanTextureCache::CreateTexture(
     image_format_list_create_info.pViewFormats = formats;
   }
 
-  VmaAllocationCreateInfo allocation_create_info = {};
-  allocation_create_info.usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE;
-
   VkImage image;
   VmaAllocation allocation;
-  if (vmaCreateImage(vma_allocator_, &image_create_info,
-                     &allocation_create_info, &image, &allocation, nullptr)) {
+  if (!image_pools_->CreateImage(image_create_info, image, allocation)) {
     return nullptr;
   }
 
@@ -1119,7 +1140,8 @@ bool VulkanTextureCache::LoadTextureDataFromResidentMemoryImpl(Texture& texture,
   uint32_t block_width = guest_format_info->block_width;
   uint32_t block_height = guest_format_info->block_height;
   uint32_t bytes_per_block = guest_format_info->bytes_per_block();
-  uint32_t level_first = load_base ? 0 : 1;
+  uint32_t level_first = load_base ? 0 : texture.mips_first_level();
+  assert_true(!load_base || !load_mips || texture.mips_first_level() == 1);
   uint32_t level_last = load_mips ? texture_key.mip_max_level : 0;
   assert_true(level_first <= level_last);
   uint32_t level_packed = guest_layout.packed_level;
@@ -1340,6 +1362,8 @@ bool VulkanTextureCache::LoadTextureDataFromResidentMemoryImpl(Texture& texture,
 
   DeferredCommandBuffer& command_buffer =
       command_processor_.deferred_command_buffer();
+  command_processor_.SwitchGpuTimestampCategory(
+      GpuTimestampProfiler::Category::kTextureLoads);
 
   command_processor_.BindExternalComputePipeline(pipeline);
 
@@ -1535,6 +1559,12 @@ bool VulkanTextureCache::LoadTextureDataFromResidentMemoryImpl(Texture& texture,
   return true;
 }
 
+bool VulkanTextureCache::QueryHostMemoryBudget(uint64_t& budget_out,
+                                               uint64_t& usage_out) const {
+  return command_processor_.GetVulkanProvider().QueryDeviceLocalMemoryBudget(
+      budget_out, usage_out);
+}
+
 void VulkanTextureCache::UpdateTextureBindingsImpl(
     uint32_t fetch_constant_mask) {
   uint32_t bindings_remaining = fetch_constant_mask;
@@ -1597,7 +1627,7 @@ VulkanTextureCache::VulkanTexture::~VulkanTexture() {
   for (const auto& view_pair : views_) {
     dfn.vkDestroyImageView(device, view_pair.second, nullptr);
   }
-  vmaDestroyImage(vulkan_texture_cache.vma_allocator_, image_, allocation_);
+  vulkan_texture_cache.image_pools_->DestroyImage(image_, allocation_);
 }
 
 VkImageView VulkanTextureCache::VulkanTexture::GetView(bool is_signed,
@@ -1719,6 +1749,9 @@ bool VulkanTextureCache::Initialize() {
   if (vma_allocator_ == VK_NULL_HANDLE) {
     return false;
   }
+  image_pools_ = std::make_unique<ui::vulkan::VmaImagePools>(
+      provider, vma_allocator_,
+      VkDeviceSize(cvars::vulkan_texture_memory_block_size_mb) << 20);
 
   // Image formats.
 
@@ -82,6 +82,7 @@ class VulkanTextureCache final : public TextureCache {
 
   ~VulkanTextureCache();
 
+  void BeginFrame() override;
   void BeginSubmission(uint64_t new_submission_index) override;
 
   // Must be called within a frame - creates and untiles textures needed by
@@ -136,6 +137,9 @@ class VulkanTextureCache final : public TextureCache {
   bool LoadTextureDataFromResidentMemoryImpl(Texture& texture, bool load_base,
                                              bool load_mips) override;
 
+  bool QueryHostMemoryBudget(uint64_t& budget_out,
+                             uint64_t& usage_out) const override;
+
   void UpdateTextureBindingsImpl(uint32_t fetch_constant_mask) override;
 
  private:
@@ -323,6 +327,7 @@ class VulkanTextureCache final : public TextureCache {
   // on Windows versions before 10, may have an allocation count limit as low as
   // 4096.
   VmaAllocator vma_allocator_ = VK_NULL_HANDLE;
+  std::unique_ptr<ui::vulkan::VmaImagePools> image_pools_;
 
   static const HostFormatPair kBestHostFormats[64];
   static const HostFormatPair kHostFormatGBGRUnaligned;
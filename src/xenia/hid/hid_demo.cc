@@ -86,6 +86,8 @@ class HidDemoApp final : public ui::WindowedApp {
     explicit HidDemoDialog(ui::ImGuiDrawer* imgui_drawer, HidDemoApp& app)
         : ui::ImGuiDialog(imgui_drawer), app_(app) {}
 
+    bool IsUpdatedContinuously() const override { return true; }
+
    protected:
     void OnDraw(ImGuiIO& io) override;
 
@@ -13,6 +13,7 @@
 #include <cstddef>
 #include <functional>
 
+#include "xenia/base/input_latency.h"
 #include "xenia/hid/input.h"
 #include "xenia/ui/window.h"
 #include "xenia/xbox.h"
@@ -57,6 +58,12 @@ class InputDriver {
     return !is_active_callback_ || is_active_callback_();
   }
 
+  // Marks a change of the host input of the user, for measuring the latency
+  // until it's presented.
+  static void OnHostInputEvent(uint32_t user_index) {
+    input_latency::OnHostInput(user_index);
+  }
+
  private:
   xe::ui::Window* window_;
   size_t window_z_order_;
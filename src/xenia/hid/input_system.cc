@@ -11,6 +11,12 @@
 
 #include "xenia/hid/input_system.h"
 
+#include <algorithm>
+#include <cstring>
+
+#include "xenia/base/clock.h"
+#include "xenia/base/filesystem.h"
+#include "xenia/base/input_latency.h"
 #include "xenia/base/profiling.h"
 #include "xenia/hid/hid_flags.h"
 #include "xenia/hid/input_driver.h"
@@ -27,12 +33,190 @@ DEFINE_double(left_stick_deadzone_percentage, 0.0,
 DEFINE_double(
     right_stick_deadzone_percentage, 0.0,
     "Defines deadzone level for right stick. Allowed range [0.0-1.0].", "HID");
+DEFINE_uint32(
+    input_poll_rate, 250,
+    "Number of times per second the controller states are polled from the "
+    "input drivers, for the guest to read the latest states without waiting "
+    "for the drivers. 0 to query the drivers on every guest request instead.",
+    "HID");
+DEFINE_path(
+    input_record_path, "",
+    "File to record the controller states read by the guest to, tied to the "
+    "guest frame numbers, for input_replay_path.",
+    "HID");
+DEFINE_path(
+    input_replay_path, "",
+    "File recorded with input_record_path to replay the controller states of, "
+    "instead of reading the controllers, for comparing the performance of "
+    "builds on the same gameplay. The guest system time is the recorded one, "
+    "and the time of the replayed frames is logged when the recording ends.",
+    "HID");
 
 InputSystem::InputSystem(xe::ui::Window* window) : window_(window) {}
 
-InputSystem::~InputSystem() = default;
+InputSystem::~InputSystem() { Shutdown(); }
+
+X_STATUS InputSystem::Setup() {
+  if (!cvars::input_replay_path.empty()) {
+    // The drivers aren't read while replaying.
+    BeginReplay();
+    return X_STATUS_SUCCESS;
+  }
+  if (!cvars::input_record_path.empty()) {
+    is_recording_ = BeginRecording();
+  }
+  if (!cvars::input_poll_rate || drivers_.empty()) {
+    return X_STATUS_SUCCESS;
+  }
+  // Initial states, so the guest doesn't see all controllers disconnected
+  // until the first poll.
+  PollDriverStates();
+  poll_thread_stop_ = threading::Event::CreateManualResetEvent(false);
+  poll_thread_ = threading::Thread::Create({}, [this]() { PollThread(); });
+  if (!poll_thread_) {
+    XELOGE("Failed to create the input polling thread");
+    poll_thread_stop_.reset();
+    return X_STATUS_SUCCESS;
+  }
+  poll_thread_->set_name("Input Polling");
+  return X_STATUS_SUCCESS;
+}
+
+void InputSystem::Shutdown() {
+  if (poll_thread_) {
+    poll_thread_stop_->Set();
+    threading::Wait(poll_thread_.get(), false);
+    poll_thread_.reset();
+    poll_thread_stop_.reset();
+  }
+  std::lock_guard<std::mutex> recording_lock(recording_mutex_);
+  if (recording_file_) {
+    RecordedState end_state = {};
+    end_state.frame = guest_frame_.load(std::memory_order_relaxed);
+    end_state.user_index = kRecordingEndUserIndex;
+    std::fwrite(&end_state, sizeof(end_state), 1, recording_file_);
+    std::fclose(recording_file_);
+    recording_file_ = nullptr;
+    XELOGI("Recorded the controller states of {} frames", end_state.frame);
+  }
+}
+
+bool InputSystem::BeginRecording() {
+  recording_file_ = xe::filesystem::OpenFile(cvars::input_record_path, "wb");
+  if (!recording_file_) {
+    XELOGE("Failed to open {} for recording the controller states",
+           xe::path_to_utf8(cvars::input_record_path));
+    return false;
+  }
+  RecordingHeader header = {kRecordingMagic, kRecordingVersion,
+                            Clock::guest_system_time_base()};
+  std::fwrite(&header, sizeof(header), 1, recording_file_);
+  // Recorded on the first read.
+  for (RecordedState& state : last_recorded_states_) {
+    state = {};
+    state.result = X_ERROR_FUNCTION_FAILED;
+  }
+  return true;
+}
+
+bool InputSystem::BeginReplay() {
+  is_replaying_ = true;
+  for (uint32_t i = 0; i < XUserMaxUserCount; ++i) {
+    replayed_states_[i] = {};
+    replayed_states_[i].user_index = i;
+    replayed_states_[i].result = X_ERROR_DEVICE_NOT_CONNECTED;
+  }
+  FILE* file = xe::filesystem::OpenFile(cvars::input_replay_path, "rb");
+  if (!file) {
+    XELOGE("Failed to open {} for replaying the controller states",
+           xe::path_to_utf8(cvars::input_replay_path));
+    return false;
+  }
+  RecordingHeader header;
+  if (std::fread(&header, sizeof(header), 1, file) != 1 ||
+      header.magic != kRecordingMagic ||
+      header.version != kRecordingVersion) {
+    XELOGE("{} is not a controller state recording of this version",
+           xe::path_to_utf8(cvars::input_replay_path));
+    std::fclose(file);
+    return false;
+  }
+  RecordedState state;
+  while (std::fread(&state, sizeof(state), 1, file) == 1) {
+    if (state.user_index == kRecordingEndUserIndex) {
+      replay_end_frame_ = state.frame;
+      break;
+    }
+    if (state.user_index < XUserMaxUserCount) {
+      replay_states_.push_back(state);
+    }
+  }
+  std::fclose(file);
+  if (!replay_end_frame_) {
+    // Recording not ended properly, replaying until the last state.
+    replay_end_frame_ =
+        replay_states_.empty() ? 0 : replay_states_.back().frame;
+  }
+  Clock::set_guest_system_time_base(header.guest_system_time_base);
+  XELOGI("Replaying {} controller states over {} frames",
+         replay_states_.size(), replay_end_frame_);
+  return true;
+}
+
+void InputSystem::OnGuestSwap() {
+  uint32_t frame = guest_frame_.fetch_add(1, std::memory_order_relaxed) + 1;
+  if (!is_replaying_) {
+    return;
+  }
+  if (frame == 1) {
+    replay_start_ticks_ = Clock::QueryHostTickCount();
+  } else if (frame == replay_end_frame_) {
+    uint64_t elapsed_ticks = Clock::QueryHostTickCount() - replay_start_ticks_;
+    double elapsed_ms = double(elapsed_ticks) * 1000.0 /
+                        double(Clock::QueryHostTickFrequency());
+    XELOGI(
+        "Replayed the controller states of {} frames in {:.1f} ms, {:.3f} ms "
+        "per frame",
+        frame - 1, elapsed_ms, elapsed_ms / double(frame - 1));
+  }
+}
+
+void InputSystem::RecordState(uint32_t user_index, X_RESULT result,
+                              const X_INPUT_STATE& state) {
+  std::lock_guard<std::mutex> recording_lock(recording_mutex_);
+  if (!recording_file_) {
+    return;
+  }
+  RecordedState& last_state = last_recorded_states_[user_index];
+  if (last_state.result == result &&
+      !std::memcmp(&last_state.state, &state, sizeof(state))) {
+    return;
+  }
+  last_state.frame = guest_frame_.load(std::memory_order_relaxed);
+  last_state.user_index = user_index;
+  last_state.result = result;
+  last_state.state = state;
+  std::fwrite(&last_state, sizeof(last_state), 1, recording_file_);
+}
 
-X_STATUS InputSystem::Setup() { return X_STATUS_SUCCESS; }
+X_RESULT InputSystem::GetReplayedState(uint32_t user_index,
+                                       X_INPUT_STATE* out_state) {
+  if (user_index >= XUserMaxUserCount) {
+    return X_ERROR_DEVICE_NOT_CONNECTED;
+  }
+  std::lock_guard<std::mutex> recording_lock(recording_mutex_);
+  uint32_t frame = guest_frame_.load(std::memory_order_relaxed);
+  while (replay_next_state_ < replay_states_.size() &&
+         replay_states_[replay_next_state_].frame <= frame) {
+    const RecordedState& state = replay_states_[replay_next_state_++];
+    replayed_states_[state.user_index] = state;
+  }
+  const RecordedState& state = replayed_states_[user_index];
+  if (state.result == X_ERROR_SUCCESS && out_state) {
+    *out_state = state.state;
+  }
+  return state.result;
+}
 
 void InputSystem::AddDriver(std::unique_ptr<InputDriver> driver) {
   drivers_.push_back(std::move(driver));
@@ -89,6 +273,47 @@ X_RESULT InputSystem::GetCapabilities(uint32_t user_index, uint32_t flags,
 }
 
 X_RESULT InputSystem::GetState(uint32_t user_index, X_INPUT_STATE* out_state) {
+  if (is_replaying_) {
+    return GetReplayedState(user_index, out_state);
+  }
+  X_RESULT result = GetLiveState(user_index, out_state);
+  if (is_recording_ && out_state && user_index < XUserMaxUserCount) {
+    RecordState(user_index, result,
+                result == X_ERROR_SUCCESS ? *out_state : X_INPUT_STATE{});
+  }
+  return result;
+}
+
+X_RESULT InputSystem::GetLiveState(uint32_t user_index,
+                                   X_INPUT_STATE* out_state) {
+  if (!poll_thread_ || user_index >= XUserMaxUserCount) {
+    return GetDriverState(user_index, out_state);
+  }
+  const PolledState& polled_state = polled_states_[user_index];
+  uint32_t sequence;
+  X_RESULT result;
+  uint64_t state_words[2];
+  while (true) {
+    sequence = polled_state.sequence.load(std::memory_order_acquire);
+    if (sequence & 1) {
+      continue;
+    }
+    result = polled_state.result.load(std::memory_order_relaxed);
+    state_words[0] = polled_state.state[0].load(std::memory_order_relaxed);
+    state_words[1] = polled_state.state[1].load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (polled_state.sequence.load(std::memory_order_relaxed) == sequence) {
+      break;
+    }
+  }
+  if (result == X_ERROR_SUCCESS && out_state) {
+    std::memcpy(out_state, state_words, sizeof(*out_state));
+  }
+  return result;
+}
+
+X_RESULT InputSystem::GetDriverState(uint32_t user_index,
+                                     X_INPUT_STATE* out_state) {
   SCOPE_profile_cpu_f("hid");
 
   bool any_connected = false;
@@ -100,6 +325,7 @@ X_RESULT InputSystem::GetState(uint32_t user_index, X_INPUT_STATE* out_state) {
     if (result == X_ERROR_SUCCESS) {
       UpdateUsedSlot(driver.get(), user_index, any_connected);
       AdjustDeadzoneLevels(user_index, &out_state->gamepad);
+      input_latency::OnStateProduced(user_index, out_state->packet_number);
 
       if (out_state->gamepad.buttons != 0) {
         last_used_slot = user_index;
@@ -111,6 +337,34 @@ X_RESULT InputSystem::GetState(uint32_t user_index, X_INPUT_STATE* out_state) {
   return any_connected ? X_ERROR_EMPTY : X_ERROR_DEVICE_NOT_CONNECTED;
 }
 
+void InputSystem::PollDriverStates() {
+  auto lock = this->lock();
+  for (uint32_t user_index = 0; user_index < XUserMaxUserCount; ++user_index) {
+    X_INPUT_STATE state = {};
+    X_RESULT result = GetDriverState(user_index, &state);
+    uint64_t state_words[2];
+    std::memcpy(state_words, &state, sizeof(state));
+    PolledState& polled_state = polled_states_[user_index];
+    uint32_t sequence = polled_state.sequence.load(std::memory_order_relaxed);
+    polled_state.sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    polled_state.result.store(result, std::memory_order_relaxed);
+    polled_state.state[0].store(state_words[0], std::memory_order_relaxed);
+    polled_state.state[1].store(state_words[1], std::memory_order_relaxed);
+    polled_state.sequence.store(sequence + 2, std::memory_order_release);
+  }
+}
+
+void InputSystem::PollThread() {
+  const uint32_t poll_rate = std::max(uint32_t(cvars::input_poll_rate), 1u);
+  const std::chrono::milliseconds poll_interval(
+      std::max(1000u / poll_rate, 1u));
+  while (threading::Wait(poll_thread_stop_.get(), false, poll_interval) ==
+         threading::WaitResult::kTimeout) {
+    PollDriverStates();
+  }
+}
+
 X_RESULT InputSystem::SetState(uint32_t user_index,
                                X_INPUT_VIBRATION* vibration) {
   SCOPE_profile_cpu_f("hid");
@@ -10,10 +10,15 @@
 #ifndef XENIA_HID_INPUT_SYSTEM_H_
 #define XENIA_HID_INPUT_SYSTEM_H_
 
+#include <array>
+#include <atomic>
 #include <bitset>
+#include <cstdio>
 #include <memory>
+#include <mutex>
 #include <vector>
 #include "xenia/base/mutex.h"
+#include "xenia/base/threading.h"
 #include "xenia/hid/input.h"
 #include "xenia/hid/input_driver.h"
 #include "xenia/xbox.h"
@@ -34,17 +39,26 @@ class InputSystem {
 
   xe::ui::Window* window() const { return window_; }
 
+  // Starts polling the drivers if enabled, after all drivers were added.
   X_STATUS Setup();
+  void Shutdown();
 
   void AddDriver(std::unique_ptr<InputDriver> driver);
 
   X_RESULT GetCapabilities(uint32_t user_index, uint32_t flags,
                            X_INPUT_CAPABILITIES* out_caps);
+  // While polling, returns the latest polled state of the user without
+  // calling the drivers, and doesn't require the lock.
   X_RESULT GetState(uint32_t user_index, X_INPUT_STATE* out_state);
   X_RESULT SetState(uint32_t user_index, X_INPUT_VIBRATION* vibration);
   X_RESULT GetKeystroke(uint32_t user_index, uint32_t flags,
                         X_INPUT_KEYSTROKE* out_keystroke);
 
+  // Advances the guest frame number the recorded and replayed controller
+  // states (input_record_path and input_replay_path) are tied to, on every
+  // VdSwap.
+  void OnGuestSwap();
+
   bool GetVibrationCvar();
 
   void ToggleVibration();
@@ -57,13 +71,58 @@ class InputSystem {
 
   std::unique_lock<xe_unlikely_mutex> lock();
 
+  bool is_polling() const { return poll_thread_ != nullptr; }
+
  private:
+  // Written by the poll thread only, read by any thread without locking. The
+  // sequence is odd while the state is being written.
+  struct PolledState {
+    std::atomic<uint32_t> sequence = 0;
+    std::atomic<uint32_t> result = X_ERROR_DEVICE_NOT_CONNECTED;
+    std::array<std::atomic<uint64_t>, 2> state = {};
+  };
+  static_assert(sizeof(X_INPUT_STATE) == sizeof(uint64_t) * 2);
+
+  // A state of a user, recorded when it differs from the previous one of the
+  // user, and applied from the guest frame it was read on when replaying. A
+  // state with user_index kRecordingEndUserIndex marks the frame recording
+  // ended on.
+  struct RecordedState {
+    uint32_t frame;
+    uint32_t user_index;
+    X_RESULT result;
+    X_INPUT_STATE state;
+  };
+  static_assert(sizeof(RecordedState) == sizeof(uint32_t) * 3 +
+                                             sizeof(X_INPUT_STATE));
+  static constexpr uint32_t kRecordingEndUserIndex = UINT32_MAX;
+  struct RecordingHeader {
+    fourcc_t magic;
+    uint32_t version;
+    // Clock::guest_system_time_base of the recorded session, for the guest
+    // to see the same system time, like KeQuerySystemTime, when replaying.
+    uint64_t guest_system_time_base;
+  };
+  static constexpr fourcc_t kRecordingMagic = make_fourcc("XIRC");
+  static constexpr uint32_t kRecordingVersion = 1;
+
   typedef std::pair<uint16_t, uint16_t> joystick_value;
 
   const std::string controller_slot_state_change_message[2] = {
       "Controller disconnected from slot {}.",
       "New controller connected to slot {}."};
 
+  X_RESULT GetLiveState(uint32_t user_index, X_INPUT_STATE* out_state);
+  X_RESULT GetDriverState(uint32_t user_index, X_INPUT_STATE* out_state);
+  bool BeginRecording();
+  bool BeginReplay();
+  void RecordState(uint32_t user_index, X_RESULT result,
+                   const X_INPUT_STATE& state);
+  X_RESULT GetReplayedState(uint32_t user_index, X_INPUT_STATE* out_state);
+  // Stores the states of all users from the drivers.
+  void PollDriverStates();
+  void PollThread();
+
   void UpdateUsedSlot(InputDriver* driver, uint8_t slot, bool connected);
   void AdjustDeadzoneLevels(const uint8_t slot, X_INPUT_GAMEPAD* gamepad);
   X_INPUT_VIBRATION ModifyVibrationLevel(X_INPUT_VIBRATION* vibration);
@@ -78,6 +137,23 @@ class InputSystem {
   uint32_t last_used_slot = 0;
 
   xe_unlikely_mutex lock_;
+
+  std::array<PolledState, XUserMaxUserCount> polled_states_;
+  std::unique_ptr<threading::Thread> poll_thread_;
+  std::unique_ptr<threading::Event> poll_thread_stop_;
+
+  std::atomic<uint32_t> guest_frame_ = 0;
+  // Protects the recorded and the replayed states.
+  std::mutex recording_mutex_;
+  bool is_recording_ = false;
+  FILE* recording_file_ = nullptr;
+  std::array<RecordedState, XUserMaxUserCount> last_recorded_states_;
+  bool is_replaying_ = false;
+  std::vector<RecordedState> replay_states_;
+  size_t replay_next_state_ = 0;
+  std::array<RecordedState, XUserMaxUserCount> replayed_states_;
+  uint32_t replay_end_frame_ = 0;
+  uint64_t replay_start_ticks_ = 0;
 };
 
 }  // namespace hid
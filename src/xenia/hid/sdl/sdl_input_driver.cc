@@ -579,6 +579,7 @@ void SDLInputDriver::OnControllerDeviceAxisMotion(const SDL_Event& event) {
       break;
   }
   controllers_.at(*idx).state_changed = true;
+  OnHostInputEvent(uint32_t(*idx));
 }
 
 void SDLInputDriver::OnControllerDeviceButtonChanged(const SDL_Event& event) {
@@ -641,6 +642,7 @@ void SDLInputDriver::OnControllerDeviceButtonChanged(const SDL_Event& event) {
   }
   controller.state.gamepad.buttons = xbuttons;
   controller.state_changed = true;
+  OnHostInputEvent(uint32_t(*idx));
 }
 
 std::optional<size_t> SDLInputDriver::GetControllerIndexFromInstanceID(
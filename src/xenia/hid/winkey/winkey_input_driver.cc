@@ -330,6 +330,7 @@ void WinKeyInputDriver::OnKey(ui::KeyEvent& e, bool is_down) {
   key.transition = is_down;
   key.prev_state = e.prev_state();
   key.repeat_count = e.repeat_count();
+  OnHostInputEvent(uint32_t(cvars::keyboard_user_index));
 
   auto global_lock = global_critical_region_.Acquire();
   key_events_.push(key);
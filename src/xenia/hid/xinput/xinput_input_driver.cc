@@ -161,6 +161,12 @@ X_RESULT XInputInputDriver::GetState(uint32_t user_index,
     return result;
   }
 
+  // XInput has no events, the host input is timestamped when polled.
+  if (user_index < last_packet_numbers_.size() &&
+      last_packet_numbers_[user_index] != native_state.state.dwPacketNumber) {
+    last_packet_numbers_[user_index] = native_state.state.dwPacketNumber;
+    OnHostInputEvent(user_index);
+  }
   out_state->packet_number = native_state.state.dwPacketNumber;
   if (is_active()) {
     out_state->gamepad.buttons = native_state.state.Gamepad.wButtons;
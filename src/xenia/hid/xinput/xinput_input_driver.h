@@ -10,6 +10,8 @@
 #ifndef XENIA_HID_XINPUT_XINPUT_INPUT_DRIVER_H_
 #define XENIA_HID_XINPUT_XINPUT_INPUT_DRIVER_H_
 
+#include <array>
+
 #include "xenia/hid/input_driver.h"
 
 namespace xe {
@@ -38,6 +40,8 @@ class XInputInputDriver final : public InputDriver {
   void* XInputGetKeystroke_;
   void* XInputSetState_;
   void* XInputEnable_;
+
+  std::array<uint32_t, XUserMaxUserCount> last_packet_numbers_ = {};
 };
 
 }  // namespace xinput
@@ -0,0 +1,66 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2026 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/kernel/guest_run_slots.h"
+
+#include "xenia/base/cvar.h"
+#include "xenia/kernel/host_core_scheduler.h"
+
+DEFINE_bool(cooperative_guest_scheduling, false,
+            "Lets at most as many guest threads as the console has HW threads "
+            "execute at the same time, switching between them when they wait "
+            "or sleep. May reduce host context switching in titles with many "
+            "worker threads.",
+            "Kernel");
+DEFINE_uint32(cooperative_guest_scheduling_timeout_us, 2000,
+              "Time after which a guest thread waiting for its turn with "
+              "cooperative_guest_scheduling runs anyway, in case the running "
+              "threads are busy-waiting for it.",
+              "Kernel");
+
+namespace xe {
+namespace kernel {
+
+GuestRunSlots* GuestRunSlots::GetShared() {
+  static GuestRunSlots* const shared =
+      cvars::cooperative_guest_scheduling
+          ? new GuestRunSlots(
+                HostCoreScheduler::kHwThreadCount,
+                std::chrono::microseconds(
+                    cvars::cooperative_guest_scheduling_timeout_us))
+          : nullptr;
+  return shared;
+}
+
+bool GuestRunSlots::Acquire() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  ++waiting_count_;
+  bool acquired = slot_freed_cond_.wait_for(
+      lock, admission_timeout_, [this]() { return free_slots_ > 0; });
+  --waiting_count_;
+  --free_slots_;
+  if (!acquired) {
+    ++overcommit_count_;
+  }
+  return acquired;
+}
+
+void GuestRunSlots::Release() {
+  bool notify;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    notify = ++free_slots_ > 0 && waiting_count_;
+  }
+  if (notify) {
+    slot_freed_cond_.notify_one();
+  }
+}
+
+}  // namespace kernel
+}  // namespace xe
@@ -0,0 +1,67 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2026 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#ifndef XENIA_KERNEL_GUEST_RUN_SLOTS_H_
+#define XENIA_KERNEL_GUEST_RUN_SLOTS_H_
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+
+namespace xe {
+namespace kernel {
+
+// Limits the number of guest threads executing guest code at the same time
+// with cooperative_guest_scheduling, like the six HW threads of the console.
+// A guest thread holds a run slot while it's executing, and gives it to
+// another guest thread while waiting on a host primitive or sleeping, so
+// titles creating many more threads than there are HW threads don't have all
+// of them contending for the host processors at once.
+//
+// Guest code may busy-wait for a thread that has no slot, and titles rely on
+// the console kernel preempting threads in this case, so a thread that hasn't
+// been given a slot within the admission timeout runs without one.
+class GuestRunSlots {
+ public:
+  GuestRunSlots(uint32_t slot_count,
+                std::chrono::microseconds admission_timeout)
+      : free_slots_(int32_t(slot_count)),
+        admission_timeout_(admission_timeout) {}
+  GuestRunSlots(const GuestRunSlots&) = delete;
+  GuestRunSlots& operator=(const GuestRunSlots&) = delete;
+
+  // The slots shared by all guest threads, null if
+  // cooperative_guest_scheduling is disabled.
+  static GuestRunSlots* GetShared();
+
+  // Returns false if the thread was admitted without a free slot after the
+  // timeout. Release must be called either way.
+  bool Acquire();
+  void Release();
+
+  uint64_t overcommit_count() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return overcommit_count_;
+  }
+
+ private:
+  mutable std::mutex mutex_;
+  std::condition_variable slot_freed_cond_;
+  // Negative while threads are admitted without a slot.
+  int32_t free_slots_;
+  uint32_t waiting_count_ = 0;
+  uint64_t overcommit_count_ = 0;
+  std::chrono::microseconds admission_timeout_;
+};
+
+}  // namespace kernel
+}  // namespace xe
+
+#endif  // XENIA_KERNEL_GUEST_RUN_SLOTS_H_
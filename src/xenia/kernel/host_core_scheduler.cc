@@ -0,0 +1,251 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2023 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/kernel/host_core_scheduler.h"
+
+#include <algorithm>
+#include <charconv>
+#include <string_view>
+#include <vector>
+
+#include "xenia/base/cvar.h"
+#include "xenia/base/logging.h"
+#include "xenia/base/math.h"
+#include "xenia/base/threading.h"
+#include "xenia/base/utf8.h"
+
+DEFINE_bool(pin_guest_threads, false,
+            "Pins guest threads to host cores by the HW thread they have "
+            "affinity to, and emulator threads to the remaining host cores. "
+            "Overrides ignore_thread_affinities.",
+            "Kernel");
+DEFINE_string(guest_thread_host_processors, "",
+              "Host logical processors for HW threads 0 to 5 with "
+              "pin_guest_threads, as a list like \"2,3,4,5,6,7\". Chosen from "
+              "the host topology if empty.",
+              "Kernel");
+DEFINE_string(worker_thread_host_processors, "",
+              "Host logical processors for emulator threads with "
+              "pin_guest_threads, as a list like \"0,1,8-15\". All cores not "
+              "used by HW threads if empty.",
+              "Kernel");
+
+DECLARE_int32(host_numa_node);
+
+namespace xe {
+namespace kernel {
+
+namespace {
+
+// Parses a list of logical processors and ranges of them, like "0,2-3".
+bool ParseProcessorList(const std::string_view list,
+                        std::vector<uint32_t>& processors_out) {
+  processors_out.clear();
+  for (std::string_view part : utf8::split(list, ", ", true)) {
+    uint32_t first, last;
+    size_t dash = part.find('-');
+    std::string_view first_part = part.substr(0, dash);
+    auto result = std::from_chars(
+        first_part.data(), first_part.data() + first_part.size(), first);
+    if (result.ec != std::errc() ||
+        result.ptr != first_part.data() + first_part.size()) {
+      return false;
+    }
+    last = first;
+    if (dash != std::string_view::npos) {
+      std::string_view last_part = part.substr(dash + 1);
+      result = std::from_chars(last_part.data(),
+                               last_part.data() + last_part.size(), last);
+      if (result.ec != std::errc() ||
+          result.ptr != last_part.data() + last_part.size() || last < first) {
+        return false;
+      }
+    }
+    for (uint32_t i = first; i <= last; ++i) {
+      if (i >= 64) {
+        return false;
+      }
+      processors_out.push_back(i);
+    }
+  }
+  return true;
+}
+
+// Returns the cores fully contained in the mask.
+std::vector<uint64_t> FilterCores(const std::vector<uint64_t>& cores,
+                                  uint64_t mask) {
+  std::vector<uint64_t> filtered_cores;
+  for (uint64_t core : cores) {
+    if ((core & mask) == core) {
+      filtered_cores.push_back(core);
+    }
+  }
+  return filtered_cores;
+}
+
+}  // namespace
+
+const HostCoreScheduler& HostCoreScheduler::Get() {
+  static const HostCoreScheduler scheduler;
+  return scheduler;
+}
+
+HostCoreScheduler::HostCoreScheduler() {
+  std::vector<uint64_t> cores = xe::threading::QueryPhysicalCoreMasks();
+  std::vector<uint64_t> cache_masks =
+      xe::threading::QueryLastLevelCacheMasks();
+  std::vector<uint64_t> node_masks = xe::threading::QueryNumaNodeMasks();
+  XELOGI(
+      "Host topology: {} physical cores, {} last level caches, {} NUMA nodes",
+      cores.size(), cache_masks.size(), node_masks.size());
+
+  if (!cvars::pin_guest_threads) {
+    return;
+  }
+
+  // Keep all the threads on the NUMA node the guest memory is allocated on.
+  if (cvars::host_numa_node >= 0) {
+    uint32_t node = uint32_t(cvars::host_numa_node);
+    std::vector<uint64_t> node_cores;
+    if (node < node_masks.size()) {
+      node_cores = FilterCores(cores, node_masks[node]);
+    }
+    if (node_cores.empty()) {
+      XELOGW(
+          "pin_guest_threads: host NUMA node {} has no known cores, using "
+          "all of them",
+          node);
+    } else {
+      cores = std::move(node_cores);
+    }
+  }
+  uint64_t used_cores = 0;
+  std::vector<uint32_t> processors;
+  if (!cvars::guest_thread_host_processors.empty()) {
+    if (!ParseProcessorList(cvars::guest_thread_host_processors, processors) ||
+        processors.size() != kHwThreadCount) {
+      XELOGE(
+          "pin_guest_threads: guest_thread_host_processors must list {} "
+          "logical processors, not pinning threads",
+          kHwThreadCount);
+      return;
+    }
+    for (uint32_t i = 0; i < kHwThreadCount; ++i) {
+      hw_thread_masks_[i] = uint64_t(1) << processors[i];
+    }
+  } else {
+    // Leave the first core, which usually handles most interrupts, to the
+    // emulator threads and the OS if that still leaves a core for them.
+    size_t smt_core_count = 0;
+    for (uint64_t core : cores) {
+      smt_core_count += xe::bit_count(core) >= 2 ? 1 : 0;
+    }
+    bool use_smt = smt_core_count >= kHwThreadCount / 2 &&
+                   cores.size() > kHwThreadCount / 2;
+    size_t needed_cores = use_smt ? kHwThreadCount / 2 : kHwThreadCount;
+    if (cores.size() <= needed_cores) {
+      XELOGW(
+          "pin_guest_threads: the host has too few cores to keep the HW "
+          "threads and emulator threads apart, not pinning threads");
+      return;
+    }
+    // HW threads communicate with each other constantly, place them within
+    // one last level cache (such as one CCD) if one has enough cores for them
+    // and for an emulator thread, preferring the one with the most cores.
+    std::vector<uint64_t> hw_thread_cores = cores;
+    for (uint64_t cache_mask : cache_masks) {
+      std::vector<uint64_t> cache_cores = FilterCores(cores, cache_mask);
+      if (use_smt) {
+        cache_cores.erase(
+            std::remove_if(
+                cache_cores.begin(), cache_cores.end(),
+                [](uint64_t core) { return xe::bit_count(core) < 2; }),
+            cache_cores.end());
+      }
+      if (cache_cores.size() > needed_cores &&
+          (hw_thread_cores.size() == cores.size() ||
+           cache_cores.size() > hw_thread_cores.size())) {
+        hw_thread_cores = std::move(cache_cores);
+        hw_thread_cache_mask_ = cache_mask;
+      }
+    }
+    size_t core_index = hw_thread_cores.size() > needed_cores + 1 ? 1 : 0;
+    uint32_t hw_thread = 0;
+    for (; core_index < hw_thread_cores.size() && hw_thread < kHwThreadCount;
+         ++core_index) {
+      uint64_t core = hw_thread_cores[core_index];
+      if (use_smt && xe::bit_count(core) < 2) {
+        continue;
+      }
+      used_cores |= core;
+      uint32_t threads_on_core = use_smt ? 2 : 1;
+      for (uint32_t i = 0; i < threads_on_core; ++i) {
+        uint64_t processor = core & ~(core - 1);
+        hw_thread_masks_[hw_thread++] = processor;
+        core &= ~processor;
+      }
+    }
+    if (hw_thread < kHwThreadCount) {
+      XELOGW(
+          "pin_guest_threads: not enough host cores with SMT siblings, not "
+          "pinning threads");
+      return;
+    }
+  }
+
+  if (!cvars::worker_thread_host_processors.empty()) {
+    if (!ParseProcessorList(cvars::worker_thread_host_processors,
+                            processors) ||
+        processors.empty()) {
+      XELOGE(
+          "pin_guest_threads: invalid worker_thread_host_processors, not "
+          "pinning emulator threads");
+    } else {
+      for (uint32_t processor : processors) {
+        worker_mask_ |= uint64_t(1) << processor;
+      }
+    }
+  } else {
+    // Entire cores, so that emulator threads don't share a core with a HW
+    // thread as its SMT sibling either.
+    uint64_t hw_thread_processors = 0;
+    for (uint64_t mask : hw_thread_masks_) {
+      hw_thread_processors |= mask;
+    }
+    // Prefer the cores sharing the cache with the HW threads, so the data
+    // produced by them, such as the GPU command buffer, stays in the cache, if
+    // there are enough of them not to serialize the emulator threads.
+    uint64_t cache_worker_mask = 0;
+    uint32_t cache_worker_core_count = 0;
+    for (uint64_t core : cores) {
+      if (!(core & (used_cores | hw_thread_processors))) {
+        worker_mask_ |= core;
+        if ((core & hw_thread_cache_mask_) == core) {
+          cache_worker_mask |= core;
+          ++cache_worker_core_count;
+        }
+      }
+    }
+    if (cache_worker_core_count >= 2) {
+      worker_mask_ = cache_worker_mask;
+    }
+  }
+
+  enabled_ = true;
+  XELOGI(
+      "pin_guest_threads: HW threads on host processors {}, {}, {}, {}, {}, "
+      "{}, emulator threads on mask {:016X}",
+      xe::tzcnt(hw_thread_masks_[0]), xe::tzcnt(hw_thread_masks_[1]),
+      xe::tzcnt(hw_thread_masks_[2]), xe::tzcnt(hw_thread_masks_[3]),
+      xe::tzcnt(hw_thread_masks_[4]), xe::tzcnt(hw_thread_masks_[5]),
+      worker_mask_);
+}
+
+}  // namespace kernel
+}  // namespace xe
@@ -0,0 +1,54 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2023 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#ifndef XENIA_KERNEL_HOST_CORE_SCHEDULER_H_
+#define XENIA_KERNEL_HOST_CORE_SCHEDULER_H_
+
+#include <cstdint>
+
+namespace xe {
+namespace kernel {
+
+// Assignment of XThreads to host logical processors with pin_guest_threads.
+// Guest threads run on the host processor chosen for the Xenon HW thread they
+// have affinity to, and emulator host threads (command processor, XMA, audio,
+// kernel dispatch) on the host cores not used for HW threads, so that the two
+// don't evict each other's caches.
+//
+// Without an explicit assignment, the two HW threads of each Xenon core are
+// put on the SMT siblings of one host core if the host has SMT, like on the
+// console, otherwise one host core is used per HW thread.
+class HostCoreScheduler {
+ public:
+  static constexpr uint32_t kHwThreadCount = 6;
+
+  static const HostCoreScheduler& Get();
+
+  bool enabled() const { return enabled_; }
+  // Host affinity mask for guest threads on the HW thread.
+  uint64_t hw_thread_mask(uint8_t hw_thread) const {
+    return hw_thread_masks_[hw_thread];
+  }
+  // Host affinity mask for emulator threads, 0 to leave them unpinned.
+  uint64_t worker_mask() const { return worker_mask_; }
+
+ private:
+  HostCoreScheduler();
+
+  bool enabled_ = false;
+  uint64_t hw_thread_masks_[kHwThreadCount] = {};
+  uint64_t worker_mask_ = 0;
+  // The last level cache the HW threads are placed in, or 0 if spread.
+  uint64_t hw_thread_cache_mask_ = 0;
+};
+
+}  // namespace kernel
+}  // namespace xe
+
+#endif  // XENIA_KERNEL_HOST_CORE_SCHEDULER_H_
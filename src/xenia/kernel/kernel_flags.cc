@@ -14,3 +14,7 @@ DEFINE_bool(headless, false,
             "UI");
 DEFINE_bool(log_high_frequency_kernel_calls, false,
             "Log kernel calls with the kHighFrequency tag.", "Kernel");
+DEFINE_bool(kernel_call_stats, false,
+            "Count the calls to each kernel export and the host time spent in "
+            "them, shown in CPU > Kernel Call Statistics.",
+            "Kernel");
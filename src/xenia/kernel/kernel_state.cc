@@ -14,12 +14,18 @@
 #include "third_party/fmt/include/fmt/format.h"
 #include "xenia/base/assert.h"
 #include "xenia/base/byte_stream.h"
+#include "xenia/base/clock.h"
 #include "xenia/base/logging.h"
+#include "xenia/base/metrics.h"
+#include "xenia/base/startup_timeline.h"
 #include "xenia/base/string.h"
 #include "xenia/cpu/processor.h"
 #include "xenia/emulator.h"
 #include "xenia/hid/input_system.h"
+#include "xenia/kernel/socket_io_engine.h"
 #include "xenia/kernel/user_module.h"
+#include "xenia/kernel/util/adaptive_spin.h"
+#include "xenia/kernel/util/kernel_call_stats.h"
 #include "xenia/kernel/util/shim_utils.h"
 #include "xenia/kernel/xam/xam_module.h"
 #include "xenia/kernel/xboxkrnl/xboxkrnl_memory.h"
@@ -40,6 +46,20 @@ DEFINE_bool(apply_title_update, true, "Apply title updates.", "Kernel");
 DEFINE_uint32(kernel_build_version, 1888, "Define current kernel version",
               "Kernel");
 
+DEFINE_uint32(async_file_io_threads, 2,
+              "Number of threads completing reads of files opened for "
+              "overlapped access in the background, or 0 to read them on the "
+              "guest thread issuing the read.",
+              "Kernel");
+
+DEFINE_bool(ke_timestamp_bundle_timer, true,
+            "Updates KeTimeStampBundle from a host timer every millisecond. "
+            "If disabled, it is updated only when guest threads query the "
+            "time, finish a wait, or receive an interrupt, which removes "
+            "the periodic host wakeup, but titles polling it in a busy loop "
+            "may only see it advance once per vblank.",
+            "Kernel");
+
 DECLARE_string(cl);
 
 namespace xe {
@@ -47,6 +67,27 @@ namespace kernel {
 
 constexpr uint32_t kDeferredOverlappedDelayMillis = 100;
 
+namespace {
+// Time from queueing a deferred completion until its lane starts running it.
+const metrics::Histogram dispatch_latency_us_[] = {
+    {"Kernel", "dispatch_io_completion_latency_us",
+     "Wait of deferred I/O completions for the dispatch lane, microseconds"},
+    {"Kernel", "dispatch_system_ui_latency_us",
+     "Wait of deferred system UI for the dispatch lane, microseconds"},
+};
+static_assert(
+    xe::countof(dispatch_latency_us_) ==
+        size_t(KernelState::DispatchLane::kCount),
+    "Dispatch lane latency metrics must match the lanes");
+const char* const kDispatchLaneThreadNames[] = {
+    "Kernel Dispatch (I/O Completion)",
+    "Kernel Dispatch (System UI)",
+};
+static_assert(xe::countof(kDispatchLaneThreadNames) ==
+                  size_t(KernelState::DispatchLane::kCount),
+              "Dispatch lane thread names must match the lanes");
+}  // namespace
+
 // This is a global object initialized with the XboxkrnlModule.
 // It references the current kernel state object that all kernel methods should
 // be using to stash their variables.
@@ -63,6 +104,7 @@ KernelState::KernelState(Emulator* emulator)
   assert_null(shared_kernel_state_);
   shared_kernel_state_ = this;
   processor_ = emulator->processor();
+  interrupt_callback_ = std::make_unique<cpu::GuestCallback>();
   file_system_ = emulator->file_system();
   xam_state_ = std::make_unique<xam::XamState>(emulator, this);
 
@@ -79,16 +121,41 @@ KernelState::KernelState(Emulator* emulator)
       kMemoryProtectRead | kMemoryProtectWrite);
 
   xenia_assert(fixed_alloc_worked);
+
+  util::KernelCallStats::Reset();
+  util::KernelCallStats::StartCsvWriter();
 }
 
 KernelState::~KernelState() {
+  util::KernelCallStats::StopCsvWriter();
+
   SetExecutableModule(nullptr);
 
   if (dispatch_thread_running_) {
     dispatch_thread_running_ = false;
-    dispatch_cond_.notify_all();
-    dispatch_thread_->Wait(0, 0, 0, nullptr);
+    for (DispatchLaneState& lane_state : dispatch_lanes_) {
+      lane_state.cond.notify_all();
+    }
+    for (DispatchLaneState& lane_state : dispatch_lanes_) {
+      if (lane_state.thread) {
+        lane_state.thread->Wait(0, 0, 0, nullptr);
+      }
+    }
   }
+  if (file_io_threads_running_) {
+    {
+      std::lock_guard<std::mutex> lock(file_io_mutex_);
+      file_io_threads_running_ = false;
+    }
+    file_io_cond_.notify_all();
+    for (auto& thread : file_io_threads_) {
+      thread->Wait(0, 0, 0, nullptr);
+    }
+    file_io_threads_.clear();
+    file_io_queue_.clear();
+  }
+  // Holds references to sockets and cancels the pending guest operations.
+  socket_io_engine_.reset();
 
   executable_module_.reset();
   user_modules_.clear();
@@ -135,7 +202,18 @@ bool KernelState::is_title_system_type(uint32_t title_id) {
 }
 
 util::XdbfGameData KernelState::title_xdbf() const {
-  return module_xdbf(executable_module_);
+  util::XdbfGameData db = module_xdbf(executable_module_);
+  if (!db.is_valid()) {
+    return db;
+  }
+  std::lock_guard<std::mutex> lock(title_xdbf_mutex_);
+  if (!title_xdbf_ || title_xdbf_->data() != db.data() ||
+      title_xdbf_->data_size() != db.data_size()) {
+    db.BuildIndex();
+    title_xdbf_ = std::make_unique<util::XdbfGameData>(db);
+  }
+  // The copy shares the index.
+  return *title_xdbf_;
 }
 
 util::XdbfGameData KernelState::module_xdbf(
@@ -398,39 +476,68 @@ void KernelState::SetExecutableModule(object_ref<UserModule> module) {
         xboxkrnl::XboxkrnlModule::kExLoadedCommandLineSize);
   }
 
-  // Spin up deferred dispatch worker.
+  // Spin up deferred dispatch workers.
   // TODO(benvanik): move someplace more appropriate (out of ctor, but around
   // here).
   if (!dispatch_thread_running_) {
     dispatch_thread_running_ = true;
-    dispatch_thread_ = object_ref<XHostThread>(new XHostThread(
-        this, 128 * 1024, 0,
-        [this]() {
-          // As we run guest callbacks the debugger must be able to suspend us.
-          dispatch_thread_->set_can_debugger_suspend(true);
-
-          auto global_lock = global_critical_region_.AcquireDeferred();
-          while (dispatch_thread_running_) {
-            global_lock.lock();
-            if (dispatch_queue_.empty()) {
-              dispatch_cond_.wait(global_lock);
-              if (!dispatch_thread_running_) {
-                global_lock.unlock();
+    for (size_t i = 0; i < size_t(DispatchLane::kCount); ++i) {
+      StartDispatchLane(DispatchLane(i));
+    }
+  }
+
+  if (!file_io_threads_running_ && cvars::async_file_io_threads) {
+    file_io_threads_running_ = true;
+    for (uint32_t i = 0; i < cvars::async_file_io_threads; ++i) {
+      auto thread = object_ref<XHostThread>(new XHostThread(
+          this, 128 * 1024, 0,
+          [this]() {
+            std::unique_lock<std::mutex> lock(file_io_mutex_);
+            while (true) {
+              file_io_cond_.wait(lock, [this]() {
+                return !file_io_threads_running_ || !file_io_queue_.empty();
+              });
+              if (!file_io_threads_running_) {
                 break;
               }
+              auto fn = std::move(file_io_queue_.front());
+              file_io_queue_.pop_front();
+              lock.unlock();
+              fn();
+              lock.lock();
             }
-            auto fn = std::move(dispatch_queue_.front());
-            dispatch_queue_.pop_front();
-            global_lock.unlock();
+            return 0;
+          },
+          GetSystemProcess()));
+      thread->set_name(fmt::format("Kernel File I/O {}", i));
+      thread->Create();
+      file_io_threads_.push_back(std::move(thread));
+    }
+  }
+}
 
-            fn();
-          }
-          return 0;
-        },
-        GetSystemProcess()));  // don't think an equivalent exists on real hw
-    dispatch_thread_->set_name("Kernel Dispatch");
-    dispatch_thread_->Create();
+bool KernelState::QueueFileIO(std::function<void()> fn) {
+  {
+    std::lock_guard<std::mutex> lock(file_io_mutex_);
+    if (!file_io_threads_running_) {
+      return false;
+    }
+    file_io_queue_.push_back(std::move(fn));
   }
+  file_io_cond_.notify_one();
+  return true;
+}
+
+SocketIOEngine* KernelState::socket_io_engine(bool start) {
+  std::lock_guard<std::mutex> lock(socket_io_engine_mutex_);
+  if (start && !socket_io_engine_initialized_) {
+    socket_io_engine_initialized_ = true;
+    auto engine = std::make_unique<SocketIOEngine>();
+    if (engine->Initialize()) {
+      socket_io_engine_ = std::move(engine);
+    }
+  }
+  return socket_io_engine_.get();
 }
 
 void KernelState::LoadKernelModule(object_ref<KernelModule> kernel_module) {
@@ -513,6 +620,7 @@ object_ref<UserModule> KernelState::LoadUserModuleFromMemory(
 
 X_RESULT KernelState::FinishLoadingUserModule(
     const object_ref<UserModule> module, bool call_entry) {
+  SCOPE_startup_timeline("KernelState::FinishLoadingUserModule");
   // TODO(Gliniak): Apply custom patches here
   X_RESULT result = module->LoadContinue();
   if (XFAILED(result)) {
@@ -543,6 +651,7 @@ X_RESULT KernelState::FinishLoadingUserModule(
 
 X_RESULT KernelState::ApplyTitleUpdate(
     const object_ref<UserModule> title_module) {
+  SCOPE_startup_timeline("KernelState::ApplyTitleUpdate");
   const auto title_updates = FindTitleUpdate(title_module->title_id());
   if (title_updates.empty()) {
     return X_STATUS_SUCCESS;
@@ -717,6 +826,8 @@ void KernelState::TerminateTitle() {
   XELOGD("KernelState::TerminateTitle");
   auto global_lock = global_critical_region_.Acquire();
 
+  util::AdaptiveSpin::LogStats();
+
   // Call terminate routines.
   // TODO(benvanik): these might take arguments.
   // FIXME: Calling these will send some threads into kernel code and they'll
@@ -944,15 +1055,17 @@ void KernelState::CompleteOverlappedImmediateEx(uint32_t overlapped_ptr,
 void KernelState::CompleteOverlappedDeferred(
     std::function<void()> completion_callback, uint32_t overlapped_ptr,
     X_RESULT result, std::function<void()> pre_callback,
-    std::function<void()> post_callback) {
+    std::function<void()> post_callback, DispatchLane lane) {
   CompleteOverlappedDeferredEx(std::move(completion_callback), overlapped_ptr,
-                               result, result, 0, pre_callback, post_callback);
+                               result, result, 0, pre_callback, post_callback,
+                               lane);
 }
 
 void KernelState::CompleteOverlappedDeferredEx(
     std::function<void()> completion_callback, uint32_t overlapped_ptr,
     X_RESULT result, uint32_t extended_error, uint32_t length,
-    std::function<void()> pre_callback, std::function<void()> post_callback) {
+    std::function<void()> pre_callback, std::function<void()> post_callback,
+    DispatchLane lane) {
   CompleteOverlappedDeferredEx(
       [completion_callback, result, extended_error, length](
           uint32_t& cb_extended_error, uint32_t& cb_length) -> X_RESULT {
@@ -961,12 +1074,13 @@ void KernelState::CompleteOverlappedDeferredEx(
         cb_length = length;
         return result;
       },
-      overlapped_ptr, pre_callback, post_callback);
+      overlapped_ptr, pre_callback, post_callback, lane);
 }
 
 void KernelState::CompleteOverlappedDeferred(
     std::function<X_RESULT()> completion_callback, uint32_t overlapped_ptr,
-    std::function<void()> pre_callback, std::function<void()> post_callback) {
+    std::function<void()> pre_callback, std::function<void()> post_callback,
+    DispatchLane lane) {
   CompleteOverlappedDeferredEx(
       [completion_callback](uint32_t& extended_error,
                             uint32_t& length) -> X_RESULT {
@@ -975,13 +1089,13 @@ void KernelState::CompleteOverlappedDeferred(
         length = 0;
         return result;
       },
-      overlapped_ptr, pre_callback, post_callback);
+      overlapped_ptr, pre_callback, post_callback, lane);
 }
 
 void KernelState::CompleteOverlappedDeferredEx(
     std::function<X_RESULT(uint32_t&, uint32_t&)> completion_callback,
     uint32_t overlapped_ptr, std::function<void()> pre_callback,
-    std::function<void()> post_callback) {
+    std::function<void()> post_callback, DispatchLane lane) {
   auto ptr = memory()->TranslateVirtual(overlapped_ptr);
   XOverlappedSetResult(ptr, X_ERROR_IO_PENDING);
   XOverlappedSetContext(ptr, XThread::GetCurrentThreadHandle());
@@ -994,22 +1108,66 @@ void KernelState::CompleteOverlappedDeferredEx(
       ev.get<XEvent>()->Reset();
     }
   }
+  DispatchLaneState& lane_state = dispatch_lanes_[size_t(lane)];
   auto global_lock = global_critical_region_.Acquire();
-  dispatch_queue_.push_back([this, completion_callback, overlapped_ptr,
-                             pre_callback, post_callback]() {
-    if (pre_callback) {
-      pre_callback();
-    }
-    xe::threading::Sleep(
-        std::chrono::milliseconds(kDeferredOverlappedDelayMillis));
-    uint32_t extended_error, length;
-    auto result = completion_callback(extended_error, length);
-    CompleteOverlappedEx(overlapped_ptr, result, extended_error, length);
-    if (post_callback) {
-      post_callback();
-    }
-  });
-  dispatch_cond_.notify_all();
+  lane_state.queue.emplace_back(
+      Clock::QueryHostTickCount(),
+      [this, completion_callback, overlapped_ptr, pre_callback,
+       post_callback]() {
+        if (pre_callback) {
+          pre_callback();
+        }
+        xe::threading::Sleep(
+            std::chrono::milliseconds(kDeferredOverlappedDelayMillis));
+        uint32_t extended_error, length;
+        auto result = completion_callback(extended_error, length);
+        CompleteOverlappedEx(overlapped_ptr, result, extended_error, length);
+        if (post_callback) {
+          post_callback();
+        }
+      });
+  lane_state.cond.notify_all();
+}
+
+void KernelState::StartDispatchLane(DispatchLane lane) {
+  DispatchLaneState& lane_state = dispatch_lanes_[size_t(lane)];
+  lane_state.thread = object_ref<XHostThread>(new XHostThread(
+      this, 128 * 1024, 0,
+      [this, lane, &lane_state]() {
+        // As we run guest callbacks the debugger must be able to suspend us.
+        lane_state.thread->set_can_debugger_suspend(true);
+
+        const metrics::Histogram& latency_us =
+            dispatch_latency_us_[size_t(lane)];
+        uint64_t tick_frequency = Clock::QueryHostTickFrequency();
+        auto global_lock = global_critical_region_.AcquireDeferred();
+        std::list<std::pair<uint64_t, std::function<void()>>> batch;
+        while (dispatch_thread_running_) {
+          global_lock.lock();
+          while (lane_state.queue.empty() && dispatch_thread_running_) {
+            lane_state.cond.wait(global_lock);
+          }
+          if (!dispatch_thread_running_) {
+            global_lock.unlock();
+            break;
+          }
+          // Take everything queued so far at once rather than going back to
+          // the global lock for every function.
+          batch.splice(batch.end(), lane_state.queue);
+          global_lock.unlock();
+
+          for (auto& queued : batch) {
+            latency_us.Record((Clock::QueryHostTickCount() - queued.first) *
+                              1000000 / tick_frequency);
+            queued.second();
+          }
+          batch.clear();
+        }
+        return 0;
+      },
+      GetSystemProcess()));  // don't think an equivalent exists on real hw
+  lane_state.thread->set_name(kDispatchLaneThreadNames[size_t(lane)]);
+  lane_state.thread->Create();
 }
 
 bool KernelState::Save(ByteStream* stream) {
@@ -1085,14 +1243,32 @@ bool KernelState::Save(ByteStream* stream) {
 // this only gets triggered once per ms at most, so fields other than tick count
 // will probably not be updated in a timely manner for guest code that uses them
 void KernelState::UpdateKeTimestampBundle() {
+  // Without the timer, this is called from any thread. Only one of them needs
+  // to do it, and the fields are never moved backwards, in case one raced
+  // with KeQuerySystemTime or was preempted between sampling and storing.
+  if (timestamp_bundle_updating_.exchange(true, std::memory_order_acquire)) {
+    return;
+  }
   X_TIME_STAMP_BUNDLE* lpKeTimeStampBundle =
       memory_->TranslateVirtual<X_TIME_STAMP_BUNDLE*>(ke_timestamp_bundle_ptr_);
   uint32_t uptime_ms = Clock::QueryGuestUptimeMillis();
-  xe::store_and_swap<uint64_t>(&lpKeTimeStampBundle->interrupt_time,
-                               Clock::QueryGuestInterruptTime());
-  xe::store_and_swap<uint64_t>(&lpKeTimeStampBundle->system_time,
-                               Clock::QueryGuestSystemTime());
-  xe::store_and_swap<uint32_t>(&lpKeTimeStampBundle->tick_count, uptime_ms);
+  uint64_t interrupt_time = Clock::QueryGuestInterruptTime();
+  uint64_t system_time = Clock::QueryGuestSystemTime();
+  if (interrupt_time >
+      xe::load_and_swap<uint64_t>(&lpKeTimeStampBundle->interrupt_time)) {
+    xe::store_and_swap<uint64_t>(&lpKeTimeStampBundle->interrupt_time,
+                                 interrupt_time);
+  }
+  if (system_time >
+      xe::load_and_swap<uint64_t>(&lpKeTimeStampBundle->system_time)) {
+    xe::store_and_swap<uint64_t>(&lpKeTimeStampBundle->system_time,
+                                 system_time);
+  }
+  if (int32_t(uptime_ms - xe::load_and_swap<uint32_t>(
+                              &lpKeTimeStampBundle->tick_count)) > 0) {
+    xe::store_and_swap<uint32_t>(&lpKeTimeStampBundle->tick_count, uptime_ms);
+  }
+  timestamp_bundle_updating_.store(false, std::memory_order_release);
 }
 
 uint32_t KernelState::GetKeTimestampBundle() {
@@ -1125,9 +1301,13 @@ uint32_t KernelState::CreateKeTimestampBundle() {
   xe::store_and_swap<uint32_t>(&lpKeTimeStampBundle->padding, 0);
 
   ke_timestamp_bundle_ptr_ = pKeTimeStampBundle;
-  timestamp_timer_ = xe::threading::HighResolutionTimer::CreateRepeating(
-      std::chrono::milliseconds(1),
-      [this]() { this->UpdateKeTimestampBundle(); });
+  if (cvars::ke_timestamp_bundle_timer) {
+    timestamp_timer_ = xe::threading::HighResolutionTimer::CreateRepeating(
+        std::chrono::milliseconds(1),
+        [this]() { this->UpdateKeTimestampBundle(); });
+  } else {
+    ke_timestamp_bundle_on_demand_ = true;
+  }
   return pKeTimeStampBundle;
 }
 
@@ -1206,6 +1386,8 @@ void KernelState::EmulateCPInterruptDPC(uint32_t interrupt_callback,
     return;
   }
 
+  RefreshKeTimestampBundle();
+
   auto thread = kernel::XThread::GetCurrentThread();
   assert_not_null(thread);
 
@@ -1234,8 +1416,8 @@ void KernelState::EmulateCPInterruptDPC(uint32_t interrupt_callback,
   xboxkrnl::xeKeSetCurrentProcessType(X_PROCTYPE_TITLE, current_context);
 
   uint64_t args[] = {source, interrupt_callback_data};
-  processor_->Execute(thread->thread_state(), interrupt_callback, args,
-                      xe::countof(args));
+  interrupt_callback_->Call(thread->thread_state(), interrupt_callback, args,
+                            xe::countof(args));
   xboxkrnl::xeKeSetCurrentProcessType(X_PROCTYPE_IDLE, current_context);
 
   EndDPCImpersonation(current_context, dpc_scope);
@@ -16,6 +16,8 @@
 #include <functional>
 #include <list>
 #include <memory>
+#include <mutex>
+#include <utility>
 #include <vector>
 
 #include "xenia/base/bit_map.h"
@@ -41,6 +43,7 @@ namespace xe {
 class ByteStream;
 class Emulator;
 namespace cpu {
+class GuestCallback;
 class Processor;
 }  // namespace cpu
 }  // namespace xe
@@ -184,6 +187,8 @@ class KernelState {
 
   uint32_t title_id() const;
   static bool is_title_system_type(uint32_t title_id);
+  // Indexed, and cached while the title's XDBF stays at the same location, as
+  // it's queried frequently, for instance, when enumerating achievements.
   util::XdbfGameData title_xdbf() const;
   util::XdbfGameData module_xdbf(object_ref<UserModule> exec_module) const;
 
@@ -273,6 +278,17 @@ class KernelState {
 
   util::NativeList* dpc_list() { return &dpc_list_; }
 
+  // Runs fn on one of the file I/O threads, so that reads of files opened for
+  // overlapped access don't block the issuing guest thread. Jobs run on guest
+  // visible host threads and may queue APCs. Returns false without running fn
+  // if there are no file I/O threads (--async_file_io_threads=0).
+  bool QueueFileIO(std::function<void()> fn);
+
+  // Started on the first overlapped socket operation, unless start is false,
+  // for only looking up the pending operations. Null if not started or if it
+  // couldn't be started.
+  SocketIOEngine* socket_io_engine(bool start = true);
+
   void CompleteOverlapped(uint32_t overlapped_ptr, X_RESULT result);
   void CompleteOverlappedEx(uint32_t overlapped_ptr, X_RESULT result,
                             uint32_t extended_error, uint32_t length);
@@ -281,24 +297,39 @@ class KernelState {
   void CompleteOverlappedImmediateEx(uint32_t overlapped_ptr, X_RESULT result,
                                      uint32_t extended_error, uint32_t length);
 
+  // Deferred completions run in order within a lane, but each lane has its own
+  // host thread, so work that takes long in one lane doesn't delay the others.
+  enum class DispatchLane {
+    // Overlapped operations such as enumeration and content access.
+    kIOCompletion,
+    // System UI, where dialogs block the lane until closed by the user.
+    kSystemUI,
+
+    kCount,
+  };
+
   void CompleteOverlappedDeferred(
       std::function<void()> completion_callback, uint32_t overlapped_ptr,
       X_RESULT result, std::function<void()> pre_callback = nullptr,
-      std::function<void()> post_callback = nullptr);
+      std::function<void()> post_callback = nullptr,
+      DispatchLane lane = DispatchLane::kIOCompletion);
   void CompleteOverlappedDeferredEx(
       std::function<void()> completion_callback, uint32_t overlapped_ptr,
       X_RESULT result, uint32_t extended_error, uint32_t length,
       std::function<void()> pre_callback = nullptr,
-      std::function<void()> post_callback = nullptr);
+      std::function<void()> post_callback = nullptr,
+      DispatchLane lane = DispatchLane::kIOCompletion);
 
   void CompleteOverlappedDeferred(
       std::function<X_RESULT()> completion_callback, uint32_t overlapped_ptr,
       std::function<void()> pre_callback = nullptr,
-      std::function<void()> post_callback = nullptr);
+      std::function<void()> post_callback = nullptr,
+      DispatchLane lane = DispatchLane::kIOCompletion);
   void CompleteOverlappedDeferredEx(
       std::function<X_RESULT(uint32_t&, uint32_t&)> completion_callback,
       uint32_t overlapped_ptr, std::function<void()> pre_callback = nullptr,
-      std::function<void()> post_callback = nullptr);
+      std::function<void()> post_callback = nullptr,
+      DispatchLane lane = DispatchLane::kIOCompletion);
 
   bool Save(ByteStream* stream);
   bool Restore(ByteStream* stream);
@@ -312,6 +343,13 @@ class KernelState {
   XE_COLD
   uint32_t CreateKeTimestampBundle();
   void UpdateKeTimestampBundle();
+  // Brings KeTimeStampBundle up to date when it's not updated by a timer, at
+  // points guest threads pass through the host anyway.
+  void RefreshKeTimestampBundle() {
+    if (ke_timestamp_bundle_on_demand_) {
+      UpdateKeTimestampBundle();
+    }
+  }
 
   void BeginDPCImpersonation(cpu::ppc::PPCContext* context,
                              DPCImpersonationScope& scope);
@@ -329,6 +367,7 @@ class KernelState {
   void SetProcessTLSVars(X_KPROCESS* process, int num_slots, int tls_data_size,
                          int tls_static_data_address);
   void InitializeKernelGuestGlobals();
+  void StartDispatchLane(DispatchLane lane);
 
   std::vector<xam::XCONTENT_AGGREGATE_DATA> FindTitleUpdate(
       const uint32_t title_id) const;
@@ -344,6 +383,8 @@ class KernelState {
   Emulator* emulator_;
   Memory* memory_;
   cpu::Processor* processor_;
+  // For the interrupt callbacks of EmulateCPInterruptDPC, made every vblank.
+  std::unique_ptr<cpu::GuestCallback> interrupt_callback_;
   vfs::VirtualFileSystem* file_system_;
   std::unique_ptr<xam::XamState> xam_state_;
 
@@ -364,15 +405,37 @@ class KernelState {
   uint32_t kernel_guest_globals_ = 0;
 
   std::atomic<bool> dispatch_thread_running_;
-  object_ref<XHostThread> dispatch_thread_;
+  struct DispatchLaneState {
+    object_ref<XHostThread> thread;
+    std::condition_variable_any cond;
+    // Host tick count when queued, for the latency metrics, and the function.
+    // Must be guarded by the global critical region.
+    std::list<std::pair<uint64_t, std::function<void()>>> queue;
+  };
+  DispatchLaneState dispatch_lanes_[size_t(DispatchLane::kCount)];
   // Must be guarded by the global critical region.
   util::NativeList dpc_list_;
-  std::condition_variable_any dispatch_cond_;
-  std::list<std::function<void()>> dispatch_queue_;
+
+  // Unlike the dispatch queue, not guarded by the global critical region, as
+  // the jobs do I/O.
+  std::atomic<bool> file_io_threads_running_ = false;
+  std::vector<object_ref<XHostThread>> file_io_threads_;
+  std::mutex file_io_mutex_;
+  std::condition_variable file_io_cond_;
+  std::list<std::function<void()>> file_io_queue_;
+
+  std::mutex socket_io_engine_mutex_;
+  std::unique_ptr<SocketIOEngine> socket_io_engine_;
+  bool socket_io_engine_initialized_ = false;
+
+  mutable std::mutex title_xdbf_mutex_;
+  mutable std::unique_ptr<util::XdbfGameData> title_xdbf_;
 
   BitMap tls_bitmap_;
   uint32_t ke_timestamp_bundle_ptr_ = 0;
   std::unique_ptr<xe::threading::HighResolutionTimer> timestamp_timer_;
+  bool ke_timestamp_bundle_on_demand_ = false;
+  std::atomic<bool> timestamp_bundle_updating_ = false;
   cpu::backend::GuestTrampolineGroup kernel_trampoline_group_;
   // fixed address referenced by dashboards. Data is currently unknown
   uint32_t strange_hardcoded_page_ = 0x8E038634 & (~0xFFFF);
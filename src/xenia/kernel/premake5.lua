@@ -23,3 +23,5 @@ project("xenia-kernel")
   files({
     "debug_visualizers.natvis",
   })
+
+include("testing")
@@ -0,0 +1,271 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2026 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/kernel/socket_io_engine.h"
+
+#include <chrono>
+#include <utility>
+#include <vector>
+
+#include "xenia/base/logging.h"
+#include "xenia/base/metrics.h"
+#include "xenia/base/platform.h"
+
+#ifdef XE_PLATFORM_WIN32
+// clang-format off
+#include "xenia/base/platform_win.h"
+#include <WS2tcpip.h>
+#include <WinSock2.h>
+// clang-format on
+#else
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+namespace xe {
+namespace kernel {
+
+namespace {
+
+xe::metrics::Histogram socket_io_pending_requests_(
+    "Kernel", "socket_io_pending_requests",
+    "Overlapped socket operations waited for by the socket I/O engine");
+
+#ifdef XE_PLATFORM_WIN32
+using NativeSocket = SOCKET;
+#else
+using NativeSocket = int;
+#endif
+
+void CloseNativeSocket(uint64_t native_socket) {
+#ifdef XE_PLATFORM_WIN32
+  closesocket(NativeSocket(native_socket));
+#else
+  close(NativeSocket(native_socket));
+#endif
+}
+
+}  // namespace
+
+SocketIOEngine::SocketIOEngine() = default;
+
+SocketIOEngine::~SocketIOEngine() { Shutdown(); }
+
+bool SocketIOEngine::Initialize() {
+  NativeSocket native_socket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+#ifdef XE_PLATFORM_WIN32
+  if (native_socket == INVALID_SOCKET) {
+#else
+  if (native_socket < 0) {
+#endif
+    XELOGE("SocketIOEngine: Failed to create the wake-up socket");
+    return false;
+  }
+  wake_socket_ = uint64_t(native_socket);
+
+  sockaddr_in address = {};
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  address.sin_port = 0;
+  socklen_t address_length = sizeof(address);
+  bool connected =
+      bind(native_socket, reinterpret_cast<const sockaddr*>(&address),
+           sizeof(address)) == 0 &&
+      getsockname(native_socket, reinterpret_cast<sockaddr*>(&address),
+                  &address_length) == 0 &&
+      connect(native_socket, reinterpret_cast<const sockaddr*>(&address),
+              address_length) == 0;
+#ifdef XE_PLATFORM_WIN32
+  u_long non_blocking = 1;
+  connected =
+      connected && ioctlsocket(native_socket, FIONBIO, &non_blocking) == 0;
+#else
+  connected =
+      connected && fcntl(native_socket, F_SETFL,
+                         fcntl(native_socket, F_GETFL) | O_NONBLOCK) == 0;
+#endif
+  if (!connected) {
+    XELOGE("SocketIOEngine: Failed to set up the wake-up socket");
+    CloseNativeSocket(wake_socket_);
+    wake_socket_ = uint64_t(-1);
+    return false;
+  }
+
+  running_ = true;
+  thread_ = threading::Thread::Create({}, [this]() { Run(); });
+  if (!thread_) {
+    running_ = false;
+    CloseNativeSocket(wake_socket_);
+    wake_socket_ = uint64_t(-1);
+    return false;
+  }
+  thread_->set_name("Socket I/O");
+  return true;
+}
+
+void SocketIOEngine::Shutdown() {
+  if (thread_) {
+    running_ = false;
+    Wake();
+    threading::Wait(thread_.get(), false);
+    thread_.reset();
+  }
+  if (wake_socket_ != uint64_t(-1)) {
+    CloseNativeSocket(wake_socket_);
+    wake_socket_ = uint64_t(-1);
+  }
+
+  std::vector<std::function<void()>> cancels;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& [id, pending] : requests_) {
+      cancels.push_back(std::move(pending.request.cancel));
+    }
+    requests_.clear();
+  }
+  for (auto& cancel : cancels) {
+    if (cancel) {
+      cancel();
+    }
+  }
+}
+
+void SocketIOEngine::Submit(Request request) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    requests_[next_request_id_++].request = std::move(request);
+  }
+  Wake();
+}
+
+uint32_t SocketIOEngine::Cancel(const XSocket* socket, uint32_t tag) {
+  std::vector<std::function<void()>> cancels;
+  uint32_t cancelled_count = 0;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto it = requests_.begin(); it != requests_.end();) {
+      PendingRequest& pending = it->second;
+      if (pending.request.socket.get() != socket ||
+          (tag && pending.request.tag != tag) || pending.cancelled) {
+        ++it;
+        continue;
+      }
+      ++cancelled_count;
+      if (pending.completing) {
+        // Cancelled by the engine thread unless it completes.
+        pending.cancelled = true;
+        ++it;
+        continue;
+      }
+      cancels.push_back(std::move(pending.request.cancel));
+      it = requests_.erase(it);
+    }
+  }
+  for (auto& cancel : cancels) {
+    if (cancel) {
+      cancel();
+    }
+  }
+  if (cancelled_count) {
+    Wake();
+  }
+  return cancelled_count;
+}
+
+uint32_t SocketIOEngine::pending_count() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return uint32_t(requests_.size());
+}
+
+void SocketIOEngine::Wake() {
+  if (wake_socket_ == uint64_t(-1)) {
+    return;
+  }
+  // If the socket buffer is full, the thread is already being woken up.
+  char wake_byte = 0;
+  send(NativeSocket(wake_socket_), &wake_byte, 1, 0);
+}
+
+void SocketIOEngine::Run() {
+  std::vector<uint64_t> ids;
+  std::vector<XSocket::PollEntry> entries;
+  while (running_) {
+    ids.clear();
+    entries.clear();
+    ids.push_back(0);
+    entries.push_back({wake_socket_, XSocket::kPollRead, 0});
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      for (const auto& [id, pending] : requests_) {
+        if (pending.completing || pending.cancelled) {
+          continue;
+        }
+        ids.push_back(id);
+        entries.push_back(
+            {pending.request.socket->native_handle(),
+             pending.request.write ? uint32_t(XSocket::kPollWrite)
+                                   : uint32_t(XSocket::kPollRead),
+             0});
+      }
+    }
+    socket_io_pending_requests_.Record(entries.size() - 1);
+
+    if (XSocket::Poll(entries.data(), uint32_t(entries.size()), -1) < 0) {
+      XELOGE("SocketIOEngine: Failed to wait for the sockets");
+      threading::Sleep(std::chrono::milliseconds(1));
+      continue;
+    }
+
+    if (entries[0].ready_events) {
+      char wake_bytes[64];
+      while (recv(NativeSocket(wake_socket_), wake_bytes, sizeof(wake_bytes),
+                  0) > 0) {
+      }
+    }
+
+    for (size_t i = 1; i < entries.size(); ++i) {
+      if (!entries[i].ready_events) {
+        continue;
+      }
+      PendingRequest* pending;
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = requests_.find(ids[i]);
+        if (it == requests_.end() || it->second.cancelled) {
+          continue;
+        }
+        pending = &it->second;
+        pending->completing = true;
+      }
+      // Only erased by this thread while completing.
+      bool completed = pending->request.try_complete();
+      std::function<void()> cancel;
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (completed || pending->cancelled) {
+          if (!completed) {
+            cancel = std::move(pending->request.cancel);
+          }
+          requests_.erase(ids[i]);
+        } else {
+          pending->completing = false;
+        }
+      }
+      if (cancel) {
+        cancel();
+      }
+    }
+  }
+}
+
+}  // namespace kernel
+}  // namespace xe
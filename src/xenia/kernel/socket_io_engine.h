@@ -0,0 +1,85 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2026 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#ifndef XENIA_KERNEL_SOCKET_IO_ENGINE_H_
+#define XENIA_KERNEL_SOCKET_IO_ENGINE_H_
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+
+#include "xenia/base/threading.h"
+#include "xenia/kernel/xobject.h"
+#include "xenia/kernel/xsocket.h"
+
+namespace xe {
+namespace kernel {
+
+// Services the overlapped operations on all guest sockets from one host
+// thread waiting for any of the sockets to become ready, instead of a guest
+// (or a host) thread blocked in a host call for every pending operation.
+class SocketIOEngine {
+ public:
+  struct Request {
+    object_ref<XSocket> socket;
+    // Waiting for the socket to become writable rather than readable.
+    bool write = false;
+    // Identifies the request for cancellation, such as its guest overlapped
+    // structure address.
+    uint32_t tag = 0;
+    // Called on the engine thread when the socket is ready. Must not block,
+    // returns false if the operation would still block, to wait again.
+    std::function<bool()> try_complete;
+    // Called instead of completing if the request is cancelled, including
+    // when the engine is shut down.
+    std::function<void()> cancel;
+  };
+
+  SocketIOEngine();
+  ~SocketIOEngine();
+
+  bool Initialize();
+  void Shutdown();
+
+  void Submit(Request request);
+  // Cancels the pending requests on the socket with the tag, or all of them
+  // if the tag is 0. Returns the number of requests cancelled.
+  uint32_t Cancel(const XSocket* socket, uint32_t tag = 0);
+
+  uint32_t pending_count() const;
+
+ private:
+  struct PendingRequest {
+    Request request;
+    // Being completed by the engine thread, outside the lock.
+    bool completing = false;
+    bool cancelled = false;
+  };
+
+  void Wake();
+  void Run();
+
+  mutable std::mutex mutex_;
+  uint64_t next_request_id_ = 1;
+  std::map<uint64_t, PendingRequest> requests_;
+
+  // A loopback datagram socket connected to itself, written to for waking
+  // the thread up when the requests change.
+  uint64_t wake_socket_ = uint64_t(-1);
+  std::atomic<bool> running_ = false;
+  std::unique_ptr<threading::Thread> thread_;
+};
+
+}  // namespace kernel
+}  // namespace xe
+
+#endif  // XENIA_KERNEL_SOCKET_IO_ENGINE_H_
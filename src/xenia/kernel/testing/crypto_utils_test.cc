@@ -0,0 +1,87 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2026 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "xenia/kernel/util/crypto_utils.h"
+
+#include "third_party/catch/include/catch.hpp"
+
+namespace xe::kernel::test {
+
+namespace {
+
+std::vector<uint8_t> FromHex(const char* hex) {
+  std::vector<uint8_t> bytes;
+  for (; hex[0] && hex[1]; hex += 2) {
+    bytes.push_back(uint8_t(std::stoul(std::string(hex, 2), nullptr, 16)));
+  }
+  return bytes;
+}
+
+std::vector<uint8_t> Sha1Digest(const void* data, size_t size,
+                                size_t chunk_size) {
+  util::Sha1 sha1;
+  auto bytes = reinterpret_cast<const uint8_t*>(data);
+  for (size_t offset = 0; offset < size; offset += chunk_size) {
+    sha1.Update(bytes + offset, std::min(chunk_size, size - offset));
+  }
+  std::vector<uint8_t> digest(util::Sha1::kDigestSize);
+  sha1.Finalize(digest.data());
+  return digest;
+}
+
+}  // namespace
+
+TEST_CASE("AES-128 CBC decryption", "[crypto_utils]") {
+  // SP 800-38A F.2.1 plaintext and key, with a zero IV.
+  auto key = FromHex("2B7E151628AED2A6ABF7158809CF4F3C");
+  auto ciphertext = FromHex(
+      "3AD77BB40D7A3660A89ECAF32466EF97B148C17F309EE692287AE57CF12ADD49"
+      "C93D11BFAF08C5DC4D90B37B4DEE002BA7356E1207BB406639E5E5CEB9A9ED93");
+  auto plaintext = FromHex(
+      "6BC1BEE22E409F96E93D7E117393172AAE2D8A571E03AC9C9EB76FAC45AF8E51"
+      "30C81C46A35CE411E5FBC1191A0A52EFF69F2445DF4F9B17AD2B417BE66C3710");
+
+  std::vector<uint8_t> output(ciphertext.size());
+  util::Aes128CbcDecryptor(key.data())
+      .Decrypt(ciphertext.data(), ciphertext.size(), output.data());
+  REQUIRE(output == plaintext);
+
+  // In place, chained across the calls.
+  output = ciphertext;
+  util::Aes128CbcDecryptor decryptor(key.data());
+  decryptor.Decrypt(output.data(), 16, output.data());
+  decryptor.Decrypt(output.data() + 16, output.size() - 16,
+                    output.data() + 16);
+  REQUIRE(output == plaintext);
+}
+
+TEST_CASE("SHA-1 digests", "[crypto_utils]") {
+  const char abc[] = "abc";
+  REQUIRE(Sha1Digest(abc, 3, 3) ==
+          FromHex("A9993E364706816ABA3E25717850C26C9CD0D89D"));
+
+  // Padded to two blocks.
+  const char two_blocks[] =
+      "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq";
+  REQUIRE(Sha1Digest(two_blocks, std::strlen(two_blocks), 5) ==
+          FromHex("84983E441C3BD26EBAAE4AA1F95129E5E54670F1"));
+
+  std::vector<uint8_t> million_a(1000000, 'a');
+  REQUIRE(Sha1Digest(million_a.data(), million_a.size(), 1000) ==
+          FromHex("34AA973CD4C4DAA4F61EEB2BDBAD27316534016F"));
+  REQUIRE(Sha1Digest(million_a.data(), million_a.size(), 100) ==
+          FromHex("34AA973CD4C4DAA4F61EEB2BDBAD27316534016F"));
+}
+
+}  // namespace xe::kernel::test
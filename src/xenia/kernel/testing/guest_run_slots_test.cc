@@ -0,0 +1,56 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2026 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include "xenia/kernel/guest_run_slots.h"
+
+#include "third_party/catch/include/catch.hpp"
+
+namespace xe::kernel::test {
+
+TEST_CASE("Guest run slots are handed over on release", "[run_slots]") {
+  GuestRunSlots slots(1, std::chrono::seconds(10));
+  REQUIRE(slots.Acquire());
+
+  std::atomic<bool> acquired = false;
+  std::thread waiter([&]() {
+    acquired = slots.Acquire();
+    slots.Release();
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  REQUIRE_FALSE(acquired);
+  slots.Release();
+  waiter.join();
+  REQUIRE(acquired);
+  REQUIRE(slots.overcommit_count() == 0);
+}
+
+TEST_CASE("Guest run slots are overcommitted after the timeout",
+          "[run_slots]") {
+  GuestRunSlots slots(2, std::chrono::milliseconds(1));
+  REQUIRE(slots.Acquire());
+  REQUIRE(slots.Acquire());
+  REQUIRE_FALSE(slots.Acquire());
+  REQUIRE(slots.overcommit_count() == 1);
+
+  // No slot is free until all the overcommitted threads release theirs.
+  slots.Release();
+  REQUIRE_FALSE(slots.Acquire());
+  slots.Release();
+  slots.Release();
+  slots.Release();
+  REQUIRE(slots.Acquire());
+  REQUIRE(slots.overcommit_count() == 2);
+  slots.Release();
+}
+
+}  // namespace xe::kernel::test
@@ -0,0 +1,119 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2023 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "xenia/kernel/util/object_table.h"
+#include "xenia/kernel/xobject.h"
+
+#include "third_party/catch/include/catch.hpp"
+
+namespace xe::kernel::test {
+
+namespace {
+
+class TestObject : public XObject {
+ public:
+  static const XObject::Type kObjectType = XObject::Type::Event;
+
+  TestObject() : XObject(kObjectType) {}
+};
+
+}  // namespace
+
+TEST_CASE("Object table lookups", "[object_table]") {
+  util::ObjectTable table;
+  auto object = new TestObject();
+  X_HANDLE handle = 0;
+  REQUIRE(table.AddHandle(object, &handle) == X_STATUS_SUCCESS);
+  REQUIRE(handle != 0);
+
+  REQUIRE(table.LookupObject<TestObject>(handle).get() == object);
+  REQUIRE(!table.LookupObject<TestObject>(handle + 4));
+
+  REQUIRE(table.RetainHandle(handle) == X_STATUS_SUCCESS);
+  REQUIRE(table.ReleaseHandle(handle) == X_STATUS_SUCCESS);
+  REQUIRE(table.LookupObject<TestObject>(handle).get() == object);
+  REQUIRE(table.ReleaseHandle(handle) == X_STATUS_SUCCESS);
+  REQUIRE(!table.LookupObject<TestObject>(handle));
+
+  object->Release();
+}
+
+// Many threads looking up the same handles while another one keeps adding
+// and removing handles, as guest threads calling NtSetEvent and
+// NtWaitForSingleObjectEx while others create and close objects. Not run by
+// default:
+//   xenia-kernel-tests "[benchmark]"
+TEST_CASE("Object table concurrent lookups", "[.][benchmark]") {
+  constexpr uint32_t kThreadCount = 12;
+  constexpr uint32_t kLookupsPerThread = 4 * 1024 * 1024;
+  constexpr uint32_t kObjectCount = 64;
+
+  util::ObjectTable table;
+  std::vector<TestObject*> objects;
+  std::vector<X_HANDLE> handles;
+  for (uint32_t i = 0; i < kObjectCount; ++i) {
+    auto object = new TestObject();
+    X_HANDLE handle;
+    REQUIRE(table.AddHandle(object, &handle) == X_STATUS_SUCCESS);
+    objects.push_back(object);
+    handles.push_back(handle);
+  }
+
+  std::atomic<bool> lookups_done = false;
+  std::atomic<uint32_t> wrong_objects = 0;
+  std::thread churn_thread([&table, &lookups_done]() {
+    while (!lookups_done.load(std::memory_order_relaxed)) {
+      auto object = new TestObject();
+      X_HANDLE handle;
+      if (table.AddHandle(object, &handle) == X_STATUS_SUCCESS) {
+        table.ReleaseHandle(handle);
+      }
+      object->Release();
+    }
+  });
+
+  auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> lookup_threads;
+  for (uint32_t i = 0; i < kThreadCount; ++i) {
+    lookup_threads.emplace_back([&, i]() {
+      for (uint32_t j = 0; j < kLookupsPerThread; ++j) {
+        uint32_t index = (i * 7 + j) % kObjectCount;
+        auto object = table.LookupObject<TestObject>(handles[index]);
+        if (object.get() != objects[index]) {
+          wrong_objects.fetch_add(1, std::memory_order_relaxed);
+        }
+      }
+    });
+  }
+  for (auto& thread : lookup_threads) {
+    thread.join();
+  }
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  lookups_done = true;
+  churn_thread.join();
+
+  REQUIRE(wrong_objects == 0);
+  WARN(kThreadCount << " threads: "
+                    << double(kThreadCount) * kLookupsPerThread /
+                           elapsed.count() / 1000000.0
+                    << " million lookups/s");
+
+  for (uint32_t i = 0; i < kObjectCount; ++i) {
+    table.ReleaseHandle(handles[i]);
+    objects[i]->Release();
+  }
+}
+
+}  // namespace xe::kernel::test
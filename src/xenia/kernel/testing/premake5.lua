@@ -0,0 +1,25 @@
+project_root = "../../../.."
+include(project_root.."/tools/build")
+
+test_suite("xenia-kernel-tests", project_root, ".", {
+  links = {
+    "capstone",
+    "fmt",
+    "imgui",
+    "xenia-base",
+    "xenia-core",
+    "xenia-cpu",
+    "xenia-gpu",
+    "xenia-kernel",
+    "xenia-ui",
+    "xenia-patcher",
+  },
+  filtered_links = {
+    {
+      filter = 'architecture:x86_64',
+      links = {
+        "xenia-cpu-backend-x64",
+      },
+    }
+  },
+})
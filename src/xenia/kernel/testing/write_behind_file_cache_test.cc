@@ -0,0 +1,68 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2026 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+#include "xenia/kernel/util/write_behind_file_cache.h"
+
+#include "third_party/catch/include/catch.hpp"
+
+namespace xe::kernel::test {
+
+namespace {
+
+std::vector<uint8_t> ReadFile(const std::filesystem::path& path) {
+  std::ifstream file(path, std::ios::binary);
+  return std::vector<uint8_t>(std::istreambuf_iterator<char>(file),
+                              std::istreambuf_iterator<char>());
+}
+
+}  // namespace
+
+TEST_CASE("Write-behind file writes are coalesced", "[write_behind]") {
+  const std::filesystem::path root =
+      std::filesystem::temp_directory_path() / "xenia_write_behind_test";
+  std::filesystem::remove_all(root);
+  const std::filesystem::path path = root / "user" / "setting";
+
+  // An interval long enough not to flush during the test.
+  util::WriteBehindFileCache cache(std::chrono::hours(1));
+  cache.Write(path, {1, 2, 3});
+  cache.Write(path, {4, 5});
+  REQUIRE(cache.pending_count() == 1);
+  REQUIRE_FALSE(std::filesystem::exists(path));
+
+  std::vector<uint8_t> data;
+  REQUIRE(cache.Read(path, data));
+  REQUIRE(data == (std::vector<uint8_t>{4, 5}));
+
+  REQUIRE(cache.Flush());
+  REQUIRE(cache.pending_count() == 0);
+  REQUIRE_FALSE(cache.Read(path, data));
+  REQUIRE(ReadFile(path) == (std::vector<uint8_t>{4, 5}));
+  REQUIRE_FALSE(std::filesystem::exists(root / "user" / "setting.tmp"));
+
+  cache.Write(path, {6});
+  cache.Discard(path);
+  cache.Shutdown();
+  REQUIRE(ReadFile(path) == (std::vector<uint8_t>{4, 5}));
+
+  // Synchronous after the shutdown.
+  cache.Write(path, {7});
+  REQUIRE(ReadFile(path) == (std::vector<uint8_t>{7}));
+
+  std::filesystem::remove_all(root);
+}
+
+}  // namespace xe::kernel::test
@@ -0,0 +1,168 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2023 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/kernel/util/adaptive_spin.h"
+
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+#include "xenia/base/cvar.h"
+#include "xenia/base/logging.h"
+#include "xenia/base/platform.h"
+
+#if XE_ARCH_AMD64 == 1
+#include <immintrin.h>
+#if XE_COMPILER_CLANG || XE_COMPILER_GNUC
+#include <x86intrin.h>
+#endif
+#include "xenia/base/platform_amd64.h"
+#endif
+
+DEFINE_bool(adaptive_guest_lock_spin, true,
+            "Spins on contended guest critical sections and spinlocks for "
+            "about as long as they are usually held before parking the "
+            "thread.",
+            "Kernel");
+DEFINE_bool(log_guest_lock_stats, false,
+            "Logs the guest locks with the most contended acquisitions, with "
+            "how many were spun out and how many parked, when the title "
+            "exits.",
+            "Kernel");
+
+namespace xe {
+namespace kernel {
+namespace util {
+
+namespace {
+
+constexpr uint32_t kInitialSpins = 1024;
+constexpr uint32_t kMinSpins = 32;
+constexpr uint32_t kMaxSpins = 16384;
+
+// Locks sharing an entry just share the statistics, it's only a heuristic.
+constexpr uint32_t kEntryCountLog2 = 12;
+
+struct LockEntry {
+  std::atomic<uint32_t> guest_address{0};
+  std::atomic<uint32_t> spin_limit{0};
+  std::atomic<uint64_t> spin_acquisitions{0};
+  std::atomic<uint64_t> parks{0};
+  std::atomic<uint64_t> spins{0};
+};
+
+LockEntry lock_entries_[1 << kEntryCountLog2];
+
+LockEntry& GetEntry(uint32_t guest_address) {
+  LockEntry& entry =
+      lock_entries_[((guest_address >> 2) * 0x9E3779B1u) >>
+                    (32 - kEntryCountLog2)];
+  if (entry.guest_address.load(std::memory_order_relaxed) != guest_address) {
+    entry.guest_address.store(guest_address, std::memory_order_relaxed);
+    entry.spin_limit.store(kInitialSpins, std::memory_order_relaxed);
+    entry.spin_acquisitions.store(0, std::memory_order_relaxed);
+    entry.parks.store(0, std::memory_order_relaxed);
+    entry.spins.store(0, std::memory_order_relaxed);
+  }
+  return entry;
+}
+
+#if XE_ARCH_AMD64 == 1
+// Wakes up early when the lock word is written. The deadline is short because
+// the release may have happened before the monitor was armed.
+constexpr uint64_t kUmwaitCycles = 2000;
+
+#if XE_COMPILER_CLANG || XE_COMPILER_GNUC
+__attribute__((target("waitpkg")))
+#endif
+void WaitOnLockWord(const volatile void* lock_word) {
+  _umonitor(const_cast<void*>(lock_word));
+  // C0.1, the lighter state with the faster wakeup.
+  _umwait(1, __rdtsc() + kUmwaitCycles);
+}
+#endif
+
+}  // namespace
+
+uint32_t AdaptiveSpin::BeginSpin(uint32_t guest_address, uint32_t min_spins) {
+  if (!cvars::adaptive_guest_lock_spin) {
+    return min_spins;
+  }
+  return std::max(min_spins, GetEntry(guest_address)
+                                 .spin_limit.load(std::memory_order_relaxed));
+}
+
+void AdaptiveSpin::EndSpin(uint32_t guest_address, uint32_t spins,
+                           bool acquired) {
+  if (!cvars::adaptive_guest_lock_spin) {
+    return;
+  }
+  LockEntry& entry = GetEntry(guest_address);
+  entry.spins.fetch_add(spins, std::memory_order_relaxed);
+  int32_t limit = int32_t(entry.spin_limit.load(std::memory_order_relaxed));
+  if (acquired) {
+    entry.spin_acquisitions.fetch_add(1, std::memory_order_relaxed);
+    // Follow twice the typical wait, so that holds a bit longer than usual
+    // are still spun out.
+    limit += (int32_t(spins) * 2 - limit) / 8;
+  } else {
+    entry.parks.fetch_add(1, std::memory_order_relaxed);
+    limit -= limit / 8;
+  }
+  entry.spin_limit.store(
+      uint32_t(std::clamp(limit, int32_t(kMinSpins), int32_t(kMaxSpins))),
+      std::memory_order_relaxed);
+}
+
+void AdaptiveSpin::Pause(const volatile void* lock_word) {
+#if XE_ARCH_AMD64 == 1
+  if (amd64::GetFeatureFlags() & amd64::kX64EmitWaitPkg) {
+    WaitOnLockWord(lock_word);
+  } else {
+    _mm_pause();
+  }
+#endif
+}
+
+void AdaptiveSpin::LogStats() {
+  if (!cvars::log_guest_lock_stats) {
+    return;
+  }
+  std::vector<const LockEntry*> entries;
+  for (const LockEntry& entry : lock_entries_) {
+    if (entry.spin_acquisitions.load(std::memory_order_relaxed) ||
+        entry.parks.load(std::memory_order_relaxed)) {
+      entries.push_back(&entry);
+    }
+  }
+  auto contended = [](const LockEntry* entry) {
+    return entry->spin_acquisitions.load(std::memory_order_relaxed) +
+           entry->parks.load(std::memory_order_relaxed);
+  };
+  std::sort(entries.begin(), entries.end(),
+            [&contended](const LockEntry* a, const LockEntry* b) {
+              return contended(a) > contended(b);
+            });
+  entries.resize(std::min(entries.size(), size_t(32)));
+  XELOGI("Guest locks with the most contended acquisitions:");
+  for (const LockEntry* entry : entries) {
+    uint64_t count = contended(entry);
+    XELOGI(
+        "  {:08X}: {} spun ({} spins on average), {} parked, spin limit {}",
+        entry->guest_address.load(std::memory_order_relaxed),
+        entry->spin_acquisitions.load(std::memory_order_relaxed),
+        entry->spins.load(std::memory_order_relaxed) / count,
+        entry->parks.load(std::memory_order_relaxed),
+        entry->spin_limit.load(std::memory_order_relaxed));
+  }
+}
+
+}  // namespace util
+}  // namespace kernel
+}  // namespace xe
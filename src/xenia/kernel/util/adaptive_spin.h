@@ -0,0 +1,59 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2023 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#ifndef XENIA_KERNEL_UTIL_ADAPTIVE_SPIN_H_
+#define XENIA_KERNEL_UTIL_ADAPTIVE_SPIN_H_
+
+#include <cstdint>
+
+namespace xe {
+namespace kernel {
+namespace util {
+
+// Spin-then-park policy for contended guest locks (critical sections and
+// spinlocks). How long to spin before parking is learned for each lock
+// address from how long the previous contended acquisitions had to spin,
+// which follows how long the lock is usually held: short holds are waited
+// out by spinning, long ones park right away instead of burning the core.
+//
+// Spinning uses umwait on the lock word where available, pause otherwise.
+class AdaptiveSpin {
+ public:
+  // Spins until try_acquire succeeds, or the spin budget of the lock runs
+  // out, in which case the caller should park. min_spins is a lower bound on
+  // the budget, such as the spin count of a critical section.
+  template <typename F>
+  static bool Spin(uint32_t guest_address, const volatile void* lock_word,
+                   uint32_t min_spins, F&& try_acquire) {
+    uint32_t budget = BeginSpin(guest_address, min_spins);
+    for (uint32_t spins = 1; spins <= budget; ++spins) {
+      Pause(lock_word);
+      if (try_acquire()) {
+        EndSpin(guest_address, spins, true);
+        return true;
+      }
+    }
+    EndSpin(guest_address, budget, false);
+    return false;
+  }
+
+  // Logs the locks with the most contended acquisitions.
+  static void LogStats();
+
+ private:
+  static uint32_t BeginSpin(uint32_t guest_address, uint32_t min_spins);
+  static void EndSpin(uint32_t guest_address, uint32_t spins, bool acquired);
+  static void Pause(const volatile void* lock_word);
+};
+
+}  // namespace util
+}  // namespace kernel
+}  // namespace xe
+
+#endif  // XENIA_KERNEL_UTIL_ADAPTIVE_SPIN_H_
@@ -0,0 +1,90 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2023 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/kernel/util/allocation_cache.h"
+
+#include "xenia/base/mutex.h"
+#include "xenia/memory.h"
+
+namespace xe {
+namespace kernel {
+namespace util {
+
+uint32_t AllocationCache::Take(Memory* memory, BaseHeap* heap, uint32_t size,
+                               uint32_t protect, uint32_t alignment,
+                               uint32_t low_address, uint32_t high_address) {
+  // Most recently freed first, it's the most likely to still be in the host
+  // caches.
+  for (uint32_t i = block_count_; i-- > 0;) {
+    const Block& block = blocks_[i];
+    if (block.heap != heap || block.size != size ||
+        block.protect != protect ||
+        (alignment && (block.address & (alignment - 1))) ||
+        block.address < low_address ||
+        block.address + (block.size - 1) > high_address) {
+      continue;
+    }
+    uint32_t address = block.address;
+    cached_size_ -= block.size;
+    for (uint32_t j = i + 1; j < block_count_; ++j) {
+      blocks_[j - 1] = blocks_[j];
+    }
+    --block_count_;
+    memory->Zero(address, size);
+    return address;
+  }
+  return 0;
+}
+
+bool AllocationCache::Put(Memory* memory, BaseHeap* heap, uint32_t address,
+                          uint32_t size, uint32_t protect) {
+  if (!size || size > kMaxBlockSize) {
+    return false;
+  }
+  for (uint32_t i = 0; i < block_count_; ++i) {
+    if (blocks_[i].address == address && blocks_[i].heap == heap) {
+      // Freed twice, must not be handed out twice.
+      return true;
+    }
+  }
+  if (heap->heap_type() == HeapType::kGuestPhysical) {
+    // Release would have done this. The pages stay mapped only here, so there
+    // is no aliasing to worry about, but the GPU must not keep using its
+    // copies of the old contents, and zeroing shouldn't hit watched pages.
+    memory->TriggerPhysicalMemoryCallbacks(
+        global_critical_region::AcquireDirect(), address, size, true, true);
+  }
+  while (block_count_ &&
+         (block_count_ >= kMaxBlockCount ||
+          cached_size_ + size > kMaxCachedSize)) {
+    // Evict the oldest block.
+    const Block& oldest = blocks_[0];
+    oldest.heap->Release(oldest.address);
+    cached_size_ -= oldest.size;
+    for (uint32_t i = 1; i < block_count_; ++i) {
+      blocks_[i - 1] = blocks_[i];
+    }
+    --block_count_;
+  }
+  blocks_[block_count_++] = {heap, address, size, protect};
+  cached_size_ += size;
+  return true;
+}
+
+void AllocationCache::Flush() {
+  for (uint32_t i = 0; i < block_count_; ++i) {
+    blocks_[i].heap->Release(blocks_[i].address);
+  }
+  block_count_ = 0;
+  cached_size_ = 0;
+}
+
+}  // namespace util
+}  // namespace kernel
+}  // namespace xe
@@ -0,0 +1,72 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2023 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#ifndef XENIA_KERNEL_UTIL_ALLOCATION_CACHE_H_
+#define XENIA_KERNEL_UTIL_ALLOCATION_CACHE_H_
+
+#include <array>
+#include <cstdint>
+
+namespace xe {
+class BaseHeap;
+class Memory;
+}  // namespace xe
+
+namespace xe {
+namespace kernel {
+namespace util {
+
+// Small magazine of blocks recently freed by a guest thread through the
+// kernel memory functions, still allocated in their heap, so that allocating
+// the same kind of block again doesn't need to look for free pages in the heap
+// under the global critical region.
+//
+// Blocks are matched by heap, size and protection, and must satisfy the
+// alignment and address range of the request. They are zeroed when handed out
+// again, like freshly committed pages.
+class AllocationCache {
+ public:
+  static constexpr uint32_t kMaxBlockSize = 64 * 1024;
+  static constexpr uint32_t kMaxCachedSize = 1024 * 1024;
+
+  AllocationCache() = default;
+  AllocationCache(const AllocationCache&) = delete;
+  AllocationCache& operator=(const AllocationCache&) = delete;
+
+  // Returns the address of a cached block, or 0 if there's none suitable.
+  uint32_t Take(Memory* memory, BaseHeap* heap, uint32_t size,
+                uint32_t protect, uint32_t alignment, uint32_t low_address,
+                uint32_t high_address);
+  // Keeps the block instead of releasing it. Returns false if the block should
+  // be released to the heap instead.
+  bool Put(Memory* memory, BaseHeap* heap, uint32_t address, uint32_t size,
+           uint32_t protect);
+  // Releases all cached blocks to their heaps. Must be done by the owner
+  // before the cache is destroyed.
+  void Flush();
+
+ private:
+  struct Block {
+    BaseHeap* heap;
+    uint32_t address;
+    uint32_t size;
+    uint32_t protect;
+  };
+  static constexpr uint32_t kMaxBlockCount = 16;
+
+  std::array<Block, kMaxBlockCount> blocks_;
+  uint32_t block_count_ = 0;
+  uint32_t cached_size_ = 0;
+};
+
+}  // namespace util
+}  // namespace kernel
+}  // namespace xe
+
+#endif  // XENIA_KERNEL_UTIL_ALLOCATION_CACHE_H_
@@ -7,16 +7,345 @@
  ******************************************************************************
  */
 #include <algorithm>
+#include <cstring>
 
 #include "xenia/kernel/util/crypto_utils.h"
+#include "xenia/base/byte_order.h"
+#include "xenia/base/platform.h"
 #include "xenia/xbox.h"
 
+#if XE_ARCH_AMD64
+#include <immintrin.h>
+
+#include "xenia/base/platform_amd64.h"
+#endif  // XE_ARCH_AMD64
+
 #include "third_party/crypto/TinySHA1.hpp"
+#include "third_party/crypto/rijndael-alg-fst.c"
+#include "third_party/crypto/rijndael-alg-fst.h"
+
+#if XE_ARCH_AMD64 && XE_COMPILER_HAS_GNU_EXTENSIONS
+#define XE_AESNI_FUNCTION __attribute__((target("aes,sse4.1")))
+#define XE_SHA_FUNCTION __attribute__((target("sha,sse4.1")))
+#else
+#define XE_AESNI_FUNCTION
+#define XE_SHA_FUNCTION
+#endif
 
 namespace xe {
 namespace kernel {
 namespace util {
 
+namespace {
+
+#if XE_ARCH_AMD64
+
+#define XE_AES_128_EXPAND_KEY(round, rcon)                          \
+  {                                                                 \
+    __m128i key = round_keys[round - 1];                            \
+    __m128i assist = _mm_shuffle_epi32(                             \
+        _mm_aeskeygenassist_si128(key, rcon), _MM_SHUFFLE(3, 3, 3, 3)); \
+    key = _mm_xor_si128(key, _mm_slli_si128(key, 4));               \
+    key = _mm_xor_si128(key, _mm_slli_si128(key, 4));               \
+    key = _mm_xor_si128(key, _mm_slli_si128(key, 4));               \
+    round_keys[round] = _mm_xor_si128(key, assist);                 \
+  }
+
+XE_AESNI_FUNCTION
+void ExpandAes128DecryptionKeysAesNi(const uint8_t* key,
+                                     uint8_t (*decryption_keys)[16]) {
+  __m128i round_keys[11];
+  round_keys[0] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(key));
+  XE_AES_128_EXPAND_KEY(1, 0x01);
+  XE_AES_128_EXPAND_KEY(2, 0x02);
+  XE_AES_128_EXPAND_KEY(3, 0x04);
+  XE_AES_128_EXPAND_KEY(4, 0x08);
+  XE_AES_128_EXPAND_KEY(5, 0x10);
+  XE_AES_128_EXPAND_KEY(6, 0x20);
+  XE_AES_128_EXPAND_KEY(7, 0x40);
+  XE_AES_128_EXPAND_KEY(8, 0x80);
+  XE_AES_128_EXPAND_KEY(9, 0x1B);
+  XE_AES_128_EXPAND_KEY(10, 0x36);
+  // The equivalent inverse cipher uses the encryption keys in the reverse
+  // order, with InvMixColumns applied to the middle ones.
+  _mm_store_si128(reinterpret_cast<__m128i*>(decryption_keys[0]),
+                  round_keys[10]);
+  for (size_t i = 1; i < 10; ++i) {
+    _mm_store_si128(reinterpret_cast<__m128i*>(decryption_keys[i]),
+                    _mm_aesimc_si128(round_keys[10 - i]));
+  }
+  _mm_store_si128(reinterpret_cast<__m128i*>(decryption_keys[10]),
+                  round_keys[0]);
+}
+
+#undef XE_AES_128_EXPAND_KEY
+
+XE_AESNI_FUNCTION
+void DecryptAes128CbcAesNi(const uint8_t (*decryption_keys)[16], uint8_t* iv,
+                           const uint8_t* input, size_t block_count,
+                           uint8_t* output) {
+  __m128i keys[11];
+  for (size_t i = 0; i < 11; ++i) {
+    keys[i] =
+        _mm_load_si128(reinterpret_cast<const __m128i*>(decryption_keys[i]));
+  }
+  __m128i chain = _mm_loadu_si128(reinterpret_cast<const __m128i*>(iv));
+  auto input_blocks = reinterpret_cast<const __m128i*>(input);
+  auto output_blocks = reinterpret_cast<__m128i*>(output);
+  size_t i = 0;
+  // Unlike encryption, CBC decryption of the blocks is independent, so four
+  // are interleaved to hide the latency of aesdec. All the ciphertext is
+  // loaded before storing in case the data is decrypted in place.
+  for (; i + 4 <= block_count; i += 4) {
+    __m128i ciphertext[4], state[4];
+    for (size_t j = 0; j < 4; ++j) {
+      ciphertext[j] = _mm_loadu_si128(input_blocks + i + j);
+      state[j] = _mm_xor_si128(ciphertext[j], keys[0]);
+    }
+    for (size_t round = 1; round < 10; ++round) {
+      for (size_t j = 0; j < 4; ++j) {
+        state[j] = _mm_aesdec_si128(state[j], keys[round]);
+      }
+    }
+    for (size_t j = 0; j < 4; ++j) {
+      state[j] = _mm_aesdeclast_si128(state[j], keys[10]);
+      _mm_storeu_si128(output_blocks + i + j, _mm_xor_si128(state[j], chain));
+      chain = ciphertext[j];
+    }
+  }
+  for (; i < block_count; ++i) {
+    __m128i ciphertext = _mm_loadu_si128(input_blocks + i);
+    __m128i state = _mm_xor_si128(ciphertext, keys[0]);
+    for (size_t round = 1; round < 10; ++round) {
+      state = _mm_aesdec_si128(state, keys[round]);
+    }
+    state = _mm_aesdeclast_si128(state, keys[10]);
+    _mm_storeu_si128(output_blocks + i, _mm_xor_si128(state, chain));
+    chain = ciphertext;
+  }
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(iv), chain);
+}
+
+// The message words are used in groups of 4 for 4 rounds each. A group after
+// the first 4 is derived from the 4 preceding ones, the oldest of which it
+// replaces.
+#define XE_SHA1_ROUND_GROUP(group)                                          \
+  {                                                                         \
+    __m128i& message_group = message[(group) % 4];                          \
+    if ((group) < 4) {                                                      \
+      message_group = _mm_shuffle_epi8(                                     \
+          _mm_loadu_si128(reinterpret_cast<const __m128i*>(data) + (group)), \
+          byte_swap_mask);                                                  \
+    } else {                                                                \
+      message_group = _mm_sha1msg2_epu32(                                   \
+          _mm_xor_si128(_mm_sha1msg1_epu32(message_group,                   \
+                                           message[((group) + 1) % 4]),     \
+                        message[((group) + 2) % 4]),                        \
+          message[((group) + 3) % 4]);                                      \
+    }                                                                       \
+    __m128i e_and_message =                                                 \
+        (group) ? _mm_sha1nexte_epu32(previous_abcd, message_group)         \
+                : _mm_add_epi32(e, message_group);                          \
+    previous_abcd = abcd;                                                   \
+    abcd = _mm_sha1rnds4_epu32(abcd, e_and_message, (group) / 5);           \
+  }
+
+XE_SHA_FUNCTION
+void ProcessSha1BlocksSha(uint32_t* state, const uint8_t* data,
+                          size_t block_count) {
+  // Big-endian words, the first in the highest element.
+  const __m128i byte_swap_mask =
+      _mm_set_epi64x(0x0001020304050607ULL, 0x08090A0B0C0D0E0FULL);
+  // A in the highest element.
+  __m128i abcd = _mm_shuffle_epi32(
+      _mm_loadu_si128(reinterpret_cast<const __m128i*>(state)),
+      _MM_SHUFFLE(0, 1, 2, 3));
+  __m128i e = _mm_set_epi32(int(state[4]), 0, 0, 0);
+  for (size_t i = 0; i < block_count; ++i, data += 64) {
+    __m128i abcd_before = abcd;
+    __m128i message[4];
+    __m128i previous_abcd;
+    XE_SHA1_ROUND_GROUP(0);
+    XE_SHA1_ROUND_GROUP(1);
+    XE_SHA1_ROUND_GROUP(2);
+    XE_SHA1_ROUND_GROUP(3);
+    XE_SHA1_ROUND_GROUP(4);
+    XE_SHA1_ROUND_GROUP(5);
+    XE_SHA1_ROUND_GROUP(6);
+    XE_SHA1_ROUND_GROUP(7);
+    XE_SHA1_ROUND_GROUP(8);
+    XE_SHA1_ROUND_GROUP(9);
+    XE_SHA1_ROUND_GROUP(10);
+    XE_SHA1_ROUND_GROUP(11);
+    XE_SHA1_ROUND_GROUP(12);
+    XE_SHA1_ROUND_GROUP(13);
+    XE_SHA1_ROUND_GROUP(14);
+    XE_SHA1_ROUND_GROUP(15);
+    XE_SHA1_ROUND_GROUP(16);
+    XE_SHA1_ROUND_GROUP(17);
+    XE_SHA1_ROUND_GROUP(18);
+    XE_SHA1_ROUND_GROUP(19);
+    // E after the last rounds is derived from the A before them.
+    e = _mm_sha1nexte_epu32(previous_abcd, e);
+    abcd = _mm_add_epi32(abcd, abcd_before);
+  }
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(state),
+                   _mm_shuffle_epi32(abcd, _MM_SHUFFLE(0, 1, 2, 3)));
+  state[4] = uint32_t(_mm_extract_epi32(e, 3));
+}
+
+#undef XE_SHA1_ROUND_GROUP
+
+#endif  // XE_ARCH_AMD64
+
+uint32_t RotateLeft(uint32_t value, uint32_t shift) {
+  return (value << shift) | (value >> (32 - shift));
+}
+
+void ProcessSha1BlocksSoftware(uint32_t* state, const uint8_t* data,
+                               size_t block_count) {
+  for (size_t i = 0; i < block_count; ++i, data += 64) {
+    uint32_t w[80];
+    for (size_t j = 0; j < 16; ++j) {
+      w[j] = xe::load_and_swap<uint32_t>(data + j * 4);
+    }
+    for (size_t j = 16; j < 80; ++j) {
+      w[j] = RotateLeft(w[j - 3] ^ w[j - 8] ^ w[j - 14] ^ w[j - 16], 1);
+    }
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3],
+             e = state[4];
+    for (size_t j = 0; j < 80; ++j) {
+      uint32_t f, k;
+      if (j < 20) {
+        f = (b & c) | (~b & d);
+        k = 0x5A827999;
+      } else if (j < 40) {
+        f = b ^ c ^ d;
+        k = 0x6ED9EBA1;
+      } else if (j < 60) {
+        f = (b & c) | (b & d) | (c & d);
+        k = 0x8F1BBCDC;
+      } else {
+        f = b ^ c ^ d;
+        k = 0xCA62C1D6;
+      }
+      uint32_t temp = RotateLeft(a, 5) + f + e + k + w[j];
+      e = d;
+      d = c;
+      c = RotateLeft(b, 30);
+      b = a;
+      a = temp;
+    }
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+  }
+}
+
+}  // namespace
+
+Aes128CbcDecryptor::Aes128CbcDecryptor(const uint8_t* key) {
+  std::memset(iv_, 0, sizeof(iv_));
+#if XE_ARCH_AMD64
+  use_aesni_ = (amd64::GetFeatureFlags() & amd64::kX64EmitAESNI) != 0;
+  if (use_aesni_) {
+    ExpandAes128DecryptionKeysAesNi(key, aesni_round_keys_);
+    return;
+  }
+#else
+  use_aesni_ = false;
+#endif  // XE_ARCH_AMD64
+  software_round_count_ = rijndaelKeySetupDec(software_round_keys_, key, 128);
+}
+
+void Aes128CbcDecryptor::Decrypt(const uint8_t* input, size_t size,
+                                 uint8_t* output) {
+  size_t block_count = size / kBlockSize;
+#if XE_ARCH_AMD64
+  if (use_aesni_) {
+    DecryptAes128CbcAesNi(aesni_round_keys_, iv_, input, block_count, output);
+    return;
+  }
+#endif  // XE_ARCH_AMD64
+  for (size_t i = 0; i < block_count;
+       ++i, input += kBlockSize, output += kBlockSize) {
+    uint8_t ciphertext[kBlockSize];
+    std::memcpy(ciphertext, input, kBlockSize);
+    rijndaelDecrypt(software_round_keys_, software_round_count_, ciphertext,
+                    output);
+    for (size_t j = 0; j < kBlockSize; ++j) {
+      output[j] ^= iv_[j];
+    }
+    std::memcpy(iv_, ciphertext, kBlockSize);
+  }
+}
+
+void Sha1::Reset() {
+  state_[0] = 0x67452301;
+  state_[1] = 0xEFCDAB89;
+  state_[2] = 0x98BADCFE;
+  state_[3] = 0x10325476;
+  state_[4] = 0xC3D2E1F0;
+  total_size_ = 0;
+  buffer_size_ = 0;
+}
+
+void Sha1::Update(const void* data, size_t size) {
+  auto bytes = reinterpret_cast<const uint8_t*>(data);
+  total_size_ += size;
+  if (buffer_size_) {
+    size_t buffer_fill_size = std::min(kBlockSize - buffer_size_, size);
+    std::memcpy(buffer_ + buffer_size_, bytes, buffer_fill_size);
+    buffer_size_ += buffer_fill_size;
+    bytes += buffer_fill_size;
+    size -= buffer_fill_size;
+    if (buffer_size_ < kBlockSize) {
+      return;
+    }
+    ProcessBlocks(buffer_, 1);
+    buffer_size_ = 0;
+  }
+  size_t block_count = size / kBlockSize;
+  if (block_count) {
+    ProcessBlocks(bytes, block_count);
+    bytes += block_count * kBlockSize;
+    size -= block_count * kBlockSize;
+  }
+  std::memcpy(buffer_, bytes, size);
+  buffer_size_ = size;
+}
+
+void Sha1::Finalize(uint8_t* digest) {
+  uint64_t bit_count = total_size_ * 8;
+  buffer_[buffer_size_++] = 0x80;
+  if (buffer_size_ > kBlockSize - sizeof(uint64_t)) {
+    std::memset(buffer_ + buffer_size_, 0, kBlockSize - buffer_size_);
+    ProcessBlocks(buffer_, 1);
+    buffer_size_ = 0;
+  }
+  std::memset(buffer_ + buffer_size_, 0,
+              kBlockSize - sizeof(uint64_t) - buffer_size_);
+  xe::store_and_swap<uint64_t>(buffer_ + kBlockSize - sizeof(uint64_t),
+                               bit_count);
+  ProcessBlocks(buffer_, 1);
+  for (size_t i = 0; i < 5; ++i) {
+    xe::store_and_swap<uint32_t>(digest + i * 4, state_[i]);
+  }
+  Reset();
+}
+
+void Sha1::ProcessBlocks(const uint8_t* data, size_t block_count) {
+#if XE_ARCH_AMD64
+  if (amd64::GetFeatureFlags() & amd64::kX64EmitSHA) {
+    ProcessSha1BlocksSha(state_, data, block_count);
+    return;
+  }
+#endif  // XE_ARCH_AMD64
+  ProcessSha1BlocksSoftware(state_, data, block_count);
+}
+
 uint8_t xekey_0x19[] = {0xE1, 0xBC, 0x15, 0x9C, 0x73, 0xB1, 0xEA, 0xE9,
                         0xAB, 0x31, 0x70, 0xF3, 0xAD, 0x47, 0xEB, 0xF3};
 
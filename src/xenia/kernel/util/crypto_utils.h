@@ -7,12 +7,64 @@
  ******************************************************************************
  */
 
+#ifndef XENIA_KERNEL_UTIL_CRYPTO_UTILS_H_
+#define XENIA_KERNEL_UTIL_CRYPTO_UTILS_H_
+
+#include <cstddef>
+#include <cstdint>
+
 #include "xenia/xbox.h"
 
 namespace xe {
 namespace kernel {
 namespace util {
 
+// AES-128 CBC decryption of content such as whole executable images, with
+// AES-NI if the host supports it.
+class Aes128CbcDecryptor {
+ public:
+  static constexpr size_t kBlockSize = 16;
+
+  // Starts with a zero IV.
+  explicit Aes128CbcDecryptor(const uint8_t* key);
+
+  // Decrypts the whole blocks of the input, which may be the output, into the
+  // output, continuing the chain of the previous call.
+  void Decrypt(const uint8_t* input, size_t size, uint8_t* output);
+
+ private:
+  bool use_aesni_;
+  // Decryption round keys, the first to the last.
+  alignas(16) uint8_t aesni_round_keys_[11][kBlockSize];
+  uint32_t software_round_keys_[4 * (14 + 1)];
+  int software_round_count_;
+  uint8_t iv_[kBlockSize];
+};
+
+// SHA-1 of large content, such as verifying executable images, with the SHA
+// extensions if the host supports them.
+class Sha1 {
+ public:
+  static constexpr size_t kDigestSize = 20;
+
+  Sha1() { Reset(); }
+
+  void Reset();
+  void Update(const void* data, size_t size);
+  // Resets afterwards.
+  void Finalize(uint8_t* digest);
+
+ private:
+  static constexpr size_t kBlockSize = 64;
+
+  void ProcessBlocks(const uint8_t* data, size_t block_count);
+
+  uint32_t state_[5];
+  uint64_t total_size_;
+  size_t buffer_size_;
+  uint8_t buffer_[kBlockSize];
+};
+
 const uint8_t* GetXeKey(uint32_t idx, bool devkit = false);
 
 void HmacSha(const uint8_t* key, uint32_t key_size_in, const uint8_t* inp_1,
@@ -25,4 +77,6 @@ void RC4(const uint8_t* key, uint32_t key_size_in, const uint8_t* data,
 
 }  // namespace util
 }  // namespace kernel
-}  // namespace xe
\ No newline at end of file
+}  // namespace xe
+
+#endif  // XENIA_KERNEL_UTIL_CRYPTO_UTILS_H_
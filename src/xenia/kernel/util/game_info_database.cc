@@ -25,6 +25,7 @@ GameInfoDatabase::GameInfoDatabase(const XdbfGameData* data) {
 
   is_valid_ = true;
   xdbf_gamedata_ = std::make_unique<XdbfGameData>(*data);
+  xdbf_gamedata_->BuildIndex();
 
   uint32_t compressed_size, decompressed_size = 0;
   const uint8_t* xlast_ptr =
@@ -0,0 +1,142 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2023 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/kernel/util/kernel_call_stats.h"
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <mutex>
+
+#include "third_party/fmt/include/fmt/format.h"
+#include "xenia/base/filesystem.h"
+#include "xenia/base/logging.h"
+#include "xenia/base/threading.h"
+#include "xenia/cpu/export_resolver.h"
+
+DEFINE_path(kernel_call_stats_csv, "",
+            "With kernel_call_stats, file to periodically append the call "
+            "statistics of the kernel exports to.",
+            "Kernel");
+DEFINE_uint32(kernel_call_stats_csv_interval, 10,
+              "Seconds between the kernel call statistics written to "
+              "kernel_call_stats_csv.",
+              "Kernel");
+
+namespace xe {
+namespace kernel {
+namespace util {
+
+namespace {
+
+struct RegisteredExport {
+  const char* module_name;
+  const cpu::Export* export_entry;
+  KernelCallStats::Counters* counters;
+};
+
+// Exports are registered during static initialization, possibly before this
+// file's globals are constructed.
+std::vector<RegisteredExport>& GetRegisteredExports() {
+  static std::vector<RegisteredExport> registered_exports;
+  return registered_exports;
+}
+
+std::unique_ptr<threading::Thread> csv_thread_;
+std::unique_ptr<threading::Event> csv_thread_stop_;
+
+void WriteCsv(FILE* file, double time_s) {
+  for (const KernelCallStats::Record& record : KernelCallStats::GetRecords()) {
+    fmt::print(file, "{:.1f},{},{},{},{},{:.1f}\n", time_s, record.module_name,
+               record.export_entry->ordinal, record.export_entry->name,
+               record.call_count, record.host_time_us);
+  }
+  std::fflush(file);
+}
+
+}  // namespace
+
+void KernelCallStats::Register(const char* module_name,
+                               const cpu::Export* export_entry,
+                               Counters* counters) {
+  GetRegisteredExports().push_back({module_name, export_entry, counters});
+}
+
+std::vector<KernelCallStats::Record> KernelCallStats::GetRecords() {
+  double us_per_tick = 1000000.0 / double(Clock::QueryHostTickFrequency());
+  std::vector<Record> records;
+  for (const RegisteredExport& registered : GetRegisteredExports()) {
+    uint64_t call_count =
+        registered.counters->call_count.load(std::memory_order_relaxed);
+    if (!call_count) {
+      continue;
+    }
+    records.push_back(
+        {registered.module_name, registered.export_entry, call_count,
+         double(registered.counters->host_ticks.load(
+             std::memory_order_relaxed)) *
+             us_per_tick});
+  }
+  std::sort(records.begin(), records.end(),
+            [](const Record& a, const Record& b) {
+              return a.host_time_us > b.host_time_us;
+            });
+  return records;
+}
+
+void KernelCallStats::Reset() {
+  for (const RegisteredExport& registered : GetRegisteredExports()) {
+    registered.counters->call_count.store(0, std::memory_order_relaxed);
+    registered.counters->host_ticks.store(0, std::memory_order_relaxed);
+  }
+}
+
+void KernelCallStats::StartCsvWriter() {
+  if (!cvars::kernel_call_stats || cvars::kernel_call_stats_csv.empty() ||
+      csv_thread_) {
+    return;
+  }
+  FILE* file = filesystem::OpenFile(cvars::kernel_call_stats_csv, "a");
+  if (!file) {
+    XELOGE("Failed to open {} for the kernel call statistics",
+           xe::path_to_utf8(cvars::kernel_call_stats_csv));
+    return;
+  }
+  fmt::print(file, "time_s,module,ordinal,name,calls,host_time_us\n");
+  csv_thread_stop_ = threading::Event::CreateManualResetEvent(false);
+  csv_thread_ = threading::Thread::Create({}, [file]() {
+    auto start = std::chrono::steady_clock::now();
+    auto interval = std::chrono::seconds(
+        std::max(cvars::kernel_call_stats_csv_interval, uint32_t(1)));
+    bool stop = false;
+    while (!stop) {
+      stop = threading::Wait(csv_thread_stop_.get(), false, interval) ==
+             threading::WaitResult::kSuccess;
+      std::chrono::duration<double> time =
+          std::chrono::steady_clock::now() - start;
+      WriteCsv(file, time.count());
+    }
+    std::fclose(file);
+  });
+  csv_thread_->set_name("Kernel Call Statistics");
+}
+
+void KernelCallStats::StopCsvWriter() {
+  if (!csv_thread_) {
+    return;
+  }
+  csv_thread_stop_->Set();
+  threading::Wait(csv_thread_.get(), false);
+  csv_thread_.reset();
+  csv_thread_stop_.reset();
+}
+
+}  // namespace util
+}  // namespace kernel
+}  // namespace xe
@@ -0,0 +1,88 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2023 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#ifndef XENIA_KERNEL_UTIL_KERNEL_CALL_STATS_H_
+#define XENIA_KERNEL_UTIL_KERNEL_CALL_STATS_H_
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+
+#include "xenia/base/clock.h"
+#include "xenia/kernel/kernel_flags.h"
+
+namespace xe {
+namespace cpu {
+class Export;
+}  // namespace cpu
+}  // namespace xe
+
+namespace xe {
+namespace kernel {
+namespace util {
+
+// Call counts and host time spent in each kernel export, with
+// kernel_call_stats, to find the HLE exports worth optimizing for a title.
+// The time includes everything done during the call, such as waiting in
+// blocking exports and guest APCs delivered by them.
+class KernelCallStats {
+ public:
+  struct Counters {
+    std::atomic<uint64_t> call_count{0};
+    std::atomic<uint64_t> host_ticks{0};
+  };
+
+  struct Record {
+    const char* module_name;
+    const cpu::Export* export_entry;
+    uint64_t call_count;
+    double host_time_us;
+  };
+
+  // Times a call if kernel_call_stats is enabled.
+  class ScopedCall {
+   public:
+    explicit ScopedCall(Counters& counters)
+        : counters_(counters),
+          start_ticks_(cvars::kernel_call_stats ? Clock::QueryHostTickCount()
+                                                : 0) {}
+    ~ScopedCall() {
+      if (start_ticks_) {
+        counters_.call_count.fetch_add(1, std::memory_order_relaxed);
+        counters_.host_ticks.fetch_add(
+            Clock::QueryHostTickCount() - start_ticks_,
+            std::memory_order_relaxed);
+      }
+    }
+
+   private:
+    Counters& counters_;
+    uint64_t start_ticks_;
+  };
+
+  // Called for every export as it's declared, during static initialization.
+  static void Register(const char* module_name,
+                       const cpu::Export* export_entry, Counters* counters);
+
+  // Exports that have been called, with the most host time first.
+  static std::vector<Record> GetRecords();
+  static void Reset();
+
+  // Appends the records with the time since the start to
+  // kernel_call_stats_csv every kernel_call_stats_csv_interval seconds.
+  static void StartCsvWriter();
+  static void StopCsvWriter();
+};
+
+}  // namespace util
+}  // namespace kernel
+}  // namespace xe
+
+#endif  // XENIA_KERNEL_UTIL_KERNEL_CALL_STATS_H_
@@ -14,6 +14,7 @@ struct TerminateNotification;
 struct X_TIME_STAMP_BUNDLE;
 class KernelState;
 struct XAPC;
+class SocketIOEngine;
 
 struct X_KPCR;
 struct X_KTHREAD;
@@ -10,7 +10,7 @@
 #include "xenia/kernel/util/object_table.h"
 
 #include <algorithm>
-#include <cstring>
+#include <new>
 
 #include "xenia/base/byte_stream.h"
 #include "xenia/base/logging.h"
@@ -21,6 +21,25 @@ namespace xe {
 namespace kernel {
 namespace util {
 
+uint32_t ObjectTable::GetLookupCounterIndex() {
+  static std::atomic<uint32_t> next_index = 0;
+  thread_local uint32_t index =
+      next_index.fetch_add(1, std::memory_order_relaxed) % kLookupCounterCount;
+  return index;
+}
+
+bool ObjectTable::AnyLookupsActive() const {
+  // A lookup that increments a counter after it has been seen as zero here
+  // also reads its entry after the object was removed from it, as all of this
+  // is sequentially consistent.
+  for (const LookupCounter& counter : active_lookups_) {
+    if (counter.count.load() != 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
 ObjectTable::ObjectTable() {}
 
 ObjectTable::~ObjectTable() { Reset(); }
@@ -29,36 +48,63 @@ void ObjectTable::Reset() {
   auto global_lock = global_critical_region_.Acquire();
 
   // Release all objects.
-  for (uint32_t n = 0; n < table_capacity_; n++) {
-    ObjectTableEntry& entry = table_[n];
-    if (entry.object) {
-      entry.object->Release();
-    }
-  }
-  for (uint32_t n = 0; n < host_table_capacity_; n++) {
-    ObjectTableEntry& entry = host_table_[n];
-    if (entry.object) {
-      entry.object->Release();
+  for (bool host : {false, true}) {
+    uint32_t capacity = GetCapacity(host);
+    (host ? host_table_capacity_ : table_capacity_) = 0;
+    ObjectTableEntry* entries = GetEntries(host);
+    for (uint32_t n = 0; n < capacity; n++) {
+      XObject* object = entries[n].object.exchange(nullptr);
+      if (object) {
+        retired_objects_.push_back(object);
+      }
     }
   }
+  // Like the tables freed below, this requires that no lookups are in flight
+  // anymore, which is the case when the kernel is shut down.
+  ReleaseRetiredObjects(true);
 
-  table_capacity_ = 0;
-  host_table_capacity_ = 0;
   last_free_entry_ = 0;
   last_free_host_entry_ = 0;
-  free(table_);
-  table_ = nullptr;
-  free(host_table_);
-  host_table_ = nullptr;
+  delete[] table_.exchange(nullptr);
+  delete[] host_table_.exchange(nullptr);
+  for (auto retired_table : retired_tables_) {
+    delete[] retired_table;
+  }
+  retired_tables_.clear();
+}
+
+void ObjectTable::RetireObject(XObject* object) {
+  retired_objects_.push_back(object);
+  ReleaseRetiredObjects(false);
+}
+
+void ObjectTable::ReleaseRetiredObjects(bool force) {
+  // Objects are retired after being removed from their entry, so a lookup
+  // that could still retain one must have started before that. Once no
+  // lookup is in flight at all, nothing can be about to retain them anymore.
+  // This never waits for the lookups while holding the global lock, as a
+  // thread may be suspended in the middle of one by the thread holding it.
+  // Lookups are only a few instructions long, so the retired objects are
+  // released on one of the next removals instead.
+  if (!force && AnyLookupsActive()) {
+    return;
+  }
+  // Releasing may destroy objects that remove more handles.
+  std::vector<XObject*> objects;
+  objects.swap(retired_objects_);
+  for (auto object : objects) {
+    object->Release();
+  }
 }
 
 X_STATUS ObjectTable::FindFreeSlot(uint32_t* out_slot, bool host) {
   // Find a free slot.
   uint32_t slot = host ? last_free_host_entry_ : last_free_entry_;
-  uint32_t capacity = host ? host_table_capacity_ : table_capacity_;
+  uint32_t capacity = GetCapacity(host);
+  ObjectTableEntry* entries = GetEntries(host);
   uint32_t scan_count = 0;
   while (scan_count < capacity) {
-    ObjectTableEntry& entry = host ? host_table_[slot] : table_[slot];
+    ObjectTableEntry& entry = entries[slot];
     if (!entry.object) {
       *out_slot = slot;
       return X_STATUS_SUCCESS;
@@ -86,30 +132,32 @@ X_STATUS ObjectTable::FindFreeSlot(uint32_t* out_slot, bool host) {
 }
 
 bool ObjectTable::Resize(uint32_t new_capacity, bool host) {
-  uint32_t capacity = host ? host_table_capacity_ : table_capacity_;
-  uint32_t new_size = new_capacity * sizeof(ObjectTableEntry);
-  uint32_t old_size = capacity * sizeof(ObjectTableEntry);
-  auto new_table = reinterpret_cast<ObjectTableEntry*>(
-      realloc(host ? host_table_ : table_, new_size));
+  uint32_t capacity = GetCapacity(host);
+  ObjectTableEntry* old_table = GetEntries(host);
+  // A lookup may still see the old capacity along with the new entries, so
+  // when shrinking, the entries keep the old size and only the capacity is
+  // reduced.
+  auto new_table =
+      new (std::nothrow) ObjectTableEntry[std::max(capacity, new_capacity)];
   if (!new_table) {
     return false;
   }
-
-  // Zero out new entries.
-  if (new_size > old_size) {
-    std::memset(reinterpret_cast<uint8_t*>(new_table) + old_size, 0,
-                new_size - old_size);
+  for (uint32_t n = 0; n < std::min(capacity, new_capacity); n++) {
+    new_table[n].handle_ref_count = old_table[n].handle_ref_count;
+    new_table[n].object.store(old_table[n].object.load(),
+                              std::memory_order_relaxed);
   }
 
-  if (host) {
-    last_free_host_entry_ = capacity;
-    host_table_capacity_ = new_capacity;
-    host_table_ = new_table;
-  } else {
-    last_free_entry_ = capacity;
-    table_capacity_ = new_capacity;
-    table_ = new_table;
+  // Lookups may still be reading the old entries, so they're only freed on
+  // Reset.
+  auto& table = host ? host_table_ : table_;
+  auto& table_capacity = host ? host_table_capacity_ : table_capacity_;
+  table.store(new_table, std::memory_order_release);
+  table_capacity.store(new_capacity, std::memory_order_release);
+  if (old_table) {
+    retired_tables_.push_back(old_table);
   }
+  (host ? last_free_host_entry_ : last_free_entry_) = capacity;
 
   return true;
 }
@@ -128,8 +176,7 @@ X_STATUS ObjectTable::AddHandle(XObject* object, X_HANDLE* out_handle) {
 
     // Stash.
     if (XSUCCEEDED(result)) {
-      ObjectTableEntry& entry = host_object ? host_table_[slot] : table_[slot];
-      entry.object = object;
+      ObjectTableEntry& entry = GetEntries(host_object)[slot];
       entry.handle_ref_count = 1;
       handle = slot << 2;
       if (!host_object) {
@@ -143,6 +190,7 @@ X_STATUS ObjectTable::AddHandle(XObject* object, X_HANDLE* out_handle) {
 
       // Retain so long as the object is in the table.
       object->Retain();
+      entry.object = object;
 
       XELOGI("Added handle:{:08X} for {}", handle, typeid(*object).name());
     }
@@ -219,8 +267,7 @@ X_STATUS ObjectTable::RemoveHandle(X_HANDLE handle) {
   }
 
   if (entry->object) {
-    auto object = entry->object;
-    entry->object = nullptr;
+    auto object = entry->object.exchange(nullptr);
     assert_zero(entry->handle_ref_count);
     entry->handle_ref_count = 0;
 
@@ -238,7 +285,7 @@ X_STATUS ObjectTable::RemoveHandle(X_HANDLE handle) {
       RemoveNameMapping(object->name());
     }
     // Release now that the object has been removed from the table.
-    object->Release();
+    RetireObject(object);
   }
 
   return X_STATUS_SUCCESS;
@@ -248,20 +295,15 @@ std::vector<object_ref<XObject>> ObjectTable::GetAllObjects() {
   auto lock = global_critical_region_.Acquire();
   std::vector<object_ref<XObject>> results;
 
-  for (uint32_t slot = 0; slot < host_table_capacity_; slot++) {
-    auto& entry = host_table_[slot];
-    if (entry.object && std::find(results.begin(), results.end(),
-                                  entry.object) == results.end()) {
-      entry.object->Retain();
-      results.push_back(object_ref<XObject>(entry.object));
-    }
-  }
-  for (uint32_t slot = 0; slot < table_capacity_; slot++) {
-    auto& entry = table_[slot];
-    if (entry.object && std::find(results.begin(), results.end(),
-                                  entry.object) == results.end()) {
-      entry.object->Retain();
-      results.push_back(object_ref<XObject>(entry.object));
+  for (bool host : {true, false}) {
+    ObjectTableEntry* entries = GetEntries(host);
+    for (uint32_t slot = 0; slot < GetCapacity(host); slot++) {
+      XObject* object = entries[slot].object;
+      if (object && std::find(results.begin(), results.end(), object) ==
+                        results.end()) {
+        object->Retain();
+        results.push_back(object_ref<XObject>(object));
+      }
     }
   }
 
@@ -270,13 +312,12 @@ std::vector<object_ref<XObject>> ObjectTable::GetAllObjects() {
 
 void ObjectTable::PurgeAllObjects() {
   auto lock = global_critical_region_.Acquire();
-  for (uint32_t slot = 0; slot < table_capacity_; slot++) {
-    auto& entry = table_[slot];
+  ObjectTableEntry* entries = GetEntries(false);
+  for (uint32_t slot = 0; slot < GetCapacity(false); slot++) {
+    auto& entry = entries[slot];
     if (entry.object) {
       entry.handle_ref_count = 0;
-      entry.object->Release();
-
-      entry.object = nullptr;
+      RetireObject(entry.object.exchange(nullptr));
     }
   }
 }
@@ -294,12 +335,8 @@ ObjectTable::ObjectTableEntry* ObjectTable::LookupTableInLock(X_HANDLE handle) {
 
   const bool is_host_object = XObject::is_handle_host_object(handle);
   uint32_t slot = GetHandleSlot(handle, is_host_object);
-  if (is_host_object) {
-    if (slot <= host_table_capacity_) {
-      return &host_table_[slot];
-    }
-  } else if (slot <= table_capacity_) {
-    return &table_[slot];
+  if (slot < GetCapacity(is_host_object)) {
+    return &GetEntries(is_host_object)[slot];
   }
 
   return nullptr;
@@ -320,37 +357,31 @@ XObject* ObjectTable::LookupObject(X_HANDLE handle, bool already_locked) {
     return nullptr;
   }
 
+  // No lock needed whether or not the caller holds it, see ObjectTable.
+  // The entry must only be read after counting this lookup, or a removal
+  // could release the object before it's retained here.
   XObject* object = nullptr;
-  if (!already_locked) {
-    global_critical_region_.mutex().lock();
-  }
+  std::atomic<uint32_t>& active_lookups =
+      active_lookups_[GetLookupCounterIndex()].count;
+  active_lookups.fetch_add(1);
 
   const bool is_host_object = XObject::is_handle_host_object(handle);
   uint32_t slot = GetHandleSlot(handle, is_host_object);
 
   // Verify slot.
-  if (is_host_object) {
-    if (slot < host_table_capacity_) {
-      ObjectTableEntry& entry = host_table_[slot];
-      if (entry.object) {
-        object = entry.object;
-      }
-    }
-  } else if (slot < table_capacity_) {
-    ObjectTableEntry& entry = table_[slot];
-    if (entry.object) {
-      object = entry.object;
+  uint32_t capacity = (is_host_object ? host_table_capacity_ : table_capacity_)
+                          .load(std::memory_order_acquire);
+  if (slot < capacity) {
+    ObjectTableEntry* entries = (is_host_object ? host_table_ : table_)
+                                    .load(std::memory_order_acquire);
+    object = entries[slot].object.load();
+    // Retain the object pointer.
+    if (object) {
+      object->Retain();
     }
   }
 
-  // Retain the object pointer.
-  if (object) {
-    object->Retain();
-  }
-
-  if (!already_locked) {
-    global_critical_region_.mutex().unlock();
-  }
+  active_lookups.fetch_sub(1, std::memory_order_release);
 
   return object;
 }
@@ -358,21 +389,15 @@ XObject* ObjectTable::LookupObject(X_HANDLE handle, bool already_locked) {
 void ObjectTable::GetObjectsByType(XObject::Type type,
                                    std::vector<object_ref<XObject>>* results) {
   auto global_lock = global_critical_region_.Acquire();
-  for (uint32_t slot = 0; slot < host_table_capacity_; ++slot) {
-    auto& entry = host_table_[slot];
-    if (entry.object) {
-      if (entry.object->type() == type) {
-        entry.object->Retain();
-        results->push_back(object_ref<XObject>(entry.object));
-      }
-    }
-  }
-  for (uint32_t slot = 0; slot < table_capacity_; ++slot) {
-    auto& entry = table_[slot];
-    if (entry.object) {
-      if (entry.object->type() == type) {
-        entry.object->Retain();
-        results->push_back(object_ref<XObject>(entry.object));
+  for (bool host : {true, false}) {
+    ObjectTableEntry* entries = GetEntries(host);
+    for (uint32_t slot = 0; slot < GetCapacity(host); ++slot) {
+      XObject* object = entries[slot].object;
+      if (object) {
+        if (object->type() == type) {
+          object->Retain();
+          results->push_back(object_ref<XObject>(object));
+        }
       }
     }
   }
@@ -431,34 +456,27 @@ X_STATUS ObjectTable::GetObjectByName(const std::string_view name,
 }
 
 bool ObjectTable::Save(ByteStream* stream) {
-  stream->Write<uint32_t>(host_table_capacity_);
-  for (uint32_t i = 0; i < host_table_capacity_; i++) {
-    auto& entry = host_table_[i];
-    stream->Write<int32_t>(entry.handle_ref_count);
-  }
-
-  stream->Write<uint32_t>(table_capacity_);
-  for (uint32_t i = 0; i < table_capacity_; i++) {
-    auto& entry = table_[i];
-    stream->Write<int32_t>(entry.handle_ref_count);
+  for (bool host : {true, false}) {
+    uint32_t capacity = GetCapacity(host);
+    ObjectTableEntry* entries = GetEntries(host);
+    stream->Write<uint32_t>(capacity);
+    for (uint32_t i = 0; i < capacity; i++) {
+      stream->Write<int32_t>(entries[i].handle_ref_count);
+    }
   }
 
   return true;
 }
 
 bool ObjectTable::Restore(ByteStream* stream) {
-  Resize(stream->Read<uint32_t>(), true);
-  for (uint32_t i = 0; i < host_table_capacity_; i++) {
-    auto& entry = host_table_[i];
-    // entry.object = nullptr;
-    entry.handle_ref_count = stream->Read<int32_t>();
-  }
-
-  Resize(stream->Read<uint32_t>(), false);
-  for (uint32_t i = 0; i < table_capacity_; i++) {
-    auto& entry = table_[i];
-    // entry.object = nullptr;
-    entry.handle_ref_count = stream->Read<int32_t>();
+  for (bool host : {true, false}) {
+    Resize(stream->Read<uint32_t>(), host);
+    uint32_t capacity = GetCapacity(host);
+    ObjectTableEntry* entries = GetEntries(host);
+    for (uint32_t i = 0; i < capacity; i++) {
+      // entries[i].object = nullptr;
+      entries[i].handle_ref_count = stream->Read<int32_t>();
+    }
   }
 
   return true;
@@ -467,11 +485,11 @@ bool ObjectTable::Restore(ByteStream* stream) {
 X_STATUS ObjectTable::RestoreHandle(X_HANDLE handle, XObject* object) {
   const bool is_host_object = XObject::is_handle_host_object(handle);
   uint32_t slot = GetHandleSlot(handle, is_host_object);
-  uint32_t capacity = is_host_object ? host_table_capacity_ : table_capacity_;
-  assert_true(capacity >= slot);
+  uint32_t capacity = GetCapacity(is_host_object);
+  assert_true(capacity > slot);
 
-  if (capacity >= slot) {
-    auto& entry = is_host_object ? host_table_[slot] : table_[slot];
+  if (capacity > slot) {
+    auto& entry = GetEntries(is_host_object)[slot];
     entry.object = object;
     object->Retain();
   }
@@ -10,6 +10,7 @@
 #ifndef XENIA_KERNEL_UTIL_OBJECT_TABLE_H_
 #define XENIA_KERNEL_UTIL_OBJECT_TABLE_H_
 
+#include <atomic>
 #include <string>
 #include <unordered_map>
 #include <vector>
@@ -27,6 +28,12 @@ namespace xe {
 namespace kernel {
 namespace util {
 
+// Handle lookups don't take any lock, so handle-based syscalls from different
+// threads don't contend with each other. Everything that changes the table
+// still happens in the global critical region. Objects removed from the table
+// are only released once no lookup is in flight that could still be about to
+// retain them, and the entry arrays replaced when growing are kept until
+// Reset.
 class ObjectTable {
  public:
   ObjectTable();
@@ -83,7 +90,7 @@ class ObjectTable {
  private:
   struct ObjectTableEntry {
     int handle_ref_count = 0;
-    XObject* object = nullptr;
+    std::atomic<XObject*> object = nullptr;
   };
   ObjectTableEntry* LookupTableInLock(X_HANDLE handle);
   ObjectTableEntry* LookupTable(X_HANDLE handle);
@@ -98,12 +105,40 @@ class ObjectTable {
   }
   X_STATUS FindFreeSlot(uint32_t* out_slot, bool host);
   bool Resize(uint32_t new_capacity, bool host);
+  ObjectTableEntry* GetEntries(bool host) const {
+    return (host ? host_table_ : table_).load(std::memory_order_relaxed);
+  }
+  uint32_t GetCapacity(bool host) const {
+    return (host ? host_table_capacity_ : table_capacity_)
+        .load(std::memory_order_relaxed);
+  }
+  // Takes the table's reference to an object that was just removed from its
+  // entry, releasing it once that is safe.
+  void RetireObject(XObject* object);
+  // Releases the retired objects if no lookups are in flight, or
+  // unconditionally if forced.
+  void ReleaseRetiredObjects(bool force);
 
   xe::global_critical_region global_critical_region_;
-  uint32_t table_capacity_ = 0;
-  uint32_t host_table_capacity_ = 0;
-  ObjectTableEntry* table_ = nullptr;
-  ObjectTableEntry* host_table_ = nullptr;
+  // Capacities are published after the entries, so a lookup that sees a
+  // capacity always indexes an array at least that large.
+  std::atomic<uint32_t> table_capacity_ = 0;
+  std::atomic<uint32_t> host_table_capacity_ = 0;
+  std::atomic<ObjectTableEntry*> table_ = nullptr;
+  std::atomic<ObjectTableEntry*> host_table_ = nullptr;
+  // Lookups between reading an entry and retaining its object, counted in
+  // separate cache lines for different threads so that lookups don't all
+  // write to the same line. Retired objects are released when all of them are
+  // zero.
+  static constexpr uint32_t kLookupCounterCount = 16;
+  struct alignas(64) LookupCounter {
+    std::atomic<uint32_t> count = 0;
+  };
+  LookupCounter active_lookups_[kLookupCounterCount];
+  static uint32_t GetLookupCounterIndex();
+  bool AnyLookupsActive() const;
+  std::vector<XObject*> retired_objects_;
+  std::vector<ObjectTableEntry*> retired_tables_;
   uint32_t last_free_entry_ = 0;
   uint32_t last_free_host_entry_ = 0;
   std::unordered_map<string_key_case, X_HANDLE> name_table_;
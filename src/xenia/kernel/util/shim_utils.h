@@ -23,6 +23,7 @@
 #include "xenia/cpu/ppc/ppc_context.h"
 #include "xenia/kernel/kernel_flags.h"
 #include "xenia/kernel/kernel_state.h"
+#include "xenia/kernel/util/kernel_call_stats.h"
 
 namespace xe {
 namespace kernel {
@@ -494,6 +495,18 @@ enum class KernelModuleId {
   xbdm,
 };
 
+constexpr const char* GetKernelModuleName(KernelModuleId module) {
+  switch (module) {
+    case KernelModuleId::xboxkrnl:
+      return "xboxkrnl";
+    case KernelModuleId::xam:
+      return "xam";
+    case KernelModuleId::xbdm:
+      return "xbdm";
+  }
+  return "";
+}
+
 template <size_t I = 0, typename... Ps>
 typename std::enable_if<I == sizeof...(Ps)>::type AppendKernelCallParams(
     StringBuffer& string_buffer, xe::cpu::Export* export_entry,
@@ -556,8 +569,10 @@ struct ExportRegistrerHelper {
 
     static const auto export_entry =
         new cpu::Export(ORDINAL, xe::cpu::Export::Type::kFunction, name, TAGS);
+    static util::KernelCallStats::Counters call_counters;
     struct X {
       static void Trampoline(PPCContext* ppc_context) {
+        util::KernelCallStats::ScopedCall scoped_call(call_counters);
         Param::Init init = {
             ppc_context,
             0,
@@ -606,6 +621,8 @@ struct ExportRegistrerHelper {
       }
     };
     export_entry->function_data.trampoline = &X::Trampoline;
+    util::KernelCallStats::Register(GetKernelModuleName(MODULE), export_entry,
+                                    &call_counters);
     return export_entry;
   }
 };
@@ -672,6 +689,15 @@ using xe::cpu::ExportTag;
                  xe::cpu::ExportTag::tag1 | xe::cpu::ExportTag::tag2 |   \
                      xe::cpu::ExportTag::tag3 | xe::cpu::ExportTag::tag4)
 
+// Registers an ExportIntrinsic for an export declared earlier in the file.
+#define DECLARE_EXPORT_INTRINSIC(module_name, name, intrinsic_function) \
+  const auto EXPORT_INTRINSIC_##module_name##_##name =                  \
+      EXPORT_##module_name##_##name->function_data.intrinsic =          \
+          &intrinsic_function;
+
+#define DECLARE_XBOXKRNL_EXPORT_INTRINSIC(name, intrinsic_function) \
+  DECLARE_EXPORT_INTRINSIC(xboxkrnl, name, intrinsic_function)
+
 #define DECLARE_XBOXKRNL_EMPTY_REGISTER_EXPORTS(group_name) \
   DECLARE_EMPTY_REGISTER_EXPORTS(xboxkrnl, group_name)
 
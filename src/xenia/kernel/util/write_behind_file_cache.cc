@@ -0,0 +1,137 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2026 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/kernel/util/write_behind_file_cache.h"
+
+#include <cstdio>
+#include <utility>
+
+#include "xenia/base/filesystem.h"
+#include "xenia/base/logging.h"
+
+namespace xe {
+namespace kernel {
+namespace util {
+
+WriteBehindFileCache::WriteBehindFileCache(
+    std::chrono::milliseconds flush_interval)
+    : flush_interval_(flush_interval) {
+  if (flush_interval_.count() <= 0) {
+    return;
+  }
+  flush_thread_stop_ = threading::Event::CreateManualResetEvent(false);
+  flush_thread_ = threading::Thread::Create({}, [this]() { FlushThread(); });
+  flush_thread_->set_name("File Write-Behind");
+}
+
+WriteBehindFileCache::~WriteBehindFileCache() { Shutdown(); }
+
+void WriteBehindFileCache::Write(const std::filesystem::path& path,
+                                 std::vector<uint8_t> data) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (flush_thread_) {
+      pending_[path] = std::move(data);
+      return;
+    }
+    pending_.erase(path);
+  }
+  std::lock_guard<std::mutex> flush_lock(flush_mutex_);
+  ReplaceFile(path, data);
+}
+
+bool WriteBehindFileCache::Read(const std::filesystem::path& path,
+                                std::vector<uint8_t>& data) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = pending_.find(path);
+  if (it == pending_.end()) {
+    return false;
+  }
+  data = it->second;
+  return true;
+}
+
+void WriteBehindFileCache::Discard(const std::filesystem::path& path) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  pending_.erase(path);
+}
+
+bool WriteBehindFileCache::Flush() {
+  std::lock_guard<std::mutex> flush_lock(flush_mutex_);
+  std::map<std::filesystem::path, std::vector<uint8_t>> pending;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    pending.swap(pending_);
+  }
+  bool succeeded = true;
+  for (const auto& [path, data] : pending) {
+    if (!ReplaceFile(path, data)) {
+      succeeded = false;
+    }
+  }
+  return succeeded;
+}
+
+void WriteBehindFileCache::Shutdown() {
+  if (flush_thread_) {
+    flush_thread_stop_->Set();
+    threading::Wait(flush_thread_.get(), false);
+    std::lock_guard<std::mutex> lock(mutex_);
+    // Makes further writes synchronous.
+    flush_thread_.reset();
+    flush_thread_stop_.reset();
+  }
+  Flush();
+}
+
+size_t WriteBehindFileCache::pending_count() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return pending_.size();
+}
+
+bool WriteBehindFileCache::ReplaceFile(const std::filesystem::path& path,
+                                       const std::vector<uint8_t>& data) {
+  xe::filesystem::CreateParentFolder(path);
+  // Replacing the file only when fully written.
+  std::filesystem::path temp_path = path;
+  temp_path += ".tmp";
+  FILE* file = xe::filesystem::OpenFile(temp_path, "wb");
+  if (!file) {
+    XELOGW("Failed to create {}", xe::path_to_utf8(temp_path));
+    return false;
+  }
+  bool written =
+      data.empty() || fwrite(data.data(), 1, data.size(), file) == data.size();
+  written = fclose(file) == 0 && written;
+  std::error_code error_code;
+  if (written) {
+    std::filesystem::rename(temp_path, path, error_code);
+    written = !error_code;
+  }
+  if (!written) {
+    XELOGW("Failed to write {}", xe::path_to_utf8(path));
+    std::filesystem::remove(temp_path, error_code);
+  }
+  return written;
+}
+
+void WriteBehindFileCache::FlushThread() {
+  bool stop = false;
+  while (!stop) {
+    stop = threading::Wait(flush_thread_stop_.get(), false, flush_interval_) ==
+           threading::WaitResult::kSuccess;
+    if (!stop) {
+      Flush();
+    }
+  }
+}
+
+}  // namespace util
+}  // namespace kernel
+}  // namespace xe
@@ -0,0 +1,83 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2026 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#ifndef XENIA_KERNEL_UTIL_WRITE_BEHIND_FILE_CACHE_H_
+#define XENIA_KERNEL_UTIL_WRITE_BEHIND_FILE_CACHE_H_
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "xenia/base/threading.h"
+
+namespace xe {
+namespace kernel {
+namespace util {
+
+// Host files, such as profile settings, that titles may rewrite every few
+// frames, written from a background thread instead of the guest thread
+// updating them. Writes to the same file before it's flushed are coalesced,
+// only the latest contents are written. Files are replaced atomically, by
+// writing a temporary file and renaming it over the old one, so a crash
+// during a flush leaves either the old or the new contents.
+//
+// Readers of the files must look up the pending contents with Read first.
+class WriteBehindFileCache {
+ public:
+  // A zero interval makes all writes synchronous.
+  explicit WriteBehindFileCache(std::chrono::milliseconds flush_interval);
+  ~WriteBehindFileCache();
+
+  WriteBehindFileCache(const WriteBehindFileCache&) = delete;
+  WriteBehindFileCache& operator=(const WriteBehindFileCache&) = delete;
+
+  // Replaces the file with the data, creating the parent folder if needed.
+  void Write(const std::filesystem::path& path, std::vector<uint8_t> data);
+  // Gets the contents not written to the file yet. Returns false if there are
+  // none, and the file is up to date.
+  bool Read(const std::filesystem::path& path,
+            std::vector<uint8_t>& data) const;
+  // Drops the pending contents, such as before deleting the file.
+  void Discard(const std::filesystem::path& path);
+
+  // Writes all the pending contents. Returns false if any write failed, its
+  // contents are dropped.
+  bool Flush();
+  // Stops the background thread and writes all the pending contents.
+  void Shutdown();
+
+  size_t pending_count() const;
+
+  static bool ReplaceFile(const std::filesystem::path& path,
+                          const std::vector<uint8_t>& data);
+
+ private:
+  void FlushThread();
+
+  std::chrono::milliseconds flush_interval_;
+
+  mutable std::mutex mutex_;
+  std::map<std::filesystem::path, std::vector<uint8_t>> pending_;
+  // Held while writing, so Flush returns only after the files are written,
+  // even if the background thread took the contents.
+  std::mutex flush_mutex_;
+
+  std::unique_ptr<threading::Thread> flush_thread_;
+  std::unique_ptr<threading::Event> flush_thread_stop_;
+};
+
+}  // namespace util
+}  // namespace kernel
+}  // namespace xe
+
+#endif  // XENIA_KERNEL_UTIL_WRITE_BEHIND_FILE_CACHE_H_
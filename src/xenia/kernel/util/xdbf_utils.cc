@@ -8,7 +8,9 @@
  */
 
 #include "xenia/kernel/util/xdbf_utils.h"
+
 #include <map>
+#include <unordered_map>
 
 namespace xe {
 namespace kernel {
@@ -33,6 +35,30 @@ constexpr uint64_t kXdbfIdXvc2 = 0x58564332;
 constexpr uint64_t kXdbfIdXmat = 0x584D4154;
 constexpr uint64_t kXdbfIdXsrc = 0x58535243;
 
+struct XdbfIndex {
+  struct EntryKey {
+    uint16_t section;
+    uint64_t id;
+
+    bool operator==(const EntryKey& other) const {
+      return section == other.section && id == other.id;
+    }
+    struct Hasher {
+      size_t operator()(const EntryKey& key) const {
+        return std::hash<uint64_t>()(key.id ^ (uint64_t(key.section) << 48));
+      }
+    };
+  };
+
+  std::unordered_map<EntryKey, XdbfBlock, EntryKey::Hasher> entries;
+  std::unordered_map<uint32_t, const XdbfAchievementTableEntry*> achievements;
+  std::unordered_map<uint32_t, const XdbfPropertyTableEntry*> properties;
+  std::unordered_map<uint32_t, const XdbfContextTableEntry*> contexts;
+  // Language > string ID > string.
+  std::unordered_map<uint32_t, std::unordered_map<uint16_t, std::string_view>>
+      strings;
+};
+
 XdbfWrapper::XdbfWrapper(const uint8_t* data, size_t data_size)
     : data_(data), data_size_(data_size) {
   if (!data || data_size <= sizeof(XbdfHeader)) {
@@ -58,7 +84,71 @@ XdbfWrapper::XdbfWrapper(const uint8_t* data, size_t data_size)
   content_offset_ = ptr;
 }
 
+void XdbfWrapper::BuildIndex() {
+  if (!data_ || index_) {
+    return;
+  }
+  auto index = std::make_shared<XdbfIndex>();
+
+  index->entries.reserve(header_->entry_used);
+  for (uint32_t i = 0; i < header_->entry_used; ++i) {
+    auto& entry = entries_[i];
+    XdbfBlock block;
+    block.buffer = content_offset_ + entry.offset;
+    block.size = entry.size;
+    // The first entry wins, like with the linear search.
+    index->entries.emplace(
+        XdbfIndex::EntryKey{uint16_t(entry.section), uint64_t(entry.id)},
+        block);
+    if (entry.section != uint16_t(XdbfSection::kStringTable)) {
+      continue;
+    }
+    auto xstr_head = reinterpret_cast<const XdbfSectionHeader*>(block.buffer);
+    if (xstr_head->magic != kXdbfSignatureXstr) {
+      continue;
+    }
+    auto& strings = index->strings[uint32_t(entry.id)];
+    const uint8_t* ptr = block.buffer + sizeof(XdbfSectionHeader);
+    const uint16_t string_count = xe::byte_swap<uint16_t>(*(uint16_t*)ptr);
+    ptr += sizeof(uint16_t);
+    strings.reserve(string_count);
+    for (uint16_t j = 0; j < string_count; ++j) {
+      auto string_entry = reinterpret_cast<const XdbfStringTableEntry*>(ptr);
+      ptr += sizeof(XdbfStringTableEntry);
+      strings.emplace(
+          uint16_t(string_entry->id),
+          std::string_view(reinterpret_cast<const char*>(ptr),
+                           string_entry->string_length));
+      ptr += string_entry->string_length;
+    }
+  }
+
+  // Index the tables through the linear lookups before setting index_.
+  auto achievement_table = GetAchievementTable();
+  index->achievements.reserve(achievement_table.count);
+  for (const XdbfAchievementTableEntry& entry : achievement_table) {
+    index->achievements.emplace(uint32_t(entry.id), &entry);
+  }
+  auto property_table = GetPropertyTable();
+  index->properties.reserve(property_table.count);
+  for (const XdbfPropertyTableEntry& entry : property_table) {
+    index->properties.emplace(uint32_t(entry.id), &entry);
+  }
+  auto context_table = GetContextTable();
+  index->contexts.reserve(context_table.count);
+  for (const XdbfContextTableEntry& entry : context_table) {
+    index->contexts.emplace(uint32_t(entry.id), &entry);
+  }
+
+  index_ = std::move(index);
+}
+
 XdbfBlock XdbfWrapper::GetEntry(XdbfSection section, uint64_t id) const {
+  if (index_) {
+    auto it = index_->entries.find(
+        XdbfIndex::EntryKey{static_cast<uint16_t>(section), id});
+    return it != index_->entries.end() ? it->second : XdbfBlock{0};
+  }
   for (uint32_t i = 0; i < header_->entry_used; ++i) {
     auto& entry = entries_[i];
     if (entry.section == static_cast<uint16_t>(section) && entry.id == id) {
@@ -73,10 +163,24 @@ XdbfBlock XdbfWrapper::GetEntry(XdbfSection section, uint64_t id) const {
 
 std::string XdbfWrapper::GetStringTableEntry(XLanguage language,
                                              uint16_t string_id) const {
+  return std::string(GetStringTableEntryView(language, string_id));
+}
+
+std::string_view XdbfWrapper::GetStringTableEntryView(
+    XLanguage language, uint16_t string_id) const {
+  if (index_) {
+    auto language_it = index_->strings.find(static_cast<uint32_t>(language));
+    if (language_it == index_->strings.end()) {
+      return {};
+    }
+    auto it = language_it->second.find(string_id);
+    return it != language_it->second.end() ? it->second : std::string_view();
+  }
+
   auto language_block =
       GetEntry(XdbfSection::kStringTable, static_cast<uint64_t>(language));
   if (!language_block) {
-    return "";
+    return {};
   }
 
   auto xstr_head =
@@ -92,20 +196,21 @@ std::string XdbfWrapper::GetStringTableEntry(XLanguage language,
     auto entry = reinterpret_cast<const XdbfStringTableEntry*>(ptr);
     ptr += sizeof(XdbfStringTableEntry);
     if (entry->id == string_id) {
-      return std::string(reinterpret_cast<const char*>(ptr),
-                         entry->string_length);
+      return std::string_view(reinterpret_cast<const char*>(ptr),
+                              entry->string_length);
     }
     ptr += entry->string_length;
   }
-  return "";
+  return {};
 }
 
-std::vector<XdbfAchievementTableEntry> XdbfWrapper::GetAchievements() const {
-  std::vector<XdbfAchievementTableEntry> achievements;
+XdbfTableView<XdbfAchievementTableEntry> XdbfWrapper::GetAchievementTable()
+    const {
+  XdbfTableView<XdbfAchievementTableEntry> table;
 
   auto achievement_table = GetEntry(XdbfSection::kMetadata, kXdbfIdXach);
   if (!achievement_table) {
-    return achievements;
+    return table;
   }
 
   auto xach_head =
@@ -114,23 +219,18 @@ std::vector<XdbfAchievementTableEntry> XdbfWrapper::GetAchievements() const {
   assert_true(xach_head->version == 1);
 
   const uint8_t* ptr = achievement_table.buffer + sizeof(XdbfSectionHeader);
-  const uint16_t achievement_count = xe::byte_swap<uint16_t>(*(uint16_t*)ptr);
+  table.count = xe::byte_swap<uint16_t>(*(uint16_t*)ptr);
   ptr += sizeof(uint16_t);
-
-  for (uint16_t i = 0; i < achievement_count; ++i) {
-    auto entry = reinterpret_cast<const XdbfAchievementTableEntry*>(ptr);
-    ptr += sizeof(XdbfAchievementTableEntry);
-    achievements.push_back(*entry);
-  }
-  return achievements;
+  table.entries = reinterpret_cast<const XdbfAchievementTableEntry*>(ptr);
+  return table;
 }
 
-std::vector<XdbfPropertyTableEntry> XdbfWrapper::GetProperties() const {
-  std::vector<XdbfPropertyTableEntry> properties;
+XdbfTableView<XdbfPropertyTableEntry> XdbfWrapper::GetPropertyTable() const {
+  XdbfTableView<XdbfPropertyTableEntry> table;
 
   auto property_table = GetEntry(XdbfSection::kMetadata, kXdbfIdXprp);
   if (!property_table) {
-    return properties;
+    return table;
   }
 
   auto xprp_head =
@@ -139,23 +239,18 @@ std::vector<XdbfPropertyTableEntry> XdbfWrapper::GetProperties() const {
   assert_true(xprp_head->version == 1);
 
   const uint8_t* ptr = property_table.buffer + sizeof(XdbfSectionHeader);
-  const uint16_t properties_count = xe::byte_swap<uint16_t>(*(uint16_t*)ptr);
+  table.count = xe::byte_swap<uint16_t>(*(uint16_t*)ptr);
   ptr += sizeof(uint16_t);
-
-  for (uint16_t i = 0; i < properties_count; i++) {
-    auto entry = reinterpret_cast<const XdbfPropertyTableEntry*>(ptr);
-    ptr += sizeof(XdbfPropertyTableEntry);
-    properties.push_back(*entry);
-  }
-  return properties;
+  table.entries = reinterpret_cast<const XdbfPropertyTableEntry*>(ptr);
+  return table;
 }
 
-std::vector<XdbfContextTableEntry> XdbfWrapper::GetContexts() const {
-  std::vector<XdbfContextTableEntry> contexts;
+XdbfTableView<XdbfContextTableEntry> XdbfWrapper::GetContextTable() const {
+  XdbfTableView<XdbfContextTableEntry> table;
 
   auto contexts_table = GetEntry(XdbfSection::kMetadata, kXdbfIdXctx);
   if (!contexts_table) {
-    return contexts;
+    return table;
   }
 
   auto xcxt_head =
@@ -164,15 +259,25 @@ std::vector<XdbfContextTableEntry> XdbfWrapper::GetContexts() const {
   assert_true(xcxt_head->version == 1);
 
   const uint8_t* ptr = contexts_table.buffer + sizeof(XdbfSectionHeader);
-  const uint32_t contexts_count = xe::byte_swap<uint32_t>(*(uint32_t*)ptr);
+  table.count = xe::byte_swap<uint32_t>(*(uint32_t*)ptr);
   ptr += sizeof(uint32_t);
+  table.entries = reinterpret_cast<const XdbfContextTableEntry*>(ptr);
+  return table;
+}
 
-  for (uint32_t i = 0; i < contexts_count; i++) {
-    auto entry = reinterpret_cast<const XdbfContextTableEntry*>(ptr);
-    ptr += sizeof(XdbfContextTableEntry);
-    contexts.push_back(*entry);
-  }
-  return contexts;
+std::vector<XdbfAchievementTableEntry> XdbfWrapper::GetAchievements() const {
+  auto table = GetAchievementTable();
+  return std::vector<XdbfAchievementTableEntry>(table.begin(), table.end());
+}
+
+std::vector<XdbfPropertyTableEntry> XdbfWrapper::GetProperties() const {
+  auto table = GetPropertyTable();
+  return std::vector<XdbfPropertyTableEntry>(table.begin(), table.end());
+}
+
+std::vector<XdbfContextTableEntry> XdbfWrapper::GetContexts() const {
+  auto table = GetContextTable();
+  return std::vector<XdbfContextTableEntry>(table.begin(), table.end());
 }
 
 std::vector<XdbfViewTable> XdbfWrapper::GetStatsView() const {
@@ -242,37 +347,43 @@ const uint8_t* XdbfWrapper::ReadXLast(uint32_t& compressed_size,
 }
 
 XdbfAchievementTableEntry XdbfWrapper::GetAchievement(const uint32_t id) const {
-  const auto achievements = GetAchievements();
-
-  for (const auto& entry : achievements) {
-    if (entry.id != id) {
-      continue;
+  if (index_) {
+    auto it = index_->achievements.find(id);
+    return it != index_->achievements.end() ? *it->second
+                                            : XdbfAchievementTableEntry{};
+  }
+  for (const auto& entry : GetAchievementTable()) {
+    if (entry.id == id) {
+      return entry;
     }
-    return entry;
   }
   return {};
 }
 
 XdbfPropertyTableEntry XdbfWrapper::GetProperty(const uint32_t id) const {
-  const auto properties = GetProperties();
-
-  for (const auto& entry : properties) {
-    if (entry.id != id) {
-      continue;
+  if (index_) {
+    auto it = index_->properties.find(id);
+    return it != index_->properties.end() ? *it->second
+                                          : XdbfPropertyTableEntry{};
+  }
+  for (const auto& entry : GetPropertyTable()) {
+    if (entry.id == id) {
+      return entry;
     }
-    return entry;
   }
   return {};
 }
 
 XdbfContextTableEntry XdbfWrapper::GetContext(const uint32_t id) const {
-  const auto contexts = GetContexts();
-
-  for (const auto& entry : contexts) {
-    if (entry.id != id) {
-      continue;
+  if (index_) {
+    auto it = index_->contexts.find(id);
+    return it != index_->contexts.end() ? *it->second
+                                        : XdbfContextTableEntry{};
+  }
+  for (const auto& entry : GetContextTable()) {
+    if (entry.id == id) {
+      return entry;
     }
-    return entry;
   }
   return {};
 }
@@ -10,7 +10,9 @@
 #ifndef XENIA_KERNEL_UTIL_XDBF_UTILS_H_
 #define XENIA_KERNEL_UTIL_XDBF_UTILS_H_
 
+#include <memory>
 #include <string>
+#include <string_view>
 #include <vector>
 
 #include "xenia/base/memory.h"
@@ -163,6 +165,19 @@ struct XdbfBlock {
   operator bool() const { return buffer != nullptr; }
 };
 
+// Entries of a table directly in the XDBF data, without copying.
+template <typename T>
+struct XdbfTableView {
+  const T* entries = nullptr;
+  uint32_t count = 0;
+
+  const T* begin() const { return entries; }
+  const T* end() const { return entries + count; }
+  bool empty() const { return !count; }
+};
+
+struct XdbfIndex;
+
 // Wraps an XBDF (XboxDataBaseFormat) in-memory database.
 // https://free60project.github.io/wiki/XDBF.html
 class XdbfWrapper {
@@ -171,6 +186,15 @@ class XdbfWrapper {
 
   // True if the target memory contains a valid XDBF instance.
   bool is_valid() const { return data_ != nullptr; }
+  const uint8_t* data() const { return data_; }
+  size_t data_size() const { return data_size_; }
+
+  // Builds hash maps of the entries, the table entries and the strings by
+  // their IDs, making lookups by ID constant-time instead of walking the data.
+  // The index is shared by the copies of the wrapper, so it should be built
+  // once for an XDBF that is queried repeatedly, such as the title's one.
+  void BuildIndex();
+  bool is_indexed() const { return index_ != nullptr; }
 
   // Gets an entry in the given section.
   // If the entry is not found the returned block will be nullptr.
@@ -179,6 +203,14 @@ class XdbfWrapper {
   // Gets a string from the string table in the given language.
   // Returns the empty string if the entry is not found.
   std::string GetStringTableEntry(XLanguage language, uint16_t string_id) const;
+  // Same, but referencing the XDBF data. The view is not null-terminated.
+  std::string_view GetStringTableEntryView(XLanguage language,
+                                           uint16_t string_id) const;
+
+  XdbfTableView<XdbfAchievementTableEntry> GetAchievementTable() const;
+  XdbfTableView<XdbfPropertyTableEntry> GetPropertyTable() const;
+  XdbfTableView<XdbfContextTableEntry> GetContextTable() const;
+
   std::vector<XdbfAchievementTableEntry> GetAchievements() const;
   std::vector<XdbfPropertyTableEntry> GetProperties() const;
   std::vector<XdbfContextTableEntry> GetContexts() const;
@@ -206,6 +238,8 @@ class XdbfWrapper {
   const XbdfHeader* header_ = nullptr;
   const XbdfEntry* entries_ = nullptr;
   const XbdfFileLoc* files_ = nullptr;
+
+  std::shared_ptr<const XdbfIndex> index_;
 };
 
 class XdbfGameData : public XdbfWrapper {
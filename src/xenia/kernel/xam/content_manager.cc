@@ -195,7 +195,41 @@ std::unordered_set<uint32_t> ContentManager::FindPublisherTitleIds(
 std::vector<XCONTENT_AGGREGATE_DATA> ContentManager::ListContent(
     const uint32_t device_id, const uint64_t xuid, const uint32_t title_id,
     const XContentType content_type) const {
+  CatalogKey key;
+  key.xuid = xuid;
+  key.title_id = title_id == kCurrentlyRunningTitleId
+                     ? kernel_state_->title_id()
+                     : title_id;
+  key.content_type = content_type;
+
+  std::lock_guard<std::mutex> lock(catalog_mutex_);
+  auto catalog_it = catalog_.find(key);
+  if (catalog_it == catalog_.end()) {
+    catalog_it =
+        catalog_.emplace(key, EnumerateContent(xuid, title_id, content_type))
+            .first;
+  }
+
   std::vector<XCONTENT_AGGREGATE_DATA> result;
+  result.reserve(catalog_it->second.size());
+  for (const CatalogEntry& entry : catalog_it->second) {
+    XCONTENT_AGGREGATE_DATA& content_data = result.emplace_back(entry.data);
+    if (!entry.has_header) {
+      content_data.device_id = device_id;
+    }
+  }
+  return result;
+}
+
+void ContentManager::InvalidateContentCatalog() {
+  std::lock_guard<std::mutex> lock(catalog_mutex_);
+  catalog_.clear();
+}
+
+std::vector<ContentManager::CatalogEntry> ContentManager::EnumerateContent(
+    const uint64_t xuid, const uint32_t title_id,
+    const XContentType content_type) const {
+  std::vector<CatalogEntry> result;
 
   std::unordered_set<uint32_t> title_ids = {title_id};
 
@@ -215,19 +249,18 @@ std::vector<XCONTENT_AGGREGATE_DATA> ContentManager::ListContent(
         continue;
       }
 
-      XCONTENT_AGGREGATE_DATA content_data;
-      if (XSUCCEEDED(ReadContentHeaderFile(xe::path_to_utf8(file_info.name),
-                                           xuid, title_id, content_type,
-                                           content_data))) {
-        result.emplace_back(std::move(content_data));
-      } else {
-        content_data.device_id = device_id;
+      CatalogEntry& entry = result.emplace_back();
+      XCONTENT_AGGREGATE_DATA& content_data = entry.data;
+      entry.has_header = XSUCCEEDED(
+          ReadContentHeaderFile(xe::path_to_utf8(file_info.name), xuid,
+                                title_id, content_type, content_data));
+      if (!entry.has_header) {
+        content_data.device_id = 0;
         content_data.content_type = content_type;
         content_data.set_display_name(xe::path_to_utf16(file_info.name));
         content_data.set_file_name(xe::path_to_utf8(file_info.name));
         content_data.title_id = title_id;
         content_data.xuid = xuid;
-        result.emplace_back(std::move(content_data));
       }
     }
   }
@@ -269,6 +302,8 @@ X_RESULT ContentManager::WriteContentHeaderFile(const uint64_t xuid,
                                               data.title_id, data.content_type);
   auto parent_path = header_path.parent_path();
 
+  InvalidateContentCatalog();
+
   if (!std::filesystem::exists(parent_path)) {
     if (!std::filesystem::create_directories(parent_path)) {
       return X_STATUS_ACCESS_DENIED;
@@ -334,6 +369,7 @@ X_RESULT ContentManager::CreateContent(const std::string_view root_name,
     return X_ERROR_ALREADY_EXISTS;
   }
 
+  InvalidateContentCatalog();
   if (!std::filesystem::create_directories(package_path)) {
     return X_ERROR_ACCESS_DENIED;
   }
@@ -418,6 +454,9 @@ X_RESULT ContentManager::SetContentThumbnail(
     std::vector<uint8_t> buffer) {
   auto global_lock = global_critical_region_.Acquire();
   auto package_path = ResolvePackagePath(xuid, data);
+  if (!std::filesystem::exists(package_path)) {
+    InvalidateContentCatalog();
+  }
   std::filesystem::create_directories(package_path);
   if (std::filesystem::exists(package_path)) {
     auto thumb_path = package_path / kThumbnailFileName;
@@ -440,6 +479,7 @@ X_RESULT ContentManager::DeleteContent(const uint64_t xuid,
   }
 
   auto package_path = ResolvePackagePath(xuid, data);
+  InvalidateContentCatalog();
   if (std::filesystem::remove_all(package_path) > 0) {
     return X_ERROR_SUCCESS;
   } else {
@@ -11,6 +11,7 @@
 #define XENIA_KERNEL_XAM_CONTENT_MANAGER_H_
 
 #include <memory>
+#include <mutex>
 #include <string>
 #include <unordered_map>
 #include <unordered_set>
@@ -147,9 +148,15 @@ class ContentManager {
                  const std::filesystem::path& root_path);
   ~ContentManager();
 
+  // Returns the content from the catalog, populated from the host file system
+  // on the first enumeration of the content of the XUID, the title and the
+  // type.
   std::vector<XCONTENT_AGGREGATE_DATA> ListContent(
       const uint32_t device_id, const uint64_t xuid, const uint32_t title_id,
       const XContentType content_type) const;
+  // Drops the enumerated content, for modifications of the content directories
+  // made outside the ContentManager.
+  void InvalidateContentCatalog();
 
   std::unique_ptr<ContentPackage> ResolvePackage(
       const std::string_view root_name, const uint64_t xuid,
@@ -196,9 +203,44 @@ class ContentManager {
       const uint64_t xuid,
       uint32_t base_title_id = kCurrentlyRunningTitleId) const;
 
+  struct CatalogKey {
+    uint64_t xuid;
+    // Resolved, never kCurrentlyRunningTitleId.
+    uint32_t title_id;
+    XContentType content_type;
+
+    struct Hasher {
+      size_t operator()(const CatalogKey& key) const {
+        return std::hash<uint64_t>()(key.xuid ^
+                                     (uint64_t(key.title_id) << 32) ^
+                                     uint64_t(key.content_type));
+      }
+    };
+    bool operator==(const CatalogKey& other) const {
+      return xuid == other.xuid && title_id == other.title_id &&
+             content_type == other.content_type;
+    }
+  };
+  struct CatalogEntry {
+    XCONTENT_AGGREGATE_DATA data;
+    // Without a header file, the device ID of the enumeration is used.
+    bool has_header;
+  };
+
+  std::vector<CatalogEntry> EnumerateContent(
+      const uint64_t xuid, const uint32_t title_id,
+      const XContentType content_type) const;
+
   KernelState* kernel_state_;
   std::filesystem::path root_path_;
 
+  // Enumerated content, dropped entirely on any modification as they're rare
+  // compared to enumerations, and publisher content depends on other titles.
+  mutable std::mutex catalog_mutex_;
+  mutable std::unordered_map<CatalogKey, std::vector<CatalogEntry>,
+                             CatalogKey::Hasher>
+      catalog_;
+
   // TODO(benvanik): remove use of global lock, it's bad here!
   xe::global_critical_region global_critical_region_;
   std::unordered_map<string_key, ContentPackage*> open_packages_;
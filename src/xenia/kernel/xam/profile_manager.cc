@@ -9,6 +9,7 @@
 
 #include "xenia/kernel/xam/profile_manager.h"
 
+#include <chrono>
 #include <filesystem>
 #include <vector>
 
@@ -28,6 +29,11 @@ DEFINE_string(logged_profile_slot_2_xuid, "",
               "XUID of the profile to load on boot in slot 2", "Profiles");
 DEFINE_string(logged_profile_slot_3_xuid, "",
               "XUID of the profile to load on boot in slot 3", "Profiles");
+DEFINE_uint32(profile_write_interval, 2000,
+              "Milliseconds between the writes of the profile data updated by "
+              "titles, such as their settings, to the disk. Updates within "
+              "the interval are coalesced. 0 to write them immediately.",
+              "Profiles");
 
 namespace xe {
 namespace kernel {
@@ -106,6 +112,9 @@ void ProfileManager::EncryptAccountFile(const X_XAMACCOUNTINFO* input,
 
 ProfileManager::ProfileManager(KernelState* kernel_state)
     : kernel_state_(kernel_state) {
+  write_cache_ = std::make_unique<util::WriteBehindFileCache>(
+      std::chrono::milliseconds(cvars::profile_write_interval));
+
   logged_profiles_.clear();
   accounts_.clear();
 
@@ -454,6 +463,7 @@ bool ProfileManager::CreateProfile(const std::string gamertag, bool autologin,
   if (!std::filesystem::create_directories(GetProfilePath(xuid))) {
     return false;
   }
+  kernel_state_->content_manager()->InvalidateContentCatalog();
 
   if (!MountProfile(xuid)) {
     return false;
@@ -547,8 +557,11 @@ bool ProfileManager::DeleteProfile(const uint64_t xuid) {
     accounts_.erase(xuid);
   }
 
+  // Not to recreate the files after the removal.
+  write_cache_->Flush();
   std::error_code ec;
   std::filesystem::remove_all(GetProfileContentPath(xuid), ec);
+  kernel_state_->content_manager()->InvalidateContentCatalog();
   if (ec) {
     XELOGE("Cannot remove profile: {}", ec.message());
     return false;
@@ -17,6 +17,7 @@
 
 #include "third_party/fmt/include/fmt/format.h"
 #include "xenia/base/string.h"
+#include "xenia/kernel/util/write_behind_file_cache.h"
 #include "xenia/kernel/xam/user_profile.h"
 #include "xenia/xbox.h"
 
@@ -115,6 +116,9 @@ class ProfileManager {
 
   static bool IsGamertagValid(const std::string gamertag);
 
+  // Profile data written by titles, such as their settings.
+  util::WriteBehindFileCache* write_cache() const { return write_cache_.get(); }
+
  private:
   void UpdateConfig(const uint64_t xuid, const uint8_t slot);
   bool CreateAccount(const uint64_t xuid, const std::string gamertag);
@@ -139,6 +143,7 @@ class ProfileManager {
   std::map<uint8_t, std::unique_ptr<UserProfile>> logged_profiles_;
 
   KernelState* kernel_state_;
+  std::unique_ptr<util::WriteBehindFileCache> write_cache_;
 };
 
 }  // namespace xam
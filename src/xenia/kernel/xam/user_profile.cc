@@ -9,6 +9,8 @@
 
 #include "xenia/kernel/xam/user_profile.h"
 
+#include <algorithm>
+#include <cstring>
 #include <sstream>
 
 #include "third_party/fmt/include/fmt/format.h"
@@ -136,26 +138,34 @@ void UserProfile::LoadSetting(UserSetting* setting) {
     const std::string setting_id_str =
         fmt::format("{:08X}", setting->GetSettingId());
     const std::filesystem::path file_path = content_dir / setting_id_str;
-    FILE* file = xe::filesystem::OpenFile(file_path, "rb");
-    if (!file) {
-      return;
-    }
-
-    const uint32_t input_file_size =
-        static_cast<uint32_t>(std::filesystem::file_size(file_path));
 
-    if (input_file_size < sizeof(X_USER_PROFILE_SETTING_HEADER)) {
+    // The latest contents may not be written to the file yet.
+    util::WriteBehindFileCache* write_cache =
+        kernel_state()->xam_state()->profile_manager()->write_cache();
+    std::vector<uint8_t> file_data;
+    if (!write_cache->Read(file_path, file_data)) {
+      FILE* file = xe::filesystem::OpenFile(file_path, "rb");
+      if (!file) {
+        return;
+      }
+      file_data.resize(
+          static_cast<size_t>(std::filesystem::file_size(file_path)));
+      file_data.resize(fread(file_data.data(), 1, file_data.size(), file));
       fclose(file);
+    }
+
+    if (file_data.size() < sizeof(X_USER_PROFILE_SETTING_HEADER)) {
       // Setting seems to be invalid, remove it.
+      write_cache->Discard(file_path);
       std::filesystem::remove(file_path);
       return;
     }
 
     X_USER_PROFILE_SETTING_HEADER header;
-    fread(&header, sizeof(X_USER_PROFILE_SETTING_HEADER), 1, file);
+    std::memcpy(&header, file_data.data(), sizeof(header));
     if (header.setting_id != setting->GetSettingId()) {
       // It's setting with different ID? Corrupted perhaps.
-      fclose(file);
+      write_cache->Discard(file_path);
       std::filesystem::remove(file_path);
       return;
     }
@@ -164,8 +174,10 @@ void UserProfile::LoadSetting(UserSetting* setting) {
     setting->SetNewSettingHeader(&header);
     setting->SetNewSettingSource(X_USER_PROFILE_SETTING_SOURCE::TITLE);
     std::vector<uint8_t> serialized_data(setting->GetSettingHeader()->size);
-    fread(serialized_data.data(), 1, serialized_data.size(), file);
-    fclose(file);
+    size_t serialized_size =
+        std::min(serialized_data.size(), file_data.size() - sizeof(header));
+    std::memcpy(serialized_data.data(), file_data.data() + sizeof(header),
+                serialized_size);
     setting->GetSettingData()->Deserialize(serialized_data);
   } else {
     // Unsupported for now.  Other settings aren't per-game and need to be
@@ -180,27 +192,26 @@ void UserProfile::SaveSetting(UserSetting* setting) {
     const std::filesystem::path content_dir =
         kernel_state()->content_manager()->ResolveGameUserContentPath(xuid_);
 
-    std::filesystem::create_directories(content_dir);
-
     const std::string setting_id_str =
         fmt::format("{:08X}", setting->GetSettingId());
     std::filesystem::path file_path = content_dir / setting_id_str;
-    FILE* file = xe::filesystem::OpenFile(file_path, "wb");
-
-    if (!file) {
-      return;
-    }
 
     const std::vector<uint8_t> serialized_setting =
         setting->GetSettingData()->Serialize();
     const uint32_t serialized_setting_length = std::min(
         kMaxSettingSize, static_cast<uint32_t>(serialized_setting.size()));
 
-    fwrite(setting->GetSettingHeader(), sizeof(X_USER_PROFILE_SETTING_HEADER),
-           1, file);
+    std::vector<uint8_t> file_data(sizeof(X_USER_PROFILE_SETTING_HEADER) +
+                                   serialized_setting_length);
+    std::memcpy(file_data.data(), setting->GetSettingHeader(),
+                sizeof(X_USER_PROFILE_SETTING_HEADER));
     // Writing data
-    fwrite(serialized_setting.data(), 1, serialized_setting_length, file);
-    fclose(file);
+    std::memcpy(file_data.data() + sizeof(X_USER_PROFILE_SETTING_HEADER),
+                serialized_setting.data(), serialized_setting_length);
+    // Titles may update their settings every few frames, written and
+    // coalesced in the background, creating the folder if needed.
+    kernel_state()->xam_state()->profile_manager()->write_cache()->Write(
+        file_path, std::move(file_data));
   } else {
     // Unsupported for now.  Other settings aren't per-game and need to be
     // stored some other way.
@@ -7,6 +7,7 @@
  ******************************************************************************
  */
 
+#include "xenia/base/input_latency.h"
 #include "xenia/base/logging.h"
 #include "xenia/emulator.h"
 #include "xenia/hid/input.h"
@@ -126,8 +127,16 @@ dword_result_t XamInputGetState_entry(dword_t user_index, dword_t flags,
   }
 
   auto input_system = kernel_state()->emulator()->input_system();
-  auto lock = input_system->lock();
-  return input_system->GetState(user_index, input_state);
+  // Polled states are read without waiting for the drivers.
+  std::unique_lock<xe_unlikely_mutex> lock;
+  if (!input_system->is_polling()) {
+    lock = input_system->lock();
+  }
+  X_RESULT result = input_system->GetState(user_index, input_state);
+  if (result == X_ERROR_SUCCESS && input_state) {
+    input_latency::OnGuestRead(user_index, input_state->packet_number);
+  }
+  return result;
 }
 DECLARE_XAM_EXPORT2(XamInputGetState, kInput, kImplemented, kHighFrequency);
 
@@ -7,11 +7,17 @@
  ******************************************************************************
  */
 
+#include <algorithm>
+#include <chrono>
 #include <cstring>
+#include <functional>
+#include <memory>
+#include <vector>
 
 #include "xenia/base/clock.h"
 #include "xenia/base/logging.h"
 #include "xenia/kernel/kernel_state.h"
+#include "xenia/kernel/socket_io_engine.h"
 #include "xenia/kernel/util/shim_utils.h"
 #include "xenia/kernel/xam/xam_module.h"
 #include "xenia/kernel/xam/xam_private.h"
@@ -316,69 +322,378 @@ dword_result_t NetDll_WSAGetLastError_entry() {
 }
 DECLARE_XAM_EXPORT1(NetDll_WSAGetLastError, kNetworking, kImplemented);
 
-dword_result_t NetDll_WSARecvFrom_entry(
-    dword_t caller, dword_t socket, pointer_t<XWSABUF> buffers_ptr,
-    dword_t buffer_count, lpdword_t num_bytes_recv, lpdword_t flags_ptr,
-    pointer_t<XSOCKADDR_IN> from_addr, pointer_t<XWSAOVERLAPPED> overlapped_ptr,
-    lpvoid_t completion_routine_ptr) {
-  if (overlapped_ptr) {
-    // auto evt = kernel_state()->object_table()->LookupObject<XEvent>(
-    //    overlapped_ptr->event_handle);
+struct WsaBuffer {
+  uint32_t guest_address;
+  uint32_t length;
+};
+
+std::vector<WsaBuffer> LoadWsaBuffers(uint32_t buffers_ptr,
+                                      uint32_t buffer_count,
+                                      uint32_t& total_length) {
+  auto buffers = kernel_memory()->TranslateVirtual<XWSABUF*>(buffers_ptr);
+  std::vector<WsaBuffer> wsa_buffers(buffer_count);
+  total_length = 0;
+  for (uint32_t i = 0; i < buffer_count; ++i) {
+    wsa_buffers[i].guest_address = buffers[i].buf_ptr;
+    wsa_buffers[i].length = buffers[i].len;
+    total_length += buffers[i].len;
+  }
+  return wsa_buffers;
+}
+
+// Sets the result and signals the event of the overlapped structure, and
+// queues the completion routine to the thread that started the operation.
+void CompleteWsaOverlapped(uint32_t overlapped_ptr, uint32_t error,
+                           uint32_t length, uint32_t completion_routine,
+                           uint32_t thread_handle) {
+  auto overlapped =
+      kernel_memory()->TranslateVirtual<XWSAOVERLAPPED*>(overlapped_ptr);
+  overlapped->internal_high = length;
+  overlapped->internal = error;
+  if (overlapped->event_handle) {
+    auto ev = kernel_state()->object_table()->LookupObject<XEvent>(
+        overlapped->event_handle);
+    if (ev) {
+      ev->Set(0, false);
+    }
+  }
+  if (completion_routine) {
+    auto thread =
+        kernel_state()->object_table()->LookupObject<XThread>(thread_handle);
+    if (thread) {
+      thread->EnqueueApc(completion_routine, error, length, overlapped_ptr);
+    }
+  }
+}
+
+// Completes the operation right away if possible, otherwise has the socket
+// I/O engine complete it when the socket is ready. try_transfer must not
+// block, returning -1 with X_WSAEWOULDBLOCK if the socket is not ready.
+uint32_t StartWsaOverlapped(object_ref<XSocket> socket, bool write,
+                            uint32_t num_bytes_ptr, uint32_t overlapped_ptr,
+                            uint32_t completion_routine,
+                            std::function<int(uint32_t& error)> try_transfer) {
+  const uint32_t thread_handle = XThread::GetCurrentThreadHandle();
+  uint32_t error = 0;
+  int ret = try_transfer(error);
+  if (ret >= 0) {
+    if (num_bytes_ptr) {
+      xe::store_and_swap<uint32_t>(
+          kernel_memory()->TranslateVirtual(num_bytes_ptr), uint32_t(ret));
+    }
+    CompleteWsaOverlapped(overlapped_ptr, 0, uint32_t(ret), completion_routine,
+                          thread_handle);
+    return 0;
+  }
+  SocketIOEngine* engine = kernel_state()->socket_io_engine();
+  if (error != uint32_t(X_WSAError::X_WSAEWOULDBLOCK) || !engine) {
+    XThread::SetLastError(error);
+    return ~0u;
+  }
 
-    // if (evt) {
-    //  //evt->Set(0, false);
-    //}
+  auto overlapped =
+      kernel_memory()->TranslateVirtual<XWSAOVERLAPPED*>(overlapped_ptr);
+  overlapped->internal = X_STATUS_PENDING;
+  overlapped->internal_high = 0;
+  if (overlapped->event_handle) {
+    auto ev = kernel_state()->object_table()->LookupObject<XEvent>(
+        overlapped->event_handle);
+    if (ev) {
+      ev->Reset();
+    }
   }
 
-  // we're not going to be receiving packets any time soon
-  // return error so we don't wait on that - Cancerous
-  return -1;
+  SocketIOEngine::Request request;
+  request.socket = socket;
+  request.write = write;
+  request.tag = overlapped_ptr;
+  request.try_complete = [overlapped_ptr, completion_routine, thread_handle,
+                          try_transfer]() {
+    uint32_t error = 0;
+    int ret = try_transfer(error);
+    if (ret < 0 && error == uint32_t(X_WSAError::X_WSAEWOULDBLOCK)) {
+      return false;
+    }
+    CompleteWsaOverlapped(overlapped_ptr, ret < 0 ? error : 0,
+                          ret < 0 ? 0 : uint32_t(ret), completion_routine,
+                          thread_handle);
+    return true;
+  };
+  request.cancel = [overlapped_ptr, completion_routine, thread_handle]() {
+    CompleteWsaOverlapped(overlapped_ptr,
+                          uint32_t(X_WSAError::X_WSA_OPERATION_ABORTED), 0,
+                          completion_routine, thread_handle);
+  };
+  engine->Submit(std::move(request));
+
+  XThread::SetLastError(uint32_t(X_WSAError::X_WSA_IO_PENDING));
+  return ~0u;
+}
+
+uint32_t xeWSARecvFrom(uint32_t socket_handle, uint32_t buffers_ptr,
+                       uint32_t buffer_count, uint32_t num_bytes_recv_ptr,
+                       uint32_t flags_ptr, uint32_t from_ptr,
+                       uint32_t from_len_ptr, uint32_t overlapped_ptr,
+                       uint32_t completion_routine) {
+  auto socket =
+      kernel_state()->object_table()->LookupObject<XSocket>(socket_handle);
+  if (!socket) {
+    XThread::SetLastError(uint32_t(X_WSAError::X_WSAENOTSOCK));
+    return ~0u;
+  }
+  Memory* memory = kernel_memory();
+  uint32_t flags = 0;
+  if (flags_ptr) {
+    flags = xe::load_and_swap<uint32_t>(memory->TranslateVirtual(flags_ptr));
+    // No partial messages reported.
+    xe::store_and_swap<uint32_t>(memory->TranslateVirtual(flags_ptr), 0);
+  }
+  uint32_t total_length;
+  std::vector<WsaBuffer> buffers =
+      LoadWsaBuffers(buffers_ptr, buffer_count, total_length);
+
+  // Receiving a datagram in a single call, so into a temporary buffer for
+  // multiple buffers, then scattered.
+  auto receive = [socket, buffers, total_length, flags, from_ptr, from_len_ptr](
+                     bool blocking, uint32_t& error) -> int {
+    Memory* memory = kernel_memory();
+    std::vector<uint8_t> combined_buffer;
+    uint8_t* buffer = nullptr;
+    if (buffers.size() == 1) {
+      buffer = memory->TranslateVirtual(buffers[0].guest_address);
+    } else if (total_length) {
+      combined_buffer.resize(total_length);
+      buffer = combined_buffer.data();
+    }
+    N_XSOCKADDR_IN native_from;
+    uint32_t native_from_len =
+        from_len_ptr ? xe::load_and_swap<uint32_t>(
+                           memory->TranslateVirtual(from_len_ptr))
+                     : 0;
+    int ret;
+    if (blocking) {
+      ret = socket->RecvFrom(buffer, total_length, flags,
+                             from_ptr ? &native_from : nullptr,
+                             from_len_ptr ? &native_from_len : nullptr);
+      if (ret < 0) {
+        error = socket->GetLastWSAError();
+      }
+    } else {
+      ret = socket->TryRecvFrom(buffer, total_length, flags,
+                                from_ptr ? &native_from : nullptr,
+                                from_len_ptr ? &native_from_len : nullptr,
+                                error);
+    }
+    if (ret < 0) {
+      return ret;
+    }
+    if (!combined_buffer.empty()) {
+      uint32_t offset = 0;
+      for (const WsaBuffer& wsa_buffer : buffers) {
+        uint32_t length =
+            std::min(wsa_buffer.length, uint32_t(ret) - offset);
+        std::memcpy(memory->TranslateVirtual(wsa_buffer.guest_address),
+                    combined_buffer.data() + offset, length);
+        offset += length;
+      }
+    }
+    if (from_ptr) {
+      auto from = memory->TranslateVirtual<XSOCKADDR_IN*>(from_ptr);
+      from->sin_family = native_from.sin_family;
+      from->sin_port = native_from.sin_port;
+      from->sin_addr = native_from.sin_addr;
+      std::memset(from->x_sin_zero, 0, sizeof(from->x_sin_zero));
+    }
+    if (from_len_ptr) {
+      xe::store_and_swap<uint32_t>(memory->TranslateVirtual(from_len_ptr),
+                                   native_from_len);
+    }
+    return ret;
+  };
+
+  if (overlapped_ptr) {
+    return StartWsaOverlapped(
+        socket, false, num_bytes_recv_ptr, overlapped_ptr, completion_routine,
+        [receive](uint32_t& error) { return receive(false, error); });
+  }
+
+  uint32_t error = 0;
+  int ret = receive(true, error);
+  if (ret < 0) {
+    XThread::SetLastError(error);
+    return ~0u;
+  }
+  if (num_bytes_recv_ptr) {
+    xe::store_and_swap<uint32_t>(memory->TranslateVirtual(num_bytes_recv_ptr),
+                                 uint32_t(ret));
+  }
+  return 0;
 }
-DECLARE_XAM_EXPORT2(NetDll_WSARecvFrom, kNetworking, kStub, kHighFrequency);
 
 // If the socket is a VDP socket, buffer 0 is the game data length, and buffer 1
 // is the unencrypted game data.
-dword_result_t NetDll_WSASendTo_entry(
-    dword_t caller, dword_t socket_handle, pointer_t<XWSABUF> buffers,
-    dword_t num_buffers, lpdword_t num_bytes_sent, dword_t flags,
-    pointer_t<XSOCKADDR_IN> to_ptr, dword_t to_len,
-    pointer_t<XWSAOVERLAPPED> overlapped, lpvoid_t completion_routine) {
-  assert(!overlapped);
-  assert(!completion_routine);
-
+uint32_t xeWSASendTo(uint32_t socket_handle, uint32_t buffers_ptr,
+                     uint32_t buffer_count, uint32_t num_bytes_sent_ptr,
+                     uint32_t flags, uint32_t to_ptr, uint32_t to_len,
+                     uint32_t overlapped_ptr, uint32_t completion_routine) {
   auto socket =
       kernel_state()->object_table()->LookupObject<XSocket>(socket_handle);
   if (!socket) {
     XThread::SetLastError(uint32_t(X_WSAError::X_WSAENOTSOCK));
-    return -1;
+    return ~0u;
   }
+  Memory* memory = kernel_memory();
 
   // Our sockets implementation doesn't support multiple buffers, so we need
-  // to combine the buffers the game has given us!
-  std::vector<uint8_t> combined_buffer_mem;
-  uint32_t combined_buffer_size = 0;
+  // to combine the buffers the game has given us! Copied now, as the buffers
+  // may be reused once the operation is started.
+  uint32_t combined_buffer_size;
+  std::vector<WsaBuffer> buffers =
+      LoadWsaBuffers(buffers_ptr, buffer_count, combined_buffer_size);
+  auto combined_buffer_mem =
+      std::make_shared<std::vector<uint8_t>>(combined_buffer_size);
   uint32_t combined_buffer_offset = 0;
-  for (uint32_t i = 0; i < num_buffers; i++) {
-    combined_buffer_size += buffers[i].len;
-    combined_buffer_mem.resize(combined_buffer_size);
-    uint8_t* combined_buffer = combined_buffer_mem.data();
-
-    std::memcpy(combined_buffer + combined_buffer_offset,
-                kernel_memory()->TranslateVirtual(buffers[i].buf_ptr),
-                buffers[i].len);
-    combined_buffer_offset += buffers[i].len;
+  for (const WsaBuffer& wsa_buffer : buffers) {
+    std::memcpy(combined_buffer_mem->data() + combined_buffer_offset,
+                memory->TranslateVirtual(wsa_buffer.guest_address),
+                wsa_buffer.length);
+    combined_buffer_offset += wsa_buffer.length;
   }
 
-  N_XSOCKADDR_IN native_to(to_ptr);
-  socket->SendTo(combined_buffer_mem.data(), combined_buffer_size, flags,
-                 &native_to, to_len);
+  N_XSOCKADDR_IN native_to;
+  if (to_ptr) {
+    native_to = *memory->TranslateVirtual<XSOCKADDR_IN*>(to_ptr);
+  }
 
-  // TODO: Instantly complete overlapped
+  if (overlapped_ptr) {
+    return StartWsaOverlapped(
+        socket, true, num_bytes_sent_ptr, overlapped_ptr, completion_routine,
+        [socket, combined_buffer_mem, flags, to_ptr, native_to,
+         to_len](uint32_t& error) mutable {
+          return socket->TrySendTo(
+              combined_buffer_mem->data(),
+              uint32_t(combined_buffer_mem->size()), flags,
+              to_ptr ? &native_to : nullptr, to_len, error);
+        });
+  }
 
+  int ret = socket->SendTo(combined_buffer_mem->data(), combined_buffer_size,
+                           flags, to_ptr ? &native_to : nullptr, to_len);
+  if (ret < 0) {
+    XThread::SetLastError(socket->GetLastWSAError());
+    return ~0u;
+  }
+  if (num_bytes_sent_ptr) {
+    xe::store_and_swap<uint32_t>(memory->TranslateVirtual(num_bytes_sent_ptr),
+                                 uint32_t(ret));
+  }
   return 0;
 }
+
+dword_result_t NetDll_WSARecv_entry(
+    dword_t caller, dword_t socket_handle, pointer_t<XWSABUF> buffers_ptr,
+    dword_t buffer_count, lpdword_t num_bytes_recv, lpdword_t flags_ptr,
+    pointer_t<XWSAOVERLAPPED> overlapped_ptr, lpvoid_t completion_routine_ptr) {
+  return xeWSARecvFrom(socket_handle, buffers_ptr.guest_address(),
+                       buffer_count, num_bytes_recv.guest_address(),
+                       flags_ptr.guest_address(), 0, 0,
+                       overlapped_ptr.guest_address(),
+                       completion_routine_ptr.guest_address());
+}
+DECLARE_XAM_EXPORT2(NetDll_WSARecv, kNetworking, kImplemented, kHighFrequency);
+
+dword_result_t NetDll_WSARecvFrom_entry(
+    dword_t caller, dword_t socket_handle, pointer_t<XWSABUF> buffers_ptr,
+    dword_t buffer_count, lpdword_t num_bytes_recv, lpdword_t flags_ptr,
+    pointer_t<XSOCKADDR_IN> from_addr, lpdword_t from_len_ptr,
+    pointer_t<XWSAOVERLAPPED> overlapped_ptr, lpvoid_t completion_routine_ptr) {
+  return xeWSARecvFrom(socket_handle, buffers_ptr.guest_address(),
+                       buffer_count, num_bytes_recv.guest_address(),
+                       flags_ptr.guest_address(), from_addr.guest_address(),
+                       from_len_ptr.guest_address(),
+                       overlapped_ptr.guest_address(),
+                       completion_routine_ptr.guest_address());
+}
+DECLARE_XAM_EXPORT2(NetDll_WSARecvFrom, kNetworking, kImplemented,
+                    kHighFrequency);
+
+dword_result_t NetDll_WSASend_entry(dword_t caller, dword_t socket_handle,
+                                    pointer_t<XWSABUF> buffers,
+                                    dword_t num_buffers,
+                                    lpdword_t num_bytes_sent, dword_t flags,
+                                    pointer_t<XWSAOVERLAPPED> overlapped,
+                                    lpvoid_t completion_routine) {
+  return xeWSASendTo(socket_handle, buffers.guest_address(), num_buffers,
+                     num_bytes_sent.guest_address(), flags, 0, 0,
+                     overlapped.guest_address(),
+                     completion_routine.guest_address());
+}
+DECLARE_XAM_EXPORT1(NetDll_WSASend, kNetworking, kImplemented);
+
+dword_result_t NetDll_WSASendTo_entry(
+    dword_t caller, dword_t socket_handle, pointer_t<XWSABUF> buffers,
+    dword_t num_buffers, lpdword_t num_bytes_sent, dword_t flags,
+    pointer_t<XSOCKADDR_IN> to_ptr, dword_t to_len,
+    pointer_t<XWSAOVERLAPPED> overlapped, lpvoid_t completion_routine) {
+  return xeWSASendTo(socket_handle, buffers.guest_address(), num_buffers,
+                     num_bytes_sent.guest_address(), flags,
+                     to_ptr.guest_address(), to_len,
+                     overlapped.guest_address(),
+                     completion_routine.guest_address());
+}
 DECLARE_XAM_EXPORT1(NetDll_WSASendTo, kNetworking, kImplemented);
 
+dword_result_t NetDll_WSAGetOverlappedResult_entry(
+    dword_t caller, dword_t socket_handle,
+    pointer_t<XWSAOVERLAPPED> overlapped_ptr, lpdword_t length_ptr,
+    dword_t wait, lpdword_t flags_ptr) {
+  if (!overlapped_ptr) {
+    XThread::SetLastError(uint32_t(X_WSAError::X_WSAEFAULT));
+    return 0;
+  }
+  while (overlapped_ptr->internal == X_STATUS_PENDING) {
+    if (!wait) {
+      XThread::SetLastError(uint32_t(X_WSAError::X_WSA_IO_INCOMPLETE));
+      return 0;
+    }
+    if (overlapped_ptr->event_handle) {
+      xboxkrnl::NtWaitForSingleObjectEx(overlapped_ptr->event_handle, 1, 0,
+                                        nullptr);
+    } else {
+      xe::threading::Sleep(std::chrono::milliseconds(1));
+    }
+  }
+  if (length_ptr) {
+    *length_ptr = overlapped_ptr->internal_high;
+  }
+  if (flags_ptr) {
+    *flags_ptr = 0;
+  }
+  if (overlapped_ptr->internal) {
+    XThread::SetLastError(overlapped_ptr->internal);
+    return 0;
+  }
+  return 1;
+}
+DECLARE_XAM_EXPORT2(NetDll_WSAGetOverlappedResult, kNetworking, kImplemented,
+                    kBlocking);
+
+dword_result_t NetDll_WSACancelOverlappedIO_entry(dword_t caller,
+                                                  dword_t socket_handle) {
+  auto socket =
+      kernel_state()->object_table()->LookupObject<XSocket>(socket_handle);
+  if (!socket) {
+    XThread::SetLastError(uint32_t(X_WSAError::X_WSAENOTSOCK));
+    return ~0u;
+  }
+  SocketIOEngine* engine = kernel_state()->socket_io_engine(false);
+  if (engine) {
+    engine->Cancel(socket.get());
+  }
+  return 0;
+}
+DECLARE_XAM_EXPORT1(NetDll_WSACancelOverlappedIO, kNetworking, kImplemented);
+
 dword_result_t NetDll_WSAWaitForMultipleEvents_entry(dword_t num_events,
                                                      lpdword_t events,
                                                      dword_t wait_all,
@@ -671,6 +986,13 @@ dword_result_t NetDll_closesocket_entry(dword_t caller, dword_t socket_handle) {
     return -1;
   }
 
+  // Like on Windows, the pending overlapped operations complete with
+  // WSA_OPERATION_ABORTED, before the native socket can be reused.
+  SocketIOEngine* engine = kernel_state()->socket_io_engine(false);
+  if (engine) {
+    engine->Cancel(socket.get());
+  }
+
   // TODO: Absolutely delete this object. It is no longer valid after calling
   // closesocket.
   socket->Close();
@@ -872,76 +1194,90 @@ struct host_set {
     }
   }
 
-  void Store(fd_set* native_set) {
-    FD_ZERO(native_set);
+  void AddPollEntries(std::vector<XSocket::PollEntry>& entries,
+                      uint32_t events) const {
     for (uint32_t i = 0; i < this->count; ++i) {
-      FD_SET(this->sockets[i]->native_handle(), native_set);
+      entries.push_back({this->sockets[i]->native_handle(), events, 0});
     }
   }
 
-  void UpdateFrom(fd_set* native_set) {
+  // Keeps the sockets with any of the events in the entries added by
+  // AddPollEntries.
+  void UpdateFrom(const XSocket::PollEntry* entries, uint32_t ready_events) {
     uint32_t new_count = 0;
     for (uint32_t i = 0; i < this->count; ++i) {
-      auto socket = this->sockets[i];
-      if (FD_ISSET(socket->native_handle(), native_set)) {
-        this->sockets[new_count++] = socket;
+      if (entries[i].ready_events & ready_events) {
+        this->sockets[new_count++] = this->sockets[i];
       }
     }
     this->count = new_count;
   }
 };
 
+// Waits with poll rather than select, not limited by FD_SETSIZE on the host
+// and not depending on the guest nfds, which is ignored like on Windows.
 int_result_t NetDll_select_entry(dword_t caller, dword_t nfds,
                                  pointer_t<x_fd_set> readfds,
                                  pointer_t<x_fd_set> writefds,
                                  pointer_t<x_fd_set> exceptfds,
                                  lpvoid_t timeout_ptr) {
+  std::vector<XSocket::PollEntry> entries;
   host_set host_readfds = {0};
-  fd_set native_readfds = {0};
   if (readfds) {
     host_readfds.Load(readfds);
-    host_readfds.Store(&native_readfds);
+    host_readfds.AddPollEntries(entries, XSocket::kPollRead);
   }
   host_set host_writefds = {0};
-  fd_set native_writefds = {0};
   if (writefds) {
     host_writefds.Load(writefds);
-    host_writefds.Store(&native_writefds);
+    host_writefds.AddPollEntries(entries, XSocket::kPollWrite);
   }
   host_set host_exceptfds = {0};
-  fd_set native_exceptfds = {0};
   if (exceptfds) {
     host_exceptfds.Load(exceptfds);
-    host_exceptfds.Store(&native_exceptfds);
+    host_exceptfds.AddPollEntries(entries, XSocket::kPollExcept);
   }
-  timeval* timeout_in = nullptr;
-  timeval timeout;
+  int32_t timeout_ms = -1;
   if (timeout_ptr) {
-    timeout = {static_cast<int32_t>(timeout_ptr.as_array<int32_t>()[0]),
-               static_cast<int32_t>(timeout_ptr.as_array<int32_t>()[1])};
+    timeval timeout = {
+        static_cast<int32_t>(timeout_ptr.as_array<int32_t>()[0]),
+        static_cast<int32_t>(timeout_ptr.as_array<int32_t>()[1])};
     Clock::ScaleGuestDurationTimeval(
         reinterpret_cast<int32_t*>(&timeout.tv_sec),
         reinterpret_cast<int32_t*>(&timeout.tv_usec));
-    timeout_in = &timeout;
+    timeout_ms = int32_t(std::min(int64_t(timeout.tv_sec) * 1000 +
+                                      (int64_t(timeout.tv_usec) + 999) / 1000,
+                                  int64_t(INT32_MAX)));
+  }
+  int ret = XSocket::Poll(entries.data(), uint32_t(entries.size()), timeout_ms);
+  if (ret < 0) {
+    XThread::SetLastError(XSocket::GetLastWSAError());
+    return -1;
   }
-  int ret = select(nfds, readfds ? &native_readfds : nullptr,
-                   writefds ? &native_writefds : nullptr,
-                   exceptfds ? &native_exceptfds : nullptr, timeout_in);
+
+  // Like select, counting the sockets in all the sets, and reporting errors
+  // and hang-ups as readability.
+  const XSocket::PollEntry* set_entries = entries.data();
   if (readfds) {
-    host_readfds.UpdateFrom(&native_readfds);
+    uint32_t entry_count = host_readfds.count;
+    host_readfds.UpdateFrom(set_entries,
+                            XSocket::kPollRead | XSocket::kPollError);
+    set_entries += entry_count;
     host_readfds.Store(readfds);
   }
   if (writefds) {
-    host_writefds.UpdateFrom(&native_writefds);
+    uint32_t entry_count = host_writefds.count;
+    host_writefds.UpdateFrom(set_entries, XSocket::kPollWrite);
+    set_entries += entry_count;
     host_writefds.Store(writefds);
   }
   if (exceptfds) {
-    host_exceptfds.UpdateFrom(&native_exceptfds);
+    host_exceptfds.UpdateFrom(set_entries,
+                              XSocket::kPollExcept | XSocket::kPollError);
     host_exceptfds.Store(exceptfds);
   }
-
-  // TODO(gibbed): modify ret to be what's actually copied to the guest fd_sets?
-  return ret;
+  return int32_t(host_readfds.count + host_writefds.count +
+                 host_exceptfds.count);
 }
 DECLARE_XAM_EXPORT1(NetDll_select, kNetworking, kImplemented);
 
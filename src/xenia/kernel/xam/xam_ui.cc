@@ -111,7 +111,8 @@ X_RESULT xeXamDispatchDialog(T* dialog,
     post();
     return result;
   } else {
-    kernel_state()->CompleteOverlappedDeferred(run, overlapped, pre, post);
+    kernel_state()->CompleteOverlappedDeferred(
+        run, overlapped, pre, post, KernelState::DispatchLane::kSystemUI);
     return X_ERROR_IO_PENDING;
   }
 }
@@ -155,7 +156,8 @@ X_RESULT xeXamDispatchDialogEx(
     // TODO(gibbed): do something with extended_error/length?
     return result;
   } else {
-    kernel_state()->CompleteOverlappedDeferredEx(run, overlapped, pre, post);
+    kernel_state()->CompleteOverlappedDeferredEx(
+        run, overlapped, pre, post, KernelState::DispatchLane::kSystemUI);
     return X_ERROR_IO_PENDING;
   }
 }
@@ -175,8 +177,9 @@ X_RESULT xeXamDispatchHeadless(std::function<X_RESULT()> run_callback,
     post();
     return result;
   } else {
-    kernel_state()->CompleteOverlappedDeferred(run_callback, overlapped, pre,
-                                               post);
+    kernel_state()->CompleteOverlappedDeferred(
+        run_callback, overlapped, pre, post,
+        KernelState::DispatchLane::kSystemUI);
     return X_ERROR_IO_PENDING;
   }
 }
@@ -199,8 +202,9 @@ X_RESULT xeXamDispatchHeadlessEx(
     // TODO(gibbed): do something with extended_error/length?
     return result;
   } else {
-    kernel_state()->CompleteOverlappedDeferredEx(run_callback, overlapped, pre,
-                                                 post);
+    kernel_state()->CompleteOverlappedDeferredEx(
+        run_callback, overlapped, pre, post,
+        KernelState::DispatchLane::kSystemUI);
     return X_ERROR_IO_PENDING;
   }
 }
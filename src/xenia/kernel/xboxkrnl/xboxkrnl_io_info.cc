@@ -124,6 +124,7 @@ dword_result_t NtQueryInformationFile_entry(
       // Make sure we're working with up-to-date information, just in case the
       // file size has changed via something other than NtSetInfoFile
       // (eg. seems NtWriteFile might extend the file in some cases)
+      file->Flush();
       file->entry()->update();
 
       auto info = info_ptr.as<X_FILE_NETWORK_OPEN_INFORMATION*>();
@@ -13,9 +13,11 @@
 #include "xenia/base/logging.h"
 #include "xenia/base/math.h"
 #include "xenia/kernel/kernel_state.h"
+#include "xenia/kernel/util/allocation_cache.h"
 #include "xenia/kernel/util/shim_utils.h"
 #include "xenia/kernel/xboxkrnl/xboxkrnl_memory.h"
 #include "xenia/kernel/xboxkrnl/xboxkrnl_private.h"
+#include "xenia/kernel/xthread.h"
 #include "xenia/xbox.h"
 
 DEFINE_bool(
@@ -23,6 +25,11 @@ DEFINE_bool(
     "Allows to ignore 4k offset for physical allocations with provided range. "
     "Certain titles check if result matches provided lower range.",
     "Memory");
+DEFINE_bool(guest_allocation_cache, true,
+            "Keeps a few small blocks freed by each guest thread through "
+            "MmFreePhysicalMemory and ExFreePool allocated, to hand them out "
+            "again without searching the heap under the global lock.",
+            "Memory");
 
 namespace xe {
 namespace kernel {
@@ -387,6 +394,30 @@ dword_result_t NtAllocateEncryptedMemory_entry(dword_t unk, dword_t region_size,
 }
 DECLARE_XBOXKRNL_EXPORT1(NtAllocateEncryptedMemory, kMemory, kImplemented);
 
+// The allocation cache of the calling thread, if it should be used.
+static util::AllocationCache* GetAllocationCache() {
+  if (!cvars::guest_allocation_cache || !XThread::IsInThread()) {
+    return nullptr;
+  }
+  return &XThread::GetCurrentThread()->allocation_cache();
+}
+
+// Keeps the block at the address in the allocation cache of the thread if it's
+// small enough, returns false if it has to be released.
+static bool CacheFreedAllocation(BaseHeap* heap, uint32_t address) {
+  util::AllocationCache* cache = GetAllocationCache();
+  if (!cache) {
+    return false;
+  }
+  uint32_t size, protect;
+  if (!heap->QuerySize(address, &size) ||
+      size > util::AllocationCache::kMaxBlockSize ||
+      !heap->QueryProtect(address, &protect)) {
+    return false;
+  }
+  return cache->Put(kernel_memory(), heap, address, size, protect);
+}
+
 uint32_t xeMmAllocatePhysicalMemoryEx(uint32_t flags, uint32_t region_size,
                                       uint32_t protect_bits,
                                       uint32_t min_addr_range,
@@ -447,9 +478,27 @@ uint32_t xeMmAllocatePhysicalMemoryEx(uint32_t flags, uint32_t region_size,
   heap_min_addr = heap_base + std::min(heap_min_addr, heap_size - 1);
   heap_max_addr = heap_base + std::min(heap_max_addr, heap_size - 1);
   uint32_t base_address;
-  if (!heap->AllocRange(heap_min_addr, heap_max_addr, adjusted_size,
-                        adjusted_alignment, allocation_type, protect, top_down,
-                        &base_address)) {
+  util::AllocationCache* cache = GetAllocationCache();
+  if (cache) {
+    base_address =
+        cache->Take(kernel_memory(), heap, adjusted_size, protect,
+                    adjusted_alignment, heap_min_addr, heap_max_addr);
+    if (base_address) {
+      return base_address;
+    }
+  }
+  bool allocated = heap->AllocRange(heap_min_addr, heap_max_addr,
+                                    adjusted_size, adjusted_alignment,
+                                    allocation_type, protect, top_down,
+                                    &base_address);
+  if (!allocated && cache) {
+    // The cached blocks may be what's missing.
+    cache->Flush();
+    allocated = heap->AllocRange(heap_min_addr, heap_max_addr, adjusted_size,
+                                 adjusted_alignment, allocation_type, protect,
+                                 top_down, &base_address);
+  }
+  if (!allocated) {
     // Failed - assume no memory available.
     XELOGW("MmAllocatePhysicalMemoryEx: Allocation failed: {:08X} Size: {:08X}",
            base_address, adjusted_size);
@@ -484,6 +533,9 @@ void MmFreePhysicalMemory_entry(dword_t type, dword_t base_address) {
   assert_true((base_address & 0x1F) == 0);
 
   auto heap = kernel_state()->memory()->LookupHeap(base_address);
+  if (CacheFreedAllocation(heap, base_address)) {
+    return;
+  }
   heap->Release(base_address);
 }
 DECLARE_XBOXKRNL_EXPORT1(MmFreePhysicalMemory, kMemory, kImplemented);
@@ -675,8 +727,17 @@ uint32_t xeAllocatePoolTypeWithTag(PPCContext* context, uint32_t size,
   if (size <= 0xFD8) {
     uint32_t adjusted_size = size + sizeof(X_POOL_ALLOC_HEADER);
 
-    uint32_t addr =
-        kernel_state()->memory()->SystemHeapAlloc(adjusted_size, 64);
+    // Always a single page.
+    uint32_t addr = 0;
+    if (util::AllocationCache* cache = GetAllocationCache()) {
+      addr = cache->Take(kernel_memory(),
+                         kernel_memory()->LookupHeapByType(false, 4096), 4096,
+                         kMemoryProtectRead | kMemoryProtectWrite, 0, 0,
+                         UINT32_MAX);
+    }
+    if (!addr) {
+      addr = kernel_state()->memory()->SystemHeapAlloc(adjusted_size, 64);
+    }
 
     auto result_ptr = context->TranslateVirtual<X_POOL_ALLOC_HEADER*>(addr);
     result_ptr->unk_2 = 170;
@@ -714,7 +775,11 @@ void xeFreePool(PPCContext* context, uint32_t base_address) {
   if ((base_address & (4096 - 1)) == 0) {
     memory->SystemHeapFree(base_address);
   } else {
-    memory->SystemHeapFree(base_address - sizeof(X_POOL_ALLOC_HEADER));
+    uint32_t block_address = base_address - sizeof(X_POOL_ALLOC_HEADER);
+    if (!CacheFreedAllocation(memory->LookupHeap(block_address),
+                              block_address)) {
+      memory->SystemHeapFree(block_address);
+    }
   }
 }
 
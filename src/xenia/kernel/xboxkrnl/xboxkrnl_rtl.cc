@@ -20,6 +20,7 @@
 #include "xenia/base/threading.h"
 #include "xenia/kernel/kernel_state.h"
 #include "xenia/kernel/user_module.h"
+#include "xenia/kernel/util/adaptive_spin.h"
 #include "xenia/kernel/util/shim_utils.h"
 #include "xenia/kernel/xboxkrnl/xboxkrnl_private.h"
 #include "xenia/kernel/xboxkrnl/xboxkrnl_threading.h"
@@ -605,14 +606,17 @@ void RtlEnterCriticalSection_entry(pointer_t<X_RTL_CRITICAL_SECTION> cs) {
     return;
   }
 
-  // Spin loop
-  while (spin_count--) {
-    if (xe::atomic_cas(-1, 0, &cs->lock_count)) {
-      // Acquired.
-      cs->owning_thread = cur_thread;
-      cs->recursion_count = 1;
-      return;
-    }
+  // Spin loop, for at least the spin count of the critical section.
+  auto try_acquire = [&cs]() {
+    return xe::atomic_cas(-1, 0, &cs->lock_count);
+  };
+  if (try_acquire() ||
+      util::AdaptiveSpin::Spin(cs.guest_address(), &cs->lock_count,
+                               spin_count, try_acquire)) {
+    // Acquired.
+    cs->owning_thread = cur_thread;
+    cs->recursion_count = 1;
+    return;
   }
 
   if (xe::atomic_inc(&cs->lock_count) != 0) {
@@ -69,6 +69,27 @@ class FormatData {
   virtual uint16_t peek(int32_t offset) = 0;
   virtual void skip(int32_t count) = 0;
   virtual bool put(uint16_t c) = 0;
+  // Copies the input up to the next '%' or the terminator to the output,
+  // returning the number of characters, or -1 if one can't be written.
+  virtual int32_t put_literal() = 0;
+
+  // Text of arguments, returning false if a character can't be written.
+  virtual bool put(const uint8_t* chars, int32_t length) {
+    while (length-- > 0) {
+      if (!put(*chars++)) {
+        return false;
+      }
+    }
+    return true;
+  }
+  virtual bool put_swapped(const uint16_t* chars, int32_t length) {
+    while (length-- > 0) {
+      if (!put(xe::byte_swap(*chars++))) {
+        return false;
+      }
+    }
+    return true;
+  }
 };
 
 class ArgList {
@@ -161,6 +182,12 @@ int32_t format_core(PPCContext* ppc_context, FormatData& data, ArgList& args,
           return -1;
         }
         ++count;
+        // The text up to the next specification is copied at once.
+        int32_t literal_count = data.put_literal();
+        if (literal_count < 0) {
+          return -1;
+        }
+        count += literal_count;
         continue;
       }
 
@@ -562,15 +589,9 @@ int32_t format_core(PPCContext* ppc_context, FormatData& data, ArgList& args,
               int32_t length;
 
               if (!is_wide) {
-                length = 0;
-                for (auto s = (const uint8_t*)str; cap > 0 && *s; ++s, cap--) {
-                  length++;
-                }
+                length = int32_t(strnlen((const char*)str, size_t(cap)));
               } else {
-                length = 0;
-                for (auto s = (const uint16_t*)str; cap > 0 && *s; ++s, cap--) {
-                  length++;
-                }
+                length = int32_t(xe::find_terminator_be16(str, size_t(cap)));
               }
 
               text.buffer = str;
@@ -641,20 +662,15 @@ int32_t format_core(PPCContext* ppc_context, FormatData& data, ArgList& args,
     int32_t remaining = text.length;
     if (!text.is_wide) {
       // it's a const char*
-      auto b = (const uint8_t*)text.buffer;
-      while (remaining-- > 0) {
-        if (!data.put(*b++)) {
-          return -1;
-        }
+      if (!data.put((const uint8_t*)text.buffer, remaining)) {
+        return -1;
       }
     } else {
       // it's a const char16_t*
       auto b = (const uint16_t*)text.buffer;
       if (text.swap_wide) {
-        while (remaining-- > 0) {
-          if (!data.put(xe::byte_swap(*b++))) {
-            return -1;
-          }
+        if (!data.put_swapped(b, remaining)) {
+          return -1;
         }
       } else {
         while (remaining-- > 0) {
@@ -702,21 +718,16 @@ class StackArgList : public ArgList {
 
 class ArrayArgList : public ArgList {
  public:
+  // The arguments are contiguous, so only translated once.
   ArrayArgList(PPCContext* ppc_context, uint32_t arg_ptr)
-      : ppc_context(ppc_context), arg_ptr_(arg_ptr), index_(0) {}
+      : args_(ppc_context->TranslateVirtual<const uint64_t*>(arg_ptr)) {}
 
   uint32_t get32() { return (uint32_t)get64(); }
 
-  uint64_t get64() {
-    auto value = SHIM_MEM_64(arg_ptr_ + (8 * index_));
-    ++index_;
-    return value;
-  }
+  uint64_t get64() { return xe::load_and_swap<uint64_t>(args_++); }
 
  private:
-  PPCContext* ppc_context;
-  uint32_t arg_ptr_;
-  int32_t index_;
+  const uint64_t* args_;
 };
 
 class StringFormatData : public FormatData {
@@ -749,6 +760,20 @@ class StringFormatData : public FormatData {
     return true;
   }
 
+  int32_t put_literal() {
+    auto literal = reinterpret_cast<const char*>(input_);
+    size_t length = std::strcspn(literal, "%");
+    output_.append(literal, length);
+    input_ += length;
+    return int32_t(length);
+  }
+
+  using FormatData::put;
+  bool put(const uint8_t* chars, int32_t length) {
+    output_.append(reinterpret_cast<const char*>(chars), length);
+    return true;
+  }
+
   const std::string& str() const { return output_; }
 
  private:
@@ -783,6 +808,22 @@ class WideStringFormatData : public FormatData {
     return true;
   }
 
+  int32_t put_literal() {
+    size_t length = xe::find_terminator_be16(input_, SIZE_MAX, u'%');
+    put_swapped(input_, int32_t(length));
+    input_ += length;
+    return int32_t(length);
+  }
+
+  using FormatData::put;
+  bool put_swapped(const uint16_t* chars, int32_t length) {
+    size_t offset = output_.size();
+    output_.resize(offset + length);
+    xe::copy_and_swap(reinterpret_cast<uint16_t*>(&output_[offset]), chars,
+                      length);
+    return true;
+  }
+
   const std::u16string& wstr() const { return output_; }
 
  private:
@@ -817,6 +858,23 @@ class WideCountFormatData : public FormatData {
     return true;
   }
 
+  int32_t put_literal() {
+    size_t length = xe::find_terminator_be16(input_, SIZE_MAX, u'%');
+    input_ += length;
+    count_ += int32_t(length);
+    return int32_t(length);
+  }
+
+  using FormatData::put;
+  bool put(const uint8_t* chars, int32_t length) {
+    count_ += length;
+    return true;
+  }
+  bool put_swapped(const uint16_t* chars, int32_t length) {
+    count_ += length;
+    return true;
+  }
+
   const int32_t count() const { return count_; }
 
  private:
@@ -14,9 +14,11 @@
 #include "xenia/base/clock.h"
 #include "xenia/base/logging.h"
 #include "xenia/base/mutex.h"
+#include "xenia/cpu/ppc/ppc_hir_builder.h"
 #include "xenia/cpu/processor.h"
 #include "xenia/kernel/kernel_state.h"
 #include "xenia/kernel/user_module.h"
+#include "xenia/kernel/util/adaptive_spin.h"
 #include "xenia/kernel/util/shim_utils.h"
 #include "xenia/kernel/xboxkrnl/xboxkrnl_private.h"
 #include "xenia/kernel/xevent.h"
@@ -390,6 +392,41 @@ dword_result_t KeGetCurrentProcessType_entry(const ppc_context_t& context) {
 DECLARE_XBOXKRNL_EXPORT2(KeGetCurrentProcessType, kThreading, kImplemented,
                          kHighFrequency);
 
+// Same as xeKeGetCurrentProcessType.
+bool KeGetCurrentProcessType_intrinsic(cpu::ppc::PPCHIRBuilder& f) {
+  using namespace xe::cpu::hir;
+  auto load = [&f](Value* address, size_t offset, TypeName type) {
+    return f.LoadOffset(address, f.LoadConstantInt64(int64_t(offset)), type);
+  };
+  Value* pcr = f.LoadGPR(13);
+  Label* in_dpc = f.NewLabel();
+  Label* done = f.NewLabel();
+  // Nonzero in either byte order.
+  f.BranchTrue(load(pcr,
+                    offsetof(X_KPCR, prcb_data) + offsetof(X_KPRCB, dpc_active),
+                    INT32_TYPE),
+               in_dpc);
+  Value* thread = f.ZeroExtend(
+      f.ByteSwap(load(pcr,
+                      offsetof(X_KPCR, prcb_data) +
+                          offsetof(X_KPRCB, current_thread),
+                      INT32_TYPE)),
+      INT64_TYPE);
+  f.StoreGPR(3, f.ZeroExtend(load(thread, offsetof(X_KTHREAD, process_type),
+                                  INT8_TYPE),
+                             INT64_TYPE));
+  f.Branch(done);
+  f.MarkLabel(in_dpc);
+  f.StoreGPR(3, f.ZeroExtend(load(pcr,
+                                  offsetof(X_KPCR, processtype_value_in_dpc),
+                                  INT8_TYPE),
+                             INT64_TYPE));
+  f.MarkLabel(done);
+  return true;
+}
+DECLARE_XBOXKRNL_EXPORT_INTRINSIC(KeGetCurrentProcessType,
+                                  KeGetCurrentProcessType_intrinsic);
+
 void KeSetCurrentProcessType_entry(dword_t type, const ppc_context_t& context) {
   xeKeSetCurrentProcessType(type, context);
 }
@@ -402,6 +439,14 @@ dword_result_t KeQueryPerformanceFrequency_entry() {
 DECLARE_XBOXKRNL_EXPORT2(KeQueryPerformanceFrequency, kThreading, kImplemented,
                          kHighFrequency);
 
+bool KeQueryPerformanceFrequency_intrinsic(cpu::ppc::PPCHIRBuilder& f) {
+  f.StoreGPR(3, f.LoadConstantUint64(
+                    static_cast<uint32_t>(Clock::guest_tick_frequency())));
+  return true;
+}
+DECLARE_XBOXKRNL_EXPORT_INTRINSIC(KeQueryPerformanceFrequency,
+                                  KeQueryPerformanceFrequency_intrinsic);
+
 uint32_t KeDelayExecutionThread(uint32_t processor_mode, uint32_t alertable,
                                 uint64_t* interval_ptr,
                                 cpu::ppc::PPCContext* ctx) {
@@ -448,6 +493,7 @@ void KeQuerySystemTime_entry(lpqword_t time_ptr, const ppc_context_t& ctx) {
     // like we ought to keep it consistent with ketimestampbundle in case
     // something uses this function, but also reads it directly
     uint32_t ts_bundle = ctx->kernel_state->GetKeTimestampBundle();
+    ctx->kernel_state->RefreshKeTimestampBundle();
     uint64_t time = Clock::QueryGuestSystemTime();
     // todo: cmpxchg?
     xe::store_and_swap<uint64_t>(
@@ -492,6 +538,26 @@ dword_result_t KeTlsGetValue_entry(dword_t tls_index) {
 DECLARE_XBOXKRNL_EXPORT2(KeTlsGetValue, kThreading, kImplemented,
                          kHighFrequency);
 
+// The slots follow the TLS data of the executable in the block at r13 + 0,
+// which is the same for all threads.
+bool KeTlsGetValue_intrinsic(cpu::ppc::PPCHIRBuilder& f) {
+  using namespace xe::cpu::hir;
+  if (!kernel_state()->GetExecutableModule()) {
+    return false;
+  }
+  Value* tls_ptr = f.ByteSwap(f.Load(f.LoadGPR(13), INT32_TYPE));
+  Value* slot_address =
+      f.Add(f.Add(tls_ptr, f.LoadConstantUint32(XThread::GetTLSExtendedSize(
+                               kernel_state()))),
+            f.Shl(f.Truncate(f.LoadGPR(3), INT32_TYPE), int8_t(2)));
+  f.StoreGPR(3, f.ZeroExtend(f.ByteSwap(f.Load(
+                                 f.ZeroExtend(slot_address, INT64_TYPE),
+                                 INT32_TYPE)),
+                             INT64_TYPE));
+  return true;
+}
+DECLARE_XBOXKRNL_EXPORT_INTRINSIC(KeTlsGetValue, KeTlsGetValue_intrinsic);
+
 // https://msdn.microsoft.com/en-us/library/ms686818
 dword_result_t KeTlsSetValue_entry(dword_t tls_index, dword_t tls_value) {
   // xboxkrnl doesn't actually have an error branch - it always succeeds, even
@@ -1112,11 +1178,18 @@ uint32_t xeKeKfAcquireSpinLock(PPCContext* ctx, X_KSPINLOCK* lock,
   PrefetchForCAS(lock);
   assert_true(lock->prcb_of_owner != static_cast<uint32_t>(ctx->r[13]));
   // Lock.
-  while (!xe::atomic_cas(0, xe::byte_swap(static_cast<uint32_t>(ctx->r[13])),
-                         &lock->prcb_of_owner.value)) {
-    // Spin!
-    // TODO(benvanik): error on deadlock?
-    xe::threading::MaybeYield();
+  uint32_t owner = xe::byte_swap(static_cast<uint32_t>(ctx->r[13]));
+  auto try_acquire = [lock, owner]() {
+    return xe::atomic_cas(0, owner, &lock->prcb_of_owner.value);
+  };
+  if (!try_acquire() &&
+      !util::AdaptiveSpin::Spin(ctx->HostToGuestVirtual(lock),
+                                &lock->prcb_of_owner.value, 0, try_acquire)) {
+    // Held for longer than usual, or usually held for long.
+    while (!try_acquire()) {
+      // TODO(benvanik): error on deadlock?
+      xe::threading::MaybeYield();
+    }
   }
 
   return old_irql;
@@ -1263,21 +1336,23 @@ uint32_t xeNtQueueApcThread(uint32_t thread_handle, uint32_t apc_routine,
     return X_STATUS_INVALID_HANDLE;
   }
 
-  uint32_t apc_ptr = memory->SystemHeapAlloc(XAPC::kSize);
+  // The host tick count of queueing follows the APC, for log_apc_stats.
+  uint32_t apc_ptr = memory->SystemHeapAlloc(XAPC::kSize + sizeof(uint64_t));
   if (!apc_ptr) {
     return X_STATUS_NO_MEMORY;
   }
   XAPC* apc = context->TranslateVirtual<XAPC*>(apc_ptr);
   xeKeInitializeApc(apc, thread->guest_object(), XAPC::kDummyKernelRoutine, 0,
                     apc_routine, 1 /*user apc mode*/, apc_routine_context);
+  xe::store<uint64_t>(context->TranslateVirtual(apc_ptr + XAPC::kSize),
+                      Clock::QueryHostTickCount());
 
   if (!xeKeInsertQueueApc(apc, arg1, arg2, 0, context)) {
     memory->SystemHeapFree(apc_ptr);
     return X_STATUS_UNSUCCESSFUL;
   }
-  // no-op, just meant to awaken a sleeping alertable thread to process real
-  // apcs
-  thread->thread()->QueueUserCallback([]() {});
+  // Awakens a sleeping alertable thread to process the real APCs.
+  thread->WakeForApcs();
   return X_STATUS_SUCCESS;
 }
 dword_result_t NtQueueApcThread_entry(dword_t thread_handle,
@@ -1309,12 +1384,78 @@ X_STATUS xeProcessUserApcs(PPCContext* ctx) {
   uint32_t scratch_address = old_stack_pointer - 16;
   ctx->r[1] = old_stack_pointer - 32;
 
+  XThread* xthread = XThread::GetCurrentThread();
+
   while (!user_apc_queue.empty(ctx)) {
     uint32_t apc_ptr = user_apc_queue.flink_ptr;
 
     XAPC* apc = user_apc_queue.ListEntryObject(
         ctx->TranslateVirtual<X_LIST_ENTRY*>(apc_ptr));
 
+    if (apc->kernel_routine == XAPC::kDummyKernelRoutine) {
+      // APCs from NtQueueApcThread are owned by the kernel, nothing can take
+      // them out of the queue but delivery, so the consecutive ones are all
+      // dequeued under a single acquisition of the lock.
+      struct BatchedApc {
+        uint32_t apc_ptr;
+        uint32_t normal_routine;
+        uint32_t normal_context;
+        uint32_t arg1;
+        uint32_t arg2;
+      };
+      constexpr uint32_t kMaxApcBatch = 32;
+      BatchedApc batch[kMaxApcBatch];
+      uint32_t batch_count = 0;
+      uint64_t now = Clock::QueryHostTickCount();
+      uint64_t latency_sum = 0, latency_max = 0;
+      while (true) {
+        BatchedApc& batched = batch[batch_count++];
+        batched.apc_ptr = apc_ptr;
+        batched.normal_routine = apc->normal_routine;
+        batched.normal_context = apc->normal_context;
+        batched.arg1 = apc->arg1;
+        batched.arg2 = apc->arg2;
+        uint64_t latency =
+            now - std::min(now, xe::load<uint64_t>(ctx->TranslateVirtual(
+                                    apc_ptr + XAPC::kSize)));
+        latency_sum += latency;
+        latency_max = std::max(latency_max, latency);
+        util::XeRemoveEntryList(&apc->list_entry, ctx);
+        apc->enqueued = 0;
+        if (batch_count >= kMaxApcBatch || user_apc_queue.empty(ctx)) {
+          break;
+        }
+        apc_ptr = user_apc_queue.flink_ptr;
+        apc = user_apc_queue.ListEntryObject(
+            ctx->TranslateVirtual<X_LIST_ENTRY*>(apc_ptr));
+        if (apc->kernel_routine != XAPC::kDummyKernelRoutine) {
+          break;
+        }
+      }
+      xeKeKfReleaseSpinLock(ctx, &current_thread->apc_lock, unlocked_irql);
+      alert_status = X_STATUS_USER_APC;
+
+      if (xthread) {
+        xthread->RecordApcBatch(batch_count, latency_sum, latency_max,
+                                batch_count);
+      }
+      for (uint32_t i = 0; i < batch_count; ++i) {
+        ctx->kernel_state->memory()->SystemHeapFree(batch[i].apc_ptr);
+      }
+      for (uint32_t i = 0; i < batch_count; ++i) {
+        const BatchedApc& batched = batch[i];
+        if (batched.normal_routine) {
+          uint64_t normal_args[] = {batched.normal_context, batched.arg1,
+                                    batched.arg2};
+          ctx->processor->Execute(ctx->thread_state, batched.normal_routine,
+                                  normal_args, xe::countof(normal_args));
+        }
+      }
+
+      unlocked_irql = xeKeKfAcquireSpinLock(ctx, &current_thread->apc_lock);
+      continue;
+    }
+
     uint8_t* scratch_ptr = ctx->TranslateVirtual(scratch_address);
     xe::store_and_swap<uint32_t>(scratch_ptr + 0, apc->normal_routine);
     xe::store_and_swap<uint32_t>(scratch_ptr + 4, apc->normal_context);
@@ -1325,19 +1466,18 @@ X_STATUS xeProcessUserApcs(PPCContext* ctx) {
 
     xeKeKfReleaseSpinLock(ctx, &current_thread->apc_lock, unlocked_irql);
     alert_status = X_STATUS_USER_APC;
-    if (apc->kernel_routine != XAPC::kDummyKernelRoutine) {
-      uint64_t kernel_args[] = {
-          apc_ptr,
-          scratch_address + 0,
-          scratch_address + 4,
-          scratch_address + 8,
-          scratch_address + 12,
-      };
-      ctx->processor->Execute(ctx->thread_state, apc->kernel_routine,
-                              kernel_args, xe::countof(kernel_args));
-    } else {
-      ctx->kernel_state->memory()->SystemHeapFree(apc_ptr);
+    if (xthread) {
+      xthread->RecordApcBatch(1, 0, 0, 0);
     }
+    uint64_t kernel_args[] = {
+        apc_ptr,
+        scratch_address + 0,
+        scratch_address + 4,
+        scratch_address + 8,
+        scratch_address + 12,
+    };
+    ctx->processor->Execute(ctx->thread_state, apc->kernel_routine,
+                            kernel_args, xe::countof(kernel_args));
 
     uint32_t normal_routine = xe::load_and_swap<uint32_t>(scratch_ptr + 0);
     uint32_t normal_context = xe::load_and_swap<uint32_t>(scratch_ptr + 4);
@@ -23,14 +23,16 @@ XEvent::~XEvent() = default;
 void XEvent::Initialize(bool manual_reset, bool initial_state) {
   assert_false(event_);
 
-  this->CreateNative<X_KEVENT>();
+  native_header_ = &this->CreateNative<X_KEVENT>()->header;
 
+  manual_reset_ = manual_reset;
   if (manual_reset) {
-    event_ = xe::threading::Event::CreateManualResetEvent(initial_state);
+    event_ = xe::threading::Event::CreateManualResetEvent(false);
   } else {
-    event_ = xe::threading::Event::CreateAutoResetEvent(initial_state);
+    event_ = xe::threading::Event::CreateAutoResetEvent(false);
   }
   assert_not_null(event_);
+  signaled_ = initial_state;
 }
 
 void XEvent::InitializeNative(void* native_ptr, X_DISPATCH_HEADER* header) {
@@ -48,55 +50,140 @@ void XEvent::InitializeNative(void* native_ptr, X_DISPATCH_HEADER* header) {
       return;
   }
 
-  bool initial_state = header->signal_state ? true : false;
+  native_header_ = header;
   if (manual_reset_) {
-    event_ = xe::threading::Event::CreateManualResetEvent(initial_state);
+    event_ = xe::threading::Event::CreateManualResetEvent(false);
   } else {
-    event_ = xe::threading::Event::CreateAutoResetEvent(initial_state);
+    event_ = xe::threading::Event::CreateAutoResetEvent(false);
   }
   assert_not_null(event_);
+  signaled_ = header->signal_state ? true : false;
+}
+
+void XEvent::SetNativeSignalState(bool signaled) {
+  if (native_header_) {
+    native_header_->signal_state = signaled ? 1 : 0;
+  }
 }
 
 int32_t XEvent::Set(uint32_t priority_increment, bool wait) {
-  event_->Set();
+  std::lock_guard<xe_mutex> lock(state_mutex_);
+  if (host_waiters_) {
+    event_->Set();
+    host_signaled_ = true;
+  } else {
+    signaled_ = true;
+  }
+  SetNativeSignalState(true);
   return 1;
 }
 
 int32_t XEvent::Pulse(uint32_t priority_increment, bool wait) {
-  event_->Pulse();
+  std::lock_guard<xe_mutex> lock(state_mutex_);
+  if (host_waiters_) {
+    event_->Pulse();
+  } else {
+    // Nobody to release.
+    signaled_ = false;
+  }
+  SetNativeSignalState(false);
   return 1;
 }
 
 int32_t XEvent::Reset() {
-  event_->Reset();
+  Clear();
   return 1;
 }
 void XEvent::Query(uint32_t* out_type, uint32_t* out_state) {
-  auto [type, state] = event_->Query();
+  std::lock_guard<xe_mutex> lock(state_mutex_);
+  if (host_waiters_) {
+    auto [type, state] = event_->Query();
+    *out_type = type;
+    *out_state = state;
+    return;
+  }
+  // NotificationEvent or SynchronizationEvent.
+  *out_type = manual_reset_ ? 0 : 1;
+  *out_state = signaled_ ? 1 : 0;
+}
+void XEvent::Clear() {
+  std::lock_guard<xe_mutex> lock(state_mutex_);
+  if (host_waiters_) {
+    event_->Reset();
+  } else {
+    signaled_ = false;
+  }
+  SetNativeSignalState(false);
+}
+
+bool XEvent::TryAcquireFast() {
+  std::lock_guard<xe_mutex> lock(state_mutex_);
+  if (host_waiters_ || !signaled_) {
+    return false;
+  }
+  if (!manual_reset_) {
+    signaled_ = false;
+    SetNativeSignalState(false);
+  }
+  return true;
+}
 
-  *out_type = type;
-  *out_state = state;
+void XEvent::BeginHostWait() {
+  std::lock_guard<xe_mutex> lock(state_mutex_);
+  if (!host_waiters_++ && signaled_) {
+    event_->Set();
+    signaled_ = false;
+    host_signaled_ = true;
+  }
+}
+
+void XEvent::EndHostWait() {
+  std::lock_guard<xe_mutex> lock(state_mutex_);
+  assert_not_zero(host_waiters_);
+  if (--host_waiters_ || !host_signaled_) {
+    return;
+  }
+  // Take back whatever state the host waiters left, consuming it if
+  // auto-reset.
+  signaled_ = xe::threading::Wait(event_.get(), false,
+                                  std::chrono::milliseconds(0)) ==
+              xe::threading::WaitResult::kSuccess;
+  if (signaled_ && manual_reset_) {
+    event_->Reset();
+  }
+  host_signaled_ = false;
+  SetNativeSignalState(signaled_);
+}
+
+void XEvent::BeginHostSignal() {
+  BeginHostWait();
+  // Set through the host event, as by Set with host waiters.
+  std::lock_guard<xe_mutex> lock(state_mutex_);
+  host_signaled_ = true;
+  SetNativeSignalState(true);
 }
-void XEvent::Clear() { event_->Reset(); }
 
 bool XEvent::Save(ByteStream* stream) {
   XELOGD("XEvent {:08X} ({})", handle(), manual_reset_ ? "manual" : "auto");
   SaveObject(stream);
 
-  bool signaled = true;
-  auto result =
-      xe::threading::Wait(event_.get(), false, std::chrono::milliseconds(0));
-  if (result == xe::threading::WaitResult::kSuccess) {
-    signaled = true;
-  } else if (result == xe::threading::WaitResult::kTimeout) {
-    signaled = false;
-  } else {
-    assert_always();
-  }
-
-  if (signaled) {
-    // Reset the event in-case it's an auto-reset.
-    event_->Set();
+  bool signaled;
+  {
+    std::lock_guard<xe_mutex> lock(state_mutex_);
+    signaled = signaled_;
+    if (host_waiters_) {
+      auto result = xe::threading::Wait(event_.get(), false,
+                                        std::chrono::milliseconds(0));
+      if (result == xe::threading::WaitResult::kSuccess) {
+        signaled = true;
+        // Reset the event in-case it's an auto-reset.
+        event_->Set();
+      } else if (result == xe::threading::WaitResult::kTimeout) {
+        signaled = false;
+      } else {
+        assert_always();
+      }
+    }
   }
 
   stream->Write<bool>(signaled);
@@ -111,7 +198,7 @@ object_ref<XEvent> XEvent::Restore(KernelState* kernel_state,
   evt->kernel_state_ = kernel_state;
 
   evt->RestoreObject(stream);
-  bool signaled = stream->Read<bool>();
+  evt->signaled_ = stream->Read<bool>();
   evt->manual_reset_ = stream->Read<bool>();
 
   if (evt->manual_reset_) {
@@ -121,8 +208,8 @@ object_ref<XEvent> XEvent::Restore(KernelState* kernel_state,
   }
   assert_not_null(evt->event_);
 
-  if (signaled) {
-    evt->event_->Set();
+  if (evt->guest_object()) {
+    evt->native_header_ = evt->guest_object<X_DISPATCH_HEADER>();
   }
 
   return object_ref<XEvent>(evt);
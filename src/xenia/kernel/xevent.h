@@ -10,6 +10,7 @@
 #ifndef XENIA_KERNEL_XEVENT_H_
 #define XENIA_KERNEL_XEVENT_H_
 
+#include "xenia/base/mutex.h"
 #include "xenia/base/threading.h"
 #include "xenia/kernel/xobject.h"
 #include "xenia/xbox.h"
@@ -45,10 +46,27 @@ class XEvent : public XObject {
 
  protected:
   xe::threading::WaitHandle* GetWaitHandle() override { return event_.get(); }
+  bool TryAcquireFast() override;
+  void BeginHostWait() override;
+  void EndHostWait() override;
+  void BeginHostSignal() override;
 
  private:
+  void SetNativeSignalState(bool signaled);
+
   bool manual_reset_ = false;
   std::unique_ptr<xe::threading::Event> event_;
+  X_DISPATCH_HEADER* native_header_ = nullptr;
+
+  // While no host thread waits on the event, its state is kept in signaled_
+  // and event_ stays reset, so that guest code setting and resetting it
+  // doesn't need host kernel calls. The first host waiter moves the state
+  // into event_ and the last one takes it back.
+  xe_mutex state_mutex_;
+  bool signaled_ = false;
+  uint32_t host_waiters_ = 0;
+  // Whether event_ may have been set since the first host waiter.
+  bool host_signaled_ = false;
 };
 
 }  // namespace kernel
@@ -16,6 +16,7 @@
 #include "xenia/base/mutex.h"
 #include "xenia/kernel/kernel_state.h"
 #include "xenia/kernel/xevent.h"
+#include "xenia/kernel/xthread.h"
 #include "xenia/memory.h"
 
 namespace xe {
@@ -180,6 +181,65 @@ X_STATUS XFile::Read(uint32_t buffer_guest_address, uint32_t buffer_length,
   return result;
 }
 
+bool XFile::ReadAsync(uint32_t buffer_guest_address, uint32_t buffer_length,
+                      uint64_t byte_offset, uint32_t apc_routine,
+                      uint32_t apc_context,
+                      uint32_t io_status_block_guest_address,
+                      object_ref<XEvent> event) {
+  // Reads from the current position would have to be ordered against each
+  // other, and most devices can't be read from several threads.
+  if (is_synchronous_ || byte_offset >= uint64_t(-2) ||
+      !file_->supports_concurrent_reads()) {
+    return false;
+  }
+  auto thread = retain_object(XThread::GetCurrentThread());
+  auto io_status_block =
+      io_status_block_guest_address
+          ? memory()->TranslateVirtual<X_IO_STATUS_BLOCK*>(
+                io_status_block_guest_address)
+          : nullptr;
+
+  // Before queueing, as the read may complete right away.
+  async_event_->Reset();
+  if (event) {
+    event->Reset();
+  }
+  if (io_status_block) {
+    io_status_block->status = X_STATUS_PENDING;
+    io_status_block->information = 0;
+  }
+
+  return kernel_state()->QueueFileIO([file = retain_object(this), thread,
+                                      event, buffer_guest_address,
+                                      buffer_length, byte_offset, apc_routine,
+                                      apc_context, io_status_block,
+                                      io_status_block_guest_address]() {
+    uint32_t bytes_read = 0;
+    X_STATUS result = file->Read(buffer_guest_address, buffer_length,
+                                 byte_offset, &bytes_read, apc_context, false);
+    if (io_status_block) {
+      io_status_block->status = result;
+      io_status_block->information = bytes_read;
+    }
+
+    XIOCompletion::IONotification notify;
+    notify.apc_context = apc_context;
+    notify.num_bytes = bytes_read;
+    notify.status = result;
+    file->NotifyIOCompletionPorts(notify);
+    file->async_event_->Set();
+
+    // Low bit probably means do not queue to IO ports.
+    if (thread && (apc_routine & ~1u) && apc_context) {
+      thread->EnqueueApc(apc_routine & ~1u, apc_context,
+                         io_status_block_guest_address, 0);
+    }
+    if (event) {
+      event->Set(0, false);
+    }
+  });
+}
+
 X_STATUS XFile::ReadScatter(uint32_t segments_guest_address, uint32_t length,
                             uint64_t byte_offset, uint32_t* out_bytes_read,
                             uint32_t apc_context) {
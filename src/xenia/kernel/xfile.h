@@ -157,6 +157,15 @@ class XFile : public XObject {
                 uint64_t byte_offset, uint32_t* out_bytes_read,
                 uint32_t apc_context, bool notify_completion = true);
 
+  // Queues a read of a file opened for overlapped access on the kernel file
+  // I/O threads and returns true, or returns false if it has to be done
+  // synchronously instead. Once the read is done, the status block is written
+  // and the completion ports, the file, the APC and the event are signaled.
+  bool ReadAsync(uint32_t buffer_guest_address, uint32_t buffer_length,
+                 uint64_t byte_offset, uint32_t apc_routine,
+                 uint32_t apc_context, uint32_t io_status_block_guest_address,
+                 object_ref<XEvent> event);
+
   X_STATUS ReadScatter(uint32_t segments_guest_address, uint32_t length,
                        uint64_t byte_offset, uint32_t* out_bytes_read,
                        uint32_t apc_context);
@@ -166,6 +175,7 @@ class XFile : public XObject {
                  uint32_t apc_context);
 
   X_STATUS SetLength(size_t length);
+  X_STATUS Flush() { return file_->Flush(); }
   X_STATUS Rename(const std::filesystem::path file_path);
 
   void RegisterIOCompletionPort(uint32_t key, object_ref<XIOCompletion> port);
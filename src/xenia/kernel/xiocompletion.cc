@@ -9,9 +9,18 @@
 
 #include "xenia/kernel/xiocompletion.h"
 
+#include "xenia/base/logging.h"
+#include "xenia/base/metrics.h"
+
 namespace xe {
 namespace kernel {
 
+namespace {
+metrics::Histogram io_completion_queue_depth_(
+    "Kernel", "io_completion_queue_depth",
+    "Notifications already queued in an I/O completion port when queueing");
+}  // namespace
+
 XIOCompletion::XIOCompletion(KernelState* kernel_state)
     : XObject(kernel_state, kObjectType) {
   notification_semaphore_ = threading::Semaphore::Create(0, kMaxNotifications);
@@ -23,7 +32,14 @@ XIOCompletion::~XIOCompletion() = default;
 void XIOCompletion::QueueNotification(IONotification& notification) {
   std::unique_lock<std::mutex> lock(notification_lock_);
 
-  notifications_.push(notification);
+  if (notification_count_ >= kMaxNotifications) {
+    XELOGW("XIOCompletion: Dropping a notification, the queue is full");
+    return;
+  }
+  io_completion_queue_depth_.Record(notification_count_);
+  notifications_[(notifications_read_index_ + notification_count_) %
+                 kMaxNotifications] = notification;
+  ++notification_count_;
   notification_semaphore_->Release(1, nullptr);
 }
 
@@ -33,10 +49,12 @@ bool XIOCompletion::WaitForNotification(uint64_t wait_ticks,
   auto res = threading::Wait(notification_semaphore_.get(), false, ms);
   if (res == threading::WaitResult::kSuccess) {
     std::unique_lock<std::mutex> lock(notification_lock_);
-    assert_false(notifications_.empty());
+    assert_not_zero(notification_count_);
 
-    std::memcpy(notify, &notifications_.front(), sizeof(IONotification));
-    notifications_.pop();
+    *notify = notifications_[notifications_read_index_];
+    notifications_read_index_ =
+        (notifications_read_index_ + 1) % kMaxNotifications;
+    --notification_count_;
 
     return true;
   }
@@ -10,7 +10,8 @@
 #ifndef XENIA_KERNEL_XIOCOMPLETION_H_
 #define XENIA_KERNEL_XIOCOMPLETION_H_
 
-#include <queue>
+#include <array>
+#include <mutex>
 
 #include "xenia/base/threading.h"
 #include "xenia/kernel/xobject.h"
@@ -42,7 +43,12 @@ class XIOCompletion : public XObject {
   static const uint32_t kMaxNotifications = 1024;
 
   std::mutex notification_lock_;
-  std::queue<IONotification> notifications_;
+  // Fixed ring of at most as many notifications as the semaphore can count,
+  // rather than a heap-allocated queue, as notifications are queued on every
+  // asynchronous I/O completion.
+  std::array<IONotification, kMaxNotifications> notifications_;
+  uint32_t notifications_read_index_ = 0;
+  uint32_t notification_count_ = 0;
   std::unique_ptr<threading::Semaphore> notification_semaphore_ = nullptr;
 };
 
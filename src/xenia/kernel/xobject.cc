@@ -199,13 +199,27 @@ X_STATUS XObject::Wait(uint32_t wait_reason, uint32_t processor_mode,
     return X_STATUS_SUCCESS;
   }
 
+  if (TryAcquireFast()) {
+    WaitCallback();
+    return X_STATUS_SUCCESS;
+  }
+
   auto timeout_ms =
       opt_timeout ? std::chrono::milliseconds(Clock::ScaleGuestDurationMillis(
                         TimeoutTicksToMs(*opt_timeout)))
                   : std::chrono::milliseconds::max();
 
+  // Polling doesn't give the run slot to other threads.
+  if (!opt_timeout || *opt_timeout) {
+    XThread::ReleaseRunSlot();
+  }
+  BeginHostWait();
   auto result =
       xe::threading::Wait(wait_handle, alertable ? true : false, timeout_ms);
+  EndHostWait();
+  XThread::AcquireRunSlot();
+  XThread::SampleHostProcessor();
+  kernel_state_->RefreshKeTimestampBundle();
   switch (result) {
     case xe::threading::WaitResult::kSuccess:
       WaitCallback();
@@ -231,9 +245,19 @@ X_STATUS XObject::SignalAndWait(XObject* signal_object, XObject* wait_object,
                         TimeoutTicksToMs(*opt_timeout)))
                   : std::chrono::milliseconds::max();
 
+  if (!opt_timeout || *opt_timeout) {
+    XThread::ReleaseRunSlot();
+  }
+  signal_object->BeginHostSignal();
+  wait_object->BeginHostWait();
   auto result = xe::threading::SignalAndWait(
       signal_object->GetWaitHandle(), wait_object->GetWaitHandle(),
       alertable ? true : false, timeout_ms);
+  wait_object->EndHostWait();
+  signal_object->EndHostWait();
+  XThread::AcquireRunSlot();
+  XThread::SampleHostProcessor();
+  wait_object->kernel_state_->RefreshKeTimestampBundle();
   switch (result) {
     case xe::threading::WaitResult::kSuccess:
       wait_object->WaitCallback();
@@ -267,9 +291,27 @@ X_STATUS XObject::WaitMultiple(uint32_t count, XObject** objects,
                         TimeoutTicksToMs(*opt_timeout)))
                   : std::chrono::milliseconds::max();
 
+  if (!opt_timeout || *opt_timeout) {
+    XThread::ReleaseRunSlot();
+  }
+  for (size_t i = 0; i < count; ++i) {
+    objects[i]->BeginHostWait();
+  }
+  auto end_host_waits = [count, objects]() {
+    for (size_t i = 0; i < count; ++i) {
+      objects[i]->EndHostWait();
+    }
+    XThread::AcquireRunSlot();
+    XThread::SampleHostProcessor();
+    if (count) {
+      objects[0]->kernel_state_->RefreshKeTimestampBundle();
+    }
+  };
+
   if (wait_type) {
     auto result = xe::threading::WaitAny(wait_handles, count,
                                          alertable ? true : false, timeout_ms);
+    end_host_waits();
     switch (result.first) {
       case xe::threading::WaitResult::kSuccess:
         objects[result.second]->WaitCallback();
@@ -290,6 +332,7 @@ X_STATUS XObject::WaitMultiple(uint32_t count, XObject** objects,
   } else {
     auto result = xe::threading::WaitAll(wait_handles, count,
                                          alertable ? true : false, timeout_ms);
+    end_host_waits();
     switch (result) {
       case xe::threading::WaitResult::kSuccess:
         for (uint32_t i = 0; i < count; i++) {
@@ -16,6 +16,7 @@
 #include <string>
 
 #include "xenia/base/threading.h"
+#include "xenia/base/type_pool.h"
 #include "xenia/memory.h"
 #include "xenia/xbox.h"
 
@@ -99,7 +100,9 @@ struct X_OBJECT_CREATE_INFORMATION {
   // Security QoS here (SECURITY_QUALITY_OF_SERVICE) too!
 };
 
-class XObject {
+// Allocated from pools as titles may create and close objects like events
+// very frequently, such as every frame.
+class XObject : public ThreadCachedPoolAllocated {
  public:
   // 45410806 needs proper handle value for certain calculations
   // It gets handle value from TLS (without base handle value is 0x88)
@@ -232,6 +235,19 @@ class XObject {
   virtual void WaitCallback() {}
   virtual xe::threading::WaitHandle* GetWaitHandle() { return nullptr; }
 
+  // Objects may keep their signal state outside of the host wait handle while
+  // no host thread waits on them, so that signaling them doesn't need a host
+  // kernel call. TryAcquireFast satisfies a wait from that state if possible.
+  // Every host wait on GetWaitHandle is bracketed by BeginHostWait, which
+  // moves the state into the host wait handle, and EndHostWait.
+  virtual bool TryAcquireFast() { return false; }
+  virtual void BeginHostWait() {}
+  virtual void EndHostWait() {}
+  // Like BeginHostWait, but for a host call that signals the wait handle
+  // directly, such as the signal object of SignalAndWait, so that EndHostWait
+  // takes back the state the signal left.
+  virtual void BeginHostSignal() { BeginHostWait(); }
+
   // Creates the kernel object for guest code to use. Typically not needed.
   uint8_t* CreateNative(uint32_t size);
   void SetNativePointer(uint32_t native_ptr, bool uninitialized = false);
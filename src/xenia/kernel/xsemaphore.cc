@@ -23,10 +23,15 @@ XSemaphore::~XSemaphore() = default;
 bool XSemaphore::Initialize(int32_t initial_count, int32_t maximum_count) {
   assert_false(semaphore_);
 
-  CreateNative(sizeof(X_KSEMAPHORE));
+  native_header_ = reinterpret_cast<X_DISPATCH_HEADER*>(
+      CreateNative(sizeof(X_KSEMAPHORE)));
 
+  if (initial_count < 0 || initial_count > maximum_count) {
+    return false;
+  }
   maximum_count_ = maximum_count;
-  semaphore_ = xe::threading::Semaphore::Create(initial_count, maximum_count);
+  count_ = uint32_t(initial_count);
+  semaphore_ = xe::threading::Semaphore::Create(0, maximum_count);
   return !!semaphore_;
 }
 
@@ -34,37 +39,111 @@ bool XSemaphore::InitializeNative(void* native_ptr, X_DISPATCH_HEADER* header) {
   assert_false(semaphore_);
 
   auto semaphore = reinterpret_cast<X_KSEMAPHORE*>(native_ptr);
+  int32_t initial_count = semaphore->header.signal_state;
+  if (initial_count < 0 || uint32_t(initial_count) > semaphore->limit) {
+    return false;
+  }
+  native_header_ = header;
   maximum_count_ = semaphore->limit;
-  semaphore_ = xe::threading::Semaphore::Create(semaphore->header.signal_state,
-                                                semaphore->limit);
+  count_ = uint32_t(initial_count);
+  semaphore_ = xe::threading::Semaphore::Create(0, semaphore->limit);
   return !!semaphore_;
 }
 
+void XSemaphore::SetNativeSignalState() {
+  if (native_header_) {
+    native_header_->signal_state = count_;
+  }
+}
+
 int32_t XSemaphore::ReleaseSemaphore(int32_t release_count) {
+  std::lock_guard<xe_mutex> lock(state_mutex_);
   int32_t previous_count = 0;
-  semaphore_->Release(release_count, &previous_count);
+  if (host_waiters_) {
+    semaphore_->Release(release_count, &previous_count);
+    host_released_ = true;
+    return previous_count;
+  }
+  previous_count = int32_t(count_);
+  if (release_count > 0 &&
+      uint32_t(release_count) <= maximum_count_ - count_) {
+    count_ += uint32_t(release_count);
+    SetNativeSignalState();
+  }
   return previous_count;
 }
 
+bool XSemaphore::TryAcquireFast() {
+  std::lock_guard<xe_mutex> lock(state_mutex_);
+  if (host_waiters_ || !count_) {
+    return false;
+  }
+  --count_;
+  SetNativeSignalState();
+  return true;
+}
+
+void XSemaphore::BeginHostWait() {
+  std::lock_guard<xe_mutex> lock(state_mutex_);
+  if (!host_waiters_++ && count_) {
+    semaphore_->Release(int32_t(count_), nullptr);
+    count_ = 0;
+    host_released_ = true;
+  }
+}
+
+void XSemaphore::EndHostWait() {
+  std::lock_guard<xe_mutex> lock(state_mutex_);
+  assert_not_zero(host_waiters_);
+  if (--host_waiters_ || !host_released_) {
+    return;
+  }
+  // Take back the count the host waiters left.
+  while (threading::Wait(semaphore_.get(), false,
+                         std::chrono::milliseconds(0)) ==
+         threading::WaitResult::kSuccess) {
+    ++count_;
+  }
+  host_released_ = false;
+  SetNativeSignalState();
+}
+
+void XSemaphore::BeginHostSignal() {
+  BeginHostWait();
+  // Released through the host semaphore, as by ReleaseSemaphore with host
+  // waiters.
+  std::lock_guard<xe_mutex> lock(state_mutex_);
+  host_released_ = true;
+}
+
 bool XSemaphore::Save(ByteStream* stream) {
   if (!SaveObject(stream)) {
     return false;
   }
 
-  // Get the free number of slots from the semaphore.
-  uint32_t free_count = 0;
-  while (
-      threading::Wait(semaphore_.get(), false, std::chrono::milliseconds(0)) ==
-      threading::WaitResult::kSuccess) {
-    free_count++;
+  uint32_t free_count;
+  {
+    std::lock_guard<xe_mutex> lock(state_mutex_);
+    free_count = count_;
+    if (host_waiters_) {
+      // Get the free number of slots from the semaphore.
+      uint32_t host_count = 0;
+      while (threading::Wait(semaphore_.get(), false,
+                             std::chrono::milliseconds(0)) ==
+             threading::WaitResult::kSuccess) {
+        host_count++;
+      }
+      // Restore the semaphore back to its previous count.
+      if (host_count) {
+        semaphore_->Release(host_count, nullptr);
+      }
+      free_count = host_count;
+    }
   }
 
   XELOGD("XSemaphore {:08X} (count {}/{})", handle(), free_count,
          maximum_count_);
 
-  // Restore the semaphore back to its previous count.
-  semaphore_->Release(free_count, nullptr);
-
   stream->Write(maximum_count_);
   stream->Write(free_count);
 
@@ -85,10 +164,14 @@ object_ref<XSemaphore> XSemaphore::Restore(KernelState* kernel_state,
   XELOGD("XSemaphore {:08X} (count {}/{})", sem->handle(), free_count,
          sem->maximum_count_);
 
-  sem->semaphore_ =
-      threading::Semaphore::Create(free_count, sem->maximum_count_);
+  sem->count_ = free_count;
+  sem->semaphore_ = threading::Semaphore::Create(0, sem->maximum_count_);
   assert_not_null(sem->semaphore_);
 
+  if (sem->guest_object()) {
+    sem->native_header_ = sem->guest_object<X_DISPATCH_HEADER>();
+  }
+
   return object_ref<XSemaphore>(sem);
 }
 
@@ -10,6 +10,7 @@
 #ifndef XENIA_KERNEL_XSEMAPHORE_H_
 #define XENIA_KERNEL_XSEMAPHORE_H_
 
+#include "xenia/base/mutex.h"
 #include "xenia/base/threading.h"
 #include "xenia/kernel/xobject.h"
 #include "xenia/kernel/xthread.h"
@@ -38,10 +39,25 @@ class XSemaphore : public XObject {
   xe::threading::WaitHandle* GetWaitHandle() override {
     return semaphore_.get();
   }
+  bool TryAcquireFast() override;
+  void BeginHostWait() override;
+  void EndHostWait() override;
+  void BeginHostSignal() override;
 
  private:
+  void SetNativeSignalState();
+
   std::unique_ptr<xe::threading::Semaphore> semaphore_;
   uint32_t maximum_count_ = 0;
+  X_DISPATCH_HEADER* native_header_ = nullptr;
+
+  // Like the state of XEvent, the count is kept in count_ while no host
+  // thread waits on the semaphore, and semaphore_ stays at zero.
+  xe_mutex state_mutex_;
+  uint32_t count_ = 0;
+  uint32_t host_waiters_ = 0;
+  // Whether semaphore_ may have been released since the first host waiter.
+  bool host_released_ = false;
 };
 
 }  // namespace kernel
@@ -10,7 +10,10 @@
 #include "src/xenia/kernel/xsocket.h"
 
 #include <cstring>
+#include <vector>
 
+#include "xenia/base/logging.h"
+#include "xenia/base/metrics.h"
 #include "xenia/base/platform.h"
 #include "xenia/kernel/kernel_state.h"
 #include "xenia/kernel/xam/xam_module.h"
@@ -26,6 +29,7 @@
 #include <arpa/inet.h>
 #include <netinet/in.h>
 #include <netinet/ip.h>
+#include <poll.h>
 #include <sys/socket.h>
 #include <unistd.h>
 #endif
@@ -33,6 +37,23 @@
 namespace xe {
 namespace kernel {
 
+namespace {
+
+xe::metrics::Counter socket_bytes_received_("Kernel", "socket_bytes_received",
+                                            "Bytes received on guest sockets");
+xe::metrics::Counter socket_bytes_sent_("Kernel", "socket_bytes_sent",
+                                        "Bytes sent on guest sockets");
+
+bool IsLastErrorWouldBlock() {
+#ifdef XE_PLATFORM_WIN32
+  return WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+  return errno == EAGAIN || errno == EWOULDBLOCK;
+#endif
+}
+
+}  // namespace
+
 XSocket::XSocket(KernelState* kernel_state)
     : XObject(kernel_state, kObjectType) {}
 
@@ -60,6 +81,10 @@ X_STATUS XSocket::Initialize(AddressFamily af, Type type, Protocol proto) {
 }
 
 X_STATUS XSocket::Close() {
+  if (native_handle_ == uint64_t(-1)) {
+    return X_STATUS_SUCCESS;
+  }
+
 #if XE_PLATFORM_WIN32
   int ret = closesocket(native_handle_);
 #elif XE_PLATFORM_LINUX
@@ -69,6 +94,15 @@ X_STATUS XSocket::Close() {
   if (ret != 0) {
     return X_STATUS_UNSUCCESSFUL;
   }
+  native_handle_ = uint64_t(-1);
+
+  if (receive_count_ || send_count_) {
+    XELOGD(
+        "Socket {:08X} closed: received {} bytes in {} operations, sent {} "
+        "bytes in {} operations",
+        handle(), uint64_t(bytes_received_), uint64_t(receive_count_),
+        uint64_t(bytes_sent_), uint64_t(send_count_));
+  }
 
   return X_STATUS_SUCCESS;
 }
@@ -176,7 +210,13 @@ object_ref<XSocket> XSocket::Accept(N_XSOCKADDR* name, int* name_len) {
 int XSocket::Shutdown(int how) { return shutdown(native_handle_, how); }
 
 int XSocket::Recv(uint8_t* buf, uint32_t buf_len, uint32_t flags) {
-  return recv(native_handle_, reinterpret_cast<char*>(buf), buf_len, flags);
+  int ret = recv(native_handle_, reinterpret_cast<char*>(buf), buf_len, flags);
+  if (ret >= 0) {
+    bytes_received_ += ret;
+    ++receive_count_;
+    socket_bytes_received_.Increment(ret);
+  }
+  return ret;
 }
 
 int XSocket::RecvFrom(uint8_t* buf, uint32_t buf_len, uint32_t flags,
@@ -219,12 +259,23 @@ int XSocket::RecvFrom(uint8_t* buf, uint32_t buf_len, uint32_t flags,
     *from_len = nfromlen;
   }
 
+  if (ret >= 0) {
+    bytes_received_ += ret;
+    ++receive_count_;
+    socket_bytes_received_.Increment(ret);
+  }
   return ret;
 }
 
 int XSocket::Send(const uint8_t* buf, uint32_t buf_len, uint32_t flags) {
-  return send(native_handle_, reinterpret_cast<const char*>(buf), buf_len,
-              flags);
+  int ret = send(native_handle_, reinterpret_cast<const char*>(buf), buf_len,
+                 flags);
+  if (ret >= 0) {
+    bytes_sent_ += ret;
+    ++send_count_;
+    socket_bytes_sent_.Increment(ret);
+  }
+  return ret;
 }
 
 int XSocket::SendTo(uint8_t* buf, uint32_t buf_len, uint32_t flags,
@@ -247,8 +298,112 @@ int XSocket::SendTo(uint8_t* buf, uint32_t buf_len, uint32_t flags,
     nto.sin_port = to->sin_port;
   }
 
-  return sendto(native_handle_, reinterpret_cast<char*>(buf), buf_len, flags,
-                to ? (sockaddr*)&nto : nullptr, to_len);
+  int ret = sendto(native_handle_, reinterpret_cast<char*>(buf), buf_len,
+                   flags, to ? (sockaddr*)&nto : nullptr, to_len);
+  if (ret >= 0) {
+    bytes_sent_ += ret;
+    ++send_count_;
+    socket_bytes_sent_.Increment(ret);
+  }
+  return ret;
+}
+
+int XSocket::TryRecvFrom(uint8_t* buf, uint32_t buf_len, uint32_t flags,
+                         N_XSOCKADDR_IN* from, uint32_t* from_len,
+                         uint32_t& error) {
+#ifdef XE_PLATFORM_WIN32
+  // No per-call non-blocking flag. Datagrams and stream data that have been
+  // reported can be received without blocking unless another thread takes
+  // them first.
+  PollEntry entry = {native_handle_, kPollRead, 0};
+  if (Poll(&entry, 1, 0) <= 0) {
+    error = uint32_t(X_WSAError::X_WSAEWOULDBLOCK);
+    return -1;
+  }
+  int ret = RecvFrom(buf, buf_len, flags, from, from_len);
+#else
+  int ret = RecvFrom(buf, buf_len, flags | MSG_DONTWAIT, from, from_len);
+#endif
+  if (ret < 0) {
+    error = IsLastErrorWouldBlock() ? uint32_t(X_WSAError::X_WSAEWOULDBLOCK)
+                                    : GetLastWSAError();
+  }
+  return ret;
+}
+
+int XSocket::TrySendTo(uint8_t* buf, uint32_t buf_len, uint32_t flags,
+                       N_XSOCKADDR_IN* to, uint32_t to_len, uint32_t& error) {
+#ifdef XE_PLATFORM_WIN32
+  PollEntry entry = {native_handle_, kPollWrite, 0};
+  if (Poll(&entry, 1, 0) <= 0) {
+    error = uint32_t(X_WSAError::X_WSAEWOULDBLOCK);
+    return -1;
+  }
+  int ret = SendTo(buf, buf_len, flags, to, to_len);
+#else
+  int ret = SendTo(buf, buf_len, flags | MSG_DONTWAIT, to, to_len);
+#endif
+  if (ret < 0) {
+    error = IsLastErrorWouldBlock() ? uint32_t(X_WSAError::X_WSAEWOULDBLOCK)
+                                    : GetLastWSAError();
+  }
+  return ret;
+}
+
+int XSocket::Poll(PollEntry* entries, uint32_t count, int32_t timeout_ms) {
+#ifdef XE_PLATFORM_WIN32
+  // WSAPoll rejects POLLPRI, out-of-band data is reported as POLLRDBAND.
+  constexpr short kNativeRead = POLLRDNORM;
+  constexpr short kNativeWrite = POLLWRNORM;
+  constexpr short kNativeExcept = POLLRDBAND;
+  std::vector<WSAPOLLFD> native_entries(count);
+#else
+  constexpr short kNativeRead = POLLIN;
+  constexpr short kNativeWrite = POLLOUT;
+  constexpr short kNativeExcept = POLLPRI;
+  std::vector<pollfd> native_entries(count);
+#endif
+  for (uint32_t i = 0; i < count; ++i) {
+    auto& native_entry = native_entries[i];
+    native_entry.fd = decltype(native_entry.fd)(entries[i].native_handle);
+    native_entry.events = 0;
+    native_entry.revents = 0;
+    if (entries[i].events & kPollRead) {
+      native_entry.events |= kNativeRead;
+    }
+    if (entries[i].events & kPollWrite) {
+      native_entry.events |= kNativeWrite;
+    }
+    if (entries[i].events & kPollExcept) {
+      native_entry.events |= kNativeExcept;
+    }
+  }
+#ifdef XE_PLATFORM_WIN32
+  int ret = WSAPoll(native_entries.data(), ULONG(count), timeout_ms);
+#else
+  int ret = poll(native_entries.data(), nfds_t(count), timeout_ms);
+#endif
+  if (ret < 0) {
+    return -1;
+  }
+  for (uint32_t i = 0; i < count; ++i) {
+    short revents = native_entries[i].revents;
+    uint32_t ready_events = 0;
+    if (revents & kNativeRead) {
+      ready_events |= kPollRead;
+    }
+    if (revents & kNativeWrite) {
+      ready_events |= kPollWrite;
+    }
+    if (revents & kNativeExcept) {
+      ready_events |= kPollExcept;
+    }
+    if (revents & (POLLERR | POLLHUP | POLLNVAL)) {
+      ready_events |= kPollError;
+    }
+    entries[i].ready_events = ready_events;
+  }
+  return ret;
 }
 
 bool XSocket::QueuePacket(uint32_t src_ip, uint16_t src_port,
@@ -279,7 +434,7 @@ X_STATUS XSocket::GetSockName(uint8_t* buf, int* buf_len) {
   return X_STATUS_SUCCESS;
 }
 
-uint32_t XSocket::GetLastWSAError() const {
+uint32_t XSocket::GetLastWSAError() {
   // Todo(Gliniak): Provide error mapping table
   // Xbox error codes might not match with what we receive from OS
 #ifdef XE_PLATFORM_WIN32
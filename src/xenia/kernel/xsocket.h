@@ -10,6 +10,7 @@
 #ifndef XENIA_KERNEL_XSOCKET_H_
 #define XENIA_KERNEL_XSOCKET_H_
 
+#include <atomic>
 #include <cstring>
 #include <queue>
 
@@ -21,8 +22,12 @@ namespace xe {
 namespace kernel {
 enum class X_WSAError : uint32_t {
   X_WSA_INVALID_PARAMETER = 0x0057,
+  X_WSA_OPERATION_ABORTED = 0x03E3,
+  X_WSA_IO_INCOMPLETE = 0x03E4,
+  X_WSA_IO_PENDING = 0x03E5,
   X_WSAEFAULT = 0x271E,
   X_WSAEINVAL = 0x2726,
+  X_WSAEWOULDBLOCK = 0x2733,
   X_WSAENOTSOCK = 0x2736,
   X_WSAEMSGSIZE = 0x2738,
 };
@@ -103,6 +108,13 @@ class XSocket : public XObject {
 
   uint64_t native_handle() const { return native_handle_; }
   uint16_t bound_port() const { return bound_port_; }
+  Type type() const { return type_; }
+
+  // Throughput, for all the operations on the socket.
+  uint64_t bytes_received() const { return bytes_received_; }
+  uint64_t bytes_sent() const { return bytes_sent_; }
+  uint64_t receive_count() const { return receive_count_; }
+  uint64_t send_count() const { return send_count_; }
 
   X_STATUS Initialize(AddressFamily af, Type type, Protocol proto);
   X_STATUS Close();
@@ -128,7 +140,32 @@ class XSocket : public XObject {
   int SendTo(uint8_t* buf, uint32_t buf_len, uint32_t flags, N_XSOCKADDR_IN* to,
              uint32_t to_len);
 
-  uint32_t GetLastWSAError() const;
+  // Same as RecvFrom and SendTo, but never blocking, for the overlapped
+  // operations. Returns -1 with X_WSAEWOULDBLOCK in error if the operation
+  // can't complete right away.
+  int TryRecvFrom(uint8_t* buf, uint32_t buf_len, uint32_t flags,
+                  N_XSOCKADDR_IN* from, uint32_t* from_len, uint32_t& error);
+  int TrySendTo(uint8_t* buf, uint32_t buf_len, uint32_t flags,
+                N_XSOCKADDR_IN* to, uint32_t to_len, uint32_t& error);
+
+  static uint32_t GetLastWSAError();
+
+  enum PollEvents : uint32_t {
+    kPollRead = 1 << 0,
+    kPollWrite = 1 << 1,
+    kPollExcept = 1 << 2,
+    // Only reported, for errors and hang-ups.
+    kPollError = 1 << 3,
+  };
+  struct PollEntry {
+    uint64_t native_handle;
+    uint32_t events;
+    uint32_t ready_events;
+  };
+  // Waits for any of the native sockets to become ready, like poll, for up to
+  // timeout_ms, or indefinitely if negative. Returns the number of ready
+  // entries, or -1 on failure.
+  static int Poll(PollEntry* entries, uint32_t count, int32_t timeout_ms);
 
   struct packet {
     // These values are in network byte order.
@@ -157,6 +194,11 @@ class XSocket : public XObject {
 
   bool broadcast_socket_ = false;
 
+  std::atomic<uint64_t> bytes_received_ = 0;
+  std::atomic<uint64_t> bytes_sent_ = 0;
+  std::atomic<uint64_t> receive_count_ = 0;
+  std::atomic<uint64_t> send_count_ = 0;
+
   std::unique_ptr<xe::threading::Event> event_;
   std::mutex incoming_packet_mutex_;
   std::queue<uint8_t*> incoming_packets_;
@@ -9,6 +9,7 @@
 
 #include "xenia/kernel/xthread.h"
 
+#include <algorithm>
 #include <cstring>
 
 #include "third_party/fmt/include/fmt/format.h"
@@ -23,6 +24,8 @@
 #include "xenia/cpu/ppc/ppc_decode_data.h"
 #include "xenia/cpu/processor.h"
 #include "xenia/emulator.h"
+#include "xenia/kernel/guest_run_slots.h"
+#include "xenia/kernel/host_core_scheduler.h"
 #include "xenia/kernel/kernel_state.h"
 #include "xenia/kernel/user_module.h"
 #include "xenia/kernel/xboxkrnl/xboxkrnl_threading.h"
@@ -33,6 +36,13 @@ DEFINE_bool(ignore_thread_priorities, true,
 DEFINE_bool(ignore_thread_affinities, true,
             "Ignores game-specified thread affinities.", "Kernel");
 
+DEFINE_bool(log_apc_stats, false,
+            "Logs how many user APCs each thread received, in how many "
+            "batches, and how long they were queued, when the thread exits.",
+            "Kernel");
+
+DECLARE_uint32(timer_slack_us);
+
 #if 0
 DEFINE_int64(stack_size_multiplier_hack, 1,
              "A hack for games with setjmp/longjmp issues.", "Kernel");
@@ -93,6 +103,7 @@ XThread::~XThread() {
   if (thread_state_) {
     delete thread_state_;
   }
+  allocation_cache_.Flush();
   kernel_state()->memory()->SystemHeapFree(tls_static_address_);
   kernel_state()->memory()->SystemHeapFree(pcr_address_);
   FreeStack();
@@ -309,11 +320,10 @@ X_STATUS XThread::Create() {
 
   const uint32_t kDefaultTlsSlotCount = 1024;
   uint32_t tls_slots = kDefaultTlsSlotCount;
-  uint32_t tls_extended_size = 0;
   if (tls_header && tls_header->slot_count) {
     tls_slots = tls_header->slot_count;
-    tls_extended_size = tls_header->data_size;
   }
+  uint32_t tls_extended_size = GetTLSExtendedSize(kernel_state());
 
   // Allocate both the slots and the extended data.
   // Some TLS is compiled with the binary (declspec(thread)) vars. The game
@@ -396,6 +406,8 @@ X_STATUS XThread::Create() {
   thread_ = xe::threading::Thread::Create(params, [this]() {
     // Set thread ID override. This is used by logging.
     xe::threading::set_current_thread_id(handle());
+    xe::threading::set_current_thread_timer_slack(
+        std::chrono::microseconds(cvars::timer_slack_us));
 
     // Set name immediately, if we have one.
     thread_->set_name(thread_name_);
@@ -409,6 +421,7 @@ X_STATUS XThread::Create() {
     cpu::ThreadState::Bind(this->thread_state());
     running_ = true;
     Execute();
+    ReleaseRunSlot();
     running_ = false;
     current_thread_ = nullptr;
     current_xthread_tls_ = nullptr;
@@ -477,12 +490,41 @@ X_STATUS XThread::Exit(int exit_code) {
   xboxkrnl::xeKeKfReleaseSpinLock(cpu_context, &kprocess->thread_list_spinlock,
                                   old_irql);
 
+  if (host_affinity_mask_) {
+    XELOGI(
+        "XThread{:08X} ({:X}) exiting after {} host processor migrations and "
+        "{} HW thread changes",
+        handle(), thread_id_, host_migrations_, hw_thread_moves_);
+  }
+
+  if (run_slot_overcommits_) {
+    XELOGI(
+        "XThread{:08X} ({:X}) exiting after running {} times without a run "
+        "slot",
+        handle(), thread_id_, run_slot_overcommits_);
+  }
+
+  allocation_cache_.Flush();
+
+  if (cvars::log_apc_stats && apc_count_) {
+    double ticks_per_us = double(Clock::QueryHostTickFrequency()) / 1000000.0;
+    XELOGI(
+        "XThread{:08X} ({:X}) delivered {} user APCs in {} batches (at most "
+        "{} at once), queued for {:.1f}us on average and {:.1f}us at most",
+        handle(), thread_id_, apc_count_, apc_batch_count_, apc_batch_max_,
+        apc_timed_count_
+            ? double(apc_latency_sum_) / apc_timed_count_ / ticks_per_us
+            : 0.0,
+        double(apc_latency_max_) / ticks_per_us);
+  }
+
   kernel_state()->OnThreadExit(this);
 
   // Notify processor of our exit.
   emulator()->processor()->OnThreadExit(thread_id_);
 
   // NOTE: unless PlatformExit fails, expect it to never return!
+  ReleaseRunSlot();
   current_xthread_tls_ = nullptr;
   current_thread_ = nullptr;
   xe::Profiler::ThreadExit();
@@ -508,10 +550,16 @@ X_STATUS XThread::Terminate(int exit_code) {
 
   running_ = false;
   if (XThread::IsInThread(this)) {
+    ReleaseRunSlot();
     ReleaseHandle();
     xe::threading::Thread::Exit(exit_code);
   } else {
     thread_->Terminate(exit_code);
+    if (holds_run_slot_) {
+      // Can't release it on the terminated thread anymore.
+      holds_run_slot_ = false;
+      GuestRunSlots::GetShared()->Release();
+    }
     ReleaseHandle();
   }
 
@@ -539,6 +587,8 @@ void XThread::Execute() {
   // have time to initialize shared structures AFTER CreateThread (RR).
   xe::threading::Sleep(std::chrono::milliseconds(10));
 
+  AcquireRunSlot();
+
   // Dispatch any APCs that were queued before the thread was created first.
   DeliverAPCs();
 
@@ -617,6 +667,29 @@ void XThread::EnqueueApc(uint32_t normal_routine, uint32_t normal_context,
   xenia_assert(success == X_STATUS_SUCCESS);
 }
 
+void XThread::WakeForApcs() {
+  if (apc_wake_pending_.exchange(true, std::memory_order_acq_rel)) {
+    return;
+  }
+  // Cleared before the wait returns, so APCs queued later request another
+  // wakeup, while those queued before are delivered after the wait.
+  thread_->QueueUserCallback([this]() {
+    apc_wake_pending_.store(false, std::memory_order_release);
+  });
+}
+
+void XThread::RecordApcBatch(uint32_t apc_count,
+                             uint64_t latency_host_ticks_sum,
+                             uint64_t latency_host_ticks_max,
+                             uint32_t timed_count) {
+  apc_count_ += apc_count;
+  ++apc_batch_count_;
+  apc_batch_max_ = std::max(apc_batch_max_, apc_count);
+  apc_timed_count_ += timed_count;
+  apc_latency_sum_ += latency_host_ticks_sum;
+  apc_latency_max_ = std::max(apc_latency_max_, latency_host_ticks_max);
+}
+
 void XThread::SetCurrentThread() { current_xthread_tls_ = this; }
 
 void XThread::DeliverAPCs() {
@@ -676,7 +749,18 @@ void XThread::SetActiveCpu(uint8_t cpu_index) {
     thread_object.current_cpu = cpu_index;
   }
 
-  if (xe::threading::logical_processor_count() >= 6) {
+  const HostCoreScheduler& scheduler = HostCoreScheduler::Get();
+  if (scheduler.enabled()) {
+    uint64_t mask = is_guest_thread() ? scheduler.hw_thread_mask(cpu_index)
+                                      : scheduler.worker_mask();
+    if (mask && mask != host_affinity_mask_) {
+      if (host_affinity_mask_) {
+        ++hw_thread_moves_;
+      }
+      host_affinity_mask_ = mask;
+      thread_->set_affinity_mask(mask);
+    }
+  } else if (xe::threading::logical_processor_count() >= 6) {
     if (!cvars::ignore_thread_affinities) {
       thread_->set_affinity_mask(uint64_t(1) << cpu_index);
     }
@@ -687,6 +771,57 @@ void XThread::SetActiveCpu(uint8_t cpu_index) {
   }
 }
 
+void XThread::SampleHostProcessor() {
+  XThread* thread = current_xthread_tls_;
+  if (!thread || !thread->host_affinity_mask_) {
+    return;
+  }
+  uint32_t processor = xe::threading::current_logical_processor();
+  if (processor == UINT_MAX || processor == thread->last_host_processor_) {
+    return;
+  }
+  if (thread->last_host_processor_ != UINT_MAX) {
+    ++thread->host_migrations_;
+  }
+  thread->last_host_processor_ = processor;
+}
+
+uint32_t XThread::GetTLSExtendedSize(KernelState* kernel_state) {
+  xex2_opt_tls_info* tls_header = nullptr;
+  auto module = kernel_state->GetExecutableModule();
+  if (module) {
+    module->GetOptHeader(XEX_HEADER_TLS_INFO, &tls_header);
+  }
+  if (!tls_header || !tls_header->slot_count) {
+    return 0;
+  }
+  return tls_header->data_size;
+}
+
+void XThread::ReleaseRunSlot() {
+  XThread* thread = current_xthread_tls_;
+  if (!thread || !thread->holds_run_slot_) {
+    return;
+  }
+  thread->holds_run_slot_ = false;
+  GuestRunSlots::GetShared()->Release();
+}
+
+void XThread::AcquireRunSlot() {
+  XThread* thread = current_xthread_tls_;
+  if (!thread || thread->holds_run_slot_ || !thread->is_guest_thread()) {
+    return;
+  }
+  GuestRunSlots* run_slots = GuestRunSlots::GetShared();
+  if (!run_slots) {
+    return;
+  }
+  if (!run_slots->Acquire()) {
+    ++thread->run_slot_overcommits_;
+  }
+  thread->holds_run_slot_ = true;
+}
+
 bool XThread::GetTLSValue(uint32_t slot, uint32_t* value_out) {
   if (slot * 4 > tls_total_size_) {
     return false;
@@ -765,9 +900,14 @@ X_STATUS XThread::Delay(uint32_t processor_mode, uint32_t alertable,
     timeout_ms = 0;
   }
   timeout_ms = Clock::ScaleGuestDurationMillis(timeout_ms);
+  // Even with a zero interval, yielding lets the threads waiting for a run
+  // slot execute.
+  ReleaseRunSlot();
   if (alertable) {
     auto result =
         xe::threading::AlertableSleep(std::chrono::milliseconds(timeout_ms));
+    AcquireRunSlot();
+    kernel_state()->RefreshKeTimestampBundle();
     switch (result) {
       default:
       case xe::threading::SleepResult::kSuccess:
@@ -777,6 +917,9 @@ X_STATUS XThread::Delay(uint32_t processor_mode, uint32_t alertable,
     }
   } else {
     xe::threading::Sleep(std::chrono::milliseconds(timeout_ms));
+    AcquireRunSlot();
+    SampleHostProcessor();
+    kernel_state()->RefreshKeTimestampBundle();
     return X_STATUS_SUCCESS;
   }
 }
@@ -952,6 +1095,8 @@ object_ref<XThread> XThread::Restore(KernelState* kernel_state,
     thread->thread_ = xe::threading::Thread::Create(params, [thread, state]() {
       // Set thread ID override. This is used by logging.
       xe::threading::set_current_thread_id(thread->handle());
+      xe::threading::set_current_thread_timer_slack(
+          std::chrono::microseconds(cvars::timer_slack_us));
 
       // Set name immediately, if we have one.
       thread->thread_->set_name(thread->name());
@@ -17,6 +17,7 @@
 #include "xenia/base/threading.h"
 #include "xenia/cpu/thread.h"
 #include "xenia/cpu/thread_state.h"
+#include "xenia/kernel/util/allocation_cache.h"
 #include "xenia/kernel/util/native_list.h"
 #include "xenia/kernel/xmutant.h"
 #include "xenia/kernel/xobject.h"
@@ -322,6 +323,13 @@ class XThread : public XObject, public cpu::Thread {
 
   void EnqueueApc(uint32_t normal_routine, uint32_t normal_context,
                   uint32_t arg1, uint32_t arg2);
+  // Interrupts an alertable host wait of the thread so that it delivers its
+  // user APCs. Wakeups requested while one is still pending are merged, as the
+  // thread delivers all queued APCs at once.
+  void WakeForApcs();
+  // Statistics of user APC delivery, for log_apc_stats.
+  void RecordApcBatch(uint32_t apc_count, uint64_t latency_host_ticks_sum,
+                      uint64_t latency_host_ticks_max, uint32_t timed_count);
 
   int32_t priority() const { return priority_; }
   int32_t QueryPriority();
@@ -337,7 +345,22 @@ class XThread : public XObject, public cpu::Thread {
   void SetAffinity(uint32_t affinity);
   uint8_t active_cpu() const;
   void SetActiveCpu(uint8_t cpu_index);
-
+  // With pin_guest_threads, counts the host processor changes of the current
+  // thread, on return from host waits.
+  static void SampleHostProcessor();
+  // With cooperative_guest_scheduling, the current guest thread gives its run
+  // slot to other guest threads while it's blocked in a host wait or a sleep.
+  // Acquiring is a no-op if the slot is already held.
+  static void ReleaseRunSlot();
+  static void AcquireRunSlot();
+
+  // Size of the TLS data of the executable, which comes before the TLS slots
+  // in the TLS block of the threads.
+  static uint32_t GetTLSExtendedSize(KernelState* kernel_state);
+
+  // Recently freed kernel allocations of the thread, only to be used on the
+  // thread itself.
+  util::AllocationCache& allocation_cache() { return allocation_cache_; }
   bool GetTLSValue(uint32_t slot, uint32_t* value_out);
   bool SetTLSValue(uint32_t slot, uint32_t value);
 
@@ -387,6 +410,26 @@ class XThread : public XObject, public cpu::Thread {
   bool running_ = false;
 
   int32_t priority_ = 0;
+
+  // With pin_guest_threads.
+  uint64_t host_affinity_mask_ = 0;
+  uint32_t hw_thread_moves_ = 0;
+  uint32_t last_host_processor_ = UINT_MAX;
+  uint32_t host_migrations_ = 0;
+
+  // With cooperative_guest_scheduling.
+  bool holds_run_slot_ = false;
+  uint32_t run_slot_overcommits_ = 0;
+
+  util::AllocationCache allocation_cache_;
+
+  std::atomic<bool> apc_wake_pending_ = false;
+  uint64_t apc_count_ = 0;
+  uint64_t apc_batch_count_ = 0;
+  uint32_t apc_batch_max_ = 0;
+  uint64_t apc_timed_count_ = 0;
+  uint64_t apc_latency_sum_ = 0;
+  uint64_t apc_latency_max_ = 0;
 };
 
 class XHostThread : public XThread {
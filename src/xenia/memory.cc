@@ -33,6 +33,22 @@ DEFINE_bool(protect_on_release, false,
             "Protect released memory to prevent accesses.", "Memory");
 DEFINE_bool(scribble_heap, false,
             "Scribble 0xCD into all allocated heap memory.", "Memory");
+DEFINE_bool(guest_memory_large_pages, false,
+            "Ask the host to back guest physical memory with large pages to "
+            "reduce TLB misses (transparent huge pages on Linux, when enabled "
+            "as \"madvise\" or \"always\").",
+            "Memory");
+DEFINE_bool(poll_physical_memory_writes, false,
+            "Detect CPU writes to memory cached by the GPU with host write "
+            "tracking, polled before each batch of GPU commands, instead of "
+            "an access violation for every written page. Requires Linux 6.7 "
+            "or newer.",
+            "Memory");
+DEFINE_int32(host_numa_node, -1,
+             "Host NUMA node to allocate guest memory and the JIT code cache "
+             "on, and to keep the guest and emulator threads on with "
+             "pin_guest_threads. -1 to leave the placement to the host.",
+             "Memory");
 
 namespace xe {
 uint32_t get_page_count(uint32_t value, uint32_t page_size) {
@@ -169,6 +185,11 @@ bool Memory::Initialize() {
   virtual_membase_ = mapping_base_;
   physical_membase_ = mapping_base_ + 0x100000000ull;
 
+  // Before any page is accessed.
+  if (cvars::host_numa_node >= 0) {
+    BindViewsToNumaNode(uint32_t(cvars::host_numa_node));
+  }
+
   // Prepare virtual heaps.
   heaps_.v00000000.Initialize(this, virtual_membase_, HeapType::kGuestVirtual,
                               0x00000000, 0x40000000, 4096);
@@ -217,6 +238,20 @@ bool Memory::Initialize() {
                            xe::memory::AllocationType::kCommit,
                            xe::memory::PageAccess::kReadWrite);
   }
+  if (cvars::guest_memory_large_pages) {
+    AdviseLargePages();
+  }
+
+  if (cvars::poll_physical_memory_writes) {
+    write_watch_ = xe::memory::WriteWatch::Create();
+    if (write_watch_) {
+      XELOGI("Using host write tracking for physical memory watches");
+    } else {
+      XELOGW(
+          "Host write tracking is not supported, using protection for "
+          "physical memory watches");
+    }
+  }
 
   // Add handlers for MMIO.
   mmio_handler_ = cpu::MMIOHandler::Install(
@@ -322,6 +357,47 @@ int Memory::MapViews(uint8_t* mapping_base) {
   return 0;
 }
 
+void Memory::AdviseLargePages() {
+  size_t advised_size = 0;
+  for (size_t n = 0; n < xe::countof(map_info); n++) {
+    // Only the views of physical memory.
+    if (map_info[n].target_address < 0x100000000ull) {
+      continue;
+    }
+    size_t length = map_info[n].virtual_address_end -
+                    map_info[n].virtual_address_start + 1;
+    if (xe::memory::AdviseLargePages(views_.all_views[n], length)) {
+      advised_size += length;
+    }
+  }
+  if (advised_size) {
+    XELOGI("Requested large pages for {} MB of guest physical memory views",
+           advised_size >> 20);
+  } else {
+    XELOGW("Large pages for guest memory are not supported on this host");
+  }
+}
+
+void Memory::BindViewsToNumaNode(uint32_t node) {
+  size_t bound_size = 0;
+  for (size_t n = 0; n < xe::countof(map_info); n++) {
+    size_t length = map_info[n].virtual_address_end -
+                    map_info[n].virtual_address_start + 1;
+    if (xe::memory::BindToNumaNode(views_.all_views[n], length, node)) {
+      bound_size += length;
+    }
+  }
+  if (bound_size) {
+    XELOGI("Bound {} MB of guest memory views to host NUMA node {}",
+           bound_size >> 20, node);
+  } else {
+    XELOGW(
+        "Guest memory can't be bound to host NUMA node {}, it will be "
+        "allocated on the node of the thread first accessing it",
+        node);
+  }
+}
+
 void Memory::UnmapViews() {
   for (size_t n = 0; n < xe::countof(views_.all_views); n++) {
     if (views_.all_views[n]) {
@@ -472,18 +548,50 @@ uint32_t Memory::GetPhysicalAddress(uint32_t address) const {
   return static_cast<const PhysicalHeap*>(heap)->GetPhysicalAddress(address);
 }
 
-void Memory::Zero(uint32_t address, uint32_t size) {
-  std::memset(TranslateVirtual(address), 0, size);
+// Host accesses this large to guest memory are mostly initialization of
+// buffers not read again soon, which would only evict the cache.
+constexpr uint32_t kStreamingHostAccessThreshold = 1024 * 1024;
+
+void Memory::TriggerHostAccessCallbacks(uint32_t address, uint32_t size,
+                                        bool is_write) {
+  // Once for the whole range rather than an access violation for every
+  // watched page. Only physical memory is watched, checked before locking.
+  const BaseHeap* heap = LookupHeap(address);
+  if (!heap || heap->heap_type() != HeapType::kGuestPhysical) {
+    return;
+  }
+  TriggerPhysicalMemoryCallbacks(global_critical_region_.Acquire(), address,
+                                 size, is_write, false);
 }
 
+void Memory::Zero(uint32_t address, uint32_t size) { Fill(address, size, 0); }
+
 void Memory::Fill(uint32_t address, uint32_t size, uint8_t value) {
-  std::memset(TranslateVirtual(address), value, size);
+  if (!size) {
+    return;
+  }
+  TriggerHostAccessCallbacks(address, size, true);
+  uint8_t* pdest = TranslateVirtual(address);
+  if (size >= kStreamingHostAccessThreshold) {
+    xe::memory::fill_streaming(pdest, value, size);
+  } else {
+    std::memset(pdest, value, size);
+  }
 }
 
 void Memory::Copy(uint32_t dest, uint32_t src, uint32_t size) {
+  if (!size) {
+    return;
+  }
+  TriggerHostAccessCallbacks(src, size, false);
+  TriggerHostAccessCallbacks(dest, size, true);
   uint8_t* pdest = TranslateVirtual(dest);
   const uint8_t* psrc = TranslateVirtual(src);
-  std::memcpy(pdest, psrc, size);
+  if (size >= kStreamingHostAccessThreshold) {
+    xe::memory::copy_streaming(pdest, psrc, size);
+  } else {
+    std::memcpy(pdest, psrc, size);
+  }
 }
 
 uint32_t Memory::SearchAligned(uint32_t start, uint32_t end,
@@ -543,7 +651,15 @@ bool Memory::AccessViolationCallback(
   uint32_t virtual_address = HostToGuestVirtual(host_address);
   BaseHeap* heap = LookupHeap(virtual_address);
   if (heap->heap_type() != HeapType::kGuestPhysical) {
-    return false;
+    if (!is_write || !heap->UnwatchCodeWrites(virtual_address)) {
+      return false;
+    }
+    if (code_write_callback_) {
+      code_write_callback_(code_write_callback_context_,
+                           virtual_address & ~(system_page_size_ - 1),
+                           system_page_size_);
+    }
+    return true;
   }
 
   // Access violation callbacks from the guest are triggered when the global
@@ -576,10 +692,69 @@ bool Memory::TriggerPhysicalMemoryCallbacks(
   return false;
 }
 
+void Memory::SetCodeWriteCallback(CodeWriteCallback callback,
+                                  void* callback_context) {
+  auto global_lock = global_critical_region_.Acquire();
+  code_write_callback_ = callback;
+  code_write_callback_context_ = callback_context;
+}
+
+void Memory::WatchCodeWrites(uint32_t virtual_address, uint32_t length) {
+  BaseHeap* heap = LookupHeap(virtual_address);
+  if (!heap || heap->heap_type() == HeapType::kGuestPhysical) {
+    return;
+  }
+  heap->WatchCodeWrites(virtual_address, length);
+}
+
+bool Memory::PhysicalMemoryInvalidationCallbackEntry::IsAnyPageWatched(
+    uint32_t physical_address_first, uint32_t physical_address_last) const {
+  uint32_t page_first = physical_address_first >> kPageSizeLog2;
+  uint32_t page_last = physical_address_last >> kPageSizeLog2;
+  uint32_t block_first = page_first >> 6;
+  uint32_t block_last = page_last >> 6;
+  for (uint32_t i = block_first; i <= block_last; ++i) {
+    uint64_t block_mask = UINT64_MAX;
+    if (i == block_first) {
+      block_mask &= ~((uint64_t(1) << (page_first & 63)) - 1);
+    }
+    if (i == block_last && (page_last & 63) != 63) {
+      block_mask &= (uint64_t(1) << ((page_last & 63) + 1)) - 1;
+    }
+    if (watched_pages[i] & block_mask) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void Memory::PhysicalMemoryInvalidationCallbackEntry::SetPagesWatched(
+    uint32_t physical_address_first, uint32_t physical_address_last,
+    bool watched) {
+  uint32_t page_first = physical_address_first >> kPageSizeLog2;
+  uint32_t page_last = physical_address_last >> kPageSizeLog2;
+  uint32_t block_first = page_first >> 6;
+  uint32_t block_last = page_last >> 6;
+  for (uint32_t i = block_first; i <= block_last; ++i) {
+    uint64_t block_mask = UINT64_MAX;
+    if (i == block_first) {
+      block_mask &= ~((uint64_t(1) << (page_first & 63)) - 1);
+    }
+    if (i == block_last && (page_last & 63) != 63) {
+      block_mask &= (uint64_t(1) << ((page_last & 63) + 1)) - 1;
+    }
+    if (watched) {
+      watched_pages[i] |= block_mask;
+    } else {
+      watched_pages[i] &= ~block_mask;
+    }
+  }
+}
+
 void* Memory::RegisterPhysicalMemoryInvalidationCallback(
     PhysicalMemoryInvalidationCallback callback, void* callback_context) {
-  auto entry = new std::pair<PhysicalMemoryInvalidationCallback, void*>(
-      callback, callback_context);
+  auto entry =
+      new PhysicalMemoryInvalidationCallbackEntry(callback, callback_context);
   auto lock = global_critical_region_.Acquire();
   physical_memory_invalidation_callbacks_.push_back(entry);
   return entry;
@@ -588,7 +763,7 @@ void* Memory::RegisterPhysicalMemoryInvalidationCallback(
 void Memory::UnregisterPhysicalMemoryInvalidationCallback(
     void* callback_handle) {
   auto entry =
-      reinterpret_cast<std::pair<PhysicalMemoryInvalidationCallback, void*>*>(
+      reinterpret_cast<PhysicalMemoryInvalidationCallbackEntry*>(
           callback_handle);
   {
     auto lock = global_critical_region_.Acquire();
@@ -602,9 +777,52 @@ void Memory::UnregisterPhysicalMemoryInvalidationCallback(
   delete entry;
 }
 
+void* Memory::RegisterPhysicalMemoryDataProvider(
+    PhysicalMemoryDataProviderCallback callback, void* callback_context) {
+  auto entry = new std::pair<PhysicalMemoryDataProviderCallback, void*>(
+      callback, callback_context);
+  auto lock = global_critical_region_.Acquire();
+  physical_memory_data_providers_.push_back(entry);
+  return entry;
+}
+
+void Memory::UnregisterPhysicalMemoryDataProvider(void* callback_handle) {
+  auto entry =
+      reinterpret_cast<std::pair<PhysicalMemoryDataProviderCallback, void*>*>(
+          callback_handle);
+  {
+    auto lock = global_critical_region_.Acquire();
+    auto it = std::find(physical_memory_data_providers_.begin(),
+                        physical_memory_data_providers_.end(), entry);
+    assert_true(it != physical_memory_data_providers_.end());
+    if (it != physical_memory_data_providers_.end()) {
+      physical_memory_data_providers_.erase(it);
+    }
+  }
+  delete entry;
+}
+
 void Memory::EnablePhysicalMemoryAccessCallbacks(
     uint32_t physical_address, uint32_t length,
-    bool enable_invalidation_notifications, bool enable_data_providers) {
+    bool enable_invalidation_notifications, bool enable_data_providers,
+    void* invalidation_callback_handle) {
+  if (enable_invalidation_notifications && length &&
+      physical_address < 0x20000000) {
+    uint32_t watch_first = physical_address;
+    uint32_t watch_last =
+        watch_first + std::min(length, 0x20000000 - watch_first) - 1;
+    auto global_lock = global_critical_region_.Acquire();
+    if (invalidation_callback_handle) {
+      reinterpret_cast<PhysicalMemoryInvalidationCallbackEntry*>(
+          invalidation_callback_handle)
+          ->SetPagesWatched(watch_first, watch_last, true);
+    } else {
+      for (auto invalidation_callback :
+           physical_memory_invalidation_callbacks_) {
+        invalidation_callback->SetPagesWatched(watch_first, watch_last, true);
+      }
+    }
+  }
   heaps_.vA0000000.EnableAccessCallbacks(physical_address, length,
                                          enable_invalidation_notifications,
                                          enable_data_providers);
@@ -616,6 +834,15 @@ void Memory::EnablePhysicalMemoryAccessCallbacks(
                                          enable_data_providers);
 }
 
+void Memory::PollPhysicalMemoryWrites() {
+  if (!write_watch_) {
+    return;
+  }
+  heaps_.vA0000000.PollWrites();
+  heaps_.vC0000000.PollWrites();
+  heaps_.vE0000000.PollWrites();
+}
+
 uint32_t Memory::SystemHeapAlloc(uint32_t size, uint32_t alignment,
                                  uint32_t system_heap_flags) {
   // TODO(benvanik): lightweight pool.
@@ -670,6 +897,18 @@ void Memory::DumpMap() {
   XELOGE("");
 }
 
+void Memory::QueryHeapStats(std::vector<HeapStats>& stats_out) {
+  BaseHeap* const heaps[] = {
+      &heaps_.v00000000, &heaps_.v40000000, &heaps_.v80000000,
+      &heaps_.v90000000, &heaps_.physical,  &heaps_.vA0000000,
+      &heaps_.vC0000000, &heaps_.vE0000000,
+  };
+  stats_out.resize(xe::countof(heaps));
+  for (size_t i = 0; i < xe::countof(heaps); ++i) {
+    heaps[i]->QueryStats(stats_out[i]);
+  }
+}
+
 bool Memory::Save(ByteStream* stream) {
   XELOGD("Serializing memory...");
   heaps_.v00000000.Save(stream);
@@ -731,7 +970,60 @@ void BaseHeap::Initialize(Memory* memory, uint8_t* membase, HeapType heap_type,
   page_size_shift_ = xe::log2_floor(page_size_);
   host_address_offset_ = host_address_offset;
   page_table_.resize(heap_size / page_size);
+  reserved_pages_.assign(xe::round_up(page_table_.size(), size_t(64)) / 64, 0);
   unreserved_page_count_ = uint32_t(page_table_.size());
+  committed_page_count_ = 0;
+  allocation_rate_sample_time_ = Clock::QueryHostTickCount();
+}
+
+static inline uint64_t GetPageBlockMask(uint32_t block_index,
+                                        uint32_t page_first,
+                                        uint32_t page_last) {
+  uint64_t mask = UINT64_MAX;
+  if (block_index == page_first >> 6) {
+    mask &= UINT64_MAX << (page_first & 63);
+  }
+  if (block_index == page_last >> 6) {
+    mask &= UINT64_MAX >> (63 - (page_last & 63));
+  }
+  return mask;
+}
+
+void BaseHeap::SetPagesReserved(uint32_t page_first, uint32_t page_count,
+                                bool reserved) {
+  uint32_t page_last = page_first + page_count - 1;
+  for (uint32_t i = page_first >> 6; i <= page_last >> 6; ++i) {
+    uint64_t mask = GetPageBlockMask(i, page_first, page_last);
+    if (reserved) {
+      reserved_pages_[i] |= mask;
+    } else {
+      reserved_pages_[i] &= ~mask;
+    }
+  }
+}
+
+uint32_t BaseHeap::FindFirstReservedPage(uint32_t page_first,
+                                         uint32_t page_last) const {
+  for (uint32_t i = page_first >> 6; i <= page_last >> 6; ++i) {
+    uint64_t reserved =
+        reserved_pages_[i] & GetPageBlockMask(i, page_first, page_last);
+    if (reserved) {
+      return (i << 6) + xe::tzcnt(reserved);
+    }
+  }
+  return UINT32_MAX;
+}
+
+uint32_t BaseHeap::FindLastReservedPage(uint32_t page_first,
+                                        uint32_t page_last) const {
+  for (uint32_t i = (page_last >> 6) + 1; i-- > (page_first >> 6);) {
+    uint64_t reserved =
+        reserved_pages_[i] & GetPageBlockMask(i, page_first, page_last);
+    if (reserved) {
+      return (i << 6) + 63 - xe::lzcnt(reserved);
+    }
+  }
+  return UINT32_MAX;
 }
 
 void BaseHeap::Dispose() {
@@ -757,6 +1049,14 @@ void BaseHeap::DumpMap() {
   XELOGE("            Page Size: {0} ({0:08X})", page_size_);
   XELOGE("           Page Count: {}", page_table_.size());
   XELOGE("  Host Address Offset: {0} ({0:08X})", host_address_offset_);
+  HeapStats stats;
+  QueryStats(stats);
+  XELOGE("       Reserved Pages: {}", stats.reserved_page_count);
+  XELOGE("      Committed Pages: {}", stats.committed_page_count);
+  XELOGE("   Largest Free Pages: {} in {} free runs",
+         stats.largest_free_page_run, stats.free_run_count);
+  XELOGE("          Allocations: {} ({} released)", stats.allocation_count,
+         stats.release_count);
   bool is_empty_span = false;
   uint32_t empty_span_start = 0;
   for (uint32_t i = 0; i < uint32_t(page_table_.size()); ++i) {
@@ -798,10 +1098,107 @@ void BaseHeap::DumpMap() {
   }
 }
 
+static bool IsPageZero(const void* page, uint32_t page_size) {
+  const uint64_t* page_qwords = reinterpret_cast<const uint64_t*>(page);
+  for (uint32_t i = 0; i < page_size / sizeof(uint64_t); ++i) {
+    if (page_qwords[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void BaseHeap::QueryStats(HeapStats& stats_out) {
+  auto global_lock = global_critical_region_.Acquire();
+  stats_out.heap_base = heap_base_;
+  stats_out.heap_size = heap_size_;
+  stats_out.page_size = page_size_;
+  stats_out.heap_type = heap_type_;
+  stats_out.total_page_count = total_page_count();
+  stats_out.reserved_page_count = reserved_page_count();
+  stats_out.committed_page_count = committed_page_count_;
+
+  // Skipping 64 pages at a time through the bitmap, alternating between the
+  // first reserved page and the first free page after it.
+  uint32_t page_count = total_page_count();
+  uint32_t largest_free_page_run = 0;
+  uint32_t free_run_count = 0;
+  uint32_t page = 0;
+  while (page < page_count) {
+    uint32_t reserved_page = FindFirstReservedPage(page, page_count - 1);
+    uint32_t free_end = std::min(reserved_page, page_count);
+    if (free_end > page) {
+      largest_free_page_run = std::max(largest_free_page_run, free_end - page);
+      ++free_run_count;
+    }
+    page = free_end;
+    while (page < page_count) {
+      uint64_t free_pages =
+          ~reserved_pages_[page >> 6] & (UINT64_MAX << (page & 63));
+      if (free_pages) {
+        page = (page & ~uint32_t(63)) + xe::tzcnt(free_pages);
+        break;
+      }
+      page = (page & ~uint32_t(63)) + 64;
+    }
+  }
+  stats_out.largest_free_page_run = largest_free_page_run;
+  stats_out.free_run_count = free_run_count;
+
+  uint64_t time = Clock::QueryHostTickCount();
+  uint64_t frequency = Clock::QueryHostTickFrequency();
+  if (time - allocation_rate_sample_time_ >= frequency) {
+    allocations_per_second_ =
+        double(allocation_count_ - allocation_rate_sample_count_) *
+        double(frequency) / double(time - allocation_rate_sample_time_);
+    allocation_rate_sample_count_ = allocation_count_;
+    allocation_rate_sample_time_ = time;
+  }
+  stats_out.allocation_count = allocation_count_;
+  stats_out.release_count = release_count_;
+  stats_out.allocations_per_second = allocations_per_second_;
+  std::memcpy(stats_out.allocation_size_histogram, allocation_size_histogram_,
+              sizeof(allocation_size_histogram_));
+}
+
+void BaseHeap::RecordAllocation(uint32_t page_count) {
+  ++allocation_count_;
+  uint32_t size_log2 =
+      uint32_t(xe::log2_ceil(uint64_t(page_count) << page_size_shift_));
+  uint32_t bucket = size_log2 > 12 ? size_log2 - 12 : 0;
+  ++allocation_size_histogram_[std::min(
+      bucket, HeapStats::kAllocationSizeBucketCount - 1)];
+}
+
 bool BaseHeap::Save(ByteStream* stream) {
   XELOGD("Heap {:08X}-{:08X}", heap_base_, heap_base_ + (heap_size_ - 1));
 
-  for (size_t i = 0; i < page_table_.size(); i++) {
+  // The emulation is paused while saving, so the committed pages are checked
+  // and copied on multiple threads. The layout of the stream depends on which
+  // pages are zero, so that is checked for all pages before writing it.
+  constexpr size_t kPagesPerTask = 1024;
+  size_t page_count = page_table_.size();
+  size_t task_count = (page_count + (kPagesPerTask - 1)) / kPagesPerTask;
+  std::vector<memory::PageAccess> old_accesses(page_count,
+                                               memory::PageAccess::kNoAccess);
+  std::vector<uint8_t> pages_zero(page_count, 0);
+  xe::threading::ParallelFor(task_count, [&](size_t task) {
+    size_t task_page_end = std::min((task + 1) * kPagesPerTask, page_count);
+    for (size_t i = task * kPagesPerTask; i < task_page_end; ++i) {
+      if (!(page_table_[i].state & kMemoryAllocationCommit)) {
+        continue;
+      }
+      void* addr = TranslateRelative(i * page_size_);
+      memory::Protect(addr, page_size_, memory::PageAccess::kReadWrite,
+                      &old_accesses[i]);
+      // Most of the committed memory is usually never written, store only a
+      // flag for zero pages.
+      pages_zero[i] = uint8_t(IsPageZero(addr, page_size_));
+    }
+  });
+
+  std::vector<size_t> page_offsets(page_count, SIZE_MAX);
+  for (size_t i = 0; i < page_count; i++) {
     auto& page = page_table_[i];
     stream->Write(page.qword);
     if (!page.state) {
@@ -809,20 +1206,29 @@ bool BaseHeap::Save(ByteStream* stream) {
       continue;
     }
 
-    // TODO(DrChat): write compressed with snappy.
     if (page.state & kMemoryAllocationCommit) {
-      void* addr = TranslateRelative(i * page_size_);
-
-      memory::PageAccess old_access;
-      memory::Protect(addr, page_size_, memory::PageAccess::kReadWrite,
-                      &old_access);
-
-      stream->Write(addr, page_size_);
-
-      memory::Protect(addr, page_size_, old_access, nullptr);
+      stream->Write(pages_zero[i]);
+      if (!pages_zero[i]) {
+        page_offsets[i] = stream->offset();
+        stream->Advance(page_size_);
+      }
     }
   }
 
+  xe::threading::ParallelFor(task_count, [&](size_t task) {
+    size_t task_page_end = std::min((task + 1) * kPagesPerTask, page_count);
+    for (size_t i = task * kPagesPerTask; i < task_page_end; ++i) {
+      if (!(page_table_[i].state & kMemoryAllocationCommit)) {
+        continue;
+      }
+      void* addr = TranslateRelative(i * page_size_);
+      if (page_offsets[i] != SIZE_MAX) {
+        std::memcpy(stream->data() + page_offsets[i], addr, page_size_);
+      }
+      memory::Protect(addr, page_size_, old_accesses[i], nullptr);
+    }
+  });
+
   return true;
 }
 
@@ -855,24 +1261,41 @@ bool BaseHeap::Restore(ByteStream* stream) {
 
     // Now read into memory. We'll set R/W protection first, then set the
     // protection back to its previous state.
-    // TODO(DrChat): read compressed with snappy.
     if (page.state & kMemoryAllocationCommit) {
       void* addr = TranslateRelative(i * page_size_);
       xe::memory::Protect(addr, page_size_, memory::PageAccess::kReadWrite,
                           nullptr);
 
-      stream->Read(addr, page_size_);
+      if (stream->Read<uint8_t>()) {
+        std::memset(addr, 0, page_size_);
+      } else {
+        stream->Read(addr, page_size_);
+      }
 
       xe::memory::Protect(addr, page_size_, page_access, nullptr);
     }
   }
 
+  std::fill(reserved_pages_.begin(), reserved_pages_.end(), 0);
+  committed_page_count_ = 0;
+  for (uint32_t i = 0; i < uint32_t(page_table_.size()); ++i) {
+    if (page_table_[i].state) {
+      reserved_pages_[i >> 6] |= uint64_t(1) << (i & 63);
+    }
+    if (page_table_[i].state & kMemoryAllocationCommit) {
+      ++committed_page_count_;
+    }
+  }
+
   return true;
 }
 
 void BaseHeap::Reset() {
   // TODO(DrChat): protect pages.
   std::memset(page_table_.data(), 0, sizeof(PageEntry) * page_table_.size());
+  std::fill(reserved_pages_.begin(), reserved_pages_.end(), 0);
+  committed_page_count_ = 0;
+  code_watched_pages_.clear();
   // TODO(Triang3l): Remove access callbacks from pages if this is a physical
   // memory heap.
 }
@@ -959,6 +1382,11 @@ bool BaseHeap::AllocFixed(uint32_t base_address, uint32_t size,
       XELOGE("BaseHeap::AllocFixed failed to alloc range from host");
       return false;
     }
+    if (cvars::guest_memory_large_pages &&
+        heap_type_ == HeapType::kGuestPhysical) {
+      // Committing maps the range again on POSIX, dropping the earlier hint.
+      xe::memory::AdviseLargePages(result, page_count * page_size_);
+    }
 
     if (cvars::scribble_heap && protect & kMemoryProtectWrite) {
       std::memset(result, 0xCD, page_count * page_size_);
@@ -979,8 +1407,16 @@ bool BaseHeap::AllocFixed(uint32_t base_address, uint32_t size,
     if (!(page_entry.state & kMemoryAllocationReserve)) {
       unreserved_page_count_--;
     }
+    if (!(page_entry.state & kMemoryAllocationCommit) &&
+        (allocation_type & kMemoryAllocationCommit)) {
+      committed_page_count_++;
+    }
     page_entry.state = kMemoryAllocationReserve | allocation_type;
   }
+  SetPagesReserved(start_page_number, page_count, true);
+  if (allocation_type & kMemoryAllocationReserve) {
+    RecordAllocation(page_count);
+  }
 
   return true;
 }
@@ -1019,9 +1455,10 @@ bool BaseHeap::AllocRange(uint32_t low_address, uint32_t high_address,
   auto global_lock = global_critical_region_.Acquire();
 
   // Find a free page range.
-  // The base page must match the requested alignment, so we first scan for
-  // a free aligned page and only then check for continuous free pages.
-  // TODO(benvanik): optimized searching (free list buckets, bitmap, etc).
+  // The base page must match the requested alignment. Whenever a candidate
+  // range contains reserved pages, the search can skip past the reserved page
+  // farthest in the direction of the search, found in the bitmap 64 pages at a
+  // time.
   uint32_t start_page_number = UINT_MAX;
   uint32_t end_page_number = UINT_MAX;
   // chrispy:todo, page_scan_stride is probably always a power of two...
@@ -1029,75 +1466,44 @@ bool BaseHeap::AllocRange(uint32_t low_address, uint32_t high_address,
   high_page_number =
       high_page_number - QuickMod(high_page_number, page_scan_stride);
   if (top_down) {
-    for (int64_t base_page_number =
-             high_page_number - xe::round_up(page_count, page_scan_stride);
-         base_page_number >= low_page_number;
-         base_page_number -= page_scan_stride) {
-      if (page_table_[base_page_number].state != 0) {
-        // Base page not free, skip to next usable page.
-        continue;
-      }
-      // Check requested range to ensure free.
-      start_page_number = uint32_t(base_page_number);
-      end_page_number = uint32_t(base_page_number) + page_count - 1;
-      assert_true(end_page_number < page_table_.size());
-      bool any_taken = false;
-      for (uint32_t page_number = uint32_t(base_page_number);
-           !any_taken && page_number <= end_page_number; ++page_number) {
-        bool is_free = page_table_[page_number].state == 0;
-        if (!is_free) {
-          // At least one page in the range is used, skip to next.
-          // We know we'll be starting at least before this page.
-          any_taken = true;
-          if (page_count > page_number) {
-            // Not enough space left to fit entire page range. Breaks outer
-            // loop.
-            base_page_number = -1;
-          } else {
-            base_page_number = page_number - page_count;
-            base_page_number -= QuickMod(base_page_number, page_scan_stride);
-            base_page_number += page_scan_stride;  // cancel out loop logic
-          }
-          break;
-        }
-      }
-      if (!any_taken) {
+    int64_t base_page_number =
+        int64_t(high_page_number) -
+        int64_t(xe::round_up(page_count, page_scan_stride));
+    while (base_page_number >= low_page_number) {
+      uint32_t range_end_page_number =
+          uint32_t(base_page_number) + page_count - 1;
+      assert_true(range_end_page_number < page_table_.size());
+      uint32_t reserved_page_number = FindFirstReservedPage(
+          uint32_t(base_page_number), range_end_page_number);
+      if (reserved_page_number == UINT32_MAX) {
         // Found our place.
+        start_page_number = uint32_t(base_page_number);
+        end_page_number = range_end_page_number;
+        break;
+      }
+      if (page_count > reserved_page_number) {
+        // Not enough space left below the reserved page.
         break;
       }
-      // Retry.
-      start_page_number = end_page_number = UINT_MAX;
+      // We know the range must end before the reserved page.
+      base_page_number = reserved_page_number - page_count;
+      base_page_number -= QuickMod(base_page_number, page_scan_stride);
     }
   } else {
-    for (uint32_t base_page_number = low_page_number;
-         base_page_number <= high_page_number - page_count;
-         base_page_number += page_scan_stride) {
-      if (page_table_[base_page_number].state != 0) {
-        // Base page not free, skip to next usable page.
-        continue;
-      }
-      // Check requested range to ensure free.
-      start_page_number = base_page_number;
-      end_page_number = base_page_number + page_count - 1;
-      bool any_taken = false;
-      for (uint32_t page_number = base_page_number;
-           !any_taken && page_number <= end_page_number; ++page_number) {
-        bool is_free = page_table_[page_number].state == 0;
-        if (!is_free) {
-          // At least one page in the range is used, skip to next.
-          // We know we'll be starting at least after this page.
-          any_taken = true;
-          base_page_number = xe::round_up(page_number + 1, page_scan_stride);
-          base_page_number -= page_scan_stride;  // cancel out loop logic
-          break;
-        }
-      }
-      if (!any_taken) {
+    uint32_t base_page_number = low_page_number;
+    while (base_page_number <= high_page_number - page_count) {
+      uint32_t range_end_page_number = base_page_number + page_count - 1;
+      uint32_t reserved_page_number =
+          FindLastReservedPage(base_page_number, range_end_page_number);
+      if (reserved_page_number == UINT32_MAX) {
         // Found our place.
+        start_page_number = base_page_number;
+        end_page_number = range_end_page_number;
         break;
       }
-      // Retry.
-      start_page_number = end_page_number = UINT_MAX;
+      // We know the range must start after the reserved page.
+      base_page_number =
+          xe::round_up(reserved_page_number + 1, page_scan_stride);
     }
   }
   if (start_page_number == UINT_MAX || end_page_number == UINT_MAX) {
@@ -1121,6 +1527,11 @@ bool BaseHeap::AllocRange(uint32_t low_address, uint32_t high_address,
       XELOGE("BaseHeap::Alloc failed to alloc range from host");
       return false;
     }
+    if (cvars::guest_memory_large_pages &&
+        heap_type_ == HeapType::kGuestPhysical) {
+      // Committing maps the range again on POSIX, dropping the earlier hint.
+      xe::memory::AdviseLargePages(result, page_count << page_size_shift_);
+    }
 
     if (cvars::scribble_heap && (protect & kMemoryProtectWrite)) {
       std::memset(result, 0xCD, page_count << page_size_shift_);
@@ -1138,6 +1549,11 @@ bool BaseHeap::AllocRange(uint32_t low_address, uint32_t high_address,
     page_entry.state = kMemoryAllocationReserve | allocation_type;
     unreserved_page_count_--;
   }
+  SetPagesReserved(start_page_number, page_count, true);
+  if (allocation_type & kMemoryAllocationCommit) {
+    committed_page_count_ += page_count;
+  }
+  RecordAllocation(page_count);
 
   *out_address = heap_base_ + (start_page_number << page_size_shift_);
   return true;
@@ -1186,6 +1602,9 @@ bool BaseHeap::Decommit(uint32_t address, uint32_t size) {
   for (uint32_t page_number = start_page_number; page_number <= end_page_number;
        ++page_number) {
     auto& page_entry = page_table_[page_number];
+    if (page_entry.state & kMemoryAllocationCommit) {
+      committed_page_count_--;
+    }
     page_entry.state &= ~kMemoryAllocationCommit;
   }
 
@@ -1212,6 +1631,10 @@ bool BaseHeap::Release(uint32_t base_address, uint32_t* out_region_size) {
     *out_region_size = (base_page_entry.region_page_count * page_size_);
   }
 
+  UnwatchCodeWritesInPages(
+      base_page_number,
+      base_page_number + base_page_entry.region_page_count - 1);
+
   // Release from host not needed as mapping reserves the range for us.
   // TODO(benvanik): protect with NOACCESS?
   /*BOOL result = VirtualFree(
@@ -1244,9 +1667,14 @@ bool BaseHeap::Release(uint32_t base_address, uint32_t* out_region_size) {
   for (uint32_t page_number = base_page_number; page_number <= end_page_number;
        ++page_number) {
     auto& page_entry = page_table_[page_number];
+    if (page_entry.state & kMemoryAllocationCommit) {
+      committed_page_count_--;
+    }
     page_entry.qword = 0;
     unreserved_page_count_++;
   }
+  SetPagesReserved(base_page_number, base_page_entry.region_page_count, false);
+  ++release_count_;
 
   return true;
 }
@@ -1337,6 +1765,7 @@ bool BaseHeap::Protect(uint32_t address, uint32_t size, uint32_t protect,
     auto& page_entry = page_table_[page_number];
     page_entry.current_protect = protect;
   }
+  ReprotectCodeWatchedPages(start_page_number, end_page_number);
 
   return true;
 }
@@ -1456,6 +1885,103 @@ xe::memory::PageAccess BaseHeap::QueryRangeAccess(uint32_t low_address,
   return ToPageAccess(protect);
 }
 
+void BaseHeap::WatchCodeWrites(uint32_t address, uint32_t length) {
+  if (!length || address < heap_base_ || address - heap_base_ >= heap_size_) {
+    return;
+  }
+  uint32_t system_page_shift = xe::log2_floor(memory_->system_page_size_);
+  uint32_t relative_first = address - heap_base_;
+  auto relative_last = uint32_t(std::min(
+      uint64_t(relative_first) + length - 1, uint64_t(heap_size_ - 1)));
+  auto global_lock = global_critical_region_.Acquire();
+  if (code_watched_pages_.empty()) {
+    code_watched_pages_.resize(
+        (size_t(heap_size_ >> system_page_shift) + 63) / 64);
+  }
+  for (uint32_t host_page = relative_first >> system_page_shift;
+       host_page <= relative_last >> system_page_shift; ++host_page) {
+    uint64_t& watched_block = code_watched_pages_[host_page >> 6];
+    uint64_t watched_bit = uint64_t(1) << (host_page & 63);
+    if ((watched_block & watched_bit) ||
+        !(page_table_[(host_page << system_page_shift) >> page_size_shift_]
+              .state &
+          kMemoryAllocationCommit)) {
+      continue;
+    }
+    watched_block |= watched_bit;
+    ProtectCodeWatchedPage(host_page, true);
+  }
+}
+
+bool BaseHeap::UnwatchCodeWrites(uint32_t address) {
+  if (address < heap_base_ || address - heap_base_ >= heap_size_) {
+    return false;
+  }
+  // Only the host page containing the address, even if the heap page is
+  // larger, as the rest of it may contain more code.
+  uint32_t host_page =
+      (address - heap_base_) >> xe::log2_floor(memory_->system_page_size_);
+  auto global_lock = global_critical_region_.Acquire();
+  return UnwatchCodeWritesInHostPages(host_page, host_page);
+}
+
+void BaseHeap::ReprotectCodeWatchedPages(uint32_t page_first,
+                                         uint32_t page_last) {
+  if (code_watched_pages_.empty()) {
+    return;
+  }
+  uint32_t system_page_shift = xe::log2_floor(memory_->system_page_size_);
+  uint32_t host_page_last =
+      (((page_last + 1) << page_size_shift_) - 1) >> system_page_shift;
+  for (uint32_t host_page = (page_first << page_size_shift_) >>
+                            system_page_shift;
+       host_page <= host_page_last; ++host_page) {
+    if (code_watched_pages_[host_page >> 6] &
+        (uint64_t(1) << (host_page & 63))) {
+      ProtectCodeWatchedPage(host_page, true);
+    }
+  }
+}
+
+bool BaseHeap::UnwatchCodeWritesInPages(uint32_t page_first,
+                                        uint32_t page_last) {
+  uint32_t system_page_shift = xe::log2_floor(memory_->system_page_size_);
+  return UnwatchCodeWritesInHostPages(
+      (page_first << page_size_shift_) >> system_page_shift,
+      (((page_last + 1) << page_size_shift_) - 1) >> system_page_shift);
+}
+
+bool BaseHeap::UnwatchCodeWritesInHostPages(uint32_t host_page_first,
+                                            uint32_t host_page_last) {
+  if (code_watched_pages_.empty()) {
+    return false;
+  }
+  bool any_watched = false;
+  for (uint32_t host_page = host_page_first; host_page <= host_page_last;
+       ++host_page) {
+    uint64_t& watched_block = code_watched_pages_[host_page >> 6];
+    uint64_t watched_bit = uint64_t(1) << (host_page & 63);
+    if (watched_block & watched_bit) {
+      watched_block &= ~watched_bit;
+      ProtectCodeWatchedPage(host_page, false);
+      any_watched = true;
+    }
+  }
+  return any_watched;
+}
+
+void BaseHeap::ProtectCodeWatchedPage(uint32_t host_page, bool watched) {
+  uint32_t system_page_size = memory_->system_page_size_;
+  uint32_t relative_address = host_page * system_page_size;
+  uint32_t protect =
+      page_table_[relative_address >> page_size_shift_].current_protect;
+  if (watched) {
+    protect &= ~kMemoryProtectWrite;
+  }
+  xe::memory::Protect(TranslateRelative(relative_address), system_page_size,
+                      ToPageAccess(protect), nullptr);
+}
+
 VirtualHeap::VirtualHeap() = default;
 
 VirtualHeap::~VirtualHeap() = default;
@@ -1667,10 +2193,10 @@ bool PhysicalHeap::Protect(uint32_t address, uint32_t size, uint32_t protect,
   auto global_lock = global_critical_region_.Acquire();
 
   // Only invalidate if making writable again, for simplicity - not when simply
-  // marking some range as immutable, for instance.
-  if (protect & kMemoryProtectWrite) {
-    TriggerCallbacks(std::move(global_lock), address, size, true, true, false);
-  }
+  // marking some range as immutable, for instance. But data must be provided
+  // in any case as the new protection will make the pages accessible.
+  TriggerCallbacks(std::move(global_lock), address, size,
+                   (protect & kMemoryProtectWrite) != 0, true, false);
 
   if (!parent_heap_->Protect(GetPhysicalAddress(address), size, protect,
                              old_protect)) {
@@ -1685,8 +2211,6 @@ void PhysicalHeap::EnableAccessCallbacks(uint32_t physical_address,
                                          uint32_t length,
                                          bool enable_invalidation_notifications,
                                          bool enable_data_providers) {
-  // TODO(Triang3l): Implement data providers.
-  assert_false(enable_data_providers);
   if (!enable_invalidation_notifications && !enable_data_providers) {
     return;
   }
@@ -1736,9 +2260,12 @@ template <bool enable_invalidation_notifications>
 XE_NOINLINE void PhysicalHeap::EnableAccessCallbacksInner(
     const uint32_t system_page_first, const uint32_t system_page_last,
     xe::memory::PageAccess protect_access) XE_RESTRICT {
-  uint8_t* protect_base = membase_ + heap_base_;
   uint32_t protect_system_page_first = UINT32_MAX;
 
+  // Only data providers need the pages to be fully inaccessible.
+  const bool enable_data_providers =
+      protect_access == xe::memory::PageAccess::kNoAccess;
+
   SystemPageFlagsBlock* XE_RESTRICT sys_page_flags = system_page_flags_.data();
   PageEntry* XE_RESTRICT page_table_ptr = page_table_.data();
 
@@ -1793,17 +2320,22 @@ XE_NOINLINE void PhysicalHeap::EnableAccessCallbacksInner(
     // enable invalidation notifications for read-only pages for the same
     // reason.
     if (current_page_access != xe::memory::PageAccess::kNoAccess) {
-      // TODO(Triang3l): Enable data providers.
       if constexpr (enable_invalidation_notifications) {
         if (current_page_access != xe::memory::PageAccess::kReadOnly &&
             (page_flags_block.notify_on_invalidation & page_flags_bit) == 0) {
-          // TODO(Triang3l): Check if data providers are already enabled.
           // If data providers are already enabled for the page, it has even
           // stricter protection.
-          protect_system_page = true;
+          if ((page_flags_block.provide_data & page_flags_bit) == 0) {
+            protect_system_page = true;
+          }
           page_flags_block.notify_on_invalidation |= page_flags_bit;
         }
       }
+      if (enable_data_providers &&
+          (page_flags_block.provide_data & page_flags_bit) == 0) {
+        protect_system_page = true;
+        page_flags_block.provide_data |= page_flags_bit;
+      }
     }
     if (protect_system_page) {
       if (protect_system_page_first == UINT32_MAX) {
@@ -1811,32 +2343,38 @@ XE_NOINLINE void PhysicalHeap::EnableAccessCallbacksInner(
       }
     } else {
       if (protect_system_page_first != UINT32_MAX) {
-        xe::memory::Protect(
-            protect_base + (protect_system_page_first << system_page_shift_),
-            (i - protect_system_page_first) << system_page_shift_,
-            protect_access);
+        WatchSystemPages(protect_system_page_first,
+                         i - protect_system_page_first, protect_access);
         protect_system_page_first = UINT32_MAX;
       }
     }
   }
 
   if (protect_system_page_first != UINT32_MAX) {
-    xe::memory::Protect(
-        protect_base + (protect_system_page_first << system_page_shift_),
-        (system_page_last + 1 - protect_system_page_first)
-            << system_page_shift_,
-        protect_access);
+    WatchSystemPages(protect_system_page_first,
+                     system_page_last + 1 - protect_system_page_first,
+                     protect_access);
+  }
+}
+
+void PhysicalHeap::WatchSystemPages(uint32_t system_page_first,
+                                    uint32_t system_page_count,
+                                    xe::memory::PageAccess protect_access) {
+  uint8_t* address =
+      membase_ + heap_base_ + (size_t(system_page_first) << system_page_shift_);
+  size_t length = size_t(system_page_count) << system_page_shift_;
+  // Data providers will need actual protection.
+  if (memory_->write_watch_ &&
+      protect_access == xe::memory::PageAccess::kReadOnly) {
+    // If this fails, the pages are reported as written when polled.
+    memory_->write_watch_->Reset(address, length);
+    return;
   }
+  xe::memory::Protect(address, length, protect_access);
 }
 bool PhysicalHeap::TriggerCallbacks(
     global_unique_lock_type global_lock_locked_once, uint32_t virtual_address,
     uint32_t length, bool is_write, bool unwatch_exact_range, bool unprotect) {
-  // TODO(Triang3l): Support read watches.
-  assert_true(is_write);
-  if (!is_write) {
-    return false;
-  }
-
   if (virtual_address < heap_base_) {
     if (heap_base_ - virtual_address >= length) {
       return false;
@@ -1863,26 +2401,41 @@ bool PhysicalHeap::TriggerCallbacks(
   uint32_t block_index_first = system_page_first >> 6;
   uint32_t block_index_last = system_page_last >> 6;
 
-  // Check if watching any page, whether need to call the callback at all.
+  // Check if watching any page, whether need to call the callbacks at all.
   bool any_watched = false;
+  bool any_data_provided = false;
   for (uint32_t i = block_index_first; i <= block_index_last; ++i) {
-    uint64_t block = system_page_flags_[i].notify_on_invalidation;
+    uint64_t block_mask = UINT64_MAX;
     if (i == block_index_first) {
-      block &= ~((uint64_t(1) << (system_page_first & 63)) - 1);
+      block_mask &= ~((uint64_t(1) << (system_page_first & 63)) - 1);
     }
     if (i == block_index_last && (system_page_last & 63) != 63) {
-      block &= (uint64_t(1) << ((system_page_last & 63) + 1)) - 1;
+      block_mask &= (uint64_t(1) << ((system_page_last & 63) + 1)) - 1;
     }
-    if (block) {
+    const SystemPageFlagsBlock& page_flags_block = system_page_flags_[i];
+    if (is_write && (page_flags_block.notify_on_invalidation & block_mask)) {
       any_watched = true;
-      break;
+    }
+    if (page_flags_block.provide_data & block_mask) {
+      any_data_provided = true;
     }
   }
+
+  // Provide the data before the invalidation notifications, so they (and the
+  // access itself) see the up-to-date data.
+  if (any_data_provided) {
+    ProvideData(system_page_first, system_page_last, is_write);
+  }
+
   if (!any_watched) {
-    return false;
+    return any_data_provided;
   }
 
   // Trigger callbacks.
+  if (memory_->write_watch_) {
+    // Not protected for watching in the first place.
+    unprotect = false;
+  }
   if (!unprotect) {
     // If not doing anything with protection, no point in unwatching excess
     // pages.
@@ -1898,14 +2451,49 @@ bool PhysicalHeap::TriggerCallbacks(
                   host_address_offset()) +
           physical_address_offset - physical_address_start,
       heap_size_ - (physical_address_start - physical_address_offset));
+  uint32_t physical_address_last = physical_address_start + physical_length - 1;
+  // Don't unprotect too much if not caring much about the region (limit to
+  // 4 MB - somewhat random, but max 1024 iterations of the page loop).
+  const uint32_t kMaxUnwatchExcess = 4 * 1024 * 1024;
   uint32_t unwatch_first = 0;
   uint32_t unwatch_last = UINT32_MAX;
   for (auto invalidation_callback :
        memory_->physical_memory_invalidation_callbacks_) {
+    if (!invalidation_callback->IsAnyPageWatched(physical_address_start,
+                                                 physical_address_last)) {
+      // Not notified, but its pages around the range must stay watched.
+      if (!unwatch_exact_range) {
+        using Entry = Memory::PhysicalMemoryInvalidationCallbackEntry;
+        uint32_t page_first = physical_address_start >> Entry::kPageSizeLog2;
+        uint32_t page_last = physical_address_last >> Entry::kPageSizeLog2;
+        uint32_t window_page_first =
+            (physical_address_start & ~(kMaxUnwatchExcess - 1)) >>
+            Entry::kPageSizeLog2;
+        uint32_t window_page_last = std::min(
+            (physical_address_last | (kMaxUnwatchExcess - 1)) >>
+                Entry::kPageSizeLog2,
+            Entry::kPageCount - 1);
+        for (uint32_t page = page_first; page > window_page_first; --page) {
+          if (invalidation_callback->IsPageWatched(page - 1)) {
+            unwatch_first =
+                std::max(unwatch_first, page << Entry::kPageSizeLog2);
+            break;
+          }
+        }
+        for (uint32_t page = page_last; page < window_page_last; ++page) {
+          if (invalidation_callback->IsPageWatched(page + 1)) {
+            unwatch_last = std::min(
+                unwatch_last, ((page + 1) << Entry::kPageSizeLog2) - 1);
+            break;
+          }
+        }
+      }
+      continue;
+    }
     std::pair<uint32_t, uint32_t> callback_unwatch_range =
-        invalidation_callback->first(invalidation_callback->second,
-                                     physical_address_start, physical_length,
-                                     unwatch_exact_range);
+        invalidation_callback->callback(
+            invalidation_callback->callback_context, physical_address_start,
+            physical_length, unwatch_exact_range);
     if (!unwatch_exact_range) {
       unwatch_first = std::max(unwatch_first, callback_unwatch_range.first);
       unwatch_last = std::min(
@@ -1918,16 +2506,11 @@ bool PhysicalHeap::TriggerCallbacks(
   if (!unwatch_exact_range) {
     // Always unwatch at least the requested pages.
     unwatch_first = std::min(unwatch_first, physical_address_start);
-    unwatch_last =
-        std::max(unwatch_last, physical_address_start + physical_length - 1);
-    // Don't unprotect too much if not caring much about the region (limit to
-    // 4 MB - somewhat random, but max 1024 iterations of the page loop).
-    const uint32_t kMaxUnwatchExcess = 4 * 1024 * 1024;
+    unwatch_last = std::max(unwatch_last, physical_address_last);
     unwatch_first = std::max(unwatch_first,
                              physical_address_start & ~(kMaxUnwatchExcess - 1));
     unwatch_last =
-        std::min(unwatch_last, (physical_address_start + physical_length - 1) |
-                                   (kMaxUnwatchExcess - 1));
+        std::min(unwatch_last, physical_address_last | (kMaxUnwatchExcess - 1));
     // Convert to heap-relative addresses.
     unwatch_first = xe::sat_sub(unwatch_first, physical_address_offset);
     unwatch_last = xe::sat_sub(unwatch_last, physical_address_offset);
@@ -1949,9 +2532,13 @@ bool PhysicalHeap::TriggerCallbacks(
     uint8_t* protect_base = membase_ + heap_base_;
     uint32_t unprotect_system_page_first = UINT32_MAX;
     for (uint32_t i = system_page_first; i <= system_page_last; ++i) {
-      // Check if need to allow writing to this page.
-      bool unprotect_page = (system_page_flags_[i >> 6].notify_on_invalidation &
-                             (uint64_t(1) << (i & 63))) != 0;
+      // Check if need to allow writing to this page. Pages still waiting for
+      // data from providers (outside the accessed range) must stay protected.
+      const SystemPageFlagsBlock& page_flags_block = system_page_flags_[i >> 6];
+      uint64_t page_flags_bit = uint64_t(1) << (i & 63);
+      bool unprotect_page =
+          (page_flags_block.notify_on_invalidation & page_flags_bit) != 0 &&
+          (page_flags_block.provide_data & page_flags_bit) == 0;
       if (unprotect_page) {
         uint32_t guest_page_number =
             xe::sat_sub(i << system_page_shift_, host_address_offset()) >>
@@ -1996,10 +2583,134 @@ bool PhysicalHeap::TriggerCallbacks(
     }
     system_page_flags_[i].notify_on_invalidation &= mask;
   }
+  uint32_t unwatched_physical_first =
+      xe::sat_sub(system_page_first << system_page_shift_,
+                  host_address_offset()) +
+      physical_address_offset;
+  uint32_t unwatched_physical_last =
+      std::min(xe::sat_sub((system_page_last + 1) << system_page_shift_,
+                           host_address_offset()) +
+                   physical_address_offset,
+               physical_address_offset + heap_size_) -
+      1;
+  for (auto invalidation_callback :
+       memory_->physical_memory_invalidation_callbacks_) {
+    invalidation_callback->SetPagesWatched(unwatched_physical_first,
+                                           unwatched_physical_last, false);
+  }
 
   return true;
 }
 
+void PhysicalHeap::ProvideData(uint32_t system_page_first,
+                               uint32_t system_page_last, bool is_write) {
+  uint32_t physical_address_offset = GetPhysicalAddress(heap_base_);
+  uint8_t* protect_base = membase_ + heap_base_;
+  uint32_t i = system_page_first;
+  while (i <= system_page_last) {
+    if (!(system_page_flags_[i >> 6].provide_data &
+          (uint64_t(1) << (i & 63)))) {
+      ++i;
+      continue;
+    }
+    uint32_t run_first = i;
+    while (i <= system_page_last && (system_page_flags_[i >> 6].provide_data &
+                                     (uint64_t(1) << (i & 63)))) {
+      ++i;
+    }
+
+    uint32_t run_physical_start =
+        xe::sat_sub(run_first << system_page_shift_, host_address_offset()) +
+        physical_address_offset;
+    uint32_t run_physical_length = std::min(
+        xe::sat_sub(i << system_page_shift_, host_address_offset()) +
+            physical_address_offset - run_physical_start,
+        heap_size_ - (run_physical_start - physical_address_offset));
+    for (auto data_provider : memory_->physical_memory_data_providers_) {
+      data_provider->first(data_provider->second, run_physical_start,
+                           run_physical_length);
+    }
+
+    // Restore the protection, which may be different for different pages in
+    // the run, keeping the pages that are not being written watched for
+    // invalidation.
+    uint32_t protect_run_first = run_first;
+    xe::memory::PageAccess protect_run_access =
+        xe::memory::PageAccess::kNoAccess;
+    for (uint32_t j = run_first; j <= i; ++j) {
+      xe::memory::PageAccess page_access = xe::memory::PageAccess::kNoAccess;
+      if (j < i) {
+        SystemPageFlagsBlock& page_flags_block = system_page_flags_[j >> 6];
+        uint64_t page_flags_bit = uint64_t(1) << (j & 63);
+        page_flags_block.provide_data &= ~page_flags_bit;
+        uint32_t guest_page_number =
+            xe::sat_sub(j << system_page_shift_, host_address_offset()) >>
+            page_size_shift_;
+        page_access =
+            ToPageAccess(page_table_[guest_page_number].current_protect);
+        if (!is_write && !memory_->write_watch_ &&
+            page_access == xe::memory::PageAccess::kReadWrite &&
+            (page_flags_block.notify_on_invalidation & page_flags_bit)) {
+          page_access = xe::memory::PageAccess::kReadOnly;
+        }
+      }
+      if (j != run_first && (j == i || page_access != protect_run_access)) {
+        xe::memory::Protect(
+            protect_base + (size_t(protect_run_first) << system_page_shift_),
+            size_t(j - protect_run_first) << system_page_shift_,
+            protect_run_access);
+        protect_run_first = j;
+      }
+      protect_run_access = page_access;
+    }
+  }
+}
+
+void PhysicalHeap::PollWrites() {
+  xe::memory::WriteWatch* write_watch = memory_->write_watch_.get();
+  if (!write_watch) {
+    return;
+  }
+  uint8_t* watch_base = membase_ + heap_base_;
+  auto trigger_callbacks = [this, watch_base](void* address, size_t length) {
+    uint32_t heap_relative_address = xe::sat_sub(
+        uint32_t(static_cast<uint8_t*>(address) - watch_base),
+        host_address_offset());
+    TriggerCallbacks(global_critical_region_.Acquire(),
+                     heap_base_ + heap_relative_address, uint32_t(length),
+                     true, true);
+  };
+  // Scanning only the runs of watched pages, as only they are tracked.
+  uint32_t i = 0;
+  while (true) {
+    uint32_t run_first;
+    {
+      auto global_lock = global_critical_region_.Acquire();
+      while (i < system_page_count_) {
+        uint64_t block =
+            system_page_flags_[i >> 6].notify_on_invalidation >> (i & 63);
+        if (block) {
+          i += xe::tzcnt(block);
+          break;
+        }
+        i = (i | 63) + 1;
+      }
+      if (i >= system_page_count_) {
+        break;
+      }
+      run_first = i;
+      while (i < system_page_count_ &&
+             (system_page_flags_[i >> 6].notify_on_invalidation &
+              (uint64_t(1) << (i & 63)))) {
+        ++i;
+      }
+    }
+    write_watch->GetWritten(
+        watch_base + (size_t(run_first) << system_page_shift_),
+        size_t(i - run_first) << system_page_shift_, trigger_callbacks);
+  }
+}
+
 uint32_t PhysicalHeap::GetPhysicalAddress(uint32_t address) const {
   assert_true(address >= heap_base_);
   address -= heap_base_;
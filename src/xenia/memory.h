@@ -98,6 +98,31 @@ union PageEntry {
   };
 };
 
+// Usage and fragmentation statistics of a heap, for live analysis of titles
+// running out of guest memory.
+struct HeapStats {
+  // Bucket i counts the allocations of up to 4 KB << i, the last bucket also
+  // counts all larger ones.
+  static constexpr uint32_t kAllocationSizeBucketCount = 20;
+
+  uint32_t heap_base;
+  uint32_t heap_size;
+  uint32_t page_size;
+  HeapType heap_type;
+  uint32_t total_page_count;
+  uint32_t reserved_page_count;
+  uint32_t committed_page_count;
+  // Longest and total number of runs of contiguous free pages.
+  uint32_t largest_free_page_run;
+  uint32_t free_run_count;
+  // Since the heap was initialized.
+  uint64_t allocation_count;
+  uint64_t release_count;
+  // Averaged over at least a second, updated when the stats are queried.
+  double allocations_per_second;
+  uint64_t allocation_size_histogram[kAllocationSizeBucketCount];
+};
+
 // Heap abstraction for page-based allocation.
 class BaseHeap {
  public:
@@ -124,6 +149,9 @@ class BaseHeap {
     return total_page_count() - unreserved_page_count();
   }
 
+  // Sum of committed pages in heap
+  uint32_t committed_page_count() const { return committed_page_count_; }
+
   // Type of specified heap
   HeapType heap_type() const { return heap_type_; }
 
@@ -143,6 +171,10 @@ class BaseHeap {
   // Dumps information about all allocations within the heap to the log.
   void DumpMap();
 
+  // Gathers the usage statistics, with the free runs found from the reserved
+  // page bitmap, and the counters maintained by the allocation functions.
+  void QueryStats(HeapStats& stats_out);
+
   // Allocates pages with the given properties and allocation strategy.
   // This can reserve and commit the pages as well as set protection modes.
   // This will fail if not enough contiguous pages can be found.
@@ -198,6 +230,16 @@ class BaseHeap {
   xe::memory::PageAccess QueryRangeAccess(uint32_t low_address,
                                           uint32_t high_address);
 
+  // Write-protects the committed host pages containing the range without
+  // changing their guest protection, so guest writes to them trigger the code
+  // write callback of the memory. Pages stay watched until written, or until
+  // their region is released. Not for physical memory heaps, which have their
+  // own access callbacks.
+  void WatchCodeWrites(uint32_t address, uint32_t length);
+  // Restores the guest protection of the host page containing the address if
+  // it's watched, returns whether it was.
+  bool UnwatchCodeWrites(uint32_t address);
+
   bool Save(ByteStream* stream);
   bool Restore(ByteStream* stream);
 
@@ -210,6 +252,28 @@ class BaseHeap {
                   uint32_t heap_base, uint32_t heap_size, uint32_t page_size,
                   uint32_t host_address_offset = 0);
 
+  // Updates reserved_pages_, must be done along with changing the page table
+  // state between free and reserved.
+  void SetPagesReserved(uint32_t page_first, uint32_t page_count,
+                        bool reserved);
+  // Return UINT32_MAX if all pages in the inclusive range are free.
+  uint32_t FindFirstReservedPage(uint32_t page_first,
+                                 uint32_t page_last) const;
+  uint32_t FindLastReservedPage(uint32_t page_first, uint32_t page_last) const;
+  // Reapplies the write protection to the watched host pages in the inclusive
+  // range of heap pages after their guest protection has been changed.
+  void ReprotectCodeWatchedPages(uint32_t page_first, uint32_t page_last);
+  // Unwatches the watched host pages in the inclusive range of heap pages,
+  // returns whether any was watched.
+  bool UnwatchCodeWritesInPages(uint32_t page_first, uint32_t page_last);
+  bool UnwatchCodeWritesInHostPages(uint32_t host_page_first,
+                                    uint32_t host_page_last);
+  // Sets the host protection of a host page from the guest protection, without
+  // write access if watched.
+  void ProtectCodeWatchedPage(uint32_t host_page, bool watched);
+  // Counts a new region of pages in the statistics.
+  void RecordAllocation(uint32_t page_count);
+
   Memory* memory_;
   uint8_t* membase_;
   HeapType heap_type_;
@@ -219,8 +283,24 @@ class BaseHeap {
   uint32_t page_size_shift_;
   uint32_t host_address_offset_;
   uint32_t unreserved_page_count_;
+  uint32_t committed_page_count_ = 0;
+  uint64_t allocation_count_ = 0;
+  uint64_t release_count_ = 0;
+  uint64_t allocation_size_histogram_[HeapStats::kAllocationSizeBucketCount] =
+      {};
+  // The allocation count and the host tick count when the allocation rate was
+  // last updated.
+  uint64_t allocation_rate_sample_count_ = 0;
+  uint64_t allocation_rate_sample_time_ = 0;
+  double allocations_per_second_ = 0.0;
   xe::global_critical_region global_critical_region_;
   std::vector<PageEntry> page_table_;
+  // One bit per page, set if the page is not free (its state is not 0), to
+  // find free ranges without walking the page table entry by entry.
+  std::vector<uint64_t> reserved_pages_;
+  // One bit per host page, set if writes to it are watched with
+  // WatchCodeWrites. Allocated when the first page is watched.
+  std::vector<uint64_t> code_watched_pages_;
 };
 
 // Normal heap allowing allocations from guest virtual address ranges.
@@ -282,6 +362,10 @@ class PhysicalHeap : public BaseHeap {
                         bool is_write, bool unwatch_exact_range,
                         bool unprotect = true);
 
+  // With host write tracking, triggers callbacks for the watched pages written
+  // since they were watched.
+  void PollWrites();
+
   uint32_t GetPhysicalAddress(uint32_t address) const;
 
   uint32_t SystemPagenumToGuestPagenum(uint32_t num) const {
@@ -297,6 +381,16 @@ class PhysicalHeap : public BaseHeap {
   }
 
  protected:
+  // Raises the protection of system pages to watch them, or, with host write
+  // tracking, starts tracking writes to them instead.
+  void WatchSystemPages(uint32_t system_page_first, uint32_t system_page_count,
+                        xe::memory::PageAccess protect_access);
+  // Triggers the data providers for the runs of pages that need data within
+  // the range, and restores the protection of those pages. Must be called in
+  // the global critical region.
+  void ProvideData(uint32_t system_page_first, uint32_t system_page_last,
+                   bool is_write);
+
   VirtualHeap* parent_heap_;
 
   uint32_t system_page_size_;
@@ -308,6 +402,9 @@ class PhysicalHeap : public BaseHeap {
     // Whether writing to each page should result trigger invalidation
     // callbacks.
     uint64_t notify_on_invalidation;
+    // Whether accessing each page should trigger data providers. Such pages
+    // are fully inaccessible on the host.
+    uint64_t provide_data;
   };
   // Protected by global_critical_region. Flags for each 64 system pages,
   // interleaved as blocks, so bit scan can be used to quickly extract ranges.
@@ -403,6 +500,8 @@ class Memory {
   uint32_t GetPhysicalAddress(uint32_t address) const;
 
   // Zeros out a range of memory at the given guest address.
+  // Zero, Fill and Copy trigger the physical memory callbacks once for each
+  // accessed range, and bypass the cache for large ranges.
   void Zero(uint32_t address, uint32_t size);
 
   // Fills a range of guest memory with the given byte value.
@@ -462,16 +561,39 @@ class Memory {
   // notification handler must invalidate the all the data stored in the touched
   // pages.
   //
+  // Each callback also tracks which physical pages it has enabled the
+  // notifications for itself, and is invoked only for the writes to those
+  // pages, so a handler isn't called for memory only watched by the others.
+  // The pages are unwatched for the callback once it has been invoked for them.
+  //
   // Because large ranges (like whole framebuffers) may be written to and
   // exceptions are expensive, it's better to unprotect multiple pages as a
   // result of a write access violation, so the shortest common range returned
   // by all the invalidation callbacks (clamped to a sane range and also not to
   // touch pages with provider callbacks) is unprotected.
   //
+  // With host write tracking (poll_physical_memory_writes), watched pages are
+  // not protected, so writes to them don't cause access violations. Instead,
+  // PollPhysicalMemoryWrites triggers the callbacks for all watched pages
+  // written since they were watched, and must be called before using anything
+  // cached from guest memory that the CPU may have written - the GPU command
+  // processor does this before executing each batch of commands.
+  //
   // - Data providers:
   //
-  // TODO(Triang3l): Implement data providers - more complicated because they
-  // will need to be able to release the global lock.
+  // Protecting from any access. One-shot callbacks for filling the guest memory
+  // with data that is currently located elsewhere (such as data written by the
+  // GPU that has not been read back to the guest memory yet) before the guest
+  // accesses it.
+  //
+  // Triggered for the pages being accessed (in case of a read or a write
+  // access violation, with the provider called before the invalidation
+  // notifications so the guest write is done on top of the provided data), or
+  // explicitly for a range, such as before changing the protection of pages.
+  //
+  // Data providers are called in the global critical region with the lock held
+  // rather than released, so they must not await anything that may need the
+  // global critical region to make progress.
 
   // Returns start and length of the smallest physical memory region surrounding
   // the watched region that can be safely unwatched, if it doesn't matter,
@@ -487,22 +609,57 @@ class Memory {
   // RegisterPhysicalMemoryInvalidationCallback.
   void UnregisterPhysicalMemoryInvalidationCallback(void* callback_handle);
 
+  // Writes the up-to-date data for the physical memory region to the host
+  // physical memory view (TranslatePhysical, not the guest virtual views, which
+  // are protected). May be called for regions that the provider has no data
+  // for anymore, or has never provided data for - such calls must be ignored.
+  typedef void (*PhysicalMemoryDataProviderCallback)(
+      void* context_ptr, uint32_t physical_address_start, uint32_t length);
+  // Returns a handle for unregistering.
+  void* RegisterPhysicalMemoryDataProvider(
+      PhysicalMemoryDataProviderCallback callback, void* callback_context);
+  // Unregisters a physical memory data provider previously added with
+  // RegisterPhysicalMemoryDataProvider.
+  void UnregisterPhysicalMemoryDataProvider(void* callback_handle);
+
   // Enables physical memory access callbacks for the specified memory range,
-  // snapped to system page boundaries.
+  // snapped to system page boundaries. Invalidation notifications are sent
+  // only to the callback with the specified handle for the range, or to all
+  // the callbacks if it's null.
   void EnablePhysicalMemoryAccessCallbacks(
       uint32_t physical_address, uint32_t length,
-      bool enable_invalidation_notifications, bool enable_data_providers);
+      bool enable_invalidation_notifications, bool enable_data_providers,
+      void* invalidation_callback_handle = nullptr);
 
   // Forces triggering of watch callbacks for a virtual address range if pages
   // are watched there and unwatching them. Returns whether any page was
-  // watched. Must be called with global critical region locking depth of 1.
-  // TODO(Triang3l): Implement data providers - this is why locking depth of 1
-  // will be required in the future.
+  // watched. Data providers are triggered for both reads and writes, while
+  // invalidation notifications only for writes. Must be called with global
+  // critical region locking depth of 1.
   bool TriggerPhysicalMemoryCallbacks(
       global_unique_lock_type global_lock_locked_once, uint32_t virtual_address,
       uint32_t length, bool is_write, bool unwatch_exact_range,
       bool unprotect = true);
 
+  // Triggers invalidation callbacks for the watched pages written since they
+  // were watched, if host write tracking is used, otherwise does nothing. Must
+  // not be called with the global critical region locked.
+  void PollPhysicalMemoryWrites();
+
+  // Code write watches, for invalidating the code translated from the guest
+  // virtual memory outside the physical memory heaps when it's modified, such
+  // as by titles patching their own code or loading overlays into writable
+  // memory.
+  //
+  // The callback is invoked with the global critical region locked for the
+  // host page written by the guest, which is not watched anymore, and the
+  // write is performed after it returns. Watching the range again is up to the
+  // callback's owner, such as once the code in it has been translated again.
+  typedef void (*CodeWriteCallback)(void* context_ptr, uint32_t virtual_address,
+                                    uint32_t length);
+  void SetCodeWriteCallback(CodeWriteCallback callback, void* callback_context);
+  void WatchCodeWrites(uint32_t virtual_address, uint32_t length);
+
   // Allocates virtual memory from the 'system' heap.
   // System memory is kept separate from game memory but is still accessible
   // using normal guest virtual addresses. Kernel structures and other internal
@@ -536,6 +693,9 @@ class Memory {
   // Dumps a map of all allocated memory to the log.
   void DumpMap();
 
+  // Gathers the statistics of all heaps, in the order of DumpMap.
+  void QueryHeapStats(std::vector<HeapStats>& stats_out);
+
   bool Save(ByteStream* stream);
   bool Restore(ByteStream* stream);
 
@@ -545,6 +705,10 @@ class Memory {
  private:
   int MapViews(uint8_t* mapping_base);
   void UnmapViews();
+  // Hints the host to back the physical memory views with large pages.
+  void AdviseLargePages();
+  // Asks the host to allocate the memory of the views on the NUMA node.
+  void BindViewsToNumaNode(uint32_t node);
 
   static uint32_t HostToGuestVirtualThunk(const void* context,
                                           const void* host_address);
@@ -554,6 +718,10 @@ class Memory {
   static bool AccessViolationCallbackThunk(
       global_unique_lock_type global_lock_locked_once, void* context,
       void* host_address, bool is_write);
+  // Triggers the physical memory callbacks for a range accessed by the host
+  // in Zero, Fill or Copy.
+  void TriggerHostAccessCallbacks(uint32_t address, uint32_t size,
+                                  bool is_write);
 
   std::filesystem::path file_name_;
   uint32_t system_page_size_ = 0;
@@ -580,6 +748,9 @@ class Memory {
   } views_ = {{0}};
 
   std::unique_ptr<cpu::MMIOHandler> mmio_handler_;
+  // Used instead of protection to watch physical memory if available and
+  // enabled.
+  std::unique_ptr<xe::memory::WriteWatch> write_watch_;
 
   struct {
     VirtualHeap v00000000;
@@ -596,9 +767,41 @@ class Memory {
   friend class BaseHeap;
 
   friend class PhysicalHeap;
+
+  struct PhysicalMemoryInvalidationCallbackEntry {
+    // Granularity of watching of the physical memory by individual callbacks.
+    static constexpr uint32_t kPageSizeLog2 = 12;
+    static constexpr uint32_t kPageCount = 0x20000000 >> kPageSizeLog2;
+
+    PhysicalMemoryInvalidationCallbackEntry(
+        PhysicalMemoryInvalidationCallback callback, void* callback_context)
+        : callback(callback),
+          callback_context(callback_context),
+          watched_pages(new uint64_t[kPageCount >> 6]()) {}
+
+    bool IsPageWatched(uint32_t page) const {
+      return (watched_pages[page >> 6] & (uint64_t(1) << (page & 63))) != 0;
+    }
+    // The range must be non-empty.
+    bool IsAnyPageWatched(uint32_t physical_address_first,
+                          uint32_t physical_address_last) const;
+    void SetPagesWatched(uint32_t physical_address_first,
+                         uint32_t physical_address_last, bool watched);
+
+    PhysicalMemoryInvalidationCallback callback;
+    void* callback_context;
+    // Bit per page, set if notifications for it have been enabled for this
+    // callback, within the global critical region.
+    std::unique_ptr<uint64_t[]> watched_pages;
+  };
+
   xe::global_critical_region global_critical_region_;
-  std::vector<std::pair<PhysicalMemoryInvalidationCallback, void*>*>
+  std::vector<PhysicalMemoryInvalidationCallbackEntry*>
       physical_memory_invalidation_callbacks_;
+  std::vector<std::pair<PhysicalMemoryDataProviderCallback, void*>*>
+      physical_memory_data_providers_;
+  CodeWriteCallback code_write_callback_ = nullptr;
+  void* code_write_callback_context_ = nullptr;
 };
 
 }  // namespace xe
@@ -6,7 +6,11 @@
  * Released under the BSD license - see LICENSE in the root for more details. *
  ******************************************************************************
  */
+#include <cstdint>
+#include <cstdio>
 #include <regex>
+#include <system_error>
+#include <unordered_map>
 
 #include "xenia/base/cvar.h"
 #include "xenia/base/filesystem.h"
@@ -22,8 +26,10 @@ DEFINE_bool(apply_patches, true, "Enables custom patching functionality",
 namespace xe {
 namespace patcher {
 
-PatchDB::PatchDB(const std::filesystem::path patches_root) {
+PatchDB::PatchDB(const std::filesystem::path patches_root,
+                 const std::filesystem::path index_root) {
   patches_root_ = patches_root;
+  index_root_ = index_root;
   LoadPatches();
 }
 
@@ -38,23 +44,196 @@ void PatchDB::LoadPatches() {
   const std::vector<xe::filesystem::FileInfo> patch_files =
       filesystem::ListFiles(patches_directory);
 
+  std::unordered_map<std::string, IndexedFile> stored_files;
+  {
+    std::vector<IndexedFile> stored_file_list;
+    if (ReadIndex(stored_file_list)) {
+      for (IndexedFile& stored_file : stored_file_list) {
+        std::string name = stored_file.name;
+        stored_files.emplace(std::move(name), std::move(stored_file));
+      }
+    }
+  }
+
+  indexed_files_.clear();
+  loaded_patches_.clear();
+  size_t read_file_count = 0;
   for (const xe::filesystem::FileInfo& patch_file : patch_files) {
+    std::string file_name = path_to_utf8(patch_file.name);
     // Skip files that doesn't have only title_id as name and .patch as
     // extension
-    if (!std::regex_match(path_to_utf8(patch_file.name),
-                          patch_filename_regex_)) {
+    if (!std::regex_match(file_name, patch_filename_regex_)) {
       XELOGE("PatchDB: Skipped loading file {} due to incorrect filename",
-             path_to_utf8(patch_file.name));
+             file_name);
       continue;
     }
 
-    const PatchFileEntry loaded_title_patches =
+    auto stored_it = stored_files.find(file_name);
+    if (stored_it != stored_files.end() &&
+        stored_it->second.size == patch_file.total_size &&
+        stored_it->second.write_timestamp == patch_file.write_timestamp) {
+      indexed_files_.push_back(std::move(stored_it->second));
+      continue;
+    }
+
+    // New or modified file. The parsed patches are kept, as the title they're
+    // for may be the one that will be launched.
+    PatchFileEntry loaded_title_patches =
         ReadPatchFile(patch_file.path / patch_file.name);
+    ++read_file_count;
+    IndexedFile& indexed_file = indexed_files_.emplace_back();
+    indexed_file.name = std::move(file_name);
+    indexed_file.size = patch_file.total_size;
+    indexed_file.write_timestamp = patch_file.write_timestamp;
+    indexed_file.title_id = loaded_title_patches.title_id;
+    indexed_file.hashes = loaded_title_patches.hashes;
+    indexed_file.loaded_index = SIZE_MAX;
     if (loaded_title_patches.title_id != -1) {
-      loaded_patches_.push_back(loaded_title_patches);
+      indexed_file.loaded_index = loaded_patches_.size();
+      loaded_patches_.push_back(std::move(loaded_title_patches));
+    }
+  }
+  // Also rewritten if files have been removed.
+  if (read_file_count || stored_files.size() != indexed_files_.size()) {
+    WriteIndex();
+  }
+  XELOGI("PatchDB: Indexed {} patch files, {} of them read",
+         indexed_files_.size(), read_file_count);
+}
+
+std::filesystem::path PatchDB::GetIndexPath() const {
+  if (index_root_.empty()) {
+    return std::filesystem::path();
+  }
+  return index_root_ / "patch_index.bin";
+}
+
+bool PatchDB::ReadIndex(std::vector<IndexedFile>& files_out) const {
+  files_out.clear();
+  std::filesystem::path index_path = GetIndexPath();
+  if (index_path.empty()) {
+    return false;
+  }
+  FILE* file = xe::filesystem::OpenFile(index_path, "rb");
+  if (!file) {
+    return false;
+  }
+  IndexFileHeader header;
+  bool read = fread(&header, sizeof(header), 1, file) == 1 &&
+              header.magic == IndexFileHeader::kMagic &&
+              header.version == IndexFileHeader::kVersion;
+  if (read) {
+    files_out.reserve(header.file_count);
+    for (uint32_t i = 0; read && i < header.file_count; ++i) {
+      IndexedFile& indexed_file = files_out.emplace_back();
+      uint32_t name_length, hash_count;
+      read = fread(&name_length, sizeof(name_length), 1, file) == 1;
+      if (read) {
+        indexed_file.name.resize(name_length);
+        read = !name_length ||
+               fread(indexed_file.name.data(), name_length, 1, file) == 1;
+      }
+      read = read &&
+             fread(&indexed_file.size, sizeof(indexed_file.size), 1, file) ==
+                 1 &&
+             fread(&indexed_file.write_timestamp,
+                   sizeof(indexed_file.write_timestamp), 1, file) == 1 &&
+             fread(&indexed_file.title_id, sizeof(indexed_file.title_id), 1,
+                   file) == 1 &&
+             fread(&hash_count, sizeof(hash_count), 1, file) == 1;
+      if (read) {
+        indexed_file.hashes.resize(hash_count);
+        read = !hash_count || fread(indexed_file.hashes.data(),
+                                    sizeof(uint64_t) * hash_count, 1,
+                                    file) == 1;
+      }
+      indexed_file.loaded_index = SIZE_MAX;
+    }
+  }
+  fclose(file);
+  if (!read) {
+    XELOGW("PatchDB: Ignoring the invalid patch index {}",
+           xe::path_to_utf8(index_path));
+    files_out.clear();
+  }
+  return read;
+}
+
+void PatchDB::WriteIndex() const {
+  std::filesystem::path index_path = GetIndexPath();
+  if (index_path.empty()) {
+    return;
+  }
+  std::error_code error_code;
+  std::filesystem::create_directories(index_path.parent_path(), error_code);
+  // Replacing the previous index only when fully written.
+  std::filesystem::path temp_path = index_path;
+  temp_path += ".tmp";
+  FILE* file = xe::filesystem::OpenFile(temp_path, "wb");
+  if (!file) {
+    XELOGW("PatchDB: Failed to create the patch index {}",
+           xe::path_to_utf8(temp_path));
+    return;
+  }
+  IndexFileHeader header;
+  header.magic = IndexFileHeader::kMagic;
+  header.version = IndexFileHeader::kVersion;
+  header.file_count = uint32_t(indexed_files_.size());
+  bool written = fwrite(&header, sizeof(header), 1, file) == 1;
+  for (const IndexedFile& indexed_file : indexed_files_) {
+    if (!written) {
+      break;
+    }
+    uint32_t name_length = uint32_t(indexed_file.name.size());
+    uint32_t hash_count = uint32_t(indexed_file.hashes.size());
+    written =
+        fwrite(&name_length, sizeof(name_length), 1, file) == 1 &&
+        (!name_length ||
+         fwrite(indexed_file.name.data(), name_length, 1, file) == 1) &&
+        fwrite(&indexed_file.size, sizeof(indexed_file.size), 1, file) == 1 &&
+        fwrite(&indexed_file.write_timestamp,
+               sizeof(indexed_file.write_timestamp), 1, file) == 1 &&
+        fwrite(&indexed_file.title_id, sizeof(indexed_file.title_id), 1,
+               file) == 1 &&
+        fwrite(&hash_count, sizeof(hash_count), 1, file) == 1 &&
+        (!hash_count || fwrite(indexed_file.hashes.data(),
+                               sizeof(uint64_t) * hash_count, 1, file) == 1);
+  }
+  written = fclose(file) == 0 && written;
+  if (written) {
+    std::filesystem::rename(temp_path, index_path, error_code);
+    written = !error_code;
+  }
+  if (!written) {
+    XELOGW("PatchDB: Failed to write the patch index {}",
+           xe::path_to_utf8(index_path));
+    std::filesystem::remove(temp_path, error_code);
+  }
+}
+
+const PatchFileEntry* PatchDB::LoadIndexedFile(IndexedFile& indexed_file) {
+  if (indexed_file.title_id == -1) {
+    return nullptr;
+  }
+  if (indexed_file.loaded_index == SIZE_MAX) {
+    PatchFileEntry loaded_title_patches = ReadPatchFile(
+        patches_root_ / "patches" / xe::to_path(indexed_file.name));
+    if (loaded_title_patches.title_id == -1) {
+      // Modified since the index was built and now broken.
+      indexed_file.title_id = loaded_title_patches.title_id;
+      return nullptr;
     }
+    indexed_file.loaded_index = loaded_patches_.size();
+    loaded_patches_.push_back(std::move(loaded_title_patches));
+  }
+  return &loaded_patches_[indexed_file.loaded_index];
+}
+
+std::vector<PatchFileEntry>& PatchDB::GetAllPatches() {
+  for (IndexedFile& indexed_file : indexed_files_) {
+    LoadIndexedFile(indexed_file);
   }
-  XELOGI("PatchDB: Loaded patches for {} titles", loaded_patches_.size());
+  return loaded_patches_;
 }
 
 PatchFileEntry PatchDB::ReadPatchFile(
@@ -214,14 +393,18 @@ std::vector<PatchFileEntry> PatchDB::GetTitlePatches(
     const uint32_t title_id, const std::optional<uint64_t> hash) {
   std::vector<PatchFileEntry> title_patches;
 
-  std::copy_if(
-      loaded_patches_.cbegin(), loaded_patches_.cend(),
-      std::back_inserter(title_patches), [=](const PatchFileEntry entry) {
-        bool hash_exist = std::find(entry.hashes.cbegin(), entry.hashes.cend(),
-                                    hash) != entry.hashes.cend();
-
-        return entry.title_id == title_id && hash_exist;
-      });
+  // Only reading the files indexed for the title and the hash.
+  for (IndexedFile& indexed_file : indexed_files_) {
+    if (indexed_file.title_id != title_id ||
+        std::find(indexed_file.hashes.cbegin(), indexed_file.hashes.cend(),
+                  hash) == indexed_file.hashes.cend()) {
+      continue;
+    }
+    const PatchFileEntry* entry = LoadIndexedFile(indexed_file);
+    if (entry) {
+      title_patches.push_back(*entry);
+    }
+  }
 
   return title_patches;
 }
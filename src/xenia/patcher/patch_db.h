@@ -11,9 +11,12 @@
 #define XENIA_PATCH_DB_H_
 
 #include <cstring>
+#include <filesystem>
 #include <map>
 #include <optional>
 #include <regex>
+#include <string>
+#include <vector>
 
 #include "third_party/tomlplusplus/toml.hpp"
 
@@ -91,18 +94,52 @@ struct PatchData {
 
 class PatchDB {
  public:
-  PatchDB(const std::filesystem::path patches_root);
+  // The index of the title IDs and the hashes of the patch files is stored in
+  // index_root if it's not empty, so the files can be parsed only when a title
+  // they're for is launched.
+  PatchDB(const std::filesystem::path patches_root,
+          const std::filesystem::path index_root = {});
   ~PatchDB();
 
+  // Builds the index of the patch files, reading only the files that have
+  // been added or modified since the stored index was written.
   void LoadPatches();
 
   PatchFileEntry ReadPatchFile(const std::filesystem::path& file_path) const;
 
   std::vector<PatchFileEntry> GetTitlePatches(
       const uint32_t title_id, const std::optional<uint64_t> hash);
-  std::vector<PatchFileEntry>& GetAllPatches() { return loaded_patches_; }
+  // Reads all the patch files not read yet.
+  std::vector<PatchFileEntry>& GetAllPatches();
 
  private:
+  struct IndexFileHeader {
+    static constexpr uint32_t kMagic = 0x58445058;  // 'XPDX'
+    static constexpr uint32_t kVersion = 1;
+
+    uint32_t magic;
+    uint32_t version;
+    uint32_t file_count;
+  };
+
+  struct IndexedFile {
+    // UTF-8 file name in the patches directory.
+    std::string name;
+    uint64_t size;
+    uint64_t write_timestamp;
+    // -1 if the file can't be loaded.
+    uint32_t title_id;
+    std::vector<uint64_t> hashes;
+    // Not stored, index in loaded_patches_ once read, or SIZE_MAX.
+    size_t loaded_index;
+  };
+
+  std::filesystem::path GetIndexPath() const;
+  bool ReadIndex(std::vector<IndexedFile>& files_out) const;
+  void WriteIndex() const;
+  // Reads the file if needed, returns nullptr if it can't be loaded.
+  const PatchFileEntry* LoadIndexedFile(IndexedFile& file);
+
   void ReadHashes(PatchFileEntry& patch_entry,
                   const toml::node* patch_toml_fields) const;
   void ReadPatchHeader(PatchInfoEntry& patch_info,
@@ -125,8 +162,10 @@ class PatchDB {
       {"be16", PatchData(sizeof(uint16_t), PatchDataType::kBE16)},
       {"be8", PatchData(sizeof(uint8_t), PatchDataType::kBE8)}};
 
+  std::vector<IndexedFile> indexed_files_;
   std::vector<PatchFileEntry> loaded_patches_;
   std::filesystem::path patches_root_;
+  std::filesystem::path index_root_;
 };
 }  // namespace patcher
 }  // namespace xe
@@ -0,0 +1,162 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2026 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/ui/d3d12/d3d12_placed_resource_pool.h"
+
+#include <algorithm>
+
+#include "xenia/base/assert.h"
+#include "xenia/base/logging.h"
+#include "xenia/base/math.h"
+#include "xenia/ui/d3d12/d3d12_util.h"
+
+namespace xe {
+namespace ui {
+namespace d3d12 {
+
+D3D12PlacedResourcePool::~D3D12PlacedResourcePool() {
+  assert_zero(statistics_.resource_count);
+}
+
+uint64_t D3D12PlacedResourcePool::GetSizeClassUnits(uint64_t units) {
+  if (units <= 4) {
+    return units;
+  }
+  // 4 size classes between each power of two.
+  uint64_t step = uint64_t(1) << (61 - xe::lzcnt(units));
+  return xe::round_up(units, step);
+}
+
+bool D3D12PlacedResourcePool::CreateResource(
+    const D3D12_RESOURCE_DESC& desc, D3D12_RESOURCE_STATES initial_state,
+    const D3D12_CLEAR_VALUE* optimized_clear_value,
+    Microsoft::WRL::ComPtr<ID3D12Resource>& resource_out,
+    Allocation& allocation_out, uint64_t* slot_size_out) {
+  ID3D12Device* device = provider_.GetDevice();
+
+  // Small textures can be placed with 4 KB rather than 64 KB alignment - if
+  // that's not possible for the resource, the returned alignment is different.
+  D3D12_RESOURCE_DESC placed_desc = desc;
+  placed_desc.Alignment = D3D12_SMALL_RESOURCE_PLACEMENT_ALIGNMENT;
+  D3D12_RESOURCE_ALLOCATION_INFO allocation_info =
+      device->GetResourceAllocationInfo(0, 1, &placed_desc);
+  if (allocation_info.Alignment != D3D12_SMALL_RESOURCE_PLACEMENT_ALIGNMENT) {
+    placed_desc.Alignment = 0;
+    allocation_info = device->GetResourceAllocationInfo(0, 1, &placed_desc);
+  }
+  if (allocation_info.SizeInBytes == UINT64_MAX ||
+      !allocation_info.Alignment) {
+    return false;
+  }
+  uint64_t slot_size =
+      GetSizeClassUnits((allocation_info.SizeInBytes +
+                         (allocation_info.Alignment - 1)) /
+                        allocation_info.Alignment) *
+      allocation_info.Alignment;
+  if (slot_size > heap_size_ / 4) {
+    return false;
+  }
+
+  std::vector<std::unique_ptr<Heap>>& heaps = size_classes_[slot_size];
+  auto heap_it =
+      std::find_if(heaps.begin(), heaps.end(),
+                   [](const std::unique_ptr<Heap>& heap) {
+                     return !heap->free_slots.empty();
+                   });
+  Heap* heap;
+  if (heap_it != heaps.end()) {
+    heap = heap_it->get();
+  } else {
+    uint32_t slot_count = uint32_t(heap_size_ / slot_size);
+    D3D12_HEAP_DESC heap_desc = {};
+    heap_desc.SizeInBytes = slot_size * slot_count;
+    heap_desc.Properties = util::kHeapPropertiesDefault;
+    heap_desc.Flags = heap_flags_ | provider_.GetHeapFlagCreateNotZeroed();
+    Microsoft::WRL::ComPtr<ID3D12Heap> new_heap;
+    if (FAILED(device->CreateHeap(&heap_desc, IID_PPV_ARGS(&new_heap)))) {
+      XELOGE(
+          "D3D12PlacedResourcePool: Failed to create a {} MB heap for {} KB "
+          "slots",
+          heap_desc.SizeInBytes >> 20, slot_size >> 10);
+      return false;
+    }
+    auto new_heap_slots = std::make_unique<Heap>();
+    new_heap_slots->heap = std::move(new_heap);
+    new_heap_slots->slot_size = slot_size;
+    new_heap_slots->slot_count = slot_count;
+    // Taking from the back, so the beginning of the heap is used first.
+    new_heap_slots->free_slots.reserve(slot_count);
+    for (uint32_t i = slot_count; i; --i) {
+      new_heap_slots->free_slots.push_back(i - 1);
+    }
+    heap = new_heap_slots.get();
+    heaps.push_back(std::move(new_heap_slots));
+    ++statistics_.heap_count;
+    statistics_.heap_bytes += heap_desc.SizeInBytes;
+  }
+
+  uint32_t slot = heap->free_slots.back();
+  Microsoft::WRL::ComPtr<ID3D12Resource> resource;
+  if (FAILED(device->CreatePlacedResource(
+          heap->heap.Get(), slot_size * slot, &placed_desc, initial_state,
+          optimized_clear_value, IID_PPV_ARGS(&resource)))) {
+    return false;
+  }
+  heap->free_slots.pop_back();
+  ++statistics_.resource_count;
+  statistics_.resource_bytes += slot_size;
+
+  resource_out = std::move(resource);
+  allocation_out.heap = heap;
+  allocation_out.slot = slot;
+  if (slot_size_out) {
+    *slot_size_out = slot_size;
+  }
+  return true;
+}
+
+void D3D12PlacedResourcePool::Free(const Allocation& allocation) {
+  if (!allocation.IsValid()) {
+    return;
+  }
+  Heap* heap = allocation.heap;
+  assert_true(heap->free_slots.size() < heap->slot_count);
+  heap->free_slots.push_back(allocation.slot);
+  assert_not_zero(statistics_.resource_count);
+  --statistics_.resource_count;
+  statistics_.resource_bytes -= heap->slot_size;
+  if (heap->free_slots.size() < heap->slot_count) {
+    return;
+  }
+  // Keep one heap with free slots in each size class to avoid recreating heaps
+  // when resources are frequently created and released, but release the other
+  // empty heaps.
+  auto size_class_it = size_classes_.find(heap->slot_size);
+  assert_true(size_class_it != size_classes_.end());
+  std::vector<std::unique_ptr<Heap>>& heaps = size_class_it->second;
+  bool other_heap_has_free_slots =
+      std::any_of(heaps.cbegin(), heaps.cend(),
+                  [heap](const std::unique_ptr<Heap>& other_heap) {
+                    return other_heap.get() != heap &&
+                           !other_heap->free_slots.empty();
+                  });
+  if (!other_heap_has_free_slots) {
+    return;
+  }
+  --statistics_.heap_count;
+  statistics_.heap_bytes -= heap->slot_size * heap->slot_count;
+  heaps.erase(std::find_if(heaps.begin(), heaps.end(),
+                           [heap](const std::unique_ptr<Heap>& other_heap) {
+                             return other_heap.get() == heap;
+                           }));
+}
+
+}  // namespace d3d12
+}  // namespace ui
+}  // namespace xe
@@ -0,0 +1,100 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2026 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#ifndef XENIA_UI_D3D12_D3D12_PLACED_RESOURCE_POOL_H_
+#define XENIA_UI_D3D12_D3D12_PLACED_RESOURCE_POOL_H_
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include "xenia/ui/d3d12/d3d12_provider.h"
+
+namespace xe {
+namespace ui {
+namespace d3d12 {
+
+// Places resources of one heap category (specified by the heap flags, such as
+// D3D12_HEAP_FLAG_ALLOW_ONLY_NON_RT_DS_TEXTURES) in large default heaps instead
+// of creating a committed resource, with at least 64 KB of memory, for each of
+// them. Every heap is split into equal slots of one size class, with four size
+// classes per power of two, so at most a quarter of a slot is wasted. Resources
+// larger than a quarter of a heap are not placed, and should be created as
+// committed resources by the caller.
+//
+// The memory of a slot may be reused as soon as it's freed, so the resource
+// must not be used by the GPU anymore when it's released and the allocation is
+// freed. Contents of newly placed resources are undefined. Not thread-safe.
+class D3D12PlacedResourcePool {
+ private:
+  struct Heap;
+
+ public:
+  struct Allocation {
+    Heap* heap = nullptr;
+    uint32_t slot = 0;
+    bool IsValid() const { return heap != nullptr; }
+  };
+
+  struct Statistics {
+    uint32_t heap_count = 0;
+    uint64_t heap_bytes = 0;
+    uint32_t resource_count = 0;
+    // Including the slot space not used by the resources.
+    uint64_t resource_bytes = 0;
+  };
+
+  D3D12PlacedResourcePool(const D3D12Provider& provider,
+                          D3D12_HEAP_FLAGS heap_flags, uint64_t heap_size)
+      : provider_(provider), heap_flags_(heap_flags), heap_size_(heap_size) {}
+  D3D12PlacedResourcePool(const D3D12PlacedResourcePool&) = delete;
+  D3D12PlacedResourcePool& operator=(const D3D12PlacedResourcePool&) = delete;
+  // All the resources must be released before the pool is destroyed.
+  ~D3D12PlacedResourcePool();
+
+  // Returns false if the resource is too large to be placed, or if creation
+  // has failed. The alignment of the resource description is overridden. The
+  // size of the slot is written to slot_size_out if not null.
+  bool CreateResource(const D3D12_RESOURCE_DESC& desc,
+                      D3D12_RESOURCE_STATES initial_state,
+                      const D3D12_CLEAR_VALUE* optimized_clear_value,
+                      Microsoft::WRL::ComPtr<ID3D12Resource>& resource_out,
+                      Allocation& allocation_out,
+                      uint64_t* slot_size_out = nullptr);
+  void Free(const Allocation& allocation);
+
+  const Statistics& statistics() const { return statistics_; }
+
+ private:
+  struct Heap {
+    Microsoft::WRL::ComPtr<ID3D12Heap> heap;
+    uint64_t slot_size;
+    uint32_t slot_count;
+    std::vector<uint32_t> free_slots;
+  };
+
+  // Rounds the size up to the size class, both in units of the alignment.
+  static uint64_t GetSizeClassUnits(uint64_t units);
+
+  const D3D12Provider& provider_;
+  D3D12_HEAP_FLAGS heap_flags_;
+  uint64_t heap_size_;
+
+  // Slot size -> heaps with slots of that size.
+  std::map<uint64_t, std::vector<std::unique_ptr<Heap>>> size_classes_;
+
+  Statistics statistics_;
+};
+
+}  // namespace d3d12
+}  // namespace ui
+}  // namespace xe
+
+#endif  // XENIA_UI_D3D12_D3D12_PLACED_RESOURCE_POOL_H_
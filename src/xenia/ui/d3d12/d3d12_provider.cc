@@ -77,6 +77,9 @@ D3D12Provider::~D3D12Provider() {
   if (device_ != nullptr) {
     device_->Release();
   }
+  if (adapter3_ != nullptr) {
+    adapter3_->Release();
+  }
   if (dxgi_factory_ != nullptr) {
     dxgi_factory_->Release();
   }
@@ -106,6 +109,21 @@ D3D12Provider::~D3D12Provider() {
   }
 }
 
+bool D3D12Provider::QueryLocalVideoMemoryInfo(uint64_t& budget_out,
+                                              uint64_t& usage_out) const {
+  if (!adapter3_) {
+    return false;
+  }
+  DXGI_QUERY_VIDEO_MEMORY_INFO video_memory_info;
+  if (FAILED(adapter3_->QueryVideoMemoryInfo(
+          0, DXGI_MEMORY_SEGMENT_GROUP_LOCAL, &video_memory_info))) {
+    return false;
+  }
+  budget_out = video_memory_info.Budget;
+  usage_out = video_memory_info.CurrentUsage;
+  return true;
+}
+
 bool D3D12Provider::EnableIncreaseBasePriorityPrivilege() {
   TOKEN_PRIVILEGES privileges;
   privileges.PrivilegeCount = 1;
@@ -315,6 +333,9 @@ bool D3D12Provider::Initialize() {
     dxgi_factory->Release();
     return false;
   }
+  if (FAILED(adapter->QueryInterface(IID_PPV_ARGS(&adapter3_)))) {
+    adapter3_ = nullptr;
+  }
   adapter->Release();
 
   // Configure the Direct3D 12 debug info queue.
@@ -457,8 +478,16 @@ bool D3D12Provider::Initialize() {
     virtual_address_bits_per_resource_ =
         virtual_address_support.MaxGPUVirtualAddressBitsPerResource;
   }
+  cache_coherent_uma_ = false;
+  D3D12_FEATURE_DATA_ARCHITECTURE architecture = {};
+  if (SUCCEEDED(device->CheckFeatureSupport(D3D12_FEATURE_ARCHITECTURE,
+                                            &architecture,
+                                            sizeof(architecture)))) {
+    cache_coherent_uma_ = architecture.UMA && architecture.CacheCoherentUMA;
+  }
   XELOGD3D(
       "Direct3D 12 device and OS features:\n"
+      "* Cache-coherent UMA: {}\n"
       "* Max GPU virtual address bits per resource: {}\n"
       "* Non-zeroed heap creation: {}\n"
       "* Pixel-shader-specified stencil reference: {}\n"
@@ -467,7 +496,7 @@ bool D3D12Provider::Initialize() {
       "* Resource binding: tier {}\n"
       "* Tiled resources: tier {}\n"
       "* Unaligned block-compressed textures: {}",
-      virtual_address_bits_per_resource_,
+      cache_coherent_uma_ ? "yes" : "no", virtual_address_bits_per_resource_,
       (heap_flag_create_not_zeroed_ & D3D12_HEAP_FLAG_CREATE_NOT_ZEROED) ? "yes"
                                                                          : "no",
       ps_specified_stencil_reference_supported_ ? "yes" : "no",
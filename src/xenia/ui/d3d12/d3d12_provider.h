@@ -100,6 +100,10 @@ class D3D12Provider : public GraphicsProvider {
 
   // Adapter info.
   GpuVendorID GetAdapterVendorID() const { return adapter_vendor_id_; }
+  // Current local video memory budget from the OS and the usage by the
+  // process. Returns false if not available.
+  bool QueryLocalVideoMemoryInfo(uint64_t& budget_out,
+                                 uint64_t& usage_out) const;
 
   // Device features.
   D3D12_HEAP_FLAGS GetHeapFlagCreateNotZeroed() const {
@@ -127,6 +131,10 @@ class D3D12Provider : public GraphicsProvider {
   uint32_t GetVirtualAddressBitsPerResource() const {
     return virtual_address_bits_per_resource_;
   }
+  // Whether the GPU shares cache-coherent memory with the CPU, so custom heaps
+  // with write-back CPU page properties in L0 can be accessed by both without
+  // the overhead of uncached CPU access.
+  bool IsCacheCoherentUMA() const { return cache_coherent_uma_; }
 
   // Proxies for DirectX functions since they are loaded dynamically.
   HRESULT SerializeRootSignature(const D3D12_ROOT_SIGNATURE_DESC* desc,
@@ -190,6 +198,8 @@ class D3D12Provider : public GraphicsProvider {
   DxcCreateInstanceProc pfn_dxcompiler_dxc_create_instance_ = nullptr;
 
   IDXGIFactory2* dxgi_factory_ = nullptr;
+  // For video memory budget queries, may be null.
+  IDXGIAdapter3* adapter3_ = nullptr;
   ID3D12Device* device_ = nullptr;
   ID3D12CommandQueue* direct_queue_ = nullptr;
   IDXGraphicsAnalysis* graphics_analysis_ = nullptr;
@@ -206,6 +216,7 @@ class D3D12Provider : public GraphicsProvider {
   bool ps_specified_stencil_reference_supported_;
   bool rasterizer_ordered_views_supported_;
   bool unaligned_block_textures_supported_;
+  bool cache_coherent_uma_;
 
   lightweight_nvapi::nvapi_state_t* nvapi_;
   lightweight_nvapi::cb_NvAPI_D3D12_CreateCommittedResource
@@ -34,6 +34,11 @@ class ImGuiDialog {
 
   void Draw();
 
+  // Whether the contents of the dialog may change without input, such as live
+  // statistics, so it must not stop being repainted when it looks the same for
+  // some frames.
+  virtual bool IsUpdatedContinuously() const { return false; }
+
  protected:
   ImGuiDialog(ImGuiDrawer* imgui_drawer);
 
@@ -9,6 +9,7 @@
 
 #include "xenia/ui/imgui_drawer.h"
 
+#include <algorithm>
 #include <cfloat>
 #include <cstring>
 
@@ -17,6 +18,7 @@
 #include "xenia/base/clock.h"
 #include "xenia/base/logging.h"
 #include "xenia/base/math.h"
+#include "xenia/base/xxhash.h"
 #include "xenia/ui/imgui_dialog.h"
 #include "xenia/ui/imgui_notification.h"
 #include "xenia/ui/resources.h"
@@ -47,6 +49,13 @@ const char kProggyTinyCompressedDataBase85[10950 + 1] =
 
 static_assert(sizeof(ImmediateVertex) == sizeof(ImDrawVert),
               "Vertex types must match");
+static_assert(sizeof(ImDrawIdx) == sizeof(uint16_t),
+              "Index types must match");
+
+// Number of identical frames after which continuous repainting stops. More
+// than one because Dear ImGui may react to input in the frame after it, such
+// as by highlighting the item under the mouse.
+constexpr uint32_t kUnchangedFramesBeforeIdle = 3;
 
 ImGuiDrawer::ImGuiDrawer(xe::ui::Window* window, size_t z_order)
     : window_(window), z_order_(z_order) {
@@ -89,6 +98,7 @@ void ImGuiDrawer::AddDialog(ImGuiDialog* dialog) {
     }
   }
   dialogs_.push_back(dialog);
+  RequestRepaint();
 }
 
 void ImGuiDrawer::RemoveDialog(ImGuiDialog* dialog) {
@@ -105,6 +115,7 @@ void ImGuiDrawer::RemoveDialog(ImGuiDialog* dialog) {
     }
   }
   dialogs_.erase(it);
+  RequestRepaint();
   DetachIfLastWindowRemoved();
 }
 
@@ -121,6 +132,7 @@ void ImGuiDrawer::AddNotification(ImGuiNotification* dialog) {
     }
   }
   notifications_.push_back(dialog);
+  RequestRepaint();
 }
 
 void ImGuiDrawer::RemoveNotification(ImGuiNotification* dialog) {
@@ -130,6 +142,7 @@ void ImGuiDrawer::RemoveNotification(ImGuiNotification* dialog) {
     return;
   }
   notifications_.erase(it);
+  RequestRepaint();
   DetachIfLastWindowRemoved();
 }
 
@@ -500,8 +513,10 @@ void ImGuiDrawer::Draw(UIDrawContext& ui_draw_context) {
 
   ImGui::Render();
   ImDrawData* draw_data = ImGui::GetDrawData();
+  uint64_t frame_hash = 0;
   if (draw_data) {
-    RenderDrawLists(draw_data, ui_draw_context);
+    frame_hash = BuildDrawBatch(*draw_data);
+    RenderDrawBatch(ui_draw_context);
   }
 
   if (reset_mouse_position_after_next_frame_) {
@@ -514,8 +529,17 @@ void ImGuiDrawer::Draw(UIDrawContext& ui_draw_context) {
   DetachIfLastWindowRemoved();
 
   if (!dialogs_.empty() || !notifications_.empty()) {
-    // Repaint (and handle input) continuously if still active.
-    presenter_->RequestUIPaintFromUIThread();
+    // Repaint (and handle input) continuously if still active, unless nothing
+    // has changed for a few frames - painting will be resumed by input then.
+    if (frame_hash != last_frame_hash_ || IsUpdatedContinuously()) {
+      unchanged_frame_count_ = 0;
+    } else if (unchanged_frame_count_ < kUnchangedFramesBeforeIdle) {
+      ++unchanged_frame_count_;
+    }
+    last_frame_hash_ = frame_hash;
+    if (unchanged_frame_count_ < kUnchangedFramesBeforeIdle) {
+      presenter_->RequestUIPaintFromUIThread();
+    }
   }
 }
 
@@ -527,45 +551,125 @@ void ImGuiDrawer::ClearDialogs() {
   }
 }
 
-void ImGuiDrawer::RenderDrawLists(ImDrawData* data,
-                                  UIDrawContext& ui_draw_context) {
-  ImGuiIO& io = ImGui::GetIO();
-
-  immediate_drawer_->Begin(ui_draw_context, io.DisplaySize.x, io.DisplaySize.y);
-
-  for (int i = 0; i < data->CmdListsCount; ++i) {
-    const auto cmd_list = data->CmdLists[i];
-
-    ImmediateDrawBatch batch;
-    batch.vertices =
-        reinterpret_cast<ImmediateVertex*>(cmd_list->VtxBuffer.Data);
-    batch.vertex_count = cmd_list->VtxBuffer.size();
-    batch.indices = cmd_list->IdxBuffer.Data;
-    batch.index_count = cmd_list->IdxBuffer.size();
-    immediate_drawer_->BeginDrawBatch(batch);
-
-    for (int j = 0; j < cmd_list->CmdBuffer.size(); ++j) {
-      const auto& cmd = cmd_list->CmdBuffer[j];
-
-      ImmediateDraw draw;
+uint64_t ImGuiDrawer::BuildDrawBatch(const ImDrawData& data) {
+  batch_vertices_.clear();
+  batch_indices_.clear();
+  batch_draws_.clear();
+  for (int i = 0; i < data.CmdListsCount; ++i) {
+    const ImDrawList& cmd_list = *data.CmdLists[i];
+    int list_base_vertex = int(batch_vertices_.size());
+    int list_index_offset = int(batch_indices_.size());
+    const auto* vertices =
+        reinterpret_cast<const ImmediateVertex*>(cmd_list.VtxBuffer.Data);
+    batch_vertices_.insert(batch_vertices_.end(), vertices,
+                           vertices + cmd_list.VtxBuffer.size());
+    batch_indices_.insert(batch_indices_.end(), cmd_list.IdxBuffer.Data,
+                          cmd_list.IdxBuffer.Data + cmd_list.IdxBuffer.size());
+    // The indices are relative to the vertices of the list, which are not
+    // rebased as there may be more than 65536 vertices in total.
+    size_t list_first_draw = batch_draws_.size();
+    for (int j = 0; j < cmd_list.CmdBuffer.size(); ++j) {
+      const ImDrawCmd& cmd = cmd_list.CmdBuffer[j];
+      auto texture = reinterpret_cast<ImmediateTexture*>(cmd.TextureId);
+      int base_vertex = list_base_vertex + int(cmd.VtxOffset);
+      int index_offset = list_index_offset + int(cmd.IdxOffset);
+      if (batch_draws_.size() > list_first_draw) {
+        // Merge with the previous draw if only the range of the indices is
+        // different, and continues it.
+        ImmediateDraw& previous_draw = batch_draws_.back();
+        if (previous_draw.texture == texture &&
+            previous_draw.base_vertex == base_vertex &&
+            previous_draw.index_offset + previous_draw.count == index_offset &&
+            previous_draw.scissor_left == cmd.ClipRect.x &&
+            previous_draw.scissor_top == cmd.ClipRect.y &&
+            previous_draw.scissor_right == cmd.ClipRect.z &&
+            previous_draw.scissor_bottom == cmd.ClipRect.w) {
+          previous_draw.count += int(cmd.ElemCount);
+          continue;
+        }
+      }
+      ImmediateDraw& draw = batch_draws_.emplace_back();
       draw.primitive_type = ImmediatePrimitiveType::kTriangles;
-      draw.count = cmd.ElemCount;
-      draw.index_offset = cmd.IdxOffset;
-      draw.texture = reinterpret_cast<ImmediateTexture*>(cmd.TextureId);
+      draw.count = int(cmd.ElemCount);
+      draw.index_offset = index_offset;
+      draw.base_vertex = base_vertex;
+      draw.texture = texture;
       draw.scissor = true;
       draw.scissor_left = cmd.ClipRect.x;
       draw.scissor_top = cmd.ClipRect.y;
       draw.scissor_right = cmd.ClipRect.z;
       draw.scissor_bottom = cmd.ClipRect.w;
-      immediate_drawer_->Draw(draw);
     }
+  }
+
+  XXH3_state_t hash_state;
+  XXH3_64bits_reset(&hash_state);
+  XXH3_64bits_update(&hash_state, &data.DisplaySize, sizeof(data.DisplaySize));
+  XXH3_64bits_update(&hash_state, batch_vertices_.data(),
+                     sizeof(ImmediateVertex) * batch_vertices_.size());
+  XXH3_64bits_update(&hash_state, batch_indices_.data(),
+                     sizeof(uint16_t) * batch_indices_.size());
+  for (const ImmediateDraw& draw : batch_draws_) {
+    // Not hashing the structure itself, its padding is undefined.
+    struct {
+      uint64_t texture;
+      int32_t count;
+      int32_t index_offset;
+      int32_t base_vertex;
+      float scissor[4];
+      uint32_t padding;
+    } draw_hash_data = {uint64_t(uintptr_t(draw.texture)),
+                        draw.count,
+                        draw.index_offset,
+                        draw.base_vertex,
+                        {draw.scissor_left, draw.scissor_top,
+                         draw.scissor_right, draw.scissor_bottom},
+                        0};
+    XXH3_64bits_update(&hash_state, &draw_hash_data, sizeof(draw_hash_data));
+  }
+  return XXH3_64bits_digest(&hash_state);
+}
 
-    immediate_drawer_->EndDrawBatch();
+void ImGuiDrawer::RenderDrawBatch(UIDrawContext& ui_draw_context) {
+  if (batch_draws_.empty()) {
+    return;
+  }
+  ImGuiIO& io = ImGui::GetIO();
+
+  immediate_drawer_->Begin(ui_draw_context, io.DisplaySize.x, io.DisplaySize.y);
+
+  // Uploading the vertices and the indices of all the lists at once.
+  ImmediateDrawBatch batch;
+  batch.vertices = batch_vertices_.data();
+  batch.vertex_count = int(batch_vertices_.size());
+  batch.indices = batch_indices_.data();
+  batch.index_count = int(batch_indices_.size());
+  immediate_drawer_->BeginDrawBatch(batch);
+  for (const ImmediateDraw& draw : batch_draws_) {
+    immediate_drawer_->Draw(draw);
   }
+  immediate_drawer_->EndDrawBatch();
 
   immediate_drawer_->End();
 }
 
+bool ImGuiDrawer::IsUpdatedContinuously() const {
+  if (!notifications_.empty()) {
+    return true;
+  }
+  return std::any_of(dialogs_.cbegin(), dialogs_.cend(),
+                     [](const ImGuiDialog* dialog) {
+                       return dialog->IsUpdatedContinuously();
+                     });
+}
+
+void ImGuiDrawer::RequestRepaint() {
+  unchanged_frame_count_ = 0;
+  if (presenter_) {
+    presenter_->RequestUIPaintFromUIThread();
+  }
+}
+
 ImGuiIO& ImGuiDrawer::GetIO() {
   ImGui::SetCurrentContext(internal_state_);
   return ImGui::GetIO();
@@ -576,6 +680,7 @@ void ImGuiDrawer::OnKeyDown(KeyEvent& e) { OnKey(e, true); }
 void ImGuiDrawer::OnKeyUp(KeyEvent& e) { OnKey(e, false); }
 
 void ImGuiDrawer::OnKeyChar(KeyEvent& e) {
+  RequestRepaint();
   auto& io = GetIO();
   // TODO(Triang3l): Accept the Unicode character.
   unsigned int character = static_cast<unsigned int>(e.virtual_key());
@@ -586,6 +691,7 @@ void ImGuiDrawer::OnKeyChar(KeyEvent& e) {
 }
 
 void ImGuiDrawer::OnMouseDown(MouseEvent& e) {
+  RequestRepaint();
   SwitchToPhysicalMouseAndUpdateMousePosition(e);
   auto& io = GetIO();
   int button = -1;
@@ -614,10 +720,12 @@ void ImGuiDrawer::OnMouseDown(MouseEvent& e) {
 }
 
 void ImGuiDrawer::OnMouseMove(MouseEvent& e) {
+  RequestRepaint();
   SwitchToPhysicalMouseAndUpdateMousePosition(e);
 }
 
 void ImGuiDrawer::OnMouseUp(MouseEvent& e) {
+  RequestRepaint();
   SwitchToPhysicalMouseAndUpdateMousePosition(e);
   auto& io = GetIO();
   int button = -1;
@@ -646,12 +754,14 @@ void ImGuiDrawer::OnMouseUp(MouseEvent& e) {
 }
 
 void ImGuiDrawer::OnMouseWheel(MouseEvent& e) {
+  RequestRepaint();
   SwitchToPhysicalMouseAndUpdateMousePosition(e);
   auto& io = GetIO();
   io.MouseWheel += float(e.scroll_y()) / float(MouseEvent::kScrollPerDetent);
 }
 
 void ImGuiDrawer::OnTouchEvent(TouchEvent& e) {
+  RequestRepaint();
   auto& io = GetIO();
   TouchEvent::Action action = e.action();
   uint32_t pointer_id = e.pointer_id();
@@ -699,6 +809,7 @@ void ImGuiDrawer::ClearInput() {
 }
 
 void ImGuiDrawer::OnKey(KeyEvent& e, bool is_down) {
+  RequestRepaint();
   auto& io = GetIO();
   const VirtualKey virtual_key = e.virtual_key();
   if (auto imGuiKey = VirtualKeyToImGuiKey(virtual_key); imGuiKey) {
@@ -76,7 +76,8 @@ class ImGuiDrawer : public WindowInputListener, public UIDrawer {
   void OnMouseUp(MouseEvent& e) override;
   void OnMouseWheel(MouseEvent& e) override;
   void OnTouchEvent(TouchEvent& e) override;
-  // For now, no need for OnDpiChanged because redrawing is done continuously.
+  // No need for OnDpiChanged, the DPI change is followed by a resize, which
+  // causes a repaint.
 
  private:
   void Initialize();
@@ -88,7 +89,15 @@ class ImGuiDrawer : public WindowInputListener, public UIDrawer {
   void SetupNotificationTextures();
   void SetupFontTexture();
 
-  void RenderDrawLists(ImDrawData* data, UIDrawContext& ui_draw_context);
+  // Gathers the vertices, the indices and the draws of all draw lists into one
+  // batch, returning the hash of its contents.
+  uint64_t BuildDrawBatch(const ImDrawData& data);
+  void RenderDrawBatch(UIDrawContext& ui_draw_context);
+  // Whether anything drawn may change without input, such as notifications
+  // fading out, so it must be repainted even if the last frames were the same.
+  bool IsUpdatedContinuously() const;
+  // Resumes repainting if it was stopped because the frames were the same.
+  void RequestRepaint();
 
   void ClearInput();
   void OnKey(KeyEvent& e, bool is_down);
@@ -137,6 +146,16 @@ class ImGuiDrawer : public WindowInputListener, public UIDrawer {
 
   double frame_time_tick_frequency_;
   uint64_t last_frame_time_ticks_;
+
+  // The draw batch of the current frame, reused between frames to avoid
+  // reallocating the storage.
+  std::vector<ImmediateVertex> batch_vertices_;
+  std::vector<uint16_t> batch_indices_;
+  std::vector<ImmediateDraw> batch_draws_;
+  // For stopping the continuous repainting while nothing changes, until input
+  // is received.
+  uint64_t last_frame_hash_ = 0;
+  uint32_t unchanged_frame_count_ = 0;
 };
 
 }  // namespace ui
@@ -14,6 +14,8 @@
 
 #include "xenia/base/assert.h"
 #include "xenia/base/cvar.h"
+#include "xenia/base/frame_timeline.h"
+#include "xenia/base/input_latency.h"
 #include "xenia/base/logging.h"
 #include "xenia/base/platform.h"
 #include "xenia/ui/window.h"
@@ -246,6 +248,7 @@ void Presenter::PaintFromUIThread(bool force_paint) {
   // Reset ui_thread_paint_requested_ unconditionally also, regardless of
   // whether the UI needs to be drawn - the flag may be set to try reconnecting,
   // for example.
+  ui_thread_paint_requested_urgently_.store(false, std::memory_order_relaxed);
   if (ui_thread_paint_requested_.exchange(false, std::memory_order_relaxed)) {
     do_paint = true;
   }
@@ -1191,12 +1194,22 @@ bool Presenter::RequestPaintOrConnectionRecoveryViaWindow(
   // theoretically. For safety, check whether the window exists unconditionally.
   assert_not_null(window_);
   assert_not_null(surface_);
-  if (ui_thread_paint_requested_.exchange(true, std::memory_order_relaxed)) {
-    // Invalidation pending already, no need to do it twice.
-    return false;
-  }
+  bool paint_requested =
+      ui_thread_paint_requested_.exchange(true, std::memory_order_relaxed);
   if (force_ui_thread_paint_tick) {
+    // Painting as soon as possible, even if a regular request is pending
+    // already, as it may be behind the input and other window messages.
+    if (ui_thread_paint_requested_urgently_.exchange(
+            true, std::memory_order_relaxed)) {
+      return false;
+    }
     ForceUIThreadPaintTick();
+    window_->RequestPaintUrgently();
+    return true;
+  }
+  if (paint_requested) {
+    // Invalidation pending already, no need to do it twice.
+    return false;
   }
   window_->RequestPaint();
   return true;
@@ -1279,6 +1292,11 @@ Presenter::PaintResult Presenter::PaintAndPresent(bool execute_ui_drawers) {
   assert_true(surface_paint_connection_state_ ==
               SurfacePaintConnectionState::kConnectedPaintable);
   PaintResult result = PaintAndPresentImpl(execute_ui_drawers);
+  if (result == PaintResult::kPresented ||
+      result == PaintResult::kPresentedSuboptimal) {
+    input_latency::OnPresent();
+    frame_timeline::OnPresent();
+  }
   switch (result) {
     case PaintResult::kPresented:
       surface_paint_connection_was_optimal_at_successful_paint_ = true;
@@ -914,6 +914,9 @@ class Presenter {
   // connection as the next successful reconnection should be followed by a
   // repaint request anyway.
   std::atomic<bool> ui_thread_paint_requested_{false};
+  // Whether the pending paint request has been made via RequestPaintUrgently,
+  // not to delay a new guest output frame if a regular request is pending.
+  std::atomic<bool> ui_thread_paint_requested_urgently_{false};
 
   std::mutex guest_output_paint_config_mutex_;
   // UI thread: writable, guest output thread: read-only.
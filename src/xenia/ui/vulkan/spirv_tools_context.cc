@@ -63,17 +63,33 @@ bool SpirvToolsContext::Initialize(unsigned int spirv_version) {
     Shutdown();
     return false;
   }
-  spv_target_env target_env;
+  if (!LoadLibraryFunction(fn_spvOptimizerCreate_, "spvOptimizerCreate") ||
+      !LoadLibraryFunction(fn_spvOptimizerDestroy_, "spvOptimizerDestroy") ||
+      !LoadLibraryFunction(fn_spvOptimizerRegisterPerformancePasses_,
+                           "spvOptimizerRegisterPerformancePasses") ||
+      !LoadLibraryFunction(fn_spvOptimizerRegisterPassFromFlag_,
+                           "spvOptimizerRegisterPassFromFlag") ||
+      !LoadLibraryFunction(fn_spvOptimizerOptionsCreate_,
+                           "spvOptimizerOptionsCreate") ||
+      !LoadLibraryFunction(fn_spvOptimizerOptionsDestroy_,
+                           "spvOptimizerOptionsDestroy") ||
+      !LoadLibraryFunction(fn_spvOptimizerOptionsSetRunValidator_,
+                           "spvOptimizerOptionsSetRunValidator") ||
+      !LoadLibraryFunction(fn_spvBinaryDestroy_, "spvBinaryDestroy") ||
+      !LoadLibraryFunction(fn_spvOptimizerRun_, "spvOptimizerRun")) {
+    XELOGW("SPIRV-Tools: The optimizer is not available in the library");
+    fn_spvOptimizerRun_ = nullptr;
+  }
   if (spirv_version >= 0x10500) {
-    target_env = SPV_ENV_VULKAN_1_2;
+    target_env_ = SPV_ENV_VULKAN_1_2;
   } else if (spirv_version >= 0x10400) {
-    target_env = SPV_ENV_VULKAN_1_1_SPIRV_1_4;
+    target_env_ = SPV_ENV_VULKAN_1_1_SPIRV_1_4;
   } else if (spirv_version >= 0x10300) {
-    target_env = SPV_ENV_VULKAN_1_1;
+    target_env_ = SPV_ENV_VULKAN_1_1;
   } else {
-    target_env = SPV_ENV_VULKAN_1_0;
+    target_env_ = SPV_ENV_VULKAN_1_0;
   }
-  context_ = fn_spvContextCreate_(target_env);
+  context_ = fn_spvContextCreate_(target_env_);
   if (!context_) {
     XELOGE("SPIRV-Tools: Failed to create a Vulkan 1.0 context");
     Shutdown();
@@ -95,6 +111,7 @@ void SpirvToolsContext::Shutdown() {
 #endif
     library_ = nullptr;
   }
+  fn_spvOptimizerRun_ = nullptr;
 }
 
 spv_result_t SpirvToolsContext::Validate(const uint32_t* words,
@@ -118,6 +135,43 @@ spv_result_t SpirvToolsContext::Validate(const uint32_t* words,
   return result;
 }
 
+bool SpirvToolsContext::Optimize(const uint32_t* words, size_t num_words,
+                                 std::vector<uint32_t>& optimized_out) const {
+  optimized_out.clear();
+  if (!context_ || !IsOptimizerAvailable()) {
+    return false;
+  }
+  spv_optimizer_t* optimizer = fn_spvOptimizerCreate_(target_env_);
+  if (!optimizer) {
+    return false;
+  }
+  fn_spvOptimizerRegisterPerformancePasses_(optimizer);
+  // Not in the performance passes, but the translator declares all the
+  // interpolators and system values that may be needed by any modification.
+  // Not available in older versions of the library, but not required.
+  fn_spvOptimizerRegisterPassFromFlag_(optimizer,
+                                       "--remove-unused-interface-variables");
+  spv_optimizer_options options = fn_spvOptimizerOptionsCreate_();
+  // Skipping validation for speed - the translator output is expected to be
+  // valid.
+  fn_spvOptimizerOptionsSetRunValidator_(options, false);
+  spv_binary optimized_binary = nullptr;
+  spv_result_t result = fn_spvOptimizerRun_(optimizer, words, num_words,
+                                            &optimized_binary, options);
+  fn_spvOptimizerOptionsDestroy_(options);
+  fn_spvOptimizerDestroy_(optimizer);
+  if (result != SPV_SUCCESS || !optimized_binary) {
+    if (optimized_binary) {
+      fn_spvBinaryDestroy_(optimized_binary);
+    }
+    return false;
+  }
+  optimized_out.assign(optimized_binary->code,
+                       optimized_binary->code + optimized_binary->wordCount);
+  fn_spvBinaryDestroy_(optimized_binary);
+  return !optimized_out.empty();
+}
+
 }  // namespace vulkan
 }  // namespace ui
 }  // namespace xe
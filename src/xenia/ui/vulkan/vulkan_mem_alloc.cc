@@ -15,6 +15,7 @@
 
 #include "xenia/base/logging.h"
 #include "xenia/ui/vulkan/vulkan_provider.h"
+#include "xenia/ui/vulkan/vulkan_util.h"
 
 namespace xe {
 namespace ui {
@@ -103,6 +104,129 @@ VmaAllocator CreateVmaAllocator(const VulkanProvider& provider,
   return allocator;
 }
 
+VmaImagePools::~VmaImagePools() {
+  for (VmaPool pool : pools_) {
+    if (pool != VK_NULL_HANDLE) {
+      vmaDestroyPool(allocator_, pool);
+    }
+  }
+}
+
+bool VmaImagePools::CreateImage(const VkImageCreateInfo& image_create_info,
+                                VkImage& image_out,
+                                VmaAllocation& allocation_out) {
+  const VulkanProvider::DeviceFunctions& dfn = provider_.dfn();
+  VkDevice device = provider_.device();
+
+  VkImage image;
+  if (dfn.vkCreateImage(device, &image_create_info, nullptr, &image) !=
+      VK_SUCCESS) {
+    return false;
+  }
+  VkMemoryRequirements memory_requirements;
+  dfn.vkGetImageMemoryRequirements(device, image, &memory_requirements);
+  uint32_t memory_type =
+      util::ChooseMemoryType(provider_, memory_requirements.memoryTypeBits,
+                             util::MemoryPurpose::kDeviceLocal);
+  if (memory_type == UINT32_MAX) {
+    dfn.vkDestroyImage(device, image, nullptr);
+    return false;
+  }
+
+  VmaAllocation allocation = VK_NULL_HANDLE;
+  if (block_size_ && memory_requirements.size <= block_size_ / 2) {
+    VmaPool& pool = pools_[memory_type];
+    if (pool == VK_NULL_HANDLE) {
+      VmaPoolCreateInfo pool_create_info = {};
+      pool_create_info.memoryTypeIndex = memory_type;
+      pool_create_info.blockSize = block_size_;
+      if (vmaCreatePool(allocator_, &pool_create_info, &pool) != VK_SUCCESS) {
+        XELOGE("Failed to create a {} MB VMA pool for memory type {}",
+               block_size_ >> 20, memory_type);
+        pool = VK_NULL_HANDLE;
+      }
+    }
+    if (pool != VK_NULL_HANDLE) {
+      VmaAllocationCreateInfo allocation_create_info = {};
+      allocation_create_info.pool = pool;
+      // Without a new block if that would exceed the budget - the image can
+      // still fit in a separate allocation of its own size then.
+      allocation_create_info.flags = VMA_ALLOCATION_CREATE_WITHIN_BUDGET_BIT;
+      if (vmaAllocateMemoryForImage(allocator_, image, &allocation_create_info,
+                                    &allocation, nullptr) != VK_SUCCESS) {
+        allocation = VK_NULL_HANDLE;
+      }
+    }
+  }
+  if (allocation == VK_NULL_HANDLE) {
+    VmaAllocationCreateInfo allocation_create_info = {};
+    allocation_create_info.memoryTypeBits = UINT32_C(1) << memory_type;
+    // Distinguishing the separate allocations when destroying.
+    allocation_create_info.pUserData = this;
+    if (vmaAllocateMemoryForImage(allocator_, image, &allocation_create_info,
+                                  &allocation, nullptr) != VK_SUCCESS) {
+      dfn.vkDestroyImage(device, image, nullptr);
+      return false;
+    }
+    ++separate_allocation_count_;
+    separate_allocation_bytes_ += memory_requirements.size;
+  }
+
+  if (vmaBindImageMemory(allocator_, allocation, image) != VK_SUCCESS) {
+    DestroyImage(image, allocation);
+    return false;
+  }
+
+  image_out = image;
+  allocation_out = allocation;
+  return true;
+}
+
+void VmaImagePools::DestroyImage(VkImage image, VmaAllocation allocation) {
+  VmaAllocationInfo allocation_info;
+  vmaGetAllocationInfo(allocator_, allocation, &allocation_info);
+  if (allocation_info.pUserData == this) {
+    --separate_allocation_count_;
+    separate_allocation_bytes_ -= allocation_info.size;
+  }
+  vmaDestroyImage(allocator_, image, allocation);
+}
+
+VmaImagePools::Statistics VmaImagePools::GetStatistics() const {
+  Statistics statistics;
+  for (VmaPool pool : pools_) {
+    if (pool == VK_NULL_HANDLE) {
+      continue;
+    }
+    VmaStatistics pool_statistics;
+    vmaGetPoolStatistics(allocator_, pool, &pool_statistics);
+    statistics.block_count += pool_statistics.blockCount;
+    statistics.block_bytes += pool_statistics.blockBytes;
+    statistics.pooled_allocation_count += pool_statistics.allocationCount;
+    statistics.pooled_allocation_bytes += pool_statistics.allocationBytes;
+  }
+  statistics.separate_allocation_count = separate_allocation_count_;
+  statistics.separate_allocation_bytes = separate_allocation_bytes_;
+  return statistics;
+}
+
+void VmaImagePools::LogStatistics(const char* name) const {
+  for (size_t i = 0; i < pools_.size(); ++i) {
+    if (pools_[i] == VK_NULL_HANDLE) {
+      continue;
+    }
+    VmaStatistics pool_statistics;
+    vmaGetPoolStatistics(allocator_, pools_[i], &pool_statistics);
+    XELOGGPU(
+        "{}: Memory type {} pool: {} images in {} KB, {} blocks of {} KB",
+        name, i, pool_statistics.allocationCount,
+        pool_statistics.allocationBytes >> 10, pool_statistics.blockCount,
+        pool_statistics.blockBytes >> 10);
+  }
+  XELOGGPU("{}: {} images in separate allocations of {} KB", name,
+           separate_allocation_count_, separate_allocation_bytes_ >> 10);
+}
+
 }  // namespace vulkan
 }  // namespace ui
 }  // namespace xe
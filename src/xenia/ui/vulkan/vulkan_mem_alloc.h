@@ -13,6 +13,9 @@
 // Make sure vulkan.h is included from third_party (rather than from the system
 // include directory) before vk_mem_alloc.h.
 
+#include <array>
+#include <cstdint>
+
 #include "xenia/ui/vulkan/vulkan_provider.h"
 
 #define VMA_STATIC_VULKAN_FUNCTIONS 0
@@ -32,6 +35,52 @@ namespace vulkan {
 VmaAllocator CreateVmaAllocator(const VulkanProvider& provider,
                                 bool externally_synchronized);
 
+// Suballocates the device-local images of one usage class, such as textures or
+// render targets, from VMA pools created on demand for each memory type, so
+// images with similar lifetimes share large device memory blocks instead of
+// taking separate allocations. Images larger than half of a block, or all
+// images if the block size is 0, are allocated outside the pools. Must be
+// accessed with the same external synchronization as the allocator.
+class VmaImagePools {
+ public:
+  struct Statistics {
+    // Device memory blocks of the pools.
+    uint32_t block_count = 0;
+    VkDeviceSize block_bytes = 0;
+    // Images in the pools.
+    uint32_t pooled_allocation_count = 0;
+    VkDeviceSize pooled_allocation_bytes = 0;
+    // Images allocated outside the pools.
+    uint32_t separate_allocation_count = 0;
+    VkDeviceSize separate_allocation_bytes = 0;
+  };
+
+  VmaImagePools(const VulkanProvider& provider, VmaAllocator allocator,
+                VkDeviceSize block_size)
+      : provider_(provider), allocator_(allocator), block_size_(block_size) {}
+  VmaImagePools(const VmaImagePools&) = delete;
+  VmaImagePools& operator=(const VmaImagePools&) = delete;
+  // All the images must be destroyed before the pools.
+  ~VmaImagePools();
+
+  // Creates the image and binds device-local memory to it.
+  bool CreateImage(const VkImageCreateInfo& image_create_info,
+                   VkImage& image_out, VmaAllocation& allocation_out);
+  void DestroyImage(VkImage image, VmaAllocation allocation);
+
+  Statistics GetStatistics() const;
+  // Logs the statistics of each pool, prefixed with the name of the user.
+  void LogStatistics(const char* name) const;
+
+ private:
+  const VulkanProvider& provider_;
+  VmaAllocator allocator_;
+  VkDeviceSize block_size_;
+  std::array<VmaPool, VK_MAX_MEMORY_TYPES> pools_ = {};
+  uint32_t separate_allocation_count_ = 0;
+  VkDeviceSize separate_allocation_bytes_ = 0;
+};
+
 }  // namespace vulkan
 }  // namespace ui
 }  // namespace xe
@@ -744,6 +744,11 @@ void VulkanProvider::TryCreateDevice() {
   }
 
   device_info_.apiVersion = properties.apiVersion;
+  device_info_.driverVersion = properties.driverVersion;
+  device_info_.vendorID = properties.vendorID;
+  device_info_.deviceID = properties.deviceID;
+  std::memcpy(device_info_.pipelineCacheUUID, properties.pipelineCacheUUID,
+              sizeof(device_info_.pipelineCacheUUID));
 
   XELOGVK("Device Vulkan API version: {}.{}.{}",
           VK_API_VERSION_MAJOR(properties.apiVersion),
@@ -822,6 +827,8 @@ void VulkanProvider::TryCreateDevice() {
       EXTENSION(VK_EXT_memory_budget)
       EXTENSION(VK_EXT_fragment_shader_interlock)
       EXTENSION(VK_EXT_non_seamless_cube_map)
+      EXTENSION(VK_KHR_pipeline_library)
+      EXTENSION(VK_EXT_graphics_pipeline_library)
     } else {
       if (!std::strcmp(extension.extensionName, "VK_KHR_portability_subset")) {
         XELOGW(
@@ -922,6 +929,8 @@ void VulkanProvider::TryCreateDevice() {
   LIMIT_SAMPLE_COUNTS(sampledImageIntegerSampleCounts)
   LIMIT_SAMPLE_COUNTS(sampledImageDepthSampleCounts)
   LIMIT_SAMPLE_COUNTS(sampledImageStencilSampleCounts)
+  LIMIT(timestampComputeAndGraphics)
+  LIMIT(timestampPeriod)
   LIMIT(standardSampleLocations)
   LIMIT(optimalBufferCopyOffsetAlignment)
   LIMIT(optimalBufferCopyRowPitchAlignment)
@@ -1028,6 +1037,14 @@ void VulkanProvider::TryCreateDevice() {
   if (device_info_.ext_VK_EXT_non_seamless_cube_map) {
     FEATURES2_ADD(NonSeamlessCubeMapFeaturesEXT)
   }
+  FEATURES2_DECLARE(GraphicsPipelineLibraryFeaturesEXT,
+                    GRAPHICS_PIPELINE_LIBRARY_FEATURES_EXT)
+  PROPERTIES2_DECLARE(GraphicsPipelineLibraryPropertiesEXT,
+                      GRAPHICS_PIPELINE_LIBRARY_PROPERTIES_EXT)
+  if (device_info_.ext_VK_EXT_graphics_pipeline_library) {
+    FEATURES2_ADD(GraphicsPipelineLibraryFeaturesEXT)
+    PROPERTIES2_ADD(GraphicsPipelineLibraryPropertiesEXT)
+  }
 
   if (instance_extensions_.khr_get_physical_device_properties2) {
     ifn_.vkGetPhysicalDeviceProperties2(physical_device_, &properties2);
@@ -1125,6 +1142,16 @@ void VulkanProvider::TryCreateDevice() {
     EXTENSION_FEATURE(NonSeamlessCubeMapFeaturesEXT, nonSeamlessCubeMap)
   }
 
+  // Pipeline libraries are provided by VK_KHR_pipeline_library, which is
+  // required by VK_EXT_graphics_pipeline_library.
+  if (device_info_.ext_VK_EXT_graphics_pipeline_library &&
+      device_info_.ext_VK_KHR_pipeline_library) {
+    EXTENSION_FEATURE(GraphicsPipelineLibraryFeaturesEXT,
+                      graphicsPipelineLibrary)
+    EXTENSION_PROPERTY(GraphicsPipelineLibraryPropertiesEXT,
+                       graphicsPipelineLibraryFastLinking)
+  }
+
 #undef EXTENSION_FEATURE_PROMOTED_AS_OPTIONAL
 #undef EXTENSION_FEATURE_PROMOTED
 #undef EXTENSION_FEATURE
@@ -1402,6 +1429,36 @@ void VulkanProvider::TryCreateDevice() {
           properties.deviceName);
 }
 
+bool VulkanProvider::QueryDeviceLocalMemoryBudget(uint64_t& budget_out,
+                                                  uint64_t& usage_out) const {
+  if (!device_info_.ext_VK_EXT_memory_budget) {
+    return false;
+  }
+  VkPhysicalDeviceMemoryBudgetPropertiesEXT memory_budget_properties = {};
+  memory_budget_properties.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+  VkPhysicalDeviceMemoryProperties2 memory_properties = {};
+  memory_properties.sType =
+      VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+  memory_properties.pNext = &memory_budget_properties;
+  ifn_.vkGetPhysicalDeviceMemoryProperties2(physical_device_,
+                                            &memory_properties);
+  uint64_t budget = 0;
+  uint64_t usage = 0;
+  for (uint32_t heap_index = 0;
+       heap_index < memory_properties.memoryProperties.memoryHeapCount;
+       ++heap_index) {
+    if (memory_properties.memoryProperties.memoryHeaps[heap_index].flags &
+        VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) {
+      budget += memory_budget_properties.heapBudget[heap_index];
+      usage += memory_budget_properties.heapUsage[heap_index];
+    }
+  }
+  budget_out = budget;
+  usage_out = usage;
+  return true;
+}
+
 }  // namespace vulkan
 }  // namespace ui
 }  // namespace xe
@@ -73,6 +73,10 @@ class VulkanProvider : public GraphicsProvider {
     uint32_t memory_types_host_cached;
 
     uint32_t apiVersion;
+    uint32_t driverVersion;
+    uint32_t vendorID;
+    uint32_t deviceID;
+    uint8_t pipelineCacheUUID[VK_UUID_SIZE];
     uint32_t maxImageDimension2D;
     uint32_t maxImageDimension3D;
     uint32_t maxImageDimensionCube;
@@ -105,6 +109,8 @@ class VulkanProvider : public GraphicsProvider {
     VkSampleCountFlags sampledImageIntegerSampleCounts;
     VkSampleCountFlags sampledImageDepthSampleCounts;
     VkSampleCountFlags sampledImageStencilSampleCounts;
+    bool timestampComputeAndGraphics;
+    float timestampPeriod;
     VkSampleCountFlags standardSampleLocations;
     VkDeviceSize optimalBufferCopyOffsetAlignment;
     VkDeviceSize optimalBufferCopyRowPitchAlignment;
@@ -200,6 +206,17 @@ class VulkanProvider : public GraphicsProvider {
 
     bool shaderDemoteToHelperInvocation;
 
+    // VK_KHR_pipeline_library (#291).
+
+    bool ext_VK_KHR_pipeline_library;
+
+    // VK_EXT_graphics_pipeline_library (#321).
+
+    bool ext_VK_EXT_graphics_pipeline_library;
+
+    bool graphicsPipelineLibrary;
+    bool graphicsPipelineLibraryFastLinking;
+
     // VK_KHR_maintenance4 (#414, Vulkan 1.3).
 
     bool ext_1_3_VK_KHR_maintenance4;
@@ -281,6 +298,11 @@ class VulkanProvider : public GraphicsProvider {
 
   const DeviceInfo& device_info() const { return device_info_; }
 
+  // Current budget of the device-local memory heaps from the OS and the usage
+  // by the process. Returns false if VK_EXT_memory_budget is not supported.
+  bool QueryDeviceLocalMemoryBudget(uint64_t& budget_out,
+                                    uint64_t& usage_out) const;
+
   struct QueueFamily {
     uint32_t queue_first_index = 0;
     uint32_t queue_count = 0;
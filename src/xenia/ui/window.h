@@ -343,6 +343,16 @@ class Window {
       RequestPaintImpl();
     }
   }
+  // Like RequestPaint, but on platforms where the paint requests are fulfilled
+  // only when there are no other messages to handle (such as Windows), the
+  // request is handled ahead of the input and the other pending messages. For
+  // presenting new guest output frames, so UI activity (mouse movement over
+  // the UI, for instance) doesn't delay them.
+  void RequestPaintUrgently() {
+    if (presenter_surface_) {
+      RequestPaintUrgentlyImpl();
+    }
+  }
   void RequestPresenterUIPaintFromUIThread() {
     if (presenter_) {
       presenter_->RequestUIPaintFromUIThread();
@@ -541,6 +551,7 @@ class Window {
       Surface::TypeFlags allowed_types) = 0;
   // Called only if the Surface exists.
   virtual void RequestPaintImpl() = 0;
+  virtual void RequestPaintUrgentlyImpl() { RequestPaintImpl(); }
 
   // Will also disconnect the surface if needed.
   void OnBeforeClose(WindowDestructionReceiver& destruction_receiver);
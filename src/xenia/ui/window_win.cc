@@ -549,6 +549,17 @@ std::unique_ptr<Surface> Win32Window::CreateSurfaceImpl(
 
 void Win32Window::RequestPaintImpl() { InvalidateRect(hwnd_, nullptr, FALSE); }
 
+void Win32Window::RequestPaintUrgentlyImpl() {
+  // WM_PAINT is generated only when the message queue is empty. Messages sent
+  // from other threads are handled before the posted and the input messages,
+  // and SendNotifyMessage doesn't wait for the message to be handled. Within
+  // the UI thread though, it would call the window procedure directly.
+  if (app_context().IsInUIThread() ||
+      !SendNotifyMessageW(hwnd_, kUserMessagePaintUrgently, 0, 0)) {
+    RequestPaintImpl();
+  }
+}
+
 BOOL Win32Window::AdjustWindowRectangle(RECT& rect, DWORD style, BOOL menu,
                                         DWORD ex_style, UINT dpi) const {
   const Win32WindowedAppContext& win32_app_context =
@@ -1062,7 +1073,8 @@ LRESULT Win32Window::WndProc(HWND hWnd, UINT message, WPARAM wParam,
       }
     } break;
 
-    case WM_PAINT: {
+    case WM_PAINT:
+    case kUserMessagePaintUrgently: {
       if (batched_size_update_depth_) {
         // Avoid painting an outdated surface during a batched size update when
         // WM_SIZE handling is deferred.
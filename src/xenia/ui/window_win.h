@@ -60,10 +60,12 @@ class Win32Window : public Window {
   std::unique_ptr<Surface> CreateSurfaceImpl(
       Surface::TypeFlags allowed_types) override;
   void RequestPaintImpl() override;
+  void RequestPaintUrgentlyImpl() override;
 
  private:
   enum : UINT {
     kUserMessageAutoHideCursor = WM_USER,
+    kUserMessagePaintUrgently,
   };
 
   BOOL AdjustWindowRectangle(RECT& rect, DWORD style, BOOL menu, DWORD ex_style,
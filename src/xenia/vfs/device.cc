@@ -10,6 +10,7 @@
 #include "xenia/vfs/device.h"
 
 #include "xenia/base/logging.h"
+#include "xenia/base/utf8.h"
 
 namespace xe {
 namespace vfs {
@@ -17,5 +18,25 @@ namespace vfs {
 Device::Device(const std::string_view mount_path) : mount_path_(mount_path) {}
 Device::~Device() = default;
 
+Entry* Device::ResolvePathCached(const std::string_view path) {
+  auto global_lock = global_critical_region_.Acquire();
+  std::string key = xe::utf8::lower_ascii(path);
+  auto it = path_cache_.find(key);
+  if (it != path_cache_.end()) {
+    return it->second;
+  }
+  Entry* entry = ResolvePath(path);
+  if (path_cache_.size() >= kPathCacheMaxSize) {
+    path_cache_.clear();
+  }
+  path_cache_.emplace(std::move(key), entry);
+  return entry;
+}
+
+void Device::InvalidatePathCache() {
+  auto global_lock = global_critical_region_.Acquire();
+  path_cache_.clear();
+}
+
 }  // namespace vfs
 }  // namespace xe
@@ -12,6 +12,7 @@
 
 #include <memory>
 #include <string>
+#include <unordered_map>
 
 #include "xenia/base/mutex.h"
 #include "xenia/base/string_buffer.h"
@@ -32,6 +33,11 @@ class Device {
 
   virtual void Dump(StringBuffer* string_buffer) = 0;
   virtual Entry* ResolvePath(const std::string_view path) = 0;
+  // ResolvePath with the results, including the paths that don't exist,
+  // cached by the path, as titles may probe the same files many times.
+  Entry* ResolvePathCached(const std::string_view path);
+  // Must be called whenever entries are created, deleted or renamed.
+  void InvalidatePathCache();
 
   virtual const std::string& name() const = 0;
   virtual uint32_t attributes() const = 0;
@@ -45,6 +51,12 @@ class Device {
  protected:
   xe::global_critical_region global_critical_region_;
   std::string mount_path_;
+
+ private:
+  // Cleared when full rather than evicting individual paths.
+  static constexpr size_t kPathCacheMaxSize = 8192;
+  // Lowercase path -> entry, or null if it doesn't exist.
+  std::unordered_map<std::string, Entry*> path_cache_;
 };
 
 }  // namespace vfs
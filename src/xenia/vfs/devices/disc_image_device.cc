@@ -44,6 +44,7 @@ bool DiscImageDevice::Initialize() {
     XELOGE("Failed to verify disc image header: {}", result);
     return false;
   }
+  game_offset_ = state.game_offset;
 
   result = ReadAllEntries(&state, state.ptr + state.root_offset);
   if (result != Error::kSuccess) {
@@ -123,6 +124,16 @@ DiscImageDevice::Error DiscImageDevice::ReadAllEntries(
   return Error::kSuccess;
 }
 
+void DiscImageDevice::ReadDirectory(DiscImageEntry* entry) {
+  ParseState state = {0};
+  state.ptr = mmap_->data();
+  state.size = mmap_->size();
+  state.game_offset = game_offset_;
+  if (!ReadEntry(&state, state.ptr + entry->directory_offset_, 0, entry)) {
+    XELOGE("Failed to read GDFX directory {}", entry->path());
+  }
+}
+
 bool DiscImageDevice::ReadEntry(ParseState* state, const uint8_t* buffer,
                                 uint16_t entry_ordinal,
                                 DiscImageEntry* parent) {
@@ -159,17 +170,13 @@ bool DiscImageDevice::ReadEntry(ParseState* state, const uint8_t* buffer,
     entry->data_offset_ = 0;
     entry->data_size_ = 0;
     if (length) {
-      // Not a leaf - read in children.
+      // Not a leaf - the children are read when first looked up.
       if (state->size < state->game_offset + (sector * kXESectorSize)) {
         // Out of bounds read.
         return false;
       }
-      // Read child list.
-      uint8_t* folder_ptr =
-          state->ptr + state->game_offset + (sector * kXESectorSize);
-      if (!ReadEntry(state, folder_ptr, 0, entry.get())) {
-        return false;
-      }
+      entry->directory_offset_ = state->game_offset + (sector * kXESectorSize);
+      entry->directory_size_ = length;
     }
   } else {
     // File.
@@ -58,6 +58,7 @@ class DiscImageDevice : public Device {
   std::filesystem::path host_path_;
   std::unique_ptr<Entry> root_entry_;
   std::unique_ptr<MappedMemory> mmap_;
+  size_t game_offset_ = 0;
 
   typedef struct {
     uint8_t* ptr;
@@ -73,6 +74,10 @@ class DiscImageDevice : public Device {
   Error ReadAllEntries(ParseState* state, const uint8_t* root_buffer);
   bool ReadEntry(ParseState* state, const uint8_t* buffer,
                  uint16_t entry_ordinal, DiscImageEntry* parent);
+  // Reads the children of a directory entry, on first lookup.
+  void ReadDirectory(DiscImageEntry* entry);
+
+  friend class DiscImageEntry;
 };
 
 }  // namespace vfs
@@ -12,6 +12,7 @@
 #include <algorithm>
 
 #include "xenia/base/math.h"
+#include "xenia/vfs/devices/disc_image_device.h"
 #include "xenia/vfs/devices/disc_image_file.h"
 
 namespace xe {
@@ -34,6 +35,12 @@ std::unique_ptr<DiscImageEntry> DiscImageEntry::Create(
   return std::move(entry);
 }
 
+void DiscImageEntry::PopulateChildren() {
+  if (directory_size_) {
+    static_cast<DiscImageDevice*>(device_)->ReadDirectory(this);
+  }
+}
+
 X_STATUS DiscImageEntry::Open(uint32_t desired_access, File** out_file) {
   *out_file = new DiscImageFile(desired_access, this);
   return X_STATUS_SUCCESS;
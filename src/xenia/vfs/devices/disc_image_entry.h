@@ -42,12 +42,18 @@ class DiscImageEntry : public Entry {
                                            size_t offset,
                                            size_t length) override;
 
+ protected:
+  void PopulateChildren() override;
+
  private:
   friend class DiscImageDevice;
 
   MappedMemory* mmap_;
   size_t data_offset_;
   size_t data_size_;
+  // Location of the directory table of a non-empty directory.
+  size_t directory_offset_ = 0;
+  size_t directory_size_ = 0;
 };
 
 }  // namespace vfs
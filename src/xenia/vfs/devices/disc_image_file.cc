@@ -12,10 +12,16 @@
 #include <algorithm>
 
 #include "xenia/base/logging.h"
+#include "xenia/base/memory.h"
 #include "xenia/vfs/devices/disc_image_entry.h"
 namespace xe {
 namespace vfs {
 
+// Reads this large are usually streamed straight into textures, vertex
+// buffers or decompression input, and are not going to be touched by the
+// host CPU again soon.
+constexpr size_t kStreamingCopyThreshold = 64 * 1024;
+
 DiscImageFile::DiscImageFile(uint32_t file_access, DiscImageEntry* entry)
     : File(file_access, entry), entry_(entry) {}
 
@@ -37,7 +43,24 @@ X_STATUS DiscImageFile::ReadSync(void* buffer, size_t buffer_length,
   size_t real_offset = entry_->data_offset() + byte_offset;
   size_t real_length =
       std::min(buffer_length, entry_->data_size() - byte_offset);
-  std::memcpy(buffer, entry_->mmap()->data() + real_offset, real_length);
+  uint8_t* source = entry_->mmap()->data() + real_offset;
+  auto dest = static_cast<uint8_t*>(buffer);
+  size_t streamed_length = 0;
+  constexpr uintptr_t kLineMask = XE_HOST_CACHE_LINE_SIZE - 1;
+  if (real_length >= kStreamingCopyThreshold && real_length <= UINT32_MAX &&
+      !((reinterpret_cast<uintptr_t>(dest) |
+         reinterpret_cast<uintptr_t>(source)) &
+        kLineMask)) {
+    // Copy from the mapping with non-temporal stores, not to evict the whole
+    // host cache for data going to guest memory.
+    streamed_length = real_length & ~size_t(kLineMask);
+    xe::memory::vastcpy(dest, source, uint32_t(streamed_length));
+    // Make the stores visible before the caller triggers the invalidation
+    // callbacks for the range.
+    xe::swcache::WriteFence();
+  }
+  std::memcpy(dest + streamed_length, source + streamed_length,
+              real_length - streamed_length);
   *out_bytes_read = real_length;
   return X_STATUS_SUCCESS;
 }
@@ -31,6 +31,8 @@ class DiscImageFile : public File {
     return X_STATUS_ACCESS_DENIED;
   }
   X_STATUS SetLength(size_t length) override { return X_STATUS_ACCESS_DENIED; }
+  // Copies from the mapped image.
+  bool supports_concurrent_reads() const override { return true; }
 
  private:
   DiscImageEntry* entry_;
@@ -9,6 +9,11 @@
 
 #include "xenia/vfs/devices/disc_zarchive_device.h"
 
+#include <algorithm>
+#include <cstring>
+
+#include "third_party/fmt/include/fmt/format.h"
+#include "xenia/base/cvar.h"
 #include "xenia/base/literals.h"
 #include "xenia/base/logging.h"
 #include "xenia/base/math.h"
@@ -16,6 +21,15 @@
 
 #include "third_party/zarchive/include/zarchive/zarchivereader.h"
 
+DEFINE_uint32(zarchive_cache_size_mb, 64,
+              "Size of the cache of decompressed data of ZArchive disc images, "
+              "in MB. 0 to disable the cache and prefetching.",
+              "Storage");
+DEFINE_uint32(zarchive_prefetch_threads, 2,
+              "Number of threads decompressing ZArchive data ahead of "
+              "sequential reads.",
+              "Storage");
+
 namespace xe {
 namespace vfs {
 
@@ -23,7 +37,20 @@ DiscZarchiveDevice::DiscZarchiveDevice(const std::string_view mount_path,
                                        const std::filesystem::path& host_path)
     : Device(mount_path), name_("GDFX"), host_path_(host_path), reader_() {}
 
-DiscZarchiveDevice::~DiscZarchiveDevice() {};
+DiscZarchiveDevice::~DiscZarchiveDevice() {
+  {
+    std::lock_guard<std::mutex> lock(cache_mutex_);
+    prefetch_running_ = false;
+  }
+  prefetch_cond_.notify_all();
+  for (auto& thread : prefetch_threads_) {
+    xe::threading::Wait(thread.get(), false);
+  }
+  if (cache_hits_ || cache_misses_) {
+    XELOGI("ZArchive cache: {} hits, {} misses, {} chunks prefetched",
+           cache_hits_, cache_misses_, chunks_prefetched_);
+  }
+}
 
 bool DiscZarchiveDevice::Initialize() {
   reader_ =
@@ -34,6 +61,29 @@ bool DiscZarchiveDevice::Initialize() {
     return false;
   }
 
+  cache_capacity_ =
+      size_t(cvars::zarchive_cache_size_mb) * 1024 * 1024 / kChunkSize;
+  if (cache_capacity_) {
+    // Each thread needs its own reader to decompress in parallel.
+    prefetch_running_ = true;
+    for (uint32_t i = 0; i < cvars::zarchive_prefetch_threads; ++i) {
+      auto reader = std::unique_ptr<ZArchiveReader>(
+          ZArchiveReader::OpenFromFile(host_path_));
+      if (!reader) {
+        break;
+      }
+      auto reader_ptr = reader.get();
+      auto thread = xe::threading::Thread::Create(
+          {}, [this, reader_ptr]() { PrefetchThreadMain(reader_ptr); });
+      if (!thread) {
+        break;
+      }
+      thread->set_name(fmt::format("ZArchive Prefetch {}", i));
+      prefetch_readers_.push_back(std::move(reader));
+      prefetch_threads_.push_back(std::move(thread));
+    }
+  }
+
   const std::string root_path = std::string("/");
   const ZArchiveNodeHandle handle = reader_->LookUp(root_path);
   auto root_entry = new DiscZarchiveEntry(this, nullptr, root_path);
@@ -61,7 +111,11 @@ Entry* DiscZarchiveDevice::ResolvePath(const std::string_view path) {
     return nullptr;
   }
 
-  const ZArchiveNodeHandle handle = reader_->LookUp(path);
+  ZArchiveNodeHandle handle;
+  {
+    std::lock_guard<std::mutex> lock(reader_mutex_);
+    handle = reader_->LookUp(path);
+  }
   if (handle == ZARCHIVE_INVALID_NODE) {
     return nullptr;
   }
@@ -69,6 +123,122 @@ Entry* DiscZarchiveDevice::ResolvePath(const std::string_view path) {
   return root_entry_->ResolvePath(path);
 }
 
+uint64_t DiscZarchiveDevice::ReadFromFile(uint32_t handle, uint64_t offset,
+                                          uint64_t length, void* buffer,
+                                          bool sequential) {
+  if (!cache_capacity_) {
+    std::lock_guard<std::mutex> lock(reader_mutex_);
+    return reader_->ReadFromFile(handle, offset, length, buffer);
+  }
+  if (!length) {
+    return 0;
+  }
+
+  uint64_t first_index = offset / kChunkSize;
+  uint64_t last_index = (offset + length - 1) / kChunkSize;
+  std::unique_lock<std::mutex> lock(cache_mutex_);
+  // Hand everything after the first chunk to the prefetch threads, so large
+  // reads are decompressed in parallel while this thread works on the first.
+  if (!prefetch_threads_.empty() &&
+      (sequential || last_index > first_index)) {
+    uint64_t prefetch_end =
+        std::min(last_index + 1 + (sequential ? kReadAheadChunks : 0),
+                 first_index + cache_capacity_ / 2);
+    for (uint64_t index = first_index + 1; index < prefetch_end; ++index) {
+      ChunkKey key = {handle, index};
+      if (!chunks_.count(key) && !chunks_loading_.count(key)) {
+        prefetch_queue_.push_back(key);
+      }
+    }
+    // Drop what the threads didn't get to in time, it'd be evicted anyway.
+    while (prefetch_queue_.size() > cache_capacity_ / 2) {
+      prefetch_queue_.pop_front();
+    }
+    prefetch_cond_.notify_all();
+  }
+
+  auto dest = static_cast<uint8_t*>(buffer);
+  uint64_t bytes_read = 0;
+  for (uint64_t index = first_index; index <= last_index; ++index) {
+    ChunkKey key = {handle, index};
+    chunk_loaded_cond_.wait(lock,
+                            [&]() { return !chunks_loading_.count(key); });
+    auto it = chunks_.find(key);
+    if (it != chunks_.end()) {
+      ++cache_hits_;
+      lru_.splice(lru_.begin(), lru_, it->second);
+    } else {
+      ++cache_misses_;
+      chunks_loading_.insert(key);
+      lock.unlock();
+      std::vector<uint8_t> data;
+      {
+        std::lock_guard<std::mutex> reader_lock(reader_mutex_);
+        data = DecompressChunk(reader_.get(), key);
+      }
+      lock.lock();
+      InsertChunkInLock(key, std::move(data));
+    }
+    // Most recently used, either way.
+    const auto& data = lru_.front().data;
+    uint64_t chunk_offset = offset + bytes_read - index * kChunkSize;
+    if (chunk_offset >= data.size()) {
+      // End of the file.
+      break;
+    }
+    uint64_t count =
+        std::min(length - bytes_read, uint64_t(data.size()) - chunk_offset);
+    std::memcpy(dest + bytes_read, data.data() + chunk_offset, size_t(count));
+    bytes_read += count;
+  }
+  return bytes_read;
+}
+
+void DiscZarchiveDevice::PrefetchThreadMain(ZArchiveReader* reader) {
+  std::unique_lock<std::mutex> lock(cache_mutex_);
+  while (true) {
+    prefetch_cond_.wait(lock, [this]() {
+      return !prefetch_running_ || !prefetch_queue_.empty();
+    });
+    if (!prefetch_running_) {
+      break;
+    }
+    ChunkKey key = prefetch_queue_.front();
+    prefetch_queue_.pop_front();
+    if (chunks_.count(key) || chunks_loading_.count(key)) {
+      continue;
+    }
+    chunks_loading_.insert(key);
+    lock.unlock();
+    auto data = DecompressChunk(reader, key);
+    lock.lock();
+    InsertChunkInLock(key, std::move(data));
+    ++chunks_prefetched_;
+  }
+}
+
+std::vector<uint8_t> DiscZarchiveDevice::DecompressChunk(
+    ZArchiveReader* reader, const ChunkKey& key) {
+  std::vector<uint8_t> data(kChunkSize);
+  uint64_t size = reader->ReadFromFile(key.handle, key.index * kChunkSize,
+                                       kChunkSize, data.data());
+  // Reads past the end of the file return nothing rather than failing.
+  data.resize(size_t(std::min(size, kChunkSize)));
+  return data;
+}
+
+void DiscZarchiveDevice::InsertChunkInLock(const ChunkKey& key,
+                                           std::vector<uint8_t> data) {
+  lru_.push_front(Chunk{key, std::move(data)});
+  chunks_[key] = lru_.begin();
+  chunks_loading_.erase(key);
+  while (lru_.size() > cache_capacity_) {
+    chunks_.erase(lru_.back().key);
+    lru_.pop_back();
+  }
+  chunk_loaded_cond_.notify_all();
+}
+
 bool DiscZarchiveDevice::ReadAllEntries(const std::string& path,
                                         DiscZarchiveEntry* node,
                                         DiscZarchiveEntry* parent) {
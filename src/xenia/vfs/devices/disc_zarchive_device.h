@@ -10,10 +10,18 @@
 #ifndef XENIA_VFS_DEVICES_DISC_ZARCHIVE_DEVICE_H_
 #define XENIA_VFS_DEVICES_DISC_ZARCHIVE_DEVICE_H_
 
+#include <condition_variable>
+#include <deque>
+#include <list>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
 #include "xenia/base/mapped_memory.h"
+#include "xenia/base/threading.h"
 #include "xenia/vfs/device.h"
 
 #include "third_party/zarchive/include/zarchive/zarchivereader.h"
@@ -49,10 +57,68 @@ class DiscZarchiveDevice : public Device {
 
   ZArchiveReader* reader() const { return reader_.get(); }
 
+  // Reads through the cache of decompressed chunks. Chunks following a
+  // sequential or large read are decompressed ahead of time on the prefetch
+  // threads, which have their own readers.
+  uint64_t ReadFromFile(uint32_t handle, uint64_t offset, uint64_t length,
+                        void* buffer, bool sequential);
+
  private:
+  // ZArchive compresses 64 KB blocks, though of the whole archive and not
+  // of each file, so chunks usually span two of them.
+  static constexpr uint64_t kChunkSize = 64 * 1024;
+  static constexpr uint64_t kReadAheadChunks = 8;
+
+  struct ChunkKey {
+    uint32_t handle;
+    uint64_t index;
+
+    bool operator==(const ChunkKey& other) const {
+      return handle == other.handle && index == other.index;
+    }
+  };
+  struct ChunkKeyHash {
+    size_t operator()(const ChunkKey& key) const {
+      return std::hash<uint64_t>()(key.index * 0x9E3779B97F4A7C15ull ^
+                                   key.handle);
+    }
+  };
+  struct Chunk {
+    ChunkKey key;
+    std::vector<uint8_t> data;
+  };
+
   bool ReadAllEntries(const std::string& path, DiscZarchiveEntry* node,
                       DiscZarchiveEntry* parent);
 
+  void PrefetchThreadMain(ZArchiveReader* reader);
+  static std::vector<uint8_t> DecompressChunk(ZArchiveReader* reader,
+                                              const ChunkKey& key);
+  void InsertChunkInLock(const ChunkKey& key, std::vector<uint8_t> data);
+
+  size_t cache_capacity_ = 0;  // In chunks.
+  std::mutex cache_mutex_;
+  // Front is the most recently used.
+  std::list<Chunk> lru_;
+  std::unordered_map<ChunkKey, std::list<Chunk>::iterator, ChunkKeyHash>
+      chunks_;
+  // Being decompressed outside the lock.
+  std::unordered_set<ChunkKey, ChunkKeyHash> chunks_loading_;
+  std::condition_variable chunk_loaded_cond_;
+  uint64_t cache_hits_ = 0;
+  uint64_t cache_misses_ = 0;
+  uint64_t chunks_prefetched_ = 0;
+
+  // Guarded by cache_mutex_.
+  bool prefetch_running_ = false;
+  std::deque<ChunkKey> prefetch_queue_;
+  std::condition_variable prefetch_cond_;
+  std::vector<std::unique_ptr<ZArchiveReader>> prefetch_readers_;
+  std::vector<std::unique_ptr<xe::threading::Thread>> prefetch_threads_;
+
+  // Guards reader_ for reads, as demand reads may come from any thread.
+  std::mutex reader_mutex_;
+
   std::string name_;
   std::filesystem::path host_path_;
   std::unique_ptr<Entry> root_entry_;
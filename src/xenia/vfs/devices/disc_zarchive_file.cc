@@ -31,12 +31,15 @@ X_STATUS DiscZarchiveFile::ReadSync(void* buffer, size_t buffer_length,
   if (byte_offset >= entry_->size()) {
     return X_STATUS_END_OF_FILE;
   }
+  // Continuing where the last read ended, probably streaming the file.
+  bool sequential = byte_offset && byte_offset == next_sequential_offset_;
   const uint64_t bytes_read =
       ((DiscZarchiveDevice*)entry_->device_)
-          ->reader()
-          ->ReadFromFile(entry_->handle_, byte_offset, buffer_length, buffer);
+          ->ReadFromFile(entry_->handle_, byte_offset, buffer_length, buffer,
+                         sequential);
   const size_t real_length =
       std::min(buffer_length, entry_->data_size() - byte_offset);
+  next_sequential_offset_ = byte_offset + real_length;
   *out_bytes_read = real_length;
   return X_STATUS_SUCCESS;
 }
@@ -10,6 +10,8 @@
 #ifndef XENIA_VFS_DEVICES_DISC_ZARCHIVE_FILE_H_
 #define XENIA_VFS_DEVICES_DISC_ZARCHIVE_FILE_H_
 
+#include <atomic>
+
 #include "xenia/vfs/file.h"
 
 namespace xe {
@@ -31,9 +33,13 @@ class DiscZarchiveFile : public File {
     return X_STATUS_ACCESS_DENIED;
   }
   X_STATUS SetLength(size_t length) override { return X_STATUS_ACCESS_DENIED; }
+  // The device serializes access to its reader.
+  bool supports_concurrent_reads() const override { return true; }
 
  private:
   DiscZarchiveEntry* entry_;
+  // For detecting sequential reads.
+  std::atomic<size_t> next_sequential_offset_ = 0;
 };
 
 }  // namespace vfs
@@ -96,6 +96,16 @@ std::unique_ptr<Entry> HostPathEntry::CreateEntryInternal(
       HostPathEntry::Create(device_, this, full_path, file_info.value()));
 }
 
+void HostPathEntry::PopulateChildren() {
+  if (!(attributes_ & kFileAttributeDirectory)) {
+    return;
+  }
+  for (auto& child_info : xe::filesystem::ListFiles(host_path_)) {
+    children_.push_back(std::unique_ptr<Entry>(HostPathEntry::Create(
+        device_, this, host_path_ / child_info.name, child_info)));
+  }
+}
+
 bool HostPathEntry::DeleteEntryInternal(Entry* entry) {
   auto full_path = host_path_ / xe::to_path(entry->name());
   std::error_code ec;  // avoid exception on remove/remove_all failure
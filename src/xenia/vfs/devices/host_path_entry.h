@@ -52,6 +52,7 @@ class HostPathEntry : public Entry {
                                              uint32_t attributes) override;
   bool DeleteEntryInternal(Entry* entry) override;
   void RenameEntryInternal(const std::filesystem::path file_path) override;
+  void PopulateChildren() override;
 
   std::filesystem::path host_path_;
 };
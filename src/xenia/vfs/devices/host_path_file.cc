@@ -9,11 +9,85 @@
 
 #include "xenia/vfs/devices/host_path_file.h"
 
+#include <chrono>
+#include <unordered_set>
+
+#include "xenia/base/clock.h"
+#include "xenia/base/cvar.h"
+#include "xenia/base/logging.h"
+#include "xenia/base/threading.h"
 #include "xenia/vfs/devices/host_path_entry.h"
 
+DEFINE_uint32(host_file_write_buffer_kb, 256,
+              "Size of the buffer coalescing sequential guest writes to each "
+              "host file, in KB. 0 to write to the host file on every guest "
+              "write.",
+              "Storage");
+
 namespace xe {
 namespace vfs {
 
+// Writes the data left in the write buffers of the files on a background
+// thread, so it's not lost if the emulator exits abnormally while the files
+// are open.
+class HostPathFileFlusher {
+ public:
+  static HostPathFileFlusher& Get() {
+    // Never destroyed, as the thread runs until the process exits.
+    static HostPathFileFlusher* const flusher = new HostPathFileFlusher;
+    return *flusher;
+  }
+
+  void Add(HostPathFile* file) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    files_.insert(file);
+    if (!thread_) {
+      thread_ = xe::threading::Thread::Create({}, [this]() { FlushThread(); });
+      if (thread_) {
+        thread_->set_name("Host File Flush");
+      }
+    }
+  }
+
+  // After this returns, the file is not accessed by the thread anymore.
+  void Remove(HostPathFile* file) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    files_.erase(file);
+  }
+
+ private:
+  static constexpr std::chrono::milliseconds kFlushDelay{500};
+
+  void FlushThread() {
+    uint64_t delay_ticks =
+        xe::Clock::QueryHostTickFrequency() * kFlushDelay.count() / 1000;
+    while (true) {
+      xe::threading::Sleep(kFlushDelay);
+      uint64_t now = xe::Clock::QueryHostTickCount();
+      // Files are removed with mutex_ held before being destroyed, so they
+      // stay alive while they're being flushed.
+      std::lock_guard<std::mutex> lock(mutex_);
+      for (auto it = files_.begin(); it != files_.end();) {
+        HostPathFile* file = *it;
+        std::lock_guard<std::mutex> file_lock(file->write_buffer_mutex_);
+        if (!file->write_buffer_.empty() &&
+            now - file->write_buffer_start_time_ >= delay_ticks) {
+          file->FlushWriteBuffer();
+        }
+        if (file->write_buffer_.empty()) {
+          it = files_.erase(it);
+        } else {
+          ++it;
+        }
+      }
+    }
+  }
+
+  std::mutex mutex_;
+  std::unordered_set<HostPathFile*> files_;
+  std::unique_ptr<xe::threading::Thread> thread_;
+};
+
 HostPathFile::HostPathFile(
     uint32_t file_access, HostPathEntry* entry,
     std::unique_ptr<xe::filesystem::FileHandle> file_handle)
@@ -22,6 +96,15 @@ HostPathFile::HostPathFile(
 HostPathFile::~HostPathFile() = default;
 
 void HostPathFile::Destroy() {
+  HostPathFileFlusher::Get().Remove(this);
+  {
+    std::lock_guard<std::mutex> lock(write_buffer_mutex_);
+    if (entry_ && entry_->delete_on_close()) {
+      write_buffer_.clear();
+    } else {
+      FlushWriteBuffer();
+    }
+  }
   if (entry_ && entry_->delete_on_close()) {
     entry()->Delete();
   }
@@ -35,6 +118,16 @@ X_STATUS HostPathFile::ReadSync(void* buffer, size_t buffer_length,
     return X_STATUS_ACCESS_DENIED;
   }
 
+  {
+    std::lock_guard<std::mutex> lock(write_buffer_mutex_);
+    if (!write_buffer_.empty() &&
+        byte_offset < write_buffer_offset_ + write_buffer_.size() &&
+        byte_offset + buffer_length > write_buffer_offset_) {
+      // Reading what has been written via this file.
+      FlushWriteBuffer();
+    }
+  }
+
   if (file_handle_->Read(byte_offset, buffer, buffer_length, out_bytes_read)) {
     return X_STATUS_SUCCESS;
   } else {
@@ -50,12 +143,43 @@ X_STATUS HostPathFile::WriteSync(const void* buffer, size_t buffer_length,
     return X_STATUS_ACCESS_DENIED;
   }
 
-  if (file_handle_->Write(byte_offset, buffer, buffer_length,
-                          out_bytes_written)) {
-    return X_STATUS_SUCCESS;
-  } else {
-    return X_STATUS_END_OF_FILE;
+  size_t buffer_capacity = size_t(cvars::host_file_write_buffer_kb) << 10;
+  bool buffer_started;
+  {
+    std::lock_guard<std::mutex> lock(write_buffer_mutex_);
+    if (!write_buffer_.empty() &&
+        (byte_offset != write_buffer_offset_ + write_buffer_.size() ||
+         write_buffer_.size() + buffer_length > buffer_capacity) &&
+        !FlushWriteBuffer()) {
+      return X_STATUS_END_OF_FILE;
+    }
+    if (buffer_length >= buffer_capacity) {
+      // Large enough to be written directly.
+      if (file_handle_->Write(byte_offset, buffer, buffer_length,
+                              out_bytes_written)) {
+        return X_STATUS_SUCCESS;
+      } else {
+        return X_STATUS_END_OF_FILE;
+      }
+    }
+    buffer_started = write_buffer_.empty();
+    if (buffer_started) {
+      write_buffer_offset_ = byte_offset;
+      write_buffer_start_time_ = xe::Clock::QueryHostTickCount();
+    }
+    const uint8_t* buffer_bytes = static_cast<const uint8_t*>(buffer);
+    write_buffer_.insert(write_buffer_.end(), buffer_bytes,
+                         buffer_bytes + buffer_length);
+  }
+  // Not with write_buffer_mutex_ held, as the flusher locks the files while
+  // holding its own mutex.
+  if (buffer_started) {
+    HostPathFileFlusher::Get().Add(this);
+  }
+  if (out_bytes_written) {
+    *out_bytes_written = buffer_length;
   }
+  return X_STATUS_SUCCESS;
 }
 
 X_STATUS HostPathFile::SetLength(size_t length) {
@@ -64,6 +188,8 @@ X_STATUS HostPathFile::SetLength(size_t length) {
     return X_STATUS_ACCESS_DENIED;
   }
 
+  std::lock_guard<std::mutex> lock(write_buffer_mutex_);
+  FlushWriteBuffer();
   if (file_handle_->SetLength(length)) {
     return X_STATUS_SUCCESS;
   } else {
@@ -71,5 +197,26 @@ X_STATUS HostPathFile::SetLength(size_t length) {
   }
 }
 
+X_STATUS HostPathFile::Flush() {
+  std::lock_guard<std::mutex> lock(write_buffer_mutex_);
+  return FlushWriteBuffer() ? X_STATUS_SUCCESS : X_STATUS_UNSUCCESSFUL;
+}
+
+bool HostPathFile::FlushWriteBuffer() {
+  if (write_buffer_.empty()) {
+    return true;
+  }
+  size_t bytes_written;
+  bool written = file_handle_->Write(write_buffer_offset_, write_buffer_.data(),
+                                     write_buffer_.size(), &bytes_written);
+  if (!written) {
+    XELOGE("Failed to write {} buffered bytes at {} to {}",
+           write_buffer_.size(), write_buffer_offset_,
+           xe::path_to_utf8(file_handle_->path()));
+  }
+  write_buffer_.clear();
+  return written;
+}
+
 }  // namespace vfs
 }  // namespace xe
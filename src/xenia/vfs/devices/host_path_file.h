@@ -10,7 +10,9 @@
 #ifndef XENIA_VFS_DEVICES_HOST_PATH_FILE_H_
 #define XENIA_VFS_DEVICES_HOST_PATH_FILE_H_
 
+#include <mutex>
 #include <string>
+#include <vector>
 
 #include "xenia/base/filesystem.h"
 #include "xenia/vfs/file.h"
@@ -20,6 +22,11 @@ namespace vfs {
 
 class HostPathEntry;
 
+// Sequential guest writes are coalesced in a per-file buffer of
+// host_file_write_buffer_kb, written to the host file when the buffer is full,
+// when a write doesn't continue the buffered data, before reads overlapping it,
+// and when the file is flushed or closed. Data left in the buffer is also
+// written on a background thread after a while.
 class HostPathFile : public File {
  public:
   HostPathFile(uint32_t file_access, HostPathEntry* entry,
@@ -33,9 +40,23 @@ class HostPathFile : public File {
   X_STATUS WriteSync(const void* buffer, size_t buffer_length,
                      size_t byte_offset, size_t* out_bytes_written) override;
   X_STATUS SetLength(size_t length) override;
+  X_STATUS Flush() override;
+  // Host reads are positional.
+  bool supports_concurrent_reads() const override { return true; }
 
  private:
+  friend class HostPathFileFlusher;
+
+  // Must be called with write_buffer_mutex_ held.
+  bool FlushWriteBuffer();
+
   std::unique_ptr<xe::filesystem::FileHandle> file_handle_;
+
+  std::mutex write_buffer_mutex_;
+  std::vector<uint8_t> write_buffer_;
+  size_t write_buffer_offset_ = 0;
+  // Host tick count of the first buffered write.
+  uint64_t write_buffer_start_time_ = 0;
 };
 
 }  // namespace vfs
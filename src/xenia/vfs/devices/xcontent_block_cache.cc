@@ -0,0 +1,131 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2023 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include "xenia/vfs/devices/xcontent_block_cache.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "xenia/base/cvar.h"
+#include "xenia/base/filesystem.h"
+
+DEFINE_uint32(xcontent_block_cache_size_mb, 32,
+              "Size of the cache of reads from STFS and SVOD packages (DLC, "
+              "title updates, installed games) shared by all of them, in MB. "
+              "0 to disable.",
+              "Storage");
+
+namespace xe {
+namespace vfs {
+
+XContentBlockCache& XContentBlockCache::Get() {
+  static XContentBlockCache cache;
+  return cache;
+}
+
+size_t XContentBlockCache::GetCapacity() {
+  return size_t(cvars::xcontent_block_cache_size_mb) * 1024 * 1024 / kLineSize;
+}
+
+size_t XContentBlockCache::Read(const void* owner, FILE* file, size_t offset,
+                                void* buffer, size_t length, bool read_ahead) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto& stats = stats_[owner];
+  size_t capacity = GetCapacity();
+  // Large reads would only push everything else out.
+  if (!capacity || length >= kReadAheadLines * kLineSize) {
+    xe::filesystem::Seek(file, int64_t(offset), SEEK_SET);
+    return fread(buffer, 1, length, file);
+  }
+
+  auto dest = static_cast<uint8_t*>(buffer);
+  size_t bytes_read = 0;
+  while (bytes_read < length) {
+    size_t position = offset + bytes_read;
+    LineKey key = {file, position / kLineSize};
+    const Line* line;
+    auto it = lines_.find(key);
+    if (it != lines_.end()) {
+      ++stats.hits;
+      lru_.splice(lru_.begin(), lru_, it->second);
+      line = &*it->second;
+    } else {
+      ++stats.misses;
+      line = LoadLinesInLock(owner, key, read_ahead ? kReadAheadLines : 1,
+                             stats);
+      // The line just loaded is the most recently used, so it stays.
+      EvictInLock(capacity);
+    }
+    size_t line_offset = position - size_t(key.index) * kLineSize;
+    if (line_offset >= line->data.size()) {
+      // End of the file.
+      break;
+    }
+    size_t count =
+        std::min(length - bytes_read, line->data.size() - line_offset);
+    std::memcpy(dest + bytes_read, line->data.data() + line_offset, count);
+    bytes_read += count;
+  }
+  return bytes_read;
+}
+
+XContentBlockCache::Stats XContentBlockCache::Invalidate(const void* owner) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (auto it = lru_.begin(); it != lru_.end();) {
+    if (it->owner == owner) {
+      lines_.erase(it->key);
+      it = lru_.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  Stats stats;
+  auto stats_it = stats_.find(owner);
+  if (stats_it != stats_.end()) {
+    stats = stats_it->second;
+    stats_.erase(stats_it);
+  }
+  return stats;
+}
+
+const XContentBlockCache::Line* XContentBlockCache::LoadLinesInLock(
+    const void* owner, const LineKey& key, size_t count, Stats& stats) {
+  read_buffer_.resize(count * kLineSize);
+  xe::filesystem::Seek(key.file, int64_t(key.index * kLineSize), SEEK_SET);
+  size_t size = fread(read_buffer_.data(), 1, read_buffer_.size(), key.file);
+  // Last to first, so that the line asked for is the most recently used.
+  for (size_t i = count; i-- > 0;) {
+    LineKey line_key = {key.file, key.index + i};
+    size_t line_begin = i * kLineSize;
+    if (i && (line_begin >= size || lines_.count(line_key))) {
+      continue;
+    }
+    size_t line_size =
+        size > line_begin ? std::min(kLineSize, size - line_begin) : 0;
+    auto data_begin = read_buffer_.cbegin() + line_begin;
+    lru_.push_front(
+        Line{owner, line_key,
+             std::vector<uint8_t>(data_begin, data_begin + line_size)});
+    lines_[line_key] = lru_.begin();
+    if (i) {
+      ++stats.read_ahead_lines;
+    }
+  }
+  return &lru_.front();
+}
+
+void XContentBlockCache::EvictInLock(size_t capacity) {
+  while (lru_.size() > capacity) {
+    lines_.erase(lru_.back().key);
+    lru_.pop_back();
+  }
+}
+
+}  // namespace vfs
+}  // namespace xe
@@ -0,0 +1,94 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2023 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#ifndef XENIA_VFS_DEVICES_XCONTENT_BLOCK_CACHE_H_
+#define XENIA_VFS_DEVICES_XCONTENT_BLOCK_CACHE_H_
+
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace xe {
+namespace vfs {
+
+// Caches host reads of XContent container files in lines of several blocks,
+// shared by all mounted containers and evicted least recently used first.
+// STFS and SVOD files map to many small blocks scattered over the package, so
+// without it every guest read turns into a seek and a short read per block.
+//
+// All reads of container files go through here, which also serializes them,
+// as the files of a container share their FILE handles.
+class XContentBlockCache {
+ public:
+  struct Stats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t read_ahead_lines = 0;
+  };
+
+  static XContentBlockCache& Get();
+
+  // Reads from the host file of the owning device at the offset, returning
+  // the number of bytes read. With read_ahead, misses also load the lines
+  // following the one needed.
+  size_t Read(const void* owner, FILE* file, size_t offset, void* buffer,
+              size_t length, bool read_ahead);
+
+  // Drops the lines of the owner, before its files are closed, and returns
+  // its statistics.
+  Stats Invalidate(const void* owner);
+
+ private:
+  static constexpr size_t kLineSize = 64 * 1024;
+  static constexpr size_t kReadAheadLines = 4;
+
+  struct LineKey {
+    FILE* file;
+    uint64_t index;
+
+    bool operator==(const LineKey& other) const {
+      return file == other.file && index == other.index;
+    }
+  };
+  struct LineKeyHash {
+    size_t operator()(const LineKey& key) const {
+      return std::hash<FILE*>()(key.file) ^
+             size_t(key.index * 0x9E3779B97F4A7C15ull);
+    }
+  };
+  struct Line {
+    const void* owner;
+    LineKey key;
+    // Shorter than kLineSize at the end of the file.
+    std::vector<uint8_t> data;
+  };
+
+  // In lines.
+  static size_t GetCapacity();
+  // Reads count lines starting at the key, returns the first one.
+  const Line* LoadLinesInLock(const void* owner, const LineKey& key,
+                              size_t count, Stats& stats);
+  void EvictInLock(size_t capacity);
+
+  std::mutex mutex_;
+  // Front is the most recently used.
+  std::list<Line> lru_;
+  std::unordered_map<LineKey, std::list<Line>::iterator, LineKeyHash> lines_;
+  std::unordered_map<const void*, Stats> stats_;
+  std::vector<uint8_t> read_buffer_;
+};
+
+}  // namespace vfs
+}  // namespace xe
+
+#endif  // XENIA_VFS_DEVICES_XCONTENT_BLOCK_CACHE_H_
@@ -9,6 +9,7 @@
 
 #include "xenia/vfs/devices/xcontent_container_device.h"
 #include "xenia/base/logging.h"
+#include "xenia/vfs/devices/xcontent_block_cache.h"
 #include "xenia/vfs/devices/xcontent_devices/stfs_container_device.h"
 #include "xenia/vfs/devices/xcontent_devices/svod_container_device.h"
 
@@ -132,6 +133,12 @@ void XContentContainerDevice::Dump(StringBuffer* string_buffer) {
 }
 
 void XContentContainerDevice::CloseFiles() {
+  auto stats = XContentBlockCache::Get().Invalidate(this);
+  if (stats.hits || stats.misses) {
+    XELOGI("{}: block cache {} hits, {} misses, {} lines read ahead",
+           xe::path_to_utf8(host_path_.filename()), stats.hits, stats.misses,
+           stats.read_ahead_lines);
+  }
   for (auto& file : files_) {
     fclose(file.second);
   }
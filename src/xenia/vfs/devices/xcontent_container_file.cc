@@ -11,6 +11,7 @@
 #include <cmath>
 
 #include "xenia/base/math.h"
+#include "xenia/vfs/devices/xcontent_block_cache.h"
 #include "xenia/vfs/devices/xcontent_container_entry.h"
 #include "xenia/vfs/devices/xcontent_container_file.h"
 
@@ -37,6 +38,10 @@ X_STATUS XContentContainerFile::ReadSync(void* buffer, size_t buffer_length,
   size_t remaining_length =
       std::min(buffer_length, entry_->size() - byte_offset);
 
+  // Continuing where the last read ended, probably streaming the file.
+  bool read_ahead = byte_offset && byte_offset == next_sequential_offset_;
+  auto& block_cache = XContentBlockCache::Get();
+
   *out_bytes_read = 0;
   for (size_t i = 0; i < entry_->block_list().size(); i++) {
     auto& record = entry_->block_list()[i];
@@ -52,8 +57,9 @@ X_STATUS XContentContainerFile::ReadSync(void* buffer, size_t buffer_length,
         std::min(record.length - read_offset, remaining_length);
 
     auto& file = entry_->files()->at(record.file);
-    xe::filesystem::Seek(file, record.offset + read_offset, SEEK_SET);
-    auto num_read = fread(p, 1, read_length, file);
+    auto num_read =
+        block_cache.Read(entry_->device(), file, record.offset + read_offset,
+                         p, read_length, read_ahead);
 
     *out_bytes_read += num_read;
     p += num_read;
@@ -63,6 +69,7 @@ X_STATUS XContentContainerFile::ReadSync(void* buffer, size_t buffer_length,
       break;
     }
   }
+  next_sequential_offset_ = byte_offset + *out_bytes_read;
 
   return X_STATUS_SUCCESS;
 }
@@ -10,6 +10,8 @@
 #ifndef XENIA_VFS_DEVICES_XCONTENT_CONTAINER_FILE_H_
 #define XENIA_VFS_DEVICES_XCONTENT_CONTAINER_FILE_H_
 
+#include <atomic>
+
 #include "xenia/vfs/file.h"
 
 #include "xenia/xbox.h"
@@ -33,9 +35,13 @@ class XContentContainerFile : public File {
     return X_STATUS_ACCESS_DENIED;
   }
   X_STATUS SetLength(size_t length) override { return X_STATUS_ACCESS_DENIED; }
+  // Host reads are serialized by XContentBlockCache.
+  bool supports_concurrent_reads() const override { return true; }
 
  private:
   XContentContainerEntry* entry_;
+  // For detecting sequential reads.
+  std::atomic<size_t> next_sequential_offset_ = 0;
 };
 
 }  // namespace vfs
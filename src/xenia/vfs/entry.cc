@@ -40,14 +40,22 @@ void Entry::Dump(xe::StringBuffer* string_buffer, int indent) {
   }
   string_buffer->Append(name());
   string_buffer->Append('\n');
-  for (auto& child : children_) {
+  for (auto& child : children()) {
     child->Dump(string_buffer, indent + 2);
   }
 }
 
 bool Entry::is_read_only() const { return device_->is_read_only(); }
 
+void Entry::EnsureChildrenPopulated() const {
+  // Not in the global critical region, as this may do host I/O. Populating
+  // is not a visible change, so this is const.
+  std::call_once(children_populated_,
+                 [this]() { const_cast<Entry*>(this)->PopulateChildren(); });
+}
+
 Entry* Entry::GetChild(const std::string_view name) {
+  EnsureChildrenPopulated();
   auto global_lock = global_critical_region_.Acquire();
   auto it = std::find_if(children_.cbegin(), children_.cend(),
                          [&](const auto& child) {
@@ -74,6 +82,7 @@ Entry* Entry::ResolvePath(const std::string_view path) {
 
 Entry* Entry::IterateChildren(const xe::filesystem::WildcardEngine& engine,
                               size_t* current_index) {
+  EnsureChildrenPopulated();
   auto global_lock = global_critical_region_.Acquire();
   while (*current_index < children_.size()) {
     auto& child = children_[*current_index];
@@ -99,6 +108,7 @@ Entry* Entry::CreateEntry(const std::string_view name, uint32_t attributes) {
     return nullptr;
   }
   children_.push_back(std::move(entry));
+  device_->InvalidatePathCache();
   // TODO(benvanik): resort? would break iteration?
   Touch();
   return children_.back().get();
@@ -121,6 +131,7 @@ bool Entry::Delete(Entry* entry) {
       break;
     }
   }
+  device_->InvalidatePathCache();
   Touch();
   return true;
 }
@@ -144,6 +155,7 @@ void Entry::Rename(const std::filesystem::path file_path) {
       xe::utf8::join_guest_paths(splitted_path);
 
   RenameEntryInternal(guest_path_without_root);
+  device_->InvalidatePathCache();
 
   absolute_path_ = xe::utf8::join_guest_paths(device_->mount_path(),
                                               guest_path_without_root);
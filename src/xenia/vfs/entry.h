@@ -11,6 +11,7 @@
 #define XENIA_VFS_ENTRY_H_
 
 #include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
@@ -109,9 +110,13 @@ class Entry {
   Entry* ResolvePath(const std::string_view path);
 
   const std::vector<std::unique_ptr<Entry>>& children() const {
+    EnsureChildrenPopulated();
     return children_;
   }
-  size_t child_count() const { return children_.size(); }
+  size_t child_count() const {
+    EnsureChildrenPopulated();
+    return children_.size();
+  }
   Entry* IterateChildren(const xe::filesystem::WildcardEngine& engine,
                          size_t* current_index);
 
@@ -142,6 +147,10 @@ class Entry {
   }
   virtual bool DeleteEntryInternal(Entry* entry) { return false; }
   virtual void RenameEntryInternal(const std::filesystem::path file_path) {}
+  // Called once before the children are first needed, for devices reading
+  // directories on demand rather than the whole tree when mounting, as there
+  // may be tens of thousands of entries.
+  virtual void PopulateChildren() {}
 
   xe::global_critical_region global_critical_region_;
   Device* device_;
@@ -157,6 +166,11 @@ class Entry {
   uint64_t write_timestamp_;
   bool delete_on_close_;
   std::vector<std::unique_ptr<Entry>> children_;
+
+ private:
+  void EnsureChildrenPopulated() const;
+
+  mutable std::once_flag children_populated_;
 };
 
 }  // namespace vfs
@@ -32,6 +32,10 @@ class File {
   virtual X_STATUS WriteSync(const void* buffer, size_t buffer_length,
                              size_t byte_offset, size_t* out_bytes_written) = 0;
 
+  // Whether ReadSync may be called from several threads at once, including
+  // concurrently with other files of the same device.
+  virtual bool supports_concurrent_reads() const { return false; }
+
   // TODO: Parameters
   virtual X_STATUS ReadAsync(void* buffer, size_t buffer_length,
                              size_t byte_offset, size_t* out_bytes_read) {
@@ -45,6 +49,8 @@ class File {
   }
 
   virtual X_STATUS SetLength(size_t length) { return X_STATUS_NOT_IMPLEMENTED; }
+  // Writes the data buffered by WriteSync, if any, to the underlying storage.
+  virtual X_STATUS Flush() { return X_STATUS_SUCCESS; }
   virtual X_STATUS Rename(const std::filesystem::path file_path) {
     return X_STATUS_NOT_IMPLEMENTED;
   }
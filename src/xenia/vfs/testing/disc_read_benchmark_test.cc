@@ -0,0 +1,117 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2023 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "xenia/base/filesystem.h"
+#include "xenia/vfs/devices/disc_image_device.h"
+#include "xenia/vfs/devices/disc_zarchive_device.h"
+#include "xenia/vfs/entry.h"
+#include "xenia/vfs/file.h"
+
+#include "third_party/catch/include/catch.hpp"
+
+namespace xe::vfs::test {
+
+namespace {
+
+constexpr size_t kSequentialReadSize = 64 * 1024;
+constexpr size_t kRandomReadSize = 16 * 1024;
+constexpr size_t kMaxBytesPerTest = 256 * 1024 * 1024;
+
+Entry* FindLargestFile(Entry* entry) {
+  Entry* largest = nullptr;
+  for (auto& child : entry->children()) {
+    Entry* candidate = child->attributes() & kFileAttributeDirectory
+                           ? FindLargestFile(child.get())
+                           : child.get();
+    if (candidate && (!largest || candidate->size() > largest->size())) {
+      largest = candidate;
+    }
+  }
+  return largest;
+}
+
+// Returns MB/s.
+double MeasureReads(File* file, bool sequential) {
+  size_t file_size = file->entry()->size();
+  size_t read_size = sequential ? kSequentialReadSize : kRandomReadSize;
+  size_t total_size = std::min(file_size, kMaxBytesPerTest);
+  std::vector<uint8_t> buffer(read_size);
+  std::mt19937_64 random(0x5A4152);
+  std::uniform_int_distribution<size_t> random_offset(
+      0, file_size > read_size ? file_size - read_size : 0);
+
+  auto start = std::chrono::steady_clock::now();
+  size_t bytes_total = 0;
+  for (size_t offset = 0; offset < total_size; offset += read_size) {
+    size_t bytes_read = 0;
+    file->ReadSync(buffer.data(), read_size,
+                   sequential ? offset : random_offset(random), &bytes_read);
+    bytes_total += bytes_read;
+  }
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return double(bytes_total) / (1024.0 * 1024.0) / elapsed.count();
+}
+
+}  // namespace
+
+// Compares the read throughput of the same game as a GDFX image and as a
+// ZArchive, using the largest file on the disc. Not run by default:
+//   XENIA_BENCHMARK_ISO=game.iso XENIA_BENCHMARK_ZAR=game.zar
+//   xenia-vfs-tests "[benchmark]"
+TEST_CASE("Disc image read throughput", "[.][benchmark]") {
+  const char* iso_path = std::getenv("XENIA_BENCHMARK_ISO");
+  const char* zar_path = std::getenv("XENIA_BENCHMARK_ZAR");
+  if (!iso_path || !zar_path) {
+    WARN("XENIA_BENCHMARK_ISO and XENIA_BENCHMARK_ZAR must be set");
+    return;
+  }
+
+  DiscImageDevice iso_device("\\ISO", xe::to_path(iso_path));
+  REQUIRE(iso_device.Initialize());
+  DiscZarchiveDevice zar_device("\\ZAR", xe::to_path(zar_path));
+  REQUIRE(zar_device.Initialize());
+
+  Entry* iso_entry = FindLargestFile(iso_device.ResolvePath(""));
+  REQUIRE(iso_entry);
+  Entry* zar_entry = zar_device.ResolvePath(iso_entry->path());
+  REQUIRE(zar_entry);
+  REQUIRE(zar_entry->size() == iso_entry->size());
+
+  File* iso_file = nullptr;
+  REQUIRE(iso_entry->Open(xe::filesystem::FileAccess::kFileReadData,
+                          &iso_file) == X_STATUS_SUCCESS);
+  File* zar_file = nullptr;
+  REQUIRE(zar_entry->Open(xe::filesystem::FileAccess::kFileReadData,
+                          &zar_file) == X_STATUS_SUCCESS);
+
+  // ZArchive first, so the image isn't just benefiting from a warm host file
+  // cache the other way around.
+  double zar_sequential = MeasureReads(zar_file, true);
+  double zar_random = MeasureReads(zar_file, false);
+  double iso_sequential = MeasureReads(iso_file, true);
+  double iso_random = MeasureReads(iso_file, false);
+  WARN(iso_entry->path() << " (" << iso_entry->size() / (1024 * 1024)
+                         << " MB)\n"
+                         << "  sequential: image " << iso_sequential
+                         << " MB/s, zarchive " << zar_sequential << " MB/s\n"
+                         << "  random:     image " << iso_random
+                         << " MB/s, zarchive " << zar_random << " MB/s");
+
+  zar_file->Destroy();
+  iso_file->Destroy();
+}
+
+}  // namespace xe::vfs::test
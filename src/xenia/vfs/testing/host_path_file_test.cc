@@ -0,0 +1,80 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2026 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+#include "xenia/vfs/devices/host_path_device.h"
+
+#include "third_party/catch/include/catch.hpp"
+
+namespace xe::vfs::test {
+
+namespace {
+
+std::vector<uint8_t> ReadHostFile(const std::filesystem::path& path) {
+  std::ifstream file(path, std::ios::binary);
+  return std::vector<uint8_t>(std::istreambuf_iterator<char>(file),
+                              std::istreambuf_iterator<char>());
+}
+
+}  // namespace
+
+TEST_CASE("Host file writes are buffered", "[host_path_file]") {
+  const std::filesystem::path root =
+      std::filesystem::temp_directory_path() / "xenia_host_path_file_test";
+  std::filesystem::remove_all(root);
+  std::filesystem::create_directories(root);
+  std::ofstream(root / "save.bin").close();
+
+  HostPathDevice device("\\Device\\Test", root, false);
+  REQUIRE(device.Initialize());
+  Entry* entry = device.ResolvePath("save.bin");
+  REQUIRE(entry);
+  File* file = nullptr;
+  REQUIRE(entry->Open(FileAccess::kFileReadData | FileAccess::kFileWriteData,
+                      &file) == X_STATUS_SUCCESS);
+
+  std::vector<uint8_t> expected;
+  for (uint8_t i = 0; i < 64; ++i) {
+    size_t bytes_written = 0;
+    REQUIRE(file->WriteSync(&i, 1, i, &bytes_written) == X_STATUS_SUCCESS);
+    REQUIRE(bytes_written == 1);
+    expected.push_back(i);
+  }
+
+  // Reads through the same file see the buffered writes.
+  uint8_t read_back[64] = {};
+  size_t bytes_read = 0;
+  REQUIRE(file->ReadSync(read_back, sizeof(read_back), 0, &bytes_read) ==
+          X_STATUS_SUCCESS);
+  REQUIRE(bytes_read == sizeof(read_back));
+  REQUIRE(std::vector<uint8_t>(read_back, read_back + 64) == expected);
+
+  // Non-sequential and flushed explicitly.
+  uint8_t value = 0xFF;
+  size_t bytes_written = 0;
+  REQUIRE(file->WriteSync(&value, 1, 8, &bytes_written) == X_STATUS_SUCCESS);
+  expected[8] = value;
+  REQUIRE(file->Flush() == X_STATUS_SUCCESS);
+  REQUIRE(ReadHostFile(root / "save.bin") == expected);
+
+  // Written on close.
+  REQUIRE(file->WriteSync(&value, 1, 64, &bytes_written) == X_STATUS_SUCCESS);
+  expected.push_back(value);
+  file->Destroy();
+  REQUIRE(ReadHostFile(root / "save.bin") == expected);
+
+  std::filesystem::remove_all(root);
+}
+
+}  // namespace xe::vfs::test
@@ -0,0 +1,48 @@
+/**
+ ******************************************************************************
+ * Xenia : Xbox 360 Emulator Research Project                                 *
+ ******************************************************************************
+ * Copyright 2026 Ben Vanik. All rights reserved.                             *
+ * Released under the BSD license - see LICENSE in the root for more details. *
+ ******************************************************************************
+ */
+
+#include <filesystem>
+#include <fstream>
+
+#include "xenia/vfs/devices/host_path_device.h"
+
+#include "third_party/catch/include/catch.hpp"
+
+namespace xe::vfs::test {
+
+TEST_CASE("Device path cache is invalidated on changes", "[path_cache]") {
+  const std::filesystem::path root =
+      std::filesystem::temp_directory_path() / "xenia_path_cache_test";
+  std::filesystem::remove_all(root);
+  std::filesystem::create_directories(root / "data");
+  std::ofstream(root / "data" / "a.bin") << "a";
+
+  HostPathDevice device("\\Device\\Test", root, false);
+  REQUIRE(device.Initialize());
+
+  Entry* entry = device.ResolvePathCached("data\\a.bin");
+  REQUIRE(entry);
+  REQUIRE(device.ResolvePathCached("DATA\\A.BIN") == entry);
+  REQUIRE_FALSE(device.ResolvePathCached("data\\b.bin"));
+  // Cached as missing until created.
+  REQUIRE_FALSE(device.ResolvePathCached("data\\b.bin"));
+
+  Entry* data = device.ResolvePathCached("data");
+  REQUIRE(data);
+  Entry* created = data->CreateEntry("b.bin", kFileAttributeNormal);
+  REQUIRE(created);
+  REQUIRE(device.ResolvePathCached("data\\b.bin") == created);
+
+  REQUIRE(data->Delete(entry));
+  REQUIRE_FALSE(device.ResolvePathCached("data\\a.bin"));
+
+  std::filesystem::remove_all(root);
+}
+
+}  // namespace xe::vfs::test